@@ -1,21 +1,42 @@
 #!/usr/bin/env python3
 
 import argparse
+from collections import OrderedDict
 
 parser = argparse.ArgumentParser("generate_rc.py", description="Generates an .rc files that fixes the permissions for all the ftrace events listed in the input atrace_categories.txt file")
 parser.add_argument("filename", help="Path to the atrace_categories.txt file")
+parser.add_argument("--no-debugfs", action="store_true", help="Only fix the tracefs paths, for devices without debugfs")
 
 args = parser.parse_args()
 
-print("# Sets permission for vendor ftrace events")
-print("on late-init")
+roots = ["/sys/kernel/tracing"]
+if not args.no_debugfs:
+  roots.insert(0, "/sys/kernel/debug/tracing")
 
+# Events by subsystem, in the order they are first listed. An event listed by
+# several categories gets its permissions fixed once.
+subsystems = OrderedDict()
+categories = OrderedDict()
 with open(args.filename, 'r') as f:
+  category = None
   for line in f:
     line = line.rstrip('\n')
     if line.startswith(' ') or line.startswith('\t'):
       path = line.lstrip(" \t")
-      print("    chmod 0666 /sys/kernel/debug/tracing/events/{}/enable".format(path))
-      print("    chmod 0666 /sys/kernel/tracing/events/{}/enable".format(path))
-    else:
-      print ("    # {} trace points".format(line))
+      subsystem = path.split('/')[0]
+      events = subsystems.setdefault(subsystem, OrderedDict())
+      events[path] = None
+      categories.setdefault(subsystem, OrderedDict())[category] = None
+    elif line:
+      category = line
+
+print("# Sets permission for vendor ftrace events")
+print("on late-init")
+
+# init has no recursive chmod and ueventd only applies permissions to device
+# nodes, so every event still takes one chmod per tracing root.
+for subsystem, events in subsystems.items():
+  print("    # {} trace points ({})".format(subsystem, ", ".join(categories[subsystem])))
+  for root in roots:
+    for path in events:
+      print("    chmod 0666 {}/events/{}/enable".format(root, path))
@@ -38,17 +38,76 @@ using android::hardware::boot::V1_1::MergeStatus;
 BootControlShared::BootControlShared() {}
 
 bool BootControlShared::Init() {
+    std::lock_guard<std::mutex> lock(mMergeStatusLock);
+
+    mVirtualAbMessage.reset();
     return InitMiscVirtualAbMessageIfNeeded();
 }
 
+bool BootControlShared::loadVirtualAbMessageLocked() {
+    misc_virtual_ab_message message;
+    std::string err;
+
+    if (mVirtualAbMessage) {
+        return true;
+    }
+
+    if (!ReadMiscVirtualAbMessage(&message, &err)) {
+        LOG(ERROR) << "Could not read merge status: " << err;
+        return false;
+    }
+    // Leave an uninitialized message uncached so the next call reads misc again.
+    if (message.magic != MISC_VIRTUAL_AB_MAGIC_HEADER ||
+        message.version != MISC_VIRTUAL_AB_MESSAGE_VERSION) {
+        LOG(ERROR) << "Invalid virtual A/B message in misc";
+        return false;
+    }
+
+    mVirtualAbMessage = message;
+    return true;
+}
+
 Return<bool> BootControlShared::setSnapshotMergeStatus(MergeStatus status) {
-    return SetMiscVirtualAbMergeStatus(getCurrentSlot(), status);
+    std::lock_guard<std::mutex> lock(mMergeStatusLock);
+    misc_virtual_ab_message message;
+    std::string err;
+
+    if (!loadVirtualAbMessageLocked()) {
+        // Let libboot_control deal with a message that is not there yet.
+        return SetMiscVirtualAbMergeStatus(getCurrentSlot(), status);
+    }
+
+    message = *mVirtualAbMessage;
+    message.merge_status = static_cast<uint8_t>(status);
+    message.source_slot = static_cast<uint32_t>(getCurrentSlot());
+    if (!WriteMiscVirtualAbMessage(message, &err)) {
+        LOG(ERROR) << "Could not write merge status: " << err;
+        // The write may have landed partially; read misc again next time.
+        mVirtualAbMessage.reset();
+        return false;
+    }
+
+    mVirtualAbMessage = message;
+    return true;
 }
 
 Return<MergeStatus> BootControlShared::getSnapshotMergeStatus() {
+    std::lock_guard<std::mutex> lock(mMergeStatusLock);
     MergeStatus status;
-    if (!GetMiscVirtualAbMergeStatus(getCurrentSlot(), &status)) {
-        return MergeStatus::UNKNOWN;
+
+    if (!loadVirtualAbMessageLocked()) {
+        if (!GetMiscVirtualAbMergeStatus(getCurrentSlot(), &status)) {
+            return MergeStatus::UNKNOWN;
+        }
+        return status;
+    }
+
+    status = static_cast<MergeStatus>(mVirtualAbMessage->merge_status);
+    // A snapshot taken from the slot we booted again is discarded at boot,
+    // matching GetMiscVirtualAbMergeStatus().
+    if (status == MergeStatus::SNAPSHOTTED &&
+        static_cast<uint32_t>(getCurrentSlot()) == mVirtualAbMessage->source_slot) {
+        status = MergeStatus::NONE;
     }
     return status;
 }
@@ -17,9 +17,13 @@
 #pragma once
 
 #include <android/hardware/boot/1.2/IBootControl.h>
+#include <bootloader_message/bootloader_message.h>
 #include <hidl/MQDescriptor.h>
 #include <hidl/Status.h>
 
+#include <mutex>
+#include <optional>
+
 namespace android {
 namespace hardware {
 namespace boot {
@@ -36,6 +40,16 @@ struct BootControlShared : public IBootControl {
 
     Return<bool> setSnapshotMergeStatus(MergeStatus status) override;
     Return<MergeStatus> getSnapshotMergeStatus() override;
+
+  private:
+    // Reads the virtual A/B message from misc into mVirtualAbMessage unless
+    // it is already cached. Caller holds mMergeStatusLock.
+    bool loadVirtualAbMessageLocked();
+
+    // misc is only written through this HAL while the system runs, so the
+    // message is read once and every set writes the cached copy through.
+    std::mutex mMergeStatusLock;
+    std::optional<misc_virtual_ab_message> mVirtualAbMessage;
 };
 
 extern "C" IBootControl *HIDL_FETCH_IBootControl(const char *name);
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "pixel-boottiming"
+
+#include <aidl/android/frameworks/stats/IStats.h>
+#include <android-base/logging.h>
+#include <android/binder_manager.h>
+#include <hardware/google/pixel/pixelstats/pixelatoms.pb.h>
+#include <pixelboottiming/BootPhaseAtom.h>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+using aidl::android::frameworks::stats::IStats;
+using aidl::android::frameworks::stats::VendorAtom;
+using aidl::android::frameworks::stats::VendorAtomValue;
+using android::hardware::google::pixel::PixelAtoms::PixelHalBootPhaseReported;
+
+namespace {
+
+constexpr int kVendorAtomOffset = 2;
+
+}  // namespace
+
+void reportBootPhasesToStats(const std::string &hal, const std::vector<BootPhase> &phases) {
+    const std::string instance = std::string() + IStats::descriptor + "/default";
+    if (!AServiceManager_isDeclared(instance.c_str())) {
+        LOG(ERROR) << "Stats service is not registered.";
+        return;
+    }
+    const std::shared_ptr<IStats> stats_client =
+            IStats::fromBinder(ndk::SpAIBinder(AServiceManager_waitForService(instance.c_str())));
+    if (!stats_client) {
+        LOG(ERROR) << "Unable to get AIDL Stats service";
+        return;
+    }
+    for (const auto &phase : phases) {
+        std::vector<VendorAtomValue> values(4);
+        values[PixelHalBootPhaseReported::kHalFieldNumber - kVendorAtomOffset] =
+                VendorAtomValue::make<VendorAtomValue::stringValue>(hal);
+        values[PixelHalBootPhaseReported::kPhaseFieldNumber - kVendorAtomOffset] =
+                VendorAtomValue::make<VendorAtomValue::stringValue>(phase.name);
+        values[PixelHalBootPhaseReported::kStartBoottimeMillisFieldNumber - kVendorAtomOffset] =
+                VendorAtomValue::make<VendorAtomValue::longValue>(
+                        std::chrono::duration_cast<std::chrono::milliseconds>(phase.start)
+                                .count());
+        values[PixelHalBootPhaseReported::kDurationMicrosFieldNumber - kVendorAtomOffset] =
+                VendorAtomValue::make<VendorAtomValue::longValue>(
+                        std::chrono::duration_cast<std::chrono::microseconds>(phase.duration)
+                                .count());
+        VendorAtom event = {.reverseDomainName = "",
+                            .atomId = PixelAtoms::Atom::kPixelHalBootPhaseReported,
+                            .values = std::move(values)};
+        if (!stats_client->reportVendorAtom(event).isOk()) {
+            LOG(ERROR) << "Unable to report boot phase " << phase.name << " of " << hal;
+        }
+    }
+}
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "pixel-boottiming"
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <pixelboottiming/BootPhaseTimer.h>
+#include <time.h>
+
+#include <thread>
+#include <utility>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+namespace {
+
+double toMs(std::chrono::nanoseconds duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+}  // namespace
+
+std::chrono::nanoseconds BootPhaseTimer::bootTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+BootPhaseTimer::BootPhaseTimer(std::string hal, Clock clock)
+    : mHal(std::move(hal)), mClock(std::move(clock)), mStart(mClock()) {}
+
+void BootPhaseTimer::begin(std::string name) {
+    if (mFinished)
+        return;
+    end();
+    mCurrent = BootPhase{std::move(name), mClock(), {}};
+}
+
+void BootPhaseTimer::end() {
+    if (!mCurrent)
+        return;
+    mCurrent->duration = mClock() - mCurrent->start;
+    mPhases.push_back(std::move(*mCurrent));
+    mCurrent.reset();
+}
+
+void BootPhaseTimer::finish(Reporter reporter) {
+    if (mFinished)
+        return;
+    end();
+    mFinished = true;
+    mPhases.push_back({kTotalPhase, mStart, mClock() - mStart});
+    LOG(INFO) << summary();
+    if (reporter) {
+        std::thread([reporter = std::move(reporter), hal = mHal, phases = mPhases] {
+            reporter(hal, phases);
+        }).detach();
+    }
+}
+
+std::string BootPhaseTimer::summary() const {
+    std::string summary = mHal + " init";
+    if (mFinished) {
+        const BootPhase &total = mPhases.back();
+        base::StringAppendF(&summary, " took %.1fms at %.3fs", toMs(total.duration),
+                            toMs(total.start + total.duration) / 1000);
+    }
+    const char *separator = ": ";
+    for (const auto &phase : mPhases) {
+        if (mFinished && &phase == &mPhases.back())
+            break;
+        base::StringAppendF(&summary, "%s%s %.1fms", separator, phase.name.c_str(),
+                            toMs(phase.duration));
+        separator = ", ";
+    }
+    return summary;
+}
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_COMMON_BOOTTIMING_BOOTPHASEATOM_H
+#define HARDWARE_GOOGLE_PIXEL_COMMON_BOOTTIMING_BOOTPHASEATOM_H
+
+#include <pixelboottiming/BootPhaseTimer.h>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+/**
+ * A BootPhaseTimer::Reporter which reports each phase as a
+ * PixelHalBootPhaseReported atom through IStats. It waits for IStats to come
+ * up, so it is meant to run on the thread finish() starts.
+ */
+void reportBootPhasesToStats(const std::string &hal, const std::vector<BootPhase> &phases);
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
+
+#endif  // HARDWARE_GOOGLE_PIXEL_COMMON_BOOTTIMING_BOOTPHASEATOM_H
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_COMMON_BOOTTIMING_BOOTPHASETIMER_H
+#define HARDWARE_GOOGLE_PIXEL_COMMON_BOOTTIMING_BOOTPHASETIMER_H
+
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+struct BootPhase {
+    std::string name;
+    // CLOCK_BOOTTIME at the start of the phase
+    std::chrono::nanoseconds start;
+    std::chrono::nanoseconds duration;
+};
+
+/**
+ * Times the named phases a HAL goes through while it initializes at boot.
+ *
+ * Phases are stamped with CLOCK_BOOTTIME so they line up with the kernel log
+ * and with each other across HALs. finish() emits them once: one line to
+ * logcat, then the phases and a "total" phase from construction to finish()
+ * to a reporter, e.g. reportBootPhasesToStats(). The reporter runs on a
+ * detached thread as it typically waits for a service which may not be up
+ * yet, which must not hold up the HAL.
+ *
+ * Not thread safe, a timer is used by the thread initializing the HAL.
+ */
+class BootPhaseTimer {
+  public:
+    using Clock = std::function<std::chrono::nanoseconds()>;
+    using Reporter =
+            std::function<void(const std::string &hal, const std::vector<BootPhase> &phases)>;
+
+    static constexpr const char *kTotalPhase = "total";
+
+    // The time since boot, including suspend
+    static std::chrono::nanoseconds bootTime();
+
+    explicit BootPhaseTimer(std::string hal, Clock clock = bootTime);
+    // Disallow copy and assign.
+    BootPhaseTimer(const BootPhaseTimer &) = delete;
+    void operator=(const BootPhaseTimer &) = delete;
+
+    // End the current phase, if any, and start the named one
+    void begin(std::string name);
+    // End the current phase
+    void end();
+    /**
+     * End the current phase and emit the phases. Only the first call emits,
+     * phases begun after it are ignored. reporter may be null to only log.
+     */
+    void finish(Reporter reporter = nullptr);
+
+    const std::string &hal() const { return mHal; }
+    // The phases ended so far, and the total phase once finished
+    const std::vector<BootPhase> &phases() const { return mPhases; }
+    // "<hal> init took <total>ms at <boot>s: <phase> <duration>ms, ..."
+    std::string summary() const;
+
+  private:
+    const std::string mHal;
+    const Clock mClock;
+    const std::chrono::nanoseconds mStart;
+    std::vector<BootPhase> mPhases;
+    // The name and start of the current phase
+    std::optional<BootPhase> mCurrent;
+    bool mFinished = false;
+};
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
+
+#endif  // HARDWARE_GOOGLE_PIXEL_COMMON_BOOTTIMING_BOOTPHASETIMER_H
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <pixelboottiming/BootPhaseTimer.h>
+
+#include <future>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+using std::literals::chrono_literals::operator""ms;
+using std::literals::chrono_literals::operator""s;
+
+class BootPhaseTimerTest : public ::testing::Test {
+  protected:
+    BootPhaseTimer::Clock clock() {
+        return [this] { return now_; };
+    }
+
+    std::chrono::nanoseconds now_ = 5s;
+};
+
+TEST_F(BootPhaseTimerTest, TimesPhases) {
+    BootPhaseTimer timer("thermal", clock());
+    now_ += 1ms;
+    timer.begin("parse_config");
+    now_ += 10ms;
+    timer.begin("sensor_map");
+    now_ += 2ms;
+    timer.end();
+    // Time between phases only counts towards the total
+    now_ += 3ms;
+    timer.begin("cooling_devices");
+    now_ += 4ms;
+
+    ASSERT_EQ(2u, timer.phases().size());
+    EXPECT_EQ("parse_config", timer.phases()[0].name);
+    EXPECT_EQ(5s + 1ms, timer.phases()[0].start);
+    EXPECT_EQ(10ms, timer.phases()[0].duration);
+    EXPECT_EQ("sensor_map", timer.phases()[1].name);
+    EXPECT_EQ(2ms, timer.phases()[1].duration);
+
+    timer.finish();
+    ASSERT_EQ(4u, timer.phases().size());
+    EXPECT_EQ(4ms, timer.phases()[2].duration);
+    EXPECT_EQ(BootPhaseTimer::kTotalPhase, timer.phases()[3].name);
+    EXPECT_EQ(5s, timer.phases()[3].start);
+    EXPECT_EQ(20ms, timer.phases()[3].duration);
+    EXPECT_EQ(
+            "thermal init took 20.0ms at 5.020s: parse_config 10.0ms, sensor_map 2.0ms, "
+            "cooling_devices 4.0ms",
+            timer.summary());
+}
+
+TEST_F(BootPhaseTimerTest, ReportsOnce) {
+    BootPhaseTimer timer("power", clock());
+    timer.begin("hint_manager");
+    now_ += 7ms;
+
+    std::promise<std::vector<BootPhase>> reported;
+    timer.finish([&reported](const std::string &hal, const std::vector<BootPhase> &phases) {
+        EXPECT_EQ("power", hal);
+        reported.set_value(phases);
+    });
+    auto future = reported.get_future();
+    ASSERT_EQ(std::future_status::ready, future.wait_for(5s));
+    const auto phases = future.get();
+    ASSERT_EQ(2u, phases.size());
+    EXPECT_EQ("hint_manager", phases[0].name);
+    EXPECT_EQ(BootPhaseTimer::kTotalPhase, phases[1].name);
+
+    // Nothing changes or is reported after the first finish()
+    timer.begin("late");
+    now_ += 1ms;
+    timer.finish([](const std::string &, const std::vector<BootPhase> &) { FAIL(); });
+    EXPECT_EQ(2u, timer.phases().size());
+}
+
+TEST_F(BootPhaseTimerTest, BootTimeAdvances) {
+    const auto first = BootPhaseTimer::bootTime();
+    EXPECT_GT(first.count(), 0);
+    EXPECT_LE(first, BootPhaseTimer::bootTime());
+}
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,375 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "pixel-proctable"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#include <pixelproctable/ProcessTable.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+namespace {
+
+// The enum of proc_event::what, nested in it by older kernel headers
+using ProcEventWhat = decltype(proc_event::what);
+
+// The value of the "<key>" line of content, up to the end of the line
+std::string_view findLine(std::string_view content, std::string_view key) {
+    size_t pos = 0;
+    while (pos < content.size()) {
+        size_t end = content.find('\n', pos);
+        if (end == std::string_view::npos)
+            end = content.size();
+        std::string_view line = content.substr(pos, end - pos);
+        if (line.substr(0, key.size()) == key) {
+            line.remove_prefix(key.size());
+            while (!line.empty() && (line.front() == ' ' || line.front() == '\t'))
+                line.remove_prefix(1);
+            return line;
+        }
+        pos = end + 1;
+    }
+    return {};
+}
+
+// The leading number of value
+bool parseLeadingUint(std::string_view value, uint64_t *out) {
+    size_t len = 0;
+    while (len < value.size() && value[len] >= '0' && value[len] <= '9') len++;
+    return len && android::base::ParseUint(std::string(value.substr(0, len)), out);
+}
+
+}  // namespace
+
+ProcessTable::ProcessTable(std::string procRoot, size_t maxOpenFiles, bool useProcEvents)
+    : mProcRoot(std::move(procRoot)),
+      mMaxOpenFiles(maxOpenFiles),
+      mUseProcEvents(useProcEvents) {}
+
+void ProcessTable::openProcEvents() {
+    android::base::unique_fd fd(
+            socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR));
+    if (fd < 0) {
+        LOG(WARNING) << "proc connector socket failed: " << strerror(errno);
+        return;
+    }
+    struct sockaddr_nl addr = {};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = CN_IDX_PROC;
+    addr.nl_pid = 0;
+    if (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+        LOG(WARNING) << "proc connector bind failed: " << strerror(errno);
+        return;
+    }
+    char request[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op))]
+            __attribute__((aligned(NLMSG_ALIGNTO))) = {};
+    struct nlmsghdr *header = reinterpret_cast<struct nlmsghdr *>(request);
+    header->nlmsg_len = sizeof(request);
+    header->nlmsg_type = NLMSG_DONE;
+    header->nlmsg_pid = getpid();
+    struct cn_msg *msg = reinterpret_cast<struct cn_msg *>(NLMSG_DATA(header));
+    msg->id.idx = CN_IDX_PROC;
+    msg->id.val = CN_VAL_PROC;
+    msg->len = sizeof(enum proc_cn_mcast_op);
+    *reinterpret_cast<enum proc_cn_mcast_op *>(msg->data) = PROC_CN_MCAST_LISTEN;
+    if (TEMP_FAILURE_RETRY(send(fd, request, sizeof(request), 0)) < 0) {
+        LOG(WARNING) << "proc connector listen failed: " << strerror(errno);
+        return;
+    }
+    mProcEvents = std::move(fd);
+}
+
+// Apply the events since the last call in order. False if events were lost.
+bool ProcessTable::readProcEvents() {
+    char buffer[4096] __attribute__((aligned(NLMSG_ALIGNTO)));
+    while (true) {
+        ssize_t len = TEMP_FAILURE_RETRY(recv(mProcEvents, buffer, sizeof(buffer), 0));
+        if (len < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return true;
+            if (errno != ENOBUFS)
+                LOG(WARNING) << "proc connector recv failed: " << strerror(errno);
+            return false;
+        }
+        for (struct nlmsghdr *header = reinterpret_cast<struct nlmsghdr *>(buffer);
+             NLMSG_OK(header, len); header = NLMSG_NEXT(header, len)) {
+            if (header->nlmsg_type != NLMSG_DONE)
+                continue;
+            const struct cn_msg *msg = reinterpret_cast<const struct cn_msg *>(NLMSG_DATA(header));
+            if (msg->len < sizeof(struct proc_event))
+                continue;
+            const struct proc_event *event = reinterpret_cast<const struct proc_event *>(msg->data);
+            const auto &data = event->event_data;
+            // Only the main threads, the others share the process of their tgid
+            switch (event->what) {
+                case ProcEventWhat::PROC_EVENT_FORK:
+                    if (data.fork.child_pid == data.fork.child_tgid)
+                        readStatus(data.fork.child_tgid);
+                    break;
+                case ProcEventWhat::PROC_EVENT_EXIT:
+                    if (data.exit.process_pid == data.exit.process_tgid)
+                        erase(data.exit.process_tgid);
+                    break;
+                case ProcEventWhat::PROC_EVENT_EXEC:
+                    readStatus(data.exec.process_tgid);
+                    break;
+                case ProcEventWhat::PROC_EVENT_UID:
+                    if (data.id.process_pid == data.id.process_tgid)
+                        readStatus(data.id.process_tgid);
+                    break;
+                case ProcEventWhat::PROC_EVENT_COMM:
+                    if (data.comm.process_pid == data.comm.process_tgid)
+                        readStatus(data.comm.process_tgid);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+// Add the pids of /proc not known yet, and drop those gone
+void ProcessTable::scan() {
+    std::unique_ptr<DIR, int (*)(DIR *)> dir(opendir(mProcRoot.c_str()), closedir);
+    if (!dir) {
+        LOG(ERROR) << "Fail to open " << mProcRoot;
+        return;
+    }
+    mScanCount++;
+    std::unordered_set<uint32_t> seen;
+    seen.reserve(mEntries.size());
+    while (struct dirent *ent = readdir(dir.get())) {
+        uint32_t pid;
+        if (ent->d_type != DT_DIR || !android::base::ParseUint(ent->d_name, &pid))
+            continue;
+        seen.insert(pid);
+        if (!mEntries.count(pid))
+            readStatus(pid);
+    }
+    for (auto it = mEntries.begin(); it != mEntries.end();) {
+        if (seen.count(it->first)) {
+            ++it;
+            continue;
+        }
+        if (it->second.statFd >= 0)
+            mOpenFiles.erase(it->second.openFile);
+        it = mEntries.erase(it);
+    }
+}
+
+// Add pid, or bump its seq if its comm or uid changed
+void ProcessTable::readStatus(uint32_t pid) {
+    if (mIgnored.count(pid))
+        return;
+    ProcessInfo info;
+    if (!android::base::ReadFileToString(mProcRoot + "/" + std::to_string(pid) + "/status",
+                                         &mBuffer) ||
+        !parseStatus(mBuffer, &info)) {
+        // Gone already
+        erase(pid);
+        return;
+    }
+    auto [it, added] = mEntries.try_emplace(pid);
+    ProcessInfo &known = it->second.info;
+    if (!added && known.comm == info.comm && known.uid == info.uid)
+        return;
+    known.pid = pid;
+    known.comm = std::move(info.comm);
+    known.uid = info.uid;
+    known.seq = ++mSeq;
+}
+
+void ProcessTable::erase(uint32_t pid) {
+    auto it = mEntries.find(pid);
+    if (it == mEntries.end())
+        return;
+    if (it->second.statFd >= 0)
+        mOpenFiles.erase(it->second.openFile);
+    mEntries.erase(it);
+}
+
+void ProcessTable::update(bool rescan) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (!mScanCount && mUseProcEvents) {
+        // Listen before the first scan, so no process is missed in between
+        openProcEvents();
+    }
+    bool needScan = rescan || !mScanCount || mProcEvents < 0;
+    if (mProcEvents >= 0 && !readProcEvents()) {
+        LOG(WARNING) << "proc connector events lost, rescan " << mProcRoot;
+        needScan = true;
+    }
+    if (needScan)
+        scan();
+}
+
+void ProcessTable::ignore(uint32_t pid) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mIgnored.insert(pid);
+    erase(pid);
+}
+
+// The stat of a process which exited fails to read, even if its pid is reused
+bool ProcessTable::readStat(Entry *entry) {
+    const uint32_t pid = entry->info.pid;
+    if (entry->statFd < 0) {
+        const std::string path = mProcRoot + "/" + std::to_string(pid) + "/stat";
+        entry->statFd.reset(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+        if (entry->statFd < 0)
+            return false;
+        if (!mOpenFiles.empty() && mOpenFiles.size() >= mMaxOpenFiles) {
+            mEntries.find(mOpenFiles.back())->second.statFd.reset();
+            mOpenFiles.pop_back();
+        }
+        mOpenFiles.push_front(pid);
+        entry->openFile = mOpenFiles.begin();
+    } else {
+        mOpenFiles.splice(mOpenFiles.begin(), mOpenFiles, entry->openFile);
+    }
+
+    char buf[1024];
+    ssize_t len = TEMP_FAILURE_RETRY(pread(entry->statFd, buf, sizeof(buf) - 1, 0));
+    ProcessInfo info = entry->info;
+    if (len <= 0 || !parseStat(std::string_view(buf, len), &info)) {
+        if (len > 0)
+            LOG(ERROR) << "Invalid proc data\n" << std::string(buf, len);
+        return false;
+    }
+    if (info.comm != entry->info.comm)
+        info.seq = ++mSeq;
+    entry->info = std::move(info);
+    return true;
+}
+
+bool ProcessTable::readIo(Entry *entry) {
+    return android::base::ReadFileToString(
+                   mProcRoot + "/" + std::to_string(entry->info.pid) + "/io", &mBuffer) &&
+           parseIo(mBuffer, &entry->info);
+}
+
+bool ProcessTable::sample(uint32_t pid, uint32_t fields, ProcessInfo *info) {
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mEntries.find(pid);
+    if (it == mEntries.end())
+        return false;
+    if (((fields & kTimes) && !readStat(&it->second)) ||
+        ((fields & kIo) && !readIo(&it->second))) {
+        erase(pid);
+        return false;
+    }
+    *info = it->second.info;
+    return true;
+}
+
+bool ProcessTable::find(uint32_t pid, ProcessInfo *info) const {
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mEntries.find(pid);
+    if (it == mEntries.end())
+        return false;
+    *info = it->second.info;
+    return true;
+}
+
+void ProcessTable::pids(std::vector<uint32_t> *pids) const {
+    std::lock_guard<std::mutex> lock(mLock);
+    pids->clear();
+    pids->reserve(mEntries.size());
+    for (const auto &it : mEntries) pids->push_back(it.first);
+}
+
+uint64_t ProcessTable::changedSince(uint64_t seq, std::vector<ProcessInfo> *changed) const {
+    std::lock_guard<std::mutex> lock(mLock);
+    changed->clear();
+    for (const auto &it : mEntries) {
+        if (it.second.info.seq > seq)
+            changed->push_back(it.second.info);
+    }
+    return mSeq;
+}
+
+uint32_t ProcessTable::scanCount() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mScanCount;
+}
+
+bool ProcessTable::hasProcEvents() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mProcEvents >= 0;
+}
+
+/*
+ * "<pid> (<comm>) <state> ...", the comm may hold spaces and parentheses, so
+ * it is between the first '(' and the last ')'. utime, stime, cutime and
+ * cstime are the 12th to 15th fields after it.
+ */
+bool ProcessTable::parseStat(std::string_view content, ProcessInfo *info) {
+    const size_t open = content.find('(');
+    const size_t close = content.rfind(')');
+    if (open == std::string_view::npos || close == std::string_view::npos || close < open)
+        return false;
+    uint64_t times[4];
+    std::string_view fields = content.substr(close + 1);
+    for (int field = 1; field <= 15; field++) {
+        while (!fields.empty() && fields.front() == ' ') fields.remove_prefix(1);
+        const size_t end = std::min(fields.find(' '), fields.size());
+        if (!end)
+            return false;
+        if (field >= 12 && !parseLeadingUint(fields.substr(0, end), &times[field - 12]))
+            return false;
+        fields.remove_prefix(end);
+    }
+    info->comm = std::string(content.substr(open + 1, close - open - 1));
+    info->utime = times[0] + times[2];
+    info->stime = times[1] + times[3];
+    return true;
+}
+
+bool ProcessTable::parseStatus(std::string_view content, ProcessInfo *info) {
+    std::string_view name = findLine(content, "Name:");
+    uint64_t uid;
+    if (name.empty() || !parseLeadingUint(findLine(content, "Uid:"), &uid))
+        return false;
+    info->comm = std::string(name);
+    info->uid = uid;
+    return true;
+}
+
+bool ProcessTable::parseIo(std::string_view content, ProcessInfo *info) {
+    return parseLeadingUint(findLine(content, "read_bytes:"), &info->readBytes) &&
+           parseLeadingUint(findLine(content, "write_bytes:"), &info->writeBytes);
+}
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_COMMON_PROCTABLE_PROCESSTABLE_H
+#define HARDWARE_GOOGLE_PIXEL_COMMON_PROCTABLE_PROCESSTABLE_H
+
+#include <android-base/unique_fd.h>
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+struct ProcessInfo {
+    uint32_t pid = 0;
+    uint32_t uid = 0;   // the real uid, from status
+    std::string comm;   // at most 15 characters
+    // Clock ticks, including the children it waited for, as of the last sample()
+    uint64_t utime = 0;
+    uint64_t stime = 0;
+    // Bytes from storage, as of the last sample() with kIo
+    uint64_t readBytes = 0;
+    uint64_t writeBytes = 0;
+    // Bumped when the process was added, or its comm or uid changed
+    uint64_t seq = 0;
+};
+
+/**
+ * The processes running, by pid, kept up to date incrementally.
+ *
+ * /proc is walked once, then the fork, exit, exec, uid and comm events of the
+ * netlink proc connector add, drop and re-read processes, reading
+ * /proc/<pid>/status only for those. Without the connector, which needs
+ * CAP_NET_ADMIN, or when events were lost, update() walks /proc again and
+ * reads only the pids it did not know.
+ *
+ * The counters are read on demand by sample(), through /proc/<pid>/stat files
+ * kept open to be read again with a single pread(), the least recently
+ * sampled closed beyond maxOpenFiles.
+ *
+ * Thread safe, so that the stats collectors of a daemon can share one table
+ * and one walk of /proc.
+ */
+class ProcessTable {
+  public:
+    enum Fields : uint32_t {
+        kTimes = 1 << 0,  // utime and stime, from stat
+        kIo = 1 << 1,     // readBytes and writeBytes, from io
+    };
+
+    explicit ProcessTable(std::string procRoot = "/proc", size_t maxOpenFiles = 256,
+                          bool useProcEvents = true);
+    // Disallow copy and assign.
+    ProcessTable(const ProcessTable &) = delete;
+    void operator=(const ProcessTable &) = delete;
+
+    // Apply the events since the last update, or walk /proc when needed or rescan
+    void update(bool rescan = false);
+    // Never add pid, e.g. one the caller has no permission to read
+    void ignore(uint32_t pid);
+
+    // Read the fields of pid into its entry and copy it to info. False, and
+    // the entry dropped, if the process is gone.
+    bool sample(uint32_t pid, uint32_t fields, ProcessInfo *info);
+    bool find(uint32_t pid, ProcessInfo *info) const;
+    // The pids of the table, in no particular order
+    void pids(std::vector<uint32_t> *pids) const;
+    /**
+     * Copy the processes added or changed after seq to changed, and return
+     * the seq to pass next time. 0 gets every process.
+     */
+    uint64_t changedSince(uint64_t seq, std::vector<ProcessInfo> *changed) const;
+
+    // /proc walks so far, the first included
+    uint32_t scanCount() const;
+    bool hasProcEvents() const;
+
+    // Parse /proc/<pid>/stat, /proc/<pid>/status and /proc/<pid>/io content
+    static bool parseStat(std::string_view content, ProcessInfo *info);
+    static bool parseStatus(std::string_view content, ProcessInfo *info);
+    static bool parseIo(std::string_view content, ProcessInfo *info);
+
+  private:
+    struct Entry {
+        ProcessInfo info;
+        android::base::unique_fd statFd;
+        std::list<uint32_t>::iterator openFile;  // in mOpenFiles while statFd is open
+    };
+
+    const std::string mProcRoot;
+    const size_t mMaxOpenFiles;
+    const bool mUseProcEvents;
+    mutable std::mutex mLock;
+    std::unordered_map<uint32_t, Entry> mEntries;
+    std::unordered_set<uint32_t> mIgnored;
+    std::list<uint32_t> mOpenFiles;  // most recently sampled first
+    android::base::unique_fd mProcEvents;  // the proc connector socket
+    std::string mBuffer;                   // reused by every read
+    uint64_t mSeq = 0;
+    uint32_t mScanCount = 0;
+
+    void openProcEvents();
+    bool readProcEvents();
+    void scan();
+    void readStatus(uint32_t pid);
+    void erase(uint32_t pid);
+    bool readStat(Entry *entry);
+    bool readIo(Entry *entry);
+};
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
+
+#endif  // HARDWARE_GOOGLE_PIXEL_COMMON_PROCTABLE_PROCESSTABLE_H
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <gtest/gtest.h>
+#include <pixelproctable/ProcessTable.h>
+#include <sys/stat.h>
+
+#include <cinttypes>
+#include <cstdlib>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+using android::base::StringPrintf;
+using android::base::WriteStringToFile;
+
+// A synthetic /proc, without the proc connector
+class ProcessTableTest : public ::testing::Test {
+  protected:
+    void addProcess(uint32_t pid, const std::string &comm, uint32_t uid, uint64_t utime = 0) {
+        const std::string dir = StringPrintf("%s/%u", mDir.path, pid);
+        mkdir(dir.c_str(), 0755);
+        WriteStringToFile(StringPrintf("Name:\t%s\nUmask:\t0077\nState:\tS (sleeping)\n"
+                                       "Tgid:\t%u\nPid:\t%u\nUid:\t%u\t%u\t%u\t%u\n",
+                                       comm.c_str(), pid, pid, uid, uid, uid, uid),
+                          dir + "/status");
+        WriteStringToFile(StringPrintf("%u (%s) S 1 %u %u 0 -1 4194560 0 0 0 0 %" PRIu64
+                                       " 7 2 1 20 0 1 0 100 0 0\n",
+                                       pid, comm.c_str(), pid, pid, utime),
+                          dir + "/stat");
+        WriteStringToFile("rchar: 10\nwchar: 20\nsyscr: 1\nsyscw: 2\nread_bytes: 4096\n"
+                          "write_bytes: 8192\ncancelled_write_bytes: 0\n",
+                          dir + "/io");
+    }
+
+    void removeProcess(uint32_t pid) {
+        system(StringPrintf("rm -rf %s/%u", mDir.path, pid).c_str());
+    }
+
+    TemporaryDir mDir;
+};
+
+TEST_F(ProcessTableTest, ParsesStat) {
+    ProcessInfo info;
+    ASSERT_TRUE(ProcessTable::parseStat(
+            "42 (a (b) c) S 1 42 42 0 -1 4194560 0 0 0 0 30 7 2 1 20 0 1 0 100 0 0\n", &info));
+    EXPECT_EQ("a (b) c", info.comm);
+    EXPECT_EQ(32u, info.utime);
+    EXPECT_EQ(8u, info.stime);
+    EXPECT_FALSE(ProcessTable::parseStat("42 (short) S 1 42", &info));
+    EXPECT_FALSE(ProcessTable::parseStat("42 no comm", &info));
+}
+
+TEST_F(ProcessTableTest, ParsesStatusAndIo) {
+    ProcessInfo info;
+    ASSERT_TRUE(ProcessTable::parseStatus("Name:\tcom.app two\nUid:\t10123\t10123\t10123\t10123\n",
+                                          &info));
+    EXPECT_EQ("com.app two", info.comm);
+    EXPECT_EQ(10123u, info.uid);
+    EXPECT_FALSE(ProcessTable::parseStatus("Name:\tnouid\n", &info));
+    ASSERT_TRUE(ProcessTable::parseIo("read_bytes: 12\nwrite_bytes: 34\n", &info));
+    EXPECT_EQ(12u, info.readBytes);
+    EXPECT_EQ(34u, info.writeBytes);
+}
+
+TEST_F(ProcessTableTest, TracksProcesses) {
+    addProcess(10, "init", 0);
+    addProcess(20, "app", 10020, 5);
+    ProcessTable table(mDir.path, 256, false);
+    table.ignore(10);
+    table.update();
+    EXPECT_EQ(1u, table.scanCount());
+
+    std::vector<uint32_t> pids;
+    table.pids(&pids);
+    EXPECT_EQ(std::vector<uint32_t>{20}, pids);
+
+    std::vector<ProcessInfo> changed;
+    uint64_t seq = table.changedSince(0, &changed);
+    ASSERT_EQ(1u, changed.size());
+    EXPECT_EQ("app", changed[0].comm);
+    EXPECT_EQ(10020u, changed[0].uid);
+
+    ProcessInfo info;
+    ASSERT_TRUE(table.sample(20, ProcessTable::kTimes | ProcessTable::kIo, &info));
+    EXPECT_EQ(7u, info.utime);
+    EXPECT_EQ(8u, info.stime);
+    EXPECT_EQ(4096u, info.readBytes);
+    EXPECT_EQ(8192u, info.writeBytes);
+
+    // Only the new process is reported changed, the exited one is dropped
+    addProcess(30, "new", 10030);
+    removeProcess(20);
+    table.update();
+    seq = table.changedSince(seq, &changed);
+    ASSERT_EQ(1u, changed.size());
+    EXPECT_EQ(30u, changed[0].pid);
+    EXPECT_FALSE(table.find(20, &info));
+    EXPECT_FALSE(table.sample(20, ProcessTable::kTimes, &info));
+
+    table.changedSince(seq, &changed);
+    EXPECT_TRUE(changed.empty());
+}
+
+TEST_F(ProcessTableTest, DropsProcessGoneOnSample) {
+    addProcess(20, "app", 10020);
+    addProcess(21, "other", 10021);
+    // One stat file kept open, the other reopened at each sample
+    ProcessTable table(mDir.path, 1, false);
+    table.update();
+
+    ProcessInfo info;
+    ASSERT_TRUE(table.sample(20, ProcessTable::kTimes, &info));
+    ASSERT_TRUE(table.sample(21, ProcessTable::kTimes, &info));
+    ASSERT_TRUE(table.sample(20, ProcessTable::kTimes, &info));
+    removeProcess(21);
+    EXPECT_FALSE(table.sample(21, ProcessTable::kTimes, &info));
+    EXPECT_FALSE(table.find(21, &info));
+    EXPECT_TRUE(table.find(20, &info));
+}
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <pixelsysfs/SysfsBackend.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+namespace {
+
+class PosixSysfsBackend : public SysfsBackend {
+  public:
+    int open(const std::string &path, int flags) override {
+        return TEMP_FAILURE_RETRY(::open(path.c_str(), flags));
+    }
+    ssize_t read(int fd, char *buffer, size_t size) override {
+        return TEMP_FAILURE_RETRY(::pread(fd, buffer, size, 0));
+    }
+    ssize_t write(int fd, const char *buffer, size_t size) override {
+        return TEMP_FAILURE_RETRY(::pwrite(fd, buffer, size, 0));
+    }
+    void close(int fd) override { ::close(fd); }
+};
+
+}  // namespace
+
+SysfsBackend *SysfsBackend::posix() {
+    static PosixSysfsBackend *backend = new PosixSysfsBackend();
+    return backend;
+}
+
+void FakeSysfsBackend::setContent(const std::string &path, const std::string &content) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mFiles[path].content = content;
+}
+
+std::string FakeSysfsBackend::content(const std::string &path) {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mFiles[path].content;
+}
+
+void FakeSysfsBackend::setError(const std::string &path, int error) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mFiles[path].error = error;
+}
+
+int FakeSysfsBackend::opens(const std::string &path) {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mFiles[path].opens;
+}
+
+int FakeSysfsBackend::reads(const std::string &path) {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mFiles[path].reads;
+}
+
+int FakeSysfsBackend::writes(const std::string &path) {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mFiles[path].writes;
+}
+
+int FakeSysfsBackend::open(const std::string &path, int) {
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mFiles.find(path);
+
+    if (it == mFiles.end()) {
+        errno = ENOENT;
+        return -1;
+    }
+    it->second.opens++;
+    if (it->second.error) {
+        errno = it->second.error;
+        return -1;
+    }
+    auto slot = std::find(mFds.begin(), mFds.end(), std::string());
+    if (slot == mFds.end())
+        slot = mFds.insert(mFds.end(), std::string());
+    *slot = path;
+    return slot - mFds.begin();
+}
+
+FakeSysfsBackend::File *FakeSysfsBackend::fileOf(int fd) {
+    if (fd < 0 || static_cast<size_t>(fd) >= mFds.size() || mFds[fd].empty())
+        return nullptr;
+    return &mFiles[mFds[fd]];
+}
+
+ssize_t FakeSysfsBackend::read(int fd, char *buffer, size_t size) {
+    std::lock_guard<std::mutex> lock(mLock);
+    File *file = fileOf(fd);
+
+    if (!file) {
+        errno = EBADF;
+        return -1;
+    }
+    file->reads++;
+    if (file->error) {
+        errno = file->error;
+        return -1;
+    }
+    size = std::min(size, file->content.size());
+    memcpy(buffer, file->content.data(), size);
+    return size;
+}
+
+ssize_t FakeSysfsBackend::write(int fd, const char *buffer, size_t size) {
+    std::lock_guard<std::mutex> lock(mLock);
+    File *file = fileOf(fd);
+
+    if (!file) {
+        errno = EBADF;
+        return -1;
+    }
+    file->writes++;
+    if (file->error) {
+        errno = file->error;
+        return -1;
+    }
+    file->content.assign(buffer, size);
+    return size;
+}
+
+void FakeSysfsBackend::close(int fd) {
+    std::lock_guard<std::mutex> lock(mLock);
+
+    if (fd >= 0 && static_cast<size_t>(fd) < mFds.size())
+        mFds[fd].clear();
+}
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <pixelsysfs/SysfsNode.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <utility>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+namespace {
+
+constexpr std::string_view kWhitespace = " \t\n";
+
+template <typename T>
+bool parseNumber(std::string_view text, T *value) {
+    text = TrimSysfsValue(text);
+    if (text.empty())
+        return false;
+    // from_chars takes no leading '+'
+    if (text[0] == '+')
+        text.remove_prefix(1);
+    const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), *value);
+    return ec == std::errc() && end == text.data() + text.size();
+}
+
+}  // namespace
+
+std::string_view TrimSysfsValue(std::string_view text) {
+    const size_t begin = text.find_first_not_of(kWhitespace);
+    if (begin == std::string_view::npos)
+        return {};
+    return text.substr(begin, text.find_last_not_of(kWhitespace) - begin + 1);
+}
+
+bool ParseSysfsNumber(std::string_view text, int64_t *value) {
+    return parseNumber(text, value);
+}
+
+bool ParseSysfsNumber(std::string_view text, uint64_t *value) {
+    return parseNumber(text, value);
+}
+
+SysfsNode::SysfsNode(std::string path, SysfsBackend *backend, bool instrumented)
+    : mPath(std::move(path)),
+      mBackend(backend),
+      mInstrumented(instrumented),
+      mReadFd(-1),
+      mWriteFd(-1) {}
+
+SysfsNode::~SysfsNode() {
+    closeFd(&mReadFd);
+    closeFd(&mWriteFd);
+}
+
+int SysfsNode::fd(int *slot, int flags) {
+    if (*slot < 0)
+        *slot = mBackend->open(mPath, flags | O_CLOEXEC);
+    return *slot;
+}
+
+void SysfsNode::closeFd(int *slot) {
+    if (*slot >= 0)
+        mBackend->close(*slot);
+    *slot = -1;
+}
+
+std::chrono::steady_clock::time_point SysfsNode::now() const {
+    return mInstrumented ? std::chrono::steady_clock::now()
+                         : std::chrono::steady_clock::time_point();
+}
+
+void SysfsNode::record(bool ok, std::chrono::steady_clock::time_point start) {
+    if (!ok)
+        mStats.errors++;
+    if (!mInstrumented)
+        return;
+    const auto latency = std::chrono::steady_clock::now() - start;
+    mStats.totalLatency += latency;
+    mStats.maxLatency = std::max<std::chrono::nanoseconds>(mStats.maxLatency, latency);
+}
+
+bool SysfsNode::read(std::string_view *content) {
+    const auto start = now();
+    mStats.reads++;
+
+    const int readFd = fd(&mReadFd, O_RDONLY);
+    if (readFd < 0) {
+        record(false, start);
+        return false;
+    }
+    const ssize_t size = mBackend->read(readFd, mBuffer, sizeof(mBuffer));
+    if (size < 0) {
+        const int error = errno;
+        closeFd(&mReadFd);
+        errno = error;
+        record(false, start);
+        return false;
+    }
+    *content = std::string_view(mBuffer, size);
+    record(true, start);
+    return true;
+}
+
+bool SysfsNode::readInt(int64_t *value) {
+    std::string_view content;
+    return read(&content) && ParseSysfsNumber(content, value);
+}
+
+bool SysfsNode::readUint(uint64_t *value) {
+    std::string_view content;
+    return read(&content) && ParseSysfsNumber(content, value);
+}
+
+bool SysfsNode::readString(std::string_view *value) {
+    std::string_view content;
+    if (!read(&content))
+        return false;
+    *value = TrimSysfsValue(content);
+    return true;
+}
+
+bool SysfsNode::write(std::string_view value) {
+    const auto start = now();
+    mStats.writes++;
+
+    const int writeFd = fd(&mWriteFd, O_WRONLY);
+    if (writeFd < 0) {
+        record(false, start);
+        return false;
+    }
+    const ssize_t size = mBackend->write(writeFd, value.data(), value.size());
+    if (size != static_cast<ssize_t>(value.size())) {
+        const int error = size < 0 ? errno : EIO;
+        closeFd(&mWriteFd);
+        mLastWrite.reset();
+        errno = error;
+        record(false, start);
+        return false;
+    }
+    mLastWrite = value;
+    record(true, start);
+    return true;
+}
+
+bool SysfsNode::writeInt(int64_t value) {
+    char text[24];
+    const auto [end, ec] = std::to_chars(text, text + sizeof(text), value);
+    return write(std::string_view(text, end - text));
+}
+
+bool SysfsNode::writeIfChanged(std::string_view value) {
+    if (mLastWrite && *mLastWrite == value) {
+        mStats.skippedWrites++;
+        return true;
+    }
+    return write(value);
+}
+
+bool SysfsNode::writeIntIfChanged(int64_t value) {
+    char text[24];
+    const auto [end, ec] = std::to_chars(text, text + sizeof(text), value);
+    return writeIfChanged(std::string_view(text, end - text));
+}
+
+void SysfsNode::reset() {
+    closeFd(&mReadFd);
+    closeFd(&mWriteFd);
+    mLastWrite.reset();
+}
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
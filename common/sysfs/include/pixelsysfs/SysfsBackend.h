@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_COMMON_SYSFS_SYSFSBACKEND_H
+#define HARDWARE_GOOGLE_PIXEL_COMMON_SYSFS_SYSFSBACKEND_H
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+/**
+ * The file operations a SysfsNode is made of. Failing calls return -1 with
+ * errno set, as the syscalls do. Reads and writes always start at offset 0,
+ * which is what sysfs attributes expect.
+ */
+class SysfsBackend {
+  public:
+    virtual ~SysfsBackend() = default;
+
+    virtual int open(const std::string &path, int flags) = 0;
+    virtual ssize_t read(int fd, char *buffer, size_t size) = 0;
+    virtual ssize_t write(int fd, const char *buffer, size_t size) = 0;
+    virtual void close(int fd) = 0;
+
+    // open/pread/pwrite/close on the real files, shared by the whole process
+    static SysfsBackend *posix();
+};
+
+/**
+ * In-memory files for tests. Nodes read back the content set with
+ * setContent() or last written, and fail with the errno given to setError().
+ * Thread safe.
+ */
+class FakeSysfsBackend : public SysfsBackend {
+  public:
+    void setContent(const std::string &path, const std::string &content);
+    std::string content(const std::string &path);
+    // 0 clears the error
+    void setError(const std::string &path, int error);
+    // Calls made for path so far
+    int opens(const std::string &path);
+    int reads(const std::string &path);
+    int writes(const std::string &path);
+
+    int open(const std::string &path, int flags) override;
+    ssize_t read(int fd, char *buffer, size_t size) override;
+    ssize_t write(int fd, const char *buffer, size_t size) override;
+    void close(int fd) override;
+
+  private:
+    struct File {
+        std::string content;
+        int error = 0;
+        int opens = 0;
+        int reads = 0;
+        int writes = 0;
+    };
+
+    // Caller holds mLock. nullptr for an fd which isn't open.
+    File *fileOf(int fd);
+
+    std::mutex mLock;
+    std::map<std::string, File> mFiles;
+    // Path of each fd, indexed by fd; empty once closed
+    std::vector<std::string> mFds;
+};
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
+
+#endif  // HARDWARE_GOOGLE_PIXEL_COMMON_SYSFS_SYSFSBACKEND_H
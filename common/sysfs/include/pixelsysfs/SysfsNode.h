@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_COMMON_SYSFS_SYSFSNODE_H
+#define HARDWARE_GOOGLE_PIXEL_COMMON_SYSFS_SYSFSNODE_H
+
+#include <pixelsysfs/SysfsBackend.h>
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+/**
+ * One small sysfs attribute which is read or written over and over.
+ *
+ * The fds of the node are opened on first use and kept open; each access is a
+ * single pread()/pwrite() at offset 0 through a fixed buffer, so it costs one
+ * syscall and no allocation. An fd which fails an access is closed and opened
+ * again on the next one, so a node which comes and goes recovers by itself.
+ *
+ * Not thread safe, a node is owned by one thread or used under its owner's
+ * lock.
+ */
+class SysfsNode {
+  public:
+    // sysfs attributes hold at most a page
+    static constexpr size_t kBufferSize = 4096;
+
+    struct Stats {
+        uint64_t reads = 0;
+        uint64_t writes = 0;
+        // writeIfChanged() calls which matched the last write
+        uint64_t skippedWrites = 0;
+        uint64_t errors = 0;
+        // Only kept when the node is instrumented
+        std::chrono::nanoseconds totalLatency{0};
+        std::chrono::nanoseconds maxLatency{0};
+    };
+
+    explicit SysfsNode(std::string path, SysfsBackend *backend = SysfsBackend::posix(),
+                       bool instrumented = false);
+    ~SysfsNode();
+    // Disallow copy and assign, the node owns its fds.
+    SysfsNode(const SysfsNode &) = delete;
+    void operator=(const SysfsNode &) = delete;
+
+    const std::string &path() const { return mPath; }
+
+    /**
+     * Read the whole node. content stays valid until the next read of this
+     * node. On failure errno is left as set by the failing call.
+     */
+    bool read(std::string_view *content);
+    // Read a node holding a single number, surrounding whitespace is ignored
+    bool readInt(int64_t *value);
+    bool readUint(uint64_t *value);
+    // Read the node with surrounding whitespace removed
+    bool readString(std::string_view *value);
+
+    bool write(std::string_view value);
+    bool writeInt(int64_t value);
+    // Skip the write when value is what this node last wrote successfully.
+    // Only for nodes nothing else writes to.
+    bool writeIfChanged(std::string_view value);
+    bool writeIntIfChanged(int64_t value);
+
+    // Close the fds and forget the last written value
+    void reset();
+
+    const Stats &stats() const { return mStats; }
+
+  private:
+    // Return the fd for the access mode, opening it if needed; -1 on failure
+    int fd(int *slot, int flags);
+    void closeFd(int *slot);
+    void record(bool ok, std::chrono::steady_clock::time_point start);
+    std::chrono::steady_clock::time_point now() const;
+
+    const std::string mPath;
+    SysfsBackend *const mBackend;
+    const bool mInstrumented;
+    int mReadFd;
+    int mWriteFd;
+    std::optional<std::string> mLastWrite;
+    Stats mStats;
+    char mBuffer[kBufferSize];
+};
+
+// Number parsing for sysfs content with std::from_chars.
+// Surrounding whitespace is ignored, anything else makes the parse fail.
+bool ParseSysfsNumber(std::string_view text, int64_t *value);
+bool ParseSysfsNumber(std::string_view text, uint64_t *value);
+std::string_view TrimSysfsValue(std::string_view text);
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
+
+#endif  // HARDWARE_GOOGLE_PIXEL_COMMON_SYSFS_SYSFSNODE_H
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+#include <pixelsysfs/SysfsNode.h>
+
+#include <cerrno>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+constexpr char kPath[] = "/sys/fake/node";
+
+TEST(SysfsNodeTest, ReadKeepsFdOpen) {
+    FakeSysfsBackend backend;
+    SysfsNode node(kPath, &backend);
+    int64_t value;
+
+    backend.setContent(kPath, "42\n");
+    ASSERT_TRUE(node.readInt(&value));
+    EXPECT_EQ(42, value);
+    backend.setContent(kPath, " -7 \n");
+    ASSERT_TRUE(node.readInt(&value));
+    EXPECT_EQ(-7, value);
+    EXPECT_EQ(1, backend.opens(kPath));
+    EXPECT_EQ(2, backend.reads(kPath));
+    EXPECT_EQ(2u, node.stats().reads);
+}
+
+TEST(SysfsNodeTest, ParseRejectsTrailingText) {
+    FakeSysfsBackend backend;
+    SysfsNode node(kPath, &backend);
+    uint64_t value;
+    std::string_view text;
+
+    backend.setContent(kPath, "12 mV\n");
+    EXPECT_FALSE(node.readUint(&value));
+    ASSERT_TRUE(node.readString(&text));
+    EXPECT_EQ("12 mV", text);
+    backend.setContent(kPath, "-1\n");
+    EXPECT_FALSE(node.readUint(&value));
+    backend.setContent(kPath, "+18446744073709551615");
+    ASSERT_TRUE(node.readUint(&value));
+    EXPECT_EQ(UINT64_MAX, value);
+}
+
+TEST(SysfsNodeTest, FailedAccessReopens) {
+    FakeSysfsBackend backend;
+    SysfsNode node(kPath, &backend);
+    std::string_view content;
+
+    EXPECT_FALSE(node.read(&content));
+    EXPECT_EQ(ENOENT, errno);
+    backend.setContent(kPath, "1");
+    ASSERT_TRUE(node.read(&content));
+    backend.setError(kPath, EIO);
+    EXPECT_FALSE(node.read(&content));
+    EXPECT_EQ(EIO, errno);
+    backend.setError(kPath, 0);
+    ASSERT_TRUE(node.read(&content));
+    EXPECT_EQ("1", content);
+    // Opened again after the EIO, the missing node was never opened
+    EXPECT_EQ(2, backend.opens(kPath));
+    EXPECT_EQ(2u, node.stats().errors);
+}
+
+TEST(SysfsNodeTest, WriteIfChangedSkipsSameValue) {
+    FakeSysfsBackend backend;
+    SysfsNode node(kPath, &backend);
+
+    backend.setContent(kPath, "");
+    ASSERT_TRUE(node.writeIntIfChanged(5));
+    ASSERT_TRUE(node.writeIntIfChanged(5));
+    EXPECT_EQ(1, backend.writes(kPath));
+    EXPECT_EQ(1u, node.stats().skippedWrites);
+    ASSERT_TRUE(node.writeInt(5));
+    EXPECT_EQ(2, backend.writes(kPath));
+    ASSERT_TRUE(node.writeIfChanged("on"));
+    EXPECT_EQ("on", backend.content(kPath));
+
+    // A failed write forgets the last value
+    backend.setError(kPath, EBUSY);
+    EXPECT_FALSE(node.writeIfChanged("off"));
+    backend.setError(kPath, 0);
+    ASSERT_TRUE(node.writeIfChanged("off"));
+    ASSERT_TRUE(node.writeIfChanged("off"));
+    EXPECT_EQ(2u, node.stats().skippedWrites);
+    node.reset();
+    ASSERT_TRUE(node.writeIfChanged("off"));
+    EXPECT_EQ(6, backend.writes(kPath));
+}
+
+TEST(SysfsNodeTest, InstrumentedNodeKeepsLatency) {
+    FakeSysfsBackend backend;
+    SysfsNode plain(kPath, &backend);
+    SysfsNode instrumented(kPath, &backend, true);
+    std::string_view content;
+
+    backend.setContent(kPath, "1");
+    ASSERT_TRUE(plain.read(&content));
+    ASSERT_TRUE(instrumented.read(&content));
+    EXPECT_EQ(0, plain.stats().totalLatency.count());
+    EXPECT_GT(instrumented.stats().totalLatency.count(), 0);
+    EXPECT_GE(instrumented.stats().totalLatency, instrumented.stats().maxLatency);
+}
+
+TEST(SysfsNodeTest, PosixBackend) {
+    TemporaryFile file;
+    SysfsNode node(file.path);
+    int64_t value;
+
+    ASSERT_TRUE(node.writeInt(123));
+    ASSERT_TRUE(node.readInt(&value));
+    EXPECT_EQ(123, value);
+    std::string content;
+    ASSERT_TRUE(android::base::ReadFileToString(file.path, &content));
+    EXPECT_EQ("123", content);
+}
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <pixelthermalchannel/ThermalChannel.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <thread>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+namespace {
+
+constexpr uint32_t kMagic = 0x54434850;  // "PHCT"
+constexpr uint32_t kVersion = 1;
+
+struct Slot {
+    char name[kThermalChannelNameLength];
+    std::atomic<int32_t> value;
+};
+
+}  // namespace
+
+struct ThermalChannelRegion {
+    uint32_t magic;
+    uint32_t version;
+    // Odd while the writer updates the region
+    std::atomic<uint32_t> sequence;
+    // Readers blocked in wait(), the writer only wakes when there are any
+    std::atomic<uint32_t> waiters;
+    // pid of the attached reader, 0 if none
+    std::atomic<int32_t> consumer;
+    std::atomic<uint32_t> sensorCount;
+    std::atomic<uint32_t> cdevCount;
+    Slot sensors[kThermalChannelMaxSensors];
+    Slot cdevs[kThermalChannelMaxCdevs];
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "the region is shared across processes");
+
+namespace {
+
+ThermalChannelRegion *mapRegion(int fd) {
+    void *addr = mmap(nullptr, sizeof(ThermalChannelRegion), PROT_READ | PROT_WRITE, MAP_SHARED,
+                      fd, 0);
+    close(fd);
+    return addr == MAP_FAILED ? nullptr : static_cast<ThermalChannelRegion *>(addr);
+}
+
+void unmapRegion(ThermalChannelRegion *region) {
+    if (region)
+        munmap(region, sizeof(ThermalChannelRegion));
+}
+
+// Only the writer changes the sequence, so a plain store is enough
+void beginWrite(ThermalChannelRegion *region) {
+    region->sequence.store(region->sequence.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void endWrite(ThermalChannelRegion *region) {
+    region->sequence.store(region->sequence.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_seq_cst);
+    if (region->waiters.load(std::memory_order_seq_cst) > 0) {
+        syscall(SYS_futex, &region->sequence, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+}
+
+void copySlots(const Slot *slots, uint32_t count, ThermalChannelEntry *entries) {
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(entries[i].name, slots[i].name, kThermalChannelNameLength);
+        entries[i].name[kThermalChannelNameLength - 1] = '\0';
+        entries[i].value = slots[i].value.load(std::memory_order_relaxed);
+    }
+}
+
+}  // namespace
+
+ThermalChannelWriter::~ThermalChannelWriter() {
+    unmapRegion(mRegion);
+}
+
+bool ThermalChannelWriter::open(const std::string &path) {
+    const int fd = TEMP_FAILURE_RETRY(::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0660));
+    if (fd < 0)
+        return false;
+    if (ftruncate(fd, sizeof(ThermalChannelRegion)) != 0) {
+        close(fd);
+        return false;
+    }
+    ThermalChannelRegion *region = mapRegion(fd);
+    if (!region)
+        return false;
+
+    if (region->magic != kMagic || region->version != kVersion) {
+        memset(static_cast<void *>(region), 0, sizeof(*region));
+        region->version = kVersion;
+        region->magic = kMagic;
+    } else {
+        // Left by a previous instance, keep the sequence moving so readers see the reset
+        beginWrite(region);
+        region->sensorCount.store(0, std::memory_order_relaxed);
+        region->cdevCount.store(0, std::memory_order_relaxed);
+        endWrite(region);
+    }
+    unmapRegion(mRegion);
+    mRegion = region;
+    mSensorIndex.clear();
+    mCdevIndex.clear();
+    return true;
+}
+
+bool ThermalChannelWriter::set(bool sensor, std::string_view name, int32_t value) {
+    if (!mRegion || name.empty() || name.size() >= kThermalChannelNameLength)
+        return false;
+
+    auto &index = sensor ? mSensorIndex : mCdevIndex;
+    Slot *slots = sensor ? mRegion->sensors : mRegion->cdevs;
+    std::atomic<uint32_t> &count = sensor ? mRegion->sensorCount : mRegion->cdevCount;
+    const size_t capacity = sensor ? kThermalChannelMaxSensors : kThermalChannelMaxCdevs;
+
+    const auto it = index.find(std::string(name));
+    if (it != index.end()) {
+        Slot &slot = slots[it->second];
+        if (slot.value.load(std::memory_order_relaxed) == value)
+            return true;
+        beginWrite(mRegion);
+        slot.value.store(value, std::memory_order_relaxed);
+        endWrite(mRegion);
+        return true;
+    }
+
+    const uint32_t next = count.load(std::memory_order_relaxed);
+    if (next >= capacity)
+        return false;
+    beginWrite(mRegion);
+    memset(slots[next].name, 0, kThermalChannelNameLength);
+    memcpy(slots[next].name, name.data(), name.size());
+    slots[next].value.store(value, std::memory_order_relaxed);
+    count.store(next + 1, std::memory_order_relaxed);
+    endWrite(mRegion);
+    index.emplace(name, next);
+    return true;
+}
+
+bool ThermalChannelWriter::setSensorSeverity(std::string_view sensor, int32_t severity) {
+    return set(true, sensor, severity);
+}
+
+bool ThermalChannelWriter::setCdevState(std::string_view cdev, int32_t state) {
+    return set(false, cdev, state);
+}
+
+bool ThermalChannelWriter::consumerAttached() const {
+    return mRegion && mRegion->consumer.load(std::memory_order_acquire) != 0;
+}
+
+void ThermalChannelWriter::detachConsumer() {
+    if (mRegion)
+        mRegion->consumer.store(0, std::memory_order_release);
+}
+
+uint32_t ThermalChannelWriter::generation() const {
+    return mRegion ? mRegion->sequence.load(std::memory_order_relaxed) : 0;
+}
+
+ThermalChannelReader::~ThermalChannelReader() {
+    unmapRegion(mRegion);
+}
+
+bool ThermalChannelReader::open(const std::string &path) {
+    const int fd = TEMP_FAILURE_RETRY(::open(path.c_str(), O_RDWR | O_CLOEXEC));
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(ThermalChannelRegion))) {
+        close(fd);
+        return false;
+    }
+    ThermalChannelRegion *region = mapRegion(fd);
+    if (!region)
+        return false;
+    if (region->magic != kMagic || region->version != kVersion) {
+        unmapRegion(region);
+        return false;
+    }
+    unmapRegion(mRegion);
+    mRegion = region;
+    return true;
+}
+
+void ThermalChannelReader::attach() {
+    if (mRegion)
+        mRegion->consumer.store(getpid(), std::memory_order_release);
+}
+
+uint32_t ThermalChannelReader::generation() const {
+    return mRegion ? mRegion->sequence.load(std::memory_order_acquire) & ~1u : 0;
+}
+
+void ThermalChannelReader::read(ThermalChannelSnapshot *snapshot) const {
+    if (!mRegion) {
+        *snapshot = {};
+        return;
+    }
+    while (true) {
+        const uint32_t begin = mRegion->sequence.load(std::memory_order_acquire);
+        if (begin & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        snapshot->sensorCount = std::min<uint32_t>(
+                mRegion->sensorCount.load(std::memory_order_relaxed), kThermalChannelMaxSensors);
+        snapshot->cdevCount = std::min<uint32_t>(mRegion->cdevCount.load(std::memory_order_relaxed),
+                                                 kThermalChannelMaxCdevs);
+        copySlots(mRegion->sensors, snapshot->sensorCount, snapshot->sensors);
+        copySlots(mRegion->cdevs, snapshot->cdevCount, snapshot->cdevs);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (mRegion->sequence.load(std::memory_order_relaxed) == begin) {
+            snapshot->generation = begin;
+            return;
+        }
+    }
+}
+
+bool ThermalChannelReader::wait(uint32_t generation, std::chrono::milliseconds timeout) const {
+    if (!mRegion) {
+        std::this_thread::sleep_for(timeout);
+        return false;
+    }
+    const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+    const struct timespec ts = {
+            .tv_sec = static_cast<time_t>(seconds.count()),
+            .tv_nsec = static_cast<long>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(timeout - seconds)
+                            .count()),
+    };
+    mRegion->waiters.fetch_add(1, std::memory_order_seq_cst);
+    // Wait on the exact current value, a writer in progress moves it again when done
+    const uint32_t current = mRegion->sequence.load(std::memory_order_seq_cst);
+    if ((current & ~1u) == generation) {
+        syscall(SYS_futex, &mRegion->sequence, FUTEX_WAIT, current, &ts, nullptr, 0);
+    }
+    mRegion->waiters.fetch_sub(1, std::memory_order_seq_cst);
+    return this->generation() != generation;
+}
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_COMMON_THERMAL_CHANNEL_THERMALCHANNEL_H
+#define HARDWARE_GOOGLE_PIXEL_COMMON_THERMAL_CHANNEL_THERMALCHANNEL_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+/*
+ * Shared memory channel from the thermal HAL to the power HAL.
+ *
+ * The thermal HAL publishes the power hint severity of each sensor and the
+ * requested state of each cooling device into a file backed region both HALs
+ * map. The power HAL waits on the region with a futex and applies the changes
+ * itself, so a throttling change costs no binder transaction.
+ *
+ * The region is a seqlock: the single writer makes the sequence odd while it
+ * updates, readers retry until they copied the entries under one even value.
+ */
+
+constexpr size_t kThermalChannelNameLength = 32;
+constexpr size_t kThermalChannelMaxSensors = 32;
+constexpr size_t kThermalChannelMaxCdevs = 64;
+
+// Names of the ThrottlingSeverity values, indexed by value
+constexpr const char *kThermalChannelSeverityNames[] = {
+        "NONE", "LIGHT", "MODERATE", "SEVERE", "CRITICAL", "EMERGENCY", "SHUTDOWN",
+};
+constexpr int32_t kThermalChannelSeverityCount =
+        sizeof(kThermalChannelSeverityNames) / sizeof(kThermalChannelSeverityNames[0]);
+
+struct ThermalChannelEntry {
+    char name[kThermalChannelNameLength];
+    int32_t value;
+};
+
+struct ThermalChannelSnapshot {
+    uint32_t generation = 0;
+    uint32_t sensorCount = 0;
+    uint32_t cdevCount = 0;
+    ThermalChannelEntry sensors[kThermalChannelMaxSensors];
+    ThermalChannelEntry cdevs[kThermalChannelMaxCdevs];
+};
+
+// Layout of the mapped file, shared by both HALs
+struct ThermalChannelRegion;
+
+class ThermalChannelWriter {
+  public:
+    ThermalChannelWriter() = default;
+    ~ThermalChannelWriter();
+    ThermalChannelWriter(const ThermalChannelWriter &) = delete;
+    void operator=(const ThermalChannelWriter &) = delete;
+
+    // Create or reuse the region at path and drop any entries left by a previous writer
+    bool open(const std::string &path);
+    bool isOpen() const { return mRegion != nullptr; }
+
+    // Publish a value, nothing happens when it didn't change. Fails when the region is
+    // full or not open.
+    bool setSensorSeverity(std::string_view sensor, int32_t severity);
+    bool setCdevState(std::string_view cdev, int32_t state);
+
+    // Whether a reader attached itself and applies the sensor severities
+    bool consumerAttached() const;
+    // Called when the reader is known to be gone
+    void detachConsumer();
+
+    uint32_t generation() const;
+
+  private:
+    bool set(bool sensor, std::string_view name, int32_t value);
+
+    ThermalChannelRegion *mRegion = nullptr;
+    // Entry index of each published name
+    std::unordered_map<std::string, size_t> mSensorIndex;
+    std::unordered_map<std::string, size_t> mCdevIndex;
+};
+
+class ThermalChannelReader {
+  public:
+    ThermalChannelReader() = default;
+    ~ThermalChannelReader();
+    ThermalChannelReader(const ThermalChannelReader &) = delete;
+    void operator=(const ThermalChannelReader &) = delete;
+
+    // Map an existing region, fails until the writer created it
+    bool open(const std::string &path);
+    bool isOpen() const { return mRegion != nullptr; }
+
+    // Tell the writer this reader applies the sensor severities from now on
+    void attach();
+
+    // Sequence of the last completed update; it changes with every update
+    uint32_t generation() const;
+    // Copy a consistent view of the region
+    void read(ThermalChannelSnapshot *snapshot) const;
+    // Block until the generation moves away from generation or timeout passes.
+    // Return whether it moved.
+    bool wait(uint32_t generation, std::chrono::milliseconds timeout) const;
+
+  private:
+    ThermalChannelRegion *mRegion = nullptr;
+};
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
+
+#endif  // HARDWARE_GOOGLE_PIXEL_COMMON_THERMAL_CHANNEL_THERMALCHANNEL_H
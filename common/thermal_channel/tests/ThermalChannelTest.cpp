@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+#include <pixelthermalchannel/ThermalChannel.h>
+
+#include <string>
+#include <thread>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+using std::literals::chrono_literals::operator""ms;
+
+class ThermalChannelTest : public ::testing::Test {
+  protected:
+    void SetUp() override { mPath = std::string(mDir.path) + "/channel"; }
+
+    TemporaryDir mDir;
+    std::string mPath;
+};
+
+TEST_F(ThermalChannelTest, ReaderNeedsWriter) {
+    ThermalChannelReader reader;
+    EXPECT_FALSE(reader.open(mPath));
+    ThermalChannelWriter writer;
+    ASSERT_TRUE(writer.open(mPath));
+    EXPECT_TRUE(reader.open(mPath));
+}
+
+TEST_F(ThermalChannelTest, PublishSensorsAndCdevs) {
+    ThermalChannelWriter writer;
+    ThermalChannelReader reader;
+    ThermalChannelSnapshot snapshot;
+    ASSERT_TRUE(writer.open(mPath));
+    ASSERT_TRUE(reader.open(mPath));
+
+    const uint32_t start = reader.generation();
+    ASSERT_TRUE(writer.setSensorSeverity("VIRTUAL-SKIN", 2));
+    ASSERT_TRUE(writer.setCdevState("fan", 3));
+    ASSERT_TRUE(writer.setSensorSeverity("VIRTUAL-SKIN", 4));
+    reader.read(&snapshot);
+    EXPECT_NE(start, snapshot.generation);
+    ASSERT_EQ(1u, snapshot.sensorCount);
+    EXPECT_STREQ("VIRTUAL-SKIN", snapshot.sensors[0].name);
+    EXPECT_EQ(4, snapshot.sensors[0].value);
+    ASSERT_EQ(1u, snapshot.cdevCount);
+    EXPECT_STREQ("fan", snapshot.cdevs[0].name);
+    EXPECT_EQ(3, snapshot.cdevs[0].value);
+
+    // Publishing the same value isn't an update
+    ASSERT_TRUE(writer.setCdevState("fan", 3));
+    EXPECT_EQ(snapshot.generation, reader.generation());
+
+    EXPECT_FALSE(writer.setSensorSeverity(std::string(kThermalChannelNameLength, 'a'), 1));
+}
+
+TEST_F(ThermalChannelTest, RestartedWriterDropsEntries) {
+    ThermalChannelReader reader;
+    ThermalChannelSnapshot snapshot;
+    {
+        ThermalChannelWriter writer;
+        ASSERT_TRUE(writer.open(mPath));
+        ASSERT_TRUE(reader.open(mPath));
+        ASSERT_TRUE(writer.setSensorSeverity("soc", 1));
+        reader.attach();
+        EXPECT_TRUE(writer.consumerAttached());
+    }
+    const uint32_t before = reader.generation();
+    ThermalChannelWriter writer;
+    ASSERT_TRUE(writer.open(mPath));
+    reader.read(&snapshot);
+    EXPECT_NE(before, snapshot.generation);
+    EXPECT_EQ(0u, snapshot.sensorCount);
+    // The reader outlived the writer, it stays attached
+    EXPECT_TRUE(writer.consumerAttached());
+    writer.detachConsumer();
+    EXPECT_FALSE(writer.consumerAttached());
+}
+
+TEST_F(ThermalChannelTest, WaitWakesOnUpdate) {
+    ThermalChannelWriter writer;
+    ThermalChannelReader reader;
+    ASSERT_TRUE(writer.open(mPath));
+    ASSERT_TRUE(reader.open(mPath));
+
+    const uint32_t generation = reader.generation();
+    EXPECT_FALSE(reader.wait(generation, 1ms));
+    std::thread publisher([&writer] {
+        std::this_thread::sleep_for(10ms);
+        writer.setSensorSeverity("battery", 1);
+    });
+    EXPECT_TRUE(reader.wait(generation, 10000ms));
+    publisher.join();
+}
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
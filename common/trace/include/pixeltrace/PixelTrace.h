@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_COMMON_TRACE_PIXELTRACE_H
+#define HARDWARE_GOOGLE_PIXEL_COMMON_TRACE_PIXELTRACE_H
+
+#include <cutils/trace.h>
+
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+
+/*
+ * Trace sections and counters whose names are built at runtime, e.g. from a
+ * sensor or node name. With tracing off each one costs the tag check and
+ * nothing else; with tracing on the name is formatted into a stack buffer,
+ * never the heap. The tag is the ATRACE_TAG of the translation unit, as for
+ * the ATRACE_* macros.
+ *
+ *   PIXEL_TRACE_NAME_F("ThermalHelper::readThermalSensor - %s", name);
+ *   PIXEL_TRACE_INT_F(value, "%s-cached", name);
+ */
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+// Longer names are truncated
+constexpr size_t kPixelTraceMaxNameLength = 128;
+
+class PixelScopedTrace {
+  public:
+    __attribute__((format(printf, 3, 4))) PixelScopedTrace(uint64_t tag, const char *format, ...)
+        : mTag(tag), mActive(atrace_is_tag_enabled(tag)) {
+        if (!mActive)
+            return;
+        char name[kPixelTraceMaxNameLength];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(name, sizeof(name), format, args);
+        va_end(args);
+        atrace_begin(mTag, name);
+    }
+    ~PixelScopedTrace() {
+        if (mActive)
+            atrace_end(mTag);
+    }
+    PixelScopedTrace(const PixelScopedTrace &) = delete;
+    void operator=(const PixelScopedTrace &) = delete;
+
+  private:
+    const uint64_t mTag;
+    const bool mActive;
+};
+
+// Callers check the tag first, so the arguments aren't even evaluated when off
+inline void PixelTraceInt64(uint64_t tag, int64_t value, const char *format, ...)
+        __attribute__((format(printf, 3, 4)));
+inline void PixelTraceInt64(uint64_t tag, int64_t value, const char *format, ...) {
+    char name[kPixelTraceMaxNameLength];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(name, sizeof(name), format, args);
+    va_end(args);
+    atrace_int64(tag, name, value);
+}
+
+// For sections which end somewhere else, the caller pairs it with ATRACE_END()
+inline void PixelTraceBegin(uint64_t tag, const char *format, ...)
+        __attribute__((format(printf, 2, 3)));
+inline void PixelTraceBegin(uint64_t tag, const char *format, ...) {
+    char name[kPixelTraceMaxNameLength];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(name, sizeof(name), format, args);
+    va_end(args);
+    atrace_begin(tag, name);
+}
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
+
+#define PIXEL_TRACE_CONCAT_(a, b) a##b
+#define PIXEL_TRACE_CONCAT(a, b) PIXEL_TRACE_CONCAT_(a, b)
+
+// Trace the rest of the scope as a section named by the printf format
+#define PIXEL_TRACE_NAME_F(...)                                                         \
+    ::android::hardware::google::pixel::PixelScopedTrace PIXEL_TRACE_CONCAT(pixelTrace, \
+                                                                            __LINE__)( \
+            ATRACE_TAG, __VA_ARGS__)
+
+// Begin a section named by the printf format, the caller checks the tag first
+#define PIXEL_TRACE_BEGIN_F(...) \
+    ::android::hardware::google::pixel::PixelTraceBegin(ATRACE_TAG, __VA_ARGS__)
+
+// Set the counter named by the printf format
+#define PIXEL_TRACE_INT_F(value, ...)                                                            \
+    do {                                                                                         \
+        if (atrace_is_tag_enabled(ATRACE_TAG))                                                   \
+            ::android::hardware::google::pixel::PixelTraceInt64(ATRACE_TAG, (value), __VA_ARGS__); \
+    } while (0)
+
+#endif  // HARDWARE_GOOGLE_PIXEL_COMMON_TRACE_PIXELTRACE_H
@@ -22,6 +22,10 @@
 #include <dlfcn.h>
 #include <endian.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <map>
 #include <string>
 #include <unordered_map>
@@ -50,6 +54,10 @@ constexpr int DISPLAY_BRIGHTNESS_DIM_THRESHOLD = 20;
 using OEMCommandHandler =
         std::function<ScopedAStatus(const std::vector<std::string> &, std::string *)>;
 
+// Set by "oem eraseskipempty 1": doOemSpecificErase() leaves volumes that
+// hold no filesystem untouched.
+static std::atomic<bool> erase_skip_empty{false};
+
 ScopedAStatus Fastboot::getPartitionType(const std::string &in_partitionName,
                                          FileSystemType *_aidl_return) {
     if (in_partitionName.empty()) {
@@ -126,9 +134,22 @@ ScopedAStatus SetBrightnessLevel(const std::vector<std::string> &args, std::stri
                                                               message.c_str());
 }
 
+ScopedAStatus SetEraseSkipEmpty(const std::vector<std::string> &args,
+                                std::string *_aidl_return) {
+    if (args.size() != 1 || (args[0] != "0" && args[0] != "1")) {
+        return ScopedAStatus::fromExceptionCodeWithMessage(EX_ILLEGAL_ARGUMENT,
+                                                           "Usage: eraseskipempty <0|1>");
+    }
+
+    erase_skip_empty = args[0] == "1";
+    *_aidl_return = "";
+    return ScopedAStatus::ok();
+}
+
 ScopedAStatus Fastboot::doOemCommand(const std::string &in_oemCmd, std::string *_aidl_return) {
     const std::unordered_map<std::string, OEMCommandHandler> kOEMCmdMap = {
             {FB_OEM_SET_BRIGHTNESS, SetBrightnessLevel},
+            {FB_OEM_ERASE_SKIP_EMPTY, SetEraseSkipEmpty},
     };
 
     auto args = ::android::base::Split(in_oemCmd, " ");
@@ -167,6 +188,18 @@ std::map<enum WipeVolumeStatus, std::string> wipe_vol_ret_msg{
         {VOL_BLK_DEV_OPEN, "Fail to open block device"},
         {WIPE_ERROR_MAX, "Unknown wipe error"}};
 
+// A volume is empty when the start of the block device, where ext4 and f2fs
+// keep their superblocks, reads back as zeros: a wiped device reads that way.
+static bool is_volume_empty(int fd) {
+    constexpr size_t kSuperblockArea = 8192;
+    std::vector<char> buf(kSuperblockArea);
+
+    if (!::android::base::ReadFullyAtOffset(fd, buf.data(), buf.size(), 0)) {
+        return false;
+    }
+    return std::all_of(buf.begin(), buf.end(), [](char c) { return c == 0; });
+}
+
 enum WipeVolumeStatus wipe_volume(const std::string &volume) {
     if (!::android::fs_mgr::ReadDefaultFstab(&fstab)) {
         return VOL_FSTAB;
@@ -179,11 +212,19 @@ enum WipeVolumeStatus wipe_volume(const std::string &volume) {
         return VOL_MOUNTED;
     }
 
-    int fd = open(v->blk_device.c_str(), O_WRONLY | O_CREAT, 0644);
+    int fd = open(v->blk_device.c_str(), O_RDWR | O_CREAT, 0644);
     if (fd == -1) {
         return VOL_BLK_DEV_OPEN;
     }
-    wipe_block_device(fd, get_block_device_size(fd));
+    if (erase_skip_empty && is_volume_empty(fd)) {
+        LOG(INFO) << "Skipping wipe of empty volume " << volume;
+        close(fd);
+        return WIPE_OK;
+    }
+    // Discards the device (secure discard when supported); no zeros are written.
+    if (wipe_block_device(fd, get_block_device_size(fd))) {
+        LOG(WARNING) << "Discard failed on " << v->blk_device;
+    }
     close(fd);
 
     return WIPE_OK;
@@ -211,12 +252,29 @@ bool WipeDigitalCarKeys(void) {
     return (*WipeKeysFunc)(nullptr);
 }
 
+// Runs step and logs how long it took.
+template <typename F>
+static auto timed_erase_step(const char *name, F step) {
+    auto start = std::chrono::steady_clock::now();
+    auto result = step();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start);
+
+    LOG(INFO) << "OEM erase: " << name << " done in " << elapsed.count() << " ms";
+    return result;
+}
+
 ScopedAStatus Fastboot::doOemSpecificErase() {
     // Erase metadata partition along with userdata partition.
     // Keep erasing Titan M even if failing on this case.
-    auto wipe_status = wipe_volume("/metadata");
-
-    bool dck_wipe_success = WipeDigitalCarKeys();
+    // The metadata, DCK and Titan M wipes touch different hardware, so the
+    // first two run in the background while Titan M is wiped here.
+    auto wipe_future = std::async(std::launch::async, [] {
+        return timed_erase_step("metadata", [] { return wipe_volume("/metadata"); });
+    });
+    auto dck_future = std::async(std::launch::async, [] {
+        return timed_erase_step("DCK", [] { return WipeDigitalCarKeys(); });
+    });
 
     // Connect to Titan M
     ::nos::NuggetClient client;
@@ -231,12 +289,19 @@ ScopedAStatus Fastboot::doOemSpecificErase() {
     std::vector<uint8_t> magic(sizeof(magicValue));
     memcpy(magic.data(), &magicValue, sizeof(magicValue));
     const uint8_t retry_count = 5;
-    uint32_t nugget_status;
-    for (uint8_t i = 0; i < retry_count; i++) {
-        nugget_status = client.CallApp(APP_ID_NUGGET, NUGGET_PARAM_NUKE_FROM_ORBIT, magic, nullptr);
-        if (nugget_status == APP_SUCCESS && wipe_status == WIPE_OK) {
-            return ScopedAStatus::ok();
+    uint32_t nugget_status = timed_erase_step("Titan M", [&] {
+        uint32_t status =
+                client.CallApp(APP_ID_NUGGET, NUGGET_PARAM_NUKE_FROM_ORBIT, magic, nullptr);
+        for (uint8_t i = 1; i < retry_count && status != APP_SUCCESS; i++) {
+            status = client.CallApp(APP_ID_NUGGET, NUGGET_PARAM_NUKE_FROM_ORBIT, magic, nullptr);
         }
+        return status;
+    });
+
+    auto wipe_status = wipe_future.get();
+    bool dck_wipe_success = dck_future.get();
+    if (nugget_status == APP_SUCCESS && wipe_status == WIPE_OK) {
+        return ScopedAStatus::ok();
     }
 
     // Return exactly what happened
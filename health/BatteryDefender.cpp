@@ -23,11 +23,13 @@
 #include <android-base/properties.h>
 #include <cutils/klog.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <pixelhealth/BatteryDefender.h>
 #include <pixelhealth/HealthHelper.h>
 #include <stdio.h>
 #include <sys/types.h>
 #include <time.h>
+#include <unistd.h>
 #include <utils/Timers.h>
 
 #include <unordered_map>
@@ -44,17 +46,25 @@ BatteryDefender::BatteryDefender(const std::string pathWirelessPresent,
                                  const std::string pathChargeLevelStart,
                                  const std::string pathChargeLevelStop,
                                  const int32_t timeToActivateSecs,
-                                 const int32_t timeToClearTimerSecs, const bool useTypeC)
+                                 const int32_t timeToClearTimerSecs, const bool useTypeC,
+                                 const std::string pathUSBChargerPresent,
+                                 const std::string pathDockChargerPresent)
 
-    : mPathWirelessPresent(pathWirelessPresent),
+    : mWirelessPresent(pathWirelessPresent),
       kPathChargeLevelStart(pathChargeLevelStart),
       kPathChargeLevelStop(pathChargeLevelStop),
       kTimeToActivateSecs(timeToActivateSecs),
       kTimeToClearTimerSecs(timeToClearTimerSecs),
-      kUseTypeC(useTypeC) {
+      kUseTypeC(useTypeC),
+      mUSBChargerPresent(pathUSBChargerPresent),
+      mDockChargerPresent(pathDockChargerPresent) {
     mTimePreviousSecs = getTime();
 }
 
+BatteryDefender::~BatteryDefender() {
+    flushPersistentTimers();
+}
+
 void BatteryDefender::clearStateData(void) {
     mHasReachedHighCapacityLevel = false;
     mTimeActiveSecs = 0;
@@ -63,7 +73,16 @@ void BatteryDefender::clearStateData(void) {
 }
 
 void BatteryDefender::setWirelessNotSupported(void) {
-    mPathWirelessPresent = PATH_NOT_SUPPORTED;
+    mWirelessPresent.path = PATH_NOT_SUPPORTED;
+    mWirelessPresent.fd.reset();
+}
+
+void BatteryDefender::flushPersistentTimers(void) {
+    // Nothing was loaded to write back yet
+    if (mCurrentState == STATE_INIT) {
+        return;
+    }
+    writePersistentTimers(true);
 }
 
 void BatteryDefender::loadPersistentStorage(void) {
@@ -112,6 +131,43 @@ int BatteryDefender::readFileToInt(const std::string &path, const bool silent) {
     return value;
 }
 
+int BatteryDefender::readPresenceNode(PresenceNode *node, const bool silent) {
+    int value = 0;  // default
+
+    if (node->path == PATH_NOT_SUPPORTED) {
+        return value;
+    }
+
+    if (!node->fd.ok()) {
+        node->fd.reset(TEMP_FAILURE_RETRY(open(node->path.c_str(), O_RDONLY | O_CLOEXEC)));
+        if (!node->fd.ok()) {
+            if (silent == false) {
+                PLOG(ERROR) << "Failed to open " << node->path;
+            }
+            return value;
+        }
+    }
+
+    char buffer[32];
+    const ssize_t size = TEMP_FAILURE_RETRY(pread(node->fd.get(), buffer, sizeof(buffer) - 1, 0));
+    if (size < 0) {
+        if (silent == false) {
+            PLOG(ERROR) << "Failed to read " << node->path;
+        }
+        // The node may have gone with its driver; open it again on the next update
+        node->fd.reset();
+        return value;
+    }
+
+    std::string contents(buffer, size);
+    removeLineEndings(&contents);
+    if (!android::base::ParseInt(contents, &value)) {
+        LOG(ERROR) << "Failed to parse " << node->path;
+    }
+
+    return value;
+}
+
 bool BatteryDefender::writeIntToFile(const std::string &path, const int value) {
     bool success = android::base::WriteStringToFile(std::to_string(value), path);
     if (!success) {
@@ -121,17 +177,25 @@ bool BatteryDefender::writeIntToFile(const std::string &path, const int value) {
     return success;
 }
 
-void BatteryDefender::writeTimeToFile(const std::string &path, const int value, int64_t *previous) {
-    // Some number of seconds delay before repeated writes
+void BatteryDefender::writeTimeToFile(const std::string &path, const int value, int64_t *previous,
+                                      const bool force) {
+    // Some number of seconds delay before repeated writes, to spare the flash
     const bool hasTimeChangedSignificantly =
-            ((value == 0) || (*previous == -1) || (value > (*previous + kWriteDelaySecs)) ||
-             (value < (*previous - kWriteDelaySecs)));
+            (force || (value == 0) || (*previous == -1) ||
+             (value > (*previous + kWriteDelaySecs)) || (value < (*previous - kWriteDelaySecs)));
     if ((value != *previous) && hasTimeChangedSignificantly) {
         writeIntToFile(path, value);
         *previous = value;
     }
 }
 
+void BatteryDefender::writePersistentTimers(const bool force) {
+    writeTimeToFile(kPathPersistChargerPresentTime, mTimeChargerPresentSecs,
+                    &mTimeChargerPresentSecsPrevious, force);
+    writeTimeToFile(kPathPersistDefenderActiveTime, mTimeActiveSecs, &mTimeActiveSecsPrevious,
+                    force);
+}
+
 void BatteryDefender::writeChargeLevelsToFile(const int vendorStart, const int vendorStop) {
     int chargeLevelStart = vendorStart;
     int chargeLevelStop = vendorStop;
@@ -178,10 +242,13 @@ bool BatteryDefender::isTypeCSink(const std::string &path) {
     return (buffer.find("[sink]") != std::string::npos);
 }
 
-bool BatteryDefender::isWiredPresent(void) {
+bool BatteryDefender::isWiredPresent(const PowerSupplyUevent *usb) {
     // Default to USB "present" if type C is not used.
     if (!kUseTypeC) {
-        return readFileToInt(kPathUSBChargerPresent) != 0;
+        if (usb && usb->has(PowerSupplyUevent::PRESENT)) {
+            return usb->get(PowerSupplyUevent::PRESENT) != 0;
+        }
+        return readPresenceNode(&mUSBChargerPresent) != 0;
     }
 
     DIR *dp = opendir(kTypeCPath.c_str());
@@ -210,13 +277,13 @@ bool BatteryDefender::isWiredPresent(void) {
 }
 
 bool BatteryDefender::isDockPresent(void) {
-    return readFileToInt(kPathDOCKChargerPresent, true) != 0;
+    return readPresenceNode(&mDockChargerPresent, true) != 0;
 }
 
-bool BatteryDefender::isChargePowerAvailable(void) {
+bool BatteryDefender::isChargePowerAvailable(const PowerSupplyUevent *usb) {
     // USB presence is an indicator of power availability
-    const bool chargerPresentWired = isWiredPresent();
-    const bool chargerPresentWireless = readFileToInt(mPathWirelessPresent) != 0;
+    const bool chargerPresentWired = isWiredPresent(usb);
+    const bool chargerPresentWireless = readPresenceNode(&mWirelessPresent) != 0;
     const bool chargerPresentDock = isDockPresent();
     mIsWiredPresent = chargerPresentWired;
     mIsWirelessPresent = chargerPresentWireless;
@@ -458,6 +525,14 @@ void BatteryDefender::updateDefenderProperties(
 }
 
 void BatteryDefender::update(HealthInfo *health_info) {
+    updateWith(health_info, nullptr);
+}
+
+void BatteryDefender::update(HealthInfo *health_info, const PowerSupplyUevent &usb) {
+    updateWith(health_info, &usb);
+}
+
+void BatteryDefender::updateWith(HealthInfo *health_info, const PowerSupplyUevent *usb) {
     if (!health_info) {
         return;
     }
@@ -468,14 +543,15 @@ void BatteryDefender::update(HealthInfo *health_info) {
     const int chargeLevelVendorStop =
             android::base::GetIntProperty(kPropChargeLevelVendorStop, kChargeLevelDefaultStop);
     mIsDefenderDisabled = isBatteryDefenderDisabled(chargeLevelVendorStart, chargeLevelVendorStop);
-    mIsPowerAvailable = isChargePowerAvailable();
+    mIsPowerAvailable = isChargePowerAvailable(usb);
     mTimeBetweenUpdateCalls = getDeltaTimeSeconds(&mTimePreviousSecs);
     mIsDockDefendTrigger = isDockDefendTrigger();
 
     // Run state machine
     stateMachine_runAction(mCurrentState, *health_info);
     const state_E nextState = stateMachine_getNextState(mCurrentState);
-    if (nextState != mCurrentState) {
+    const bool isStateChanged = nextState != mCurrentState;
+    if (isStateChanged) {
         stateMachine_firstAction(nextState);
     }
     mCurrentState = nextState;
@@ -483,10 +559,8 @@ void BatteryDefender::update(HealthInfo *health_info) {
     // Verify/update battery defender battery properties
     updateDefenderProperties(health_info); /* May override battery properties */
 
-    // Store outputs
-    writeTimeToFile(kPathPersistChargerPresentTime, mTimeChargerPresentSecs,
-                    &mTimeChargerPresentSecsPrevious);
-    writeTimeToFile(kPathPersistDefenderActiveTime, mTimeActiveSecs, &mTimeActiveSecsPrevious);
+    // Store outputs; the timers as they stand at every state transition
+    writePersistentTimers(isStateChanged);
     writeChargeLevelsToFile(chargeLevelVendorStart, chargeLevelVendorStop);
     android::base::SetProperty(kPropBatteryDefenderState, kStateStringMap[mCurrentState]);
 }
@@ -15,9 +15,12 @@
  * limitations under the License.
  */
 
+#include <android-base/parseint.h>
+#include <fcntl.h>
 #include <pixelhealth/BatteryMetricsLogger.h>
 #include <pixelhealth/HealthHelper.h>
 #include <pixelhealth/StatsHelper.h>
+#include <unistd.h>
 
 namespace hardware {
 namespace google {
@@ -44,10 +47,60 @@ BatteryMetricsLogger::BatteryMetricsLogger(const char *const batt_res, const cha
     memset(max_, 0, sizeof(max_));
 }
 
+void BatteryMetricsLogger::FieldStats::add(int32_t value) {
+    count++;
+    sum += value;
+    median.add(value);
+    p90.add(value);
+}
+
+void BatteryMetricsLogger::FieldStats::clear() {
+    count = 0;
+    sum = 0;
+    median.clear();
+    p90.clear();
+}
+
+std::string BatteryMetricsLogger::FieldStats::toString() const {
+    if (count == 0) {
+        return "none";
+    }
+    return "avg " + std::to_string(sum / count) + " median " +
+           std::to_string(lround(median.get())) + " p90 " + std::to_string(lround(p90.get()));
+}
+
 int64_t BatteryMetricsLogger::getTime(void) {
     return nanoseconds_to_seconds(systemTime(SYSTEM_TIME_BOOTTIME));
 }
 
+// Reads an integer from a sysfs node, opened on the first read and kept open
+bool BatteryMetricsLogger::readSysfsInt(const char *path, android::base::unique_fd *fd,
+                                        int32_t *value) {
+    if (!fd->ok()) {
+        fd->reset(TEMP_FAILURE_RETRY(open(path, O_RDONLY | O_CLOEXEC)));
+        if (!fd->ok()) {
+            PLOG(ERROR) << "Can't open " << path;
+            return false;
+        }
+    }
+
+    char buffer[32];
+    const ssize_t size = TEMP_FAILURE_RETRY(pread(fd->get(), buffer, sizeof(buffer) - 1, 0));
+    if (size < 0) {
+        PLOG(ERROR) << "Can't read " << path;
+        fd->reset();
+        return false;
+    }
+    buffer[size] = '\0';
+
+    const std::string contents = android::base::Trim(buffer);
+    if (!android::base::ParseInt(contents, value)) {
+        LOG(ERROR) << "Can't parse " << contents << " from " << path;
+        return false;
+    }
+    return true;
+}
+
 bool BatteryMetricsLogger::uploadOutlierMetric(const std::shared_ptr<IStats> &stats_client,
                                                sampleType type) {
     if (kStatsSnapshotType[type] < 0)
@@ -66,7 +119,14 @@ bool BatteryMetricsLogger::uploadOutlierMetric(const std::shared_ptr<IStats> &st
 bool BatteryMetricsLogger::uploadAverageBatteryResistance(
         const std::shared_ptr<IStats> &stats_client) {
     if (strlen(kBatteryAvgResistance) == 0) {
-        LOG(INFO) << "Sysfs path for average battery resistance not specified";
+        if (res_stats_.count == 0) {
+            LOG(INFO) << "Sysfs path for average battery resistance not specified";
+            return true;
+        }
+        // Fall back to the average of the resistance samples
+        reportBatteryHealthSnapshot(
+                stats_client, VendorBatteryHealthSnapshot::BATTERY_SNAPSHOT_TYPE_AVG_RESISTANCE,
+                0, 0, 0, 0, res_stats_.sum / res_stats_.count, 0);
         return true;
     }
 
@@ -119,6 +179,7 @@ bool BatteryMetricsLogger::uploadMetrics(void) {
         // Upload min/max metrics
         uploadOutlierMetric(stats_client, static_cast<sampleType>(metric));
     }
+    LOG(INFO) << "res " << res_stats_.toString() << ", ocv " << ocv_stats_.toString();
 
     uploadAverageBatteryResistance(stats_client);
 
@@ -127,32 +188,30 @@ bool BatteryMetricsLogger::uploadMetrics(void) {
     memset(max_, 0, sizeof(max_));
     num_samples_ = 0;
     num_res_samples_ = 0;
+    res_stats_.clear();
+    ocv_stats_.clear();
     last_upload_ = time;
     LOG(INFO) << "Finished uploading to tron";
     return true;
 }
 
 bool BatteryMetricsLogger::recordSample(const HealthInfo &health_info) {
-    std::string resistance_str, ocv_str;
     int32_t resistance, ocv;
     int32_t time = getTime();
+    const bool charging = health_info.batteryStatus == BatteryStatus::CHARGING;
 
     LOG(INFO) << "Recording a sample at time " << std::to_string(time);
 
-    if (!android::base::ReadFileToString(kBatteryResistance, &resistance_str)) {
-        LOG(ERROR) << "Can't read the battery resistance from " << kBatteryResistance;
-        resistance = -INT_MAX;
-    } else if (!(std::stringstream(resistance_str) >> resistance)) {
-        LOG(ERROR) << "Can't parse battery resistance value " << resistance_str;
+    if (!readSysfsInt(kBatteryResistance, &res_fd_, &resistance)) {
         resistance = -INT_MAX;
+    } else if (!charging) {
+        res_stats_.add(resistance);
     }
 
-    if (!android::base::ReadFileToString(kBatteryOCV, &ocv_str)) {
-        LOG(ERROR) << "Can't read open-circuit voltage (ocv) value from " << kBatteryOCV;
-        ocv = -INT_MAX;
-    } else if (!(std::stringstream(ocv_str) >> ocv)) {
-        LOG(ERROR) << "Can't parse open-circuit voltage (ocv) value " << ocv_str;
+    if (!readSysfsInt(kBatteryOCV, &ocv_fd_, &ocv)) {
         ocv = -INT_MAX;
+    } else {
+        ocv_stats_.add(ocv);
     }
 
     int32_t sample[NUM_FIELDS] = {[TIME] = time,
@@ -162,23 +221,23 @@ bool BatteryMetricsLogger::recordSample(const HealthInfo &health_info) {
                                   [TEMP] = health_info.batteryTemperatureTenthsCelsius,
                                   [SOC] = health_info.batteryLevel,
                                   [OCV] = ocv};
-    if (health_info.batteryStatus != BatteryStatus::CHARGING) {
+    if (!charging) {
         num_res_samples_++;
     }
 
     // Only calculate the min and max for metric types we want to upload
     for (int metric = 0; metric < NUM_FIELDS; metric++) {
         // Discard resistance min/max when charging
-        if ((metric == RES && health_info.batteryStatus == BatteryStatus::CHARGING) ||
-            kStatsSnapshotType[metric] < 0)
+        if ((metric == RES && charging) || kStatsSnapshotType[metric] < 0)
             continue;
-        if (num_samples_ == 0 || (metric == RES && num_res_samples_ == 0) ||
+        // The first resistance sample may follow charging ones
+        if (num_samples_ == 0 || (metric == RES && num_res_samples_ == 1) ||
             sample[metric] < min_[metric][metric]) {
             for (int i = 0; i < NUM_FIELDS; i++) {  // update new min with current sample
                 min_[metric][i] = sample[i];
             }
         }
-        if (num_samples_ == 0 || (metric == RES && num_res_samples_ == 0) ||
+        if (num_samples_ == 0 || (metric == RES && num_res_samples_ == 1) ||
             sample[metric] > max_[metric][metric]) {
             for (int i = 0; i < NUM_FIELDS; i++) {  // update new max with current sample
                 max_[metric][i] = sample[i];
@@ -16,6 +16,9 @@
 
 #include "pixelhealth/BatteryThermalControl.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+
 using aidl::android::hardware::health::BatteryStatus;
 using aidl::android::hardware::health::HealthInfo;
 
@@ -28,20 +31,45 @@ using android::base::GetIntProperty;
 
 BatteryThermalControl::BatteryThermalControl(const std::string &path) : mThermalSocMode(path) {
     mStatus = true;
+    mFailed = false;
+    mFailedEnable = false;
 }
 
+bool BatteryThermalControl::writeThermalMode(bool isEnable) {
+    const std::string action = (isEnable) ? "enabled" : "disabled";
+
+    if (!mThermalSocModeFd.ok()) {
+        mThermalSocModeFd.reset(
+                TEMP_FAILURE_RETRY(open(mThermalSocMode.c_str(), O_WRONLY | O_CLOEXEC)));
+    }
+    if (!mThermalSocModeFd.ok() ||
+        TEMP_FAILURE_RETRY(pwrite(mThermalSocModeFd.get(), action.c_str(), action.size(), 0)) !=
+                static_cast<ssize_t>(action.size())) {
+        LOG(ERROR) << "Error Write: \"" << action << "\" to " << mThermalSocMode
+                   << " error:" << strerror(errno);
+        mThermalSocModeFd.reset();
+        return false;
+    }
+    return true;
+}
+
+// Writes the mode only on a transition, so most updates do no I/O
 void BatteryThermalControl::setThermalMode(bool isEnable, bool isWeakCharger) {
-    std::string action = (isEnable) ? "enabled" : "disabled";
+    if (mStatus == isEnable) {
+        mFailed = false;
+        return;
+    }
+    if (!isEnable && isWeakCharger)
+        return;
+    if (mFailed && mFailedEnable == isEnable)
+        return;
 
-    if (mStatus != isEnable) {
-        if (!isEnable && isWeakCharger)
-            return;
-        if (android::base::WriteStringToFile(action, mThermalSocMode)) {
-            mStatus = isEnable;
-        } else {
-            LOG(ERROR) << "Error Write: \"" << action << "\" to " << mThermalSocMode
-                       << " error:" << strerror(errno);
-        }
+    if (writeThermalMode(isEnable)) {
+        mStatus = isEnable;
+        mFailed = false;
+    } else {
+        mFailed = true;
+        mFailedEnable = isEnable;
     }
 }
 
@@ -16,15 +16,18 @@
 
 #define LOG_TAG "dChargerDetect"
 
-#include <android-base/file.h>
 #include <android-base/parseint.h>
 #include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 #include <cutils/klog.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <pixelhealth/ChargerDetect.h>
 #include <pixelhealth/HealthHelper.h>
+#include <unistd.h>
 
 #include <string>
+#include <string_view>
 
 constexpr char kPowerSupplySysfsPath[]{"/sys/class/power_supply/"};
 constexpr char kUsbOnlinePath[]{"/sys/class/power_supply/usb/online"};
@@ -38,123 +41,258 @@ namespace google {
 namespace pixel {
 namespace health {
 
-int ChargerDetect::readFromFile(const std::string& path, std::string* buf) {
-    if (android::base::ReadFileToString(path.c_str(), buf)) {
-        *buf = android::base::Trim(*buf);
-    }
-    return buf->length();
-}
+namespace {
 
-int ChargerDetect::getIntField(const std::string& path) {
-    std::string buf;
-    int value = 0;
+// How a usb power supply with a given usb_type selected is online
+enum class UsbOnline { USB, AC };
 
-    if (readFromFile(path, &buf) > 0)
-        android::base::ParseInt(buf, &value);
+struct UsbTypeToken {
+    std::string_view name;
+    UsbOnline online;
+};
 
-    return value;
-}
+// Any other usb_type, or none, is taken as AC: a BC1.2 non compliant charger
+constexpr UsbTypeToken kUsbTypeTokens[] = {
+        {"SDP", UsbOnline::USB},
+        {"CDP", UsbOnline::AC},
+        {"DCP", UsbOnline::AC},
+};
+
+// The nodes onlineUpdate() reads, kept open until a power supply is added or removed
+struct PowerSupplyNodes {
+    bool resolved = false;
+    std::string tcpmPsyName;
+    std::string tcpmUsbTypePath;
+    android::base::unique_fd usbOnline;
+    android::base::unique_fd usbType;
+    android::base::unique_fd tcpmUsbType;
+};
+PowerSupplyNodes nodes;
+
+// What is known of the usb power supply without reading its nodes
+struct UsbProperties {
+    bool hasOnline = false;
+    bool online = false;
+    bool hasUsbType = false;
+    UsbOnline usbType = UsbOnline::AC;
+};
+// What the last uevent of the usb power supply carried, for the next onlineUpdate()
+UsbProperties usbUevent;
 
 /*
- * Traverses through /sys/class/power_supply/ to identify TCPM(Type-C/PD) power supply.
- * TCPM power supply's name follows the format "tcpm-source-psy-6-0025" with i2c/i3c bus id
- * and client id(SID) baked in.
+ * Reads a sysfs node into buf through fd, which is opened on the first read
+ * and again after an error, and returns its contents without surrounding
+ * whitespace.
  */
-void ChargerDetect::populateTcpmPsyName(std::string* tcpmPsyName) {
-    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(kPowerSupplySysfsPath), closedir);
-    if (dir == NULL) {
-            KLOG_ERROR(LOG_TAG, "Could not open %s\n", kPowerSupplySysfsPath);
-    } else {
-        struct dirent* entry;
+std::string_view readNode(const char *path, android::base::unique_fd *fd, char *buf,
+                          size_t size) {
+    if (!fd->ok()) {
+        fd->reset(TEMP_FAILURE_RETRY(open(path, O_RDONLY | O_CLOEXEC)));
+        if (!fd->ok()) {
+            return {};
+        }
+    }
 
-        while ((entry = readdir(dir.get()))) {
-            const char* name = entry->d_name;
+    const ssize_t len = TEMP_FAILURE_RETRY(pread(fd->get(), buf, size, 0));
+    if (len < 0) {
+        fd->reset();
+        return {};
+    }
 
-            KLOG_DEBUG(LOG_TAG, "Psy name:%s", name);
-            if (strstr(name, kTcpmPsyFilter)) {
-                *tcpmPsyName = name;
-            }
-        }
+    std::string_view contents(buf, len);
+    const size_t start = contents.find_first_not_of(" \t\n");
+    if (start == std::string_view::npos) {
+        return {};
     }
+    return contents.substr(start, contents.find_last_not_of(" \t\n") - start + 1);
 }
 
 /*
  * The contents of /sys/class/power_supply/<Power supply name>/usb_type follows the format:
  * Unknown [SDP] CDP DCP
  * with the current selected value encloses within square braces.
- * This functions extracts the current selected value and returns it back to the caller.
+ * This returns the selected value, or nothing if there is none.
  */
-int ChargerDetect::getPsyUsbType(const std::string& path, std::string* type) {
-    size_t start;
-    std::string usbType;
-    int ret;
-
-    ret = readFromFile(path, &usbType);
-    if (ret <= 0) {
-        KLOG_ERROR(LOG_TAG, "Error reading %s: %d\n", path.c_str(), ret);
-        return -EINVAL;
+std::string_view selectedUsbType(std::string_view usbType) {
+    const size_t start = usbType.find('[');
+    if (start == std::string_view::npos) {
+        return {};
+    }
+    const size_t end = usbType.find(']', start);
+    if (end == std::string_view::npos) {
+        return {};
     }
+    return usbType.substr(start + 1, end - start - 1);
+}
 
-    start = usbType.find('[');
-    if (start == std::string::npos) {
-        KLOG_ERROR(LOG_TAG, "'[' not found in %s: %s\n", path.c_str(), usbType.c_str());
-        return -EINVAL;
+UsbOnline usbOnlineOf(std::string_view selected) {
+    for (const auto &token : kUsbTypeTokens) {
+        if (token.name == selected) {
+            return token.online;
+        }
     }
+    return UsbOnline::AC;
+}
 
-    *type = usbType.substr(start + 1, usbType.find(']') - start - 1);
-    return 0;
+void resolvePowerSupplies() {
+    nodes = PowerSupplyNodes();
+    ChargerDetect::populateTcpmPsyName(&nodes.tcpmPsyName);
+    KLOG_DEBUG(LOG_TAG, "TcpmPsyName:%s\n", nodes.tcpmPsyName.c_str());
+    if (!nodes.tcpmPsyName.empty()) {
+        nodes.tcpmUsbTypePath =
+                std::string(kPowerSupplySysfsPath) + nodes.tcpmPsyName + "/usb_type";
+    }
+    nodes.resolved = true;
 }
 
 /*
  * Reads the usb power_supply's usb_type and the tcpm power_supply's usb_type to infer
  * HealthInfo(hardware/interfaces/health/1.0/types.hal) online property.
  */
-void ChargerDetect::onlineUpdate(HealthInfo *health_info) {
-    std::string tcpmOnlinePath, usbPsyType;
-    static std::string tcpmPsyName;
-    int ret;
+void updateOnline(HealthInfo *health_info, const UsbProperties &usb) {
+    char buf[128];
 
     health_info->chargerAcOnline = false;
     health_info->chargerUsbOnline = false;
 
-    if (tcpmPsyName.empty()) {
-        populateTcpmPsyName(&tcpmPsyName);
-        KLOG_DEBUG(LOG_TAG, "TcpmPsyName:%s\n", tcpmPsyName.c_str());
+    if (!nodes.resolved) {
+        resolvePowerSupplies();
     }
-
-    if (!getIntField(kUsbOnlinePath)) {
+    bool online = false;
+    if (usb.hasOnline) {
+        online = usb.online;
+    } else {
+        int value = 0;
+        android::base::ParseInt(std::string(readNode(kUsbOnlinePath, &nodes.usbOnline, buf,
+                                                     sizeof(buf))),
+                                &value);
+        online = value != 0;
+    }
+    if (!online) {
         return;
     }
 
-    ret = getPsyUsbType(kUsbPowerSupplySysfsPath, &usbPsyType);
-    if (!ret) {
-        if (usbPsyType == "CDP" || usbPsyType == "DCP") {
-            health_info->chargerAcOnline = true;
-            return;
-        } else if (usbPsyType == "SDP") {
-            health_info->chargerUsbOnline = true;
-            return;
+    UsbOnline usbType = usb.usbType;
+    if (!usb.hasUsbType) {
+        const std::string_view contents =
+                readNode(kUsbPowerSupplySysfsPath, &nodes.usbType, buf, sizeof(buf));
+        if (contents.empty()) {
+            KLOG_ERROR(LOG_TAG, "Error reading %s\n", kUsbPowerSupplySysfsPath);
         }
+        usbType = usbOnlineOf(selectedUsbType(contents));
+    }
+    if (usbType == UsbOnline::USB) {
+        health_info->chargerUsbOnline = true;
+        return;
     }
 
     /* Safe to assume AC charger here if BC1.2 non compliant */
     health_info->chargerAcOnline = true;
 
-    if (tcpmPsyName.empty()) {
+    if (nodes.tcpmUsbTypePath.empty()) {
         return;
     }
 
-    ret = getPsyUsbType(std::string(kPowerSupplySysfsPath) + tcpmPsyName + "/usb_type",
-                        &usbPsyType);
-    if (ret < 0) {
+    const std::string_view tcpmUsbType = selectedUsbType(
+            readNode(nodes.tcpmUsbTypePath.c_str(), &nodes.tcpmUsbType, buf, sizeof(buf)));
+    if (tcpmUsbType.empty()) {
         return;
     }
 
-    KLOG_DEBUG(LOG_TAG, "TcpmPsy Usbtype:%s\n", usbPsyType.c_str());
+    KLOG_DEBUG(LOG_TAG, "TcpmPsy Usbtype:%s\n", std::string(tcpmUsbType).c_str());
 
     return;
 }
 
+}  // namespace
+
+/*
+ * Traverses through /sys/class/power_supply/ to identify TCPM(Type-C/PD) power supply.
+ * TCPM power supply's name follows the format "tcpm-source-psy-6-0025" with i2c/i3c bus id
+ * and client id(SID) baked in.
+ */
+void ChargerDetect::populateTcpmPsyName(std::string* tcpmPsyName) {
+    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(kPowerSupplySysfsPath), closedir);
+    if (dir == NULL) {
+            KLOG_ERROR(LOG_TAG, "Could not open %s\n", kPowerSupplySysfsPath);
+    } else {
+        struct dirent* entry;
+
+        while ((entry = readdir(dir.get()))) {
+            const char* name = entry->d_name;
+
+            KLOG_DEBUG(LOG_TAG, "Psy name:%s", name);
+            if (strstr(name, kTcpmPsyFilter)) {
+                *tcpmPsyName = name;
+            }
+        }
+    }
+}
+
+void ChargerDetect::onlineUpdate(HealthInfo *health_info) {
+    const UsbProperties uevent = usbUevent;
+    usbUevent = UsbProperties();
+    updateOnline(health_info, uevent);
+}
+
+void ChargerDetect::onlineUpdate(HealthInfo *health_info, const PowerSupplyUevent &usb) {
+    UsbProperties properties;
+    properties.hasOnline = usb.has(PowerSupplyUevent::ONLINE);
+    properties.online = usb.get(PowerSupplyUevent::ONLINE) != 0;
+    const std::string_view selected = selectedUsbType(usb.usbType());
+    if (!selected.empty()) {
+        properties.hasUsbType = true;
+        properties.usbType = usbOnlineOf(selected);
+    }
+    updateOnline(health_info, properties);
+}
+
+void ChargerDetect::onUevent(const char *msg, size_t length) {
+    std::string_view action, subsystem, name, online, usbType;
+    const char *end = msg + length;
+    for (const char *cp = msg; cp < end;) {
+        std::string_view property(cp, strnlen(cp, end - cp));
+        cp += property.size() + 1;
+
+        if (android::base::ConsumePrefix(&property, "ACTION=")) {
+            action = property;
+        } else if (android::base::ConsumePrefix(&property, "SUBSYSTEM=")) {
+            subsystem = property;
+        } else if (android::base::ConsumePrefix(&property, "POWER_SUPPLY_NAME=")) {
+            name = property;
+        } else if (android::base::ConsumePrefix(&property, "POWER_SUPPLY_ONLINE=")) {
+            online = property;
+        } else if (android::base::ConsumePrefix(&property, "POWER_SUPPLY_USB_TYPE=")) {
+            usbType = property;
+        }
+    }
+
+    if (subsystem != "power_supply") {
+        return;
+    }
+
+    if (action == "add" || action == "remove") {
+        // Resolve the power supplies and open their nodes again on the next update
+        nodes.resolved = false;
+        usbUevent = UsbProperties();
+        return;
+    }
+
+    if (name != "usb") {
+        return;
+    }
+    int value = 0;
+    if (!online.empty() && android::base::ParseInt(std::string(online), &value)) {
+        usbUevent.hasOnline = true;
+        usbUevent.online = value != 0;
+    }
+    const std::string_view selected = selectedUsbType(usbType);
+    if (!selected.empty()) {
+        usbUevent.hasUsbType = true;
+        usbUevent.usbType = usbOnlineOf(selected);
+    }
+}
+
 void ChargerDetect::onlineUpdate(struct android::BatteryProperties *props) {
     HealthInfo health_info = ToHealthInfo(props);
     onlineUpdate(&health_info);
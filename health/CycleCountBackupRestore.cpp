@@ -14,7 +14,12 @@
  * limitations under the License.
  */
 
+#include <android-base/unique_fd.h>
+#include <fcntl.h>
 #include <pixelhealth/CycleCountBackupRestore.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <utils/Timers.h>
 
 namespace hardware {
 namespace google {
@@ -22,12 +27,21 @@ namespace pixel {
 namespace health {
 
 static constexpr int kBackupTrigger = 20;
+// Least time between writes of the persist file, to spare the flash; the
+// battery keeps its own counts meanwhile
+static constexpr int64_t kMinBackupIntervalSecs = 60 * 60;
+
+static int64_t BoottimeSecs() {
+    return nanoseconds_to_seconds(systemTime(SYSTEM_TIME_BOOTTIME));
+}
 
 CycleCountBackupRestore::CycleCountBackupRestore(int nb_buckets, const char *sysfs_path,
                                                  const char *persist_path, const char *serial_path)
     : nb_buckets_(nb_buckets),
       saved_soc_(-1),
       soc_inc_(0),
+      backup_pending_(false),
+      last_backup_secs_(0),
       sysfs_path_(sysfs_path),
       persist_path_(persist_path),
       serial_path_(serial_path) {
@@ -41,6 +55,10 @@ void CycleCountBackupRestore::Restore() {
     }
     Read(sysfs_path_, hw_bins_);
     UpdateAndSave();
+    // Whatever the battery had that the persist file lacked goes out now
+    if (backup_pending_ && WritePersist()) {
+        last_backup_secs_ = BoottimeSecs();
+    }
 }
 
 bool CycleCountBackupRestore::CheckSerial() {
@@ -87,6 +105,21 @@ void CycleCountBackupRestore::Backup(int battery_level) {
         UpdateAndSave();
         soc_inc_ = 0;
     }
+    SavePending();
+}
+
+// Writes the counts not yet in the persist file, at most once per kMinBackupIntervalSecs
+void CycleCountBackupRestore::SavePending() {
+    if (!backup_pending_) {
+        return;
+    }
+    const int64_t now = BoottimeSecs();
+    if (last_backup_secs_ != 0 && now - last_backup_secs_ < kMinBackupIntervalSecs) {
+        return;
+    }
+    if (WritePersist()) {
+        last_backup_secs_ = now;
+    }
 }
 
 void CycleCountBackupRestore::Read(const std::string &path, int *bins) {
@@ -109,7 +142,7 @@ void CycleCountBackupRestore::Read(const std::string &path, int *bins) {
     }
 }
 
-void CycleCountBackupRestore::Write(int *bins, const std::string &path) {
+std::string CycleCountBackupRestore::Format(const int *bins) {
     std::string str_data = "";
 
     for (int i = 0; i < nb_buckets_; ++i) {
@@ -118,12 +151,62 @@ void CycleCountBackupRestore::Write(int *bins, const std::string &path) {
         }
         str_data += std::to_string(bins[i]);
     }
+    return str_data;
+}
+
+void CycleCountBackupRestore::Write(int *bins, const std::string &path) {
+    const std::string str_data = Format(bins);
 
     LOG(INFO) << "Write: \"" << str_data << "\" to " << path;
     if (!android::base::WriteStringToFile(str_data, path))
         LOG(ERROR) << "Write to " << path << " error: " << strerror(errno);
 }
 
+/*
+ * Writes sw_bins_ to a file next to the persist file and renames it over
+ * that, so a crash or power loss leaves either the old counts or the new
+ * ones, never a partial file. This needs create, rename and unlink access to
+ * the persist directory; without it the file is written in place as before.
+ */
+bool CycleCountBackupRestore::WritePersist() {
+    const std::string str_data = Format(sw_bins_);
+    const std::string tmp_path = persist_path_ + ".tmp";
+
+    LOG(INFO) << "Write: \"" << str_data << "\" to " << persist_path_;
+    android::base::unique_fd fd(TEMP_FAILURE_RETRY(
+            open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0660)));
+    if (!fd.ok()) {
+        PLOG(WARNING) << "Failed to open " << tmp_path << ", write in place";
+        if (!android::base::WriteStringToFile(str_data, persist_path_)) {
+            PLOG(ERROR) << "Write to " << persist_path_ << " error";
+            return false;
+        }
+        backup_pending_ = false;
+        return true;
+    }
+    if (!android::base::WriteStringToFd(str_data, fd) || fsync(fd.get()) != 0) {
+        PLOG(ERROR) << "Write to " << tmp_path << " error";
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    fd.reset();
+    if (rename(tmp_path.c_str(), persist_path_.c_str()) != 0) {
+        PLOG(ERROR) << "Failed to rename " << tmp_path << " to " << persist_path_;
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    // The rename is only durable once the directory is synced
+    const std::string dir = android::base::Dirname(persist_path_);
+    android::base::unique_fd dir_fd(
+            TEMP_FAILURE_RETRY(open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)));
+    if (!dir_fd.ok() || fsync(dir_fd.get()) != 0) {
+        PLOG(WARNING) << "Failed to sync " << dir;
+    }
+
+    backup_pending_ = false;
+    return true;
+}
+
 void CycleCountBackupRestore::UpdateAndSave() {
     bool backup = false;
     bool restore = false;
@@ -139,7 +222,7 @@ void CycleCountBackupRestore::UpdateAndSave() {
     if (restore)
         Write(hw_bins_, sysfs_path_);
     if (backup)
-        Write(sw_bins_, persist_path_);
+        backup_pending_ = true;
 }
 
 }  // namespace health
@@ -30,11 +30,17 @@ using android::base::GetProperty;
 using android::base::ReadFileToString;
 using android::base::SetProperty;
 
+// Battery level at and below which each discharging update is sampled
+static constexpr int kSampleBelowLevel = 3;
+
 LowBatteryShutdownMetrics::LowBatteryShutdownMetrics(const char *const voltage_avg,
-                                                     const char *const persist_prop)
+                                                     const char *const persist_prop,
+                                                     const char *const samples_path)
     : kVoltageAvg(voltage_avg), kPersistProp(persist_prop) {
     prop_written_ = false;
     prop_empty_ = false;
+    if (samples_path && samples_path[0])
+        samples_ = std::make_unique<ShutdownSampleRing>(samples_path);
 }
 
 bool LowBatteryShutdownMetrics::uploadVoltageAvg(void) {
@@ -67,11 +73,13 @@ bool LowBatteryShutdownMetrics::uploadVoltageAvg(void) {
     return true;
 }
 
-bool LowBatteryShutdownMetrics::saveVoltageAvg(void) {
+bool LowBatteryShutdownMetrics::saveVoltageAvg(const PowerSupplyUevent *fuel_gauge) {
     std::string voltage_avg;
     std::string prop_contents;
 
-    if (!ReadFileToString(kVoltageAvg, &voltage_avg)) {
+    if (fuel_gauge && fuel_gauge->has(PowerSupplyUevent::VOLTAGE_AVG)) {
+        voltage_avg = std::to_string(fuel_gauge->get(PowerSupplyUevent::VOLTAGE_AVG));
+    } else if (!ReadFileToString(kVoltageAvg, &voltage_avg)) {
         LOG(ERROR) << "Can't read the Maxim fuel gauge average voltage value";
         return false;
     }
@@ -89,10 +97,26 @@ bool LowBatteryShutdownMetrics::saveVoltageAvg(void) {
 }
 
 void LowBatteryShutdownMetrics::logShutdownVoltage(const HealthInfo &health_info) {
+    logShutdownVoltageWith(health_info, nullptr);
+}
+
+void LowBatteryShutdownMetrics::logShutdownVoltage(const HealthInfo &health_info,
+                                                   const PowerSupplyUevent &fuel_gauge) {
+    logShutdownVoltageWith(health_info, &fuel_gauge);
+}
+
+void LowBatteryShutdownMetrics::logShutdownVoltageWith(const HealthInfo &health_info,
+                                                       const PowerSupplyUevent *fuel_gauge) {
+    if (samples_ && health_info.batteryLevel <= kSampleBelowLevel &&
+        health_info.batteryStatus == BatteryStatus::DISCHARGING) {
+        samples_->record(health_info.batteryVoltageMillivolts,
+                         health_info.batteryCurrentMicroamps, health_info.batteryLevel);
+    }
+
     // If we're about to shut down due to low battery, save voltage_avg
     if (!prop_written_ && health_info.batteryLevel == 0 &&
         health_info.batteryStatus == BatteryStatus::DISCHARGING) {
-        prop_written_ = saveVoltageAvg();
+        prop_written_ = saveVoltageAvg(fuel_gauge);
     } else if (!prop_empty_) {  // We have data to upload
         uploadVoltageAvg();
     }
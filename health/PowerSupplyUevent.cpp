@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "PowerSupplyUevent"
+
+#include <android-base/logging.h>
+#include <fcntl.h>
+#include <pixelhealth/PowerSupplyUevent.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+
+namespace hardware {
+namespace google {
+namespace pixel {
+namespace health {
+
+namespace {
+
+constexpr size_t kInitialBufferSize = 1024;
+constexpr std::string_view kKeyPrefix = "POWER_SUPPLY_";
+
+struct PropertyKey {
+    std::string_view key;
+    PowerSupplyUevent::Property property;
+};
+
+// The keys after POWER_SUPPLY_; any other is skipped
+constexpr PropertyKey kPropertyKeys[] = {
+        {"PRESENT", PowerSupplyUevent::PRESENT},
+        {"ONLINE", PowerSupplyUevent::ONLINE},
+        {"CAPACITY", PowerSupplyUevent::CAPACITY},
+        {"VOLTAGE_NOW", PowerSupplyUevent::VOLTAGE_NOW},
+        {"VOLTAGE_AVG", PowerSupplyUevent::VOLTAGE_AVG},
+        {"VOLTAGE_OCV", PowerSupplyUevent::VOLTAGE_OCV},
+        {"CURRENT_NOW", PowerSupplyUevent::CURRENT_NOW},
+        {"CURRENT_AVG", PowerSupplyUevent::CURRENT_AVG},
+        {"TEMP", PowerSupplyUevent::TEMP},
+        {"CHARGE_COUNTER", PowerSupplyUevent::CHARGE_COUNTER},
+        {"CYCLE_COUNT", PowerSupplyUevent::CYCLE_COUNT},
+};
+static_assert(std::size(kPropertyKeys) == PowerSupplyUevent::NUM_PROPERTIES,
+              "every property needs a key");
+
+}  // namespace
+
+PowerSupplyUevent::PowerSupplyUevent(const std::string &name,
+                                     const std::string &power_supply_path)
+    : path_(power_supply_path + name + "/uevent") {
+    std::fill(has_, has_ + NUM_PROPERTIES, false);
+    std::fill(values_, values_ + NUM_PROPERTIES, 0);
+}
+
+bool PowerSupplyUevent::read() {
+    std::fill(has_, has_ + NUM_PROPERTIES, false);
+    status_ = {};
+    usb_type_ = {};
+
+    if (!fd_.ok()) {
+        fd_.reset(TEMP_FAILURE_RETRY(open(path_.c_str(), O_RDONLY | O_CLOEXEC)));
+        if (!fd_.ok()) {
+            PLOG(ERROR) << "Can't open " << path_;
+            return false;
+        }
+    }
+
+    // A uevent node is generated whole on each read from offset 0, so keep
+    // reading at 0 with a bigger buffer until it fits
+    if (buffer_.empty()) {
+        buffer_.resize(kInitialBufferSize);
+    }
+    ssize_t size;
+    while (true) {
+        size = TEMP_FAILURE_RETRY(pread(fd_.get(), buffer_.data(), buffer_.size(), 0));
+        if (size < 0) {
+            PLOG(ERROR) << "Can't read " << path_;
+            // The power supply may have gone; open it again on the next read
+            fd_.reset();
+            return false;
+        }
+        if (static_cast<size_t>(size) < buffer_.size()) {
+            break;
+        }
+        buffer_.resize(buffer_.size() * 2);
+    }
+
+    parse(std::string_view(buffer_.data(), size));
+    return true;
+}
+
+void PowerSupplyUevent::parse(std::string_view contents) {
+    while (!contents.empty()) {
+        const size_t end = contents.find('\n');
+        std::string_view line = contents.substr(0, end);
+        contents.remove_prefix(end == std::string_view::npos ? contents.size() : end + 1);
+
+        if (line.substr(0, kKeyPrefix.size()) != kKeyPrefix) {
+            continue;
+        }
+        line.remove_prefix(kKeyPrefix.size());
+        const size_t equals = line.find('=');
+        if (equals == std::string_view::npos) {
+            continue;
+        }
+        const std::string_view key = line.substr(0, equals);
+        const std::string_view value = line.substr(equals + 1);
+
+        if (key == "STATUS") {
+            status_ = value;
+            continue;
+        }
+        if (key == "USB_TYPE") {
+            usb_type_ = value;
+            continue;
+        }
+        for (const auto &entry : kPropertyKeys) {
+            if (entry.key != key) {
+                continue;
+            }
+            int64_t parsed;
+            const auto result = std::from_chars(value.data(), value.data() + value.size(), parsed);
+            if (result.ec == std::errc() && result.ptr == value.data() + value.size()) {
+                has_[entry.property] = true;
+                values_[entry.property] = parsed;
+            }
+            break;
+        }
+    }
+}
+
+int64_t PowerSupplyUevent::get(Property property, int64_t default_value) const {
+    return has_[property] ? values_[property] : default_value;
+}
+
+}  // namespace health
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
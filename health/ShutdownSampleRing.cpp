@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ShutdownSampleRing"
+
+#include <android-base/logging.h>
+#include <fcntl.h>
+#include <pixelhealth/ShutdownSampleRing.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace hardware {
+namespace google {
+namespace pixel {
+namespace health {
+
+ShutdownSampleRing::ShutdownSampleRing(const std::string &path) : path_(path), map_(nullptr) {}
+
+ShutdownSampleRing::~ShutdownSampleRing() {
+    unmap();
+}
+
+bool ShutdownSampleRing::map() {
+    fd_.reset(TEMP_FAILURE_RETRY(open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0660)));
+    if (!fd_.ok()) {
+        PLOG(ERROR) << "Can't open " << path_;
+        return false;
+    }
+    if (ftruncate(fd_.get(), kFileSize) != 0) {
+        PLOG(ERROR) << "Can't size " << path_;
+        fd_.reset();
+        return false;
+    }
+    void *map = mmap(nullptr, kFileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd_.get(), 0);
+    if (map == MAP_FAILED) {
+        PLOG(ERROR) << "Can't map " << path_;
+        fd_.reset();
+        return false;
+    }
+    map_ = map;
+
+    // Start over on a file of another layout, or one left from before an update
+    Header *header = static_cast<Header *>(map_);
+    if (header->magic != kMagic || header->version != kVersion ||
+        header->capacity != kCapacity) {
+        header->magic = kMagic;
+        header->version = kVersion;
+        header->capacity = kCapacity;
+        header->count = 0;
+    }
+    return true;
+}
+
+void ShutdownSampleRing::unmap() {
+    if (map_) {
+        munmap(map_, kFileSize);
+        map_ = nullptr;
+    }
+    fd_.reset();
+}
+
+bool ShutdownSampleRing::record(int32_t voltage_mv, int32_t current_ua, int32_t soc) {
+    // pixelstats removes the file once it has reported it; take a new one then
+    struct stat st;
+    if (map_ && (fstat(fd_.get(), &st) != 0 || st.st_nlink == 0)) {
+        unmap();
+    }
+    if (!map_ && !map()) {
+        return false;
+    }
+
+    Header *header = static_cast<Header *>(map_);
+    Sample *samples = reinterpret_cast<Sample *>(header + 1);
+    const uint32_t count = header->count;
+    Sample &sample = samples[count % kCapacity];
+    sample.timestamp_secs = time(nullptr);
+    sample.voltage_mv = voltage_mv;
+    sample.current_ua = current_ua;
+    sample.soc = soc;
+    sample.reserved = 0;
+    __atomic_store_n(&header->count, count + 1, __ATOMIC_RELEASE);
+
+    // The whole ring is a single page; a brownout may follow at any time
+    if (msync(map_, kFileSize, MS_SYNC) != 0) {
+        PLOG(ERROR) << "Can't sync " << path_;
+    }
+    return true;
+}
+
+}  // namespace health
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
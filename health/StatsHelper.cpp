@@ -97,6 +97,44 @@ void reportBatteryCausedShutdown(const std::shared_ptr<IStats> &stats_client,
         LOG(ERROR) << "Unable to report VendorBatteryHealthSnapshot to IStats service";
 }
 
+void reportBootPhases(const std::string &hal,
+                      const std::vector<android::hardware::google::pixel::BootPhase> &phases) {
+    const std::string instance = std::string() + IStats::descriptor + "/default";
+    if (!AServiceManager_isDeclared(instance.c_str())) {
+        LOG(ERROR) << "Stats service is not registered.";
+        return;
+    }
+    // Boot phases are reported right after boot, so wait for IStats
+    const std::shared_ptr<IStats> stats_client =
+            IStats::fromBinder(ndk::SpAIBinder(AServiceManager_waitForService(instance.c_str())));
+    if (!stats_client) {
+        LOG(ERROR) << "Unable to get AIDL Stats service";
+        return;
+    }
+    for (const auto &phase : phases) {
+        // Load values array
+        std::vector<VendorAtomValue> values(4);
+        VendorAtomValue tmp;
+        tmp.set<VendorAtomValue::stringValue>(hal);
+        values[0] = tmp;
+        tmp.set<VendorAtomValue::stringValue>(phase.name);
+        values[1] = tmp;
+        tmp.set<VendorAtomValue::longValue>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(phase.start).count());
+        values[2] = tmp;
+        tmp.set<VendorAtomValue::longValue>(
+                std::chrono::duration_cast<std::chrono::microseconds>(phase.duration).count());
+        values[3] = tmp;
+
+        // Send vendor atom to IStats HAL
+        VendorAtom event = {.atomId = PixelAtoms::PIXEL_HAL_BOOT_PHASE_REPORTED,
+                            .values = std::move(values)};
+        const ndk::ScopedAStatus ret = stats_client->reportVendorAtom(event);
+        if (!ret.isOk())
+            LOG(ERROR) << "Unable to report PixelHalBootPhaseReported to IStats service";
+    }
+}
+
 }  // namespace health
 }  // namespace pixel
 }  // namespace google
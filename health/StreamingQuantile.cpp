@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pixelhealth/StreamingQuantile.h>
+
+#include <algorithm>
+
+namespace hardware {
+namespace google {
+namespace pixel {
+namespace health {
+
+StreamingQuantile::StreamingQuantile(double quantile) : quantile_(quantile) {
+    clear();
+}
+
+void StreamingQuantile::clear() {
+    count_ = 0;
+    for (int i = 0; i < kMarkers; i++) {
+        heights_[i] = 0;
+        positions_[i] = i + 1;
+    }
+    desired_[0] = 1;
+    desired_[1] = 1 + 2 * quantile_;
+    desired_[2] = 1 + 4 * quantile_;
+    desired_[3] = 3 + 2 * quantile_;
+    desired_[4] = 5;
+    increments_[0] = 0;
+    increments_[1] = quantile_ / 2;
+    increments_[2] = quantile_;
+    increments_[3] = (1 + quantile_) / 2;
+    increments_[4] = 1;
+}
+
+void StreamingQuantile::add(double value) {
+    // The first values are the markers themselves
+    if (count_ < kMarkers) {
+        heights_[count_++] = value;
+        if (count_ == kMarkers) {
+            std::sort(heights_, heights_ + kMarkers);
+        }
+        return;
+    }
+    count_++;
+
+    // The cell the value falls in, stretching the ends to hold it
+    int cell;
+    if (value < heights_[0]) {
+        heights_[0] = value;
+        cell = 0;
+    } else if (value >= heights_[kMarkers - 1]) {
+        heights_[kMarkers - 1] = value;
+        cell = kMarkers - 2;
+    } else {
+        cell = 0;
+        while (value >= heights_[cell + 1]) {
+            cell++;
+        }
+    }
+
+    for (int i = cell + 1; i < kMarkers; i++) {
+        positions_[i]++;
+    }
+    for (int i = 0; i < kMarkers; i++) {
+        desired_[i] += increments_[i];
+    }
+
+    // Move the middle markers that drifted a position or more from where they should be
+    for (int i = 1; i < kMarkers - 1; i++) {
+        const double drift = desired_[i] - positions_[i];
+        if ((drift >= 1 && positions_[i + 1] - positions_[i] > 1) ||
+            (drift <= -1 && positions_[i - 1] - positions_[i] < -1)) {
+            const int d = drift > 0 ? 1 : -1;
+            const double height = parabolic(i, d);
+            if (heights_[i - 1] < height && height < heights_[i + 1]) {
+                heights_[i] = height;
+            } else {
+                heights_[i] = linear(i, d);
+            }
+            positions_[i] += d;
+        }
+    }
+}
+
+double StreamingQuantile::get() const {
+    if (count_ == 0) {
+        return 0;
+    }
+    if (count_ >= kMarkers) {
+        return heights_[2];
+    }
+
+    double sorted[kMarkers];
+    std::copy(heights_, heights_ + count_, sorted);
+    std::sort(sorted, sorted + count_);
+    return sorted[static_cast<int>(quantile_ * (count_ - 1) + 0.5)];
+}
+
+double StreamingQuantile::parabolic(int i, int d) const {
+    return heights_[i] +
+           d / (positions_[i + 1] - positions_[i - 1]) *
+                   ((positions_[i] - positions_[i - 1] + d) * (heights_[i + 1] - heights_[i]) /
+                            (positions_[i + 1] - positions_[i]) +
+                    (positions_[i + 1] - positions_[i] - d) * (heights_[i] - heights_[i - 1]) /
+                            (positions_[i] - positions_[i - 1]));
+}
+
+double StreamingQuantile::linear(int i, int d) const {
+    return heights_[i] + d * (heights_[i + d] - heights_[i]) / (positions_[i + d] - positions_[i]);
+}
+
+}  // namespace health
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
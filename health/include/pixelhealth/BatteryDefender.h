@@ -18,7 +18,9 @@
 #define HARDWARE_GOOGLE_PIXEL_HEALTH_BATTERYDEFENDER_H
 
 #include <aidl/android/hardware/health/HealthInfo.h>
+#include <android-base/unique_fd.h>
 #include <batteryservice/BatteryService.h>
+#include <pixelhealth/PowerSupplyUevent.h>
 #include <stdbool.h>
 #include <time.h>
 
@@ -41,13 +43,17 @@ const int DEFAULT_CHARGE_LEVEL_STOP = 100;
 const int DEFAULT_CHARGE_LEVEL_DEFENDER_START = 70;
 const int DEFAULT_CHARGE_LEVEL_DEFENDER_STOP = 80;
 const int DEFAULT_CAPACITY_LEVEL = 100;
-const int WRITE_DELAY_SECS = 2 * ONE_MIN_IN_SECONDS;
+// Persisted timers are written once they drift this far from the last write,
+// so a restart loses at most this much of either timer
+const int WRITE_DELAY_SECS = 20 * ONE_MIN_IN_SECONDS;
 
 const char *const PATH_NOT_SUPPORTED = "";
 const char *const DEFAULT_START_LEVEL_PATH =
         "/sys/devices/platform/soc/soc:google,charger/charge_start_level";
 const char *const DEFAULT_STOP_LEVEL_PATH =
         "/sys/devices/platform/soc/soc:google,charger/charge_stop_level";
+const char *const DEFAULT_USB_PRESENT_PATH = "/sys/class/power_supply/usb/present";
+const char *const DEFAULT_DOCK_PRESENT_PATH = "/sys/class/power_supply/dock/present";
 
 class BatteryDefender {
   public:
@@ -57,17 +63,28 @@ class BatteryDefender {
                     const std::string pathChargeLevelStop = DEFAULT_STOP_LEVEL_PATH,
                     const int32_t timeToActivateSecs = DEFAULT_TIME_TO_ACTIVATE_SECONDS,
                     const int32_t timeToClearTimerSecs = DEFAULT_TIME_TO_CLEAR_SECONDS,
-                    const bool useTypeC = true);
+                    const bool useTypeC = true,
+                    const std::string pathUSBChargerPresent = DEFAULT_USB_PRESENT_PATH,
+                    const std::string pathDockChargerPresent = DEFAULT_DOCK_PRESENT_PATH);
+    // Flushes the persisted timers
+    ~BatteryDefender();
 
     // Either of the update() function shall be called periodically in HealthService
     // Deprecated. Use update(HealthInfo*)
     void update(struct android::BatteryProperties *props);
     void update(aidl::android::hardware::health::HealthInfo *health_info);
+    // Takes the presence of the usb power supply from its uevent node, read by the caller
+    void update(aidl::android::hardware::health::HealthInfo *health_info,
+                const PowerSupplyUevent &usb);
 
     // Set wireless not supported if this is not a device with a wireless charger
     // (must be checked at runtime)
     void setWirelessNotSupported(void);
 
+    // Write the persisted timers now, e.g. on shutdown, rather than once they
+    // have drifted WRITE_DELAY_SECS
+    void flushPersistentTimers(void);
+
   private:
     enum state_E {
         STATE_INIT,
@@ -85,17 +102,24 @@ class BatteryDefender {
             [STATE_ACTIVE] = "ACTIVE",
     };
 
+    // A presence node, kept open and read with pread on every update
+    struct PresenceNode {
+        explicit PresenceNode(const std::string &path) : path(path) {}
+        std::string path;
+        android::base::unique_fd fd;
+    };
+
     // Constructor
-    std::string mPathWirelessPresent;
+    PresenceNode mWirelessPresent;
     const std::string kPathChargeLevelStart;
     const std::string kPathChargeLevelStop;
     const int32_t kTimeToActivateSecs;
     const int32_t kTimeToClearTimerSecs;
     const bool kUseTypeC;
+    PresenceNode mUSBChargerPresent;
+    PresenceNode mDockChargerPresent;
 
     // Sysfs
-    const std::string kPathUSBChargerPresent = "/sys/class/power_supply/usb/present";
-    const std::string kPathDOCKChargerPresent = "/sys/class/power_supply/dock/present";
     const std::string kTypeCPath = "/sys/class/typec/";
     const std::string kPathPersistChargerPresentTime =
             "/mnt/vendor/persist/battery/defender_charger_time";
@@ -167,6 +191,8 @@ class BatteryDefender {
     // Process state entry actions
     void stateMachine_firstAction(const state_E state);
 
+    void updateWith(aidl::android::hardware::health::HealthInfo *health_info,
+                    const PowerSupplyUevent *usb);
     void updateDefenderProperties(aidl::android::hardware::health::HealthInfo *health_info);
     void clearStateData(void);
     void loadPersistentStorage(void);
@@ -175,13 +201,16 @@ class BatteryDefender {
     int32_t getTimeToActivate(void);
     void removeLineEndings(std::string *str);
     int readFileToInt(const std::string &path, const bool silent = false);
+    int readPresenceNode(PresenceNode *node, const bool silent = false);
     bool writeIntToFile(const std::string &path, const int value);
-    void writeTimeToFile(const std::string &path, const int value, int64_t *previous);
+    void writeTimeToFile(const std::string &path, const int value, int64_t *previous,
+                         const bool force = false);
+    void writePersistentTimers(const bool force);
     void writeChargeLevelsToFile(const int vendorStart, const int vendorStop);
     bool isTypeCSink(const std::string &path);
-    bool isWiredPresent(void);
+    bool isWiredPresent(const PowerSupplyUevent *usb);
     bool isDockPresent(void);
-    bool isChargePowerAvailable(void);
+    bool isChargePowerAvailable(const PowerSupplyUevent *usb);
     bool isDefaultChargeLevel(const int start, const int stop);
     bool isBatteryDefenderDisabled(const int vendorStart, const int vendorStop);
     void addTimeToChargeTimers(void);
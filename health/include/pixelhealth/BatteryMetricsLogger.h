@@ -22,8 +22,10 @@
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 #include <batteryservice/BatteryService.h>
 #include <math.h>
+#include <pixelhealth/StreamingQuantile.h>
 #include <time.h>
 #include <utils/Timers.h>
 
@@ -80,6 +82,20 @@ class BatteryMetricsLogger {
     static constexpr int TEN_MINUTES_SEC = 10 * 60;
     static constexpr int ONE_DAY_SEC = 24 * 60 * 60;
 
+    // Running statistics of a field since the last upload, in constant space
+    // however often it is sampled
+    struct FieldStats {
+        FieldStats() : median(0.5), p90(0.9) {}
+        void add(int32_t value);
+        void clear();
+        std::string toString() const;
+
+        int32_t count = 0;
+        int64_t sum = 0;
+        StreamingQuantile median;
+        StreamingQuantile p90;
+    };
+
     // min and max are referenced by type in both the X and Y axes
     // i.e. min[TYPE] is the event where the minimum of that type occurred, and
     // min[TYPE][TYPE] is the reading of that type at that minimum event
@@ -89,8 +105,13 @@ class BatteryMetricsLogger {
     int32_t num_samples_;      // number of min/max samples since last upload
     int64_t last_sample_;      // time in seconds since boot of last sample
     int64_t last_upload_;      // time in seconds since boot of last upload
+    FieldStats res_stats_;     // of the resistance samples while not charging
+    FieldStats ocv_stats_;
+    android::base::unique_fd res_fd_;
+    android::base::unique_fd ocv_fd_;
 
     int64_t getTime();
+    bool readSysfsInt(const char *path, android::base::unique_fd *fd, int32_t *value);
     bool recordSample(const aidl::android::hardware::health::HealthInfo &health_info);
     bool uploadMetrics();
     bool uploadOutlierMetric(const std::shared_ptr<IStats> &stats_client, sampleType type);
@@ -21,6 +21,7 @@
 #include <android-base/logging.h>
 #include <android-base/properties.h>
 #include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 #include <batteryservice/BatteryService.h>
 
 #include <string>
@@ -45,9 +46,15 @@ class BatteryThermalControl {
 
   private:
     void setThermalMode(bool isEnable, bool isWeakCharger);
+    bool writeThermalMode(bool isEnable);
 
     const std::string mThermalSocMode;
+    // Opened on the first write and kept open
+    android::base::unique_fd mThermalSocModeFd;
     bool mStatus;
+    // A mode that failed to be written is not tried again until another one is wanted
+    bool mFailed;
+    bool mFailedEnable;
 };
 
 }  // namespace health
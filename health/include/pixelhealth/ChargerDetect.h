@@ -20,6 +20,7 @@
 #include <aidl/android/hardware/health/HealthInfo.h>
 #include <android-base/strings.h>
 #include <healthd/BatteryMonitor.h>
+#include <pixelhealth/PowerSupplyUevent.h>
 
 using android::BatteryMonitor;
 
@@ -33,12 +34,20 @@ class ChargerDetect {
     // Deprecated. Use onlineUpdate(HealthInfo*)
     static void onlineUpdate(struct android::BatteryProperties *props);
     static void onlineUpdate(aidl::android::hardware::health::HealthInfo *health_info);
+    // Takes the online and usb_type of the usb power supply from its uevent node, read
+    // by the caller
+    static void onlineUpdate(aidl::android::hardware::health::HealthInfo *health_info,
+                             const PowerSupplyUevent &usb);
     static void populateTcpmPsyName(std::string *tcpmPsyName);
 
-  private:
-    static int getPsyUsbType(const std::string &path, std::string *type);
-    static int readFromFile(const std::string &path, std::string *buf);
-    static int getIntField(const std::string &path);
+    /*
+     * Passes a uevent the health HAL received, as the NUL separated KEY=VALUE
+     * strings of its message. The power supply nodes onlineUpdate() reads are
+     * resolved and opened once, and again only after a power supply was added
+     * or removed. When a uevent of the usb power supply carries its ONLINE and
+     * USB_TYPE, the next onlineUpdate() uses those instead of reading sysfs.
+     */
+    static void onUevent(const char *msg, size_t length);
 };
 
 }  // namespace health
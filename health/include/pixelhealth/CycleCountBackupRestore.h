@@ -20,6 +20,8 @@
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/strings.h>
+#include <stdint.h>
+
 #include <string>
 
 namespace hardware {
@@ -42,13 +44,19 @@ class CycleCountBackupRestore {
     int *hw_bins_;
     int saved_soc_;
     int soc_inc_;
+    // sw_bins_ holds counts the persist file does not have yet
+    bool backup_pending_;
+    int64_t last_backup_secs_;
     std::string sysfs_path_;
     std::string persist_path_;
     std::string serial_path_;
 
     void Read(const std::string &path, int *bins);
+    std::string Format(const int *bins);
     void Write(int *bins, const std::string &path);
+    bool WritePersist();
     void UpdateAndSave();
+    void SavePending();
     bool CheckSerial();
 };
 
@@ -24,9 +24,12 @@
 #include <android-base/strings.h>
 #include <batteryservice/BatteryService.h>
 #include <math.h>
+#include <pixelhealth/PowerSupplyUevent.h>
+#include <pixelhealth/ShutdownSampleRing.h>
 #include <time.h>
 #include <utils/Timers.h>
 
+#include <memory>
 #include <string>
 
 namespace hardware {
@@ -36,12 +39,19 @@ namespace health {
 
 class LowBatteryShutdownMetrics {
   public:
+    // samples_path is where to keep the ring of samples near shutdown, e.g. under
+    // /data/vendor; none keeps no samples
     LowBatteryShutdownMetrics(
             const char *const voltage_avg,
-            const char *const persist_prop = "persist.vendor.shutdown.voltage_avg");
+            const char *const persist_prop = "persist.vendor.shutdown.voltage_avg",
+            const char *const samples_path = nullptr);
     // Deprecated. Use logShutdownVoltage(const HealthInfo&)
     void logShutdownVoltage(struct android::BatteryProperties *props);
     void logShutdownVoltage(const aidl::android::hardware::health::HealthInfo &health_info);
+    // Takes the average voltage from the uevent node of the fuel gauge, read by the caller,
+    // when it carries one
+    void logShutdownVoltage(const aidl::android::hardware::health::HealthInfo &health_info,
+                            const PowerSupplyUevent &fuel_gauge);
 
   private:
     const char *const kVoltageAvg;
@@ -51,8 +61,11 @@ class LowBatteryShutdownMetrics {
     bool prop_written_;
     // Help us avoid polling kPersistProp if it's empty
     bool prop_empty_;
+    std::unique_ptr<ShutdownSampleRing> samples_;
 
-    bool saveVoltageAvg();
+    bool saveVoltageAvg(const PowerSupplyUevent *fuel_gauge);
+    void logShutdownVoltageWith(const aidl::android::hardware::health::HealthInfo &health_info,
+                                const PowerSupplyUevent *fuel_gauge);
     void readStatus();
     bool uploadVoltageAvg();
 };
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_HEALTH_POWERSUPPLYUEVENT_H
+#define HARDWARE_GOOGLE_PIXEL_HEALTH_POWERSUPPLYUEVENT_H
+
+#include <android-base/unique_fd.h>
+#include <stdint.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace hardware {
+namespace google {
+namespace pixel {
+namespace health {
+
+/*
+ * Reads every property of a power supply at once from its uevent node,
+ * /sys/class/power_supply/<name>/uevent, rather than each from its own
+ * attribute. read() takes one pread of a node that stays open, and the
+ * POWER_SUPPLY_<KEY>=<value> lines are looked up in a table fixed at compile
+ * time. An update can read each power supply once and hand it to every pixel
+ * component that needs it.
+ */
+class PowerSupplyUevent {
+  public:
+    // The numeric properties, in the units of their power_supply attribute
+    enum Property {
+        PRESENT,
+        ONLINE,
+        CAPACITY,        // %
+        VOLTAGE_NOW,     // uV
+        VOLTAGE_AVG,     // uV
+        VOLTAGE_OCV,     // uV
+        CURRENT_NOW,     // uA
+        CURRENT_AVG,     // uA
+        TEMP,            // deci-degC
+        CHARGE_COUNTER,  // uAh
+        CYCLE_COUNT,
+        NUM_PROPERTIES,  // do not reference
+    };
+
+    // power_supply_path is the directory of the power supplies, for tests
+    explicit PowerSupplyUevent(const std::string &name,
+                               const std::string &power_supply_path = "/sys/class/power_supply/");
+
+    // Reads the uevent node again; false if it cannot be read
+    bool read();
+
+    bool has(Property property) const { return has_[property]; }
+    // The value of property as of the last read(), default_value if it had none
+    int64_t get(Property property, int64_t default_value = 0) const;
+    // The raw POWER_SUPPLY_STATUS and POWER_SUPPLY_USB_TYPE, empty if it had none
+    std::string_view status() const { return status_; }
+    std::string_view usbType() const { return usb_type_; }
+
+  private:
+    const std::string path_;
+    android::base::unique_fd fd_;
+    std::vector<char> buffer_;
+
+    bool has_[NUM_PROPERTIES];
+    int64_t values_[NUM_PROPERTIES];
+    // Into buffer_
+    std::string_view status_;
+    std::string_view usb_type_;
+
+    void parse(std::string_view contents);
+};
+
+}  // namespace health
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+
+#endif  // HARDWARE_GOOGLE_PIXEL_HEALTH_POWERSUPPLYUEVENT_H
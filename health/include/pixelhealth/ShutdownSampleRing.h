@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_HEALTH_SHUTDOWNSAMPLERING_H
+#define HARDWARE_GOOGLE_PIXEL_HEALTH_SHUTDOWNSAMPLERING_H
+
+#include <android-base/unique_fd.h>
+#include <stdint.h>
+
+#include <string>
+
+namespace hardware {
+namespace google {
+namespace pixel {
+namespace health {
+
+/*
+ * A fixed ring of the last battery samples before a shutdown, kept in a
+ * small file mapped into memory so that it outlives a brownout. pixelstats
+ * reads and removes the file on the next boot (BrownoutDetectedReporter).
+ *
+ * The file is a Header followed by kCapacity Samples, in native byte order.
+ * There is a single writer; a sample is stored whole before the count that
+ * publishes it.
+ */
+class ShutdownSampleRing {
+  public:
+    static constexpr uint32_t kMagic = 0x53484452;  // "SHDR"
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kCapacity = 32;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t capacity;
+        // Samples written so far; the newest is at (count - 1) % capacity
+        uint32_t count;
+    };
+    struct Sample {
+        int64_t timestamp_secs;  // CLOCK_REALTIME
+        int32_t voltage_mv;
+        int32_t current_ua;
+        int32_t soc;
+        int32_t reserved;
+    };
+    static_assert(sizeof(Header) == 16 && sizeof(Sample) == 24, "the file layout is fixed");
+
+    explicit ShutdownSampleRing(const std::string &path);
+    ~ShutdownSampleRing();
+
+    // Stores a sample and flushes it to the file; false if the file can't be mapped
+    bool record(int32_t voltage_mv, int32_t current_ua, int32_t soc);
+
+  private:
+    static constexpr size_t kFileSize = sizeof(Header) + kCapacity * sizeof(Sample);
+
+    const std::string path_;
+    android::base::unique_fd fd_;
+    void *map_;
+
+    bool map();
+    void unmap();
+};
+
+}  // namespace health
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+
+#endif  // HARDWARE_GOOGLE_PIXEL_HEALTH_SHUTDOWNSAMPLERING_H
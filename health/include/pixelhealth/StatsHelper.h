@@ -18,6 +18,7 @@
 #define HARDWARE_GOOGLE_PIXEL_HEALTH_STATSHELPER_H
 
 #include <aidl/android/frameworks/stats/IStats.h>
+#include <pixelboottiming/BootPhaseTimer.h>
 
 namespace hardware {
 namespace google {
@@ -36,6 +37,14 @@ void reportBatteryHealthSnapshot(const std::shared_ptr<IStats> &stats_client, in
 void reportBatteryCausedShutdown(const std::shared_ptr<IStats> &stats_client,
                                  int32_t last_recorded_micro_volt);
 
+/*
+ * A BootPhaseTimer::Reporter for health HALs, reporting each phase as a
+ * PixelHalBootPhaseReported atom. Waits for IStats to come up, so it is meant
+ * to run on the thread BootPhaseTimer::finish() starts.
+ */
+void reportBootPhases(const std::string &hal,
+                      const std::vector<android::hardware::google::pixel::BootPhase> &phases);
+
 }  // namespace health
 }  // namespace pixel
 }  // namespace google
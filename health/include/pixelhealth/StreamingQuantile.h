@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_HEALTH_STREAMINGQUANTILE_H
+#define HARDWARE_GOOGLE_PIXEL_HEALTH_STREAMINGQUANTILE_H
+
+#include <stdint.h>
+
+namespace hardware {
+namespace google {
+namespace pixel {
+namespace health {
+
+// Estimates a quantile of a stream of values in constant space, with the P-square
+// algorithm (Jain and Chlamtac, 1985). Five markers follow the minimum, the
+// maximum, the quantile and the quantiles halfway to either end, and are moved
+// along a parabola fitted through their neighbours as values arrive.
+class StreamingQuantile {
+  public:
+    explicit StreamingQuantile(double quantile);
+
+    void add(double value);
+    // The estimate; exact until five values are added, 0 before any
+    double get() const;
+    int64_t count() const { return count_; }
+    void clear();
+
+  private:
+    static constexpr int kMarkers = 5;
+
+    double parabolic(int i, int d) const;
+    double linear(int i, int d) const;
+
+    const double quantile_;
+    int64_t count_;
+    double heights_[kMarkers];
+    double positions_[kMarkers];
+    double desired_[kMarkers];
+    double increments_[kMarkers];
+};
+
+}  // namespace health
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+
+#endif  // HARDWARE_GOOGLE_PIXEL_HEALTH_STREAMINGQUANTILE_H
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Times a health HAL update through every pixel component, against the fake
+ * sysfs tree of HealthUpdateCycle, and reports the read and write syscalls
+ * and the bytes read per update. HealthUpdateBudgetTestCases fails when those
+ * grow past their budget.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "HealthUpdateCycle.h"
+
+nsecs_t testvar_systemTimeSecs = 0;
+nsecs_t systemTime(int clock) {
+    UNUSED(clock);
+    return seconds_to_nanoseconds(testvar_systemTimeSecs);
+}
+
+namespace hardware {
+namespace google {
+namespace pixel {
+namespace health {
+
+namespace {
+
+void BM_UpdateCycle(benchmark::State &state) {
+    HealthUpdateCycle cycle;
+    cycle.update();
+
+    const IoCounters start = IoCounters::now();
+    for (auto _ : state) {
+        cycle.update();
+    }
+    const IoCounters io = IoCounters::now() - start;
+
+    const auto perUpdate = benchmark::Counter::kAvgIterations;
+    state.counters["reads"] = benchmark::Counter(io.reads, perUpdate);
+    state.counters["writes"] = benchmark::Counter(io.writes, perUpdate);
+    state.counters["bytes_read"] = benchmark::Counter(io.bytes_read, perUpdate);
+}
+BENCHMARK(BM_UpdateCycle);
+
+}  // namespace
+
+}  // namespace health
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+
+BENCHMARK_MAIN();
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_HEALTH_TEST_HEALTHUPDATECYCLE_H
+#define HARDWARE_GOOGLE_PIXEL_HEALTH_TEST_HEALTHUPDATECYCLE_H
+
+#include <aidl/android/hardware/health/HealthInfo.h>
+#include <android-base/file.h>
+#include <android-base/parseint.h>
+#include <android-base/strings.h>
+#include <pixelhealth/BatteryDefender.h>
+#include <pixelhealth/BatteryMetricsLogger.h>
+#include <pixelhealth/BatteryThermalControl.h>
+#include <pixelhealth/ChargerDetect.h>
+#include <pixelhealth/DeviceHealth.h>
+#include <pixelhealth/LowBatteryShutdownMetrics.h>
+#include <pixelhealth/PowerSupplyUevent.h>
+#include <sys/stat.h>
+#include <utils/Timers.h>
+
+#include <string>
+
+// The boot time in seconds, which the test binaries return from systemTime()
+extern nsecs_t testvar_systemTimeSecs;
+
+namespace hardware {
+namespace google {
+namespace pixel {
+namespace health {
+
+using aidl::android::hardware::health::BatteryStatus;
+using aidl::android::hardware::health::HealthInfo;
+
+// The read and write syscalls this process made so far and their bytes, from /proc/self/io
+struct IoCounters {
+    int64_t reads = 0;
+    int64_t writes = 0;
+    int64_t bytes_read = 0;
+    int64_t bytes_written = 0;
+
+    static IoCounters now() {
+        IoCounters counters;
+        std::string io;
+        if (!android::base::ReadFileToString("/proc/self/io", &io)) {
+            return counters;
+        }
+        for (const auto &line : android::base::Split(io, "\n")) {
+            const auto fields = android::base::Split(line, ":");
+            if (fields.size() != 2) {
+                continue;
+            }
+            const std::string value = android::base::Trim(fields[1]);
+            if (fields[0] == "syscr") {
+                android::base::ParseInt(value, &counters.reads);
+            } else if (fields[0] == "syscw") {
+                android::base::ParseInt(value, &counters.writes);
+            } else if (fields[0] == "rchar") {
+                android::base::ParseInt(value, &counters.bytes_read);
+            } else if (fields[0] == "wchar") {
+                android::base::ParseInt(value, &counters.bytes_written);
+            }
+        }
+        return counters;
+    }
+
+    IoCounters operator-(const IoCounters &other) const {
+        IoCounters diff;
+        diff.reads = reads - other.reads;
+        diff.writes = writes - other.writes;
+        diff.bytes_read = bytes_read - other.bytes_read;
+        diff.bytes_written = bytes_written - other.bytes_written;
+        return diff;
+    }
+};
+
+/*
+ * One health HAL update through every pixel component that hooks it, in the
+ * order a device's health HAL calls them, against a fake sysfs tree under a
+ * temporary directory. The battery discharges at 60% with no charger, and
+ * each update advances the boot time by a minute. BatteryDefender takes the
+ * wired presence from the usb power supply rather than /sys/class/typec,
+ * which the tree does not stand in for.
+ */
+class HealthUpdateCycle {
+  public:
+    static constexpr int kSecondsPerUpdate = 60;
+
+    HealthUpdateCycle()
+        : resistance_path_(path("resistance")),
+          ocv_path_(path("ocv")),
+          voltage_avg_path_(path("power_supply/battery/voltage_avg")),
+          samples_path_(path("shutdown_samples")),
+          battery_("battery", makeTree(dir_.path)),
+          usb_("usb", std::string(dir_.path) + "/power_supply/"),
+          battery_defender_(PATH_NOT_SUPPORTED, path("charge_start_level"),
+                            path("charge_stop_level"), DEFAULT_TIME_TO_ACTIVATE_SECONDS,
+                            DEFAULT_TIME_TO_CLEAR_SECONDS, false, path("power_supply/usb/present"),
+                            path("power_supply/dock/present")),
+          battery_metrics_logger_(resistance_path_.c_str(), ocv_path_.c_str()),
+          low_battery_shutdown_metrics_(voltage_avg_path_.c_str(),
+                                        "vendor.health.test.shutdown.voltage_avg",
+                                        samples_path_.c_str()),
+          battery_thermal_control_(path("thermal_soc_mode")) {}
+
+    void update() {
+        testvar_systemTimeSecs += kSecondsPerUpdate;
+
+        battery_.read();
+        usb_.read();
+        HealthInfo health_info;
+        health_info.batteryPresent = battery_.get(PowerSupplyUevent::PRESENT) != 0;
+        health_info.batteryStatus = BatteryStatus::DISCHARGING;
+        health_info.batteryLevel = battery_.get(PowerSupplyUevent::CAPACITY);
+        health_info.batteryVoltageMillivolts = battery_.get(PowerSupplyUevent::VOLTAGE_NOW) / 1000;
+        health_info.batteryCurrentMicroamps = battery_.get(PowerSupplyUevent::CURRENT_NOW);
+        health_info.batteryTemperatureTenthsCelsius = battery_.get(PowerSupplyUevent::TEMP);
+        health_info.batteryChargeCounterUah = battery_.get(PowerSupplyUevent::CHARGE_COUNTER);
+        health_info.batteryCycleCount = battery_.get(PowerSupplyUevent::CYCLE_COUNT);
+
+        ChargerDetect::onlineUpdate(&health_info, usb_);
+        battery_defender_.update(&health_info, usb_);
+        device_health_.update(&health_info);
+        battery_metrics_logger_.logBatteryProperties(health_info);
+        low_battery_shutdown_metrics_.logShutdownVoltage(health_info, battery_);
+        battery_thermal_control_.updateThermalState(health_info);
+    }
+
+    // The I/O of count updates, less that of taking the counters
+    IoCounters measure(int count) {
+        const IoCounters before_counters = IoCounters::now();
+        const IoCounters counters_cost = IoCounters::now() - before_counters;
+
+        const IoCounters start = IoCounters::now();
+        for (int i = 0; i < count; i++) {
+            update();
+        }
+        return IoCounters::now() - start - counters_cost;
+    }
+
+  private:
+    TemporaryDir dir_;
+    // The components keep pointers to these
+    const std::string resistance_path_;
+    const std::string ocv_path_;
+    const std::string voltage_avg_path_;
+    const std::string samples_path_;
+    PowerSupplyUevent battery_;
+    PowerSupplyUevent usb_;
+    BatteryDefender battery_defender_;
+    DeviceHealth device_health_;
+    BatteryMetricsLogger battery_metrics_logger_;
+    LowBatteryShutdownMetrics low_battery_shutdown_metrics_;
+    BatteryThermalControl battery_thermal_control_;
+
+    std::string path(const char *name) const { return std::string(dir_.path) + "/" + name; }
+
+    // Lays out the fake tree under dir, and returns its power_supply directory
+    static std::string makeTree(const std::string &dir) {
+        const std::string power_supply = dir + "/power_supply/";
+        mkdir(power_supply.c_str(), 0700);
+        mkdir((power_supply + "battery").c_str(), 0700);
+        mkdir((power_supply + "usb").c_str(), 0700);
+        mkdir((power_supply + "dock").c_str(), 0700);
+
+        android::base::WriteStringToFile(
+                "POWER_SUPPLY_NAME=battery\n"
+                "POWER_SUPPLY_TYPE=Battery\n"
+                "POWER_SUPPLY_STATUS=Discharging\n"
+                "POWER_SUPPLY_HEALTH=Good\n"
+                "POWER_SUPPLY_PRESENT=1\n"
+                "POWER_SUPPLY_TECHNOLOGY=Li-ion\n"
+                "POWER_SUPPLY_CYCLE_COUNT=120\n"
+                "POWER_SUPPLY_VOLTAGE_NOW=3900000\n"
+                "POWER_SUPPLY_VOLTAGE_AVG=3895000\n"
+                "POWER_SUPPLY_VOLTAGE_OCV=3950000\n"
+                "POWER_SUPPLY_CURRENT_NOW=-350000\n"
+                "POWER_SUPPLY_CURRENT_AVG=-340000\n"
+                "POWER_SUPPLY_CAPACITY=60\n"
+                "POWER_SUPPLY_TEMP=250\n"
+                "POWER_SUPPLY_CHARGE_COUNTER=2400000\n",
+                power_supply + "battery/uevent");
+        android::base::WriteStringToFile("3895000\n", power_supply + "battery/voltage_avg");
+        android::base::WriteStringToFile(
+                "POWER_SUPPLY_NAME=usb\n"
+                "POWER_SUPPLY_TYPE=USB\n"
+                "POWER_SUPPLY_PRESENT=0\n"
+                "POWER_SUPPLY_ONLINE=0\n"
+                "POWER_SUPPLY_USB_TYPE=[Unknown] SDP CDP DCP\n",
+                power_supply + "usb/uevent");
+        android::base::WriteStringToFile("0\n", power_supply + "usb/present");
+        android::base::WriteStringToFile("0\n", power_supply + "dock/present");
+
+        android::base::WriteStringToFile("0\n", dir + "/charge_start_level");
+        android::base::WriteStringToFile("100\n", dir + "/charge_stop_level");
+        android::base::WriteStringToFile("110000\n", dir + "/resistance");
+        android::base::WriteStringToFile("3950000\n", dir + "/ocv");
+        android::base::WriteStringToFile("enabled\n", dir + "/thermal_soc_mode");
+        return power_supply;
+    }
+};
+
+}  // namespace health
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+
+#endif  // HARDWARE_GOOGLE_PIXEL_HEALTH_TEST_HEALTHUPDATECYCLE_H
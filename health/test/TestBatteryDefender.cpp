@@ -24,6 +24,10 @@
 #include <android-base/file.h>
 #include <android-base/properties.h>
 
+#include <fstream>
+#include <map>
+#include <memory>
+
 #define MIN_TIME_BETWEEN_FILE_UPDATES (WRITE_DELAY_SECS + 1)
 
 class HealthInterface {
@@ -107,8 +111,12 @@ using ::testing::SetArgPointee;
 struct android::BatteryProperties props;
 BatteryDefender *battDefender;
 
-const char *kPathWiredChargerPresent = "/sys/class/power_supply/usb/present";
-const char *kPathWirelessChargerPresent = "/sys/class/power_supply/wireless/present";
+// The presence nodes are read through their own fds rather than ReadFileToString,
+// so the tests write them as files under a temporary directory
+TemporaryDir *sysfsDir;
+const char *kPathWiredChargerPresent = "usb_present";
+const char *kPathWirelessChargerPresent = "wireless_present";
+const char *kPathDockChargerPresent = "dock_present";
 const char *kPathPersistChargerPresentTime = "/mnt/vendor/persist/battery/defender_charger_time";
 const char *kPathPersistDefenderActiveTime = "/mnt/vendor/persist/battery/defender_active_time";
 const char *kPathStartLevel = "/sys/devices/platform/soc/soc:google,charger/charge_start_level";
@@ -127,17 +135,34 @@ const char *kPropBatteryDefenderCtrlStartSOC = "vendor.battery.defender.ctrl.rec
 const char *kPropBatteryDefenderCtrlStopSOC = "vendor.battery.defender.ctrl.recharge_soc_stop";
 const char *kPropBatteryDefenderCtrlTriggerSOC = "vendor.battery.defender.ctrl.trigger_soc";
 
+static std::string sysfsPath(const char *node) {
+    return std::string(sysfsDir->path) + "/" + node;
+}
+
+static void writeSysfs(const char *node, const char *value) {
+    std::ofstream(sysfsPath(node), std::ios::trunc) << value << std::endl;
+}
+
+static std::unique_ptr<BatteryDefender> makeDefender(void) {
+    return std::make_unique<BatteryDefender>(
+            sysfsPath(kPathWirelessChargerPresent), DEFAULT_START_LEVEL_PATH,
+            DEFAULT_STOP_LEVEL_PATH, DEFAULT_TIME_TO_ACTIVATE_SECONDS,
+            DEFAULT_TIME_TO_CLEAR_SECONDS, false, sysfsPath(kPathWiredChargerPresent),
+            sysfsPath(kPathDockChargerPresent));
+}
+
 class BatteryDefenderTest : public ::testing::Test {
   public:
-    BatteryDefenderTest()
-        : defender(kPathWirelessChargerPresent, DEFAULT_START_LEVEL_PATH, DEFAULT_STOP_LEVEL_PATH,
-                   DEFAULT_TIME_TO_ACTIVATE_SECONDS, DEFAULT_TIME_TO_CLEAR_SECONDS, false) {}
-
     void SetUp() {
         mock = &mockFixture;
+        sysfsDir = &sysfsDirFixture;
+        writeSysfs(kPathWiredChargerPresent, "0");
+        writeSysfs(kPathWirelessChargerPresent, "0");
+        writeSysfs(kPathDockChargerPresent, "0");
 
         props = {};
-        battDefender = &defender;
+        defender = makeDefender();
+        battDefender = defender.get();
 
         EXPECT_CALL(*mock, SetProperty(_, _)).Times(AnyNumber());
         EXPECT_CALL(*mock, ReadFileToString(_, _, _)).Times(AnyNumber());
@@ -153,9 +178,10 @@ class BatteryDefenderTest : public ::testing::Test {
 
     void TearDown() {}
 
-  private:
+  protected:
     HealthInterfaceMock mockFixture;
-    BatteryDefender defender;
+    TemporaryDir sysfsDirFixture;
+    std::unique_ptr<BatteryDefender> defender;
 };
 
 static void enableDefender(void) {
@@ -167,18 +193,15 @@ static void enableDefender(void) {
 }
 
 static void usbPresent(void) {
-    ON_CALL(*mock, ReadFileToString(kPathWiredChargerPresent, _, _))
-            .WillByDefault(DoAll(SetArgPointee<1>(std::string("1")), Return(true)));
+    writeSysfs(kPathWiredChargerPresent, "1");
 }
 
 static void wirelessPresent(void) {
-    ON_CALL(*mock, ReadFileToString(kPathWirelessChargerPresent, _, _))
-            .WillByDefault(DoAll(SetArgPointee<1>(std::string("1")), Return(true)));
+    writeSysfs(kPathWirelessChargerPresent, "1");
 }
 
 static void wirelessNotPresent(void) {
-    ON_CALL(*mock, ReadFileToString(kPathWirelessChargerPresent, _, _))
-            .WillByDefault(DoAll(SetArgPointee<1>(std::string("0")), Return(true)));
+    writeSysfs(kPathWirelessChargerPresent, "0");
 }
 
 static void powerAvailable(void) {
@@ -451,18 +474,17 @@ TEST_F(BatteryDefenderTest, ConnectDisconnectCycle) {
 
     // Maintain kPathPersistChargerPresentTime = 1000 + MIN_TIME_BETWEEN_FILE_UPDATES
     EXPECT_CALL(*mock, SetProperty(kPropBatteryDefenderState, "CONNECTED"));
-    testvar_systemTimeSecs += MIN_TIME_BETWEEN_FILE_UPDATES;
+    testvar_systemTimeSecs += 1;
     battDefender->update(&props);
 
     // Maintain kPathPersistChargerPresentTime = 1000 + MIN_TIME_BETWEEN_FILE_UPDATES
     EXPECT_CALL(*mock, SetProperty(kPropBatteryDefenderState, "CONNECTED"));
-    testvar_systemTimeSecs += DEFAULT_TIME_TO_CLEAR_SECONDS - MIN_TIME_BETWEEN_FILE_UPDATES - 1;
+    testvar_systemTimeSecs += DEFAULT_TIME_TO_CLEAR_SECONDS - 2;
     battDefender->update(&props);
 
-    testvar_systemTimeSecs += 1;
     EXPECT_CALL(*mock, WriteStringToFile(std::to_string(0), kPathPersistChargerPresentTime, _));
     EXPECT_CALL(*mock, SetProperty(kPropBatteryDefenderState, "DISCONNECTED"));
-    testvar_systemTimeSecs += MIN_TIME_BETWEEN_FILE_UPDATES;
+    testvar_systemTimeSecs += 1;
     battDefender->update(&props);
 
     // Power ON
@@ -773,6 +795,113 @@ TEST_F(BatteryDefenderTest, WirelessPathUnsupported) {
     battDefender->update(&props);
 }
 
+// Keeps what is written to the persisted timers, so a restart reads it back
+static void persistTimersInMemory(std::map<std::string, std::string> *persisted) {
+    for (const char *path : {kPathPersistChargerPresentTime, kPathPersistDefenderActiveTime}) {
+        ON_CALL(*mock, ReadFileToString(path, _, _))
+                .WillByDefault([persisted](const std::string &path, std::string *content, bool) {
+                    const auto it = persisted->find(path);
+                    *content = it == persisted->end() ? "0" : it->second;
+                    return true;
+                });
+        ON_CALL(*mock, WriteStringToFile(_, path, _))
+                .WillByDefault([persisted](const std::string &content, const std::string &path,
+                                           bool) {
+                    (*persisted)[path] = content;
+                    return true;
+                });
+    }
+}
+
+TEST_F(BatteryDefenderTest, PersistWritesCoalesced) {
+    enableDefender();
+    powerAvailable();
+    defaultThresholds();
+    initTo1000sConnectedCapacityReached();
+
+    // An hour of updates every minute: the value read back on the first one,
+    // then once every WRITE_DELAY_SECS of accumulated time, and the rest on
+    // destruction
+    EXPECT_CALL(*mock, WriteStringToFile(_, kPathPersistChargerPresentTime, _)).Times(4);
+    EXPECT_CALL(*mock, SetProperty(kPropBatteryDefenderState, "CONNECTED")).Times(61);
+    battDefender->update(&props);
+    for (int i = 0; i < 60; i++) {
+        testvar_systemTimeSecs += ONE_MIN_IN_SECONDS;
+        battDefender->update(&props);
+    }
+}
+
+TEST_F(BatteryDefenderTest, StateTransitionFlushesTimers) {
+    enableDefender();
+    powerAvailable();
+    defaultThresholds();
+    ON_CALL(*mock, ReadFileToString(kPathPersistChargerPresentTime, _, _))
+            .WillByDefault(
+                    DoAll(SetArgPointee<1>(std::to_string(DEFAULT_TIME_TO_ACTIVATE_SECONDS - 10)),
+                          Return(true)));
+
+    InSequence s;
+
+    EXPECT_CALL(*mock, SetProperty(kPropBatteryDefenderState, "CONNECTED"));
+    battDefender->update(&props);
+
+    // Written on the transition even though it drifted less than WRITE_DELAY_SECS
+    EXPECT_CALL(*mock, WriteStringToFile(std::to_string(DEFAULT_TIME_TO_ACTIVATE_SECONDS + 50),
+                                         kPathPersistChargerPresentTime, _));
+    EXPECT_CALL(*mock, SetProperty(kPropBatteryDefenderState, "ACTIVE"));
+    testvar_systemTimeSecs += ONE_MIN_IN_SECONDS;
+    battDefender->update(&props);
+}
+
+TEST_F(BatteryDefenderTest, FlushOnShutdown) {
+    enableDefender();
+    powerAvailable();
+    defaultThresholds();
+    initTo1000sConnectedCapacityReached();
+
+    EXPECT_CALL(*mock, SetProperty(kPropBatteryDefenderState, "CONNECTED")).Times(2);
+    battDefender->update(&props);
+    testvar_systemTimeSecs += ONE_MIN_IN_SECONDS;
+    battDefender->update(&props);
+
+    EXPECT_CALL(*mock, WriteStringToFile(std::to_string(1000 + ONE_MIN_IN_SECONDS),
+                                         kPathPersistChargerPresentTime, _));
+    battDefender->flushPersistentTimers();
+}
+
+TEST_F(BatteryDefenderTest, RestartLosesAtMostWriteDelay) {
+    enableDefender();
+    powerAvailable();
+    defaultThresholds();
+    capacityReached();
+    std::map<std::string, std::string> persisted;
+    persistTimersInMemory(&persisted);
+
+    // Charge at full capacity, updating every minute, then crash without a flush
+    int accumulatedSecs = 0;
+    battDefender->update(&props);
+    for (int i = 0; i < 90; i++) {
+        testvar_systemTimeSecs += ONE_MIN_IN_SECONDS;
+        accumulatedSecs += ONE_MIN_IN_SECONDS;
+        battDefender->update(&props);
+    }
+    // Leaked, as a crash would not run its destructor
+    static_cast<void>(defender.release());
+
+    // The persisted time is never ahead of the real one, and at most
+    // WRITE_DELAY_SECS behind it
+    const int persistedSecs = std::stoi(persisted[kPathPersistChargerPresentTime]);
+    EXPECT_LE(persistedSecs, accumulatedSecs);
+    EXPECT_GE(persistedSecs, accumulatedSecs - WRITE_DELAY_SECS);
+
+    // and it is what the restarted defender carries on from
+    defender = makeDefender();
+    battDefender = defender.get();
+    EXPECT_CALL(*mock, WriteStringToFile(std::to_string(persistedSecs),
+                                         kPathPersistChargerPresentTime, _));
+    battDefender->update(&props);
+}
+
 }  // namespace health
 }  // namespace pixel
 }  // namespace google
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "HealthUpdateCycle.h"
+
+nsecs_t testvar_systemTimeSecs = 0;
+nsecs_t systemTime(int clock) {
+    UNUSED(clock);
+    return seconds_to_nanoseconds(testvar_systemTimeSecs);
+}
+
+namespace hardware {
+namespace google {
+namespace pixel {
+namespace health {
+
+// What one update may cost on average once every node is open. Raise these only
+// with a reason in the change that needs it.
+constexpr double kMaxReadsPerUpdate = 6;
+constexpr double kMaxBytesReadPerUpdate = 2048;
+// BatteryDefender sets its state property on each update, a write to the property
+// service, and BatteryMetricsLogger logs each sample it takes
+constexpr double kMaxWritesPerUpdate = 1.5;
+// What the first update may cost, which opens the nodes and loads what persists
+constexpr int64_t kMaxReadsFirstUpdate = 16;
+
+// Long enough for the persisted timers of BatteryDefender to be due once
+constexpr int kUpdates = 2 * WRITE_DELAY_SECS / HealthUpdateCycle::kSecondsPerUpdate;
+
+class UpdateBudgetTest : public ::testing::Test {
+  public:
+    void SetUp() { testvar_systemTimeSecs = 0; }
+};
+
+TEST_F(UpdateBudgetTest, FirstUpdate) {
+    HealthUpdateCycle cycle;
+    const IoCounters io = cycle.measure(1);
+
+    EXPECT_LE(io.reads, kMaxReadsFirstUpdate);
+}
+
+TEST_F(UpdateBudgetTest, SteadyState) {
+    HealthUpdateCycle cycle;
+    cycle.measure(1);
+    const IoCounters io = cycle.measure(kUpdates);
+
+    EXPECT_LE(io.reads / static_cast<double>(kUpdates), kMaxReadsPerUpdate);
+    EXPECT_LE(io.bytes_read / static_cast<double>(kUpdates), kMaxBytesReadPerUpdate);
+    EXPECT_LE(io.writes / static_cast<double>(kUpdates), kMaxWritesPerUpdate);
+}
+
+}  // namespace health
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
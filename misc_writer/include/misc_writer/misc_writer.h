@@ -21,6 +21,7 @@
 
 #include <optional>
 #include <string>
+#include <vector>
 
 namespace android {
 namespace hardware {
@@ -134,6 +135,9 @@ class MiscWriter {
     // offset is in relative to the start of the vendor space.
     static bool WriteMiscPartitionVendorSpace(const void *data, size_t size, size_t offset,
                                               std::string *err);
+    // Reads |size| bytes from the vendor space in /misc partition, at the given offset.
+    static bool ReadMiscPartitionVendorSpace(void *data, size_t size, size_t offset,
+                                             std::string *err);
 
     explicit MiscWriter(const MiscWriterActions &action) : action_(action) {}
     explicit MiscWriter(const MiscWriterActions &action, const char data)
@@ -145,7 +149,23 @@ class MiscWriter {
     // offset in the vendor space of /misc instead of the default offset.
     bool PerformAction(std::optional<size_t> override_offset = std::nullopt);
 
+    // Performs all the given actions with a single read-modify-write of the vendor space region
+    // they touch, then reads the region back to verify it. Later actions win where they overlap.
+    // Nothing is written if any action is invalid, or if override_offset is given with more than
+    // one action.
+    static bool PerformActions(const std::vector<MiscWriter> &misc_writers,
+                               std::optional<size_t> override_offset = std::nullopt);
+
   private:
+    struct VendorSpaceWrite {
+        size_t offset;
+        std::string content;
+    };
+
+    // Appends the writes the stored action needs to |writes|.
+    bool CollectWrites(std::optional<size_t> override_offset,
+                       std::vector<VendorSpaceWrite> *writes) const;
+
     MiscWriterActions action_{MiscWriterActions::kUnset};
     char chardata_{'0'};
     std::string stringdata_;
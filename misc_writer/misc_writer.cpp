@@ -21,8 +21,11 @@
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
 #include <bootloader_message/bootloader_message.h>
+#include <stdint.h>
 #include <string.h>
 
+#include <algorithm>
+
 namespace android {
 namespace hardware {
 namespace google {
@@ -47,7 +50,22 @@ bool MiscWriter::WriteMiscPartitionVendorSpace(const void* data, size_t size, si
                               err);
 }
 
-bool MiscWriter::PerformAction(std::optional<size_t> override_offset) {
+bool MiscWriter::ReadMiscPartitionVendorSpace(void* data, size_t size, size_t offset,
+                                              std::string* err) {
+  if (!OffsetAndSizeInVendorSpace(offset, size)) {
+    *err = android::base::StringPrintf("Out of bound read (offset %zu size %zu)", offset, size);
+    return false;
+  }
+  auto misc_blk_device = get_misc_blk_device(err);
+  if (misc_blk_device.empty()) {
+    return false;
+  }
+  return read_misc_partition(data, size, misc_blk_device, VENDOR_SPACE_OFFSET_IN_MISC + offset,
+                             err);
+}
+
+bool MiscWriter::CollectWrites(std::optional<size_t> override_offset,
+                               std::vector<VendorSpaceWrite>* writes) const {
   size_t offset = 0;
   std::string content;
   switch (action_) {
@@ -104,7 +122,7 @@ bool MiscWriter::PerformAction(std::optional<size_t> override_offset) {
         content.resize(32);
         break;
     case MiscWriterActions::kSetSotaConfig:
-        goto sota_config;
+        break;
     case MiscWriterActions::kWriteDstTransition:
         offset = override_offset.value_or(kDstTransitionOffsetInVendorSpace);
         content = std::string(kDstTransition) + stringdata_;
@@ -128,37 +146,102 @@ bool MiscWriter::PerformAction(std::optional<size_t> override_offset) {
       return false;
   }
 
-  if (std::string err;
-      !WriteMiscPartitionVendorSpace(content.data(), content.size(), offset, &err)) {
-    LOG(ERROR) << "Failed to write " << content << " at offset " << offset << " : " << err;
-    return false;
+  if (action_ != MiscWriterActions::kSetSotaConfig) {
+    writes->push_back({offset, std::move(content)});
   }
 
-sota_config:
   if (action_ == MiscWriterActions::kSetSotaFlag || action_ == MiscWriterActions::kSetSotaConfig) {
     content = ::android::base::GetProperty("persist.vendor.nfc.factoryota.state", "");
     if (content.size() != 0 && content.size() <= 40) {
-      offset = kSotaStateOffsetInVendorSpace;
-      if (std::string err;
-          !WriteMiscPartitionVendorSpace(content.data(), content.size(), offset, &err)) {
-          LOG(ERROR) << "Failed to write " << content << " at offset " << offset << " : " << err;
-          return false;
-      }
+      writes->push_back({kSotaStateOffsetInVendorSpace, std::move(content)});
     }
     content = ::android::base::GetProperty("persist.vendor.nfc.factoryota.schedule_shipmode", "");
     if (content.size() != 0 && content.size() <= 32) {
-      offset = kSotaScheduleShipmodeOffsetInVendorSpace;
-      if (std::string err;
-          !WriteMiscPartitionVendorSpace(content.data(), content.size(), offset, &err)) {
-          LOG(ERROR) << "Failed to write " << content << " at offset " << offset << " : " << err;
-          return false;
-      }
+      writes->push_back({kSotaScheduleShipmodeOffsetInVendorSpace, std::move(content)});
     }
   }
 
   return true;
 }
 
+bool MiscWriter::PerformAction(std::optional<size_t> override_offset) {
+  std::vector<VendorSpaceWrite> writes;
+  if (!CollectWrites(override_offset, &writes)) {
+    return false;
+  }
+
+  for (const auto& [offset, content] : writes) {
+    if (std::string err;
+        !WriteMiscPartitionVendorSpace(content.data(), content.size(), offset, &err)) {
+      LOG(ERROR) << "Failed to write " << content << " at offset " << offset << " : " << err;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool MiscWriter::PerformActions(const std::vector<MiscWriter>& misc_writers,
+                                std::optional<size_t> override_offset) {
+  // The override would send every action to the same offset.
+  if (override_offset && misc_writers.size() > 1) {
+    LOG(ERROR) << "Override offset is only supported with a single action";
+    return false;
+  }
+  std::vector<VendorSpaceWrite> writes;
+  for (const auto& misc_writer : misc_writers) {
+    if (!misc_writer.CollectWrites(override_offset, &writes)) {
+      return false;
+    }
+  }
+  if (writes.empty()) {
+    return true;
+  }
+
+  size_t begin = SIZE_MAX;
+  size_t end = 0;
+  for (const auto& [offset, content] : writes) {
+    if (!OffsetAndSizeInVendorSpace(offset, content.size())) {
+      LOG(ERROR) << "Out of bound write (offset " << offset << " size " << content.size() << ")";
+      return false;
+    }
+    begin = std::min(begin, offset);
+    end = std::max(end, offset + content.size());
+  }
+
+  // Bytes between the writes keep their current value.
+  std::string region(end - begin, 0);
+  if (std::string err; !ReadMiscPartitionVendorSpace(region.data(), region.size(), begin, &err)) {
+    LOG(ERROR) << "Failed to read " << region.size() << " bytes at offset " << begin << " : "
+               << err;
+    return false;
+  }
+  for (const auto& [offset, content] : writes) {
+    region.replace(offset - begin, content.size(), content);
+  }
+
+  if (std::string err;
+      !WriteMiscPartitionVendorSpace(region.data(), region.size(), begin, &err)) {
+    LOG(ERROR) << "Failed to write " << region.size() << " bytes at offset " << begin << " : "
+               << err;
+    return false;
+  }
+
+  std::string readback(region.size(), 0);
+  if (std::string err;
+      !ReadMiscPartitionVendorSpace(readback.data(), readback.size(), begin, &err)) {
+    LOG(ERROR) << "Failed to read back " << readback.size() << " bytes at offset " << begin
+               << " : " << err;
+    return false;
+  }
+  if (readback != region) {
+    LOG(ERROR) << "Read back mismatch for " << region.size() << " bytes at offset " << begin;
+    return false;
+  }
+
+  return true;
+}
+
 }  // namespace pixel
 }  // namespace google
 }  // namespace hardware
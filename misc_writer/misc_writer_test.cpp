@@ -138,6 +138,39 @@ TEST_F(MiscWriterTest, SetClearDisplayMode) {
   CheckMiscPartitionVendorSpaceContent(MiscWriter::kDisplayModeOffsetInVendorSpace, zeros);
 }
 
+TEST_F(MiscWriterTest, PerformActions) {
+  std::string err;
+  ASSERT_TRUE(MiscWriter::WriteMiscPartitionVendorSpace("keep", 4, 40, &err)) << err;
+
+  std::vector<MiscWriter> misc_writers;
+  misc_writers.emplace_back(MiscWriterActions::kSetDarkThemeFlag);
+  misc_writers.emplace_back(MiscWriterActions::kSetDisplayMode, "1440x3120@60:120");
+  misc_writers.emplace_back(MiscWriterActions::kWriteTimeFormat, '1');
+  ASSERT_TRUE(MiscWriter::PerformActions(misc_writers));
+
+  CheckMiscPartitionVendorSpaceContent(MiscWriter::kThemeFlagOffsetInVendorSpace, "theme-dark");
+  CheckMiscPartitionVendorSpaceContent(MiscWriter::kDisplayModeOffsetInVendorSpace,
+                                       "mode=1440x3120@60:120");
+  CheckMiscPartitionVendorSpaceContent(MiscWriter::kTimeFormatValOffsetInVendorSpace,
+                                       "timeformat=1");
+  // Bytes between the actions are left alone.
+  CheckMiscPartitionVendorSpaceContent(40, "keep");
+
+  // An invalid action fails the whole batch before anything is written.
+  misc_writers.clear();
+  misc_writers.emplace_back(MiscWriterActions::kClearDarkThemeFlag);
+  misc_writers.emplace_back(MiscWriterActions::kUnset);
+  ASSERT_FALSE(MiscWriter::PerformActions(misc_writers));
+  CheckMiscPartitionVendorSpaceContent(MiscWriter::kThemeFlagOffsetInVendorSpace, "theme-dark");
+
+  // Several actions can't share an override offset.
+  misc_writers.clear();
+  misc_writers.emplace_back(MiscWriterActions::kSetSotaFlag);
+  misc_writers.emplace_back(MiscWriterActions::kWriteTimeFormat, '0');
+  ASSERT_FALSE(MiscWriter::PerformActions(misc_writers, 12360));
+  CheckMiscPartitionVendorSpaceContent(12360, std::string(16, 0));
+}
+
 TEST_F(MiscWriterTest, WriteMiscPartitionVendorSpace) {
   std::string kTestMessage = "kTestMessage";
   std::string err;
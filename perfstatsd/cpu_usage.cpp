@@ -14,29 +14,41 @@
  * limitations under the License.
  */
 
+#define ATRACE_TAG (ATRACE_TAG_POWER | ATRACE_TAG_HAL)
 #define LOG_TAG "perfstatsd_cpu"
 
 #include "cpu_usage.h"
+#include <android/pixel/perfstatsd/IPerfstatsdPrivate.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <string.h>
+#include <unistd.h>
+#include <utils/Trace.h>
 
 using namespace android::pixel::perfstatsd;
 
 static bool cDebug = false;
 static constexpr char FMT_CPU_TOTAL[] =
     "[CPU: %lld.%03llds][T:%.2f%%,U:%.2f%%,S:%.2f%%,IO:%.2f%%]";
+static constexpr char FMT_CPU_SELF[] = "[SELF:%u.%03ums,PIDS:%u]";
+static constexpr char FMT_CPU_CLUSTER[] = "[CLUSTER%u-%u:B:%.2f%%,IO:%.2f%%,IRQ:%.2f%%";
+static constexpr char FMT_CPU_CLUSTER_FREQ[] = ",F:%uMHz,MAX:%.2f%%";
 static constexpr char TOP_HEADER[] = "[CPU_TOP]  PID, PROCESS_NAME, USR_TIME, SYS_TIME\n";
 static constexpr char FMT_TOP_PROFILE[] = "%6.2f%%   %5d %s %" PRIu64 " %" PRIu64 "\n";
 
-CpuUsage::CpuUsage(void) {
+CpuUsage::CpuUsage(std::shared_ptr<ProcessTable> processTable)
+    : RecordStatsType(IPerfstatsdPrivate::STATS_CPU, &CpuUsage::format, &CpuUsage::exportSample),
+      mProcessTable(processTable ? std::move(processTable)
+                                 : std::make_shared<ProcessTable>(getProcRoot(),
+                                                                  CPU_USAGE_PROC_FILES_MAX)) {
     std::string procstat;
-    if (android::base::ReadFileToString("/proc/stat", &procstat)) {
+    if (android::base::ReadFileToString(getProcRoot() + "/stat", &procstat)) {
         std::istringstream stream(procstat);
         std::string line;
         while (getline(stream, line)) {
             std::vector<std::string> fields = android::base::Split(line, " ");
             if (fields[0].find("cpu") != std::string::npos && fields[0] != "cpu") {
-                CpuData data;
+                CpuData data = {};
                 mPrevCoresUsage.push_back(data);
             }
         }
@@ -44,11 +56,52 @@ CpuUsage::CpuUsage(void) {
     mCores = mPrevCoresUsage.size();
     mProfileThreshold = CPU_USAGE_PROFILE_THRESHOLD;
     mTopcount = TOP_PROCESS_COUNT;
+    mDisabled = false;
+    mProfileProcess = false;
+    initClusters();
+}
+
+// Group the cores by their cpufreq policy, from related_cpus
+void CpuUsage::initClusters(void) {
+    std::vector<uint32_t> firstCpus(mCores, UINT32_MAX);
+    for (uint32_t c = 0; c < mCores; c++) {
+        std::string related;
+        if (!android::base::ReadFileToString(
+                "/sys/devices/system/cpu/cpu" + std::to_string(c) + "/cpufreq/related_cpus",
+                &related))
+            continue;
+        uint32_t numCpus = 0;
+        for (const auto &field : android::base::Split(android::base::Trim(related), " ")) {
+            uint32_t cpu;
+            if (android::base::ParseUint(field, &cpu)) {
+                firstCpus[c] = std::min(firstCpus[c], cpu);
+                numCpus++;
+            }
+        }
+        if (!numCpus || std::find(firstCpus.begin(), firstCpus.begin() + c, firstCpus[c]) !=
+                            firstCpus.begin() + c)
+            continue;
+        if (mClusters.size() >= CPU_USAGE_MAX_CLUSTERS) {
+            firstCpus[c] = UINT32_MAX;
+            continue;
+        }
+        mClusters.push_back({firstCpus[c], numCpus, {}});
+    }
+    std::sort(mClusters.begin(), mClusters.end(),
+              [](const CpuCluster &a, const CpuCluster &b) { return a.firstCpu < b.firstCpu; });
+
+    mCoreClusters.assign(mCores, UINT8_MAX);
+    for (uint32_t c = 0; c < mCores; c++) {
+        for (uint32_t i = 0; i < mClusters.size(); i++) {
+            if (mClusters[i].firstCpu == firstCpus[c])
+                mCoreClusters[c] = i;
+        }
+    }
 }
 
 void CpuUsage::setOptions(const std::string &key, const std::string &value) {
     if (key == PROCPROF_THRESHOLD || key == CPU_DISABLED || key == CPU_DEBUG ||
-        key == CPU_TOPCOUNT) {
+        key == CPU_TOPCOUNT || key == CPU_RESCAN || key == CPU_TIME_IN_STATE) {
         uint32_t val = 0;
         if (!base::ParseUint(value, &val)) {
             LOG(ERROR) << "Invalid value: " << value;
@@ -67,189 +120,341 @@ void CpuUsage::setOptions(const std::string &key, const std::string &value) {
         } else if (key == CPU_TOPCOUNT) {
             mTopcount = val;
             LOG(INFO) << "set top count " << mTopcount;
+        } else if (key == CPU_RESCAN) {
+            mRescanPeriods = val;
+            LOG(INFO) << "set rescan periods " << mRescanPeriods;
+        } else if (key == CPU_TIME_IN_STATE) {
+            mTimeInState = (val != 0);
+            LOG(INFO) << "set time in state " << mTimeInState;
         }
     }
 }
 
-void CpuUsage::profileProcess(std::string *out) {
-    // Read cpu usage per process and find the top ones
-    DIR *dir;
-    struct dirent *ent;
-    std::unordered_map<uint32_t, ProcData> procUsage;
+/*
+ * Sample the stat of a process into procList, and return the cpu time it used
+ * since it was last read.
+ */
+uint64_t CpuUsage::sampleProcess(
+    uint32_t pid, std::priority_queue<ProcData, std::vector<ProcData>, ProcdataCompare> *procList) {
+    ProcessInfo info;
+    if (!mProcessTable->sample(pid, ProcessTable::kTimes, &info)) {
+        mPrevProcdata.erase(pid);
+        return 0;
+    }
+    mScannedPids++;
+    uint64_t user = info.utime;
+    uint64_t system = info.stime;
+
+    // A process seen for the first time is charged all it used to this window,
+    // one not read for a few windows the average over them
+    auto it = mPrevProcdata.find(pid);
+    const bool known = it != mPrevProcdata.end();
+    if (!known)
+        it = mPrevProcdata.emplace(pid, ProcSample()).first;
+    ProcSample &sample = it->second;
+    uint64_t diffUser = user - (known ? sample.user : 0);
+    uint64_t diffSystem = system - (known ? sample.system : 0);
+    uint64_t diffUsage = diffUser + diffSystem;
+    uint64_t diffCpu = known ? mPrevUsage.cpuTime - sample.cpuTime : mDiffCpu;
+
+    float usageRatio = diffCpu ? (float)(diffUsage * 100.0 / diffCpu) : 0.0f;
+    if (cDebug && usageRatio > 100) {
+        LOG(INFO) << "pid: " << pid << " , ratio: " << usageRatio
+                  << " , prev usage: " << (known ? sample.user + sample.system : 0)
+                  << " , cur usage: " << user + system << " , total cpu diff: " << diffCpu;
+    }
+    sample.user = user;
+    sample.system = system;
+    sample.cpuTime = mPrevUsage.cpuTime;
+    sample.scan = mScanCount;
+    sample.active = diffUsage > 0;
+
+    ProcData data;
+    data.pid = pid;
+    data.name = std::move(info.comm);
+    data.usageRatio = usageRatio;
+    data.user = diffUser;
+    data.system = diffSystem;
+    procList->push(data);
+    return diffUsage;
+}
+
+/*
+ * Find the top processes. Only those which used cpu time in the previous
+ * window are read again, unless they do not add up to half the busy time of
+ * /proc/stat, or it is time for the periodic full scan. A full scan reads
+ * every process of the ProcessTable, which only walks /proc itself without
+ * the proc connector.
+ */
+bool CpuUsage::profileProcess(std::vector<CpuTopRecord> *tops) {
     std::priority_queue<ProcData, std::vector<ProcData>, ProcdataCompare> procList;
-    if ((dir = opendir("/proc/")) != NULL) {
-        while ((ent = readdir(dir)) != NULL) {
-            if (ent->d_type == DT_DIR) {
-                std::string pidStr = ent->d_name;
-                std::string::const_iterator it = pidStr.begin();
-                while (it != pidStr.end() && isdigit(*it)) ++it;
-                if (!pidStr.empty() && it == pidStr.end()) {
-                    std::string pidStat;
-                    if (android::base::ReadFileToString("/proc/" + pidStr + "/stat", &pidStat)) {
-                        std::vector<std::string> fields = android::base::Split(pidStat, " ");
-                        uint32_t pid = 0;
-                        uint64_t utime = 0;
-                        uint64_t stime = 0;
-                        uint64_t cutime = 0;
-                        uint64_t cstime = 0;
-
-                        if (!base::ParseUint(fields[0], &pid) ||
-                            !base::ParseUint(fields[13], &utime) ||
-                            !base::ParseUint(fields[14], &stime) ||
-                            !base::ParseUint(fields[15], &cutime) ||
-                            !base::ParseUint(fields[16], &cstime)) {
-                            LOG(ERROR) << "Invalid proc data\n" << pidStat;
-                            continue;
-                        }
-                        std::string proc = fields[1];
-                        std::string name =
-                            proc.length() > 2 ? proc.substr(1, proc.length() - 2) : "";
-                        uint64_t user = utime + cutime;
-                        uint64_t system = stime + cstime;
-                        uint64_t totalUsage = user + system;
-
-                        uint64_t diffUser = user - mPrevProcdata[pid].user;
-                        uint64_t diffSystem = system - mPrevProcdata[pid].system;
-                        uint64_t diffUsage = totalUsage - mPrevProcdata[pid].usage;
-
-                        ProcData ldata;
-                        ldata.user = user;
-                        ldata.system = system;
-                        ldata.usage = totalUsage;
-                        procUsage[pid] = ldata;
-
-                        float usageRatio = (float)(diffUsage * 100.0 / mDiffCpu);
-                        if (cDebug && usageRatio > 100) {
-                            LOG(INFO) << "pid: " << pid << " , ratio: " << usageRatio
-                                      << " , prev usage: " << mPrevProcdata[pid].usage
-                                      << " , cur usage: " << totalUsage
-                                      << " , total cpu diff: " << mDiffCpu;
-                        }
-
-                        ProcData data;
-                        data.pid = pid;
-                        data.name = name;
-                        data.usageRatio = usageRatio;
-                        data.user = diffUser;
-                        data.system = diffSystem;
-                        procList.push(data);
-                    }
-                }
-            }
+    mScanCount++;
+    mScannedPids = 0;
+
+    bool fullScan = mPrevProcdata.empty() || mScanCount - mLastFullScan >= mRescanPeriods;
+    if (!fullScan) {
+        mPids.clear();
+        for (const auto &it : mPrevProcdata) {
+            if (it.second.active)
+                mPids.push_back(it.first);
+        }
+        uint64_t accounted = 0;
+        for (uint32_t pid : mPids) accounted += sampleProcess(pid, &procList);
+        // The rest of the busy time went to processes which were idle before
+        fullScan = accounted * 2 < mDiffBusy;
+    }
+
+    if (fullScan) {
+        mProcessTable->update();
+        mProcessTable->pids(&mPids);
+        for (uint32_t pid : mPids) {
+            auto it = mPrevProcdata.find(pid);
+            if (it == mPrevProcdata.end() || it->second.scan != mScanCount)
+                sampleProcess(pid, &procList);
         }
-        mPrevProcdata = std::move(procUsage);
-        out->append(TOP_HEADER);
-        for (uint32_t count = 0; !procList.empty() && count < mTopcount; count++) {
-            ProcData data = procList.top();
-            out->append(android::base::StringPrintf(FMT_TOP_PROFILE, data.usageRatio, data.pid,
-                                                    data.name.c_str(), data.user, data.system));
-            procList.pop();
+        // Forget the processes which exited
+        for (auto it = mPrevProcdata.begin(); it != mPrevProcdata.end();) {
+            if (it->second.scan != mScanCount) {
+                it = mPrevProcdata.erase(it);
+            } else {
+                ++it;
+            }
         }
-        closedir(dir);
-    } else {
-        LOG(ERROR) << "Fail to open /proc/";
+        mLastFullScan = mScanCount;
+    }
+
+    tops->clear();
+    for (uint32_t count = 0; !procList.empty() && count < mTopcount; count++) {
+        const ProcData &data = procList.top();
+        CpuTopRecord top;
+        top.pid = data.pid;
+        top.usageRatio = data.usageRatio;
+        top.user = data.user;
+        top.system = data.system;
+        snprintf(top.name, sizeof(top.name), "%s", data.name.c_str());
+        tops->push_back(top);
+        procList.pop();
+    }
+    return true;
+}
+
+// Parse up to count space separated numbers of [pos, end) into values, returns how many
+static size_t parseNumbers(const char *pos, const char *end, uint64_t *values, size_t count) {
+    size_t n = 0;
+    while (n < count) {
+        while (pos < end && *pos == ' ') pos++;
+        if (pos == end || !isdigit(*pos))
+            break;
+        uint64_t value = 0;
+        for (; pos < end && isdigit(*pos); pos++) value = value * 10 + (*pos - '0');
+        values[n++] = value;
     }
+    return n;
 }
 
-void CpuUsage::getOverallUsage(std::chrono::system_clock::time_point &now, std::string *out) {
+void CpuUsage::getOverallUsage(std::chrono::system_clock::time_point &now, CpuRecord *record) {
     mDiffCpu = 0;
     mTotalRatio = 0.0f;
-    std::string procStat;
 
     // Get overall cpu usage
-    if (android::base::ReadFileToString("/proc/stat", &procStat)) {
-        std::istringstream stream(procStat);
-        std::string line;
-        while (getline(stream, line)) {
-            std::vector<std::string> fields = android::base::Split(line, " ");
-            if (fields[0].find("cpu") != std::string::npos) {
-                std::string cpuStr = fields[0];
-                std::string core = cpuStr.length() > 3 ? cpuStr.substr(3, cpuStr.length() - 3) : "";
-                uint64_t user = 0;
-                uint64_t nice = 0;
-                uint64_t system = 0;
-                uint64_t idle = 0;
-                uint64_t iowait = 0;
-                uint64_t irq = 0;
-                uint64_t softirq = 0;
-                uint64_t steal = 0;
-
-                // cpu  6013 3243 6311 92390 517 693 319 0 0 0  <-- (fields[1] = "")
-                // cpu0 558 139 568 12135 67 121 50 0 0 0
-                uint32_t base = core.compare("") ? 1 : 2;
-
-                if (!base::ParseUint(fields[base], &user) ||
-                    !base::ParseUint(fields[base + 1], &nice) ||
-                    !base::ParseUint(fields[base + 2], &system) ||
-                    !base::ParseUint(fields[base + 3], &idle) ||
-                    !base::ParseUint(fields[base + 4], &iowait) ||
-                    !base::ParseUint(fields[base + 5], &irq) ||
-                    !base::ParseUint(fields[base + 6], &softirq) ||
-                    !base::ParseUint(fields[base + 7], &steal)) {
-                    LOG(ERROR) << "Invalid /proc/stat data\n" << line;
-                    continue;
-                }
-
-                uint64_t cpuTime = user + nice + system + idle + iowait + irq + softirq + steal;
-                uint64_t cpuUsage = cpuTime - idle - iowait;
-                uint64_t userUsage = user + nice;
-
-                if (!core.compare("")) {
-                    uint64_t diffUsage = cpuUsage - mPrevUsage.cpuUsage;
-                    mDiffCpu = cpuTime - mPrevUsage.cpuTime;
-                    uint64_t diffUser = userUsage - mPrevUsage.userUsage;
-                    uint64_t diffSys = system - mPrevUsage.sysUsage;
-                    uint64_t diffIo = iowait - mPrevUsage.ioUsage;
-
-                    mTotalRatio = (float)(diffUsage * 100.0 / mDiffCpu);
-                    float userRatio = (float)(diffUser * 100.0 / mDiffCpu);
-                    float sysRatio = (float)(diffSys * 100.0 / mDiffCpu);
-                    float ioRatio = (float)(diffIo * 100.0 / mDiffCpu);
-
-                    if (cDebug) {
-                        LOG(INFO) << "prev total: " << mPrevUsage.cpuUsage
-                                  << " , cur total: " << cpuUsage << " , diffusage: " << diffUsage
-                                  << " , diffcpu: " << mDiffCpu << " , ratio: " << mTotalRatio;
-                    }
-
-                    mPrevUsage.cpuUsage = cpuUsage;
-                    mPrevUsage.cpuTime = cpuTime;
-                    mPrevUsage.userUsage = userUsage;
-                    mPrevUsage.sysUsage = system;
-                    mPrevUsage.ioUsage = iowait;
-
-                    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - mLast);
-                    out->append(android::base::StringPrintf(FMT_CPU_TOTAL, ms.count() / 1000,
-                                                            ms.count() % 1000, mTotalRatio,
-                                                            userRatio, sysRatio, ioRatio));
-                } else {
-                    // calculate total cpu usage of each core
-                    uint32_t c = 0;
-                    if (!base::ParseUint(core, &c)) {
-                        LOG(ERROR) << "Invalid core: " << core;
-                        continue;
-                    }
-                    uint64_t diffUsage = cpuUsage - mPrevCoresUsage[c].cpuUsage;
-                    float coreTotalRatio = (float)(diffUsage * 100.0 / mDiffCpu);
-                    if (cDebug) {
-                        LOG(INFO) << "core " << c
-                                  << " , prev cpu usage: " << mPrevCoresUsage[c].cpuUsage
-                                  << " , cur cpu usage: " << cpuUsage
-                                  << " , diffusage: " << diffUsage
-                                  << " , difftotalcpu: " << mDiffCpu
-                                  << " , ratio: " << coreTotalRatio;
-                    }
-                    mPrevCoresUsage[c].cpuUsage = cpuUsage;
-
-                    char buf[64];
-                    sprintf(buf, "%.2f%%]", coreTotalRatio);
-                    out->append("[" + core + ":" + std::string(buf));
-                }
+    if (!android::base::ReadFileToString(getProcRoot() + "/stat", &mProcStat)) {
+        LOG(ERROR) << "Fail to read /proc/stat";
+        return;
+    }
+    record->hasStat = true;
+    const char *end = mProcStat.data() + mProcStat.size();
+    for (const char *line = mProcStat.data(); line < end;) {
+        const char *eol = static_cast<const char *>(memchr(line, '\n', end - line));
+        if (!eol)
+            eol = end;
+        const char *pos = line + 3;
+        const char *next = eol + 1;
+        if (eol - line < 4 || memcmp(line, "cpu", 3)) {
+            line = next;
+            continue;
+        }
+        // cpu  6013 3243 6311 92390 517 693 319 0 0 0
+        // cpu0 558 139 568 12135 67 121 50 0 0 0
+        uint64_t c = 0;
+        const bool total = *pos == ' ';
+        if (!total && parseNumbers(pos, eol, &c, 1) != 1) {
+            LOG(ERROR) << "Invalid core: " << std::string(line, eol);
+            line = next;
+            continue;
+        }
+        while (pos < eol && *pos != ' ') pos++;
+        // user, nice, system, idle, iowait, irq, softirq, steal
+        uint64_t fields[8];
+        if (parseNumbers(pos, eol, fields, 8) != 8) {
+            LOG(ERROR) << "Invalid /proc/stat data\n" << std::string(line, eol);
+            line = next;
+            continue;
+        }
+        line = next;
+        const uint64_t user = fields[0], nice = fields[1], system = fields[2], idle = fields[3],
+                       iowait = fields[4], irq = fields[5], softirq = fields[6], steal = fields[7];
+
+        uint64_t cpuTime = user + nice + system + idle + iowait + irq + softirq + steal;
+        uint64_t cpuUsage = cpuTime - idle - iowait;
+        uint64_t userUsage = user + nice;
+
+        if (total) {
+            uint64_t diffUsage = cpuUsage - mPrevUsage.cpuUsage;
+            mDiffCpu = cpuTime - mPrevUsage.cpuTime;
+            mDiffBusy = diffUsage;
+            uint64_t diffUser = userUsage - mPrevUsage.userUsage;
+            uint64_t diffSys = system - mPrevUsage.sysUsage;
+            uint64_t diffIo = iowait - mPrevUsage.ioUsage;
+
+            mTotalRatio = (float)(diffUsage * 100.0 / mDiffCpu);
+            float userRatio = (float)(diffUser * 100.0 / mDiffCpu);
+            float sysRatio = (float)(diffSys * 100.0 / mDiffCpu);
+            float ioRatio = (float)(diffIo * 100.0 / mDiffCpu);
+
+            if (cDebug) {
+                LOG(INFO) << "prev total: " << mPrevUsage.cpuUsage << " , cur total: " << cpuUsage
+                          << " , diffusage: " << diffUsage << " , diffcpu: " << mDiffCpu
+                          << " , ratio: " << mTotalRatio;
             }
+
+            mPrevUsage.cpuUsage = cpuUsage;
+            mPrevUsage.cpuTime = cpuTime;
+            mPrevUsage.userUsage = userUsage;
+            mPrevUsage.sysUsage = system;
+            mPrevUsage.ioUsage = iowait;
+
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - mLast);
+            record->hasTotal = true;
+            record->intervalMs = ms.count();
+            record->totalRatio = mTotalRatio;
+            record->userRatio = userRatio;
+            record->sysRatio = sysRatio;
+            record->ioRatio = ioRatio;
+        } else {
+            // calculate total cpu usage of each core
+            if (c >= mPrevCoresUsage.size())
+                mPrevCoresUsage.resize(c + 1, CpuData());
+            CpuData &prev = mPrevCoresUsage[c];
+            uint64_t diffUsage = cpuUsage - prev.cpuUsage;
+            float coreTotalRatio = (float)(diffUsage * 100.0 / mDiffCpu);
+            if (cDebug) {
+                LOG(INFO) << "core " << c << " , prev cpu usage: " << prev.cpuUsage
+                          << " , cur cpu usage: " << cpuUsage << " , diffusage: " << diffUsage
+                          << " , difftotalcpu: " << mDiffCpu << " , ratio: " << coreTotalRatio;
+            }
+
+            if (record->numCores < CPU_USAGE_MAX_CORES && c <= UINT8_MAX) {
+                const uint8_t i = record->numCores++;
+                record->cores[i] = c;
+                record->coreRatios[i] = coreTotalRatio;
+                record->coreBusy[i] = diffUsage;
+                record->coreIowait[i] = iowait - prev.ioUsage;
+                record->coreIrq[i] = irq + softirq - prev.irqUsage;
+                record->coreTicks[i] = cpuTime - prev.cpuTime;
+            }
+            prev.cpuUsage = cpuUsage;
+            prev.cpuTime = cpuTime;
+            prev.ioUsage = iowait;
+            prev.irqUsage = irq + softirq;
         }
-        out->append("\n");
-    } else {
-        LOG(ERROR) << "Fail to read /proc/stat";
+    }
+    getClusterUsage(record);
+}
+
+// Sum the core usage of record by cluster, with the time in state of each one if enabled
+void CpuUsage::getClusterUsage(CpuRecord *record) {
+    record->numClusters = mClusters.size();
+    for (uint32_t i = 0; i < mClusters.size(); i++) {
+        record->clusters[i].firstCpu = mClusters[i].firstCpu;
+        record->clusters[i].numCpus = mClusters[i].numCpus;
+    }
+    for (uint32_t i = 0; i < record->numCores; i++) {
+        const uint32_t c = record->cores[i];
+        if (c >= mCoreClusters.size() || mCoreClusters[c] >= record->numClusters)
+            continue;
+        CpuClusterRecord &cluster = record->clusters[mCoreClusters[c]];
+        cluster.busy += record->coreBusy[i];
+        cluster.iowait += record->coreIowait[i];
+        cluster.irq += record->coreIrq[i];
+        cluster.ticks += record->coreTicks[i];
+    }
+    for (uint32_t i = 0; i < mClusters.size(); i++) {
+        if (mTimeInState)
+            readTimeInState(&mClusters[i], &record->clusters[i]);
+        else
+            mClusters[i].timeInState.clear();
+    }
+}
+
+// The average frequency of cluster since the last read, and its share at the highest one
+void CpuUsage::readTimeInState(CpuCluster *cluster, CpuClusterRecord *record) {
+    std::string buffer;
+    if (!android::base::ReadFileToString("/sys/devices/system/cpu/cpufreq/policy" +
+                                             std::to_string(cluster->firstCpu) +
+                                             "/stats/time_in_state",
+                                         &buffer))
+        return;
+    // <kHz> <time>, by frequency
+    const bool first = cluster->timeInState.empty();
+    uint64_t total = 0, weighted = 0, maxFreq = 0, atMax = 0;
+    size_t n = 0;
+    const char *end = buffer.data() + buffer.size();
+    for (const char *line = buffer.data(); line < end; n++) {
+        const char *eol = static_cast<const char *>(memchr(line, '\n', end - line));
+        if (!eol)
+            eol = end;
+        uint64_t values[2];
+        if (parseNumbers(line, eol, values, 2) == 2) {
+            if (n >= cluster->timeInState.size())
+                cluster->timeInState.resize(n + 1, {values[0], 0});
+            auto &prev = cluster->timeInState[n];
+            const uint64_t diff = prev.first == values[0] ? values[1] - prev.second : 0;
+            prev = {values[0], values[1]};
+            total += diff;
+            weighted += diff * values[0];
+            if (values[0] >= maxFreq) {
+                maxFreq = values[0];
+                atMax = diff;
+            }
+        }
+        line = eol + 1;
+    }
+    if (first || !total)
+        return;
+    record->avgFreqKhz = weighted / total;
+    record->maxFreqRatio = atMax * 100.0f / total;
+}
+
+/*
+ * Trace record as counters, and its top processes as instant events, for
+ * Perfetto to line them up with ftrace. Only called while atrace is enabled.
+ */
+static void traceRecord(const CpuRecord &record, const std::vector<CpuTopRecord> &tops) {
+    if (record.hasTotal) {
+        ATRACE_INT64("perfstatsd_cpu_total_permille", record.totalRatio * 10);
+        ATRACE_INT64("perfstatsd_cpu_user_permille", record.userRatio * 10);
+        ATRACE_INT64("perfstatsd_cpu_sys_permille", record.sysRatio * 10);
+        ATRACE_INT64("perfstatsd_cpu_io_permille", record.ioRatio * 10);
+    }
+    for (uint32_t i = 0; i < record.numCores; i++) {
+        std::string name = android::base::StringPrintf("perfstatsd_cpu%u_permille", record.cores[i]);
+        ATRACE_INT64(name.c_str(), record.coreRatios[i] * 10);
+    }
+    for (uint32_t i = 0; i < record.numClusters; i++) {
+        const CpuClusterRecord &cluster = record.clusters[i];
+        std::string name =
+            android::base::StringPrintf("perfstatsd_cluster%u_busy_permille", cluster.firstCpu);
+        ATRACE_INT64(name.c_str(), cluster.busy * 1000LL / std::max(cluster.ticks, 1U));
+        if (cluster.avgFreqKhz) {
+            name = android::base::StringPrintf("perfstatsd_cluster%u_avg_khz", cluster.firstCpu);
+            ATRACE_INT64(name.c_str(), cluster.avgFreqKhz);
+        }
+    }
+    ATRACE_INT64("perfstatsd_self_cpu_us", record.selfCpuUs);
+    for (const CpuTopRecord &top : tops) {
+        std::string event = android::base::StringPrintf("%.2f%% %u %s", top.usageRatio, top.pid,
+                                                        top.name);
+        ATRACE_INSTANT_FOR_TRACK("perfstatsd_cpu_top", event.c_str());
     }
 }
 
@@ -257,29 +462,139 @@ void CpuUsage::refresh(void) {
     if (mDisabled)
         return;
 
-    std::string out;
+    CpuRecord record = {};
     std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+    record.time = now;
 
-    getOverallUsage(now, &out);
+    getOverallUsage(now, &record);
 
-    if (mTotalRatio >= mProfileThreshold) {
+    mTops.clear();
+    mScannedPids = 0;
+    if (mProfilingAllowed && mTotalRatio >= mProfileThreshold) {
         if (cDebug)
             LOG(INFO) << "Total CPU usage over " << mProfileThreshold << "%";
-        std::string profileResult;
-        profileProcess(&profileResult);
+        const bool profiled = profileProcess(&mTops);
         if (mProfileProcess) {
             // Dump top processes once met threshold continuously at least twice.
-            out.append(profileResult);
+            record.hasProfile = profiled;
         } else
             mProfileProcess = true;
+        if (!record.hasProfile)
+            mTops.clear();
     } else
         mProfileProcess = false;
 
-    append(now, out);
+    // All perfstatsd did since the last record, this refresh included
+    struct timespec cpu;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+    int64_t selfCpuUs = cpu.tv_sec * 1000000LL + cpu.tv_nsec / 1000;
+    record.selfCpuUs = selfCpuUs - mLastSelfCpuUs;
+    record.scannedPids = mScannedPids;
+    mLastSelfCpuUs = selfCpuUs;
+
+    if (record.hasStat && ATRACE_ENABLED())
+        traceRecord(record, mTops);
+    append(record, mTops);
     mLast = now;
     if (cDebug) {
         auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::system_clock::now() - now);
-        LOG(INFO) << "Took " << ms.count() << " ms, data bytes: " << out.length();
+        LOG(INFO) << "Took " << ms.count() << " ms, read " << mScannedPids
+                  << " processes, top processes: " << mTops.size();
+    }
+}
+
+/*
+ * Sample Log
+ *
+ * [CPU: 10.012s][T:62.31%,U:40.12%,S:20.08%,IO:0.11%][0:70.00%]...[SELF:3.120ms,PIDS:42]
+ * [CLUSTER0-3:B:40.10%,IO:0.20%,IRQ:1.10%,F:1203MHz,MAX:2.00%][CLUSTER4-5:...]...
+ * [CPU_TOP]  PID, PROCESS_NAME, USR_TIME, SYS_TIME
+ *  30.12%    1234 surfaceflinger 120 80
+ */
+void CpuUsage::format(const CpuRecord &record, const CpuTopRecord *tops, std::string *out) {
+    if (!record.hasStat)
+        return;
+    if (record.hasTotal) {
+        android::base::StringAppendF(out, FMT_CPU_TOTAL,
+                                     static_cast<long long>(record.intervalMs / 1000),
+                                     static_cast<long long>(record.intervalMs % 1000),
+                                     record.totalRatio, record.userRatio, record.sysRatio,
+                                     record.ioRatio);
+    }
+    for (uint32_t i = 0; i < record.numCores; i++)
+        android::base::StringAppendF(out, "[%u:%.2f%%]", record.cores[i], record.coreRatios[i]);
+    android::base::StringAppendF(out, FMT_CPU_SELF, record.selfCpuUs / 1000,
+                                 record.selfCpuUs % 1000, record.scannedPids);
+    out->append("\n");
+    for (uint32_t i = 0; i < record.numClusters; i++) {
+        const CpuClusterRecord &cluster = record.clusters[i];
+        const float ticks = std::max(cluster.ticks, 1U);
+        android::base::StringAppendF(out, FMT_CPU_CLUSTER, cluster.firstCpu,
+                                     cluster.firstCpu + cluster.numCpus - 1,
+                                     cluster.busy * 100.0f / ticks,
+                                     cluster.iowait * 100.0f / ticks, cluster.irq * 100.0f / ticks);
+        if (cluster.avgFreqKhz)
+            android::base::StringAppendF(out, FMT_CPU_CLUSTER_FREQ, cluster.avgFreqKhz / 1000,
+                                         cluster.maxFreqRatio);
+        out->append("]");
+    }
+    if (record.numClusters)
+        out->append("\n");
+
+    // The top processes of the oldest records may be overwritten already
+    if (!record.hasProfile || (record.numTops && !tops))
+        return;
+    out->append(TOP_HEADER);
+    for (uint32_t i = 0; i < record.numTops; i++) {
+        android::base::StringAppendF(out, FMT_TOP_PROFILE, tops[i].usageRatio, tops[i].pid,
+                                     tops[i].name, tops[i].user, tops[i].system);
+    }
+}
+
+void CpuUsage::exportSample(const CpuRecord &record, const CpuTopRecord *tops,
+                            StatsHistory *history) {
+    if (!record.hasStat)
+        return;
+    CpuSample sample;
+    sample.timeMs = toEpochMs(record.time);
+    sample.intervalMs = record.intervalMs;
+    sample.hasTotal = record.hasTotal;
+    sample.totalPercent = record.totalRatio;
+    sample.userPercent = record.userRatio;
+    sample.sysPercent = record.sysRatio;
+    sample.ioPercent = record.ioRatio;
+    sample.cores.assign(record.cores, record.cores + record.numCores);
+    sample.corePercents.assign(record.coreRatios, record.coreRatios + record.numCores);
+    sample.coreBusyTicks.assign(record.coreBusy, record.coreBusy + record.numCores);
+    sample.coreIowaitTicks.assign(record.coreIowait, record.coreIowait + record.numCores);
+    sample.coreIrqTicks.assign(record.coreIrq, record.coreIrq + record.numCores);
+    sample.coreTicks.assign(record.coreTicks, record.coreTicks + record.numCores);
+    for (uint32_t i = 0; i < record.numClusters; i++) {
+        const CpuClusterRecord &cluster = record.clusters[i];
+        CpuClusterSample clusterSample;
+        clusterSample.firstCpu = cluster.firstCpu;
+        clusterSample.numCpus = cluster.numCpus;
+        clusterSample.busyTicks = cluster.busy;
+        clusterSample.iowaitTicks = cluster.iowait;
+        clusterSample.irqTicks = cluster.irq;
+        clusterSample.ticks = cluster.ticks;
+        clusterSample.avgFreqKhz = cluster.avgFreqKhz;
+        clusterSample.maxFreqPercent = cluster.maxFreqRatio;
+        sample.clusters.push_back(clusterSample);
+    }
+    sample.selfCpuUs = record.selfCpuUs;
+    sample.scannedPids = record.scannedPids;
+    if (record.hasProfile && tops) {
+        for (uint32_t i = 0; i < record.numTops; i++) {
+            CpuTopSample top;
+            top.pid = tops[i].pid;
+            top.usagePercent = tops[i].usageRatio;
+            top.userTicks = tops[i].user;
+            top.systemTicks = tops[i].system;
+            top.name = tops[i].name;
+            sample.tops.push_back(std::move(top));
+        }
     }
+    history->cpu.push_back(std::move(sample));
 }
@@ -19,14 +19,23 @@
 
 #include <statstype.h>
 
-#define CPU_USAGE_BUFFER_SIZE (6 * 30)
+#include <atomic>
+#include <memory>
+
+#define CPU_USAGE_BUFFER_SIZE (6 * 60)
+#define CPU_USAGE_MAX_CORES (16)
+#define CPU_USAGE_MAX_CLUSTERS (8)
 #define TOP_PROCESS_COUNT (5)
 #define CPU_USAGE_PROFILE_THRESHOLD (50)
+#define CPU_USAGE_RESCAN_PERIODS (10)  // profiled refreshes between full scans of /proc
+#define CPU_USAGE_PROC_FILES_MAX (256)  // stat files the ProcessTable keeps open
 
 #define PROCPROF_THRESHOLD "cpu.procprof.threshold"
 #define CPU_DISABLED "cpu.disabled"
 #define CPU_DEBUG "cpu.debug"
 #define CPU_TOPCOUNT "cpu.topcount"
+#define CPU_RESCAN "cpu.rescan"
+#define CPU_TIME_IN_STATE "cpu.timeinstate"
 
 namespace android {
 namespace pixel {
@@ -38,6 +47,37 @@ struct CpuData {
     uint64_t userUsage;
     uint64_t sysUsage;
     uint64_t ioUsage;
+    uint64_t irqUsage;
+};
+
+// A cpufreq policy, the cores which share a frequency
+struct CpuCluster {
+    uint32_t firstCpu;
+    uint32_t numCpus;
+    // <kHz, time in 10ms> of its time_in_state at the last refresh
+    std::vector<std::pair<uint64_t, uint64_t>> timeInState;
+};
+
+// The usage of a CpuCluster over a CpuRecord, in ticks of all its cores
+struct CpuClusterRecord {
+    uint8_t firstCpu;
+    uint8_t numCpus;
+    uint32_t busy;
+    uint32_t iowait;
+    uint32_t irq;  // irq and softirq
+    uint32_t ticks;
+    // From time_in_state with CPU_TIME_IN_STATE, 0 if not read
+    uint32_t avgFreqKhz;
+    float maxFreqRatio;  // time at the highest frequency
+};
+
+// What CpuUsage knows of a process from the last time it read its stat
+struct ProcSample {
+    uint64_t user;
+    uint64_t system;
+    uint64_t cpuTime;  // the total cpu time of /proc/stat then
+    uint32_t scan;     // the profileProcess() call which read it
+    bool active;       // it used cpu time since the read before
 };
 
 struct ProcData {
@@ -49,11 +89,50 @@ struct ProcData {
     uint64_t system;
 };
 
-class CpuUsage : public StatsType {
+// One CpuUsage sample, see CpuUsage::format()
+struct CpuRecord : RecordHeader {
+    bool hasStat;  // /proc/stat was read
+    bool hasTotal;
+    bool hasProfile;  // the top processes follow
+    uint8_t numCores;
+    uint32_t selfCpuUs;    // cpu time perfstatsd used since the last record
+    uint32_t scannedPids;  // processes whose stat was read for this record
+    int64_t intervalMs;
+    float totalRatio;
+    float userRatio;
+    float sysRatio;
+    float ioRatio;
+    uint8_t cores[CPU_USAGE_MAX_CORES];
+    float coreRatios[CPU_USAGE_MAX_CORES];
+    // Ticks of each of cores busy, in iowait, in irq and softirq, and in total
+    uint32_t coreBusy[CPU_USAGE_MAX_CORES];
+    uint32_t coreIowait[CPU_USAGE_MAX_CORES];
+    uint32_t coreIrq[CPU_USAGE_MAX_CORES];
+    uint32_t coreTicks[CPU_USAGE_MAX_CORES];
+    uint8_t numClusters;
+    CpuClusterRecord clusters[CPU_USAGE_MAX_CLUSTERS];
+};
+
+// One of the top processes of a CpuRecord
+struct CpuTopRecord {
+    uint32_t pid;
+    float usageRatio;
+    uint64_t user;
+    uint64_t system;
+    char name[16];  // the comm of a task is at most 15 characters
+};
+
+struct ProcdataCompare;
+
+class CpuUsage : public RecordStatsType<CpuRecord, CpuTopRecord> {
   public:
-    CpuUsage(void);
+    explicit CpuUsage(std::shared_ptr<ProcessTable> processTable = nullptr);
     void refresh(void);
     void setOptions(const std::string &key, const std::string &value);
+    // Total cpu usage in percent of the last refresh
+    float getTotalRatio(void) const { return mTotalRatio; }
+    // Perfstatsd stops the process profiling while over its own cpu budget
+    void setProfilingAllowed(bool allowed) { mProfilingAllowed = allowed; }
 
   private:
     std::chrono::system_clock::time_point mLast;
@@ -62,13 +141,36 @@ class CpuUsage : public StatsType {
     uint32_t mTopcount;
     bool mDisabled;
     bool mProfileProcess;
+    std::atomic<bool> mProfilingAllowed = true;  // set from other stats threads
+    bool mTimeInState = false;
+    std::string mProcStat;               // reused by every refresh
+    std::vector<CpuCluster> mClusters;   // by first cpu
+    std::vector<uint8_t> mCoreClusters;  // index in mClusters of each core
     CpuData mPrevUsage;                                    // cpu usage of last record
     std::vector<CpuData> mPrevCoresUsage;                  // cpu usage per core of last record
-    std::unordered_map<uint32_t, ProcData> mPrevProcdata;  // <pid, last_usage>
+    std::unordered_map<uint32_t, ProcSample> mPrevProcdata;  // <pid, last_usage>
+    std::shared_ptr<ProcessTable> mProcessTable;
+    std::vector<uint32_t> mPids;  // reused by every profileProcess()
+    uint32_t mScanCount = 0;
+    uint32_t mLastFullScan = 0;
+    uint32_t mRescanPeriods = CPU_USAGE_RESCAN_PERIODS;
+    uint32_t mScannedPids = 0;
     uint64_t mDiffCpu;
+    uint64_t mDiffBusy = 0;  // non-idle cpu time of the window
+    int64_t mLastSelfCpuUs = 0;
     float mTotalRatio;
-    void getOverallUsage(std::chrono::system_clock::time_point &, std::string *);
-    void profileProcess(std::string *);
+    std::vector<CpuTopRecord> mTops;  // reused by every refresh
+    void getOverallUsage(std::chrono::system_clock::time_point &, CpuRecord *);
+    void initClusters(void);
+    void getClusterUsage(CpuRecord *);
+    void readTimeInState(CpuCluster *cluster, CpuClusterRecord *record);
+    bool profileProcess(std::vector<CpuTopRecord> *);
+    uint64_t sampleProcess(
+        uint32_t pid,
+        std::priority_queue<ProcData, std::vector<ProcData>, ProcdataCompare> *procList);
+    static void format(const CpuRecord &record, const CpuTopRecord *tops, std::string *out);
+    static void exportSample(const CpuRecord &record, const CpuTopRecord *tops,
+                             StatsHistory *history);
 };
 
 struct ProcdataCompare {
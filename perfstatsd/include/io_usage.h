@@ -16,30 +16,37 @@
 #ifndef _IO_USAGE_H_
 #define _IO_USAGE_H_
 
+#include <android/pixel/perfstatsd/IPerfstatsdPrivate.h>
 #include <statstype.h>
 #include <chrono>
+#include <memory>
 #include <sstream>
 #include <string>
 
 #include <unordered_map>
 
-#define IO_USAGE_BUFFER_SIZE (6 * 30)
+#define IO_USAGE_BUFFER_SIZE (6 * 60)
 #define IO_TOP_MAX 5
 
 namespace android {
 namespace pixel {
 namespace perfstatsd {
 
+/*
+ * The uid to name mapping of the running processes, from the processes of the
+ * ProcessTable added or changed since the last update().
+ */
 class ProcPidIoStats {
   private:
-    std::chrono::system_clock::time_point mCheckTime;
-    std::vector<uint32_t> mPrevPids;
-    std::vector<uint32_t> mCurrPids;
+    std::shared_ptr<ProcessTable> mProcessTable;
+    uint64_t mSeq = 0;                  // of the ProcessTable at the last update()
+    std::vector<ProcessInfo> mChanged;  // reused by every update()
     std::unordered_map<uint32_t, std::string> mUidNameMapping;
-    // functions
-    std::vector<uint32_t> getNewPids();
 
   public:
+    explicit ProcPidIoStats(std::shared_ptr<ProcessTable> processTable)
+        : mProcessTable(std::move(processTable)) {}
+    // Map the uids of every process with forceAll, not only of those changed
     void update(bool forceAll);
     bool getNameForUid(uint32_t uid, std::string *name);
 };
@@ -88,9 +95,9 @@ struct UserIo {
         return r;
     }
 
-    uint64_t sumWrite() { return fgWrite + bgWrite; }
+    uint64_t sumWrite() const { return fgWrite + bgWrite; }
 
-    uint64_t sumRead() { return fgRead + bgRead; }
+    uint64_t sumRead() const { return fgRead + bgRead; }
 
     void reset() {
         uid = 0;
@@ -125,6 +132,30 @@ class ScopeTimer {
     void dump(std::string *outAppend);
 };
 
+// One IoUsage sample, see IoStats::format()
+struct IoRecord : RecordHeader {
+    int64_t intervalMs;
+    uint64_t read;
+    uint64_t write;
+    uint64_t fsync;
+    // The dump thresholds when the sample was taken
+    uint64_t readMin;
+    uint64_t writeMin;
+    // The first numReadTops top records are the top readers, the rest the top writers
+    uint32_t numReadTops;
+};
+
+// One of the top readers or writers of an IoRecord
+struct IoTopRecord {
+    uint32_t uid;
+    float percent;
+    uint64_t fg;
+    uint64_t bg;
+    uint64_t fgFsync;
+    uint64_t bgFsync;
+    char name[32];  // "-" if not known
+};
+
 constexpr uint64_t IO_USAGE_DUMP_THRESHOLD = 50L * 1000L * 1000L;  // 50MB
 class IoStats {
   private:
@@ -132,38 +163,57 @@ class IoStats {
     uint64_t mMinSizeOfTotalWrite = IO_USAGE_DUMP_THRESHOLD;
     std::chrono::system_clock::time_point mLast;
     std::chrono::system_clock::time_point mNow;
-    std::unordered_map<uint32_t, UserIo> mPrevious;
+    // The counters of the last read in file order, which rarely changes, and
+    // the index of each uid in them, rebuilt when the order does change
+    std::vector<UserIo> mPrevious;
+    std::unordered_map<uint32_t, uint32_t> mPreviousIndex;
+    bool mPreviousIndexValid = false;
     UserIo mTotal;
+    // Min-heaps of the largest writers and readers, sorted largest first by calcAll()
     UserIo mWriteTop[IO_TOP_MAX];
     UserIo mReadTop[IO_TOP_MAX];
+    size_t mNumWriteTop = 0;
+    size_t mNumReadTop = 0;
     std::vector<uint32_t> mUnknownUidList;
     std::unordered_map<uint32_t, std::string> mUidNameMap;
     ProcPidIoStats mProcIoStats;
     // Functions
-    std::unordered_map<uint32_t, UserIo> calcIncrement(
-        const std::unordered_map<uint32_t, UserIo> &data);
-    void updateTopWrite(UserIo usage);
-    void updateTopRead(UserIo usage);
+    const UserIo *findPrevious(size_t index, uint32_t uid);
+    void updateTopWrite(const UserIo &usage);
+    void updateTopRead(const UserIo &usage);
     void updateUnknownUidList();
 
   public:
-    IoStats() {
+    explicit IoStats(std::shared_ptr<ProcessTable> processTable)
+        : mProcIoStats(std::move(processTable)) {
         mNow = std::chrono::system_clock::now();
         mLast = mNow;
     }
-    void calcAll(std::unordered_map<uint32_t, UserIo> &&data);
+    // data holds the counters of each uid, in the order of /proc/uid_io/stats.
+    // It is swapped with the previous counters, leaving storage to reuse.
+    void calcAll(std::vector<UserIo> *data);
     void setDumpThresholdSizeForRead(uint64_t size) { mMinSizeOfTotalRead = size; }
     void setDumpThresholdSizeForWrite(uint64_t size) { mMinSizeOfTotalWrite = size; }
-    bool dump(std::stringstream *output);
+    void dump(IoRecord *record, std::vector<IoTopRecord> *tops);
+    static void format(const IoRecord &record, const IoTopRecord *tops, std::string *out);
+    static void exportSample(const IoRecord &record, const IoTopRecord *tops,
+                             StatsHistory *history);
 };
 
-class IoUsage : public StatsType {
+class IoUsage : public RecordStatsType<IoRecord, IoTopRecord> {
   private:
     bool mDisabled;
     IoStats mStats;
+    std::vector<IoTopRecord> mTops;  // reused by every refresh
+    std::string mBuffer;             // reused by every refresh
+    std::vector<UserIo> mData;       // reused by every refresh
 
   public:
-    IoUsage() : mDisabled(false) {}
+    explicit IoUsage(std::shared_ptr<ProcessTable> processTable = nullptr)
+        : RecordStatsType(IPerfstatsdPrivate::STATS_IO, &IoStats::format, &IoStats::exportSample),
+          mDisabled(false),
+          mStats(processTable ? std::move(processTable)
+                              : std::make_shared<ProcessTable>(getProcRoot())) {}
     void refresh(void);
     void setOptions(const std::string &key, const std::string &value);
 };
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MEM_USAGE_H_
+#define _MEM_USAGE_H_
+
+#include <statstype.h>
+
+#define MEM_USAGE_BUFFER_SIZE (6 * 60)
+#define MEM_ZRAM_MM_STAT "/sys/block/zram0/mm_stat"
+
+#define MEM_DISABLED "mem.disabled"
+#define MEM_DEBUG "mem.debug"
+
+namespace android {
+namespace pixel {
+namespace perfstatsd {
+
+// The /proc/vmstat counters of a MemRecord, summed over their kswapd, direct
+// and khugepaged variants, or anon and file ones
+enum MemCounter {
+    MEM_PGSCAN,
+    MEM_PGSCAN_DIRECT,
+    MEM_PGSTEAL,
+    MEM_COMPACT_STALL,
+    MEM_WORKINGSET_REFAULT,
+    MEM_NUM_COUNTERS,
+};
+
+// One MemUsage sample, see MemUsage::format()
+struct MemRecord : RecordHeader {
+    int64_t intervalMs;
+    bool hasPsi;
+    bool hasVmstat;
+    bool hasZram;
+    // /proc/pressure/memory: avg10 in percent, and the stall time since the last record
+    float someAvg10;
+    float fullAvg10;
+    uint64_t someStallUs;
+    uint64_t fullStallUs;
+    // Deltas since the last record, by MemCounter
+    uint64_t counters[MEM_NUM_COUNTERS];
+    // zram mm_stat: orig_data_size, compr_data_size and mem_used_total
+    uint64_t zramOrigBytes;
+    uint64_t zramComprBytes;
+    uint64_t zramUsedBytes;
+};
+
+// Memory samples have no top records
+struct MemTopRecord {};
+
+/*
+ * Samples memory pressure from /proc/pressure/memory, the reclaim and
+ * compaction counters of /proc/vmstat and the zram mm_stat. Each file is read
+ * into a reused buffer and parsed in one pass, without allocating.
+ */
+class MemUsage : public RecordStatsType<MemRecord, MemTopRecord> {
+  public:
+    MemUsage(void);
+    void refresh(void);
+    void setOptions(const std::string &key, const std::string &value);
+    static void format(const MemRecord &record, const MemTopRecord *tops, std::string *out);
+    static void exportSample(const MemRecord &record, const MemTopRecord *tops,
+                             StatsHistory *history);
+
+  private:
+    bool readPsi(MemRecord *record);
+    bool readVmstat(MemRecord *record);
+    bool readZram(MemRecord *record);
+
+    bool mDisabled = false;
+    bool mDebug = false;
+    std::chrono::system_clock::time_point mLast;
+    std::string mBuffer;  // reused by every read
+    // The totals of the last refresh, 0 until it read them
+    uint64_t mPrevSomeTotalUs = 0;
+    uint64_t mPrevFullTotalUs = 0;
+    uint64_t mPrevCounters[MEM_NUM_COUNTERS] = {};
+    bool mHavePrevPsi = false;
+    bool mHavePrevVmstat = false;
+    std::vector<MemTopRecord> mTops;  // always empty
+};
+
+}  // namespace perfstatsd
+}  // namespace pixel
+}  // namespace android
+
+#endif /* _MEM_USAGE_H_ */
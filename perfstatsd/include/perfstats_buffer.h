@@ -48,37 +48,50 @@ constexpr auto operator""_KiB(unsigned long long const num) {
     return num * 1024;
 }
 
-class StatsData {
-  public:
-    std::chrono::system_clock::time_point getTime() const { return mTime; }
-    std::string getData() const { return mData; }
-    void setTime(std::chrono::system_clock::time_point &time) { mTime = time; }
-    void setData(std::string &data) { mData = data; }
-
-  private:
-    std::chrono::system_clock::time_point mTime;
-    std::string mData;
+// Fields every PerfstatsBuffer record starts with
+struct RecordHeader {
+    std::chrono::system_clock::time_point time;
+    // Sequence number of the first top record of this record, and their count
+    uint64_t firstTop;
+    uint32_t numTops;
 };
 
+/*
+ * A ring of fixed-size plain data records, preallocated by setSize(). Once
+ * full, each new record overwrites the oldest one. Records are copied in and
+ * out without allocating, and only formatted to text when history is read.
+ */
+template <typename Record>
 class PerfstatsBuffer {
   public:
-    size_t size() { return mBufferSize; }
-    size_t count() { return mStorage.size(); }
+    size_t size() const { return mStorage.size(); }
+    size_t count() const { return mCount; }
 
-    void setSize(size_t size) { mBufferSize = size; }
-    void emplace(StatsData &&data);
-    const std::queue<StatsData> &dump(void);
+    // Preallocate size records, dropping the ones held
+    void setSize(size_t size) {
+        mStorage.assign(size, Record());
+        mFirst = 0;
+        mCount = 0;
+    }
+    void emplace(const Record &record) {
+        if (mStorage.empty())
+            return;
+        mStorage[(mFirst + mCount) % mStorage.size()] = record;
+        if (mCount < mStorage.size())
+            mCount++;
+        else
+            mFirst = (mFirst + 1) % mStorage.size();
+    }
+    // Copy the records out, oldest first
+    void dump(std::vector<Record> *out) const {
+        out->resize(mCount);
+        for (size_t i = 0; i < mCount; i++) (*out)[i] = mStorage[(mFirst + i) % mStorage.size()];
+    }
 
   private:
-    size_t mBufferSize = 0U;
-    std::queue<StatsData> mStorage;
-};
-
-struct StatsdataCompare {
-    // sort time in ascending order
-    bool operator()(const StatsData &a, const StatsData &b) const {
-        return a.getTime() > b.getTime();
-    }
+    std::vector<Record> mStorage;
+    size_t mFirst = 0U;
+    size_t mCount = 0U;
 };
 
 }  // namespace perfstatsd
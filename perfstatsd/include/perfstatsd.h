@@ -19,25 +19,94 @@
 
 #include "cpu_usage.h"
 #include "io_usage.h"
+#include "mem_usage.h"
 #include "statstype.h"
 
+#include <condition_variable>
+#include <thread>
+
 #define DEFAULT_DATA_COLLECT_PERIOD (10)  // seconds
-#define PERFSTATSD_PERIOD "perfstatsd.period"
+#define DEFAULT_BURST_PERIOD (1)          // seconds
+#define DEFAULT_BURST_DURATION (10)       // seconds
+#define DEFAULT_BURST_LOAD (80)           // % of total cpu usage, 0 to disable
+#define DEFAULT_IDLE_PERIOD (60)          // seconds
+#define DEFAULT_IDLE_LOAD (10)            // % of total cpu usage
+#define DEFAULT_BUDGET (10)               // permille of one cpu, 0 for no limit
+#define BUDGET_MAX_LEVEL (4)              // no profiling, then periods doubled up to 8 times
+#define BUDGET_RECOVER_REFRESHES (6)      // under half the budget in a row to step back
+#define BUDGET_CHECK_WINDOW (1)           // seconds, at least
+#define PERFSTATSD_PERIOD "perfstatsd.period"  // ".cpu" or ".io" for the period of one type
+#define PERFSTATSD_BURST "perfstatsd.burst"    // seconds of burst to start now
+#define PERFSTATSD_BURST_PERIOD "perfstatsd.burst.period"
+#define PERFSTATSD_BURST_DURATION "perfstatsd.burst.duration"
+#define PERFSTATSD_BURST_LOAD "perfstatsd.burst.load"
+#define PERFSTATSD_IDLE_PERIOD "perfstatsd.idle.period"
+#define PERFSTATSD_IDLE_LOAD "perfstatsd.idle.load"
+#define PERFSTATSD_BUDGET "perfstatsd.budget"
+// Bursts while not "0", e.g. set by a PropertyNode of the Power HAL during launch hints
+#define PERFSTATSD_BURST_PROP "vendor.perfstatsd.burst"
+#define HISTORY_CHUNK_SIZE (16_KiB)  // bytes written at once by writeHistory()
 
 namespace android {
 namespace pixel {
 namespace perfstatsd {
 
+/*
+ * Refreshes each stats type on its own thread and period. A burst samples every type at
+ * least every mBurstPeriod for a while, started by PERFSTATSD_BURST,
+ * PERFSTATSD_BURST_PROP or a cpu usage of mBurstLoad or more. While the cpu
+ * usage stays under mIdleLoad, the periods double at each cpu refresh up to
+ * mIdlePeriod.
+ *
+ * When the refreshes use more than mBudget of a cpu, process profiling stops,
+ * then the periods double, one level at a time until it is back under budget.
+ */
 class Perfstatsd : public RefBase {
   private:
-    std::list<std::unique_ptr<StatsType>> mStats;
+    struct Schedule {
+        std::unique_ptr<StatsType> stats;
+        std::string name;  // of its PERFSTATSD_PERIOD option
+        uint32_t period;   // seconds, 0 for mRefreshPeriod
+        std::chrono::steady_clock::time_point last;
+    };
+    std::list<Schedule> mStats;
+    CpuUsage *mCpuUsage;  // in mStats, its usage drives bursts and idle periods
+    // Guards the scheduling below, shared by the stats threads and set by the
+    // binder and property threads too
+    std::mutex mMutex;
+    std::condition_variable mWakeup;
+    uint64_t mWakeups = 0;  // counts the notifications of mWakeup
     uint32_t mRefreshPeriod;
+    uint32_t mBurstPeriod = DEFAULT_BURST_PERIOD;
+    uint32_t mBurstDuration = DEFAULT_BURST_DURATION;
+    uint32_t mBurstLoad = DEFAULT_BURST_LOAD;
+    uint32_t mIdlePeriod = DEFAULT_IDLE_PERIOD;
+    uint32_t mIdleLoad = DEFAULT_IDLE_LOAD;
+    bool mBurstHint = false;  // PERFSTATSD_BURST_PROP is set
+    std::chrono::steady_clock::time_point mBurstUntil;
+    uint32_t mIdleCount = 0;  // cpu refreshes in a row under mIdleLoad
+    uint32_t mBudget = DEFAULT_BUDGET;
+    uint32_t mBudgetLevel = 0;  // of BUDGET_MAX_LEVEL, 0 while within budget
+    uint32_t mUnderBudgetCount = 0;
+    // cpu time of the refreshes since the last budget check, and when that was
+    int64_t mBudgetCpuUs = 0;
+    std::chrono::steady_clock::time_point mBudgetCheck;
+    std::chrono::steady_clock::duration getPeriod(const Schedule &schedule,
+                                                  std::chrono::steady_clock::time_point now);
+    void burst(std::chrono::steady_clock::time_point until);
+    void refresh(Schedule *schedule);
+    void runSchedule(Schedule *schedule);
+    void checkBudget(std::chrono::steady_clock::time_point now);
+    bool setSchedulingOption(const std::string &key, const std::string &value);
+    void formatHistory(std::string *out, const std::function<bool(std::string *)> &flush);
 
   public:
     Perfstatsd(void);
-    void refresh(void);
-    void pause(void) { sleep(mRefreshPeriod); }
+    void run(void);
+    void watchBurstProperty(void);
     void getHistory(std::string *ret);
+    int64_t writeHistory(int fd);
+    void queryHistory(int64_t startMs, int64_t endMs, int32_t typeMask, StatsHistory *history);
     void setOptions(const std::string &key, const std::string &value);
 };
 
@@ -19,6 +19,7 @@
 
 #include <binder/BinderService.h>
 #include <binder/IPCThreadState.h>
+#include <binder/ParcelFileDescriptor.h>
 #include <binder/ProcessState.h>
 #include "android/pixel/perfstatsd/BnPerfstatsdPrivate.h"
 
@@ -34,6 +35,10 @@ class PerfstatsdPrivateService : public android::BinderService<PerfstatsdPrivate
 
     android::binder::Status dumpHistory(std::string *_aidl_return);
     android::binder::Status setOptions(const std::string &key, const std::string &value);
+    android::binder::Status queryHistory(int64_t startMs, int64_t endMs, int32_t typeMask,
+                                         StatsHistory *_aidl_return);
+    android::binder::Status writeHistory(const android::os::ParcelFileDescriptor &fd,
+                                         int64_t *_aidl_return);
 };
 
 android::sp<IPerfstatsdPrivate> getPerfstatsdPrivateService();
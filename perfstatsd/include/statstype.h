@@ -17,47 +17,131 @@
 #ifndef _STATSTYPE_H_
 #define _STATSTYPE_H_
 
+#include <android/pixel/perfstatsd/StatsHistory.h>
 #include <perfstats_buffer.h>
+#include <pixelproctable/ProcessTable.h>
 
 namespace android {
 namespace pixel {
 namespace perfstatsd {
 
+// The proc filesystem the stats are read from, "/proc" but in benchmarks
+const std::string &getProcRoot();
+void setProcRoot(const std::string &root);
+
+// The processes of getProcRoot(), shared by the stats types which need them
+using ::android::hardware::google::pixel::ProcessInfo;
+using ::android::hardware::google::pixel::ProcessTable;
+
+// A record time as the milliseconds since the epoch of StatsHistory samples
+inline int64_t toEpochMs(std::chrono::system_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+}
+
+// The records of a StatsType copied out of its buffers, oldest first
+class StatsSnapshot {
+  public:
+    virtual ~StatsSnapshot() = default;
+    virtual size_t count() const = 0;
+    virtual std::chrono::system_clock::time_point getTime(size_t index) const = 0;
+    // Append the text of the index-th record
+    virtual void format(size_t index, std::string *out) const = 0;
+    // Append the index-th record as a sample to its list of history
+    virtual void exportSample(size_t index, StatsHistory *history) const = 0;
+};
+
 class StatsType : public RefBase {
   public:
+    // The IPerfstatsdPrivate::STATS_* type of the samples
+    virtual int32_t type() const = 0;
     virtual void refresh() = 0;
     virtual void setOptions(const std::string &, const std::string &) = 0;
-    void dump(std::priority_queue<StatsData, std::vector<StatsData>, StatsdataCompare> *queue) {
+    virtual void setBufferSize(size_t size) = 0;
+    virtual std::unique_ptr<StatsSnapshot> snapshot() = 0;
+};
+
+/*
+ * A StatsType whose samples are a Record, each with the TopRecords of the
+ * processes or users that stood out in it. The top records go to a ring of
+ * their own, a quarter the size of the records' as most samples have none;
+ * the tops of the oldest records may be overwritten before the records.
+ */
+template <typename Record, typename TopRecord>
+class RecordStatsType : public StatsType {
+  public:
+    // Append the text of record. tops holds its record.numTops top records,
+    // nullptr if they were overwritten.
+    using Formatter = void (*)(const Record &record, const TopRecord *tops, std::string *out);
+    // Append record as a sample to its list of history, tops as for Formatter
+    using Exporter = void (*)(const Record &record, const TopRecord *tops, StatsHistory *history);
+
+    int32_t type() const override { return mType; }
+
+    void setBufferSize(size_t size) override {
         std::unique_lock<std::mutex> mlock(mMutex);
-        std::queue<StatsData> buffer = mBuffer.dump();
-        while (!buffer.empty()) {
-            queue->push(buffer.front());
-            buffer.pop();
-        }
+        mRecords.setSize(size);
+        mTops.setSize(size / 4);
+    }
+    std::unique_ptr<StatsSnapshot> snapshot() override {
+        std::unique_ptr<Snapshot> snapshot(new Snapshot(mFormatter, mExporter));
+        std::unique_lock<std::mutex> mlock(mMutex);
+        mRecords.dump(&snapshot->mRecords);
+        mTops.dump(&snapshot->mTops);
+        snapshot->mFirstTop = mNextTop - snapshot->mTops.size();
+        return snapshot;
     }
-    size_t bufferSize() { return mBuffer.size(); }
-    void setBufferSize(size_t size) { mBuffer.setSize(size); }
-    size_t bufferCount() { return mBuffer.count(); }
 
   protected:
-    void append(StatsData &&data) {
+    RecordStatsType(int32_t type, Formatter formatter, Exporter exporter)
+        : mType(type), mFormatter(formatter), mExporter(exporter) {}
+
+    void append(Record record, const std::vector<TopRecord> &tops) {
         std::unique_lock<std::mutex> mlock(mMutex);
-        mBuffer.emplace(std::forward<StatsData>(data));
-    }
-    void append(std::chrono::system_clock::time_point &time, std::string &content) {
-        StatsData data;
-        data.setTime(time);
-        data.setData(content);
-        append(std::move(data));
-    }
-    void append(std::string &content) {
-        std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
-        append(now, content);
+        record.firstTop = mNextTop;
+        record.numTops = tops.size();
+        for (const TopRecord &top : tops) mTops.emplace(top);
+        mNextTop += tops.size();
+        mRecords.emplace(record);
     }
 
   private:
-    PerfstatsBuffer mBuffer;
+    class Snapshot : public StatsSnapshot {
+      public:
+        Snapshot(Formatter formatter, Exporter exporter)
+            : mFormatter(formatter), mExporter(exporter) {}
+        size_t count() const override { return mRecords.size(); }
+        std::chrono::system_clock::time_point getTime(size_t index) const override {
+            return mRecords[index].time;
+        }
+        void format(size_t index, std::string *out) const override {
+            mFormatter(mRecords[index], getTops(mRecords[index]), out);
+        }
+        void exportSample(size_t index, StatsHistory *history) const override {
+            mExporter(mRecords[index], getTops(mRecords[index]), history);
+        }
+        // The top records of record, nullptr if they were overwritten
+        const TopRecord *getTops(const Record &record) const {
+            const bool haveTops = record.firstTop >= mFirstTop &&
+                                  record.firstTop + record.numTops <= mFirstTop + mTops.size();
+            return haveTops ? mTops.data() + (record.firstTop - mFirstTop) : nullptr;
+        }
+
+        const Formatter mFormatter;
+        const Exporter mExporter;
+        std::vector<Record> mRecords;
+        std::vector<TopRecord> mTops;
+        // Sequence number of mTops[0]
+        uint64_t mFirstTop;
+    };
+
+    const int32_t mType;
+    const Formatter mFormatter;
+    const Exporter mExporter;
     std::mutex mMutex;
+    PerfstatsBuffer<Record> mRecords;
+    PerfstatsBuffer<TopRecord> mTops;
+    // Sequence number of the next top record
+    uint64_t mNextTop = 0U;
 };
 
 }  // namespace perfstatsd
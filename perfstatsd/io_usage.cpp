@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#define ATRACE_TAG (ATRACE_TAG_POWER | ATRACE_TAG_HAL)
 #define LOG_TAG "perfstatsd_io"
 
 #include "io_usage.h"
@@ -23,9 +24,13 @@
 #include <cutils/android_filesystem_config.h>
 #include <inttypes.h>
 #include <pwd.h>
+#include <string.h>
+#include <unistd.h>
+#include <utils/Trace.h>
+#include <algorithm>
 
 using namespace android::pixel::perfstatsd;
-static constexpr const char *UID_IO_STATS_PATH = "/proc/uid_io/stats";
+static constexpr const char *UID_IO_STATS_PATH = "/uid_io/stats";  // under getProcRoot()
 static constexpr char FMT_STR_TOTAL_USAGE[] =
     "[IO_TOTAL: %lld.%03llds] RD:%s WR:%s fsync:%" PRIu64 "\n";
 static constexpr char STR_TOP_HEADER[] =
@@ -73,86 +78,13 @@ static bool isAppUid(uint32_t uid) {
     return false;
 }
 
-std::vector<uint32_t> ProcPidIoStats::getNewPids() {
-    std::vector<uint32_t> newpids;
-    // Not exists in Previous
-    for (int i = 0, len = mCurrPids.size(); i < len; i++) {
-        if (std::find(mPrevPids.begin(), mPrevPids.end(), mCurrPids[i]) == mPrevPids.end()) {
-            newpids.push_back(mCurrPids[i]);
-        }
-    }
-    return newpids;
-}
-
 void ProcPidIoStats::update(bool forceAll) {
     ScopeTimer _debugTimer("update: /proc/pid/status for UID/Name mapping");
     _debugTimer.setEnabled(sOptDebug);
-    if (forceAll) {
-        mPrevPids.clear();
-    } else {
-        mPrevPids = mCurrPids;
-    }
-    // Get current pid list
-    mCurrPids.clear();
-    DIR *dir;
-    struct dirent *ent;
-    if ((dir = opendir("/proc/")) == NULL) {
-        LOG(ERROR) << "failed on opendir '/proc/'";
-        return;
-    }
-    while ((ent = readdir(dir)) != NULL) {
-        if (ent->d_type == DT_DIR) {
-            uint32_t pid;
-            if (android::base::ParseUint(ent->d_name, &pid)) {
-                mCurrPids.push_back(pid);
-            }
-        }
-    }
-    std::vector<uint32_t> newpids = getNewPids();
-    // update mUidNameMapping only for new pids
-    for (int i = 0, len = newpids.size(); i < len; i++) {
-        uint32_t pid = newpids[i];
-        std::string buffer;
-        if (!android::base::ReadFileToString("/proc/" + std::to_string(pid) + "/status", &buffer)) {
-            if (sOptDebug)
-                LOG(INFO) << "/proc/" << std::to_string(pid) << "/status"
-                          << ": ReadFileToString failed (process died?)";
-            continue;
-        }
-        // --- Find Name ---
-        size_t s = buffer.find("Name:");
-        if (s == std::string::npos) {
-            continue;
-        }
-        s += std::strlen("Name:");
-        // find the pos of next word
-        while (buffer[s] && isspace(buffer[s])) s++;
-        if (buffer[s] == 0) {
-            continue;
-        }
-        size_t e = s;
-        // find the end pos of the word
-        while (buffer[e] && !std::isspace(buffer[e])) e++;
-        std::string pname(buffer, s, e - s);
-
-        // --- Find Uid ---
-        s = buffer.find("\nUid:", e);
-        if (s == std::string::npos) {
-            continue;
-        }
-        s += std::strlen("\nUid:");
-        // find the pos of next word
-        while (buffer[s] && isspace(buffer[s])) s++;
-        if (buffer[s] == 0) {
-            continue;
-        }
-        e = s;
-        // find the end pos of the word
-        while (buffer[e] && !std::isspace(buffer[e])) e++;
-        std::string strUid(buffer, s, e - s);
-
-        uint32_t uid = (uint32_t)std::stoi(strUid);
-        mUidNameMapping[uid] = pname;
+    mProcessTable->update();
+    mSeq = mProcessTable->changedSince(forceAll ? 0 : mSeq, &mChanged);
+    for (const ProcessInfo &info : mChanged) {
+        mUidNameMapping[info.uid] = info.comm;
     }
 }
 
@@ -164,27 +96,31 @@ bool ProcPidIoStats::getNameForUid(uint32_t uid, std::string *name) {
     return false;
 }
 
-void IoStats::updateTopRead(UserIo usage) {
-    UserIo tmp;
-    for (int i = 0, len = IO_TOP_MAX; i < len; i++) {
-        if (usage.sumRead() > mReadTop[i].sumRead()) {
-            // if new read > old read, then swap values
-            tmp = mReadTop[i];
-            mReadTop[i] = usage;
-            usage = tmp;
-        }
+void IoStats::updateTopRead(const UserIo &usage) {
+    const auto greater = [](const UserIo &a, const UserIo &b) { return a.sumRead() > b.sumRead(); };
+    if (mNumReadTop < IO_TOP_MAX) {
+        mReadTop[mNumReadTop++] = usage;
+        std::push_heap(mReadTop, mReadTop + mNumReadTop, greater);
+    } else if (usage.sumRead() > mReadTop[0].sumRead()) {
+        // replace the smallest of the tops
+        std::pop_heap(mReadTop, mReadTop + IO_TOP_MAX, greater);
+        mReadTop[IO_TOP_MAX - 1] = usage;
+        std::push_heap(mReadTop, mReadTop + IO_TOP_MAX, greater);
     }
 }
 
-void IoStats::updateTopWrite(UserIo usage) {
-    UserIo tmp;
-    for (int i = 0, len = IO_TOP_MAX; i < len; i++) {
-        if (usage.sumWrite() > mWriteTop[i].sumWrite()) {
-            // if new write > old write, then swap values
-            tmp = mWriteTop[i];
-            mWriteTop[i] = usage;
-            usage = tmp;
-        }
+void IoStats::updateTopWrite(const UserIo &usage) {
+    const auto greater = [](const UserIo &a, const UserIo &b) {
+        return a.sumWrite() > b.sumWrite();
+    };
+    if (mNumWriteTop < IO_TOP_MAX) {
+        mWriteTop[mNumWriteTop++] = usage;
+        std::push_heap(mWriteTop, mWriteTop + mNumWriteTop, greater);
+    } else if (usage.sumWrite() > mWriteTop[0].sumWrite()) {
+        // replace the smallest of the tops
+        std::pop_heap(mWriteTop, mWriteTop + IO_TOP_MAX, greater);
+        mWriteTop[IO_TOP_MAX - 1] = usage;
+        std::push_heap(mWriteTop, mWriteTop + IO_TOP_MAX, greater);
     }
 }
 
@@ -234,37 +170,32 @@ void IoStats::updateUnknownUidList() {
     mUnknownUidList.clear();
 }
 
-std::unordered_map<uint32_t, UserIo> IoStats::calcIncrement(
-    const std::unordered_map<uint32_t, UserIo> &data) {
-    std::unordered_map<uint32_t, UserIo> diffs;
-    for (const auto &it : data) {
-        const UserIo &d = it.second;
-        // If data not existed, copy one, else calculate the increment.
-        if (mPrevious.find(d.uid) == mPrevious.end()) {
-            diffs[d.uid] = d;
-        } else {
-            diffs[d.uid] = d - mPrevious[d.uid];
-        }
-        // If uid not existed in UidNameMap, then add into unknown list
-        if ((diffs[d.uid].sumRead() || diffs[d.uid].sumWrite()) &&
-            mUidNameMap.find(d.uid) == mUidNameMap.end()) {
-            mUnknownUidList.push_back(d.uid);
+// The previous counters of uid, found at index when the order of the file did not change
+const UserIo *IoStats::findPrevious(size_t index, uint32_t uid) {
+    if (index < mPrevious.size() && mPrevious[index].uid == uid) {
+        return &mPrevious[index];
+    }
+    if (!mPreviousIndexValid) {
+        mPreviousIndex.clear();
+        for (uint32_t i = 0, len = mPrevious.size(); i < len; i++) {
+            mPreviousIndex[mPrevious[i].uid] = i;
         }
+        mPreviousIndexValid = true;
     }
-    // update Uid/Name mapping for dump()
-    updateUnknownUidList();
-    return diffs;
+    auto it = mPreviousIndex.find(uid);
+    return it == mPreviousIndex.end() ? nullptr : &mPrevious[it->second];
 }
 
-void IoStats::calcAll(std::unordered_map<uint32_t, UserIo> &&data) {
+void IoStats::calcAll(std::vector<UserIo> *data) {
     // if mList == mNow, it's in init state.
     if (mLast == mNow) {
-        mPrevious = std::move(data);
+        mPrevious.swap(*data);
+        mPreviousIndexValid = false;
         mLast = mNow;
         mNow = std::chrono::system_clock::now();
         mProcIoStats.update(true);
-        for (const auto &d : data) {
-            mUnknownUidList.push_back(d.first);
+        for (const auto &d : *data) {
+            mUnknownUidList.push_back(d.uid);
         }
         updateUnknownUidList();
         return;
@@ -272,27 +203,90 @@ void IoStats::calcAll(std::unordered_map<uint32_t, UserIo> &&data) {
     mLast = mNow;
     mNow = std::chrono::system_clock::now();
 
-    // calculate incremental IO throughput
-    std::unordered_map<uint32_t, UserIo> amounts = calcIncrement(data);
-    // assign current data to Previous for next calculating
-    mPrevious = std::move(data);
     // Reset Total and Tops
     mTotal.reset();
-    for (int i = 0, len = IO_TOP_MAX; i < len; i++) {
-        mReadTop[i].reset();
-        mWriteTop[i].reset();
-    }
-    for (const auto &it : amounts) {
-        const UserIo &d = it.second;
+    mNumReadTop = 0;
+    mNumWriteTop = 0;
+    // calculate incremental IO throughput
+    bool reordered = data->size() != mPrevious.size();
+    for (size_t i = 0, len = data->size(); i < len; i++) {
+        const UserIo &d = (*data)[i];
+        const UserIo *prev = findPrevious(i, d.uid);
+        reordered |= prev != mPrevious.data() + i;
+        // If data not existed, copy one, else calculate the increment.
+        const UserIo diff = prev ? d - *prev : d;
         // Add into total
-        mTotal = mTotal + d;
+        mTotal = mTotal + diff;
+        if (!diff.sumRead() && !diff.sumWrite()) {
+            continue;
+        }
+        // If uid not existed in UidNameMap, then add into unknown list
+        if (mUidNameMap.find(d.uid) == mUidNameMap.end()) {
+            mUnknownUidList.push_back(d.uid);
+        }
         // Check if it's top
-        updateTopRead(d);
-        updateTopWrite(d);
+        if (diff.sumRead()) {
+            updateTopRead(diff);
+        }
+        if (diff.sumWrite()) {
+            updateTopWrite(diff);
+        }
+    }
+    // update Uid/Name mapping for dump()
+    updateUnknownUidList();
+    std::sort_heap(mReadTop, mReadTop + mNumReadTop,
+                   [](const UserIo &a, const UserIo &b) { return a.sumRead() > b.sumRead(); });
+    std::sort_heap(mWriteTop, mWriteTop + mNumWriteTop,
+                   [](const UserIo &a, const UserIo &b) { return a.sumWrite() > b.sumWrite(); });
+    // keep current data as Previous for next calculating
+    mPrevious.swap(*data);
+    if (reordered) {
+        mPreviousIndexValid = false;
+    }
+}
+
+// Take the last calcAll() as a record and its top readers and writers
+void IoStats::dump(IoRecord *record, std::vector<IoTopRecord> *tops) {
+    record->intervalMs =
+        std::chrono::duration_cast<std::chrono::milliseconds>(mNow - mLast).count();
+    record->read = mTotal.sumRead();
+    record->write = mTotal.sumWrite();
+    record->fsync = mTotal.fgFsync + mTotal.bgFsync;
+    record->readMin = mMinSizeOfTotalRead;
+    record->writeMin = mMinSizeOfTotalWrite;
+
+    const auto addTop = [&](const UserIo &target, float percent, uint64_t fg, uint64_t bg) {
+        IoTopRecord top;
+        top.uid = target.uid;
+        top.percent = percent;
+        top.fg = fg;
+        top.bg = bg;
+        top.fgFsync = target.fgFsync;
+        top.bgFsync = target.bgFsync;
+        auto name = mUidNameMap.find(target.uid);
+        snprintf(top.name, sizeof(top.name), "%s",
+                 name == mUidNameMap.end() ? "-" : name->second.c_str());
+        tops->push_back(top);
+    };
+    tops->clear();
+    if (mTotal.sumRead() >= mMinSizeOfTotalRead) {
+        for (size_t i = 0; i < mNumReadTop; i++) {
+            const UserIo &target = mReadTop[i];
+            addTop(target, 100.0f * target.sumRead() / mTotal.sumRead(), target.fgRead,
+                   target.bgRead);
+        }
+    }
+    record->numReadTops = tops->size();
+    if (mTotal.sumWrite() >= mMinSizeOfTotalWrite) {
+        for (size_t i = 0; i < mNumWriteTop; i++) {
+            const UserIo &target = mWriteTop[i];
+            addTop(target, 100.0f * target.sumWrite() / mTotal.sumWrite(), target.fgWrite,
+                   target.bgWrite);
+        }
     }
 }
 
-/* Dump IO usage (Sample Log)
+/* Format an IO usage record (Sample Log)
  *
  * [IO_TOTAL: 10.160s] RD:371,703,808 WR:15,929,344 fsync:567
  * [TOP Usage ]    fg bytes,    bg bytes,fgsyn,bgsyn :  UID   NAME
@@ -307,80 +301,118 @@ void IoStats::calcAll(std::unordered_map<uint32_t, UserIo> &&data) {
  * [W4:  8.13%]      667648,      401408,   23,   20 : 10061 android.vending
  * [W5:  5.35%]           0,      704512,    0,   25 : 10055 -
  *
+ * The top readers and writers of the oldest records may be overwritten already,
+ * they are left out then.
  */
-bool IoStats::dump(std::stringstream *output) {
-    std::stringstream &out = (*output);
-
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(mNow - mLast);
+void IoStats::format(const IoRecord &record, const IoTopRecord *tops, std::string *out) {
     char readTotal[32];
     char writeTotal[32];
-    if (!formatNum(mTotal.sumRead(), readTotal, 32)) {
-        LOG(ERROR) << "formatNum buffer size is too small for read: " << mTotal.sumRead();
+    if (!formatNum(record.read, readTotal, 32)) {
+        LOG(ERROR) << "formatNum buffer size is too small for read: " << record.read;
     }
-    if (!formatNum(mTotal.sumWrite(), writeTotal, 32)) {
-        LOG(ERROR) << "formatNum buffer size is too small for write: " << mTotal.sumWrite();
+    if (!formatNum(record.write, writeTotal, 32)) {
+        LOG(ERROR) << "formatNum buffer size is too small for write: " << record.write;
     }
 
-    out << android::base::StringPrintf(FMT_STR_TOTAL_USAGE, ms.count() / 1000, ms.count() % 1000,
-                                       readTotal, writeTotal, mTotal.fgFsync + mTotal.bgFsync);
+    android::base::StringAppendF(out, FMT_STR_TOTAL_USAGE,
+                                 static_cast<long long>(record.intervalMs / 1000),
+                                 static_cast<long long>(record.intervalMs % 1000), readTotal,
+                                 writeTotal, record.fsync);
 
-    if (mTotal.sumRead() >= mMinSizeOfTotalRead || mTotal.sumWrite() >= mMinSizeOfTotalWrite) {
-        out << STR_TOP_HEADER;
+    if (record.read >= record.readMin || record.write >= record.writeMin) {
+        out->append(STR_TOP_HEADER);
     }
     // Dump READ TOP
-    if (mTotal.sumRead() < mMinSizeOfTotalRead) {
-        out << android::base::StringPrintf(FMT_STR_SKIP_TOP_READ, mMinSizeOfTotalRead / 1000000)
-            << std::endl;
-    } else {
-        for (int i = 0, len = IO_TOP_MAX; i < len; i++) {
-            UserIo &target = mReadTop[i];
-            if (target.sumRead() == 0) {
-                break;
-            }
-            float percent = 100.0f * target.sumRead() / mTotal.sumRead();
-            const char *package = mUidNameMap.find(target.uid) == mUidNameMap.end()
-                                      ? "-"
-                                      : mUidNameMap[target.uid].c_str();
-            out << android::base::StringPrintf(FMT_STR_TOP_READ_USAGE, i + 1, percent,
-                                               target.fgRead, target.bgRead, target.fgFsync,
-                                               target.bgFsync, target.uid, package);
+    if (record.read < record.readMin) {
+        android::base::StringAppendF(out, FMT_STR_SKIP_TOP_READ, record.readMin / 1000000);
+        out->append("\n");
+    } else if (tops) {
+        for (uint32_t i = 0; i < record.numReadTops; i++) {
+            const IoTopRecord &top = tops[i];
+            android::base::StringAppendF(out, FMT_STR_TOP_READ_USAGE, i + 1, top.percent, top.fg,
+                                         top.bg, top.fgFsync, top.bgFsync, top.uid, top.name);
         }
     }
 
     // Dump WRITE TOP
-    if (mTotal.sumWrite() < mMinSizeOfTotalWrite) {
-        out << android::base::StringPrintf(FMT_STR_SKIP_TOP_WRITE, mMinSizeOfTotalWrite / 1000000)
-            << std::endl;
-    } else {
-        for (int i = 0, len = IO_TOP_MAX; i < len; i++) {
-            UserIo &target = mWriteTop[i];
-            if (target.sumWrite() == 0) {
-                break;
-            }
-            float percent = 100.0f * target.sumWrite() / mTotal.sumWrite();
-            const char *package = mUidNameMap.find(target.uid) == mUidNameMap.end()
-                                      ? "-"
-                                      : mUidNameMap[target.uid].c_str();
-            out << android::base::StringPrintf(FMT_STR_TOP_WRITE_USAGE, i + 1, percent,
-                                               target.fgWrite, target.bgWrite, target.fgFsync,
-                                               target.bgFsync, target.uid, package);
+    if (record.write < record.writeMin) {
+        android::base::StringAppendF(out, FMT_STR_SKIP_TOP_WRITE, record.writeMin / 1000000);
+        out->append("\n");
+    } else if (tops) {
+        for (uint32_t i = record.numReadTops; i < record.numTops; i++) {
+            const IoTopRecord &top = tops[i];
+            android::base::StringAppendF(out, FMT_STR_TOP_WRITE_USAGE, i - record.numReadTops + 1,
+                                         top.percent, top.fg, top.bg, top.fgFsync, top.bgFsync,
+                                         top.uid, top.name);
+        }
+    }
+}
+
+void IoStats::exportSample(const IoRecord &record, const IoTopRecord *tops,
+                           StatsHistory *history) {
+    IoSample sample;
+    sample.timeMs = toEpochMs(record.time);
+    sample.intervalMs = record.intervalMs;
+    sample.readBytes = record.read;
+    sample.writeBytes = record.write;
+    sample.fsync = record.fsync;
+    for (uint32_t i = 0; tops && i < record.numTops; i++) {
+        IoTopSample top;
+        top.uid = tops[i].uid;
+        top.percent = tops[i].percent;
+        top.fgBytes = tops[i].fg;
+        top.bgBytes = tops[i].bg;
+        top.fgFsync = tops[i].fgFsync;
+        top.bgFsync = tops[i].bgFsync;
+        top.name = tops[i].name;
+        (i < record.numReadTops ? sample.readTops : sample.writeTops).push_back(std::move(top));
+    }
+    history->io.push_back(std::move(sample));
+}
+
+// Parse the next space separated number of [*pos, end) into value
+static bool parseField(const char **pos, const char *end, uint64_t *value) {
+    const char *p = *pos;
+    while (p < end && *p == ' ') p++;
+    if (p == end || !isdigit(*p)) {
+        return false;
+    }
+    uint64_t v = 0;
+    for (; p < end && isdigit(*p); p++) {
+        uint64_t digit = *p - '0';
+        if (v > (UINT64_MAX - digit) / 10) {
+            return false;
         }
+        v = v * 10 + digit;
     }
+    if (p < end && *p != ' ') {
+        return false;
+    }
+    *pos = p;
+    *value = v;
     return true;
 }
 
-static bool loadDataFromLine(std::string &&line, UserIo &data) {
-    std::vector<std::string> fields = android::base::Split(line, " ");
-    if (fields.size() < 11 || !android::base::ParseUint(fields[0], &data.uid) ||
-        !android::base::ParseUint(fields[3], &data.fgRead) ||
-        !android::base::ParseUint(fields[4], &data.fgWrite) ||
-        !android::base::ParseUint(fields[7], &data.bgRead) ||
-        !android::base::ParseUint(fields[8], &data.bgWrite) ||
-        !android::base::ParseUint(fields[9], &data.fgFsync) ||
-        !android::base::ParseUint(fields[10], &data.bgFsync)) {
-        LOG(WARNING) << "Invalid uid I/O stats: \"" << line << "\"";
+/* Load a line of /proc/uid_io/stats, without copying it:
+ * uid fgRchar fgWchar fgRead fgWrite bgRchar bgWchar bgRead bgWrite fgFsync bgFsync
+ */
+static bool loadDataFromLine(const char *line, const char *end, UserIo *data) {
+    uint64_t fields[11];
+    for (uint64_t &field : fields) {
+        if (!parseField(&line, end, &field)) {
+            return false;
+        }
+    }
+    if (fields[0] > UINT32_MAX) {
         return false;
     }
+    data->uid = fields[0];
+    data->fgRead = fields[3];
+    data->fgWrite = fields[4];
+    data->bgRead = fields[7];
+    data->bgWrite = fields[8];
+    data->fgFsync = fields[9];
+    data->bgFsync = fields[10];
     return true;
 }
 
@@ -428,35 +460,62 @@ void IoUsage::setOptions(const std::string &key, const std::string &value) {
     }
 }
 
+/*
+ * Trace record as counters, and its top readers and writers as instant events,
+ * for Perfetto to line them up with ftrace. Only called while atrace is enabled.
+ */
+static void traceRecord(const IoRecord &record, const std::vector<IoTopRecord> &tops) {
+    ATRACE_INT64("perfstatsd_io_read_bytes", record.read);
+    ATRACE_INT64("perfstatsd_io_write_bytes", record.write);
+    ATRACE_INT64("perfstatsd_io_fsync", record.fsync);
+    for (uint32_t i = 0; i < tops.size(); i++) {
+        const IoTopRecord &top = tops[i];
+        std::string event = android::base::StringPrintf(
+            "%s %.2f%% %u %s fg:%" PRIu64 " bg:%" PRIu64, i < record.numReadTops ? "R" : "W",
+            top.percent, top.uid, top.name, top.fg, top.bg);
+        ATRACE_INSTANT_FOR_TRACK("perfstatsd_io_top", event.c_str());
+    }
+}
+
 void IoUsage::refresh(void) {
     if (mDisabled)
         return;
     ScopeTimer _debugTimer("refresh");
     _debugTimer.setEnabled(sOptDebug);
-    std::string buffer;
-    if (!android::base::ReadFileToString(UID_IO_STATS_PATH, &buffer)) {
-        LOG(ERROR) << UID_IO_STATS_PATH << ": ReadFileToString failed";
+    if (!android::base::ReadFileToString(getProcRoot() + UID_IO_STATS_PATH, &mBuffer)) {
+        LOG(ERROR) << getProcRoot() << UID_IO_STATS_PATH << ": ReadFileToString failed";
     }
     if (sOptDebug)
-        LOG(INFO) << "read " << UID_IO_STATS_PATH << " OK.";
-    std::vector<std::string> lines = android::base::Split(std::move(buffer), "\n");
-    std::unordered_map<uint32_t, UserIo> datas;
-    for (uint32_t i = 0; i < lines.size(); i++) {
-        if (lines[i].empty()) {
-            continue;
+        LOG(INFO) << "read " << getProcRoot() << UID_IO_STATS_PATH << " OK.";
+    mData.clear();
+    const char *end = mBuffer.data() + mBuffer.size();
+    for (const char *line = mBuffer.data(); line < end;) {
+        const char *eol = static_cast<const char *>(memchr(line, '\n', end - line));
+        if (!eol) {
+            eol = end;
         }
         UserIo data;
-        if (!loadDataFromLine(std::move(lines[i]), data))
-            continue;
-        datas[data.uid] = data;
+        if (eol != line) {
+            if (loadDataFromLine(line, eol, &data)) {
+                mData.push_back(data);
+            } else {
+                LOG(WARNING) << "Invalid uid I/O stats: \"" << std::string(line, eol) << "\"";
+            }
+        }
+        line = eol + 1;
     }
-    mStats.calcAll(std::move(datas));
-    std::stringstream out;
-    mStats.dump(&out);
-    const std::string &str = out.str();
+    mStats.calcAll(&mData);
+    IoRecord record = {};
+    record.time = std::chrono::system_clock::now();
+    mStats.dump(&record, &mTops);
     if (sOptDebug) {
+        std::string str;
+        record.numTops = mTops.size();
+        IoStats::format(record, mTops.data(), &str);
         LOG(INFO) << str;
         LOG(INFO) << "output append length:" << str.length();
     }
-    append((std::string &)str);
+    if (ATRACE_ENABLED())
+        traceRecord(record, mTops);
+    append(record, mTops);
 }
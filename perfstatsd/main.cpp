@@ -18,6 +18,7 @@
 
 #include <perfstatsd.h>
 #include <perfstatsd_service.h>
+#include <signal.h>
 
 enum MODE { DUMP_HISTORY, SET_OPTION };
 
@@ -26,11 +27,11 @@ android::sp<Perfstatsd> perfstatsdSp;
 void *perfstatsdMain(void *) {
     LOG(INFO) << "main thread started";
     perfstatsdSp = new Perfstatsd();
+    std::thread propertyThread(&Perfstatsd::watchBurstProperty, perfstatsdSp.get());
+    pthread_setname_np(propertyThread.native_handle(), "perfstatsd_prop");
+    propertyThread.detach();
 
-    while (true) {
-        perfstatsdSp->refresh();
-        perfstatsdSp->pause();
-    }
+    perfstatsdSp->run();
     return NULL;
 }
 
@@ -46,6 +47,9 @@ void help(char **argv) {
 }
 
 int startService(void) {
+    // writeHistory() reports a reader gone away as a write error
+    signal(SIGPIPE, SIG_IGN);
+
     pthread_t perfstatsdMainThread;
     errno = pthread_create(&perfstatsdMainThread, NULL, perfstatsdMain, NULL);
     if (errno != 0) {
@@ -81,8 +85,24 @@ int serviceCall(int mode, const std::string &key, const std::string &value) {
 
     switch (mode) {
         case DUMP_HISTORY: {
-            std::string history;
             LOG(INFO) << "dump perfstats history.";
+            // Have the service stream the history to stdout, rather than return it at once
+            int64_t written = 0;
+            fflush(stdout);
+            android::base::unique_fd out(dup(STDOUT_FILENO));
+            if (out >= 0 &&
+                perfstatsdPrivateService
+                    ->writeHistory(android::os::ParcelFileDescriptor(std::move(out)), &written)
+                    .isOk()) {
+                if (written <= 0) {
+                    LOG(ERROR) << "perf stats history is not available";
+                    fprintf(stdout, "perf stats history is not available\n");
+                    return -1;
+                }
+                fprintf(stdout, "\n");
+                break;
+            }
+            std::string history;
             if (!perfstatsdPrivateService->dumpHistory(&history).isOk() || history.empty()) {
                 PLOG(ERROR) << "perf stats history is not available";
                 fprintf(stdout, "perf stats history is not available\n");
@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG (ATRACE_TAG_POWER | ATRACE_TAG_HAL)
+#define LOG_TAG "perfstatsd_mem"
+
+#include "mem_usage.h"
+#include <android/pixel/perfstatsd/IPerfstatsdPrivate.h>
+#include <android-base/file.h>
+#include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
+#include <inttypes.h>
+#include <utils/Trace.h>
+
+using namespace android::pixel::perfstatsd;
+
+static constexpr char FMT_MEM_PSI[] =
+    "[MEM: %lld.%03llds][PSI:SOME:%.2f%%,FULL:%.2f%%,STALL:%" PRIu64 ".%03" PRIu64
+    "ms,%" PRIu64 ".%03" PRIu64 "ms]";
+static constexpr char FMT_MEM_VMSTAT[] =
+    "[RECLAIM:SCAN:%" PRIu64 ",DIRECT:%" PRIu64 ",STEAL:%" PRIu64 ",COMPACT_STALL:%" PRIu64
+    ",REFAULT:%" PRIu64 "]";
+static constexpr char FMT_MEM_ZRAM[] = "[ZRAM:ORIG:%" PRIu64 "MB,COMPR:%" PRIu64 "MB,USED:%" PRIu64
+                                       "MB]";
+
+// The /proc/vmstat lines summed into each MemCounter
+static const struct {
+    const char *name;
+    MemCounter counter;
+} VMSTAT_COUNTERS[] = {
+    {"pgscan_kswapd", MEM_PGSCAN},
+    {"pgscan_direct", MEM_PGSCAN},
+    {"pgscan_khugepaged", MEM_PGSCAN},
+    {"pgscan_direct", MEM_PGSCAN_DIRECT},
+    {"pgsteal_kswapd", MEM_PGSTEAL},
+    {"pgsteal_direct", MEM_PGSTEAL},
+    {"pgsteal_khugepaged", MEM_PGSTEAL},
+    {"compact_stall", MEM_COMPACT_STALL},
+    // Split into anon and file since 5.9
+    {"workingset_refault", MEM_WORKINGSET_REFAULT},
+    {"workingset_refault_anon", MEM_WORKINGSET_REFAULT},
+    {"workingset_refault_file", MEM_WORKINGSET_REFAULT},
+};
+
+MemUsage::MemUsage(void)
+    : RecordStatsType(IPerfstatsdPrivate::STATS_MEM, &MemUsage::format, &MemUsage::exportSample) {}
+
+void MemUsage::setOptions(const std::string &key, const std::string &value) {
+    if (key == MEM_DISABLED || key == MEM_DEBUG) {
+        uint32_t val = 0;
+        if (!base::ParseUint(value, &val)) {
+            LOG(ERROR) << "Invalid value: " << value;
+            return;
+        }
+
+        if (key == MEM_DISABLED) {
+            mDisabled = (val != 0);
+            LOG(INFO) << "set disabled " << mDisabled;
+        } else if (key == MEM_DEBUG) {
+            mDebug = (val != 0);
+            LOG(INFO) << "set debug " << mDebug;
+        }
+    }
+}
+
+// Parse the decimal number at *pos, moving *pos past it
+static bool parseNumber(const char **pos, const char *end, uint64_t *value) {
+    const char *p = *pos;
+    while (p < end && *p == ' ') p++;
+    if (p == end || !isdigit(*p))
+        return false;
+    uint64_t v = 0;
+    for (; p < end && isdigit(*p); p++) v = v * 10 + (*p - '0');
+    *pos = p;
+    *value = v;
+    return true;
+}
+
+// The value after key in [line, eol), eol if there is no key
+static const char *findValue(const char *line, const char *eol, const char *key) {
+    const size_t len = strlen(key);
+    const char *found = static_cast<const char *>(memmem(line, eol - line, key, len));
+    return found ? found + len : eol;
+}
+
+// The counter of a cumulative total since the last one, 0 if it went back
+static uint64_t delta(uint64_t now, uint64_t prev) {
+    return now >= prev ? now - prev : 0;
+}
+
+/*
+ * "some avg10=0.00 avg60=0.00 avg300=0.00 total=0" then the same for "full",
+ * which the kernel may leave out
+ */
+bool MemUsage::readPsi(MemRecord *record) {
+    if (!android::base::ReadFileToString(getProcRoot() + "/pressure/memory", &mBuffer))
+        return false;
+    const char *end = mBuffer.data() + mBuffer.size();
+    uint64_t someTotal = 0, fullTotal = 0;
+    bool haveSome = false;
+    for (const char *line = mBuffer.data(); line < end;) {
+        const char *eol = static_cast<const char *>(memchr(line, '\n', end - line));
+        if (!eol)
+            eol = end;
+        const bool some = eol - line > 5 && !memcmp(line, "some ", 5);
+        const bool full = eol - line > 5 && !memcmp(line, "full ", 5);
+        const char *avg10 = findValue(line, eol, "avg10=");
+        const char *total = findValue(line, eol, "total=");
+        uint64_t whole, value;
+        if ((some || full) && parseNumber(&avg10, eol, &whole) &&
+            parseNumber(&total, eol, &value)) {
+            // The ten second average is "%lu.%02lu", not worth strtof()
+            float average = whole;
+            if (avg10 + 2 < eol && avg10[0] == '.' && isdigit(avg10[1]) && isdigit(avg10[2]))
+                average += ((avg10[1] - '0') * 10 + (avg10[2] - '0')) / 100.0f;
+            if (some) {
+                record->someAvg10 = average;
+                someTotal = value;
+                haveSome = true;
+            } else {
+                record->fullAvg10 = average;
+                fullTotal = value;
+            }
+        }
+        line = eol + 1;
+    }
+    if (!haveSome) {
+        LOG(ERROR) << "Invalid /proc/pressure/memory\n" << mBuffer;
+        return false;
+    }
+    if (mHavePrevPsi) {
+        record->someStallUs = delta(someTotal, mPrevSomeTotalUs);
+        record->fullStallUs = delta(fullTotal, mPrevFullTotalUs);
+    }
+    mPrevSomeTotalUs = someTotal;
+    mPrevFullTotalUs = fullTotal;
+    mHavePrevPsi = true;
+    return true;
+}
+
+// The "<name> <value>" lines of VMSTAT_COUNTERS, the deltas since the last read
+bool MemUsage::readVmstat(MemRecord *record) {
+    if (!android::base::ReadFileToString(getProcRoot() + "/vmstat", &mBuffer))
+        return false;
+    uint64_t counters[MEM_NUM_COUNTERS] = {};
+    const char *end = mBuffer.data() + mBuffer.size();
+    for (const char *line = mBuffer.data(); line < end;) {
+        const char *eol = static_cast<const char *>(memchr(line, '\n', end - line));
+        if (!eol)
+            eol = end;
+        const char *space = static_cast<const char *>(memchr(line, ' ', eol - line));
+        const size_t len = space ? space - line : 0;
+        uint64_t value;
+        // Most lines are none of ours, and only the names need comparing for them
+        for (const auto &vmstat : VMSTAT_COUNTERS) {
+            if (len && !strncmp(line, vmstat.name, len) && vmstat.name[len] == '\0') {
+                const char *pos = space;
+                if (parseNumber(&pos, eol, &value))
+                    counters[vmstat.counter] += value;
+            }
+        }
+        line = eol + 1;
+    }
+    if (mHavePrevVmstat) {
+        for (int i = 0; i < MEM_NUM_COUNTERS; i++)
+            record->counters[i] = delta(counters[i], mPrevCounters[i]);
+    }
+    memcpy(mPrevCounters, counters, sizeof(counters));
+    const bool havePrev = mHavePrevVmstat;
+    mHavePrevVmstat = true;
+    return havePrev;
+}
+
+// orig_data_size compr_data_size mem_used_total ..., in bytes
+bool MemUsage::readZram(MemRecord *record) {
+    if (!android::base::ReadFileToString(MEM_ZRAM_MM_STAT, &mBuffer))
+        return false;
+    const char *pos = mBuffer.data();
+    const char *end = pos + mBuffer.size();
+    return parseNumber(&pos, end, &record->zramOrigBytes) &&
+           parseNumber(&pos, end, &record->zramComprBytes) &&
+           parseNumber(&pos, end, &record->zramUsedBytes);
+}
+
+static void traceRecord(const MemRecord &record) {
+    if (record.hasPsi) {
+        ATRACE_INT64("perfstatsd_mem_psi_some_permille", record.someAvg10 * 10);
+        ATRACE_INT64("perfstatsd_mem_psi_full_permille", record.fullAvg10 * 10);
+        ATRACE_INT64("perfstatsd_mem_psi_some_stall_us", record.someStallUs);
+        ATRACE_INT64("perfstatsd_mem_psi_full_stall_us", record.fullStallUs);
+    }
+    if (record.hasVmstat) {
+        ATRACE_INT64("perfstatsd_mem_pgscan", record.counters[MEM_PGSCAN]);
+        ATRACE_INT64("perfstatsd_mem_pgscan_direct", record.counters[MEM_PGSCAN_DIRECT]);
+        ATRACE_INT64("perfstatsd_mem_pgsteal", record.counters[MEM_PGSTEAL]);
+        ATRACE_INT64("perfstatsd_mem_compact_stall", record.counters[MEM_COMPACT_STALL]);
+        ATRACE_INT64("perfstatsd_mem_refault", record.counters[MEM_WORKINGSET_REFAULT]);
+    }
+    if (record.hasZram)
+        ATRACE_INT64("perfstatsd_mem_zram_used_kb", record.zramUsedBytes / 1024);
+}
+
+void MemUsage::refresh(void) {
+    if (mDisabled)
+        return;
+
+    MemRecord record = {};
+    record.time = std::chrono::system_clock::now();
+    if (mLast.time_since_epoch().count())
+        record.intervalMs =
+            std::chrono::duration_cast<std::chrono::milliseconds>(record.time - mLast).count();
+    mLast = record.time;
+
+    record.hasPsi = readPsi(&record);
+    record.hasVmstat = readVmstat(&record);
+    record.hasZram = readZram(&record);
+    if (mDebug) {
+        std::string out;
+        format(record, nullptr, &out);
+        LOG(INFO) << out;
+    }
+    if (ATRACE_ENABLED())
+        traceRecord(record);
+    append(record, mTops);
+}
+
+void MemUsage::format(const MemRecord &record, const MemTopRecord *, std::string *out) {
+    if (!record.hasPsi && !record.hasVmstat && !record.hasZram)
+        return;
+    if (record.hasPsi) {
+        android::base::StringAppendF(out, FMT_MEM_PSI,
+                                     static_cast<long long>(record.intervalMs / 1000),
+                                     static_cast<long long>(record.intervalMs % 1000),
+                                     record.someAvg10, record.fullAvg10, record.someStallUs / 1000,
+                                     record.someStallUs % 1000, record.fullStallUs / 1000,
+                                     record.fullStallUs % 1000);
+    }
+    if (record.hasVmstat) {
+        android::base::StringAppendF(
+            out, FMT_MEM_VMSTAT, record.counters[MEM_PGSCAN], record.counters[MEM_PGSCAN_DIRECT],
+            record.counters[MEM_PGSTEAL], record.counters[MEM_COMPACT_STALL],
+            record.counters[MEM_WORKINGSET_REFAULT]);
+    }
+    if (record.hasZram) {
+        android::base::StringAppendF(out, FMT_MEM_ZRAM, record.zramOrigBytes >> 20,
+                                     record.zramComprBytes >> 20, record.zramUsedBytes >> 20);
+    }
+    out->append("\n");
+}
+
+void MemUsage::exportSample(const MemRecord &record, const MemTopRecord *,
+                            StatsHistory *history) {
+    if (!record.hasPsi && !record.hasVmstat && !record.hasZram)
+        return;
+    MemSample sample;
+    sample.timeMs = toEpochMs(record.time);
+    sample.intervalMs = record.intervalMs;
+    sample.hasPsi = record.hasPsi;
+    sample.psiSomeAvg10 = record.someAvg10;
+    sample.psiFullAvg10 = record.fullAvg10;
+    sample.psiSomeStallUs = record.someStallUs;
+    sample.psiFullStallUs = record.fullStallUs;
+    sample.hasVmstat = record.hasVmstat;
+    sample.pgscan = record.counters[MEM_PGSCAN];
+    sample.pgscanDirect = record.counters[MEM_PGSCAN_DIRECT];
+    sample.pgsteal = record.counters[MEM_PGSTEAL];
+    sample.compactStall = record.counters[MEM_COMPACT_STALL];
+    sample.workingsetRefault = record.counters[MEM_WORKINGSET_REFAULT];
+    sample.hasZram = record.hasZram;
+    sample.zramOrigBytes = record.zramOrigBytes;
+    sample.zramComprBytes = record.zramComprBytes;
+    sample.zramUsedBytes = record.zramUsedBytes;
+    history->mem.push_back(std::move(sample));
+}
@@ -16,72 +16,359 @@
 
 #define LOG_TAG "perfstatsd"
 
+#include <android-base/properties.h>
 #include <perfstatsd.h>
+#include <sys/system_properties.h>
 
 using namespace android::pixel::perfstatsd;
 
+static std::string sProcRoot = "/proc";
+
+const std::string &android::pixel::perfstatsd::getProcRoot() {
+    return sProcRoot;
+}
+
+void android::pixel::perfstatsd::setProcRoot(const std::string &root) {
+    sProcRoot = root;
+}
+
 Perfstatsd::Perfstatsd(void) {
     mRefreshPeriod = DEFAULT_DATA_COLLECT_PERIOD;
 
-    std::unique_ptr<StatsType> cpuUsage(new CpuUsage);
+    // One table, and one walk of /proc, for the cpu and io stats
+    auto processTable = std::make_shared<ProcessTable>(getProcRoot(), CPU_USAGE_PROC_FILES_MAX);
+    mCpuUsage = new CpuUsage(processTable);
+    std::unique_ptr<StatsType> cpuUsage(mCpuUsage);
     cpuUsage->setBufferSize(CPU_USAGE_BUFFER_SIZE);
-    mStats.emplace_back(std::move(cpuUsage));
+    mStats.push_back({std::move(cpuUsage), "cpu", 0, {}});
 
-    std::unique_ptr<StatsType> ioUsage(new IoUsage);
+    std::unique_ptr<StatsType> ioUsage(new IoUsage(processTable));
     ioUsage->setBufferSize(IO_USAGE_BUFFER_SIZE);
-    mStats.emplace_back(std::move(ioUsage));
+    mStats.push_back({std::move(ioUsage), "io", 0, {}});
+
+    std::unique_ptr<StatsType> memUsage(new MemUsage);
+    memUsage->setBufferSize(MEM_USAGE_BUFFER_SIZE);
+    mStats.push_back({std::move(memUsage), "mem", 0, {}});
+}
+
+// The period of schedule at now, with mMutex held
+std::chrono::steady_clock::duration Perfstatsd::getPeriod(
+    const Schedule &schedule, std::chrono::steady_clock::time_point now) {
+    uint32_t period = schedule.period ? schedule.period : mRefreshPeriod;
+    if (now < mBurstUntil)
+        period = std::min(period, mBurstPeriod);
+    // Back off while idle, doubling the period up to mIdlePeriod
+    for (uint32_t i = 0; i < mIdleCount && period < mIdlePeriod && now >= mBurstUntil; i++)
+        period = std::min(period * 2, mIdlePeriod);
+    // Over budget with process profiling stopped already
+    if (mBudgetLevel > 1)
+        period <<= mBudgetLevel - 1;
+    return std::chrono::seconds(period);
+}
+
+// Burst until the given time at least, and wake up the stats threads for it
+void Perfstatsd::burst(std::chrono::steady_clock::time_point until) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (until <= mBurstUntil)
+        return;
+    if (std::chrono::steady_clock::now() >= mBurstUntil)
+        LOG(INFO) << "burst sampling";
+    mBurstUntil = until;
+    mWakeups++;
+    mWakeup.notify_all();
+}
+
+static int64_t threadCpuUs(void) {
+    struct timespec cpu;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+    return cpu.tv_sec * 1000000LL + cpu.tv_nsec / 1000;
+}
+
+/*
+ * Step the budget level up when the refreshes since the last check went over
+ * budget. The stats threads refresh close together, so a check spans
+ * BUDGET_CHECK_WINDOW at least.
+ */
+void Perfstatsd::checkBudget(std::chrono::steady_clock::time_point now) {
+    auto wallUs = std::chrono::duration_cast<std::chrono::microseconds>(now - mBudgetCheck);
+    const bool first = mBudgetCheck == std::chrono::steady_clock::time_point();
+    if (!first && wallUs < std::chrono::seconds(BUDGET_CHECK_WINDOW))
+        return;
+    const int64_t cpuUs = mBudgetCpuUs;
+    mBudgetCheck = now;
+    mBudgetCpuUs = 0;
+    if (first)
+        return;
+    if (!mBudget) {
+        if (mBudgetLevel) {
+            LOG(INFO) << "budget: no limit, process profiling resumed";
+            mBudgetLevel = 0;
+            mCpuUsage->setProfilingAllowed(true);
+        }
+        return;
+    }
+
+    const uint32_t level = mBudgetLevel;
+    const int64_t cost = cpuUs * 1000 / wallUs.count();  // permille of a cpu
+    if (cost > mBudget) {
+        mUnderBudgetCount = 0;
+        mBudgetLevel = std::min(mBudgetLevel + 1, static_cast<uint32_t>(BUDGET_MAX_LEVEL));
+    } else if (mBudgetLevel && cost * 2 < mBudget &&
+               ++mUnderBudgetCount >= BUDGET_RECOVER_REFRESHES) {
+        mUnderBudgetCount = 0;
+        mBudgetLevel--;
+    }
+    if (mBudgetLevel == level)
+        return;
+    if (mBudgetLevel > level)
+        LOG(WARNING) << "over budget, used " << cpuUs << "us of cpu in " << wallUs.count()
+                     << "us: " << cost << " > " << mBudget << " permille";
+    else
+        LOG(INFO) << "back under budget: " << cost << " permille";
+    if (mBudgetLevel == 0)
+        LOG(INFO) << "budget: process profiling resumed";
+    else if (mBudgetLevel == 1)
+        LOG(WARNING) << "budget: process profiling stopped";
+    else
+        LOG(WARNING) << "budget: periods multiplied by " << (1U << (mBudgetLevel - 1));
+    mCpuUsage->setProfilingAllowed(mBudgetLevel == 0);
+}
+
+// Refresh the stats type of schedule, on its own thread
+void Perfstatsd::refresh(Schedule *schedule) {
+    auto now = std::chrono::steady_clock::now();
+    const int64_t startCpuUs = threadCpuUs();
+    schedule->stats->refresh();
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    schedule->last = now;
+    mBudgetCpuUs += threadCpuUs() - startCpuUs;
+    checkBudget(now);
+    if (schedule->stats.get() != mCpuUsage)
+        return;
+
+    float load = mCpuUsage->getTotalRatio();
+    if (load < mIdleLoad)
+        mIdleCount = std::min(mIdleCount + 1, 32U);
+    else
+        mIdleCount = 0;
+    if ((mBurstLoad && load >= mBurstLoad) || mBurstHint) {
+        // Wake up the other types, asleep for their periods before the burst
+        if (now >= mBurstUntil) {
+            mWakeups++;
+            mWakeup.notify_all();
+        }
+        mBurstUntil = std::max(mBurstUntil, now + std::chrono::seconds(mBurstDuration));
+    }
 }
 
-void Perfstatsd::refresh(void) {
-    for (auto const &stats : mStats) {
-        stats->refresh();
+// Refresh the stats type of schedule whenever it is due, never returns
+void Perfstatsd::runSchedule(Schedule *schedule) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            auto now = std::chrono::steady_clock::now();
+            while (now < schedule->last + getPeriod(*schedule, now)) {
+                // Sleep again for a burst or new periods
+                const uint64_t wakeups = mWakeups;
+                mWakeup.wait_until(lock, schedule->last + getPeriod(*schedule, now),
+                                   [&] { return mWakeups != wakeups; });
+                now = std::chrono::steady_clock::now();
+            }
+        }
+        refresh(schedule);
     }
-    return;
 }
 
-void Perfstatsd::getHistory(std::string *ret) {
-    std::priority_queue<StatsData, std::vector<StatsData>, StatsdataCompare> mergedQueue;
-    for (auto const &stats : mStats) {
-        stats->dump(&mergedQueue);
+/*
+ * Run each stats type on a thread of its own, so that a slow refresh of one
+ * does not delay the others or skew their record times. Never returns.
+ */
+void Perfstatsd::run(void) {
+    std::vector<std::thread> threads;
+    for (auto &schedule : mStats) {
+        threads.emplace_back(&Perfstatsd::runSchedule, this, &schedule);
+        std::string name = "perfstatsd_" + schedule.name;
+        pthread_setname_np(threads.back().native_handle(), name.c_str());
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+// Burst while PERFSTATSD_BURST_PROP is set, never returns
+void Perfstatsd::watchBurstProperty(void) {
+    base::WaitForPropertyCreation(PERFSTATSD_BURST_PROP);
+    const prop_info *pi = __system_property_find(PERFSTATSD_BURST_PROP);
+    uint32_t serial = 0;
+    while (__system_property_wait(pi, serial, &serial, nullptr)) {
+        std::string value = base::GetProperty(PERFSTATSD_BURST_PROP, "0");
+        bool hint = !value.empty() && value != "0";
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mBurstHint = hint;
+        }
+        if (hint)
+            burst(std::chrono::steady_clock::now() + std::chrono::seconds(mBurstDuration));
+    }
+    PLOG(ERROR) << "failed to wait for " << PERFSTATSD_BURST_PROP;
+}
+
+/*
+ * Format the history into *out, the records of every stats type merged by
+ * time. With a flush, it is called whenever out holds HISTORY_CHUNK_SIZE
+ * bytes or more, and once at the end, to take them; formatting stops when it
+ * returns false.
+ */
+void Perfstatsd::formatHistory(std::string *out,
+                               const std::function<bool(std::string *)> &flush) {
+    std::vector<std::unique_ptr<StatsSnapshot>> snapshots;
+    for (auto const &schedule : mStats) {
+        snapshots.emplace_back(schedule.stats->snapshot());
     }
 
-    while (!mergedQueue.empty()) {
-        StatsData data = mergedQueue.top();
-        auto raw_time = data.getTime();
+    // Merge the records of every snapshot, each oldest first, by time
+    std::vector<size_t> next(snapshots.size(), 0);
+    while (true) {
+        size_t oldest = snapshots.size();
+        for (size_t i = 0; i < snapshots.size(); i++) {
+            if (next[i] < snapshots[i]->count() &&
+                (oldest == snapshots.size() ||
+                 snapshots[i]->getTime(next[i]) < snapshots[oldest]->getTime(next[oldest])))
+                oldest = i;
+        }
+        if (oldest == snapshots.size())
+            break;
+
+        auto raw_time = snapshots[oldest]->getTime(next[oldest]);
         auto seconds = std::chrono::time_point_cast<std::chrono::seconds>(raw_time);
         auto d = raw_time - seconds;
         auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(d);
-        std::string content = data.getData();
 
         time_t t = std::chrono::system_clock::to_time_t(raw_time);
         char buff[20];
         strftime(buff, sizeof(buff), "%m-%d %H:%M:%S", localtime(&t));
 
-        ret->append(std::string(buff) + ".");
-        ret->append(std::to_string(milliseconds.count()) + "\n");
-        ret->append(content + "\n");
-        mergedQueue.pop();
+        out->append(buff);
+        out->append(".");
+        out->append(std::to_string(milliseconds.count()));
+        out->append("\n");
+        snapshots[oldest]->format(next[oldest]++, out);
+        out->append("\n");
+
+        if (flush && out->size() >= HISTORY_CHUNK_SIZE && !flush(out))
+            return;
     }
+    if (flush)
+        flush(out);
+}
+
+void Perfstatsd::getHistory(std::string *ret) {
+    formatHistory(ret, nullptr);
 
     if (ret->size() > 400_KiB)
         LOG(WARNING) << "Data might be too large. size: " << ret->size() << " bytes\n" << *ret;
 }
 
-void Perfstatsd::setOptions(const std::string &key, const std::string &value) {
-    if (key == PERFSTATSD_PERIOD) {
-        uint32_t val = 0;
-        if (!base::ParseUint(value, &val) || val < 1) {
-            LOG(ERROR) << "Invalid value. Minimum refresh period is 1 second";
-        } else {
-            mRefreshPeriod = val;
-            LOG(INFO) << "set period to " << value << " seconds";
+// Write the history to fd a chunk at a time. Returns the bytes written, -1 on error.
+int64_t Perfstatsd::writeHistory(int fd) {
+    std::string chunk;
+    chunk.reserve(2 * HISTORY_CHUNK_SIZE);
+    int64_t written = 0;
+    formatHistory(&chunk, [&](std::string *out) {
+        if (!base::WriteFully(fd, out->data(), out->size())) {
+            PLOG(ERROR) << "failed to write history";
+            written = -1;
+            return false;
         }
-        return;
+        written += out->size();
+        out->clear();
+        return true;
+    });
+    return written;
+}
+
+// The samples of the stats types in typeMask taken from startMs to endMs, both included
+void Perfstatsd::queryHistory(int64_t startMs, int64_t endMs, int32_t typeMask,
+                              StatsHistory *history) {
+    for (auto const &schedule : mStats) {
+        if (!(schedule.stats->type() & typeMask))
+            continue;
+        std::unique_ptr<StatsSnapshot> snapshot = schedule.stats->snapshot();
+        // The records are oldest first, find the first one of the range
+        size_t first = 0, last = snapshot->count();
+        while (first < last) {
+            size_t mid = first + (last - first) / 2;
+            if (toEpochMs(snapshot->getTime(mid)) < startMs)
+                first = mid + 1;
+            else
+                last = mid;
+        }
+        for (size_t i = first;
+             i < snapshot->count() && toEpochMs(snapshot->getTime(i)) <= endMs; i++) {
+            snapshot->exportSample(i, history);
+        }
+    }
+}
+
+// Set an option of PERFSTATSD_PERIOD, PERFSTATSD_BURST or PERFSTATSD_IDLE_*, false if not one
+bool Perfstatsd::setSchedulingOption(const std::string &key, const std::string &value) {
+    const auto now = std::chrono::steady_clock::now();
+    Schedule *schedule = nullptr;
+    for (auto &s : mStats) {
+        if (key == PERFSTATSD_PERIOD "." + s.name)
+            schedule = &s;
     }
+    uint32_t *option = nullptr;
+    if (key == PERFSTATSD_PERIOD) {
+        option = &mRefreshPeriod;
+    } else if (schedule) {
+        option = &schedule->period;
+    } else if (key == PERFSTATSD_BURST_PERIOD) {
+        option = &mBurstPeriod;
+    } else if (key == PERFSTATSD_BURST_DURATION) {
+        option = &mBurstDuration;
+    } else if (key == PERFSTATSD_IDLE_PERIOD) {
+        option = &mIdlePeriod;
+    } else if (key != PERFSTATSD_BURST && key != PERFSTATSD_BURST_LOAD &&
+               key != PERFSTATSD_IDLE_LOAD && key != PERFSTATSD_BUDGET) {
+        return false;
+    }
+
+    uint32_t val = 0;
+    // The period of a stats type may go back to 0, for PERFSTATSD_PERIOD
+    if (!base::ParseUint(value, &val) || (option && !schedule && val < 1)) {
+        LOG(ERROR) << "Invalid value " << value << " for " << key
+                   << ". Minimum period and duration are 1 second";
+        return true;
+    }
+    if (key == PERFSTATSD_BURST) {
+        burst(now + std::chrono::seconds(val));
+        return true;
+    }
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (key == PERFSTATSD_BURST_LOAD)
+        mBurstLoad = val;
+    else if (key == PERFSTATSD_IDLE_LOAD)
+        mIdleLoad = val;
+    else if (key == PERFSTATSD_BUDGET)
+        mBudget = val;
+    else
+        *option = val;
+    LOG(INFO) << "set " << key << " to " << value;
+    // Sleep again for the new periods
+    mWakeups++;
+    mWakeup.notify_all();
+    return true;
+}
+
+void Perfstatsd::setOptions(const std::string &key, const std::string &value) {
+    if (setSchedulingOption(key, value))
+        return;
 
-    for (auto const &stats : mStats) {
-        stats->setOptions(std::forward<const std::string>(key),
-                          std::forward<const std::string>(value));
+    for (auto const &schedule : mStats) {
+        schedule.stats->setOptions(std::forward<const std::string>(key),
+                                   std::forward<const std::string>(value));
     }
     return;
 }
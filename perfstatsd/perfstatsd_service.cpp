@@ -35,6 +35,22 @@ android::binder::Status PerfstatsdPrivateService::setOptions(const std::string &
     return android::binder::Status::ok();
 }
 
+android::binder::Status PerfstatsdPrivateService::queryHistory(int64_t startMs, int64_t endMs,
+                                                               int32_t typeMask,
+                                                               StatsHistory *_aidl_return) {
+    perfstatsdSp->queryHistory(startMs, endMs, typeMask, _aidl_return);
+    return android::binder::Status::ok();
+}
+
+android::binder::Status PerfstatsdPrivateService::writeHistory(
+    const android::os::ParcelFileDescriptor &fd, int64_t *_aidl_return) {
+    *_aidl_return = perfstatsdSp->writeHistory(fd.get());
+    if (*_aidl_return < 0)
+        return android::binder::Status::fromExceptionCode(android::binder::Status::EX_ILLEGAL_STATE,
+                                                          "failed to write history");
+    return android::binder::Status::ok();
+}
+
 android::sp<IPerfstatsdPrivate> getPerfstatsdPrivateService() {
     android::sp<android::IServiceManager> sm = android::defaultServiceManager();
     if (sm == NULL)
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs CpuUsage::refresh and IoUsage::refresh against a synthetic /proc with
+ * the number of processes given as the benchmark argument, one refresh per
+ * iteration, so the reported time is ns/refresh. The allocs counter is per
+ * refresh, from the global operator new of this binary.
+ *
+ * Every process is busy, and the process profiling of CpuUsage always on, so
+ * this is the worst case of a refresh, not the idle one.
+ */
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <benchmark/benchmark.h>
+#include <sys/stat.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+
+#include "cpu_usage.h"
+#include "io_usage.h"
+
+namespace {
+
+std::atomic<int64_t> allocation_count = 0;
+
+}  // namespace
+
+void *operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    void *ptr = malloc(size ? size : 1);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+namespace android {
+namespace pixel {
+namespace perfstatsd {
+
+using android::base::StringPrintf;
+using android::base::WriteStringToFile;
+
+namespace {
+
+#define BENCHMARK_CORES (8)
+#define BENCHMARK_APP_UID (10000)
+// Rewriting the tree between refreshes is not timed, but would make the
+// benchmark run for minutes if it picked the iterations itself
+#define BENCHMARK_REFRESHES (200)
+
+/*
+ * stat, uid_io/stats and <pid>/stat, <pid>/status of numProcs processes, one
+ * app uid each. tick() moves every counter on as if every process ran.
+ */
+class ProcTree {
+  public:
+    explicit ProcTree(uint32_t numProcs) : mNumProcs(numProcs) {
+        for (uint32_t pid = 1; pid <= mNumProcs; pid++) {
+            const std::string dir = StringPrintf("%s/%u", mDir.path, pid);
+            mkdir(dir.c_str(), 0755);
+            WriteStringToFile(StringPrintf("Name:\tproc%u\nUmask:\t0077\nState:\tS (sleeping)\n"
+                                           "Tgid:\t%u\nPid:\t%u\nUid:\t%u\t%u\t%u\t%u\n",
+                                           pid, pid, pid, uid(pid), uid(pid), uid(pid), uid(pid)),
+                              dir + "/status");
+        }
+        mkdir(StringPrintf("%s/uid_io", mDir.path).c_str(), 0755);
+        tick();
+        setProcRoot(mDir.path);
+    }
+    ~ProcTree() { setProcRoot("/proc"); }
+
+    void tick() {
+        mTicks++;
+        const uint64_t busy = mTicks * 100 * BENCHMARK_CORES;
+        std::string stat = StringPrintf("cpu  %" PRIu64 " 0 %" PRIu64 " %" PRIu64 " 0 0 0 0 0 0\n",
+                                        busy / 2, busy / 2, mTicks);
+        for (uint32_t core = 0; core < BENCHMARK_CORES; core++)
+            stat += StringPrintf("cpu%u %" PRIu64 " 0 %" PRIu64 " %" PRIu64 " 0 0 0 0 0 0\n", core,
+                                 mTicks * 50, mTicks * 50, mTicks);
+        WriteStringToFile(stat, StringPrintf("%s/stat", mDir.path));
+
+        std::string uidIo;
+        for (uint32_t pid = 1; pid <= mNumProcs; pid++) {
+            WriteStringToFile(StringPrintf("%u (proc%u) S 1 %u %u 0 -1 4194560 0 0 0 0 %" PRIu64
+                                           " %" PRIu64 " 0 0 20 0 1 0 100 0 0\n",
+                                           pid, pid, pid, pid, mTicks * pid, mTicks),
+                              StringPrintf("%s/%u/stat", mDir.path, pid));
+            const uint64_t bytes = mTicks * pid * 4096;
+            uidIo += StringPrintf("%u %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " 0 0 %" PRIu64
+                                  " %" PRIu64 " %" PRIu64 " 0\n",
+                                  uid(pid), bytes, bytes, bytes, bytes, bytes, bytes, mTicks);
+        }
+        WriteStringToFile(uidIo, StringPrintf("%s/uid_io/stats", mDir.path));
+    }
+
+  private:
+    static uint32_t uid(uint32_t pid) { return BENCHMARK_APP_UID + pid; }
+
+    TemporaryDir mDir;
+    const uint32_t mNumProcs;
+    uint64_t mTicks = 0;
+};
+
+template <typename T>
+void runRefresh(benchmark::State &state, T *stats, ProcTree *tree) {
+    stats->setBufferSize(1);
+    stats->refresh();
+    int64_t allocs = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        tree->tick();
+        const int64_t start = allocation_count.load(std::memory_order_relaxed);
+        state.ResumeTiming();
+        stats->refresh();
+        allocs += allocation_count.load(std::memory_order_relaxed) - start;
+    }
+    state.counters["allocs"] = benchmark::Counter(allocs, benchmark::Counter::kAvgIterations);
+}
+
+void BM_CpuUsageRefresh(benchmark::State &state) {
+    ProcTree tree(state.range(0));
+    CpuUsage cpu;
+    cpu.setOptions(PROCPROF_THRESHOLD, "0");
+    runRefresh(state, &cpu, &tree);
+}
+BENCHMARK(BM_CpuUsageRefresh)->Arg(100)->Arg(500)->Arg(2000)->Iterations(BENCHMARK_REFRESHES);
+
+void BM_IoUsageRefresh(benchmark::State &state) {
+    ProcTree tree(state.range(0));
+    IoUsage io;
+    runRefresh(state, &io, &tree);
+}
+BENCHMARK(BM_IoUsageRefresh)->Arg(100)->Arg(500)->Arg(2000)->Iterations(BENCHMARK_REFRESHES);
+
+}  // namespace
+
+}  // namespace perfstatsd
+}  // namespace pixel
+}  // namespace android
+
+BENCHMARK_MAIN();
@@ -21,8 +21,12 @@
 #include <utils/Timers.h>
 #include <cinttypes>
 #include <cmath>
+#include <cstdio>
 
 #include <android-base/file.h>
+#include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
 #include <pixelstats/BatteryEEPROMReporter.h>
 #include <pixelstats/StatsHelper.h>
 #include <hardware/google/pixel/pixelstats/pixelatoms.pb.h>
@@ -41,12 +45,60 @@ using android::hardware::google::pixel::PixelAtoms::BatteryEEPROM;
 #define LINESIZE_V2 31
 #define LINESIZE_MAX17201_HIST 80
 
+namespace {
+
+bool isHistorySpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+int hexDigitValue(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * Decode the next field of a history entry the way sscanf("%<width>x") reads
+ * it: skip whitespace, then take 1 to width hex digits. The value is
+ * truncated to T as sscanf stores it.
+ */
+template <typename T>
+bool decodeHexField(std::string_view entry, size_t *pos, size_t width, T *value) {
+    while (*pos < entry.size() && isHistorySpace(entry[*pos])) (*pos)++;
+    uint32_t decoded = 0;
+    size_t digits = 0;
+    for (; digits < width && *pos < entry.size(); digits++, (*pos)++) {
+        int digit = hexDigitValue(entry[*pos]);
+        if (digit < 0)
+            break;
+        decoded = decoded << 4 | digit;
+    }
+    *value = static_cast<T>(decoded);
+    return digits > 0;
+}
+
+// An entry as kept in a cursor, without its whitespace
+std::string compactEntry(std::string_view entry) {
+    std::string compact;
+    compact.reserve(entry.size());
+    for (const char c : entry) {
+        if (!isHistorySpace(c))
+            compact.push_back(c);
+    }
+    return compact;
+}
+
+}  // namespace
+
 BatteryEEPROMReporter::BatteryEEPROMReporter() {}
 
 void BatteryEEPROMReporter::checkAndReport(const std::shared_ptr<IStats> &stats_client,
                                            const std::string &path) {
     std::string file_contents;
-    std::string history_each;
 
     const int kSecondsPerMonth = 60 * 60 * 24 * 30;
     int64_t now = getTimeSecs();
@@ -61,101 +113,197 @@ void BatteryEEPROMReporter::checkAndReport(const std::shared_ptr<IStats> &stats_
         return;
     }
 
-    int16_t i, num;
-    struct BatteryHistory hist;
-    const int kHistTotalLen = file_contents.size();
+    struct BatteryHistory hist = {};
+    const std::string_view contents(file_contents);
+    const int kHistTotalLen = contents.size();
+    HistoryCursor &cursor = history_cursors_[kEEPROMCursorName];
 
     ALOGD("kHistTotalLen=%d\n", kHistTotalLen);
 
     if (kHistTotalLen >= (LINESIZE_V2 * BATT_HIST_NUM_MAX_V2)) {
-        struct BatteryHistoryExtend histv2;
-        for (i = 0; i < BATT_HIST_NUM_MAX_V2; i++) {
+        for (int i = resumeEntry(cursor, contents, LINESIZE_V2); i < BATT_HIST_NUM_MAX_V2; i++) {
             size_t history_offset = i * LINESIZE_V2;
-            if (history_offset > file_contents.size())
+            if (history_offset > contents.size())
                 break;
-            history_each = file_contents.substr(history_offset, LINESIZE_V2);
-            unsigned int data[4];
-
-            /* Format transfer: go/gsx01-eeprom */
-            num = sscanf(history_each.c_str(), "%4" SCNx16 "%4" SCNx16 "%x %x %x %x",
-                        &histv2.tempco, &histv2.rcomp0, &data[0], &data[1], &data[2], &data[3]);
-
-            if (histv2.tempco == 0xFFFF && histv2.rcomp0 == 0xFFFF)
+            const std::string_view history_each = contents.substr(history_offset, LINESIZE_V2);
+            if (!decodeHistoryV2(history_each, i, &hist))
                 continue;
 
-            /* Extract each data */
-            uint64_t tmp = (int64_t)data[3] << 48 |
-                           (int64_t)data[2] << 32 |
-                           (int64_t)data[1] << 16 |
-                           data[0];
-
-            /* ignore this data if unreasonable */
-            if (tmp <= 0)
-                continue;
-
-            /* data format/unit in go/gsx01-eeprom#heading=h.finy98ign34p */
-            histv2.timer_h = tmp & 0xFF;
-            histv2.fullcapnom = (tmp >>= 8) & 0x3FF;
-            histv2.fullcaprep = (tmp >>= 10) & 0x3FF;
-            histv2.mixsoc = (tmp >>= 10) & 0x3F;
-            histv2.vfsoc = (tmp >>= 6) & 0x3F;
-            histv2.maxvolt = (tmp >>= 6) & 0xF;
-            histv2.minvolt = (tmp >>= 4) & 0xF;
-            histv2.maxtemp = (tmp >>= 4) & 0xF;
-            histv2.mintemp = (tmp >>= 4) & 0xF;
-            histv2.maxchgcurr = (tmp >>= 4) & 0xF;
-            histv2.maxdischgcurr = (tmp >>= 4) & 0xF;
-
-            /* Mapping to original format to collect data */
-            /* go/pixel-battery-eeprom-atom#heading=h.dcawdjiz2ls6 */
-            hist.tempco = histv2.tempco;
-            hist.rcomp0 = histv2.rcomp0;
-            hist.timer_h = (uint8_t)histv2.timer_h * 5;
-            hist.max_temp = (int8_t)histv2.maxtemp * 3 + 22;
-            hist.min_temp = (int8_t)histv2.mintemp * 3 - 20;
-            hist.min_ibatt = (int16_t)histv2.maxchgcurr * 500 * (-1);
-            hist.max_ibatt = (int16_t)histv2.maxdischgcurr * 500;
-            hist.min_vbatt = (uint16_t)histv2.minvolt * 10 + 2500;
-            hist.max_vbatt = (uint16_t)histv2.maxvolt * 20 + 4200;
-            hist.batt_soc = (uint8_t)histv2.vfsoc * 2;
-            hist.msoc = (uint8_t)histv2.mixsoc * 2;
-            hist.full_cap = (int16_t)histv2.fullcaprep * 125 / 1000;
-            hist.full_rep = (int16_t)histv2.fullcapnom * 125 / 1000;
-            hist.cycle_cnt = (i + 1) * 10;
-
             reportEvent(stats_client, hist);
             report_time_ = getTimeSecs();
+            advanceCursor(&cursor, i, history_each);
         }
+        saveHistoryCursors();
         return;
     }
 
-    for (i = 0; i < (LINESIZE * BATT_HIST_NUM_MAX); i = i + LINESIZE) {
-        if (i + LINESIZE > kHistTotalLen)
+    for (int i = resumeEntry(cursor, contents, LINESIZE); i < BATT_HIST_NUM_MAX; i++) {
+        if ((i + 1) * LINESIZE > kHistTotalLen)
             break;
-        history_each = file_contents.substr(i, LINESIZE);
-        num = sscanf(history_each.c_str(),
-                   "%4" SCNx16 "%4" SCNx16 "%4" SCNx16 "%4" SCNx16
-                   "%2" SCNx8 "%2" SCNx8 " %2" SCNx8 "%2" SCNx8
-                   "%2" SCNx8 "%2" SCNx8 " %2" SCNx8 "%2" SCNx8
-                   "%2" SCNx8 "%2" SCNx8 " %4" SCNx16 "%4" SCNx16
-                   "%4" SCNx16 "%4" SCNx16 "%4" SCNx16,
-                   &hist.cycle_cnt, &hist.full_cap, &hist.esr,
-                   &hist.rslow, &hist.batt_temp, &hist.soh,
-                   &hist.cc_soc, &hist.cutoff_soc, &hist.msoc,
-                   &hist.sys_soc, &hist.reserve, &hist.batt_soc,
-                   &hist.min_temp, &hist.max_temp,  &hist.max_vbatt,
-                   &hist.min_vbatt, &hist.max_ibatt, &hist.min_ibatt,
-                   &hist.checksum);
-
-        if (num != kNumBatteryHistoryFields) {
-            ALOGE("Couldn't process %s", history_each.c_str());
+        const std::string_view history_each = contents.substr(i * LINESIZE, LINESIZE);
+        size_t pos = 0;
+        if (!(decodeHexField(history_each, &pos, 4, &hist.cycle_cnt) &&
+              decodeHexField(history_each, &pos, 4, &hist.full_cap) &&
+              decodeHexField(history_each, &pos, 4, &hist.esr) &&
+              decodeHexField(history_each, &pos, 4, &hist.rslow) &&
+              decodeHexField(history_each, &pos, 2, &hist.batt_temp) &&
+              decodeHexField(history_each, &pos, 2, &hist.soh) &&
+              decodeHexField(history_each, &pos, 2, &hist.cc_soc) &&
+              decodeHexField(history_each, &pos, 2, &hist.cutoff_soc) &&
+              decodeHexField(history_each, &pos, 2, &hist.msoc) &&
+              decodeHexField(history_each, &pos, 2, &hist.sys_soc) &&
+              decodeHexField(history_each, &pos, 2, &hist.reserve) &&
+              decodeHexField(history_each, &pos, 2, &hist.batt_soc) &&
+              decodeHexField(history_each, &pos, 2, &hist.min_temp) &&
+              decodeHexField(history_each, &pos, 2, &hist.max_temp) &&
+              decodeHexField(history_each, &pos, 4, &hist.max_vbatt) &&
+              decodeHexField(history_each, &pos, 4, &hist.min_vbatt) &&
+              decodeHexField(history_each, &pos, 4, &hist.max_ibatt) &&
+              decodeHexField(history_each, &pos, 4, &hist.min_ibatt) &&
+              decodeHexField(history_each, &pos, 4, &hist.checksum))) {
+            ALOGE("Couldn't process %.*s", static_cast<int>(history_each.size()),
+                  history_each.data());
             continue;
         }
 
         if (checkLogEvent(hist)) {
             reportEvent(stats_client, hist);
             report_time_ = getTimeSecs();
+            advanceCursor(&cursor, i, history_each);
+        }
+    }
+    saveHistoryCursors();
+}
+
+/**
+ * Decode a P21+ history entry into the original format. Returns false for an
+ * entry not written yet or holding unreasonable data.
+ */
+bool BatteryEEPROMReporter::decodeHistoryV2(std::string_view history_each, int index,
+                                            struct BatteryHistory *hist) {
+    struct BatteryHistoryExtend histv2;
+    uint32_t data[4];
+
+    /* Format transfer: go/gsx01-eeprom */
+    size_t pos = 0;
+    if (!(decodeHexField(history_each, &pos, 4, &histv2.tempco) &&
+          decodeHexField(history_each, &pos, 4, &histv2.rcomp0)))
+        return false;
+    if (histv2.tempco == 0xFFFF && histv2.rcomp0 == 0xFFFF)
+        return false;
+    for (auto &word : data) {
+        if (!decodeHexField(history_each, &pos, 8, &word))
+            return false;
+    }
+
+    /* Extract each data */
+    uint64_t tmp = (int64_t)data[3] << 48 |
+                   (int64_t)data[2] << 32 |
+                   (int64_t)data[1] << 16 |
+                   data[0];
+
+    /* ignore this data if unreasonable */
+    if (tmp <= 0)
+        return false;
+
+    /* data format/unit in go/gsx01-eeprom#heading=h.finy98ign34p */
+    histv2.timer_h = tmp & 0xFF;
+    histv2.fullcapnom = (tmp >>= 8) & 0x3FF;
+    histv2.fullcaprep = (tmp >>= 10) & 0x3FF;
+    histv2.mixsoc = (tmp >>= 10) & 0x3F;
+    histv2.vfsoc = (tmp >>= 6) & 0x3F;
+    histv2.maxvolt = (tmp >>= 6) & 0xF;
+    histv2.minvolt = (tmp >>= 4) & 0xF;
+    histv2.maxtemp = (tmp >>= 4) & 0xF;
+    histv2.mintemp = (tmp >>= 4) & 0xF;
+    histv2.maxchgcurr = (tmp >>= 4) & 0xF;
+    histv2.maxdischgcurr = (tmp >>= 4) & 0xF;
+
+    /* Mapping to original format to collect data */
+    /* go/pixel-battery-eeprom-atom#heading=h.dcawdjiz2ls6 */
+    hist->tempco = histv2.tempco;
+    hist->rcomp0 = histv2.rcomp0;
+    hist->timer_h = (uint8_t)histv2.timer_h * 5;
+    hist->max_temp = (int8_t)histv2.maxtemp * 3 + 22;
+    hist->min_temp = (int8_t)histv2.mintemp * 3 - 20;
+    hist->min_ibatt = (int16_t)histv2.maxchgcurr * 500 * (-1);
+    hist->max_ibatt = (int16_t)histv2.maxdischgcurr * 500;
+    hist->min_vbatt = (uint16_t)histv2.minvolt * 10 + 2500;
+    hist->max_vbatt = (uint16_t)histv2.maxvolt * 20 + 4200;
+    hist->batt_soc = (uint8_t)histv2.vfsoc * 2;
+    hist->msoc = (uint8_t)histv2.mixsoc * 2;
+    hist->full_cap = (int16_t)histv2.fullcaprep * 125 / 1000;
+    hist->full_rep = (int16_t)histv2.fullcapnom * 125 / 1000;
+    hist->cycle_cnt = (index + 1) * 10;
+    return true;
+}
+
+/**
+ * The entry to continue a history from. The entries before the cursor were
+ * handled already, unless the one the cursor ends with changed, e.g. with a
+ * new battery, in which case the whole history is read again.
+ */
+int BatteryEEPROMReporter::resumeEntry(const HistoryCursor &cursor, std::string_view contents,
+                                       size_t entry_size) {
+    if (cursor.next_entry == 0)
+        return 0;
+    const size_t last_offset = (cursor.next_entry - 1) * entry_size;
+    if (last_offset >= contents.size() ||
+        compactEntry(contents.substr(last_offset, entry_size)) != cursor.last_entry) {
+        ALOGI("Battery history changed, reading it from the start");
+        return 0;
+    }
+    return cursor.next_entry;
+}
+
+void BatteryEEPROMReporter::advanceCursor(HistoryCursor *cursor, int index,
+                                          std::string_view entry) {
+    cursor->next_entry = index + 1;
+    cursor->last_entry = compactEntry(entry);
+    cursors_changed_ = true;
+}
+
+/**
+ * Keep the history cursors in a text file, so that a restart does not report
+ * the same entries again. Each line is
+ *   <history> <next entry> <last entry without whitespace>
+ */
+void BatteryEEPROMReporter::setHistoryCursorPath(const std::string &path) {
+    cursor_path_ = path;
+
+    std::string file_contents;
+    if (!ReadFileToString(path, &file_contents)) {
+        if (errno != ENOENT)
+            ALOGE("Unable to read history cursors %s - %s", path.c_str(), strerror(errno));
+        return;
+    }
+    for (const auto &line : android::base::Split(file_contents, "\n")) {
+        const std::vector<std::string> words = android::base::Split(line, " ");
+        int next_entry;
+        if (words.size() != 3 || !android::base::ParseInt(words[1], &next_entry, 1)) {
+            if (!line.empty())
+                ALOGE("Bad history cursor line: %s", line.c_str());
+            continue;
         }
+        history_cursors_[words[0]] = {.next_entry = next_entry, .last_entry = words[2]};
+    }
+}
+
+void BatteryEEPROMReporter::saveHistoryCursors() {
+    if (!cursors_changed_ || cursor_path_.empty())
+        return;
+    cursors_changed_ = false;
+
+    std::string file_contents;
+    for (const auto &[name, cursor] : history_cursors_) {
+        if (cursor.next_entry > 0)
+            android::base::StringAppendF(&file_contents, "%s %d %s\n", name.c_str(),
+                                         cursor.next_entry, cursor.last_entry.c_str());
+    }
+    const std::string tmp_path = cursor_path_ + ".tmp";
+    if (!android::base::WriteStringToFile(file_contents, tmp_path) ||
+        rename(tmp_path.c_str(), cursor_path_.c_str())) {
+        ALOGE("Unable to write history cursors %s - %s", cursor_path_.c_str(), strerror(errno));
     }
 }
 
@@ -316,7 +464,6 @@ void BatteryEEPROMReporter::checkAndReportGMSR(const std::shared_ptr<IStats> &st
 void BatteryEEPROMReporter::checkAndReportMaxfgHistory(const std::shared_ptr<IStats> &stats_client,
                                                        const std::string &path) {
     std::string file_contents;
-    int16_t i;
 
     if (path.empty())
         return;
@@ -326,32 +473,35 @@ void BatteryEEPROMReporter::checkAndReportMaxfgHistory(const std::shared_ptr<ISt
         return;
     }
 
-    std::string hist_each;
-    const int kHistTotalLen = file_contents.size();
+    const std::string_view contents(file_contents);
+    const int kHistTotalLen = contents.size();
+    HistoryCursor &cursor = history_cursors_[kMaxfgCursorName];
 
     ALOGD("checkAndReportMaxfgHistory:size=%d\n%s", kHistTotalLen, file_contents.c_str());
 
-    for (i = 0; i < kHistTotalLen; i++) {
+    for (int i = resumeEntry(cursor, contents, LINESIZE_MAX17201_HIST); i < kHistTotalLen; i++) {
         struct BatteryHistory maxfg_hist;
         uint16_t nQRTable00, nQRTable10, nQRTable20, nQRTable30, nCycles, nFullCapNom;
         uint16_t nRComp0, nTempCo, nIAvgEmpty, nFullCapRep, nVoltTemp, nMaxMinCurr, nMaxMinVolt;
         uint16_t nMaxMinTemp, nSOC, nTimerH;
-        int16_t num;
         size_t hist_offset = i * LINESIZE_MAX17201_HIST;
 
-        if (hist_offset >= file_contents.size())
+        if (hist_offset >= contents.size())
             break;
 
-        hist_each = file_contents.substr(hist_offset, LINESIZE_MAX17201_HIST);
-        num = sscanf(hist_each.c_str(), "%4" SCNx16 "%4" SCNx16 "%4" SCNx16 "%4" SCNx16
-                     "%4" SCNx16 "%4" SCNx16 "%4" SCNx16 "%4" SCNx16 "%4" SCNx16 "%4" SCNx16
-                     "%4" SCNx16 "%4" SCNx16 "%4" SCNx16 "%4" SCNx16 "%4" SCNx16 "%4" SCNx16,
-                     &nQRTable00, &nQRTable10, &nQRTable20, &nQRTable30, &nCycles, &nFullCapNom,
-                     &nRComp0, &nTempCo, &nIAvgEmpty, &nFullCapRep, &nVoltTemp, &nMaxMinCurr,
-                     &nMaxMinVolt, &nMaxMinTemp, &nSOC, &nTimerH);
+        const std::string_view hist_each = contents.substr(hist_offset, LINESIZE_MAX17201_HIST);
+        uint16_t *const fields[kNum17201HISTFields] = {
+                &nQRTable00, &nQRTable10, &nQRTable20, &nQRTable30, &nCycles, &nFullCapNom,
+                &nRComp0, &nTempCo, &nIAvgEmpty, &nFullCapRep, &nVoltTemp, &nMaxMinCurr,
+                &nMaxMinVolt, &nMaxMinTemp, &nSOC, &nTimerH};
+        size_t pos = 0;
+        int num = 0;
+        while (num < kNum17201HISTFields && decodeHexField(hist_each, &pos, 4, fields[num]))
+            num++;
 
         if (num != kNum17201HISTFields) {
-            ALOGE("Couldn't process %s (num=%d)", hist_each.c_str(), num);
+            ALOGE("Couldn't process %.*s (num=%d)", static_cast<int>(hist_each.size()),
+                  hist_each.data(), num);
             continue;
         }
 
@@ -375,7 +525,9 @@ void BatteryEEPROMReporter::checkAndReportMaxfgHistory(const std::shared_ptr<ISt
         maxfg_hist.rslow = nVoltTemp;
 
         reportEvent(stats_client, maxfg_hist);
+        advanceCursor(&cursor, i, hist_each);
     }
+    saveHistoryCursors();
 }
 
 void BatteryEEPROMReporter::checkAndReportFGModelLoading(const std::shared_ptr<IStats> &client,
@@ -32,8 +32,6 @@ namespace google {
 namespace pixel {
 
 using aidl::android::frameworks::stats::IStats;
-using aidl::android::frameworks::stats::VendorAtom;
-using aidl::android::frameworks::stats::VendorAtomValue;
 using android::base::ReadFileToString;
 using android::base::WriteStringToFile;
 using android::hardware::google::pixel::PixelAtoms::BatteryHealthStatus;
@@ -68,7 +66,7 @@ bool BatteryHealthReporter::reportBatteryHealthStatus(const std::shared_ptr<ISta
 
 void BatteryHealthReporter::reportBatteryHealthStatusEvent(
         const std::shared_ptr<IStats> &stats_client, const char *line) {
-    int health_status_stats_fields[] = {
+    static constexpr int health_status_stats_fields[] = {
             BatteryHealthStatus::kHealthAlgorithmFieldNumber,
             BatteryHealthStatus::kHealthStatusFieldNumber,
             BatteryHealthStatus::kHealthIndexFieldNumber,
@@ -84,8 +82,8 @@ void BatteryHealthReporter::reportBatteryHealthStatusEvent(
 
     const int32_t vtier_fields_size = std::size(health_status_stats_fields);
     static_assert(vtier_fields_size == 11, "Unexpected battery health status fields size");
-    std::vector<VendorAtomValue> values(vtier_fields_size);
-    VendorAtomValue val;
+    static_assert(decltype(status_atom_)::hasFields(health_status_stats_fields),
+                  "Battery health status field out of the atom");
     int32_t i = 0, fields_size = 0, tmp[vtier_fields_size] = {0};
 
     // health_algo: health_status, health_index,healh_capacity_index,health_imp_index,
@@ -100,15 +98,10 @@ void BatteryHealthReporter::reportBatteryHealthStatusEvent(
     }
 
     ALOGD("BatteryHealthStatus: processed %s", line);
-    for (i = 0; i < fields_size; i++) {
-        val.set<VendorAtomValue::intValue>(tmp[i]);
-        values[health_status_stats_fields[i] - kVendorAtomOffset] = val;
-    }
+    status_atom_.reset();
+    for (i = 0; i < fields_size; i++) status_atom_.setInt(health_status_stats_fields[i], tmp[i]);
 
-    VendorAtom event = {.reverseDomainName = "",
-                        .atomId = PixelAtoms::Atom::kBatteryHealthStatus,
-                        .values = std::move(values)};
-    const ndk::ScopedAStatus ret = stats_client->reportVendorAtom(event);
+    const ndk::ScopedAStatus ret = stats_client->reportVendorAtom(status_atom_.atom());
     if (!ret.isOk())
         ALOGE("Unable to report BatteryHealthStatus to Stats service");
 }
@@ -140,7 +133,7 @@ bool BatteryHealthReporter::reportBatteryHealthUsage(const std::shared_ptr<IStat
 
 void BatteryHealthReporter::reportBatteryHealthUsageEvent(
         const std::shared_ptr<IStats> &stats_client, const char *line) {
-    int health_status_stats_fields[] = {
+    static constexpr int health_status_stats_fields[] = {
             BatteryHealthUsage::kTemperatureLimitDeciCFieldNumber,
             BatteryHealthUsage::kSocLimitFieldNumber,
             BatteryHealthUsage::kChargeTimeSecsFieldNumber,
@@ -149,8 +142,8 @@ void BatteryHealthReporter::reportBatteryHealthUsageEvent(
 
     const int32_t vtier_fields_size = std::size(health_status_stats_fields);
     static_assert(vtier_fields_size == 4, "Unexpected battery health status fields size");
-    std::vector<VendorAtomValue> values(vtier_fields_size);
-    VendorAtomValue val;
+    static_assert(decltype(usage_atom_)::hasFields(health_status_stats_fields),
+                  "Battery health usage field out of the atom");
     int32_t i = 0, tmp[vtier_fields_size] = {0};
 
     // temp/soc charge(s) discharge(s)
@@ -160,15 +153,11 @@ void BatteryHealthReporter::reportBatteryHealthUsageEvent(
     }
 
     ALOGD("BatteryHealthUsage: processed %s", line);
-    for (i = 0; i < vtier_fields_size; i++) {
-        val.set<VendorAtomValue::intValue>(tmp[i]);
-        values[health_status_stats_fields[i] - kVendorAtomOffset] = val;
-    }
+    usage_atom_.reset();
+    for (i = 0; i < vtier_fields_size; i++)
+        usage_atom_.setInt(health_status_stats_fields[i], tmp[i]);
 
-    VendorAtom event = {.reverseDomainName = "",
-                        .atomId = PixelAtoms::Atom::kBatteryHealthUsage,
-                        .values = std::move(values)};
-    const ndk::ScopedAStatus ret = stats_client->reportVendorAtom(event);
+    const ndk::ScopedAStatus ret = stats_client->reportVendorAtom(usage_atom_.atom());
     if (!ret.isOk())
         ALOGE("Unable to report BatteryHealthStatus to Stats service");
 }
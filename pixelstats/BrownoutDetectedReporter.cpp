@@ -23,13 +23,19 @@
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 #include <android/binder_manager.h>
+#include <errno.h>
 #include <hardware/google/pixel/pixelstats/pixelatoms.pb.h>
 #include <pixelstats/BrownoutDetectedReporter.h>
 #include <time.h>
+#include <unistd.h>
 #include <utils/Log.h>
 
+#include <algorithm>
+#include <charconv>
+#include <cstring>
 #include <map>
-#include <regex>
+#include <sstream>
+#include <string_view>
 
 namespace android {
 namespace hardware {
@@ -42,22 +48,12 @@ using aidl::android::frameworks::stats::VendorAtomValue;
 using android::base::ReadFileToString;
 using android::hardware::google::pixel::PixelAtoms::BrownoutDetected;
 
-#define READING_IDX 2
-#define KEY_IDX 0
 #define DEFAULT_BATTERY_TEMP 9999999
 #define DEFAULT_BATTERY_SOC 100
 #define DEFAULT_BATTERY_VOLT 5000000
 #define ONE_SECOND_IN_US 1000000
 
-const std::regex kTimestampPattern("^\\S+\\s[0-9]+:[0-9]+:[0-9]+\\S+$");
-const std::regex kIrqPattern("^(\\S+)\\striggered\\sat\\s\\S+$");
-const std::regex kOdpmPattern("^CH\\d+\\[(\\S+)\\],\\s(\\d+)$");
-const std::regex kDvfsPattern("^([A-Z1-9]+):(\\d+)$");
-const std::regex kFgPattern("^(voltage_now):(\\d+)$");
-const std::regex kBatteryTempPattern("^(battery):(\\d+)$");
-const std::regex kBatteryCyclePattern("^(battery_cycle):(\\d+)$");
-const std::regex kBatterySocPattern("^(soc):(\\d+)$");
-const std::regex kAlreadyUpdatedPattern("^(LASTMEAL_UPDATED)$");
+constexpr std::string_view kAlreadyUpdated = "LASTMEAL_UPDATED";
 
 const std::map<std::string, int> kBrownoutReason = {{"uvlo,pmic,if", BrownoutDetected::UVLO_IF},
                                                     {"ocp,pmic,if", BrownoutDetected::OCP_IF},
@@ -89,27 +85,152 @@ const std::map<std::string, int> kBrownoutReason = {{"uvlo,pmic,if", BrownoutDet
                                                     {"ocp,buckcs", BrownoutDetected::OCP_BCS},
                                                     {"ocp,buckds", BrownoutDetected::OCP_BDS}};
 
-bool BrownoutDetectedReporter::updateIfFound(std::string line, std::regex pattern,
-                                             int *current_value, Update flag) {
-    bool found = false;
-    std::smatch pattern_match;
-    if (std::regex_match(line, pattern_match, pattern)) {
-        if (pattern_match.size() < (READING_IDX + 1)) {
-            return found;
+namespace {
+
+// The layout of the ring written by libpixelhealth's ShutdownSampleRing
+constexpr uint32_t kShutdownSamplesMagic = 0x53484452;
+constexpr uint32_t kShutdownSamplesVersion = 1;
+
+struct ShutdownSamplesHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t count;
+};
+
+struct ShutdownSample {
+    int64_t timestamp_secs;
+    int32_t voltage_mv;
+    int32_t current_ua;
+    int32_t soc;
+    int32_t reserved;
+};
+
+static_assert(sizeof(ShutdownSamplesHeader) == 16 && sizeof(ShutdownSample) == 24,
+              "must match ShutdownSampleRing");
+
+// Any of the whitespace which separates the fields of a lastmeal line
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool hasNoSpace(std::string_view text) {
+    return std::none_of(text.begin(), text.end(), isSpace);
+}
+
+// Split the leading run of digits off text
+std::string_view consumeDigits(std::string_view *text) {
+    size_t len = 0;
+    while (len < text->size() && isDigit((*text)[len])) len++;
+    std::string_view digits = text->substr(0, len);
+    text->remove_prefix(len);
+    return digits;
+}
+
+// A non-empty run of digits that fits an int
+bool parseReading(std::string_view digits, int *reading) {
+    if (digits.empty() || !std::all_of(digits.begin(), digits.end(), isDigit))
+        return false;
+    auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), *reading);
+    return ec == std::errc() && end == digits.data() + digits.size();
+}
+
+// Split text at its first whitespace, which must follow a non-empty word
+bool splitFirstWord(std::string_view text, std::string_view *word, std::string_view *rest) {
+    size_t pos = std::find_if(text.begin(), text.end(), isSpace) - text.begin();
+    if (pos == 0 || pos == text.size())
+        return false;
+    *word = text.substr(0, pos);
+    *rest = text.substr(pos + 1);
+    return true;
+}
+
+// "<irq> triggered at <time>"
+bool matchIrq(std::string_view line, std::string_view *irq) {
+    std::string_view rest;
+    if (!splitFirstWord(line, irq, &rest))
+        return false;
+    constexpr std::string_view kTriggered = "triggered";
+    constexpr std::string_view kAt = "at";
+    if (rest.substr(0, kTriggered.size()) != kTriggered)
+        return false;
+    rest.remove_prefix(kTriggered.size());
+    if (rest.empty() || !isSpace(rest[0]) || rest.substr(1, kAt.size()) != kAt)
+        return false;
+    rest.remove_prefix(1 + kAt.size());
+    return rest.size() >= 2 && isSpace(rest[0]) && hasNoSpace(rest.substr(1));
+}
+
+// "<date> <h>:<m>:<s><more>", e.g. "2023-05-01 10:21:45.123"
+bool matchTimestamp(std::string_view line) {
+    std::string_view date, time;
+    if (!splitFirstWord(line, &date, &time) || !hasNoSpace(time))
+        return false;
+    for (int i = 0; i < 2; ++i) {
+        if (consumeDigits(&time).empty() || time.empty() || time[0] != ':')
+            return false;
+        time.remove_prefix(1);
+    }
+    // At least one digit of seconds, then at least one more character
+    return time.size() >= 2 && isDigit(time[0]);
+}
+
+// "<name>:<reading>"
+bool matchNamedReading(std::string_view line, std::string_view name, int *reading) {
+    if (line.size() <= name.size() || line.substr(0, name.size()) != name ||
+        line[name.size()] != ':')
+        return false;
+    return parseReading(line.substr(name.size() + 1), reading);
+}
+
+// "<DOMAIN>:<reading>", the domain of capitals and digits 1-9
+bool matchDvfs(std::string_view line, int *reading) {
+    size_t colon = line.find(':');
+    if (colon == 0 || colon == std::string_view::npos)
+        return false;
+    std::string_view domain = line.substr(0, colon);
+    auto isDomainChar = [](char c) { return (c >= 'A' && c <= 'Z') || (c >= '1' && c <= '9'); };
+    if (!std::all_of(domain.begin(), domain.end(), isDomainChar))
+        return false;
+    return parseReading(line.substr(colon + 1), reading);
+}
+
+// "CH<n>[<rail>], <reading>"
+bool matchOdpm(std::string_view line, int *reading) {
+    if (line.substr(0, 2) != "CH")
+        return false;
+    line.remove_prefix(2);
+    if (consumeDigits(&line).empty() || line.empty() || line[0] != '[')
+        return false;
+    line.remove_prefix(1);
+
+    size_t digits_pos = line.size();
+    while (digits_pos > 0 && isDigit(line[digits_pos - 1])) digits_pos--;
+    // The rail name takes at least one character before "], "
+    if (digits_pos == line.size() || digits_pos < 4 || !isSpace(line[digits_pos - 1]) ||
+        line.substr(digits_pos - 3, 2) != "],")
+        return false;
+    if (!hasNoSpace(line.substr(0, digits_pos - 3)))
+        return false;
+    return parseReading(line.substr(digits_pos), reading);
+}
+
+}  // namespace
+
+void BrownoutDetectedReporter::updateValue(int reading, int *current_value, Update flag) {
+    if (flag == kUpdateMax) {
+        if (*current_value < reading) {
+            *current_value = reading;
         }
-        found = true;
-        int reading = std::stoi(pattern_match[READING_IDX].str());
-        if (flag == kUpdateMax) {
-            if (*current_value < reading) {
-                *current_value = reading;
-            }
-        } else {
-            if (*current_value > reading) {
-                *current_value = reading;
-            }
+    } else {
+        if (*current_value > reading) {
+            *current_value = reading;
         }
     }
-    return found;
 }
 
 void BrownoutDetectedReporter::setAtomFieldValue(std::vector<VendorAtomValue> *values, int offset,
@@ -276,7 +397,6 @@ void BrownoutDetectedReporter::logBrownoutCsv(const std::shared_ptr<IStats> &sta
     max_value.voltage_now_ = DEFAULT_BATTERY_VOLT;
     max_value.battery_soc_ = DEFAULT_BATTERY_SOC;
     max_value.battery_temp_ = DEFAULT_BATTERY_TEMP;
-    std::smatch pattern_match;
     max_value.brownout_reason_ = brownoutReasonCheck(brownoutReasonProp);
     if (max_value.brownout_reason_ < 0) {
         return;
@@ -285,7 +405,7 @@ void BrownoutDetectedReporter::logBrownoutCsv(const std::shared_ptr<IStats> &sta
     std::vector<std::vector<std::string>> rows;
     int row_num = 0;
     while (std::getline(content, line)) {
-        if (std::regex_match(line, pattern_match, kAlreadyUpdatedPattern)) {
+        if (line == kAlreadyUpdated) {
             isAlreadyUpdated = true;
             break;
         }
@@ -338,64 +458,114 @@ void BrownoutDetectedReporter::logBrownout(const std::shared_ptr<IStats> &stats_
     if (!android::base::ReadFileToString(logFilePath, &logFile)) {
         return;
     }
-    std::istringstream content(logFile);
-    std::string line;
     struct BrownoutDetectedInfo max_value = {};
     max_value.voltage_now_ = DEFAULT_BATTERY_VOLT;
     max_value.battery_soc_ = DEFAULT_BATTERY_SOC;
     max_value.battery_temp_ = DEFAULT_BATTERY_TEMP;
-    std::smatch pattern_match;
-    int odpm_index = 0, dvfs_index = 0;
     max_value.brownout_reason_ = brownoutReasonCheck(brownoutReasonProp);
     if (max_value.brownout_reason_ < 0) {
         return;
     }
     bool isAlreadyUpdated = false;
-    while (std::getline(content, line)) {
-        if (std::regex_match(line, pattern_match, kAlreadyUpdatedPattern)) {
-            isAlreadyUpdated = true;
+    parseBrownoutLog(logFile, &max_value, &isAlreadyUpdated);
+    if (!isAlreadyUpdated && max_value.battery_temp_ != DEFAULT_BATTERY_TEMP) {
+        std::string file_content = "LASTMEAL_UPDATED\n" + logFile;
+        android::base::WriteStringToFile(file_content, logFilePath);
+        uploadData(stats_client, max_value);
+    }
+}
+
+void BrownoutDetectedReporter::logShutdownSamples(const std::string &samplesPath) {
+    std::string contents;
+    if (!ReadFileToString(samplesPath, &contents)) {
+        return;
+    }
+
+    ShutdownSamplesHeader header;
+    if (contents.size() < sizeof(header)) {
+        ALOGE("Short shutdown samples file %s", samplesPath.c_str());
+    } else {
+        memcpy(&header, contents.data(), sizeof(header));
+        if (header.magic != kShutdownSamplesMagic || header.version != kShutdownSamplesVersion ||
+            header.capacity == 0 ||
+            contents.size() < sizeof(header) + header.capacity * sizeof(ShutdownSample)) {
+            ALOGE("Unknown shutdown samples file %s", samplesPath.c_str());
+        } else {
+            // Oldest first
+            uint32_t count = std::min(header.count, header.capacity);
+            for (uint32_t i = header.count - count; i != header.count; i++) {
+                ShutdownSample sample;
+                memcpy(&sample,
+                       contents.data() + sizeof(header) +
+                               (i % header.capacity) * sizeof(ShutdownSample),
+                       sizeof(sample));
+                ALOGI("Shutdown sample %ld: soc=%d%% voltage=%dmV current=%duA",
+                      static_cast<long>(sample.timestamp_secs), sample.soc, sample.voltage_mv,
+                      sample.current_ua);
+            }
+        }
+    }
+
+    if (unlink(samplesPath.c_str()) != 0) {
+        ALOGE("Unable to remove %s: %s", samplesPath.c_str(), strerror(errno));
+    }
+}
+
+/**
+ * Fold the lines of a lastmeal log into max_value, and set isAlreadyUpdated
+ * if it was reported before. Each line is matched in one pass over it, the
+ * first of these formats it takes decides what it updates.
+ */
+void BrownoutDetectedReporter::parseBrownoutLog(const std::string &logFile,
+                                                struct BrownoutDetectedInfo *max_value,
+                                                bool *isAlreadyUpdated) {
+    std::string_view content(logFile);
+    int odpm_index = 0, dvfs_index = 0;
+    while (!content.empty()) {
+        size_t eol = content.find('\n');
+        std::string_view line = content.substr(0, eol);
+        content.remove_prefix(eol == std::string_view::npos ? content.size() : eol + 1);
+
+        if (line == kAlreadyUpdated) {
+            *isAlreadyUpdated = true;
             break;
         }
-        if (std::regex_match(line, pattern_match, kIrqPattern)) {
-            if (pattern_match.size() < (KEY_IDX + 1)) {
-                return;
-            }
-            std::ssub_match irq = pattern_match[KEY_IDX];
-            if (irq.str().find("batoilo") != std::string::npos) {
-                max_value.triggered_irq_ = BrownoutDetected::BATOILO;
-                continue;
-            }
-            if (irq.str().find("vdroop1") != std::string::npos) {
-                max_value.triggered_irq_ = BrownoutDetected::UVLO1;
-                continue;
-            }
-            if (irq.str().find("vdroop2") != std::string::npos) {
-                max_value.triggered_irq_ = BrownoutDetected::UVLO2;
-                continue;
-            }
-            if (irq.str().find("smpl_gm") != std::string::npos) {
-                max_value.triggered_irq_ = BrownoutDetected::SMPL_WARN;
-                continue;
+        std::string_view irq;
+        if (matchIrq(line, &irq)) {
+            if (irq.find("batoilo") != std::string_view::npos) {
+                max_value->triggered_irq_ = BrownoutDetected::BATOILO;
+            } else if (irq.find("vdroop1") != std::string_view::npos) {
+                max_value->triggered_irq_ = BrownoutDetected::UVLO1;
+            } else if (irq.find("vdroop2") != std::string_view::npos) {
+                max_value->triggered_irq_ = BrownoutDetected::UVLO2;
+            } else if (irq.find("smpl_gm") != std::string_view::npos) {
+                max_value->triggered_irq_ = BrownoutDetected::SMPL_WARN;
             }
             continue;
         }
-        if (std::regex_match(line, pattern_match, kTimestampPattern)) {
-            max_value.triggered_timestamp_ = parseTimestamp(line.c_str());
+        if (matchTimestamp(line)) {
+            max_value->triggered_timestamp_ = parseTimestamp(std::string(line));
             continue;
         }
-        if (updateIfFound(line, kBatterySocPattern, &max_value.battery_soc_, kUpdateMin)) {
+        int reading;
+        if (matchNamedReading(line, "soc", &reading)) {
+            updateValue(reading, &max_value->battery_soc_, kUpdateMin);
             continue;
         }
-        if (updateIfFound(line, kBatteryTempPattern, &max_value.battery_temp_, kUpdateMin)) {
+        if (matchNamedReading(line, "battery", &reading)) {
+            updateValue(reading, &max_value->battery_temp_, kUpdateMin);
             continue;
         }
-        if (updateIfFound(line, kBatteryCyclePattern, &max_value.battery_cycle_, kUpdateMax)) {
+        if (matchNamedReading(line, "battery_cycle", &reading)) {
+            updateValue(reading, &max_value->battery_cycle_, kUpdateMax);
             continue;
         }
-        if (updateIfFound(line, kFgPattern, &max_value.voltage_now_, kUpdateMin)) {
+        if (matchNamedReading(line, "voltage_now", &reading)) {
+            updateValue(reading, &max_value->voltage_now_, kUpdateMin);
             continue;
         }
-        if (updateIfFound(line, kDvfsPattern, &max_value.dvfs_value_[dvfs_index], kUpdateMax)) {
+        if (matchDvfs(line, &reading)) {
+            updateValue(reading, &max_value->dvfs_value_[dvfs_index], kUpdateMax);
             dvfs_index++;
             // Discarding previous value and update with new DVFS value
             if (dvfs_index == DVFS_MAX_IDX) {
@@ -403,7 +573,8 @@ void BrownoutDetectedReporter::logBrownout(const std::shared_ptr<IStats> &stats_
             }
             continue;
         }
-        if (updateIfFound(line, kOdpmPattern, &max_value.odpm_value_[odpm_index], kUpdateMax)) {
+        if (matchOdpm(line, &reading)) {
+            updateValue(reading, &max_value->odpm_value_[odpm_index], kUpdateMax);
             odpm_index++;
             // Discarding previous value and update with new ODPM value
             if (odpm_index == ODPM_MAX_IDX) {
@@ -412,11 +583,6 @@ void BrownoutDetectedReporter::logBrownout(const std::shared_ptr<IStats> &stats_
             continue;
         }
     }
-    if (!isAlreadyUpdated && max_value.battery_temp_ != DEFAULT_BATTERY_TEMP) {
-        std::string file_content = "LASTMEAL_UPDATED\n" + logFile;
-        android::base::WriteStringToFile(file_content, logFilePath);
-        uploadData(stats_client, max_value);
-    }
 }
 
 }  // namespace pixel
@@ -21,10 +21,13 @@
 #include <log/log.h>
 #include <pixelstats/ChargeStatsReporter.h>
 #include <pixelstats/StatsHelper.h>
+#include <pixelstats/SysfsReader.h>
 #include <time.h>
 #include <utils/Timers.h>
 
 #include <cmath>
+#include <cstdlib>
+#include <string_view>
 
 namespace android {
 namespace hardware {
@@ -40,9 +43,18 @@ using android::hardware::google::pixel::PixelAtoms::ChargeStats;
 using android::hardware::google::pixel::PixelAtoms::VoltageTierStats;
 
 #define DURATION_FILTER_SECS 15
-#define CHG_STATS_FMT0 "%d,%d,%d, %d,%d,%d,%d"
-#define CHG_STATS_FMT1 "%d,%d,%d, %d,%d,%d,%d %d" /* AACR */
-#define CHG_STATS_FMT2 "%d,%d,%d, %d,%d,%d,%d %d %d,%d" /* AACR + CSI */
+
+/*
+ * The charge stats line is one of
+ *   "%d,%d,%d, %d,%d,%d,%d"
+ *   "%d,%d,%d, %d,%d,%d,%d %d"        AACR
+ *   "%d,%d,%d, %d,%d,%d,%d %d %d,%d"  AACR + CSI
+ * each extending the one before, so the line is scanned once and its format
+ * told by how many values it has. The separator before each value, ' ' for
+ * whitespace only:
+ */
+static constexpr char kChargeStatsSeparators[] = {' ', ',', ',', ',', ',',
+                                                  ',', ',', ' ', ' ', ','};
 
 ChargeStatsReporter::ChargeStatsReporter() {}
 
@@ -54,7 +66,7 @@ void ChargeStatsReporter::ReportChargeStats(const std::shared_ptr<IStats> &stats
                                             const std::string line, const std::string wline_at,
                                             const std::string wline_ac,
                                             const std::string pca_line) {
-    int charge_stats_fields[] = {
+    static constexpr int charge_stats_fields[] = {
             ChargeStats::kAdapterTypeFieldNumber,
             ChargeStats::kAdapterVoltageFieldNumber,
             ChargeStats::kAdapterAmperageFieldNumber,
@@ -75,30 +87,32 @@ void ChargeStatsReporter::ReportChargeStats(const std::shared_ptr<IStats> &stats
     };
     const int32_t chg_fields_size = std::size(charge_stats_fields);
     static_assert(chg_fields_size == 17, "Unexpected charge stats fields size");
+    static_assert(decltype(charge_stats_atom_)::hasFields(charge_stats_fields),
+                  "Charge stats field out of the atom");
     const int32_t wlc_fields_size = 7;
-    std::vector<VendorAtomValue> values(chg_fields_size);
-    VendorAtomValue val;
     int32_t i = 0, tmp[chg_fields_size] = {0}, fields_size = (chg_fields_size - wlc_fields_size);
     int32_t pca_ac[2] = {0}, pca_rs[5] = {0};
     std::string pdo_line, file_contents;
     std::istringstream ss;
 
     ALOGD("processing %s", line.c_str());
-    if (sscanf(line.c_str(), CHG_STATS_FMT2, &tmp[0], &tmp[1], &tmp[2], &tmp[3], &tmp[4], &tmp[5],
-               &tmp[6], &tmp[7], &tmp[8], &tmp[9]) == 10) {
+    std::string_view rest = line;
+    size_t num_values = 0;
+    while (num_values < std::size(kChargeStatsSeparators) &&
+           ScanSysfsInt(&rest, kChargeStatsSeparators[num_values], &tmp[num_values]))
+        num_values++;
+    if (num_values == 10) {
         /*
          * Charging Speed Indicator (CSI) the sum of the reasons that limit the charging speed in
          * this charging session.
          */
-    } else if (sscanf(line.c_str(), CHG_STATS_FMT1, &tmp[0], &tmp[1], &tmp[2], &tmp[3], &tmp[4],
-               &tmp[5], &tmp[6], &tmp[7]) == 8) {
+    } else if (num_values >= 8) {
         /*
          * Age Adjusted Charge Rate (AACR) logs an additional battery capacity in order to determine
          * the charge curve needed to minimize battery cycle life degradation, while also minimizing
          * impact to the user.
          */
-    } else if (sscanf(line.c_str(), CHG_STATS_FMT0, &tmp[0], &tmp[1], &tmp[2], &tmp[3], &tmp[4],
-                      &tmp[5], &tmp[6]) != 7) {
+    } else if (num_values != 7) {
         ALOGE("Couldn't process %s", line.c_str());
         return;
     }
@@ -140,7 +154,7 @@ void ChargeStatsReporter::ReportChargeStats(const std::shared_ptr<IStats> &stats
         }
     }
 
-    if (ReadFileToString(kGChargerMetricsPath.c_str(), &file_contents)) {
+    if (ReadFileToString(kGChargerMetricsPath, &file_contents)) {
         ss.str(file_contents);
         while (std::getline(ss, pdo_line)) {
             if (sscanf(pdo_line.c_str(), "D:%x,%x,%x,%x,%x,%x,%x", &pca_ac[0], &pca_ac[1], &pca_rs[0],
@@ -155,15 +169,10 @@ void ChargeStatsReporter::ReportChargeStats(const std::shared_ptr<IStats> &stats
         }
     }
 
-    for (i = 0; i < fields_size; i++) {
-        val.set<VendorAtomValue::intValue>(tmp[i]);
-        values[charge_stats_fields[i] - kVendorAtomOffset] = val;
-    }
+    charge_stats_atom_.reset();
+    for (i = 0; i < fields_size; i++) charge_stats_atom_.setInt(charge_stats_fields[i], tmp[i]);
 
-    VendorAtom event = {.reverseDomainName = "",
-                        .atomId = PixelAtoms::Atom::kChargeStats,
-                        .values = std::move(values)};
-    const ndk::ScopedAStatus ret = stats_client->reportVendorAtom(event);
+    const ndk::ScopedAStatus ret = stats_client->reportVendorAtom(charge_stats_atom_.atom());
     if (!ret.isOk())
         ALOGE("Unable to report ChargeStats to Stats service");
 }
@@ -171,7 +180,7 @@ void ChargeStatsReporter::ReportChargeStats(const std::shared_ptr<IStats> &stats
 void ChargeStatsReporter::ReportVoltageTierStats(const std::shared_ptr<IStats> &stats_client,
                                                  const char *line, const bool has_wireless = false,
                                                  const std::string &wfile_contents = "") {
-    int voltage_tier_stats_fields[] = {
+    static constexpr int voltage_tier_stats_fields[] = {
             VoltageTierStats::kVoltageTierFieldNumber,
             VoltageTierStats::kSocInFieldNumber, /* retrieved via ssoc_tmp */
             VoltageTierStats::kCcInFieldNumber,
@@ -195,18 +204,29 @@ void ChargeStatsReporter::ReportVoltageTierStats(const std::shared_ptr<IStats> &
 
     const int32_t vtier_fields_size = std::size(voltage_tier_stats_fields);
     static_assert(vtier_fields_size == 20, "Unexpected voltage tier stats fields size");
+    static_assert(decltype(voltage_tier_atom_)::hasFields(voltage_tier_stats_fields),
+                  "Voltage tier stats field out of the atom");
     const int32_t wlc_fields_size = 4;
-    std::vector<VendorAtomValue> values(vtier_fields_size);
-    VendorAtomValue val;
     float ssoc_tmp;
     int32_t i = 0, tmp[vtier_fields_size - 1] = {0}, /* ssoc_tmp is not saved in this array */
             fields_size = (vtier_fields_size - wlc_fields_size);
 
-    if (sscanf(line, "%d, %f,%d,%d, %d,%d,%d, %d,%d,%d, %d,%d,%d, %d,%d,%d", &tmp[0], &ssoc_tmp,
-               &tmp[1], &tmp[2], &tmp[3], &tmp[4], &tmp[5], &tmp[6], &tmp[7], &tmp[8], &tmp[9],
-               &tmp[10], &tmp[11], &tmp[12], &tmp[13], &tmp[14]) != 16) {
-        /* If format isn't as expected, then ignore line on purpose */
+    /*
+     * The line is "%d, %f,%d,%d, %d,%d,%d, %d,%d,%d, %d,%d,%d, %d,%d,%d". The %f is read
+     * with strtof() as sscanf() does, which needs the rest of the NUL terminated line.
+     * If format isn't as expected, then ignore line on purpose.
+     */
+    std::string_view rest = line;
+    if (!ScanSysfsInt(&rest, ' ', &tmp[0]) || rest.empty() || rest[0] != ',')
+        return;
+    char *soc_end;
+    ssoc_tmp = strtof(rest.data() + 1, &soc_end);
+    if (soc_end == rest.data() + 1)
         return;
+    rest.remove_prefix(soc_end - rest.data());
+    for (i = 1; i < 15; i++) {
+        if (!ScanSysfsInt(&rest, ',', &tmp[i]))
+            return;
     }
 
     if (has_wireless) {
@@ -220,19 +240,13 @@ void ChargeStatsReporter::ReportVoltageTierStats(const std::shared_ptr<IStats> &
     }
 
     ALOGD("VoltageTierStats: processed %s", line);
-    val.set<VendorAtomValue::intValue>(tmp[0]);
-    values[voltage_tier_stats_fields[0] - kVendorAtomOffset] = val;
-    val.set<VendorAtomValue::floatValue>(ssoc_tmp);
-    values[voltage_tier_stats_fields[1] - kVendorAtomOffset] = val;
-    for (i = 2; i < fields_size; i++) {
-        val.set<VendorAtomValue::intValue>(tmp[i - 1]);
-        values[voltage_tier_stats_fields[i] - kVendorAtomOffset] = val;
-    }
+    voltage_tier_atom_.reset();
+    voltage_tier_atom_.setInt<VoltageTierStats::kVoltageTierFieldNumber>(tmp[0]);
+    voltage_tier_atom_.setFloat<VoltageTierStats::kSocInFieldNumber>(ssoc_tmp);
+    for (i = 2; i < fields_size; i++)
+        voltage_tier_atom_.setInt(voltage_tier_stats_fields[i], tmp[i - 1]);
 
-    VendorAtom event = {.reverseDomainName = "",
-                        .atomId = PixelAtoms::Atom::kVoltageTierStats,
-                        .values = std::move(values)};
-    const ndk::ScopedAStatus ret = stats_client->reportVendorAtom(event);
+    const ndk::ScopedAStatus ret = stats_client->reportVendorAtom(voltage_tier_atom_.atom());
     if (!ret.isOk())
         ALOGE("Unable to report VoltageTierStats to Stats service");
 }
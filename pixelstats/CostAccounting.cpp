@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "pixelstats-vendor"
+
+#include <android-base/file.h>
+#include <fcntl.h>
+#include <pixelstats/CostAccounting.h>
+#include <pixelstats/SysfsReader.h>
+#include <pixelstats/VendorAtomQueue.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <utils/Log.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+namespace {
+
+int64_t clockMicros(clockid_t clock) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+// The rchar of a /proc/<tid>/io, which comes first. *read_size is the size of
+// the read, which the next rchar counts.
+int64_t readRchar(int io_fd, int64_t *read_size) {
+    char buffer[256];
+    const ssize_t size = TEMP_FAILURE_RETRY(pread(io_fd, buffer, sizeof(buffer), 0));
+    *read_size = std::max<ssize_t>(size, 0);
+    if (size <= 0)
+        return -1;
+
+    std::string_view text(buffer, size);
+    uint64_t rchar;
+    if (NextSysfsToken(&text, " \n") != "rchar:" ||
+        !ParseSysfsUint(NextSysfsToken(&text, " \n"), &rchar))
+        return -1;
+    return rchar;
+}
+
+// The value in kB of the "<name>: <value> kB" line of /proc/self content, -1 if missing
+int64_t findProcKb(std::string_view content, std::string_view name) {
+    while (!content.empty()) {
+        const size_t end = content.find('\n');
+        std::string_view line = content.substr(0, end);
+        content.remove_prefix(end == std::string_view::npos ? content.size() : end + 1);
+        if (NextSysfsToken(&line, " \t") != name)
+            continue;
+        uint64_t kb;
+        return ParseSysfsUint(NextSysfsToken(&line, " \t"), &kb) ? kb : -1;
+    }
+    return -1;
+}
+
+std::mutex cost_dumps_lock;
+// Guarded by cost_dumps_lock
+std::vector<std::pair<const void *, std::function<void(int fd)>>> cost_dumps;
+
+}  // namespace
+
+void CostStats::add(const Cost &cost) {
+    runs++;
+    total_wall_us += cost.wall_us;
+    max_wall_us = std::max(max_wall_us, cost.wall_us);
+    total_cpu_us += cost.cpu_us;
+    max_cpu_us = std::max(max_cpu_us, cost.cpu_us);
+    if (cost.read_bytes > 0)
+        read_bytes += cost.read_bytes;
+    atoms += cost.atoms;
+}
+
+void CostStats::dump(int fd, const char *name) const {
+    dprintf(fd,
+            "  %s: runs %" PRId64 " wall total %" PRId64 "us max %" PRId64 "us cpu total %" PRId64
+            "us max %" PRId64 "us read %" PRId64 " bytes atoms %" PRId64 "\n",
+            name, runs, total_wall_us, max_wall_us, total_cpu_us, max_cpu_us, read_bytes, atoms);
+}
+
+void DumpProcessMemory(int fd) {
+    std::string rollup, status;
+    android::base::ReadFileToString("/proc/self/smaps_rollup", &rollup);
+    android::base::ReadFileToString("/proc/self/status", &status);
+    dprintf(fd,
+            "Memory: rss %" PRId64 " kB pss %" PRId64 " kB private dirty %" PRId64
+            " kB peak rss %" PRId64 " kB\n",
+            findProcKb(rollup, "Rss:"), findProcKb(rollup, "Pss:"),
+            findProcKb(rollup, "Private_Dirty:"), findProcKb(status, "VmHWM:"));
+}
+
+android::base::unique_fd OpenThreadIo() {
+    return android::base::unique_fd(
+            TEMP_FAILURE_RETRY(open("/proc/thread-self/io", O_RDONLY | O_CLOEXEC)));
+}
+
+CostMeter::CostMeter(int io_fd) : io_fd_(io_fd) {
+    start_read_bytes_ = -1;
+    if (io_fd_ >= 0) {
+        int64_t read_size;
+        start_read_bytes_ = readRchar(io_fd_, &read_size);
+        if (start_read_bytes_ >= 0)
+            start_read_bytes_ += read_size;
+    }
+    start_atoms_ = ThreadQueuedAtomCount();
+    start_cpu_us_ = clockMicros(CLOCK_THREAD_CPUTIME_ID);
+    start_wall_us_ = clockMicros(CLOCK_BOOTTIME);
+}
+
+Cost CostMeter::stop() {
+    Cost cost;
+    cost.wall_us = clockMicros(CLOCK_BOOTTIME) - start_wall_us_;
+    cost.cpu_us = clockMicros(CLOCK_THREAD_CPUTIME_ID) - start_cpu_us_;
+    cost.atoms = ThreadQueuedAtomCount() - start_atoms_;
+    cost.read_bytes = -1;
+    if (start_read_bytes_ >= 0) {
+        int64_t read_size;
+        const int64_t rchar = readRchar(io_fd_, &read_size);
+        if (rchar >= start_read_bytes_)
+            cost.read_bytes = rchar - start_read_bytes_;
+    }
+    return cost;
+}
+
+void AddCostDump(const void *owner, std::function<void(int fd)> dump) {
+    std::lock_guard<std::mutex> lock(cost_dumps_lock);
+    cost_dumps.emplace_back(owner, std::move(dump));
+}
+
+void RemoveCostDump(const void *owner) {
+    std::lock_guard<std::mutex> lock(cost_dumps_lock);
+    cost_dumps.erase(std::remove_if(cost_dumps.begin(), cost_dumps.end(),
+                                    [owner](const auto &entry) { return entry.first == owner; }),
+                     cost_dumps.end());
+}
+
+bool WriteCostDumps(const std::string &path) {
+    const std::string tmp_path = path + ".tmp";
+    android::base::unique_fd fd(TEMP_FAILURE_RETRY(
+            open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640)));
+    if (!fd.ok()) {
+        ALOGE("Unable to write %s - %s", tmp_path.c_str(), strerror(errno));
+        return false;
+    }
+    DumpProcessMemory(fd.get());
+    {
+        std::lock_guard<std::mutex> lock(cost_dumps_lock);
+        for (const auto &[owner, dump] : cost_dumps) dump(fd.get());
+    }
+    fd.reset();
+    if (rename(tmp_path.c_str(), path.c_str())) {
+        ALOGE("Unable to rename %s - %s", tmp_path.c_str(), strerror(errno));
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
@@ -18,6 +18,7 @@
 #include <chre_host/socket_client.h>
 #include <pixelstats/DropDetect.h>
 #include <pixelstats/StatsHelper.h>
+#include <pixelstats/VendorAtomQueue.h>
 #include <pixelstatsatoms.h>
 
 #define LOG_TAG "pixelstats-vendor"
@@ -25,8 +26,8 @@
 
 #include <inttypes.h>
 #include <math.h>
+#include <string.h>
 
-using aidl::android::frameworks::stats::IStats;
 using aidl::android::frameworks::stats::VendorAtom;
 using aidl::android::frameworks::stats::VendorAtomValue;
 using android::sp;
@@ -102,11 +103,29 @@ void DropDetect::onConnected() {
 /**
  * Decode unix socket msgs to CHRE messages, and call the appropriate
  * callback depending on the CHRE message.
+ * Nanoapp messages, the only frequent ones, are read in place from the
+ * verified buffer instead of being unpacked to a NanoappMessageT.
  */
 void DropDetect::onMessageReceived(const void *data, size_t length) {
-    if (!HostProtocolHost::decodeMessageFromChre(data, length, *this)) {
+    flatbuffers::Verifier verifier(static_cast<const uint8_t *>(data), length);
+    if (!fbs::VerifyMessageContainerBuffer(verifier)) {
         ALOGE("Failed to decode message");
+        return;
     }
+
+    const fbs::MessageContainer *container = fbs::GetMessageContainer(data);
+    if (container->message_type() != fbs::ChreMessage::NanoappMessage) {
+        if (!HostProtocolHost::decodeMessageFromChre(data, length, *this)) {
+            ALOGE("Failed to decode message");
+        }
+        return;
+    }
+
+    const fbs::NanoappMessage *message = container->message_as_NanoappMessage();
+    if (message->app_id() != kDropDetectAppId || message->message() == nullptr)
+        return;
+    handleDropMessage(message->message_type(), message->message()->data(),
+                      message->message()->size());
 }
 
 /**
@@ -167,15 +186,12 @@ static VendorAtom dropEventFromNanoappPayload(const struct DropEventPayloadV2 *p
                             accel_peak_thousandths_g, free_fall_duration_ms);
 }
 
-static void reportDropEventToStatsd(const VendorAtom &atom) {
-    const std::shared_ptr<IStats> stats_client = getStatsService();
-    if (!stats_client) {
-        ALOGE("Unable to get AIDL Stats service");
-        return;
-    }
-
-    const ndk::ScopedAStatus ret = stats_client->reportVendorAtom(atom);
-    if (!ret.isOk()) {
+/**
+ * Queue the atom for the sender thread of the VendorAtomQueue, the CHRE
+ * socket thread never waits on the Stats service.
+ */
+static void reportDropEventToStatsd(VendorAtom atom) {
+    if (!getVendorAtomQueue()->enqueue(std::move(atom))) {
         ALOGE("Unable to report VENDOR_PHYSICAL_DROP_DETECTED to Stats service");
     }
 }
@@ -188,14 +204,20 @@ void DropDetect::handleNanoappMessage(const fbs::NanoappMessageT &message) {
     if (message.app_id != kDropDetectAppId)
         return;
 
-    if (message.message_type == kDropEventDetection &&
-        message.message.size() >= sizeof(struct DropEventPayload)) {
-        reportDropEventToStatsd(dropEventFromNanoappPayload(
-            reinterpret_cast<const struct DropEventPayload *>(&message.message[0])));
-    } else if (message.message_type == kDropEventDetectionV2 &&
-               message.message.size() >= sizeof(struct DropEventPayloadV2)) {
-        reportDropEventToStatsd(dropEventFromNanoappPayload(
-            reinterpret_cast<const struct DropEventPayloadV2 *>(&message.message[0])));
+    handleDropMessage(message.message_type, message.message.data(), message.message.size());
+}
+
+void DropDetect::handleDropMessage(uint32_t message_type, const uint8_t *payload, size_t size) {
+    // The payload in the flatbuffer has no alignment guarantee
+    if (message_type == kDropEventDetection && size >= sizeof(struct DropEventPayload)) {
+        struct DropEventPayload event;
+        memcpy(&event, payload, sizeof(event));
+        reportDropEventToStatsd(dropEventFromNanoappPayload(&event));
+    } else if (message_type == kDropEventDetectionV2 &&
+               size >= sizeof(struct DropEventPayloadV2)) {
+        struct DropEventPayloadV2 event;
+        memcpy(&event, payload, sizeof(event));
+        reportDropEventToStatsd(dropEventFromNanoappPayload(&event));
     }
 }
 
@@ -18,7 +18,6 @@
 
 #include <aidl/android/frameworks/stats/IStats.h>
 #include <android-base/file.h>
-#include <android-base/parsedouble.h>
 #include <android-base/parseint.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
@@ -31,6 +30,8 @@
 #include <unistd.h>
 #include <utils/Log.h>
 
+#include <algorithm>
+#include <chrono>
 #include <numeric>
 
 #define SZ_4K 0x00001000
@@ -110,6 +111,12 @@ const std::vector<MmMetricsReporter::ProcStatMetricsInfo> MmMetricsReporter::kPr
         {"cpu", 4, PixelMmMetricsPerDay::kCpuIoWaitTimeCsFieldNumber, true},
 };
 
+const std::vector<MmMetricsReporter::KthreadStimeInfo> MmMetricsReporter::kKthreadStimeInfo = {
+        {"kswapd", true, PixelMmMetricsPerDay::kKswapdStimeClksFieldNumber},
+        {"kcompactd", true, PixelMmMetricsPerDay::kKcompactdStimeClksFieldNumber},
+        {"khugepaged", false, PixelMmMetricsPerDay::kKhugepagedStimeClksFieldNumber},
+};
+
 const std::vector<MmMetricsReporter::MmMetricsInfo> MmMetricsReporter::kCmaStatusInfo = {
         {"alloc_pages_attempts", CmaStatus::kCmaAllocPagesAttemptsFieldNumber, true},
         {"alloc_pages_failfast_attempts", CmaStatus::kCmaAllocPagesSoftAttemptsFieldNumber, true},
@@ -166,6 +173,26 @@ bool MmMetricsReporter::checkKernelMMMetricSupport() {
     return !err_require_all && !err_require_one_ion_total_pools_path;
 }
 
+namespace {
+
+constexpr char kZramAutotuneModeProperty[] = "persist.vendor.zram.autotune";
+// Sizes the autotune moves between, smallest first, each with a fstab.zram.<size>
+constexpr char kZramAutotuneLadderProperty[] = "ro.vendor.zram.autotune.ladder";
+constexpr char kZramDefaultLadder[] = "40p,50p,60p";
+constexpr char kZramSizeProperty[] = "vendor.zram.size";
+constexpr char kZramRecommendedSizeProperty[] = "vendor.zram.autotune.recommended";
+constexpr char kZramBootSizeProperty[] = "persist.vendor.boot.zram.size";
+
+template <typename Info>
+std::vector<std::string> metricNames(const std::vector<Info> &metrics_info) {
+    std::vector<std::string> names;
+    for (const auto &entry : metrics_info)
+        names.push_back(entry.name);
+    return names;
+}
+
+}  // namespace
+
 MmMetricsReporter::MmMetricsReporter()
     : kVmstatPath("/proc/vmstat"),
       kIonTotalPoolsPath("/sys/kernel/dma_heap/total_pools_kb"),
@@ -176,26 +203,25 @@ MmMetricsReporter::MmMetricsReporter()
       kPixelStatMm("/sys/kernel/pixel_stat/mm"),
       kMeminfoPath("/proc/meminfo"),
       kProcStatPath("/proc/stat"),
+      kZramMmStatPath("/sys/block/zram0/mm_stat"),
+      kPerHourTable(metricNames(kMmMetricsPerHourInfo)),
+      kPerDayTable(metricNames(kMmMetricsPerDayInfo)),
+      kZramMeminfoTable({"SwapTotal", "SwapFree"}),
+      kZramVmstatTable({"workingset_refault_anon"}),
       prev_compaction_duration_(kNumCompactionDurationPrevMetrics, 0),
       prev_direct_reclaim_(kNumDirectReclaimPrevMetrics, 0) {
     ker_mm_metrics_support_ = checkKernelMMMetricSupport();
+    // Avoid avc denial since pixelstats-vendor doesn't have the permission to access /proc/1
+    process_table_.ignore(1);
 }
 
 bool MmMetricsReporter::ReadFileToUint(const std::string &path, uint64_t *val) {
-    std::string file_contents;
-
-    if (!ReadFileToString(path, &file_contents)) {
+    if (!sysfs_reader_.readUint(path, val)) {
         // Don't print this log if the file doesn't exist, since logs will be printed repeatedly.
         if (errno != ENOENT) {
-            ALOGI("Unable to read %s - %s", path.c_str(), strerror(errno));
+            ALOGI("Unable to read %s as uint - %s", path.c_str(), strerror(errno));
         }
         return false;
-    } else {
-        file_contents = android::base::Trim(file_contents);
-        if (!android::base::ParseUint(file_contents, val)) {
-            ALOGI("Unable to convert %s to uint - %s", path.c_str(), strerror(errno));
-            return false;
-        }
     }
     return true;
 }
@@ -301,41 +327,29 @@ bool MmMetricsReporter::reportVendorAtom(const std::shared_ptr<IStats> &stats_cl
 
 /**
  * Parse sysfs node in Name/Value pair form, including /proc/vmstat and /proc/meminfo
- * Name could optionally with a colon (:) suffix (will be removed to produce the output map),
+ * Name could optionally with a colon (:) suffix,
  * extra columns (e.g. 3rd column 'kb' for /proc/meminfo) will be discarded.
- * Return value: a map containing the pairs of {field_string, data}.
+ * Only the names in table are kept, at their index in table.
+ * Return value: false, with values empty(), on read or parse errors or an empty node.
  */
-std::map<std::string, uint64_t> MmMetricsReporter::readSysfsNameValue(const std::string &path) {
-    std::string file_contents;
-    std::map<std::string, uint64_t> metrics;
-
-    if (!ReadFileToString(path, &file_contents)) {
+bool MmMetricsReporter::readSysfsNameValue(const std::string &path,
+                                           const SysfsNameValueTable &table,
+                                           SysfsNameValues *values) {
+    std::string_view file_contents;
+    if (!sysfs_reader_.read(path, &file_contents)) {
         ALOGE("Unable to read vmstat from %s, err: %s", path.c_str(), strerror(errno));
-        return metrics;
+        values->values.assign(table.size(), 0);
+        values->present.assign(table.size(), false);
+        values->valid = false;
+        return false;
     }
 
-    std::istringstream data(file_contents);
-    std::string line;
-    int line_num = 0;
-
-    while (std::getline(data, line)) {
-        line_num++;
-        std::vector<std::string> words = android::base::Tokenize(line, " ");
-
-        uint64_t i;
-        if (words.size() < 2 || !android::base::ParseUint(words[1], &i)) {
-            ALOGE("File %s corrupted at line %d", path.c_str(), line_num);
-            metrics.clear();
-            break;
-        }
-
-        if (words[0][words[0].length() - 1] == ':')
-            words[0].pop_back();
-
-        metrics[words[0]] = i;
+    int bad_line;
+    if (!table.parse(file_contents, values, &bad_line)) {
+        ALOGE("File %s corrupted at line %d", path.c_str(), bad_line);
+        return false;
     }
-
-    return metrics;
+    return !values->empty();
 }
 
 /**
@@ -416,6 +430,59 @@ uint64_t MmMetricsReporter::getGpuMemory() {
     return gpu_size;
 }
 
+/**
+ * Same as the map based fillAtomValues() below, for metrics read through the
+ * SysfsNameValueTable built from metrics_info: entry i of metrics_info is at
+ * index i of mm_metrics.
+ */
+bool MmMetricsReporter::fillAtomValues(const std::vector<MmMetricsInfo> &metrics_info,
+                                       const SysfsNameValues &mm_metrics,
+                                       SysfsNameValues *prev_mm_metrics,
+                                       std::vector<VendorAtomValue> *atom_values) {
+    bool err = false;
+    VendorAtomValue tmp;
+    tmp.set<VendorAtomValue::longValue>(0);
+    // resize atom_values to add all fields defined in metrics_info
+    int max_idx = 0;
+    for (auto &entry : metrics_info) {
+        if (max_idx < entry.atom_key)
+            max_idx = entry.atom_key;
+    }
+    unsigned int size = max_idx - kVendorAtomOffset + 1;
+    if (atom_values->size() < size)
+        atom_values->resize(size, tmp);
+
+    for (size_t i = 0; i < metrics_info.size() && i < mm_metrics.present.size(); ++i) {
+        const MmMetricsInfo &entry = metrics_info[i];
+        int atom_idx = entry.atom_key - kVendorAtomOffset;
+
+        if (!mm_metrics.present[i])
+            continue;
+
+        uint64_t cur_value = mm_metrics.values[i];
+        uint64_t prev_value = 0;
+        if (prev_mm_metrics == nullptr && entry.update_diff) {
+            // Bug: We need previous saved metrics to calculate the difference.
+            ALOGE("FIX ME: shouldn't reach here: "
+                  "Diff upload required by prev_mm_metrics not provided.");
+            err = true;
+            continue;
+        } else if (entry.update_diff) {
+            // reaching here implies: prev_mm_metrics != nullptr
+            // Not present implies it's the 1st data: nothing to do, since prev_value already = 0
+            if (i < prev_mm_metrics->present.size() && prev_mm_metrics->present[i])
+                prev_value = prev_mm_metrics->values[i];
+        }
+
+        tmp.set<VendorAtomValue::longValue>(cur_value - prev_value);
+        (*atom_values)[atom_idx] = tmp;
+    }
+    if (prev_mm_metrics && !err) {
+        (*prev_mm_metrics) = mm_metrics;
+    }
+    return !err;
+}
+
 /**
  * fillAtomValues() is used to copy Mm metrics to values
  * metrics_info: This is a vector of MmMetricsInfo {field_string, atom_key, update_diff}
@@ -620,48 +687,136 @@ bool MmMetricsReporter::fillProcStat(const std::vector<ProcStatMetricsInfo> &met
 
 void MmMetricsReporter::aggregatePixelMmMetricsPer5Min() {
     aggregatePressureStall();
+    sampleZramTuner();
 }
 
-void MmMetricsReporter::logPixelMmMetricsPerHour(const std::shared_ptr<IStats> &stats_client) {
-    std::vector<VendorAtomValue> values = genPixelMmMetricsPerHour();
+std::string MmMetricsReporter::getZramAutotuneMode() {
+    return android::base::GetProperty(kZramAutotuneModeProperty, "off");
+}
 
-    if (values.size() != 0) {
-        // Send vendor atom to IStats HAL
-        reportVendorAtom(stats_client, PixelAtoms::Atom::kPixelMmMetricsPerHour, values,
-                         "PixelMmMetricsPerHour");
+/**
+ * Feed zram_tuner_ while the autotune is on. The memory stall total comes
+ * from the PSI read aggregatePressureStall() just did.
+ */
+void MmMetricsReporter::sampleZramTuner() {
+    if (getZramAutotuneMode() == "off")
+        return;
+
+    // memory is the last PSI file and "some" its last category
+    const long memory_some_us = psi_total_[kPsiNumAllTotals - 1];
+    if (memory_some_us < 0)
+        return;
+
+    ZramTuner::Sample sample;
+    std::string_view mm_stat;
+    if (!sysfs_reader_.read(getSysfsPath(kZramMmStatPath), &mm_stat) ||
+        !ParseSysfsUint(NextSysfsToken(&mm_stat, " \n"), &sample.orig_data_size) ||
+        !ParseSysfsUint(NextSysfsToken(&mm_stat, " \n"), &sample.compr_data_size))
+        return;
+
+    SysfsNameValues meminfo;
+    SysfsNameValues vmstat;
+    if (!readSysfsNameValue(getSysfsPath(kMeminfoPath), kZramMeminfoTable, &meminfo) ||
+        !readSysfsNameValue(getSysfsPath(kVmstatPath), kZramVmstatTable, &vmstat))
+        return;
+    if (!meminfo.present[0] || !meminfo.present[1] || !vmstat.present[0])
+        return;
+
+    sample.swap_total_kb = meminfo.values[0];
+    sample.swap_free_kb = meminfo.values[1];
+    sample.refault_anon = vmstat.values[0];
+    sample.memory_some_us = memory_some_us;
+    sample.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                             std::chrono::steady_clock::now().time_since_epoch())
+                             .count();
+    zram_tuner_.addSample(sample);
+}
+
+/**
+ * In "recommend" mode the size is only published in
+ * vendor.zram.autotune.recommended; in "apply" mode it is also written to
+ * persist.vendor.boot.zram.size, which init swaps on from the next boot.
+ */
+void MmMetricsReporter::fillZramTuning(std::vector<VendorAtomValue> *values) {
+    const std::string mode = getZramAutotuneMode();
+    ZramTuner::Decision decision;
+    if (mode != "off") {
+        decision = zram_tuner_.decide(
+                android::base::GetProperty(kZramSizeProperty, ""),
+                android::base::GetProperty(kZramAutotuneLadderProperty, kZramDefaultLadder));
     }
+
+    if (decision.action != PixelMmMetricsPerDay::ZRAM_SIZE_NONE) {
+        android::base::SetProperty(kZramRecommendedSizeProperty, decision.size);
+        if (mode == "apply" && decision.action != PixelMmMetricsPerDay::ZRAM_SIZE_KEEP) {
+            ALOGI("zram size %s for the next boot", decision.size.c_str());
+            android::base::SetProperty(kZramBootSizeProperty, decision.size);
+        }
+    }
+
+    VendorAtomValue tmp;
+    tmp.set<VendorAtomValue::intValue>(decision.action);
+    (*values)[PixelMmMetricsPerDay::kZramSizeActionFieldNumber - kVendorAtomOffset] = tmp;
+    tmp.set<VendorAtomValue::longValue>(decision.compression_ratio_pct);
+    (*values)[PixelMmMetricsPerDay::kZramCompressionRatioPctFieldNumber - kVendorAtomOffset] = tmp;
+    tmp.set<VendorAtomValue::longValue>(decision.peak_swap_used_pct);
+    (*values)[PixelMmMetricsPerDay::kZramPeakSwapUsedPctFieldNumber - kVendorAtomOffset] = tmp;
+    tmp.set<VendorAtomValue::longValue>(decision.memory_pressure_permille);
+    (*values)[PixelMmMetricsPerDay::kZramMemoryPressurePermilleFieldNumber - kVendorAtomOffset] =
+            tmp;
+    tmp.set<VendorAtomValue::longValue>(decision.refault_anon_per_hour);
+    (*values)[PixelMmMetricsPerDay::kZramRefaultAnonPerHourFieldNumber - kVendorAtomOffset] = tmp;
 }
 
-std::vector<VendorAtomValue> MmMetricsReporter::genPixelMmMetricsPerHour() {
+void MmMetricsReporter::startPsiMonitor() {
     if (!MmMetricsSupported())
-        return std::vector<VendorAtomValue>();
+        return;
+    if (!psi_monitor_.start(getSysfsPath(kPsiBasePath)))
+        ALOGW("PSI triggers unavailable, pressure stall spikes are not reported");
+}
 
-    std::map<std::string, uint64_t> vmstat = readSysfsNameValue(getSysfsPath(kVmstatPath));
-    if (vmstat.size() == 0)
-        return std::vector<VendorAtomValue>();
+void MmMetricsReporter::logPixelMmMetricsPerHour(const std::shared_ptr<IStats> &stats_client) {
+    if (!buildPixelMmMetricsPerHour())
+        return;
+
+    // Send vendor atom to IStats HAL
+    const ndk::ScopedAStatus ret = stats_client->reportVendorAtom(per_hour_atom_.atom());
+    if (!ret.isOk())
+        ALOGE("Unable to report PixelMmMetricsPerHour to Stats service");
+}
 
-    std::map<std::string, uint64_t> meminfo = readSysfsNameValue(getSysfsPath(kMeminfoPath));
-    if (meminfo.size() == 0)
+std::vector<VendorAtomValue> MmMetricsReporter::genPixelMmMetricsPerHour() {
+    if (!buildPixelMmMetricsPerHour())
         return std::vector<VendorAtomValue>();
+    return per_hour_atom_.atom().values;
+}
+
+bool MmMetricsReporter::buildPixelMmMetricsPerHour() {
+    if (!MmMetricsSupported())
+        return false;
+
+    if (!readSysfsNameValue(getSysfsPath(kVmstatPath), kPerHourTable, &hour_vmstat_))
+        return false;
+
+    if (!readSysfsNameValue(getSysfsPath(kMeminfoPath), kPerHourTable, &hour_meminfo_))
+        return false;
 
     uint64_t ion_total_pools = getIonTotalPools();
     uint64_t gpu_memory = getGpuMemory();
 
-    // allocate enough values[] entries for the metrics.
     VendorAtomValue tmp;
     tmp.set<VendorAtomValue::longValue>(0);
-    int last_value_index = PixelMmMetricsPerHour::kDmabufKbFieldNumber - kVendorAtomOffset;
-    std::vector<VendorAtomValue> values(last_value_index + 1, tmp);
+    per_hour_atom_.reset(tmp);
+    std::vector<VendorAtomValue> *values = per_hour_atom_.values();
 
-    fillAtomValues(kMmMetricsPerHourInfo, vmstat, &prev_hour_vmstat_, &values);
-    fillAtomValues(kMmMetricsPerHourInfo, meminfo, nullptr, &values);
-    tmp.set<VendorAtomValue::longValue>(ion_total_pools);
-    values[PixelMmMetricsPerHour::kIonTotalPoolsFieldNumber - kVendorAtomOffset] = tmp;
-    tmp.set<VendorAtomValue::longValue>(gpu_memory);
-    values[PixelMmMetricsPerHour::kGpuMemoryFieldNumber - kVendorAtomOffset] = tmp;
-    fillPressureStallAtom(&values);
+    fillAtomValues(kMmMetricsPerHourInfo, hour_vmstat_, &prev_hour_vmstat_, values);
+    fillAtomValues(kMmMetricsPerHourInfo, hour_meminfo_, nullptr, values);
+    per_hour_atom_.setLong<PixelMmMetricsPerHour::kIonTotalPoolsFieldNumber>(ion_total_pools);
+    per_hour_atom_.setLong<PixelMmMetricsPerHour::kGpuMemoryFieldNumber>(gpu_memory);
+    fillPressureStallAtom(values);
+    fillPsiSpikeAtom(values);
 
-    return values;
+    return true;
 }
 
 void MmMetricsReporter::logPixelMmMetricsPerDay(const std::shared_ptr<IStats> &stats_client) {
@@ -678,8 +833,8 @@ std::vector<VendorAtomValue> MmMetricsReporter::genPixelMmMetricsPerDay() {
     if (!MmMetricsSupported())
         return std::vector<VendorAtomValue>();
 
-    std::map<std::string, uint64_t> vmstat = readSysfsNameValue(getSysfsPath(kVmstatPath));
-    if (vmstat.size() == 0)
+    SysfsNameValues vmstat;
+    if (!readSysfsNameValue(getSysfsPath(kVmstatPath), kPerDayTable, &vmstat))
         return std::vector<VendorAtomValue>();
 
     std::map<std::string, std::vector<uint64_t>> procstat =
@@ -693,12 +848,13 @@ std::vector<VendorAtomValue> MmMetricsReporter::genPixelMmMetricsPerDay() {
     std::vector<long> compaction_duration;
     readCompactionDurationStat(&compaction_duration);
 
-    bool is_first_atom = (prev_day_vmstat_.size() == 0) ? true : false;
+    bool is_first_atom = prev_day_vmstat_.empty();
 
     // allocate enough values[] entries for the metrics.
     VendorAtomValue tmp;
     tmp.set<VendorAtomValue::longValue>(0);
-    int last_value_index = PixelMmMetricsPerDay::kKswapdPageoutRunFieldNumber - kVendorAtomOffset;
+    int last_value_index =
+            PixelMmMetricsPerDay::kZramRefaultAnonPerHourFieldNumber - kVendorAtomOffset;
     std::vector<VendorAtomValue> values(last_value_index + 1, tmp);
 
     if (!fillAtomValues(kMmMetricsPerDayInfo, vmstat, &prev_day_vmstat_, &values)) {
@@ -708,18 +864,17 @@ std::vector<VendorAtomValue> MmMetricsReporter::genPixelMmMetricsPerDay() {
         return std::vector<VendorAtomValue>();
     }
 
-    std::map<std::string, uint64_t> pixel_vmstat = readSysfsNameValue(
-            getSysfsPath(android::base::StringPrintf("%s/vmstat", kPixelStatMm).c_str()));
+    SysfsNameValues pixel_vmstat;
+    readSysfsNameValue(
+            getSysfsPath(android::base::StringPrintf("%s/vmstat", kPixelStatMm).c_str()),
+            kPerDayTable, &pixel_vmstat);
     if (!fillAtomValues(kMmMetricsPerDayInfo, pixel_vmstat, &prev_day_pixel_vmstat_, &values)) {
         // resets previous read since we reject the current one: so that we will
         // need two more reads to get a new diff.
         prev_day_vmstat_.clear();
         return std::vector<VendorAtomValue>();
     }
-    fillProcessStime(PixelMmMetricsPerDay::kKswapdStimeClksFieldNumber, "kswapd0",
-                     &prev_kswapd_pid_, &prev_kswapd_stime_, &values);
-    fillProcessStime(PixelMmMetricsPerDay::kKcompactdStimeClksFieldNumber, "kcompactd0",
-                     &prev_kcompactd_pid_, &prev_kcompactd_stime_, &values);
+    fillKthreadStime(&values);
     fillDirectReclaimStatAtom(direct_reclaim, &values);
     fillCompactionDurationStatAtom(compaction_duration, &values);
 
@@ -727,6 +882,7 @@ std::vector<VendorAtomValue> MmMetricsReporter::genPixelMmMetricsPerDay() {
         prev_procstat_.clear();
         return std::vector<VendorAtomValue>();
     }
+    fillZramTuning(&values);
 
     // Don't report the first atom to avoid big spike in accumulated values.
     if (is_first_atom) {
@@ -737,137 +893,136 @@ std::vector<VendorAtomValue> MmMetricsReporter::genPixelMmMetricsPerDay() {
 }
 
 /**
- * Return pid if /proc/<pid>/comm is equal to name, or -1 if not found.
+ * Return the entry of kKthreadStimeInfo matching a thread name, or nullptr.
+ * A per node thread may carry a ":<n>" suffix, as the threads kswapd<node>:<n>
+ * of a multi-threaded kswapd do.
  */
-int MmMetricsReporter::findPidByProcessName(const std::string &name) {
-    std::unique_ptr<DIR, int (*)(DIR *)> dir(opendir("/proc"), closedir);
-    if (!dir)
-        return -1;
-
-    int pid;
-    while (struct dirent *dp = readdir(dir.get())) {
-        if (dp->d_type != DT_DIR)
-            continue;
-
-        if (!android::base::ParseInt(dp->d_name, &pid))
-            continue;
-
-        // Avoid avc denial since pixelstats-vendor doesn't have the permission to access /proc/1
-        if (pid == 1)
+const MmMetricsReporter::KthreadStimeInfo *MmMetricsReporter::matchKthread(
+        std::string_view comm) {
+    for (const auto &info : kKthreadStimeInfo) {
+        if (comm.substr(0, info.name.size()) != info.name)
             continue;
-
-        std::string file_contents;
-        std::string path = android::base::StringPrintf("/proc/%s/comm", dp->d_name);
-        if (!ReadFileToString(path, &file_contents))
-            continue;
-
-        file_contents = android::base::Trim(file_contents);
-        if (file_contents.compare(name))
+        std::string_view node = comm.substr(info.name.size());
+        if (!info.per_node) {
+            if (node.empty())
+                return &info;
             continue;
+        }
+        if (!node.empty() && node[0] != ':' &&
+            node.find_first_not_of("0123456789:") == std::string_view::npos)
+            return &info;
+    }
+    return nullptr;
+}
 
-        return pid;
+std::vector<std::pair<int, std::string>> MmMetricsReporter::findKthreads() {
+    std::vector<std::pair<int, std::string>> kthreads;
+    std::vector<ProcessInfo> processes;
+    process_table_.update();
+    process_table_.changedSince(0, &processes);
+    for (const auto &process : processes) {
+        if (matchKthread(process.comm))
+            kthreads.emplace_back(process.pid, process.comm);
     }
-    return -1;
+    return kthreads;
+}
+
+std::string MmMetricsReporter::getKthreadStatPath(int pid, const std::string &comm) {
+    (void)comm;  // only needed by test code
+    return android::base::StringPrintf("/proc/%d/stat", pid);
 }
 
 /**
- * Get stime of a process from <path>, i.e. 15th field of <path> = /proc/<pid>/stat
- * Custom path (base path) could be used to inject data for test codes.
+ * Get stime of a kernel thread, i.e. 15th field of /proc/<pid>/stat, after
+ * checking that the pid still belongs to the thread.
  */
-int64_t MmMetricsReporter::getStimeByPathAndVerifyName(const std::string &path,
-                                                       const std::string &name) {
+bool MmMetricsReporter::readKthreadStime(const Kthread &kthread, uint64_t *stime) {
     const int stime_idx = 15;
-    const int name_idx = 2;
-    uint64_t stime;
-    int64_t ret;
-    std::string file_contents;
-    if (!ReadFileToString(path, &file_contents)) {
-        ALOGE("Unable to read %s, err: %s", path.c_str(), strerror(errno));
-        return -1;
-    }
-
-    std::vector<std::string> data = android::base::Split(file_contents, " ");
-    if (data.size() < stime_idx) {
-        ALOGE("Unable to find stime from %s. size: %zu", path.c_str(), data.size());
-        return -1;
-    }
-
-    std::string parenthesis_name = std::string("(") + name + ")";
-    if (parenthesis_name.compare(data[name_idx - 1]) != 0) {
-        ALOGE("Mismatched name for process stat: queried %s vs. found %s", parenthesis_name.c_str(),
-              data[name_idx - 1].c_str());
-        return -1;
-    }
-
-    if (android::base::ParseUint(data[stime_idx - 1], &stime)) {
-        ret = static_cast<int64_t>(stime);
-        return ret < 0 ? -1 : ret;
-    } else {
-        ALOGE("Stime Uint parse fail for process info path %s", path.c_str());
-        return -1;
-    }
-}
+    const std::string path = getKthreadStatPath(kthread.pid, kthread.comm);
+    std::string_view content;
+    if (!sysfs_reader_.read(path, &content))
+        return false;
 
-// returns /proc/<pid> on success, empty string on failure.
-// For test: use derived class to return custom path for test data injection.
-std::string MmMetricsReporter::getProcessStatPath(const std::string &name, int *prev_pid) {
-    if (prev_pid == nullptr) {
-        ALOGE("Should not reach here: prev_pid == nullptr");
-        return "";
+    // "<pid> (<comm>) <state> ...", the comm may hold spaces and parentheses
+    const size_t comm_start = content.find('(');
+    const size_t comm_end = content.rfind(')');
+    if (comm_start == std::string_view::npos || comm_end == std::string_view::npos ||
+        comm_end < comm_start ||
+        content.substr(comm_start + 1, comm_end - comm_start - 1) != kthread.comm) {
+        ALOGW("%s is no longer at pid %d", kthread.comm.c_str(), kthread.pid);
+        sysfs_reader_.evict(path);
+        return false;
     }
 
-    int pid = findPidByProcessName(name);
-    if (pid <= 0) {
-        ALOGE("Unable to find pid for %s, err: %s", name.c_str(), strerror(errno));
-        return "";
+    // The state is the 3rd field
+    std::string_view fields = content.substr(comm_end + 1);
+    std::string_view field;
+    for (int i = 3; i <= stime_idx; ++i) field = NextSysfsToken(&fields, " ");
+    if (!ParseSysfsUint(field, stime)) {
+        ALOGE("Unable to find stime from %s", path.c_str());
+        sysfs_reader_.evict(path);
+        return false;
     }
-
-    if (*prev_pid != -1 && pid != *prev_pid)
-        ALOGW("%s pid changed from %d to %d.", name.c_str(), *prev_pid, pid);
-    *prev_pid = pid;
-
-    return android::base::StringPrintf("/proc/%d/stat", pid);
+    return true;
 }
 
 /**
- * Find stime of the process and copy it into atom_values
- * atom_key: Currently, it can only be kKswapdTimeFieldNumber or kKcompactdTimeFieldNumber
- * name: process name, "kswapd0" or "kcompactd0"
- * prev_pid: The pid of the process. It would be the pid we found last time,
- *      or -1 if not found.
- * prev_stime: The stime of the process collected last time.
- * atom_values: The atom we will report later.
+ * Copy the stime spent since the last call by the threads of each entry of
+ * kKthreadStimeInfo into atom_values. /proc is only searched again when a
+ * thread is gone, which kernel threads rarely are. A thread found by such a
+ * search started since the last call, its whole stime counts.
  */
-void MmMetricsReporter::fillProcessStime(int atom_key, const std::string &name, int *prev_pid,
-                                         uint64_t *prev_stime,
-                                         std::vector<VendorAtomValue> *atom_values) {
-    std::string path;
-    int64_t stime;
-    int64_t stimeDiff;
-
-    // Find <pid> for executable <name>, and return "/proc/<pid>/stat" path.
-    // Give warning if prev_pid != current pid when prev_pid != -1, which means
-    // <name> at least once died and respawn.
-    path = getProcessStatPath(name, prev_pid);
-
-    if ((stime = getStimeByPathAndVerifyName(path, name)) < 0) {
-        return;
+void MmMetricsReporter::fillKthreadStime(std::vector<VendorAtomValue> *atom_values) {
+    std::map<int, int64_t> stime_diffs;
+    bool search = kthreads_.empty();
+
+    auto addStime = [&stime_diffs](Kthread *kthread, uint64_t stime) {
+        if (stime < kthread->prev_stime) {
+            ALOGE("stime diff for %s < 0: not possible", kthread->comm.c_str());
+        } else {
+            stime_diffs[kthread->atom_key] += stime - kthread->prev_stime;
+        }
+        kthread->prev_stime = stime;
+    };
+
+    for (auto it = kthreads_.begin(); it != kthreads_.end();) {
+        uint64_t stime;
+        if (!readKthreadStime(*it, &stime)) {
+            it = kthreads_.erase(it);
+            search = true;
+            continue;
+        }
+        addStime(&*it, stime);
+        ++it;
     }
 
-    stimeDiff = stime - *prev_stime;
-    if (stimeDiff < 0) {
-        ALOGE("stime diff for %s < 0: not possible", name.c_str());
-        return;
+    if (search) {
+        for (const auto &[pid, comm] : findKthreads()) {
+            auto known = std::find_if(kthreads_.begin(), kthreads_.end(),
+                                      [pid = pid](const Kthread &k) { return k.pid == pid; });
+            const KthreadStimeInfo *info = matchKthread(comm);
+            if (known != kthreads_.end() || !info)
+                continue;
+            Kthread kthread = {.pid = pid, .comm = comm, .atom_key = info->atom_key};
+            uint64_t stime;
+            if (!readKthreadStime(kthread, &stime))
+                continue;
+            addStime(&kthread, stime);
+            kthreads_.push_back(std::move(kthread));
+        }
+        if (kthreads_.empty())
+            ALOGE("Unable to find any of the MM kernel threads");
     }
-    *prev_stime = stime;
 
-    int atom_idx = atom_key - kVendorAtomOffset;
-    int size = atom_idx + 1;
-    VendorAtomValue tmp;
-    tmp.set<VendorAtomValue::longValue>(stimeDiff);
-    if (atom_values->size() < size)
-        atom_values->resize(size, tmp);
-    (*atom_values)[atom_idx] = tmp;
+    for (const auto &[atom_key, stime_diff] : stime_diffs) {
+        int atom_idx = atom_key - kVendorAtomOffset;
+        int size = atom_idx + 1;
+        VendorAtomValue tmp;
+        tmp.set<VendorAtomValue::longValue>(stime_diff);
+        if (atom_values->size() < size)
+            atom_values->resize(size, tmp);
+        (*atom_values)[atom_idx] = tmp;
+    }
 }
 
 /**
@@ -1080,10 +1235,10 @@ void MmMetricsReporter::readPressureStall(const std::string &basePath, std::vect
     // loop thru all pressure stall files: cpu, io, memory
     for (int type_idx = 0; type_idx < kPsiNumFiles;
          ++type_idx, file_save_idx += kPsiMetricsPerFile) {
-        std::string file_contents;
+        std::string_view file_contents;
         std::string path = getSysfsPath(basePath + '/' + kPsiTypes[type_idx]);
 
-        if (!ReadFileToString(path, &file_contents)) {
+        if (!sysfs_reader_.read(path, &file_contents)) {
             // Don't print this log if the file doesn't exist, since logs will be printed
             // repeatedly.
             if (errno != ENOENT)
@@ -1116,33 +1271,36 @@ err_out:
  *
  * Return value: true on success, false otherwise.
  */
-bool MmMetricsReporter::parsePressureStallFileContent(bool is_cpu, const std::string &lines,
+bool MmMetricsReporter::parsePressureStallFileContent(bool is_cpu, std::string_view lines,
                                                       std::vector<long> *store, int file_save_idx) {
-    constexpr int kNumOfWords = 5;  // expected number of words separated by spaces.
+    constexpr int kNumOfWords = kPsiNumNames + 1;  // expected number of words separated by spaces.
     constexpr int kCategoryFull = 0;
 
-    std::istringstream data(lines);
-    std::string line;
-
-    while (std::getline(data, line)) {
+    for (std::string_view line = NextSysfsToken(&lines, "\n"); !line.empty();
+         line = NextSysfsToken(&lines, "\n")) {
         int category_idx = 0;
 
-        line = android::base::Trim(line);
-        std::vector<std::string> words = android::base::Tokenize(line, " ");
-        if (words.size() != kNumOfWords) {
-            ALOGE("PSI parse fail: num of words = %d != expected %d",
-                  static_cast<int>(words.size()), kNumOfWords);
+        PsiLineWords words;
+        int num_words = 0;
+        for (std::string_view word = NextSysfsToken(&line, " \t"); !word.empty();
+             word = NextSysfsToken(&line, " \t"), ++num_words) {
+            if (num_words < kNumOfWords)
+                words[num_words] = word;
+        }
+        if (num_words != kNumOfWords) {
+            ALOGE("PSI parse fail: num of words = %d != expected %d", num_words, kNumOfWords);
             return false;
         }
 
         // words[0] should be either "full" or "some", the category name.
         for (auto &cat : kPsiCategories) {
-            if (words[0].compare(cat) == 0)
+            if (words[0] == cat)
                 break;
             ++category_idx;
         }
         if (category_idx == kPsiNumCategories) {
-            ALOGE("PSI parse fail: unknown category %s", words[0].c_str());
+            ALOGE("PSI parse fail: unknown category %.*s", static_cast<int>(words[0].size()),
+                  words[0].data());
             return false;
         }
 
@@ -1171,19 +1329,22 @@ bool MmMetricsReporter::parsePressureStallFileContent(bool is_cpu, const std::st
 // line_save_idx: the base start index to save in vector for this line (category)
 //
 // Return value: true on success, false otherwise.
-bool MmMetricsReporter::parsePressureStallWords(const std::vector<std::string> &words,
+bool MmMetricsReporter::parsePressureStallWords(const PsiLineWords &words,
                                                 std::vector<long> *store, int line_save_idx) {
     // Skip the first word, which is already parsed by the caller.
     // All others are value pairs in "name=value" form.
     // e.g. ["some", "avg10=0.00", "avg60=0.00", "avg300=0.00", "total=29705314"]
     // "some" is skipped.
     for (int i = 1; i < words.size(); ++i) {
-        std::vector<std::string> metric = android::base::Tokenize(words[i], "=");
-        if (metric.size() != 2) {
+        const size_t equal = words[i].find('=');
+        if (equal == 0 || equal == std::string_view::npos || equal + 1 == words[i].size() ||
+            words[i].find('=', equal + 1) != std::string_view::npos) {
             ALOGE("%s: parse error (name=value) @ idx %d", __FUNCTION__, i);
             return false;
         }
-        if (!MmMetricsReporter::savePressureMetrics(metric[0], metric[1], store, line_save_idx))
+        if (!MmMetricsReporter::savePressureMetrics(words[i].substr(0, equal),
+                                                    words[i].substr(equal + 1), store,
+                                                    line_save_idx))
             return false;
     }
     return true;
@@ -1203,13 +1364,13 @@ bool MmMetricsReporter::parsePressureStallWords(const std::vector<std::string> &
 //
 // Return value: true on success, false otherwise.
 //
-bool MmMetricsReporter::savePressureMetrics(const std::string &name, const std::string &value,
+bool MmMetricsReporter::savePressureMetrics(std::string_view name, std::string_view value,
                                             std::vector<long> *store, int base_save_idx) {
     int name_idx = 0;
     constexpr int kNameIdxTotal = 3;
 
     for (auto &mn : kPsiMetricNames) {
-        if (name.compare(mn) == 0)
+        if (name == mn)
             break;
         ++name_idx;
     }
@@ -1221,16 +1382,16 @@ bool MmMetricsReporter::savePressureMetrics(const std::string &name, const std::
     long out;
     if (name_idx == kNameIdxTotal) {
         // 'total' metrics
-        unsigned long tmp;
-        if (!android::base::ParseUint(value, &tmp))
+        uint64_t tmp;
+        if (!ParseSysfsUint(value, &tmp))
             out = -1;
         else
             out = tmp;
     } else {
-        // 'avg' metrics
-        double d = -1.0;
-        if (android::base::ParseDouble(value, &d))
-            out = static_cast<long>(d * 100 + 0.5);
+        // 'avg' metrics, in hundredths
+        int64_t centis;
+        if (ParseSysfsCentis(value, &centis))
+            out = centis;
         else
             out = -1;
     }
@@ -1433,6 +1594,42 @@ cleanup:
     psi_data_set_count_ = 0;
 }
 
+/**
+ * This function fills the PSI spike fields from the spikes the PSI monitor
+ * caught since the previous atom, or -1 when the monitor is not running.
+ *
+ * values: the atom value vector to be filled.
+ */
+void MmMetricsReporter::fillPsiSpikeAtom(std::vector<VendorAtomValue> *values) {
+    constexpr int kFieldsPerResource = 3;
+    // The atom orders the resources like kPsiTypes: cpu, io, memory
+    constexpr int start_idx =
+            PixelMmMetricsPerHour::kPsiCpuSomeSpikeCountFieldNumber - kVendorAtomOffset;
+
+    if (!MmMetricsSupported())
+        return;
+
+    unsigned int min_value_size = start_idx + PsiMonitor::kNumResources * kFieldsPerResource;
+    if (values->size() < min_value_size)
+        values->resize(min_value_size);
+
+    const bool running = psi_monitor_.isRunning();
+    std::array<PsiMonitor::Aggregate, PsiMonitor::kNumResources> aggregates;
+    if (running)
+        psi_monitor_.collect(&aggregates);
+
+    VendorAtomValue tmp;
+    int metric_idx = start_idx;
+    for (const auto &aggregate : aggregates) {
+        tmp.set<VendorAtomValue::longValue>(running ? aggregate.spike_count : -1);
+        (*values)[metric_idx++] = tmp;
+        tmp.set<VendorAtomValue::longValue>(running ? aggregate.spike_duration_ms : -1);
+        (*values)[metric_idx++] = tmp;
+        tmp.set<VendorAtomValue::longValue>(running ? aggregate.max_stall_us : -1);
+        (*values)[metric_idx++] = tmp;
+    }
+}
+
 /**
  * This function is to collect CMA metrics and upload them.
  * The CMA metrics are collected by readCmaStat(), copied into atom values
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pixelstats/PowerSupplyUevent.h>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+std::string_view PowerSupplyUevent::get(std::string_view property) const {
+    for (const auto &[name, value] : properties) {
+        if (name == property)
+            return value;
+    }
+    return {};
+}
+
+void PowerSupplySubscriptions::subscribe(const std::string &supply,
+                                         const std::vector<std::string> &properties,
+                                         Callback callback) {
+    Subscription subscription;
+    subscription.supply = supply;
+    subscription.properties = properties;
+    subscription.last_values.resize(properties.size());
+    subscription.callback = std::move(callback);
+    subscriptions_.push_back(std::move(subscription));
+}
+
+bool PowerSupplySubscriptions::takeChanges(const PowerSupplyUevent &uevent,
+                                           Subscription *subscription) {
+    bool changed = !subscription->delivered || subscription->properties.empty();
+    for (size_t i = 0; i < subscription->properties.size(); ++i) {
+        const std::string_view value = uevent.get(subscription->properties[i]);
+        if (value != subscription->last_values[i]) {
+            subscription->last_values[i] = value;
+            changed = true;
+        }
+    }
+    subscription->delivered = true;
+    return changed;
+}
+
+void PowerSupplySubscriptions::dispatch(const std::shared_ptr<IStats> &stats_client,
+                                        const PowerSupplyUevent &uevent) {
+    const std::string_view name = uevent.name();
+    for (Subscription &subscription : subscriptions_) {
+        if (!subscription.supply.empty() && subscription.supply != name)
+            continue;
+        if (takeChanges(uevent, &subscription))
+            subscription.callback(stats_client, uevent);
+    }
+}
+
+std::string PowerSupplyOfPath(std::string_view path) {
+    constexpr std::string_view kPowerSupplyClass = "/sys/class/power_supply/";
+    if (path.substr(0, kPowerSupplyClass.size()) != kPowerSupplyClass)
+        return "";
+    path.remove_prefix(kPowerSupplyClass.size());
+    const size_t slash = path.find('/');
+    if (slash == 0 || slash == std::string_view::npos)
+        return "";
+    return std::string(path.substr(0, slash));
+}
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "pixelstats-vendor"
+
+#include <android-base/chrono_utils.h>
+#include <fcntl.h>
+#include <pixelstats/PsiMonitor.h>
+#include <pixelstats/SysfsReader.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <utils/Log.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <string_view>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+namespace {
+
+constexpr const char *kResourceNames[PsiMonitor::kNumResources] = {"cpu", "io", "memory"};
+// Marks the stop eventfd in the epoll data, the triggers use their Resource
+constexpr uint32_t kStopEvent = PsiMonitor::kNumResources;
+
+int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   android::base::boot_clock::now().time_since_epoch())
+            .count();
+}
+
+}  // namespace
+
+PsiMonitor::~PsiMonitor() {
+    if (!thread_.joinable())
+        return;
+    uint64_t one = 1;
+    if (write(stop_fd_.get(), &one, sizeof(one)) != sizeof(one))
+        ALOGE("Unable to stop the PSI monitor - %s", strerror(errno));
+    thread_.join();
+}
+
+bool PsiMonitor::start(const std::string &base_path) {
+    if (thread_.joinable())
+        return true;
+
+    epoll_fd_.reset(epoll_create1(EPOLL_CLOEXEC));
+    stop_fd_.reset(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+    if (!epoll_fd_.ok() || !stop_fd_.ok()) {
+        ALOGE("Unable to create the PSI monitor fds - %s", strerror(errno));
+        return false;
+    }
+
+    int armed = 0;
+    for (int i = 0; i < kNumResources; ++i) {
+        if (armTrigger(static_cast<Resource>(i), base_path + '/' + kResourceNames[i]))
+            ++armed;
+    }
+
+    struct epoll_event event = {.events = EPOLLIN, .data = {.u32 = kStopEvent}};
+    if (!armed || epoll_ctl(epoll_fd_.get(), EPOLL_CTL_ADD, stop_fd_.get(), &event)) {
+        for (auto &fd : trigger_fds_) fd.reset();
+        epoll_fd_.reset();
+        stop_fd_.reset();
+        return false;
+    }
+
+    ALOGI("PSI monitor armed %d triggers: some %" PRId64 " %" PRId64, armed, threshold_us_,
+          window_us_);
+    thread_ = std::thread(&PsiMonitor::monitorLoop, this);
+    return true;
+}
+
+bool PsiMonitor::armTrigger(Resource resource, const std::string &path) {
+    android::base::unique_fd fd(
+            TEMP_FAILURE_RETRY(open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC)));
+    if (!fd.ok()) {
+        ALOGW("Unable to open %s for a PSI trigger - %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    // The trigger is a NUL terminated string, as libpsi writes it
+    auto writeTrigger = [this, &fd] {
+        const std::string trigger =
+                "some " + std::to_string(threshold_us_) + " " + std::to_string(window_us_);
+        return write(fd.get(), trigger.c_str(), trigger.size() + 1) >= 0;
+    };
+    bool written = writeTrigger();
+    if (!written && errno == EINVAL && window_us_ == kWindowUs) {
+        threshold_us_ = kThresholdUs * kFallbackWindowUs / kWindowUs;
+        window_us_ = kFallbackWindowUs;
+        written = writeTrigger();
+    }
+    if (!written) {
+        ALOGW("Unable to arm PSI trigger on %s - %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    struct epoll_event event = {.events = EPOLLPRI, .data = {.u32 = resource}};
+    if (epoll_ctl(epoll_fd_.get(), EPOLL_CTL_ADD, fd.get(), &event)) {
+        ALOGW("Unable to poll PSI trigger on %s - %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    trigger_fds_[resource] = std::move(fd);
+    return true;
+}
+
+void PsiMonitor::collect(std::array<Aggregate, kNumResources> *aggregates) {
+    aggregates->fill(Aggregate());
+
+    std::scoped_lock lock(lock_);
+    for (size_t i = 0; i < ring_count_; ++i) {
+        const Spike &spike = ring_[i];
+        Aggregate &aggregate = (*aggregates)[spike.resource];
+        ++aggregate.spike_count;
+        aggregate.spike_duration_ms += spike.duration_ms;
+        aggregate.max_stall_us = std::max(aggregate.max_stall_us, spike.max_stall_us);
+    }
+    for (int i = 0; i < kNumResources; ++i) {
+        (*aggregates)[i].spike_count += overflow_count_[i];
+        overflow_count_[i] = 0;
+    }
+    ring_count_ = 0;
+}
+
+void PsiMonitor::monitorLoop() {
+    struct epoll_event events[kNumResources + 1];
+    // A spike ends when no window was signalled for this long after its last one.
+    // The kernel signals a trigger at most once per window.
+    const int64_t spike_end_ms = 2 * window_us_ / 1000;
+
+    while (true) {
+        // Sleep until a trigger fires, or until the next open spike is over
+        int timeout_ms = -1;
+        const int64_t now_ms = nowMs();
+        for (const auto &spike : open_spikes_) {
+            if (!spike.active)
+                continue;
+            int64_t left_ms = std::max<int64_t>(spike.last_event_ms + spike_end_ms - now_ms, 0);
+            if (timeout_ms < 0 || left_ms < timeout_ms)
+                timeout_ms = static_cast<int>(left_ms);
+        }
+
+        int num_events = epoll_wait(epoll_fd_.get(), events, kNumResources + 1, timeout_ms);
+        if (num_events < 0) {
+            if (errno == EINTR)
+                continue;
+            ALOGE("PSI monitor epoll failed - %s", strerror(errno));
+            return;
+        }
+
+        const int64_t event_ms = nowMs();
+        for (int i = 0; i < num_events; ++i) {
+            if (events[i].data.u32 == kStopEvent)
+                return;
+            if (events[i].events & EPOLLERR) {
+                // The monitored cgroup went away, which does not happen for /proc/pressure
+                ALOGE("PSI trigger on %s failed", kResourceNames[events[i].data.u32]);
+                epoll_ctl(epoll_fd_.get(), EPOLL_CTL_DEL,
+                          trigger_fds_[events[i].data.u32].get(), nullptr);
+                continue;
+            }
+            onTrigger(static_cast<Resource>(events[i].data.u32), event_ms);
+        }
+
+        for (int i = 0; i < kNumResources; ++i) {
+            const OpenSpike &spike = open_spikes_[i];
+            if (spike.active && event_ms - spike.last_event_ms >= spike_end_ms)
+                closeSpike(static_cast<Resource>(i));
+        }
+    }
+}
+
+void PsiMonitor::onTrigger(Resource resource, int64_t now_ms) {
+    OpenSpike &spike = open_spikes_[resource];
+    uint64_t total_us = 0;
+    const bool has_total = readSomeTotal(resource, &total_us);
+
+    if (!spike.active) {
+        // The stall inside the first window is only known to be over the threshold
+        spike = {.active = true,
+                 .start_ms = now_ms,
+                 .last_event_ms = now_ms,
+                 .last_total_us = total_us,
+                 .max_stall_us = threshold_us_ * kWindowUs / window_us_};
+        return;
+    }
+
+    // Scale the stall since the previous event down to one window of kWindowUs, so the
+    // maximum reads the same with the fallback window
+    if (has_total && spike.last_total_us && total_us > spike.last_total_us) {
+        const int64_t elapsed_us = std::max<int64_t>((now_ms - spike.last_event_ms) * 1000,
+                                                     window_us_);
+        const int64_t stall_us = static_cast<int64_t>(total_us - spike.last_total_us);
+        spike.max_stall_us = std::max(spike.max_stall_us,
+                                      std::min(stall_us * kWindowUs / elapsed_us, kWindowUs));
+    }
+    spike.last_event_ms = now_ms;
+    spike.last_total_us = total_us;
+}
+
+void PsiMonitor::closeSpike(Resource resource) {
+    OpenSpike &spike = open_spikes_[resource];
+    spike.active = false;
+
+    // The last signalled window ends about one window after its event
+    const Spike finished = {
+            .resource = resource,
+            .duration_ms = spike.last_event_ms - spike.start_ms + window_us_ / 1000,
+            .max_stall_us = spike.max_stall_us,
+    };
+    std::scoped_lock lock(lock_);
+    if (ring_count_ < kRingSize)
+        ring_[ring_count_++] = finished;
+    else
+        ++overflow_count_[resource];
+}
+
+/*
+ * The trigger fd reads like the plain node:
+ *   some avg10=0.00 avg60=0.00 avg300=0.00 total=123456
+ *   full avg10=0.00 avg60=0.00 avg300=0.00 total=12345
+ */
+bool PsiMonitor::readSomeTotal(Resource resource, uint64_t *total_us) {
+    char buffer[256];
+    ssize_t len = TEMP_FAILURE_RETRY(
+            pread(trigger_fds_[resource].get(), buffer, sizeof(buffer) - 1, 0));
+    if (len <= 0)
+        return false;
+
+    std::string_view content(buffer, len);
+    std::string_view line = NextSysfsToken(&content, "\n");
+    constexpr std::string_view kTotal = "total=";
+    size_t pos = line.find(kTotal);
+    if (line.substr(0, 4) != "some" || pos == std::string_view::npos)
+        return false;
+    return ParseSysfsUint(line.substr(pos + kTotal.size()), total_us);
+}
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
@@ -16,6 +16,7 @@
 
 #include <pixelstats/StatsHelper.h>
 #include <pixelstats/SysfsCollector.h>
+#include <pixelstats/VendorAtomQueue.h>
 
 #define LOG_TAG "pixelstats-vendor"
 
@@ -23,15 +24,27 @@
 #include <android-base/parseint.h>
 #include <android-base/properties.h>
 #include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 #include <android/binder_manager.h>
+#include <pixelboottiming/BootPhaseAtom.h>
 #include <utils/Log.h>
 #include <utils/Timers.h>
 
 #include <mntent.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/inotify.h>
 #include <sys/timerfd.h>
 #include <sys/vfs.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cinttypes>
+#include <map>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 
 #ifndef ARRAY_SIZE
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
@@ -82,6 +95,67 @@ using android::hardware::google::pixel::PixelAtoms::VendorTempResidencyStats;
 using android::hardware::google::pixel::PixelAtoms::ZramBdStat;
 using android::hardware::google::pixel::PixelAtoms::ZramMmStat;
 
+namespace {
+
+// gcd (greatest common divisor) of all the collector periods
+constexpr int kSecondsPerWake = 5 * 60;
+
+constexpr int kWakesPer5Min = 5 * 60 / kSecondsPerWake;
+constexpr int kWakesPerHour = 60 * 60 / kSecondsPerWake;
+constexpr int kWakesPerDay = 24 * 60 * 60 / kSecondsPerWake;
+
+// Threads running the collectors due at one wake
+constexpr size_t kCollectorWorkers = 2;
+
+// The boot collection starts once boot completes, or this long after pixelstats starts
+constexpr std::chrono::minutes kBootCompletedTimeout(5);
+// How long the boot collection waits for the ready paths of the collectors, after
+// which the remaining collectors run anyway
+constexpr std::chrono::seconds kReadyPathTimeout(60);
+// Pause between the collector groups of the boot collection
+constexpr std::chrono::milliseconds kBootCollectionStagger(500);
+
+bool IsReady(const char *path) {
+    return path == nullptr || path[0] == '\0' || access(path, F_OK) == 0;
+}
+
+/**
+ * Wait until one of paths exists or timeout passes. inotify on the parent
+ * directories wakes up on nodes created by a driver probe, but kernfs doesn't
+ * report every creation, so the paths are also checked every second.
+ */
+void WaitForAnyPath(const std::vector<const char *> &paths, std::chrono::milliseconds timeout) {
+    const android::base::unique_fd inotify_fd(inotify_init1(IN_CLOEXEC | IN_NONBLOCK));
+    if (inotify_fd >= 0) {
+        for (const char *path : paths)
+            inotify_add_watch(inotify_fd, android::base::Dirname(path).c_str(),
+                              IN_CREATE | IN_MOVED_TO);
+    }
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        if (std::any_of(paths.begin(), paths.end(), IsReady))
+            return;
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+            return;
+        const auto wait = std::min<std::chrono::milliseconds>(
+                std::chrono::seconds(1),
+                std::chrono::ceil<std::chrono::milliseconds>(deadline - now));
+        if (inotify_fd < 0) {
+            std::this_thread::sleep_for(wait);
+            continue;
+        }
+        struct pollfd pfd = {.fd = inotify_fd.get(), .events = POLLIN};
+        if (poll(&pfd, 1, wait.count()) > 0) {
+            char events[4096];
+            while (read(inotify_fd, events, sizeof(events)) > 0) {
+            }
+        }
+    }
+}
+
+}  // namespace
+
 SysfsCollector::SysfsCollector(const struct SysfsPaths &sysfs_paths)
     : kSlowioReadCntPath(sysfs_paths.SlowioReadCntPath),
       kSlowioWriteCntPath(sysfs_paths.SlowioWriteCntPath),
@@ -138,7 +212,31 @@ SysfsCollector::SysfsCollector(const struct SysfsPaths &sysfs_paths)
       kMaxfgHistoryPath("/dev/maxfg_history"),
       kFGModelLoadingPath(sysfs_paths.FGModelLoadingPath),
       kFGLogBufferPath(sysfs_paths.FGLogBufferPath),
-      kSpeakerVersionPath(sysfs_paths.SpeakerVersionPath) {}
+      kSpeakerVersionPath(sysfs_paths.SpeakerVersionPath),
+      kAtomSnapshotPath(sysfs_paths.AtomSnapshotPath),
+      kBatteryHistoryCursorPath(sysfs_paths.BatteryHistoryCursorPath),
+      kCostDumpPath(sysfs_paths.CostDumpPath),
+      kShutdownSamplesPath(sysfs_paths.ShutdownSamplesPath) {
+    registerCollectors();
+    AddCostDump(this, [this](int fd) { dump(fd); });
+
+    if (kBatteryHistoryCursorPath != nullptr && strlen(kBatteryHistoryCursorPath) > 0)
+        battery_EEPROM_reporter_.setHistoryCursorPath(kBatteryHistoryCursorPath);
+
+    if (kAtomSnapshotPath != nullptr && strlen(kAtomSnapshotPath) > 0) {
+        std::map<std::string, UnchangedAtomFilter::Snapshot> saved_snapshots;
+        LoadAtomSnapshots(kAtomSnapshotPath, &saved_snapshots);
+        for (auto &[name, snapshot] : atom_snapshots_) {
+            const auto saved = saved_snapshots.find(name);
+            if (saved != saved_snapshots.end())
+                snapshot = std::move(saved->second);
+        }
+    }
+}
+
+SysfsCollector::~SysfsCollector() {
+    RemoveCostDump(this);
+}
 
 bool SysfsCollector::ReadFileToInt(const std::string &path, int *val) {
     return ReadFileToInt(path.c_str(), val);
@@ -202,7 +300,7 @@ void SysfsCollector::logBatteryChargeCycles(const std::shared_ptr<IStats> &stats
 }
 
 /**
- * Read the contents of kEEPROMPath and report them.
+ * Read the contents of kEEPROMPath and report the entries not reported yet.
  */
 void SysfsCollector::logBatteryEEPROM(const std::shared_ptr<IStats> &stats_client) {
     if (kEEPROMPath == nullptr || strlen(kEEPROMPath) == 0) {
@@ -221,12 +319,7 @@ void SysfsCollector::logBatteryEEPROM(const std::shared_ptr<IStats> &stats_clien
  * Log battery history validation
  */
 void SysfsCollector::logBatteryHistoryValidation() {
-    const std::shared_ptr<IStats> stats_client = getStatsService();
-    if (!stats_client) {
-        ALOGE("Unable to get AIDL Stats service");
-        return;
-    }
-
+    const std::shared_ptr<IStats> stats_client = getVendorAtomQueue();
     battery_EEPROM_reporter_.checkAndReportValidation(stats_client, kFGLogBufferPath);
 }
 
@@ -237,13 +330,6 @@ void SysfsCollector::logBatteryHealth(const std::shared_ptr<IStats> &stats_clien
     battery_health_reporter_.checkAndReportStatus(stats_client);
 }
 
-/**
- * Log battery time-to-full stats
- */
-void SysfsCollector::logBatteryTTF(const std::shared_ptr<IStats> &stats_client) {
-    battery_time_to_full_reporter_.checkAndReportStats(stats_client);
-}
-
 /**
  * Check the codec for failures over the past 24hr.
  */
@@ -2099,72 +2185,20 @@ void SysfsCollector::logMitigationDurationCounts(const std::shared_ptr<IStats> &
     mitigation_duration_reporter_.logMitigationDuration(stats_client, kPowerMitigationDurationPath);
 }
 
-void SysfsCollector::logPerDay() {
-    const std::shared_ptr<IStats> stats_client = getStatsService();
-    if (!stats_client) {
-        ALOGE("Unable to get AIDL Stats service");
-        return;
-    }
-    // Collect once per service init; can be multiple due to service reinit
-    if (!log_once_reported) {
-        logBootStats(stats_client);
-    }
-    logBatteryCapacity(stats_client);
-    logBatteryChargeCycles(stats_client);
-    logBatteryEEPROM(stats_client);
-    logBatteryHealth(stats_client);
-    logBatteryTTF(stats_client);
-    logBlockStatsReported(stats_client);
-    logCodec1Failed(stats_client);
-    logCodecFailed(stats_client);
-    logDisplayStats(stats_client);
-    logDisplayPortStats(stats_client);
-    logHDCPStats(stats_client);
-    logF2fsStats(stats_client);
-    logF2fsAtomicWriteInfo(stats_client);
-    logF2fsCompressionInfo(stats_client);
-    logF2fsGcSegmentInfo(stats_client);
-    logF2fsSmartIdleMaintEnabled(stats_client);
-    logSlowIO(stats_client);
-    logSpeakerImpedance(stats_client);
-    logSpeechDspStat(stats_client);
-    logUFSLifetime(stats_client);
-    logUFSErrorStats(stats_client);
-    logSpeakerHealthStats(stats_client);
-    mm_metrics_reporter_.logCmaStatus(stats_client);
-    mm_metrics_reporter_.logPixelMmMetricsPerDay(stats_client);
-    logVendorAudioHardwareStats(stats_client);
-    logThermalStats(stats_client);
-    logTempResidencyStats(stats_client);
-    logVendorLongIRQStatsReported(stats_client);
-    logVendorResumeLatencyStats(stats_client);
-    logPartitionUsedSpace(stats_client);
-    logPcieLinkStats(stats_client);
-    logMitigationDurationCounts(stats_client);
-    logVendorAudioPdmStatsReported(stats_client);
-    logWavesStats(stats_client);
-    logAdaptedInfoStats(stats_client);
-    logPcmUsageStats(stats_client);
-    logOffloadEffectsStats(stats_client);
-    logBluetoothAudioUsage(stats_client);
-}
-
 void SysfsCollector::aggregatePer5Min() {
     mm_metrics_reporter_.aggregatePixelMmMetricsPer5Min();
 }
 
 void SysfsCollector::logBrownout() {
-    const std::shared_ptr<IStats> stats_client = getStatsService();
-    if (!stats_client) {
-        ALOGE("Unable to get AIDL Stats service");
-        return;
-    }
+    const std::shared_ptr<IStats> stats_client = getVendorAtomQueue();
     if (kBrownoutCsvPath != nullptr && strlen(kBrownoutCsvPath) > 0)
         brownout_detected_reporter_.logBrownoutCsv(stats_client, kBrownoutCsvPath,
                                                    kBrownoutReasonProp);
     else if (kBrownoutLogPath != nullptr && strlen(kBrownoutLogPath) > 0)
         brownout_detected_reporter_.logBrownout(stats_client, kBrownoutLogPath,
                                                 kBrownoutReasonProp);
+    if (kShutdownSamplesPath != nullptr && strlen(kShutdownSamplesPath) > 0)
+        brownout_detected_reporter_.logShutdownSamples(kShutdownSamplesPath);
 }
 
 void SysfsCollector::logOnce() {
@@ -2172,53 +2206,361 @@ void SysfsCollector::logOnce() {
     logBatteryHistoryValidation();
 }
 
-void SysfsCollector::logPerHour() {
-    const std::shared_ptr<IStats> stats_client = getStatsService();
-    if (!stats_client) {
-        ALOGE("Unable to get AIDL Stats service");
-        return;
+void SysfsCollector::addCollector(const char *name, int period_wakes, int estimated_cost_ms,
+                                  const char *tag, CollectFunc func, bool report_changed_only,
+                                  const char *ready_path) {
+    collectors_.push_back({
+            .name = name,
+            .period_wakes = period_wakes,
+            .slot = 0,
+            .next_wake = 0,
+            .estimated_cost_ms = estimated_cost_ms,
+            .tag = tag,
+            .func = std::move(func),
+            .snapshot = report_changed_only ? &atom_snapshots_[name] : nullptr,
+            .ready_path = ready_path,
+            .last_duration_ms = 0,
+            .cost = {},
+            .suppressed_count = 0,
+    });
+}
+
+void SysfsCollector::registerCollectors() {
+    const auto member = [this](void (SysfsCollector::*log)(const std::shared_ptr<IStats> &)) {
+        return [this, log](const std::shared_ptr<IStats> &stats_client) {
+            (this->*log)(stats_client);
+        };
+    };
+
+    // The mm reporter keeps state between its calls, so do aggregatePer5Min and the
+    // mm collectors never run at the same time.
+    addCollector("logPixelMmMetricsPerHour", kWakesPerHour, 5, "mm",
+                 [this](const std::shared_ptr<IStats> &stats_client) {
+                     mm_metrics_reporter_.logPixelMmMetricsPerHour(stats_client);
+                 });
+    addCollector("logZramStats", kWakesPerHour, 2, "", member(&SysfsCollector::logZramStats),
+                 true);
+    if (kCostDumpPath != nullptr && strlen(kCostDumpPath) > 0) {
+        addCollector("writeCostDump", kWakesPerHour, 1, "",
+                     [this](const std::shared_ptr<IStats> &) { WriteCostDumps(kCostDumpPath); });
     }
-    mm_metrics_reporter_.logPixelMmMetricsPerHour(stats_client);
-    logZramStats(stats_client);
     if (kPowerMitigationStatsPath != nullptr && strlen(kPowerMitigationStatsPath) > 0)
-        mitigation_stats_reporter_.logMitigationStatsPerHour(stats_client,
-                                                             kPowerMitigationStatsPath);
+        addCollector("logMitigationStatsPerHour", kWakesPerHour, 2, "",
+                     [this](const std::shared_ptr<IStats> &stats_client) {
+                         mitigation_stats_reporter_.logMitigationStatsPerHour(
+                                 stats_client, kPowerMitigationStatsPath);
+                     });
+
+    // Collect once per service init; can be multiple due to service reinit
+    addCollector("logBootStats", kWakesPerDay, 1, "",
+                 [this](const std::shared_ptr<IStats> &stats_client) {
+                     if (!log_once_reported)
+                         logBootStats(stats_client);
+                 });
+    // The battery collectors read the fuel gauge over I2C
+    addCollector("logBatteryCapacity", kWakesPerDay, 10, "battery",
+                 member(&SysfsCollector::logBatteryCapacity));
+    addCollector("logBatteryChargeCycles", kWakesPerDay, 5, "battery",
+                 member(&SysfsCollector::logBatteryChargeCycles));
+    addCollector("logBatteryEEPROM", kWakesPerDay, 40, "battery",
+                 member(&SysfsCollector::logBatteryEEPROM));
+    addCollector("logBatteryHealth", kWakesPerDay, 10, "battery",
+                 member(&SysfsCollector::logBatteryHealth));
+    addCollector("logBlockStatsReported", kWakesPerDay, 2, "ufs",
+                 member(&SysfsCollector::logBlockStatsReported), true);
+    addCollector("logCodec1Failed", kWakesPerDay, 1, "audio",
+                 member(&SysfsCollector::logCodec1Failed), false, kCodec1Path);
+    addCollector("logCodecFailed", kWakesPerDay, 1, "audio",
+                 member(&SysfsCollector::logCodecFailed), false, kCodecPath);
+    addCollector("logDisplayStats", kWakesPerDay, 2, "display",
+                 member(&SysfsCollector::logDisplayStats));
+    addCollector("logDisplayPortStats", kWakesPerDay, 2, "display",
+                 member(&SysfsCollector::logDisplayPortStats));
+    addCollector("logHDCPStats", kWakesPerDay, 2, "display",
+                 member(&SysfsCollector::logHDCPStats));
+    addCollector("logF2fsStats", kWakesPerDay, 5, "f2fs", member(&SysfsCollector::logF2fsStats),
+                 true);
+    addCollector("logF2fsAtomicWriteInfo", kWakesPerDay, 2, "f2fs",
+                 member(&SysfsCollector::logF2fsAtomicWriteInfo));
+    addCollector("logF2fsCompressionInfo", kWakesPerDay, 2, "f2fs",
+                 member(&SysfsCollector::logF2fsCompressionInfo));
+    addCollector("logF2fsGcSegmentInfo", kWakesPerDay, 5, "f2fs",
+                 member(&SysfsCollector::logF2fsGcSegmentInfo));
+    addCollector("logF2fsSmartIdleMaintEnabled", kWakesPerDay, 1, "f2fs",
+                 member(&SysfsCollector::logF2fsSmartIdleMaintEnabled));
+    addCollector("logSlowIO", kWakesPerDay, 1, "", member(&SysfsCollector::logSlowIO));
+    addCollector("logSpeakerImpedance", kWakesPerDay, 2, "audio",
+                 member(&SysfsCollector::logSpeakerImpedance), false, kImpedancePath);
+    addCollector("logSpeechDspStat", kWakesPerDay, 1, "audio",
+                 member(&SysfsCollector::logSpeechDspStat), false, kSpeechDspPath);
+    addCollector("logUFSLifetime", kWakesPerDay, 20, "ufs",
+                 member(&SysfsCollector::logUFSLifetime));
+    addCollector("logUFSErrorStats", kWakesPerDay, 10, "ufs",
+                 member(&SysfsCollector::logUFSErrorStats), true);
+    addCollector("logSpeakerHealthStats", kWakesPerDay, 2, "audio",
+                 member(&SysfsCollector::logSpeakerHealthStats), false, kSpeakerTemperaturePath);
+    addCollector("logCmaStatus", kWakesPerDay, 2, "mm",
+                 [this](const std::shared_ptr<IStats> &stats_client) {
+                     mm_metrics_reporter_.logCmaStatus(stats_client);
+                 });
+    addCollector("logPixelMmMetricsPerDay", kWakesPerDay, 5, "mm",
+                 [this](const std::shared_ptr<IStats> &stats_client) {
+                     mm_metrics_reporter_.logPixelMmMetricsPerDay(stats_client);
+                 });
+    addCollector("logVendorAudioHardwareStats", kWakesPerDay, 2, "audio",
+                 member(&SysfsCollector::logVendorAudioHardwareStats), true);
+    addCollector("logThermalStats", kWakesPerDay, 2, "", member(&SysfsCollector::logThermalStats));
+    addCollector("logTempResidencyStats", kWakesPerDay, 5, "",
+                 member(&SysfsCollector::logTempResidencyStats));
+    addCollector("logVendorLongIRQStatsReported", kWakesPerDay, 2, "",
+                 member(&SysfsCollector::logVendorLongIRQStatsReported));
+    addCollector("logVendorResumeLatencyStats", kWakesPerDay, 2, "",
+                 member(&SysfsCollector::logVendorResumeLatencyStats));
+    addCollector("logPartitionUsedSpace", kWakesPerDay, 1, "",
+                 member(&SysfsCollector::logPartitionUsedSpace));
+    addCollector("logPcieLinkStats", kWakesPerDay, 5, "",
+                 member(&SysfsCollector::logPcieLinkStats));
+    addCollector("logMitigationDurationCounts", kWakesPerDay, 2, "",
+                 member(&SysfsCollector::logMitigationDurationCounts));
+    addCollector("logVendorAudioPdmStatsReported", kWakesPerDay, 2, "audio",
+                 member(&SysfsCollector::logVendorAudioPdmStatsReported));
+    addCollector("logWavesStats", kWakesPerDay, 2, "audio", member(&SysfsCollector::logWavesStats));
+    addCollector("logAdaptedInfoStats", kWakesPerDay, 2, "audio",
+                 member(&SysfsCollector::logAdaptedInfoStats));
+    addCollector("logPcmUsageStats", kWakesPerDay, 2, "audio",
+                 member(&SysfsCollector::logPcmUsageStats));
+    addCollector("logOffloadEffectsStats", kWakesPerDay, 2, "audio",
+                 member(&SysfsCollector::logOffloadEffectsStats));
+    addCollector("logBluetoothAudioUsage", kWakesPerDay, 2, "audio",
+                 member(&SysfsCollector::logBluetoothAudioUsage));
+
+    assignCollectorSlots();
 }
 
 /**
- * Loop forever collecting stats from sysfs nodes and reporting them via
- * IStats.
+ * Spread the collectors of each period over its wakes by estimated cost, so
+ * the daily collection is not one long burst. Collectors sharing a tag take
+ * the same slot.
  */
-void SysfsCollector::collect(void) {
-    int timerfd = timerfd_create(CLOCK_BOOTTIME, 0);
-    if (timerfd < 0) {
-        ALOGE("Unable to create timerfd - %s", strerror(errno));
+void SysfsCollector::assignCollectorSlots() {
+    std::map<int, std::vector<std::vector<Collector *>>> groups_by_period;
+    std::map<std::pair<int, std::string_view>, size_t> group_of_tag;
+    for (auto &collector : collectors_) {
+        auto &groups = groups_by_period[collector.period_wakes];
+        if (collector.tag[0] == '\0') {
+            groups.push_back({&collector});
+            continue;
+        }
+        const auto [itr, inserted] =
+                group_of_tag.emplace(std::make_pair(collector.period_wakes, collector.tag),
+                                     groups.size());
+        if (inserted)
+            groups.emplace_back();
+        groups[itr->second].push_back(&collector);
+    }
+
+    for (const auto &[period_wakes, groups] : groups_by_period) {
+        int64_t total_cost_ms = 0;
+        for (const auto &group : groups)
+            for (const Collector *collector : group)
+                total_cost_ms += collector->estimated_cost_ms;
+
+        int64_t cost_before_ms = 0;
+        for (const auto &group : groups) {
+            const int slot = total_cost_ms ? cost_before_ms * period_wakes / total_cost_ms : 0;
+            for (Collector *collector : group) {
+                cost_before_ms += collector->estimated_cost_ms;
+                collector->slot = slot;
+                // Everything runs on boot, so the first run after it comes
+                // between half a period and one and a half periods later.
+                collector->next_wake = slot < period_wakes / 2 ? slot + period_wakes : slot;
+            }
+        }
+    }
+}
+
+void SysfsCollector::runCollectors(const std::vector<Collector *> &collectors) {
+    if (collectors.empty())
         return;
+    // Collectors report into the queue and never wait on binder
+    const std::shared_ptr<IStats> stats_client = getVendorAtomQueue();
+
+    // Each chain runs on one worker, in registration order
+    std::vector<std::vector<Collector *>> chains;
+    std::unordered_map<std::string_view, size_t> chain_of_tag;
+    for (Collector *collector : collectors) {
+        if (collector->tag[0] == '\0') {
+            chains.push_back({collector});
+            continue;
+        }
+        const auto [itr, inserted] = chain_of_tag.emplace(collector->tag, chains.size());
+        if (inserted)
+            chains.emplace_back();
+        chains[itr->second].push_back(collector);
+    }
+
+    std::atomic<size_t> next_chain = 0;
+    std::atomic<int64_t> suppressed_count = 0;
+    std::atomic<bool> snapshots_changed = false;
+    const auto run_chains = [&]() {
+        // Counts what each collector run reads, on this worker thread
+        const android::base::unique_fd io_fd = OpenThreadIo();
+        for (size_t i = next_chain++; i < chains.size(); i = next_chain++) {
+            for (Collector *collector : chains[i]) {
+                // A collector runs on one worker at a time, so its snapshot needs no lock
+                std::shared_ptr<UnchangedAtomFilter> filter;
+                if (collector->snapshot)
+                    filter = ndk::SharedRefBase::make<UnchangedAtomFilter>(stats_client,
+                                                                           collector->snapshot);
+
+                CostMeter meter(io_fd.get());
+                collector->func(filter ? filter : stats_client);
+                const Cost cost = meter.stop();
+
+                if (filter) {
+                    suppressed_count += filter->suppressedCount();
+                    if (filter->snapshotChanged())
+                        snapshots_changed = true;
+                }
+
+                std::lock_guard<std::mutex> lock(collector_stats_lock_);
+                if (filter)
+                    collector->suppressed_count += filter->suppressedCount();
+                collector->last_duration_ms = cost.wall_us / 1000;
+                collector->cost.add(cost);
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < std::min(kCollectorWorkers, chains.size()); ++i)
+        workers.emplace_back(run_chains);
+    run_chains();
+    for (auto &worker : workers)
+        worker.join();
+
+    if (suppressed_count)
+        ALOGI("Suppressed %" PRId64 " unchanged atoms", suppressed_count.load());
+    if (snapshots_changed && kAtomSnapshotPath != nullptr && strlen(kAtomSnapshotPath) > 0)
+        SaveAtomSnapshots(kAtomSnapshotPath, atom_snapshots_);
+}
+
+void SysfsCollector::runCollectorsStaggered(const std::vector<Collector *> &collectors) {
+    std::vector<std::vector<Collector *>> groups;
+    std::unordered_map<std::string_view, size_t> group_of_tag;
+    for (Collector *collector : collectors) {
+        if (collector->tag[0] == '\0') {
+            groups.push_back({collector});
+            continue;
+        }
+        const auto [itr, inserted] = group_of_tag.emplace(collector->tag, groups.size());
+        if (inserted)
+            groups.emplace_back();
+        groups[itr->second].push_back(collector);
+    }
+    for (size_t i = 0; i < groups.size(); ++i) {
+        if (i > 0)
+            std::this_thread::sleep_for(kBootCollectionStagger);
+        runCollectors(groups[i]);
     }
+}
 
-    // Sleep for 30 seconds on launch to allow codec driver to load.
-    sleep(30);
+/**
+ * Collect everything once after boot. Each collector runs once its ready
+ * path exists, and the collectors run group by group with a pause in between
+ * so the collection is spread out rather than one burst. Collectors whose
+ * path doesn't show up within kReadyPathTimeout run anyway and report what
+ * they find.
+ */
+void SysfsCollector::collectOnBoot(BootPhaseTimer *boot_timer) {
+    // Spikes between the 5 minute samples, from kernel PSI triggers
+    boot_timer->begin("psi_monitor");
+    if (android::base::GetBoolProperty("persist.vendor.pixelstats.psi_triggers", false))
+        mm_metrics_reporter_.startPsiMonitor();
 
     // sample & aggregate for the first time.
+    boot_timer->begin("first_aggregate");
     aggregatePer5Min();
 
     // Collect first set of stats on boot.
+    boot_timer->begin("first_collection");
     logOnce();
-    logPerHour();
-    logPerDay();
+    std::vector<Collector *> pending;
+    for (auto &collector : collectors_)
+        pending.push_back(&collector);
+    const auto deadline = std::chrono::steady_clock::now() + kReadyPathTimeout;
+    while (!pending.empty()) {
+        const bool timed_out = std::chrono::steady_clock::now() >= deadline;
+        std::vector<Collector *> ready;
+        std::vector<const char *> waiting_paths;
+        for (auto itr = pending.begin(); itr != pending.end();) {
+            if (timed_out || IsReady((*itr)->ready_path)) {
+                ready.push_back(*itr);
+                itr = pending.erase(itr);
+            } else {
+                waiting_paths.push_back((*itr)->ready_path);
+                ++itr;
+            }
+        }
+        if (timed_out) {
+            for (const char *path : waiting_paths)
+                ALOGW("%s did not show up, collecting anyway", path);
+        }
+        if (!ready.empty()) {
+            runCollectorsStaggered(ready);
+            continue;
+        }
+        WaitForAnyPath(waiting_paths, std::chrono::ceil<std::chrono::milliseconds>(
+                                              deadline - std::chrono::steady_clock::now()));
+    }
+}
 
-    struct itimerspec period;
+void SysfsCollector::dump(int fd) {
+    std::lock_guard<std::mutex> lock(collector_stats_lock_);
+    dprintf(fd, "SysfsCollector: wake every %d s\n", kSecondsPerWake);
+    for (const auto &collector : collectors_) {
+        collector.cost.dump(fd, collector.name);
+        dprintf(fd, "    period %d slot %d tag '%s' last %" PRId64 "ms\n", collector.period_wakes,
+                collector.slot, collector.tag, collector.last_duration_ms);
+        if (collector.snapshot)
+            dprintf(fd, "    unchanged atoms suppressed %" PRId64 "\n",
+                    collector.suppressed_count);
+        if (!IsReady(collector.ready_path))
+            dprintf(fd, "    not ready: %s\n", collector.ready_path);
+    }
+    getVendorAtomQueue()->dump(fd);
+}
+
+/**
+ * Loop forever collecting stats from sysfs nodes and reporting them via
+ * IStats.
+ */
+void SysfsCollector::collect(void) {
+    int timerfd = timerfd_create(CLOCK_BOOTTIME, 0);
+    if (timerfd < 0) {
+        ALOGE("Unable to create timerfd - %s", strerror(errno));
+        return;
+    }
+
+    BootPhaseTimer boot_timer("pixelstats");
+    // Leave the boot itself to the rest of the system
+    boot_timer.begin("boot_completed");
+    if (!android::base::WaitForProperty("sys.boot_completed", "1", kBootCompletedTimeout))
+        ALOGW("Boot not completed, collecting anyway");
 
-    // gcd (greatest common divisor) of all the following timings
-    constexpr int kSecondsPerWake = 5 * 60;
+    // At idle priority so the boot collection doesn't compete with the app launches
+    // right after boot. Threads inherit the policy, so the collector workers run idle too.
+    std::thread([this, &boot_timer]() {
+        const struct sched_param param = {.sched_priority = 0};
+        if (sched_setscheduler(0, SCHED_IDLE, &param))
+            ALOGW("Unable to run the boot collection idle - %s", strerror(errno));
+        collectOnBoot(&boot_timer);
+    }).join();
+    boot_timer.finish(reportBootPhasesToStats);
 
-    constexpr int kWakesPer5Min = 5 * 60 / kSecondsPerWake;
-    constexpr int kWakesPerHour = 60 * 60 / kSecondsPerWake;
-    constexpr int kWakesPerDay = 24 * 60 * 60 / kSecondsPerWake;
+    struct itimerspec period;
 
     int wake_5min = 0;
-    int wake_hours = 0;
-    int wake_days = 0;
+    int64_t wake = 0;
 
     period.it_interval.tv_sec = kSecondsPerWake;
     period.it_interval.tv_nsec = 0;
@@ -2247,27 +2589,26 @@ void SysfsCollector::collect(void) {
         }
 
         wake_5min += expire.count;
-        wake_hours += expire.count;
-        wake_days += expire.count;
+        wake += expire.count;
+        if (expire.count >= 2 * kWakesPerHour)
+            ALOGW("Hourly wake: sleep too much: expire.count=%" PRId64, expire.count);
 
+        // Runs before the mm collectors, never alongside them
         if (wake_5min >= kWakesPer5Min) {
             wake_5min %= kWakesPer5Min;
             aggregatePer5Min();
         }
 
-        if (wake_hours >= kWakesPerHour) {
-            if (wake_hours >= 2 * kWakesPerHour)
-                ALOGW("Hourly wake: sleep too much: expire.count=%" PRId64, expire.count);
-            wake_hours %= kWakesPerHour;
-            logPerHour();
-        }
-
-        if (wake_days >= kWakesPerDay) {
-            if (wake_hours >= 2 * kWakesPerDay)
-                ALOGW("Daily wake: sleep too much: expire.count=%" PRId64, expire.count);
-            wake_days %= kWakesPerDay;
-            logPerDay();
+        std::vector<Collector *> due_collectors;
+        for (auto &collector : collectors_) {
+            if (collector.next_wake > wake)
+                continue;
+            due_collectors.push_back(&collector);
+            // A collector whose slot passed more than once while asleep runs once
+            collector.next_wake = wake - (wake - collector.slot) % collector.period_wakes +
+                                  collector.period_wakes;
         }
+        runCollectors(due_collectors);
     }
 }
 
@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "pixelstats-vendor"
+
+#include <fcntl.h>
+#include <pixelstats/SysfsReader.h>
+#include <unistd.h>
+#include <utils/Log.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+namespace {
+
+constexpr std::string_view kWhitespace = " \t\n";
+// What isspace() matches, which sscanf() skips before a number
+constexpr std::string_view kScanfWhitespace = " \t\n\v\f\r";
+
+std::string_view trim(std::string_view text) {
+    const size_t begin = text.find_first_not_of(kWhitespace);
+    if (begin == std::string_view::npos)
+        return {};
+    return text.substr(begin, text.find_last_not_of(kWhitespace) - begin + 1);
+}
+
+template <typename T>
+bool parseNumber(std::string_view text, T *value) {
+    text = trim(text);
+    if (text.empty())
+        return false;
+    // from_chars takes no leading '+'
+    if (text[0] == '+')
+        text.remove_prefix(1);
+    const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), *value);
+    return ec == std::errc() && end == text.data() + text.size();
+}
+
+}  // namespace
+
+bool SysfsReader::read(const std::string &path, std::string_view *content) {
+    auto itr = fds_.find(path);
+    if (itr == fds_.end()) {
+        android::base::unique_fd fd(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+        if (!fd.ok())
+            return false;
+        if (fds_.size() >= kMaxOpenNodes)
+            fds_.clear();
+        itr = fds_.emplace(path, std::move(fd)).first;
+    }
+
+    const ssize_t size = TEMP_FAILURE_RETRY(pread(itr->second.get(), buffer_, kBufferSize, 0));
+    if (size < 0) {
+        const int saved_errno = errno;
+        fds_.erase(itr);
+        errno = saved_errno;
+        return false;
+    }
+    if (static_cast<size_t>(size) == kBufferSize) {
+        ALOGE("%s does not fit in %zu bytes", path.c_str(), kBufferSize);
+        fds_.erase(itr);
+        errno = EFBIG;
+        return false;
+    }
+    *content = std::string_view(buffer_, size);
+    return true;
+}
+
+bool SysfsReader::readUint(const std::string &path, uint64_t *value) {
+    std::string_view content;
+    if (!read(path, &content))
+        return false;
+    if (!ParseSysfsUint(content, value)) {
+        errno = EINVAL;
+        return false;
+    }
+    return true;
+}
+
+bool SysfsReader::readInt(const std::string &path, int64_t *value) {
+    std::string_view content;
+    if (!read(path, &content))
+        return false;
+    if (!ParseSysfsInt(content, value)) {
+        errno = EINVAL;
+        return false;
+    }
+    return true;
+}
+
+bool ParseSysfsUint(std::string_view text, uint64_t *value) {
+    text = trim(text);
+    // from_chars would wrap "-1" around
+    return !text.empty() && text[0] != '-' && parseNumber(text, value);
+}
+
+bool ParseSysfsInt(std::string_view text, int64_t *value) {
+    return parseNumber(text, value);
+}
+
+bool ParseSysfsCentis(std::string_view text, int64_t *value) {
+    text = trim(text);
+    const size_t dot = text.find('.');
+    int64_t whole = 0;
+    if (!ParseSysfsInt(text.substr(0, dot), &whole) || whole < 0 || text[0] == '-')
+        return false;
+
+    int64_t fraction = 0;
+    if (dot != std::string_view::npos) {
+        const std::string_view digits = text.substr(dot + 1);
+        if (digits.empty())
+            return false;
+        int scale = 10;
+        for (size_t i = 0; i < digits.size(); ++i) {
+            if (digits[i] < '0' || digits[i] > '9')
+                return false;
+            if (i == 2) {
+                // Round half up on the third decimal, the rest can't change it
+                fraction += digits[i] >= '5';
+            } else if (i < 2) {
+                fraction += (digits[i] - '0') * scale;
+                scale /= 10;
+            }
+        }
+    }
+    *value = whole * 100 + fraction;
+    return true;
+}
+
+void SysfsNameValues::clear() {
+    std::fill(present.begin(), present.end(), false);
+    valid = false;
+}
+
+SysfsNameValueTable::SysfsNameValueTable(const std::vector<std::string> &names) : names_(names) {
+    // Later duplicates of a name are never filled
+    for (size_t i = 0; i < names_.size(); ++i)
+        index_.emplace(names_[i], i);
+}
+
+bool SysfsNameValueTable::parse(std::string_view content, SysfsNameValues *values,
+                                int *bad_line) const {
+    values->values.assign(names_.size(), 0);
+    values->present.assign(names_.size(), false);
+    values->valid = false;
+
+    int line_num = 0;
+    while (!content.empty()) {
+        const size_t end = std::min(content.find('\n'), content.size());
+        std::string_view line = content.substr(0, end);
+        content.remove_prefix(std::min(end + 1, content.size()));
+        line_num++;
+
+        std::string_view name = NextSysfsToken(&line, " ");
+        const std::string_view value = NextSysfsToken(&line, " ");
+        uint64_t parsed;
+        if (name.empty() || value.empty() || !ParseSysfsUint(value, &parsed)) {
+            values->clear();
+            *bad_line = line_num;
+            return false;
+        }
+        if (name.back() == ':')
+            name.remove_suffix(1);
+
+        const auto itr = index_.find(name);
+        if (itr == index_.end())
+            continue;
+        values->values[itr->second] = parsed;
+        values->present[itr->second] = true;
+    }
+    values->valid = line_num > 0;
+    return true;
+}
+
+std::string_view NextSysfsToken(std::string_view *text, std::string_view delims) {
+    const size_t begin = text->find_first_not_of(delims);
+    if (begin == std::string_view::npos) {
+        *text = {};
+        return {};
+    }
+    text->remove_prefix(begin);
+    // A single delimiter, as for lines, is found with memchr
+    const size_t end = std::min(
+            delims.size() == 1 ? text->find(delims[0]) : text->find_first_of(delims),
+            text->size());
+    const std::string_view token = text->substr(0, end);
+    text->remove_prefix(end);
+    return token;
+}
+
+bool ScanSysfsInt(std::string_view *text, char separator, int32_t *value) {
+    std::string_view rest = *text;
+    if (separator != ' ') {
+        if (rest.empty() || rest[0] != separator)
+            return false;
+        rest.remove_prefix(1);
+    }
+    const size_t begin = rest.find_first_not_of(kScanfWhitespace);
+    if (begin == std::string_view::npos)
+        return false;
+    rest.remove_prefix(begin);
+
+    const char *first = rest.data();
+    const char *const last = rest.data() + rest.size();
+    // from_chars takes no leading '+', and must not take "+-1" either
+    if (*first == '+' && ++first != last && *first == '-')
+        return false;
+    int32_t parsed;
+    const auto [end, ec] = std::from_chars(first, last, parsed);
+    if (ec != std::errc())
+        return false;
+    *value = parsed;
+    text->remove_prefix(end - text->data());
+    return true;
+}
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
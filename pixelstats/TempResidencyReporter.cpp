@@ -23,10 +23,12 @@
 #include <android-base/strings.h>
 #include <android/binder_manager.h>
 #include <hardware/google/pixel/pixelstats/pixelatoms.pb.h>
+#include <pixelstats/SysfsReader.h>
 #include <pixelstats/TempResidencyReporter.h>
 #include <utils/Log.h>
 
-#include <cinttypes>
+#include <algorithm>
+#include <cstdlib>
 
 namespace android {
 namespace hardware {
@@ -40,84 +42,132 @@ using android::base::ReadFileToString;
 using android::base::WriteStringToFile;
 using android::hardware::google::pixel::PixelAtoms::ThermalDfsStats;
 
-bool updateOffsetAndCheckBound(int *offset, const int &bytes_read, const int &data_len) {
-    *offset += bytes_read;
-    return *offset <= data_len;
-}
+namespace {
 
-/**
- * Parse file_contents and read residency stats into stats.
- */
-bool parse_file_contents(std::string file_contents,
-                         std::map<std::string, TempResidencyStats> *stats) {
-    const char *data = file_contents.c_str();
-    int data_len = file_contents.length();
-    char sensor_name[32];
-    int offset = 0;
-    int bytes_read;
-
-    while (sscanf(data + offset, "THERMAL ZONE: %31s\n%n", sensor_name, &bytes_read) == 1) {
-        TempResidencyStats temp_residency_stats;
-        int64_t temp_res_value;
-        int num_stats_buckets;
-        int index = 0;
-        if (!updateOffsetAndCheckBound(&offset, bytes_read, data_len))
-            return false;
+std::string_view trimSpaces(std::string_view text) {
+    const size_t start = text.find_first_not_of(" \t");
+    if (start == std::string_view::npos)
+        return {};
+    return text.substr(start, text.find_last_not_of(" \t") - start + 1);
+}
 
-        std::string sensor_name_str = sensor_name;
+// The value of a "<key> <value><unit>" line
+bool parseField(std::string_view line, std::string_view key, std::string_view unit,
+                std::string_view *value) {
+    if (line.substr(0, key.size()) != key)
+        return false;
+    *value = trimSpaces(line.substr(key.size()));
+    if (value->size() <= unit.size() || value->substr(value->size() - unit.size()) != unit)
+        return false;
+    value->remove_suffix(unit.size());
+    return true;
+}
 
-        if (!sscanf(data + offset, "MAX_TEMP: %f\n%n", &temp_residency_stats.max_temp,
-                    &bytes_read) ||
-            !updateOffsetAndCheckBound(&offset, bytes_read, data_len))
-            return false;
+bool parseFloat(std::string_view text, float *value) {
+    char buffer[32];
+    if (text.empty() || text.size() >= sizeof(buffer))
+        return false;
+    text.copy(buffer, text.size());
+    buffer[text.size()] = '\0';
+    char *end;
+    *value = strtof(buffer, &end);
+    return end == buffer + text.size();
+}
 
-        if (!sscanf(data + offset, "MAX_TEMP_TIMESTAMP: %" PRId64 "s\n%n",
-                    &temp_residency_stats.max_temp_timestamp, &bytes_read) ||
-            !updateOffsetAndCheckBound(&offset, bytes_read, data_len))
-            return false;
+bool isBucketBound(std::string_view text) {
+    int64_t bound;
+    return ParseSysfsInt(text, &bound);
+}
 
-        if (!sscanf(data + offset, "MIN_TEMP: %f\n%n", &temp_residency_stats.min_temp,
-                    &bytes_read) ||
-            !updateOffsetAndCheckBound(&offset, bytes_read, data_len))
-            return false;
+// "<low> - <high> ====> <residency>ms", low may be -inf or high inf but not both
+bool parseBucket(std::string_view line, int64_t *residency) {
+    std::string_view low = NextSysfsToken(&line, " \t");
+    std::string_view dash = NextSysfsToken(&line, " \t");
+    std::string_view high = NextSysfsToken(&line, " \t");
+    std::string_view arrow = NextSysfsToken(&line, " \t");
+    std::string_view value = NextSysfsToken(&line, " \t");
+    if (dash != "-" || arrow != "====>" || !NextSysfsToken(&line, " \t").empty() ||
+        !(isBucketBound(low) || (low == "-inf" && high != "inf")) ||
+        !(isBucketBound(high) || high == "inf") || !android::base::ConsumeSuffix(&value, "ms"))
+        return false;
+    return ParseSysfsInt(value, residency);
+}
 
-        if (!sscanf(data + offset, "MIN_TEMP_TIMESTAMP: %" PRId64 "s\n%n",
-                    &temp_residency_stats.min_temp_timestamp, &bytes_read) ||
-            !updateOffsetAndCheckBound(&offset, bytes_read, data_len))
-            return false;
+}  // namespace
 
-        if (!sscanf(data + offset, "NUM_TEMP_RESIDENCY_BUCKETS: %d\n%n", &num_stats_buckets,
-                    &bytes_read) ||
-            !updateOffsetAndCheckBound(&offset, bytes_read, data_len))
+/**
+ * Parse the residency stats of each thermal zone into stats_, in one pass
+ * over the lines of content:
+ *   THERMAL ZONE: <sensor>
+ *   MAX_TEMP: <temp>
+ *   MAX_TEMP_TIMESTAMP: <secs>s
+ *   MIN_TEMP: <temp>
+ *   MIN_TEMP_TIMESTAMP: <secs>s
+ *   NUM_TEMP_RESIDENCY_BUCKETS: <n>
+ *   -inf - <t1> ====> <residency>ms
+ *   <t1> - <t2> ====> <residency>ms
+ *   ...
+ *   <tn-1> - inf ====> <residency>ms
+ * Parsing stops at the first line which does not start a zone.
+ */
+bool TempResidencyReporter::parseResidency(std::string_view content) {
+    num_stats_ = 0;
+    while (true) {
+        std::string_view line = NextSysfsToken(&content, "\n");
+        if (NextSysfsToken(&line, " \t") != "THERMAL" || NextSysfsToken(&line, " \t") != "ZONE:")
+            return true;
+        const std::string_view sensor_name = trimSpaces(line);
+        if (sensor_name.empty())
+            return true;
+
+        if (num_stats_ == stats_.size())
+            stats_.emplace_back();
+        TempResidencyStats &stats = stats_[num_stats_];
+        stats.sensor_name = sensor_name;
+        stats.temp_residency_buckets.clear();
+
+        std::string_view value;
+        int64_t num_buckets;
+        if (!parseField(NextSysfsToken(&content, "\n"), "MAX_TEMP:", "", &value) ||
+            !parseFloat(value, &stats.max_temp) ||
+            !parseField(NextSysfsToken(&content, "\n"), "MAX_TEMP_TIMESTAMP:", "s", &value) ||
+            !ParseSysfsInt(value, &stats.max_temp_timestamp) ||
+            !parseField(NextSysfsToken(&content, "\n"), "MIN_TEMP:", "", &value) ||
+            !parseFloat(value, &stats.min_temp) ||
+            !parseField(NextSysfsToken(&content, "\n"), "MIN_TEMP_TIMESTAMP:", "s", &value) ||
+            !ParseSysfsInt(value, &stats.min_temp_timestamp) ||
+            !parseField(NextSysfsToken(&content, "\n"), "NUM_TEMP_RESIDENCY_BUCKETS:", "",
+                        &value) ||
+            !ParseSysfsInt(value, &num_buckets))
             return false;
 
-        while (index < num_stats_buckets) {
-            if (sscanf(data + offset, "-inf - %*d ====> %" PRId64 "ms\n%n", &temp_res_value,
-                       &bytes_read) != 1 &&
-                sscanf(data + offset, "%*d - %*d ====> %" PRId64 "ms\n%n", &temp_res_value,
-                       &bytes_read) != 1 &&
-                sscanf(data + offset, "%*d - inf ====> %" PRId64 "ms\n\n%n", &temp_res_value,
-                       &bytes_read) != 1)
-                return false;
-
-            temp_residency_stats.temp_residency_buckets.push_back(temp_res_value);
-            index++;
-
-            offset += bytes_read;
-            if ((offset >= data_len) && (index < num_stats_buckets))
+        for (int index = 0; index < num_buckets; index++) {
+            int64_t residency;
+            if (!parseBucket(NextSysfsToken(&content, "\n"), &residency))
                 return false;
+            stats.temp_residency_buckets.push_back(residency);
         }
-        (*stats)[sensor_name_str] = temp_residency_stats;
+        num_stats_++;
     }
-    return true;
 }
 
 /**
- * Logs the Temperature residency stats for every thermal zone.
+ * Logs the Temperature residency stats for every thermal zone, then frees
+ * what the collection allocated until the next one.
  */
 void TempResidencyReporter::logTempResidencyStats(
         const std::shared_ptr<IStats> &stats_client, std::string_view temperature_residency_path,
         std::string_view temperature_residency_reset_path) {
+    reportResidency(stats_client, temperature_residency_path, temperature_residency_reset_path);
+    stats_ = {};
+    num_stats_ = 0;
+    report_order_ = {};
+    event_.values = {};
+}
+
+void TempResidencyReporter::reportResidency(const std::shared_ptr<IStats> &stats_client,
+                                            std::string_view temperature_residency_path,
+                                            std::string_view temperature_residency_reset_path) {
     if (temperature_residency_path.empty() || temperature_residency_reset_path.empty()) {
         ALOGV("TempResidency Stats/Reset path not specified");
         return;
@@ -127,12 +177,11 @@ void TempResidencyReporter::logTempResidencyStats(
         ALOGE("Unable to read TempResidencyStatsPath");
         return;
     }
-    std::map<std::string, TempResidencyStats> stats_map;
-    if (!parse_file_contents(file_contents, &stats_map)) {
+    if (!parseResidency(file_contents)) {
         ALOGE("Fail to parse TempResidencyStatsPath");
         return;
     }
-    if (!stats_map.size())
+    if (!num_stats_)
         return;
     ::android::base::boot_clock::time_point curTime = ::android::base::boot_clock::now();
     int64_t since_last_update_ms =
@@ -145,52 +194,44 @@ void TempResidencyReporter::logTempResidencyStats(
         return;
     }
 
-    auto stats_map_iterator = stats_map.begin();
-    VendorAtomValue tmp_atom_value;
-
-    // Iterate through stats_map by sensor_name
-    while (stats_map_iterator != stats_map.end()) {
-        std::vector<VendorAtomValue> values;
-        const auto &sensor_name_str = stats_map_iterator->first;
-        const auto &temp_residency_stats = stats_map_iterator->second;
-        const auto &temp_residency_buckets_count =
-                temp_residency_stats.temp_residency_buckets.size();
-        if (temp_residency_buckets_count > kMaxBucketLen) {
-            stats_map_iterator++;
+    // Report by sensor name, the last zone of a name wins
+    report_order_.resize(num_stats_);
+    for (size_t i = 0; i < num_stats_; i++) report_order_[i] = num_stats_ - 1 - i;
+    std::stable_sort(report_order_.begin(), report_order_.end(), [this](size_t a, size_t b) {
+        return stats_[a].sensor_name < stats_[b].sensor_name;
+    });
+    report_order_.erase(std::unique(report_order_.begin(), report_order_.end(),
+                                    [this](size_t a, size_t b) {
+                                        return stats_[a].sensor_name == stats_[b].sensor_name;
+                                    }),
+                        report_order_.end());
+
+    event_.reverseDomainName = "";
+    event_.atomId = PixelAtoms::Atom::kVendorTempResidencyStats;
+    std::vector<VendorAtomValue> &values = event_.values;
+    values.resize(2 + kMaxBucketLen + 4);
+    for (const size_t index : report_order_) {
+        const TempResidencyStats &temp_residency_stats = stats_[index];
+        const auto &temp_residency_buckets = temp_residency_stats.temp_residency_buckets;
+        if (temp_residency_buckets.size() > kMaxBucketLen)
             continue;
+
+        auto value = values.begin();
+        (value++)->set<VendorAtomValue::stringValue>(temp_residency_stats.sensor_name);
+        (value++)->set<VendorAtomValue::longValue>(since_last_update_ms);
+        // Fill the residency buckets, and the remaining ones with 0
+        for (int i = 0; i < kMaxBucketLen; i++) {
+            (value++)->set<VendorAtomValue::longValue>(
+                    i < temp_residency_buckets.size() ? temp_residency_buckets[i] : 0);
         }
-        tmp_atom_value.set<VendorAtomValue::stringValue>(sensor_name_str);
-        values.push_back(tmp_atom_value);
-        tmp_atom_value.set<VendorAtomValue::longValue>(since_last_update_ms);
-        values.push_back(tmp_atom_value);
-        // Iterate over every temperature residency buckets
-        for (const auto &temp_residency_bucket : temp_residency_stats.temp_residency_buckets) {
-            tmp_atom_value.set<VendorAtomValue::longValue>(temp_residency_bucket);
-            values.push_back(tmp_atom_value);
-        }
-        // Fill the remaining residency buckets with 0.
-        int remaining_residency_buckets_count = kMaxBucketLen - temp_residency_buckets_count;
-        if (remaining_residency_buckets_count > 0) {
-            tmp_atom_value.set<VendorAtomValue::longValue>(0);
-            values.insert(values.end(), remaining_residency_buckets_count, tmp_atom_value);
-        }
-        tmp_atom_value.set<VendorAtomValue::floatValue>(temp_residency_stats.max_temp);
-        values.push_back(tmp_atom_value);
-        tmp_atom_value.set<VendorAtomValue::longValue>(temp_residency_stats.max_temp_timestamp);
-        values.push_back(tmp_atom_value);
-        tmp_atom_value.set<VendorAtomValue::floatValue>(temp_residency_stats.min_temp);
-        values.push_back(tmp_atom_value);
-        tmp_atom_value.set<VendorAtomValue::longValue>(temp_residency_stats.min_temp_timestamp);
-        values.push_back(tmp_atom_value);
+        (value++)->set<VendorAtomValue::floatValue>(temp_residency_stats.max_temp);
+        (value++)->set<VendorAtomValue::longValue>(temp_residency_stats.max_temp_timestamp);
+        (value++)->set<VendorAtomValue::floatValue>(temp_residency_stats.min_temp);
+        (value++)->set<VendorAtomValue::longValue>(temp_residency_stats.min_temp_timestamp);
         //  Send vendor atom to IStats HAL
-        VendorAtom event = {.reverseDomainName = "",
-                            .atomId = PixelAtoms::Atom::kVendorTempResidencyStats,
-                            .values = std::move(values)};
-        ndk::ScopedAStatus ret = stats_client->reportVendorAtom(event);
+        ndk::ScopedAStatus ret = stats_client->reportVendorAtom(event_);
         if (!ret.isOk())
             ALOGE("Unable to report VendorTempResidencyStats to Stats service");
-
-        stats_map_iterator++;
     }
     prevTime = curTime;
 }
@@ -45,17 +45,26 @@
 #include <cutils/uevent.h>
 #include <fcntl.h>
 #include <hardware/google/pixel/pixelstats/pixelatoms.pb.h>
+#include <linux/filter.h>
+#include <linux/netlink.h>
 #include <linux/thermal.h>
 #include <log/log.h>
 #include <pixelstats/StatsHelper.h>
 #include <pixelstats/UeventListener.h>
+#include <pixelstats/VendorAtomQueue.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <utils/StrongPointer.h>
 
+#include <algorithm>
+#include <cinttypes>
+#include <iterator>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <vector>
 
 namespace android {
 namespace hardware {
@@ -82,8 +91,104 @@ constexpr int32_t VID_GOOGLE = 0x18d1;
 constexpr int32_t PID_OFFSET = 2;
 constexpr int32_t PID_LENGTH = 4;
 constexpr uint32_t PID_P30 = 0x4f05;
-constexpr const char *THERMAL_ABNORMAL_INFO_EQ = "THERMAL_ABNORMAL_INFO=";
-constexpr const char *THERMAL_ABNORMAL_TYPE_EQ = "THERMAL_ABNORMAL_TYPE=";
+
+namespace {
+
+// The uevent keys ProcessUevent() records, indexes into its key slots.
+enum UeventKey {
+    kKeyDriver,
+    kKeyProduct,
+    kKeyMicBreakStatus,
+    kKeyMicDegradeStatus,
+    kKeyDevpath,
+    kKeySubsystem,
+    kKeyGpuEventType,
+    kKeyGpuEventInfo,
+    kKeyThermalAbnormalType,
+    kKeyThermalAbnormalInfo,
+    kNumUeventKeys,
+    kKeyNone = kNumUeventKeys,
+};
+
+// Most uevents carry none of these keys, so dispatch on the key length first.
+// Each length has at most two candidates.
+UeventKey lookupUeventKey(std::string_view name) {
+    switch (name.size()) {
+        case 6:
+            return name == "DRIVER" ? kKeyDriver : kKeyNone;
+        case 7:
+            if (name == "DEVPATH")
+                return kKeyDevpath;
+            return name == "PRODUCT" ? kKeyProduct : kKeyNone;
+        case 9:
+            return name == "SUBSYSTEM" ? kKeySubsystem : kKeyNone;
+        case 15:
+            if (name == "GPU_UEVENT_TYPE")
+                return kKeyGpuEventType;
+            return name == "GPU_UEVENT_INFO" ? kKeyGpuEventInfo : kKeyNone;
+        case 16:
+            return name == "MIC_BREAK_STATUS" ? kKeyMicBreakStatus : kKeyNone;
+        case 18:
+            return name == "MIC_DEGRADE_STATUS" ? kKeyMicDegradeStatus : kKeyNone;
+        case 21:
+            if (name == "THERMAL_ABNORMAL_TYPE")
+                return kKeyThermalAbnormalType;
+            return name == "THERMAL_ABNORMAL_INFO" ? kKeyThermalAbnormalInfo : kKeyNone;
+        default:
+            return kKeyNone;
+    }
+}
+
+// Subsystems which send most of the uevents during USB plug and charging, and
+// none of the handlers cares about: neither their DRIVER nor their DEVPATH match.
+bool isIgnoredSubsystem(std::string_view subsystem) {
+    switch (subsystem.size()) {
+        case 3:
+            return subsystem == "bdi" || subsystem == "net" || subsystem == "tty" ||
+                   subsystem == "usb";
+        case 5:
+            return subsystem == "block" || subsystem == "input";
+        case 6:
+            return subsystem == "hidraw" || subsystem == "queues" || subsystem == "wakeup";
+        case 7:
+            return subsystem == "thermal";
+        case 11:
+            return subsystem == "video4linux";
+        default:
+            return false;
+    }
+}
+
+// Uevents taken from the socket with one recvmmsg() call
+constexpr int kUeventBatchSize = 16;
+
+// Same checks as uevent_kernel_multicast_recv(): root credentials, kernel sender,
+// multicast group, and not truncated
+bool isKernelUevent(const struct mmsghdr &mmsg, const struct sockaddr_nl &addr) {
+    if (mmsg.msg_len == 0 || mmsg.msg_len >= UEVENT_MSG_LEN ||
+        (mmsg.msg_hdr.msg_flags & MSG_TRUNC))
+        return false;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&mmsg.msg_hdr);
+    if (!cmsg || cmsg->cmsg_type != SCM_CREDENTIALS)
+        return false;
+    const struct ucred *cred = reinterpret_cast<const struct ucred *>(CMSG_DATA(cmsg));
+    return cred->uid == 0 && addr.nl_groups != 0 && addr.nl_pid == 0;
+}
+
+constexpr uint32_t bpfWord(const char (&word)[5]) {
+    return (static_cast<uint32_t>(word[0]) << 24) | (static_cast<uint32_t>(word[1]) << 16) |
+           (static_cast<uint32_t>(word[2]) << 8) | static_cast<uint32_t>(word[3]);
+}
+
+}  // namespace
+
+struct UeventBatch {
+    char msgs[kUeventBatchSize][UEVENT_MSG_LEN + 2];
+    char controls[kUeventBatchSize][CMSG_SPACE(sizeof(struct ucred))];
+    struct sockaddr_nl addrs[kUeventBatchSize];
+    struct iovec iovs[kUeventBatchSize];
+    struct mmsghdr hdrs[kUeventBatchSize];
+};
 
 bool UeventListener::ReadFileToInt(const std::string &path, int *val) {
     return ReadFileToInt(path.c_str(), val);
@@ -198,35 +303,52 @@ void UeventListener::ReportFGMetricsEvent(const std::shared_ptr<IStats> &stats_c
     battery_fg_reporter_.checkAndReportFGAbnormality(stats_client, kFGAbnlPath);
 }
 
-/**
- * Report raw battery capacity, system battery capacity and associated
- * battery capacity curves. This data is collected to verify the filter
- * applied on the battery capacity. This will allow debugging of issues
- * ranging from incorrect fuel gauge hardware calculations to issues
- * with the software reported battery capacity.
- *
- * The data is retrieved by parsing the battery power supply's ssoc_details.
- *
- * This atom logs data in 5 potential events:
- *      1. When a device is connected
- *      2. When a device is disconnected
- *      3. When a device has reached a full charge (from the UI's perspective)
- *      4. When there is a >= 2 percent skip in the UI reported SOC
- *      5. When there is a difference of >= 4 percent between the raw hardware
- *          battery capacity and the system reported battery capacity.
- */
-void UeventListener::ReportBatteryCapacityFGEvent(const std::shared_ptr<IStats> &stats_client,
-                                                  const char *subsystem) {
-    if (!subsystem || strcmp(subsystem, "SUBSYSTEM=power_supply")) {
-        return;
-    }
+void UeventListener::SubscribePowerSupply(const std::string &supply,
+                                          const std::vector<std::string> &properties,
+                                          PowerSupplySubscriptions::Callback callback) {
+    power_supply_subscriptions_.subscribe(supply, properties, std::move(callback));
+}
 
-    // Indicates an implicit disable of the battery capacity reporting
-    if (kBatterySSOCPath.empty()) {
-        return;
+void UeventListener::SubscribeBatteryReporters() {
+    /**
+     * Report raw battery capacity, system battery capacity and associated
+     * battery capacity curves. This data is collected to verify the filter
+     * applied on the battery capacity. This will allow debugging of issues
+     * ranging from incorrect fuel gauge hardware calculations to issues
+     * with the software reported battery capacity.
+     *
+     * The data is retrieved by parsing the battery power supply's ssoc_details.
+     *
+     * This atom logs data in 5 potential events:
+     *      1. When a device is connected
+     *      2. When a device is disconnected
+     *      3. When a device has reached a full charge (from the UI's perspective)
+     *      4. When there is a >= 2 percent skip in the UI reported SOC
+     *      5. When there is a difference of >= 4 percent between the raw hardware
+     *          battery capacity and the system reported battery capacity.
+     *
+     * ssoc_details only changes along with a uevent of its own supply, so the
+     * uevents of the other supplies are not followed. The fuel gauge can drift
+     * from the UI SOC with no property of the uevent changing, so every uevent
+     * of the supply is taken.
+     */
+    // An empty path indicates an implicit disable of the battery capacity reporting
+    if (!kBatterySSOCPath.empty()) {
+        SubscribePowerSupply(PowerSupplyOfPath(kBatterySSOCPath), {},
+                             [this](const std::shared_ptr<IStats> &stats_client,
+                                    const PowerSupplyUevent &) {
+                                 battery_capacity_reporter_.checkAndReport(stats_client,
+                                                                           kBatterySSOCPath);
+                             });
     }
 
-    battery_capacity_reporter_.checkAndReport(stats_client, kBatterySSOCPath);
+    // The time to full stats are updated at the end of a charging session, and
+    // reported at most once a month
+    SubscribePowerSupply("battery", {"STATUS"},
+                         [this](const std::shared_ptr<IStats> &stats_client,
+                                const PowerSupplyUevent &) {
+                             battery_ttf_reporter_.checkAndReportStats(stats_client);
+                         });
 }
 
 void UeventListener::ReportTypeCPartnerId(const std::shared_ptr<IStats> &stats_client) {
@@ -396,15 +518,14 @@ void UeventListener::ReportThermalAbnormalEvent(const std::shared_ptr<IStats> &s
 }
 
 bool UeventListener::ProcessUevent() {
-    char msg[UEVENT_MSG_LEN + 2];
-    char *cp;
-    const char *driver, *product, *subsystem;
-    const char *mic_break_status, *mic_degrade_status;
-    const char *devpath;
-    bool collect_partner_id = false;
-    const char *gpu_event_type = nullptr, *gpu_event_info = nullptr;
-    const char *thermal_abnormal_event_type = nullptr, *thermal_abnormal_event_info = nullptr;
-    int n;
+#ifdef LOG_UEVENTS_TO_FILE_ONLY_FOR_DEVEL
+    if (log_fd_ < 0) {
+        /* Intentionally no O_CREAT so no logging will happen
+         * unless the user intentionally 'touch's the file.
+         */
+        log_fd_ = open(LOG_UEVENTS_TO_FILE_ONLY_FOR_DEVEL, O_WRONLY);
+    }
+#endif
 
     if (uevent_fd_ < 0) {
         uevent_fd_ = uevent_open_socket(64 * 1024, true);
@@ -412,27 +533,69 @@ bool UeventListener::ProcessUevent() {
             ALOGE("uevent_init: uevent_open_socket failed\n");
             return false;
         }
+        AttachUeventFilter();
     }
 
-#ifdef LOG_UEVENTS_TO_FILE_ONLY_FOR_DEVEL
-    if (log_fd_ < 0) {
-        /* Intentionally no O_CREAT so no logging will happen
-         * unless the user intentionally 'touch's the file.
-         */
-        log_fd_ = open(LOG_UEVENTS_TO_FILE_ONLY_FOR_DEVEL, O_WRONLY);
+    if (!uevent_batch_)
+        uevent_batch_ = std::make_shared<UeventBatch>();
+    UeventBatch &batch = *uevent_batch_;
+    for (int i = 0; i < kUeventBatchSize; ++i) {
+        batch.iovs[i].iov_base = batch.msgs[i];
+        batch.iovs[i].iov_len = UEVENT_MSG_LEN;
+        struct msghdr &hdr = batch.hdrs[i].msg_hdr;
+        hdr.msg_name = &batch.addrs[i];
+        hdr.msg_namelen = sizeof(batch.addrs[i]);
+        hdr.msg_iov = &batch.iovs[i];
+        hdr.msg_iovlen = 1;
+        hdr.msg_control = batch.controls[i];
+        hdr.msg_controllen = sizeof(batch.controls[i]);
+        hdr.msg_flags = 0;
     }
-#endif
 
-    n = uevent_kernel_multicast_recv(uevent_fd_, msg, UEVENT_MSG_LEN);
-    if (n <= 0 || n >= UEVENT_MSG_LEN)
-        return false;
+    // Block for the first uevent, then take whatever else is already queued
+    const int count = TEMP_FAILURE_RETRY(
+            recvmmsg(uevent_fd_, batch.hdrs, kUeventBatchSize, MSG_WAITFORONE, nullptr));
+    if (count < 0) {
+        if (errno != ENOBUFS)
+            return false;
+        // The socket filled up and the kernel dropped uevents, keep listening
+        int64_t overflow_count;
+        {
+            std::lock_guard<std::mutex> lock(stats_lock_);
+            overflow_count = ++overflow_count_;
+        }
+        ALOGW("uevent socket overflowed, uevents lost (%" PRId64 " times so far)", overflow_count);
+        return true;
+    }
 
-    // Ensure double-null termination of msg.
-    msg[n] = '\0';
-    msg[n + 1] = '\0';
+    {
+        std::lock_guard<std::mutex> lock(stats_lock_);
+        wake_count_++;
+        max_batch_size_ = std::max(max_batch_size_, count);
+    }
+    if (!thread_io_opened_) {
+        thread_io_fd_ = OpenThreadIo();
+        thread_io_opened_ = true;
+    }
+    for (int i = 0; i < count; ++i) {
+        if (!isKernelUevent(batch.hdrs[i], batch.addrs[i]))
+            continue;
+        char *msg = batch.msgs[i];
+        // Ensure double-null termination of msg.
+        msg[batch.hdrs[i].msg_len] = '\0';
+        msg[batch.hdrs[i].msg_len + 1] = '\0';
+        HandleUevent(msg);
+    }
+    return true;
+}
 
-    driver = product = subsystem = NULL;
-    mic_break_status = mic_degrade_status = devpath = NULL;
+void UeventListener::HandleUevent(char *msg) {
+    constexpr std::string_view kPowerSupplyPrefix = "POWER_SUPPLY_";
+    const char *keys[kNumUeventKeys] = {};
+    bool collect_partner_id = false;
+    char *cp;
+
+    power_supply_uevent_.properties.clear();
 
     /**
      * msg is a sequence of null-terminated strings.
@@ -441,62 +604,171 @@ bool UeventListener::ProcessUevent() {
      */
     cp = msg;
     while (*cp) {
+        const size_t len = strlen(cp);
         if (log_fd_ > 0) {
-            write(log_fd_, cp, strlen(cp));
+            write(log_fd_, cp, len);
             write(log_fd_, "\n", 1);
         }
 
-        if (!strncmp(cp, "DRIVER=", strlen("DRIVER="))) {
-            driver = cp;
-        } else if (!strncmp(cp, "PRODUCT=", strlen("PRODUCT="))) {
-            product = cp;
-        } else if (!strncmp(cp, "MIC_BREAK_STATUS=", strlen("MIC_BREAK_STATUS="))) {
-            mic_break_status = cp;
-        } else if (!strncmp(cp, "MIC_DEGRADE_STATUS=", strlen("MIC_DEGRADE_STATUS="))) {
-            mic_degrade_status = cp;
-        } else if (!strncmp(cp, "DEVPATH=", strlen("DEVPATH="))) {
-            devpath = cp;
-        } else if (!strncmp(cp, "SUBSYSTEM=", strlen("SUBSYSTEM="))) {
-            subsystem = cp;
+        const char *equal = static_cast<const char *>(memchr(cp, '=', len));
+        const std::string_view name = equal ? std::string_view(cp, equal - cp) : "";
+        const UeventKey key = equal ? lookupUeventKey(name) : kKeyNone;
+        if (key != kKeyNone) {
+            keys[key] = cp;
+            // SUBSYSTEM comes right after ACTION and DEVPATH, drop the rest of an
+            // uninteresting uevent without looking at its other keys
+            if (key == kKeySubsystem && kRejectIgnoredSubsystems && log_fd_ <= 0 &&
+                isIgnoredSubsystem(std::string_view(equal + 1))) {
+                CountUevent(cp);
+                return;
+            }
+        } else if (name.substr(0, kPowerSupplyPrefix.size()) == kPowerSupplyPrefix) {
+            power_supply_uevent_.properties.emplace_back(
+                    name.substr(kPowerSupplyPrefix.size()),
+                    std::string_view(equal + 1, cp + len - equal - 1));
         } else if (!strncmp(cp, kTypeCPartnerUevent.c_str(), kTypeCPartnerUevent.size())) {
             collect_partner_id = true;
-        } else if (!strncmp(cp, "GPU_UEVENT_TYPE=", strlen("GPU_UEVENT_TYPE="))) {
-            gpu_event_type = cp;
-        } else if (!strncmp(cp, "GPU_UEVENT_INFO=", strlen("GPU_UEVENT_INFO="))) {
-            gpu_event_info = cp;
-        } else if (!strncmp(cp, THERMAL_ABNORMAL_TYPE_EQ, strlen(THERMAL_ABNORMAL_TYPE_EQ))) {
-            thermal_abnormal_event_type = cp;
-        } else if (!strncmp(cp, THERMAL_ABNORMAL_INFO_EQ, strlen(THERMAL_ABNORMAL_INFO_EQ))) {
-            thermal_abnormal_event_info = cp;
         }
         /* advance to after the next \0 */
-        while (*cp++) {
-        }
+        cp += len + 1;
     }
 
-    std::shared_ptr<IStats> stats_client = getStatsService();
-    if (!stats_client) {
-        ALOGE("Unable to get Stats service instance.");
-    } else {
-        /* Process the strings recorded. */
-        ReportMicStatusUevents(stats_client, devpath, mic_break_status);
-        ReportMicStatusUevents(stats_client, devpath, mic_degrade_status);
-        ReportUsbPortOverheatEvent(stats_client, driver);
-        ReportChargeMetricsEvent(stats_client, driver);
-        ReportBatteryCapacityFGEvent(stats_client, subsystem);
-        if (collect_partner_id) {
-            ReportTypeCPartnerId(stats_client);
-        }
-        ReportGpuEvent(stats_client, driver, gpu_event_type, gpu_event_info);
-        ReportThermalAbnormalEvent(stats_client, devpath, thermal_abnormal_event_type,
-                                   thermal_abnormal_event_info);
-        ReportFGMetricsEvent(stats_client, driver);
+    const char *driver = keys[kKeyDriver];
+    const char *subsystem = keys[kKeySubsystem];
+    const char *devpath = keys[kKeyDevpath];
+    CountUevent(subsystem);
+    CostMeter meter(thread_io_fd_.get());
+
+    // Atoms are queued, the uevent loop never waits on the Stats service
+    const std::shared_ptr<IStats> stats_client = getVendorAtomQueue();
+    /* Process the strings recorded. */
+    ReportMicStatusUevents(stats_client, devpath, keys[kKeyMicBreakStatus]);
+    ReportMicStatusUevents(stats_client, devpath, keys[kKeyMicDegradeStatus]);
+    ReportUsbPortOverheatEvent(stats_client, driver);
+    ReportChargeMetricsEvent(stats_client, driver);
+    if (subsystem && !strcmp(subsystem, "SUBSYSTEM=power_supply"))
+        power_supply_subscriptions_.dispatch(stats_client, power_supply_uevent_);
+    if (collect_partner_id) {
+        ReportTypeCPartnerId(stats_client);
     }
+    ReportGpuEvent(stats_client, driver, keys[kKeyGpuEventType], keys[kKeyGpuEventInfo]);
+    ReportThermalAbnormalEvent(stats_client, devpath, keys[kKeyThermalAbnormalType],
+                               keys[kKeyThermalAbnormalInfo]);
+    ReportFGMetricsEvent(stats_client, driver);
+    AddUeventCost(subsystem, meter.stop());
 
     if (log_fd_ > 0) {
         write(log_fd_, "\n", 1);
     }
-    return true;
+}
+
+void UeventListener::CountUevent(const char *subsystem) {
+    constexpr std::string_view kSubsystemEq = "SUBSYSTEM=";
+    const std::string_view name =
+            subsystem ? std::string_view(subsystem).substr(kSubsystemEq.size()) : "(none)";
+
+    std::lock_guard<std::mutex> lock(stats_lock_);
+    uevent_count_++;
+    auto itr = subsystem_counts_.find(name);
+    if (itr == subsystem_counts_.end())
+        itr = subsystem_counts_.emplace(name, 0).first;
+    itr->second++;
+}
+
+void UeventListener::AddUeventCost(const char *subsystem, const Cost &cost) {
+    constexpr std::string_view kSubsystemEq = "SUBSYSTEM=";
+    const std::string_view name =
+            subsystem ? std::string_view(subsystem).substr(kSubsystemEq.size()) : "(none)";
+
+    std::lock_guard<std::mutex> lock(stats_lock_);
+    auto itr = subsystem_costs_.find(name);
+    if (itr == subsystem_costs_.end())
+        itr = subsystem_costs_.emplace(name, CostStats()).first;
+    itr->second.add(cost);
+}
+
+void UeventListener::dump(int fd) {
+    std::lock_guard<std::mutex> lock(stats_lock_);
+    dprintf(fd,
+            "UeventListener: %" PRId64 " uevents in %" PRId64 " wakes, socket overflows %" PRId64
+            ", largest batch %d\n",
+            uevent_count_, wake_count_, overflow_count_, max_batch_size_);
+    for (const auto &[subsystem, count] : subsystem_counts_)
+        dprintf(fd, "  %s: %" PRId64 "\n", subsystem.c_str(), count);
+    dprintf(fd, "UeventListener handling costs:\n");
+    for (const auto &[subsystem, cost] : subsystem_costs_)
+        cost.dump(fd, subsystem.c_str());
+}
+
+std::vector<sock_filter> UeventListener::BuildUeventFilter() {
+    // Positions of the '@' after add, bind/move, change/remove/unbind/online and offline
+    constexpr uint32_t kAtPositions[] = {3, 4, 5, 6, 7};
+    // "/devices/virtual/" in words, then the first 4 characters of the next component
+    constexpr uint32_t kVirtualPrefix[] = {bpfWord("/dev"), bpfWord("ices"), bpfWord("/vir"),
+                                           bpfWord("tual")};
+    constexpr uint32_t kIgnoredClasses[] = {bpfWord("bdi/"), bpfWord("bloc"), bpfWord("inpu"),
+                                            bpfWord("net/"), bpfWord("ther"), bpfWord("tty/"),
+                                            bpfWord("wake")};
+    // Header plus the first words of the devpath; anything shorter is passed on
+    constexpr uint32_t kMinLength = 64;
+
+    constexpr size_t kNumAt = std::size(kAtPositions);
+    constexpr size_t kCompare = 2 + 4 * kNumAt;
+    constexpr size_t kNumPrefix = std::size(kVirtualPrefix);
+    constexpr size_t kClassLoad = kCompare + 2 * kNumPrefix + 2;
+    constexpr size_t kAccept = kClassLoad + 1 + std::size(kIgnoredClasses);
+    constexpr size_t kReject = kAccept + 1;
+    // Offset of a jump from instruction pc to target
+    const auto to = [](size_t pc, size_t target) { return static_cast<uint8_t>(target - pc - 1); };
+
+    std::vector<sock_filter> filter;
+    filter.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0));
+    filter.push_back(BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, kMinLength, 0, to(1, kAccept)));
+    // X = offset of the devpath
+    for (size_t i = 0; i < kNumAt; ++i) {
+        const size_t pc = filter.size();
+        filter.push_back(BPF_STMT(BPF_LD | BPF_B | BPF_ABS, kAtPositions[i]));
+        const uint8_t next = i + 1 < kNumAt ? 2 : to(pc + 1, kAccept);
+        filter.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, '@', 0, next));
+        filter.push_back(BPF_STMT(BPF_LDX | BPF_W | BPF_IMM, kAtPositions[i] + 1));
+        filter.push_back(BPF_STMT(BPF_JMP | BPF_JA, to(pc + 3, kCompare)));
+    }
+    for (size_t i = 0; i < kNumPrefix; ++i) {
+        const size_t pc = filter.size();
+        filter.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_IND, static_cast<uint32_t>(4 * i)));
+        filter.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, kVirtualPrefix[i], 0,
+                                  to(pc + 1, kAccept)));
+    }
+    filter.push_back(BPF_STMT(BPF_LD | BPF_B | BPF_IND, 4 * kNumPrefix));
+    filter.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, '/', 0, to(filter.size(), kAccept)));
+    filter.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_IND, 4 * kNumPrefix + 1));
+    for (const uint32_t ignored_class : kIgnoredClasses) {
+        filter.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ignored_class,
+                                  to(filter.size(), kReject), 0));
+    }
+    filter.push_back(BPF_STMT(BPF_RET | BPF_K, 0xffffffff));
+    filter.push_back(BPF_STMT(BPF_RET | BPF_K, 0));
+    return filter;
+}
+
+/**
+ * Drop the uevents of the noisiest ignored subsystems in the kernel, before
+ * they are queued on the socket. A kernel uevent starts with "ACTION@DEVPATH",
+ * the filter finds the '@' and rejects devpaths under /devices/virtual/ of
+ * the subsystems isIgnoredSubsystem() drops anyway. Anything it does not
+ * recognize is passed on.
+ */
+void UeventListener::AttachUeventFilter() {
+    if (!kRejectIgnoredSubsystems || log_fd_ > 0)
+        return;
+
+    const std::vector<sock_filter> filter = BuildUeventFilter();
+    const struct sock_fprog prog = {
+            .len = static_cast<unsigned short>(filter.size()),
+            .filter = const_cast<sock_filter *>(filter.data()),
+    };
+    if (setsockopt(uevent_fd_, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0)
+        ALOGW("Unable to attach uevent filter: %s", strerror(errno));
 }
 
 UeventListener::UeventListener(const std::string audio_uevent, const std::string ssoc_details_path,
@@ -516,7 +788,10 @@ UeventListener::UeventListener(const std::string audio_uevent, const std::string
       kFwUpdatePath(fw_update_path),
       kFGAbnlPath(fg_abnl_path),
       uevent_fd_(-1),
-      log_fd_(-1) {}
+      log_fd_(-1) {
+    SubscribeBatteryReporters();
+    AddCostDump(this, [this](int fd) { dump(fd); });
+}
 
 UeventListener::UeventListener(const struct UeventPaths &uevents_paths)
     : kAudioUevent((uevents_paths.AudioUevent == nullptr) ? "" : uevents_paths.AudioUevent),
@@ -540,7 +815,14 @@ UeventListener::UeventListener(const struct UeventPaths &uevents_paths)
                                    ? "" : uevents_paths.FwUpdatePath),
       kFGAbnlPath(uevents_paths.FGAbnlPath),
       uevent_fd_(-1),
-      log_fd_(-1) {}
+      log_fd_(-1) {
+    SubscribeBatteryReporters();
+    AddCostDump(this, [this](int fd) { dump(fd); });
+}
+
+UeventListener::~UeventListener() {
+    RemoveCostDump(this);
+}
 
 /* Thread function to continuously monitor uevents.
  * Exit after kMaxConsecutiveErrors to prevent spinning. */
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "pixelstats-vendor"
+
+#include <android-base/file.h>
+#include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <pixelstats/UnchangedAtomFilter.h>
+#include <utils/Log.h>
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+namespace {
+
+// FNV-1a, stable across builds unlike std::hash, as digests are persisted
+uint64_t digestVendorAtom(const VendorAtom &vendor_atom) {
+    const std::string text = vendor_atom.toString();
+    uint64_t digest = 0xcbf29ce484222325ULL;
+    for (const char c : text) {
+        digest ^= static_cast<uint8_t>(c);
+        digest *= 0x100000001b3ULL;
+    }
+    return digest;
+}
+
+}  // namespace
+
+UnchangedAtomFilter::UnchangedAtomFilter(std::shared_ptr<IStats> stats_client,
+                                         Snapshot *snapshot)
+    : stats_client_(std::move(stats_client)), snapshot_(snapshot) {}
+
+ndk::ScopedAStatus UnchangedAtomFilter::reportVendorAtom(const VendorAtom &vendor_atom) {
+    const std::pair<int32_t, int32_t> key(vendor_atom.atomId,
+                                          atoms_of_id_[vendor_atom.atomId]++);
+    const uint64_t digest = digestVendorAtom(vendor_atom);
+
+    const auto last = snapshot_->find(key);
+    if (last != snapshot_->end() && last->second == digest) {
+        suppressed_count_++;
+        return ndk::ScopedAStatus::ok();
+    }
+
+    ndk::ScopedAStatus ret = stats_client_->reportVendorAtom(vendor_atom);
+    // Only remember what made it out, a dropped atom is sent again next time
+    if (ret.isOk()) {
+        (*snapshot_)[key] = digest;
+        snapshot_changed_ = true;
+    }
+    return ret;
+}
+
+bool LoadAtomSnapshots(const std::string &path,
+                       std::map<std::string, UnchangedAtomFilter::Snapshot> *snapshots) {
+    std::string file_contents;
+    if (!android::base::ReadFileToString(path, &file_contents)) {
+        if (errno != ENOENT)
+            ALOGE("Unable to read atom snapshots %s - %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    for (const auto &line : android::base::Split(file_contents, "\n")) {
+        const std::vector<std::string> words = android::base::Split(line, " ");
+        int32_t atom_id, position;
+        uint64_t digest;
+        if (words.size() != 4 || !android::base::ParseInt(words[1], &atom_id) ||
+            !android::base::ParseInt(words[2], &position) ||
+            !android::base::ParseUint(words[3], &digest)) {
+            if (!line.empty())
+                ALOGE("Bad atom snapshot line: %s", line.c_str());
+            continue;
+        }
+        (*snapshots)[words[0]][{atom_id, position}] = digest;
+    }
+    return true;
+}
+
+bool SaveAtomSnapshots(const std::string &path,
+                       const std::map<std::string, UnchangedAtomFilter::Snapshot> &snapshots) {
+    std::string file_contents;
+    for (const auto &[name, snapshot] : snapshots) {
+        for (const auto &[key, digest] : snapshot) {
+            android::base::StringAppendF(&file_contents, "%s %d %d %" PRIu64 "\n", name.c_str(),
+                                         key.first, key.second, digest);
+        }
+    }
+
+    // Replace the file whole, a reader never sees a partial snapshot
+    const std::string tmp_path = path + ".tmp";
+    if (!android::base::WriteStringToFile(file_contents, tmp_path) ||
+        rename(tmp_path.c_str(), path.c_str())) {
+        ALOGE("Unable to write atom snapshots %s - %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
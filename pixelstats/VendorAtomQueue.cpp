@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "pixelstats-vendor"
+
+#include <pixelstats/StatsHelper.h>
+#include <pixelstats/VendorAtomQueue.h>
+#include <utils/Log.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+namespace {
+
+constexpr size_t kMaxBatchSize = 128;
+// Wait for this long without a new atom before sending, so that the atoms of
+// one collector burst go out together.
+constexpr std::chrono::milliseconds kBurstSettleTime(100);
+constexpr std::chrono::seconds kReconnectDelay(5);
+
+thread_local int64_t thread_queued_count = 0;
+
+int64_t msSince(std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now() - time)
+            .count();
+}
+
+}  // namespace
+
+VendorAtomQueue::VendorAtomQueue()
+    : death_recipient_(AIBinder_DeathRecipient_new(&VendorAtomQueue::onStatsServiceDied)),
+      sender_thread_(&VendorAtomQueue::senderLoop, this) {}
+
+VendorAtomQueue::~VendorAtomQueue() {
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    sender_thread_.join();
+    if (stats_client_)
+        AIBinder_unlinkToDeath(stats_client_->asBinder().get(), death_recipient_.get(), this);
+}
+
+ndk::ScopedAStatus VendorAtomQueue::reportVendorAtom(const VendorAtom &vendor_atom) {
+    if (!enqueue(vendor_atom))
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    return ndk::ScopedAStatus::ok();
+}
+
+bool VendorAtomQueue::enqueue(VendorAtom vendor_atom) {
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (queue_.size() >= kMaxQueuedAtoms) {
+            dropped_full_count_++;
+            return false;
+        }
+        size_t &pending = pending_per_atom_id_[vendor_atom.atomId];
+        if (pending >= kMaxQueuedPerAtomId) {
+            dropped_quota_count_++;
+            return false;
+        }
+        pending++;
+        queue_.push_back({std::move(vendor_atom), std::chrono::steady_clock::now()});
+        queued_count_++;
+        thread_queued_count++;
+        max_queue_size_ = std::max(max_queue_size_, queue_.size());
+    }
+    cv_.notify_all();
+    return true;
+}
+
+void VendorAtomQueue::senderLoop() {
+    std::unique_lock<std::mutex> lock(lock_);
+    while (true) {
+        cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+
+        // Let the rest of the burst come in
+        while (!stop_ && queue_.size() < kMaxBatchSize) {
+            const size_t size = queue_.size();
+            if (!cv_.wait_for(lock, kBurstSettleTime,
+                              [this, size] { return stop_ || queue_.size() != size; }))
+                break;
+        }
+        if (stop_)
+            return;
+
+        std::deque<QueuedAtom> batch;
+        while (!queue_.empty() && batch.size() < kMaxBatchSize) {
+            batch.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+
+        lock.unlock();
+        const bool sent = sendBatch(&batch);
+        lock.lock();
+        if (sent)
+            continue;
+
+        // No Stats service: keep the unsent atoms, oldest first, as far as the bound allows
+        while (!batch.empty()) {
+            if (queue_.size() >= kMaxQueuedAtoms) {
+                dropped_full_count_ += batch.size();
+                for (const auto &queued : batch) pending_per_atom_id_[queued.atom.atomId]--;
+                break;
+            }
+            queue_.push_front(std::move(batch.back()));
+            batch.pop_back();
+        }
+        cv_.wait_for(lock, kReconnectDelay, [this] { return stop_; });
+    }
+}
+
+bool VendorAtomQueue::connect() {
+    stats_client_ = getStatsService();
+    if (!stats_client_)
+        return false;
+    // Only a death notified after the link is about this connection
+    service_died_ = false;
+    const binder_status_t status = AIBinder_linkToDeath(stats_client_->asBinder().get(),
+                                                        death_recipient_.get(), this);
+    if (status != STATUS_OK)
+        ALOGW("Unable to watch the Stats service for death - %d", status);
+    return true;
+}
+
+void VendorAtomQueue::onStatsServiceDied(void *cookie) {
+    VendorAtomQueue *queue = static_cast<VendorAtomQueue *>(cookie);
+    ALOGW("Stats service died");
+    queue->service_died_ = true;
+    std::lock_guard<std::mutex> lock(queue->lock_);
+    queue->death_count_++;
+}
+
+bool VendorAtomQueue::sendBatch(std::deque<QueuedAtom> *batch) {
+    int64_t sent_count = 0;
+    int64_t dropped_failed_count = 0;
+    int64_t reconnect_count = 0;
+    int64_t total_latency_ms = 0;
+    int64_t max_latency_ms = 0;
+    std::vector<int32_t> done_atom_ids;
+    bool retried = false;
+
+    while (!batch->empty()) {
+        // Rather than finding out through a failed transaction
+        if (service_died_.exchange(false))
+            stats_client_.reset();
+        if (!stats_client_) {
+            if (!connect()) {
+                ALOGE("Unable to get AIDL Stats service, %zu atoms pending", batch->size());
+                break;
+            }
+            reconnect_count++;
+        }
+
+        const QueuedAtom &queued = batch->front();
+        const ndk::ScopedAStatus ret = stats_client_->reportVendorAtom(queued.atom);
+        if (!ret.isOk()) {
+            // The Stats service may have restarted, retry once on a new connection
+            stats_client_.reset();
+            if (!retried) {
+                retried = true;
+                continue;
+            }
+            ALOGE("Unable to report atom %d to Stats service", queued.atom.atomId);
+            dropped_failed_count++;
+        } else {
+            const int64_t latency_ms = msSince(queued.queued_time);
+            total_latency_ms += latency_ms;
+            max_latency_ms = std::max(max_latency_ms, latency_ms);
+            sent_count++;
+        }
+        retried = false;
+        done_atom_ids.push_back(queued.atom.atomId);
+        batch->pop_front();
+    }
+
+    std::lock_guard<std::mutex> lock(lock_);
+    for (const int32_t atom_id : done_atom_ids) pending_per_atom_id_[atom_id]--;
+    batch_count_++;
+    sent_count_ += sent_count;
+    dropped_failed_count_ += dropped_failed_count;
+    reconnect_count_ += reconnect_count;
+    total_latency_ms_ += total_latency_ms;
+    max_latency_ms_ = std::max(max_latency_ms_, max_latency_ms);
+    return batch->empty();
+}
+
+void VendorAtomQueue::dump(int fd) {
+    std::lock_guard<std::mutex> lock(lock_);
+    const int64_t oldest_ms = queue_.empty() ? 0 : msSince(queue_.front().queued_time);
+    dprintf(fd,
+            "VendorAtomQueue: queued %" PRId64 " sent %" PRId64 " in %" PRId64
+            " batches, pending %zu (max %zu, oldest %" PRId64 "ms)\n",
+            queued_count_, sent_count_, batch_count_, queue_.size(), max_queue_size_, oldest_ms);
+    dprintf(fd, "  latency: avg %" PRId64 "ms max %" PRId64 "ms\n",
+            sent_count_ ? total_latency_ms_ / sent_count_ : 0, max_latency_ms_);
+    dprintf(fd,
+            "  dropped: queue full %" PRId64 ", atom id quota %" PRId64
+            ", failed after retry %" PRId64 "; connections %" PRId64 " service deaths %" PRId64
+            "\n",
+            dropped_full_count_, dropped_quota_count_, dropped_failed_count_, reconnect_count_,
+            death_count_);
+    for (const auto &[atom_id, pending] : pending_per_atom_id_) {
+        if (pending)
+            dprintf(fd, "  pending atom %d: %zu\n", atom_id, pending);
+    }
+}
+
+std::shared_ptr<VendorAtomQueue> getVendorAtomQueue() {
+    static const std::shared_ptr<VendorAtomQueue> queue =
+            ndk::SharedRefBase::make<VendorAtomQueue>();
+    return queue;
+}
+
+int64_t ThreadQueuedAtomCount() {
+    return thread_queued_count;
+}
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
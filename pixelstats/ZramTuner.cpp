@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/strings.h>
+#include <pixelstats/ZramTuner.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+namespace {
+
+constexpr int64_t kMsPerHour = 60 * 60 * 1000;
+
+// Counters going backwards (e.g. a zram reset) count as no change
+uint64_t delta(uint64_t first, uint64_t last) {
+    return last > first ? last - first : 0;
+}
+
+}  // namespace
+
+void ZramTuner::addSample(const Sample &sample) {
+    if (!started_) {
+        first_ = sample;
+        started_ = true;
+    }
+    last_ = sample;
+    sample_count_++;
+    if (sample.swap_total_kb > 0) {
+        const uint64_t used_kb = sample.swap_total_kb - std::min(sample.swap_free_kb,
+                                                                 sample.swap_total_kb);
+        peak_swap_used_pct_ = std::max(peak_swap_used_pct_,
+                                       static_cast<int64_t>(used_kb * 100 / sample.swap_total_kb));
+    }
+}
+
+ZramTuner::Decision ZramTuner::decide(const std::string &current_size, const std::string &ladder) {
+    Decision decision;
+    const int64_t elapsed_ms = last_.time_ms - first_.time_ms;
+
+    if (last_.compr_data_size > 0)
+        decision.compression_ratio_pct = last_.orig_data_size * 100 / last_.compr_data_size;
+    decision.peak_swap_used_pct = peak_swap_used_pct_;
+    if (elapsed_ms > 0) {
+        // us stalled per ms elapsed is the stalled share in permille
+        decision.memory_pressure_permille =
+                delta(first_.memory_some_us, last_.memory_some_us) / elapsed_ms;
+        decision.refault_anon_per_hour =
+                delta(first_.refault_anon, last_.refault_anon) * kMsPerHour / elapsed_ms;
+    }
+
+    const bool enough_samples = sample_count_ >= kMinSamples && elapsed_ms > 0;
+    // Start the next window from the latest sample
+    first_ = last_;
+    sample_count_ = 0;
+    peak_swap_used_pct_ = 0;
+    if (!enough_samples)
+        return decision;
+
+    const std::vector<std::string> sizes = android::base::Split(ladder, ",");
+    const auto current = std::find(sizes.begin(), sizes.end(), current_size);
+    if (current_size.empty() || current == sizes.end())
+        return decision;
+
+    const bool pressured = decision.memory_pressure_permille >= kGrowMinPressurePermille ||
+                           decision.refault_anon_per_hour >= kGrowMinRefaultAnonPerHour;
+    const bool idle = decision.memory_pressure_permille < kShrinkMaxPressurePermille &&
+                      decision.refault_anon_per_hour < kShrinkMaxRefaultAnonPerHour;
+
+    decision.action = PixelMmMetricsPerDay::ZRAM_SIZE_KEEP;
+    decision.size = current_size;
+    if (decision.peak_swap_used_pct >= kGrowMinPeakSwapUsedPct && pressured &&
+        decision.compression_ratio_pct >= kGrowMinCompressionRatioPct) {
+        if (current + 1 != sizes.end()) {
+            decision.action = PixelMmMetricsPerDay::ZRAM_SIZE_GROW;
+            decision.size = *(current + 1);
+        }
+    } else if (decision.peak_swap_used_pct < kShrinkMaxPeakSwapUsedPct && idle) {
+        if (current != sizes.begin()) {
+            decision.action = PixelMmMetricsPerDay::ZRAM_SIZE_SHRINK;
+            decision.size = *(current - 1);
+        }
+    }
+    return decision;
+}
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
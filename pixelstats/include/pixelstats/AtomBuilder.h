@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_PIXELSTATS_ATOMBUILDER_H
+#define HARDWARE_GOOGLE_PIXEL_PIXELSTATS_ATOMBUILDER_H
+
+#include <aidl/android/frameworks/stats/IStats.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+using aidl::android::frameworks::stats::VendorAtom;
+using aidl::android::frameworks::stats::VendorAtomValue;
+
+/**
+ * The VendorAtom of one atom type, kept by a reporter which reports it over
+ * and over. The values vector is sized once for the fields up to
+ * kLastFieldNumber and reused, so building an atom allocates nothing after
+ * the first one:
+ *
+ *   AtomBuilder<PixelAtoms::Atom::kBatteryHealthUsage,
+ *               BatteryHealthUsage::kDischargeTimeSecsFieldNumber> usage_atom_;
+ *
+ *   usage_atom_.reset();
+ *   usage_atom_.setInt<BatteryHealthUsage::kSocLimitFieldNumber>(soc_limit);
+ *   stats_client->reportVendorAtom(usage_atom_.atom());
+ *
+ * The field numbers come from pixelatoms.pb.h. A field number given as a
+ * template argument is checked at compile time; one taken from a table of
+ * field numbers should have the table checked with hasFields().
+ */
+template <int32_t kAtomId, int kLastFieldNumber>
+class AtomBuilder {
+  public:
+    // Proto messages are 1-indexed and VendorAtom field numbers start at 2, so
+    // each value is at the index of its field number -2.
+    static constexpr int kVendorAtomOffset = 2;
+    static constexpr size_t kNumValues = kLastFieldNumber - kVendorAtomOffset + 1;
+    static_assert(kLastFieldNumber >= kVendorAtomOffset, "An atom has fields from 2 on");
+
+    AtomBuilder() {
+        atom_.atomId = kAtomId;
+        atom_.values.resize(kNumValues);
+    }
+
+    static constexpr bool hasField(int field_number) {
+        return field_number >= kVendorAtomOffset && field_number <= kLastFieldNumber;
+    }
+    template <size_t N>
+    static constexpr bool hasFields(const int (&field_numbers)[N]) {
+        for (const int field_number : field_numbers) {
+            if (!hasField(field_number))
+                return false;
+        }
+        return true;
+    }
+
+    // Start a new atom with every value set to initial, by default an int 0 as in
+    // a new values vector
+    void reset(const VendorAtomValue &initial = VendorAtomValue()) {
+        std::fill(atom_.values.begin(), atom_.values.end(), initial);
+    }
+
+    template <int kFieldNumber>
+    void setInt(int32_t value) {
+        at<kFieldNumber>().template set<VendorAtomValue::intValue>(value);
+    }
+    template <int kFieldNumber>
+    void setLong(int64_t value) {
+        at<kFieldNumber>().template set<VendorAtomValue::longValue>(value);
+    }
+    template <int kFieldNumber>
+    void setFloat(float value) {
+        at<kFieldNumber>().template set<VendorAtomValue::floatValue>(value);
+    }
+
+    // field_number must be one of the atom, see hasFields()
+    void setInt(int field_number, int32_t value) {
+        atom_.values[field_number - kVendorAtomOffset].set<VendorAtomValue::intValue>(value);
+    }
+    void setLong(int field_number, int64_t value) {
+        atom_.values[field_number - kVendorAtomOffset].set<VendorAtomValue::longValue>(value);
+    }
+
+    // For the fill helpers which work on a values vector
+    std::vector<VendorAtomValue> *values() { return &atom_.values; }
+    const VendorAtom &atom() const { return atom_; }
+
+  private:
+    template <int kFieldNumber>
+    VendorAtomValue &at() {
+        static_assert(hasField(kFieldNumber), "Not a field of the atom");
+        return atom_.values[kFieldNumber - kVendorAtomOffset];
+    }
+
+    VendorAtom atom_;
+};
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
+
+#endif  // HARDWARE_GOOGLE_PIXEL_PIXELSTATS_ATOMBUILDER_H
@@ -18,7 +18,9 @@
 #define HARDWARE_GOOGLE_PIXEL_PIXELSTATS_BATTERYEEPROMREPORTER_H
 
 #include <cstdint>
+#include <map>
 #include <string>
+#include <string_view>
 
 #include <aidl/android/frameworks/stats/IStats.h>
 
@@ -54,6 +56,8 @@ class BatteryEEPROMReporter {
                                       const std::vector<std::string> &paths);
     void checkAndReportValidation(const std::shared_ptr<IStats> &stats_client,
                                   const std::vector<std::string> &paths);
+    // Load the history cursors from path, and keep them there from now on
+    void setHistoryCursorPath(const std::string &path);
 
   private:
     // Proto messages are 1-indexed and VendorAtom field numbers start at 2, so
@@ -148,6 +152,24 @@ class BatteryEEPROMReporter {
     int64_t report_time_ = 0;
     int64_t getTimeSecs();
 
+    /* How far a history was reported, by history name */
+    struct HistoryCursor {
+        /* The index of the first entry not reported yet */
+        int next_entry = 0;
+        /* The last reported entry, to tell when the history was reset */
+        std::string last_entry;
+    };
+    const char *const kEEPROMCursorName = "eeprom";
+    const char *const kMaxfgCursorName = "maxfg";
+    std::map<std::string, HistoryCursor> history_cursors_;
+    std::string cursor_path_;
+    bool cursors_changed_ = false;
+
+    bool decodeHistoryV2(std::string_view history_each, int index, struct BatteryHistory *hist);
+    int resumeEntry(const HistoryCursor &cursor, std::string_view contents, size_t entry_size);
+    void advanceCursor(HistoryCursor *cursor, int index, std::string_view entry);
+    void saveHistoryCursors();
+
     bool checkLogEvent(struct BatteryHistory hist);
     void reportEvent(const std::shared_ptr<IStats> &stats_client,
                      const struct BatteryHistory &hist);
@@ -18,6 +18,8 @@
 #define HARDWARE_GOOGLE_PIXEL_PIXELSTATS_BATTERYHEALTHREPORTER_H
 
 #include <aidl/android/frameworks/stats/IStats.h>
+#include <hardware/google/pixel/pixelstats/pixelatoms.pb.h>
+#include <pixelstats/AtomBuilder.h>
 
 namespace android {
 namespace hardware {
@@ -45,14 +47,17 @@ class BatteryHealthReporter {
     int64_t report_time_ = 0;
     int64_t getTimeSecs();
 
-    // Proto messages are 1-indexed and VendorAtom field numbers start at 2, so
-    // store everything in the values array at the index of the field number
-    // -2.
-    const int kVendorAtomOffset = 2;
+    AtomBuilder<PixelAtoms::Atom::kBatteryHealthStatus,
+                PixelAtoms::BatteryHealthStatus::kBatteryDisconnectStatusFieldNumber>
+            status_atom_;
+    AtomBuilder<PixelAtoms::Atom::kBatteryHealthUsage,
+                PixelAtoms::BatteryHealthUsage::kDischargeTimeSecsFieldNumber>
+            usage_atom_;
 
-    const std::string kBatteryHealthStatusPath =
+    static constexpr const char *kBatteryHealthStatusPath =
             "/sys/class/power_supply/battery/health_index_stats";
-    const std::string kBatteryHealthUsagePath = "/sys/class/power_supply/battery/swelling_data";
+    static constexpr const char *kBatteryHealthUsagePath =
+            "/sys/class/power_supply/battery/swelling_data";
 };
 
 }  // namespace pixel
@@ -35,6 +35,8 @@ class BatteryTTFReporter {
     void checkAndReportStats(const std::shared_ptr<IStats> &stats_client);
 
   private:
+    friend class PixelstatsParserBenchmark;
+
     void reportBatteryTTFStatsEvent(const std::shared_ptr<IStats> &stats_client, const char *line);
     bool reportBatteryTTFStats(const std::shared_ptr<IStats> &stats_client);
 
@@ -46,7 +48,7 @@ class BatteryTTFReporter {
     // -2.
     const int kVendorAtomOffset = 2;
 
-    const std::string kBatteryTTFPath = "/sys/class/power_supply/battery/ttf_stats";
+    static constexpr const char *kBatteryTTFPath = "/sys/class/power_supply/battery/ttf_stats";
 };
 
 }  // namespace pixel
@@ -21,7 +21,6 @@
 #include <hardware/google/pixel/pixelstats/pixelatoms.pb.h>
 
 #include <map>
-#include <regex>
 #include <string>
 
 namespace android {
@@ -96,8 +95,13 @@ class BrownoutDetectedReporter {
     void logBrownoutCsv(const std::shared_ptr<IStats> &stats_client, const std::string &logFilePath,
                         const std::string &brownoutReasonProp);
     int brownoutReasonCheck(const std::string &brownoutReasonProp);
+    // Log the battery samples libpixelhealth kept before the last shutdown, then
+    // remove them so they are logged once
+    void logShutdownSamples(const std::string &samplesPath);
 
   private:
+    friend class PixelstatsParserBenchmark;
+
     struct BrownoutDetectedInfo {
         int triggered_irq_;
         long triggered_timestamp_;
@@ -122,7 +126,9 @@ class BrownoutDetectedReporter {
 
     void setAtomFieldValue(std::vector<VendorAtomValue> *values, int offset, int content);
     long parseTimestamp(std::string timestamp);
-    bool updateIfFound(std::string line, std::regex pattern, int *current_value, Update flag);
+    void updateValue(int reading, int *current_value, Update flag);
+    void parseBrownoutLog(const std::string &logFile, struct BrownoutDetectedInfo *max_value,
+                          bool *isAlreadyUpdated);
     void uploadData(const std::shared_ptr<IStats> &stats_client,
                     const struct BrownoutDetectedInfo max_value);
     // Proto messages are 1-indexed and VendorAtom field numbers start at 2, so
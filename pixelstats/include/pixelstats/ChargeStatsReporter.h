@@ -18,6 +18,8 @@
 #define HARDWARE_GOOGLE_PIXEL_PIXELSTATS_CHARGESTATSREPORTER_H
 
 #include <aidl/android/frameworks/stats/IStats.h>
+#include <hardware/google/pixel/pixelstats/pixelatoms.pb.h>
+#include <pixelstats/AtomBuilder.h>
 #include <pixelstats/PcaChargeStats.h>
 #include <pixelstats/WirelessChargeStats.h>
 
@@ -37,6 +39,8 @@ class ChargeStatsReporter {
     void checkAndReport(const std::shared_ptr<IStats> &stats_client, const std::string &path);
 
   private:
+    friend class PixelstatsParserBenchmark;
+
     bool checkContentsAndAck(std::string *file_contents, const std::string &path);
     void ReportVoltageTierStats(const std::shared_ptr<IStats> &stats_client, const char *line,
                                 const bool has_wireless, const std::string &wfile_contents);
@@ -51,17 +55,21 @@ class ChargeStatsReporter {
 
     int log_event_time_secs_ = 0;
 
-    // Proto messages are 1-indexed and VendorAtom field numbers start at 2, so
-    // store everything in the values array at the index of the field number
-    // -2.
-    const int kVendorAtomOffset = 2;
+    AtomBuilder<PixelAtoms::Atom::kChargeStats,
+                PixelAtoms::ChargeStats::kCsiAggregateTypeFieldNumber>
+            charge_stats_atom_;
+    AtomBuilder<PixelAtoms::Atom::kVoltageTierStats,
+                PixelAtoms::VoltageTierStats::kMaxAdapterPowerOutFieldNumber>
+            voltage_tier_atom_;
 
-    const std::string kThermalChargeMetricsPath =
+    static constexpr const char *kThermalChargeMetricsPath =
             "/sys/devices/platform/google,charger/thermal_stats";
 
-    const std::string kGChargerMetricsPath = "/sys/devices/platform/google,charger/charge_stats";
+    static constexpr const char *kGChargerMetricsPath =
+            "/sys/devices/platform/google,charger/charge_stats";
 
-    const std::string kGDualBattMetricsPath = "/sys/class/power_supply/dualbatt/dbatt_stats";
+    static constexpr const char *kGDualBattMetricsPath =
+            "/sys/class/power_supply/dualbatt/dbatt_stats";
 };
 
 }  // namespace pixel
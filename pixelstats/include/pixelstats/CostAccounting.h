@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_PIXELSTATS_COSTACCOUNTING_H
+#define HARDWARE_GOOGLE_PIXEL_PIXELSTATS_COSTACCOUNTING_H
+
+#include <android-base/unique_fd.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+// What one run of a collector or uevent handler cost its thread
+struct Cost {
+    int64_t wall_us = 0;
+    int64_t cpu_us = 0;
+    // Bytes read from files, sysfs included, -1 if not known
+    int64_t read_bytes = 0;
+    // Atoms queued to the Stats service
+    int64_t atoms = 0;
+};
+
+// The totals over the runs of one collector or uevent handler
+struct CostStats {
+    int64_t runs = 0;
+    int64_t total_wall_us = 0;
+    int64_t max_wall_us = 0;
+    int64_t total_cpu_us = 0;
+    int64_t max_cpu_us = 0;
+    int64_t read_bytes = 0;
+    int64_t atoms = 0;
+
+    void add(const Cost &cost);
+    // One line with the name, indented by two
+    void dump(int fd, const char *name) const;
+};
+
+// /proc/thread-self/io of the calling thread, whose rchar counts the bytes the
+// thread read. Invalid if the kernel has no task I/O accounting.
+android::base::unique_fd OpenThreadIo();
+
+/**
+ * Measures the cost of the calling thread from its construction to stop().
+ * io_fd is OpenThreadIo() of this thread, or -1 to leave read_bytes at -1.
+ * Two clock_gettime() calls, plus two reads of io_fd, per run.
+ */
+class CostMeter {
+  public:
+    explicit CostMeter(int io_fd);
+    Cost stop();
+
+  private:
+    const int io_fd_;
+    int64_t start_wall_us_;
+    int64_t start_cpu_us_;
+    int64_t start_read_bytes_;
+    int64_t start_atoms_;
+};
+
+/**
+ * The dumps written together to the cost dump file, by owner. An owner
+ * removes its dump before it goes away.
+ */
+void AddCostDump(const void *owner, std::function<void(int fd)> dump);
+void RemoveCostDump(const void *owner);
+// Replace the file at path with the memory of the process, then every dump
+// in the order they were added
+bool WriteCostDumps(const std::string &path);
+// Rss and Pss of the process from /proc/self/smaps_rollup, and its peak Rss
+void DumpProcessMemory(int fd);
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
+
+#endif  // HARDWARE_GOOGLE_PIXEL_PIXELSTATS_COSTACCOUNTING_H
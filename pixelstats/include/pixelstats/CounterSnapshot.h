@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_PIXELSTATS_COUNTERSNAPSHOT_H
+#define HARDWARE_GOOGLE_PIXEL_PIXELSTATS_COUNTERSNAPSHOT_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+/**
+ * The last sample of a fixed set of kernel counters, for reporters which
+ * upload how much each counter went up since their previous upload:
+ *
+ *   snapshot.begin();
+ *   snapshot.set(i, value);  // for each counter read, the others keep their value
+ *   if (snapshot.changed())
+ *       ... snapshot.delta(i) ...
+ *   snapshot.commit();
+ *
+ * changed() is false when no counter went up, so the reporter can skip
+ * building an atom which would only hold zeros. A counter lower than its
+ * previous value was reset, e.g. by a module reload, and counts from 0 again.
+ */
+template <size_t N>
+class CounterSnapshot {
+  public:
+    static constexpr size_t size() { return N; }
+
+    // Start a new sample from the previous one
+    void begin() {
+        current_ = previous_;
+        changed_ = false;
+    }
+    void set(size_t index, uint64_t value) {
+        current_[index] = value;
+        changed_ |= delta(index) != 0;
+    }
+    bool changed() const { return changed_; }
+
+    uint64_t delta(size_t index) const {
+        return current_[index] >= previous_[index] ? current_[index] - previous_[index]
+                                                   : current_[index];
+    }
+    // The delta clamped to an int32 atom field
+    int32_t intDelta(size_t index) const {
+        return static_cast<int32_t>(std::min<uint64_t>(delta(index), INT32_MAX));
+    }
+
+    // The current sample becomes the previous one
+    void commit() { previous_ = current_; }
+
+  private:
+    std::array<uint64_t, N> previous_ = {};
+    std::array<uint64_t, N> current_ = {};
+    bool changed_ = false;
+};
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
+
+#endif  // HARDWARE_GOOGLE_PIXEL_PIXELSTATS_COUNTERSNAPSHOT_H
@@ -19,8 +19,12 @@
 
 #include <aidl/android/frameworks/stats/IStats.h>
 #include <hardware/google/pixel/pixelstats/pixelatoms.pb.h>
+#include <pixelstats/CounterSnapshot.h>
+#include <pixelstats/SysfsReader.h>
 
+#include <iterator>
 #include <string>
+#include <vector>
 
 namespace android {
 namespace hardware {
@@ -47,75 +51,55 @@ class DisplayStatsReporter {
                          const display_stats_type stats_type);
 
   private:
-    bool readDisplayErrorCount(const std::string &path, int64_t *val);
+    bool readDisplayErrorCount(const std::string &path, uint64_t *val);
     // Proto messages are 1-indexed and VendorAtom field numbers start at 2, so
     // store everything in the values array at the index of the field number
     // -2.
     static constexpr int kVendorAtomOffset = 2;
-    static constexpr int kNumOfDisplayPanelErrorStats = 4;
 
-    int verifyCount(int val, bool *report_stats);
+    /*
+     * Read the counters of one atom, from the paths at the index of their field
+     * number -2. A counter which fails to read keeps its previous value.
+     * Returns false if no counter went up.
+     */
+    template <size_t N>
+    bool captureErrorCounts(const std::vector<std::string> &paths,
+                            const int64_t (&field_numbers)[N], CounterSnapshot<N> *snapshot);
+    // Report how much each counter went up since the previous report, if any did
+    template <size_t N>
+    void logErrorCounts(const std::shared_ptr<IStats> &stats_client, int32_t atom_id,
+                        const std::vector<std::string> &paths, const int64_t (&field_numbers)[N],
+                        CounterSnapshot<N> *snapshot);
+
+    SysfsReader sysfs_reader_;
 
     /* display state */
-    struct DisplayPanelErrorStats {
-        int64_t primary_error_count_te;
-        int64_t primary_error_count_unknown;
-        int64_t secondary_error_count_te;
-        int64_t secondary_error_count_unknown;
-    };
-    struct DisplayPanelErrorStats prev_panel_data_ = {};
-    void logDisplayPanelErrorStats(const std::shared_ptr<IStats> &stats_client,
-                                   const std::vector<std::string> &display_stats_paths);
-    bool captureDisplayPanelErrorStats(const std::vector<std::string> &display_stats_paths,
-                                       struct DisplayPanelErrorStats *cur_data);
+    static constexpr int64_t display_panel_error_path_index[] = {
+            PixelAtoms::DisplayPanelErrorStats::kPrimaryErrorCountTeFieldNumber,
+            PixelAtoms::DisplayPanelErrorStats::kPrimaryErrorCountUnknownFieldNumber,
+            PixelAtoms::DisplayPanelErrorStats::kSecondaryErrorCountTeFieldNumber,
+            PixelAtoms::DisplayPanelErrorStats::kSecondaryErrorCountUnknownFieldNumber};
+    CounterSnapshot<std::size(display_panel_error_path_index)> panel_counts_;
 
     /* displayport state */
-    enum display_port_error_stats_index {
-        LINK_NEGOTIATION_FAILURES = 0,
-        EDID_READ_FAILURES,
-        DPCD_READ_FAILURES,
-        EDID_INVALID_FAILURES,
-        SINK_COUNT_INVALID_FAILURES,
-        LINK_UNSTABLE_FAILURES,
-        DISPLAY_PORT_ERROR_STATS_SIZE,
-    };
-    static constexpr int64_t display_port_error_path_index[DISPLAY_PORT_ERROR_STATS_SIZE] = {
+    static constexpr int64_t display_port_error_path_index[] = {
             PixelAtoms::DisplayPortErrorStats::kLinkNegotiationFailuresFieldNumber,
             PixelAtoms::DisplayPortErrorStats::kEdidReadFailuresFieldNumber,
             PixelAtoms::DisplayPortErrorStats::kDpcdReadFailuresFieldNumber,
             PixelAtoms::DisplayPortErrorStats::kEdidInvalidFailuresFieldNumber,
             PixelAtoms::DisplayPortErrorStats::kSinkCountInvalidFailuresFieldNumber,
             PixelAtoms::DisplayPortErrorStats::kLinkUnstableFailuresFieldNumber};
-    int64_t prev_dp_data_[DISPLAY_PORT_ERROR_STATS_SIZE] = {0};
-
-    void logDisplayPortErrorStats(const std::shared_ptr<IStats> &stats_client,
-                                  const std::vector<std::string> &displayport_stats_paths);
-    bool captureDisplayPortErrorStats(const std::vector<std::string> &displayport_stats_paths,
-                                      int64_t *cur_data);
+    CounterSnapshot<std::size(display_port_error_path_index)> dp_counts_;
 
     /* HDCP state */
-    enum hdcp_auth_type_stats_index {
-        HDCP2_SUCCESS = 0,
-        HDCP2_FALLBACK,
-        HDCP2_FAIL,
-        HDCP1_SUCCESS,
-        HDCP1_FAIL,
-        HDCP0,
-        HDCP_AUTH_TYPE_STATS_SIZE,
-    };
-    static constexpr int64_t hdcp_auth_type_path_index[HDCP_AUTH_TYPE_STATS_SIZE] = {
+    static constexpr int64_t hdcp_auth_type_path_index[] = {
             PixelAtoms::HDCPAuthTypeStats::kHdcp2SuccessCountFieldNumber,
             PixelAtoms::HDCPAuthTypeStats::kHdcp2FallbackCountFieldNumber,
             PixelAtoms::HDCPAuthTypeStats::kHdcp2FailCountFieldNumber,
             PixelAtoms::HDCPAuthTypeStats::kHdcp1SuccessCountFieldNumber,
             PixelAtoms::HDCPAuthTypeStats::kHdcp1FailCountFieldNumber,
             PixelAtoms::HDCPAuthTypeStats::kHdcp0CountFieldNumber};
-    int64_t prev_hdcp_data_[HDCP_AUTH_TYPE_STATS_SIZE] = {0};
-
-    void logHDCPAuthTypeStats(const std::shared_ptr<IStats> &stats_client,
-                              const std::vector<std::string> &hdcp_stats_paths);
-    bool captureHDCPAuthTypeStats(const std::vector<std::string> &hdcp_stats_paths,
-                                  int64_t *cur_data);
+    CounterSnapshot<std::size(hdcp_auth_type_path_index)> hdcp_counts_;
 };
 
 }  // namespace pixel
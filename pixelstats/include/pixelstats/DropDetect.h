@@ -40,6 +40,8 @@ class DropDetect : public android::chre::SocketClient::ICallbacks,
 
   private:
     DropDetect(const uint64_t drop_detect_app_id);
+    // Handle a message of the DropDetect nanoapp, payload is not aligned
+    void handleDropMessage(uint32_t message_type, const uint8_t *payload, size_t size);
 
     const uint64_t kDropDetectAppId;
 };
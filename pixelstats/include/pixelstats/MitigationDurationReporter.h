@@ -63,7 +63,7 @@ class MitigationDurationReporter {
     // -2.
     const int kVendorAtomOffset = 2;
     const int kExpectedNumberOfLines = 33;
-    const std::string kGreaterThanTenMsSysfsNode = "/greater_than_10ms_count";
+    static constexpr const char *kGreaterThanTenMsSysfsNode = "/greater_than_10ms_count";
 
     void valueAssignmentHelper(std::vector<VendorAtomValue> *values, int *val, int fieldNumber);
 
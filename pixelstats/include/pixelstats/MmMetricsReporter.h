@@ -17,11 +17,18 @@
 #ifndef HARDWARE_GOOGLE_PIXEL_PIXELSTATS_MMMETRICSREPORTER_H
 #define HARDWARE_GOOGLE_PIXEL_PIXELSTATS_MMMETRICSREPORTER_H
 
+#include <array>
 #include <map>
 #include <string>
+#include <string_view>
 
 #include <aidl/android/frameworks/stats/IStats.h>
 #include <hardware/google/pixel/pixelstats/pixelatoms.pb.h>
+#include <pixelproctable/ProcessTable.h>
+#include <pixelstats/AtomBuilder.h>
+#include <pixelstats/PsiMonitor.h>
+#include <pixelstats/SysfsReader.h>
+#include <pixelstats/ZramTuner.h>
 
 namespace android {
 namespace hardware {
@@ -38,6 +45,8 @@ class MmMetricsReporter {
   public:
     MmMetricsReporter();
     void aggregatePixelMmMetricsPer5Min();
+    // Count pressure stall spikes with kernel PSI triggers between hourly atoms
+    void startPsiMonitor();
     void logPixelMmMetricsPerHour(const std::shared_ptr<IStats> &stats_client);
     void logPixelMmMetricsPerDay(const std::shared_ptr<IStats> &stats_client);
     void logCmaStatus(const std::shared_ptr<IStats> &stats_client);
@@ -65,6 +74,25 @@ class MmMetricsReporter {
         bool update_diff;
     };
 
+    /*
+     * A kernel thread whose stime is reported. A per node entry covers every
+     * thread named <name><node>, e.g. kswapd0 and kswapd1, and the stime of
+     * those threads adds up into the field.
+     */
+    struct KthreadStimeInfo {
+        std::string name;
+        bool per_node;
+        int atom_key;
+    };
+
+    // A thread matched by kKthreadStimeInfo
+    struct Kthread {
+        int pid;
+        std::string comm;
+        int atom_key;
+        uint64_t prev_stime;
+    };
+
     enum CmaType {
         FARAWIMG = 0,
         FAIMG = 1,
@@ -78,6 +106,7 @@ class MmMetricsReporter {
     static const std::vector<MmMetricsInfo> kMeminfoInfo;
     static const std::vector<MmMetricsInfo> kMmMetricsPerDayInfo;
     static const std::vector<ProcStatMetricsInfo> kProcStatInfo;
+    static const std::vector<KthreadStimeInfo> kKthreadStimeInfo;
     static const std::vector<MmMetricsInfo> kCmaStatusInfo;
     static const std::vector<MmMetricsInfo> kCmaStatusExtInfo;
 
@@ -132,18 +161,32 @@ class MmMetricsReporter {
     void fillDirectReclaimStatAtom(const std::vector<long> &store,
                                    std::vector<VendorAtomValue> *values);
     void readPressureStall(const std::string &basePath, std::vector<long> *store);
-    bool parsePressureStallFileContent(bool is_cpu, const std::string &lines,
+    // A pressure stall line: the category followed by one "name=value" per metric name
+    using PsiLineWords = std::array<std::string_view, kPsiNumNames + 1>;
+    bool parsePressureStallFileContent(bool is_cpu, std::string_view lines,
                                        std::vector<long> *store, int file_save_idx);
-    bool parsePressureStallWords(const std::vector<std::string> &words, std::vector<long> *store,
+    bool parsePressureStallWords(const PsiLineWords &words, std::vector<long> *store,
                                  int line_save_idx);
-    bool savePressureMetrics(const std::string &name, const std::string &value,
+    bool savePressureMetrics(std::string_view name, std::string_view value,
                              std::vector<long> *store, int base_save_idx);
     void fillPressureStallAtom(std::vector<VendorAtomValue> *values);
+    void fillPsiSpikeAtom(std::vector<VendorAtomValue> *values);
+    // persist.vendor.zram.autotune: off, recommend or apply
+    std::string getZramAutotuneMode();
+    void sampleZramTuner();
+    // Decide the zram size for the next boot, act on it and report it in the daily atom
+    void fillZramTuning(std::vector<VendorAtomValue> *values);
+    // Build the hourly atom in per_hour_atom_, false if there is none to report
+    bool buildPixelMmMetricsPerHour();
     void aggregatePressureStall();
-    std::map<std::string, uint64_t> readSysfsNameValue(const std::string &path);
+    bool readSysfsNameValue(const std::string &path, const SysfsNameValueTable &table,
+                            SysfsNameValues *values);
     std::map<std::string, std::vector<uint64_t>> readProcStat(const std::string &path);
     uint64_t getIonTotalPools();
     uint64_t getGpuMemory();
+    bool fillAtomValues(const std::vector<MmMetricsInfo> &metrics_info,
+                        const SysfsNameValues &mm_metrics, SysfsNameValues *prev_mm_metrics,
+                        std::vector<VendorAtomValue> *atom_values);
     bool fillAtomValues(const std::vector<MmMetricsInfo> &metrics_info,
                         const std::map<std::string, uint64_t> &mm_metrics,
                         std::map<std::string, uint64_t> *prev_mm_metrics,
@@ -154,12 +197,14 @@ class MmMetricsReporter {
                       const std::map<std::string, std::vector<uint64_t>> &cur_pstat,
                       std::map<std::string, std::vector<uint64_t>> *prev_pstat,
                       std::vector<VendorAtomValue> *atom_values);
-    virtual std::string getProcessStatPath(const std::string &name, int *prev_pid);
-    bool isValidProcessInfoPath(const std::string &path, const char *name);
-    int findPidByProcessName(const std::string &name);
-    int64_t getStimeByPathAndVerifyName(const std::string &path, const std::string &name);
-    void fillProcessStime(int atom_key, const std::string &name, int *pid, uint64_t *prev_stime,
-                          std::vector<VendorAtomValue> *atom_values);
+    // The pid and comm of each thread matched by kKthreadStimeInfo.
+    // For test: use derived class to return custom threads for test data injection.
+    virtual std::vector<std::pair<int, std::string>> findKthreads();
+    // For test: use derived class to return custom path for test data injection.
+    virtual std::string getKthreadStatPath(int pid, const std::string &comm);
+    const KthreadStimeInfo *matchKthread(std::string_view comm);
+    bool readKthreadStime(const Kthread &kthread, uint64_t *stime);
+    void fillKthreadStime(std::vector<VendorAtomValue> *atom_values);
     std::map<std::string, uint64_t> readCmaStat(const std::string &cma_type,
                                                 const std::vector<MmMetricsInfo> &metrics_info);
     void reportCmaStatusAtom(
@@ -179,6 +224,7 @@ class MmMetricsReporter {
     const char *const kPixelStatMm;
     const char *const kMeminfoPath;
     const char *const kProcStatPath;
+    const char *const kZramMmStatPath;
     // Proto messages are 1-indexed and VendorAtom field numbers start at 2, so
     // store everything in the values array at the index of the field number
     // -2.
@@ -186,22 +232,39 @@ class MmMetricsReporter {
     static constexpr int kNumCompactionDurationPrevMetrics = 6;
     static constexpr int kNumDirectReclaimPrevMetrics = 20;
 
+    // Keeps the PSI, vmstat, meminfo and pool size nodes open between samples
+    SysfsReader sysfs_reader_;
+    // The names of kMmMetricsPerHourInfo and kMmMetricsPerDayInfo, by index
+    const SysfsNameValueTable kPerHourTable;
+    const SysfsNameValueTable kPerDayTable;
+    // The swap counters sampled by zram_tuner_
+    const SysfsNameValueTable kZramMeminfoTable;
+    const SysfsNameValueTable kZramVmstatTable;
     std::vector<long> prev_compaction_duration_;
     std::vector<long> prev_direct_reclaim_;
     long prev_psi_total_[kPsiNumAllTotals];
     long psi_total_[kPsiNumAllTotals];
     long psi_aggregated_[kPsiNumAllUploadAvgMetrics];  // min, max and avg of original avgXXX
     int psi_data_set_count_ = 0;
-    std::map<std::string, uint64_t> prev_hour_vmstat_;
-    std::map<std::string, uint64_t> prev_day_vmstat_;
-    std::map<std::string, uint64_t> prev_day_pixel_vmstat_;
+    PsiMonitor psi_monitor_;
+    // The hourly atom and its samples, reused from one hour to the next
+    AtomBuilder<PixelAtoms::Atom::kPixelMmMetricsPerHour,
+                PixelAtoms::PixelMmMetricsPerHour::kPsiMemSomeSpikeMaxStallUsFieldNumber>
+            per_hour_atom_;
+    SysfsNameValues hour_vmstat_;
+    SysfsNameValues hour_meminfo_;
+    SysfsNameValues prev_hour_vmstat_;
+    SysfsNameValues prev_day_vmstat_;
+    SysfsNameValues prev_day_pixel_vmstat_;
     std::map<std::string, std::vector<uint64_t>> prev_procstat_;
     std::map<std::string, std::map<std::string, uint64_t>> prev_cma_stat_;
     std::map<std::string, std::map<std::string, uint64_t>> prev_cma_stat_ext_;
-    int prev_kswapd_pid_ = -1;
-    int prev_kcompactd_pid_ = -1;
-    uint64_t prev_kswapd_stime_ = 0;
-    uint64_t prev_kcompactd_stime_ = 0;
+    // Their /proc/<pid>/stat stay open in sysfs_reader_ until a read fails
+    // or finds another comm, which starts a new search in process_table_
+    std::vector<Kthread> kthreads_;
+    // Only walked on a search, reading the status of the pids it did not know
+    ProcessTable process_table_{"/proc", 0, false};
+    ZramTuner zram_tuner_;
     bool ker_mm_metrics_support_;
 };
 
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_PIXELSTATS_POWERSUPPLYUEVENT_H
+#define HARDWARE_GOOGLE_PIXEL_PIXELSTATS_POWERSUPPLYUEVENT_H
+
+#include <aidl/android/frameworks/stats/IStats.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+using aidl::android::frameworks::stats::IStats;
+
+/**
+ * The properties of one power_supply uevent, without their POWER_SUPPLY_
+ * prefix, e.g. {"STATUS", "Charging"}. The views point into the uevent
+ * message and are only valid while it is dispatched.
+ */
+struct PowerSupplyUevent {
+    std::vector<std::pair<std::string_view, std::string_view>> properties;
+
+    // The value of property, empty if the uevent does not have it
+    std::string_view get(std::string_view property) const;
+    // POWER_SUPPLY_NAME, e.g. "battery"
+    std::string_view name() const { return get("NAME"); }
+};
+
+/**
+ * Reporters which follow a power supply subscribe to its uevents here instead
+ * of reading its sysfs nodes on every uevent or on a timer. A subscription
+ * names the supply, empty for any, and the properties it reacts to: it gets
+ * the first uevent of the supply, then only those in which one of these
+ * properties has a different value than in the last uevent it got. With no
+ * properties it gets every uevent of the supply.
+ *
+ * Subscribe before uevents are dispatched; both run on the uevent thread.
+ */
+class PowerSupplySubscriptions {
+  public:
+    using Callback = std::function<void(const std::shared_ptr<IStats> &stats_client,
+                                        const PowerSupplyUevent &uevent)>;
+
+    void subscribe(const std::string &supply, const std::vector<std::string> &properties,
+                   Callback callback);
+    void dispatch(const std::shared_ptr<IStats> &stats_client, const PowerSupplyUevent &uevent);
+
+  private:
+    struct Subscription {
+        std::string supply;
+        std::vector<std::string> properties;
+        // Values of properties in the last uevent delivered
+        std::vector<std::string> last_values;
+        bool delivered = false;
+        Callback callback;
+    };
+
+    // Whether uevent changes a property of subscription, which then takes its values
+    static bool takeChanges(const PowerSupplyUevent &uevent, Subscription *subscription);
+
+    std::vector<Subscription> subscriptions_;
+};
+
+/**
+ * The supply of a sysfs path under /sys/class/power_supply/, e.g. "battery"
+ * for /sys/class/power_supply/battery/ssoc_details. Empty for another path.
+ */
+std::string PowerSupplyOfPath(std::string_view path);
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
+
+#endif  // HARDWARE_GOOGLE_PIXEL_PIXELSTATS_POWERSUPPLYUEVENT_H
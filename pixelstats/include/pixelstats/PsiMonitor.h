@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_PIXELSTATS_PSIMONITOR_H
+#define HARDWARE_GOOGLE_PIXEL_PIXELSTATS_PSIMONITOR_H
+
+#include <android-base/unique_fd.h>
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+/**
+ * Catches short pressure stall spikes which the 5 minute PSI sampling averages
+ * away. A kernel PSI trigger ("some <threshold us> <window us>") is armed on
+ * each of /proc/pressure/{cpu,io,memory} and a thread sleeps in epoll until the
+ * kernel signals a window whose stall went over the threshold.
+ *
+ * Consecutive signalled windows form one spike. Finished spikes are kept in a
+ * fixed size ring until collect() aggregates them; when the ring is full the
+ * new spike only adds to the count.
+ */
+class PsiMonitor {
+  public:
+    enum Resource { kCpu = 0, kIo = 1, kMemory = 2, kNumResources = 3 };
+
+    struct Aggregate {
+        int64_t spike_count = 0;
+        int64_t spike_duration_ms = 0;
+        // Highest stall seen in a single window
+        int64_t max_stall_us = 0;
+    };
+
+    static constexpr int64_t kThresholdUs = 150000;
+    static constexpr int64_t kWindowUs = 1000000;
+    // Kernels from 6.5 only take 2s multiple windows from unprivileged users,
+    // the trigger then falls back to the same stall ratio over 2s
+    static constexpr int64_t kFallbackWindowUs = 2000000;
+    static constexpr size_t kRingSize = 64;
+
+    PsiMonitor() = default;
+    ~PsiMonitor();
+    // Disallow copy and assign.
+    PsiMonitor(const PsiMonitor &) = delete;
+    void operator=(const PsiMonitor &) = delete;
+
+    /**
+     * Arm the triggers under base_path and start the monitor thread. Returns
+     * false, leaving the monitor stopped, if no trigger could be armed (e.g.
+     * the kernel lacks PSI triggers).
+     */
+    bool start(const std::string &base_path);
+    bool isRunning() const { return thread_.joinable(); }
+
+    // Aggregate the spikes finished since the last call and empty the ring
+    void collect(std::array<Aggregate, kNumResources> *aggregates);
+
+  private:
+    struct Spike {
+        Resource resource;
+        int64_t duration_ms;
+        int64_t max_stall_us;
+    };
+
+    // A spike still receiving events, used only by the monitor thread
+    struct OpenSpike {
+        bool active = false;
+        int64_t start_ms = 0;
+        int64_t last_event_ms = 0;
+        uint64_t last_total_us = 0;
+        int64_t max_stall_us = 0;
+    };
+
+    // Arm the trigger on one node, false if the kernel refused it
+    bool armTrigger(Resource resource, const std::string &path);
+    void monitorLoop();
+    void onTrigger(Resource resource, int64_t now_ms);
+    void closeSpike(Resource resource);
+    // The cumulative "some" stall of a resource, in us
+    bool readSomeTotal(Resource resource, uint64_t *total_us);
+
+    int64_t threshold_us_ = kThresholdUs;
+    int64_t window_us_ = kWindowUs;
+    android::base::unique_fd trigger_fds_[kNumResources];
+    android::base::unique_fd epoll_fd_;
+    android::base::unique_fd stop_fd_;
+    OpenSpike open_spikes_[kNumResources];
+
+    std::mutex lock_;
+    // Guarded by lock_
+    std::array<Spike, kRingSize> ring_;
+    size_t ring_count_ = 0;
+    int64_t overflow_count_[kNumResources] = {};
+
+    std::thread thread_;
+};
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
+
+#endif  // HARDWARE_GOOGLE_PIXEL_PIXELSTATS_PSIMONITOR_H
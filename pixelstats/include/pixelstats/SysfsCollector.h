@@ -19,17 +19,25 @@
 
 #include <aidl/android/frameworks/stats/IStats.h>
 #include <hardware/google/pixel/pixelstats/pixelatoms.pb.h>
+#include <pixelboottiming/BootPhaseTimer.h>
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #include "BatteryEEPROMReporter.h"
 #include "BatteryHealthReporter.h"
-#include "BatteryTTFReporter.h"
 #include "BrownoutDetectedReporter.h"
+#include "CostAccounting.h"
 #include "DisplayStatsReporter.h"
 #include "MitigationDurationReporter.h"
 #include "MitigationStatsReporter.h"
 #include "MmMetricsReporter.h"
 #include "TempResidencyReporter.h"
 #include "ThermalStatsReporter.h"
+#include "UnchangedAtomFilter.h"
 
 namespace android {
 namespace hardware {
@@ -98,23 +106,70 @@ class SysfsCollector {
         const std::vector<std::string> FGModelLoadingPath;
         const std::vector<std::string> FGLogBufferPath;
         const char *const SpeakerVersionPath;
+        // Where to keep the digests of the atoms that are reported only when they change,
+        // e.g. under /data/vendor. Unset keeps them in memory only.
+        const char *const AtomSnapshotPath;
+        // Where to keep how far the battery histories were reported. Unset reports the
+        // whole histories again after a restart.
+        const char *const BatteryHistoryCursorPath;
+        // Where to write the cost of the collectors and uevent handlers every hour,
+        // e.g. under /data/vendor. Unset writes none.
+        const char *const CostDumpPath;
+        // Where libpixelhealth keeps the battery samples before a shutdown, to be
+        // logged on the next boot. Unset logs none.
+        const char *const ShutdownSamplesPath;
     };
 
     SysfsCollector(const struct SysfsPaths &paths);
+    ~SysfsCollector();
     void collect();
+    // Write the period, slot and run costs of each collector to fd
+    void dump(int fd);
 
   private:
+    using CollectFunc = std::function<void(const std::shared_ptr<IStats> &)>;
+    struct Collector {
+        const char *name;
+        // Run once every period_wakes wakes of the collect loop, at wake slot of the period
+        int period_wakes;
+        int slot;
+        int64_t next_wake;
+        // Estimated duration, used to spread collectors over their period
+        int estimated_cost_ms;
+        // Collectors with the same non-empty tag share state or a bus, so they run one
+        // after another in registration order
+        const char *tag;
+        CollectFunc func;
+        // Set for collectors of absolute counters: an atom equal to the last one reported at
+        // the same place is dropped. Points into atom_snapshots_.
+        UnchangedAtomFilter::Snapshot *snapshot;
+        // The boot collection runs the collector once this node exists, e.g. a node its
+        // driver creates when it probes. Null or empty for none.
+        const char *ready_path;
+        // Guarded by collector_stats_lock_
+        int64_t last_duration_ms;
+        CostStats cost;
+        int64_t suppressed_count;
+    };
+
     bool ReadFileToInt(const std::string &path, int *val);
     bool ReadFileToInt(const char *path, int *val);
     void aggregatePer5Min();
     void logOnce();
     void logBrownout();
-    void logPerDay();
-    void logPerHour();
+    void registerCollectors();
+    void addCollector(const char *name, int period_wakes, int estimated_cost_ms, const char *tag,
+                      CollectFunc func, bool report_changed_only = false,
+                      const char *ready_path = nullptr);
+    void assignCollectorSlots();
+    // Run the collectors on up to kCollectorWorkers threads and wait for them
+    void runCollectors(const std::vector<Collector *> &collectors);
+    // Run the collectors group by group, pausing in between
+    void runCollectorsStaggered(const std::vector<Collector *> &collectors);
+    void collectOnBoot(BootPhaseTimer *boot_timer);
 
     void logBatteryChargeCycles(const std::shared_ptr<IStats> &stats_client);
     void logBatteryHealth(const std::shared_ptr<IStats> &stats_client);
-    void logBatteryTTF(const std::shared_ptr<IStats> &stats_client);
     void logBlockStatsReported(const std::shared_ptr<IStats> &stats_client);
     void logCodecFailed(const std::shared_ptr<IStats> &stats_client);
     void logCodec1Failed(const std::shared_ptr<IStats> &stats_client);
@@ -215,6 +270,10 @@ class SysfsCollector {
     const std::vector<std::string> kFGModelLoadingPath;
     const std::vector<std::string> kFGLogBufferPath;
     const char *const kSpeakerVersionPath;
+    const char *const kAtomSnapshotPath;
+    const char *const kBatteryHistoryCursorPath;
+    const char *const kCostDumpPath;
+    const char *const kShutdownSamplesPath;
 
     BatteryEEPROMReporter battery_EEPROM_reporter_;
     MmMetricsReporter mm_metrics_reporter_;
@@ -224,12 +283,16 @@ class SysfsCollector {
     ThermalStatsReporter thermal_stats_reporter_;
     DisplayStatsReporter display_stats_reporter_;
     BatteryHealthReporter battery_health_reporter_;
-    BatteryTTFReporter battery_time_to_full_reporter_;
     TempResidencyReporter temp_residency_reporter_;
     // Proto messages are 1-indexed and VendorAtom field numbers start at 2, so
     // store everything in the values array at the index of the field number    // -2.
     const int kVendorAtomOffset = 2;
 
+    std::vector<Collector> collectors_;
+    std::mutex collector_stats_lock_;
+    // By collector name, one entry per collector reporting only changed atoms
+    std::map<std::string, UnchangedAtomFilter::Snapshot> atom_snapshots_;
+
     bool log_once_reported = false;
     int64_t prev_huge_pages_since_boot_ = -1;
 
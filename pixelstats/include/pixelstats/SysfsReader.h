@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_PIXELSTATS_SYSFSREADER_H
+#define HARDWARE_GOOGLE_PIXEL_PIXELSTATS_SYSFSREADER_H
+
+#include <android-base/unique_fd.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+/**
+ * Reads small sysfs and procfs nodes which are sampled over and over.
+ * The fd of each node stays open between reads and the node is re-read with
+ * pread() at offset 0 into a fixed buffer, so a sample costs one syscall and
+ * no allocation. The fd of a node which fails to read is closed, and opened
+ * again on the next read.
+ *
+ * Not thread safe, each reporter keeps its own reader.
+ */
+class SysfsReader {
+  public:
+    // Big enough for /proc/vmstat
+    static constexpr size_t kBufferSize = 16 * 1024;
+    // Nodes kept open at once, all are closed when one more is needed
+    static constexpr size_t kMaxOpenNodes = 64;
+
+    SysfsReader() = default;
+    // Disallow copy and assign.
+    SysfsReader(const SysfsReader &) = delete;
+    void operator=(const SysfsReader &) = delete;
+
+    /**
+     * Read the whole node into the reader's buffer. content stays valid until
+     * the next read through this reader. On failure errno is left as set by
+     * the failing call.
+     */
+    bool read(const std::string &path, std::string_view *content);
+    // Read a node holding a single number, surrounding whitespace is ignored
+    bool readUint(const std::string &path, uint64_t *value);
+    bool readInt(const std::string &path, int64_t *value);
+    void evict(const std::string &path) { fds_.erase(path); }
+
+  private:
+    std::unordered_map<std::string, android::base::unique_fd> fds_;
+    char buffer_[kBufferSize];
+};
+
+// Values of a name/value node, stored at the index of each name in its SysfsNameValueTable
+struct SysfsNameValues {
+    std::vector<uint64_t> values;
+    std::vector<bool> present;
+    // Set by a successful parse of a non-empty node
+    bool valid = false;
+
+    bool empty() const { return !valid; }
+    void clear();
+};
+
+/**
+ * The names wanted from a name/value node such as /proc/vmstat or
+ * /proc/meminfo, indexed once at construction. parse() goes over the node
+ * content in a single pass and stores the value of each wanted name at its
+ * index, other lines are only checked for being well formed.
+ */
+class SysfsNameValueTable {
+  public:
+    explicit SysfsNameValueTable(const std::vector<std::string> &names);
+    // Disallow copy and assign, the index points into names_.
+    SysfsNameValueTable(const SysfsNameValueTable &) = delete;
+    void operator=(const SysfsNameValueTable &) = delete;
+
+    size_t size() const { return names_.size(); }
+    /**
+     * Lines are "<name>[:] <value> [unit]". Returns false, with values
+     * cleared, if a line is malformed; *bad_line is set to its 1-based number.
+     * Empty content parses fine but leaves values empty().
+     */
+    bool parse(std::string_view content, SysfsNameValues *values, int *bad_line) const;
+
+  private:
+    const std::vector<std::string> names_;
+    std::unordered_map<std::string_view, size_t> index_;
+};
+
+// Number parsing for sysfs content, without std::string temporaries.
+// Surrounding whitespace is ignored, anything else makes the parse fail.
+bool ParseSysfsUint(std::string_view text, uint64_t *value);
+bool ParseSysfsInt(std::string_view text, int64_t *value);
+// Parse a non-negative decimal such as "2.93" in hundredths, rounded, e.g. 293
+bool ParseSysfsCentis(std::string_view text, int64_t *value);
+// Split the next token off text at any of delims, skipping leading delims.
+// Returns an empty view once text has no token left.
+std::string_view NextSysfsToken(std::string_view *text, std::string_view delims);
+// Scan the next int of a fixed format line as sscanf() does for "<separator>%d":
+// text must start with separator, unless it is ' ', then the value may have
+// leading whitespace and a sign. On success the value is taken off text.
+// A value out of the int32 range does not scan.
+bool ScanSysfsInt(std::string_view *text, char separator, int32_t *value);
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
+
+#endif  // HARDWARE_GOOGLE_PIXEL_PIXELSTATS_SYSFSREADER_H
@@ -19,6 +19,8 @@
 #include <hardware/google/pixel/pixelstats/pixelatoms.pb.h>
 
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace android {
 namespace hardware {
@@ -26,9 +28,11 @@ namespace google {
 namespace pixel {
 
 using aidl::android::frameworks::stats::IStats;
+using aidl::android::frameworks::stats::VendorAtom;
 using aidl::android::frameworks::stats::VendorAtomValue;
 
 struct TempResidencyStats {
+    std::string sensor_name;
     std::vector<int64_t> temp_residency_buckets;
     float max_temp, min_temp;
     int64_t max_temp_timestamp, min_temp_timestamp;
@@ -44,9 +48,25 @@ class TempResidencyReporter {
                                std::string_view temperature_residency_reset_path);
 
   private:
+    friend class PixelstatsParserBenchmark;
+
+    bool parseResidency(std::string_view content);
+    void reportResidency(const std::shared_ptr<IStats> &stats_client,
+                         std::string_view temperature_residency_path,
+                         std::string_view temperature_residency_reset_path);
+
     ::android::base::boot_clock::time_point prevTime =
             ::android::base::boot_clock::time_point::min();
     const int kMaxBucketLen = 20;
+
+    // Storage of one collection, released once it is reported as the
+    // collection runs once a day.
+    // The first num_stats_ entries hold the sensors of the last parse
+    std::vector<TempResidencyStats> stats_;
+    size_t num_stats_ = 0;
+    // Indices into stats_ in sensor name order, one per name
+    std::vector<size_t> report_order_;
+    VendorAtom event_;
 };
 
 }  // namespace pixel
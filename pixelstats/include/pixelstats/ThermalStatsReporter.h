@@ -19,8 +19,12 @@
 
 #include <aidl/android/frameworks/stats/IStats.h>
 #include <hardware/google/pixel/pixelstats/pixelatoms.pb.h>
+#include <pixelstats/CounterSnapshot.h>
+#include <pixelstats/SysfsReader.h>
 
+#include <iterator>
 #include <string>
+#include <vector>
 
 namespace android {
 namespace hardware {
@@ -40,27 +44,27 @@ class ThermalStatsReporter {
                          const std::vector<std::string> &thermal_stats_paths);
 
   private:
-    struct ThermalDfsCounts {
-        int64_t big_count;
-        int64_t mid_count;
-        int64_t little_count;
-        int64_t gpu_count;
-        int64_t tpu_count;
-        int64_t aur_count;
-    };
-
     // Proto messages are 1-indexed and VendorAtom field numbers start at 2, so
     // store everything in the values array at the index of the field number
     // -2.
-    const int kVendorAtomOffset = 2;
-    const int kNumOfThermalDfsStats = 6;
-    struct ThermalDfsCounts prev_data;
+    static constexpr int kVendorAtomOffset = 2;
+    static constexpr int64_t kThermalDfsFieldNumbers[] = {
+            PixelAtoms::ThermalDfsStats::kBigDfsCountFieldNumber,
+            PixelAtoms::ThermalDfsStats::kMidDfsCountFieldNumber,
+            PixelAtoms::ThermalDfsStats::kLittleDfsCountFieldNumber,
+            PixelAtoms::ThermalDfsStats::kGpuDfsCountFieldNumber,
+            PixelAtoms::ThermalDfsStats::kTpuDfsCountFieldNumber,
+            PixelAtoms::ThermalDfsStats::kAurDfsCountFieldNumber};
+    static constexpr int kNumOfThermalDfsStats = std::size(kThermalDfsFieldNumbers);
+
+    SysfsReader sysfs_reader_;
+    // The DFS counts, in the order of kThermalDfsFieldNumbers
+    CounterSnapshot<kNumOfThermalDfsStats> dfs_counts_;
 
     void logThermalDfsStats(const std::shared_ptr<IStats> &stats_client,
                             const std::vector<std::string> &thermal_stats_paths);
-    bool captureThermalDfsStats(const std::vector<std::string> &thermal_stats_paths,
-                                struct ThermalDfsCounts *cur_data);
-    bool readDfsCount(const std::string &path, int64_t *val);
+    bool captureThermalDfsStats(const std::vector<std::string> &thermal_stats_paths);
+    bool readDfsCount(const std::string &path, uint64_t *val);
 };
 
 }  // namespace pixel
@@ -20,8 +20,20 @@
 #include <aidl/android/frameworks/stats/IStats.h>
 #include <android-base/chrono_utils.h>
 #include <pixelstats/BatteryCapacityReporter.h>
-#include <pixelstats/ChargeStatsReporter.h>
 #include <pixelstats/BatteryFGReporter.h>
+#include <pixelstats/BatteryTTFReporter.h>
+#include <pixelstats/ChargeStatsReporter.h>
+#include <pixelstats/CostAccounting.h>
+#include <linux/filter.h>
+#include <pixelstats/PowerSupplyUevent.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace android {
 namespace hardware {
@@ -33,7 +45,7 @@ using aidl::android::frameworks::stats::IStats;
  * A class to listen for uevents and report reliability events to
  * the PixelStats HAL.
  * Runs in a background thread if created with ListenForeverInNewThread().
- * Alternatively, process one message at a time with ProcessUevent().
+ * Alternatively, process the pending messages with ProcessUevent().
  */
 class UeventListener {
   public:
@@ -70,11 +82,28 @@ class UeventListener {
                    const std::string fw_update_path = "",
                    const std::vector<std::string> fg_abnl_path = {""});
     UeventListener(const struct UeventPaths &paths);
+    ~UeventListener();
 
-    bool ProcessUevent();  // Process a single Uevent.
+    bool ProcessUevent();  // Process the next batch of Uevents.
     void ListenForever();  // Process Uevents forever
+    // Get the power_supply uevents of supply, see PowerSupplySubscriptions.
+    // Call before listening.
+    void SubscribePowerSupply(const std::string &supply,
+                              const std::vector<std::string> &properties,
+                              PowerSupplySubscriptions::Callback callback);
+    // Per subsystem uevent counts and handling costs, wakes and socket overflows
+    void dump(int fd);
+    // The socket filter that drops the uevents of ignored subsystems, see AttachUeventFilter()
+    static std::vector<sock_filter> BuildUeventFilter();
 
   private:
+    friend class PixelstatsParserBenchmark;
+
+    void AttachUeventFilter();
+    void SubscribeBatteryReporters();
+    void HandleUevent(char *msg);
+    void CountUevent(const char *subsystem);
+    void AddUeventCost(const char *subsystem, const Cost &cost);
     bool ReadFileToInt(const std::string &path, int *val);
     bool ReadFileToInt(const char *path, int *val);
     void ReportMicStatusUevents(const std::shared_ptr<IStats> &stats_client, const char *devpath,
@@ -89,8 +118,6 @@ class UeventListener {
     void ReportVoltageTierStats(const std::shared_ptr<IStats> &stats_client, const char *line,
                                 const bool has_wireless, const std::string wfile_contents);
     void ReportChargeMetricsEvent(const std::shared_ptr<IStats> &stats_client, const char *driver);
-    void ReportBatteryCapacityFGEvent(const std::shared_ptr<IStats> &stats_client,
-                                      const char *subsystem);
     void ReportTypeCPartnerId(const std::shared_ptr<IStats> &stats_client);
     void ReportGpuEvent(const std::shared_ptr<IStats> &stats_client, const char *driver,
                         const char *gpu_event_type, const char *gpu_event_info);
@@ -104,6 +131,8 @@ class UeventListener {
     const std::string kUsbPortOverheatPath;
     const std::string kChargeMetricsPath;
     const std::string kTypeCPartnerUevent;
+    // A custom partner uevent key might come with a subsystem that is otherwise ignored
+    const bool kRejectIgnoredSubsystems = kTypeCPartnerUevent == typec_partner_uevent_default;
     const std::string kTypeCPartnerVidPath;
     const std::string kTypeCPartnerPidPath;
     const std::string kFwUpdatePath;
@@ -193,6 +222,11 @@ class UeventListener {
     BatteryCapacityReporter battery_capacity_reporter_;
     ChargeStatsReporter charge_stats_reporter_;
     BatteryFGReporter battery_fg_reporter_;
+    BatteryTTFReporter battery_ttf_reporter_;
+
+    PowerSupplySubscriptions power_supply_subscriptions_;
+    // The power_supply properties of the uevent being handled, reused
+    PowerSupplyUevent power_supply_uevent_;
 
     // Proto messages are 1-indexed and VendorAtom field numbers start at 2, so
     // store everything in the values array at the index of the field number
@@ -201,6 +235,21 @@ class UeventListener {
 
     int uevent_fd_;
     int log_fd_;
+    // Receive buffers for recvmmsg(), allocated on first use
+    std::shared_ptr<struct UeventBatch> uevent_batch_;
+    // /proc/thread-self/io of the uevent thread, opened on first use
+    android::base::unique_fd thread_io_fd_;
+    bool thread_io_opened_ = false;
+
+    std::mutex stats_lock_;
+    // Guarded by stats_lock_
+    std::map<std::string, int64_t, std::less<>> subsystem_counts_;
+    // Cost of the uevents handled, by subsystem; dropped uevents are not metered
+    std::map<std::string, CostStats, std::less<>> subsystem_costs_;
+    int64_t uevent_count_ = 0;
+    int64_t wake_count_ = 0;
+    int64_t overflow_count_ = 0;
+    int max_batch_size_ = 0;
 };
 
 }  // namespace pixel
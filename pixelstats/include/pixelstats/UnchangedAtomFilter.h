@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_PIXELSTATS_UNCHANGEDATOMFILTER_H
+#define HARDWARE_GOOGLE_PIXEL_PIXELSTATS_UNCHANGEDATOMFILTER_H
+
+#include <aidl/android/frameworks/stats/BnStats.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+using aidl::android::frameworks::stats::BnStats;
+using aidl::android::frameworks::stats::IStats;
+using aidl::android::frameworks::stats::VendorAtom;
+
+/**
+ * An IStats handed to a collector which reports absolute counters. It drops an
+ * atom equal to the one the collector reported at the same place last time:
+ * the same atom id, and the same position among the atoms of that id reported
+ * in one run. Other atoms are forwarded to stats_client, and the snapshot
+ * keeps a digest of the last forwarded one.
+ */
+class UnchangedAtomFilter : public BnStats {
+  public:
+    // Atom digest by atom id and position in the run
+    using Snapshot = std::map<std::pair<int32_t, int32_t>, uint64_t>;
+
+    UnchangedAtomFilter(std::shared_ptr<IStats> stats_client, Snapshot *snapshot);
+
+    ndk::ScopedAStatus reportVendorAtom(const VendorAtom &vendor_atom) override;
+
+    int64_t suppressedCount() const { return suppressed_count_; }
+    bool snapshotChanged() const { return snapshot_changed_; }
+
+  private:
+    const std::shared_ptr<IStats> stats_client_;
+    Snapshot *const snapshot_;
+    std::map<int32_t, int32_t> atoms_of_id_;
+    int64_t suppressed_count_ = 0;
+    bool snapshot_changed_ = false;
+};
+
+/**
+ * Snapshots by collector name, kept in a text file so that an unchanged
+ * counter is not reported again after a restart. Each line is
+ *   <collector> <atom id> <position> <digest>
+ */
+bool LoadAtomSnapshots(const std::string &path,
+                       std::map<std::string, UnchangedAtomFilter::Snapshot> *snapshots);
+bool SaveAtomSnapshots(const std::string &path,
+                       const std::map<std::string, UnchangedAtomFilter::Snapshot> &snapshots);
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
+
+#endif  // HARDWARE_GOOGLE_PIXEL_PIXELSTATS_UNCHANGEDATOMFILTER_H
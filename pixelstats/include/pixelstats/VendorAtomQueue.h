@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_PIXELSTATS_VENDORATOMQUEUE_H
+#define HARDWARE_GOOGLE_PIXEL_PIXELSTATS_VENDORATOMQUEUE_H
+
+#include <aidl/android/frameworks/stats/BnStats.h>
+#include <android/binder_auto_utils.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+using aidl::android::frameworks::stats::BnStats;
+using aidl::android::frameworks::stats::IStats;
+using aidl::android::frameworks::stats::VendorAtom;
+
+/**
+ * A local IStats which queues the reported atoms and forwards them to the
+ * Stats service from its own thread. Reporters keep building atoms with the
+ * StatsHelper functions and calling reportVendorAtom() on the client they are
+ * given; handing them this one means a burst of atoms costs a few queue
+ * pushes instead of one binder transaction each, and a slow or restarting
+ * Stats service only holds up the sender thread.
+ *
+ * The queue is bounded, in total and per atom id so that one chatty atom
+ * cannot crowd the others out: an atom over either bound is dropped and
+ * reportVendorAtom() fails, so the reporter logs it as before. The queue owns
+ * the connection to the service and drops it when the service dies; atoms
+ * whose transaction fails are retried once on a fresh connection.
+ */
+class VendorAtomQueue : public BnStats {
+  public:
+    static constexpr size_t kMaxQueuedAtoms = 512;
+    static constexpr size_t kMaxQueuedPerAtomId = 256;
+
+    VendorAtomQueue();
+    ~VendorAtomQueue();
+
+    ndk::ScopedAStatus reportVendorAtom(const VendorAtom &vendor_atom) override;
+    /**
+     * Queue an atom for sending, without waiting on the Stats service.
+     * Returns false if the atom was dropped as the queue is full.
+     */
+    bool enqueue(VendorAtom vendor_atom);
+    void dump(int fd);
+
+  private:
+    struct QueuedAtom {
+        VendorAtom atom;
+        std::chrono::steady_clock::time_point queued_time;
+    };
+
+    void senderLoop();
+    // Returns false if the Stats service could not be reached at all
+    bool sendBatch(std::deque<QueuedAtom> *batch);
+    bool connect();
+    static void onStatsServiceDied(void *cookie);
+
+    std::mutex lock_;
+    std::condition_variable cv_;
+    std::deque<QueuedAtom> queue_;
+    // Atoms of each id in queue_ or in the batch being sent
+    std::map<int32_t, size_t> pending_per_atom_id_;
+    bool stop_ = false;
+
+    // Used only by the sender thread
+    std::shared_ptr<IStats> stats_client_;
+    ndk::ScopedAIBinder_DeathRecipient death_recipient_;
+    // Set from a binder thread
+    std::atomic<bool> service_died_ = false;
+
+    // Guarded by lock_
+    int64_t queued_count_ = 0;
+    int64_t sent_count_ = 0;
+    int64_t batch_count_ = 0;
+    int64_t dropped_full_count_ = 0;
+    int64_t dropped_quota_count_ = 0;
+    int64_t dropped_failed_count_ = 0;
+    int64_t reconnect_count_ = 0;
+    int64_t death_count_ = 0;
+    size_t max_queue_size_ = 0;
+    // From enqueue() to the end of the transaction of the sent atoms
+    int64_t total_latency_ms_ = 0;
+    int64_t max_latency_ms_ = 0;
+
+    std::thread sender_thread_;
+};
+
+// The process wide queue, as a client the reporters can report through
+std::shared_ptr<VendorAtomQueue> getVendorAtomQueue();
+// Atoms the calling thread queued so far, to count what a collector reports
+int64_t ThreadQueuedAtomCount();
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
+
+#endif  // HARDWARE_GOOGLE_PIXEL_PIXELSTATS_VENDORATOMQUEUE_H
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_PIXELSTATS_ZRAMTUNER_H
+#define HARDWARE_GOOGLE_PIXEL_PIXELSTATS_ZRAMTUNER_H
+
+#include <hardware/google/pixel/pixelstats/pixelatoms.pb.h>
+
+#include <cstdint>
+#include <string>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+using android::hardware::google::pixel::PixelAtoms::PixelMmMetricsPerDay;
+
+/**
+ * Picks the zram size for the next boot from how swap behaved over a day.
+ *
+ * The sizes are the fstab.zram.<size> variants init can swap on, ordered
+ * from smallest to largest in a ladder such as "40p,50p,60p". A day ending
+ * with swap nearly full while memory pressure or anon refaults were high,
+ * and with pages compressing well enough that more zram pays off, moves one
+ * step up the ladder. A day with swap mostly empty and no pressure moves one
+ * step down, giving the zram metadata and backing space back. Ladder entries
+ * may differ in backing device size (e.g. 50p-1g), which sizes writeback the
+ * same way.
+ *
+ * The tuner only keeps the counters; the caller reads the nodes, feeds a
+ * sample every few minutes and asks for a decision once a day.
+ */
+class ZramTuner {
+  public:
+    struct Sample {
+        // From /sys/block/zram0/mm_stat, in bytes
+        uint64_t orig_data_size = 0;
+        uint64_t compr_data_size = 0;
+        // From /proc/meminfo, in kB
+        uint64_t swap_total_kb = 0;
+        uint64_t swap_free_kb = 0;
+        // Cumulative workingset_refault_anon from /proc/vmstat, in pages
+        uint64_t refault_anon = 0;
+        // Cumulative "some" stall of /proc/pressure/memory, in us
+        uint64_t memory_some_us = 0;
+        // Monotonic time of the sample, which like PSI stops in suspend
+        int64_t time_ms = 0;
+    };
+
+    struct Decision {
+        PixelMmMetricsPerDay::ZramSizeAction action = PixelMmMetricsPerDay::ZRAM_SIZE_NONE;
+        // The ladder entry to use next boot, empty for ZRAM_SIZE_NONE
+        std::string size;
+        // Over the window: latest orig/compr ratio, highest swap use, share of
+        // time stalled on memory and anon refault rate
+        int64_t compression_ratio_pct = 0;
+        int64_t peak_swap_used_pct = 0;
+        int64_t memory_pressure_permille = 0;
+        int64_t refault_anon_per_hour = 0;
+    };
+
+    // Half a day of 5 minute samples, fewer make no decision
+    static constexpr size_t kMinSamples = 12 * 12;
+
+    static constexpr int64_t kGrowMinPeakSwapUsedPct = 90;
+    static constexpr int64_t kGrowMinCompressionRatioPct = 200;
+    static constexpr int64_t kGrowMinPressurePermille = 10;
+    // 100MB of 4kB pages an hour
+    static constexpr int64_t kGrowMinRefaultAnonPerHour = 25600;
+    static constexpr int64_t kShrinkMaxPeakSwapUsedPct = 50;
+    static constexpr int64_t kShrinkMaxPressurePermille = 2;
+    static constexpr int64_t kShrinkMaxRefaultAnonPerHour = 2560;
+
+    ZramTuner() = default;
+    // Disallow copy and assign.
+    ZramTuner(const ZramTuner &) = delete;
+    void operator=(const ZramTuner &) = delete;
+
+    void addSample(const Sample &sample);
+    size_t sampleCount() const { return sample_count_; }
+
+    /**
+     * Decide from the samples since the last call and start a new window from
+     * the latest sample. current_size is the vendor.zram.size in use and
+     * ladder the comma separated sizes; a size missing from the ladder or too
+     * few samples give ZRAM_SIZE_NONE.
+     */
+    Decision decide(const std::string &current_size, const std::string &ladder);
+
+  private:
+    // The first sample of the window, deltas are taken against it
+    Sample first_;
+    Sample last_;
+    bool started_ = false;
+    size_t sample_count_ = 0;
+    int64_t peak_swap_used_pct_ = 0;
+};
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
+
+#endif  // HARDWARE_GOOGLE_PIXEL_PIXELSTATS_ZRAMTUNER_H
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs the text parsers of pixelstats over the inputs in data/, one parse per
+ * benchmark iteration, so the reported time is ns/parse. The allocs/parse
+ * counter comes from the global operator new of this binary.
+ *
+ *   pixelstats_parser_benchmark [--data_dir=<dir>] [benchmark flags]
+ *
+ * The inputs default to the data/ directory installed next to the binary.
+ * Atoms reported by the parsers go to a sink which drops them.
+ */
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
+#include <benchmark/benchmark.h>
+#include <pixelstats/BatteryEEPROMReporter.h>
+#include <pixelstats/BatteryTTFReporter.h>
+#include <pixelstats/BrownoutDetectedReporter.h>
+#include <pixelstats/ChargeStatsReporter.h>
+#include <pixelstats/TempResidencyReporter.h>
+#include <pixelstats/UeventListener.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::atomic<int64_t> allocation_count = 0;
+
+}  // namespace
+
+void *operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    void *ptr = malloc(size ? size : 1);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+using aidl::android::frameworks::stats::BnStats;
+using aidl::android::frameworks::stats::VendorAtom;
+
+namespace {
+
+std::string data_dir;
+
+class NullStats : public BnStats {
+  public:
+    ndk::ScopedAStatus reportVendorAtom(const VendorAtom &) override {
+        return ndk::ScopedAStatus::ok();
+    }
+};
+
+std::string readInput(const std::string &name) {
+    std::string content;
+    if (!android::base::ReadFileToString(data_dir + "/" + name, &content)) {
+        std::cerr << "Unable to read " << data_dir << "/" << name << std::endl;
+        exit(1);
+    }
+    return content;
+}
+
+std::vector<std::string> readLines(const std::string &name) {
+    std::vector<std::string> lines = android::base::Split(readInput(name), "\n");
+    if (!lines.empty() && lines.back().empty())
+        lines.pop_back();
+    return lines;
+}
+
+// Counts the allocations made between construction and finish()
+class AllocationCounter {
+  public:
+    AllocationCounter() : start_(allocation_count.load()) {}
+    void finish(benchmark::State &state) {
+        state.counters["allocs/parse"] = benchmark::Counter(
+                static_cast<double>(allocation_count.load() - start_),
+                benchmark::Counter::kAvgIterations);
+    }
+
+  private:
+    const int64_t start_;
+};
+
+}  // namespace
+
+// Reaches the line parsers of the reporters, which are private
+class PixelstatsParserBenchmark {
+  public:
+    static void uevent(UeventListener *listener, char *msg) { listener->HandleUevent(msg); }
+
+    static void lastmeal(BrownoutDetectedReporter *reporter, const std::string &content) {
+        BrownoutDetectedReporter::BrownoutDetectedInfo info = {};
+        bool already_updated = false;
+        reporter->parseBrownoutLog(content, &info, &already_updated);
+        benchmark::DoNotOptimize(info);
+    }
+
+    static void ttfLine(BatteryTTFReporter *reporter, const std::shared_ptr<IStats> &stats_client,
+                        const std::string &line) {
+        reporter->reportBatteryTTFStatsEvent(stats_client, line.c_str());
+    }
+
+    static void chargeStats(ChargeStatsReporter *reporter,
+                            const std::shared_ptr<IStats> &stats_client,
+                            const std::vector<std::string> &lines) {
+        reporter->ReportChargeStats(stats_client, lines[0], "", "", "");
+        for (size_t i = 1; i < lines.size(); ++i)
+            reporter->ReportVoltageTierStats(stats_client, lines[i].c_str(), false, "");
+    }
+
+    static void tempResidency(TempResidencyReporter *reporter, const std::string &content) {
+        benchmark::DoNotOptimize(reporter->parseResidency(content));
+    }
+};
+
+namespace {
+
+// One uevent per parse, as recvmmsg() hands them over: NUL separated strings
+// ending with an empty one
+void BM_Uevent(benchmark::State &state) {
+    // The data file has one string per line and a blank line after each uevent
+    std::vector<std::string> uevents(1);
+    for (const auto &line : readLines("uevents")) {
+        if (line.empty()) {
+            uevents.emplace_back();
+            continue;
+        }
+        uevents.back().append(line).push_back('\0');
+    }
+    // No paths, so the reporting of a matched uevent fails fast
+    UeventListener listener("", "", "", "", "", "", "", {""});
+
+    std::vector<char> buffer(4096);
+    size_t i = 0;
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        const std::string &msg = uevents[i++ % uevents.size()];
+        memcpy(buffer.data(), msg.c_str(), msg.size() + 1);
+        PixelstatsParserBenchmark::uevent(&listener, buffer.data());
+    }
+    allocations.finish(state);
+}
+
+void BM_BrownoutLastmeal(benchmark::State &state) {
+    const std::string content = readInput("lastmeal");
+    BrownoutDetectedReporter reporter;
+
+    AllocationCounter allocations;
+    for (auto _ : state) PixelstatsParserBenchmark::lastmeal(&reporter, content);
+    allocations.finish(state);
+}
+
+// Includes reading the history from the data file, as the reporter has no
+// entry point taking the content
+void BM_BatteryEEPROMHistory(benchmark::State &state) {
+    const std::string path = data_dir + "/eeprom_history";
+    const std::shared_ptr<IStats> stats_client = ndk::SharedRefBase::make<NullStats>();
+
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        // A reporter reports once a month
+        BatteryEEPROMReporter reporter;
+        reporter.checkAndReport(stats_client, path);
+    }
+    allocations.finish(state);
+}
+
+void BM_BatteryTTFLine(benchmark::State &state) {
+    const std::vector<std::string> lines = readLines("ttf_stats");
+    const std::shared_ptr<IStats> stats_client = ndk::SharedRefBase::make<NullStats>();
+    BatteryTTFReporter reporter;
+
+    size_t i = 0;
+    AllocationCounter allocations;
+    for (auto _ : state)
+        PixelstatsParserBenchmark::ttfLine(&reporter, stats_client, lines[i++ % lines.size()]);
+    allocations.finish(state);
+}
+
+// The charge stats summary line and its voltage tier lines
+void BM_ChargeStats(benchmark::State &state) {
+    const std::vector<std::string> lines = readLines("charge_stats");
+    const std::shared_ptr<IStats> stats_client = ndk::SharedRefBase::make<NullStats>();
+    ChargeStatsReporter reporter;
+
+    AllocationCounter allocations;
+    for (auto _ : state) PixelstatsParserBenchmark::chargeStats(&reporter, stats_client, lines);
+    allocations.finish(state);
+}
+
+// A dump of every residency tracked thermal zone
+void BM_TempResidency(benchmark::State &state) {
+    const std::string content = readInput("temp_residency");
+    TempResidencyReporter reporter;
+
+    AllocationCounter allocations;
+    for (auto _ : state) PixelstatsParserBenchmark::tempResidency(&reporter, content);
+    allocations.finish(state);
+}
+
+BENCHMARK(BM_Uevent);
+BENCHMARK(BM_BrownoutLastmeal);
+BENCHMARK(BM_BatteryEEPROMHistory);
+BENCHMARK(BM_BatteryTTFLine);
+BENCHMARK(BM_ChargeStats);
+BENCHMARK(BM_TempResidency);
+
+}  // namespace
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using android::hardware::google::pixel::data_dir;
+
+    benchmark::Initialize(&argc, argv);
+    data_dir = android::base::GetExecutableDirectory() + "/data";
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (android::base::ConsumePrefix(&arg, "--data_dir=")) {
+            data_dir = arg;
+        } else {
+            std::cerr << "Unknown argument " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
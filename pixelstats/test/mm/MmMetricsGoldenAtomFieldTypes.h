@@ -89,6 +89,15 @@ const int PixelMmMetricsPerHour_field_types[]{
         longValue,  // optional int64 shmem_pages = 62;
         longValue,  // optional int64 page_table_pages = 63;
         longValue,  // optional int64 dmabuf_kb = 64;
+        longValue,  // optional int64 psi_cpu_some_spike_count = 65;
+        longValue,  // optional int64 psi_cpu_some_spike_duration_ms = 66;
+        longValue,  // optional int64 psi_cpu_some_spike_max_stall_us = 67;
+        longValue,  // optional int64 psi_io_some_spike_count = 68;
+        longValue,  // optional int64 psi_io_some_spike_duration_ms = 69;
+        longValue,  // optional int64 psi_io_some_spike_max_stall_us = 70;
+        longValue,  // optional int64 psi_mem_some_spike_count = 71;
+        longValue,  // optional int64 psi_mem_some_spike_duration_ms = 72;
+        longValue,  // optional int64 psi_mem_some_spike_max_stall_us = 73;
 };
 
 const int PixelMmMetricsPerDay_field_types[]{
@@ -155,6 +164,12 @@ const int PixelMmMetricsPerDay_field_types[]{
         longValue,  // optional int64 cpu_idle_time_cs = 62;
         longValue,  // optional int64 cpu_io_wait_time_cs = 63;
         longValue,  // optional int64 kswapd_pageout_run = 64;
+        longValue,  // optional int64 khugepaged_stime_clks = 65;
+        intValue,   // optional ZramSizeAction zram_size_action = 66;
+        longValue,  // optional int64 zram_compression_ratio_pct = 67;
+        longValue,  // optional int64 zram_peak_swap_used_pct = 68;
+        longValue,  // optional int64 zram_memory_pressure_permille = 69;
+        longValue,  // optional int64 zram_refault_anon_per_hour = 70;
 };
 }  // namespace mm_metrics_atom_field_test_golden_results
 
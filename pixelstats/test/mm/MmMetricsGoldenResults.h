@@ -98,6 +98,10 @@ const int64_t PixelMmMetricsPerHour_golden[]{
     2785,
     2677,
     177,
+    // PSI trigger spikes, no monitor running in the test
+    -1, -1, -1,
+    -1, -1, -1,
+    -1, -1, -1,
         // clang-format on
 };
 
@@ -175,6 +179,13 @@ const int64_t PixelMmMetricsPerDay_golden[]{
     5201,
     5405,
     1126601,
+    77,
+    // zram autotune is off in the test
+    0,
+    0,
+    0,
+    0,
+    0,
         // clang-format on
 };
 }  // namespace mm_metrics_reporter_test_golden_result
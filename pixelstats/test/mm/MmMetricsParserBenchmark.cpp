@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares the map based name/value parser MmMetricsReporter used for
+ * /proc/vmstat with SysfsNameValueTable, both looking up a quarter of the names
+ * of the dump like the per day metrics do.
+ *
+ *   pixelstats_mm_parser_benchmark [--vmstat=<dump>]
+ *
+ * The dump defaults to the live /proc/vmstat, read once before the runs.
+ */
+
+#include <android-base/file.h>
+#include <android-base/parseint.h>
+#include <android-base/strings.h>
+#include <benchmark/benchmark.h>
+#include <pixelstats/SysfsReader.h>
+
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+namespace {
+
+std::string vmstat_path = "/proc/vmstat";
+std::string vmstat_content;
+std::vector<std::string> wanted_names;
+
+// The parser as it was, returning all the pairs of the node
+std::map<std::string, uint64_t> parseToMap(const std::string &file_contents) {
+    std::map<std::string, uint64_t> metrics;
+    std::istringstream data(file_contents);
+    std::string line;
+
+    while (std::getline(data, line)) {
+        std::vector<std::string> words = android::base::Tokenize(line, " ");
+
+        uint64_t i;
+        if (words.size() < 2 || !android::base::ParseUint(words[1], &i)) {
+            metrics.clear();
+            break;
+        }
+
+        if (words[0][words[0].length() - 1] == ':')
+            words[0].pop_back();
+
+        metrics[words[0]] = i;
+    }
+    return metrics;
+}
+
+void BM_MapParser(benchmark::State &state) {
+    for (auto _ : state) {
+        const std::map<std::string, uint64_t> metrics = parseToMap(vmstat_content);
+        uint64_t sum = 0;
+        for (const auto &name : wanted_names) {
+            const auto data = metrics.find(name);
+            if (data != metrics.end())
+                sum += data->second;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetBytesProcessed(state.iterations() * vmstat_content.size());
+}
+
+void BM_TableParser(benchmark::State &state) {
+    const SysfsNameValueTable table(wanted_names);
+    SysfsNameValues values;
+    int bad_line;
+    for (auto _ : state) {
+        table.parse(vmstat_content, &values, &bad_line);
+        uint64_t sum = 0;
+        for (size_t i = 0; i < table.size(); ++i) {
+            if (values.present[i])
+                sum += values.values[i];
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetBytesProcessed(state.iterations() * vmstat_content.size());
+}
+
+BENCHMARK(BM_MapParser);
+BENCHMARK(BM_TableParser);
+
+}  // namespace
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android::hardware::google::pixel;
+
+    benchmark::Initialize(&argc, argv);
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (android::base::ConsumePrefix(&arg, "--vmstat=")) {
+            vmstat_path = arg;
+        } else {
+            std::cerr << "Unknown argument " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    if (!android::base::ReadFileToString(vmstat_path, &vmstat_content)) {
+        std::cerr << "Unable to read " << vmstat_path << std::endl;
+        return 1;
+    }
+    int line_num = 0;
+    for (const auto &line : android::base::Split(vmstat_content, "\n")) {
+        const std::vector<std::string> words = android::base::Tokenize(line, " ");
+        if (!words.empty() && line_num++ % 4 == 0)
+            wanted_names.push_back(words[0]);
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -80,17 +80,23 @@ class MockMmMetricsReporter : public MmMetricsReporter {
             {"/proc/pressure/cpu", "psi_cpu"},
             {"/proc/pressure/io", "psi_io"},
             {"/proc/pressure/memory", "psi_memory"},
+            {"/sys/block/zram0/mm_stat", "zram_mm_stat"},
             {"kswapd0", "kswapd0_stat"},
             {"kcompactd0", "kcompactd0_stat"},
+            {"khugepaged", "khugepaged_stat"},
     };
 
     virtual std::string getSysfsPath(const std::string &path) {
         return base_path_ + "/" + mock_path_map.at(path);
     }
 
-    virtual std::string getProcessStatPath(const std::string &name, int *prev_pid) {
-        (void)(prev_pid);  // unused parameter
-        return getSysfsPath(name);
+    virtual std::vector<std::pair<int, std::string>> findKthreads() {
+        return {{93, "kswapd0"}, {84, "kcompactd0"}, {51, "khugepaged"}};
+    }
+
+    virtual std::string getKthreadStatPath(int pid, const std::string &comm) {
+        (void)(pid);  // unused parameter
+        return getSysfsPath(comm);
     }
 };
 
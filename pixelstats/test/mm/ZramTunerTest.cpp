@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <pixelstats/ZramTuner.h>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+namespace {
+
+constexpr char kLadder[] = "40p,50p,60p";
+constexpr int64_t kIntervalMs = 5 * 60 * 1000;
+
+/**
+ * Feed a window of samples: swap used up to peak_used_pct of 1000MB, pages
+ * compressing at ratio, and per sample stall_us of memory stall and
+ * refaults anon refaults. The counters in state carry over to the next window.
+ */
+void feed(ZramTuner *tuner, ZramTuner::Sample *state, int64_t peak_used_pct, uint64_t ratio,
+          uint64_t stall_us, uint64_t refaults) {
+    ZramTuner::Sample &sample = *state;
+    sample.swap_total_kb = 1000 * 1024;
+    for (size_t i = 0; i <= ZramTuner::kMinSamples; i++) {
+        const uint64_t used_kb = sample.swap_total_kb * peak_used_pct / 100 * i /
+                                 ZramTuner::kMinSamples;
+        sample.swap_free_kb = sample.swap_total_kb - used_kb;
+        sample.orig_data_size = used_kb * 1024 * ratio;
+        sample.compr_data_size = used_kb * 1024;
+        tuner->addSample(sample);
+        if (i == ZramTuner::kMinSamples)
+            break;
+        sample.memory_some_us += stall_us;
+        sample.refault_anon += refaults;
+        sample.time_ms += kIntervalMs;
+    }
+}
+
+}  // namespace
+
+TEST(ZramTunerTest, TooFewSamples) {
+    ZramTuner tuner;
+    ZramTuner::Sample sample;
+    tuner.addSample(sample);
+    EXPECT_EQ(PixelMmMetricsPerDay::ZRAM_SIZE_NONE, tuner.decide("50p", kLadder).action);
+}
+
+TEST(ZramTunerTest, SizeNotInLadder) {
+    ZramTuner tuner;
+    ZramTuner::Sample sample;
+    feed(&tuner, &sample, 95, 3, 30 * kIntervalMs, 0);
+    EXPECT_EQ(PixelMmMetricsPerDay::ZRAM_SIZE_NONE, tuner.decide("4g", kLadder).action);
+}
+
+TEST(ZramTunerTest, GrowUnderPressure) {
+    ZramTuner tuner;
+    ZramTuner::Sample sample;
+    // 3% of the time stalled on memory
+    feed(&tuner, &sample, 95, 3, 30 * kIntervalMs, 0);
+    const ZramTuner::Decision decision = tuner.decide("50p", kLadder);
+    EXPECT_EQ(PixelMmMetricsPerDay::ZRAM_SIZE_GROW, decision.action);
+    EXPECT_EQ("60p", decision.size);
+    EXPECT_EQ(300, decision.compression_ratio_pct);
+    EXPECT_EQ(95, decision.peak_swap_used_pct);
+    EXPECT_EQ(30, decision.memory_pressure_permille);
+
+    // Already at the top of the ladder
+    feed(&tuner, &sample, 95, 3, 30 * kIntervalMs, 0);
+    EXPECT_EQ(PixelMmMetricsPerDay::ZRAM_SIZE_KEEP, tuner.decide("60p", kLadder).action);
+}
+
+TEST(ZramTunerTest, KeepPoorlyCompressing) {
+    ZramTuner tuner;
+    ZramTuner::Sample sample;
+    feed(&tuner, &sample, 95, 1, 30 * kIntervalMs, 0);
+    EXPECT_EQ(PixelMmMetricsPerDay::ZRAM_SIZE_KEEP, tuner.decide("50p", kLadder).action);
+}
+
+TEST(ZramTunerTest, GrowOnRefaults) {
+    ZramTuner tuner;
+    ZramTuner::Sample sample;
+    // 4096 refaults every 5 minutes
+    feed(&tuner, &sample, 92, 3, 0, 4096);
+    const ZramTuner::Decision decision = tuner.decide("40p", kLadder);
+    EXPECT_EQ(PixelMmMetricsPerDay::ZRAM_SIZE_GROW, decision.action);
+    EXPECT_EQ("50p", decision.size);
+    EXPECT_EQ(4096 * 12, decision.refault_anon_per_hour);
+}
+
+TEST(ZramTunerTest, ShrinkWhenIdle) {
+    ZramTuner tuner;
+    ZramTuner::Sample sample;
+    feed(&tuner, &sample, 30, 3, 0, 10);
+    ZramTuner::Decision decision = tuner.decide("50p", kLadder);
+    EXPECT_EQ(PixelMmMetricsPerDay::ZRAM_SIZE_SHRINK, decision.action);
+    EXPECT_EQ("40p", decision.size);
+
+    // Already at the bottom of the ladder
+    feed(&tuner, &sample, 30, 3, 0, 10);
+    decision = tuner.decide("40p", kLadder);
+    EXPECT_EQ(PixelMmMetricsPerDay::ZRAM_SIZE_KEEP, decision.action);
+    EXPECT_EQ("40p", decision.size);
+}
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/unique_fd.h>
+#include <gtest/gtest.h>
+#include <pixelstats/UeventListener.h>
+#include <sys/socket.h>
+
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+
+namespace {
+
+/**
+ * Runs the uevent filter the kernel would: attached to the receiving end of
+ * a datagram socket pair, it either lets a message through or drops it.
+ */
+class UeventFilterTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        int fds[2];
+        ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, fds));
+        send_fd_.reset(fds[0]);
+        recv_fd_.reset(fds[1]);
+
+        const std::vector<sock_filter> filter = UeventListener::BuildUeventFilter();
+        const struct sock_fprog prog = {
+                .len = static_cast<unsigned short>(filter.size()),
+                .filter = const_cast<sock_filter *>(filter.data()),
+        };
+        ASSERT_EQ(0, setsockopt(recv_fd_.get(), SOL_SOCKET, SO_ATTACH_FILTER, &prog,
+                                sizeof(prog)));
+    }
+
+    // Whether a kernel uevent with the given "ACTION@DEVPATH" header passes
+    bool passes(const std::string &header) {
+        std::string msg = header;
+        msg += '\0';
+        msg += "ACTION=change";
+        msg += '\0';
+        msg += "SUBSYSTEM=power_supply";
+        msg += '\0';
+        msg += "SEQNUM=1234";
+        msg += '\0';
+        return passesRaw(msg);
+    }
+
+    bool passesRaw(const std::string &msg) {
+        EXPECT_EQ(static_cast<ssize_t>(msg.size()),
+                  send(send_fd_.get(), msg.data(), msg.size(), 0));
+        char buf[512];
+        return recv(recv_fd_.get(), buf, sizeof(buf), MSG_DONTWAIT) > 0;
+    }
+
+    android::base::unique_fd send_fd_;
+    android::base::unique_fd recv_fd_;
+};
+
+}  // namespace
+
+TEST_F(UeventFilterTest, RejectsIgnoredVirtualSubsystems) {
+    EXPECT_FALSE(passes("add@/devices/virtual/wakeup/wakeup12"));
+    EXPECT_FALSE(passes("change@/devices/virtual/thermal/thermal_zone3"));
+    EXPECT_FALSE(passes("remove@/devices/virtual/net/rmnet0"));
+    EXPECT_FALSE(passes("offline@/devices/virtual/block/zram0"));
+    EXPECT_FALSE(passes("online@/devices/virtual/tty/ttyS0"));
+    EXPECT_FALSE(passes("bind@/devices/virtual/input/input3"));
+    EXPECT_FALSE(passes("unbind@/devices/virtual/bdi/254:0"));
+}
+
+TEST_F(UeventFilterTest, AcceptsOtherDevpaths) {
+    EXPECT_TRUE(passes("change@/devices/platform/google,battery/power_supply/battery"));
+    EXPECT_TRUE(passes("change@/devices/platform/soc/soc:google,overheat_mitigation"));
+    EXPECT_TRUE(passes("bind@/devices/virtual/typec/port0"));
+    EXPECT_TRUE(passes("move@/devices/virtual/misc/foo"));
+    EXPECT_TRUE(passes("change@/module/pixel_metrics"));
+    // An ignored subsystem outside /devices/virtual/ is left to the listener
+    EXPECT_TRUE(passes("add@/devices/platform/soc/net/wlan0"));
+}
+
+TEST_F(UeventFilterTest, AcceptsWhatItDoesNotRecognize) {
+    // No '@' where an action would end
+    EXPECT_TRUE(passes("libudev-/devices/virtual/wakeup/wakeup12"));
+    // Shorter than the header it compares
+    EXPECT_TRUE(passesRaw("add@/devices/virtual/net/lo"));
+}
+
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
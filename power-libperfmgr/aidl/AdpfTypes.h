@@ -57,6 +57,8 @@ enum class AdpfVoteType : int32_t {
     GPU_LOAD_DOWN,
     GPU_LOAD_RESET,
     GPU_CAPACITY,
+    CPU_LOAD_PREDICTED,
+    GPU_CO_BOOST,
     VOTE_TYPE_SIZE
 };
 
@@ -80,6 +82,10 @@ constexpr const char *AdpfVoteTypeToStr(AdpfVoteType voteType) {
             return "GPU_LOAD_RESET";
         case AdpfVoteType::GPU_CAPACITY:
             return "GPU_CAPACITY";
+        case AdpfVoteType::CPU_LOAD_PREDICTED:
+            return "CPU_LOAD_PREDICTED";
+        case AdpfVoteType::GPU_CO_BOOST:
+            return "GPU_CO_BOOST";
         default:
             return "INVALID_VOTE";
     }
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG (ATRACE_TAG_POWER | ATRACE_TAG_HAL)
+
+#include "AppDescriptorTrace.h"
+
+#include <utils/Trace.h>
+
+#include <cstdio>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+namespace {
+
+using ::aidl::android::hardware::power::SessionMode;
+
+constexpr std::array<const char *, static_cast<size_t>(AppTraceCounter::COUNTER_SIZE)>
+        kCounterNames = {
+                "pid.err",
+                "pid.integral",
+                "pid.derivative",
+                "pid.pOut",
+                "pid.iOut",
+                "pid.dOut",
+                "pid.output",
+                "target",
+                "active",
+                "add_threads",
+                "act_last",
+                "min",
+                "batch_size",
+                "hint_count",
+                "hint_overtime",
+                "is_first_frame",
+                "report_latency_us",
+                "timeout_lateness_us",
+                "hboost.avgDuration",
+                "hboost.isActive",
+                "hboost.isLowFrameRate",
+                "hboost.maxDuration",
+                "hboost.numOfMissedCycles",
+                "hboost.p90Duration",
+                "cpu_duration",
+                "gpu_duration",
+                "gpu_capacity",
+                "energy_cap",
+                "gpu_co_boost",
+};
+
+}  // namespace
+
+AppDescriptorTrace::AppDescriptorTrace(const std::string &idString) {
+    snprintf(mId.data(), mId.size(), "%s", idString.c_str());
+}
+
+void AppDescriptorTrace::traceInt(AppTraceCounter counter, int32_t value) {
+    trace(static_cast<size_t>(counter), value);
+}
+
+void AppDescriptorTrace::traceMode(SessionMode mode, int32_t value) {
+    const size_t index = static_cast<size_t>(mode);
+    if (index < kNumModes) {
+        trace(static_cast<size_t>(AppTraceCounter::COUNTER_SIZE) + index, value);
+    }
+}
+
+void AppDescriptorTrace::traceVote(int voteId, int32_t value) {
+    if (voteId >= 0 && static_cast<size_t>(voteId) < kNumVotes) {
+        trace(static_cast<size_t>(AppTraceCounter::COUNTER_SIZE) + kNumModes + voteId, value);
+    }
+}
+
+std::string AppDescriptorTrace::name(size_t index) {
+    std::lock_guard lock(mMutex);
+    return nameLocked(index);
+}
+
+void AppDescriptorTrace::trace(size_t index, int32_t value) {
+    if (!ATRACE_ENABLED()) {
+        if (mHasNames.load(std::memory_order_relaxed)) {
+            std::lock_guard lock(mMutex);
+            mNames.reset();
+            mHasNames = false;
+        }
+        return;
+    }
+    std::lock_guard lock(mMutex);
+    ATRACE_INT(nameLocked(index), value);
+}
+
+const char *AppDescriptorTrace::nameLocked(size_t index) {
+    if (!mNames) {
+        // Value initialized, an empty name is built on first use
+        mNames.reset(new Name[kNumNames]());
+        mHasNames = true;
+    }
+    Name &name = mNames[index];
+    if (name[0] != '\0') {
+        return name.data();
+    }
+    constexpr size_t kNumCounters = static_cast<size_t>(AppTraceCounter::COUNTER_SIZE);
+    if (index < kNumCounters) {
+        snprintf(name.data(), name.size(), "adpf.%s-%s", mId.data(), kCounterNames[index]);
+    } else if (index < kNumCounters + kNumModes) {
+        snprintf(name.data(), name.size(), "adpf.%s-%s_mode", mId.data(),
+                 toString(static_cast<SessionMode>(index - kNumCounters)).c_str());
+    } else {
+        snprintf(name.data(), name.size(), "adpf.%s-vote.%s", mId.data(),
+                 AdpfVoteTypeToStr(static_cast<AdpfVoteType>(index - kNumCounters - kNumModes)));
+    }
+    return name.data();
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
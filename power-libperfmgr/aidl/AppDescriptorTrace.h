@@ -17,8 +17,12 @@
 #pragma once
 
 #include <aidl/android/hardware/power/SessionMode.h>
-#include <android-base/stringprintf.h>
+#include <android-base/thread_annotations.h>
 
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
 
 #include "AdpfTypes.h"
@@ -35,80 +39,80 @@ constexpr size_t enum_size() {
     return static_cast<size_t>(*(ndk::enum_range<T>().end() - 1)) + 1;
 }
 
-// The App Hint Descriptor struct manages information necessary
-// to calculate the next uclamp min value from the PID function
-// and is separate so that it can be used as a pointer for
-// easily passing to the pid function
-struct AppDescriptorTrace {
-    AppDescriptorTrace(const std::string &idString) {
-        using ::android::base::StringPrintf;
-        trace_pid_err = StringPrintf("adpf.%s-%s", idString.c_str(), "pid.err");
-        trace_pid_integral = StringPrintf("adpf.%s-%s", idString.c_str(), "pid.integral");
-        trace_pid_derivative = StringPrintf("adpf.%s-%s", idString.c_str(), "pid.derivative");
-        trace_pid_pOut = StringPrintf("adpf.%s-%s", idString.c_str(), "pid.pOut");
-        trace_pid_iOut = StringPrintf("adpf.%s-%s", idString.c_str(), "pid.iOut");
-        trace_pid_dOut = StringPrintf("adpf.%s-%s", idString.c_str(), "pid.dOut");
-        trace_pid_output = StringPrintf("adpf.%s-%s", idString.c_str(), "pid.output");
-        trace_target = StringPrintf("adpf.%s-%s", idString.c_str(), "target");
-        trace_active = StringPrintf("adpf.%s-%s", idString.c_str(), "active");
-        trace_add_threads = StringPrintf("adpf.%s-%s", idString.c_str(), "add_threads");
-        trace_actl_last = StringPrintf("adpf.%s-%s", idString.c_str(), "act_last");
-        trace_min = StringPrintf("adpf.%s-%s", idString.c_str(), "min");
-        trace_batch_size = StringPrintf("adpf.%s-%s", idString.c_str(), "batch_size");
-        trace_hint_count = StringPrintf("adpf.%s-%s", idString.c_str(), "hint_count");
-        trace_hint_overtime = StringPrintf("adpf.%s-%s", idString.c_str(), "hint_overtime");
-        trace_is_first_frame = StringPrintf("adpf.%s-%s", idString.c_str(), "is_first_frame");
-        // traces for heuristic boost
-        trace_avg_duration = StringPrintf("adpf.%s-%s", idString.c_str(), "hboost.avgDuration");
-        trace_heuristic_boost_active =
-                StringPrintf("adpf.%s-%s", idString.c_str(), "hboost.isActive");
-        trace_low_frame_rate =
-                StringPrintf("adpf.%s-%s", idString.c_str(), "hboost.isLowFrameRate");
-        trace_max_duration = StringPrintf("adpf.%s-%s", idString.c_str(), "hboost.maxDuration");
-        trace_missed_cycles =
-                StringPrintf("adpf.%s-%s", idString.c_str(), "hboost.numOfMissedCycles");
-        for (size_t i = 0; i < trace_modes.size(); ++i) {
-            trace_modes[i] = StringPrintf(
-                    "adpf.%s-%s_mode", idString.c_str(),
-                    toString(static_cast<aidl::android::hardware::power::SessionMode>(i)).c_str());
-        }
-        for (size_t i = 0; i < trace_votes.size(); ++i) {
-            trace_votes[i] = StringPrintf("adpf.%s-vote.%s", idString.c_str(),
-                                          AdpfVoteTypeToStr(static_cast<AdpfVoteType>(i)));
-        }
-        trace_cpu_duration = StringPrintf("adpf.%s-%s", idString.c_str(), "cpu_duration");
-        trace_gpu_duration = StringPrintf("adpf.%s-%s", idString.c_str(), "gpu_duration");
-        trace_gpu_capacity = StringPrintf("adpf.%s-%s", idString.c_str(), "gpu_capacity");
-    }
+// Per session counters, traced as "adpf.<idString>-<name>"
+enum class AppTraceCounter : size_t {
+    PID_ERR,
+    PID_INTEGRAL,
+    PID_DERIVATIVE,
+    PID_P_OUT,
+    PID_I_OUT,
+    PID_D_OUT,
+    PID_OUTPUT,
+    TARGET,
+    ACTIVE,
+    ADD_THREADS,
+    ACTL_LAST,
+    MIN,
+    BATCH_SIZE,
+    HINT_COUNT,
+    HINT_OVERTIME,
+    IS_FIRST_FRAME,
+    // ADPF latency
+    REPORT_LATENCY,
+    TIMEOUT_LATENESS,
+    // Heuristic boost
+    AVG_DURATION,
+    HEURISTIC_BOOST_ACTIVE,
+    LOW_FRAME_RATE,
+    MAX_DURATION,
+    MISSED_CYCLES,
+    P90_DURATION,
+    CPU_DURATION,
+    GPU_DURATION,
+    GPU_CAPACITY,
+    // Energy aware mode
+    ENERGY_CAP,
+    // CPU/GPU co-boost
+    GPU_CO_BOOST,
+    COUNTER_SIZE
+};
+
+// Trace counters of one hint session. Nothing but the id is kept until the
+// first counter is traced with tracing on, the names are then formatted into
+// fixed buffers as they get used, and dropped once tracing is turned off.
+class AppDescriptorTrace {
+  public:
+    explicit AppDescriptorTrace(const std::string &idString);
+
+    // Trace value if tracing is on
+    void traceInt(AppTraceCounter counter, int32_t value);
+    void traceMode(::aidl::android::hardware::power::SessionMode mode, int32_t value);
+    void traceVote(int voteId, int32_t value);
+
+    // Return the trace name of the counter at index, building it if needed.
+    // Indexes past the counters are the modes, then the votes.
+    std::string name(size_t index);
+
+    static constexpr size_t kNumModes = enum_size<::aidl::android::hardware::power::SessionMode>();
+    static constexpr size_t kNumVotes = static_cast<size_t>(AdpfVoteType::VOTE_TYPE_SIZE);
+    static constexpr size_t kNumNames =
+            static_cast<size_t>(AppTraceCounter::COUNTER_SIZE) + kNumModes + kNumVotes;
+
+  private:
+    // Long enough for the id strings hint sessions use, longer ids and names
+    // are truncated.
+    static constexpr size_t kMaxIdLen = 64;
+    static constexpr size_t kMaxNameLen = 96;
+    using Name = std::array<char, kMaxNameLen>;
+
+    void trace(size_t index, int32_t value);
+    const char *nameLocked(size_t index) REQUIRES(mMutex);
 
-    // Trace values
-    std::string trace_pid_err;
-    std::string trace_pid_integral;
-    std::string trace_pid_derivative;
-    std::string trace_pid_pOut;
-    std::string trace_pid_iOut;
-    std::string trace_pid_dOut;
-    std::string trace_pid_output;
-    std::string trace_target;
-    std::string trace_active;
-    std::string trace_add_threads;
-    std::string trace_actl_last;
-    std::string trace_min;
-    std::string trace_batch_size;
-    std::string trace_hint_count;
-    std::string trace_hint_overtime;
-    std::string trace_is_first_frame;
-    // traces for heuristic boost
-    std::string trace_avg_duration;
-    std::string trace_heuristic_boost_active;
-    std::string trace_low_frame_rate;
-    std::string trace_max_duration;
-    std::string trace_missed_cycles;
-    std::array<std::string, enum_size<aidl::android::hardware::power::SessionMode>()> trace_modes;
-    std::array<std::string, static_cast<int32_t>(AdpfVoteType::VOTE_TYPE_SIZE)> trace_votes;
-    std::string trace_cpu_duration;
-    std::string trace_gpu_duration;
-    std::string trace_gpu_capacity;
+    std::array<char, kMaxIdLen> mId;
+    std::mutex mMutex;
+    std::unique_ptr<Name[]> mNames GUARDED_BY(mMutex);
+    // Set while mNames holds names, checked without the lock when tracing is off
+    std::atomic<bool> mHasNames{false};
 };
 
 }  // namespace pixel
@@ -19,6 +19,13 @@
 
 #include "BackgroundWorker.h"
 
+#include <android-base/logging.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <cstring>
+
 namespace aidl {
 namespace google {
 namespace hardware {
@@ -26,122 +33,467 @@ namespace power {
 namespace impl {
 namespace pixel {
 
+TimerWheel::TimerWheel(Clock::time_point start)
+    : mStart(start), mNodes(kLevels * kSlots) {
+    for (uint32_t slot = 0; slot < kLevels * kSlots; ++slot) {
+        mNodes[slot].prev = slot;
+        mNodes[slot].next = slot;
+    }
+}
+
+int64_t TimerWheel::toTick(Clock::time_point t) const {
+    if (t <= mStart) {
+        return 0;
+    }
+    // Round up, a timer never fires before its deadline
+    const auto elapsed = t - mStart;
+    const auto ticks = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+    return ticks + (std::chrono::milliseconds(ticks) < elapsed ? 1 : 0);
+}
+
+TimerWheel::Clock::time_point TimerWheel::toTime(int64_t tick) const {
+    return mStart + tick * kTick;
+}
+
+uint32_t TimerWheel::allocNode() {
+    if (mFreeList == kNil) {
+        mNodes.emplace_back();
+        return mNodes.size() - 1;
+    }
+    const uint32_t node = mFreeList;
+    mFreeList = mNodes[node].next;
+    return node;
+}
+
+void TimerWheel::link(uint32_t node) {
+    const int64_t expiry = mNodes[node].expiry;
+    const int64_t delta = expiry - mCurrentTick;
+    uint32_t slot;
+    if (delta < kSlots) {
+        slot = slotIndex(0, expiry);
+    } else if (delta < kSlots * kSlots) {
+        slot = slotIndex(1, expiry);
+    } else if (delta < kSlots * kSlots * kSlots) {
+        slot = slotIndex(2, expiry);
+    } else {
+        // Too far out, park it in the slot cascading last and relink it then
+        slot = slotIndex(2, mCurrentTick);
+    }
+    // Append, timers of the same tick fire in scheduling order
+    const uint32_t tail = mNodes[slot].prev;
+    mNodes[node].prev = tail;
+    mNodes[node].next = slot;
+    mNodes[tail].next = node;
+    mNodes[slot].prev = node;
+}
+
+void TimerWheel::unlink(uint32_t node) {
+    mNodes[mNodes[node].prev].next = mNodes[node].next;
+    mNodes[mNodes[node].next].prev = mNodes[node].prev;
+    mNodes[node].prev = kNil;
+    mNodes[node].next = kNil;
+}
+
+bool TimerWheel::schedule(const Key &key, Clock::time_point deadline) {
+    auto [itr, added] = mIndex.try_emplace(key, kNil);
+    uint32_t node;
+    if (added) {
+        node = allocNode();
+        itr->second = node;
+        mNodes[node].key = key;
+    } else {
+        node = itr->second;
+        unlink(node);
+    }
+    mNodes[node].deadline = deadline;
+    mNodes[node].expiry = std::max(toTick(deadline), mCurrentTick + 1);
+    link(node);
+    return added;
+}
+
+bool TimerWheel::cancel(const Key &key) {
+    auto itr = mIndex.find(key);
+    if (itr == mIndex.end()) {
+        return false;
+    }
+    const uint32_t node = itr->second;
+    unlink(node);
+    mNodes[node].next = mFreeList;
+    mFreeList = node;
+    mIndex.erase(itr);
+    return true;
+}
+
+int64_t TimerWheel::nextEventTick() const {
+    int64_t best = kNone;
+    // Level 0 holds timers expiring within the next kSlots - 1 ticks
+    for (int64_t tick = mCurrentTick + 1; tick < mCurrentTick + kSlots; ++tick) {
+        if (!slotEmpty(slotIndex(0, tick))) {
+            best = tick;
+            break;
+        }
+    }
+    // Upper levels need to be cascaded at their slot boundaries
+    for (int level = 1; level < kLevels; ++level) {
+        const int shift = level * kLevelBits;
+        for (int64_t i = 1; i <= kSlots; ++i) {
+            const int64_t boundary = ((mCurrentTick >> shift) + i) << shift;
+            if (boundary >= best) {
+                break;
+            }
+            if (!slotEmpty(slotIndex(level, boundary))) {
+                best = boundary;
+                break;
+            }
+        }
+    }
+    return best;
+}
+
+TimerWheel::Clock::time_point TimerWheel::nextWakeup() const {
+    if (mIndex.empty()) {
+        return Clock::time_point::max();
+    }
+    const int64_t tick = nextEventTick();
+    return tick == kNone ? Clock::time_point::max() : toTime(tick);
+}
+
+void TimerWheel::cascade(int level, int64_t tick) {
+    const uint32_t slot = slotIndex(level, tick);
+    uint32_t node = mNodes[slot].next;
+    // Detach the whole list first, nodes may be relinked into the same slot
+    mNodes[slot].prev = slot;
+    mNodes[slot].next = slot;
+    while (node != slot) {
+        const uint32_t next = mNodes[node].next;
+        link(node);
+        node = next;
+    }
+}
+
+void TimerWheel::collect(int64_t tick, std::vector<Expired> *expired) {
+    const uint32_t slot = slotIndex(0, tick);
+    uint32_t node = mNodes[slot].next;
+    mNodes[slot].prev = slot;
+    mNodes[slot].next = slot;
+    while (node != slot) {
+        const uint32_t next = mNodes[node].next;
+        if (mNodes[node].expiry > tick) {
+            // Shouldn't happen, keep it for later
+            link(node);
+        } else {
+            expired->push_back({mNodes[node].key, mNodes[node].deadline});
+            mIndex.erase(mNodes[node].key);
+            mNodes[node].prev = kNil;
+            mNodes[node].next = mFreeList;
+            mFreeList = node;
+        }
+        node = next;
+    }
+}
+
+void TimerWheel::advance(Clock::time_point now, std::vector<Expired> *expired) {
+    if (now < mStart) {
+        return;
+    }
+    const int64_t nowTick =
+            std::chrono::duration_cast<std::chrono::milliseconds>(now - mStart).count();
+    while (mCurrentTick < nowTick) {
+        const int64_t next = mIndex.empty() ? kNone : nextEventTick();
+        if (next > nowTick) {
+            // Nothing due in between, skip the empty ticks
+            mCurrentTick = nowTick;
+            break;
+        }
+        mCurrentTick = next;
+        for (int level = kLevels - 1; level > 0; --level) {
+            if ((next & ((int64_t{1} << (level * kLevelBits)) - 1)) == 0) {
+                cascade(level, next);
+            }
+        }
+        collect(next, expired);
+    }
+}
+
+namespace {
+
+constexpr const char *laneName(WorkerLane lane) {
+    switch (lane) {
+        case WorkerLane::REALTIME:
+            return "realtime";
+        case WorkerLane::NORMAL:
+            return "normal";
+        default:
+            return "invalid";
+    }
+}
+
+}  // namespace
+
 PriorityQueueWorkerPool::PriorityQueueWorkerPool(size_t threadCount,
                                                  const std::string &threadNamePrefix) {
-    mRunning = true;
-    mThreadPool.reserve(threadCount);
-    for (size_t threadId = 0; threadId < threadCount; ++threadId) {
-        mThreadPool.push_back(std::thread([&, tid = threadId]() { loop(); }));
+    startLane(WorkerLane::NORMAL, {.threadCount = threadCount,
+                                   .threadNamePrefix = threadNamePrefix});
+}
 
-        if (!threadNamePrefix.empty()) {
-            const std::string fullThreadName = threadNamePrefix + std::to_string(threadId);
-            pthread_setname_np(mThreadPool.back().native_handle(), fullThreadName.c_str());
+PriorityQueueWorkerPool::PriorityQueueWorkerPool(
+        const std::array<LaneConfig, kNumWorkerLanes> &lanes) {
+    for (size_t i = 0; i < kNumWorkerLanes; ++i) {
+        startLane(static_cast<WorkerLane>(i), lanes[i]);
+    }
+}
+
+void PriorityQueueWorkerPool::startLane(WorkerLane laneId, const LaneConfig &config) {
+    Lane &lane = mLanes[static_cast<size_t>(laneId)];
+    lane.threads.reserve(config.threadCount);
+    lane.waiterWakeups.assign(config.threadCount, std::chrono::steady_clock::time_point::min());
+    for (size_t threadId = 0; threadId < config.threadCount; ++threadId) {
+        lane.threads.push_back(std::thread([this, &lane, threadId]() { loop(&lane, threadId); }));
+
+        if (!config.threadNamePrefix.empty()) {
+            const std::string fullThreadName = config.threadNamePrefix + std::to_string(threadId);
+            pthread_setname_np(lane.threads.back().native_handle(), fullThreadName.c_str());
+        }
+        if (config.fifoPriority > 0) {
+            const sched_param param = {.sched_priority = config.fifoPriority};
+            const int err = pthread_setschedparam(lane.threads.back().native_handle(),
+                                                  SCHED_FIFO, &param);
+            if (err != 0) {
+                LOG(WARNING) << "Failed to make " << laneName(laneId)
+                             << " lane thread SCHED_FIFO: " << strerror(err);
+            }
         }
     }
 }
 
 PriorityQueueWorkerPool::~PriorityQueueWorkerPool() {
-    {
-        std::lock_guard<std::mutex> lock(mMutex);
-        mRunning = false;
-        mCv.notify_all();
+    stopThreads();
+}
+
+void PriorityQueueWorkerPool::stopThreads() {
+    for (auto &lane : mLanes) {
+        std::lock_guard<std::mutex> lock(lane.mutex);
+        lane.running = false;
+        lane.cv.notify_all();
     }
-    for (auto &t : mThreadPool) {
-        if (t.joinable()) {
-            t.join();
+    for (auto &lane : mLanes) {
+        for (auto &t : lane.threads) {
+            if (t.joinable()) {
+                t.join();
+            }
         }
     }
 }
 
+PriorityQueueWorkerPool::Lane *PriorityQueueWorkerPool::findLane(int64_t templateQueueWorkerId) {
+    std::lock_guard<std::mutex> lock(mWorkerLanesMutex);
+    auto itr = mWorkerLanes.find(templateQueueWorkerId);
+    if (itr == mWorkerLanes.end()) {
+        return nullptr;
+    }
+    return &mLanes[static_cast<size_t>(itr->second)];
+}
+
 void PriorityQueueWorkerPool::addCallback(int64_t templateQueueWorkerId,
-                                          std::function<void(int64_t)> callback) {
+                                          std::function<void(int64_t)> callback,
+                                          WorkerLane lane) {
     if (!callback) {
         // Don't add callback if it isn't callable to prevent having to check later
         return;
     }
-    std::unique_lock<std::shared_mutex> lock(mSharedMutex);
-    auto itr = mCallbackMap.find(templateQueueWorkerId);
-    if (itr != mCallbackMap.end()) {
-        return;
+    if (static_cast<size_t>(lane) >= kNumWorkerLanes ||
+        mLanes[static_cast<size_t>(lane)].threads.empty()) {
+        lane = WorkerLane::NORMAL;
     }
-    mCallbackMap[templateQueueWorkerId] = callback;
+    {
+        std::unique_lock<std::shared_mutex> lock(mSharedMutex);
+        auto itr = mCallbackMap.find(templateQueueWorkerId);
+        if (itr != mCallbackMap.end()) {
+            return;
+        }
+        mCallbackMap[templateQueueWorkerId] = callback;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mWorkerLanesMutex);
+        mWorkerLanes[templateQueueWorkerId] = lane;
+    }
+    Lane &workerLane = mLanes[static_cast<size_t>(lane)];
+    std::lock_guard<std::mutex> lock(workerLane.mutex);
+    workerLane.stats.try_emplace(templateQueueWorkerId);
 }
 
 void PriorityQueueWorkerPool::removeCallback(int64_t templateQueueWorkerId) {
-    std::unique_lock<std::shared_mutex> lock(mSharedMutex);
-    auto itr = mCallbackMap.find(templateQueueWorkerId);
-    if (itr == mCallbackMap.end()) {
-        return;
+    {
+        std::unique_lock<std::shared_mutex> lock(mSharedMutex);
+        auto itr = mCallbackMap.find(templateQueueWorkerId);
+        if (itr == mCallbackMap.end()) {
+            return;
+        }
+        mCallbackMap.erase(itr);
+    }
+    Lane *lane = findLane(templateQueueWorkerId);
+    {
+        std::lock_guard<std::mutex> lock(mWorkerLanesMutex);
+        mWorkerLanes.erase(templateQueueWorkerId);
+    }
+    if (lane != nullptr) {
+        std::lock_guard<std::mutex> lock(lane->mutex);
+        lane->stats.erase(templateQueueWorkerId);
     }
-    mCallbackMap.erase(itr);
 }
 
 void PriorityQueueWorkerPool::schedule(int64_t templateQueueWorkerId, int64_t packageId,
                                        std::chrono::steady_clock::time_point deadline) {
-    std::unique_lock<std::mutex> lock(mMutex);
-    mPackageQueue.emplace(deadline, templateQueueWorkerId, packageId);
-    mCv.notify_all();
-}
-
-void PriorityQueueWorkerPool::loop() {
-    Package package;
-    while (mRunning) {
-        std::unique_lock<std::mutex> lock(mMutex);
-        // Default to longest wait possible without overflowing if there is
-        // nothing to work on in the queue
-        std::chrono::steady_clock::time_point deadline =
-                std::chrono::steady_clock::time_point::max();
-
-        // Use next item to work on deadline if available
-        if (!mPackageQueue.empty()) {
-            deadline = mPackageQueue.top().deadline;
-        }
-
-        // Wait until signal or deadline
-        mCv.wait_until(lock, deadline, [&]() {
-            // Check if stop running requested, if so return now
-            if (!mRunning)
-                return true;
-
-            // Check if nothing in queue (e.g. spurious wakeup), wait as long as possible again
-            if (mPackageQueue.empty()) {
-                deadline = std::chrono::steady_clock::time_point::max();
-                return false;
-            }
+    Lane *lane = findLane(templateQueueWorkerId);
+    if (lane == nullptr) {
+        // Nothing would run it
+        return;
+    }
+    std::unique_lock<std::mutex> lock(lane->mutex);
+    const bool added = lane->wheel.schedule({templateQueueWorkerId, packageId}, deadline);
+    auto stats = lane->stats.find(templateQueueWorkerId);
+    if (stats != lane->stats.end()) {
+        if (added) {
+            stats->second.depth++;
+            stats->second.maxDepth = std::max(stats->second.maxDepth, stats->second.depth);
+        } else {
+            stats->second.coalesced++;
+        }
+    }
+    lane->maxDepth = std::max(lane->maxDepth, lane->wheel.size());
+    // Only wake the workers if a waiting one would otherwise sleep past the
+    // deadline, threads busy running work don't count as they may run long.
+    // Waking all of them keeps a waiter that is due earlier from absorbing the
+    // notification, the others go back to sleep until the earliest deadline.
+    if (std::any_of(lane->waiterWakeups.begin(), lane->waiterWakeups.end(),
+                    [deadline](auto wakeup) { return deadline < wakeup; })) {
+        lane->cv.notify_all();
+    }
+}
+
+bool PriorityQueueWorkerPool::cancel(int64_t templateQueueWorkerId, int64_t packageId) {
+    Lane *lane = findLane(templateQueueWorkerId);
+    if (lane == nullptr) {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(lane->mutex);
+    if (!lane->wheel.cancel({templateQueueWorkerId, packageId})) {
+        return false;
+    }
+    auto stats = lane->stats.find(templateQueueWorkerId);
+    if (stats != lane->stats.end() && stats->second.depth > 0) {
+        stats->second.depth--;
+    }
+    return true;
+}
 
-            // Something in queue, use that as next deadline
-            deadline = mPackageQueue.top().deadline;
-            // Check if deadline is in the future still, continue waiting with updated deadline
-            if (deadline > std::chrono::steady_clock::now())
-                return false;
-            // Next work entry's deadline is in the past or exactly now, time to work on it
-            return true;
-        });
+void PriorityQueueWorkerPool::dumpToStream(std::ostream &stream) {
+    for (size_t i = 0; i < kNumWorkerLanes; ++i) {
+        Lane &lane = mLanes[i];
+        std::lock_guard<std::mutex> lock(lane.mutex);
+        if (lane.threads.empty()) {
+            continue;
+        }
+        stream << "Lane " << laneName(static_cast<WorkerLane>(i)) << ": threads "
+               << lane.threads.size() << " depth " << lane.wheel.size() << " max depth "
+               << lane.maxDepth << " lateness max "
+               << std::chrono::duration_cast<std::chrono::microseconds>(lane.maxLateness).count()
+               << "us\n";
+        for (const auto &[workerId, stats] : lane.stats) {
+            const auto avgLatenessUs =
+                    stats.processed == 0
+                            ? 0
+                            : std::chrono::duration_cast<std::chrono::microseconds>(
+                                      stats.totalLateness)
+                                              .count() /
+                                      static_cast<int64_t>(stats.processed);
+            stream << "Worker " << std::hex << workerId << std::dec << ": depth " << stats.depth
+                   << " max depth " << stats.maxDepth << " processed " << stats.processed
+                   << " coalesced " << stats.coalesced << " lateness avg " << avgLatenessUs
+                   << "us max "
+                   << std::chrono::duration_cast<std::chrono::microseconds>(stats.maxLateness)
+                              .count()
+                   << "us\n";
+        }
+    }
+}
 
-        if (!mRunning)
-            break;
-        if (mPackageQueue.empty())
+void PriorityQueueWorkerPool::loop(Lane *lane, size_t threadId) {
+    std::vector<TimerWheel::Expired> expired;
+    std::unique_lock<std::mutex> lock(lane->mutex);
+    while (lane->running) {
+        const auto now = std::chrono::steady_clock::now();
+        lane->wheel.advance(now, &expired);
+        if (expired.empty()) {
+            // Wait until signal or the next deadline, spurious wakeups just
+            // go around the loop again
+            auto &wakeup = lane->waiterWakeups[threadId];
+            wakeup = lane->wheel.nextWakeup();
+            lane->cv.wait_until(lock, wakeup);
+            wakeup = std::chrono::steady_clock::time_point::min();
             continue;
+        }
 
-        // Copy work entry from queue and unlock
-        package = mPackageQueue.top();
-        mPackageQueue.pop();
+        recordExpiredLocked(lane, now, expired);
         lock.unlock();
+        runExpired(expired);
+        expired.clear();
+        lock.lock();
+    }
+}
 
-        // Find callback based on package's callback id
-        {
-            std::shared_lock<std::shared_mutex> lockCb(mSharedMutex);
-            auto callbackItr = mCallbackMap.find(package.templateQueueWorkerId);
-            if (callbackItr == mCallbackMap.end()) {
-                // Callback was removed before package could be worked on, that's ok just ignore
-                continue;
+void PriorityQueueWorkerPool::runDue(std::chrono::steady_clock::time_point now) {
+    std::vector<TimerWheel::Expired> expired;
+    bool ran = true;
+    while (ran) {
+        ran = false;
+        for (auto &lane : mLanes) {
+            {
+                std::lock_guard<std::mutex> lock(lane.mutex);
+                lane.wheel.advance(now, &expired);
+                recordExpiredLocked(&lane, now, expired);
+            }
+            if (!expired.empty()) {
+                runExpired(expired);
+                expired.clear();
+                ran = true;
             }
-            // Exceptions disabled so no need to wrap this
-            callbackItr->second(package.packageId);
         }
     }
 }
 
+void PriorityQueueWorkerPool::recordExpiredLocked(
+        Lane *lane, std::chrono::steady_clock::time_point now,
+        const std::vector<TimerWheel::Expired> &expired) {
+    for (const auto &e : expired) {
+        const auto lateness = std::chrono::nanoseconds(now - e.deadline);
+        lane->maxLateness = std::max(lane->maxLateness, lateness);
+        auto stats = lane->stats.find(e.key.workerId);
+        if (stats == lane->stats.end()) {
+            continue;
+        }
+        stats->second.depth = stats->second.depth > 0 ? stats->second.depth - 1 : 0;
+        stats->second.processed++;
+        stats->second.totalLateness += lateness;
+        stats->second.maxLateness = std::max(stats->second.maxLateness, lateness);
+    }
+}
+
+void PriorityQueueWorkerPool::runExpired(const std::vector<TimerWheel::Expired> &expired) {
+    // Find callback based on package's callback id
+    std::shared_lock<std::shared_mutex> lockCb(mSharedMutex);
+    for (const auto &e : expired) {
+        auto callbackItr = mCallbackMap.find(e.key.workerId);
+        if (callbackItr == mCallbackMap.end()) {
+            // Callback was removed before package could be worked on, that's ok just
+            // ignore
+            continue;
+        }
+        // Exceptions disabled so no need to wrap this
+        callbackItr->second(e.key.id);
+    }
+}
+
 }  // namespace pixel
 }  // namespace impl
 }  // namespace power
@@ -16,15 +16,19 @@
 
 #pragma once
 
+#include <array>
 #include <chrono>
 #include <condition_variable>
 #include <functional>
 #include <mutex>
-#include <queue>
+#include <optional>
+#include <ostream>
 #include <shared_mutex>
 #include <string>
 #include <thread>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "AdpfTypes.h"
 
@@ -35,51 +39,176 @@ namespace power {
 namespace impl {
 namespace pixel {
 
-// Background thread processing from priority queue based on time deadline
+// Hierarchical timer wheel with 1ms ticks: three levels of 64 slots cover
+// ~262s, later timers wait in the last level until they get close enough.
+// A timer is identified by its key, scheduling a key which is already pending
+// moves that timer instead of adding another one. Scheduling and cancelling
+// are O(1). Not thread safe, the owner provides the locking.
+class TimerWheel {
+  public:
+    using Clock = std::chrono::steady_clock;
+    struct Key {
+        int64_t workerId{0};
+        int64_t id{0};
+        bool operator==(const Key &) const = default;
+    };
+    struct Expired {
+        Key key;
+        Clock::time_point deadline;
+    };
+    static constexpr std::chrono::milliseconds kTick{1};
+
+    explicit TimerWheel(Clock::time_point start = Clock::now());
+    // Return true if a new timer was added, false if a pending one was moved
+    bool schedule(const Key &key, Clock::time_point deadline);
+    // Return false if key isn't pending
+    bool cancel(const Key &key);
+    // Advance the wheel to now and append the timers which are due to expired
+    void advance(Clock::time_point now, std::vector<Expired> *expired);
+    // Time the wheel has to be advanced next, time_point::max() if empty
+    Clock::time_point nextWakeup() const;
+    size_t size() const { return mIndex.size(); }
+
+  private:
+    static constexpr int kLevelBits = 6;
+    static constexpr int64_t kSlots = 1 << kLevelBits;
+    static constexpr int kLevels = 3;
+    static constexpr uint32_t kNil = UINT32_MAX;
+    static constexpr int64_t kNone = INT64_MAX;
+
+    struct Node {
+        Key key;
+        Clock::time_point deadline;
+        int64_t expiry{0};
+        // Circular list of the slot, the first kLevels * kSlots nodes are the
+        // sentinels of the slots. Free nodes are chained through next.
+        uint32_t prev{kNil};
+        uint32_t next{kNil};
+    };
+    struct KeyHash {
+        size_t operator()(const Key &key) const {
+            return std::hash<int64_t>()(key.workerId) ^ (std::hash<int64_t>()(key.id) << 1);
+        }
+    };
+
+    static uint32_t slotIndex(int level, int64_t tick) {
+        return level * kSlots + ((tick >> (level * kLevelBits)) & (kSlots - 1));
+    }
+    bool slotEmpty(uint32_t slot) const { return mNodes[slot].next == slot; }
+    int64_t toTick(Clock::time_point t) const;
+    Clock::time_point toTime(int64_t tick) const;
+    int64_t nextEventTick() const;
+    void link(uint32_t node);
+    void unlink(uint32_t node);
+    uint32_t allocNode();
+    void cascade(int level, int64_t tick);
+    void collect(int64_t tick, std::vector<Expired> *expired);
+
+    const Clock::time_point mStart;
+    int64_t mCurrentTick{0};
+    std::vector<Node> mNodes;
+    uint32_t mFreeList{kNil};
+    std::unordered_map<Key, uint32_t, KeyHash> mIndex;
+};
+
+// Lanes of a PriorityQueueWorkerPool. Each lane has its own threads and
+// timers, so a burst of slow work in one lane doesn't delay the others.
+enum class WorkerLane : size_t {
+    // Work the uclamp of the sessions waits on, such as releasing votes
+    REALTIME,
+    // Housekeeping
+    NORMAL,
+    LANE_SIZE
+};
+constexpr size_t kNumWorkerLanes = static_cast<size_t>(WorkerLane::LANE_SIZE);
+
+// Background thread processing timed work packages based on time deadline
 // This class isn't meant to be used directly, use TemplatePriorityQueueWorker below
 class PriorityQueueWorkerPool {
   public:
+    struct LaneConfig {
+        size_t threadCount{0};
+        // Used for naming threads to help with debugging
+        std::string threadNamePrefix;
+        // SCHED_FIFO priority of the threads, 0 keeps them SCHED_OTHER
+        int fifoPriority{0};
+    };
+
     // CTOR
-    // thread count is number of threads to create in thread pool
+    // thread count is number of threads to create in thread pool, all of them
+    // serving the NORMAL lane
     // thread name prefix is use for naming threads to help with debugging
     PriorityQueueWorkerPool(size_t threadCount, const std::string &threadNamePrefix);
+    // Lanes without threads hand their work to the NORMAL lane, which should
+    // have at least one
+    explicit PriorityQueueWorkerPool(const std::array<LaneConfig, kNumWorkerLanes> &lanes);
     // DTOR
     ~PriorityQueueWorkerPool();
-    // Map callback id to callback function
-    void addCallback(int64_t templateQueueWorkerId, std::function<void(int64_t)> callback);
+    // Map callback id to callback function, its work runs in lane
+    void addCallback(int64_t templateQueueWorkerId, std::function<void(int64_t)> callback,
+                     WorkerLane lane = WorkerLane::NORMAL);
     // Unmap callback id with callback function
     void removeCallback(int64_t templateQueueWorkerId);
-    // Schedule work for specific worker id with package id to be run at time deadline
+    // Schedule work for specific worker id with package id to be run at time deadline,
+    // scheduling a package id which is still pending moves it to the new deadline
     void schedule(int64_t templateQueueWorkerId, int64_t packageId,
                   std::chrono::steady_clock::time_point deadline);
+    // Drop pending work, return false if it wasn't pending
+    bool cancel(int64_t templateQueueWorkerId, int64_t packageId);
+    // Dump queue depth and lateness per lane and worker
+    void dumpToStream(std::ostream &stream);
+    // Stop the threads, the work is then only run by runDue(). For driving
+    // the pool from a virtual clock, as the ADPF replay does.
+    void stopThreads();
+    // Run the work due by now on the calling thread, including work it
+    // schedules which is due by now too
+    void runDue(std::chrono::steady_clock::time_point now);
 
   private:
-    // Thread coordination
-    std::mutex mMutex;
-    bool mRunning;
-    std::condition_variable mCv;
-    std::vector<std::thread> mThreadPool;
-    void loop();
-
-    // Work package with worker id to find correct callback in
-    struct Package {
-        Package() {}
-        Package(std::chrono::steady_clock::time_point pDeadline, int64_t pTemplateQueueWorkerId,
-                int64_t pPackageId)
-            : deadline(pDeadline),
-              templateQueueWorkerId(pTemplateQueueWorkerId),
-              packageId(pPackageId) {}
-        std::chrono::steady_clock::time_point deadline;
-        int64_t templateQueueWorkerId{0};
-        int64_t packageId{0};
-        // Sort time earliest first
-        bool operator<(const Package &p) const { return deadline > p.deadline; }
+    struct WorkerStats {
+        size_t depth{0};
+        size_t maxDepth{0};
+        uint64_t processed{0};
+        uint64_t coalesced{0};
+        std::chrono::nanoseconds totalLateness{0};
+        std::chrono::nanoseconds maxLateness{0};
     };
-    std::priority_queue<Package> mPackageQueue;
+    struct Lane {
+        // Thread coordination
+        std::mutex mutex;
+        bool running{true};
+        std::condition_variable cv;
+        std::vector<std::thread> threads;
+
+        TimerWheel wheel;
+        // Time each thread wakes up by itself while it waits, min() while it
+        // runs work, indexed like threads
+        std::vector<std::chrono::steady_clock::time_point> waiterWakeups;
+
+        size_t maxDepth{0};
+        std::chrono::nanoseconds maxLateness{0};
+        std::unordered_map<int64_t, WorkerStats> stats;
+    };
+
+    void startLane(WorkerLane lane, const LaneConfig &config);
+    // Lane the work of the worker runs in, nullptr if it has no callback
+    Lane *findLane(int64_t templateQueueWorkerId);
+    void loop(Lane *lane, size_t threadId);
+    // Count the expired work of lane in its stats, with lane->mutex held
+    void recordExpiredLocked(Lane *lane, std::chrono::steady_clock::time_point now,
+                             const std::vector<TimerWheel::Expired> &expired);
+    // Run the callbacks of the expired work
+    void runExpired(const std::vector<TimerWheel::Expired> &expired);
+
+    std::array<Lane, kNumWorkerLanes> mLanes;
 
     // Callback management
     std::shared_mutex mSharedMutex;
     std::unordered_map<int64_t, std::function<void(int64_t)>> mCallbackMap;
+    // Looked up on every schedule, also from within callbacks which run
+    // holding mSharedMutex, so it has a mutex of its own
+    std::mutex mWorkerLanesMutex;
+    std::unordered_map<int64_t, WorkerLane> mWorkerLanes;
 };
 
 // Generic templated worker for registering a single std::function callback one time
@@ -90,14 +219,17 @@ class PriorityQueueWorkerPool {
 template <typename PACKAGE>
 class TemplatePriorityQueueWorker {
   public:
-    // CTOR, callback to run when added work is run, worker to use for adding work to
+    // CTOR, callback to run when added work is run, worker to use for adding work to,
+    // lane of the worker running it
     TemplatePriorityQueueWorker(std::function<void(const PACKAGE &)> cb,
-                                std::shared_ptr<PriorityQueueWorkerPool> worker)
+                                std::shared_ptr<PriorityQueueWorkerPool> worker,
+                                WorkerLane lane = WorkerLane::NORMAL)
         : mCallbackId(reinterpret_cast<std::intptr_t>(this)), mCallback(cb), mWorker(worker) {
         if (!mCallback) {
             mCallback = [](const auto &) {};
         }
-        mWorker->addCallback(mCallbackId, [&](int64_t packageId) { process(packageId); });
+        mWorker->addCallback(
+                mCallbackId, [&](int64_t packageId) { process(packageId); }, lane);
     }
 
     // DTOR
@@ -105,15 +237,57 @@ class TemplatePriorityQueueWorker {
 
     void schedule(const PACKAGE &package,
                   std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now()) {
+        int64_t packageId;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            packageId = ++mPackageIdCounter;
+            mPackages.emplace(packageId, Entry{package, std::nullopt});
+        }
+        mWorker->schedule(mCallbackId, packageId, t);
+    }
+
+    // Schedule package under key, replacing the package and deadline of the
+    // key if it is still pending so repeated reschedules share a single timer.
+    void scheduleKeyed(int64_t key, const PACKAGE &package,
+                       std::chrono::steady_clock::time_point t) {
+        int64_t packageId;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto itr = mKeyedIds.find(key);
+            if (itr != mKeyedIds.end()) {
+                packageId = itr->second;
+                mPackages[packageId].package = package;
+            } else {
+                packageId = ++mPackageIdCounter;
+                mKeyedIds.emplace(key, packageId);
+                mPackages.emplace(packageId, Entry{package, key});
+            }
+        }
+        mWorker->schedule(mCallbackId, packageId, t);
+    }
+
+    // Drop the pending package of key
+    void cancelKeyed(int64_t key) {
+        int64_t packageId;
         {
             std::lock_guard<std::mutex> lock(mMutex);
-            ++mPackageIdCounter;
-            mPackages.emplace(mPackageIdCounter, package);
+            auto itr = mKeyedIds.find(key);
+            if (itr == mKeyedIds.end()) {
+                return;
+            }
+            packageId = itr->second;
+            mKeyedIds.erase(itr);
+            mPackages.erase(packageId);
         }
-        mWorker->schedule(mCallbackId, mPackageIdCounter, t);
+        mWorker->cancel(mCallbackId, packageId);
     }
 
   private:
+    struct Entry {
+        PACKAGE package;
+        std::optional<int64_t> key;
+    };
+
     int64_t mCallbackId{0};
     std::function<void(const PACKAGE &)> mCallback;
     // Must ensure PriorityQueueWorker does not go out of scope before this class does
@@ -124,7 +298,9 @@ class TemplatePriorityQueueWorker {
     // Want a container that is:
     // fast to add, fast random find find, fast random removal,
     // and with reasonable space efficiency
-    std::unordered_map<int64_t, PACKAGE> mPackages;
+    std::unordered_map<int64_t, Entry> mPackages;
+    // Package id of each pending keyed package
+    std::unordered_map<int64_t, int64_t> mKeyedIds;
 
     void process(int64_t packageId) {
         PACKAGE package;
@@ -136,7 +312,10 @@ class TemplatePriorityQueueWorker {
                 return;
             }
 
-            package = itr->second;
+            package = itr->second.package;
+            if (itr->second.key) {
+                mKeyedIds.erase(*itr->second.key);
+            }
             mPackages.erase(itr);
         }
         mCallback(package);
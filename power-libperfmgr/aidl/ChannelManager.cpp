@@ -0,0 +1,271 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "powerhal-libperfmgr"
+#define ATRACE_TAG (ATRACE_TAG_POWER | ATRACE_TAG_HAL)
+
+#include "ChannelManager.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <pthread.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "tests/mocks/MockPowerHintSession.h"
+#include "tests/mocks/MockPowerSessionManager.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+using ChannelMessageContents = ChannelMessage::ChannelMessageContents;
+
+template <class PowerSessionManagerT, class PowerHintSessionT>
+SessionChannel<PowerSessionManagerT, PowerHintSessionT>::SessionChannel(int32_t tgid,
+                                                                        int32_t uid)
+    : mTgid(tgid), mUid(uid), mQueue(std::make_unique<ChannelQueue>(kQueueSize, true)) {
+    if (!mQueue->isValid()) {
+        LOG(ERROR) << "Failed to create session channel queue for tgid " << tgid << " uid " << uid;
+        return;
+    }
+    if (EventFlag::createEventFlag(mQueue->getEventFlagWord(), &mEventFlag) != ::android::OK) {
+        LOG(ERROR) << "Failed to create session channel event flag for tgid " << tgid << " uid "
+                   << uid;
+        mEventFlag = nullptr;
+        return;
+    }
+    mReader = std::thread([this]() { readerLoop(); });
+    const std::string threadName = "ADPF_FMQ_" + std::to_string(tgid);
+    pthread_setname_np(mReader.native_handle(), threadName.substr(0, 15).c_str());
+}
+
+template <class PowerSessionManagerT, class PowerHintSessionT>
+SessionChannel<PowerSessionManagerT, PowerHintSessionT>::~SessionChannel() {
+    mStopping.store(true);
+    if (mReader.joinable()) {
+        // Wake the reader with the write bit, it checks mStopping first.
+        mEventFlag->wake(kWriteBit);
+        mReader.join();
+    }
+    if (mEventFlag != nullptr) {
+        EventFlag::deleteEventFlag(&mEventFlag);
+    }
+}
+
+template <class PowerSessionManagerT, class PowerHintSessionT>
+bool SessionChannel<PowerSessionManagerT, PowerHintSessionT>::isValid() const {
+    return mQueue->isValid() && mEventFlag != nullptr;
+}
+
+template <class PowerSessionManagerT, class PowerHintSessionT>
+void SessionChannel<PowerSessionManagerT, PowerHintSessionT>::getDesc(ChannelConfig *config) {
+    config->channelDescriptor = mQueue->dupeDesc();
+    config->readFlagBitmask = kReadBit;
+    config->writeFlagBitmask = kWriteBit;
+    // The event flag word is part of the queue, no separate flag queue needed.
+    config->eventFlagDescriptor = std::nullopt;
+}
+
+template <class PowerSessionManagerT, class PowerHintSessionT>
+void SessionChannel<PowerSessionManagerT, PowerHintSessionT>::readerLoop() {
+    std::vector<ChannelMessage> batch(kQueueSize);
+    while (!mStopping.load()) {
+        uint32_t state = 0;
+        // No timeout, retry on spurious wakeups; the destructor wakes us.
+        mEventFlag->wait(kWriteBit, &state, 0, true);
+        if (mStopping.load()) {
+            break;
+        }
+        size_t count = std::min(mQueue->availableToRead(), batch.size());
+        if (count == 0) {
+            continue;
+        }
+        if (!mQueue->read(batch.data(), count)) {
+            LOG(ERROR) << "Failed to read " << count << " messages from session channel of tgid "
+                       << mTgid;
+            continue;
+        }
+        // Let a writer blocked on a full queue go before doing the work.
+        mEventFlag->wake(kReadBit);
+        mWakeups.fetch_add(1, std::memory_order_relaxed);
+        mMessages.fetch_add(count, std::memory_order_relaxed);
+        if (count > mMaxBatch.load(std::memory_order_relaxed)) {
+            mMaxBatch.store(count, std::memory_order_relaxed);
+        }
+        if (ATRACE_ENABLED()) {
+            ATRACE_INT(("adpf.fmq." + std::to_string(mTgid) + "-batch").c_str(), count);
+        }
+        dispatch(batch.data(), count);
+    }
+}
+
+template <class PowerSessionManagerT, class PowerHintSessionT>
+std::shared_ptr<PowerHintSessionT>
+SessionChannel<PowerSessionManagerT, PowerHintSessionT>::getSession(int32_t sessionId) {
+    auto session = std::static_pointer_cast<PowerHintSessionT>(
+            PowerSessionManagerT::getInstance()->getSession(sessionId));
+    if (session && !session->isOwnedBy(mTgid, mUid)) {
+        // Don't let a channel reach into the sessions of another app.
+        return nullptr;
+    }
+    return session;
+}
+
+template <class PowerSessionManagerT, class PowerHintSessionT>
+void SessionChannel<PowerSessionManagerT, PowerHintSessionT>::reportWorkDurations(
+        int32_t sessionId, const std::vector<WorkDuration> &durations) {
+    if (durations.empty()) {
+        return;
+    }
+    auto session = getSession(sessionId);
+    if (!session) {
+        mDropped.fetch_add(durations.size(), std::memory_order_relaxed);
+        return;
+    }
+    session->reportActualWorkDuration(durations);
+}
+
+template <class PowerSessionManagerT, class PowerHintSessionT>
+void SessionChannel<PowerSessionManagerT, PowerHintSessionT>::dispatch(
+        const ChannelMessage *messages, size_t count) {
+    std::vector<WorkDuration> durations;
+    int32_t durationsSessionId = 0;
+    for (size_t i = 0; i < count; i++) {
+        const ChannelMessage &message = messages[i];
+        const auto tag = message.data.getTag();
+        if (tag == ChannelMessageContents::Tag::workDuration) {
+            if (!durations.empty() && durationsSessionId != message.sessionID) {
+                reportWorkDurations(durationsSessionId, durations);
+                durations.clear();
+            }
+            const auto &fixed = message.data.get<ChannelMessageContents::Tag::workDuration>();
+            durationsSessionId = message.sessionID;
+            WorkDuration &duration = durations.emplace_back();
+            duration.timeStampNanos = message.timeStampNanos;
+            duration.durationNanos = fixed.durationNanos;
+            duration.workPeriodStartTimestampNanos = fixed.workPeriodStartTimestampNanos;
+            duration.cpuDurationNanos = fixed.cpuDurationNanos;
+            duration.gpuDurationNanos = fixed.gpuDurationNanos;
+            continue;
+        }
+        // Keep the order of the messages of a session.
+        reportWorkDurations(durationsSessionId, durations);
+        durations.clear();
+
+        auto session = getSession(message.sessionID);
+        if (!session) {
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        switch (tag) {
+            case ChannelMessageContents::Tag::targetDuration:
+                session->updateTargetWorkDuration(
+                        message.data.get<ChannelMessageContents::Tag::targetDuration>());
+                break;
+            case ChannelMessageContents::Tag::hint:
+                session->sendHint(message.data.get<ChannelMessageContents::Tag::hint>());
+                break;
+            case ChannelMessageContents::Tag::mode: {
+                const auto &mode = message.data.get<ChannelMessageContents::Tag::mode>();
+                session->setMode(mode.modeInt, mode.enabled);
+                break;
+            }
+            default:
+                mDropped.fetch_add(1, std::memory_order_relaxed);
+                break;
+        }
+    }
+    reportWorkDurations(durationsSessionId, durations);
+}
+
+template <class PowerSessionManagerT, class PowerHintSessionT>
+void SessionChannel<PowerSessionManagerT, PowerHintSessionT>::dumpToStream(
+        std::ostream &stream) {
+    stream << "tgid: " << mTgid << " uid: " << mUid << " wakeups: " << mWakeups.load()
+           << " messages: " << mMessages.load() << " max batch: " << mMaxBatch.load()
+           << " dropped: " << mDropped.load() << "\n";
+}
+
+template <class PowerSessionManagerT, class PowerHintSessionT>
+bool ChannelManager<PowerSessionManagerT, PowerHintSessionT>::getChannelConfig(
+        int32_t tgid, int32_t uid, ChannelConfig *config) {
+    const uint64_t key = channelKey(tgid, uid);
+    std::lock_guard<std::mutex> lock(mChannelsMutex);
+    auto it = mChannels.find(key);
+    if (it == mChannels.end()) {
+        auto channel = std::make_unique<ChannelT>(tgid, uid);
+        if (!channel->isValid()) {
+            return false;
+        }
+        it = mChannels.emplace(key, std::move(channel)).first;
+    }
+    it->second->getDesc(config);
+    return true;
+}
+
+template <class PowerSessionManagerT, class PowerHintSessionT>
+bool ChannelManager<PowerSessionManagerT, PowerHintSessionT>::closeChannel(int32_t tgid,
+                                                                           int32_t uid) {
+    std::unique_ptr<ChannelT> channel;
+    {
+        std::lock_guard<std::mutex> lock(mChannelsMutex);
+        auto it = mChannels.find(channelKey(tgid, uid));
+        if (it == mChannels.end()) {
+            return false;
+        }
+        channel = std::move(it->second);
+        mChannels.erase(it);
+    }
+    // Join the reader outside of the lock, it may be in the middle of a batch.
+    channel.reset();
+    return true;
+}
+
+template <class PowerSessionManagerT, class PowerHintSessionT>
+void ChannelManager<PowerSessionManagerT, PowerHintSessionT>::dumpToFd(int fd) {
+    std::ostringstream dump_buf;
+    dump_buf << "========== Begin ADPF session channels ==========\n";
+    {
+        std::lock_guard<std::mutex> lock(mChannelsMutex);
+        for (auto &[key, channel] : mChannels) {
+            channel->dumpToStream(dump_buf);
+        }
+    }
+    dump_buf << "========== End ADPF session channels ==========\n";
+    if (!::android::base::WriteStringToFd(dump_buf.str(), fd)) {
+        PLOG(ERROR) << "Failed to dump session channels to fd: " << fd;
+    }
+}
+
+template class SessionChannel<>;
+template class SessionChannel<testing::NiceMock<mock::pixel::MockPowerSessionManager>,
+                              testing::NiceMock<mock::pixel::MockPowerHintSession>>;
+template class ChannelManager<>;
+template class ChannelManager<testing::NiceMock<mock::pixel::MockPowerSessionManager>,
+                              testing::NiceMock<mock::pixel::MockPowerHintSession>>;
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "AdpfTypes.h"
+#include "PowerHintSession.h"
+#include "PowerSessionManager.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+// A SessionChannel is the FMQ a single (tgid, uid) uses to send its session
+// updates without a binder transaction. The client writes ChannelMessages and
+// wakes kWriteBit; the reader thread drains everything available in one go,
+// wakes kReadBit so a blocked writer can continue, and forwards the messages
+// to their PowerHintSessions. Messages addressing a session which wasn't
+// created by the same tgid and uid are dropped.
+template <class PowerSessionManagerT = PowerSessionManager<>,
+          class PowerHintSessionT = PowerHintSession<>>
+class SessionChannel : public Immobile {
+  public:
+    static constexpr uint32_t kReadBit = 0x01;
+    static constexpr uint32_t kWriteBit = 0x02;
+    static constexpr size_t kQueueSize = 64;
+
+    SessionChannel(int32_t tgid, int32_t uid);
+    ~SessionChannel();
+
+    // Return false if the queue or its event flag couldn't be set up.
+    bool isValid() const;
+    void getDesc(ChannelConfig *config);
+    void dumpToStream(std::ostream &stream);
+
+  private:
+    void readerLoop();
+    // Forward a batch of messages, consecutive work durations of a session
+    // are reported together with a single call.
+    void dispatch(const ChannelMessage *messages, size_t count);
+    void reportWorkDurations(int32_t sessionId, const std::vector<WorkDuration> &durations);
+    std::shared_ptr<PowerHintSessionT> getSession(int32_t sessionId);
+
+    const int32_t mTgid;
+    const int32_t mUid;
+    std::unique_ptr<ChannelQueue> mQueue;
+    EventFlag *mEventFlag = nullptr;
+    std::atomic<bool> mStopping{false};
+    std::thread mReader;
+
+    // Reader stats, only written by the reader thread.
+    std::atomic<uint64_t> mWakeups{0};
+    std::atomic<uint64_t> mMessages{0};
+    std::atomic<uint64_t> mDropped{0};
+    std::atomic<size_t> mMaxBatch{0};
+};
+
+// ChannelManager owns the SessionChannel of every (tgid, uid) which asked for
+// one.
+template <class PowerSessionManagerT = PowerSessionManager<>,
+          class PowerHintSessionT = PowerHintSession<>>
+class ChannelManager : public Immobile {
+  public:
+    using ChannelT = SessionChannel<PowerSessionManagerT, PowerHintSessionT>;
+
+    ChannelManager() = default;
+    ~ChannelManager() = default;
+
+    // Return the existing channel of (tgid, uid), or create it. Return false
+    // if the queue couldn't be created.
+    bool getChannelConfig(int32_t tgid, int32_t uid, ChannelConfig *config);
+    // Stop the reader and free the queue, return false if there was none.
+    bool closeChannel(int32_t tgid, int32_t uid);
+    void dumpToFd(int fd);
+
+    // Singleton
+    static ChannelManager *getInstance() {
+        static ChannelManager instance{};
+        return &instance;
+    }
+
+  private:
+    static uint64_t channelKey(int32_t tgid, int32_t uid) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(tgid)) << 32) |
+               static_cast<uint32_t>(uid);
+    }
+
+    std::mutex mChannelsMutex;
+    std::map<uint64_t, std::unique_ptr<ChannelT>> mChannels GUARDED_BY(mChannelsMutex);
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "powerhal-libperfmgr"
+
+#include "CpuEnergyMeter.h"
+
+#include <android-base/logging.h>
+#include <android-base/properties.h>
+#include <android-base/strings.h>
+
+#include <algorithm>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+std::unique_ptr<CpuEnergyMeter> CpuEnergyMeter::create() {
+    const std::string device = ::android::base::GetProperty(kPowerHalAdpfEnergyDevice, "");
+    const std::string rails = ::android::base::GetProperty(kPowerHalAdpfEnergyRails, "");
+    if (device.empty() || rails.empty()) {
+        return nullptr;
+    }
+    const std::chrono::milliseconds period(
+            ::android::base::GetUintProperty<uint32_t>(kPowerHalAdpfEnergyPeriodMs, 10));
+    auto sampler = RailEnergySampler::create(device, period);
+    if (!sampler) {
+        LOG(WARNING) << "No CPU energy for ADPF, failed to capture the rails of " << device;
+        return nullptr;
+    }
+
+    std::vector<size_t> railIndices;
+    const auto &railNames = sampler->railNames();
+    for (const auto &rail : ::android::base::Split(rails, ",")) {
+        const auto it = std::find(railNames.begin(), railNames.end(), ::android::base::Trim(rail));
+        if (it == railNames.end()) {
+            LOG(WARNING) << "No CPU energy for ADPF, " << device << " has no rail " << rail;
+            return nullptr;
+        }
+        railIndices.push_back(it - railNames.begin());
+    }
+    LOG(INFO) << "CPU energy for ADPF from " << railIndices.size() << " rails of " << device;
+    return std::unique_ptr<CpuEnergyMeter>(
+            new CpuEnergyMeter(std::move(sampler), std::move(railIndices)));
+}
+
+std::optional<uint64_t> CpuEnergyMeter::readEnergyUWs() const {
+    std::vector<::android::hardware::google::pixel::powerstats::RailEnergySample> samples;
+    if (!mSampler->readLatest(&samples)) {
+        return std::nullopt;
+    }
+    uint64_t energyUWs = 0;
+    for (auto index : mRailIndices) {
+        energyUWs += samples[index].energyUWs;
+    }
+    return energyUWs;
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
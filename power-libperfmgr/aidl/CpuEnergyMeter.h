@@ -0,0 +1,68 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <railsampler/RailEnergySampler.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+// sysfs directory of the ODPM IIO device with the CPU cluster rails, e.g.
+// /sys/bus/iio/devices/iio:device0
+constexpr char kPowerHalAdpfEnergyDevice[] = "vendor.powerhal.adpf.energy_device";
+// Comma separated names of the CPU cluster rails on that device
+constexpr char kPowerHalAdpfEnergyRails[] = "vendor.powerhal.adpf.energy_rails";
+constexpr char kPowerHalAdpfEnergyPeriodMs[] = "vendor.powerhal.adpf.energy_period_ms";
+
+// The energy of the CPU clusters so far, from the ODPM rails captured by a
+// RailEnergySampler, for the energy aware ADPF mode. The sampler keeps the
+// latest sample in memory, so a read costs no syscall.
+class CpuEnergyMeter {
+  public:
+    // nullptr when the rails are not configured or can't be captured
+    static std::unique_ptr<CpuEnergyMeter> create();
+
+    // Sum of the energy of the CPU rails at the latest sample, nullopt if
+    // there is no sample yet
+    std::optional<uint64_t> readEnergyUWs() const;
+
+  private:
+    using RailEnergySampler = ::android::hardware::google::pixel::powerstats::RailEnergySampler;
+
+    CpuEnergyMeter(std::unique_ptr<RailEnergySampler> sampler, std::vector<size_t> railIndices)
+        : mSampler(std::move(sampler)), mRailIndices(std::move(railIndices)) {}
+
+    const std::unique_ptr<RailEnergySampler> mSampler;
+    // Of the CPU rails in the samples
+    const std::vector<size_t> mRailIndices;
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -16,6 +16,9 @@
 
 #include "GpuCalculationHelpers.h"
 
+#include <algorithm>
+#include <cmath>
+
 using std::literals::chrono_literals::operator""ns;
 using std::chrono::duration;
 using std::chrono::duration_cast;
@@ -70,6 +73,85 @@ Cycles calculate_capacity(WorkDuration observation, nanoseconds target, Frequenc
     return gpu_frequency * gpu_delta;
 }
 
+Cycles GpuCapacityFilter::update(Cycles request, double up_rate, double down_rate) {
+    auto const sample = static_cast<double>(static_cast<int>(request));
+    auto const rate = std::clamp(sample > mValue ? up_rate : down_rate, 0.0, 1.0);
+
+    mValue += (sample - mValue) * rate;
+
+    mTrajectory[mTrajectoryNext] = value();
+    mTrajectoryNext = (mTrajectoryNext + 1) % kTrajectorySize;
+    mTrajectoryCount = std::min(mTrajectoryCount + 1, kTrajectorySize);
+    return value();
+}
+
+void GpuCapacityFilter::reset() {
+    mValue = 0.0;
+    mTrajectoryNext = 0;
+    mTrajectoryCount = 0;
+}
+
+Cycles GpuCapacityFilter::value() const {
+    return Cycles(static_cast<int>(std::lround(mValue)));
+}
+
+void GpuCapacityFilter::dumpToStream(std::ostream &stream) const {
+    size_t const first = (mTrajectoryNext + kTrajectorySize - mTrajectoryCount) % kTrajectorySize;
+
+    stream << "GpuCapacity(";
+    for (size_t i = 0; i < mTrajectoryCount; i++) {
+        stream << (i ? " " : "") << static_cast<int>(mTrajectory[(first + i) % kTrajectorySize]);
+    }
+    stream << ")";
+}
+
+Cycles GpuCoBoost::update(double uclamp_min_rise, size_t frames, size_t missed_frames,
+                          double factor, Cycles max_capacity, uint32_t decay_frames) {
+    if (mFramesLeft > 0) {
+        mBoostedFrames += frames;
+        mBoostedMissedFrames += missed_frames;
+    } else {
+        mUnboostedFrames += frames;
+        mUnboostedMissedFrames += missed_frames;
+    }
+    mFramesLeft -= std::min<uint32_t>(mFramesLeft, frames);
+
+    if (uclamp_min_rise > 0 && decay_frames > 0) {
+        auto const peak = std::min(factor * uclamp_min_rise, 1.0) *
+                          static_cast<int>(max_capacity);
+        // A smaller spike during the decay doesn't cut the co-boost short
+        if (peak >= static_cast<double>(static_cast<int>(value()))) {
+            mPeak = peak;
+            mDecayFrames = decay_frames;
+            mFramesLeft = decay_frames;
+        }
+    }
+    return value();
+}
+
+void GpuCoBoost::reset() {
+    mPeak = 0.0;
+    mDecayFrames = 0;
+    mFramesLeft = 0;
+}
+
+Cycles GpuCoBoost::value() const {
+    if (mDecayFrames == 0) {
+        return Cycles(0);
+    }
+    return Cycles(static_cast<int>(std::lround(mPeak * mFramesLeft / mDecayFrames)));
+}
+
+void GpuCoBoost::dumpToStream(std::ostream &stream) const {
+    auto const missRate = [](uint64_t missed, uint64_t frames) {
+        return frames == 0 ? 0 : static_cast<int>(missed * 100 / frames);
+    };
+    stream << "GpuCoBoost(" << static_cast<int>(value()) << ", Missed%("
+           << missRate(mBoostedMissedFrames, mBoostedFrames) << " of " << mBoostedFrames
+           << " co-boosted, " << missRate(mUnboostedMissedFrames, mUnboostedFrames) << " of "
+           << mUnboostedFrames << " not))";
+}
+
 }  // namespace pixel
 }  // namespace impl
 }  // namespace power
@@ -18,7 +18,9 @@
 
 #include <aidl/android/hardware/power/WorkDuration.h>
 
+#include <array>
 #include <chrono>
+#include <ostream>
 
 #include "PhysicalQuantityTypes.h"
 
@@ -42,6 +44,53 @@ inline double gpu_time_attribution(std::chrono::nanoseconds total, std::chrono::
 Cycles calculate_capacity(WorkDuration observation, std::chrono::nanoseconds target,
                           Frequency gpu_frequency);
 
+// Smooths the per-frame capacity requests of a session with an exponentially
+// weighted moving average, so that the GPU frequency doesn't follow every
+// frame. Requests above the filtered value are weighted with up_rate and
+// requests below it with down_rate; a rate of 1 follows the request as is.
+class GpuCapacityFilter {
+  public:
+    Cycles update(Cycles request, double up_rate, double down_rate);
+    void reset();
+    Cycles value() const;
+    // Prints the filtered capacities of the last frames, oldest first.
+    void dumpToStream(std::ostream &stream) const;
+
+  private:
+    static constexpr size_t kTrajectorySize = 8;
+
+    double mValue{0.0};
+    std::array<Cycles, kTrajectorySize> mTrajectory{};
+    size_t mTrajectoryNext{0};
+    size_t mTrajectoryCount{0};
+};
+
+// Raises the GPU capacity of a session ahead of its GPU load when its CPU
+// demand spikes, since GPU frequency changes land frames after CPU boosts.
+// A rise of the uclamp min of the session, as a share of the uclamp range,
+// starts a co-boost of factor * rise * max_capacity, decaying linearly to
+// nothing over decay_frames frames. Also counts the missed frames with and
+// without a co-boost, to tell whether it helps.
+class GpuCoBoost {
+  public:
+    // The frames of a report ran with the co-boost of the previous one
+    Cycles update(double uclamp_min_rise, size_t frames, size_t missed_frames, double factor,
+                  Cycles max_capacity, uint32_t decay_frames);
+    void reset();
+    Cycles value() const;
+    // Prints the current co-boost and the miss rates with and without one.
+    void dumpToStream(std::ostream &stream) const;
+
+  private:
+    double mPeak{0.0};
+    uint32_t mDecayFrames{0};
+    uint32_t mFramesLeft{0};
+    uint64_t mBoostedFrames{0};
+    uint64_t mBoostedMissedFrames{0};
+    uint64_t mUnboostedFrames{0};
+    uint64_t mUnboostedMissedFrames{0};
+};
+
 }  // namespace pixel
 }  // namespace impl
 }  // namespace power
@@ -20,6 +20,7 @@
 #include "GpuCapacityNode.h"
 
 #include <android-base/logging.h>
+#include <android-base/properties.h>
 #include <utils/Trace.h>
 
 #include <charconv>
@@ -40,11 +41,13 @@ GpuCapacityNode::~GpuCapacityNode() {
 
 GpuCapacityNode::GpuCapacityNode(std::unique_ptr<FdInterface> fd_interface,
                                  int validated_capacity_headroom_fd, int validated_frequency_fd,
-                                 std::string_view node_path)
+                                 std::string_view node_path,
+                                 std::chrono::nanoseconds coalesce_window)
     : fd_interface_(std::move(fd_interface)),
       capacity_node_path_(node_path),
       capacity_headroom_fd_(validated_capacity_headroom_fd),
-      frequency_fd_(validated_frequency_fd) {
+      frequency_fd_(validated_frequency_fd),
+      coalesce_window_(coalesce_window) {
     if (capacity_headroom_fd_ < 0) {
         LOG(FATAL) << ("precondition violation for GpuCapacityNode: invalid capacity_headroom_fd_");
     }
@@ -54,7 +57,8 @@ GpuCapacityNode::GpuCapacityNode(std::unique_ptr<FdInterface> fd_interface,
 }
 
 std::unique_ptr<GpuCapacityNode> GpuCapacityNode::init_gpu_capacity_node(
-        std::unique_ptr<FdInterface> fd_interface, std::string_view gpu_node_dir) {
+        std::unique_ptr<FdInterface> fd_interface, std::string_view gpu_node_dir,
+        std::chrono::nanoseconds coalesce_window) {
     static constexpr auto fd_flags_common = O_CLOEXEC | O_NONBLOCK;
     auto const capacity_headroom_file = std::string(gpu_node_dir) + "/capacity_headroom";
     auto const capacity_headroom_fd =
@@ -73,20 +77,86 @@ std::unique_ptr<GpuCapacityNode> GpuCapacityNode::init_gpu_capacity_node(
         return nullptr;
     }
     return std::make_unique<GpuCapacityNode>(std::move(fd_interface), capacity_headroom_fd,
-                                             frequency_fd, gpu_node_dir);
+                                             frequency_fd, gpu_node_dir, coalesce_window);
 }
 
-bool GpuCapacityNode::set_gpu_capacity(Cycles capacity) const {
-    std::lock_guard lk(capacity_mutex_);
+bool GpuCapacityNode::write_capacity_locked(Cycles capacity,
+                                            std::chrono::steady_clock::time_point now) const {
+    if (last_written_ == capacity) {
+        return true;
+    }
     auto const capacity_str = std::to_string(static_cast<int>(capacity));
     ATRACE_INT("gpuCapacitySet", static_cast<int>(static_cast<int>(capacity)));
+    writes_issued_++;
     auto const rc =
             fd_interface_->write(capacity_headroom_fd_, capacity_str.c_str(), capacity_str.size());
-    if (!rc) {
+    if (rc < 0) {
         LOG(ERROR) << "could not write to capacity node: " << capacity_node_path_ << ": "
                    << strerror(errno);
+        last_written_.reset();
+        return false;
+    }
+    last_written_ = capacity;
+    last_write_time_ = now;
+    return true;
+}
+
+bool GpuCapacityNode::set_gpu_capacity(Cycles capacity) const {
+    std::lock_guard lk(capacity_mutex_);
+    writes_requested_++;
+    pending_.reset();
+    return write_capacity_locked(capacity, std::chrono::steady_clock::now());
+}
+
+std::optional<std::chrono::steady_clock::time_point> GpuCapacityNode::request_gpu_capacity(
+        Cycles capacity, std::chrono::steady_clock::time_point now) const {
+    std::lock_guard lk(capacity_mutex_);
+    writes_requested_++;
+    if (flush_due_) {
+        pending_ = capacity;
+        return {};
+    }
+    if (last_written_ == capacity) {
+        return {};
+    }
+    if (!last_written_ || now - last_write_time_ >= coalesce_window_) {
+        write_capacity_locked(capacity, now);
+        return {};
+    }
+    pending_ = capacity;
+    flush_due_ = true;
+    return last_write_time_ + coalesce_window_;
+}
+
+bool GpuCapacityNode::flush_gpu_capacity(std::chrono::steady_clock::time_point now) const {
+    std::lock_guard lk(capacity_mutex_);
+    flush_due_ = false;
+    if (!pending_) {
+        return true;
+    }
+    auto const capacity = *pending_;
+    pending_.reset();
+    return write_capacity_locked(capacity, now);
+}
+
+uint64_t GpuCapacityNode::writes_requested() const {
+    std::lock_guard lk(capacity_mutex_);
+    return writes_requested_;
+}
+
+uint64_t GpuCapacityNode::writes_issued() const {
+    std::lock_guard lk(capacity_mutex_);
+    return writes_issued_;
+}
+
+void GpuCapacityNode::dumpToStream(std::ostream &os) const {
+    std::lock_guard lk(capacity_mutex_);
+    os << "GpuCapacityNode: " << capacity_node_path_ << " requested " << writes_requested_
+       << ", issued " << writes_issued_;
+    if (last_written_) {
+        os << ", last " << static_cast<int>(*last_written_);
     }
-    return !rc;
+    os << "\n";
 }
 
 std::optional<Frequency> GpuCapacityNode::gpu_frequency() const {
@@ -133,7 +203,13 @@ std::optional<std::unique_ptr<GpuCapacityNode>> createGpuCapacityNode() {
     if (!path) {
         return {};
     }
-    return {GpuCapacityNode::init_gpu_capacity_node(std::make_unique<FdWriter>(), *path)};
+    auto const coalesce_window = std::chrono::microseconds(::android::base::GetIntProperty(
+            kPowerHalAdpfGpuCoalesceWindowUs,
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                    GpuCapacityNode::kDefaultCoalesceWindow)
+                    .count()));
+    return {GpuCapacityNode::init_gpu_capacity_node(std::make_unique<FdWriter>(), *path,
+                                                    coalesce_window)};
 }
 
 }  // namespace pixel
@@ -19,9 +19,11 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <chrono>
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <ostream>
 #include <string>
 #include <string_view>
 #include <utility>
@@ -61,27 +63,57 @@ struct FdWriter : FdInterface {
 };
 
 struct GpuCapacityNode final {
+    static constexpr std::chrono::nanoseconds kDefaultCoalesceWindow = std::chrono::milliseconds(1);
+
     // Exceptions should really be allowed, use exploded constructor pattern and provide
     // helper construction function.
     GpuCapacityNode(std::unique_ptr<FdInterface> fd_interface, int validated_capacity_headroom_fd,
-                    int validated_frequency_fd, std::string_view gpu_node_dir);
+                    int validated_frequency_fd, std::string_view gpu_node_dir,
+                    std::chrono::nanoseconds coalesce_window = kDefaultCoalesceWindow);
     static std::unique_ptr<GpuCapacityNode> init_gpu_capacity_node(
-            std::unique_ptr<FdInterface> fd_interface, std::string_view gpu_node_dir);
+            std::unique_ptr<FdInterface> fd_interface, std::string_view gpu_node_dir,
+            std::chrono::nanoseconds coalesce_window = kDefaultCoalesceWindow);
 
     ~GpuCapacityNode() noexcept;
 
+    // Write capacity now, unless it is the value last written.
     bool set_gpu_capacity(Cycles capacity) const;
+    // Coalescing variant of set_gpu_capacity: the capacity is written now if
+    // nothing was written within the coalesce window, otherwise it is kept
+    // pending and the latest pending value is written by flush_gpu_capacity.
+    // Return the time flush_gpu_capacity has to be called at, if it isn't
+    // already due.
+    std::optional<std::chrono::steady_clock::time_point> request_gpu_capacity(
+            Cycles capacity, std::chrono::steady_clock::time_point now) const;
+    bool flush_gpu_capacity(std::chrono::steady_clock::time_point now) const;
     std::optional<Frequency> gpu_frequency() const;
 
+    // Capacity changes requested by callers and sysfs writes actually issued
+    uint64_t writes_requested() const;
+    uint64_t writes_issued() const;
+    void dumpToStream(std::ostream &os) const;
+
   private:
+    bool write_capacity_locked(Cycles capacity, std::chrono::steady_clock::time_point now) const;
+
     std::unique_ptr<FdInterface> const fd_interface_;
     std::string const capacity_node_path_;
     int const capacity_headroom_fd_;
     int const frequency_fd_;
+    std::chrono::nanoseconds const coalesce_window_;
     std::mutex mutable freq_mutex_;
     std::mutex mutable capacity_mutex_;
+    // All guarded by capacity_mutex_
+    std::optional<Cycles> mutable last_written_;
+    std::chrono::steady_clock::time_point mutable last_write_time_;
+    std::optional<Cycles> mutable pending_;
+    bool mutable flush_due_ = false;
+    uint64_t mutable writes_requested_ = 0;
+    uint64_t mutable writes_issued_ = 0;
 };
 
+constexpr char kPowerHalAdpfGpuCoalesceWindowUs[] = "vendor.powerhal.adpf.gpu_coalesce_window_us";
+
 // There's not a global object factory or context in PowerHal, maybe introducing one would simplify
 // resource management.
 std::optional<std::unique_ptr<GpuCapacityNode>> createGpuCapacityNode();
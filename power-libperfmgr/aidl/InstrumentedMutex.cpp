@@ -0,0 +1,73 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "InstrumentedMutex.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+void InstrumentedMutex::lock() {
+    const auto start = std::chrono::steady_clock::now();
+    if (mMutex.try_lock()) {
+        mLockedAt = start;
+        mWait.Record(std::chrono::nanoseconds(0));
+        return;
+    }
+    mMutex.lock();
+    mLockedAt = std::chrono::steady_clock::now();
+    mWait.Record(mLockedAt - start);
+}
+
+void InstrumentedMutex::unlock() {
+    const auto held = std::chrono::steady_clock::now() - mLockedAt;
+    mMutex.unlock();
+    mHold.Record(held);
+}
+
+bool InstrumentedMutex::try_lock() {
+    if (!mMutex.try_lock()) {
+        return false;
+    }
+    mLockedAt = std::chrono::steady_clock::now();
+    mWait.Record(std::chrono::nanoseconds(0));
+    return true;
+}
+
+namespace {
+void dumpPercentiles(std::ostream &stream, const ::android::perfmgr::LatencyHistogram &h) {
+    stream << h.GetPercentile(50).count() << "/" << h.GetPercentile(90).count() << "/"
+           << h.GetPercentile(99).count() << "/" << h.GetMax().count() << "us";
+}
+}  // namespace
+
+void InstrumentedMutex::dumpToStream(std::ostream &stream, const char *name) const {
+    stream << name << ": " << mWait.GetCount() << " locks, wait ";
+    dumpPercentiles(stream, mWait);
+    stream << ", hold ";
+    dumpPercentiles(stream, mHold);
+    stream << " (p50/p90/p99/max)\n";
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+#include <perfmgr/LatencyHistogram.h>
+
+#include <chrono>
+#include <mutex>
+#include <ostream>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+// A std::mutex which keeps histograms of how long it is waited for and held,
+// to tell contention apart from long critical sections in dumps. Costs a
+// couple of steady_clock reads per lock on top of the mutex itself.
+class CAPABILITY("mutex") InstrumentedMutex {
+  public:
+    InstrumentedMutex() = default;
+    InstrumentedMutex(const InstrumentedMutex &) = delete;
+    InstrumentedMutex &operator=(const InstrumentedMutex &) = delete;
+
+    void lock() ACQUIRE();
+    void unlock() RELEASE();
+    bool try_lock() TRY_ACQUIRE(true);
+
+    const ::android::perfmgr::LatencyHistogram &waitTimes() const { return mWait; }
+    const ::android::perfmgr::LatencyHistogram &holdTimes() const { return mHold; }
+    // Write "name: n locks, wait p50/p90/p99/max us, hold p50/p90/p99/max us"
+    void dumpToStream(std::ostream &stream, const char *name) const;
+
+  private:
+    std::mutex mMutex;
+    // Only touched by the holder
+    std::chrono::steady_clock::time_point mLockedAt;
+    ::android::perfmgr::LatencyHistogram mWait;
+    ::android::perfmgr::LatencyHistogram mHold;
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PidController.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+namespace {
+
+inline int64_t ns_to_100us(int64_t ns) {
+    return ns / 100000;
+}
+
+inline int64_t windowStart(uint64_t window, int64_t length) {
+    return window == 0 || window > static_cast<uint64_t>(length)
+                   ? 0
+                   : length - static_cast<int64_t>(window);
+}
+
+}  // namespace
+
+PidOutput evaluatePid(const PidParams &params, const std::vector<WorkDuration> &actualDurations,
+                      PidState *state) {
+    const int64_t targetDurationNanos = params.targetDurationNanos;
+    const int64_t length = actualDurations.size();
+    const int64_t p_start = windowStart(params.samplingWindowP, length);
+    const int64_t i_start = windowStart(params.samplingWindowI, length);
+    const int64_t d_start = windowStart(params.samplingWindowD, length);
+    const int64_t dt = ns_to_100us(targetDurationNanos);
+    const int64_t outlierThreshold = targetDurationNanos * 20;
+
+    int64_t integral_error = state->integralError;
+    int64_t previous_error = state->previousError;
+    int64_t err_sum = 0;
+    int64_t derivative_sum = 0;
+    int64_t outlier = 0;
+    for (int64_t i = std::min({p_start, i_start, d_start}); i < length; i++) {
+        const int64_t actualDurationNanos = actualDurations[i].durationNanos;
+        if (std::abs(actualDurationNanos) > outlierThreshold &&
+            std::abs(actualDurationNanos) > std::abs(outlier)) {
+            outlier = actualDurationNanos;
+        }
+        const int64_t error = ns_to_100us(actualDurationNanos - targetDurationNanos);
+        if (i >= d_start) {
+            derivative_sum += error - previous_error;
+        }
+        if (i >= p_start) {
+            err_sum += error;
+        }
+        if (i >= i_start) {
+            integral_error = std::max(params.integralLow,
+                                      std::min(params.integralHigh, integral_error + error * dt));
+        }
+        previous_error = error;
+    }
+    state->integralError = integral_error;
+    state->previousError = previous_error;
+
+    PidOutput out;
+    out.errorAvg = err_sum / (length - p_start);
+    out.derivativeAvg = derivative_sum / dt / (length - d_start);
+    out.pOut = static_cast<int64_t>((err_sum > 0 ? params.pidPo : params.pidPu) * err_sum /
+                                    (length - p_start));
+    out.iOut = static_cast<int64_t>(params.pidI * integral_error);
+    out.dOut = static_cast<int64_t>((derivative_sum > 0 ? params.pidDo : params.pidDu) *
+                                    derivative_sum / dt / (length - d_start));
+    out.output = out.pOut + out.iOut + out.dOut;
+    out.outlierDurationNanos = outlier;
+    return out;
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/power/WorkDuration.h>
+
+#include <cstdint>
+#include <vector>
+
+using aidl::android::hardware::power::WorkDuration;
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+// Everything the PID loop reads from the ADPF profile for one report,
+// resolved once per batch instead of once per sample.
+struct PidParams {
+    int64_t targetDurationNanos{0};
+    uint64_t samplingWindowP{0};
+    uint64_t samplingWindowI{0};
+    uint64_t samplingWindowD{0};
+    double pidPo{0};
+    double pidPu{0};  // already scaled by the heuristic boost factor if active
+    double pidI{0};
+    double pidDo{0};
+    double pidDu{0};
+    int64_t integralHigh{0};  // PidIHigh / PidI
+    int64_t integralLow{0};   // PidILow / PidI
+};
+
+// PID state carried from one report to the next.
+struct PidState {
+    int64_t integralError{0};
+    int64_t previousError{0};
+};
+
+struct PidOutput {
+    int64_t errorAvg{0};
+    int64_t derivativeAvg{0};
+    int64_t pOut{0};
+    int64_t iOut{0};
+    int64_t dOut{0};
+    int64_t output{0};
+    // Sample furthest outside 20x the target, 0 if there is none.
+    int64_t outlierDurationNanos{0};
+};
+
+// Run the PID loop over a batch of actual durations, updating state in place.
+// All per-sample work is integer arithmetic on 100us units, the gains are
+// only applied to the accumulated errors once per batch. actualDurations
+// must not be empty.
+PidOutput evaluatePid(const PidParams &params, const std::vector<WorkDuration> &actualDurations,
+                      PidState *state);
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -23,17 +23,21 @@
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <android/binder_enums.h>
 #include <fmq/AidlMessageQueue.h>
 #include <fmq/EventFlag.h>
 #include <perfmgr/HintManager.h>
 #include <utils/Log.h>
 
+#include <algorithm>
 #include <mutex>
 #include <optional>
 
 #include "AdpfTypes.h"
+#include "ChannelManager.h"
 #include "PowerHintSession.h"
 #include "PowerSessionManager.h"
+#include "ThermalChannelConsumer.h"
 #include "disp-power/DisplayLowPower.h"
 
 namespace aidl {
@@ -42,12 +46,61 @@ namespace hardware {
 namespace power {
 namespace impl {
 namespace pixel {
+using ::android::perfmgr::HintId;
 using ::android::perfmgr::HintManager;
 
 constexpr char kPowerHalStateProp[] = "vendor.powerhal.state";
 constexpr char kPowerHalAudioProp[] = "vendor.powerhal.audio";
 constexpr char kPowerHalRenderingProp[] = "vendor.powerhal.rendering";
 
+// Last Mode of each interface version, nullopt for unknown versions
+static std::optional<Mode> lastModeOf(int32_t version) {
+    switch (version) {
+        case 5:
+            return Mode::AUTOMOTIVE_PROJECTION;
+        case 4:
+            [[fallthrough]];
+        case 3:
+            return Mode::GAME_LOADING;
+        case 2:
+            [[fallthrough]];
+        case 1:
+            return Mode::CAMERA_STREAMING_HIGH;
+        default:
+            return std::nullopt;
+    }
+}
+
+static std::optional<Boost> lastBoostOf(int32_t version) {
+    switch (version) {
+        case 5:
+            [[fallthrough]];
+        case 4:
+            [[fallthrough]];
+        case 3:
+            [[fallthrough]];
+        case 2:
+            [[fallthrough]];
+        case 1:
+            return Boost::CAMERA_SHOT;
+        default:
+            return std::nullopt;
+    }
+}
+
+// Size of a table indexed by the values of EnumT
+template <typename EnumT>
+static size_t enumTableSize() {
+    size_t size = 0;
+    for (const auto type : ndk::enum_range<EnumT>()) {
+        const auto index = static_cast<int32_t>(type);
+        if (index >= 0) {
+            size = std::max(size, static_cast<size_t>(index) + 1);
+        }
+    }
+    return size;
+}
+
 Power::Power(std::shared_ptr<DisplayLowPower> dlpw)
     : mDisplayLowPower(dlpw),
       mInteractionHandler(nullptr),
@@ -88,199 +141,213 @@ Power::Power(std::shared_ptr<DisplayLowPower> dlpw)
 
     auto status = this->getInterfaceVersion(&mServiceVersion);
     LOG(INFO) << "PowerHAL InterfaceVersion:" << mServiceVersion << " isOK: " << status.isOk();
+    mModeTable = buildModeTable();
+    mBoostTable = buildBoostTable();
+}
+
+std::vector<Power::ModeEntry> Power::buildModeTable() const {
+    std::vector<ModeEntry> table(enumTableSize<Mode>(),
+                                 {::android::perfmgr::kInvalidHintId, "", false, nullptr});
+    const auto lastMode = lastModeOf(mServiceVersion);
+    for (const auto type : ndk::enum_range<Mode>()) {
+        const auto index = static_cast<int32_t>(type);
+        if (index < 0) {
+            continue;
+        }
+        auto &entry = table[index];
+        entry.name = toString(type);
+        entry.hintId = HintManager::LookupHint(entry.name);
+        entry.inVersion = lastMode && index <= static_cast<int32_t>(*lastMode);
+        switch (type) {
+            case Mode::LOW_POWER:
+                entry.handler = &Power::setLowPowerMode;
+                break;
+            case Mode::SUSTAINED_PERFORMANCE:
+                entry.handler = &Power::setSustainedPerformanceMode;
+                break;
+            case Mode::VR:
+                entry.handler = &Power::setVrMode;
+                break;
+            case Mode::LAUNCH:
+                entry.handler = &Power::setLaunchMode;
+                break;
+            default:
+                entry.handler = &Power::setHintMode;
+                break;
+        }
+    }
+    return table;
+}
+
+std::vector<Power::BoostEntry> Power::buildBoostTable() const {
+    std::vector<BoostEntry> table(enumTableSize<Boost>(),
+                                  {::android::perfmgr::kInvalidHintId, "", false, nullptr});
+    const auto lastBoost = lastBoostOf(mServiceVersion);
+    for (const auto type : ndk::enum_range<Boost>()) {
+        const auto index = static_cast<int32_t>(type);
+        if (index < 0) {
+            continue;
+        }
+        auto &entry = table[index];
+        entry.name = toString(type);
+        entry.hintId = HintManager::LookupHint(entry.name);
+        entry.inVersion = lastBoost && index <= static_cast<int32_t>(*lastBoost);
+        entry.handler =
+                type == Boost::INTERACTION ? &Power::setInteractionBoost : &Power::setHintBoost;
+    }
+    return table;
+}
+
+const Power::ModeEntry *Power::getModeEntry(Mode type) const {
+    const auto index = static_cast<int32_t>(type);
+    if (index < 0 || static_cast<size_t>(index) >= mModeTable.size() ||
+        !mModeTable[index].handler) {
+        return nullptr;
+    }
+    return &mModeTable[index];
+}
+
+const Power::BoostEntry *Power::getBoostEntry(Boost type) const {
+    const auto index = static_cast<int32_t>(type);
+    if (index < 0 || static_cast<size_t>(index) >= mBoostTable.size() ||
+        !mBoostTable[index].handler) {
+        return nullptr;
+    }
+    return &mBoostTable[index];
 }
 
 ndk::ScopedAStatus Power::setMode(Mode type, bool enabled) {
-    LOG(DEBUG) << "Power setMode: " << toString(type) << " to: " << enabled;
+    const ModeEntry *entry = getModeEntry(type);
+    if (!entry) {
+        LOG(WARNING) << "Power setMode: unknown mode " << toString(type);
+        return ndk::ScopedAStatus::ok();
+    }
+    LOG(DEBUG) << "Power setMode: " << entry->name << " to: " << enabled;
     if (HintManager::GetInstance()->GetAdpfProfile() &&
         HintManager::GetInstance()->GetAdpfProfile()->mReportingRateLimitNs > 0) {
-        PowerSessionManager<>::getInstance()->updateHintMode(toString(type), enabled);
+        PowerSessionManager<>::getInstance()->updateHintMode(entry->name, enabled);
     }
-    switch (type) {
-        case Mode::LOW_POWER:
-            mDisplayLowPower->SetDisplayLowPower(enabled);
-            if (enabled) {
-                HintManager::GetInstance()->DoHint(toString(type));
-            } else {
-                HintManager::GetInstance()->EndHint(toString(type));
-            }
-            break;
-        case Mode::SUSTAINED_PERFORMANCE:
-            if (enabled && !mSustainedPerfModeOn) {
-                if (!mVRModeOn) {  // Sustained mode only.
-                    HintManager::GetInstance()->DoHint("SUSTAINED_PERFORMANCE");
-                } else {  // Sustained + VR mode.
-                    HintManager::GetInstance()->EndHint("VR");
-                    HintManager::GetInstance()->DoHint("VR_SUSTAINED_PERFORMANCE");
-                }
-                mSustainedPerfModeOn = true;
-            } else if (!enabled && mSustainedPerfModeOn) {
-                HintManager::GetInstance()->EndHint("VR_SUSTAINED_PERFORMANCE");
-                HintManager::GetInstance()->EndHint("SUSTAINED_PERFORMANCE");
-                if (mVRModeOn) {  // Switch back to VR Mode.
-                    HintManager::GetInstance()->DoHint("VR");
-                }
-                mSustainedPerfModeOn = false;
-            }
-            break;
-        case Mode::VR:
-            if (enabled && !mVRModeOn) {
-                if (!mSustainedPerfModeOn) {  // VR mode only.
-                    HintManager::GetInstance()->DoHint("VR");
-                } else {  // Sustained + VR mode.
-                    HintManager::GetInstance()->EndHint("SUSTAINED_PERFORMANCE");
-                    HintManager::GetInstance()->DoHint("VR_SUSTAINED_PERFORMANCE");
-                }
-                mVRModeOn = true;
-            } else if (!enabled && mVRModeOn) {
-                HintManager::GetInstance()->EndHint("VR_SUSTAINED_PERFORMANCE");
-                HintManager::GetInstance()->EndHint("VR");
-                if (mSustainedPerfModeOn) {  // Switch back to sustained Mode.
-                    HintManager::GetInstance()->DoHint("SUSTAINED_PERFORMANCE");
-                }
-                mVRModeOn = false;
-            }
-            break;
-        case Mode::LAUNCH:
-            if (mVRModeOn || mSustainedPerfModeOn) {
-                break;
-            }
-            [[fallthrough]];
-        case Mode::DOUBLE_TAP_TO_WAKE:
-            [[fallthrough]];
-        case Mode::FIXED_PERFORMANCE:
-            [[fallthrough]];
-        case Mode::EXPENSIVE_RENDERING:
-            [[fallthrough]];
-        case Mode::INTERACTIVE:
-            [[fallthrough]];
-        case Mode::DEVICE_IDLE:
-            [[fallthrough]];
-        case Mode::DISPLAY_INACTIVE:
-            [[fallthrough]];
-        case Mode::AUDIO_STREAMING_LOW_LATENCY:
-            [[fallthrough]];
-        case Mode::CAMERA_STREAMING_SECURE:
-            [[fallthrough]];
-        case Mode::CAMERA_STREAMING_LOW:
-            [[fallthrough]];
-        case Mode::CAMERA_STREAMING_MID:
-            [[fallthrough]];
-        case Mode::CAMERA_STREAMING_HIGH:
-            [[fallthrough]];
-        case Mode::GAME_LOADING:
-            [[fallthrough]];
-        default:
-            if (enabled) {
-                HintManager::GetInstance()->DoHint(toString(type));
-            } else {
-                HintManager::GetInstance()->EndHint(toString(type));
-            }
-            break;
+    (this->*entry->handler)(*entry, enabled);
+    return ndk::ScopedAStatus::ok();
+}
+
+void Power::setHintMode(const ModeEntry &entry, bool enabled) {
+    if (enabled) {
+        HintManager::GetInstance()->DoHint(entry.hintId);
+    } else {
+        HintManager::GetInstance()->EndHint(entry.hintId);
     }
+}
 
-    return ndk::ScopedAStatus::ok();
+void Power::setLowPowerMode(const ModeEntry &entry, bool enabled) {
+    mDisplayLowPower->SetDisplayLowPower(enabled);
+    setHintMode(entry, enabled);
 }
 
-ndk::ScopedAStatus Power::isModeSupported(Mode type, bool *_aidl_return) {
-    switch (mServiceVersion) {
-        case 5:
-            if (static_cast<int32_t>(type) <= static_cast<int32_t>(Mode::AUTOMOTIVE_PROJECTION))
-                break;
-            [[fallthrough]];
-        case 4:
-            [[fallthrough]];
-        case 3:
-            if (static_cast<int32_t>(type) <= static_cast<int32_t>(Mode::GAME_LOADING))
-                break;
-            [[fallthrough]];
-        case 2:
-            [[fallthrough]];
-        case 1:
-            if (static_cast<int32_t>(type) <= static_cast<int32_t>(Mode::CAMERA_STREAMING_HIGH))
-                break;
-            [[fallthrough]];
-        default:
-            *_aidl_return = false;
-            return ndk::ScopedAStatus::ok();
+void Power::setSustainedPerformanceMode(const ModeEntry &, bool enabled) {
+    if (enabled && !mSustainedPerfModeOn) {
+        if (!mVRModeOn) {  // Sustained mode only.
+            HintManager::GetInstance()->DoHint("SUSTAINED_PERFORMANCE");
+        } else {  // Sustained + VR mode.
+            HintManager::GetInstance()->EndHint("VR");
+            HintManager::GetInstance()->DoHint("VR_SUSTAINED_PERFORMANCE");
+        }
+        mSustainedPerfModeOn = true;
+    } else if (!enabled && mSustainedPerfModeOn) {
+        HintManager::GetInstance()->EndHint("VR_SUSTAINED_PERFORMANCE");
+        HintManager::GetInstance()->EndHint("SUSTAINED_PERFORMANCE");
+        if (mVRModeOn) {  // Switch back to VR Mode.
+            HintManager::GetInstance()->DoHint("VR");
+        }
+        mSustainedPerfModeOn = false;
     }
-    bool supported = HintManager::GetInstance()->IsHintSupported(toString(type));
-    // LOW_POWER handled insides PowerHAL specifically
-    if (type == Mode::LOW_POWER) {
-        supported = true;
+}
+
+void Power::setVrMode(const ModeEntry &, bool enabled) {
+    if (enabled && !mVRModeOn) {
+        if (!mSustainedPerfModeOn) {  // VR mode only.
+            HintManager::GetInstance()->DoHint("VR");
+        } else {  // Sustained + VR mode.
+            HintManager::GetInstance()->EndHint("SUSTAINED_PERFORMANCE");
+            HintManager::GetInstance()->DoHint("VR_SUSTAINED_PERFORMANCE");
+        }
+        mVRModeOn = true;
+    } else if (!enabled && mVRModeOn) {
+        HintManager::GetInstance()->EndHint("VR_SUSTAINED_PERFORMANCE");
+        HintManager::GetInstance()->EndHint("VR");
+        if (mSustainedPerfModeOn) {  // Switch back to sustained Mode.
+            HintManager::GetInstance()->DoHint("SUSTAINED_PERFORMANCE");
+        }
+        mVRModeOn = false;
+    }
+}
+
+void Power::setLaunchMode(const ModeEntry &entry, bool enabled) {
+    if (mVRModeOn || mSustainedPerfModeOn) {
+        return;
     }
-    if (!supported && HintManager::GetInstance()->IsAdpfProfileSupported(toString(type))) {
-        supported = true;
+    setHintMode(entry, enabled);
+}
+
+ndk::ScopedAStatus Power::isModeSupported(Mode type, bool *_aidl_return) {
+    const ModeEntry *entry = getModeEntry(type);
+    if (!entry || !entry->inVersion) {
+        *_aidl_return = false;
+        return ndk::ScopedAStatus::ok();
     }
-    LOG(INFO) << "Power mode " << toString(type) << " isModeSupported: " << supported;
+    // LOW_POWER handled insides PowerHAL specifically
+    const bool supported = type == Mode::LOW_POWER ||
+                           HintManager::GetInstance()->IsHintSupported(entry->hintId) ||
+                           HintManager::GetInstance()->IsAdpfProfileSupported(entry->name);
+    LOG(INFO) << "Power mode " << entry->name << " isModeSupported: " << supported;
     *_aidl_return = supported;
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Power::setBoost(Boost type, int32_t durationMs) {
-    LOG(DEBUG) << "Power setBoost: " << toString(type) << " duration: " << durationMs;
+    const BoostEntry *entry = getBoostEntry(type);
+    if (!entry) {
+        LOG(WARNING) << "Power setBoost: unknown boost " << toString(type);
+        return ndk::ScopedAStatus::ok();
+    }
+    LOG(DEBUG) << "Power setBoost: " << entry->name << " duration: " << durationMs;
     if (HintManager::GetInstance()->GetAdpfProfile() &&
         HintManager::GetInstance()->GetAdpfProfile()->mReportingRateLimitNs > 0) {
-        PowerSessionManager<>::getInstance()->updateHintBoost(toString(type), durationMs);
+        PowerSessionManager<>::getInstance()->updateHintBoost(entry->name, durationMs);
     }
-    switch (type) {
-        case Boost::INTERACTION:
-            if (mVRModeOn || mSustainedPerfModeOn) {
-                break;
-            }
-            mInteractionHandler->Acquire(durationMs);
-            break;
-        case Boost::DISPLAY_UPDATE_IMMINENT:
-            [[fallthrough]];
-        case Boost::ML_ACC:
-            [[fallthrough]];
-        case Boost::AUDIO_LAUNCH:
-            [[fallthrough]];
-        case Boost::CAMERA_LAUNCH:
-            [[fallthrough]];
-        case Boost::CAMERA_SHOT:
-            [[fallthrough]];
-        default:
-            if (mVRModeOn || mSustainedPerfModeOn) {
-                break;
-            }
-            if (durationMs > 0) {
-                HintManager::GetInstance()->DoHint(toString(type),
-                                                   std::chrono::milliseconds(durationMs));
-            } else if (durationMs == 0) {
-                HintManager::GetInstance()->DoHint(toString(type));
-            } else {
-                HintManager::GetInstance()->EndHint(toString(type));
-            }
-            break;
+    (this->*entry->handler)(*entry, durationMs);
+    return ndk::ScopedAStatus::ok();
+}
+
+void Power::setHintBoost(const BoostEntry &entry, int32_t durationMs) {
+    if (mVRModeOn || mSustainedPerfModeOn) {
+        return;
     }
+    if (durationMs > 0) {
+        HintManager::GetInstance()->DoHint(entry.hintId, std::chrono::milliseconds(durationMs));
+    } else if (durationMs == 0) {
+        HintManager::GetInstance()->DoHint(entry.hintId);
+    } else {
+        HintManager::GetInstance()->EndHint(entry.hintId);
+    }
+}
 
-    return ndk::ScopedAStatus::ok();
+void Power::setInteractionBoost(const BoostEntry &, int32_t durationMs) {
+    if (mVRModeOn || mSustainedPerfModeOn) {
+        return;
+    }
+    mInteractionHandler->Acquire(durationMs);
 }
 
 ndk::ScopedAStatus Power::isBoostSupported(Boost type, bool *_aidl_return) {
-    switch (mServiceVersion) {
-        case 5:
-            [[fallthrough]];
-        case 4:
-            [[fallthrough]];
-        case 3:
-            [[fallthrough]];
-        case 2:
-            [[fallthrough]];
-        case 1:
-            if (static_cast<int32_t>(type) <= static_cast<int32_t>(Boost::CAMERA_SHOT))
-                break;
-            [[fallthrough]];
-        default:
-            *_aidl_return = false;
-            return ndk::ScopedAStatus::ok();
-    }
-    bool supported = HintManager::GetInstance()->IsHintSupported(toString(type));
-    if (!supported && HintManager::GetInstance()->IsAdpfProfileSupported(toString(type))) {
-        supported = true;
+    const BoostEntry *entry = getBoostEntry(type);
+    if (!entry || !entry->inVersion) {
+        *_aidl_return = false;
+        return ndk::ScopedAStatus::ok();
     }
-    LOG(INFO) << "Power boost " << toString(type) << " isBoostSupported: " << supported;
+    const bool supported = HintManager::GetInstance()->IsHintSupported(entry->hintId) ||
+                           HintManager::GetInstance()->IsAdpfProfileSupported(entry->name);
+    LOG(INFO) << "Power boost " << entry->name << " isBoostSupported: " << supported;
     *_aidl_return = supported;
     return ndk::ScopedAStatus::ok();
 }
@@ -299,6 +366,10 @@ binder_status_t Power::dump(int fd, const char **, uint32_t) {
     // Dump nodes through libperfmgr
     HintManager::GetInstance()->DumpToFd(fd);
     PowerSessionManager<>::getInstance()->dumpToFd(fd);
+    ChannelManager<>::getInstance()->dumpToFd(fd);
+    ThermalChannelConsumer::getInstance()->dumpToFd(fd);
+    mInteractionHandler->DumpToFd(fd);
+    mDisplayLowPower->DumpToFd(fd);
     if (!::android::base::WriteStringToFd(buf, fd)) {
         PLOG(ERROR) << "Failed to dump state to fd";
     }
@@ -349,23 +420,16 @@ ndk::ScopedAStatus Power::createHintSessionWithConfig(
     return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Power::getSessionChannel(int32_t, int32_t, ChannelConfig *_aidl_return) {
-    static AidlMessageQueue<ChannelMessage, SynchronizedReadWrite> stubQueue{20, true};
-    static std::thread stubThread([&] {
-        ChannelMessage data;
-        // This loop will only run while there is data waiting
-        // to be processed, and blocks on a futex all other times
-        while (stubQueue.readBlocking(&data, 1, 0)) {
-        }
-    });
-    _aidl_return->channelDescriptor = stubQueue.dupeDesc();
-    _aidl_return->readFlagBitmask = 0x01;
-    _aidl_return->writeFlagBitmask = 0x02;
-    _aidl_return->eventFlagDescriptor = std::nullopt;
+ndk::ScopedAStatus Power::getSessionChannel(int32_t tgid, int32_t uid,
+                                            ChannelConfig *_aidl_return) {
+    if (!ChannelManager<>::getInstance()->getChannelConfig(tgid, uid, _aidl_return)) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
     return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Power::closeSessionChannel(int32_t, int32_t) {
+ndk::ScopedAStatus Power::closeSessionChannel(int32_t tgid, int32_t uid) {
+    ChannelManager<>::getInstance()->closeChannel(tgid, uid);
     return ndk::ScopedAStatus::ok();
 }
 
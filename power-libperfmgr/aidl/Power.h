@@ -17,10 +17,13 @@
 #pragma once
 
 #include <aidl/android/hardware/power/BnPower.h>
+#include <perfmgr/HintId.h>
 
 #include <atomic>
 #include <memory>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include "AdpfTypes.h"
 #include "disp-power/DisplayLowPower.h"
@@ -55,11 +58,46 @@ class Power : public ::aidl::android::hardware::power::BnPower {
     binder_status_t dump(int fd, const char **args, uint32_t numArgs) override;
 
   private:
+    // Everything setMode/setBoost and isModeSupported/isBoostSupported need
+    // about one enum value, resolved once when the service starts. Whether the
+    // config supports the hint is still asked per call through the HintId,
+    // since the config can be reloaded.
+    struct ModeEntry {
+        ::android::perfmgr::HintId hintId;
+        std::string name;
+        // Mode is part of the interface version the service runs
+        bool inVersion;
+        void (Power::*handler)(const ModeEntry &entry, bool enabled);
+    };
+    struct BoostEntry {
+        ::android::perfmgr::HintId hintId;
+        std::string name;
+        bool inVersion;
+        void (Power::*handler)(const BoostEntry &entry, int32_t durationMs);
+    };
+
+    // Return nullptr for values the service doesn't know about
+    const ModeEntry *getModeEntry(Mode type) const;
+    const BoostEntry *getBoostEntry(Boost type) const;
+    std::vector<ModeEntry> buildModeTable() const;
+    std::vector<BoostEntry> buildBoostTable() const;
+
+    void setHintMode(const ModeEntry &entry, bool enabled);
+    void setLowPowerMode(const ModeEntry &entry, bool enabled);
+    void setSustainedPerformanceMode(const ModeEntry &entry, bool enabled);
+    void setVrMode(const ModeEntry &entry, bool enabled);
+    void setLaunchMode(const ModeEntry &entry, bool enabled);
+    void setHintBoost(const BoostEntry &entry, int32_t durationMs);
+    void setInteractionBoost(const BoostEntry &entry, int32_t durationMs);
+
     std::shared_ptr<DisplayLowPower> mDisplayLowPower;
     std::unique_ptr<InteractionHandler> mInteractionHandler;
     std::atomic<bool> mVRModeOn;
     std::atomic<bool> mSustainedPerfModeOn;
     int32_t mServiceVersion;
+    // Indexed by enum value, built once mServiceVersion is known
+    std::vector<ModeEntry> mModeTable;
+    std::vector<BoostEntry> mBoostTable;
 };
 
 }  // namespace pixel
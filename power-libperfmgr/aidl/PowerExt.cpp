@@ -37,21 +37,13 @@ namespace power {
 namespace impl {
 namespace pixel {
 
+using ::android::perfmgr::HintId;
+using ::android::perfmgr::HintIdTable;
 using ::android::perfmgr::HintManager;
 
 ndk::ScopedAStatus PowerExt::setMode(const std::string &mode, bool enabled) {
     LOG(DEBUG) << "PowerExt setMode: " << mode << " to: " << enabled;
-
-    if (enabled) {
-        HintManager::GetInstance()->DoHint(mode);
-    } else {
-        HintManager::GetInstance()->EndHint(mode);
-    }
-    if (HintManager::GetInstance()->GetAdpfProfile() &&
-        HintManager::GetInstance()->GetAdpfProfile()->mReportingRateLimitNs > 0) {
-        PowerSessionManager<>::getInstance()->updateHintMode(mode, enabled);
-    }
-
+    setModeById(resolveHint(mode), enabled);
     return ndk::ScopedAStatus::ok();
 }
 
@@ -68,9 +60,38 @@ ndk::ScopedAStatus PowerExt::isModeSupported(const std::string &mode, bool *_aid
 
 ndk::ScopedAStatus PowerExt::setBoost(const std::string &boost, int32_t durationMs) {
     LOG(DEBUG) << "PowerExt setBoost: " << boost << " duration: " << durationMs;
+    setBoostById(resolveHint(boost), durationMs);
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus PowerExt::isBoostSupported(const std::string &boost, bool *_aidl_return) {
+    bool supported = HintManager::GetInstance()->IsHintSupported(boost);
+    if (!supported && HintManager::GetInstance()->IsAdpfProfileSupported(boost)) {
+        supported = true;
+    }
+    LOG(INFO) << "PowerExt boost " << boost << " isBoostSupported: " << supported;
+    *_aidl_return = supported;
+    return ndk::ScopedAStatus::ok();
+}
+
+HintId PowerExt::resolveHint(const std::string &name) {
+    return HintManager::LookupHint(name);
+}
+
+void PowerExt::setModeById(HintId mode, bool enabled) {
+    if (enabled) {
+        HintManager::GetInstance()->DoHint(mode);
+    } else {
+        HintManager::GetInstance()->EndHint(mode);
+    }
+    updateSessionHintMode(mode, enabled);
+}
+
+void PowerExt::setBoostById(HintId boost, int32_t durationMs) {
     if (HintManager::GetInstance()->GetAdpfProfile() &&
         HintManager::GetInstance()->GetAdpfProfile()->mReportingRateLimitNs > 0) {
-        PowerSessionManager<>::getInstance()->updateHintBoost(boost, durationMs);
+        PowerSessionManager<>::getInstance()->updateHintBoost(HintIdTable::GetName(boost),
+                                                              durationMs);
     }
 
     if (durationMs > 0) {
@@ -80,18 +101,20 @@ ndk::ScopedAStatus PowerExt::setBoost(const std::string &boost, int32_t duration
     } else {
         HintManager::GetInstance()->EndHint(boost);
     }
+}
 
-    return ndk::ScopedAStatus::ok();
+void PowerExt::setModes(const std::vector<std::pair<HintId, bool>> &modes) {
+    HintManager::GetInstance()->SetHints(modes);
+    for (const auto &[mode, enabled] : modes) {
+        updateSessionHintMode(mode, enabled);
+    }
 }
 
-ndk::ScopedAStatus PowerExt::isBoostSupported(const std::string &boost, bool *_aidl_return) {
-    bool supported = HintManager::GetInstance()->IsHintSupported(boost);
-    if (!supported && HintManager::GetInstance()->IsAdpfProfileSupported(boost)) {
-        supported = true;
+void PowerExt::updateSessionHintMode(HintId mode, bool enabled) {
+    if (HintManager::GetInstance()->GetAdpfProfile() &&
+        HintManager::GetInstance()->GetAdpfProfile()->mReportingRateLimitNs > 0) {
+        PowerSessionManager<>::getInstance()->updateHintMode(HintIdTable::GetName(mode), enabled);
     }
-    LOG(INFO) << "PowerExt boost " << boost << " isBoostSupported: " << supported;
-    *_aidl_return = supported;
-    return ndk::ScopedAStatus::ok();
 }
 
 }  // namespace pixel
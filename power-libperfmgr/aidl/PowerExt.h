@@ -17,11 +17,14 @@
 #pragma once
 
 #include <aidl/google/hardware/power/extension/pixel/BnPowerExt.h>
+#include <perfmgr/HintId.h>
 #include <perfmgr/HintManager.h>
 
 #include <atomic>
 #include <memory>
 #include <thread>
+#include <utility>
+#include <vector>
 
 #include "disp-power/DisplayLowPower.h"
 
@@ -40,7 +43,19 @@ class PowerExt : public ::aidl::google::hardware::power::extension::pixel::BnPow
     ndk::ScopedAStatus setBoost(const std::string &boost, int32_t durationMs) override;
     ndk::ScopedAStatus isBoostSupported(const std::string &boost, bool *_aidl_return) override;
 
+    // Fast path for in-process clients which set the same modes and boosts at
+    // frame rate: the name is resolved to a handle once with resolveHint and
+    // the calls below skip the name lookup and the per-call logging.
+    static ::android::perfmgr::HintId resolveHint(const std::string &name);
+    void setModeById(::android::perfmgr::HintId mode, bool enabled);
+    void setBoostById(::android::perfmgr::HintId boost, int32_t durationMs);
+    // Apply several mode changes in order with a single looper wakeup.
+    void setModes(const std::vector<std::pair<::android::perfmgr::HintId, bool>> &modes);
+
   private:
+    // Forward a mode change to the ADPF profile when hint reporting is on.
+    void updateSessionHintMode(::android::perfmgr::HintId mode, bool enabled);
+
     std::shared_ptr<DisplayLowPower> mDisplayLowPower;
 };
 
@@ -29,9 +29,11 @@
 #include <time.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <atomic>
 
 #include "GpuCalculationHelpers.h"
+#include "PidController.h"
 #include "tests/mocks/MockHintManager.h"
 #include "tests/mocks/MockPowerSessionManager.h"
 
@@ -53,8 +55,14 @@ namespace {
 
 static std::atomic<int64_t> sSessionIDCounter{0};
 
-static inline int64_t ns_to_100us(int64_t ns) {
-    return ns / 100000;
+// Session records are only kept for the boosts learning from them, and made
+// at the first report since many sessions never report
+std::unique_ptr<SessionRecords> makeSessionRecords(const AdpfConfig &config) {
+    if (!config.mHeuristicBoostOn.value_or(false) && !config.mPredictiveBoostOn.value_or(false)) {
+        return nullptr;
+    }
+    return std::make_unique<SessionRecords>(config.mMaxRecordsNum.value(),
+                                            config.mJankCheckTimeFactor.value());
 }
 
 }  // namespace
@@ -63,68 +71,41 @@ template <class HintManagerT, class PowerSessionManagerT>
 int64_t PowerHintSession<HintManagerT, PowerSessionManagerT>::convertWorkDurationToBoostByPid(
         const std::vector<WorkDuration> &actualDurations) {
     std::shared_ptr<AdpfConfig> adpfConfig = HintManagerT::GetInstance()->GetAdpfProfile();
-    const nanoseconds &targetDuration = mDescriptor->targetNs;
-    int64_t &integral_error = mDescriptor->integral_error;
-    int64_t &previous_error = mDescriptor->previous_error;
-    uint64_t samplingWindowP = adpfConfig->mSamplingWindowP;
-    uint64_t samplingWindowI = adpfConfig->mSamplingWindowI;
-    uint64_t samplingWindowD = adpfConfig->mSamplingWindowD;
-    int64_t targetDurationNanos = (int64_t)targetDuration.count();
-    int64_t length = actualDurations.size();
-    int64_t p_start =
-            samplingWindowP == 0 || samplingWindowP > length ? 0 : length - samplingWindowP;
-    int64_t i_start =
-            samplingWindowI == 0 || samplingWindowI > length ? 0 : length - samplingWindowI;
-    int64_t d_start =
-            samplingWindowD == 0 || samplingWindowD > length ? 0 : length - samplingWindowD;
-    int64_t dt = ns_to_100us(targetDurationNanos);
-    int64_t err_sum = 0;
-    int64_t derivative_sum = 0;
-    for (int64_t i = std::min({p_start, i_start, d_start}); i < length; i++) {
-        int64_t actualDurationNanos = actualDurations[i].durationNanos;
-        if (std::abs(actualDurationNanos) > targetDurationNanos * 20) {
-            ALOGW("The actual duration is way far from the target (%" PRId64 " >> %" PRId64 ")",
-                  actualDurationNanos, targetDurationNanos);
-        }
-        // PID control algorithm
-        int64_t error = ns_to_100us(actualDurationNanos - targetDurationNanos);
-        if (i >= d_start) {
-            derivative_sum += error - previous_error;
-        }
-        if (i >= p_start) {
-            err_sum += error;
-        }
-        if (i >= i_start) {
-            integral_error += error * dt;
-            integral_error = std::min(adpfConfig->getPidIHighDivI(), integral_error);
-            integral_error = std::max(adpfConfig->getPidILowDivI(), integral_error);
-        }
-        previous_error = error;
-    }
-
-    auto pid_pu_active = adpfConfig->mPidPu;
+    PidParams params;
+    params.targetDurationNanos = mDescriptor->targetNs.count();
+    params.samplingWindowP = adpfConfig->mSamplingWindowP;
+    params.samplingWindowI = adpfConfig->mSamplingWindowI;
+    params.samplingWindowD = adpfConfig->mSamplingWindowD;
+    params.pidPo = adpfConfig->mPidPo;
+    params.pidPu = adpfConfig->mPidPu;
     if (adpfConfig->mHeuristicBoostOn.has_value() && adpfConfig->mHeuristicBoostOn.value()) {
-        pid_pu_active = mHeuristicBoostActive
-                                ? adpfConfig->mPidPu * adpfConfig->mHBoostPidPuFactor.value()
-                                : adpfConfig->mPidPu;
-    }
-    int64_t pOut = static_cast<int64_t>((err_sum > 0 ? adpfConfig->mPidPo : pid_pu_active) *
-                                        err_sum / (length - p_start));
-    int64_t iOut = static_cast<int64_t>(adpfConfig->mPidI * integral_error);
-    int64_t dOut =
-            static_cast<int64_t>((derivative_sum > 0 ? adpfConfig->mPidDo : adpfConfig->mPidDu) *
-                                 derivative_sum / dt / (length - d_start));
-
-    int64_t output = pOut + iOut + dOut;
-    ATRACE_INT(mAppDescriptorTrace->trace_pid_err.c_str(), err_sum / (length - p_start));
-    ATRACE_INT(mAppDescriptorTrace->trace_pid_integral.c_str(), integral_error);
-    ATRACE_INT(mAppDescriptorTrace->trace_pid_derivative.c_str(),
-               derivative_sum / dt / (length - d_start));
-    ATRACE_INT(mAppDescriptorTrace->trace_pid_pOut.c_str(), pOut);
-    ATRACE_INT(mAppDescriptorTrace->trace_pid_iOut.c_str(), iOut);
-    ATRACE_INT(mAppDescriptorTrace->trace_pid_dOut.c_str(), dOut);
-    ATRACE_INT(mAppDescriptorTrace->trace_pid_output.c_str(), output);
-    return output;
+        params.pidPu = mHeuristicBoostActive
+                               ? adpfConfig->mPidPu * adpfConfig->mHBoostPidPuFactor.value()
+                               : adpfConfig->mPidPu;
+    }
+    params.pidI = adpfConfig->mPidI;
+    params.pidDo = adpfConfig->mPidDo;
+    params.pidDu = adpfConfig->mPidDu;
+    params.integralHigh = adpfConfig->getPidIHighDivI();
+    params.integralLow = adpfConfig->getPidILowDivI();
+
+    PidState state{mDescriptor->integral_error, mDescriptor->previous_error};
+    PidOutput pid = evaluatePid(params, actualDurations, &state);
+    mDescriptor->integral_error = state.integralError;
+    mDescriptor->previous_error = state.previousError;
+
+    if (pid.outlierDurationNanos != 0) {
+        ALOGW("The actual duration is way far from the target (%" PRId64 " >> %" PRId64 ")",
+              pid.outlierDurationNanos, params.targetDurationNanos);
+    }
+    mAppDescriptorTrace->traceInt(AppTraceCounter::PID_ERR, pid.errorAvg);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::PID_INTEGRAL, state.integralError);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::PID_DERIVATIVE, pid.derivativeAvg);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::PID_P_OUT, pid.pOut);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::PID_I_OUT, pid.iOut);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::PID_D_OUT, pid.dOut);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::PID_OUTPUT, pid.output);
+    return pid.output;
 }
 
 template <class HintManagerT, class PowerSessionManagerT>
@@ -138,33 +119,28 @@ PowerHintSession<HintManagerT, PowerSessionManagerT>::PowerHintSession(
                                                 std::chrono::nanoseconds(durationNs))),
       mAppDescriptorTrace(std::make_shared<AppDescriptorTrace>(mIdString)),
       mTag(tag),
-      mSessionRecords(
-              HintManagerT::GetInstance()->GetAdpfProfile()->mHeuristicBoostOn.has_value() &&
-                              HintManagerT::GetInstance()
-                                      ->GetAdpfProfile()
-                                      ->mHeuristicBoostOn.value()
-                      ? std::make_unique<SessionRecords>(HintManagerT::GetInstance()
-                                                                 ->GetAdpfProfile()
-                                                                 ->mMaxRecordsNum.value(),
-                                                         HintManagerT::GetInstance()
-                                                                 ->GetAdpfProfile()
-                                                                 ->mJankCheckTimeFactor.value())
-                      : nullptr) {
+      mRecorder(SessionRecorder::create(mSessionId, tgid, uid, static_cast<int32_t>(tag),
+                                        durationNs)) {
     ATRACE_CALL();
-    ATRACE_INT(mAppDescriptorTrace->trace_target.c_str(), mDescriptor->targetNs.count());
-    ATRACE_INT(mAppDescriptorTrace->trace_active.c_str(), mDescriptor->is_active.load());
+    mAppDescriptorTrace->traceInt(AppTraceCounter::TARGET, mDescriptor->targetNs.count());
+    mAppDescriptorTrace->traceInt(AppTraceCounter::ACTIVE, mDescriptor->is_active.load());
 
-    mLastUpdatedTime = std::chrono::steady_clock::now();
+    mLastUpdatedTime = mPSManager->now();
     mPSManager->addPowerSession(mIdString, mDescriptor, mAppDescriptorTrace, threadIds);
     // init boost
     auto adpfConfig = HintManagerT::GetInstance()->GetAdpfProfile();
     mPSManager->voteSet(
             mSessionId, AdpfVoteType::CPU_LOAD_RESET, adpfConfig->mUclampMinLoadReset, kUclampMax,
-            std::chrono::steady_clock::now(),
+            mPSManager->now(),
             duration_cast<nanoseconds>(mDescriptor->targetNs * adpfConfig->mStaleTimeFactor / 2.0));
 
     mPSManager->voteSet(mSessionId, AdpfVoteType::CPU_VOTE_DEFAULT, adpfConfig->mUclampMinInit,
-                        kUclampMax, std::chrono::steady_clock::now(), mDescriptor->targetNs);
+                        kUclampMax, mPSManager->now(), mDescriptor->targetNs);
+    SessionFootprint::add(1, 0);
+    {
+        std::scoped_lock lock{mPowerHintSessionLock};
+        updateFootprint();
+    }
     ALOGV("PowerHintSession created: %s", mDescriptor->toString().c_str());
 }
 
@@ -173,9 +149,24 @@ PowerHintSession<HintManagerT, PowerSessionManagerT>::~PowerHintSession() {
     ATRACE_CALL();
     close();
     ALOGV("PowerHintSession deleted: %s", mDescriptor->toString().c_str());
-    ATRACE_INT(mAppDescriptorTrace->trace_target.c_str(), 0);
-    ATRACE_INT(mAppDescriptorTrace->trace_actl_last.c_str(), 0);
-    ATRACE_INT(mAppDescriptorTrace->trace_active.c_str(), 0);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::TARGET, 0);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::ACTL_LAST, 0);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::ACTIVE, 0);
+    std::scoped_lock lock{mPowerHintSessionLock};
+    SessionFootprint::add(-1, -static_cast<int64_t>(mFootprintBytes));
+}
+
+template <class HintManagerT, class PowerSessionManagerT>
+void PowerHintSession<HintManagerT, PowerSessionManagerT>::updateFootprint() {
+    size_t bytes = sizeof(*this) + sizeof(AppHintDesc) + sizeof(AppDescriptorTrace);
+    if (mSessionRecords) {
+        bytes += mSessionRecords->getMemoryBytes();
+    }
+    if (mEnergySearch) {
+        bytes += sizeof(UclampEnergySearch);
+    }
+    SessionFootprint::add(0, static_cast<int64_t>(bytes) - static_cast<int64_t>(mFootprintBytes));
+    mFootprintBytes = bytes;
 }
 
 template <class HintManagerT, class PowerSessionManagerT>
@@ -191,12 +182,22 @@ void PowerHintSession<HintManagerT, PowerSessionManagerT>::updatePidControlVaria
     if (updateVote) {
         auto adpfConfig = HintManagerT::GetInstance()->GetAdpfProfile();
         mPSManager->voteSet(mSessionId, AdpfVoteType::CPU_VOTE_DEFAULT, pidControlVariable,
-                            kUclampMax, std::chrono::steady_clock::now(),
+                            kUclampMax, mPSManager->now(),
                             std::max(duration_cast<nanoseconds>(mDescriptor->targetNs *
                                                                 adpfConfig->mStaleTimeFactor),
                                      nanoseconds(adpfConfig->mReportingRateLimitNs) * 2));
     }
-    ATRACE_INT(mAppDescriptorTrace->trace_min.c_str(), pidControlVariable);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::MIN, pidControlVariable);
+}
+
+template <class HintManagerT, class PowerSessionManagerT>
+void PowerHintSession<HintManagerT, PowerSessionManagerT>::recordReportApplied(
+        std::chrono::steady_clock::time_point reportStartTime) {
+    const auto latency = std::chrono::steady_clock::now() - reportStartTime;
+    mMetrics.reportToApplied.record(latency);
+    mMetrics.recordUclampMin(mDescriptor->pidControlVariable);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::REPORT_LATENCY,
+                                  duration_cast<std::chrono::microseconds>(latency).count());
 }
 
 template <class HintManagerT, class PowerSessionManagerT>
@@ -215,7 +216,24 @@ void PowerHintSession<HintManagerT, PowerSessionManagerT>::dumpToStream(std::ost
     stream << "ID.Min.Act.Timeout(" << mIdString;
     stream << ", " << mDescriptor->pidControlVariable;
     stream << ", " << mDescriptor->is_active;
-    stream << ", " << isTimeout() << ")";
+    stream << ", " << isTimeout() << ") ";
+    mMetrics.dump(stream);
+    stream << ", ";
+    mGpuCapacityFilter.dumpToStream(stream);
+    if (mGpuCoBoost) {
+        stream << ", ";
+        mGpuCoBoost->dumpToStream(stream);
+    }
+    if (mEnergySearch) {
+        stream << ", ";
+        mEnergySearch->dumpToStream(stream);
+    }
+    if (mSessionRecords) {
+        stream << ", Predicted(" << mSessionRecords->getNumOfPredictionHits() << " hit, "
+               << mSessionRecords->getNumOfPredictionMisses() << " missed, "
+               << mSessionRecords->getNumOfFalsePredictions() << " false)";
+    }
+    stream << ", Bytes(" << mFootprintBytes << ")";
 }
 
 template <class HintManagerT, class PowerSessionManagerT>
@@ -227,12 +245,15 @@ ndk::ScopedAStatus PowerHintSession<HintManagerT, PowerSessionManagerT>::pause()
     }
     if (!mDescriptor->is_active.load())
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    if (mRecorder) {
+        mRecorder->recordPause();
+    }
     // Reset to default uclamp value.
     mPSManager->setThreadsFromPowerSession(mSessionId, {});
     mDescriptor->is_active.store(false);
     mPSManager->pause(mSessionId);
-    ATRACE_INT(mAppDescriptorTrace->trace_active.c_str(), false);
-    ATRACE_INT(mAppDescriptorTrace->trace_min.c_str(), 0);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::ACTIVE, false);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::MIN, 0);
     return ndk::ScopedAStatus::ok();
 }
 
@@ -246,12 +267,15 @@ ndk::ScopedAStatus PowerHintSession<HintManagerT, PowerSessionManagerT>::resume(
     if (mDescriptor->is_active.load()) {
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     }
+    if (mRecorder) {
+        mRecorder->recordResume();
+    }
     mPSManager->setThreadsFromPowerSession(mSessionId, mDescriptor->thread_ids);
     mDescriptor->is_active.store(true);
     // resume boost
     mPSManager->resume(mSessionId);
-    ATRACE_INT(mAppDescriptorTrace->trace_active.c_str(), true);
-    ATRACE_INT(mAppDescriptorTrace->trace_min.c_str(), mDescriptor->pidControlVariable);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::ACTIVE, true);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::MIN, mDescriptor->pidControlVariable);
     return ndk::ScopedAStatus::ok();
 }
 
@@ -265,7 +289,7 @@ ndk::ScopedAStatus PowerHintSession<HintManagerT, PowerSessionManagerT>::close()
     // Remove the session from PowerSessionManager first to avoid racing.
     mPSManager->removePowerSession(mSessionId);
     mDescriptor->is_active.store(false);
-    ATRACE_INT(mAppDescriptorTrace->trace_min.c_str(), 0);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::MIN, 0);
     return ndk::ScopedAStatus::ok();
 }
 
@@ -281,13 +305,16 @@ ndk::ScopedAStatus PowerHintSession<HintManagerT, PowerSessionManagerT>::updateT
         ALOGE("Error: targetDurationNanos(%" PRId64 ") should bigger than 0", targetDurationNanos);
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
     }
+    if (mRecorder) {
+        mRecorder->recordTarget(targetDurationNanos);
+    }
     targetDurationNanos =
             targetDurationNanos * HintManagerT::GetInstance()->GetAdpfProfile()->mTargetTimeFactor;
 
     mDescriptor->targetNs = std::chrono::nanoseconds(targetDurationNanos);
     mPSManager->updateTargetWorkDuration(mSessionId, AdpfVoteType::CPU_VOTE_DEFAULT,
                                          mDescriptor->targetNs);
-    ATRACE_INT(mAppDescriptorTrace->trace_target.c_str(), targetDurationNanos);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::TARGET, targetDurationNanos);
 
     return ndk::ScopedAStatus::ok();
 }
@@ -323,18 +350,59 @@ bool PowerHintSession<HintManagerT, PowerSessionManagerT>::updateHeuristicBoost(
                maxToAvgRatio < adpfConfig->mHBoostOffMaxAvgRatio.value()) {
         mHeuristicBoostActive = false;
     }
-    ATRACE_INT(mAppDescriptorTrace->trace_heuristic_boost_active.c_str(), mHeuristicBoostActive);
-    ATRACE_INT(mAppDescriptorTrace->trace_missed_cycles.c_str(), numOfMissedCycles);
-    ATRACE_INT(mAppDescriptorTrace->trace_avg_duration.c_str(), avgDurationUs.value());
-    ATRACE_INT(mAppDescriptorTrace->trace_max_duration.c_str(), maxDurationUs.value());
-    ATRACE_INT(mAppDescriptorTrace->trace_low_frame_rate.c_str(),
-               mSessionRecords->isLowFrameRate(adpfConfig->mLowFrameRateThreshold.value()));
+    mAppDescriptorTrace->traceInt(AppTraceCounter::HEURISTIC_BOOST_ACTIVE, mHeuristicBoostActive);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::MISSED_CYCLES, numOfMissedCycles);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::AVG_DURATION, avgDurationUs.value());
+    mAppDescriptorTrace->traceInt(AppTraceCounter::MAX_DURATION, maxDurationUs.value());
+    mAppDescriptorTrace->traceInt(AppTraceCounter::P90_DURATION,
+                                  mSessionRecords->getPercentileDuration(90).value_or(0));
+    mAppDescriptorTrace->traceInt(
+            AppTraceCounter::LOW_FRAME_RATE,
+            mSessionRecords->isLowFrameRate(adpfConfig->mLowFrameRateThreshold.value()));
     return mHeuristicBoostActive;
 }
 
+template <class HintManagerT, class PowerSessionManagerT>
+std::optional<int> PowerHintSession<HintManagerT, PowerSessionManagerT>::updateEnergySearch(
+        const std::shared_ptr<AdpfConfig> &adpfConfig, size_t frames, size_t missedFrames,
+        bool isFirstFrame) {
+    if (!adpfConfig->mEnergyAwareOn.value_or(false)) {
+        mEnergySearch.reset();
+        mEnergySearchConfig.reset();
+        return std::nullopt;
+    }
+    // The rails count the energy of everything running on the clusters
+    // since the previous report, not only the work of this session
+    const auto energyUWs = mPSManager->cpuEnergyUWs();
+    std::optional<uint64_t> reportEnergyUWs;
+    if (energyUWs && mLastCpuEnergyUWs && !isFirstFrame && *energyUWs >= *mLastCpuEnergyUWs) {
+        reportEnergyUWs = *energyUWs - *mLastCpuEnergyUWs;
+    }
+    mLastCpuEnergyUWs = energyUWs;
+
+    if (mEnergySearchConfig != adpfConfig) {
+        // Up to the highest uclamp min the session can be boosted to
+        uint32_t ceiling = adpfConfig->mUclampMinHigh;
+        if (adpfConfig->mHeuristicBoostOn.value_or(false)) {
+            ceiling = std::max(ceiling, adpfConfig->mHBoostUclampMin.value());
+        }
+        mEnergySearch = std::make_unique<UclampEnergySearch>(
+                adpfConfig->mUclampMinLow, ceiling, adpfConfig->mEnergyAwareUclampStep.value(),
+                adpfConfig->mEnergyAwareWindowFrames.value());
+        mEnergySearchConfig = adpfConfig;
+        updateFootprint();
+    } else if (isFirstFrame) {
+        mEnergySearch->reset();
+    }
+    const int cap = mEnergySearch->update(frames, missedFrames, reportEnergyUWs);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::ENERGY_CAP, cap);
+    return cap;
+}
+
 template <class HintManagerT, class PowerSessionManagerT>
 ndk::ScopedAStatus PowerHintSession<HintManagerT, PowerSessionManagerT>::reportActualWorkDuration(
         const std::vector<WorkDuration> &actualDurations) {
+    const auto reportStartTime = std::chrono::steady_clock::now();
     std::scoped_lock lock{mPowerHintSessionLock};
     if (mSessionClosed) {
         ALOGE("Error: session is dead");
@@ -353,39 +421,60 @@ ndk::ScopedAStatus PowerHintSession<HintManagerT, PowerSessionManagerT>::reportA
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     }
 
+    if (mRecorder) {
+        mRecorder->recordReport(actualDurations);
+    }
+
     auto adpfConfig = HintManagerT::GetInstance()->GetAdpfProfile();
     mDescriptor->update_count++;
     bool isFirstFrame = isTimeout();
-    ATRACE_INT(mAppDescriptorTrace->trace_batch_size.c_str(), actualDurations.size());
-    ATRACE_INT(mAppDescriptorTrace->trace_actl_last.c_str(), actualDurations.back().durationNanos);
-    ATRACE_INT(mAppDescriptorTrace->trace_target.c_str(), mDescriptor->targetNs.count());
-    ATRACE_INT(mAppDescriptorTrace->trace_hint_count.c_str(), mDescriptor->update_count);
-    ATRACE_INT(mAppDescriptorTrace->trace_hint_overtime.c_str(),
-               actualDurations.back().durationNanos - mDescriptor->targetNs.count() > 0);
-    ATRACE_INT(mAppDescriptorTrace->trace_is_first_frame.c_str(), (isFirstFrame) ? (1) : (0));
-    ATRACE_INT(mAppDescriptorTrace->trace_cpu_duration.c_str(),
-               actualDurations.back().cpuDurationNanos);
-    ATRACE_INT(mAppDescriptorTrace->trace_gpu_duration.c_str(),
-               actualDurations.back().gpuDurationNanos);
-
-    mLastUpdatedTime = std::chrono::steady_clock::now();
+    mAppDescriptorTrace->traceInt(AppTraceCounter::BATCH_SIZE, actualDurations.size());
+    mAppDescriptorTrace->traceInt(AppTraceCounter::ACTL_LAST, actualDurations.back().durationNanos);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::TARGET, mDescriptor->targetNs.count());
+    mAppDescriptorTrace->traceInt(AppTraceCounter::HINT_COUNT, mDescriptor->update_count);
+    mAppDescriptorTrace->traceInt(
+            AppTraceCounter::HINT_OVERTIME,
+            actualDurations.back().durationNanos - mDescriptor->targetNs.count() > 0);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::IS_FIRST_FRAME, (isFirstFrame) ? (1) : (0));
+    mAppDescriptorTrace->traceInt(AppTraceCounter::CPU_DURATION,
+                                  actualDurations.back().cpuDurationNanos);
+    mAppDescriptorTrace->traceInt(AppTraceCounter::GPU_DURATION,
+                                  actualDurations.back().gpuDurationNanos);
+
+    mLastUpdatedTime = mPSManager->now();
     if (isFirstFrame) {
         if (isAppSession()) {
             tryToSendPowerHint("ADPF_FIRST_FRAME");
         }
 
-        mPSManager->updateUniversalBoostMode();
+        mPSManager->updateUniversalBoostMode(mSessionId);
     }
 
     mPSManager->disableBoosts(mSessionId);
 
+    // Frames of this batch ran with the uclamp min of the previous report
+    const int64_t targetNs = mDescriptor->targetNs.count();
+    size_t missedFrames = std::count_if(
+            actualDurations.begin(), actualDurations.end(),
+            [targetNs](const WorkDuration &d) { return d.durationNanos > targetNs; });
+    mMetrics.recordFrames(actualDurations.size(), missedFrames,
+                          mDescriptor->pidControlVariable >
+                                  static_cast<int>(adpfConfig->mUclampMinLow));
+
     if (!adpfConfig->mPidOn) {
         updatePidControlVariable(adpfConfig->mUclampMinHigh);
+        recordReportApplied(reportStartTime);
         return ndk::ScopedAStatus::ok();
     }
 
-    if (adpfConfig->mHeuristicBoostOn.has_value() && adpfConfig->mHeuristicBoostOn.value()) {
+    if (!mSessionRecords) {
+        mSessionRecords = makeSessionRecords(*adpfConfig);
+        updateFootprint();
+    }
+    if (mSessionRecords) {
         mSessionRecords->addReportedDurations(actualDurations, mDescriptor->targetNs.count());
+    }
+    if (adpfConfig->mHeuristicBoostOn.has_value() && adpfConfig->mHeuristicBoostOn.value()) {
         updateHeuristicBoost();
     }
 
@@ -401,8 +490,31 @@ ndk::ScopedAStatus PowerHintSession<HintManagerT, PowerSessionManagerT>::reportA
     int next_min = std::min(static_cast<int>(uclampMinCeiling),
                             mDescriptor->pidControlVariable + static_cast<int>(output));
     next_min = std::max(static_cast<int>(adpfConfig->mUclampMinLow), next_min);
+    // Give up the boost above the lowest cap the session still meets its target at
+    if (const auto energyCap = updateEnergySearch(adpfConfig, actualDurations.size(),
+                                                  missedFrames, isFirstFrame)) {
+        next_min = std::min(next_min, *energyCap);
+    }
 
+    const int previousMin = mDescriptor->pidControlVariable;
     updatePidControlVariable(next_min);
+    recordReportApplied(reportStartTime);
+
+    // The next cycle starts about when its previous one gets reported, so
+    // the vote lands just before the predicted heavy cycle. It is dropped
+    // by disableBoosts on the next report.
+    if (adpfConfig->mPredictiveBoostOn.value_or(false) && mSessionRecords &&
+        mSessionRecords->predictNextCycleHeavy()) {
+        int predicted_min =
+                std::max(next_min, static_cast<int>(adpfConfig->mPredictiveBoostUclampMin.value()));
+        mPSManager->voteSet(mSessionId, AdpfVoteType::CPU_LOAD_PREDICTED, predicted_min,
+                            kUclampMax, mPSManager->now(), mDescriptor->targetNs * 2);
+    }
+
+    if (adpfConfig->mGpuCoBoostOn.value_or(false) && adpfConfig->mGpuBoostCapacityMax) {
+        updateGpuCoBoost(adpfConfig, previousMin, actualDurations.size(), missedFrames,
+                         isFirstFrame);
+    }
 
     if (!adpfConfig->mGpuBoostOn.value_or(false) || !adpfConfig->mGpuBoostCapacityMax ||
         !actualDurations.back().gpuDurationNanos) {
@@ -413,22 +525,53 @@ ndk::ScopedAStatus PowerHintSession<HintManagerT, PowerSessionManagerT>::reportA
     if (!gpu_freq) {
         return ndk::ScopedAStatus::ok();
     }
-    auto const additional_gpu_capacity =
-            calculate_capacity(actualDurations.back(), mDescriptor->targetNs, *gpu_freq);
-    ATRACE_INT(mAppDescriptorTrace->trace_gpu_capacity.c_str(),
-               static_cast<int>(additional_gpu_capacity));
+    // A session coming back from a timeout starts from a fresh estimate
+    if (isFirstFrame) {
+        mGpuCapacityFilter.reset();
+    }
+    auto const additional_gpu_capacity = mGpuCapacityFilter.update(
+            calculate_capacity(actualDurations.back(), mDescriptor->targetNs, *gpu_freq),
+            adpfConfig->mGpuCapacityFilterUp.value_or(1.0),
+            adpfConfig->mGpuCapacityFilterDown.value_or(1.0));
+    mAppDescriptorTrace->traceInt(AppTraceCounter::GPU_CAPACITY,
+                                  static_cast<int>(additional_gpu_capacity));
 
     auto const additional_gpu_capacity_clamped = std::clamp(
             additional_gpu_capacity, Cycles(0), Cycles(*adpfConfig->mGpuBoostCapacityMax));
 
     mPSManager->voteSet(
             mSessionId, AdpfVoteType::GPU_CAPACITY, additional_gpu_capacity_clamped,
-            std::chrono::steady_clock::now(),
+            mPSManager->now(),
             duration_cast<nanoseconds>(mDescriptor->targetNs * adpfConfig->mStaleTimeFactor));
 
     return ndk::ScopedAStatus::ok();
 }
 
+template <class HintManagerT, class PowerSessionManagerT>
+void PowerHintSession<HintManagerT, PowerSessionManagerT>::updateGpuCoBoost(
+        const std::shared_ptr<::android::perfmgr::AdpfConfig> &adpfConfig, int previousMin,
+        size_t frames, size_t missedFrames, bool isFirstFrame) {
+    if (!mGpuCoBoost) {
+        mGpuCoBoost.emplace();
+    } else if (isFirstFrame) {
+        mGpuCoBoost->reset();
+    }
+    // The GPU frequency catches up with a CPU boost frames later, so a spike
+    // in CPU demand raises the GPU capacity along with it
+    const Cycles before = mGpuCoBoost->value();
+    const Cycles coBoost = mGpuCoBoost->update(
+            static_cast<double>(mDescriptor->pidControlVariable - previousMin) / kUclampMax,
+            frames, missedFrames, adpfConfig->mGpuCoBoostFactor.value(),
+            Cycles(*adpfConfig->mGpuBoostCapacityMax), adpfConfig->mGpuCoBoostFrames.value());
+    mAppDescriptorTrace->traceInt(AppTraceCounter::GPU_CO_BOOST, static_cast<int>(coBoost));
+    if (coBoost == Cycles(0) && before == Cycles(0)) {
+        return;
+    }
+    mPSManager->voteSet(
+            mSessionId, AdpfVoteType::GPU_CO_BOOST, coBoost, mPSManager->now(),
+            duration_cast<nanoseconds>(mDescriptor->targetNs * adpfConfig->mStaleTimeFactor));
+}
+
 template <class HintManagerT, class PowerSessionManagerT>
 ndk::ScopedAStatus PowerHintSession<HintManagerT, PowerSessionManagerT>::sendHint(
         SessionHint hint) {
@@ -441,14 +584,16 @@ ndk::ScopedAStatus PowerHintSession<HintManagerT, PowerSessionManagerT>::sendHin
         ALOGE("Expect to call updateTargetWorkDuration() first.");
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     }
+    if (mRecorder) {
+        mRecorder->recordHint(static_cast<int32_t>(hint));
+    }
     auto adpfConfig = HintManagerT::GetInstance()->GetAdpfProfile();
 
     switch (hint) {
         case SessionHint::CPU_LOAD_UP:
             updatePidControlVariable(mDescriptor->pidControlVariable);
             mPSManager->voteSet(mSessionId, AdpfVoteType::CPU_LOAD_UP, adpfConfig->mUclampMinLoadUp,
-                                kUclampMax, std::chrono::steady_clock::now(),
-                                mDescriptor->targetNs * 2);
+                                kUclampMax, mPSManager->now(), mDescriptor->targetNs * 2);
             break;
         case SessionHint::CPU_LOAD_DOWN:
             updatePidControlVariable(adpfConfig->mUclampMinLow);
@@ -459,15 +604,13 @@ ndk::ScopedAStatus PowerHintSession<HintManagerT, PowerSessionManagerT>::sendHin
                              static_cast<uint32_t>(mDescriptor->pidControlVariable)),
                     false);
             mPSManager->voteSet(mSessionId, AdpfVoteType::CPU_LOAD_RESET,
-                                adpfConfig->mUclampMinLoadReset, kUclampMax,
-                                std::chrono::steady_clock::now(),
+                                adpfConfig->mUclampMinLoadReset, kUclampMax, mPSManager->now(),
                                 duration_cast<nanoseconds>(mDescriptor->targetNs *
                                                            adpfConfig->mStaleTimeFactor / 2.0));
             break;
         case SessionHint::CPU_LOAD_RESUME:
             mPSManager->voteSet(mSessionId, AdpfVoteType::CPU_LOAD_RESUME,
-                                mDescriptor->pidControlVariable, kUclampMax,
-                                std::chrono::steady_clock::now(),
+                                mDescriptor->pidControlVariable, kUclampMax, mPSManager->now(),
                                 duration_cast<nanoseconds>(mDescriptor->targetNs *
                                                            adpfConfig->mStaleTimeFactor / 2.0));
             break;
@@ -476,8 +619,8 @@ ndk::ScopedAStatus PowerHintSession<HintManagerT, PowerSessionManagerT>::sendHin
             break;
         case SessionHint::GPU_LOAD_UP:
             mPSManager->voteSet(mSessionId, AdpfVoteType::GPU_LOAD_UP,
-                                Cycles(adpfConfig->mGpuCapacityLoadUpHeadroom),
-                                std::chrono::steady_clock::now(), mDescriptor->targetNs);
+                                Cycles(adpfConfig->mGpuCapacityLoadUpHeadroom), mPSManager->now(),
+                                mDescriptor->targetNs);
             break;
         case SessionHint::GPU_LOAD_DOWN:
             // TODO(kevindubois): add impl
@@ -490,7 +633,7 @@ ndk::ScopedAStatus PowerHintSession<HintManagerT, PowerSessionManagerT>::sendHin
             return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
     }
     tryToSendPowerHint(toString(hint));
-    mLastUpdatedTime = std::chrono::steady_clock::now();
+    mLastUpdatedTime = mPSManager->now();
     return ndk::ScopedAStatus::ok();
 }
 
@@ -513,8 +656,8 @@ ndk::ScopedAStatus PowerHintSession<HintManagerT, PowerSessionManagerT>::setMode
     }
 
     mModes[static_cast<size_t>(mode)] = enabled;
-    ATRACE_INT(mAppDescriptorTrace->trace_modes[static_cast<size_t>(mode)].c_str(), enabled);
-    mLastUpdatedTime = std::chrono::steady_clock::now();
+    mAppDescriptorTrace->traceMode(mode, enabled);
+    mLastUpdatedTime = mPSManager->now();
     return ndk::ScopedAStatus::ok();
 }
 
@@ -560,7 +703,7 @@ std::string AppHintDesc::toString() const {
 
 template <class HintManagerT, class PowerSessionManagerT>
 bool PowerHintSession<HintManagerT, PowerSessionManagerT>::isTimeout() {
-    auto now = std::chrono::steady_clock::now();
+    auto now = mPSManager->now();
     time_point<steady_clock> staleTime =
             mLastUpdatedTime +
             nanoseconds(static_cast<int64_t>(
@@ -569,6 +712,12 @@ bool PowerHintSession<HintManagerT, PowerSessionManagerT>::isTimeout() {
     return now >= staleTime;
 }
 
+template <class HintManagerT, class PowerSessionManagerT>
+bool PowerHintSession<HintManagerT, PowerSessionManagerT>::isOwnedBy(int32_t tgid,
+                                                                     int32_t uid) const {
+    return mDescriptor->tgid == tgid && mDescriptor->uid == uid;
+}
+
 template class PowerHintSession<>;
 template class PowerHintSession<testing::NiceMock<mock::pixel::MockHintManager>,
                                 testing::NiceMock<mock::pixel::MockPowerSessionManager>>;
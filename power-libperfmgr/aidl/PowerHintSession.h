@@ -26,8 +26,12 @@
 
 #include "AdpfTypes.h"
 #include "AppDescriptorTrace.h"
+#include "GpuCalculationHelpers.h"
 #include "PowerSessionManager.h"
+#include "SessionMetrics.h"
+#include "SessionRecorder.h"
 #include "SessionRecords.h"
+#include "UclampEnergySearch.h"
 
 namespace aidl {
 namespace google {
@@ -69,6 +73,8 @@ class PowerHintSession : public BnPowerHintSession, public Immobile {
 
     void dumpToStream(std::ostream &stream);
     SessionTag getSessionTag() const;
+    // Return true if the session was created by the given tgid and uid.
+    bool isOwnedBy(int32_t tgid, int32_t uid) const;
 
   private:
     // In practice this lock should almost never get contested, but it's necessary for FMQ
@@ -82,6 +88,20 @@ class PowerHintSession : public BnPowerHintSession, public Immobile {
     int64_t convertWorkDurationToBoostByPid(const std::vector<WorkDuration> &actualDurations)
             REQUIRES(mPowerHintSessionLock);
     bool updateHeuristicBoost() REQUIRES(mPowerHintSessionLock);
+    // Recount the bytes of the session after one of its buffers was made
+    void updateFootprint() REQUIRES(mPowerHintSessionLock);
+    // Account a report to the energy aware search, return its uclamp min cap
+    // or nullopt if the mode is off
+    std::optional<int> updateEnergySearch(
+            const std::shared_ptr<::android::perfmgr::AdpfConfig> &adpfConfig, size_t frames,
+            size_t missedFrames, bool isFirstFrame) REQUIRES(mPowerHintSessionLock);
+    // Vote the GPU capacity following a rise of the uclamp min from previousMin
+    void updateGpuCoBoost(const std::shared_ptr<::android::perfmgr::AdpfConfig> &adpfConfig,
+                          int previousMin, size_t frames, size_t missedFrames, bool isFirstFrame)
+            REQUIRES(mPowerHintSessionLock);
+    // Record the latency of a report once its uclamp vote is applied
+    void recordReportApplied(std::chrono::steady_clock::time_point reportStartTime)
+            REQUIRES(mPowerHintSessionLock);
 
     // Data
     PowerSessionManagerT *mPSManager;
@@ -102,6 +122,19 @@ class PowerHintSession : public BnPowerHintSession, public Immobile {
     const SessionTag mTag;
     std::unique_ptr<SessionRecords> mSessionRecords GUARDED_BY(mPowerHintSessionLock) = nullptr;
     bool mHeuristicBoostActive GUARDED_BY(mPowerHintSessionLock){false};
+    SessionMetrics mMetrics GUARDED_BY(mPowerHintSessionLock);
+    GpuCapacityFilter mGpuCapacityFilter GUARDED_BY(mPowerHintSessionLock);
+    // Made at the first report of a profile with the CPU/GPU co-boost on
+    std::optional<GpuCoBoost> mGpuCoBoost GUARDED_BY(mPowerHintSessionLock);
+    // Energy aware mode, made for the profile it was configured by
+    std::unique_ptr<UclampEnergySearch> mEnergySearch GUARDED_BY(mPowerHintSessionLock);
+    std::shared_ptr<::android::perfmgr::AdpfConfig> mEnergySearchConfig
+            GUARDED_BY(mPowerHintSessionLock);
+    std::optional<uint64_t> mLastCpuEnergyUWs GUARDED_BY(mPowerHintSessionLock);
+    // Counted in SessionFootprint
+    size_t mFootprintBytes GUARDED_BY(mPowerHintSessionLock) = 0;
+    // Set when the client calls are recorded, see kPowerHalAdpfRecordDir
+    const std::unique_ptr<SessionRecorder> mRecorder;
 };
 
 }  // namespace pixel
@@ -21,6 +21,7 @@
 
 #include <android-base/file.h>
 #include <android-base/stringprintf.h>
+#include <android-base/strings.h>
 #include <log/log.h>
 #include <perfmgr/HintManager.h>
 #include <private/android_filesystem_config.h>
@@ -31,6 +32,7 @@
 #include "AdpfTypes.h"
 #include "AppDescriptorTrace.h"
 #include "AppHintDesc.h"
+#include "SessionMetrics.h"
 #include "tests/mocks/MockHintManager.h"
 
 namespace aidl {
@@ -76,6 +78,15 @@ static int set_uclamp(int tid, UclampRange range) {
     }
     return 0;
 }
+
+// Whether the threads of sessions tagged tag are placed by config
+bool isPlacedTag(const ::android::perfmgr::AdpfConfig &config, SessionTag tag) {
+    if (!config.mSessionTaskProfileTags) {
+        return true;
+    }
+    const auto tags = ::android::base::Split(*config.mSessionTaskProfileTags, ",");
+    return std::find(tags.begin(), tags.end(), toString(tag)) != tags.end();
+}
 }  // namespace
 
 template <class HintManagerT>
@@ -94,6 +105,19 @@ void PowerSessionManager<HintManagerT>::updateHintMode(const std::string &mode,
     }
 }
 
+template <class HintManagerT>
+std::shared_ptr<PriorityQueueWorkerPool> PowerSessionManager<HintManagerT>::createWorkerPool() {
+    size_t realtimeThreads = 1;
+    auto adpfConfig = HintManager::GetInstance()->GetAdpfProfile();
+    if (adpfConfig && adpfConfig->mWorkerThreads.has_value()) {
+        realtimeThreads = adpfConfig->mWorkerThreads.value();
+    }
+    std::array<PriorityQueueWorkerPool::LaneConfig, kNumWorkerLanes> lanes;
+    lanes[static_cast<size_t>(WorkerLane::REALTIME)] = {realtimeThreads, "adpf_rt", 1};
+    lanes[static_cast<size_t>(WorkerLane::NORMAL)] = {1, "adpf_handler", 0};
+    return std::make_shared<PriorityQueueWorkerPool>(lanes);
+}
+
 template <class HintManagerT>
 void PowerSessionManager<HintManagerT>::updateHintBoost(const std::string &boost,
                                                         int32_t durationMs) {
@@ -117,13 +141,14 @@ void PowerSessionManager<HintManagerT>::addPowerSession(
               idString.c_str());
         return;
     }
-    const auto timeNow = std::chrono::steady_clock::now();
+    const auto timeNow = now();
     SessionValueEntry sve;
     sve.tgid = sessionDescriptor->tgid;
     sve.uid = sessionDescriptor->uid;
     sve.idString = idString;
     sve.isActive = sessionDescriptor->is_active;
     sve.isAppSession = sessionDescriptor->uid >= AID_APP_START;
+    sve.tag = sessionDescriptor->tag;
     sve.lastUpdatedTime = timeNow;
     sve.votes = std::make_shared<Votes>();
     sve.sessionTrace = sessionTrace;
@@ -133,7 +158,7 @@ void PowerSessionManager<HintManagerT>::addPowerSession(
 
     bool addedRes = false;
     {
-        std::lock_guard<std::mutex> lock(mSessionTaskMapMutex);
+        std::lock_guard lock(mSessionTaskMapMutex);
         addedRes = mSessionTaskMap.add(sessionDescriptor->sessionId, sve, {});
     }
     if (!addedRes) {
@@ -156,10 +181,14 @@ void PowerSessionManager<HintManagerT>::removePowerSession(int64_t sessionId) {
     {
         // Wait till end to remove session because it needs to be around for apply U clamp
         // to work above since applying the uclamp needs a valid session id
-        std::lock_guard<std::mutex> lock(mSessionTaskMapMutex);
+        std::lock_guard lock(mSessionTaskMapMutex);
         mSessionTaskMap.replace(sessionId, {}, &addedThreads, &removedThreads);
+        mSessionCgroups.erase(sessionId);
         mSessionTaskMap.remove(sessionId);
     }
+    for (int voteId = 0; voteId < static_cast<int>(AdpfVoteType::VOTE_TYPE_SIZE); ++voteId) {
+        mEventSessionTimeoutWorker.cancelKeyed(timeoutKey(sessionId, voteId));
+    }
 
     for (auto tid : removedThreads) {
         if (!SetTaskProfiles(tid, {"NoResetUclampGrp"})) {
@@ -175,11 +204,14 @@ void PowerSessionManager<HintManagerT>::setThreadsFromPowerSession(
         int64_t sessionId, const std::vector<int32_t> &threadIds) {
     std::vector<pid_t> addedThreads;
     std::vector<pid_t> removedThreads;
+    UclampWrites writes;
     forceSessionActive(sessionId, false);
     {
-        std::lock_guard<std::mutex> lock(mSessionTaskMapMutex);
+        std::lock_guard lock(mSessionTaskMapMutex);
         mSessionTaskMap.replace(sessionId, threadIds, &addedThreads, &removedThreads);
+        updateUclampBackendLocked(sessionId, &writes);
     }
+    applyUclampWrites(writes);
     for (auto tid : addedThreads) {
         if (!SetTaskProfiles(tid, {"ResetUclampGrp"})) {
             ALOGE("Failed to set ResetUclampGrp task profile for tid:%d", tid);
@@ -194,36 +226,75 @@ void PowerSessionManager<HintManagerT>::setThreadsFromPowerSession(
 }
 
 template <class HintManagerT>
-std::optional<bool> PowerSessionManager<HintManagerT>::isAnyAppSessionActive() {
-    bool isAnyAppSessionActive = false;
+void PowerSessionManager<HintManagerT>::updateUniversalBoostMode(int64_t sessionId) {
     {
-        std::lock_guard<std::mutex> lock(mSessionTaskMapMutex);
-        isAnyAppSessionActive =
-                mSessionTaskMap.isAnyAppSessionActive(std::chrono::steady_clock::now());
+        std::lock_guard lock(mSessionTaskMapMutex);
+        if (!mSessionTaskMap.updateAppSessionActive(sessionId, now())) {
+            return;
+        }
     }
-    return isAnyAppSessionActive;
+    updateTopAppBoost();
 }
 
 template <class HintManagerT>
-void PowerSessionManager<HintManagerT>::updateUniversalBoostMode() {
-    const auto active = isAnyAppSessionActive();
-    if (!active.has_value()) {
+void PowerSessionManager<HintManagerT>::updateTopAppBoost() {
+    const auto timeNow = now();
+    std::lock_guard<std::mutex> boostLock(mTopAppBoostMutex);
+    bool active;
+    {
+        std::lock_guard lock(mSessionTaskMapMutex);
+        active = mSessionTaskMap.numActiveAppSessions() > 0;
+    }
+    auto &state = mTopAppBoost;
+    if (active) {
+        state.inactiveSince.reset();
+    } else if (!state.inactiveSince) {
+        state.inactiveSince = timeNow;
+    }
+    if (active == state.disabled) {
+        return;
+    }
+
+    auto toggleTime = state.lastToggle + mTopAppBoostHold;
+    if (!active) {
+        toggleTime = std::max(toggleTime, *state.inactiveSince + mTopAppBoostRelease);
+    }
+    if (timeNow < toggleTime) {
+        state.numDeferred++;
+        mTopAppBoostWorker.scheduleKeyed(0, {}, toggleTime);
         return;
     }
-    if (active.value()) {
+
+    if (active) {
         disableSystemTopAppBoost();
+        state.numDisable++;
     } else {
         enableSystemTopAppBoost();
+        state.numEnable++;
     }
+    state.disabled = active;
+    state.lastToggle = timeNow;
+}
+
+template <class HintManagerT>
+void PowerSessionManager<HintManagerT>::handleEvent(const EventTopAppBoostUpdate &) {
+    updateTopAppBoost();
 }
 
 template <class HintManagerT>
 void PowerSessionManager<HintManagerT>::dumpToFd(int fd) {
     std::ostringstream dump_buf;
     dump_buf << "========== Begin PowerSessionManager ADPF list ==========\n";
-    std::lock_guard<std::mutex> lock(mSessionTaskMapMutex);
+    TopAppBoostState topAppBoost;
+    {
+        // Taken before mSessionTaskMapMutex, like updateTopAppBoost does
+        std::lock_guard<std::mutex> boostLock(mTopAppBoostMutex);
+        topAppBoost = mTopAppBoost;
+    }
+    std::lock_guard lock(mSessionTaskMapMutex);
+    const auto &sessionCgroups = mSessionCgroups;
     mSessionTaskMap.forEachSessionValTasks(
-            [&](auto /* sessionId */, const auto &sessionVal, const auto &tasks) {
+            [&](auto sessionId, const auto &sessionVal, const auto &tasks) {
                 sessionVal.dump(dump_buf);
                 dump_buf << " Tid:Ref[";
 
@@ -239,9 +310,25 @@ void PowerSessionManager<HintManagerT>::dumpToFd(int fd) {
                         --tasksLen;
                     }
                 }
-                dump_buf << "]\n";
+                dump_buf << "]";
+                auto cgroupItr = sessionCgroups.find(sessionId);
+                if (cgroupItr != sessionCgroups.end()) {
+                    dump_buf << " Cgroup:" << cgroupItr->second->numTasks();
+                }
+                dump_buf << "\n";
             });
     dump_buf << "========== End PowerSessionManager ADPF list ==========\n";
+    dump_buf << "TopAppBoost: disabled:" << topAppBoost.disabled
+             << " activeAppSessions:" << mSessionTaskMap.numActiveAppSessions()
+             << " disables:" << topAppBoost.numDisable << " enables:" << topAppBoost.numEnable
+             << " deferred:" << topAppBoost.numDeferred << "\n";
+    SessionFootprint::dump(dump_buf) << "\n";
+    mSessionTaskMapMutex.dumpToStream(dump_buf, "SessionTaskMap lock");
+    mTaskLivenessMonitor->dumpToStream(dump_buf);
+    if (mGpuCapacityNode) {
+        (*mGpuCapacityNode)->dumpToStream(dump_buf);
+    }
+    mPriorityQueueWorkerPool->dumpToStream(dump_buf);
     if (!::android::base::WriteStringToFd(dump_buf.str(), fd)) {
         ALOGE("Failed to dump one of session list to fd:%d", fd);
     }
@@ -250,7 +337,7 @@ void PowerSessionManager<HintManagerT>::dumpToFd(int fd) {
 template <class HintManagerT>
 void PowerSessionManager<HintManagerT>::pause(int64_t sessionId) {
     {
-        std::lock_guard<std::mutex> lock(mSessionTaskMapMutex);
+        std::lock_guard lock(mSessionTaskMapMutex);
         auto sessValPtr = mSessionTaskMap.findSession(sessionId);
         if (nullptr == sessValPtr) {
             ALOGW("Pause failed, session is null %" PRId64, sessionId);
@@ -263,14 +350,15 @@ void PowerSessionManager<HintManagerT>::pause(int64_t sessionId) {
         }
         sessValPtr->isActive = false;
     }
-    applyCpuAndGpuVotes(sessionId, std::chrono::steady_clock::now());
-    updateUniversalBoostMode();
+    applyCpuAndGpuVotes(sessionId, now());
+    updateUniversalBoostMode(sessionId);
+    updateTaskPlacement(sessionId);
 }
 
 template <class HintManagerT>
 void PowerSessionManager<HintManagerT>::resume(int64_t sessionId) {
     {
-        std::lock_guard<std::mutex> lock(mSessionTaskMapMutex);
+        std::lock_guard lock(mSessionTaskMapMutex);
         auto sessValPtr = mSessionTaskMap.findSession(sessionId);
         if (nullptr == sessValPtr) {
             ALOGW("Resume failed, session is null %" PRId64, sessionId);
@@ -283,15 +371,16 @@ void PowerSessionManager<HintManagerT>::resume(int64_t sessionId) {
         }
         sessValPtr->isActive = true;
     }
-    applyCpuAndGpuVotes(sessionId, std::chrono::steady_clock::now());
-    updateUniversalBoostMode();
+    applyCpuAndGpuVotes(sessionId, now());
+    updateUniversalBoostMode(sessionId);
+    updateTaskPlacement(sessionId);
 }
 
 template <class HintManagerT>
 void PowerSessionManager<HintManagerT>::updateTargetWorkDuration(
         int64_t sessionId, AdpfVoteType voteId, std::chrono::nanoseconds durationNs) {
     int voteIdInt = static_cast<std::underlying_type_t<AdpfVoteType>>(voteId);
-    std::lock_guard<std::mutex> lock(mSessionTaskMapMutex);
+    std::lock_guard lock(mSessionTaskMapMutex);
     auto sessValPtr = mSessionTaskMap.findSession(sessionId);
     if (nullptr == sessValPtr) {
         ALOGE("Failed to updateTargetWorkDuration, session val is null id: %" PRId64, sessionId);
@@ -304,12 +393,6 @@ void PowerSessionManager<HintManagerT>::updateTargetWorkDuration(
     // revisit that decision.
 }
 
-template <typename T>
-auto shouldScheduleTimeout(Votes const &votes, int vote_id, std::chrono::time_point<T> deadline)
-        -> bool {
-    return !votes.voteIsActive(vote_id) || deadline < votes.voteTimeout(vote_id);
-}
-
 template <class HintManagerT>
 void PowerSessionManager<HintManagerT>::voteSet(int64_t sessionId, AdpfVoteType voteId,
                                                 int uclampMin, int uclampMax,
@@ -317,7 +400,8 @@ void PowerSessionManager<HintManagerT>::voteSet(int64_t sessionId, AdpfVoteType
                                                 std::chrono::nanoseconds durationNs) {
     const int voteIdInt = static_cast<std::underlying_type_t<AdpfVoteType>>(voteId);
     const auto timeoutDeadline = startTime + durationNs;
-    bool scheduleTimeout = false;
+    bool appActiveChanged = false;
+    UclampWrites writes;
 
     {
         std::lock_guard lock(mSessionTaskMapMutex);
@@ -327,20 +411,24 @@ void PowerSessionManager<HintManagerT>::voteSet(int64_t sessionId, AdpfVoteType
             // that has been removed is a possibility
             return;
         }
-        scheduleTimeout = shouldScheduleTimeout(*session->votes, voteIdInt, timeoutDeadline),
         mSessionTaskMap.addVote(sessionId, voteIdInt, uclampMin, uclampMax, startTime, durationNs);
         if (ATRACE_ENABLED()) {
-            ATRACE_INT(session->sessionTrace->trace_votes[voteIdInt].c_str(), uclampMin);
+            session->sessionTrace->traceVote(voteIdInt, uclampMin);
         }
         session->lastUpdatedTime = startTime;
-        applyUclampLocked(sessionId, startTime);
+        collectUclampLocked(sessionId, startTime, &writes);
+        appActiveChanged = mSessionTaskMap.updateAppSessionActive(sessionId, startTime);
     }
-
-    if (scheduleTimeout) {
-        mEventSessionTimeoutWorker.schedule(
-                {.timeStamp = startTime, .sessionId = sessionId, .voteId = voteIdInt},
-                timeoutDeadline);
+    applyUclampWrites(writes);
+    if (appActiveChanged) {
+        updateTopAppBoost();
     }
+
+    // Repeated votes move the single timer of the (session, vote) pair
+    mEventSessionTimeoutWorker.scheduleKeyed(
+            timeoutKey(sessionId, voteIdInt),
+            {.timeStamp = startTime, .sessionId = sessionId, .voteId = voteIdInt},
+            timeoutDeadline);
 }
 
 template <class HintManagerT>
@@ -350,7 +438,7 @@ void PowerSessionManager<HintManagerT>::voteSet(int64_t sessionId, AdpfVoteType
                                                 std::chrono::nanoseconds durationNs) {
     const int voteIdInt = static_cast<std::underlying_type_t<AdpfVoteType>>(voteId);
     const auto timeoutDeadline = startTime + durationNs;
-    bool scheduleTimeout = false;
+    bool appActiveChanged = false;
 
     {
         std::lock_guard lock(mSessionTaskMapMutex);
@@ -358,27 +446,29 @@ void PowerSessionManager<HintManagerT>::voteSet(int64_t sessionId, AdpfVoteType
         if (!session) {
             return;
         }
-        scheduleTimeout = shouldScheduleTimeout(*session->votes, voteIdInt, timeoutDeadline),
         mSessionTaskMap.addGpuVote(sessionId, voteIdInt, capacity, startTime, durationNs);
         if (ATRACE_ENABLED()) {
-            ATRACE_INT(session->sessionTrace->trace_votes[voteIdInt].c_str(),
-                       static_cast<int>(capacity));
+            session->sessionTrace->traceVote(voteIdInt, static_cast<int>(capacity));
         }
         session->lastUpdatedTime = startTime;
         applyGpuVotesLocked(sessionId, startTime);
+        appActiveChanged = mSessionTaskMap.updateAppSessionActive(sessionId, startTime);
     }
-
-    if (scheduleTimeout) {
-        mEventSessionTimeoutWorker.schedule(
-                {.timeStamp = startTime, .sessionId = sessionId, .voteId = voteIdInt},
-                timeoutDeadline);
+    if (appActiveChanged) {
+        updateTopAppBoost();
     }
+
+    // Repeated votes move the single timer of the (session, vote) pair
+    mEventSessionTimeoutWorker.scheduleKeyed(
+            timeoutKey(sessionId, voteIdInt),
+            {.timeStamp = startTime, .sessionId = sessionId, .voteId = voteIdInt},
+            timeoutDeadline);
 }
 
 template <class HintManagerT>
 void PowerSessionManager<HintManagerT>::disableBoosts(int64_t sessionId) {
     {
-        std::lock_guard<std::mutex> lock(mSessionTaskMapMutex);
+        std::lock_guard lock(mSessionTaskMapMutex);
         auto sessValPtr = mSessionTaskMap.findSession(sessionId);
         if (nullptr == sessValPtr) {
             // Because of the async nature of some events an event for a session
@@ -389,11 +479,12 @@ void PowerSessionManager<HintManagerT>::disableBoosts(int64_t sessionId) {
         // sessValPtr->disableBoosts();
         for (auto vid : {AdpfVoteType::CPU_LOAD_UP, AdpfVoteType::CPU_LOAD_RESET,
                          AdpfVoteType::CPU_LOAD_RESUME, AdpfVoteType::VOTE_POWER_EFFICIENCY,
-                         AdpfVoteType::GPU_LOAD_UP, AdpfVoteType::GPU_LOAD_RESET}) {
+                         AdpfVoteType::GPU_LOAD_UP, AdpfVoteType::GPU_LOAD_RESET,
+                         AdpfVoteType::CPU_LOAD_PREDICTED}) {
             auto vint = static_cast<std::underlying_type_t<AdpfVoteType>>(vid);
             sessValPtr->votes->setUseVote(vint, false);
             if (ATRACE_ENABLED()) {
-                ATRACE_INT(sessValPtr->sessionTrace->trace_votes[vint].c_str(), 0);
+                sessValPtr->sessionTrace->traceVote(vint, 0);
             }
         }
     }
@@ -401,26 +492,45 @@ void PowerSessionManager<HintManagerT>::disableBoosts(int64_t sessionId) {
 
 template <class HintManagerT>
 void PowerSessionManager<HintManagerT>::enableSystemTopAppBoost() {
-    if (HintManager::GetInstance()->IsHintSupported(kDisableBoostHintName)) {
+    if (HintManager::GetInstance()->IsHintSupported(mDisableBoostHintId)) {
         ALOGV("PowerSessionManager::enableSystemTopAppBoost!!");
-        HintManager::GetInstance()->EndHint(kDisableBoostHintName);
+        HintManager::GetInstance()->EndHint(mDisableBoostHintId);
     }
 }
 
 template <class HintManagerT>
 void PowerSessionManager<HintManagerT>::disableSystemTopAppBoost() {
-    if (HintManager::GetInstance()->IsHintSupported(kDisableBoostHintName)) {
+    if (HintManager::GetInstance()->IsHintSupported(mDisableBoostHintId)) {
         ALOGV("PowerSessionManager::disableSystemTopAppBoost!!");
-        HintManager::GetInstance()->DoHint(kDisableBoostHintName);
+        HintManager::GetInstance()->DoHint(mDisableBoostHintId);
+    }
+}
+
+template <class HintManagerT>
+PowerSessionManager<HintManagerT>::~PowerSessionManager() {
+    {
+        std::lock_guard lock(mSessionTaskMapMutex);
+        mSessionTaskMap.setTaskWatcher(nullptr);
+    }
+    // Join the monitor thread while the session map it calls into is alive
+    mTaskLivenessMonitor.reset();
+}
+
+template <class HintManagerT>
+void PowerSessionManager<HintManagerT>::handleTaskDead(pid_t taskId) {
+    std::lock_guard lock(mSessionTaskMapMutex);
+    const auto sessionIds = mSessionTaskMap.removeDeadTask(taskId);
+    if (!sessionIds.empty()) {
+        ALOGV("Removed dead thread %d from %zu hint sessions.", taskId, sessionIds.size());
     }
 }
 
 template <class HintManagerT>
 void PowerSessionManager<HintManagerT>::handleEvent(const EventSessionTimeout &eventTimeout) {
     bool recalcUclamp = false;
-    const auto tNow = std::chrono::steady_clock::now();
+    const auto tNow = now();
     {
-        std::lock_guard<std::mutex> lock(mSessionTaskMapMutex);
+        std::lock_guard lock(mSessionTaskMapMutex);
         auto sessValPtr = mSessionTaskMap.findSession(eventTimeout.sessionId);
         if (nullptr == sessValPtr) {
             // It is ok for session timeouts to fire after a session has been
@@ -428,10 +538,10 @@ void PowerSessionManager<HintManagerT>::handleEvent(const EventSessionTimeout &e
             return;
         }
 
-        // To minimize the number of events pushed into the queue, we are using
-        // the following logic to make use of a single timeout event which will
-        // requeue itself if the timeout has been changed since it was added to
-        // the work queue.  Requeue Logic:
+        // Every vote of a session has a single keyed timeout event which
+        // voteSet moves along with the vote deadline, the event still
+        // requeues itself in case the vote timeout changed without it.
+        // Requeue Logic:
         // if vote active and vote timeout <= sched time
         //    then deactivate vote and recalc uclamp (near end of function)
         // if vote active and vote timeout > sched time
@@ -443,14 +553,20 @@ void PowerSessionManager<HintManagerT>::handleEvent(const EventSessionTimeout &e
             if (voteTimeout <= tNow) {
                 sessValPtr->votes->setUseVote(eventTimeout.voteId, false);
                 recalcUclamp = true;
+                sessValPtr->timeoutLateness.record(tNow - voteTimeout);
                 if (ATRACE_ENABLED()) {
-                    ATRACE_INT(sessValPtr->sessionTrace->trace_votes[eventTimeout.voteId].c_str(),
-                               0);
+                    sessValPtr->sessionTrace->traceVote(eventTimeout.voteId, 0);
+                    sessValPtr->sessionTrace->traceInt(
+                            AppTraceCounter::TIMEOUT_LATENESS,
+                            std::chrono::duration_cast<std::chrono::microseconds>(tNow -
+                                                                                  voteTimeout)
+                                    .count());
                 }
             } else {
-                // Can unlock sooner than we do
-                auto eventTimeout2 = eventTimeout;
-                mEventSessionTimeoutWorker.schedule(eventTimeout2, voteTimeout);
+                // Only reached if the vote was extended without a reschedule
+                mEventSessionTimeoutWorker.scheduleKeyed(
+                        timeoutKey(eventTimeout.sessionId, eventTimeout.voteId), eventTimeout,
+                        voteTimeout);
             }
         }
     }
@@ -463,46 +579,148 @@ void PowerSessionManager<HintManagerT>::handleEvent(const EventSessionTimeout &e
     // than trying to use the event's timestamp which will be slightly off given
     // the background priority queue introduces latency
     applyCpuAndGpuVotes(eventTimeout.sessionId, tNow);
-    updateUniversalBoostMode();
+    updateUniversalBoostMode(eventTimeout.sessionId);
 }
 
 template <class HintManagerT>
-void PowerSessionManager<HintManagerT>::applyUclampLocked(
-        int64_t sessionId, std::chrono::steady_clock::time_point timePoint) {
+void PowerSessionManager<HintManagerT>::collectUclampLocked(
+        int64_t sessionId, std::chrono::steady_clock::time_point timePoint, UclampWrites *writes) {
     auto config = HintManager::GetInstance()->GetAdpfProfile();
+    auto sessValPtr = mSessionTaskMap.findSession(sessionId);
+    if (nullptr == sessValPtr) {
+        return;
+    }
+
+    if (!config->mUclampMinOn) {
+        ALOGV("PowerSessionManager::set_uclamp: skip");
+    } else {
+        auto cgroupItr = mSessionCgroups.find(sessionId);
+        std::shared_ptr<SessionCgroup> cgroup =
+                cgroupItr == mSessionCgroups.end() ? nullptr : cgroupItr->second;
+        for (auto tid : mSessionTaskMap.getTaskIds(sessionId)) {
+            UclampRange uclampRange;
+            // Threads in the cgroup have no other session, so any of them
+            // has the range of the whole group
+            if (cgroup && cgroup->hasTask(tid)) {
+                if (!writes->cgroup) {
+                    mSessionTaskMap.getTaskVoteRange(tid, timePoint, uclampRange,
+                                                     config->mUclampMaxEfficientBase,
+                                                     config->mUclampMaxEfficientOffset);
+                    writes->cgroup = cgroup;
+                    writes->cgroupRange = uclampRange;
+                }
+                continue;
+            }
+            mSessionTaskMap.getTaskVoteRange(tid, timePoint, uclampRange,
+                                             config->mUclampMaxEfficientBase,
+                                             config->mUclampMaxEfficientOffset);
+            if (mSessionTaskMap.isUclampApplied(tid, uclampRange)) {
+                continue;
+            }
+            // Marked applied now so later votes compare against it, and
+            // invalidated again by applyUclampWrites if the write fails
+            mSessionTaskMap.setUclampApplied(tid, uclampRange);
+            writes->tasks.emplace_back(tid, uclampRange);
+        }
+        takeUclampTicketLocked(writes);
+    }
+
+    sessValPtr->lastUpdatedTime = timePoint;
+}
+
+template <class HintManagerT>
+void PowerSessionManager<HintManagerT>::takeUclampTicketLocked(UclampWrites *writes) {
+    if ((!writes->tasks.empty() || writes->cgroup) && writes->ticket == 0) {
+        writes->ticket = ++mUclampWriteNext;
+    }
+}
+
+template <class HintManagerT>
+void PowerSessionManager<HintManagerT>::applyUclampWrites(const UclampWrites &writes) {
+    if (writes.ticket == 0) {
+        return;
+    }
     {
-        // TODO(kevindubois) un-indent this in followup patch to reduce churn.
-        auto sessValPtr = mSessionTaskMap.findSession(sessionId);
-        if (nullptr == sessValPtr) {
-            return;
+        std::unique_lock lock(mUclampWriteMutex);
+        mUclampWriteCv.wait(lock, [&] { return mUclampWriteServed + 1 == writes.ticket; });
+    }
+
+    std::vector<pid_t> failed;
+    std::vector<pid_t> dead;
+    if (writes.cgroup) {
+        writes.cgroup->setUclamp(writes.cgroupRange);
+    }
+    for (const auto &[tid, range] : writes.tasks) {
+        const int stat = set_uclamp(tid, range);
+        if (stat == ESRCH) {
+            dead.push_back(tid);
+        } else if (stat != 0) {
+            failed.push_back(tid);
+        }
+    }
+
+    {
+        std::lock_guard lock(mUclampWriteMutex);
+        mUclampWriteServed = writes.ticket;
+    }
+    mUclampWriteCv.notify_all();
+
+    if (failed.empty() && dead.empty()) {
+        return;
+    }
+    std::lock_guard lock(mSessionTaskMapMutex);
+    for (auto tid : failed) {
+        mSessionTaskMap.invalidateUclampApplied(tid);
+    }
+    for (auto tid : dead) {
+        const auto sessionIds = mSessionTaskMap.removeDeadTask(tid);
+        if (!sessionIds.empty()) {
+            ALOGV("Removed dead thread %d from %zu hint sessions.", tid, sessionIds.size());
         }
+    }
+}
 
-        if (!config->mUclampMinOn) {
-            ALOGV("PowerSessionManager::set_uclamp: skip");
-        } else {
-            auto &threadList = mSessionTaskMap.getTaskIds(sessionId);
-            auto tidIter = threadList.begin();
-            while (tidIter != threadList.end()) {
-                UclampRange uclampRange;
-                mSessionTaskMap.getTaskVoteRange(*tidIter, timePoint, uclampRange,
-                                                 config->mUclampMaxEfficientBase,
-                                                 config->mUclampMaxEfficientOffset);
-                int stat = set_uclamp(*tidIter, uclampRange);
-                if (stat == ESRCH) {
-                    ALOGV("Removing dead thread %d from hint session %s.", *tidIter,
-                          sessValPtr->idString.c_str());
-                    if (mSessionTaskMap.removeDeadTaskSessionMap(sessionId, *tidIter)) {
-                        ALOGV("Removed dead thread-session map.");
-                    }
-                    tidIter = threadList.erase(tidIter);
-                } else {
-                    tidIter++;
-                }
+template <class HintManagerT>
+void PowerSessionManager<HintManagerT>::updateUclampBackendLocked(int64_t sessionId,
+                                                                  UclampWrites *writes) {
+    auto cgroupItr = mSessionCgroups.find(sessionId);
+    const auto &threadList = mSessionTaskMap.getTaskIds(sessionId);
+    std::vector<pid_t> movedIn;
+    std::vector<pid_t> movedOut;
+    if (mCgroupUclampThreads == 0 || threadList.size() < mCgroupUclampThreads) {
+        if (cgroupItr != mSessionCgroups.end()) {
+            cgroupItr->second->setTasks({}, nullptr, &movedOut);
+            mSessionCgroups.erase(cgroupItr);
+        }
+    } else {
+        if (cgroupItr == mSessionCgroups.end()) {
+            auto cgroup = SessionCgroup::create(kCpuctlRoot, sessionId);
+            if (!cgroup) {
+                return;
+            }
+            cgroupItr = mSessionCgroups.emplace(sessionId, std::move(cgroup)).first;
+        }
+        // A thread can only be in one cgroup, shared threads keep their own uclamp
+        std::vector<pid_t> exclusiveThreads;
+        for (auto tid : threadList) {
+            if (mSessionTaskMap.getSessionIds(tid).size() == 1) {
+                exclusiveThreads.push_back(tid);
             }
         }
+        cgroupItr->second->setTasks(exclusiveThreads, &movedIn, &movedOut);
+    }
 
-        sessValPtr->lastUpdatedTime = timePoint;
+    // The uclamp of a thread is clamped by its cgroup, so the threads moved
+    // in drop theirs for the cgroup one to take effect
+    for (auto tid : movedIn) {
+        const UclampRange fullRange;
+        mSessionTaskMap.setUclampApplied(tid, fullRange);
+        writes->tasks.emplace_back(tid, fullRange);
+    }
+    for (auto tid : movedOut) {
+        mSessionTaskMap.invalidateUclampApplied(tid);
     }
+    takeUclampTicketLocked(writes);
 }
 
 template <class HintManagerT>
@@ -516,18 +734,33 @@ void PowerSessionManager<HintManagerT>::applyGpuVotesLocked(
     auto const gpuVotingOn = HintManager::GetInstance()->GetAdpfProfile()->mGpuBoostOn;
     if (mGpuCapacityNode && gpuVotingOn) {
         auto const capacity = mSessionTaskMap.getSessionsGpuCapacity(timePoint);
-        (*mGpuCapacityNode)->set_gpu_capacity(capacity);
+        // Sessions reporting within the same coalesce window share one write
+        auto const flushTime = (*mGpuCapacityNode)->request_gpu_capacity(capacity, now());
+        if (flushTime) {
+            mGpuCapacityFlushWorker.schedule({.deadline = *flushTime}, *flushTime);
+        }
     }
 
     sessValPtr->lastUpdatedTime = timePoint;
 }
 
+template <class HintManagerT>
+void PowerSessionManager<HintManagerT>::handleEvent(const EventGpuCapacityFlush &) {
+    if (mGpuCapacityNode) {
+        (*mGpuCapacityNode)->flush_gpu_capacity(now());
+    }
+}
+
 template <class HintManagerT>
 void PowerSessionManager<HintManagerT>::applyCpuAndGpuVotes(
         int64_t sessionId, std::chrono::steady_clock::time_point timePoint) {
-    std::lock_guard lock(mSessionTaskMapMutex);
-    applyUclampLocked(sessionId, timePoint);
-    applyGpuVotesLocked(sessionId, timePoint);
+    UclampWrites writes;
+    {
+        std::lock_guard lock(mSessionTaskMapMutex);
+        collectUclampLocked(sessionId, timePoint, &writes);
+        applyGpuVotesLocked(sessionId, timePoint);
+    }
+    applyUclampWrites(writes);
 }
 
 template <class HintManagerT>
@@ -538,10 +771,18 @@ std::optional<Frequency> PowerSessionManager<HintManagerT>::gpuFrequency() const
     return {};
 }
 
+template <class HintManagerT>
+std::optional<uint64_t> PowerSessionManager<HintManagerT>::cpuEnergyUWs() const {
+    if (mCpuEnergyMeter) {
+        return mCpuEnergyMeter->readEnergyUWs();
+    }
+    return {};
+}
+
 template <class HintManagerT>
 void PowerSessionManager<HintManagerT>::forceSessionActive(int64_t sessionId, bool isActive) {
     {
-        std::lock_guard<std::mutex> lock(mSessionTaskMapMutex);
+        std::lock_guard lock(mSessionTaskMapMutex);
         auto sessValPtr = mSessionTaskMap.findSession(sessionId);
         if (nullptr == sessValPtr) {
             return;
@@ -552,21 +793,71 @@ void PowerSessionManager<HintManagerT>::forceSessionActive(int64_t sessionId, bo
     // As currently written, call needs to occur synchronously so as to ensure
     // that the SessionId remains valid and mapped to the proper threads/tasks
     // which enables apply u clamp to work correctly
-    applyCpuAndGpuVotes(sessionId, std::chrono::steady_clock::now());
-    updateUniversalBoostMode();
+    applyCpuAndGpuVotes(sessionId, now());
+    updateUniversalBoostMode(sessionId);
+    updateTaskPlacement(sessionId);
 }
 
 template <class HintManagerT>
-void PowerSessionManager<HintManagerT>::setPreferPowerEfficiency(int64_t sessionId, bool enabled) {
-    std::lock_guard<std::mutex> lock(mSessionTaskMapMutex);
-    auto sessValPtr = mSessionTaskMap.findSession(sessionId);
-    if (nullptr == sessValPtr) {
-        return;
+void PowerSessionManager<HintManagerT>::updateTaskPlacement(int64_t sessionId) {
+    auto config = HintManager::GetInstance()->GetAdpfProfile();
+    std::string profile;
+    std::vector<pid_t> tids;
+    {
+        std::lock_guard lock(mSessionTaskMapMutex);
+        auto sessValPtr = mSessionTaskMap.findSession(sessionId);
+        if (nullptr == sessValPtr) {
+            return;
+        }
+        const auto &threadList = mSessionTaskMap.getTaskIds(sessionId);
+        const bool place = sessValPtr->isActive && !threadList.empty() &&
+                           config->mSessionTaskProfile && isPlacedTag(*config, sessValPtr->tag);
+        if (place == sessValPtr->taskProfileRevert.has_value()) {
+            return;
+        }
+        if (place) {
+            // Undone with the revert profile of the config it was placed by
+            profile = *config->mSessionTaskProfile;
+            sessValPtr->taskProfileRevert = config->mSessionTaskProfileRevert;
+            tids.assign(threadList.begin(), threadList.end());
+        } else {
+            profile = *sessValPtr->taskProfileRevert;
+            sessValPtr->taskProfileRevert.reset();
+            // Threads another placed session shares stay where they are
+            for (auto tid : threadList) {
+                const auto &sessionIds = mSessionTaskMap.getSessionIds(tid);
+                if (std::none_of(sessionIds.begin(), sessionIds.end(), [&](int64_t id) {
+                        const auto other = mSessionTaskMap.findSession(id);
+                        return id != sessionId && other && other->taskProfileRevert;
+                    })) {
+                    tids.push_back(tid);
+                }
+            }
+        }
+    }
+    for (auto tid : tids) {
+        if (!SetTaskProfiles(tid, {profile})) {
+            ALOGE("Failed to set %s task profile for tid:%d", profile.c_str(), tid);
+        }
     }
-    if (enabled != sessValPtr->isPowerEfficient) {
+}
+
+template <class HintManagerT>
+void PowerSessionManager<HintManagerT>::setPreferPowerEfficiency(int64_t sessionId, bool enabled) {
+    UclampWrites writes;
+    {
+        std::lock_guard lock(mSessionTaskMapMutex);
+        auto sessValPtr = mSessionTaskMap.findSession(sessionId);
+        if (nullptr == sessValPtr) {
+            return;
+        }
+        if (enabled == sessValPtr->isPowerEfficient) {
+            return;
+        }
         sessValPtr->isPowerEfficient = enabled;
-        applyUclampLocked(sessionId, std::chrono::steady_clock::now());
+        collectUclampLocked(sessionId, now(), &writes);
     }
+    applyUclampWrites(writes);
 }
 
 template <class HintManagerT>
@@ -603,6 +894,38 @@ void PowerSessionManager<HintManagerT>::clear() {
     mSessionMap.clear();
 }
 
+template <class HintManagerT>
+std::chrono::steady_clock::time_point PowerSessionManager<HintManagerT>::now() const {
+    return mClock ? mClock() : std::chrono::steady_clock::now();
+}
+
+template <class HintManagerT>
+void PowerSessionManager<HintManagerT>::setClock(
+        std::function<std::chrono::steady_clock::time_point()> clock) {
+    // The worker threads would run the timed work at the real time
+    mPriorityQueueWorkerPool->stopThreads();
+    mClock = std::move(clock);
+}
+
+template <class HintManagerT>
+void PowerSessionManager<HintManagerT>::runDueWork() {
+    mPriorityQueueWorkerPool->runDue(now());
+}
+
+template <class HintManagerT>
+std::optional<UclampRange> PowerSessionManager<HintManagerT>::getSessionUclampRange(
+        int64_t sessionId) {
+    auto config = HintManager::GetInstance()->GetAdpfProfile();
+    UclampRange range;
+    std::lock_guard lock(mSessionTaskMapMutex);
+    if (!mSessionTaskMap.getSessionVoteRange(sessionId, now(), range,
+                                             config->mUclampMaxEfficientBase,
+                                             config->mUclampMaxEfficientOffset)) {
+        return std::nullopt;
+    }
+    return range;
+}
+
 template class PowerSessionManager<>;
 template class PowerSessionManager<testing::NiceMock<mock::pixel::MockHintManager>>;
 
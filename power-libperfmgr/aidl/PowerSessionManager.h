@@ -20,13 +20,20 @@
 #include <perfmgr/HintManager.h>
 #include <utils/Mutex.h>
 
+#include <condition_variable>
+#include <functional>
 #include <mutex>
 #include <optional>
+#include <unordered_map>
 
 #include "AppHintDesc.h"
 #include "BackgroundWorker.h"
+#include "CpuEnergyMeter.h"
 #include "GpuCapacityNode.h"
+#include "InstrumentedMutex.h"
+#include "SessionCgroup.h"
 #include "SessionTaskMap.h"
+#include "TaskLivenessMonitor.h"
 
 namespace aidl {
 namespace google {
@@ -38,11 +45,15 @@ namespace pixel {
 using ::android::Thread;
 
 constexpr char kPowerHalAdpfDisableTopAppBoost[] = "vendor.powerhal.adpf.disable.hint";
+// Minimum time the top-app boost stays in a state before it toggles again
+constexpr char kPowerHalAdpfTopAppBoostHoldMs[] = "vendor.powerhal.adpf.ta_boost_hold_ms";
+// Time without any active app session before the top-app boost comes back
+constexpr char kPowerHalAdpfTopAppBoostReleaseMs[] = "vendor.powerhal.adpf.ta_boost_release_ms";
 
 template <class HintManagerT = ::android::perfmgr::HintManager>
 class PowerSessionManager : public Immobile {
   public:
-    ~PowerSessionManager() = default;
+    ~PowerSessionManager();
 
     // Update the current hint info
     void updateHintMode(const std::string &mode, bool enabled);
@@ -60,7 +71,9 @@ class PowerSessionManager : public Immobile {
     void pause(int64_t sessionId);
     void resume(int64_t sessionId);
 
-    void updateUniversalBoostMode();
+    // Recount the session as an active app session or not, and disable the
+    // system top-app boost while any app session is active
+    void updateUniversalBoostMode(int64_t sessionId);
     void dumpToFd(int fd);
 
     void updateTargetWorkDuration(int64_t sessionId, AdpfVoteType voteId,
@@ -85,6 +98,8 @@ class PowerSessionManager : public Immobile {
     }
 
     std::optional<Frequency> gpuFrequency() const;
+    // Energy of the CPU clusters so far, nullopt unless configured, see CpuEnergyMeter
+    std::optional<uint64_t> cpuEnergyUWs() const;
 
     void registerSession(std::shared_ptr<void> session, int64_t sessionId);
     void unregisterSession(int64_t sessionId);
@@ -92,19 +107,89 @@ class PowerSessionManager : public Immobile {
     void clear();
     std::shared_ptr<void> getSession(int64_t sessionId);
 
+    // Time the votes of the sessions start and time out at, steady_clock
+    // unless set by setClock()
+    std::chrono::steady_clock::time_point now() const;
+    // Only for replay, before any session is added: take the time from clock
+    // and run the timed work, such as vote timeouts, from runDueWork() only.
+    void setClock(std::function<std::chrono::steady_clock::time_point()> clock);
+    // Only for replay: run the timed work due by now()
+    void runDueWork();
+    // Uclamp range the votes of the session give its threads, nullopt if
+    // there is no such session
+    std::optional<UclampRange> getSessionUclampRange(int64_t sessionId);
+
   private:
-    std::optional<bool> isAnyAppSessionActive();
     void disableSystemTopAppBoost();
     void enableSystemTopAppBoost();
     const std::string kDisableBoostHintName;
+    const ::android::perfmgr::HintId mDisableBoostHintId;
+
+    // Toggle the top-app boost to follow the count of active app sessions.
+    // Disabling it is held off until the boost has been enabled for
+    // mTopAppBoostHold, enabling it back also until no app session has been
+    // active for mTopAppBoostRelease. A held off toggle is retried later
+    // through mTopAppBoostWorker.
+    void updateTopAppBoost();
+    struct EventTopAppBoostUpdate {};
+    void handleEvent(const EventTopAppBoostUpdate &e);
+    const std::chrono::milliseconds mTopAppBoostHold;
+    const std::chrono::milliseconds mTopAppBoostRelease;
+    std::mutex mTopAppBoostMutex;
+    struct TopAppBoostState {
+        bool disabled{false};
+        std::chrono::steady_clock::time_point lastToggle;
+        std::optional<std::chrono::steady_clock::time_point> inactiveSince;
+        uint64_t numDisable{0};
+        uint64_t numEnable{0};
+        uint64_t numDeferred{0};
+    } mTopAppBoost GUARDED_BY(mTopAppBoostMutex);
 
     int mDisplayRefreshRate;
+    // Set by setClock() for replay, empty for steady_clock
+    std::function<std::chrono::steady_clock::time_point()> mClock;
 
     // Rewrite specific
-    mutable std::mutex mSessionTaskMapMutex;
+    mutable InstrumentedMutex mSessionTaskMapMutex;
     SessionTaskMap mSessionTaskMap;
+    // Vote timeouts run in the realtime lane so housekeeping can't delay a
+    // uclamp release, its thread count comes from the ADPF profile
+    static std::shared_ptr<PriorityQueueWorkerPool> createWorkerPool();
     std::shared_ptr<PriorityQueueWorkerPool> mPriorityQueueWorkerPool;
 
+    // Sessions applying their uclamp through a cgroup, see SessionCgroup
+    const size_t mCgroupUclampThreads;
+    std::unordered_map<int64_t, std::shared_ptr<SessionCgroup>> mSessionCgroups
+            GUARDED_BY(mSessionTaskMapMutex);
+
+    // Uclamp writes computed under mSessionTaskMapMutex, made after it is
+    // released so the sched_setattr and cgroup writes don't hold up the other
+    // sessions. Writes take a ticket while the map is locked and are made in
+    // ticket order, so the last range computed for a thread is the one it ends
+    // up with.
+    struct UclampWrites {
+        std::vector<std::pair<pid_t, UclampRange>> tasks;
+        // Keeps the cgroup alive if the session goes away in between
+        std::shared_ptr<SessionCgroup> cgroup;
+        UclampRange cgroupRange;
+        uint64_t ticket{0};
+    };
+    void takeUclampTicketLocked(UclampWrites *writes) REQUIRES(mSessionTaskMapMutex);
+    void applyUclampWrites(const UclampWrites &writes) EXCLUDES(mSessionTaskMapMutex);
+    uint64_t mUclampWriteNext GUARDED_BY(mSessionTaskMapMutex){0};
+    // Last ticket written, guarded by mUclampWriteMutex
+    std::mutex mUclampWriteMutex;
+    std::condition_variable mUclampWriteCv;
+    uint64_t mUclampWriteServed{0};
+
+    // Move the threads of a session in or out of its cgroup after they changed
+    void updateUclampBackendLocked(int64_t sessionId, UclampWrites *writes)
+            REQUIRES(mSessionTaskMapMutex);
+
+    // Drops the linked tasks of all sessions as soon as they exit
+    void handleTaskDead(pid_t taskId);
+    std::shared_ptr<TaskLivenessMonitor> mTaskLivenessMonitor;
+
     // Session timeout
     struct EventSessionTimeout {
         std::chrono::steady_clock::time_point timeStamp;
@@ -112,11 +197,15 @@ class PowerSessionManager : public Immobile {
         int voteId{0};
     };
     void handleEvent(const EventSessionTimeout &e);
+    static int64_t timeoutKey(int64_t sessionId, int voteId) {
+        return sessionId * static_cast<int64_t>(AdpfVoteType::VOTE_TYPE_SIZE) + voteId;
+    }
     TemplatePriorityQueueWorker<EventSessionTimeout> mEventSessionTimeoutWorker;
 
-    // Calculate uclamp range
-    void applyUclampLocked(int64_t sessionId, std::chrono::steady_clock::time_point timePoint)
-            REQUIRES(mSessionTaskMapMutex);
+    // Calculate the uclamp range of the threads of a session, to be applied
+    // with applyUclampWrites once the map is unlocked
+    void collectUclampLocked(int64_t sessionId, std::chrono::steady_clock::time_point timePoint,
+                             UclampWrites *writes) REQUIRES(mSessionTaskMapMutex);
 
     void applyGpuVotesLocked(int64_t sessionId, std::chrono::steady_clock::time_point timePoint)
             REQUIRES(mSessionTaskMapMutex);
@@ -124,19 +213,50 @@ class PowerSessionManager : public Immobile {
     void applyCpuAndGpuVotes(int64_t sessionId, std::chrono::steady_clock::time_point timePoint);
     // Force a session active or in-active, helper for other methods
     void forceSessionActive(int64_t sessionId, bool isActive);
+    // Apply the task profile placing the threads of a session while it is
+    // active and has threads, undo it otherwise, see
+    // AdpfConfig::mSessionTaskProfile
+    void updateTaskPlacement(int64_t sessionId);
 
     // Singleton
     PowerSessionManager()
         : kDisableBoostHintName(::android::base::GetProperty(kPowerHalAdpfDisableTopAppBoost,
                                                              "ADPF_DISABLE_TA_BOOST")),
+          mDisableBoostHintId(::android::perfmgr::HintManager::LookupHint(kDisableBoostHintName)),
+          mTopAppBoostHold(
+                  ::android::base::GetUintProperty<uint32_t>(kPowerHalAdpfTopAppBoostHoldMs, 100)),
+          mTopAppBoostRelease(::android::base::GetUintProperty<uint32_t>(
+                  kPowerHalAdpfTopAppBoostReleaseMs, 300)),
           mDisplayRefreshRate(60),
-          mPriorityQueueWorkerPool(new PriorityQueueWorkerPool(1, "adpf_handler")),
-          mEventSessionTimeoutWorker([&](auto e) { handleEvent(e); }, mPriorityQueueWorkerPool),
-          mGpuCapacityNode(createGpuCapacityNode()) {}
+          mPriorityQueueWorkerPool(createWorkerPool()),
+          mCgroupUclampThreads(
+                  ::android::base::GetUintProperty<size_t>(kPowerHalAdpfCgroupUclampThreads, 0)),
+          mTaskLivenessMonitor(std::make_shared<TaskLivenessMonitor>(
+                  [&](pid_t taskId) { handleTaskDead(taskId); })),
+          mEventSessionTimeoutWorker([&](auto e) { handleEvent(e); }, mPriorityQueueWorkerPool,
+                                     WorkerLane::REALTIME),
+          mGpuCapacityNode(createGpuCapacityNode()),
+          mCpuEnergyMeter(CpuEnergyMeter::create()),
+          mGpuCapacityFlushWorker([&](auto e) { handleEvent(e); }, mPriorityQueueWorkerPool),
+          mTopAppBoostWorker([&](auto e) { handleEvent(e); }, mPriorityQueueWorkerPool) {
+        if (mTaskLivenessMonitor->isValid()) {
+            std::lock_guard lock(mSessionTaskMapMutex);
+            mSessionTaskMap.setTaskWatcher(mTaskLivenessMonitor);
+        }
+    }
     PowerSessionManager(PowerSessionManager const &) = delete;
     PowerSessionManager &operator=(PowerSessionManager const &) = delete;
 
     std::optional<std::unique_ptr<GpuCapacityNode>> const mGpuCapacityNode;
+    std::unique_ptr<CpuEnergyMeter> const mCpuEnergyMeter;
+
+    // Deferred write of GPU capacity votes coalesced by mGpuCapacityNode
+    struct EventGpuCapacityFlush {
+        std::chrono::steady_clock::time_point deadline;
+    };
+    void handleEvent(const EventGpuCapacityFlush &e);
+    TemplatePriorityQueueWorker<EventGpuCapacityFlush> mGpuCapacityFlushWorker;
+    TemplatePriorityQueueWorker<EventTopAppBoostUpdate> mTopAppBoostWorker;
 
     std::mutex mSessionMapMutex;
     std::map<int, std::weak_ptr<void>> mSessionMap GUARDED_BY(mSessionMapMutex);
@@ -0,0 +1,225 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "powerhal-libperfmgr"
+
+#include "SessionCgroup.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstring>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+namespace {
+
+// cpu.uclamp.min/max take a percentage with two decimals
+std::string toPercent(int uclamp) {
+    return ::android::base::StringPrintf("%.2f", uclamp * 100.0 / kUclampMax);
+}
+
+}  // namespace
+
+std::unique_ptr<SessionCgroup> SessionCgroup::create(const std::string &root, int64_t sessionId,
+                                                     CgroupReader reader) {
+    struct stat st;
+    if (stat(root.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        LOG(ERROR) << "No cgroup root " << root;
+        return nullptr;
+    }
+    return std::unique_ptr<SessionCgroup>(new SessionCgroup(
+            root, ::android::base::StringPrintf("adpf-%" PRId64, sessionId), std::move(reader)));
+}
+
+SessionCgroup::SessionCgroup(const std::string &root, std::string name, CgroupReader reader)
+    : mRoot(root), mName(std::move(name)), mReader(std::move(reader)) {}
+
+SessionCgroup::~SessionCgroup() {
+    setTasks({}, nullptr, nullptr);
+}
+
+std::optional<std::string> SessionCgroup::parseCpuCgroup(const std::string &procCgroup) {
+    // Lines are "<id>:<controllers>:<path>"
+    for (const auto &line : ::android::base::Split(procCgroup, "\n")) {
+        const auto fields = ::android::base::Split(line, ":");
+        if (fields.size() != 3) {
+            continue;
+        }
+        const auto controllers = ::android::base::Split(fields[1], ",");
+        if (std::find(controllers.begin(), controllers.end(), "cpu") != controllers.end()) {
+            return fields[2] == "/" ? "" : fields[2];
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<std::string> SessionCgroup::readCpuCgroup(pid_t taskId) {
+    std::string procCgroup;
+    if (!::android::base::ReadFileToString(
+                ::android::base::StringPrintf("/proc/%d/cgroup", taskId), &procCgroup)) {
+        return std::nullopt;
+    }
+    return parseCpuCgroup(procCgroup);
+}
+
+std::string SessionCgroup::childOf(const std::string &parent) const {
+    return parent + "/" + mName;
+}
+
+bool SessionCgroup::moveTask(pid_t taskId, const std::string &cgroup) {
+    const std::string path = mRoot + cgroup;
+    if (!::android::base::WriteStringToFile(std::to_string(taskId), path + "/tasks")) {
+        // ESRCH once the thread exited, nothing is left to move
+        if (errno != ESRCH) {
+            LOG(WARNING) << "Failed to move thread " << taskId << " to " << path << ": "
+                         << strerror(errno);
+        }
+        return false;
+    }
+    return true;
+}
+
+bool SessionCgroup::ensureChild(const std::string &parent) {
+    if (mChildren.count(parent) > 0) {
+        return true;
+    }
+    const std::string path = mRoot + childOf(parent);
+    if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+        LOG(ERROR) << "Failed to create cgroup " << path << ": " << strerror(errno);
+        return false;
+    }
+    mChildren.insert(parent);
+    // Children created later take the range the others already have
+    if (mAppliedUclamp) {
+        const UclampRange range = *mAppliedUclamp;
+        mAppliedUclamp.reset();
+        setUclamp(range);
+    }
+    return true;
+}
+
+void SessionCgroup::removeUnusedChildren() {
+    for (auto itr = mChildren.begin(); itr != mChildren.end();) {
+        const bool used = std::any_of(mTasks.begin(), mTasks.end(),
+                                      [&](const auto &task) { return task.second == *itr; });
+        if (used) {
+            ++itr;
+            continue;
+        }
+        const std::string path = mRoot + childOf(*itr);
+        if (rmdir(path.c_str()) != 0) {
+            LOG(WARNING) << "Failed to remove cgroup " << path << ": " << strerror(errno);
+        }
+        itr = mChildren.erase(itr);
+    }
+}
+
+void SessionCgroup::setTasks(const std::vector<pid_t> &taskIds, std::vector<pid_t> *movedIn,
+                             std::vector<pid_t> *movedOut) {
+    for (auto itr = mTasks.begin(); itr != mTasks.end();) {
+        if (std::find(taskIds.begin(), taskIds.end(), itr->first) != taskIds.end()) {
+            ++itr;
+            continue;
+        }
+        // The origin recorded when moving in may be stale, only a thread
+        // still in the child goes back to its parent
+        const auto current = mReader(itr->first);
+        if (!current || *current == childOf(itr->second)) {
+            moveTask(itr->first, itr->second);
+        }
+        if (movedOut) {
+            movedOut->push_back(itr->first);
+        }
+        itr = mTasks.erase(itr);
+    }
+
+    for (auto taskId : taskIds) {
+        const auto current = mReader(taskId);
+        auto task = mTasks.find(taskId);
+        if (task != mTasks.end() && (!current || *current == childOf(task->second))) {
+            continue;
+        }
+        // Without a known cgroup the thread goes under the root, one left in
+        // a session cgroup by an earlier instance keeps its parent
+        std::string parent = current.value_or("");
+        if (::android::base::EndsWith(parent, "/" + mName)) {
+            parent.resize(parent.size() - mName.size() - 1);
+        }
+        if (!ensureChild(parent) || !moveTask(taskId, childOf(parent))) {
+            continue;
+        }
+        if (task != mTasks.end()) {
+            task->second = parent;
+            continue;
+        }
+        mTasks.emplace(taskId, parent);
+        if (movedIn) {
+            movedIn->push_back(taskId);
+        }
+    }
+    removeUnusedChildren();
+}
+
+bool SessionCgroup::hasTask(pid_t taskId) const {
+    return mTasks.count(taskId) > 0;
+}
+
+size_t SessionCgroup::numTasks() const {
+    return mTasks.size();
+}
+
+bool SessionCgroup::setUclamp(const UclampRange &range) {
+    if (mAppliedUclamp == range) {
+        return true;
+    }
+    bool ok = true;
+    for (const auto &parent : mChildren) {
+        const std::string path = mRoot + childOf(parent);
+        if (!::android::base::WriteStringToFile(toPercent(range.uclampMin),
+                                                path + "/cpu.uclamp.min") ||
+            !::android::base::WriteStringToFile(toPercent(range.uclampMax),
+                                                path + "/cpu.uclamp.max")) {
+            LOG(WARNING) << "Failed to set uclamp of " << path << ": " << strerror(errno);
+            ok = false;
+        }
+    }
+    if (ok) {
+        mAppliedUclamp = range;
+    } else {
+        mAppliedUclamp.reset();
+    }
+    return ok;
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
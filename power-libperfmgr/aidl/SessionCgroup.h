@@ -0,0 +1,106 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "AdpfTypes.h"
+#include "UClampVoter.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+constexpr char kCpuctlRoot[] = "/dev/cpuctl";
+// Sessions with at least this many threads apply their uclamp through a
+// cgroup of their own, 0 turns the cgroup backend off.
+constexpr char kPowerHalAdpfCgroupUclampThreads[] = "vendor.powerhal.adpf.cgroup_uclamp_threads";
+
+// A cpu controller cgroup holding the threads of one hint session, so a vote
+// change costs one write of cpu.uclamp.min/max instead of a sched_setattr per
+// thread. Threads keep the cpu.shares and uclamp limits of the cgroup they
+// came from, such as top-app, as the session cgroup is created under it; a
+// session with threads in several cgroups gets one child in each of them.
+// The kernel caps the uclamp of a cgroup by the one of its parent, so the
+// parents need a cpu.uclamp.min leaving room for the session votes.
+// Threads are moved back to the parent once they leave the session, unless
+// something else moved them out of the session cgroup in the meantime.
+class SessionCgroup : public Immobile {
+  public:
+    // Return the cpu controller cgroup of a thread relative to the root, ""
+    // for the root itself, nullopt if unknown
+    using CgroupReader = std::function<std::optional<std::string>(pid_t)>;
+
+    // Return nullptr if root, the mount point of the cpu controller, isn't a
+    // directory. The cgroups are created as threads get moved in.
+    static std::unique_ptr<SessionCgroup> create(const std::string &root, int64_t sessionId,
+                                                 CgroupReader reader = readCpuCgroup);
+    ~SessionCgroup();
+
+    // Make taskIds the threads of the cgroup. Return the threads moved in and
+    // out, threads which couldn't be moved in are left out. Threads moved to
+    // another cgroup by someone else are moved back in under that one.
+    void setTasks(const std::vector<pid_t> &taskIds, std::vector<pid_t> *movedIn,
+                  std::vector<pid_t> *movedOut);
+    bool hasTask(pid_t taskId) const;
+    size_t numTasks() const;
+    // Write the range to the cgroups unless it is already applied, return
+    // false on failure.
+    bool setUclamp(const UclampRange &range);
+    // The session cgroup under parent, relative to the root like the result
+    // of the CgroupReader
+    std::string childOf(const std::string &parent) const;
+
+    // Return the cpu controller cgroup of a cgroup v1 /proc/<tid>/cgroup.
+    static std::optional<std::string> parseCpuCgroup(const std::string &procCgroup);
+    static std::optional<std::string> readCpuCgroup(pid_t taskId);
+
+  private:
+    SessionCgroup(const std::string &root, std::string name, CgroupReader reader);
+    bool moveTask(pid_t taskId, const std::string &cgroup);
+    // Create the child under parent if missing, return false on failure
+    bool ensureChild(const std::string &parent);
+    void removeUnusedChildren();
+
+    const std::string mRoot;
+    const std::string mName;
+    const CgroupReader mReader;
+    // Parents the session has a child cgroup under
+    std::unordered_set<std::string> mChildren;
+    // Thread to the parent of the child cgroup it was moved to
+    std::unordered_map<pid_t, std::string> mTasks;
+    std::optional<UclampRange> mAppliedUclamp;
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SessionMetrics.h"
+
+#include <algorithm>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+namespace {
+
+int missRatePercent(uint64_t missed, uint64_t frames) {
+    return frames == 0 ? 0 : static_cast<int>(missed * 100 / frames);
+}
+
+}  // namespace
+
+void LatencyStats::record(std::chrono::nanoseconds latency) {
+    const int64_t ns = std::max<int64_t>(0, latency.count());
+    count++;
+    totalNs += ns;
+    maxNs = std::max(maxNs, ns);
+}
+
+std::ostream &LatencyStats::dump(std::ostream &os, const char *name) const {
+    os << name << ": " << count;
+    if (count > 0) {
+        os << " " << totalNs / static_cast<int64_t>(count) / 1000 << "/" << maxNs / 1000 << "us";
+    }
+    return os;
+}
+
+void SessionMetrics::recordFrames(uint64_t frames, uint64_t missedFrames, bool boosted) {
+    if (boosted) {
+        boostedFrames += frames;
+        boostedMissedFrames += missedFrames;
+    } else {
+        unboostedFrames += frames;
+        unboostedMissedFrames += missedFrames;
+    }
+}
+
+void SessionMetrics::recordUclampMin(int uclampMin) {
+    const int bucket = std::clamp(uclampMin / kUclampMinBucketSize, 0, kUclampMinBuckets - 1);
+    uclampMinHistogram[bucket]++;
+}
+
+std::ostream &SessionMetrics::dump(std::ostream &os) const {
+    reportToApplied.dump(os, "ReportToApplied");
+    os << ", Missed%(" << missRatePercent(unboostedMissedFrames, unboostedFrames) << " of "
+       << unboostedFrames << " unboosted, "
+       << missRatePercent(boostedMissedFrames, boostedFrames) << " of " << boostedFrames
+       << " boosted)";
+    os << ", UclampMin[";
+    for (int i = 0; i < kUclampMinBuckets; i++) {
+        os << (i == 0 ? "" : " ") << uclampMinHistogram[i];
+    }
+    os << "]";
+    return os;
+}
+
+std::atomic<int64_t> SessionFootprint::sSessions{0};
+std::atomic<int64_t> SessionFootprint::sBytes{0};
+
+void SessionFootprint::add(int64_t sessions, int64_t bytes) {
+    sSessions += sessions;
+    sBytes += bytes;
+}
+
+std::ostream &SessionFootprint::dump(std::ostream &os) {
+    const int64_t sessions = sSessions.load();
+    const int64_t bytes = sBytes.load();
+    os << "Sessions: " << sessions << ", " << bytes << " bytes, "
+       << (sessions == 0 ? 0 : bytes / sessions) << " bytes/session";
+    return os;
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
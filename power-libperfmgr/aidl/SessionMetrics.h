@@ -0,0 +1,82 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+// Count, mean and max of a latency, constant size and no locking of its own.
+struct LatencyStats {
+    uint64_t count{0};
+    int64_t totalNs{0};
+    int64_t maxNs{0};
+
+    void record(std::chrono::nanoseconds latency);
+    // Write "name: n avg/max us" to ostream
+    std::ostream &dump(std::ostream &os, const char *name) const;
+};
+
+// How well ADPF keeps up with a session, updated on every report and
+// dumped with the session. It only keeps counters which are cheap enough to
+// update whether tracing is on or not.
+struct SessionMetrics {
+    static constexpr int kUclampMinBucketSize = 64;
+    static constexpr int kUclampMinBuckets = 1024 / kUclampMinBucketSize;
+
+    // From entering reportActualWorkDuration to the uclamp vote being applied
+    LatencyStats reportToApplied;
+    // Frames reported while the session ran at the uclamp min floor or above it
+    uint64_t unboostedFrames{0};
+    uint64_t unboostedMissedFrames{0};
+    uint64_t boostedFrames{0};
+    uint64_t boostedMissedFrames{0};
+    // Applied uclamp min values, kUclampMinBucketSize wide buckets
+    std::array<uint32_t, kUclampMinBuckets> uclampMinHistogram{};
+
+    void recordFrames(uint64_t frames, uint64_t missedFrames, bool boosted);
+    void recordUclampMin(int uclampMin);
+    // Write info about the metrics to ostream for logging and debugging
+    std::ostream &dump(std::ostream &os) const;
+};
+
+// Bytes held by the live sessions and their buffers, shared by all of them
+struct SessionFootprint {
+    static void add(int64_t sessions, int64_t bytes);
+    // Write "Sessions: n, b bytes, b/n bytes/session" to ostream
+    static std::ostream &dump(std::ostream &os);
+
+  private:
+    static std::atomic<int64_t> sSessions;
+    static std::atomic<int64_t> sBytes;
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
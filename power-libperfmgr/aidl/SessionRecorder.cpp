@@ -0,0 +1,290 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "powerhal-libperfmgr"
+
+#include "SessionRecorder.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cinttypes>
+#include <cstring>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+namespace {
+
+constexpr char kMagic[] = {'A', 'D', 'P', 'R'};
+constexpr uint8_t kVersion = 1;
+
+void putVarint(std::string *out, uint64_t value) {
+    while (value >= 0x80) {
+        out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out->push_back(static_cast<char>(value));
+}
+
+void putSigned(std::string *out, int64_t value) {
+    putVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+class Reader {
+  public:
+    explicit Reader(std::string_view data) : mData(data) {}
+
+    bool atEnd() const { return mPos == mData.size(); }
+
+    bool getByte(uint8_t *value) {
+        if (atEnd()) {
+            return false;
+        }
+        *value = static_cast<uint8_t>(mData[mPos++]);
+        return true;
+    }
+
+    bool getVarint(uint64_t *value) {
+        uint64_t result = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte;
+            if (!getByte(&byte)) {
+                return false;
+            }
+            result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                *value = result;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool getSigned(int64_t *value) {
+        uint64_t raw;
+        if (!getVarint(&raw)) {
+            return false;
+        }
+        *value = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+        return true;
+    }
+
+    template <typename T>
+    bool getInt(T *value) {
+        int64_t raw;
+        if (!getSigned(&raw)) {
+            return false;
+        }
+        *value = static_cast<T>(raw);
+        return true;
+    }
+
+  private:
+    std::string_view mData;
+    size_t mPos{0};
+};
+
+}  // namespace
+
+std::optional<SessionRecording> SessionRecording::parse(std::string_view data) {
+    if (data.size() < sizeof(kMagic) + 1 || memcmp(data.data(), kMagic, sizeof(kMagic)) != 0 ||
+        static_cast<uint8_t>(data[sizeof(kMagic)]) != kVersion) {
+        return std::nullopt;
+    }
+    Reader reader(data.substr(sizeof(kMagic) + 1));
+    SessionRecording recording;
+    if (!reader.getInt(&recording.tgid) || !reader.getInt(&recording.uid) ||
+        !reader.getInt(&recording.tag) || !reader.getInt(&recording.targetNs)) {
+        return std::nullopt;
+    }
+
+    std::chrono::nanoseconds time{0};
+    int64_t lastTimeStampNanos = 0;
+    while (!reader.atEnd()) {
+        RecordedEvent event;
+        uint8_t type;
+        uint64_t delta;
+        if (!reader.getByte(&type) || !reader.getVarint(&delta)) {
+            break;
+        }
+        event.type = static_cast<RecordedEventType>(type);
+        time += std::chrono::nanoseconds(delta);
+        event.time = time;
+
+        bool complete = true;
+        switch (event.type) {
+            case RecordedEventType::REPORT_DURATIONS: {
+                uint64_t count;
+                complete = reader.getVarint(&count);
+                for (uint64_t i = 0; complete && i < count; i++) {
+                    WorkDuration d;
+                    int64_t timeStampDelta = 0;
+                    int64_t workPeriodStartDelta = 0;
+                    complete = reader.getSigned(&timeStampDelta) &&
+                               reader.getSigned(&workPeriodStartDelta) &&
+                               reader.getInt(&d.durationNanos) &&
+                               reader.getInt(&d.cpuDurationNanos) &&
+                               reader.getInt(&d.gpuDurationNanos);
+                    lastTimeStampNanos += timeStampDelta;
+                    d.timeStampNanos = lastTimeStampNanos;
+                    d.workPeriodStartTimestampNanos = d.timeStampNanos + workPeriodStartDelta;
+                    event.durations.push_back(d);
+                }
+                break;
+            }
+            case RecordedEventType::SEND_HINT:
+            case RecordedEventType::UPDATE_TARGET:
+                complete = reader.getSigned(&event.value);
+                break;
+            case RecordedEventType::PAUSE:
+            case RecordedEventType::RESUME:
+                break;
+            default:
+                return std::nullopt;
+        }
+        if (!complete) {
+            break;
+        }
+        recording.events.push_back(std::move(event));
+    }
+    return recording;
+}
+
+std::unique_ptr<SessionRecorder> SessionRecorder::create(int64_t sessionId, int32_t tgid,
+                                                         int32_t uid, int32_t tag,
+                                                         int64_t targetNs) {
+    const std::string dir = ::android::base::GetProperty(kPowerHalAdpfRecordDir, "");
+    if (dir.empty()) {
+        return nullptr;
+    }
+    return open(::android::base::StringPrintf("%s/adpf-%" PRId32 "-%" PRId64 ".rec", dir.c_str(),
+                                              tgid, sessionId),
+                tgid, uid, tag, targetNs);
+}
+
+std::unique_ptr<SessionRecorder> SessionRecorder::open(const std::string &path, int32_t tgid,
+                                                       int32_t uid, int32_t tag,
+                                                       int64_t targetNs) {
+    const int fd = TEMP_FAILURE_RETRY(
+            ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600));
+    if (fd < 0) {
+        LOG(ERROR) << "Failed to open ADPF recording " << path << ": " << strerror(errno);
+        return nullptr;
+    }
+    std::unique_ptr<SessionRecorder> recorder(new SessionRecorder(fd));
+    std::lock_guard lock(recorder->mMutex);
+    recorder->mBuffer.append(kMagic, sizeof(kMagic));
+    recorder->mBuffer.push_back(static_cast<char>(kVersion));
+    putSigned(&recorder->mBuffer, tgid);
+    putSigned(&recorder->mBuffer, uid);
+    putSigned(&recorder->mBuffer, tag);
+    putSigned(&recorder->mBuffer, targetNs);
+    return recorder;
+}
+
+SessionRecorder::SessionRecorder(int fd)
+    : mFd(fd), mLastEventTime(std::chrono::steady_clock::now()) {}
+
+SessionRecorder::~SessionRecorder() {
+    flush();
+    close(mFd);
+}
+
+void SessionRecorder::recordReport(const std::vector<WorkDuration> &durations) {
+    std::lock_guard lock(mMutex);
+    beginEventLocked(RecordedEventType::REPORT_DURATIONS);
+    putVarint(&mBuffer, durations.size());
+    for (const auto &d : durations) {
+        putSigned(&mBuffer, d.timeStampNanos - mLastTimeStampNanos);
+        putSigned(&mBuffer, d.workPeriodStartTimestampNanos - d.timeStampNanos);
+        putSigned(&mBuffer, d.durationNanos);
+        putSigned(&mBuffer, d.cpuDurationNanos);
+        putSigned(&mBuffer, d.gpuDurationNanos);
+        mLastTimeStampNanos = d.timeStampNanos;
+    }
+    endEventLocked();
+}
+
+void SessionRecorder::recordHint(int32_t hint) {
+    std::lock_guard lock(mMutex);
+    beginEventLocked(RecordedEventType::SEND_HINT);
+    putSigned(&mBuffer, hint);
+    endEventLocked();
+}
+
+void SessionRecorder::recordTarget(int64_t targetNs) {
+    std::lock_guard lock(mMutex);
+    beginEventLocked(RecordedEventType::UPDATE_TARGET);
+    putSigned(&mBuffer, targetNs);
+    endEventLocked();
+}
+
+void SessionRecorder::recordPause() {
+    std::lock_guard lock(mMutex);
+    beginEventLocked(RecordedEventType::PAUSE);
+    endEventLocked();
+}
+
+void SessionRecorder::recordResume() {
+    std::lock_guard lock(mMutex);
+    beginEventLocked(RecordedEventType::RESUME);
+    endEventLocked();
+}
+
+void SessionRecorder::flush() {
+    std::lock_guard lock(mMutex);
+    flushLocked();
+}
+
+void SessionRecorder::beginEventLocked(RecordedEventType type) {
+    const auto now = std::chrono::steady_clock::now();
+    mBuffer.push_back(static_cast<char>(type));
+    putVarint(&mBuffer,
+              std::chrono::duration_cast<std::chrono::nanoseconds>(now - mLastEventTime).count());
+    mLastEventTime = now;
+}
+
+void SessionRecorder::endEventLocked() {
+    if (mBuffer.size() >= kFlushBytes) {
+        flushLocked();
+    }
+}
+
+void SessionRecorder::flushLocked() {
+    if (!mFailed && !mBuffer.empty() && !::android::base::WriteFully(mFd, mBuffer.data(),
+                                                                     mBuffer.size())) {
+        LOG(ERROR) << "Failed to write ADPF recording: " << strerror(errno);
+        // Later events would be meaningless without the lost ones
+        mFailed = true;
+    }
+    mBuffer.clear();
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
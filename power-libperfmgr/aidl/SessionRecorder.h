@@ -0,0 +1,118 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/power/WorkDuration.h>
+#include <android-base/thread_annotations.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "AdpfTypes.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+using aidl::android::hardware::power::WorkDuration;
+
+// Directory to record the client calls of every new hint session to, one file
+// per session, recording is off when empty.
+constexpr char kPowerHalAdpfRecordDir[] = "vendor.powerhal.adpf.record_dir";
+
+enum class RecordedEventType : uint8_t {
+    REPORT_DURATIONS = 1,
+    SEND_HINT = 2,
+    UPDATE_TARGET = 3,
+    PAUSE = 4,
+    RESUME = 5,
+};
+
+struct RecordedEvent {
+    RecordedEventType type{RecordedEventType::PAUSE};
+    // Since the session was created
+    std::chrono::nanoseconds time{0};
+    // Hint of SEND_HINT, target of UPDATE_TARGET in nanoseconds
+    int64_t value{0};
+    // Durations of REPORT_DURATIONS
+    std::vector<WorkDuration> durations;
+};
+
+struct SessionRecording {
+    int32_t tgid{0};
+    int32_t uid{0};
+    int32_t tag{0};
+    int64_t targetNs{0};
+    std::vector<RecordedEvent> events;
+
+    // Parse the content of a recording file, nullopt if it is corrupted.
+    // A recording cut short by a crash is returned up to its last full event.
+    static std::optional<SessionRecording> parse(std::string_view data);
+};
+
+// Logs the calls a client makes on its hint session to a compact binary file
+// so they can be replayed offline against other ADPF configs. Values are
+// LEB128 varints, signed ones zigzag encoded, times are deltas to the previous
+// event. Events are buffered and written out once kFlushBytes are pending.
+class SessionRecorder : public Immobile {
+  public:
+    static constexpr size_t kFlushBytes = 4096;
+
+    // Return nullptr unless kPowerHalAdpfRecordDir is set.
+    static std::unique_ptr<SessionRecorder> create(int64_t sessionId, int32_t tgid, int32_t uid,
+                                                   int32_t tag, int64_t targetNs);
+    // Return nullptr if path can't be written.
+    static std::unique_ptr<SessionRecorder> open(const std::string &path, int32_t tgid,
+                                                 int32_t uid, int32_t tag, int64_t targetNs);
+    ~SessionRecorder();
+
+    void recordReport(const std::vector<WorkDuration> &durations);
+    void recordHint(int32_t hint);
+    void recordTarget(int64_t targetNs);
+    void recordPause();
+    void recordResume();
+    void flush();
+
+  private:
+    explicit SessionRecorder(int fd);
+    void beginEventLocked(RecordedEventType type) REQUIRES(mMutex);
+    void endEventLocked() REQUIRES(mMutex);
+    void flushLocked() REQUIRES(mMutex);
+
+    const int mFd;
+    std::mutex mMutex;
+    std::string mBuffer GUARDED_BY(mMutex);
+    std::chrono::steady_clock::time_point mLastEventTime GUARDED_BY(mMutex);
+    int64_t mLastTimeStampNanos GUARDED_BY(mMutex){0};
+    bool mFailed GUARDED_BY(mMutex){false};
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
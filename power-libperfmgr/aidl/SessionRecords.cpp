@@ -20,6 +20,9 @@
 
 #include <android-base/logging.h>
 
+#include <algorithm>
+#include <cmath>
+
 namespace aidl {
 namespace google {
 namespace hardware {
@@ -28,20 +31,29 @@ namespace impl {
 namespace pixel {
 
 SessionRecords::SessionRecords(const int32_t maxNumOfRecords, const double jankCheckTimeFactor)
-    : kMaxNumOfRecords(maxNumOfRecords), kJankCheckTimeFactor(jankCheckTimeFactor) {
-    mRecords.resize(maxNumOfRecords);
+    : kMaxNumOfRecords(std::clamp(maxNumOfRecords, 1, kMaxRecordsLimit)),
+      kJankCheckTimeFactor(jankCheckTimeFactor) {
+    mRecords.resize(kMaxNumOfRecords);
+    mRecordsIndQueue.resize(kMaxNumOfRecords);
+    mSortedDurations.reserve(kMaxNumOfRecords);
+}
+
+uint16_t SessionRecords::toDuration(int64_t durationUs) {
+    return std::clamp<int64_t>((durationUs + kDurationUnitUs / 2) / kDurationUnitUs, 0,
+                               UINT16_MAX);
 }
 
 void SessionRecords::addReportedDurations(const std::vector<WorkDuration> &actualDurationsNs,
                                           int64_t targetDurationNs) {
     for (auto &duration : actualDurationsNs) {
-        int32_t totalDurationUs = duration.durationNanos / 1000;
+        const uint16_t totalDuration = toDuration(duration.durationNanos / 1000);
+        const int32_t totalDurationUs = toDurationUs(totalDuration);
 
         if (mNumOfFrames >= kMaxNumOfRecords) {
             // Remove the oldest record when the number of records is greater
             // than allowed.
             int32_t indexOfRecordToRemove = (mLatestRecordIndex + 1) % kMaxNumOfRecords;
-            mSumOfDurationsUs -= mRecords[indexOfRecordToRemove].totalDurationUs;
+            mSumOfDurationsUs -= toDurationUs(mRecords[indexOfRecordToRemove].totalDuration);
             if (mRecords[indexOfRecordToRemove].isMissedCycle) {
                 mNumOfMissedCycles--;
                 if (mNumOfMissedCycles < 0) {
@@ -51,9 +63,17 @@ void SessionRecords::addReportedDurations(const std::vector<WorkDuration> &actua
             mNumOfFrames--;
 
             // If the record to be removed is the max duration, pop it out of the
-            // descending dequeue of record indexes.
-            if (mRecordsIndQueue.front() == indexOfRecordToRemove) {
-                mRecordsIndQueue.pop_front();
+            // descending queue of record indexes.
+            if (mRecordsIndQueueSize > 0 &&
+                mRecordsIndQueue[mRecordsIndQueueHead] == indexOfRecordToRemove) {
+                mRecordsIndQueueHead = (mRecordsIndQueueHead + 1) % kMaxNumOfRecords;
+                mRecordsIndQueueSize--;
+            }
+
+            auto it = std::lower_bound(mSortedDurations.begin(), mSortedDurations.end(),
+                                       mRecords[indexOfRecordToRemove].totalDuration);
+            if (it != mSortedDurations.end()) {
+                mSortedDurations.erase(it);
             }
         }
 
@@ -61,14 +81,21 @@ void SessionRecords::addReportedDurations(const std::vector<WorkDuration> &actua
 
         // Track start delay
         auto startTimeNs = duration.timeStampNanos - duration.durationNanos;
-        int32_t startIntervalUs = 0;
+        int64_t startIntervalUs = 0;
         if (mNumOfFrames > 0) {
             startIntervalUs = (startTimeNs - mLastStartTimeNs) / 1000;
         }
         mLastStartTimeNs = startTimeNs;
 
-        bool cycleMissed = totalDurationUs > (targetDurationNs / 1000) * kJankCheckTimeFactor;
-        mRecords[mLatestRecordIndex] = CycleRecord{startIntervalUs, totalDurationUs, cycleMissed};
+        // Checked against the reported duration, not the rounded one
+        bool cycleMissed = duration.durationNanos / 1000 >
+                           (targetDurationNs / 1000) * kJankCheckTimeFactor;
+        updateHeavyCycles(totalDurationUs, cycleMissed);
+        auto &record = mRecords[mLatestRecordIndex];
+        record.startInterval = std::clamp<int64_t>(startIntervalUs / kStartIntervalUnitUs, 0,
+                                                   (1 << 15) - 1);
+        record.isMissedCycle = cycleMissed;
+        record.totalDuration = totalDuration;
         mNumOfFrames++;
         if (cycleMissed) {
             mNumOfMissedCycles++;
@@ -76,22 +103,83 @@ void SessionRecords::addReportedDurations(const std::vector<WorkDuration> &actua
 
         // Pop out the indexes that their related values are not greater than the
         // latest one.
-        while (!mRecordsIndQueue.empty() &&
-               (mRecords[mRecordsIndQueue.back()].totalDurationUs <= totalDurationUs)) {
-            mRecordsIndQueue.pop_back();
+        while (mRecordsIndQueueSize > 0) {
+            int32_t back = (mRecordsIndQueueHead + mRecordsIndQueueSize - 1) % kMaxNumOfRecords;
+            if (mRecords[mRecordsIndQueue[back]].totalDuration > totalDuration) {
+                break;
+            }
+            mRecordsIndQueueSize--;
         }
-        mRecordsIndQueue.push_back(mLatestRecordIndex);
+        mRecordsIndQueue[(mRecordsIndQueueHead + mRecordsIndQueueSize) % kMaxNumOfRecords] =
+                mLatestRecordIndex;
+        mRecordsIndQueueSize++;
+
+        // Within the reserved capacity, so insert only shifts the tail.
+        mSortedDurations.insert(
+                std::upper_bound(mSortedDurations.begin(), mSortedDurations.end(), totalDuration),
+                totalDuration);
 
         mSumOfDurationsUs += totalDurationUs;
         mAvgDurationUs = mSumOfDurationsUs / mNumOfFrames;
     }
 }
 
+void SessionRecords::updateHeavyCycles(int32_t totalDurationUs, bool cycleMissed) {
+    mCycleCount++;
+    bool isHeavy = cycleMissed;
+    if (mCycleCount == mPredictedCycle) {
+        mPredictedCycle = -1;
+        if (cycleMissed) {
+            mNumOfPredictionMisses++;
+        } else if (totalDurationUs > mAvgDurationUs) {
+            mNumOfPredictionHits++;
+            isHeavy = true;
+        } else {
+            mNumOfFalsePredictions++;
+        }
+    }
+    if (!isHeavy) {
+        return;
+    }
+    if (mNumOfHeavyCycles == kHeavyCycleHistory) {
+        std::move(mHeavyCycles.begin() + 1, mHeavyCycles.end(), mHeavyCycles.begin());
+        mNumOfHeavyCycles--;
+    }
+    mHeavyCycles[mNumOfHeavyCycles++] = mCycleCount;
+}
+
+std::optional<int32_t> SessionRecords::getHeavyCyclePeriod() {
+    if (mNumOfHeavyCycles < kHeavyCycleHistory) {
+        return std::nullopt;
+    }
+    const int64_t period = mHeavyCycles[1] - mHeavyCycles[0];
+    for (size_t i = 2; i < kHeavyCycleHistory; i++) {
+        if (mHeavyCycles[i] - mHeavyCycles[i - 1] != period) {
+            return std::nullopt;
+        }
+    }
+    // Back to back heavy cycles are left to the PID and the heuristic boost,
+    // and a period longer than the records can't be told apart from noise.
+    if (period < 2 || period > kMaxNumOfRecords) {
+        return std::nullopt;
+    }
+    return period;
+}
+
+bool SessionRecords::predictNextCycleHeavy() {
+    auto period = getHeavyCyclePeriod();
+    if (!period.has_value() || mCycleCount + 1 - mHeavyCycles.back() != period.value()) {
+        return false;
+    }
+    mPredictedCycle = mCycleCount + 1;
+    return true;
+}
+
 std::optional<int32_t> SessionRecords::getMaxDuration() {
-    if (mRecordsIndQueue.empty()) {
+    if (mRecordsIndQueueSize <= 0) {
         return std::nullopt;
     }
-    return mRecords[mRecordsIndQueue.front()].totalDurationUs;
+    return toDurationUs(mRecords[mRecordsIndQueue[mRecordsIndQueueHead]].totalDuration);
 }
 
 std::optional<int32_t> SessionRecords::getAvgDuration() {
@@ -101,6 +189,14 @@ std::optional<int32_t> SessionRecords::getAvgDuration() {
     return mAvgDurationUs;
 }
 
+std::optional<int32_t> SessionRecords::getPercentileDuration(double percentile) {
+    if (mSortedDurations.empty() || !(percentile > 0.0) || percentile > 100.0) {
+        return std::nullopt;
+    }
+    size_t rank = static_cast<size_t>(std::ceil(percentile / 100.0 * mSortedDurations.size()));
+    return toDurationUs(mSortedDurations[std::clamp<size_t>(rank, 1, mSortedDurations.size()) - 1]);
+}
+
 int32_t SessionRecords::getNumOfRecords() {
     return mNumOfFrames;
 }
@@ -109,17 +205,26 @@ int32_t SessionRecords::getNumOfMissedCycles() {
     return mNumOfMissedCycles;
 }
 
+size_t SessionRecords::getMemoryBytes() const {
+    return sizeof(*this) + mRecords.capacity() * sizeof(CycleRecord) +
+           mRecordsIndQueue.capacity() * sizeof(uint16_t) +
+           mSortedDurations.capacity() * sizeof(uint16_t);
+}
+
 bool SessionRecords::isLowFrameRate(int32_t fpsLowRateThreshold) {
     // Check the last three records. If all of their start delays are larger
     // than the cycle duration threshold, return "true".
     auto cycleDurationThresholdUs = 1000000.0 / fpsLowRateThreshold;
+    auto startIntervalUs = [this](int32_t ind) {
+        return mRecords[ind].startInterval * kStartIntervalUnitUs;
+    };
     if (mNumOfFrames >= 3) {  // Todo: make this number as a tunable config
         int32_t ind1 = mLatestRecordIndex;
         int32_t ind2 = ind1 == 0 ? (kMaxNumOfRecords - 1) : (ind1 - 1);
         int32_t ind3 = ind2 == 0 ? (kMaxNumOfRecords - 1) : (ind2 - 1);
-        return (mRecords[ind1].startIntervalUs >= cycleDurationThresholdUs) &&
-               (mRecords[ind2].startIntervalUs >= cycleDurationThresholdUs) &&
-               (mRecords[ind3].startIntervalUs >= cycleDurationThresholdUs);
+        return (startIntervalUs(ind1) >= cycleDurationThresholdUs) &&
+               (startIntervalUs(ind2) >= cycleDurationThresholdUs) &&
+               (startIntervalUs(ind3) >= cycleDurationThresholdUs);
     }
 
     return false;
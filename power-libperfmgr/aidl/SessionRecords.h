@@ -18,7 +18,9 @@
 
 #include <aidl/android/hardware/power/WorkDuration.h>
 
-#include <deque>
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <optional>
 #include <vector>
 
@@ -33,10 +35,19 @@ using aidl::android::hardware::power::WorkDuration;
 
 class SessionRecords {
   public:
+    // Durations are kept in 16 bits of kDurationUnitUs, exact for whole
+    // milliseconds and saturated past half a second, which is long past any
+    // frame deadline. Start intervals only get compared to the low frame rate
+    // threshold, so 15 bits of kStartIntervalUnitUs, up to a second, will do.
+    static constexpr int32_t kDurationUnitUs = 8;
+    static constexpr int32_t kStartIntervalUnitUs = 32;
+    // Record indexes are kept in 16 bits too
+    static constexpr int32_t kMaxRecordsLimit = UINT16_MAX + 1;
+
     struct CycleRecord {
-        int32_t startIntervalUs{0};
-        int32_t totalDurationUs{0};
-        bool isMissedCycle{false};
+        uint16_t startInterval : 15;
+        uint16_t isMissedCycle : 1;
+        uint16_t totalDuration;
     };
 
   public:
@@ -47,23 +58,61 @@ class SessionRecords {
                               int64_t targetDurationNs);
     std::optional<int32_t> getMaxDuration();
     std::optional<int32_t> getAvgDuration();
+    // Nearest-rank percentile of the recorded durations, percentile in (0, 100].
+    std::optional<int32_t> getPercentileDuration(double percentile);
     int32_t getNumOfRecords();
     int32_t getNumOfMissedCycles();
     bool isLowFrameRate(int32_t fpsLowRateThreshold);
+    // Number of cycles between heavy cycles if the last kHeavyCycleHistory
+    // heavy cycles came at the same interval.
+    std::optional<int32_t> getHeavyCyclePeriod();
+    // Return true if the next cycle is expected to be a heavy one, and check
+    // the prediction when that cycle gets reported.
+    bool predictNextCycleHeavy();
+    // Predicted heavy cycles which met the target, missed it anyway, or turned
+    // out not to be heavy at all.
+    uint32_t getNumOfPredictionHits() const { return mNumOfPredictionHits; }
+    uint32_t getNumOfPredictionMisses() const { return mNumOfPredictionMisses; }
+    uint32_t getNumOfFalsePredictions() const { return mNumOfFalsePredictions; }
+    // Bytes of the object and its containers
+    size_t getMemoryBytes() const;
 
   private:
+    void updateHeavyCycles(int32_t totalDurationUs, bool cycleMissed);
+    static uint16_t toDuration(int64_t durationUs);
+    static int32_t toDurationUs(uint16_t duration) { return duration * kDurationUnitUs; }
+
     const int32_t kMaxNumOfRecords;
     const double kJankCheckTimeFactor;
+    // All the containers below are sized by kMaxNumOfRecords in the
+    // constructor and never allocate afterwards.
     std::vector<CycleRecord> mRecords;
-    // A descending order queue to store the records' indexes.
-    // It is for detecting the maximum duration.
-    std::deque<int32_t> mRecordsIndQueue;
+    // A descending order queue to store the records' indexes, kept as a ring
+    // of kMaxNumOfRecords slots. It is for detecting the maximum duration.
+    std::vector<uint16_t> mRecordsIndQueue;
+    int32_t mRecordsIndQueueHead{0};
+    int32_t mRecordsIndQueueSize{0};
+    // Durations of the current records in ascending order, for percentiles.
+    std::vector<uint16_t> mSortedDurations;
     int32_t mAvgDurationUs{0};
     int64_t mLastStartTimeNs{0};
     int32_t mLatestRecordIndex{-1};
     int32_t mNumOfMissedCycles{0};
     int32_t mNumOfFrames{0};
     int64_t mSumOfDurationsUs{0};
+
+    // A cycle is heavy when it misses the target. A predicted cycle which got
+    // boosted still counts as heavy when it is longer than the average, so a
+    // boost that works doesn't end its own prediction.
+    static constexpr size_t kHeavyCycleHistory = 4;
+    // Cycles reported since the construction
+    int64_t mCycleCount{0};
+    std::array<int64_t, kHeavyCycleHistory> mHeavyCycles{};
+    size_t mNumOfHeavyCycles{0};
+    int64_t mPredictedCycle{-1};
+    uint32_t mNumOfPredictionHits{0};
+    uint32_t mNumOfPredictionMisses{0};
+    uint32_t mNumOfFalsePredictions{0};
 };
 
 }  // namespace pixel
@@ -26,55 +26,115 @@ namespace power {
 namespace impl {
 namespace pixel {
 
+SessionTaskMap::SessionSlot *SessionTaskMap::findSlot(int64_t sessionId) {
+    auto sessItr = mSessions.find(sessionId);
+    if (sessItr == mSessions.end()) {
+        return nullptr;
+    }
+    return &mSlots[sessItr->second.index];
+}
+
+const SessionTaskMap::SessionSlot *SessionTaskMap::findSlot(int64_t sessionId) const {
+    auto sessItr = mSessions.find(sessionId);
+    if (sessItr == mSessions.end()) {
+        return nullptr;
+    }
+    return &mSlots[sessItr->second.index];
+}
+
+void SessionTaskMap::linkTasks(SessionHandle handle, const std::vector<pid_t> &taskIds,
+                               bool notifyWatcher) {
+    for (auto taskId : taskIds) {
+        auto &sessions = mTasks[taskId];
+        sessions.push_back(handle);
+        mAppliedUclamp.erase(taskId);
+        if (notifyWatcher && mTaskWatcher && sessions.size() == 1) {
+            mTaskWatcher->watchTask(taskId);
+        }
+    }
+}
+
+bool SessionTaskMap::unlinkTask(SessionHandle handle, pid_t taskId, bool notifyWatcher) {
+    auto taskItr = mTasks.find(taskId);
+    if (taskItr == mTasks.end()) {
+        // Inconsisent state
+        return false;
+    }
+
+    // Now lookup session in task's set
+    auto taskSessItr = std::find(taskItr->second.begin(), taskItr->second.end(), handle);
+    if (taskSessItr == taskItr->second.end()) {
+        // Should not happen
+        return false;
+    }
+
+    // Remove session from task map
+    taskItr->second.erase(taskSessItr);
+    if (taskItr->second.empty()) {
+        mTasks.erase(taskItr);
+        if (notifyWatcher && mTaskWatcher) {
+            mTaskWatcher->unwatchTask(taskId);
+        }
+    }
+    mAppliedUclamp.erase(taskId);
+    return true;
+}
+
 bool SessionTaskMap::add(int64_t sessionId, const SessionValueEntry &sv,
                          const std::vector<pid_t> &taskIds) {
     if (mSessions.find(sessionId) != mSessions.end()) {
         return false;
     }
 
-    auto sessValPtr = std::make_shared<SessionValueEntry>();
-    (*sessValPtr) = sv;
-    sessValPtr->sessionId = sessionId;
+    SessionHandle handle;
+    if (!mFreeSlots.empty()) {
+        handle.index = mFreeSlots.back();
+        mFreeSlots.pop_back();
+    } else {
+        handle.index = mSlots.size();
+        mSlots.emplace_back();
+    }
+    SessionSlot &slot = mSlots[handle.index];
+    handle.generation = slot.generation;
 
-    auto &sessEntry = mSessions[sessionId];
-    sessEntry.val = sessValPtr;
-    sessEntry.linkedTasks = taskIds;
+    slot.sessionId = sessionId;
+    slot.val = std::make_shared<SessionValueEntry>(sv);
+    slot.val->sessionId = sessionId;
+    slot.linkedTasks = taskIds;
+    mSessions.emplace(sessionId, handle);
 
-    for (auto taskId : taskIds) {
-        mTasks[taskId].push_back(sessValPtr);
-    }
+    linkTasks(handle, taskIds);
     return true;
 }
 
 void SessionTaskMap::addVote(int64_t sessionId, int voteId, int uclampMin, int uclampMax,
                              std::chrono::steady_clock::time_point startTime,
                              std::chrono::nanoseconds durationNs) {
-    auto sessItr = mSessions.find(sessionId);
-    if (sessItr == mSessions.end()) {
+    SessionSlot *slot = findSlot(sessionId);
+    if (slot == nullptr) {
         return;
     }
 
-    sessItr->second.val->votes->add(voteId,
-                                    CpuVote(true, startTime, durationNs, uclampMin, uclampMax));
+    slot->val->votes->add(voteId, CpuVote(true, startTime, durationNs, uclampMin, uclampMax));
 }
 
 void SessionTaskMap::addGpuVote(int64_t sessionId, int voteId, Cycles capacity,
                                 std::chrono::steady_clock::time_point startTime,
                                 std::chrono::nanoseconds durationNs) {
-    auto sessItr = mSessions.find(sessionId);
-    if (sessItr == mSessions.end()) {
+    SessionSlot *slot = findSlot(sessionId);
+    if (slot == nullptr) {
         return;
     }
 
-    sessItr->second.val->votes->add(voteId, GpuVote(true, startTime, durationNs, capacity));
+    slot->val->votes->add(voteId, GpuVote(true, startTime, durationNs, capacity));
 }
 
 std::shared_ptr<SessionValueEntry> SessionTaskMap::findSession(int64_t sessionId) const {
-    auto sessItr = mSessions.find(sessionId);
-    if (sessItr == mSessions.end()) {
+    const SessionSlot *slot = findSlot(sessionId);
+    if (slot == nullptr) {
         return nullptr;
     }
-    return sessItr->second.val;
+    return slot->val;
 }
 
 void SessionTaskMap::getTaskVoteRange(pid_t taskId, std::chrono::steady_clock::time_point timeNow,
@@ -88,26 +148,57 @@ void SessionTaskMap::getTaskVoteRange(pid_t taskId, std::chrono::steady_clock::t
         return;
     }
 
-    for (const auto &sessInTask : taskItr->second) {
-        if (!sessInTask->isActive) {
+    for (const auto handle : taskItr->second) {
+        const SessionSlot *slot = resolve(handle);
+        if (slot == nullptr) {
             continue;
         }
-        sessInTask->votes->getUclampRange(range, timeNow);
-        if (sessInTask->isPowerEfficient && uclampMaxEfficientBase.has_value()) {
-            range.uclampMax = std::min(range.uclampMax,
-                                       sessInTask->votes->allTimedOut(timeNow)
-                                               ? *uclampMaxEfficientBase
-                                               : range.uclampMin + *uclampMaxEfficientOffset);
-        }
+        addSessionVoteRange(*slot->val, timeNow, range, uclampMaxEfficientBase,
+                            uclampMaxEfficientOffset);
+    }
+}
+
+bool SessionTaskMap::getSessionVoteRange(int64_t sessionId,
+                                         std::chrono::steady_clock::time_point timeNow,
+                                         UclampRange &range,
+                                         std::optional<int32_t> &uclampMaxEfficientBase,
+                                         std::optional<int32_t> &uclampMaxEfficientOffset) const {
+    const SessionSlot *slot = findSlot(sessionId);
+    if (slot == nullptr) {
+        return false;
+    }
+    range = {};
+    addSessionVoteRange(*slot->val, timeNow, range, uclampMaxEfficientBase,
+                        uclampMaxEfficientOffset);
+    return true;
+}
+
+void SessionTaskMap::addSessionVoteRange(const SessionValueEntry &session,
+                                         std::chrono::steady_clock::time_point timeNow,
+                                         UclampRange &range,
+                                         std::optional<int32_t> &uclampMaxEfficientBase,
+                                         std::optional<int32_t> &uclampMaxEfficientOffset) {
+    if (!session.isActive) {
+        return;
+    }
+    session.votes->getUclampRange(range, timeNow);
+    if (session.isPowerEfficient && uclampMaxEfficientBase.has_value()) {
+        range.uclampMax = std::min(range.uclampMax, session.votes->allTimedOut(timeNow)
+                                                            ? *uclampMaxEfficientBase
+                                                            : range.uclampMin +
+                                                                      *uclampMaxEfficientOffset);
     }
 }
 
 Cycles SessionTaskMap::getSessionsGpuCapacity(
         std::chrono::steady_clock::time_point time_point) const {
     Cycles max(0);
-    for (auto const &[_, session] : mSessions) {
+    for (const auto &slot : mSlots) {
+        if (!slot.val) {
+            continue;
+        }
         max = std::max(max,
-                       session.val->votes->getGpuCapacityRequest(time_point).value_or(Cycles(0)));
+                       slot.val->votes->getGpuCapacityRequest(time_point).value_or(Cycles(0)));
     }
     return max;
 }
@@ -120,69 +211,87 @@ std::vector<int64_t> SessionTaskMap::getSessionIds(pid_t taskId) const {
     }
     std::vector<int64_t> res;
     res.reserve(itr->second.size());
-    for (const auto &i : itr->second) {
-        res.push_back(i->sessionId);
+    for (const auto handle : itr->second) {
+        const SessionSlot *slot = resolve(handle);
+        if (slot != nullptr) {
+            res.push_back(slot->sessionId);
+        }
     }
     return res;
 }
 
 std::vector<pid_t> &SessionTaskMap::getTaskIds(int64_t sessionId) {
-    auto taskItr = mSessions.find(sessionId);
-    if (taskItr == mSessions.end()) {
+    SessionSlot *slot = findSlot(sessionId);
+    if (slot == nullptr) {
         static std::vector<pid_t> emptyTaskIdVec;
         return emptyTaskIdVec;
     }
-    return taskItr->second.linkedTasks;
+    return slot->linkedTasks;
 }
 
 bool SessionTaskMap::isAnyAppSessionActive(std::chrono::steady_clock::time_point timePoint) const {
-    for (auto &sessionVal : mSessions) {
-        if (!sessionVal.second.val->isAppSession) {
+    for (const auto &slot : mSlots) {
+        if (!slot.val || !slot.val->isAppSession) {
             continue;
         }
-        if (!sessionVal.second.val->isActive) {
+        if (!slot.val->isActive) {
             continue;
         }
-        if (!sessionVal.second.val->votes->allTimedOut(timePoint)) {
+        if (!slot.val->votes->allTimedOut(timePoint)) {
             return true;
         }
     }
     return false;
 }
 
+bool SessionTaskMap::updateAppSessionActive(int64_t sessionId,
+                                            std::chrono::steady_clock::time_point timePoint) {
+    SessionSlot *slot = findSlot(sessionId);
+    if (slot == nullptr) {
+        return false;
+    }
+    const bool active = slot->val->isAppSession && slot->val->isActive &&
+                        !slot->val->votes->allTimedOut(timePoint);
+    if (active == slot->countedAppActive) {
+        return false;
+    }
+    slot->countedAppActive = active;
+    if (active) {
+        mNumActiveAppSessions++;
+    } else {
+        mNumActiveAppSessions--;
+    }
+    return true;
+}
+
+size_t SessionTaskMap::numActiveAppSessions() const {
+    return mNumActiveAppSessions;
+}
+
 bool SessionTaskMap::remove(int64_t sessionId) {
     auto sessItr = mSessions.find(sessionId);
     if (sessItr == mSessions.end()) {
         return false;
     }
+    const SessionHandle handle = sessItr->second;
+    SessionSlot &slot = mSlots[handle.index];
 
     // For each task id in linked tasks need to remove the corresponding
     // task to session mapping in the task map
-    for (const auto taskId : sessItr->second.linkedTasks) {
-        // Used linked task ids to cleanup
-        auto taskItr = mTasks.find(taskId);
-        if (taskItr == mTasks.end()) {
-            // Inconsisent state
-            continue;
-        }
-
-        // Now lookup session id in task's set
-        auto taskSessItr =
-                std::find(taskItr->second.begin(), taskItr->second.end(), sessItr->second.val);
-        if (taskSessItr == taskItr->second.end()) {
-            // Should not happen
-            continue;
-        }
-
-        // Remove session id from task map
-        taskItr->second.erase(taskSessItr);
-        if (taskItr->second.empty()) {
-            mTasks.erase(taskItr);
-        }
+    for (const auto taskId : slot.linkedTasks) {
+        unlinkTask(handle, taskId);
     }
 
     // Now we can safely remove session entirely since there are no more
     // mappings in task to session id
+    if (slot.countedAppActive) {
+        mNumActiveAppSessions--;
+        slot.countedAppActive = false;
+    }
+    slot.val.reset();
+    slot.linkedTasks.clear();
+    slot.generation++;
+    mFreeSlots.push_back(handle.index);
     mSessions.erase(sessItr);
     return true;
 }
@@ -193,27 +302,42 @@ bool SessionTaskMap::removeDeadTaskSessionMap(int64_t sessionId, pid_t taskId) {
         return false;
     }
 
-    auto taskItr = mTasks.find(taskId);
-    if (taskItr == mTasks.end()) {
-        // Inconsisent state
-        return false;
-    }
+    return unlinkTask(sessItr->second, taskId);
+}
 
-    // Now lookup session id in task's set
-    auto taskSessItr =
-            std::find(taskItr->second.begin(), taskItr->second.end(), sessItr->second.val);
-    if (taskSessItr == taskItr->second.end()) {
-        // Should not happen
-        return false;
+std::vector<int64_t> SessionTaskMap::removeDeadTask(pid_t taskId) {
+    std::vector<int64_t> sessionIds = getSessionIds(taskId);
+    for (auto sessionId : sessionIds) {
+        auto &linkedTasks = getTaskIds(sessionId);
+        linkedTasks.erase(std::remove(linkedTasks.begin(), linkedTasks.end(), taskId),
+                          linkedTasks.end());
+        // A task listed twice in a session is linked twice
+        while (removeDeadTaskSessionMap(sessionId, taskId)) {
+        }
     }
+    return sessionIds;
+}
 
-    // Remove session id from task map
-    taskItr->second.erase(taskSessItr);
-    if (taskItr->second.empty()) {
-        mTasks.erase(taskItr);
+void SessionTaskMap::setTaskWatcher(std::shared_ptr<TaskWatcher> watcher) {
+    mTaskWatcher = std::move(watcher);
+    if (mTaskWatcher) {
+        for (const auto &[taskId, sessions] : mTasks) {
+            mTaskWatcher->watchTask(taskId);
+        }
     }
+}
 
-    return true;
+bool SessionTaskMap::isUclampApplied(pid_t taskId, const UclampRange &range) const {
+    auto itr = mAppliedUclamp.find(taskId);
+    return itr != mAppliedUclamp.end() && itr->second == range;
+}
+
+void SessionTaskMap::setUclampApplied(pid_t taskId, const UclampRange &range) {
+    mAppliedUclamp[taskId] = range;
+}
+
+void SessionTaskMap::invalidateUclampApplied(pid_t taskId) {
+    mAppliedUclamp.erase(taskId);
 }
 
 bool SessionTaskMap::replace(int64_t sessionId, const std::vector<pid_t> &taskIds,
@@ -222,33 +346,47 @@ bool SessionTaskMap::replace(int64_t sessionId, const std::vector<pid_t> &taskId
     if (itr == mSessions.end()) {
         return false;
     }
+    const SessionHandle handle = itr->second;
+    SessionSlot &slot = mSlots[handle.index];
 
-    // Make copies of val and threads
-    auto svTmp = itr->second.val;
-    const auto previousTaskIds = itr->second.linkedTasks;
+    // Make copy of threads
+    const auto previousTaskIds = slot.linkedTasks;
 
     // Determine newly added threads
-    if (addedThreads) {
-        for (auto tid : taskIds) {
-            auto taskSessItr = mTasks.find(tid);
-            if (taskSessItr == mTasks.end()) {
-                addedThreads->push_back(tid);
-            }
+    std::vector<pid_t> newTaskIds;
+    for (auto tid : taskIds) {
+        auto taskSessItr = mTasks.find(tid);
+        if (taskSessItr == mTasks.end()) {
+            newTaskIds.push_back(tid);
         }
     }
+    if (addedThreads) {
+        addedThreads->insert(addedThreads->end(), newTaskIds.begin(), newTaskIds.end());
+    }
 
-    // Remove session from mappings
-    remove(sessionId);
-    // Add session value and task mappings
-    add(sessionId, *svTmp, taskIds);
+    // Relink the tasks, the session keeps its slot and value. The watcher is
+    // only told about the difference so tasks staying linked keep their watch.
+    for (const auto taskId : previousTaskIds) {
+        unlinkTask(handle, taskId, false);
+    }
+    slot.linkedTasks = taskIds;
+    linkTasks(handle, taskIds, false);
 
     // Determine completely removed threads
-    if (removedThreads) {
-        for (auto tid : previousTaskIds) {
-            auto taskSessItr = mTasks.find(tid);
-            if (taskSessItr == mTasks.end()) {
+    for (auto tid : previousTaskIds) {
+        auto taskSessItr = mTasks.find(tid);
+        if (taskSessItr == mTasks.end()) {
+            if (removedThreads) {
                 removedThreads->push_back(tid);
             }
+            if (mTaskWatcher) {
+                mTaskWatcher->unwatchTask(tid);
+            }
+        }
+    }
+    if (mTaskWatcher) {
+        for (auto tid : newTaskIds) {
+            mTaskWatcher->watchTask(tid);
         }
     }
 
@@ -264,21 +402,21 @@ size_t SessionTaskMap::sizeTasks() const {
 }
 
 const std::string &SessionTaskMap::idString(int64_t sessionId) const {
-    auto sessItr = mSessions.find(sessionId);
-    if (sessItr == mSessions.end()) {
+    const SessionSlot *slot = findSlot(sessionId);
+    if (slot == nullptr) {
         static const std::string emptyString;
         return emptyString;
     }
-    return sessItr->second.val->idString;
+    return slot->val->idString;
 }
 
 bool SessionTaskMap::isAppSession(int64_t sessionId) const {
-    auto sessItr = mSessions.find(sessionId);
-    if (sessItr == mSessions.end()) {
+    const SessionSlot *slot = findSlot(sessionId);
+    if (slot == nullptr) {
         return false;
     }
 
-    return sessItr->second.val->isAppSession;
+    return slot->val->isAppSession;
 }
 
 }  // namespace pixel
@@ -16,10 +16,13 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <unordered_map>
 #include <vector>
 
 #include "SessionValueEntry.h"
+#include "TaskLivenessMonitor.h"
 
 namespace aidl {
 namespace google {
@@ -28,6 +31,53 @@ namespace power {
 namespace impl {
 namespace pixel {
 
+// Vector keeping up to N elements inline before moving to the heap, a task is
+// almost always linked to one or two sessions only.
+template <typename T, size_t N>
+class InlineVector {
+  public:
+    T *begin() { return data(); }
+    T *end() { return data() + mSize; }
+    const T *begin() const { return data(); }
+    const T *end() const { return data() + mSize; }
+    size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+
+    void push_back(const T &value) {
+        if (mSize < N) {
+            mInline[mSize++] = value;
+            return;
+        }
+        if (mSize == N) {
+            mHeap.assign(mInline.begin(), mInline.end());
+        }
+        mHeap.push_back(value);
+        mSize++;
+    }
+
+    void erase(const T *pos) {
+        if (mSize > N) {
+            mHeap.erase(mHeap.begin() + (pos - mHeap.data()));
+            if (--mSize == N) {
+                std::copy(mHeap.begin(), mHeap.end(), mInline.begin());
+                mHeap.clear();
+            }
+            return;
+        }
+        std::copy(mInline.begin() + (pos - mInline.data()) + 1, mInline.begin() + mSize,
+                  mInline.begin() + (pos - mInline.data()));
+        mSize--;
+    }
+
+  private:
+    T *data() { return mSize > N ? mHeap.data() : mInline.data(); }
+    const T *data() const { return mSize > N ? mHeap.data() : mInline.data(); }
+
+    std::array<T, N> mInline{};
+    std::vector<T> mHeap;
+    size_t mSize{0};
+};
+
 /**
  * Map session id to a value and link to many task ids
  * Maintain consistency between mappings
@@ -60,6 +110,11 @@ class SessionTaskMap {
     void getTaskVoteRange(pid_t taskId, std::chrono::steady_clock::time_point timeNow,
                           UclampRange &range, std::optional<int32_t> &uclampMaxEfficientBase,
                           std::optional<int32_t> &uclampMaxEfficientOffset) const;
+    // Range the votes of session alone give its tasks, the default range if
+    // the session isn't active. Return false if the session doesn't exist.
+    bool getSessionVoteRange(int64_t sessionId, std::chrono::steady_clock::time_point timeNow,
+                             UclampRange &range, std::optional<int32_t> &uclampMaxEfficientBase,
+                             std::optional<int32_t> &uclampMaxEfficientOffset) const;
     Cycles getSessionsGpuCapacity(std::chrono::steady_clock::time_point time_point) const;
 
     // Find session ids given a task id if it exists
@@ -71,6 +126,13 @@ class SessionTaskMap {
     // Return true if any app session is active, false otherwise
     bool isAnyAppSessionActive(std::chrono::steady_clock::time_point timePoint) const;
 
+    // Recount the session as an active app session if it is active with a
+    // vote in range at timePoint, return true if that changed. The count is
+    // only as fresh as the last call for each session.
+    bool updateAppSessionActive(int64_t sessionId,
+                                std::chrono::steady_clock::time_point timePoint);
+    size_t numActiveAppSessions() const;
+
     // Remove a session based on session id
     bool remove(int64_t sessionId);
 
@@ -89,12 +151,12 @@ class SessionTaskMap {
         if (taskSessItr == mTasks.end()) {
             return;
         }
-        for (const auto &session : taskSessItr->second) {
-            auto sessionItr = mSessions.find(session->sessionId);
-            if (sessionItr == mSessions.end()) {
+        for (const auto handle : taskSessItr->second) {
+            const SessionSlot *slot = resolve(handle);
+            if (slot == nullptr) {
                 continue;
             }
-            fn(sessionItr->first, *(sessionItr->second.val));
+            fn(slot->sessionId, *(slot->val));
         }
     }
 
@@ -102,8 +164,10 @@ class SessionTaskMap {
     // fn takes int64_t session id, session entry val, linked task ids
     template <typename FN>
     void forEachSessionValTasks(FN fn) const {
-        for (const auto &e : mSessions) {
-            fn(e.first, *(e.second.val), e.second.linkedTasks);
+        for (const auto &slot : mSlots) {
+            if (slot.val) {
+                fn(slot.sessionId, *(slot.val), slot.linkedTasks);
+            }
         }
     }
 
@@ -116,16 +180,76 @@ class SessionTaskMap {
     // Remove dead task-session map entry
     bool removeDeadTaskSessionMap(int64_t sessionId, pid_t taskId);
 
+    // Remove a task which exited from all the sessions linking to it, return
+    // the ids of those sessions
+    std::vector<int64_t> removeDeadTask(pid_t taskId);
+
+    // Tell watcher whenever a task id starts or stops being linked to any
+    // session, starting with the tasks already linked
+    void setTaskWatcher(std::shared_ptr<TaskWatcher> watcher);
+
+    // Return true if range is the last uclamp range applied to the task
+    bool isUclampApplied(pid_t taskId, const UclampRange &range) const;
+
+    // Record range as applied to the task after a successful sched_setattr
+    void setUclampApplied(pid_t taskId, const UclampRange &range);
+
+    // Forget the applied range, the next apply always issues the syscall
+    void invalidateUclampApplied(pid_t taskId);
+
   private:
-    // Internal struct to hold per-session data and linked tasks
-    struct ValEntry {
+    // Index of a session in mSlots. The generation changes whenever the slot
+    // is freed, so a handle outliving its session doesn't resolve to the
+    // session later reusing the slot.
+    struct SessionHandle {
+        uint32_t index{0};
+        uint32_t generation{0};
+        bool operator==(const SessionHandle &) const = default;
+    };
+    // Internal struct to hold per-session data and linked tasks, val is
+    // nullptr while the slot is free
+    struct SessionSlot {
+        uint32_t generation{0};
+        int64_t sessionId{0};
         std::shared_ptr<SessionValueEntry> val;
         std::vector<pid_t> linkedTasks;
+        // Counted in mNumActiveAppSessions
+        bool countedAppActive{false};
     };
-    // Map session id to value
-    std::unordered_map<int64_t, ValEntry> mSessions;
-    // Map task id to set of session ids
-    std::unordered_map<pid_t, std::vector<std::shared_ptr<SessionValueEntry>>> mTasks;
+    static constexpr size_t kInlineSessionsPerTask = 4;
+
+    const SessionSlot *resolve(SessionHandle handle) const {
+        if (handle.index >= mSlots.size()) {
+            return nullptr;
+        }
+        const SessionSlot &slot = mSlots[handle.index];
+        return slot.val && slot.generation == handle.generation ? &slot : nullptr;
+    }
+    SessionSlot *findSlot(int64_t sessionId);
+    const SessionSlot *findSlot(int64_t sessionId) const;
+    // Merge the range of the votes of an active session into range
+    static void addSessionVoteRange(const SessionValueEntry &session,
+                                    std::chrono::steady_clock::time_point timeNow,
+                                    UclampRange &range,
+                                    std::optional<int32_t> &uclampMaxEfficientBase,
+                                    std::optional<int32_t> &uclampMaxEfficientOffset);
+    void linkTasks(SessionHandle handle, const std::vector<pid_t> &taskIds,
+                   bool notifyWatcher = true);
+    // Remove the link of taskId to the session, return false if there was none
+    bool unlinkTask(SessionHandle handle, pid_t taskId, bool notifyWatcher = true);
+
+    // Sessions packed in a vector, freed slots are reused
+    std::vector<SessionSlot> mSlots;
+    std::vector<uint32_t> mFreeSlots;
+    // Map session id to its slot
+    std::unordered_map<int64_t, SessionHandle> mSessions;
+    // Map task id to the sessions linking to it
+    std::unordered_map<pid_t, InlineVector<SessionHandle, kInlineSessionsPerTask>> mTasks;
+    // Map task id to the uclamp range last applied to it. Entries are dropped
+    // whenever the task set of the task changes, tids get reused.
+    std::unordered_map<pid_t, UclampRange> mAppliedUclamp;
+    std::shared_ptr<TaskWatcher> mTaskWatcher;
+    size_t mNumActiveAppSessions{0};
 };
 
 }  // namespace pixel
@@ -36,7 +36,11 @@ std::ostream &SessionValueEntry::dump(std::ostream &os) const {
     } else {
         os << ", votes nullptr";
     }
-    os << ", " << isActive;
+    os << ", " << isActive << ") ";
+    if (taskProfileRevert) {
+        os << "Placed, ";
+    }
+    timeoutLateness.dump(os, "TimeoutLateness");
     return os;
 }
 
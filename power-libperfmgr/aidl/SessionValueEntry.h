@@ -16,9 +16,14 @@
 
 #pragma once
 
+#include <aidl/android/hardware/power/SessionTag.h>
+
+#include <optional>
 #include <ostream>
+#include <string>
 
 #include "AppDescriptorTrace.h"
+#include "SessionMetrics.h"
 #include "UClampVoter.h"
 
 namespace aidl {
@@ -44,6 +49,13 @@ struct SessionValueEntry {
     std::shared_ptr<Votes> votes;
     std::shared_ptr<AppDescriptorTrace> sessionTrace;
     bool isPowerEfficient{false};
+    ::aidl::android::hardware::power::SessionTag tag{
+            ::aidl::android::hardware::power::SessionTag::OTHER};
+    // Task profile undoing the placement applied to the threads, set while
+    // it is applied
+    std::optional<std::string> taskProfileRevert;
+    // From the deadline of a vote to its timeout event expiring it
+    LatencyStats timeoutLateness;
 
     // Write info about power session to ostream for logging and debugging
     std::ostream &dump(std::ostream &os) const;
@@ -0,0 +1,196 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "powerhal-libperfmgr"
+
+#include "TaskLivenessMonitor.h"
+
+#include <android-base/logging.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#ifndef PIDFD_THREAD
+#define PIDFD_THREAD O_EXCL
+#endif
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+namespace {
+
+constexpr uint64_t kWakeEvent = ~uint64_t{0};
+
+uint64_t eventData(pid_t taskId, uint32_t generation) {
+    return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(taskId);
+}
+
+}  // namespace
+
+TaskLivenessMonitor::TaskLivenessMonitor(std::function<void(pid_t)> onTaskDead)
+    : mOnTaskDead(std::move(onTaskDead)) {
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    mWakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (mEpollFd < 0 || mWakeFd < 0) {
+        LOG(ERROR) << "Failed to set up task liveness epoll: " << strerror(errno);
+        return;
+    }
+    struct epoll_event event = {.events = EPOLLIN, .data = {.u64 = kWakeEvent}};
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeFd, &event) < 0) {
+        LOG(ERROR) << "Failed to add task liveness wake fd: " << strerror(errno);
+        close(mWakeFd);
+        mWakeFd = -1;
+        return;
+    }
+    mThread = std::thread([this]() { loop(); });
+    pthread_setname_np(mThread.native_handle(), "ADPF_LIVENESS");
+}
+
+TaskLivenessMonitor::~TaskLivenessMonitor() {
+    mStopping.store(true);
+    if (mThread.joinable()) {
+        eventfd_write(mWakeFd, 1);
+        mThread.join();
+    }
+    {
+        std::lock_guard lock(mMutex);
+        for (const auto &[taskId, watch] : mWatches) {
+            close(watch.pidfd);
+        }
+        mWatches.clear();
+    }
+    if (mWakeFd >= 0) {
+        close(mWakeFd);
+    }
+    if (mEpollFd >= 0) {
+        close(mEpollFd);
+    }
+}
+
+bool TaskLivenessMonitor::isValid() const {
+    return mThread.joinable();
+}
+
+void TaskLivenessMonitor::watchTask(pid_t taskId) {
+    std::lock_guard lock(mMutex);
+    if (!isValid() || mPidfdUnsupported || mWatches.count(taskId) > 0) {
+        return;
+    }
+    const int pidfd = syscall(__NR_pidfd_open, taskId, PIDFD_THREAD);
+    if (pidfd < 0) {
+        if (errno == EINVAL || errno == ENOSYS) {
+            LOG(INFO) << "Thread pidfds not supported, dead tasks are found on uclamp updates";
+            mPidfdUnsupported = true;
+        }
+        // ESRCH: the task already exited, the next uclamp update drops it.
+        return;
+    }
+    const uint32_t generation = ++mGeneration;
+    struct epoll_event event = {.events = EPOLLIN, .data = {.u64 = eventData(taskId, generation)}};
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, pidfd, &event) < 0) {
+        LOG(ERROR) << "Failed to watch task " << taskId << ": " << strerror(errno);
+        close(pidfd);
+        return;
+    }
+    mWatches.emplace(taskId, Watch{pidfd, generation});
+}
+
+void TaskLivenessMonitor::unwatchTask(pid_t taskId) {
+    std::lock_guard lock(mMutex);
+    auto itr = mWatches.find(taskId);
+    if (itr == mWatches.end()) {
+        return;
+    }
+    closeWatchLocked(itr->second);
+    mWatches.erase(itr);
+}
+
+void TaskLivenessMonitor::closeWatchLocked(const Watch &watch) {
+    epoll_ctl(mEpollFd, EPOLL_CTL_DEL, watch.pidfd, nullptr);
+    close(watch.pidfd);
+}
+
+size_t TaskLivenessMonitor::numWatched() const {
+    std::lock_guard lock(mMutex);
+    return mWatches.size();
+}
+
+void TaskLivenessMonitor::dumpToStream(std::ostream &stream) const {
+    std::lock_guard lock(mMutex);
+    stream << "TaskLivenessMonitor: watched " << mWatches.size() << ", dead " << mNumDead;
+    if (mPidfdUnsupported) {
+        stream << ", thread pidfd unsupported";
+    }
+    stream << "\n";
+}
+
+void TaskLivenessMonitor::loop() {
+    std::array<struct epoll_event, 16> events;
+    std::vector<pid_t> deadTasks;
+    while (!mStopping.load()) {
+        const int n = epoll_wait(mEpollFd, events.data(), events.size(), -1);
+        if (n < 0) {
+            if (errno != EINTR) {
+                LOG(ERROR) << "Task liveness epoll_wait failed: " << strerror(errno);
+                return;
+            }
+            continue;
+        }
+        {
+            std::lock_guard lock(mMutex);
+            for (int i = 0; i < n; i++) {
+                const uint64_t data = events[i].data.u64;
+                if (data == kWakeEvent) {
+                    continue;
+                }
+                const pid_t taskId = static_cast<pid_t>(data & 0xffffffff);
+                auto itr = mWatches.find(taskId);
+                // Unwatched, or unwatched and watched again, since epoll_wait
+                if (itr == mWatches.end() || itr->second.generation != (data >> 32)) {
+                    continue;
+                }
+                closeWatchLocked(itr->second);
+                mWatches.erase(itr);
+                mNumDead++;
+                deadTasks.push_back(taskId);
+            }
+        }
+        // The callback is free to call back into unwatchTask
+        for (auto taskId : deadTasks) {
+            mOnTaskDead(taskId);
+        }
+        deadTasks.clear();
+    }
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -0,0 +1,91 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <unordered_map>
+
+#include "AdpfTypes.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+// Notified by SessionTaskMap when a task id starts or stops being linked to
+// any session.
+struct TaskWatcher {
+    virtual ~TaskWatcher() = default;
+    virtual void watchTask(pid_t taskId) = 0;
+    virtual void unwatchTask(pid_t taskId) = 0;
+};
+
+// Tracks the liveness of the watched tasks with one pidfd each, all polled
+// from a single epoll by a background thread which calls onTaskDead once per
+// task that exited. A task is no longer watched once reported dead.
+// Thread pidfds (PIDFD_THREAD) need Linux 6.9, on older kernels watchTask does
+// nothing and dead tasks keep being found by sched_setattr returning ESRCH.
+class TaskLivenessMonitor : public TaskWatcher, public Immobile {
+  public:
+    explicit TaskLivenessMonitor(std::function<void(pid_t)> onTaskDead);
+    ~TaskLivenessMonitor() override;
+
+    // Return false if the epoll couldn't be set up.
+    bool isValid() const;
+    void watchTask(pid_t taskId) override;
+    void unwatchTask(pid_t taskId) override;
+    size_t numWatched() const;
+    void dumpToStream(std::ostream &stream) const;
+
+  private:
+    struct Watch {
+        int pidfd{-1};
+        uint32_t generation{0};
+    };
+    void loop();
+    void closeWatchLocked(const Watch &watch) REQUIRES(mMutex);
+
+    const std::function<void(pid_t)> mOnTaskDead;
+    int mEpollFd{-1};
+    int mWakeFd{-1};
+    std::atomic<bool> mStopping{false};
+    std::thread mThread;
+
+    mutable std::mutex mMutex;
+    std::unordered_map<pid_t, Watch> mWatches GUARDED_BY(mMutex);
+    // Stale epoll events of a re-watched tid are told apart by generation
+    uint32_t mGeneration GUARDED_BY(mMutex){0};
+    bool mPidfdUnsupported GUARDED_BY(mMutex){false};
+    uint64_t mNumDead GUARDED_BY(mMutex){0};
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
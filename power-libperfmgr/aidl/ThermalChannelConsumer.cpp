@@ -0,0 +1,182 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "powerhal-libperfmgr"
+#define ATRACE_TAG (ATRACE_TAG_POWER | ATRACE_TAG_HAL)
+
+#include "ThermalChannelConsumer.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/properties.h>
+#include <perfmgr/HintManager.h>
+#include <pthread.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <sstream>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+using ::android::hardware::google::pixel::kThermalChannelSeverityNames;
+using ::android::perfmgr::HintManager;
+using ::android::perfmgr::kInvalidHintId;
+
+namespace {
+
+constexpr char kThermalChannelPathProperty[] = "vendor.thermal.power_channel_path";
+// Bounds how long the destructor waits, updates wake the thread right away
+constexpr std::chrono::milliseconds kWaitTimeout{1000};
+
+}  // namespace
+
+ThermalChannelConsumer::ThermalChannelConsumer()
+    : mPath(::android::base::GetProperty(kThermalChannelPathProperty, "")) {}
+
+ThermalChannelConsumer::~ThermalChannelConsumer() {
+    mStopping = true;
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void ThermalChannelConsumer::start(ModesCallback setModes) {
+    if (mPath.empty() || mThread.joinable()) {
+        return;
+    }
+    mSetModes = std::move(setModes);
+    mThread = std::thread(&ThermalChannelConsumer::loop, this);
+    pthread_setname_np(mThread.native_handle(), "ThermalChannel");
+}
+
+void ThermalChannelConsumer::loop() {
+    uint32_t generation = 0;
+    bool logged = false;
+
+    while (!mStopping) {
+        if (!mReader.isOpen()) {
+            if (!mReader.open(mPath)) {
+                if (!logged) {
+                    PLOG(WARNING) << "Thermal channel " << mPath << " not ready";
+                    logged = true;
+                }
+                mReader.wait(generation, kWaitTimeout);
+                continue;
+            }
+            LOG(INFO) << "Attached to thermal channel " << mPath;
+            mReader.attach();
+            mAttached = true;
+            // Force the first read
+            generation = mReader.generation() + 1;
+        }
+        if (mReader.generation() != generation) {
+            mReader.read(&mSnapshot);
+            generation = mSnapshot.generation;
+            apply(mSnapshot);
+        }
+        mReader.wait(generation, kWaitTimeout);
+    }
+}
+
+ThermalChannelConsumer::Sensor &ThermalChannelConsumer::sensorLocked(const std::string &name) {
+    auto it = mSensors.find(name);
+    if (it != mSensors.end()) {
+        return it->second;
+    }
+    Sensor sensor;
+    for (int32_t severity = 0; severity < kThermalChannelSeverityCount; severity++) {
+        const std::string hint = "THERMAL_" + name + "_" + kThermalChannelSeverityNames[severity];
+        sensor.hints[severity] = HintManager::GetInstance()->IsHintSupported(hint)
+                                         ? HintManager::LookupHint(hint)
+                                         : kInvalidHintId;
+    }
+    return mSensors.emplace(name, sensor).first->second;
+}
+
+void ThermalChannelConsumer::apply(const ThermalChannelSnapshot &snapshot) {
+    ATRACE_CALL();
+    std::vector<std::pair<HintId, bool>> modes;
+    int32_t maxSeverity = 0;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        // A sensor missing from the snapshot was dropped by a restarted thermal HAL, so its
+        // hints end like a sensor back at NONE
+        std::unordered_map<std::string, int32_t> published;
+        for (uint32_t i = 0; i < snapshot.sensorCount; i++) {
+            published[snapshot.sensors[i].name] =
+                    std::clamp(snapshot.sensors[i].value, 0, kThermalChannelSeverityCount - 1);
+            sensorLocked(snapshot.sensors[i].name);
+        }
+        for (auto &[name, sensor] : mSensors) {
+            const auto it = published.find(name);
+            const int32_t severity = it == published.end() ? 0 : it->second;
+            maxSeverity = std::max(maxSeverity, severity);
+            if (severity == sensor.appliedSeverity) {
+                continue;
+            }
+            // Same as the binder path: every supported severity up to the current one is on
+            for (int32_t s = 0; s < kThermalChannelSeverityCount; s++) {
+                const bool enable = s <= severity;
+                if (sensor.hints[s] != kInvalidHintId && enable != (s <= sensor.appliedSeverity)) {
+                    modes.emplace_back(sensor.hints[s], enable);
+                }
+            }
+            sensor.appliedSeverity = severity;
+        }
+        mUpdates++;
+        mModesApplied += modes.size();
+    }
+    mMaxSeverity.store(maxSeverity, std::memory_order_relaxed);
+    // Boosts with thermal values drop to what the throttled clusters can still reach
+    HintManager::GetInstance()->SetThermalSeverity(maxSeverity);
+    if (!modes.empty()) {
+        mSetModes(modes);
+    }
+}
+
+void ThermalChannelConsumer::dumpToFd(int fd) {
+    if (mPath.empty()) {
+        return;
+    }
+    std::ostringstream dump_buf;
+    dump_buf << "========== Begin thermal channel ==========\n";
+    dump_buf << "Path: " << mPath << " attached: " << mAttached
+             << " max severity: " << getMaxSeverity() << "\n";
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        dump_buf << "Updates: " << mUpdates << " modes applied: " << mModesApplied << "\n";
+        for (const auto &[name, sensor] : mSensors) {
+            dump_buf << name << ": " << kThermalChannelSeverityNames[sensor.appliedSeverity]
+                     << "\n";
+        }
+    }
+    dump_buf << "========== End thermal channel ==========\n";
+    if (!::android::base::WriteStringToFd(dump_buf.str(), fd)) {
+        PLOG(ERROR) << "Failed to dump thermal channel to fd: " << fd;
+    }
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+#include <perfmgr/HintId.h>
+#include <pixelthermalchannel/ThermalChannel.h>
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "AdpfTypes.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+using ::android::hardware::google::pixel::kThermalChannelSeverityCount;
+using ::android::hardware::google::pixel::ThermalChannelReader;
+using ::android::hardware::google::pixel::ThermalChannelSnapshot;
+using ::android::perfmgr::HintId;
+
+// Applies the thermal power hints the thermal HAL publishes on the shared
+// memory channel at vendor.thermal.power_channel_path, in place of its
+// THERMAL_<sensor>_<severity> setMode binder calls. A background thread waits
+// on the channel and hands every change to the hint manager as one batch.
+// Without the property set the consumer never starts.
+class ThermalChannelConsumer : public Immobile {
+  public:
+    using ModesCallback = std::function<void(const std::vector<std::pair<HintId, bool>> &)>;
+
+    ~ThermalChannelConsumer();
+
+    // Start consuming when the channel is configured, modes are applied through setModes
+    void start(ModesCallback setModes);
+    // Highest severity any sensor published, a single load for per frame callers such as
+    // ADPF sessions
+    int32_t getMaxSeverity() const { return mMaxSeverity.load(std::memory_order_relaxed); }
+    void dumpToFd(int fd);
+
+    // Singleton
+    static ThermalChannelConsumer *getInstance() {
+        static ThermalChannelConsumer instance{};
+        return &instance;
+    }
+
+  private:
+    ThermalChannelConsumer();
+
+    struct Sensor {
+        // Hint of each severity, kInvalidHintId when not supported
+        std::array<HintId, kThermalChannelSeverityCount> hints;
+        int32_t appliedSeverity{0};
+    };
+    void loop();
+    void apply(const ThermalChannelSnapshot &snapshot);
+    Sensor &sensorLocked(const std::string &name) REQUIRES(mMutex);
+
+    const std::string mPath;
+    ModesCallback mSetModes;
+    ThermalChannelReader mReader;
+    // Only touched by the consumer thread
+    ThermalChannelSnapshot mSnapshot;
+    std::atomic<int32_t> mMaxSeverity{0};
+    std::atomic<bool> mAttached{false};
+    std::atomic<bool> mStopping{false};
+    std::thread mThread;
+
+    std::mutex mMutex;
+    std::unordered_map<std::string, Sensor> mSensors GUARDED_BY(mMutex);
+    uint64_t mUpdates GUARDED_BY(mMutex){0};
+    uint64_t mModesApplied GUARDED_BY(mMutex){0};
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -16,6 +16,8 @@
 
 #include "UClampVoter.h"
 
+#include <limits>
+
 namespace aidl {
 namespace google {
 namespace hardware {
@@ -32,38 +34,99 @@ static void confine(UclampRange &uclampRange, const CpuVote &cpu_vote,
     uclampRange.uclampMax = std::min(uclampRange.uclampMax, cpu_vote.mUclampRange.uclampMax);
 }
 
+// Pulls until in to the next time after t at which vote enters or leaves its range.
+static void narrowToNextChange(const VoteRange &vote, std::chrono::steady_clock::time_point t,
+                               std::chrono::steady_clock::time_point &until) {
+    using std::literals::chrono_literals::operator""ns;
+    if (!vote.active()) {
+        return;
+    }
+    if (t < vote.startTime()) {
+        until = std::min(until, vote.startTime());
+    } else if (t <= vote.startTime() + vote.durationNs()) {
+        until = std::min(until, vote.startTime() + vote.durationNs() + 1ns);
+    }
+}
+
 std::ostream &operator<<(std::ostream &o, const UclampRange &uc) {
     o << "[" << uc.uclampMin << "," << uc.uclampMax << "]";
     return o;
 }
 
-Votes::Votes() {}
+Votes::Votes() {
+    mCpuVotes.reserve(static_cast<size_t>(AdpfVoteType::VOTE_TYPE_SIZE));
+    mGpuVotes.reserve(static_cast<size_t>(AdpfVoteType::VOTE_TYPE_SIZE));
+}
+
+template <typename VoteT>
+typename Votes::VoteList<VoteT>::iterator Votes::find(VoteList<VoteT> &votes, int voteId) {
+    return std::find_if(votes.begin(), votes.end(),
+                        [voteId](const auto &v) { return v.first == voteId; });
+}
+
+template <typename VoteT>
+typename Votes::VoteList<VoteT>::const_iterator Votes::find(const VoteList<VoteT> &votes,
+                                                            int voteId) {
+    return std::find_if(votes.begin(), votes.end(),
+                        [voteId](const auto &v) { return v.first == voteId; });
+}
 
 constexpr static auto gpu_vote_id = static_cast<int>(AdpfVoteType::GPU_CAPACITY);
 
 static inline bool isGpuVote(int type_raw) {
     AdpfVoteType const type = static_cast<AdpfVoteType>(type_raw);
     return type == AdpfVoteType::GPU_CAPACITY || type == AdpfVoteType::GPU_LOAD_UP ||
-           type == AdpfVoteType::GPU_LOAD_DOWN || type == AdpfVoteType::GPU_LOAD_RESET;
+           type == AdpfVoteType::GPU_LOAD_DOWN || type == AdpfVoteType::GPU_LOAD_RESET ||
+           type == AdpfVoteType::GPU_CO_BOOST;
+}
+
+const Votes::Merged &Votes::merged(std::chrono::steady_clock::time_point t) const {
+    if (mMerged.valid && mMerged.from <= t && t < mMerged.until) {
+        return mMerged;
+    }
+
+    mMerged.valid = true;
+    mMerged.from = t;
+    mMerged.until = std::chrono::steady_clock::time_point::max();
+    // Neutral bounds so merging the cached range equals confining by every vote
+    mMerged.range = {std::numeric_limits<int>::min(), std::numeric_limits<int>::max()};
+    mMerged.anyInRange = false;
+    for (const auto &[id, vote] : mCpuVotes) {
+        confine(mMerged.range, vote, t);
+        mMerged.anyInRange |= vote.isTimeInRange(t);
+        narrowToNextChange(vote, t, mMerged.until);
+    }
+    for (const auto &[id, vote] : mGpuVotes) {
+        mMerged.anyInRange |= vote.isTimeInRange(t);
+        narrowToNextChange(vote, t, mMerged.until);
+    }
+    return mMerged;
 }
 
 void Votes::add(int id, CpuVote const &vote) {
-    if (!isGpuVote(id)) {
-        mCpuVotes[id] = vote;
+    if (isGpuVote(id)) {
+        return;
+    }
+    invalidate();
+    auto it = find(mCpuVotes, id);
+    if (it != mCpuVotes.end()) {
+        it->second = vote;
+    } else {
+        mCpuVotes.emplace_back(id, vote);
     }
 }
 
 std::optional<Cycles> Votes::getGpuCapacityRequest(std::chrono::steady_clock::time_point t) const {
     std::optional<Cycles> res = std::nullopt;
 
-    constexpr AdpfVoteType gpu_capacity_hints[] = {
-            AdpfVoteType::GPU_CAPACITY,
-            AdpfVoteType::GPU_LOAD_UP,
-    };
-    for (auto const hint : gpu_capacity_hints) {
-        auto it = mGpuVotes.find(static_cast<int>(hint));
-        if (it != mGpuVotes.end() && it->second.isTimeInRange(t)) {
-            res = res.value_or(Cycles(0)) + it->second.mCapacity;
+    for (auto const &[id, vote] : mGpuVotes) {
+        const auto hint = static_cast<AdpfVoteType>(id);
+        if (hint != AdpfVoteType::GPU_CAPACITY && hint != AdpfVoteType::GPU_LOAD_UP &&
+            hint != AdpfVoteType::GPU_CO_BOOST) {
+            continue;
+        }
+        if (vote.isTimeInRange(t)) {
+            res = res.value_or(Cycles(0)) + vote.mCapacity;
         }
     }
 
@@ -71,21 +134,29 @@ std::optional<Cycles> Votes::getGpuCapacityRequest(std::chrono::steady_clock::ti
 }
 
 void Votes::add(int id, GpuVote const &vote) {
-    if (isGpuVote(id)) {
-        mGpuVotes[id] = vote;
+    if (!isGpuVote(id)) {
+        return;
+    }
+    invalidate();
+    auto it = find(mGpuVotes, id);
+    if (it != mGpuVotes.end()) {
+        it->second = vote;
+    } else {
+        mGpuVotes.emplace_back(id, vote);
     }
 }
 
 void Votes::updateDuration(int voteId, std::chrono::nanoseconds durationNs) {
+    invalidate();
     if (isGpuVote(voteId)) {
-        auto const it = mGpuVotes.find(voteId);
+        auto const it = find(mGpuVotes, voteId);
         if (it != mGpuVotes.end()) {
             it->second.updateDuration(durationNs);
         }
         return;
     }
 
-    auto const voteItr = mCpuVotes.find(voteId);
+    auto const voteItr = find(mCpuVotes, voteId);
     if (voteItr != mCpuVotes.end()) {
         voteItr->second.updateDuration(durationNs);
     }
@@ -93,10 +164,9 @@ void Votes::updateDuration(int voteId, std::chrono::nanoseconds durationNs) {
 
 void Votes::getUclampRange(UclampRange &uclampRange,
                            std::chrono::steady_clock::time_point t) const {
-    for (auto it = mCpuVotes.begin(); it != mCpuVotes.end(); it++) {
-        auto timings_it = mCpuVotes.find(it->first);
-        confine(uclampRange, it->second, t);
-    }
+    const UclampRange &range = merged(t).range;
+    uclampRange.uclampMin = std::max(uclampRange.uclampMin, range.uclampMin);
+    uclampRange.uclampMax = std::min(uclampRange.uclampMax, range.uclampMax);
 }
 
 bool Votes::anyTimedOut(std::chrono::steady_clock::time_point t) const {
@@ -115,23 +185,13 @@ bool Votes::anyTimedOut(std::chrono::steady_clock::time_point t) const {
 }
 
 bool Votes::allTimedOut(std::chrono::steady_clock::time_point t) const {
-    for (const auto &v : mGpuVotes) {
-        if (v.second.isTimeInRange(t)) {
-            return false;
-        }
-    }
-
-    for (const auto &v : mCpuVotes) {
-        if (v.second.isTimeInRange(t)) {
-            return false;
-        }
-    }
-    return true;
+    return !merged(t).anyInRange;
 }
 
 bool Votes::remove(int voteId) {
+    invalidate();
     if (isGpuVote(voteId)) {
-        auto const it = mGpuVotes.find(voteId);
+        auto const it = find(mGpuVotes, voteId);
         if (it != mGpuVotes.end()) {
             mGpuVotes.erase(it);
             return true;
@@ -139,7 +199,7 @@ bool Votes::remove(int voteId) {
         return false;
     }
 
-    auto const it = mCpuVotes.find(voteId);
+    auto const it = find(mCpuVotes, voteId);
     if (it != mCpuVotes.end()) {
         mCpuVotes.erase(it);
         return true;
@@ -149,8 +209,9 @@ bool Votes::remove(int voteId) {
 }
 
 bool Votes::setUseVote(int voteId, bool active) {
+    invalidate();
     if (isGpuVote(voteId)) {
-        auto const itr = mGpuVotes.find(voteId);
+        auto const itr = find(mGpuVotes, voteId);
         if (itr == mGpuVotes.end()) {
             return false;
         }
@@ -158,7 +219,7 @@ bool Votes::setUseVote(int voteId, bool active) {
         return true;
     }
 
-    auto const itr = mCpuVotes.find(voteId);
+    auto const itr = find(mCpuVotes, voteId);
     if (itr == mCpuVotes.end()) {
         return false;
     }
@@ -172,14 +233,14 @@ size_t Votes::size() const {
 
 bool Votes::voteIsActive(int voteId) const {
     if (isGpuVote(voteId)) {
-        auto const itr = mGpuVotes.find(voteId);
+        auto const itr = find(mGpuVotes, voteId);
         if (itr == mGpuVotes.end()) {
             return false;
         }
         return itr->second.active();
     }
 
-    auto const itr = mCpuVotes.find(voteId);
+    auto const itr = find(mCpuVotes, voteId);
     if (itr == mCpuVotes.end()) {
         return false;
     }
@@ -188,14 +249,14 @@ bool Votes::voteIsActive(int voteId) const {
 
 std::chrono::steady_clock::time_point Votes::voteTimeout(int voteId) const {
     if (isGpuVote(voteId)) {
-        auto const itr = mGpuVotes.find(voteId);
+        auto const itr = find(mGpuVotes, voteId);
         if (itr == mGpuVotes.end()) {
             return std::chrono::steady_clock::time_point{};
         }
         return itr->second.startTime() + itr->second.durationNs();
     }
 
-    auto const itr = mCpuVotes.find(voteId);
+    auto const itr = find(mCpuVotes, voteId);
     if (itr == mCpuVotes.end()) {
         return std::chrono::steady_clock::time_point{};
     }
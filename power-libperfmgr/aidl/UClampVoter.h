@@ -19,8 +19,10 @@
 #include <algorithm>
 #include <chrono>
 #include <memory>
+#include <optional>
 #include <ostream>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "AdpfTypes.h"
 #include "PhysicalQuantityTypes.h"
@@ -37,6 +39,7 @@ namespace pixel {
 struct UclampRange {
     int uclampMin{kUclampMin};
     int uclampMax{kUclampMax};
+    bool operator==(const UclampRange &) const = default;
 };
 
 // --------------------------------------------------------
@@ -118,7 +121,8 @@ class Votes {
 
     // Given input UclampRange, and a time point now, increase the min and
     // decrease max if this VoteRange is in range, return UclampRange with
-    // the largest min and the smallest max
+    // the largest min and the smallest max. The merged range of the votes is
+    // cached until a vote changes, starts or expires.
     void getUclampRange(UclampRange &uclampRange, std::chrono::steady_clock::time_point t) const;
 
     std::optional<Cycles> getGpuCapacityRequest(std::chrono::steady_clock::time_point t) const;
@@ -143,8 +147,30 @@ class Votes {
     std::chrono::steady_clock::time_point voteTimeout(int voteId) const;
 
   private:
-    std::unordered_map<int, CpuVote> mCpuVotes;
-    std::unordered_map<int, GpuVote> mGpuVotes;
+    // A session only has a handful of votes, keep them contiguous and scan
+    // them linearly instead of hashing the vote id.
+    template <typename VoteT>
+    using VoteList = std::vector<std::pair<int, VoteT>>;
+    template <typename VoteT>
+    static typename VoteList<VoteT>::iterator find(VoteList<VoteT> &votes, int voteId);
+    template <typename VoteT>
+    static typename VoteList<VoteT>::const_iterator find(const VoteList<VoteT> &votes,
+                                                         int voteId);
+
+    // What the votes amount to for time points in [from, until)
+    struct Merged {
+        bool valid{false};
+        std::chrono::steady_clock::time_point from;
+        std::chrono::steady_clock::time_point until;
+        UclampRange range;
+        bool anyInRange{false};
+    };
+    const Merged &merged(std::chrono::steady_clock::time_point t) const;
+    void invalidate() { mMerged.valid = false; }
+
+    VoteList<CpuVote> mCpuVotes;
+    VoteList<GpuVote> mGpuVotes;
+    mutable Merged mMerged;
 };
 
 }  // namespace pixel
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "UclampEnergySearch.h"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+namespace {
+
+// Widen the step so that the levels from low to high fit in maxLevels
+int boundedStep(int low, int high, int step, size_t maxLevels) {
+    step = std::max(step, 1);
+    const int range = std::max(high - low, 0);
+    const int gaps = static_cast<int>(maxLevels) - 1;
+    const int minStep = (range + gaps - 1) / gaps;
+    return std::max(step, minStep);
+}
+
+}  // namespace
+
+UclampEnergySearch::UclampEnergySearch(int low, int high, int step, uint32_t windowFrames)
+    : mLow(low),
+      mHigh(std::max(low, high)),
+      mStep(boundedStep(low, high, step, kMaxLevels)),
+      mWindowFrames(std::max(windowFrames, 1u)),
+      mLevels((mHigh - mLow + mStep - 1) / mStep + 1),
+      mLevel(mLevels.size() - 1) {}
+
+int UclampEnergySearch::levelCap(size_t level) const {
+    return std::min(mLow + static_cast<int>(level) * mStep, mHigh);
+}
+
+int UclampEnergySearch::update(size_t frames, size_t missedFrames,
+                               std::optional<uint64_t> energyUWs) {
+    mFrames += frames;
+    mMissedFrames += missedFrames;
+    if (energyUWs) {
+        mEnergyUWs += *energyUWs;
+        mTotalFrames += frames;
+        mTotalEnergyUWs += *energyUWs;
+    } else {
+        mEnergyKnown = false;
+    }
+    if (mFrames >= mWindowFrames) {
+        finishWindow();
+    }
+    return cap();
+}
+
+void UclampEnergySearch::finishWindow() {
+    for (auto &level : mLevels) {
+        if (level.holdWindows > 0) {
+            level.holdWindows--;
+        }
+    }
+    Level &current = mLevels[mLevel];
+    const bool hasUpper = mLevel + 1 < mLevels.size();
+    if (mMissedFrames > 0) {
+        current.energyPerFrameUWs.reset();
+        current.holdWindows = kHoldWindows;
+        if (hasUpper) {
+            mLevel++;
+        }
+    } else {
+        if (mEnergyKnown) {
+            current.energyPerFrameUWs = static_cast<double>(mEnergyUWs) / mFrames;
+        } else {
+            current.energyPerFrameUWs.reset();
+        }
+        const auto &upperEnergy =
+                hasUpper ? mLevels[mLevel + 1].energyPerFrameUWs : std::optional<double>();
+        if (upperEnergy && current.energyPerFrameUWs &&
+            *upperEnergy <= *current.energyPerFrameUWs) {
+            current.holdWindows = kHoldWindows;
+            mLevel++;
+        } else if (mLevel > 0 && mLevels[mLevel - 1].holdWindows == 0) {
+            mLevel--;
+        }
+    }
+    mFrames = 0;
+    mMissedFrames = 0;
+    mEnergyUWs = 0;
+    mEnergyKnown = true;
+}
+
+void UclampEnergySearch::reset() {
+    mLevels.assign(mLevels.size(), Level());
+    mLevel = mLevels.size() - 1;
+    mFrames = 0;
+    mMissedFrames = 0;
+    mEnergyUWs = 0;
+    mEnergyKnown = true;
+}
+
+std::optional<double> UclampEnergySearch::energyPerFrameUWs() const {
+    if (mTotalFrames == 0) {
+        return std::nullopt;
+    }
+    return static_cast<double>(mTotalEnergyUWs) / mTotalFrames;
+}
+
+void UclampEnergySearch::dumpToStream(std::ostream &stream) const {
+    stream << "Energy(";
+    if (const auto energy = energyPerFrameUWs()) {
+        const auto flags = stream.flags();
+        const auto precision = stream.precision();
+        stream << std::fixed << std::setprecision(3) << *energy / 1000.0;
+        stream.flags(flags);
+        stream.precision(precision);
+        stream << " mJ/frame, ";
+    }
+    stream << "cap " << cap() << ")";
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+// Searches the lowest cap on the uclamp min of a session it still meets its
+// target at, for the energy aware ADPF mode. The caps are levels a step
+// apart between the uclamp min floor and ceiling of the profile. The search
+// stays at a level for a window of frames, then moves down a level if no
+// frame of the window missed its target and up a level otherwise. It stops
+// going down when the energy per frame of the level above was no higher, as
+// a lower frequency can cost more per frame once it runs the CPUs longer. A
+// level which missed or cost more is held off for a few windows before it
+// is probed again, so the search follows the load but can't flap.
+// Not thread safe, owned by a session and used under its lock.
+class UclampEnergySearch {
+  public:
+    static constexpr size_t kMaxLevels = 32;
+    static constexpr uint32_t kHoldWindows = 8;
+
+    UclampEnergySearch(int low, int high, int step, uint32_t windowFrames);
+
+    // Account a report of frames, missedFrames of them over target, during
+    // which the CPU rails used energyUWs, or nullopt if unknown. Return the
+    // cap of the uclamp min of the next frames.
+    int update(size_t frames, size_t missedFrames, std::optional<uint64_t> energyUWs);
+    int cap() const { return levelCap(mLevel); }
+    // Restart from the ceiling, e.g. when the session resumes
+    void reset();
+
+    // Energy per frame over all reports with a known energy, in uWs
+    std::optional<double> energyPerFrameUWs() const;
+    // Write "Energy(mJ/frame, cap)" to ostream
+    void dumpToStream(std::ostream &stream) const;
+
+  private:
+    struct Level {
+        // Of the last window meeting the target at this level
+        std::optional<double> energyPerFrameUWs;
+        // Windows left before the search may go down to this level again
+        uint32_t holdWindows{0};
+    };
+
+    int levelCap(size_t level) const;
+    void finishWindow();
+
+    const int mLow;
+    const int mHigh;
+    const int mStep;
+    const uint32_t mWindowFrames;
+    std::vector<Level> mLevels;
+    size_t mLevel;
+
+    // The current window
+    uint64_t mFrames{0};
+    uint64_t mMissedFrames{0};
+    uint64_t mEnergyUWs{0};
+    bool mEnergyKnown{true};
+
+    // Over the whole session
+    uint64_t mTotalFrames{0};
+    uint64_t mTotalEnergyUWs{0};
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
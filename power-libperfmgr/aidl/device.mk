@@ -4,6 +4,10 @@ BOARD_SEPOLICY_DIRS += hardware/google/pixel-sepolicy/power-libperfmgr
 PRODUCT_PACKAGES += \
     sendhint
 
+# hint to hardware latency benchmark
+PRODUCT_PACKAGES_DEBUG += \
+    hint_latency
+
 # power HAL
 PRODUCT_PACKAGES += \
     android.hardware.power-service.pixel-libperfmgr
@@ -22,29 +22,39 @@
 #include <android/binder_manager.h>
 #include <android/binder_process.h>
 #include <perfmgr/HintManager.h>
+#include <pixelboottiming/BootPhaseAtom.h>
 
 #include <thread>
 
 #include "Power.h"
 #include "PowerExt.h"
 #include "PowerSessionManager.h"
+#include "ThermalChannelConsumer.h"
 #include "disp-power/DisplayLowPower.h"
 
 using aidl::google::hardware::power::impl::pixel::DisplayLowPower;
 using aidl::google::hardware::power::impl::pixel::Power;
 using aidl::google::hardware::power::impl::pixel::PowerExt;
+using aidl::google::hardware::power::impl::pixel::ThermalChannelConsumer;
+using ::android::hardware::google::pixel::BootPhaseTimer;
+using ::android::hardware::google::pixel::reportBootPhasesToStats;
 using ::android::perfmgr::HintManager;
 
 constexpr std::string_view kPowerHalInitProp("vendor.powerhal.init");
+// Set to 1 to reload the powerhint config in place, back to 0 to rearm
+constexpr std::string_view kPowerHalReloadProp("vendor.powerhal.reload");
 
 int main() {
     android::base::SetDefaultTag(LOG_TAG);
+    BootPhaseTimer bootTimer("power");
     // Parse config but do not start the looper
+    bootTimer.begin("hint_manager");
     HintManager *hm = HintManager::GetInstance();
     if (!hm) {
         LOG(FATAL) << "HintManager Init failed";
     }
 
+    bootTimer.begin("power_service");
     std::shared_ptr<DisplayLowPower> dlpw = std::make_shared<DisplayLowPower>();
 
     // single thread
@@ -67,11 +77,19 @@ int main() {
     binder_status_t status = AServiceManager_addService(pw->asBinder().get(), instance.c_str());
     CHECK(status == STATUS_OK);
     LOG(INFO) << "Pixel Power HAL AIDL Service with Extension is started.";
+    bootTimer.finish(reportBootPhasesToStats);
 
     std::thread initThread([&]() {
         ::android::base::WaitForProperty(kPowerHalInitProp.data(), "1");
         HintManager::GetInstance()->Start();
         dlpw->Init();
+        ThermalChannelConsumer::getInstance()->start(
+                [pwExt](const auto &modes) { pwExt->setModes(modes); });
+        while (true) {
+            ::android::base::WaitForProperty(kPowerHalReloadProp.data(), "1");
+            HintManager::Reload(false);
+            ::android::base::WaitForProperty(kPowerHalReloadProp.data(), "0");
+        }
     });
     initThread.detach();
 
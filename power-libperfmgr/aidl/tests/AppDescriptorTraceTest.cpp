@@ -0,0 +1,71 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "aidl/AppDescriptorTrace.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+using ::aidl::android::hardware::power::SessionMode;
+
+constexpr size_t kModesStart = static_cast<size_t>(AppTraceCounter::COUNTER_SIZE);
+constexpr size_t kVotesStart = kModesStart + AppDescriptorTrace::kNumModes;
+
+TEST(AppDescriptorTraceTest, names) {
+    AppDescriptorTrace trace("1000-10123-7-4");
+    EXPECT_EQ("adpf.1000-10123-7-4-pid.err",
+              trace.name(static_cast<size_t>(AppTraceCounter::PID_ERR)));
+    EXPECT_EQ("adpf.1000-10123-7-4-hboost.numOfMissedCycles",
+              trace.name(static_cast<size_t>(AppTraceCounter::MISSED_CYCLES)));
+    EXPECT_EQ("adpf.1000-10123-7-4-gpu_capacity",
+              trace.name(static_cast<size_t>(AppTraceCounter::GPU_CAPACITY)));
+    EXPECT_EQ("adpf.1000-10123-7-4-" + toString(SessionMode::AUTO_CPU) + "_mode",
+              trace.name(kModesStart + static_cast<size_t>(SessionMode::AUTO_CPU)));
+    EXPECT_EQ("adpf.1000-10123-7-4-vote.CPU_LOAD_UP",
+              trace.name(kVotesStart + static_cast<size_t>(AdpfVoteType::CPU_LOAD_UP)));
+    // Built once and kept
+    EXPECT_EQ("adpf.1000-10123-7-4-pid.err",
+              trace.name(static_cast<size_t>(AppTraceCounter::PID_ERR)));
+}
+
+TEST(AppDescriptorTraceTest, longIdIsTruncated) {
+    AppDescriptorTrace trace(std::string(200, 'x'));
+    const std::string name = trace.name(static_cast<size_t>(AppTraceCounter::TARGET));
+    EXPECT_GT(name.size(), 0);
+    EXPECT_LT(name.size(), 96);
+    EXPECT_EQ(0, name.rfind("adpf.xxx", 0));
+}
+
+TEST(AppDescriptorTraceTest, traceOutOfRangeIsIgnored) {
+    AppDescriptorTrace trace("1");
+    trace.traceInt(AppTraceCounter::TARGET, 1);
+    trace.traceMode(static_cast<SessionMode>(AppDescriptorTrace::kNumModes), 1);
+    trace.traceVote(-1, 1);
+    trace.traceVote(AppDescriptorTrace::kNumVotes, 1);
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
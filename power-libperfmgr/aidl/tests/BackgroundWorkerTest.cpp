@@ -16,6 +16,9 @@
 
 #include <gtest/gtest.h>
 
+#include <sstream>
+#include <thread>
+
 #include "aidl/BackgroundWorker.h"
 
 namespace aidl {
@@ -28,6 +31,7 @@ namespace pixel {
 using std::literals::chrono_literals::operator""s;
 using std::literals::chrono_literals::operator""ms;
 using std::literals::chrono_literals::operator""ns;
+using std::literals::chrono_literals::operator""us;
 
 constexpr double kTIMING_TOLERANCE_MS = std::chrono::milliseconds(25).count();
 
@@ -160,6 +164,246 @@ TEST(TemplatePriorityQueueWorker, testDouble) {
     EXPECT_NEAR(350, getDurationMs(vec[5].t, tNow).count(), kTIMING_TOLERANCE_MS);
 }
 
+std::vector<int64_t> expiredIds(const std::vector<TimerWheel::Expired> &expired) {
+    std::vector<int64_t> ids;
+    for (const auto &e : expired) {
+        ids.push_back(e.key.id);
+    }
+    return ids;
+}
+
+TEST(TimerWheel, fireInDeadlineOrder) {
+    const auto t0 = std::chrono::steady_clock::now();
+    TimerWheel wheel(t0);
+    std::vector<TimerWheel::Expired> expired;
+
+    EXPECT_TRUE(wheel.schedule({1, 3}, t0 + 300ms));
+    EXPECT_TRUE(wheel.schedule({1, 1}, t0 + 10ms));
+    EXPECT_TRUE(wheel.schedule({1, 2}, t0 + 70ms));
+    EXPECT_TRUE(wheel.schedule({2, 1}, t0 + 10ms));
+    EXPECT_EQ(4, wheel.size());
+    EXPECT_EQ(t0 + 10ms, wheel.nextWakeup());
+
+    wheel.advance(t0 + 9ms, &expired);
+    EXPECT_TRUE(expired.empty());
+    wheel.advance(t0 + 10ms, &expired);
+    ASSERT_EQ(2, expired.size());
+    EXPECT_EQ((TimerWheel::Key{1, 1}), expired[0].key);
+    EXPECT_EQ((TimerWheel::Key{2, 1}), expired[1].key);
+    EXPECT_EQ(t0 + 10ms, expired[0].deadline);
+    expired.clear();
+
+    wheel.advance(t0 + 1s, &expired);
+    EXPECT_EQ(std::vector<int64_t>({2, 3}), expiredIds(expired));
+    EXPECT_EQ(0, wheel.size());
+    EXPECT_EQ(std::chrono::steady_clock::time_point::max(), wheel.nextWakeup());
+}
+
+TEST(TimerWheel, neverFiresEarly) {
+    const auto t0 = std::chrono::steady_clock::now();
+    TimerWheel wheel(t0);
+    std::vector<TimerWheel::Expired> expired;
+
+    wheel.schedule({1, 1}, t0 + 5ms + 500us);
+    wheel.advance(t0 + 5ms + 900us, &expired);
+    EXPECT_TRUE(expired.empty());
+    wheel.advance(t0 + 6ms, &expired);
+    EXPECT_EQ(1, expired.size());
+}
+
+TEST(TimerWheel, rescheduleCoalesces) {
+    const auto t0 = std::chrono::steady_clock::now();
+    TimerWheel wheel(t0);
+    std::vector<TimerWheel::Expired> expired;
+
+    EXPECT_TRUE(wheel.schedule({1, 1}, t0 + 10ms));
+    EXPECT_FALSE(wheel.schedule({1, 1}, t0 + 20ms));
+    EXPECT_FALSE(wheel.schedule({1, 1}, t0 + 30ms));
+    EXPECT_EQ(1, wheel.size());
+    wheel.advance(t0 + 25ms, &expired);
+    EXPECT_TRUE(expired.empty());
+    wheel.advance(t0 + 30ms, &expired);
+    EXPECT_EQ(1, expired.size());
+
+    // Moving a timer earlier works too
+    expired.clear();
+    wheel.schedule({1, 1}, t0 + 5s);
+    wheel.schedule({1, 1}, t0 + 40ms);
+    wheel.advance(t0 + 40ms, &expired);
+    EXPECT_EQ(1, expired.size());
+}
+
+TEST(TimerWheel, cancel) {
+    const auto t0 = std::chrono::steady_clock::now();
+    TimerWheel wheel(t0);
+    std::vector<TimerWheel::Expired> expired;
+
+    wheel.schedule({1, 1}, t0 + 10ms);
+    wheel.schedule({1, 2}, t0 + 10ms);
+    EXPECT_TRUE(wheel.cancel({1, 1}));
+    EXPECT_FALSE(wheel.cancel({1, 1}));
+    // Freed timers are reused
+    wheel.schedule({1, 3}, t0 + 20ms);
+    wheel.advance(t0 + 1s, &expired);
+    EXPECT_EQ(std::vector<int64_t>({2, 3}), expiredIds(expired));
+}
+
+TEST(TimerWheel, cascadesLongDeadlines) {
+    const auto t0 = std::chrono::steady_clock::now();
+    TimerWheel wheel(t0);
+    std::vector<TimerWheel::Expired> expired;
+
+    // One timer per level, plus one beyond the range of the wheel
+    wheel.schedule({1, 4}, t0 + 600s + 1ms);
+    wheel.schedule({1, 3}, t0 + 100s + 7ms);
+    wheel.schedule({1, 2}, t0 + 3s + 3ms);
+    wheel.schedule({1, 1}, t0 + 50ms);
+
+    for (const auto deadline : {t0 + 50ms, t0 + 3s + 3ms, t0 + 100s + 7ms, t0 + 600s + 1ms}) {
+        // Step through the wakeups the worker thread would use
+        while (expired.empty()) {
+            const auto wakeup = wheel.nextWakeup();
+            ASSERT_NE(std::chrono::steady_clock::time_point::max(), wakeup);
+            ASSERT_LE(wakeup, deadline);
+            wheel.advance(wakeup, &expired);
+        }
+        ASSERT_EQ(1, expired.size());
+        EXPECT_EQ(deadline, expired[0].deadline);
+        expired.clear();
+    }
+    EXPECT_EQ(0, wheel.size());
+}
+
+TEST(TemplatePriorityQueueWorker, testKeyedCoalesces) {
+    std::condition_variable cv;
+    std::mutex m;
+    std::vector<work> vec;
+
+    auto p = std::make_shared<PriorityQueueWorkerPool>(1, "adpf_");
+    TemplatePriorityQueueWorker<int> worker{
+            [&](int i) {
+                std::lock_guard<std::mutex> lock(m);
+                vec.push_back({i, std::chrono::steady_clock::now()});
+                cv.notify_all();
+            },
+            p};
+
+    const auto tNow = std::chrono::steady_clock::now();
+    worker.scheduleKeyed(1, 101, tNow + 100ms);
+    worker.scheduleKeyed(1, 102, tNow + 200ms);
+    worker.scheduleKeyed(2, 201, tNow + 150ms);
+    worker.scheduleKeyed(3, 301, tNow + 50ms);
+    worker.cancelKeyed(3);
+
+    std::unique_lock<std::mutex> lock(m);
+    cv.wait_for(lock, 1500ms, [&]() { return vec.size() == 2; });
+    // Give a spurious extra package the chance to show up
+    cv.wait_for(lock, 100ms, [&]() { return vec.size() > 2; });
+
+    ASSERT_EQ(2, vec.size());
+    EXPECT_EQ(201, vec[0].val);
+    EXPECT_NEAR(150, getDurationMs(vec[0].t, tNow).count(), kTIMING_TOLERANCE_MS);
+    EXPECT_EQ(102, vec[1].val);
+    EXPECT_NEAR(200, getDurationMs(vec[1].t, tNow).count(), kTIMING_TOLERANCE_MS);
+
+    std::ostringstream dump;
+    p->dumpToStream(dump);
+    EXPECT_NE(std::string::npos, dump.str().find("processed 2 coalesced 1"));
+}
+
+TEST(TemplatePriorityQueueWorker, testLanesDontBlockEachOther) {
+    std::condition_variable cv;
+    std::mutex m;
+    std::vector<work> vec;
+
+    auto p = std::make_shared<PriorityQueueWorkerPool>(
+            std::array<PriorityQueueWorkerPool::LaneConfig, kNumWorkerLanes>{
+                    PriorityQueueWorkerPool::LaneConfig{.threadCount = 1,
+                                                        .threadNamePrefix = "adpf_rt"},
+                    PriorityQueueWorkerPool::LaneConfig{.threadCount = 1,
+                                                        .threadNamePrefix = "adpf_"}});
+    TemplatePriorityQueueWorker<int> slowWorker{
+            [&](int) { std::this_thread::sleep_for(300ms); }, p, WorkerLane::NORMAL};
+    TemplatePriorityQueueWorker<int> worker{
+            [&](int i) {
+                std::lock_guard<std::mutex> lock(m);
+                vec.push_back({i, std::chrono::steady_clock::now()});
+                cv.notify_all();
+            },
+            p, WorkerLane::REALTIME};
+
+    const auto tNow = std::chrono::steady_clock::now();
+    slowWorker.schedule(1, tNow + 10ms);
+    worker.schedule(101, tNow + 100ms);
+
+    std::unique_lock<std::mutex> lock(m);
+    cv.wait_for(lock, 1500ms, [&]() { return vec.size() == 1; });
+    ASSERT_EQ(1, vec.size());
+    EXPECT_NEAR(100, getDurationMs(vec[0].t, tNow).count(), kTIMING_TOLERANCE_MS);
+
+    std::ostringstream dump;
+    p->dumpToStream(dump);
+    EXPECT_NE(std::string::npos, dump.str().find("Lane realtime: threads 1"));
+    EXPECT_NE(std::string::npos, dump.str().find("Lane normal: threads 1"));
+}
+
+TEST(TemplatePriorityQueueWorker, testIdleThreadRunsWorkWhileOtherIsBusy) {
+    std::condition_variable cv;
+    std::mutex m;
+    std::vector<work> vec;
+
+    auto p = std::make_shared<PriorityQueueWorkerPool>(2, "adpf_");
+    TemplatePriorityQueueWorker<int> slowWorker{
+            [&](int) { std::this_thread::sleep_for(500ms); }, p, WorkerLane::NORMAL};
+    TemplatePriorityQueueWorker<int> worker{
+            [&](int i) {
+                std::lock_guard<std::mutex> lock(m);
+                vec.push_back({i, std::chrono::steady_clock::now()});
+                cv.notify_all();
+            },
+            p, WorkerLane::NORMAL};
+
+    // Let both threads go idle, so only one of them picks up the slow work
+    std::this_thread::sleep_for(20ms);
+    const auto tNow = std::chrono::steady_clock::now();
+    slowWorker.schedule(1, tNow + 10ms);
+    // One thread is now blocked in the slow work, the other waits without a
+    // deadline and has to be woken up for the new one
+    std::this_thread::sleep_for(50ms);
+    worker.schedule(101, tNow + 100ms);
+
+    std::unique_lock<std::mutex> lock(m);
+    cv.wait_for(lock, 1500ms, [&]() { return vec.size() == 1; });
+    ASSERT_EQ(1, vec.size());
+    EXPECT_EQ(101, vec[0].val);
+    EXPECT_NEAR(100, getDurationMs(vec[0].t, tNow).count(), kTIMING_TOLERANCE_MS);
+}
+
+TEST(TemplatePriorityQueueWorker, testLaneWithoutThreadsUsesNormal) {
+    std::condition_variable cv;
+    std::mutex m;
+    std::vector<work> vec;
+
+    auto p = std::make_shared<PriorityQueueWorkerPool>(1, "adpf_");
+    TemplatePriorityQueueWorker<int> worker{
+            [&](int i) {
+                std::lock_guard<std::mutex> lock(m);
+                vec.push_back({i, std::chrono::steady_clock::now()});
+                cv.notify_all();
+            },
+            p, WorkerLane::REALTIME};
+
+    worker.schedule(7, std::chrono::steady_clock::now() + 10ms);
+    std::unique_lock<std::mutex> lock(m);
+    cv.wait_for(lock, 1500ms, [&]() { return vec.size() == 1; });
+    ASSERT_EQ(1, vec.size());
+    EXPECT_EQ(7, vec[0].val);
+
+    std::ostringstream dump;
+    p->dumpToStream(dump);
+    EXPECT_EQ(std::string::npos, dump.str().find("Lane realtime"));
+}
+
 }  // namespace pixel
 }  // namespace impl
 }  // namespace power
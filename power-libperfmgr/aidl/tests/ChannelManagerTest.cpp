@@ -0,0 +1,178 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "aidl/ChannelManager.h"
+#include "mocks/MockPowerHintSession.h"
+#include "mocks/MockPowerSessionManager.h"
+
+using namespace testing;
+
+using std::literals::chrono_literals::operator""s;
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+using MockSession = NiceMock<mock::pixel::MockPowerHintSession>;
+using MockManager = NiceMock<mock::pixel::MockPowerSessionManager>;
+using TestingChannelManager = ChannelManager<MockManager, MockSession>;
+using ChannelMessageContents = ChannelMessage::ChannelMessageContents;
+
+constexpr int32_t kTgid = 1000;
+constexpr int32_t kUid = 10123;
+constexpr int32_t kSessionId = 7;
+constexpr int32_t kOtherSessionId = 8;
+
+class ChannelManagerTest : public ::testing::Test {
+  public:
+    void SetUp() override {
+        mSession = std::make_shared<MockSession>();
+        mOtherSession = std::make_shared<MockSession>();
+        ON_CALL(*mSession, isOwnedBy(kTgid, kUid)).WillByDefault(Return(true));
+        ON_CALL(*mOtherSession, isOwnedBy(_, _)).WillByDefault(Return(false));
+        ON_CALL(*MockManager::getInstance(), getSession(kSessionId))
+                .WillByDefault(Return(std::static_pointer_cast<void>(mSession)));
+        ON_CALL(*MockManager::getInstance(), getSession(kOtherSessionId))
+                .WillByDefault(Return(std::static_pointer_cast<void>(mOtherSession)));
+        mManager = std::make_unique<TestingChannelManager>();
+    }
+
+    void TearDown() override {
+        mManager.reset();
+        Mock::VerifyAndClearExpectations(MockManager::getInstance());
+    }
+
+  protected:
+    static ChannelMessage workDuration(int32_t sessionId, int64_t durationNanos) {
+        ChannelMessage message;
+        message.sessionID = sessionId;
+        message.timeStampNanos = durationNanos;
+        WorkDurationFixedV1 fixed;
+        fixed.durationNanos = durationNanos;
+        message.data.set<ChannelMessageContents::Tag::workDuration>(fixed);
+        return message;
+    }
+
+    // Write messages as a client of the channel would, and wake the reader.
+    static void send(const ChannelConfig &config, const std::vector<ChannelMessage> &messages) {
+        ChannelQueue client(config.channelDescriptor, false);
+        ASSERT_TRUE(client.isValid());
+        EventFlag *flag = nullptr;
+        ASSERT_EQ(::android::OK, EventFlag::createEventFlag(client.getEventFlagWord(), &flag));
+        ASSERT_TRUE(client.write(messages.data(), messages.size()));
+        flag->wake(config.writeFlagBitmask);
+        EventFlag::deleteEventFlag(&flag);
+    }
+
+    std::shared_ptr<MockSession> mSession;
+    std::shared_ptr<MockSession> mOtherSession;
+    std::unique_ptr<TestingChannelManager> mManager;
+};
+
+TEST_F(ChannelManagerTest, channelPerTgidUid) {
+    ChannelConfig config;
+    ChannelConfig sameConfig;
+    ChannelConfig otherConfig;
+    ASSERT_TRUE(mManager->getChannelConfig(kTgid, kUid, &config));
+    ASSERT_TRUE(mManager->getChannelConfig(kTgid, kUid, &sameConfig));
+    ASSERT_TRUE(mManager->getChannelConfig(kTgid + 1, kUid, &otherConfig));
+    EXPECT_EQ(TestingChannelManager::ChannelT::kReadBit, config.readFlagBitmask);
+    EXPECT_EQ(TestingChannelManager::ChannelT::kWriteBit, config.writeFlagBitmask);
+    EXPECT_FALSE(config.eventFlagDescriptor.has_value());
+
+    EXPECT_TRUE(mManager->closeChannel(kTgid, kUid));
+    EXPECT_FALSE(mManager->closeChannel(kTgid, kUid));
+    EXPECT_TRUE(mManager->closeChannel(kTgid + 1, kUid));
+}
+
+TEST_F(ChannelManagerTest, batchesWorkDurations) {
+    ChannelConfig config;
+    ASSERT_TRUE(mManager->getChannelConfig(kTgid, kUid, &config));
+
+    std::promise<void> done;
+    {
+        InSequence seq;
+        EXPECT_CALL(*mSession, reportActualWorkDuration(SizeIs(3)))
+                .WillOnce(Return(ByMove(ndk::ScopedAStatus::ok())));
+        EXPECT_CALL(*mSession, sendHint(SessionHint::CPU_LOAD_UP))
+                .WillOnce(Return(ByMove(ndk::ScopedAStatus::ok())));
+        EXPECT_CALL(*mSession, setMode(SessionMode::POWER_EFFICIENCY, true))
+                .WillOnce(Return(ByMove(ndk::ScopedAStatus::ok())));
+        EXPECT_CALL(*mSession, reportActualWorkDuration(SizeIs(1)))
+                .WillOnce(Return(ByMove(ndk::ScopedAStatus::ok())));
+        EXPECT_CALL(*mSession, updateTargetWorkDuration(16666666))
+                .WillOnce(DoAll(InvokeWithoutArgs([&done]() { done.set_value(); }),
+                                Return(ByMove(ndk::ScopedAStatus::ok()))));
+    }
+
+    std::vector<ChannelMessage> messages;
+    messages.push_back(workDuration(kSessionId, 1000));
+    messages.push_back(workDuration(kSessionId, 2000));
+    messages.push_back(workDuration(kSessionId, 3000));
+    ChannelMessage hint;
+    hint.sessionID = kSessionId;
+    hint.data.set<ChannelMessageContents::Tag::hint>(SessionHint::CPU_LOAD_UP);
+    messages.push_back(hint);
+    ChannelMessage mode;
+    mode.sessionID = kSessionId;
+    ChannelMessageContents::SessionModeSetter setter;
+    setter.modeInt = SessionMode::POWER_EFFICIENCY;
+    setter.enabled = true;
+    mode.data.set<ChannelMessageContents::Tag::mode>(setter);
+    messages.push_back(mode);
+    messages.push_back(workDuration(kSessionId, 4000));
+    ChannelMessage target;
+    target.sessionID = kSessionId;
+    target.data.set<ChannelMessageContents::Tag::targetDuration>(16666666);
+    messages.push_back(target);
+
+    send(config, messages);
+    ASSERT_EQ(std::future_status::ready, done.get_future().wait_for(1s));
+    EXPECT_TRUE(mManager->closeChannel(kTgid, kUid));
+}
+
+TEST_F(ChannelManagerTest, dropsSessionsOfOtherApps) {
+    ChannelConfig config;
+    ASSERT_TRUE(mManager->getChannelConfig(kTgid, kUid, &config));
+
+    std::promise<void> done;
+    EXPECT_CALL(*mOtherSession, reportActualWorkDuration(_)).Times(0);
+    EXPECT_CALL(*mSession, reportActualWorkDuration(SizeIs(1)))
+            .WillOnce(DoAll(InvokeWithoutArgs([&done]() { done.set_value(); }),
+                            Return(ByMove(ndk::ScopedAStatus::ok()))));
+
+    send(config, {workDuration(kOtherSessionId, 1000), workDuration(kSessionId, 1000)});
+    ASSERT_EQ(std::future_status::ready, done.get_future().wait_for(1s));
+    EXPECT_TRUE(mManager->closeChannel(kTgid, kUid));
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -18,6 +18,8 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <sstream>
+
 #include "aidl/GpuCalculationHelpers.h"
 
 using aidl::android::hardware::power::WorkDuration;
@@ -192,6 +194,59 @@ TEST(GpuCapacityCalculation, frame_nonsense_subtarget_gpu) {
     EXPECT_EQ(calculate_capacity(observation, 10ms, 100000_hz), Cycles(0));
 }
 
+TEST(GpuCapacityFilter, unit_rates_follow_requests) {
+    GpuCapacityFilter filter;
+    EXPECT_EQ(filter.update(Cycles(1000), 1.0, 1.0), Cycles(1000));
+    EXPECT_EQ(filter.update(Cycles(0), 1.0, 1.0), Cycles(0));
+    EXPECT_EQ(filter.update(Cycles(400), 1.0, 1.0), Cycles(400));
+}
+
+TEST(GpuCapacityFilter, separate_up_and_down_rates) {
+    GpuCapacityFilter filter;
+    EXPECT_EQ(filter.update(Cycles(1000), 0.5, 0.25), Cycles(500));
+    EXPECT_EQ(filter.update(Cycles(1000), 0.5, 0.25), Cycles(750));
+    EXPECT_EQ(filter.update(Cycles(0), 0.5, 0.25), Cycles(563));
+    EXPECT_EQ(filter.update(Cycles(0), 0.5, 0.25), Cycles(422));
+}
+
+TEST(GpuCapacityFilter, reset_and_trajectory) {
+    GpuCapacityFilter filter;
+    for (int i = 1; i <= 10; i++) {
+        filter.update(Cycles(i * 10), 1.0, 1.0);
+    }
+    std::ostringstream stream;
+    filter.dumpToStream(stream);
+    EXPECT_EQ(stream.str(), "GpuCapacity(30 40 50 60 70 80 90 100)");
+
+    filter.reset();
+    EXPECT_EQ(filter.value(), Cycles(0));
+    stream.str("");
+    filter.dumpToStream(stream);
+    EXPECT_EQ(stream.str(), "GpuCapacity()");
+}
+
+TEST(GpuCoBoost, decays_over_frames) {
+    GpuCoBoost coBoost;
+    EXPECT_EQ(coBoost.update(0.5, 1, 0, 0.5, Cycles(1000), 4), Cycles(250));
+    EXPECT_EQ(coBoost.update(0.0, 1, 1, 0.5, Cycles(1000), 4), Cycles(188));
+    // A smaller spike doesn't restart the decay
+    EXPECT_EQ(coBoost.update(0.2, 1, 0, 0.5, Cycles(1000), 4), Cycles(125));
+    EXPECT_EQ(coBoost.update(0.0, 2, 0, 0.5, Cycles(1000), 4), Cycles(0));
+    EXPECT_EQ(coBoost.update(0.0, 1, 0, 0.5, Cycles(1000), 4), Cycles(0));
+
+    std::ostringstream stream;
+    coBoost.dumpToStream(stream);
+    EXPECT_EQ(stream.str(), "GpuCoBoost(0, Missed%(25 of 4 co-boosted, 0 of 2 not))");
+}
+
+TEST(GpuCoBoost, capped_and_reset) {
+    GpuCoBoost coBoost;
+    EXPECT_EQ(coBoost.update(0.5, 1, 0, 4.0, Cycles(1000), 2), Cycles(1000));
+    EXPECT_EQ(coBoost.update(-0.5, 1, 0, 4.0, Cycles(1000), 2), Cycles(500));
+    coBoost.reset();
+    EXPECT_EQ(coBoost.value(), Cycles(0));
+}
+
 }  // namespace pixel
 }  // namespace impl
 }  // namespace power
@@ -122,6 +122,56 @@ TEST_F(GpuCapacityNodeTest, writes_failure) {
     EXPECT_THAT(capacity_node.set_gpu_capacity(capacity), Eq(false));
 }
 
+TEST_F(GpuCapacityNodeTest, skips_writing_unchanged_value) {
+    EXPECT_CALL(*mock_fd_interface, write(fake_fd, StrEq(capacity_str), capacity_str.size()))
+            .Times(1);
+    GpuCapacityNode capacity_node(std::make_unique<FdInterfaceWrapper>(mock_fd_interface), fake_fd,
+                                  another_fake_fd, path);
+    EXPECT_TRUE(capacity_node.set_gpu_capacity(capacity));
+    EXPECT_TRUE(capacity_node.set_gpu_capacity(capacity));
+    EXPECT_THAT(capacity_node.writes_requested(), Eq(2u));
+    EXPECT_THAT(capacity_node.writes_issued(), Eq(1u));
+}
+
+TEST_F(GpuCapacityNodeTest, rewrites_value_after_failure) {
+    EXPECT_CALL(*mock_fd_interface, write(_, _, _)).Times(2).WillOnce(Return(-1)).WillOnce(
+            Return(5));
+    GpuCapacityNode capacity_node(std::make_unique<FdInterfaceWrapper>(mock_fd_interface), fake_fd,
+                                  another_fake_fd, path);
+    EXPECT_FALSE(capacity_node.set_gpu_capacity(capacity));
+    EXPECT_TRUE(capacity_node.set_gpu_capacity(capacity));
+}
+
+TEST_F(GpuCapacityNodeTest, coalesces_requests_within_window) {
+    using std::literals::chrono_literals::operator""us;
+    auto const t0 = std::chrono::steady_clock::now();
+    testing::Sequence seq;
+    EXPECT_CALL(*mock_fd_interface, write(fake_fd, StrEq("100"), _)).InSequence(seq);
+    EXPECT_CALL(*mock_fd_interface, write(fake_fd, StrEq("300"), _)).InSequence(seq);
+    EXPECT_CALL(*mock_fd_interface, write(fake_fd, StrEq("400"), _)).InSequence(seq);
+    GpuCapacityNode capacity_node(std::make_unique<FdInterfaceWrapper>(mock_fd_interface), fake_fd,
+                                  another_fake_fd, path, 1000us);
+
+    // First request goes straight through
+    EXPECT_FALSE(capacity_node.request_gpu_capacity(Cycles(100), t0));
+    // Within the window: the first one asks for a flush at the end of it, the
+    // following ones only replace the pending value
+    auto const flush_time = capacity_node.request_gpu_capacity(Cycles(200), t0 + 100us);
+    ASSERT_TRUE(flush_time);
+    EXPECT_THAT(*flush_time, Eq(t0 + 1000us));
+    EXPECT_FALSE(capacity_node.request_gpu_capacity(Cycles(300), t0 + 200us));
+    EXPECT_TRUE(capacity_node.flush_gpu_capacity(t0 + 1000us));
+    // Nothing pending anymore
+    EXPECT_TRUE(capacity_node.flush_gpu_capacity(t0 + 1100us));
+    // Unchanged value needs neither a write nor a flush
+    EXPECT_FALSE(capacity_node.request_gpu_capacity(Cycles(300), t0 + 1200us));
+    // Past the window again
+    EXPECT_FALSE(capacity_node.request_gpu_capacity(Cycles(400), t0 + 2000us));
+
+    EXPECT_THAT(capacity_node.writes_requested(), Eq(5u));
+    EXPECT_THAT(capacity_node.writes_issued(), Eq(3u));
+}
+
 TEST_F(GpuCapacityNodeTest, reads_freq_correctly) {
     static constexpr auto value = "100";
     testing::Sequence seq;
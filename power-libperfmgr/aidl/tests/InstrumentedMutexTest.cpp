@@ -0,0 +1,72 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <thread>
+
+#include "aidl/InstrumentedMutex.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+using std::literals::chrono_literals::operator""ms;
+
+TEST(InstrumentedMutexTest, recordsHoldAndWait) {
+    InstrumentedMutex mutex;
+    {
+        std::lock_guard lock(mutex);
+        std::this_thread::sleep_for(20ms);
+    }
+    EXPECT_EQ(1, mutex.waitTimes().GetCount());
+    EXPECT_EQ(0, mutex.waitTimes().GetMax().count());
+    EXPECT_EQ(1, mutex.holdTimes().GetCount());
+    EXPECT_GE(mutex.holdTimes().GetMax(), 20ms);
+
+    std::unique_lock lock(mutex);
+    std::thread waiter([&mutex] { std::lock_guard waiting(mutex); });
+    std::this_thread::sleep_for(20ms);
+    lock.unlock();
+    waiter.join();
+    EXPECT_EQ(3, mutex.waitTimes().GetCount());
+    EXPECT_GE(mutex.waitTimes().GetMax(), 10ms);
+    EXPECT_EQ(3, mutex.holdTimes().GetCount());
+}
+
+TEST(InstrumentedMutexTest, tryLock) {
+    InstrumentedMutex mutex;
+    ASSERT_TRUE(mutex.try_lock());
+    std::thread([&mutex] { EXPECT_FALSE(mutex.try_lock()); }).join();
+    mutex.unlock();
+    EXPECT_EQ(1, mutex.waitTimes().GetCount());
+    EXPECT_EQ(1, mutex.holdTimes().GetCount());
+
+    std::ostringstream os;
+    mutex.dumpToStream(os, "Map");
+    EXPECT_EQ(0, os.str().rfind("Map: 1 locks, wait 0/0/0/0us, hold ", 0)) << os.str();
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
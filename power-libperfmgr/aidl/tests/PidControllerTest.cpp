@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "aidl/PidController.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+namespace {
+
+// The per-sample PID loop evaluatePid replaced, kept as the reference.
+PidOutput referencePid(const PidParams &params, const std::vector<WorkDuration> &actualDurations,
+                       PidState *state) {
+    int64_t length = actualDurations.size();
+    int64_t p_start = params.samplingWindowP == 0 || params.samplingWindowP > static_cast<uint64_t>(length)
+                              ? 0
+                              : length - params.samplingWindowP;
+    int64_t i_start = params.samplingWindowI == 0 || params.samplingWindowI > static_cast<uint64_t>(length)
+                              ? 0
+                              : length - params.samplingWindowI;
+    int64_t d_start = params.samplingWindowD == 0 || params.samplingWindowD > static_cast<uint64_t>(length)
+                              ? 0
+                              : length - params.samplingWindowD;
+    int64_t dt = params.targetDurationNanos / 100000;
+    int64_t err_sum = 0;
+    int64_t derivative_sum = 0;
+    for (int64_t i = std::min({p_start, i_start, d_start}); i < length; i++) {
+        int64_t error = (actualDurations[i].durationNanos - params.targetDurationNanos) / 100000;
+        if (i >= d_start) {
+            derivative_sum += error - state->previousError;
+        }
+        if (i >= p_start) {
+            err_sum += error;
+        }
+        if (i >= i_start) {
+            state->integralError += error * dt;
+            state->integralError = std::min(params.integralHigh, state->integralError);
+            state->integralError = std::max(params.integralLow, state->integralError);
+        }
+        state->previousError = error;
+    }
+    PidOutput out;
+    out.errorAvg = err_sum / (length - p_start);
+    out.derivativeAvg = derivative_sum / dt / (length - d_start);
+    out.pOut = static_cast<int64_t>((err_sum > 0 ? params.pidPo : params.pidPu) * err_sum /
+                                    (length - p_start));
+    out.iOut = static_cast<int64_t>(params.pidI * state->integralError);
+    out.dOut = static_cast<int64_t>((derivative_sum > 0 ? params.pidDo : params.pidDu) *
+                                    derivative_sum / dt / (length - d_start));
+    out.output = out.pOut + out.iOut + out.dOut;
+    return out;
+}
+
+PidParams defaultParams() {
+    PidParams params;
+    params.targetDurationNanos = 16666666;
+    params.samplingWindowP = 1;
+    params.samplingWindowI = 0;
+    params.samplingWindowD = 1;
+    params.pidPo = 2.0;
+    params.pidPu = 1.0;
+    params.pidI = 0.001;
+    params.pidDo = 500.0;
+    params.pidDu = 0.0;
+    params.integralHigh = static_cast<int64_t>(512 / params.pidI);
+    params.integralLow = static_cast<int64_t>(-30 / params.pidI);
+    return params;
+}
+
+std::vector<WorkDuration> makeDurations(std::initializer_list<int64_t> durationsNs) {
+    std::vector<WorkDuration> durations;
+    for (auto d : durationsNs) {
+        WorkDuration w;
+        w.durationNanos = d;
+        durations.push_back(w);
+    }
+    return durations;
+}
+
+}  // namespace
+
+TEST(PidControllerTest, singleSample) {
+    PidParams params = defaultParams();
+    PidState state;
+    auto out = evaluatePid(params, makeDurations({20000000}), &state);
+    // 3.33ms over the target in 100us units
+    EXPECT_EQ(33, out.errorAvg);
+    EXPECT_EQ(33, state.previousError);
+    EXPECT_EQ(33 * 166, state.integralError);
+    EXPECT_EQ(66, out.pOut);
+    EXPECT_EQ(out.pOut + out.iOut + out.dOut, out.output);
+    EXPECT_EQ(0, out.outlierDurationNanos);
+}
+
+TEST(PidControllerTest, integralIsClamped) {
+    PidParams params = defaultParams();
+    PidState state;
+    evaluatePid(params, makeDurations({1000000000, 1000000000}), &state);
+    EXPECT_EQ(params.integralHigh, state.integralError);
+    evaluatePid(params, std::vector<WorkDuration>(30), &state);
+    EXPECT_EQ(params.integralLow, state.integralError);
+}
+
+TEST(PidControllerTest, reportsWorstOutlier) {
+    PidParams params = defaultParams();
+    PidState state;
+    auto out = evaluatePid(params, makeDurations({16000000, 400000000, -500000000, 340000000}),
+                           &state);
+    EXPECT_EQ(-500000000, out.outlierDurationNanos);
+}
+
+TEST(PidControllerTest, matchesReferenceForRandomBatches) {
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int64_t> duration(0, 60000000);
+    std::uniform_int_distribution<int> batchSize(1, 64);
+    std::uniform_int_distribution<int> window(0, 8);
+
+    for (int round = 0; round < 200; round++) {
+        PidParams params = defaultParams();
+        params.samplingWindowP = window(gen);
+        params.samplingWindowI = window(gen);
+        params.samplingWindowD = window(gen);
+        PidState state;
+        PidState reference;
+        for (int report = 0; report < 20; report++) {
+            std::vector<WorkDuration> durations(batchSize(gen));
+            for (auto &d : durations) {
+                d.durationNanos = duration(gen);
+            }
+            auto out = evaluatePid(params, durations, &state);
+            auto expected = referencePid(params, durations, &reference);
+            ASSERT_EQ(expected.errorAvg, out.errorAvg);
+            ASSERT_EQ(expected.derivativeAvg, out.derivativeAvg);
+            ASSERT_EQ(expected.pOut, out.pOut);
+            ASSERT_EQ(expected.iOut, out.iOut);
+            ASSERT_EQ(expected.dOut, out.dOut);
+            ASSERT_EQ(expected.output, out.output);
+            ASSERT_EQ(reference.integralError, state.integralError);
+            ASSERT_EQ(reference.previousError, state.previousError);
+        }
+    }
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <unordered_map>
+
+#include "aidl/SessionCgroup.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+using ::android::base::ReadFileToString;
+
+std::string readFile(const std::string &path) {
+    std::string content;
+    ReadFileToString(path, &content);
+    return content;
+}
+
+TEST(SessionCgroupTest, parseCpuCgroup) {
+    EXPECT_EQ("/top-app",
+              SessionCgroup::parseCpuCgroup("5:memory:/\n3:cpu:/top-app\n1:cpuset:/top-app\n"));
+    EXPECT_EQ("/foreground", SessionCgroup::parseCpuCgroup("2:cpu,cpuacct:/foreground\n"));
+    EXPECT_EQ("", SessionCgroup::parseCpuCgroup("3:cpu:/\n"));
+    EXPECT_FALSE(SessionCgroup::parseCpuCgroup("0::/user.slice\n1:cpuset:/\n").has_value());
+}
+
+TEST(SessionCgroupTest, movesTasksInAndOut) {
+    TemporaryDir root;
+    // Threads of unknown cgroup go under the root
+    auto cgroup = SessionCgroup::create(root.path, 42,
+                                        [](pid_t) { return std::optional<std::string>(); });
+    ASSERT_NE(nullptr, cgroup);
+    const std::string path = std::string(root.path) + cgroup->childOf("");
+    EXPECT_EQ(std::string(root.path) + "/adpf-42", path);
+
+    const pid_t tid = gettid();
+    std::vector<pid_t> movedIn;
+    std::vector<pid_t> movedOut;
+    cgroup->setTasks({tid}, &movedIn, &movedOut);
+    EXPECT_EQ(std::vector<pid_t>({tid}), movedIn);
+    EXPECT_TRUE(movedOut.empty());
+    EXPECT_TRUE(cgroup->hasTask(tid));
+    struct stat st;
+    ASSERT_EQ(0, stat(path.c_str(), &st));
+    EXPECT_TRUE(S_ISDIR(st.st_mode));
+    EXPECT_EQ(std::to_string(tid), readFile(path + "/tasks"));
+
+    // Already in, nothing moves
+    movedIn.clear();
+    cgroup->setTasks({tid}, &movedIn, &movedOut);
+    EXPECT_TRUE(movedIn.empty());
+    EXPECT_TRUE(movedOut.empty());
+
+    cgroup->setTasks({}, &movedIn, &movedOut);
+    EXPECT_EQ(std::vector<pid_t>({tid}), movedOut);
+    EXPECT_FALSE(cgroup->hasTask(tid));
+    EXPECT_EQ(0, cgroup->numTasks());
+    EXPECT_EQ(std::to_string(tid), readFile(std::string(root.path) + "/tasks"));
+}
+
+TEST(SessionCgroupTest, createsUnderParentCgroup) {
+    TemporaryDir root;
+    const std::string rootPath = root.path;
+    for (const char *parent : {"/top-app", "/foreground", "/background"}) {
+        ASSERT_EQ(0, mkdir((rootPath + parent).c_str(), 0755));
+    }
+    std::unordered_map<pid_t, std::string> cgroups{{100, "/top-app"}, {101, "/foreground"}};
+    auto cgroup = SessionCgroup::create(root.path, 7, [&](pid_t tid) {
+        return std::optional<std::string>(cgroups[tid]);
+    });
+    ASSERT_NE(nullptr, cgroup);
+    EXPECT_EQ("/top-app/adpf-7", cgroup->childOf("/top-app"));
+
+    std::vector<pid_t> movedIn;
+    std::vector<pid_t> movedOut;
+    cgroup->setTasks({100, 101}, &movedIn, &movedOut);
+    EXPECT_EQ(2, movedIn.size());
+    EXPECT_EQ("100", readFile(rootPath + "/top-app/adpf-7/tasks"));
+    EXPECT_EQ("101", readFile(rootPath + "/foreground/adpf-7/tasks"));
+    EXPECT_TRUE(cgroup->setUclamp({512, 1024}));
+    EXPECT_EQ("50.00", readFile(rootPath + "/top-app/adpf-7/cpu.uclamp.min"));
+    EXPECT_EQ("50.00", readFile(rootPath + "/foreground/adpf-7/cpu.uclamp.min"));
+
+    // Moved to background by someone else, the thread stays in the session
+    // under its new parent, with the session uclamp
+    cgroups = {{100, "/top-app/adpf-7"}, {101, "/background"}};
+    movedIn.clear();
+    cgroup->setTasks({100, 101}, &movedIn, &movedOut);
+    EXPECT_TRUE(movedIn.empty());
+    EXPECT_TRUE(movedOut.empty());
+    EXPECT_EQ("101", readFile(rootPath + "/background/adpf-7/tasks"));
+    EXPECT_EQ("50.00", readFile(rootPath + "/background/adpf-7/cpu.uclamp.min"));
+
+    // Only the thread still in a session cgroup goes back to its parent, the
+    // one moved out meanwhile is left where it is now
+    cgroups = {{100, "/top-app/adpf-7"}, {101, "/foreground"}};
+    cgroup->setTasks({}, &movedIn, &movedOut);
+    EXPECT_EQ(2, movedOut.size());
+    EXPECT_EQ("100", readFile(rootPath + "/top-app/tasks"));
+    EXPECT_EQ("", readFile(rootPath + "/foreground/tasks"));
+    EXPECT_EQ("", readFile(rootPath + "/background/tasks"));
+}
+
+TEST(SessionCgroupTest, setUclampWritesPercentOnce) {
+    TemporaryDir root;
+    auto cgroup = SessionCgroup::create(root.path, 1, [](pid_t) { return std::string(); });
+    ASSERT_NE(nullptr, cgroup);
+    cgroup->setTasks({100}, nullptr, nullptr);
+    const std::string path = std::string(root.path) + cgroup->childOf("");
+    const std::string minPath = path + "/cpu.uclamp.min";
+    const std::string maxPath = path + "/cpu.uclamp.max";
+
+    EXPECT_TRUE(cgroup->setUclamp({512, 1024}));
+    EXPECT_EQ("50.00", readFile(minPath));
+    EXPECT_EQ("100.00", readFile(maxPath));
+
+    // Unchanged range isn't written again
+    unlink(minPath.c_str());
+    EXPECT_TRUE(cgroup->setUclamp({512, 1024}));
+    EXPECT_EQ("", readFile(minPath));
+
+    EXPECT_TRUE(cgroup->setUclamp({123, 900}));
+    EXPECT_EQ("12.01", readFile(minPath));
+    EXPECT_EQ("87.89", readFile(maxPath));
+}
+
+TEST(SessionCgroupTest, createFailsWithoutRoot) {
+    EXPECT_EQ(nullptr, SessionCgroup::create("/nonexistent/cpuctl", 1));
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+#include "aidl/SessionMetrics.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+using std::literals::chrono_literals::operator""us;
+
+TEST(SessionMetricsTest, latencyStats) {
+    LatencyStats stats;
+    std::ostringstream empty;
+    stats.dump(empty, "Latency");
+    EXPECT_EQ("Latency: 0", empty.str());
+
+    stats.record(100us);
+    stats.record(300us);
+    // A clock going backwards doesn't turn into a negative latency
+    stats.record(-50us);
+    EXPECT_EQ(3, stats.count);
+    EXPECT_EQ(400000, stats.totalNs);
+    EXPECT_EQ(300000, stats.maxNs);
+
+    std::ostringstream os;
+    stats.dump(os, "Latency");
+    EXPECT_EQ("Latency: 3 133/300us", os.str());
+}
+
+TEST(SessionMetricsTest, missRateByBoostState) {
+    SessionMetrics metrics;
+    metrics.recordFrames(4, 2, false);
+    metrics.recordFrames(6, 0, false);
+    metrics.recordFrames(5, 1, true);
+    EXPECT_EQ(10, metrics.unboostedFrames);
+    EXPECT_EQ(2, metrics.unboostedMissedFrames);
+    EXPECT_EQ(5, metrics.boostedFrames);
+    EXPECT_EQ(1, metrics.boostedMissedFrames);
+
+    std::ostringstream os;
+    metrics.dump(os);
+    EXPECT_NE(std::string::npos, os.str().find("Missed%(20 of 10 unboosted, 20 of 5 boosted)"));
+}
+
+TEST(SessionMetricsTest, uclampMinHistogram) {
+    SessionMetrics metrics;
+    metrics.recordUclampMin(0);
+    metrics.recordUclampMin(63);
+    metrics.recordUclampMin(64);
+    metrics.recordUclampMin(480);
+    metrics.recordUclampMin(1024);
+    metrics.recordUclampMin(-1);
+    EXPECT_EQ(3, metrics.uclampMinHistogram[0]);
+    EXPECT_EQ(1, metrics.uclampMinHistogram[1]);
+    EXPECT_EQ(1, metrics.uclampMinHistogram[7]);
+    EXPECT_EQ(1, metrics.uclampMinHistogram[SessionMetrics::kUclampMinBuckets - 1]);
+}
+
+TEST(SessionFootprintTest, countsSessionsAndBytes) {
+    // Other tests of the binary may have sessions alive, compare to their count
+    std::ostringstream before;
+    SessionFootprint::dump(before);
+    SessionFootprint::add(2, 300);
+    std::ostringstream during;
+    SessionFootprint::dump(during);
+    EXPECT_NE(before.str(), during.str());
+    SessionFootprint::add(-2, -300);
+    std::ostringstream after;
+    SessionFootprint::dump(after);
+    EXPECT_EQ(before.str(), after.str());
+    EXPECT_NE(std::string::npos, after.str().find("bytes/session"));
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include "aidl/SessionRecorder.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+WorkDuration makeDuration(int64_t timeStamp, int64_t duration) {
+    WorkDuration d;
+    d.timeStampNanos = timeStamp;
+    d.durationNanos = duration;
+    d.workPeriodStartTimestampNanos = timeStamp - duration;
+    d.cpuDurationNanos = duration - 1000;
+    d.gpuDurationNanos = duration / 2;
+    return d;
+}
+
+std::string readRecording(const std::string &path) {
+    std::string data;
+    EXPECT_TRUE(::android::base::ReadFileToString(path, &data));
+    return data;
+}
+
+TEST(SessionRecorderTest, roundTrip) {
+    TemporaryFile file;
+    const std::vector<WorkDuration> durations = {makeDuration(123456789000, 16000000),
+                                                 makeDuration(123472789000, 17500000)};
+    {
+        auto recorder = SessionRecorder::open(file.path, 1000, 10123, 1, 16666666);
+        ASSERT_NE(nullptr, recorder);
+        recorder->recordTarget(8333333);
+        recorder->recordReport(durations);
+        recorder->recordHint(2);
+        recorder->recordPause();
+        recorder->recordResume();
+        recorder->recordReport({makeDuration(123400000000, 9000000)});
+    }
+
+    auto recording = SessionRecording::parse(readRecording(file.path));
+    ASSERT_TRUE(recording.has_value());
+    EXPECT_EQ(1000, recording->tgid);
+    EXPECT_EQ(10123, recording->uid);
+    EXPECT_EQ(1, recording->tag);
+    EXPECT_EQ(16666666, recording->targetNs);
+    ASSERT_EQ(6, recording->events.size());
+
+    const auto &events = recording->events;
+    EXPECT_EQ(RecordedEventType::UPDATE_TARGET, events[0].type);
+    EXPECT_EQ(8333333, events[0].value);
+    EXPECT_EQ(RecordedEventType::REPORT_DURATIONS, events[1].type);
+    EXPECT_EQ(durations, events[1].durations);
+    EXPECT_EQ(RecordedEventType::SEND_HINT, events[2].type);
+    EXPECT_EQ(2, events[2].value);
+    EXPECT_EQ(RecordedEventType::PAUSE, events[3].type);
+    EXPECT_EQ(RecordedEventType::RESUME, events[4].type);
+    // Timestamps going backwards survive the delta encoding
+    ASSERT_EQ(1, events[5].durations.size());
+    EXPECT_EQ(makeDuration(123400000000, 9000000), events[5].durations[0]);
+    for (size_t i = 1; i < events.size(); i++) {
+        EXPECT_LE(events[i - 1].time, events[i].time);
+    }
+}
+
+TEST(SessionRecorderTest, truncatedRecordingKeepsFullEvents) {
+    TemporaryFile file;
+    {
+        auto recorder = SessionRecorder::open(file.path, 1, 2, 0, 16666666);
+        ASSERT_NE(nullptr, recorder);
+        recorder->recordPause();
+        recorder->recordReport({makeDuration(1000000000, 16000000)});
+    }
+    const std::string data = readRecording(file.path);
+
+    auto recording = SessionRecording::parse(data.substr(0, data.size() - 1));
+    ASSERT_TRUE(recording.has_value());
+    ASSERT_EQ(1, recording->events.size());
+    EXPECT_EQ(RecordedEventType::PAUSE, recording->events[0].type);
+
+    EXPECT_FALSE(SessionRecording::parse(data.substr(0, 3)).has_value());
+    EXPECT_FALSE(SessionRecording::parse("not a recording").has_value());
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -16,6 +16,7 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <vector>
 
 #include "aidl/SessionRecords.h"
@@ -88,6 +89,112 @@ TEST_F(SessionRecordsTest, addReportedDurations) {
     ASSERT_EQ(4, mRecords->getNumOfMissedCycles());
 }
 
+TEST_F(SessionRecordsTest, percentileDuration) {
+    ASSERT_FALSE(mRecords->getPercentileDuration(90).has_value());
+
+    mRecords->addReportedDurations(fakeWorkDurations(std::vector<int32_t>{3}), MS_TO_NS(3));
+    ASSERT_EQ(MS_TO_US(3), mRecords->getPercentileDuration(1).value());
+    ASSERT_EQ(MS_TO_US(3), mRecords->getPercentileDuration(100).value());
+
+    mRecords->addReportedDurations(fakeWorkDurations({5, 1, 4, 2}), MS_TO_NS(3));
+    ASSERT_EQ(MS_TO_US(1), mRecords->getPercentileDuration(20).value());
+    ASSERT_EQ(MS_TO_US(3), mRecords->getPercentileDuration(50).value());
+    ASSERT_EQ(MS_TO_US(5), mRecords->getPercentileDuration(90).value());
+    ASSERT_EQ(mRecords->getMaxDuration(), mRecords->getPercentileDuration(100));
+
+    // Old records leave the window along with their durations, including
+    // duplicated values.
+    mRecords->addReportedDurations(fakeWorkDurations({2, 2, 6}), MS_TO_NS(3));
+    ASSERT_EQ(5, mRecords->getNumOfRecords());
+    ASSERT_EQ(MS_TO_US(2), mRecords->getPercentileDuration(20).value());
+    ASSERT_EQ(MS_TO_US(2), mRecords->getPercentileDuration(60).value());
+    ASSERT_EQ(MS_TO_US(4), mRecords->getPercentileDuration(80).value());
+    ASSERT_EQ(MS_TO_US(6), mRecords->getPercentileDuration(90).value());
+    ASSERT_EQ(MS_TO_US(6), mRecords->getMaxDuration().value());
+
+    ASSERT_FALSE(mRecords->getPercentileDuration(0).has_value());
+    ASSERT_FALSE(mRecords->getPercentileDuration(101).has_value());
+}
+
+TEST_F(SessionRecordsTest, slidingWindowMatchesBruteForce) {
+    std::vector<int32_t> durationsMs;
+    uint32_t seed = 1;
+    for (int i = 0; i < 200; i++) {
+        seed = seed * 1103515245 + 12345;
+        durationsMs.push_back((seed >> 16) % 8 + 1);
+    }
+    for (size_t i = 0; i < durationsMs.size(); i++) {
+        mRecords->addReportedDurations(fakeWorkDurations(std::vector<int32_t>{durationsMs[i]}), MS_TO_NS(3));
+        size_t first = i + 1 > kMaxNumOfRecords ? i + 1 - kMaxNumOfRecords : 0;
+        std::vector<int32_t> window(durationsMs.begin() + first, durationsMs.begin() + i + 1);
+        std::sort(window.begin(), window.end());
+        ASSERT_EQ(MS_TO_US(window.back()), mRecords->getMaxDuration().value());
+        size_t rank = (9 * window.size() + 9) / 10;  // ceil(0.9 * size)
+        ASSERT_EQ(MS_TO_US(window[rank - 1]), mRecords->getPercentileDuration(90).value());
+    }
+}
+
+TEST_F(SessionRecordsTest, heavyCyclePeriod) {
+    // Heavy cycle every 3rd frame, target 3ms and 1.5x jank check factor
+    ASSERT_FALSE(mRecords->predictNextCycleHeavy());
+    for (int i = 0; i < 3; i++) {
+        mRecords->addReportedDurations(fakeWorkDurations({2, 2, 8}), MS_TO_NS(3));
+    }
+    // Only three heavy cycles so far
+    ASSERT_FALSE(mRecords->getHeavyCyclePeriod().has_value());
+    mRecords->addReportedDurations(fakeWorkDurations({2, 2, 8}), MS_TO_NS(3));
+    ASSERT_EQ(3, mRecords->getHeavyCyclePeriod().value());
+
+    mRecords->addReportedDurations(fakeWorkDurations(std::vector<int32_t>{2}), MS_TO_NS(3));
+    ASSERT_FALSE(mRecords->predictNextCycleHeavy());
+    mRecords->addReportedDurations(fakeWorkDurations(std::vector<int32_t>{2}), MS_TO_NS(3));
+    ASSERT_TRUE(mRecords->predictNextCycleHeavy());
+
+    // The boost made the cycle meet the target, but it was still heavier than
+    // the average so the period holds.
+    mRecords->addReportedDurations(fakeWorkDurations(std::vector<int32_t>{4}), MS_TO_NS(3));
+    ASSERT_EQ(1, mRecords->getNumOfPredictionHits());
+    ASSERT_EQ(3, mRecords->getHeavyCyclePeriod().value());
+
+    mRecords->addReportedDurations(fakeWorkDurations({2, 2}), MS_TO_NS(3));
+    ASSERT_TRUE(mRecords->predictNextCycleHeavy());
+    mRecords->addReportedDurations(fakeWorkDurations(std::vector<int32_t>{9}), MS_TO_NS(3));
+    ASSERT_EQ(1, mRecords->getNumOfPredictionMisses());
+
+    mRecords->addReportedDurations(fakeWorkDurations({2, 2}), MS_TO_NS(3));
+    ASSERT_TRUE(mRecords->predictNextCycleHeavy());
+    mRecords->addReportedDurations(fakeWorkDurations(std::vector<int32_t>{1}), MS_TO_NS(3));
+    ASSERT_EQ(1, mRecords->getNumOfFalsePredictions());
+    ASSERT_EQ(1, mRecords->getNumOfPredictionHits());
+    ASSERT_EQ(1, mRecords->getNumOfPredictionMisses());
+    // The cycle after a false prediction isn't predicted again
+    ASSERT_FALSE(mRecords->predictNextCycleHeavy());
+}
+
+TEST_F(SessionRecordsTest, noPeriodForIrregularOrBackToBackHeavyCycles) {
+    mRecords->addReportedDurations(fakeWorkDurations({8, 2, 8, 2, 2, 8, 8}), MS_TO_NS(3));
+    ASSERT_FALSE(mRecords->getHeavyCyclePeriod().has_value());
+    mRecords->addReportedDurations(fakeWorkDurations({8, 8, 8, 8}), MS_TO_NS(3));
+    ASSERT_FALSE(mRecords->getHeavyCyclePeriod().has_value());
+    ASSERT_FALSE(mRecords->predictNextCycleHeavy());
+}
+
+TEST_F(SessionRecordsTest, compactDurations) {
+    // Rounded to kDurationUnitUs, saturated past the 16 bits
+    std::vector<WorkDuration> durations;
+    durations.emplace_back(0, 1003 * 1000);
+    durations.emplace_back(0, MS_TO_NS(2000));
+    mRecords->addReportedDurations(durations, MS_TO_NS(3));
+    ASSERT_EQ(2, mRecords->getNumOfRecords());
+    ASSERT_EQ(1000, mRecords->getPercentileDuration(50).value());
+    ASSERT_EQ(UINT16_MAX * SessionRecords::kDurationUnitUs, mRecords->getMaxDuration().value());
+    ASSERT_EQ(1, mRecords->getNumOfMissedCycles());
+
+    // 4 bytes a record, 2 for each index and sorted duration
+    SessionRecords large(1000, kJankCheckTimeFactor);
+    ASSERT_EQ(sizeof(SessionRecords) + 8000, large.getMemoryBytes());
+}
+
 TEST_F(SessionRecordsTest, checkLowFrameRate) {
     ASSERT_FALSE(mRecords->isLowFrameRate(25));
     mRecords->addReportedDurations(fakeWorkDurations({{0, 8}, {10, 9}, {20, 8}, {30, 8}}),
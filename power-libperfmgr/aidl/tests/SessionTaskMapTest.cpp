@@ -16,9 +16,12 @@
 
 #include <gtest/gtest.h>
 
+#include <utility>
+
 #include "aidl/SessionTaskMap.h"
 
 using std::literals::chrono_literals::operator""ms;
+using std::literals::chrono_literals::operator""s;
 using std::literals::chrono_literals::operator""ns;
 
 namespace aidl {
@@ -205,6 +208,41 @@ TEST(SessionTaskMapTest, remove) {
     EXPECT_FALSE(m.isAnyAppSessionActive(tNow));
 }
 
+TEST(SessionTaskMapTest, appliedUclampCache) {
+    SessionTaskMap m;
+    const UclampRange boosted{.uclampMin = 300, .uclampMax = 1024};
+    const UclampRange other{.uclampMin = 500, .uclampMax = 1024};
+    EXPECT_TRUE(m.add(1, makeSession(1000), {10, 20}));
+    EXPECT_TRUE(m.add(2, makeSession(2000), {20}));
+
+    EXPECT_FALSE(m.isUclampApplied(10, boosted));
+    m.setUclampApplied(10, boosted);
+    m.setUclampApplied(20, boosted);
+    EXPECT_TRUE(m.isUclampApplied(10, boosted));
+    EXPECT_FALSE(m.isUclampApplied(10, other));
+
+    m.invalidateUclampApplied(10);
+    EXPECT_FALSE(m.isUclampApplied(10, boosted));
+    m.setUclampApplied(10, boosted);
+
+    // Changing the threads of a session forgets its threads
+    std::vector<pid_t> addedThreads;
+    std::vector<pid_t> removedThreads;
+    m.replace(2, {20, 30}, &addedThreads, &removedThreads);
+    EXPECT_TRUE(m.isUclampApplied(10, boosted));
+    EXPECT_FALSE(m.isUclampApplied(20, boosted));
+
+    // So does a dead thread
+    m.setUclampApplied(10, boosted);
+    EXPECT_TRUE(m.removeDeadTaskSessionMap(1, 10));
+    EXPECT_FALSE(m.isUclampApplied(10, boosted));
+
+    // And removing the session
+    m.setUclampApplied(30, boosted);
+    EXPECT_TRUE(m.remove(2));
+    EXPECT_FALSE(m.isUclampApplied(30, boosted));
+}
+
 TEST(SessionTaskMapTest, isAnyAppActive) {
     SessionTaskMap m;
     auto tNow = std::chrono::steady_clock::now();
@@ -224,6 +262,46 @@ TEST(SessionTaskMapTest, isAnyAppActive) {
     EXPECT_FALSE(m.isAnyAppSessionActive(tNow + 500ms));
 }
 
+TEST(SessionTaskMapTest, numActiveAppSessions) {
+    SessionTaskMap m;
+    auto tNow = std::chrono::steady_clock::now();
+
+    SessionValueEntry sv;
+    sv.isActive = true;
+    sv.isAppSession = true;
+    sv.votes = std::make_shared<Votes>();
+    sv.votes->add(1, CpuVote(true, tNow, 400ms, 123, 1024));
+    EXPECT_TRUE(m.add(1, sv, {10}));
+    sv.votes = std::make_shared<Votes>();
+    sv.votes->add(1, CpuVote(true, tNow, 400ms, 123, 1024));
+    EXPECT_TRUE(m.add(2, sv, {20}));
+    sv.isAppSession = false;
+    sv.votes = std::make_shared<Votes>();
+    sv.votes->add(1, CpuVote(true, tNow, 400ms, 123, 1024));
+    EXPECT_TRUE(m.add(3, sv, {30}));
+    EXPECT_EQ(0, m.numActiveAppSessions());
+
+    EXPECT_TRUE(m.updateAppSessionActive(1, tNow));
+    EXPECT_TRUE(m.updateAppSessionActive(2, tNow));
+    EXPECT_FALSE(m.updateAppSessionActive(3, tNow));
+    EXPECT_FALSE(m.updateAppSessionActive(1, tNow));
+    EXPECT_EQ(2, m.numActiveAppSessions());
+
+    // Paused session
+    m.findSession(1)->isActive = false;
+    EXPECT_TRUE(m.updateAppSessionActive(1, tNow));
+    EXPECT_EQ(1, m.numActiveAppSessions());
+
+    // Votes timed out
+    EXPECT_TRUE(m.updateAppSessionActive(2, tNow + 500ms));
+    EXPECT_EQ(0, m.numActiveAppSessions());
+    EXPECT_TRUE(m.updateAppSessionActive(2, tNow));
+
+    EXPECT_TRUE(m.remove(2));
+    EXPECT_EQ(0, m.numActiveAppSessions());
+    EXPECT_FALSE(m.updateAppSessionActive(2, tNow));
+}
+
 int getVoteMin(const SessionTaskMap &m, int64_t taskId, std::chrono::steady_clock::time_point t) {
     UclampRange range;
     std::optional<int32_t> fakeEfficiencyParam = std::nullopt;
@@ -430,6 +508,128 @@ TEST(SessionTaskMapTest, usesPowerEfficiencyValues) {
     EXPECT_EQ(range.uclampMax, baseVote.uclampMax);
 }
 
+TEST(SessionTaskMapTest, inlineSessionsPerTask) {
+    SessionTaskMap m;
+    // More sessions on one task than fit inline
+    for (int64_t sessionId = 1; sessionId <= 6; sessionId++) {
+        EXPECT_TRUE(m.add(sessionId, makeSession(1000 * sessionId), {10}));
+    }
+    EXPECT_EQ(std::vector<int64_t>({1, 2, 3, 4, 5, 6}), getSessions(10, m));
+    EXPECT_TRUE(m.remove(2));
+    EXPECT_TRUE(m.remove(5));
+    EXPECT_EQ(std::vector<int64_t>({1, 3, 4, 6}), getSessions(10, m));
+    // Freed slots are reused by new sessions without resolving old links
+    EXPECT_TRUE(m.add(7, makeSession(7000), {20}));
+    EXPECT_EQ(std::vector<int64_t>({1, 3, 4, 6}), getSessions(10, m));
+    EXPECT_EQ(std::vector<int64_t>({7}), getSessions(20, m));
+    EXPECT_EQ(5, m.sizeSessions());
+}
+
+TEST(SessionTaskMapTest, replaceKeepsSessionValue) {
+    SessionTaskMap m;
+    EXPECT_TRUE(m.add(1, makeSession(1000), {10, 20}));
+    auto session = m.findSession(1);
+    session->isPowerEfficient = true;
+    EXPECT_TRUE(m.replace(1, {20, 30}, nullptr, nullptr));
+    EXPECT_EQ(session.get(), m.findSession(1).get());
+    EXPECT_EQ(std::vector<int>({20, 30}), getTasks(1, m));
+    EXPECT_TRUE(getSessions(10, m).empty());
+}
+
+// Records the watch calls of SessionTaskMap
+struct FakeTaskWatcher : public TaskWatcher {
+    void watchTask(pid_t taskId) override { calls.push_back(taskId); }
+    void unwatchTask(pid_t taskId) override { calls.push_back(-taskId); }
+    std::vector<pid_t> takeCalls() { return std::exchange(calls, {}); }
+    std::vector<pid_t> calls;
+};
+
+TEST(SessionTaskMapTest, taskWatcherFollowsLinkedTasks) {
+    SessionTaskMap m;
+    EXPECT_TRUE(m.add(1, makeSession(1000), {10, 20}));
+    auto watcher = std::make_shared<FakeTaskWatcher>();
+    m.setTaskWatcher(watcher);
+    auto calls = watcher->takeCalls();
+    std::sort(calls.begin(), calls.end());
+    EXPECT_EQ(std::vector<pid_t>({10, 20}), calls);
+
+    // Shared tasks are watched once, until the last session is gone
+    EXPECT_TRUE(m.add(2, makeSession(2000), {20, 30}));
+    EXPECT_EQ(std::vector<pid_t>({30}), watcher->takeCalls());
+
+    // Tasks kept by the replaced session aren't re-watched
+    EXPECT_TRUE(m.replace(1, {20, 40}, nullptr, nullptr));
+    EXPECT_EQ(std::vector<pid_t>({-10, 40}), watcher->takeCalls());
+
+    EXPECT_TRUE(m.remove(1));
+    EXPECT_EQ(std::vector<pid_t>({-40}), watcher->takeCalls());
+    EXPECT_TRUE(m.remove(2));
+    EXPECT_EQ(std::vector<pid_t>({-20, -30}), watcher->takeCalls());
+}
+
+TEST(SessionTaskMapTest, removeDeadTask) {
+    SessionTaskMap m;
+    auto watcher = std::make_shared<FakeTaskWatcher>();
+    m.setTaskWatcher(watcher);
+    EXPECT_TRUE(m.add(1, makeSession(1000), {10, 20}));
+    EXPECT_TRUE(m.add(2, makeSession(2000), {20, 30}));
+    EXPECT_TRUE(m.add(3, makeSession(3000), {40}));
+    watcher->takeCalls();
+
+    auto sessionIds = m.removeDeadTask(20);
+    std::sort(sessionIds.begin(), sessionIds.end());
+    EXPECT_EQ(std::vector<int64_t>({1, 2}), sessionIds);
+    EXPECT_EQ(std::vector<pid_t>({-20}), watcher->takeCalls());
+    EXPECT_TRUE(getSessions(20, m).empty());
+    EXPECT_EQ(std::vector<int>({10}), getTasks(1, m));
+    EXPECT_EQ(std::vector<int>({30}), getTasks(2, m));
+    EXPECT_EQ(std::vector<int>({40}), getTasks(3, m));
+
+    EXPECT_TRUE(m.removeDeadTask(20).empty());
+    EXPECT_TRUE(watcher->takeCalls().empty());
+}
+
+// Not a strict performance gate, prints the cost of the per report lookups
+// for a busy device: 64 sessions with 8 threads each and a few votes.
+TEST(SessionTaskMapTest, manySessionsSharingThreads) {
+    constexpr int kSessions = 64;
+    constexpr int kThreadsPerSession = 8;
+    SessionTaskMap m;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int sessionId = 1; sessionId <= kSessions; sessionId++) {
+        std::vector<pid_t> tids;
+        for (int t = 0; t < kThreadsPerSession; t++) {
+            tids.push_back(sessionId * 100 + t);
+        }
+        // Neighbouring sessions share their first thread, like a renderer
+        tids.push_back((sessionId % kSessions + 1) * 100);
+        ASSERT_TRUE(m.add(sessionId, makeSession(sessionId), tids));
+        m.addVote(sessionId, static_cast<int>(AdpfVoteType::CPU_VOTE_DEFAULT), sessionId, 1024,
+                  t0, 1s);
+        m.addVote(sessionId, static_cast<int>(AdpfVoteType::CPU_LOAD_UP), 2 * sessionId, 1024, t0,
+                  1s);
+        m.addGpuVote(sessionId, static_cast<int>(AdpfVoteType::GPU_CAPACITY), Cycles(sessionId),
+                     t0, 1s);
+    }
+
+    std::optional<int32_t> noBase;
+    std::optional<int32_t> noOffset;
+    for (int sessionId = 1; sessionId <= kSessions; sessionId++) {
+        for (auto tid : m.getTaskIds(sessionId)) {
+            UclampRange range;
+            m.getTaskVoteRange(tid, t0 + 10ms, range, noBase, noOffset);
+            // Each thread gets at least the load up vote of its own session
+            EXPECT_GE(range.uclampMin, 2 * sessionId);
+        }
+    }
+
+    // The shared thread of session 1 is boosted by session 64 too
+    UclampRange range;
+    m.getTaskVoteRange(100, t0 + 10ms, range, noBase, noOffset);
+    EXPECT_EQ(2 * kSessions, range.uclampMin);
+    EXPECT_EQ(Cycles(kSessions), m.getSessionsGpuCapacity(t0 + 10ms));
+}
+
 }  // namespace pixel
 }  // namespace impl
 }  // namespace power
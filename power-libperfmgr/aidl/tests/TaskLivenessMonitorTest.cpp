@@ -0,0 +1,130 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "aidl/TaskLivenessMonitor.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+using std::literals::chrono_literals::operator""s;
+
+// Thread blocked until release() whose tid is known
+class TestThread {
+  public:
+    TestThread() : mThread([this]() {
+        mTid.set_value(gettid());
+        mRelease.get_future().wait();
+    }) {}
+    ~TestThread() {
+        release();
+        mThread.join();
+    }
+    pid_t tid() { return mTidFuture.get(); }
+    void release() {
+        std::call_once(mReleased, [this]() { mRelease.set_value(); });
+    }
+    void join() {
+        release();
+        mThread.join();
+        mThread = std::thread([]() {});
+    }
+
+  private:
+    std::promise<pid_t> mTid;
+    std::shared_future<pid_t> mTidFuture{mTid.get_future()};
+    std::promise<void> mRelease;
+    std::once_flag mReleased;
+    std::thread mThread;
+};
+
+class TaskLivenessMonitorTest : public ::testing::Test {
+  protected:
+    void onTaskDead(pid_t taskId) {
+        std::lock_guard lock(mMutex);
+        mDeadTasks.push_back(taskId);
+        mCv.notify_all();
+    }
+    bool waitDead(size_t count) {
+        std::unique_lock lock(mMutex);
+        return mCv.wait_for(lock, 5s, [&]() { return mDeadTasks.size() >= count; });
+    }
+    std::vector<pid_t> deadTasks() {
+        std::lock_guard lock(mMutex);
+        return mDeadTasks;
+    }
+
+    std::mutex mMutex;
+    std::condition_variable mCv;
+    std::vector<pid_t> mDeadTasks;
+};
+
+TEST_F(TaskLivenessMonitorTest, reportsExitedTask) {
+    TaskLivenessMonitor monitor([this](pid_t taskId) { onTaskDead(taskId); });
+    ASSERT_TRUE(monitor.isValid());
+    TestThread exiting;
+    TestThread running;
+    monitor.watchTask(exiting.tid());
+    monitor.watchTask(running.tid());
+    if (monitor.numWatched() == 0) {
+        GTEST_SKIP() << "Thread pidfds not supported";
+    }
+    EXPECT_EQ(2, monitor.numWatched());
+
+    exiting.join();
+    ASSERT_TRUE(waitDead(1));
+    EXPECT_EQ(std::vector<pid_t>({exiting.tid()}), deadTasks());
+    EXPECT_EQ(1, monitor.numWatched());
+}
+
+TEST_F(TaskLivenessMonitorTest, unwatchedTaskIsNotReported) {
+    TaskLivenessMonitor monitor([this](pid_t taskId) { onTaskDead(taskId); });
+    ASSERT_TRUE(monitor.isValid());
+    TestThread unwatched;
+    TestThread watched;
+    monitor.watchTask(unwatched.tid());
+    monitor.watchTask(watched.tid());
+    if (monitor.numWatched() == 0) {
+        GTEST_SKIP() << "Thread pidfds not supported";
+    }
+    monitor.unwatchTask(unwatched.tid());
+    EXPECT_EQ(1, monitor.numWatched());
+
+    unwatched.join();
+    watched.join();
+    ASSERT_TRUE(waitDead(1));
+    EXPECT_EQ(std::vector<pid_t>({watched.tid()}), deadTasks());
+    EXPECT_EQ(0, monitor.numWatched());
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -54,6 +54,20 @@ namespace aidl::google::hardware::power::impl::pixel {
                                           480,             /* UclampMin_LoadUp */
                                           480,             /* UclampMin_LoadReset */
                                           500,             /* UclampMax_EfficientBase */
-                                          200);            /* UclampMax_EfficientOffset */
+                                          200,             /* UclampMax_EfficientOffset */
+                                          false,           /* PredictiveBoost_On */
+                                          600,             /* PredictiveBoostUclampMin */
+                                          std::nullopt,    /* WorkerThreads */
+                                          std::nullopt,    /* GpuCapacityFilterUp */
+                                          std::nullopt,    /* GpuCapacityFilterDown */
+                                          std::nullopt,    /* EnergyAware_On */
+                                          std::nullopt,    /* EnergyAwareUclampStep */
+                                          std::nullopt,    /* EnergyAwareWindowFrames */
+                                          std::nullopt,    /* SessionTaskProfile */
+                                          std::nullopt,    /* SessionTaskProfileRevert */
+                                          std::nullopt,    /* SessionTaskProfileTags */
+                                          std::nullopt,    /* GpuCoBoost_On */
+                                          std::nullopt,    /* GpuCoBoostFactor */
+                                          std::nullopt);   /* GpuCoBoostFrames */
 }
 }  // namespace aidl::google::hardware::power::impl::pixel
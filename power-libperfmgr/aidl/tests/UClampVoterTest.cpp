@@ -201,6 +201,64 @@ TEST(UclampVoter, loadVoteTest) {
     EXPECT_EQ(uclampMinInit, ucr.uclampMin);
 }
 
+TEST(UclampVoter, cachedRangeFollowsVoteChanges) {
+    const auto tNow = std::chrono::steady_clock::now();
+    auto votes = std::make_shared<Votes>();
+
+    votes->add(1, CpuVote(true, tNow, 100ns, 11, 1024));
+    votes->add(2, CpuVote(true, tNow + 50ns, 100ns, 22, 900));
+
+    // Before the second vote starts, then while both apply, then after the
+    // first one expired, then once everything has expired.
+    UclampRange ucr;
+    votes->getUclampRange(ucr, tNow + 10ns);
+    EXPECT_EQ(11, ucr.uclampMin);
+    EXPECT_EQ(1024, ucr.uclampMax);
+    ucr = {};
+    votes->getUclampRange(ucr, tNow + 50ns);
+    EXPECT_EQ(22, ucr.uclampMin);
+    EXPECT_EQ(900, ucr.uclampMax);
+    ucr = {};
+    votes->getUclampRange(ucr, tNow + 101ns);
+    EXPECT_EQ(22, ucr.uclampMin);
+    EXPECT_EQ(900, ucr.uclampMax);
+    EXPECT_FALSE(votes->allTimedOut(tNow + 150ns));
+    EXPECT_TRUE(votes->allTimedOut(tNow + 151ns));
+    ucr = {};
+    votes->getUclampRange(ucr, tNow + 151ns);
+    EXPECT_EQ(kUclampMin, ucr.uclampMin);
+    EXPECT_EQ(kUclampMax, ucr.uclampMax);
+
+    // Every mutation is seen by the next query at the same time point.
+    votes->updateDuration(2, 200ns);
+    EXPECT_FALSE(votes->allTimedOut(tNow + 151ns));
+    ucr = {};
+    votes->getUclampRange(ucr, tNow + 151ns);
+    EXPECT_EQ(22, ucr.uclampMin);
+    EXPECT_TRUE(votes->setUseVote(2, false));
+    ucr = {};
+    votes->getUclampRange(ucr, tNow + 151ns);
+    EXPECT_EQ(kUclampMin, ucr.uclampMin);
+    EXPECT_TRUE(votes->setUseVote(2, true));
+    votes->add(1, CpuVote(true, tNow, 1s, 33, 800));
+    ucr = {};
+    votes->getUclampRange(ucr, tNow + 151ns);
+    EXPECT_EQ(33, ucr.uclampMin);
+    EXPECT_EQ(800, ucr.uclampMax);
+    EXPECT_TRUE(votes->remove(1));
+    ucr = {};
+    votes->getUclampRange(ucr, tNow + 151ns);
+    EXPECT_EQ(22, ucr.uclampMin);
+    EXPECT_EQ(900, ucr.uclampMax);
+
+    // The cached range still narrows whatever the caller passes in.
+    ucr.uclampMin = 300;
+    ucr.uclampMax = 500;
+    votes->getUclampRange(ucr, tNow + 151ns);
+    EXPECT_EQ(300, ucr.uclampMin);
+    EXPECT_EQ(500, ucr.uclampMax);
+}
+
 TEST(GpuCapacityVoter, testIncorrectTyping) {
     const auto now = std::chrono::steady_clock::now();
     Votes votes;
@@ -337,6 +395,23 @@ TEST(GpuCapacityVoter, testGpuVoteSum) {
 
     EXPECT_EQ(votes.size(), 2);
 }
+
+TEST(GpuCapacityVoter, testGpuCoBoostAddsUp) {
+    auto const now = std::chrono::steady_clock::now();
+
+    auto const capacity_vote_id = static_cast<int>(AdpfVoteType::GPU_CAPACITY);
+    auto const co_boost_vote_id = static_cast<int>(AdpfVoteType::GPU_CO_BOOST);
+
+    Votes votes;
+    votes.add(capacity_vote_id, GpuVote(true, now, 100ms, Cycles(321)));
+    votes.add(co_boost_vote_id, GpuVote(true, now, 50ms, Cycles(200)));
+    // Not a CPU vote
+    votes.add(co_boost_vote_id, CpuVote(true, now, 50ms, 100, 1024));
+
+    EXPECT_THAT(votes.getGpuCapacityRequest(now + 1ms), Optional(Cycles(521)));
+    EXPECT_THAT(votes.getGpuCapacityRequest(now + 51ms), Optional(Cycles(321)));
+    EXPECT_EQ(votes.size(), 2);
+}
 }  // namespace pixel
 }  // namespace impl
 }  // namespace power
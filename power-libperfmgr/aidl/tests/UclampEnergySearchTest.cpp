@@ -0,0 +1,90 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <sstream>
+
+#include "aidl/UclampEnergySearch.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+TEST(UclampEnergySearchTest, stepsDownUntilMissing) {
+    UclampEnergySearch search(100, 400, 100, 10);
+    EXPECT_EQ(400, search.cap());
+    // Half a window doesn't move the search
+    EXPECT_EQ(400, search.update(5, 0, std::nullopt));
+    EXPECT_EQ(300, search.update(5, 0, std::nullopt));
+    EXPECT_EQ(200, search.update(10, 0, std::nullopt));
+    // A miss goes back up and holds the level off
+    EXPECT_EQ(300, search.update(10, 1, std::nullopt));
+    for (uint32_t i = 1; i < UclampEnergySearch::kHoldWindows; i++) {
+        EXPECT_EQ(300, search.update(10, 0, std::nullopt));
+    }
+    EXPECT_EQ(200, search.update(10, 0, std::nullopt));
+    EXPECT_EQ(100, search.update(10, 0, std::nullopt));
+    // The floor is the lowest level
+    EXPECT_EQ(100, search.update(10, 0, std::nullopt));
+
+    search.reset();
+    EXPECT_EQ(400, search.cap());
+}
+
+TEST(UclampEnergySearchTest, stopsWhenLowerCostsMore) {
+    UclampEnergySearch search(100, 400, 100, 10);
+    EXPECT_EQ(300, search.update(10, 0, 10000));
+    // Meets the target but runs longer for more energy per frame
+    EXPECT_EQ(400, search.update(10, 0, 12000));
+    EXPECT_EQ(400, search.update(10, 0, 10000));
+    EXPECT_DOUBLE_EQ(32000.0 / 30, search.energyPerFrameUWs().value());
+}
+
+TEST(UclampEnergySearchTest, boundsTheLevels) {
+    UclampEnergySearch search(0, 1024, 1, 1);
+    std::set<int> caps{search.cap()};
+    for (size_t i = 0; i < 2 * UclampEnergySearch::kMaxLevels; i++) {
+        caps.insert(search.update(1, 0, std::nullopt));
+    }
+    EXPECT_LE(caps.size(), UclampEnergySearch::kMaxLevels);
+    EXPECT_EQ(0, *caps.begin());
+    EXPECT_EQ(1024, *caps.rbegin());
+}
+
+TEST(UclampEnergySearchTest, dump) {
+    UclampEnergySearch search(100, 400, 100, 10);
+    std::ostringstream noEnergy;
+    search.dumpToStream(noEnergy);
+    EXPECT_EQ("Energy(cap 400)", noEnergy.str());
+
+    search.update(10, 0, 12340);
+    std::ostringstream energy;
+    search.dumpToStream(energy);
+    EXPECT_EQ("Energy(1.234 mJ/frame, cap 300)", energy.str());
+    EXPECT_FALSE(UclampEnergySearch(100, 400, 100, 10).energyPerFrameUWs().has_value());
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -44,6 +44,7 @@ class MockPowerHintSession {
     MOCK_METHOD(bool, isModeSet, (android::hardware::power::SessionMode mode), (const));
     MOCK_METHOD(void, dumpToStream, (std::ostream & stream));
     MOCK_METHOD(android::hardware::power::SessionTag, getSessionTag, (), (const));
+    MOCK_METHOD(bool, isOwnedBy, (int32_t tgid, int32_t uid), (const));
 
     class MockSessionTracker {
       public:
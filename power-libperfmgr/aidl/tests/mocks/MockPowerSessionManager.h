@@ -29,6 +29,9 @@ class MockPowerSessionManager {
     MockPowerSessionManager() = default;
     ~MockPowerSessionManager() = default;
 
+    // Not mocked, sessions under test run on the real time
+    std::chrono::steady_clock::time_point now() const { return std::chrono::steady_clock::now(); }
+
     MOCK_METHOD(void, updateHintMode, (const std::string &mode, bool enabled), ());
     MOCK_METHOD(void, updateHintBoost, (const std::string &boost, int32_t durationMs), ());
     MOCK_METHOD(int, getDisplayRefreshRate, (), ());
@@ -43,7 +46,7 @@ class MockPowerSessionManager {
                 (int64_t sessionId, const std::vector<int32_t> &threadIds), ());
     MOCK_METHOD(void, pause, (int64_t sessionId), ());
     MOCK_METHOD(void, resume, (int64_t sessionId), ());
-    MOCK_METHOD(void, updateUniversalBoostMode, (), ());
+    MOCK_METHOD(void, updateUniversalBoostMode, (int64_t sessionId), ());
     MOCK_METHOD(void, dumpToFd, (int fd), ());
     MOCK_METHOD(void, updateTargetWorkDuration,
                 (int64_t sessionId, impl::pixel::AdpfVoteType voteId,
@@ -63,6 +66,7 @@ class MockPowerSessionManager {
     MOCK_METHOD(void, disableBoosts, (int64_t sessionId), ());
     MOCK_METHOD(void, setPreferPowerEfficiency, (int64_t sessionId, bool enabled), ());
     MOCK_METHOD(std::optional<impl::pixel::Frequency>, gpuFrequency, (), (const));
+    MOCK_METHOD(std::optional<uint64_t>, cpuEnergyUWs, (), (const));
 
     MOCK_METHOD(void, registerSession, (std::shared_ptr<void> session, int64_t sessionId), ());
     MOCK_METHOD(void, unregisterSession, (int64_t sessionId), ());
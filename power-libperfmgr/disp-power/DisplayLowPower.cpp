@@ -17,11 +17,20 @@
 #define LOG_TAG "powerhal-libperfmgr"
 
 #include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
+#include <android-base/file.h>
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
 #include <cutils/sockets.h>
 #include <log/log.h>
 
+#include <algorithm>
+#include <cinttypes>
+
 #include "DisplayLowPower.h"
 
 namespace aidl {
@@ -31,38 +40,144 @@ namespace power {
 namespace impl {
 namespace pixel {
 
-DisplayLowPower::DisplayLowPower() : mFossStatus(false) {}
+namespace {
+
+// Low power mode flaps during AOD transitions, only the state it settles to is sent
+constexpr char kDebounceProp[] = "vendor.powerhal.dlpw.debounce_ms";
+constexpr uint32_t kDefaultDebounceMs = 20;
+constexpr std::chrono::milliseconds kMinReconnectDelay(100);
+constexpr std::chrono::milliseconds kMaxReconnectDelay(30000);
+// Give up a state the daemon can't be sent after so many tries
+constexpr int kMaxSendAttempts = 3;
+
+}  // namespace
+
+DisplayLowPower::DisplayLowPower()
+    : mDebounce(::android::base::GetUintProperty(kDebounceProp, kDefaultDebounceMs)),
+      mReconnectDelay(0),
+      mSendAttempts(0),
+      mFossStatus(false),
+      mExit(false) {}
+
+DisplayLowPower::~DisplayLowPower() {
+    {
+        std::lock_guard<std::mutex> lk(mLock);
+        mExit = true;
+    }
+    mCond.notify_all();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
 
 void DisplayLowPower::Init() {
+    if (mThread.joinable()) {
+        return;
+    }
     ConnectPpsDaemon();
+    mThread = std::thread([this]() { Routine(); });
+    pthread_setname_np(mThread.native_handle(), "DispLowPower");
 }
 
 void DisplayLowPower::SetDisplayLowPower(bool enable) {
-    SetFoss(enable);
+    {
+        std::lock_guard<std::mutex> lk(mLock);
+        mStats.requests++;
+        if (mPending) {
+            mStats.coalesced++;
+        }
+        mPending = enable;
+        mPendingTime = Clock::now();
+    }
+    mCond.notify_all();
 }
 
-void DisplayLowPower::ConnectPpsDaemon() {
+void DisplayLowPower::Routine() {
+    std::unique_lock<std::mutex> lk(mLock);
+    while (!mExit) {
+        if (!mPending) {
+            mCond.wait(lk);
+            continue;
+        }
+        // Every newer request restarts the debounce
+        auto deadline = mPendingTime + mDebounce;
+        if (mPpsSocket.get() < 0) {
+            deadline = std::max(deadline, mNextConnect);
+        }
+        if (Clock::now() < deadline) {
+            mCond.wait_until(lk, deadline);
+            continue;
+        }
+        const bool enable = *mPending;
+        mPending.reset();
+        if (enable == mFossStatus) {
+            mStats.unchanged++;
+            mSendAttempts = 0;
+            continue;
+        }
+
+        lk.unlock();
+        const bool sent = SetFoss(enable);
+        lk.lock();
+        if (sent) {
+            mFossStatus = enable;
+            mStats.sent++;
+            mSendAttempts = 0;
+            continue;
+        }
+        mStats.failed++;
+        if (!mPending && ++mSendAttempts < kMaxSendAttempts) {
+            // Retry once reconnected, unless a newer request came
+            mPending = enable;
+            mPendingTime = Clock::now();
+        } else {
+            mSendAttempts = 0;
+        }
+    }
+}
+
+bool DisplayLowPower::ConnectPpsDaemon() {
     constexpr const char kPpsDaemon[] = "pps";
 
+    if (mPpsSocket.get() >= 0) {
+        return true;
+    }
+    const auto now = Clock::now();
+    if (now < mNextConnect) {
+        return false;
+    }
     mPpsSocket.reset(
             socket_local_client(kPpsDaemon, ANDROID_SOCKET_NAMESPACE_RESERVED, SOCK_STREAM));
     if (mPpsSocket.get() < 0) {
-        ALOGW("Connecting to PPS daemon failed (%s)", strerror(errno));
+        // Warn once per outage, not on every retry
+        if (mReconnectDelay.count() == 0) {
+            ALOGW("Connecting to PPS daemon failed (%s)", strerror(errno));
+        }
+        mReconnectDelay = std::clamp(mReconnectDelay * 2, kMinReconnectDelay, kMaxReconnectDelay);
+        mNextConnect = now + mReconnectDelay;
+        return false;
     }
+    mReconnectDelay = std::chrono::milliseconds(0);
+    std::lock_guard<std::mutex> lk(mLock);
+    mStats.connects++;
+    return true;
 }
 
 int DisplayLowPower::SendPpsCommand(const std::string_view cmd) {
-    if (TEMP_FAILURE_RETRY(write(mPpsSocket.get(), cmd.data(), cmd.size())) < 0) {
+    // The daemon may have gone away, don't let that raise SIGPIPE
+    if (TEMP_FAILURE_RETRY(send(mPpsSocket.get(), cmd.data(), cmd.size(), MSG_NOSIGNAL)) < 0) {
         ALOGE("Failed to send pps command '%s' over socket (%s)", cmd.data(), strerror(errno));
+        // Reconnect for the next command
+        mPpsSocket.reset();
         return -1;
     }
 
     return 0;
 }
 
-void DisplayLowPower::SetFoss(bool enable) {
-    if (mPpsSocket.get() < 0 || mFossStatus == enable) {
-        return;
+bool DisplayLowPower::SetFoss(bool enable) {
+    if (!ConnectPpsDaemon()) {
+        return false;
     }
 
     ALOGI("%s foss", (enable) ? "Enable" : "Disable");
@@ -74,8 +189,20 @@ void DisplayLowPower::SetFoss(bool enable) {
         foss_cmd = "foss:off";
     }
 
-    if (!SendPpsCommand(foss_cmd)) {
-        mFossStatus = enable;
+    return !SendPpsCommand(foss_cmd);
+}
+
+void DisplayLowPower::DumpToFd(int fd) {
+    std::lock_guard<std::mutex> lk(mLock);
+    std::string buf = ::android::base::StringPrintf(
+            "DisplayLowPower: foss %s, requests %" PRIu64 ", sent %" PRIu64
+            ", suppressed %" PRIu64 " (coalesced %" PRIu64 ", unchanged %" PRIu64
+            "), failed %" PRIu64 ", connects %" PRIu64 "\n",
+            mFossStatus ? "on" : "off", mStats.requests, mStats.sent,
+            mStats.coalesced + mStats.unchanged, mStats.coalesced, mStats.unchanged,
+            mStats.failed, mStats.connects);
+    if (!::android::base::WriteStringToFd(buf, fd)) {
+        ALOGE("Failed to dump DisplayLowPower to fd:%d", fd);
     }
 }
 
@@ -16,7 +16,13 @@
 
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
 #include <string_view>
+#include <thread>
 
 #include <android-base/unique_fd.h>
 
@@ -27,20 +33,54 @@ namespace power {
 namespace impl {
 namespace pixel {
 
+// Sends the display low power state to the PPS daemon from its own thread.
+// Requests go through a one slot mailbox: the latest wins once it has been
+// stable for a short debounce, and a state the daemon already has is not
+// sent again.
 class DisplayLowPower {
   public:
     DisplayLowPower();
-    ~DisplayLowPower() {}
+    ~DisplayLowPower();
     void Init();
     void SetDisplayLowPower(bool enable);
+    void DumpToFd(int fd);
 
   private:
-    void ConnectPpsDaemon();
+    using Clock = std::chrono::steady_clock;
+
+    void Routine();
+    // Connect unless connected, at most once per backoff period
+    bool ConnectPpsDaemon();
     int SendPpsCommand(const std::string_view cmd);
-    void SetFoss(bool enable);
+    bool SetFoss(bool enable);
 
+    const std::chrono::milliseconds mDebounce;
+    // Only used by Init, then by mThread
     ::android::base::unique_fd mPpsSocket;
+    std::chrono::milliseconds mReconnectDelay;
+    Clock::time_point mNextConnect;
+    int mSendAttempts;
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    // Last state the daemon accepted
     bool mFossStatus;
+    std::optional<bool> mPending;
+    Clock::time_point mPendingTime;
+    bool mExit;
+    std::thread mThread;
+
+    struct Stats {
+        uint64_t requests{0};
+        uint64_t sent{0};
+        // Replaced in the mailbox before being sent
+        uint64_t coalesced{0};
+        // Equal to the state the daemon already had
+        uint64_t unchanged{0};
+        uint64_t failed{0};
+        uint64_t connects{0};
+    };
+    Stats mStats;
 };
 
 }  // namespace pixel
@@ -19,17 +19,22 @@
 
 #include "InteractionHandler.h"
 
+#include <android-base/file.h>
 #include <android-base/properties.h>
+#include <android-base/stringprintf.h>
 #include <fcntl.h>
 #include <perfmgr/HintManager.h>
-#include <poll.h>
+#include <sys/epoll.h>
 #include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <time.h>
 #include <unistd.h>
 #include <utils/Log.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <array>
+#include <cinttypes>
 #include <memory>
 
 #define MAX_LENGTH 64
@@ -59,6 +64,12 @@ static const uint32_t kMaxDurationMs =
         ::android::base::GetUintProperty("vendor.powerhal.interaction.max", /*default*/ 5650U);
 static const uint32_t kDurationOffsetMs =
         ::android::base::GetUintProperty("vendor.powerhal.interaction.offset", /*default*/ 650U);
+// Extend the running boost on a new interaction instead of restarting the wait
+static const bool kMergeInteraction =
+        ::android::base::GetBoolProperty("vendor.powerhal.interaction.merge", false);
+// Keep boost length statistics for DumpToFd
+static const bool kInteractionStats =
+        ::android::base::GetBoolProperty("vendor.powerhal.interaction.stats", false);
 
 static size_t CalcTimespecDiffMs(struct timespec start, struct timespec end) {
     size_t diff_in_ms = 0;
@@ -67,6 +78,20 @@ static size_t CalcTimespecDiffMs(struct timespec start, struct timespec end) {
     return diff_in_ms;
 }
 
+static struct timespec AddMs(struct timespec ts, int64_t ms) {
+    ts.tv_sec += ms / MSINSEC;
+    ts.tv_nsec += (ms % MSINSEC) * NSINMS;
+    if (ts.tv_nsec >= MSINSEC * NSINMS) {
+        ts.tv_sec++;
+        ts.tv_nsec -= MSINSEC * NSINMS;
+    }
+    return ts;
+}
+
+static bool IsBefore(const struct timespec &a, const struct timespec &b) {
+    return a.tv_sec < b.tv_sec || (a.tv_sec == b.tv_sec && a.tv_nsec < b.tv_nsec);
+}
+
 static int FbIdleOpen(void) {
     int fd;
     for (const auto &path : kDispIdlePath) {
@@ -83,7 +108,10 @@ static int FbIdleOpen(void) {
 using ::android::perfmgr::HintManager;
 
 InteractionHandler::InteractionHandler()
-    : mState(INTERACTION_STATE_UNINITIALIZED), mDurationMs(0) {}
+    : mState(INTERACTION_STATE_UNINITIALIZED),
+      mDurationMs(0),
+      mWaitActive(false),
+      mTimerOnDeadline(false) {}
 
 InteractionHandler::~InteractionHandler() {
     Exit();
@@ -107,6 +135,30 @@ bool InteractionHandler::Init() {
         return false;
     }
 
+    mTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    // sysfs_notify() of the idle state wakes POLLPRI pollers, edge triggered
+    // so each notification is seen once without rereading the file
+    struct epoll_event events[] = {
+            {.events = EPOLLIN, .data = {.fd = mEventFd}},
+            {.events = EPOLLIN, .data = {.fd = mTimerFd}},
+            {.events = EPOLLPRI | EPOLLERR | EPOLLET, .data = {.fd = mIdleFd}},
+    };
+    bool epollReady = mTimerFd >= 0 && mEpollFd >= 0;
+    for (auto &event : events) {
+        epollReady = epollReady && epoll_ctl(mEpollFd, EPOLL_CTL_ADD, event.data.fd, &event) == 0;
+    }
+    if (!epollReady) {
+        ALOGE("Unable to set up idle wait epoll (%d)", errno);
+        if (mTimerFd >= 0)
+            close(mTimerFd);
+        if (mEpollFd >= 0)
+            close(mEpollFd);
+        close(mEventFd);
+        close(mIdleFd);
+        return false;
+    }
+
     mState = INTERACTION_STATE_IDLE;
     mThread = std::unique_ptr<std::thread>(new std::thread(&InteractionHandler::Routine, this));
 
@@ -125,12 +177,17 @@ void InteractionHandler::Exit() {
     mCond.notify_all();
     mThread->join();
 
+    close(mEpollFd);
+    close(mTimerFd);
     close(mEventFd);
     close(mIdleFd);
 }
 
 void InteractionHandler::PerfLock() {
     ALOGV("%s: acquiring perf lock", __func__);
+    if (kInteractionStats) {
+        clock_gettime(CLOCK_MONOTONIC, &mBoostTimespec);
+    }
     if (!HintManager::GetInstance()->DoHint("INTERACTION")) {
         ALOGE("%s: do hint INTERACTION failed", __func__);
     }
@@ -182,21 +239,45 @@ void InteractionHandler::Acquire(int32_t duration) {
 
     ALOGV("%s: input: %d final duration: %d", __func__, duration, finalDuration);
 
-    if (mState == INTERACTION_STATE_WAITING)
+    if (mState == INTERACTION_STATE_WAITING && kMergeInteraction && mWaitActive) {
+        // The boost keeps going until idle or the new deadline
+        if (mTimerOnDeadline)
+            ArmTimer(DeadlineLocked());
+        mStats.merged++;
+        return;
+    }
+
+    if (mState == INTERACTION_STATE_WAITING) {
         AbortWaitLocked();
-    else if (mState == INTERACTION_STATE_IDLE)
+        mStats.restarted++;
+    } else if (mState == INTERACTION_STATE_IDLE) {
         PerfLock();
+    }
 
     mState = INTERACTION_STATE_INTERACTION;
     mCond.notify_one();
 }
 
-void InteractionHandler::Release() {
+void InteractionHandler::Release(enum WaitResult result) {
     std::lock_guard<std::mutex> lk(mLock);
     if (mState == INTERACTION_STATE_WAITING) {
         ATRACE_CALL();
         PerfRel();
         mState = INTERACTION_STATE_IDLE;
+        if (kInteractionStats) {
+            struct timespec cur_timespec;
+            clock_gettime(CLOCK_MONOTONIC, &cur_timespec);
+            const size_t boost_ms = CalcTimespecDiffMs(mBoostTimespec, cur_timespec);
+            mStats.boosts++;
+            mStats.boostMs += boost_ms;
+            mStats.requestedMs += CalcTimespecDiffMs(mBoostTimespec, DeadlineLocked());
+            if (result == WAIT_RESULT_IDLE) {
+                mStats.idleEnded++;
+                mStats.untilIdleMs += boost_ms;
+            } else if (result == WAIT_RESULT_TIMED_OUT) {
+                mStats.timedOut++;
+            }
+        }
     } else {
         // clear any wait aborts pending in event fd
         uint64_t val;
@@ -214,49 +295,121 @@ void InteractionHandler::AbortWaitLocked() {
         ALOGW("Unable to write to event fd (%zd)", ret);
 }
 
-void InteractionHandler::WaitForIdle(int32_t wait_ms, int32_t timeout_ms) {
+struct timespec InteractionHandler::DeadlineLocked() const {
+    return AddMs(mLastTimespec, kWaitMs + mDurationMs);
+}
+
+void InteractionHandler::ArmTimer(const struct timespec &deadline) {
+    struct itimerspec spec = {};
+    spec.it_value = deadline;
+    if (timerfd_settime(mTimerFd, TFD_TIMER_ABSTIME, &spec, nullptr) < 0)
+        ALOGE("%s: failed to arm timer (%d)", __func__, errno);
+}
+
+enum WaitResult InteractionHandler::WaitForIdle(int32_t wait_ms) {
     char data[MAX_LENGTH];
     ssize_t ret;
-    struct pollfd pfd[2];
+    struct epoll_event events[3];
+    struct timespec cur_timespec;
+    struct timespec check_timespec;
 
     ATRACE_CALL();
 
-    ALOGV("%s: wait:%d timeout:%d", __func__, wait_ms, timeout_ms);
+    ALOGV("%s: wait:%d", __func__, wait_ms);
 
-    pfd[0].fd = mEventFd;
-    pfd[0].events = POLLIN;
-    pfd[1].fd = mIdleFd;
-    pfd[1].events = POLLPRI | POLLERR;
+    auto finish = [this](enum WaitResult result) {
+        std::lock_guard<std::mutex> lk(mLock);
+        mTimerOnDeadline = false;
+        mWaitActive = false;
+        ArmTimer({});
+        return result;
+    };
 
-    ret = poll(pfd, 1, wait_ms);
-    if (ret > 0) {
-        ALOGV("%s: wait aborted", __func__);
-        return;
-    } else if (ret < 0) {
-        ALOGE("%s: error in poll while waiting", __func__);
-        return;
+    // Let the display leave idle before looking at it
+    clock_gettime(CLOCK_MONOTONIC, &cur_timespec);
+    ArmTimer(AddMs(cur_timespec, wait_ms));
+    bool waited = false;
+    while (!waited) {
+        int n = TEMP_FAILURE_RETRY(epoll_wait(mEpollFd, events, 3, -1));
+        if (n < 0) {
+            ALOGE("%s: error in epoll while waiting", __func__);
+            return finish(WAIT_RESULT_ERROR);
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == mEventFd) {
+                ALOGV("%s: wait aborted", __func__);
+                return finish(WAIT_RESULT_ABORTED);
+            }
+            waited = waited || events[i].data.fd == mTimerFd;
+        }
     }
 
-    ret = pread(mIdleFd, data, sizeof(data), 0);
-    if (!ret) {
-        ALOGE("%s: Unexpected EOF!", __func__);
-        return;
+    {
+        std::lock_guard<std::mutex> lk(mLock);
+        ArmTimer(DeadlineLocked());
+        mTimerOnDeadline = true;
     }
+    enum WaitResult result = WAIT_RESULT_ERROR;
+    bool check_idle = true;
+    while (true) {
+        if (check_idle) {
+            clock_gettime(CLOCK_MONOTONIC, &check_timespec);
+            ret = pread(mIdleFd, data, sizeof(data), 0);
+            if (ret <= 0) {
+                ALOGE("%s: Unexpected EOF!", __func__);
+                break;
+            }
+            if (!strncmp(data, "idle", 4)) {
+                std::lock_guard<std::mutex> lk(mLock);
+                // An interaction merged after the read keeps the boost going
+                if (!IsBefore(check_timespec, mLastTimespec)) {
+                    ALOGV("%s: idle detected", __func__);
+                    mWaitActive = false;
+                    result = WAIT_RESULT_IDLE;
+                    break;
+                }
+            }
+            check_idle = false;
+        }
 
-    if (!strncmp(data, "idle", 4)) {
-        ALOGV("%s: already idle", __func__);
-        return;
+        int n = TEMP_FAILURE_RETRY(epoll_wait(mEpollFd, events, 3, -1));
+        if (n < 0) {
+            ALOGE("%s: Error on waiting for idle (%d)", __func__, errno);
+            break;
+        }
+        bool timer_fired = false;
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == mEventFd) {
+                result = WAIT_RESULT_ABORTED;
+            } else if (events[i].data.fd == mTimerFd) {
+                timer_fired = true;
+            } else {
+                check_idle = true;
+            }
+        }
+        if (result == WAIT_RESULT_ABORTED) {
+            ALOGV("%s: wait for idle aborted", __func__);
+            break;
+        }
+        if (timer_fired) {
+            uint64_t expirations;
+            ret = read(mTimerFd, &expirations, sizeof(expirations));
+            ALOGW_IF(ret < 0 && errno != EAGAIN, "%s: failed to clear timerfd (%d)", __func__,
+                     errno);
+            std::lock_guard<std::mutex> lk(mLock);
+            clock_gettime(CLOCK_MONOTONIC, &cur_timespec);
+            // A merged interaction moved the deadline after the timer fired
+            if (!IsBefore(cur_timespec, DeadlineLocked())) {
+                ALOGV("%s: timed out waiting for idle", __func__);
+                // Stop merging before an Acquire can join the ending wait
+                mWaitActive = false;
+                result = WAIT_RESULT_TIMED_OUT;
+                break;
+            }
+        }
     }
 
-    ret = poll(pfd, 2, timeout_ms);
-    if (ret < 0)
-        ALOGE("%s: Error on waiting for idle (%zd)", __func__, ret);
-    else if (ret == 0)
-        ALOGV("%s: timed out waiting for idle", __func__);
-    else if (pfd[0].revents)
-        ALOGV("%s: wait for idle aborted", __func__);
-    else if (pfd[1].revents)
-        ALOGV("%s: idle detected", __func__);
+    return finish(result);
 }
 
 void InteractionHandler::Routine() {
@@ -269,10 +422,28 @@ void InteractionHandler::Routine() {
         if (mState == INTERACTION_STATE_UNINITIALIZED)
             return;
         mState = INTERACTION_STATE_WAITING;
+        mWaitActive = true;
         lk.unlock();
 
-        WaitForIdle(kWaitMs, mDurationMs);
-        Release();
+        Release(WaitForIdle(kWaitMs));
+    }
+}
+
+void InteractionHandler::DumpToFd(int fd) {
+    std::lock_guard<std::mutex> lk(mLock);
+    std::string buf = ::android::base::StringPrintf(
+            "InteractionHandler: merge %s, restarted %" PRIu64 ", merged %" PRIu64 "\n",
+            kMergeInteraction ? "on" : "off", mStats.restarted, mStats.merged);
+    if (kInteractionStats && mStats.boosts > 0) {
+        const uint64_t idle = std::max<uint64_t>(mStats.idleEnded, 1);
+        buf += ::android::base::StringPrintf(
+                "  boosts %" PRIu64 " (idle %" PRIu64 ", timed out %" PRIu64 "), avg boost %" PRIu64
+                "ms of %" PRIu64 "ms requested, avg until idle %" PRIu64 "ms\n",
+                mStats.boosts, mStats.idleEnded, mStats.timedOut, mStats.boostMs / mStats.boosts,
+                mStats.requestedMs / mStats.boosts, mStats.untilIdleMs / idle);
+    }
+    if (!::android::base::WriteStringToFd(buf, fd)) {
+        ALOGE("Failed to dump InteractionHandler to fd:%d", fd);
     }
 }
 
@@ -36,6 +36,13 @@ enum InteractionState {
     INTERACTION_STATE_WAITING,
 };
 
+enum WaitResult {
+    WAIT_RESULT_ABORTED,
+    WAIT_RESULT_IDLE,
+    WAIT_RESULT_TIMED_OUT,
+    WAIT_RESULT_ERROR,
+};
+
 class InteractionHandler {
   public:
     InteractionHandler();
@@ -43,11 +50,16 @@ class InteractionHandler {
     bool Init();
     void Exit();
     void Acquire(int32_t duration);
+    void DumpToFd(int fd);
 
   private:
-    void Release();
-    void WaitForIdle(int32_t wait_ms, int32_t timeout_ms);
+    void Release(enum WaitResult result);
+    enum WaitResult WaitForIdle(int32_t wait_ms);
     void AbortWaitLocked();
+    // End of the current interaction: its start, the idle wait and its
+    // duration.
+    struct timespec DeadlineLocked() const;
+    void ArmTimer(const struct timespec &deadline);
     void Routine();
 
     void PerfLock();
@@ -56,11 +68,32 @@ class InteractionHandler {
     enum InteractionState mState;
     int mIdleFd;
     int mEventFd;
+    int mTimerFd;
+    int mEpollFd;
     int32_t mDurationMs;
     struct timespec mLastTimespec;
+    // From Routine starting a wait until WaitForIdle decides idle or timeout,
+    // Acquire can merge into the wait while set.
+    bool mWaitActive;
+    // Set once mTimerFd is armed to DeadlineLocked() for the idle wait.
+    bool mTimerOnDeadline;
     std::unique_ptr<std::thread> mThread;
     std::mutex mLock;
     std::condition_variable mCond;
+
+    // Boost lengths, only kept in the instrumented mode
+    struct BoostStats {
+        uint64_t boosts{0};
+        uint64_t idleEnded{0};
+        uint64_t timedOut{0};
+        uint64_t restarted{0};
+        uint64_t merged{0};
+        uint64_t boostMs{0};
+        uint64_t requestedMs{0};
+        uint64_t untilIdleMs{0};
+    };
+    struct timespec mBoostTimespec;
+    BoostStats mStats;
 };
 
 }  // namespace pixel
@@ -64,6 +64,12 @@ void AdpfConfig::dumpToFd(int fd) {
     dump_buf << "GpuBoostOn: " << mGpuBoostOn.value_or(false) << "\n";
     dump_buf << "GpuBoostCapacityMax: " << mGpuBoostCapacityMax.value_or(0) << "\n";
     dump_buf << "mGpuCapacityLoadUpHeadroom: " << mGpuCapacityLoadUpHeadroom << "\n";
+    if (mGpuCapacityFilterUp.has_value()) {
+        dump_buf << "GpuCapacityFilterUp: " << mGpuCapacityFilterUp.value() << "\n";
+    }
+    if (mGpuCapacityFilterDown.has_value()) {
+        dump_buf << "GpuCapacityFilterDown: " << mGpuCapacityFilterDown.value() << "\n";
+    }
     if (mHeuristicBoostOn.has_value()) {
         dump_buf << "HeuristicBoost_On: " << mHeuristicBoostOn.value() << "\n";
         dump_buf << "HBoostOnMissedCycles: " << mHBoostOnMissedCycles.value() << "\n";
@@ -79,6 +85,28 @@ void AdpfConfig::dumpToFd(int fd) {
         dump_buf << "UclampMax_EfficientBase: " << *mUclampMaxEfficientBase << "\n";
         dump_buf << "UclampMax_EfficientOffset: " << *mUclampMaxEfficientOffset << "\n";
     }
+    if (mPredictiveBoostOn.has_value()) {
+        dump_buf << "PredictiveBoost_On: " << mPredictiveBoostOn.value() << "\n";
+        dump_buf << "PredictiveBoostUclampMin: " << mPredictiveBoostUclampMin.value() << "\n";
+    }
+    if (mWorkerThreads.has_value()) {
+        dump_buf << "WorkerThreads: " << mWorkerThreads.value() << "\n";
+    }
+    if (mEnergyAwareOn.has_value()) {
+        dump_buf << "EnergyAware_On: " << mEnergyAwareOn.value() << "\n";
+        dump_buf << "EnergyAwareUclampStep: " << mEnergyAwareUclampStep.value() << "\n";
+        dump_buf << "EnergyAwareWindowFrames: " << mEnergyAwareWindowFrames.value() << "\n";
+    }
+    if (mSessionTaskProfile.has_value()) {
+        dump_buf << "SessionTaskProfile: " << mSessionTaskProfile.value() << "\n";
+        dump_buf << "SessionTaskProfileRevert: " << mSessionTaskProfileRevert.value() << "\n";
+        dump_buf << "SessionTaskProfileTags: " << mSessionTaskProfileTags.value_or("all") << "\n";
+    }
+    if (mGpuCoBoostOn.has_value()) {
+        dump_buf << "GpuCoBoost_On: " << mGpuCoBoostOn.value() << "\n";
+        dump_buf << "GpuCoBoostFactor: " << mGpuCoBoostFactor.value() << "\n";
+        dump_buf << "GpuCoBoostFrames: " << mGpuCoBoostFrames.value() << "\n";
+    }
     if (!android::base::WriteStringToFd(dump_buf.str(), fd)) {
         LOG(ERROR) << "Failed to dump ADPF profile to fd: " << fd;
     }
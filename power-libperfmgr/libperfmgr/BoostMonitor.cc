@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specic language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG (ATRACE_TAG_POWER | ATRACE_TAG_HAL)
+#define LOG_TAG "libperfmgr"
+
+#include "perfmgr/BoostMonitor.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <android-base/strings.h>
+#include <pthread.h>
+#include <utils/Trace.h>
+
+#include <optional>
+
+#include "perfmgr/HintManager.h"
+
+namespace android {
+namespace perfmgr {
+
+namespace {
+constexpr std::string_view kMinFreqNode("/scaling_min_freq");
+
+std::optional<uint64_t> ReadKhz(const std::string &path) {
+    std::string buf;
+    uint64_t khz;
+    if (!android::base::ReadFileToString(path, &buf) ||
+        !android::base::ParseUint(android::base::Trim(buf), &khz)) {
+        return std::nullopt;
+    }
+    return khz;
+}
+}  // namespace
+
+std::unordered_map<std::string, std::vector<BoostMonitor::Target>> BoostMonitor::FindTargets(
+        const std::unordered_map<std::string, Hint> &actions,
+        const std::vector<std::unique_ptr<Node>> &nodes) {
+    std::unordered_map<std::string, std::vector<Target>> targets;
+    for (const auto &[hint_type, hint] : actions) {
+        for (const auto &action : hint.node_actions) {
+            const Node &node = *nodes[action.node_index];
+            const std::string &path = node.GetPath();
+            uint64_t min_khz;
+            if (!android::base::EndsWith(path, kMinFreqNode) ||
+                !android::base::ParseUint(node.GetValues()[action.value_index], &min_khz)) {
+                continue;
+            }
+            targets[hint_type].push_back({path.substr(0, path.size() - kMinFreqNode.size()),
+                                          min_khz, action.enable_cache});
+        }
+    }
+    return targets;
+}
+
+BoostMonitor::BoostMonitor(std::chrono::milliseconds interval, std::vector<MonitoredHint> hints)
+    : interval_(interval), hints_(std::move(hints)) {
+    thread_ = std::thread([this] {
+        pthread_setname_np(pthread_self(), "perfmgr_boost");
+        ThreadLoop();
+    });
+}
+
+BoostMonitor::~BoostMonitor() {
+    Stop();
+}
+
+void BoostMonitor::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void BoostMonitor::Wake() {
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        woken_ = true;
+    }
+    cv_.notify_one();
+}
+
+bool BoostMonitor::Sample() {
+    ATRACE_CALL();
+    const HintStatus::Ticks now_ticks = std::chrono::steady_clock::now().time_since_epoch().count();
+    // scaling_cur_freq and scaling_max_freq of each cluster read so far,
+    // nullopt if they couldn't be read
+    std::unordered_map<std::string, std::optional<std::pair<uint64_t, uint64_t>>> freqs;
+    bool active = false;
+
+    for (const auto &hint : hints_) {
+        HintStatus &status = *hint.status;
+        if (now_ticks < status.start_time.load(std::memory_order_relaxed) ||
+            now_ticks > status.end_time.load(std::memory_order_acquire)) {
+            continue;
+        }
+        active = true;
+        for (const auto &target : hint.targets) {
+            if (target.enable_cache != nullptr && !target.enable_cache->Get(true)) {
+                continue;
+            }
+            auto it = freqs.find(target.policy_dir);
+            if (it == freqs.end()) {
+                const auto cur_khz = ReadKhz(target.policy_dir + "/scaling_cur_freq");
+                const auto max_khz = ReadKhz(target.policy_dir + "/scaling_max_freq");
+                std::optional<std::pair<uint64_t, uint64_t>> freq;
+                if (cur_khz.has_value() && max_khz.has_value()) {
+                    freq.emplace(*cur_khz, *max_khz);
+                } else {
+                    LOG(VERBOSE) << "Failed to read frequencies of " << target.policy_dir;
+                }
+                it = freqs.emplace(target.policy_dir, freq).first;
+            }
+            if (!it->second.has_value()) {
+                continue;
+            }
+            const auto [cur_khz, max_khz] = *it->second;
+            status.boost.samples.fetch_add(1, std::memory_order_relaxed);
+            if (cur_khz >= target.min_khz) {
+                status.boost.effective.fetch_add(1, std::memory_order_relaxed);
+            } else if (max_khz < target.min_khz) {
+                status.boost.clipped.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                status.boost.below.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+    return active;
+}
+
+void BoostMonitor::ThreadLoop() {
+    std::unique_lock<std::mutex> lock(lock_);
+    while (!stop_) {
+        cv_.wait(lock, [this] { return stop_ || woken_; });
+        // Sample until no hint is active and no DoHint came in meanwhile
+        while (!stop_ && woken_) {
+            woken_ = false;
+            lock.unlock();
+            bool active = Sample();
+            lock.lock();
+            while (active && !stop_) {
+                cv_.wait_for(lock, interval_, [this] { return stop_; });
+                if (stop_) {
+                    break;
+                }
+                lock.unlock();
+                active = Sample();
+                lock.lock();
+            }
+        }
+    }
+}
+
+}  // namespace perfmgr
+}  // namespace android
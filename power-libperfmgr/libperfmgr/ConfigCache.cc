@@ -0,0 +1,464 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specic language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define LOG_TAG "libperfmgr"
+
+#include "perfmgr/ConfigCache.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/unique_fd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+#include "perfmgr/FileNode.h"
+#include "perfmgr/PropertyNode.h"
+
+namespace android {
+namespace perfmgr {
+
+namespace {
+
+constexpr char kMagic[8] = "PMGRCFG";
+constexpr uint8_t kFileNodeType = 0;
+constexpr uint8_t kPropertyNodeType = 1;
+
+class Writer {
+  public:
+    template <typename T>
+    std::enable_if_t<std::is_arithmetic_v<T>> operator()(const T &value) {
+        buf_.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+    void operator()(const std::string &value) {
+        (*this)(static_cast<uint32_t>(value.size()));
+        buf_.append(value);
+    }
+    template <typename T>
+    void operator()(const std::optional<T> &value) {
+        (*this)(static_cast<uint8_t>(value.has_value()));
+        if (value.has_value()) {
+            (*this)(*value);
+        }
+    }
+    std::string &buf() { return buf_; }
+
+  private:
+    std::string buf_;
+};
+
+class Reader {
+  public:
+    Reader(const char *data, std::size_t size) : p_(data), end_(data + size) {}
+
+    template <typename T>
+    std::enable_if_t<std::is_arithmetic_v<T>> operator()(T *value) {
+        if (!Check(sizeof(T))) {
+            return;
+        }
+        std::memcpy(value, p_, sizeof(T));
+        p_ += sizeof(T);
+    }
+    void operator()(bool *value) {
+        uint8_t v = 0;
+        (*this)(&v);
+        *value = v != 0;
+    }
+    void operator()(std::string *value) {
+        uint32_t size = 0;
+        (*this)(&size);
+        if (!Check(size)) {
+            return;
+        }
+        value->assign(p_, size);
+        p_ += size;
+    }
+    template <typename T>
+    void operator()(std::optional<T> *value) {
+        bool has_value = false;
+        (*this)(&has_value);
+        if (has_value) {
+            T v{};
+            (*this)(&v);
+            *value = v;
+        } else {
+            value->reset();
+        }
+    }
+    // Read an element count, bounded by the remaining bytes so that a corrupted
+    // count can't trigger a huge allocation.
+    uint32_t Count() {
+        uint32_t count = 0;
+        (*this)(&count);
+        if (count > static_cast<std::size_t>(end_ - p_)) {
+            ok_ = false;
+            return 0;
+        }
+        return count;
+    }
+    bool ok() const { return ok_; }
+    bool AtEnd() const { return p_ == end_; }
+
+  private:
+    bool Check(std::size_t size) {
+        if (!ok_ || size > static_cast<std::size_t>(end_ - p_)) {
+            ok_ = false;
+            return false;
+        }
+        return true;
+    }
+
+    const char *p_;
+    const char *end_;
+    bool ok_ = true;
+};
+
+// Single list of AdpfConfig fields shared by Serialize and Deserialize.
+template <typename Config, typename Visitor>
+void VisitAdpfConfig(Config *c, Visitor &&visit) {
+    visit(&c->mName);
+    visit(&c->mPidOn);
+    visit(&c->mPidPo);
+    visit(&c->mPidPu);
+    visit(&c->mPidI);
+    visit(&c->mPidIInit);
+    visit(&c->mPidIHigh);
+    visit(&c->mPidILow);
+    visit(&c->mPidDo);
+    visit(&c->mPidDu);
+    visit(&c->mUclampMinOn);
+    visit(&c->mUclampMinInit);
+    visit(&c->mUclampMinHigh);
+    visit(&c->mUclampMinLow);
+    visit(&c->mSamplingWindowP);
+    visit(&c->mSamplingWindowI);
+    visit(&c->mSamplingWindowD);
+    visit(&c->mReportingRateLimitNs);
+    visit(&c->mTargetTimeFactor);
+    visit(&c->mStaleTimeFactor);
+    visit(&c->mGpuBoostOn);
+    visit(&c->mGpuBoostCapacityMax);
+    visit(&c->mGpuCapacityLoadUpHeadroom);
+    visit(&c->mHeuristicBoostOn);
+    visit(&c->mHBoostOnMissedCycles);
+    visit(&c->mHBoostOffMaxAvgRatio);
+    visit(&c->mHBoostOffMissedCycles);
+    visit(&c->mHBoostPidPuFactor);
+    visit(&c->mHBoostUclampMin);
+    visit(&c->mJankCheckTimeFactor);
+    visit(&c->mLowFrameRateThreshold);
+    visit(&c->mMaxRecordsNum);
+    visit(&c->mUclampMinLoadUp);
+    visit(&c->mUclampMinLoadReset);
+    visit(&c->mUclampMaxEfficientBase);
+    visit(&c->mUclampMaxEfficientOffset);
+    visit(&c->mPredictiveBoostOn);
+    visit(&c->mPredictiveBoostUclampMin);
+    visit(&c->mWorkerThreads);
+    visit(&c->mGpuCapacityFilterUp);
+    visit(&c->mGpuCapacityFilterDown);
+    visit(&c->mEnergyAwareOn);
+    visit(&c->mEnergyAwareUclampStep);
+    visit(&c->mEnergyAwareWindowFrames);
+    visit(&c->mSessionTaskProfile);
+    visit(&c->mSessionTaskProfileRevert);
+    visit(&c->mSessionTaskProfileTags);
+    visit(&c->mGpuCoBoostOn);
+    visit(&c->mGpuCoBoostFactor);
+    visit(&c->mGpuCoBoostFrames);
+}
+
+std::string SerializePayload(const PowerConfig &config) {
+    Writer w;
+    w(config.gpu_sysfs_config_path);
+
+    w(static_cast<uint32_t>(config.nodes.size()));
+    for (const auto &node : config.nodes) {
+        const bool is_file = std::strcmp(node->GetType(), "File") == 0;
+        w(is_file ? kFileNodeType : kPropertyNodeType);
+        w(node->GetName());
+        w(node->GetPath());
+        const std::vector<std::string> values = node->GetValues();
+        w(static_cast<uint32_t>(values.size()));
+        for (const auto &value : values) {
+            w(value);
+        }
+        w(static_cast<uint64_t>(node->GetDefaultIndex()));
+        w(static_cast<uint8_t>(node->GetResetOnInit()));
+        w(node->GetDependsOn());
+        w(node->GetWriteLane());
+        if (is_file) {
+            const FileNode *file_node = static_cast<const FileNode *>(node.get());
+            w(static_cast<uint8_t>(file_node->GetTruncate()));
+            w(static_cast<uint8_t>(file_node->GetHoldFd()));
+            w(static_cast<uint8_t>(file_node->GetWriteOnly()));
+            w(static_cast<uint8_t>(file_node->GetCacheFd()));
+        }
+    }
+
+    w(static_cast<uint32_t>(config.actions.size()));
+    for (const auto &[hint_type, hint] : config.actions) {
+        w(hint_type);
+        w(static_cast<uint32_t>(hint.node_actions.size()));
+        for (const auto &action : hint.node_actions) {
+            w(static_cast<uint64_t>(action.node_index));
+            w(static_cast<uint64_t>(action.value_index));
+            w(static_cast<int64_t>(action.timeout_ms.count()));
+            w(action.enable_property);
+            w(static_cast<uint32_t>(action.thermal_value_index.size()));
+            for (const std::size_t index : action.thermal_value_index) {
+                w(static_cast<uint64_t>(index));
+            }
+        }
+        w(static_cast<uint32_t>(hint.hint_actions.size()));
+        for (const auto &action : hint.hint_actions) {
+            w(static_cast<uint8_t>(action.type));
+            w(action.value);
+            w(action.enable_property);
+        }
+    }
+
+    w(static_cast<uint32_t>(config.adpfs.size()));
+    for (const auto &adpf : config.adpfs) {
+        VisitAdpfConfig(adpf.get(), [&w](const auto *field) { w(*field); });
+    }
+    return std::move(w.buf());
+}
+
+bool DeserializePayload(Reader *r, PowerConfig *config) {
+    (*r)(&config->gpu_sysfs_config_path);
+
+    const uint32_t node_count = r->Count();
+    for (uint32_t i = 0; i < node_count && r->ok(); ++i) {
+        uint8_t type = 0;
+        std::string name, path, depends_on, write_lane;
+        uint64_t default_index = 0;
+        bool reset = false;
+        (*r)(&type);
+        (*r)(&name);
+        (*r)(&path);
+        std::vector<RequestGroup> values;
+        const uint32_t value_count = r->Count();
+        for (uint32_t j = 0; j < value_count && r->ok(); ++j) {
+            std::string value;
+            (*r)(&value);
+            values.emplace_back(value);
+        }
+        (*r)(&default_index);
+        (*r)(&reset);
+        (*r)(&depends_on);
+        (*r)(&write_lane);
+        if (!r->ok() || values.empty() || default_index >= values.size()) {
+            LOG(ERROR) << "Invalid Node[" << i << "] in config cache";
+            return false;
+        }
+        if (type == kFileNodeType) {
+            bool truncate = false, hold_fd = false, write_only = false, cache_fd = false;
+            (*r)(&truncate);
+            (*r)(&hold_fd);
+            (*r)(&write_only);
+            (*r)(&cache_fd);
+            config->nodes.emplace_back(std::make_unique<FileNode>(
+                    name, path, values, static_cast<std::size_t>(default_index), reset, truncate,
+                    hold_fd, write_only, cache_fd));
+        } else if (type == kPropertyNodeType) {
+            config->nodes.emplace_back(std::make_unique<PropertyNode>(
+                    name, path, values, static_cast<std::size_t>(default_index), reset));
+        } else {
+            LOG(ERROR) << "Invalid Node[" << i << "]'s Type in config cache";
+            return false;
+        }
+        config->nodes.back()->SetDependsOn(depends_on);
+        config->nodes.back()->SetWriteLane(write_lane);
+    }
+
+    const uint32_t hint_count = r->Count();
+    for (uint32_t i = 0; i < hint_count && r->ok(); ++i) {
+        std::string hint_type;
+        (*r)(&hint_type);
+        Hint &hint = config->actions[hint_type];
+        const uint32_t node_action_count = r->Count();
+        for (uint32_t j = 0; j < node_action_count && r->ok(); ++j) {
+            uint64_t node_index = 0, value_index = 0;
+            int64_t timeout_ms = 0;
+            std::string enable_property;
+            (*r)(&node_index);
+            (*r)(&value_index);
+            (*r)(&timeout_ms);
+            (*r)(&enable_property);
+            if (!r->ok() || node_index >= config->nodes.size() ||
+                value_index >= config->nodes[node_index]->GetValues().size()) {
+                LOG(ERROR) << "Invalid node action of " << hint_type << " in config cache";
+                return false;
+            }
+            std::vector<std::size_t> thermal_value_index(r->Count());
+            for (auto &index : thermal_value_index) {
+                uint64_t thermal_index = 0;
+                (*r)(&thermal_index);
+                if (!r->ok() || thermal_index >= config->nodes[node_index]->GetValues().size()) {
+                    LOG(ERROR) << "Invalid thermal value of " << hint_type << " in config cache";
+                    return false;
+                }
+                index = thermal_index;
+            }
+            if (!thermal_value_index.empty() &&
+                thermal_value_index.size() != static_cast<size_t>(kThermalSeverityCount)) {
+                LOG(ERROR) << "Invalid thermal values of " << hint_type << " in config cache";
+                return false;
+            }
+            hint.node_actions.emplace_back(node_index, value_index,
+                                           std::chrono::milliseconds(timeout_ms), enable_property);
+            hint.node_actions.back().thermal_value_index = std::move(thermal_value_index);
+        }
+        const uint32_t hint_action_count = r->Count();
+        for (uint32_t j = 0; j < hint_action_count && r->ok(); ++j) {
+            uint8_t type = 0;
+            std::string value, enable_property;
+            (*r)(&type);
+            (*r)(&value);
+            (*r)(&enable_property);
+            if (!r->ok() || type > static_cast<uint8_t>(HintActionType::MaskHint)) {
+                LOG(ERROR) << "Invalid hint action of " << hint_type << " in config cache";
+                return false;
+            }
+            hint.hint_actions.emplace_back(static_cast<HintActionType>(type), value,
+                                           enable_property);
+        }
+    }
+
+    const uint32_t adpf_count = r->Count();
+    for (uint32_t i = 0; i < adpf_count && r->ok(); ++i) {
+        auto adpf = std::make_shared<AdpfConfig>();
+        VisitAdpfConfig(adpf.get(), [r](auto *field) { (*r)(field); });
+        config->adpfs.emplace_back(std::move(adpf));
+    }
+
+    if (!r->ok() || !r->AtEnd()) {
+        LOG(ERROR) << "Truncated or oversized config cache";
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+uint64_t ConfigCache::Hash(std::string_view data, uint64_t seed) {
+    uint64_t hash = seed;
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+std::string ConfigCache::Serialize(const PowerConfig &config, uint64_t key) {
+    const std::string payload = SerializePayload(config);
+    Writer w;
+    w.buf().append(kMagic, sizeof(kMagic));
+    w(kVersion);
+    w(key);
+    w(static_cast<uint64_t>(payload.size()));
+    w(Hash(payload));
+    w.buf().append(payload);
+    return std::move(w.buf());
+}
+
+bool ConfigCache::Deserialize(const char *data, std::size_t size, uint64_t key,
+                              PowerConfig *config) {
+    if (size < sizeof(kMagic) || std::memcmp(data, kMagic, sizeof(kMagic)) != 0) {
+        LOG(ERROR) << "Invalid config cache magic";
+        return false;
+    }
+    Reader r(data + sizeof(kMagic), size - sizeof(kMagic));
+    uint32_t version = 0;
+    uint64_t cache_key = 0, payload_size = 0, payload_hash = 0;
+    r(&version);
+    r(&cache_key);
+    r(&payload_size);
+    r(&payload_hash);
+    const std::size_t header_size = sizeof(kMagic) + sizeof(version) + sizeof(cache_key) +
+                                    sizeof(payload_size) + sizeof(payload_hash);
+    if (!r.ok() || version != kVersion) {
+        LOG(INFO) << "Config cache version " << version << " mismatch, expect " << kVersion;
+        return false;
+    }
+    if (cache_key != key) {
+        LOG(INFO) << "Config cache is stale";
+        return false;
+    }
+    if (payload_size != size - header_size) {
+        LOG(ERROR) << "Config cache size mismatch";
+        return false;
+    }
+    const std::string_view payload(data + header_size, payload_size);
+    if (Hash(payload) != payload_hash) {
+        LOG(ERROR) << "Config cache checksum mismatch";
+        return false;
+    }
+
+    Reader payload_reader(payload.data(), payload.size());
+    PowerConfig parsed;
+    if (!DeserializePayload(&payload_reader, &parsed)) {
+        return false;
+    }
+    *config = std::move(parsed);
+    return true;
+}
+
+bool ConfigCache::Write(const std::string &path, const PowerConfig &config, uint64_t key) {
+    const std::string tmp_path = path + ".tmp";
+    if (!android::base::WriteStringToFile(Serialize(config, key), tmp_path)) {
+        PLOG(ERROR) << "Failed to write config cache " << tmp_path;
+        return false;
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        PLOG(ERROR) << "Failed to rename config cache to " << path;
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ConfigCache::Load(const std::string &path, uint64_t key, PowerConfig *config) {
+    android::base::unique_fd fd(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+    if (fd < 0) {
+        LOG(VERBOSE) << "No config cache at " << path;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        LOG(ERROR) << "Failed to stat config cache " << path;
+        return false;
+    }
+    const std::size_t size = static_cast<std::size_t>(st.st_size);
+    void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        PLOG(ERROR) << "Failed to mmap config cache " << path;
+        return false;
+    }
+    const bool ret = Deserialize(static_cast<const char *>(data), size, key, config);
+    munmap(data, size);
+    return ret;
+}
+
+}  // namespace perfmgr
+}  // namespace android
@@ -0,0 +1,344 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specic language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define LOG_TAG "libperfmgr"
+
+#include "perfmgr/ConfigSimulator.h"
+
+#include <android-base/logging.h>
+#include <android-base/parsedouble.h>
+#include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace android {
+namespace perfmgr {
+
+namespace {
+constexpr std::string_view kAtraceCounter("tracing_mark_write: C|");
+}  // namespace
+
+ConfigSimulator::ConfigSimulator(
+        const std::vector<std::unique_ptr<Node>> &nodes,
+        const std::unordered_map<std::string, Hint> &actions,
+        const std::unordered_map<std::string, std::chrono::microseconds> &latencies,
+        std::chrono::milliseconds redundant_window)
+    : actions_(actions), redundant_window_(redundant_window) {
+    auto default_latency = latencies.find("*");
+    for (const auto &node : nodes) {
+        NodeState state;
+        state.name = node->GetName();
+        state.values = node->GetValues();
+        state.default_index = node->GetDefaultIndex();
+        auto latency = latencies.find(node->GetPath());
+        if (latency != latencies.end()) {
+            state.latency = latency->second;
+        } else if (default_latency != latencies.end()) {
+            state.latency = default_latency->second;
+        } else {
+            state.latency = std::chrono::microseconds(0);
+        }
+        state.requests.resize(state.values.size());
+        state.peaks.resize(state.values.size(), 0);
+        state.current_index = state.default_index;
+        state.previous_index = state.default_index;
+        nodes_.emplace_back(std::move(state));
+    }
+}
+
+bool ConfigSimulator::ParseTrace(const std::string &trace, std::vector<HintEvent> *events) {
+    std::size_t line_number = 0;
+    for (const auto &raw_line : android::base::Split(trace, "\n")) {
+        line_number++;
+        const std::string line = android::base::Trim(raw_line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::vector<std::string> tokens = android::base::Tokenize(line, " \t");
+        int64_t time_ms;
+        if (android::base::ParseInt(tokens[0], &time_ms)) {
+            int64_t duration_ms = 0;
+            const bool end = tokens.size() == 3 && tokens[1] == "end";
+            const bool valid =
+                    tokens.size() >= 3 && time_ms >= 0 &&
+                    (end || (tokens[1] == "do" &&
+                             (tokens.size() == 3 ||
+                              (tokens.size() == 4 &&
+                               android::base::ParseInt(tokens[3], &duration_ms, int64_t{0})))));
+            if (!valid) {
+                LOG(ERROR) << "Invalid hint event at line " << line_number << ": " << line;
+                return false;
+            }
+            HintEvent event{std::chrono::milliseconds(time_ms), tokens[2], end, std::nullopt};
+            if (tokens.size() == 4) {
+                event.duration = std::chrono::milliseconds(duration_ms);
+            }
+            events->emplace_back(std::move(event));
+            continue;
+        }
+
+        // atrace counter: "<task> [cpu] <flags> <seconds>: tracing_mark_write: C|pid|name|value"
+        const std::size_t counter = line.find(kAtraceCounter);
+        if (counter == std::string::npos) {
+            continue;
+        }
+        const std::size_t ts_end = line.rfind(':', counter - 1);
+        const std::size_t ts_begin = line.rfind(' ', ts_end);
+        std::vector<std::string> fields =
+                android::base::Split(line.substr(counter + kAtraceCounter.size()), "|");
+        double seconds;
+        int64_t value;
+        if (ts_end == std::string::npos || ts_begin == std::string::npos || fields.size() != 3 ||
+            !android::base::ParseDouble(line.substr(ts_begin + 1, ts_end - ts_begin - 1).c_str(),
+                                        &seconds, 0.0) ||
+            !android::base::ParseInt(fields[2], &value, int64_t{0})) {
+            continue;
+        }
+        // The counter holds the effective timeout, which is replayed as the
+        // duration override; INT_MAX stands for forever.
+        HintEvent event{std::chrono::milliseconds(static_cast<int64_t>(seconds * 1000)),
+                        fields[1], value == 0, std::nullopt};
+        if (value == std::numeric_limits<int>::max()) {
+            event.duration = std::chrono::milliseconds(0);
+        } else if (value != 0) {
+            event.duration = std::chrono::milliseconds(value);
+        }
+        events->emplace_back(std::move(event));
+    }
+    return true;
+}
+
+bool ConfigSimulator::ParseLatencyTable(
+        const std::string &table,
+        std::unordered_map<std::string, std::chrono::microseconds> *latencies) {
+    std::size_t line_number = 0;
+    for (const auto &raw_line : android::base::Split(table, "\n")) {
+        line_number++;
+        const std::string line = raw_line.substr(0, raw_line.find('#'));
+        std::vector<std::string> tokens = android::base::Tokenize(line, " \t");
+        if (tokens.empty()) {
+            continue;
+        }
+        int64_t latency_us;
+        if (tokens.size() != 2 || !android::base::ParseInt(tokens[1], &latency_us, int64_t{0})) {
+            LOG(ERROR) << "Invalid latency at line " << line_number << ": " << raw_line;
+            return false;
+        }
+        (*latencies)[tokens[0]] = std::chrono::microseconds(latency_us);
+    }
+    return true;
+}
+
+void ConfigSimulator::Run(const std::vector<HintEvent> &events) {
+    std::vector<HintEvent> sorted = events;
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const auto &a, const auto &b) { return a.time < b.time; });
+    for (const auto &event : sorted) {
+        ExpireUntil(event.time.count());
+        now_ = std::max(now_, static_cast<int64_t>(event.time.count()));
+        if (actions_.find(event.hint_type) == actions_.end()) {
+            unknown_events_++;
+            continue;
+        }
+        if (event.end) {
+            EndHint(event.hint_type);
+        } else {
+            DoHint(event.hint_type, event.duration);
+        }
+    }
+    // Let every timed request run out
+    ExpireUntil(kForever - 1);
+}
+
+void ConfigSimulator::DoHint(const std::string &hint_type,
+                             std::optional<std::chrono::milliseconds> duration) {
+    auto hint = actions_.find(hint_type);
+    if (hint == actions_.end() || !in_progress_.insert(hint_type).second) {
+        return;
+    }
+    costs_[hint_type].do_count++;
+    auto mask = masks_.find(hint_type);
+    if (mask != masks_.end() && !mask->second.empty()) {
+        in_progress_.erase(hint_type);
+        return;
+    }
+    for (const auto &a : hint->second.node_actions) {
+        if (a.node_index >= nodes_.size() || a.value_index >= nodes_[a.node_index].values.size()) {
+            continue;
+        }
+        const std::chrono::milliseconds timeout = duration.value_or(a.timeout_ms);
+        const int64_t end_time =
+                timeout == std::chrono::milliseconds::zero() ? kForever : now_ + timeout.count();
+        NodeState &node = nodes_[a.node_index];
+        auto [it, inserted] = node.requests[a.value_index].emplace(hint_type, end_time);
+        if (!inserted) {
+            it->second = std::max(it->second, end_time);
+        }
+        node.peaks[a.value_index] =
+                std::max(node.peaks[a.value_index], node.requests[a.value_index].size());
+    }
+    for (const auto &a : hint->second.node_actions) {
+        if (a.node_index < nodes_.size()) {
+            UpdateNode(a.node_index, hint_type);
+        }
+    }
+    for (const auto &a : hint->second.hint_actions) {
+        switch (a.type) {
+            case HintActionType::DoHint:
+                DoHint(a.value, std::nullopt);
+                break;
+            case HintActionType::EndHint:
+                EndHint(a.value);
+                break;
+            case HintActionType::MaskHint:
+                masks_[a.value].insert(hint_type);
+                break;
+            default:
+                break;
+        }
+    }
+    in_progress_.erase(hint_type);
+}
+
+void ConfigSimulator::EndHint(const std::string &hint_type) {
+    auto hint = actions_.find(hint_type);
+    if (hint == actions_.end()) {
+        return;
+    }
+    for (const auto &a : hint->second.node_actions) {
+        if (a.node_index >= nodes_.size()) {
+            continue;
+        }
+        for (auto &group : nodes_[a.node_index].requests) {
+            group.erase(hint_type);
+        }
+        UpdateNode(a.node_index, hint_type);
+    }
+    for (const auto &a : hint->second.hint_actions) {
+        if (a.type == HintActionType::MaskHint) {
+            masks_[a.value].erase(hint_type);
+        }
+    }
+}
+
+void ConfigSimulator::UpdateNode(std::size_t i, const std::string &hint_type) {
+    NodeState &node = nodes_[i];
+    std::size_t target = node.default_index;
+    for (std::size_t v = 0; v < node.requests.size(); v++) {
+        if (!node.requests[v].empty()) {
+            target = v;
+            break;
+        }
+    }
+    if (target == node.current_index) {
+        return;
+    }
+    HintCost &cost = costs_[hint_type];
+    cost.writes++;
+    cost.write_latency += node.latency;
+    if (target == node.previous_index && now_ - node.last_write < redundant_window_.count()) {
+        cost.redundant_writes++;
+    }
+    node.previous_index = node.current_index;
+    node.current_index = target;
+    node.last_write = now_;
+}
+
+void ConfigSimulator::ExpireUntil(int64_t time) {
+    while (true) {
+        int64_t next = kForever;
+        for (const auto &node : nodes_) {
+            for (const auto &group : node.requests) {
+                for (const auto &[hint_type, end_time] : group) {
+                    next = std::min(next, end_time);
+                }
+            }
+        }
+        if (next > time) {
+            return;
+        }
+        now_ = std::max(now_, next);
+        for (std::size_t i = 0; i < nodes_.size(); i++) {
+            // Charge the write to the first hint expiring on the node
+            std::optional<std::string> expired;
+            for (auto &group : nodes_[i].requests) {
+                for (auto it = group.begin(); it != group.end();) {
+                    if (it->second <= now_) {
+                        if (!expired.has_value() || it->first < *expired) {
+                            expired = it->first;
+                        }
+                        it = group.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
+            if (expired.has_value()) {
+                UpdateNode(i, *expired);
+            }
+        }
+    }
+}
+
+std::vector<ConfigSimulator::GroupPeak> ConfigSimulator::GetGroupPeaks() const {
+    std::vector<GroupPeak> peaks;
+    for (const auto &node : nodes_) {
+        for (std::size_t v = 0; v < node.values.size(); v++) {
+            if (node.peaks[v] > 0) {
+                peaks.push_back({node.name, node.values[v], node.peaks[v]});
+            }
+        }
+    }
+    return peaks;
+}
+
+std::string ConfigSimulator::GetReport() const {
+    std::string report(
+            "Hint\tDoHint Count\tWrites\tRedundant Writes\tWrite Latency (us)\t"
+            "Latency per DoHint (us)\n");
+    HintCost total;
+    for (const auto &[hint_type, cost] : costs_) {
+        report += android::base::StringPrintf(
+                "%s\t%u\t%u\t%u\t%lld\t%lld\n", hint_type.c_str(), cost.do_count, cost.writes,
+                cost.redundant_writes, static_cast<long long>(cost.write_latency.count()),
+                static_cast<long long>(cost.do_count ? cost.write_latency.count() / cost.do_count
+                                                     : 0));
+        total.do_count += cost.do_count;
+        total.writes += cost.writes;
+        total.redundant_writes += cost.redundant_writes;
+        total.write_latency += cost.write_latency;
+    }
+    report += android::base::StringPrintf("Total\t%u\t%u\t%u\t%lld\t-\n", total.do_count,
+                                          total.writes, total.redundant_writes,
+                                          static_cast<long long>(total.write_latency.count()));
+    report += "\nNode\tValue\tPeak Requests\n";
+    for (const auto &peak : GetGroupPeaks()) {
+        report += android::base::StringPrintf("%s\t%s\t%zu\n", peak.node.c_str(),
+                                              peak.value.c_str(), peak.peak);
+    }
+    if (unknown_events_ > 0) {
+        report += android::base::StringPrintf("\nIgnored %zu events of unknown hints\n",
+                                              unknown_events_);
+    }
+    return report;
+}
+
+}  // namespace perfmgr
+}  // namespace android
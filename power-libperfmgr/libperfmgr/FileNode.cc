@@ -25,48 +25,98 @@
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <inttypes.h>
+#include <linux/magic.h>
+#include <pixeltrace/PixelTrace.h>
+#include <sys/vfs.h>
 #include <utils/Trace.h>
 
 namespace android {
 namespace perfmgr {
 
 FileNode::FileNode(std::string name, std::string node_path, std::vector<RequestGroup> req_sorted,
-                   std::size_t default_val_index, bool reset_on_init, bool truncate, bool hold_fd, bool write_only)
+                   std::size_t default_val_index, bool reset_on_init, bool truncate, bool hold_fd,
+                   bool write_only, bool cache_fd)
     : Node(std::move(name), std::move(node_path), std::move(req_sorted), default_val_index,
            reset_on_init),
       hold_fd_(hold_fd),
       truncate_(truncate),
       write_only_(write_only),
-      warn_timeout_(android::base::GetBoolProperty("ro.debuggable", false) ? 5ms : 50ms) {}
+      cache_fd_(cache_fd),
+      warn_timeout_(android::base::GetBoolProperty("ro.debuggable", false) ? 5ms : 50ms),
+      is_pseudo_fs_(false),
+      write_count_(0),
+      write_total_us_(0),
+      write_max_us_(0) {}
 
-std::chrono::milliseconds FileNode::Update(bool log_error) {
-    std::size_t value_index = default_val_index_;
-    std::chrono::milliseconds expire_time = std::chrono::milliseconds::max();
+bool FileNode::OpenFd() {
+    fd_.reset(TEMP_FAILURE_RETRY(open(node_path_.c_str(), O_WRONLY | O_CLOEXEC)));
+    if (fd_ == -1) {
+        return false;
+    }
+    struct statfs sfs;
+    is_pseudo_fs_ = fstatfs(fd_, &sfs) == 0 &&
+                    (sfs.f_type == SYSFS_MAGIC || sfs.f_type == PROC_SUPER_MAGIC);
+    return true;
+}
 
-    // Find the highest outstanding request's expire time
-    for (std::size_t i = 0; i < req_sorted_.size(); i++) {
-        if (req_sorted_[i].GetExpireTime(&expire_time)) {
-            value_index = i;
+bool FileNode::WriteCachedFd(const std::string& value) {
+    if (fd_ == -1 && !OpenFd()) {
+        return false;
+    }
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        ssize_t n = TEMP_FAILURE_RETRY(pwrite(fd_, value.data(), value.size(), 0));
+        if (n == static_cast<ssize_t>(value.size())) {
+            // sysfs/procfs apply the value in the store callback, nothing to
+            // truncate or sync there.
+            if (!is_pseudo_fs_) {
+                if (GetTruncate() && TEMP_FAILURE_RETRY(ftruncate(fd_, value.size())) != 0) {
+                    break;
+                }
+                fsync(fd_);
+            }
+            return true;
+        }
+        // The cached fd went stale, e.g. the device was re-registered, retry
+        // once with a fresh fd.
+        if (n != -1 || (errno != EBADF && errno != ENODEV) || attempt > 0 || !OpenFd()) {
             break;
         }
     }
+    fd_.reset();
+    return false;
+}
+
+bool FileNode::WriteReopenFd(const std::string& value) {
+    int flags = O_WRONLY | O_CLOEXEC;
+    if (GetTruncate()) {
+        flags |= O_TRUNC;
+    }
+    fd_.reset(TEMP_FAILURE_RETRY(open(node_path_.c_str(), flags)));
+
+    if (fd_ == -1 || !android::base::WriteStringToFd(value, fd_)) {
+        return false;
+    }
+    // For regular file system, we need fsync
+    fsync(fd_);
+    return true;
+}
+
+std::chrono::milliseconds FileNode::Update(bool log_error) {
+    std::chrono::milliseconds expire_time;
+    std::size_t value_index = GetTargetIndex(&expire_time);
 
     // Update node only if request index changes
     if (value_index != current_val_index_ || reset_on_init_) {
         const std::string& req_value =
             req_sorted_[value_index].GetRequestValue();
         if (ATRACE_ENABLED()) {
-            const std::string tag = GetName() + ":" + req_value;
-            ATRACE_BEGIN(tag.c_str());
+            PIXEL_TRACE_BEGIN_F("%s:%s", GetName().c_str(), req_value.c_str());
         }
-        android::base::Timer t;
-        int flags = O_WRONLY | O_CLOEXEC;
-        if (GetTruncate()) {
-            flags |= O_TRUNC;
-        }
-        fd_.reset(TEMP_FAILURE_RETRY(open(node_path_.c_str(), flags)));
+        auto start = std::chrono::steady_clock::now();
+        bool written = cache_fd_ ? WriteCachedFd(req_value) : WriteReopenFd(req_value);
 
-        if (fd_ == -1 || !android::base::WriteStringToFd(req_value, fd_)) {
+        if (!written) {
             if (log_error) {
                 LOG(WARNING) << "Failed to write to node: " << node_path_
                              << " with value: " << req_value << ", fd: " << fd_;
@@ -74,21 +124,25 @@ std::chrono::milliseconds FileNode::Update(bool log_error) {
             // Retry in 500ms or sooner
             expire_time = std::min(expire_time, std::chrono::milliseconds(500));
         } else {
-            // For regular file system, we need fsync
-            fsync(fd_);
             // Some dev node requires file to remain open during the entire hint
             // duration e.g. /dev/cpu_dma_latency, so fd_ is intentionally kept
             // open during any requested value other than default one. If
             // request a default value, node will write the value and then
-            // release the fd.
-            if ((!hold_fd_) || value_index == default_val_index_) {
+            // release the fd. Cached fd is kept open regardless.
+            if (!cache_fd_ && ((!hold_fd_) || value_index == default_val_index_)) {
                 fd_.reset();
             }
-            auto duration = t.duration();
+            auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start);
+            write_count_.fetch_add(1, std::memory_order_relaxed);
+            write_total_us_.fetch_add(duration.count(), std::memory_order_relaxed);
+            if (duration.count() > write_max_us_.load(std::memory_order_relaxed)) {
+                write_max_us_.store(duration.count(), std::memory_order_relaxed);
+            }
             if (duration > warn_timeout_) {
                 LOG(WARNING) << "Slow writing to file: '" << node_path_
                              << "' with value: '" << req_value
-                             << "' took: " << duration.count() << " ms";
+                             << "' took: " << duration.count() << " us";
             }
             // Update current index only when succeed
             current_val_index_ = value_index;
@@ -101,6 +155,15 @@ std::chrono::milliseconds FileNode::Update(bool log_error) {
     return expire_time;
 }
 
+bool FileNode::IsSameConfig(const Node& other) const {
+    if (!Node::IsSameConfig(other)) {
+        return false;
+    }
+    const FileNode& file = static_cast<const FileNode&>(other);
+    return hold_fd_ == file.hold_fd_ && truncate_ == file.truncate_ &&
+           write_only_ == file.write_only_ && cache_fd_ == file.cache_fd_;
+}
+
 bool FileNode::GetHoldFd() const {
     return hold_fd_;
 }
@@ -109,22 +172,42 @@ bool FileNode::GetTruncate() const {
     return truncate_;
 }
 
+bool FileNode::GetWriteOnly() const {
+    return write_only_;
+}
+
+bool FileNode::GetCacheFd() const {
+    return cache_fd_;
+}
+
 void FileNode::DumpToFd(int fd) const {
     std::string node_value;
     if (!write_only_ && !android::base::ReadFileToString(node_path_, &node_value)) {
         LOG(ERROR) << "Failed to read node path: " << node_path_;
     }
     node_value = android::base::Trim(node_value);
+    const uint64_t write_count = write_count_.load(std::memory_order_relaxed);
+    const int64_t avg_write_us =
+            write_count ? write_total_us_.load(std::memory_order_relaxed) /
+                                  static_cast<int64_t>(write_count)
+                        : 0;
     std::string buf(
             android::base::StringPrintf("Node Name\t"
                                         "Node Path\t"
                                         "Current Index\t"
                                         "Current Value\t"
                                         "Hold FD\t"
-                                        "Truncate\n"
-                                        "%s\t%s\t%zu\t%s\t%d\t%d\n",
+                                        "Truncate\t"
+                                        "Cache FD\t"
+                                        "Write Count\t"
+                                        "Avg Write (us)\t"
+                                        "Max Write (us)\n"
+                                        "%s\t%s\t%zu\t%s\t%d\t%d\t%d\t%" PRIu64 "\t%" PRId64
+                                        "\t%" PRId64 "\n",
                                         name_.c_str(), node_path_.c_str(), current_val_index_,
-                                        node_value.c_str(), hold_fd_, truncate_));
+                                        node_value.c_str(), hold_fd_, truncate_, cache_fd_,
+                                        write_count, avg_write_us,
+                                        write_max_us_.load(std::memory_order_relaxed)));
     if (!android::base::WriteStringToFd(buf, fd)) {
         LOG(ERROR) << "Failed to dump fd: " << fd;
     }
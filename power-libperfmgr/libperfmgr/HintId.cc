@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specic language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "libperfmgr"
+
+#include "perfmgr/HintId.h"
+
+#include <android-base/logging.h>
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace android {
+namespace perfmgr {
+
+namespace {
+struct Table {
+    std::mutex lock;
+    std::unordered_map<std::string, HintId> ids;
+    // deque keeps names stable while the table grows
+    std::deque<std::string> names;
+};
+
+Table &GetTable() {
+    static Table *table = new Table();
+    return *table;
+}
+}  // namespace
+
+HintId HintIdTable::Intern(const std::string &name) {
+    Table &table = GetTable();
+    std::lock_guard<std::mutex> lock(table.lock);
+    auto it = table.ids.find(name);
+    if (it != table.ids.end()) {
+        return it->second;
+    }
+    if (table.names.size() >= kInvalidHintId) {
+        LOG(ERROR) << "Too many hint names interned, drop " << name;
+        return kInvalidHintId;
+    }
+    const HintId id = static_cast<HintId>(table.names.size());
+    table.names.push_back(name);
+    table.ids.emplace(name, id);
+    return id;
+}
+
+HintId HintIdTable::Find(const std::string &name) {
+    Table &table = GetTable();
+    std::lock_guard<std::mutex> lock(table.lock);
+    auto it = table.ids.find(name);
+    return it == table.ids.end() ? kInvalidHintId : it->second;
+}
+
+std::string HintIdTable::GetName(HintId id) {
+    Table &table = GetTable();
+    std::lock_guard<std::mutex> lock(table.lock);
+    return id < table.names.size() ? table.names[id] : std::string();
+}
+
+std::size_t HintIdTable::Size() {
+    Table &table = GetTable();
+    std::lock_guard<std::mutex> lock(table.lock);
+    return table.names.size();
+}
+
+}  // namespace perfmgr
+}  // namespace android
@@ -31,6 +31,7 @@
 #include <algorithm>
 #include <set>
 
+#include "perfmgr/ConfigCache.h"
 #include "perfmgr/FileNode.h"
 #include "perfmgr/PropertyNode.h"
 
@@ -39,21 +40,91 @@ namespace perfmgr {
 
 namespace {
 constexpr std::chrono::milliseconds kMilliSecondZero = std::chrono::milliseconds(0);
-constexpr std::chrono::steady_clock::time_point kTimePointMax =
-        std::chrono::steady_clock::time_point::max();
+constexpr HintStatus::Ticks kTicksMax =
+        std::chrono::steady_clock::time_point::max().time_since_epoch().count();
+
+// Holds the transition flag of a HintStatus; it is only ever held for a few
+// instructions, so spin instead of sleeping on a mutex.
+class TransitionGuard {
+  public:
+    explicit TransitionGuard(std::atomic<bool> *flag) : flag_(flag) {
+        while (flag_->exchange(true, std::memory_order_acquire)) {
+            while (flag_->load(std::memory_order_relaxed)) {
+            }
+        }
+    }
+    ~TransitionGuard() { flag_->store(false, std::memory_order_release); }
+
+  private:
+    std::atomic<bool> *flag_;
+};
+
+uint64_t TicksToMs(HintStatus::Ticks ticks) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::duration(ticks))
+            .count();
+}
 }  // namespace
 
 constexpr char kPowerHalTruncateProp[] = "vendor.powerhal.truncate";
+constexpr char kPowerHalCoalesceWindowUsProp[] = "vendor.powerhal.coalesce_window_us";
+constexpr char kPowerHalBoostMonitorMsProp[] = "vendor.powerhal.boost_monitor_ms";
 constexpr std::string_view kConfigDebugPathProperty("vendor.powerhal.config.debug");
 constexpr std::string_view kConfigProperty("vendor.powerhal.config");
 constexpr std::string_view kConfigDefaultFileName("powerhint.json");
+constexpr std::string_view kConfigCacheSuffix(".cache");
+
+HintManager::HintManager(sp<NodeLooperThread> nm,
+                         const std::unordered_map<std::string, Hint> &actions,
+                         const std::vector<std::shared_ptr<AdpfConfig>> &adpfs,
+                         std::optional<std::string> gpu_sysfs_config_path)
+    : nm_(std::move(nm)),
+      actions_(actions),
+      adpfs_(adpfs),
+      adpf_index_(0),
+      gpu_sysfs_config_path_(gpu_sysfs_config_path) {
+    // Intern hint names once, the hot path only deals with HintIds
+    for (auto &entry : actions_) {
+        const HintId id = HintIdTable::Intern(entry.first);
+        if (id == kInvalidHintId) {
+            continue;
+        }
+        if (id >= hints_by_id_.size()) {
+            hints_by_id_.resize(id + 1, nullptr);
+        }
+        hints_by_id_[id] = &entry;
+    }
+    // Give every MaskHint requester its own bit in the masked hint
+    std::unordered_map<const Hint *, uint32_t> mask_bits_used;
+    for (auto &entry : actions_) {
+        for (auto &action : entry.second.hint_actions) {
+            const HintEntry *masked = GetHintEntry(action.value_id);
+            if (action.type != HintActionType::MaskHint || masked == nullptr) {
+                continue;
+            }
+            uint32_t &used = mask_bits_used[&masked->second];
+            if (used < Hint::kMaxMaskBits) {
+                action.mask_bit = uint64_t{1} << used++;
+            }
+        }
+    }
+}
+
+HintManager::HintEntry *HintManager::GetHintEntry(HintId hint_id) const {
+    return hint_id < hints_by_id_.size() ? hints_by_id_[hint_id] : nullptr;
+}
 
-bool HintManager::ValidateHint(const std::string& hint_type) const {
+bool HintManager::ValidateHint(HintId hint_id) const {
     if (nm_.get() == nullptr) {
         LOG(ERROR) << "NodeLooperThread not present";
         return false;
     }
-    return IsHintSupported(hint_type);
+    return IsHintSupported(hint_id);
+}
+
+HintId HintManager::LookupHint(const std::string &hint_type) {
+    // Names come from clients too, only the config parsing interns new ones
+    return HintIdTable::Find(hint_type);
 }
 
 bool HintManager::IsHintSupported(const std::string& hint_type) const {
@@ -64,9 +135,20 @@ bool HintManager::IsHintSupported(const std::string& hint_type) const {
     return true;
 }
 
+bool HintManager::IsHintSupported(HintId hint_id) const {
+    if (GetHintEntry(hint_id) == nullptr) {
+        LOG(DEBUG) << "Hint type not present in actions: " << HintIdTable::GetName(hint_id);
+        return false;
+    }
+    return true;
+}
+
 bool HintManager::IsHintEnabled(const std::string &hint_type) const {
-    std::lock_guard<std::mutex> lock(actions_.at(hint_type).hint_lock);
-    return actions_.at(hint_type).mask_requesters.empty();
+    return actions_.at(hint_type).mask_bits.load(std::memory_order_acquire) == 0;
+}
+
+bool HintManager::IsHintEnabled(HintId hint_id) const {
+    return GetHintEntry(hint_id)->second.mask_bits.load(std::memory_order_acquire) == 0;
 }
 
 bool HintManager::InitHintStatus(const std::unique_ptr<HintManager> &hm) {
@@ -91,58 +173,99 @@ bool HintManager::InitHintStatus(const std::unique_ptr<HintManager> &hm) {
     return true;
 }
 
-void HintManager::DoHintStatus(const std::string &hint_type, std::chrono::milliseconds timeout_ms) {
-    std::lock_guard<std::mutex> lock(actions_.at(hint_type).hint_lock);
-    actions_.at(hint_type).status->stats.count.fetch_add(1);
-    auto now = std::chrono::steady_clock::now();
-    ATRACE_INT(hint_type.c_str(), (timeout_ms == kMilliSecondZero) ? std::numeric_limits<int>::max()
-                                                                   : timeout_ms.count());
-    if (now > actions_.at(hint_type).status->end_time) {
-        actions_.at(hint_type).status->stats.duration_ms.fetch_add(
-                std::chrono::duration_cast<std::chrono::milliseconds>(
-                        actions_.at(hint_type).status->end_time -
-                        actions_.at(hint_type).status->start_time)
-                        .count());
-        actions_.at(hint_type).status->start_time = now;
+std::unordered_map<std::string, std::vector<BoostMonitor::Target>> HintManager::FindBoostTargets(
+        const PowerConfig &config) {
+    if (android::base::GetUintProperty<uint32_t>(kPowerHalBoostMonitorMsProp, 0) == 0) {
+        return {};
+    }
+    return BoostMonitor::FindTargets(config.actions, config.nodes);
+}
+
+void HintManager::InitBoostMonitor(
+        const std::unique_ptr<HintManager> &hm,
+        const std::unordered_map<std::string, std::vector<BoostMonitor::Target>> &targets) {
+    const std::chrono::milliseconds interval(
+            android::base::GetUintProperty<uint32_t>(kPowerHalBoostMonitorMsProp, 0));
+    if (interval == kMilliSecondZero || targets.empty()) {
+        return;
     }
-    actions_.at(hint_type).status->end_time =
-            (timeout_ms == kMilliSecondZero) ? kTimePointMax : now + timeout_ms;
+    std::vector<BoostMonitor::MonitoredHint> hints;
+    for (const auto &[hint_type, hint_targets] : targets) {
+        hints.push_back({hm->actions_.at(hint_type).status, hint_targets});
+    }
+    LOG(INFO) << "Monitoring the boosts of " << hints.size() << " hints every "
+              << interval.count() << "ms";
+    hm->boost_monitor_ = std::make_unique<BoostMonitor>(interval, std::move(hints));
 }
 
-void HintManager::EndHintStatus(const std::string &hint_type) {
-    std::lock_guard<std::mutex> lock(actions_.at(hint_type).hint_lock);
+void HintManager::DoHintStatus(HintEntry *entry, std::chrono::milliseconds timeout_ms) {
+    HintStatus &status = *entry->second.status;
+    status.stats.count.fetch_add(1, std::memory_order_relaxed);
+    const auto now = std::chrono::steady_clock::now();
+    const HintStatus::Ticks now_ticks = now.time_since_epoch().count();
+    const HintStatus::Ticks end_ticks = (timeout_ms == kMilliSecondZero)
+                                                ? kTicksMax
+                                                : (now + timeout_ms).time_since_epoch().count();
+    ATRACE_INT(entry->first.c_str(), (timeout_ms == kMilliSecondZero)
+                                             ? std::numeric_limits<int>::max()
+                                             : timeout_ms.count());
+    // Fast path: the hint is still active, just move its end time
+    HintStatus::Ticks old_end = status.end_time.load(std::memory_order_acquire);
+    while (now_ticks <= old_end) {
+        if (status.end_time.compare_exchange_weak(old_end, end_ticks, std::memory_order_acq_rel)) {
+            return;
+        }
+    }
+    TransitionGuard guard(&status.transition);
+    old_end = status.end_time.load(std::memory_order_acquire);
+    if (now_ticks > old_end) {
+        status.stats.duration_ms.fetch_add(
+                TicksToMs(old_end - status.start_time.load(std::memory_order_relaxed)),
+                std::memory_order_relaxed);
+        status.start_time.store(now_ticks, std::memory_order_relaxed);
+    }
+    status.end_time.store(end_ticks, std::memory_order_release);
+}
+
+void HintManager::EndHintStatus(HintEntry *entry) {
+    HintStatus &status = *entry->second.status;
     // Update HintStats if the hint ends earlier than expected end_time
-    auto now = std::chrono::steady_clock::now();
-    ATRACE_INT(hint_type.c_str(), 0);
-    if (now < actions_.at(hint_type).status->end_time) {
-        actions_.at(hint_type).status->stats.duration_ms.fetch_add(
-                std::chrono::duration_cast<std::chrono::milliseconds>(
-                        now - actions_.at(hint_type).status->start_time)
-                        .count());
-        actions_.at(hint_type).status->end_time = now;
+    const HintStatus::Ticks now_ticks = std::chrono::steady_clock::now().time_since_epoch().count();
+    ATRACE_INT(entry->first.c_str(), 0);
+    if (now_ticks >= status.end_time.load(std::memory_order_acquire)) {
+        return;
+    }
+    TransitionGuard guard(&status.transition);
+    HintStatus::Ticks old_end = status.end_time.load(std::memory_order_acquire);
+    while (now_ticks < old_end) {
+        // Retry if a concurrent DoHint extended the hint meanwhile
+        if (status.end_time.compare_exchange_weak(old_end, now_ticks, std::memory_order_acq_rel)) {
+            status.stats.duration_ms.fetch_add(
+                    TicksToMs(now_ticks - status.start_time.load(std::memory_order_relaxed)),
+                    std::memory_order_relaxed);
+            break;
+        }
     }
 }
 
-void HintManager::DoHintAction(const std::string &hint_type) {
-    for (auto &action : actions_.at(hint_type).hint_actions) {
-        if (!action.enable_property.empty() &&
-            !android::base::GetBoolProperty(action.enable_property, true)) {
+void HintManager::DoHintAction(HintId hint_id, HintEntry *entry) {
+    for (auto &action : entry->second.hint_actions) {
+        if (action.enable_cache != nullptr && !action.enable_cache->Get(true)) {
             // Disabled action based on its control property
             continue;
         }
         switch (action.type) {
             case HintActionType::DoHint:
-                DoHint(action.value);
+                DoHint(action.value_id);
                 break;
             case HintActionType::EndHint:
-                EndHint(action.value);
+                EndHint(action.value_id);
                 break;
             case HintActionType::MaskHint:
-                if (actions_.find(action.value) == actions_.end()) {
+                if (GetHintEntry(action.value_id) == nullptr) {
                     LOG(ERROR) << "Failed to find " << action.value << " action";
                 } else {
-                    std::lock_guard<std::mutex> lock(actions_.at(hint_type).hint_lock);
-                    actions_.at(action.value).mask_requesters.insert(hint_type);
+                    MaskHint(hint_id, action);
                 }
                 break;
             default:
@@ -154,56 +277,152 @@ void HintManager::DoHintAction(const std::string &hint_type) {
     }
 }
 
-void HintManager::EndHintAction(const std::string &hint_type) {
-    for (auto &action : actions_.at(hint_type).hint_actions) {
-        if (action.type == HintActionType::MaskHint &&
-            actions_.find(action.value) != actions_.end()) {
-            std::lock_guard<std::mutex> lock(actions_.at(hint_type).hint_lock);
-            actions_.at(action.value).mask_requesters.erase(hint_type);
+void HintManager::EndHintAction(HintId hint_id, HintEntry *entry) {
+    for (auto &action : entry->second.hint_actions) {
+        if (action.type == HintActionType::MaskHint && GetHintEntry(action.value_id) != nullptr) {
+            UnmaskHint(hint_id, action);
         }
     }
 }
 
-bool HintManager::DoHint(const std::string& hint_type) {
-    LOG(VERBOSE) << "Do Powerhint: " << hint_type;
-    if (!ValidateHint(hint_type) || !IsHintEnabled(hint_type) ||
-        !nm_->Request(actions_.at(hint_type).node_actions, hint_type)) {
+void HintManager::MaskHint(HintId hint_id, const HintAction &action) {
+    Hint &masked = GetHintEntry(action.value_id)->second;
+    if (action.mask_bit != 0) {
+        masked.mask_bits.fetch_or(action.mask_bit, std::memory_order_release);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(masked.hint_lock);
+    masked.mask_requesters.insert(hint_id);
+    masked.mask_bits.fetch_or(Hint::kMaskOverflowBit, std::memory_order_release);
+}
+
+void HintManager::UnmaskHint(HintId hint_id, const HintAction &action) {
+    Hint &masked = GetHintEntry(action.value_id)->second;
+    if (action.mask_bit != 0) {
+        masked.mask_bits.fetch_and(~action.mask_bit, std::memory_order_release);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(masked.hint_lock);
+    masked.mask_requesters.erase(hint_id);
+    if (masked.mask_requesters.empty()) {
+        masked.mask_bits.fetch_and(~Hint::kMaskOverflowBit, std::memory_order_release);
+    }
+}
+
+bool HintManager::IsMasking(HintId hint_id, const HintAction &action) const {
+    const HintEntry *masked = GetHintEntry(action.value_id);
+    if (masked == nullptr) {
         return false;
     }
-    DoHintStatus(hint_type, actions_.at(hint_type).status->max_timeout);
-    DoHintAction(hint_type);
-    return true;
+    if (action.mask_bit != 0) {
+        return (masked->second.mask_bits.load(std::memory_order_acquire) & action.mask_bit) != 0;
+    }
+    std::lock_guard<std::mutex> lock(masked->second.hint_lock);
+    return masked->second.mask_requesters.count(hint_id) != 0;
+}
+
+void HintManager::CarryOverMasks(const HintManager &old) {
+    for (auto &entry : actions_) {
+        const auto old_entry = old.actions_.find(entry.first);
+        if (old_entry == old.actions_.end()) {
+            continue;
+        }
+        const HintId hint_id = HintIdTable::Find(entry.first);
+        for (const auto &action : entry.second.hint_actions) {
+            if (action.type != HintActionType::MaskHint ||
+                GetHintEntry(action.value_id) == nullptr) {
+                continue;
+            }
+            for (const auto &old_action : old_entry->second.hint_actions) {
+                if (old_action.type == HintActionType::MaskHint &&
+                    old_action.value_id == action.value_id && old.IsMasking(hint_id, old_action)) {
+                    MaskHint(hint_id, action);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+bool HintManager::DoHint(const std::string& hint_type) {
+    return DoHint(LookupHint(hint_type));
 }
 
 bool HintManager::DoHint(const std::string& hint_type,
                          std::chrono::milliseconds timeout_ms_override) {
-    LOG(VERBOSE) << "Do Powerhint: " << hint_type << " for "
-                 << timeout_ms_override.count() << "ms";
-    if (!ValidateHint(hint_type) || !IsHintEnabled(hint_type)) {
-        return false;
+    return DoHint(LookupHint(hint_type), timeout_ms_override);
+}
+
+bool HintManager::EndHint(const std::string& hint_type) {
+    return EndHint(LookupHint(hint_type));
+}
+
+bool HintManager::DoHint(HintId hint_id) {
+    return DoHintInternal(hint_id, std::nullopt);
+}
+
+bool HintManager::DoHint(HintId hint_id, std::chrono::milliseconds timeout_ms_override) {
+    return DoHintInternal(hint_id, timeout_ms_override);
+}
+
+bool HintManager::DoHintInternal(HintId hint_id,
+                                 std::optional<std::chrono::milliseconds> timeout_ms) {
+    if (retired_.load(std::memory_order_acquire)) {
+        // Called through a replaced instance, act on the current config
+        return GetInstance()->DoHintInternal(hint_id, timeout_ms);
     }
-    std::vector<NodeAction> actions_override = actions_.at(hint_type).node_actions;
-    for (auto& action : actions_override) {
-        action.timeout_ms = timeout_ms_override;
+    if (!ValidateHint(hint_id)) {
+        return false;
     }
-    if (!nm_->Request(actions_override, hint_type)) {
+    HintEntry *entry = GetHintEntry(hint_id);
+    LOG(VERBOSE) << "Do Powerhint: " << entry->first << " for "
+                 << timeout_ms.value_or(entry->second.status->max_timeout).count() << "ms";
+    if (!IsHintEnabled(hint_id) ||
+        !nm_->Request(entry->second.node_actions, hint_id, timeout_ms)) {
         return false;
     }
-    DoHintStatus(hint_type, timeout_ms_override);
-    DoHintAction(hint_type);
+    DoHintStatus(entry, timeout_ms.value_or(entry->second.status->max_timeout));
+    DoHintAction(hint_id, entry);
+    if (boost_monitor_ != nullptr) {
+        boost_monitor_->Wake();
+    }
     return true;
 }
 
-bool HintManager::EndHint(const std::string& hint_type) {
-    LOG(VERBOSE) << "End Powerhint: " << hint_type;
-    if (!ValidateHint(hint_type) || !nm_->Cancel(actions_.at(hint_type).node_actions, hint_type)) {
+bool HintManager::EndHint(HintId hint_id) {
+    if (retired_.load(std::memory_order_acquire)) {
+        return GetInstance()->EndHint(hint_id);
+    }
+    if (!ValidateHint(hint_id)) {
+        return false;
+    }
+    HintEntry *entry = GetHintEntry(hint_id);
+    LOG(VERBOSE) << "End Powerhint: " << entry->first;
+    if (!nm_->Cancel(entry->second.node_actions, hint_id)) {
         return false;
     }
-    EndHintStatus(hint_type);
-    EndHintAction(hint_type);
+    EndHintStatus(entry);
+    EndHintAction(hint_id, entry);
     return true;
 }
 
+bool HintManager::SetHints(const std::vector<std::pair<HintId, bool>> &hints) {
+    if (retired_.load(std::memory_order_acquire)) {
+        return GetInstance()->SetHints(hints);
+    }
+    if (nm_.get() == nullptr) {
+        LOG(ERROR) << "NodeLooperThread not present";
+        return false;
+    }
+    bool ret = true;
+    nm_->BeginBatch();
+    for (const auto &[hint_id, enabled] : hints) {
+        ret &= enabled ? DoHint(hint_id) : EndHint(hint_id);
+    }
+    nm_->EndBatch();
+    return ret;
+}
+
 bool HintManager::IsRunning() const {
     return (nm_.get() == nullptr) ? false : nm_->isRunning();
 }
@@ -218,8 +437,7 @@ std::vector<std::string> HintManager::GetHints() const {
 
 HintStats HintManager::GetHintStats(const std::string &hint_type) const {
     HintStats hint_stats;
-    if (ValidateHint(hint_type)) {
-        std::lock_guard<std::mutex> lock(actions_.at(hint_type).hint_lock);
+    if (ValidateHint(LookupHint(hint_type))) {
         hint_stats.count =
                 actions_.at(hint_type).status->stats.count.load(std::memory_order_relaxed);
         hint_stats.duration_ms =
@@ -234,6 +452,13 @@ void HintManager::DumpToFd(int fd) {
         LOG(ERROR) << "Failed to dump fd: " << fd;
     }
     nm_->DumpToFd(fd);
+    const int32_t severity = std::clamp(nm_->GetThermalSeverity(), 0, kThermalSeverityCount - 1);
+    if (!android::base::WriteStringToFd(
+                android::base::StringPrintf("Thermal severity: %s\n",
+                                            kThermalSeverityNames[severity]),
+                fd)) {
+        LOG(ERROR) << "Failed to dump fd: " << fd;
+    }
     std::string footer("==========  End perfmgr nodes  ==========\n");
     if (!android::base::WriteStringToFd(footer, fd)) {
         LOG(ERROR) << "Failed to dump fd: " << fd;
@@ -261,6 +486,53 @@ void HintManager::DumpToFd(int fd) {
     if (!android::base::WriteStringToFd(footer, fd)) {
         LOG(ERROR) << "Failed to dump fd: " << fd;
     }
+    if (boost_monitor_ != nullptr) {
+        header = "========== Begin perfmgr boost feedback ==========\n"
+                 "Hint Name\t"
+                 "Samples\t"
+                 "Effective\t"
+                 "Clipped\t"
+                 "Below\n";
+        if (!android::base::WriteStringToFd(header, fd)) {
+            LOG(ERROR) << "Failed to dump fd: " << fd;
+        }
+        std::string boost_stats_string;
+        for (const auto &ordered_key : keys) {
+            const BoostStats &boost = actions_.at(ordered_key).status->boost;
+            const uint64_t samples = boost.samples.load(std::memory_order_relaxed);
+            if (samples == 0) {
+                continue;
+            }
+            boost_stats_string += android::base::StringPrintf(
+                    "%s\t%" PRIu64 "\t%" PRIu64 "%%\t%" PRIu64 "%%\t%" PRIu64 "%%\n",
+                    ordered_key.c_str(), samples,
+                    boost.effective.load(std::memory_order_relaxed) * 100 / samples,
+                    boost.clipped.load(std::memory_order_relaxed) * 100 / samples,
+                    boost.below.load(std::memory_order_relaxed) * 100 / samples);
+        }
+        if (!android::base::WriteStringToFd(boost_stats_string, fd)) {
+            LOG(ERROR) << "Failed to dump fd: " << fd;
+        }
+        footer = "==========  End perfmgr boost feedback  ==========\n";
+        if (!android::base::WriteStringToFd(footer, fd)) {
+            LOG(ERROR) << "Failed to dump fd: " << fd;
+        }
+    }
+    header = "========== Begin perfmgr latency ==========\n"
+             "Interval\t"
+             "Count\t"
+             "p50 (us)\t"
+             "p90 (us)\t"
+             "p99 (us)\t"
+             "Max (us)\n";
+    if (!android::base::WriteStringToFd(header, fd)) {
+        LOG(ERROR) << "Failed to dump fd: " << fd;
+    }
+    nm_->DumpLatencyToFd(fd);
+    footer = "==========  End perfmgr latency  ==========\n";
+    if (!android::base::WriteStringToFd(footer, fd)) {
+        LOG(ERROR) << "Failed to dump fd: " << fd;
+    }
 
     // Dump current ADPF profile
     if (GetAdpfProfile()) {
@@ -281,7 +553,9 @@ bool HintManager::Start() {
     return nm_->Start();
 }
 
-std::unique_ptr<HintManager> HintManager::sInstance = nullptr;
+std::atomic<HintManager *> HintManager::sInstance = nullptr;
+std::mutex HintManager::sInstanceLock;
+std::vector<std::unique_ptr<HintManager>> HintManager::sInstances;
 
 void HintManager::Reload(bool start) {
     std::string config_path = "/vendor/etc/";
@@ -292,99 +566,218 @@ void HintManager::Reload(bool start) {
     config_path.append(
             android::base::GetProperty(kConfigProperty.data(), kConfigDefaultFileName.data()));
 
+    if (sInstance.load(std::memory_order_acquire) != nullptr) {
+        // Switch the running instance over, keeping the current config on error
+        if (!HintManager::ReloadFromJSON(config_path)) {
+            LOG(ERROR) << "Failed to reload config: " << config_path;
+        }
+        return;
+    }
+
     LOG(INFO) << "Pixel Power HAL AIDL Service with Extension is starting with config: "
               << config_path;
-    // Reload and start the HintManager
-    HintManager::GetFromJSON(config_path, start);
-    if (!sInstance) {
+    // Load and start the HintManager
+    if (HintManager::GetFromJSON(config_path, start) == nullptr) {
         LOG(FATAL) << "Invalid config: " << config_path;
     }
 }
 
 HintManager *HintManager::GetInstance() {
-    if (sInstance == nullptr) {
+    HintManager *hm = sInstance.load(std::memory_order_acquire);
+    if (hm == nullptr) {
         HintManager::Reload(false);
+        hm = sInstance.load(std::memory_order_acquire);
     }
-    return sInstance.get();
+    return hm;
 }
 
-static std::optional<std::string> ParseGpuSysfsNode(const std::string &json_doc) {
-    Json::Value root;
-    Json::CharReaderBuilder builder;
-    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
-    std::string errorMessage;
-    if (!reader->parse(&*json_doc.begin(), &*json_doc.end(), &root, &errorMessage)) {
-        LOG(ERROR) << "Failed to parse JSON config: " << errorMessage;
-        return {};
+void HintManager::Publish(std::unique_ptr<HintManager> hm) {
+    HintManager *old = sInstance.load(std::memory_order_relaxed);
+    sInstances.push_back(std::move(hm));
+    sInstance.store(sInstances.back().get(), std::memory_order_release);
+    if (old != nullptr) {
+        // Publish first, so requests forwarded by old find the new instance
+        old->retired_.store(true, std::memory_order_release);
     }
+}
 
+static std::optional<std::string> ParseGpuSysfsNode(const Json::Value &root) {
     if (root["GpuSysfsPath"].empty() || !root["GpuSysfsPath"].isString()) {
         return {};
     }
     return {root["GpuSysfsPath"].asString()};
 }
 
-HintManager *HintManager::GetFromJSON(const std::string &config_path, bool start) {
-    std::string json_doc;
+std::string HintManager::GetConfigCachePath(const std::string &config_path) {
+    return config_path + kConfigCacheSuffix.data();
+}
 
-    if (!android::base::ReadFileToString(config_path, &json_doc)) {
-        LOG(ERROR) << "Failed to read JSON config from " << config_path;
-        return nullptr;
+uint64_t HintManager::GetConfigKey(const std::string &json_doc) {
+    // The Truncate default comes from a property, so it's part of the key.
+    const bool truncate = android::base::GetBoolProperty(kPowerHalTruncateProp, true);
+    return ConfigCache::Hash(json_doc, ConfigCache::Hash(truncate ? "1" : "0"));
+}
+
+bool HintManager::ParseJson(const std::string &json_doc, Json::Value *root) {
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    std::string errorMessage;
+    if (!reader->parse(&*json_doc.begin(), &*json_doc.end(), root, &errorMessage)) {
+        LOG(ERROR) << "Failed to parse JSON config: " << errorMessage;
+        return false;
+    }
+    return true;
+}
+
+bool HintManager::ParseConfig(const std::string &json_doc, const std::string &config_path,
+                              PowerConfig *config) {
+    Json::Value root;
+    if (!ParseJson(json_doc, &root)) {
+        return false;
     }
 
-    std::vector<std::unique_ptr<Node>> nodes = ParseNodes(json_doc);
-    if (nodes.empty()) {
+    config->nodes = ParseNodes(root);
+    if (config->nodes.empty()) {
         LOG(ERROR) << "Failed to parse Nodes section from " << config_path;
-        return nullptr;
+        return false;
     }
-    std::vector<std::shared_ptr<AdpfConfig>> adpfs = HintManager::ParseAdpfConfigs(json_doc);
-    if (adpfs.empty()) {
+    config->adpfs = HintManager::ParseAdpfConfigs(root);
+    if (config->adpfs.empty()) {
         LOG(INFO) << "No AdpfConfig section in the " << config_path;
     }
 
-    std::unordered_map<std::string, Hint> actions = HintManager::ParseActions(json_doc, nodes);
-
-    if (actions.empty()) {
+    config->actions = HintManager::ParseActions(root, config->nodes);
+    if (config->actions.empty()) {
         LOG(ERROR) << "Failed to parse Actions section from " << config_path;
-        return nullptr;
+        return false;
     }
 
-    auto const gpu_sysfs_node = ParseGpuSysfsNode(json_doc);
+    config->gpu_sysfs_config_path = ParseGpuSysfsNode(root);
+    return true;
+}
 
-    sp<NodeLooperThread> nm = new NodeLooperThread(std::move(nodes));
-    sInstance = std::make_unique<HintManager>(std::move(nm), actions, adpfs, gpu_sysfs_node);
+bool HintManager::LoadConfig(const std::string &config_path, PowerConfig *config) {
+    std::string json_doc;
 
-    if (!HintManager::InitHintStatus(sInstance)) {
+    if (!android::base::ReadFileToString(config_path, &json_doc)) {
+        LOG(ERROR) << "Failed to read JSON config from " << config_path;
+        return false;
+    }
+
+    const std::string cache_path = GetConfigCachePath(config_path);
+    if (ConfigCache::Load(cache_path, GetConfigKey(json_doc), config)) {
+        LOG(INFO) << "Loaded compiled config: " << cache_path;
+        return true;
+    }
+    *config = PowerConfig();
+    return ParseConfig(json_doc, config_path, config);
+}
+
+HintManager *HintManager::GetFromJSON(const std::string &config_path, bool start) {
+    PowerConfig config;
+    if (!LoadConfig(config_path, &config)) {
+        return nullptr;
+    }
+
+    const std::chrono::microseconds coalesce_window(
+            android::base::GetUintProperty<uint32_t>(kPowerHalCoalesceWindowUsProp, 0));
+    const auto boost_targets = FindBoostTargets(config);
+    sp<NodeLooperThread> nm = new NodeLooperThread(std::move(config.nodes), coalesce_window);
+    auto hm = std::make_unique<HintManager>(std::move(nm), config.actions, config.adpfs,
+                                            config.gpu_sysfs_config_path);
+
+    if (!HintManager::InitHintStatus(hm)) {
         LOG(ERROR) << "Failed to initialize hint status";
         return nullptr;
     }
+    InitBoostMonitor(hm, boost_targets);
 
     LOG(INFO) << "Initialized HintManager from JSON config: " << config_path;
 
     if (start) {
-        sInstance->Start();
+        hm->Start();
+    }
+
+    HintManager *instance = hm.get();
+    std::lock_guard<std::mutex> lock(sInstanceLock);
+    HintManager *old = sInstance.load(std::memory_order_relaxed);
+    // The replaced instance has a looper of its own, which is done now
+    if (old != nullptr && old->nm_.get() != nullptr) {
+        old->nm_->Stop();
+    }
+    if (old != nullptr && old->boost_monitor_ != nullptr) {
+        old->boost_monitor_->Stop();
+    }
+    Publish(std::move(hm));
+    return instance;
+}
+
+bool HintManager::ReloadFromJSON(const std::string &config_path) {
+    std::unique_lock<std::mutex> lock(sInstanceLock);
+    HintManager *current = sInstance.load(std::memory_order_relaxed);
+    if (current == nullptr || current->nm_.get() == nullptr) {
+        lock.unlock();
+        return GetFromJSON(config_path) != nullptr;
+    }
+
+    PowerConfig config;
+    if (!LoadConfig(config_path, &config)) {
+        LOG(ERROR) << "Keep current config, failed to reload " << config_path;
+        return false;
+    }
+
+    sp<NodeLooperThread> nm = current->nm_;
+    auto hm = std::make_unique<HintManager>(nm, config.actions, config.adpfs,
+                                            config.gpu_sysfs_config_path);
+    if (!HintManager::InitHintStatus(hm)) {
+        LOG(ERROR) << "Failed to initialize hint status";
+        return false;
     }
+    std::unordered_map<HintId, std::vector<NodeAction>> node_actions;
+    for (auto &[hint_type, hint] : hm->actions_) {
+        node_actions.emplace(HintIdTable::Intern(hint_type), hint.node_actions);
+        // Keep the stats and active interval of hints whose timeout didn't change
+        auto old = current->actions_.find(hint_type);
+        if (old != current->actions_.end() &&
+            old->second.status->max_timeout == hint.status->max_timeout) {
+            hint.status = old->second.status;
+        }
+    }
+    if (!current->adpfs_.empty()) {
+        hm->SetAdpfProfile(current->GetAdpfProfile()->mName);
+    }
+    hm->CarryOverMasks(*current);
+    InitBoostMonitor(hm, FindBoostTargets(config));
 
-    return HintManager::GetInstance();
+    if (!nm->Reload(std::move(config.nodes), node_actions)) {
+        return false;
+    }
+    // Hints carried over keep their status, only the new monitor counts them
+    if (current->boost_monitor_ != nullptr) {
+        current->boost_monitor_->Stop();
+    }
+    Publish(std::move(hm));
+
+    LOG(INFO) << "Reloaded HintManager from JSON config: " << config_path;
+    return true;
 }
 
 std::vector<std::unique_ptr<Node>> HintManager::ParseNodes(
     const std::string& json_doc) {
+    Json::Value root;
+    if (!ParseJson(json_doc, &root)) {
+        return {};
+    }
+    return ParseNodes(root);
+}
+
+std::vector<std::unique_ptr<Node>> HintManager::ParseNodes(const Json::Value &root) {
     // function starts
     std::vector<std::unique_ptr<Node>> nodes_parsed;
     std::set<std::string> nodes_name_parsed;
     std::set<std::string> nodes_path_parsed;
-    Json::Value root;
-    Json::CharReaderBuilder builder;
-    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
-    std::string errorMessage;
 
-    if (!reader->parse(&*json_doc.begin(), &*json_doc.end(), &root, &errorMessage)) {
-        LOG(ERROR) << "Failed to parse JSON config: " << errorMessage;
-        return nodes_parsed;
-    }
-
-    Json::Value nodes = root["Nodes"];
+    const Json::Value &nodes = root["Nodes"];
     for (Json::Value::ArrayIndex i = 0; i < nodes.size(); ++i) {
         std::string name = nodes[i]["Name"].asString();
         LOG(VERBOSE) << "Node[" << i << "]'s Name: " << name;
@@ -492,6 +885,12 @@ std::vector<std::unique_ptr<Node>> HintManager::ParseNodes(
         LOG(VERBOSE) << "Node[" << i << "]'s ResetOnInit: " << std::boolalpha
                      << reset << std::noboolalpha;
 
+        std::string depends_on = nodes[i]["DependsOn"].asString();
+        LOG(VERBOSE) << "Node[" << i << "]'s DependsOn: " << depends_on;
+
+        std::string write_lane = nodes[i]["WriteLane"].asString();
+        LOG(VERBOSE) << "Node[" << i << "]'s WriteLane: " << write_lane;
+
         if (is_file) {
             bool truncate = android::base::GetBoolProperty(kPowerHalTruncateProp, true);
             if (nodes[i]["Truncate"].empty() || !nodes[i]["Truncate"].isBool()) {
@@ -522,14 +921,57 @@ std::vector<std::unique_ptr<Node>> HintManager::ParseNodes(
             LOG(VERBOSE) << "Node[" << i << "]'s WriteOnly: " << std::boolalpha
                          << write_only << std::noboolalpha;
 
+            bool cache_fd = false;
+            if (nodes[i]["CacheFd"].empty() || !nodes[i]["CacheFd"].isBool()) {
+                LOG(INFO) << "Failed to read Node[" << i << "]'s CacheFd, set to 'false'";
+            } else {
+                cache_fd = nodes[i]["CacheFd"].asBool();
+            }
+            LOG(VERBOSE) << "Node[" << i << "]'s CacheFd: " << std::boolalpha << cache_fd
+                         << std::noboolalpha;
+
             nodes_parsed.emplace_back(std::make_unique<FileNode>(
                     name, path, values_parsed, static_cast<std::size_t>(default_index), reset,
-                    truncate, hold_fd, write_only));
+                    truncate, hold_fd, write_only, cache_fd));
         } else {
             nodes_parsed.emplace_back(std::make_unique<PropertyNode>(
                 name, path, values_parsed,
                 static_cast<std::size_t>(default_index), reset));
         }
+        nodes_parsed.back()->SetDependsOn(depends_on);
+        nodes_parsed.back()->SetWriteLane(write_lane);
+    }
+
+    // Validate dependencies: must refer to another known node, without cycle
+    std::map<std::string, std::size_t> nodes_index;
+    for (std::size_t i = 0; i < nodes_parsed.size(); ++i) {
+        nodes_index[nodes_parsed[i]->GetName()] = i;
+    }
+    for (std::size_t i = 0; i < nodes_parsed.size(); ++i) {
+        std::size_t current = i;
+        for (std::size_t depth = 0; !nodes_parsed[current]->GetDependsOn().empty(); ++depth) {
+            const std::string& depends_on = nodes_parsed[current]->GetDependsOn();
+            if (nodes_index.find(depends_on) == nodes_index.end()) {
+                LOG(ERROR) << "Failed to find Node[" << current << "]'s DependsOn: [" << depends_on
+                           << "]";
+                nodes_parsed.clear();
+                return nodes_parsed;
+            }
+            const std::size_t next = nodes_index[depends_on];
+            // Ordering is only kept within a lane
+            if (nodes_parsed[next]->GetWriteLane() != nodes_parsed[current]->GetWriteLane()) {
+                LOG(ERROR) << "Node[" << current << "]'s DependsOn: [" << depends_on
+                           << "] is on another WriteLane";
+                nodes_parsed.clear();
+                return nodes_parsed;
+            }
+            current = next;
+            if (current == i || depth >= nodes_parsed.size()) {
+                LOG(ERROR) << "Node[" << i << "]'s DependsOn forms a cycle";
+                nodes_parsed.clear();
+                return nodes_parsed;
+            }
+        }
     }
     LOG(INFO) << nodes_parsed.size() << " Nodes parsed successfully";
     return nodes_parsed;
@@ -537,19 +979,19 @@ std::vector<std::unique_ptr<Node>> HintManager::ParseNodes(
 
 std::unordered_map<std::string, Hint> HintManager::ParseActions(
         const std::string &json_doc, const std::vector<std::unique_ptr<Node>> &nodes) {
-    // function starts
-    std::unordered_map<std::string, Hint> actions_parsed;
     Json::Value root;
-    Json::CharReaderBuilder builder;
-    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
-    std::string errorMessage;
-
-    if (!reader->parse(&*json_doc.begin(), &*json_doc.end(), &root, &errorMessage)) {
-        LOG(ERROR) << "Failed to parse JSON config";
-        return actions_parsed;
+    if (!ParseJson(json_doc, &root)) {
+        return {};
     }
+    return ParseActions(root, nodes);
+}
 
-    Json::Value actions = root["Actions"];
+std::unordered_map<std::string, Hint> HintManager::ParseActions(
+        const Json::Value &root, const std::vector<std::unique_ptr<Node>> &nodes) {
+    // function starts
+    std::unordered_map<std::string, Hint> actions_parsed;
+
+    const Json::Value &actions = root["Actions"];
     std::size_t total_parsed = 0;
 
     std::map<std::string, std::size_t> nodes_index;
@@ -612,6 +1054,45 @@ std::unordered_map<std::string, Hint> HintManager::ParseActions(
             }
             LOG(VERBOSE) << "Action[" << i << "]'s ValueIndex: " << value_index;
 
+            // Values by thermal severity, a severity without its own value
+            // keeps the one of the severity below
+            std::vector<std::size_t> thermal_value_index;
+            const Json::Value &thermal_values = actions[i]["ThermalValues"];
+            if (!thermal_values.empty()) {
+                if (!thermal_values.isObject()) {
+                    LOG(ERROR) << "Failed to read Action[" << i << "]'s ThermalValues";
+                    actions_parsed.clear();
+                    return actions_parsed;
+                }
+                for (const auto &severity_name : thermal_values.getMemberNames()) {
+                    if (std::find(std::begin(kThermalSeverityNames) + 1,
+                                  std::end(kThermalSeverityNames),
+                                  severity_name) == std::end(kThermalSeverityNames)) {
+                        LOG(ERROR) << "Action[" << i << "]'s ThermalValues has invalid severity "
+                                   << severity_name;
+                        actions_parsed.clear();
+                        return actions_parsed;
+                    }
+                }
+                thermal_value_index.assign(kThermalSeverityCount, value_index);
+                for (int32_t s = 1; s < kThermalSeverityCount; ++s) {
+                    thermal_value_index[s] = thermal_value_index[s - 1];
+                    const Json::Value &thermal_value = thermal_values[kThermalSeverityNames[s]];
+                    if (thermal_value.empty()) {
+                        continue;
+                    }
+                    if (!thermal_value.isString() ||
+                        !nodes[node_index]->GetValueIndex(thermal_value.asString(),
+                                                          &thermal_value_index[s])) {
+                        LOG(ERROR) << "Action[" << i << "]'s ThermalValues "
+                                   << kThermalSeverityNames[s] << " is not defined in Node["
+                                   << node_name << "]";
+                        actions_parsed.clear();
+                        return actions_parsed;
+                    }
+                }
+            }
+
             Json::UInt64 duration = 0;
             if (actions[i]["Duration"].empty() || !actions[i]["Duration"].isUInt64()) {
                 LOG(ERROR) << "Failed to read Action[" << i << "]'s Duration";
@@ -633,6 +1114,8 @@ std::unordered_map<std::string, Hint> HintManager::ParseActions(
             }
             actions_parsed[hint_type].node_actions.emplace_back(
                     node_index, value_index, std::chrono::milliseconds(duration), enable_property);
+            actions_parsed[hint_type].node_actions.back().thermal_value_index =
+                    std::move(thermal_value_index);
 
         } else {
             const std::string &hint_value = actions[i]["Value"].asString();
@@ -681,6 +1164,14 @@ std::unordered_map<std::string, Hint> HintManager::ParseActions(
 
 std::vector<std::shared_ptr<AdpfConfig>> HintManager::ParseAdpfConfigs(
         const std::string &json_doc) {
+    Json::Value root;
+    if (!ParseJson(json_doc, &root)) {
+        return {};
+    }
+    return ParseAdpfConfigs(root);
+}
+
+std::vector<std::shared_ptr<AdpfConfig>> HintManager::ParseAdpfConfigs(const Json::Value &root) {
     // function starts
     bool pidOn;
     double pidPOver;
@@ -704,15 +1195,7 @@ std::vector<std::shared_ptr<AdpfConfig>> HintManager::ParseAdpfConfigs(
 
     std::vector<std::shared_ptr<AdpfConfig>> adpfs_parsed;
     std::set<std::string> name_parsed;
-    Json::Value root;
-    Json::CharReaderBuilder builder;
-    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
-    std::string errorMessage;
-    if (!reader->parse(&*json_doc.begin(), &*json_doc.end(), &root, &errorMessage)) {
-        LOG(ERROR) << "Failed to parse JSON config: " << errorMessage;
-        return adpfs_parsed;
-    }
-    Json::Value adpfs = root["AdpfConfig"];
+    const Json::Value &adpfs = root["AdpfConfig"];
     for (Json::Value::ArrayIndex i = 0; i < adpfs.size(); ++i) {
         std::optional<bool> gpuBoost;
         std::optional<uint64_t> gpuBoostCapacityMax;
@@ -748,6 +1231,30 @@ std::vector<std::shared_ptr<AdpfConfig>> HintManager::ParseAdpfConfigs(
         std::optional<int32_t> uclampMaxEfficientBase;
         std::optional<int32_t> uclampMaxEfficientOffset;
 
+        // predictive boost configs
+        std::optional<bool> predictiveBoostOn;
+        std::optional<uint32_t> predictiveBoostUclampMin;
+
+        std::optional<uint32_t> workerThreads;
+
+        std::optional<double> gpuCapacityFilterUp;
+        std::optional<double> gpuCapacityFilterDown;
+
+        // energy aware configs
+        std::optional<bool> energyAwareOn;
+        std::optional<uint32_t> energyAwareUclampStep;
+        std::optional<uint32_t> energyAwareWindowFrames;
+
+        // thread placement configs
+        std::optional<std::string> sessionTaskProfile;
+        std::optional<std::string> sessionTaskProfileRevert;
+        std::optional<std::string> sessionTaskProfileTags;
+
+        // CPU/GPU co-boost configs
+        std::optional<bool> gpuCoBoostOn;
+        std::optional<double> gpuCoBoostFactor;
+        std::optional<uint32_t> gpuCoBoostFrames;
+
         ADPF_PARSE(pidOn, "PID_On", Bool);
         ADPF_PARSE(pidPOver, "PID_Po", Double);
         ADPF_PARSE(pidPUnder, "PID_Pu", Double);
@@ -780,6 +1287,20 @@ std::vector<std::shared_ptr<AdpfConfig>> HintManager::ParseAdpfConfigs(
         ADPF_PARSE_OPTIONAL(maxRecordsNum, "MaxRecordsNum", UInt);
         ADPF_PARSE_OPTIONAL(uclampMaxEfficientBase, "UclampMax_EfficientBase", Int);
         ADPF_PARSE_OPTIONAL(uclampMaxEfficientOffset, "UclampMax_EfficientOffset", Int);
+        ADPF_PARSE_OPTIONAL(predictiveBoostOn, "PredictiveBoost_On", Bool);
+        ADPF_PARSE_OPTIONAL(predictiveBoostUclampMin, "PredictiveBoostUclampMin", UInt);
+        ADPF_PARSE_OPTIONAL(workerThreads, "WorkerThreads", UInt);
+        ADPF_PARSE_OPTIONAL(gpuCapacityFilterUp, "GpuCapacityFilterUp", Double);
+        ADPF_PARSE_OPTIONAL(gpuCapacityFilterDown, "GpuCapacityFilterDown", Double);
+        ADPF_PARSE_OPTIONAL(energyAwareOn, "EnergyAware_On", Bool);
+        ADPF_PARSE_OPTIONAL(energyAwareUclampStep, "EnergyAwareUclampStep", UInt);
+        ADPF_PARSE_OPTIONAL(energyAwareWindowFrames, "EnergyAwareWindowFrames", UInt);
+        ADPF_PARSE_OPTIONAL(sessionTaskProfile, "SessionTaskProfile", String);
+        ADPF_PARSE_OPTIONAL(sessionTaskProfileRevert, "SessionTaskProfileRevert", String);
+        ADPF_PARSE_OPTIONAL(sessionTaskProfileTags, "SessionTaskProfileTags", String);
+        ADPF_PARSE_OPTIONAL(gpuCoBoostOn, "GpuCoBoost_On", Bool);
+        ADPF_PARSE_OPTIONAL(gpuCoBoostFactor, "GpuCoBoostFactor", Double);
+        ADPF_PARSE_OPTIONAL(gpuCoBoostFrames, "GpuCoBoostFrames", UInt);
 
         if (!adpfs[i]["GpuBoost"].empty() && adpfs[i]["GpuBoost"].isBool()) {
             gpuBoost = adpfs[i]["GpuBoost"].asBool();
@@ -806,6 +1327,43 @@ std::vector<std::shared_ptr<AdpfConfig>> HintManager::ParseAdpfConfigs(
             }
         }
 
+        // The predictive boost learns from the same session records as the
+        // heuristic boost.
+        if (predictiveBoostOn.has_value()) {
+            if (!predictiveBoostUclampMin.has_value() || !jankCheckTimeFactor.has_value() ||
+                !maxRecordsNum.has_value()) {
+                LOG(ERROR) << "Part of the predictive boost configurations are missing!";
+                adpfs_parsed.clear();
+                return adpfs_parsed;
+            }
+        }
+
+        if (energyAwareOn.has_value()) {
+            if (!energyAwareUclampStep.has_value() || !energyAwareWindowFrames.has_value() ||
+                energyAwareUclampStep.value() == 0 || energyAwareWindowFrames.value() == 0) {
+                LOG(ERROR) << "Part of the energy aware configurations are missing!";
+                adpfs_parsed.clear();
+                return adpfs_parsed;
+            }
+        }
+
+        // The co-boost is a share of the GPU boost capacity
+        if (gpuCoBoostOn.has_value()) {
+            if (!gpuCoBoostFactor.has_value() || !gpuCoBoostFrames.has_value() ||
+                !gpuBoostCapacityMax.has_value() || gpuCoBoostFactor.value() <= 0.0 ||
+                gpuCoBoostFrames.value() == 0) {
+                LOG(ERROR) << "Part of the GPU co-boost configurations are missing!";
+                adpfs_parsed.clear();
+                return adpfs_parsed;
+            }
+        }
+
+        if (sessionTaskProfile.has_value() != sessionTaskProfileRevert.has_value()) {
+            LOG(ERROR) << "Part of the thread placement configurations are missing!";
+            adpfs_parsed.clear();
+            return adpfs_parsed;
+        }
+
         if (uclampMaxEfficientBase.has_value() != uclampMaxEfficientBase.has_value()) {
             LOG(ERROR) << "Part of the power efficiency configuration is missing!";
             adpfs_parsed.clear();
@@ -827,7 +1385,11 @@ std::vector<std::shared_ptr<AdpfConfig>> HintManager::ParseAdpfConfigs(
                 gpuCapacityLoadUpHeadroom, heuristicBoostOn, hBoostOnMissedCycles,
                 hBoostOffMaxAvgRatio, hBoostOffMissedCycles, hBoostPidPuFactor, hBoostUclampMin,
                 jankCheckTimeFactor, lowFrameRateThreshold, maxRecordsNum, uclampMinLoadUp.value(),
-                uclampMinLoadReset.value(), uclampMaxEfficientBase, uclampMaxEfficientOffset));
+                uclampMinLoadReset.value(), uclampMaxEfficientBase, uclampMaxEfficientOffset,
+                predictiveBoostOn, predictiveBoostUclampMin, workerThreads, gpuCapacityFilterUp,
+                gpuCapacityFilterDown, energyAwareOn, energyAwareUclampStep,
+                energyAwareWindowFrames, sessionTaskProfile, sessionTaskProfileRevert,
+                sessionTaskProfileTags, gpuCoBoostOn, gpuCoBoostFactor, gpuCoBoostFrames));
     }
     LOG(INFO) << adpfs_parsed.size() << " AdpfConfigs parsed successfully";
     return adpfs_parsed;
@@ -839,6 +1401,13 @@ std::shared_ptr<AdpfConfig> HintManager::GetAdpfProfile() const {
     return adpfs_[adpf_index_];
 }
 
+void HintManager::SetThermalSeverity(int32_t severity) {
+    if (nm_->GetThermalSeverity() != severity) {
+        LOG(VERBOSE) << "Thermal severity of node actions: " << severity;
+        nm_->SetThermalSeverity(severity);
+    }
+}
+
 bool HintManager::SetAdpfProfile(const std::string &profile_name) {
     for (std::size_t i = 0; i < adpfs_.size(); ++i) {
         if (adpfs_[i]->mName == profile_name) {
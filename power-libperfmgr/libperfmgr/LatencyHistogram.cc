@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specic language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "perfmgr/LatencyHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace android {
+namespace perfmgr {
+
+LatencyHistogram::LatencyHistogram() : count_(0), max_us_(0) {
+    for (auto &bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+std::size_t LatencyHistogram::GetBucketIndex(uint64_t value_us) {
+    if (value_us < kSubBuckets) {
+        return value_us;
+    }
+    const std::size_t exponent = 63 - __builtin_clzll(value_us);
+    if (exponent > kMaxExponent) {
+        return kNumBuckets - 1;
+    }
+    const std::size_t sub = (value_us >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+    return kSubBuckets + (exponent - kSubBucketBits) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::GetBucketUpperBound(std::size_t index) {
+    if (index < kSubBuckets) {
+        return index;
+    }
+    const std::size_t shift = (index - kSubBuckets) / kSubBuckets;
+    const uint64_t sub = (index - kSubBuckets) % kSubBuckets;
+    return ((kSubBuckets + sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(std::chrono::nanoseconds latency) {
+    const uint64_t value_us = static_cast<uint64_t>(std::max<int64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(latency).count(), 0));
+    buckets_[GetBucketIndex(value_us)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    uint64_t max_us = max_us_.load(std::memory_order_relaxed);
+    while (value_us > max_us &&
+           !max_us_.compare_exchange_weak(max_us, value_us, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t LatencyHistogram::GetCount() const {
+    return count_.load(std::memory_order_relaxed);
+}
+
+std::chrono::microseconds LatencyHistogram::GetMax() const {
+    return std::chrono::microseconds(max_us_.load(std::memory_order_relaxed));
+}
+
+std::chrono::microseconds LatencyHistogram::GetPercentile(double percentile) const {
+    // Snapshot the buckets so that concurrent recording can't push the
+    // target rank past the last bucket.
+    std::array<uint32_t, kNumBuckets> snapshot;
+    uint64_t total = 0;
+    for (std::size_t i = 0; i < kNumBuckets; i++) {
+        snapshot[i] = buckets_[i].load(std::memory_order_relaxed);
+        total += snapshot[i];
+    }
+    if (total == 0) {
+        return std::chrono::microseconds(0);
+    }
+    percentile = std::clamp(percentile, 0.0, 100.0);
+    const uint64_t rank = std::max<uint64_t>(
+            1, static_cast<uint64_t>(std::ceil(percentile / 100.0 * static_cast<double>(total))));
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < kNumBuckets; i++) {
+        seen += snapshot[i];
+        if (seen >= rank) {
+            const uint64_t bound = std::min(GetBucketUpperBound(i),
+                                            static_cast<uint64_t>(GetMax().count()));
+            return std::chrono::microseconds(bound);
+        }
+    }
+    return GetMax();
+}
+
+}  // namespace perfmgr
+}  // namespace android
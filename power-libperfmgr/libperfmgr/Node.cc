@@ -23,6 +23,8 @@
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 
+#include <string_view>
+
 namespace android {
 namespace perfmgr {
 
@@ -36,27 +38,81 @@ Node::Node(std::string name, std::string node_path,
       reset_on_init_(reset_on_init),
       current_val_index_(default_val_index) {}
 
-bool Node::AddRequest(std::size_t value_index, const std::string& hint_type,
-                      ReqTime end_time) {
+bool Node::AddRequest(std::size_t value_index, HintId hint_id, ReqTime end_time) {
     if (value_index >= req_sorted_.size()) {
         LOG(ERROR) << "Value index out of bound: " << value_index
                    << " ,size: " << req_sorted_.size();
         return false;
     }
-    // Add/Update request to the new end_time for the specific hint_type
-    req_sorted_[value_index].AddRequest(hint_type, end_time);
+    // Add/Update request to the new end_time for the specific hint
+    req_sorted_[value_index].AddRequest(hint_id, end_time);
     return true;
 }
 
-bool Node::RemoveRequest(const std::string& hint_type) {
+bool Node::RemoveRequest(HintId hint_id) {
     bool ret = false;
-    // Remove all requests for the specific hint_type
+    // Remove all requests for the specific hint
     for (auto& value : req_sorted_) {
-        ret = value.RemoveRequest(hint_type) || ret;
+        ret = value.RemoveRequest(hint_id) || ret;
     }
     return ret;
 }
 
+void Node::TakeRequests(std::vector<std::pair<HintId, ReqTime>>* requests) {
+    for (auto& value : req_sorted_) {
+        value.GetRequests(requests);
+        value.ClearRequests();
+    }
+}
+
+bool Node::IsSameConfig(const Node& other) const {
+    // reset_on_init_ only matters before the first write and is left out
+    return std::string_view(GetType()) == other.GetType() && name_ == other.name_ &&
+           node_path_ == other.node_path_ && GetValues() == other.GetValues() &&
+           default_val_index_ == other.default_val_index_ && depends_on_ == other.depends_on_ &&
+           write_lane_ == other.write_lane_;
+}
+
+void Node::InheritCurrentValue(const Node& other) {
+    std::size_t index;
+    if (GetValueIndex(other.req_sorted_[other.current_val_index_].GetRequestValue(), &index)) {
+        current_val_index_ = index;
+    } else {
+        reset_on_init_ = true;
+    }
+}
+
+std::size_t Node::GetTargetIndex(std::chrono::milliseconds* expire_time) {
+    *expire_time = std::chrono::milliseconds::max();
+    // Find the highest outstanding request's expire time
+    for (std::size_t i = 0; i < req_sorted_.size(); i++) {
+        if (req_sorted_[i].GetExpireTime(expire_time)) {
+            return i;
+        }
+    }
+    return default_val_index_;
+}
+
+std::size_t Node::GetCurrentIndex() const {
+    return current_val_index_;
+}
+
+const std::string& Node::GetDependsOn() const {
+    return depends_on_;
+}
+
+void Node::SetDependsOn(std::string depends_on) {
+    depends_on_ = std::move(depends_on);
+}
+
+const std::string& Node::GetWriteLane() const {
+    return write_lane_;
+}
+
+void Node::SetWriteLane(std::string write_lane) {
+    write_lane_ = std::move(write_lane);
+}
+
 const std::string& Node::GetName() const {
     return name_;
 }
@@ -21,27 +21,211 @@
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
-#include <android-base/properties.h>
+#include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sys/resource.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
+#include <unordered_map>
+
 namespace android {
 namespace perfmgr {
 
-bool NodeLooperThread::Request(const std::vector<NodeAction>& actions,
-                               const std::string& hint_type) {
+NodeLooperThread::NodeLooperThread(std::vector<std::unique_ptr<Node>> nodes,
+                                   std::chrono::microseconds coalesce_window)
+    : Thread(false),
+      nodes_(std::move(nodes)),
+      ordered_(false),
+      lanes_(MakeLanes(nodes_)),
+      first_write_pending_(false),
+      batch_depth_(0),
+      coalesce_window_(coalesce_window),
+      coalesced_wakeups_(0) {
+    InitNodeTables();
+}
+
+std::vector<std::unique_ptr<NodeLooperThread::WriteLane>> NodeLooperThread::MakeLanes(
+        const std::vector<std::unique_ptr<Node>>& nodes) {
+    std::vector<std::unique_ptr<WriteLane>> lanes;
+    lanes.emplace_back(std::make_unique<WriteLane>());
+    for (const auto& node : nodes) {
+        const std::string& write_lane = node->GetWriteLane();
+        if (write_lane.empty() ||
+            std::any_of(lanes.begin(), lanes.end(),
+                        [&write_lane](const auto& lane) { return lane->name == write_lane; })) {
+            continue;
+        }
+        lanes.emplace_back(std::make_unique<WriteLane>());
+        lanes.back()->name = write_lane;
+    }
+    return lanes;
+}
+
+void NodeLooperThread::InitNodeTables() {
+    const std::size_t size = nodes_.size();
+    // Every node is dirty so that the next loop evaluates all of them
+    dirty_.assign(size, true);
+    deadlines_.assign(size, ReqTime::max());
+    depends_on_.assign(size, kNoDependency);
+    dependents_.assign(size, {});
+    ordered_ = false;
+    in_update_.assign(size, false);
+    dependency_first_.assign(size, false);
+    in_degree_.assign(size, 0);
+    numeric_values_.assign(size, {});
+    lane_of_.assign(size, 0);
+    std::unordered_map<std::string, std::size_t> lanes_index;
+    for (std::size_t k = 1; k < lanes_.size(); k++) {
+        lanes_index[lanes_[k]->name] = k;
+    }
+    std::unordered_map<std::string, std::size_t> nodes_index;
+    for (std::size_t i = 0; i < size; i++) {
+        nodes_index[nodes_[i]->GetName()] = i;
+        const std::string& write_lane = nodes_[i]->GetWriteLane();
+        if (!write_lane.empty()) {
+            lane_of_[i] = lanes_index.at(write_lane);
+        }
+        for (const auto& value : nodes_[i]->GetValues()) {
+            int64_t number;
+            numeric_values_[i].emplace_back(android::base::ParseInt(value, &number)
+                                                    ? std::optional<int64_t>(number)
+                                                    : std::nullopt);
+        }
+    }
+    for (std::size_t i = 0; i < size; i++) {
+        const std::string& depends_on = nodes_[i]->GetDependsOn();
+        if (depends_on.empty()) {
+            continue;
+        }
+        auto it = nodes_index.find(depends_on);
+        if (it == nodes_index.end() || it->second == i) {
+            LOG(ERROR) << "Node " << nodes_[i]->GetName() << " has invalid dependency "
+                       << depends_on;
+            continue;
+        }
+        depends_on_[i] = it->second;
+        dependents_[it->second].push_back(i);
+        ordered_ = true;
+    }
+}
+
+bool NodeLooperThread::Reload(std::vector<std::unique_ptr<Node>> nodes,
+                              const std::unordered_map<HintId, std::vector<NodeAction>>& actions) {
+    if (nodes.empty()) {
+        LOG(ERROR) << "Failed to reload NodeLooperThread without nodes";
+        return false;
+    }
+    // Lane threads are started before taking lock_, the looper may sweep with
+    // the new lanes as soon as they are swapped in.
+    std::vector<std::unique_ptr<WriteLane>> lanes = MakeLanes(nodes);
+    const bool same_lanes = std::equal(
+            lanes.begin(), lanes.end(), lanes_.begin(), lanes_.end(),
+            [](const auto& a, const auto& b) { return a->name == b->name; });
+    const bool running = ::android::Thread::isRunning();
+    if (!same_lanes && running) {
+        StartLanes(&lanes);
+    }
+
+    std::size_t kept = 0;
+    std::size_t carried = 0;
+    {
+        ::android::AutoMutex _l(lock_);
+        const ReqTime start = std::chrono::steady_clock::now();
+        std::unordered_map<std::string, std::size_t> old_index;
+        for (std::size_t i = 0; i < nodes_.size(); i++) {
+            old_index[nodes_[i]->GetName()] = i;
+        }
+        std::vector<std::pair<HintId, ReqTime>> requests;
+        for (std::size_t j = 0; j < nodes.size(); j++) {
+            auto it = old_index.find(nodes[j]->GetName());
+            if (it == old_index.end()) {
+                continue;
+            }
+            std::unique_ptr<Node>& old = nodes_[it->second];
+            old_index.erase(it);
+            requests.clear();
+            old->TakeRequests(&requests);
+            if (old->IsSameConfig(*nodes[j])) {
+                // Keep the node object, its value and its open fd
+                nodes[j] = std::move(old);
+                kept++;
+            } else {
+                nodes[j]->InheritCurrentValue(*old);
+            }
+            // Carry over the requests of hints which still act on the node,
+            // with the value and end time of the new action
+            for (const auto& [hint_id, end_time] : requests) {
+                auto hint = actions.find(hint_id);
+                if (hint == actions.end()) {
+                    continue;
+                }
+                for (const auto& a : hint->second) {
+                    if (a.node_index == j &&
+                        nodes[j]->AddRequest(ValueIndex(a), hint_id, end_time)) {
+                        carried++;
+                    }
+                }
+            }
+        }
+        // Restore the default value of the nodes which are gone
+        for (const auto& [name, i] : old_index) {
+            std::vector<std::pair<HintId, ReqTime>> dropped;
+            nodes_[i]->TakeRequests(&dropped);
+            nodes_[i]->Update(true);
+        }
+        nodes_ = std::move(nodes);
+        if (!same_lanes) {
+            lanes_.swap(lanes);
+        }
+        InitNodeTables();
+        wake_cond_.signal();
+        LOG(INFO) << "NodeLooperThread reloaded " << nodes_.size() << " nodes (" << kept
+                  << " kept, " << carried << " requests carried over) in "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(
+                             std::chrono::steady_clock::now() - start)
+                             .count()
+                  << "us";
+    }
+    if (!same_lanes) {
+        // lanes holds the previous lanes now
+        StopLanes(&lanes);
+    }
+    return true;
+}
+
+std::size_t NodeLooperThread::ValueIndex(const NodeAction& action) const {
+    if (action.thermal_value_index.empty()) {
+        return action.value_index;
+    }
+    const int32_t severity =
+            std::clamp(GetThermalSeverity(), 0,
+                       static_cast<int32_t>(action.thermal_value_index.size()) - 1);
+    return action.thermal_value_index[severity];
+}
+
+bool NodeLooperThread::Request(const std::vector<NodeAction>& actions, HintId hint_id,
+                               std::optional<std::chrono::milliseconds> timeout_ms_override) {
+    const ReqTime request_time = std::chrono::steady_clock::now();
+    if (hint_id == kInvalidHintId) {
+        LOG(ERROR) << "Request of an unknown hint";
+        return false;
+    }
     if (::android::Thread::exitPending()) {
         LOG(WARNING) << "NodeLooperThread is exiting";
         return false;
     }
     if (!::android::Thread::isRunning()) {
-        LOG(WARNING) << "NodeLooperThread is not running, request " << hint_type;
+        LOG(WARNING) << "NodeLooperThread is not running, request "
+                     << HintIdTable::GetName(hint_id);
     }
 
     bool ret = true;
     ::android::AutoMutex _l(lock_);
     for (const auto& a : actions) {
-        if (!a.enable_property.empty() &&
-            !android::base::GetBoolProperty(a.enable_property, true)) {
+        if (a.enable_cache != nullptr && !a.enable_cache->Get(true)) {
             // Disabled action based on its control property
             continue;
         }
@@ -50,35 +234,50 @@ bool NodeLooperThread::Request(const std::vector<NodeAction>& actions,
                        << " ,size: " << nodes_.size();
             ret = false;
         } else {
+            const std::chrono::milliseconds timeout_ms = timeout_ms_override.value_or(a.timeout_ms);
             // End time set to steady time point max
             ReqTime end_time = ReqTime::max();
             // Timeout is non-zero
-            if (a.timeout_ms != std::chrono::milliseconds::zero()) {
+            if (timeout_ms != std::chrono::milliseconds::zero()) {
                 auto now = std::chrono::steady_clock::now();
                 // Overflow protection in case timeout_ms is too big to overflow
                 // time point which is unsigned integer
                 if (std::chrono::duration_cast<std::chrono::milliseconds>(
-                        ReqTime::max() - now) > a.timeout_ms) {
-                    end_time = now + a.timeout_ms;
+                        ReqTime::max() - now) > timeout_ms) {
+                    end_time = now + timeout_ms;
                 }
             }
-            ret = nodes_[a.node_index]->AddRequest(a.value_index, hint_type,
-                                                   end_time) &&
-                  ret;
+            if (nodes_[a.node_index]->AddRequest(ValueIndex(a), hint_id, end_time)) {
+                dirty_[a.node_index] = true;
+            } else {
+                ret = false;
+            }
         }
     }
-    wake_cond_.signal();
+    if (pending_since_.has_value() || batch_depth_ > 0) {
+        coalesced_wakeups_.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!pending_since_.has_value()) {
+        pending_since_ = request_time;
+    }
+    if (batch_depth_ == 0) {
+        wake_cond_.signal();
+    }
     return ret;
 }
 
-bool NodeLooperThread::Cancel(const std::vector<NodeAction>& actions,
-                              const std::string& hint_type) {
+bool NodeLooperThread::Cancel(const std::vector<NodeAction>& actions, HintId hint_id) {
+    if (hint_id == kInvalidHintId) {
+        LOG(ERROR) << "Cancel of an unknown hint";
+        return false;
+    }
     if (::android::Thread::exitPending()) {
         LOG(WARNING) << "NodeLooperThread is exiting";
         return false;
     }
     if (!::android::Thread::isRunning()) {
-        LOG(WARNING) << "NodeLooperThread is not running, cancel " << hint_type;
+        LOG(WARNING) << "NodeLooperThread is not running, cancel "
+                     << HintIdTable::GetName(hint_id);
     }
 
     bool ret = true;
@@ -89,13 +288,33 @@ bool NodeLooperThread::Cancel(const std::vector<NodeAction>& actions,
                        << " ,size: " << nodes_.size();
             ret = false;
         } else {
-            nodes_[a.node_index]->RemoveRequest(hint_type);
+            if (nodes_[a.node_index]->RemoveRequest(hint_id)) {
+                dirty_[a.node_index] = true;
+            }
         }
     }
-    wake_cond_.signal();
+    if (batch_depth_ == 0) {
+        wake_cond_.signal();
+    }
     return ret;
 }
 
+void NodeLooperThread::BeginBatch() {
+    ::android::AutoMutex _l(lock_);
+    batch_depth_++;
+}
+
+void NodeLooperThread::EndBatch() {
+    ::android::AutoMutex _l(lock_);
+    if (batch_depth_ == 0) {
+        LOG(ERROR) << "EndBatch without BeginBatch";
+        return;
+    }
+    if (--batch_depth_ == 0) {
+        wake_cond_.signal();
+    }
+}
+
 void NodeLooperThread::DumpToFd(int fd) {
     ::android::AutoMutex _l(lock_);
     for (auto& n : nodes_) {
@@ -103,39 +322,256 @@ void NodeLooperThread::DumpToFd(int fd) {
     }
 }
 
+uint64_t NodeLooperThread::GetCoalescedWakeups() const {
+    return coalesced_wakeups_.load(std::memory_order_relaxed);
+}
+
+void NodeLooperThread::DumpLatencyToFd(int fd) const {
+    std::string dump;
+    const std::pair<const char*, const LatencyHistogram*> histograms[] = {
+            {"RequestToWakeup", &wakeup_latency_},
+            {"WakeupToFirstWrite", &first_write_latency_},
+            {"NodeWrite", &write_latency_},
+    };
+    for (const auto& [name, histogram] : histograms) {
+        dump += android::base::StringPrintf(
+                "%s\t%" PRIu64 "\t%" PRId64 "\t%" PRId64 "\t%" PRId64 "\t%" PRId64 "\n", name,
+                histogram->GetCount(), static_cast<int64_t>(histogram->GetPercentile(50).count()),
+                static_cast<int64_t>(histogram->GetPercentile(90).count()),
+                static_cast<int64_t>(histogram->GetPercentile(99).count()),
+                static_cast<int64_t>(histogram->GetMax().count()));
+    }
+    dump += android::base::StringPrintf("CoalescedWakeups\t%" PRIu64 "\n",
+                                        GetCoalescedWakeups());
+    if (!android::base::WriteStringToFd(dump, fd)) {
+        LOG(ERROR) << "Failed to dump fd: " << fd;
+    }
+}
+
+std::chrono::milliseconds NodeLooperThread::UpdateNode(std::size_t i, bool log_error) {
+    const std::size_t index = nodes_[i]->GetCurrentIndex();
+    const ReqTime start = std::chrono::steady_clock::now();
+    std::chrono::milliseconds expire_time = nodes_[i]->Update(log_error);
+    if (nodes_[i]->GetCurrentIndex() != index) {
+        const ReqTime end = std::chrono::steady_clock::now();
+        write_latency_.Record(end - start);
+        if (first_write_pending_.load(std::memory_order_relaxed) &&
+            first_write_pending_.exchange(false, std::memory_order_relaxed)) {
+            first_write_latency_.Record(end - sweep_time_);
+        }
+    }
+    return expire_time;
+}
+
+void NodeLooperThread::UpdateNodes(const std::vector<std::size_t>& list) {
+    if (!ordered_) {
+        // Update 2 passes: some node may have dependency in other node
+        // e.g. update cpufreq min to VAL while cpufreq max still set to
+        // a value lower than VAL, is expected to fail in first pass
+        for (auto i : list) {
+            UpdateNode(i, false);
+        }
+    }
+    for (auto i : list) {
+        std::chrono::milliseconds expire_time = UpdateNode(i, true);
+        deadlines_[i] =
+                (expire_time == kMaxUpdatePeriod) ? ReqTime::max() : sweep_time_ + expire_time;
+    }
+}
+
+void NodeLooperThread::LaneLoop(WriteLane* lane) {
+    std::unique_lock<std::mutex> lock(lane->lock);
+    while (true) {
+        lane->cond.wait(lock, [lane] { return lane->pending || lane->exit; });
+        if (lane->exit) {
+            return;
+        }
+        lock.unlock();
+        // The looper holds lock_ and waits for this lane, so the nodes and
+        // their deadlines_ entries are owned by this thread meanwhile.
+        UpdateNodes(lane->nodes);
+        lock.lock();
+        lane->pending = false;
+        lane->cond.notify_all();
+    }
+}
+
+void NodeLooperThread::StartLanes(std::vector<std::unique_ptr<WriteLane>>* lanes) {
+    for (std::size_t k = 1; k < lanes->size(); k++) {
+        WriteLane* lane = (*lanes)[k].get();
+        if (lane->thread.joinable()) {
+            continue;
+        }
+        lane->exit = false;
+        lane->thread = std::thread([this, lane] {
+            pthread_setname_np(pthread_self(), ("perfmgr_" + lane->name).substr(0, 15).c_str());
+            if (setpriority(PRIO_PROCESS, 0, PRIORITY_HIGHEST) != 0) {
+                PLOG(WARNING) << "Failed to raise priority of write lane " << lane->name;
+            }
+            LaneLoop(lane);
+        });
+    }
+}
+
+void NodeLooperThread::StopLanes(std::vector<std::unique_ptr<WriteLane>>* lanes) {
+    for (std::size_t k = 1; k < lanes->size(); k++) {
+        WriteLane* lane = (*lanes)[k].get();
+        if (!lane->thread.joinable()) {
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(lane->lock);
+            lane->exit = true;
+        }
+        lane->cond.notify_all();
+        lane->thread.join();
+    }
+}
+
 bool NodeLooperThread::threadLoop() {
     ::android::AutoMutex _l(lock_);
-    std::chrono::milliseconds timeout_ms = kMaxUpdatePeriod;
+    if (coalesce_window_ != std::chrono::microseconds::zero() && pending_since_.has_value()) {
+        // Let the rest of a request burst join this sweep
+        const ReqTime sweep_at = *pending_since_ + coalesce_window_;
+        for (ReqTime t = std::chrono::steady_clock::now(); t < sweep_at && !exitPending();
+             t = std::chrono::steady_clock::now()) {
+            wake_cond_.waitRelative(
+                    lock_, std::chrono::duration_cast<std::chrono::nanoseconds>(sweep_at - t)
+                                   .count());
+        }
+    }
+    ReqTime now = std::chrono::steady_clock::now();
+    sweep_time_ = now;
+    first_write_pending_.store(pending_since_.has_value(), std::memory_order_relaxed);
+    if (pending_since_.has_value()) {
+        const auto wakeup_latency = now - *pending_since_;
+        wakeup_latency_.Record(wakeup_latency);
+        if (ATRACE_ENABLED()) {
+            ATRACE_INT64("perfmgr_wakeup_latency_us",
+                         std::chrono::duration_cast<std::chrono::microseconds>(wakeup_latency)
+                                 .count());
+        }
+        pending_since_.reset();
+    }
+
+    // Only evaluate nodes touched by Request/Cancel or with an expiring
+    // request, everything else keeps its current value.
+    update_list_.clear();
+    for (std::size_t i = 0; i < nodes_.size(); i++) {
+        if (dirty_[i] || deadlines_[i] <= now) {
+            update_list_.push_back(i);
+            dirty_[i] = false;
+        }
+    }
 
-    // Update 2 passes: some node may have dependency in other node
-    // e.g. update cpufreq min to VAL while cpufreq max still set to
-    // a value lower than VAL, is expected to fail in first pass
     ATRACE_BEGIN("update_nodes");
-    for (auto& n : nodes_) {
-        n->Update(false);
+    if (ordered_) {
+        // Dependencies are declared in config, write each node once in order
+        OrderUpdateList();
     }
-    for (auto& n : nodes_) {
-        timeout_ms = std::min(n->Update(true), timeout_ms);
+    if (lanes_.size() == 1) {
+        UpdateNodes(update_list_);
+    } else {
+        // Fan out to the write lanes, keeping the update order within each
+        for (auto& lane : lanes_) {
+            lane->nodes.clear();
+        }
+        for (auto i : update_list_) {
+            lanes_[lane_of_[i]]->nodes.push_back(i);
+        }
+        for (std::size_t k = 1; k < lanes_.size(); k++) {
+            if (lanes_[k]->nodes.empty()) {
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(lanes_[k]->lock);
+                lanes_[k]->pending = true;
+            }
+            lanes_[k]->cond.notify_all();
+        }
+        UpdateNodes(lanes_[0]->nodes);
+        for (std::size_t k = 1; k < lanes_.size(); k++) {
+            std::unique_lock<std::mutex> lock(lanes_[k]->lock);
+            lanes_[k]->cond.wait(lock, [&lane = lanes_[k]] { return !lane->pending; });
+        }
     }
     ATRACE_END();
 
     nsecs_t sleep_timeout_ns = std::numeric_limits<nsecs_t>::max();
-    if (timeout_ms.count() < sleep_timeout_ns / 1000 / 1000) {
-        sleep_timeout_ns = timeout_ms.count() * 1000 * 1000;
+    auto next = std::min_element(deadlines_.begin(), deadlines_.end());
+    if (next != deadlines_.end() && *next != ReqTime::max()) {
+        auto sleep = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                *next - std::chrono::steady_clock::now());
+        sleep_timeout_ns = std::max<nsecs_t>(sleep.count(), 0);
     }
     // VERBOSE level won't print by default in user/userdebug build
-    LOG(VERBOSE) << "NodeLooperThread will wait for " << sleep_timeout_ns
-                 << "ns";
+    LOG(VERBOSE) << "NodeLooperThread updated " << update_list_.size() << " nodes, will wait for "
+                 << sleep_timeout_ns << "ns";
     ATRACE_BEGIN("wait");
     wake_cond_.waitRelative(lock_, sleep_timeout_ns);
     ATRACE_END();
     return true;
 }
 
+void NodeLooperThread::OrderUpdateList() {
+    for (auto i : update_list_) {
+        in_update_[i] = true;
+        in_degree_[i] = 0;
+    }
+    // Orient each dependency edge with both ends being updated: a node moving
+    // above the current value of the node it depends on (e.g. raising min
+    // over current max) needs the dependency written first; otherwise the
+    // node is written first (e.g. lowering min before lowering max).
+    for (auto i : update_list_) {
+        const std::size_t dep = depends_on_[i];
+        if (dep == kNoDependency || !in_update_[dep]) {
+            continue;
+        }
+        std::chrono::milliseconds expire_time;
+        const auto& target = numeric_values_[i][nodes_[i]->GetTargetIndex(&expire_time)];
+        const auto& bound = numeric_values_[dep][nodes_[dep]->GetCurrentIndex()];
+        dependency_first_[i] = !target.has_value() || !bound.has_value() || *target > *bound;
+        in_degree_[dependency_first_[i] ? i : dep]++;
+    }
+
+    // Topological sort over the nodes being updated
+    ordered_list_.clear();
+    for (auto i : update_list_) {
+        if (in_degree_[i] == 0) {
+            ordered_list_.push_back(i);
+        }
+    }
+    for (std::size_t pos = 0; pos < ordered_list_.size(); pos++) {
+        const std::size_t n = ordered_list_[pos];
+        for (auto child : dependents_[n]) {
+            if (in_update_[child] && dependency_first_[child] && --in_degree_[child] == 0) {
+                ordered_list_.push_back(child);
+            }
+        }
+        const std::size_t dep = depends_on_[n];
+        if (dep != kNoDependency && in_update_[dep] && !dependency_first_[n] &&
+            --in_degree_[dep] == 0) {
+            ordered_list_.push_back(dep);
+        }
+    }
+
+    for (auto i : update_list_) {
+        // Nodes in a dependency cycle never reach zero in-degree, still
+        // update them rather than dropping the request
+        if (in_degree_[i] != 0) {
+            ordered_list_.push_back(i);
+        }
+        in_update_[i] = false;
+    }
+    update_list_.swap(ordered_list_);
+}
+
 bool NodeLooperThread::Start() {
+    StartLanes(&lanes_);
     auto ret = this->run("NodeLooperThread", PRIORITY_HIGHEST);
     if (ret != NO_ERROR) {
         LOG(ERROR) << "NodeLooperThread start failed: " << ret;
+        StopLanes(&lanes_);
     } else {
         LOG(INFO) << "NodeLooperThread started";
     }
@@ -153,6 +589,7 @@ void NodeLooperThread::Stop() {
         ::android::Thread::join();
         LOG(INFO) << "NodeLooperThread stopped";
     }
+    StopLanes(&lanes_);
 }
 
 }  // namespace perfmgr
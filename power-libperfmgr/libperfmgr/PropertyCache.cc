@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specic language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "libperfmgr"
+
+#include "perfmgr/PropertyCache.h"
+
+#include <sys/system_properties.h>
+
+#include <unordered_map>
+
+namespace android {
+namespace perfmgr {
+
+bool CachedBoolProperty::Unpack(uint64_t cached, bool default_value) {
+    switch (static_cast<android::base::ParseBoolResult>(static_cast<uint32_t>(cached) - 1)) {
+        case android::base::ParseBoolResult::kTrue:
+            return true;
+        case android::base::ParseBoolResult::kFalse:
+            return false;
+        default:
+            return default_value;
+    }
+}
+
+bool CachedBoolProperty::Get(bool default_value) {
+    const prop_info *pi = pi_.load(std::memory_order_acquire);
+    if (pi == nullptr) {
+        // The property area serial changes whenever a property is added, so
+        // only retry the lookup of a missing property after that.
+        if (missing_area_serial_.load(std::memory_order_acquire) ==
+            uint64_t{__system_property_area_serial()} + 1) {
+            return default_value;
+        }
+        return Refresh(default_value);
+    }
+    const uint64_t cached = cached_.load(std::memory_order_acquire);
+    if (cached == 0 || __system_property_serial(pi) != cached >> 32) {
+        return Refresh(default_value);
+    }
+    return Unpack(cached, default_value);
+}
+
+bool CachedBoolProperty::Refresh(bool default_value) {
+    std::lock_guard<std::mutex> lock(lock_);
+    const prop_info *pi = pi_.load(std::memory_order_relaxed);
+    if (pi == nullptr) {
+        const uint32_t area_serial = __system_property_area_serial();
+        pi = __system_property_find(name_.c_str());
+        if (pi == nullptr) {
+            missing_area_serial_.store(uint64_t{area_serial} + 1, std::memory_order_release);
+            return default_value;
+        }
+        pi_.store(pi, std::memory_order_release);
+    }
+
+    uint64_t cached = cached_.load(std::memory_order_relaxed);
+    if (cached == 0 || __system_property_serial(pi) != cached >> 32) {
+        __system_property_read_callback(
+                pi,
+                [](void *cookie, const char *, const char *value, uint32_t serial) {
+                    *reinterpret_cast<uint64_t *>(cookie) =
+                            Pack(serial, android::base::ParseBool(value));
+                },
+                &cached);
+        cached_.store(cached, std::memory_order_release);
+    }
+    return Unpack(cached, default_value);
+}
+
+std::shared_ptr<CachedBoolProperty> PropertyCache::GetBoolProperty(const std::string &name) {
+    if (name.empty()) {
+        return nullptr;
+    }
+    static std::mutex lock;
+    static auto *properties =
+            new std::unordered_map<std::string, std::shared_ptr<CachedBoolProperty>>();
+    std::lock_guard<std::mutex> guard(lock);
+    auto &property = (*properties)[name];
+    if (property == nullptr) {
+        property = std::make_shared<CachedBoolProperty>(name);
+    }
+    return property;
+}
+
+}  // namespace perfmgr
+}  // namespace android
@@ -24,6 +24,7 @@
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <pixeltrace/PixelTrace.h>
 #include <utils/Trace.h>
 
 namespace android {
@@ -36,24 +37,15 @@ PropertyNode::PropertyNode(std::string name, std::string node_path,
            default_val_index, reset_on_init) {}
 
 std::chrono::milliseconds PropertyNode::Update(bool) {
-    std::size_t value_index = default_val_index_;
-    std::chrono::milliseconds expire_time = std::chrono::milliseconds::max();
-
-    // Find the highest outstanding request's expire time
-    for (std::size_t i = 0; i < req_sorted_.size(); i++) {
-        if (req_sorted_[i].GetExpireTime(&expire_time)) {
-            value_index = i;
-            break;
-        }
-    }
+    std::chrono::milliseconds expire_time;
+    std::size_t value_index = GetTargetIndex(&expire_time);
 
     // Update node only if request index changes
     if (value_index != current_val_index_ || reset_on_init_) {
         const std::string& req_value =
             req_sorted_[value_index].GetRequestValue();
         if (ATRACE_ENABLED()) {
-            const std::string tag = GetName() + ":" + req_value;
-            ATRACE_BEGIN(tag.c_str());
+            PIXEL_TRACE_BEGIN_F("%s:%s", GetName().c_str(), req_value.c_str());
         }
         if (!android::base::SetProperty(node_path_, req_value)) {
             LOG(WARNING) << "Failed to set property to : " << node_path_
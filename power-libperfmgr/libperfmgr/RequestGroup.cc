@@ -21,25 +21,50 @@
 #include <android-base/file.h>
 #include <android-base/logging.h>
 
+#include <algorithm>
 #include <sstream>
 
 namespace android {
 namespace perfmgr {
 
-bool RequestGroup::AddRequest(const std::string& hint_type, ReqTime end_time) {
-    if (request_map_.find(hint_type) == request_map_.end()) {
-        request_map_.emplace(hint_type, end_time);
-        return true;
-    } else {
-        if (request_map_[hint_type] < end_time) {
-            request_map_[hint_type] = end_time;
+bool RequestGroup::AddRequest(HintId hint_id, ReqTime end_time) {
+    size_t pos = Find(hint_id);
+    if (pos < requests_.size()) {
+        ReqTime old_end_time = requests_[pos].end_time;
+        if (old_end_time < end_time) {
+            requests_[pos].end_time = end_time;
+            if (heap_mode_) {
+                SiftDown(pos);
+                min_end_time_ = requests_.front().end_time;
+            } else if (old_end_time == min_end_time_) {
+                UpdateMinEndTime();
+            }
         }
         return false;
     }
+
+    requests_.push_back({hint_id, end_time});
+    if (heap_mode_) {
+        heap_index_[hint_id] = requests_.size() - 1;
+        SiftUp(requests_.size() - 1);
+    } else if (requests_.size() > kHeapThreshold) {
+        BuildHeap();
+    }
+    min_end_time_ = std::min(min_end_time_, end_time);
+    return true;
 }
 
-bool RequestGroup::RemoveRequest(const std::string& hint_type) {
-    return request_map_.erase(hint_type);
+bool RequestGroup::RemoveRequest(HintId hint_id) {
+    size_t pos = Find(hint_id);
+    if (pos >= requests_.size()) {
+        return false;
+    }
+    RemoveAt(pos);
+    if (heap_mode_ && requests_.size() < kHeapThreshold / 2) {
+        heap_mode_ = false;
+        heap_index_.clear();
+    }
+    return true;
 }
 
 const std::string& RequestGroup::GetRequestValue() const {
@@ -47,32 +72,157 @@ const std::string& RequestGroup::GetRequestValue() const {
 }
 
 bool RequestGroup::GetExpireTime(std::chrono::milliseconds* expire_time) {
-    ReqTime now = std::chrono::steady_clock::now();
     *expire_time = std::chrono::milliseconds::max();
+    if (requests_.empty()) {
+        return false;
+    }
+
+    ReqTime now = std::chrono::steady_clock::now();
+    auto is_expired = [now](ReqTime end_time) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(end_time - now) <=
+               std::chrono::milliseconds::zero();
+    };
+    // Fast path: nothing expired when the nearest request is still active.
+    if (!is_expired(min_end_time_)) {
+        *expire_time = std::chrono::duration_cast<std::chrono::milliseconds>(min_end_time_ - now);
+        return true;
+    }
+
+    if (heap_mode_) {
+        while (!requests_.empty() && is_expired(requests_.front().end_time)) {
+            RemoveAt(0);
+        }
+        if (requests_.size() < kHeapThreshold / 2) {
+            heap_mode_ = false;
+            heap_index_.clear();
+        }
+    } else {
+        requests_.erase(std::remove_if(requests_.begin(), requests_.end(),
+                                       [&](const Request &r) { return is_expired(r.end_time); }),
+                        requests_.end());
+        UpdateMinEndTime();
+    }
+
+    if (requests_.empty()) {
+        return false;
+    }
+    *expire_time = std::chrono::duration_cast<std::chrono::milliseconds>(min_end_time_ - now);
+    return true;
+}
+
+size_t RequestGroup::Find(HintId hint_id) const {
+    if (heap_mode_) {
+        auto it = heap_index_.find(hint_id);
+        return it == heap_index_.end() ? requests_.size() : it->second;
+    }
+    for (size_t i = 0; i < requests_.size(); i++) {
+        if (requests_[i].hint_id == hint_id) {
+            return i;
+        }
+    }
+    return requests_.size();
+}
 
-    bool active = false;
-    for (auto it = request_map_.begin(); it != request_map_.end();) {
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
-            it->second - now);
-        if (duration <= std::chrono::milliseconds::zero()) {
-            it = request_map_.erase(it);
-        } else {
-            *expire_time = std::min(duration, *expire_time);
-            active = true;
-            ++it;
+void RequestGroup::RemoveAt(size_t pos) {
+    ReqTime end_time = requests_[pos].end_time;
+    if (heap_mode_) {
+        heap_index_.erase(requests_[pos].hint_id);
+    }
+    if (pos != requests_.size() - 1) {
+        requests_[pos] = requests_.back();
+        if (heap_mode_) {
+            heap_index_[requests_[pos].hint_id] = pos;
+        }
+    }
+    requests_.pop_back();
+
+    if (heap_mode_) {
+        if (pos < requests_.size()) {
+            SiftUp(pos);
+            SiftDown(pos);
+        }
+        min_end_time_ = requests_.empty() ? ReqTime::max() : requests_.front().end_time;
+    } else if (end_time == min_end_time_) {
+        UpdateMinEndTime();
+    }
+}
+
+void RequestGroup::UpdateMinEndTime() {
+    min_end_time_ = ReqTime::max();
+    for (const auto &r : requests_) {
+        min_end_time_ = std::min(min_end_time_, r.end_time);
+    }
+}
+
+void RequestGroup::BuildHeap() {
+    heap_mode_ = true;
+    heap_index_.clear();
+    heap_index_.reserve(requests_.size() * 2);
+    for (size_t i = 0; i < requests_.size(); i++) {
+        heap_index_[requests_[i].hint_id] = i;
+    }
+    for (size_t i = requests_.size() / 2; i-- > 0;) {
+        SiftDown(i);
+    }
+}
+
+void RequestGroup::SiftUp(size_t pos) {
+    while (pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if (!(requests_[pos].end_time < requests_[parent].end_time)) {
+            break;
+        }
+        SwapRequests(pos, parent);
+        pos = parent;
+    }
+}
+
+void RequestGroup::SiftDown(size_t pos) {
+    const size_t size = requests_.size();
+    while (true) {
+        size_t smallest = pos;
+        size_t left = 2 * pos + 1;
+        size_t right = left + 1;
+        if (left < size && requests_[left].end_time < requests_[smallest].end_time) {
+            smallest = left;
+        }
+        if (right < size && requests_[right].end_time < requests_[smallest].end_time) {
+            smallest = right;
+        }
+        if (smallest == pos) {
+            break;
         }
+        SwapRequests(pos, smallest);
+        pos = smallest;
     }
-    return active;
+}
+
+void RequestGroup::SwapRequests(size_t a, size_t b) {
+    std::swap(requests_[a], requests_[b]);
+    heap_index_[requests_[a].hint_id] = a;
+    heap_index_[requests_[b].hint_id] = b;
+}
+
+void RequestGroup::GetRequests(std::vector<std::pair<HintId, ReqTime>>* requests) const {
+    for (const auto& r : requests_) {
+        requests->emplace_back(r.hint_id, r.end_time);
+    }
+}
+
+void RequestGroup::ClearRequests() {
+    requests_.clear();
+    heap_index_.clear();
+    heap_mode_ = false;
+    min_end_time_ = ReqTime::max();
 }
 
 void RequestGroup::DumpToFd(int fd, const std::string& prefix) const {
     std::ostringstream dump_buf;
     ReqTime now = std::chrono::steady_clock::now();
-    for (auto it = request_map_.begin(); it != request_map_.end(); it++) {
+    for (const auto &r : requests_) {
         auto remaining_duration =
-            std::chrono::duration_cast<std::chrono::milliseconds>(it->second -
-                                                                  now);
-        dump_buf << prefix << it->first << "\t" << remaining_duration.count()
+            std::chrono::duration_cast<std::chrono::milliseconds>(r.end_time - now);
+        dump_buf << prefix << HintIdTable::GetName(r.hint_id) << "\t" << remaining_duration.count()
                  << "\t" << request_value_ << "\n";
     }
     if (!android::base::WriteStringToFd(dump_buf.str(), fd)) {
@@ -51,6 +51,10 @@ struct AdpfConfig {
     std::optional<bool> mGpuBoostOn;
     std::optional<uint64_t> mGpuBoostCapacityMax;
     uint64_t mGpuCapacityLoadUpHeadroom;
+    // Weights of a new GPU capacity request above and below the filtered
+    // capacity of the session, in [0, 1]; unset is 1, no filtering
+    std::optional<double> mGpuCapacityFilterUp;
+    std::optional<double> mGpuCapacityFilterDown;
 
     // Heuristic boost control
     std::optional<bool> mHeuristicBoostOn;
@@ -70,11 +74,44 @@ struct AdpfConfig {
     std::optional<int32_t> mUclampMaxEfficientBase;
     std::optional<int32_t> mUclampMaxEfficientOffset;
 
+    // Predictive boost control, uses the heuristic boost records configs
+    std::optional<bool> mPredictiveBoostOn;
+    std::optional<uint32_t> mPredictiveBoostUclampMin;
+
+    // Threads releasing session votes, read once when the session manager
+    // starts with the profile active then
+    std::optional<uint32_t> mWorkerThreads;
+
+    // Energy aware control: cap the uclamp min of each session at the lowest
+    // level, EnergyAwareUclampStep apart, it meets its target at, searched one
+    // step per EnergyAwareWindowFrames frames with the CPU rail energy
+    std::optional<bool> mEnergyAwareOn;
+    std::optional<uint32_t> mEnergyAwareUclampStep;
+    std::optional<uint32_t> mEnergyAwareWindowFrames;
+
+    // Thread placement: task profile applied to the threads of a session
+    // while it is active, and the one undoing it on pause or close. Only for
+    // the sessions tagged with one of the comma separated
+    // SessionTaskProfileTags, all of them if unset
+    std::optional<std::string> mSessionTaskProfile;
+    std::optional<std::string> mSessionTaskProfileRevert;
+    std::optional<std::string> mSessionTaskProfileTags;
+
+    // CPU/GPU co-boost: when the uclamp min of a session rises, also raise its
+    // GPU capacity by GpuCoBoostFactor times the rise, as a share of the
+    // uclamp range, of GpuCapacityBoostMax, decaying over GpuCoBoostFrames
+    std::optional<bool> mGpuCoBoostOn;
+    std::optional<double> mGpuCoBoostFactor;
+    std::optional<uint32_t> mGpuCoBoostFrames;
+
     int64_t getPidIInitDivI();
     int64_t getPidIHighDivI();
     int64_t getPidILowDivI();
     void dumpToFd(int fd);
 
+    // Value-initialized config, to be filled field by field e.g. from the
+    // config cache.
+    AdpfConfig() = default;
     AdpfConfig(std::string name, bool pidOn, double pidPo, double pidPu, double pidI,
                int64_t pidIInit, int64_t pidIHigh, int64_t pidILow, double pidDo, double pidDu,
                bool uclampMinOn, uint32_t uclampMinInit, uint32_t uclampMinHigh,
@@ -90,7 +127,20 @@ struct AdpfConfig {
                std::optional<uint32_t> lowFrameRateThreshold, std::optional<uint32_t> maxRecordsNum,
                uint32_t uclampMinLoadUp, uint32_t uclampMinLoadReset,
                std::optional<int32_t> uclampMaxEfficientBase,
-               std::optional<int32_t> uclampMaxEfficientOffset)
+               std::optional<int32_t> uclampMaxEfficientOffset,
+               std::optional<bool> predictiveBoostOn,
+               std::optional<uint32_t> predictiveBoostUclampMin,
+               std::optional<uint32_t> workerThreads,
+               std::optional<double> gpuCapacityFilterUp,
+               std::optional<double> gpuCapacityFilterDown,
+               std::optional<bool> energyAwareOn,
+               std::optional<uint32_t> energyAwareUclampStep,
+               std::optional<uint32_t> energyAwareWindowFrames,
+               std::optional<std::string> sessionTaskProfile,
+               std::optional<std::string> sessionTaskProfileRevert,
+               std::optional<std::string> sessionTaskProfileTags,
+               std::optional<bool> gpuCoBoostOn, std::optional<double> gpuCoBoostFactor,
+               std::optional<uint32_t> gpuCoBoostFrames)
         : mName(std::move(name)),
           mPidOn(pidOn),
           mPidPo(pidPo),
@@ -114,6 +164,8 @@ struct AdpfConfig {
           mGpuBoostOn(gpuBoostOn),
           mGpuBoostCapacityMax(gpuBoostCapacityMax),
           mGpuCapacityLoadUpHeadroom(gpuCapacityLoadUpHeadroom),
+          mGpuCapacityFilterUp(gpuCapacityFilterUp),
+          mGpuCapacityFilterDown(gpuCapacityFilterDown),
           mHeuristicBoostOn(heuristicBoostOn),
           mHBoostOnMissedCycles(hBoostOnMissedCycles),
           mHBoostOffMaxAvgRatio(hBoostOffMaxAvgRatio),
@@ -126,7 +178,19 @@ struct AdpfConfig {
           mUclampMinLoadUp(uclampMinLoadUp),
           mUclampMinLoadReset(uclampMinLoadReset),
           mUclampMaxEfficientBase(uclampMaxEfficientBase),
-          mUclampMaxEfficientOffset(uclampMaxEfficientOffset) {}
+          mUclampMaxEfficientOffset(uclampMaxEfficientOffset),
+          mPredictiveBoostOn(predictiveBoostOn),
+          mPredictiveBoostUclampMin(predictiveBoostUclampMin),
+          mWorkerThreads(workerThreads),
+          mEnergyAwareOn(energyAwareOn),
+          mEnergyAwareUclampStep(energyAwareUclampStep),
+          mEnergyAwareWindowFrames(energyAwareWindowFrames),
+          mSessionTaskProfile(std::move(sessionTaskProfile)),
+          mSessionTaskProfileRevert(std::move(sessionTaskProfileRevert)),
+          mSessionTaskProfileTags(std::move(sessionTaskProfileTags)),
+          mGpuCoBoostOn(gpuCoBoostOn),
+          mGpuCoBoostFactor(gpuCoBoostFactor),
+          mGpuCoBoostFrames(gpuCoBoostFrames) {}
 };
 
 }  // namespace perfmgr
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specic language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_LIBPERFMGR_BOOSTMONITOR_H_
+#define ANDROID_LIBPERFMGR_BOOSTMONITOR_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "perfmgr/PropertyCache.h"
+
+namespace android {
+namespace perfmgr {
+
+class Node;
+struct Hint;
+struct HintStatus;
+
+// How the cpufreq boosts of a hint worked out, counted per cluster sample
+// taken while the hint was active.
+struct BoostStats {
+    BoostStats() : samples(0), effective(0), clipped(0), below(0) {}
+    std::atomic<uint64_t> samples;
+    // The cluster ran at or above the boosted min frequency
+    std::atomic<uint64_t> effective;
+    // scaling_max_freq, e.g. capped by a thermal cooling device, was below
+    // the boosted min frequency, so the boost could not apply
+    std::atomic<uint64_t> clipped;
+    // The cluster ran below the boosted min frequency with room above it
+    std::atomic<uint64_t> below;
+};
+
+// BoostMonitor samples scaling_cur_freq and scaling_max_freq of the clusters
+// active hints boost through a scaling_min_freq node, and counts in each
+// hint's BoostStats whether the boost took effect. It runs its own thread,
+// which only wakes up while a monitored hint is active.
+class BoostMonitor {
+  public:
+    // A cluster a hint boosts and the min frequency it boosts it to
+    struct Target {
+        std::string policy_dir;
+        uint64_t min_khz;
+        std::shared_ptr<CachedBoolProperty> enable_cache;  // of the node action
+    };
+
+    struct MonitoredHint {
+        std::shared_ptr<HintStatus> status;
+        std::vector<Target> targets;
+    };
+
+    // Return the targets of the hints in actions, those of their node actions
+    // writing a numeric value to a scaling_min_freq node, by hint name.
+    static std::unordered_map<std::string, std::vector<Target>> FindTargets(
+            const std::unordered_map<std::string, Hint> &actions,
+            const std::vector<std::unique_ptr<Node>> &nodes);
+
+    BoostMonitor(std::chrono::milliseconds interval, std::vector<MonitoredHint> hints);
+    ~BoostMonitor();
+
+    // Called on every DoHint, start sampling if not already.
+    void Wake();
+    // Stop sampling for good, Wake does nothing afterwards.
+    void Stop();
+    // Sample the clusters of the active hints once, return false if none is
+    // active.
+    bool Sample();
+
+  private:
+    BoostMonitor(BoostMonitor const &) = delete;
+    BoostMonitor &operator=(BoostMonitor const &) = delete;
+
+    void ThreadLoop();
+
+    const std::chrono::milliseconds interval_;
+    const std::vector<MonitoredHint> hints_;
+    std::mutex lock_;
+    std::condition_variable cv_;
+    bool woken_ = false;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+}  // namespace perfmgr
+}  // namespace android
+
+#endif  // ANDROID_LIBPERFMGR_BOOSTMONITOR_H_
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specic language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ANDROID_LIBPERFMGR_CONFIGCACHE_H_
+#define ANDROID_LIBPERFMGR_CONFIGCACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "perfmgr/HintManager.h"
+
+namespace android {
+namespace perfmgr {
+
+// ConfigCache stores a parsed PowerConfig in a compact binary form so that
+// HintManager can be built at startup without parsing the JSON config. The
+// cache is keyed by a hash of the JSON document and anything else the parse
+// result depends on; a cache with a different key, version or a corrupted
+// payload is rejected and the caller falls back to the JSON config.
+class ConfigCache {
+  public:
+    static constexpr uint32_t kVersion = 9;
+
+    // 64-bit FNV-1a hash of data, chained through seed.
+    static uint64_t Hash(std::string_view data, uint64_t seed = kHashSeed);
+
+    static std::string Serialize(const PowerConfig &config, uint64_t key);
+    // Return false and leave config untouched if data isn't a valid cache of key.
+    static bool Deserialize(const char *data, std::size_t size, uint64_t key,
+                            PowerConfig *config);
+
+    // Write the compiled config to path atomically.
+    static bool Write(const std::string &path, const PowerConfig &config, uint64_t key);
+    // Map the cache at path and load it into config if it matches key.
+    static bool Load(const std::string &path, uint64_t key, PowerConfig *config);
+
+  private:
+    static constexpr uint64_t kHashSeed = 0xcbf29ce484222325ULL;
+
+    ConfigCache() = delete;
+};
+
+}  // namespace perfmgr
+}  // namespace android
+
+#endif  // ANDROID_LIBPERFMGR_CONFIGCACHE_H_
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specic language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ANDROID_LIBPERFMGR_CONFIGSIMULATOR_H_
+#define ANDROID_LIBPERFMGR_CONFIGSIMULATOR_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "perfmgr/HintManager.h"
+
+namespace android {
+namespace perfmgr {
+
+// ConfigSimulator replays a trace of hints against a parsed config offline and
+// accounts the node writes NodeLooperThread would do for it, so that the cost
+// of a config change can be judged before it ships. Time is simulated, nodes
+// are never touched, enable properties are assumed on and writes never fail.
+class ConfigSimulator {
+  public:
+    struct HintEvent {
+        std::chrono::milliseconds time;
+        std::string hint_type;
+        bool end;
+        // timeout override of DoHint, 0ms for forever
+        std::optional<std::chrono::milliseconds> duration;
+    };
+
+    // Cost attributed to a hint: writes made by its DoHint and by its
+    // requests ending, either by EndHint or by expiring.
+    struct HintCost {
+        uint32_t do_count = 0;
+        uint32_t writes = 0;
+        // writes putting a node back to the value it had before its previous
+        // write within the redundant window, e.g. a boost dropped and
+        // re-applied by back to back hints
+        uint32_t redundant_writes = 0;
+        std::chrono::microseconds write_latency{0};
+    };
+
+    // Peak number of concurrent requests on a value of a node.
+    struct GroupPeak {
+        std::string node;
+        std::string value;
+        std::size_t peak;
+    };
+
+    // latencies maps node paths to their expected write latency, "*" sets the
+    // latency of other paths.
+    ConfigSimulator(const std::vector<std::unique_ptr<Node>> &nodes,
+                    const std::unordered_map<std::string, Hint> &actions,
+                    const std::unordered_map<std::string, std::chrono::microseconds> &latencies,
+                    std::chrono::milliseconds redundant_window = std::chrono::milliseconds(100));
+
+    // Parse a hint trace, one event per line in either format:
+    //   <time ms> do <hint> [duration ms]
+    //   <time ms> end <hint>
+    // or the hint counters HintManager writes to atrace, e.g.
+    //   ... 123.456789: tracing_mark_write: C|1234|LAUNCH|5000
+    // where a zero value ends the hint. Other lines of an atrace are skipped,
+    // counters which aren't hints are ignored when running the trace. Return
+    // false on a malformed event line.
+    static bool ParseTrace(const std::string &trace, std::vector<HintEvent> *events);
+    // Parse "<path> <latency us>" lines, '#' starts a comment.
+    static bool ParseLatencyTable(
+            const std::string &table,
+            std::unordered_map<std::string, std::chrono::microseconds> *latencies);
+
+    // Replay events, sorted by time, then let every timed request expire.
+    void Run(const std::vector<HintEvent> &events);
+
+    const std::map<std::string, HintCost> &GetHintCosts() const { return costs_; }
+    std::vector<GroupPeak> GetGroupPeaks() const;
+    // Number of trace events dropped for naming an unknown hint.
+    std::size_t GetUnknownEvents() const { return unknown_events_; }
+    // Tab separated report of the above.
+    std::string GetReport() const;
+
+  private:
+    static constexpr int64_t kForever = INT64_MAX;
+
+    struct NodeState {
+        std::string name;
+        std::vector<std::string> values;
+        std::size_t default_index;
+        std::chrono::microseconds latency;
+        // active requests per value, hint name to end time in ms
+        std::vector<std::map<std::string, int64_t>> requests;
+        std::vector<std::size_t> peaks;
+        std::size_t current_index;
+        std::size_t previous_index;
+        int64_t last_write = INT64_MIN;
+    };
+
+    void DoHint(const std::string &hint_type, std::optional<std::chrono::milliseconds> duration);
+    void EndHint(const std::string &hint_type);
+    // Resolve node i at now_ and charge a write to hint_type if its value changes.
+    void UpdateNode(std::size_t i, const std::string &hint_type);
+    // Expire requests ending at or before time, in time order.
+    void ExpireUntil(int64_t time);
+
+    const std::unordered_map<std::string, Hint> &actions_;
+    const std::chrono::milliseconds redundant_window_;
+    std::vector<NodeState> nodes_;
+    // hint to the requesters masking it
+    std::map<std::string, std::set<std::string>> masks_;
+    std::map<std::string, HintCost> costs_;
+    // hints being done, to stop DoHint actions looping
+    std::set<std::string> in_progress_;
+    std::size_t unknown_events_ = 0;
+    int64_t now_ = 0;
+};
+
+}  // namespace perfmgr
+}  // namespace android
+
+#endif  // ANDROID_LIBPERFMGR_CONFIGSIMULATOR_H_
@@ -19,7 +19,10 @@
 
 #include <android-base/unique_fd.h>
 
+#include <atomic>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -33,12 +36,17 @@ class FileNode : public Node {
   public:
     FileNode(std::string name, std::string node_path, std::vector<RequestGroup> req_sorted,
              std::size_t default_val_index, bool reset_on_init, bool truncate,
-             bool hold_fd = false, bool write_only = false);
+             bool hold_fd = false, bool write_only = false, bool cache_fd = false);
 
     std::chrono::milliseconds Update(bool log_error) override;
 
     bool GetHoldFd() const;
     bool GetTruncate() const;
+    bool GetCacheFd() const;
+    bool GetWriteOnly() const;
+
+    const char* GetType() const override { return "File"; }
+    bool IsSameConfig(const Node& other) const override;
 
     void DumpToFd(int fd) const override;
 
@@ -46,12 +54,31 @@ class FileNode : public Node {
     FileNode(const Node& other) = delete;
     FileNode& operator=(Node const&) = delete;
 
+    // Open node_path_ and remember whether it lives on a pseudo file system
+    // (sysfs/procfs) where fsync is a no-op.
+    bool OpenFd();
+    // Write value through the cached fd with pwrite at offset 0, reopening the
+    // node once if the cached fd went stale (EBADF/ENODEV).
+    bool WriteCachedFd(const std::string& value);
+    // Write value by reopening the node, the default write path.
+    bool WriteReopenFd(const std::string& value);
+
     const bool hold_fd_;
     const bool truncate_;
     // node will be read in DumpToFd
     const bool write_only_;
+    // fd_ is kept open for the lifetime of the node and written with pwrite
+    const bool cache_fd_;
     const std::chrono::milliseconds warn_timeout_;
     android::base::unique_fd fd_;
+    // fd_ points to sysfs or procfs, fsync can be skipped
+    bool is_pseudo_fs_;
+
+    // write latency stats in microseconds, only written by Update() but read
+    // by DumpToFd() from other threads
+    std::atomic<uint64_t> write_count_;
+    std::atomic<int64_t> write_total_us_;
+    std::atomic<int64_t> write_max_us_;
 };
 
 }  // namespace perfmgr
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specic language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_LIBPERFMGR_HINTID_H_
+#define ANDROID_LIBPERFMGR_HINTID_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+namespace android {
+namespace perfmgr {
+
+// Dense integer handle of an interned hint name, used on the hint hot path
+// instead of the hint name string.
+using HintId = uint32_t;
+constexpr HintId kInvalidHintId = std::numeric_limits<HintId>::max();
+
+// HintIdTable interns hint names into dense HintIds for the whole process.
+// Ids are never recycled, so an id resolved once at startup stays valid
+// across HintManager reloads. Interning takes a lock and is meant for
+// initialization; the request/update path only handles HintIds.
+class HintIdTable {
+  public:
+    // Return the id of name, assigning the next free id on first use.
+    static HintId Intern(const std::string &name);
+    // Return the id of name, kInvalidHintId if name was never interned.
+    static HintId Find(const std::string &name);
+    // Return the name of id, empty string for unknown id.
+    static std::string GetName(HintId id);
+    // Return the number of interned names, all valid ids are below it.
+    static std::size_t Size();
+
+  private:
+    HintIdTable() = delete;
+};
+
+}  // namespace perfmgr
+}  // namespace android
+
+#endif  // ANDROID_LIBPERFMGR_HINTID_H_
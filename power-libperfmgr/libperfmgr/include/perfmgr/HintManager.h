@@ -24,6 +24,7 @@
 #include <cstdint>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -31,7 +32,14 @@
 #include <vector>
 
 #include "perfmgr/AdpfConfig.h"
+#include "perfmgr/BoostMonitor.h"
+#include "perfmgr/HintId.h"
 #include "perfmgr/NodeLooperThread.h"
+#include "perfmgr/PropertyCache.h"
+
+namespace Json {
+class Value;
+}  // namespace Json
 
 namespace android {
 namespace perfmgr {
@@ -43,43 +51,79 @@ struct HintStats {
 };
 
 struct HintStatus {
+    using Ticks = std::chrono::steady_clock::rep;
     const std::chrono::milliseconds max_timeout;
-    HintStatus() : max_timeout(std::chrono::milliseconds(0)) {}
+    HintStatus() : HintStatus(std::chrono::milliseconds(0)) {}
     explicit HintStatus(std::chrono::milliseconds max_timeout)
         : max_timeout(max_timeout),
-          start_time(std::chrono::steady_clock::time_point::min()),
-          end_time(std::chrono::steady_clock::time_point::min()) {}
-    std::chrono::steady_clock::time_point start_time;
-    std::chrono::steady_clock::time_point end_time;
+          start_time(std::chrono::steady_clock::time_point::min().time_since_epoch().count()),
+          end_time(std::chrono::steady_clock::time_point::min().time_since_epoch().count()),
+          transition(false) {}
+    // steady_clock ticks. Extending an active hint only moves end_time with a
+    // CAS; starting or ending a hint also touches start_time and the stats,
+    // and holds the transition flag for those few instructions.
+    std::atomic<Ticks> start_time;
+    std::atomic<Ticks> end_time;
+    std::atomic<bool> transition;
     struct HintStatsInternal {
         HintStatsInternal() : count(0), duration_ms(0) {}
         std::atomic<uint32_t> count;
         std::atomic<uint64_t> duration_ms;
     } stats;
+    // Only counted while the BoostMonitor is enabled
+    BoostStats boost;
 };
 
 enum class HintActionType { Node, DoHint, EndHint, MaskHint };
 
 struct HintAction {
     HintAction(HintActionType t, const std::string &v, const std::string &p)
-        : type(t), value(v), enable_property(p) {}
+        : type(t),
+          value(v),
+          value_id(HintIdTable::Intern(v)),
+          enable_property(p),
+          enable_cache(PropertyCache::GetBoolProperty(p)) {}
     HintActionType type;
     std::string value;
+    HintId value_id;  // interned value, the target hint of the action
     std::string enable_property;
+    std::shared_ptr<CachedBoolProperty> enable_cache;  // nullptr without enable_property
+    // MaskHint only: bit of the requester in the mask_bits of the target,
+    // 0 if the target tracks it in mask_requesters instead.
+    uint64_t mask_bit = 0;
 };
 
 struct Hint {
-    Hint() {}
+    // Set in mask_bits while mask_requesters isn't empty.
+    static constexpr uint64_t kMaskOverflowBit = uint64_t{1} << 63;
+    static constexpr uint32_t kMaxMaskBits = 63;
+
+    Hint() : mask_bits(0) {}
     Hint(const Hint &obj)
         : node_actions(obj.node_actions),
           hint_actions(obj.hint_actions),
+          mask_bits(obj.mask_bits.load(std::memory_order_relaxed)),
           mask_requesters(obj.mask_requesters),
           status(obj.status) {}
     std::vector<NodeAction> node_actions;
     std::vector<HintAction> hint_actions;
+    // One bit per requester currently masking this hint, the hint is enabled
+    // when no bit is set.
+    std::atomic<uint64_t> mask_bits;
     mutable std::mutex hint_lock;
-    std::set<std::string> mask_requesters GUARDED_BY(hint_lock);
-    std::shared_ptr<HintStatus> status GUARDED_BY(hint_lock);
+    // Masking requesters that didn't get a bit in mask_bits.
+    std::set<HintId> mask_requesters GUARDED_BY(hint_lock);
+    // Set by InitHintStatus before the hint is used.
+    std::shared_ptr<HintStatus> status;
+};
+
+// PowerConfig holds everything parsed from the JSON config, or loaded from
+// its compiled cache, that is needed to construct a HintManager.
+struct PowerConfig {
+    std::vector<std::unique_ptr<Node>> nodes;
+    std::unordered_map<std::string, Hint> actions;
+    std::vector<std::shared_ptr<AdpfConfig>> adpfs;
+    std::optional<std::string> gpu_sysfs_config_path;
 };
 
 // HintManager is the external interface of the library to be used by PowerHAL
@@ -90,14 +134,10 @@ class HintManager {
   public:
     HintManager(sp<NodeLooperThread> nm, const std::unordered_map<std::string, Hint> &actions,
                 const std::vector<std::shared_ptr<AdpfConfig>> &adpfs,
-                std::optional<std::string> gpu_sysfs_config_path)
-        : nm_(std::move(nm)),
-          actions_(actions),
-          adpfs_(adpfs),
-          adpf_index_(0),
-          gpu_sysfs_config_path_(gpu_sysfs_config_path) {}
+                std::optional<std::string> gpu_sysfs_config_path);
     ~HintManager() {
-        if (nm_.get() != nullptr) nm_->Stop();
+        // A replaced instance may share its looper with the current one
+        if (nm_.get() != nullptr && !retired_.load(std::memory_order_relaxed)) nm_->Stop();
     }
 
     // Return true if the sysfs manager thread is running.
@@ -123,6 +163,25 @@ class HintManager {
     // Query if given hint enabled.
     bool IsHintEnabled(const std::string &hint_type) const;
 
+    // Return the HintId of hint_type for the HintId variants below, which
+    // behave the same as their string counterparts without hashing the name on
+    // every call. The id stays valid across config reloads, kInvalidHintId if
+    // no config loaded so far has the hint.
+    static HintId LookupHint(const std::string &hint_type);
+    bool DoHint(HintId hint_id);
+    bool DoHint(HintId hint_id, std::chrono::milliseconds timeout_ms_override);
+    bool EndHint(HintId hint_id);
+    bool IsHintSupported(HintId hint_id) const;
+    bool IsHintEnabled(HintId hint_id) const;
+
+    // Do (true) or end (false) each hint in order, waking the NodeLooperThread
+    // once for all of them. Return true if every DoHint/EndHint succeeded.
+    bool SetHints(const std::vector<std::pair<HintId, bool>> &hints);
+
+    // Set the ThrottlingSeverity of the hottest sensor. Node actions with
+    // ThermalValues pick their value by it from their next request on.
+    void SetThermalSeverity(int32_t severity);
+
     // set ADPF config by profile name.
     bool SetAdpfProfile(const std::string &profile_name);
 
@@ -137,6 +196,18 @@ class HintManager {
     // Static method to construct the global HintManager from the JSON config file.
     static HintManager *GetFromJSON(const std::string &config_path, bool start = true);
 
+    // Static method to switch the global HintManager to the JSON config file
+    // without restarting its NodeLooperThread: unchanged nodes keep their
+    // state and open fds, and active requests and masks of hints which still
+    // exist are carried over. Falls back to GetFromJSON if there is no
+    // instance yet. Return false and keep the current config if the new one
+    // is invalid.
+    static bool ReloadFromJSON(const std::string &config_path);
+
+    // Load the config of the device, with ReloadFromJSON once an instance
+    // exists. The looper is only started if a new one is created.
+    static void Reload(bool start);
+
     // Return available hints managed by HintManager
     std::vector<std::string> GetHints() const;
 
@@ -149,37 +220,86 @@ class HintManager {
     // Start thread loop
     bool Start();
 
-    // Singleton
+    // Singleton. An instance replaced by a reload stays valid, its hint
+    // requests go to the current instance.
     static HintManager *GetInstance();
 
+    // Return the path of the compiled cache of the JSON config at config_path.
+    static std::string GetConfigCachePath(const std::string &config_path);
+    // Return the key a compiled cache of json_doc must match to be used.
+    static uint64_t GetConfigKey(const std::string &json_doc);
+
   protected:
     static std::vector<std::unique_ptr<Node>> ParseNodes(
         const std::string& json_doc);
     static std::unordered_map<std::string, Hint> ParseActions(
             const std::string &json_doc, const std::vector<std::unique_ptr<Node>> &nodes);
     static std::vector<std::shared_ptr<AdpfConfig>> ParseAdpfConfigs(const std::string &json_doc);
+    // Variants of the above working on an already parsed JSON document.
+    static bool ParseJson(const std::string &json_doc, Json::Value *root);
+    static std::vector<std::unique_ptr<Node>> ParseNodes(const Json::Value &root);
+    static std::unordered_map<std::string, Hint> ParseActions(
+            const Json::Value &root, const std::vector<std::unique_ptr<Node>> &nodes);
+    static std::vector<std::shared_ptr<AdpfConfig>> ParseAdpfConfigs(const Json::Value &root);
+    // Parse all sections of json_doc with a single JSON parse; return false
+    // on error, logging the failing section of config_path.
+    static bool ParseConfig(const std::string &json_doc, const std::string &config_path,
+                            PowerConfig *config);
     static bool InitHintStatus(const std::unique_ptr<HintManager> &hm);
-
-    static void Reload(bool start);
+    // Return the BoostMonitor targets of config, empty if the monitor is disabled.
+    static std::unordered_map<std::string, std::vector<BoostMonitor::Target>> FindBoostTargets(
+            const PowerConfig &config);
+    // Start a BoostMonitor on the hints of hm with targets, after InitHintStatus.
+    static void InitBoostMonitor(
+            const std::unique_ptr<HintManager> &hm,
+            const std::unordered_map<std::string, std::vector<BoostMonitor::Target>> &targets);
+    // Read config_path into config, from its compiled cache when up to date.
+    static bool LoadConfig(const std::string &config_path, PowerConfig *config);
+
+    // Make hm the instance returned by GetInstance(), with sInstanceLock held.
+    static void Publish(std::unique_ptr<HintManager> hm);
     HintManager(HintManager const&) = delete;
     HintManager &operator=(HintManager const &) = delete;
 
-    bool ValidateHint(const std::string& hint_type) const;
+    using HintEntry = std::unordered_map<std::string, Hint>::value_type;
+    // Return the action entry of hint_id, nullptr if the hint isn't supported
+    HintEntry *GetHintEntry(HintId hint_id) const;
+    bool ValidateHint(HintId hint_id) const;
+    // Common part of the DoHint variants
+    bool DoHintInternal(HintId hint_id, std::optional<std::chrono::milliseconds> timeout_ms);
     // Helper function to update the HintStatus when DoHint
-    void DoHintStatus(const std::string &hint_type, std::chrono::milliseconds timeout_ms);
+    void DoHintStatus(HintEntry *entry, std::chrono::milliseconds timeout_ms);
     // Helper function to update the HintStatus when EndHint
-    void EndHintStatus(const std::string &hint_type);
+    void EndHintStatus(HintEntry *entry);
     // Helper function to take hint actions when DoHint
-    void DoHintAction(const std::string &hint_type);
+    void DoHintAction(HintId hint_id, HintEntry *entry);
     // Helper function to take hint actions when EndHint
-    void EndHintAction(const std::string &hint_type);
+    void EndHintAction(HintId hint_id, HintEntry *entry);
+    // Set, clear or query the mask of MaskHint action of hint_id on its target
+    void MaskHint(HintId hint_id, const HintAction &action);
+    void UnmaskHint(HintId hint_id, const HintAction &action);
+    bool IsMasking(HintId hint_id, const HintAction &action) const;
+    // Mask the targets of hints which were masking the same target in old
+    void CarryOverMasks(const HintManager &old);
     sp<NodeLooperThread> nm_;
     std::unordered_map<std::string, Hint> actions_;
+    // actions_ entries indexed by HintId, nullptr for unsupported hints
+    std::vector<HintEntry *> hints_by_id_;
     std::vector<std::shared_ptr<AdpfConfig>> adpfs_;
     uint32_t adpf_index_;
     std::optional<std::string> gpu_sysfs_config_path_;
-
-    static std::unique_ptr<HintManager> sInstance;
+    // nullptr unless enabled by vendor.powerhal.boost_monitor_ms
+    std::unique_ptr<BoostMonitor> boost_monitor_;
+
+    // Set once a reload replaced this instance
+    std::atomic<bool> retired_{false};
+
+    static std::atomic<HintManager *> sInstance;
+    // Serializes loading and reloading the config
+    static std::mutex sInstanceLock;
+    // Every instance published so far, the last one being sInstance. Replaced
+    // instances are kept alive for GetInstance() callers still holding them.
+    static std::vector<std::unique_ptr<HintManager>> sInstances GUARDED_BY(sInstanceLock);
 };
 
 }  // namespace perfmgr
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specic language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ANDROID_LIBPERFMGR_LATENCYHISTOGRAM_H_
+#define ANDROID_LIBPERFMGR_LATENCYHISTOGRAM_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace android {
+namespace perfmgr {
+
+// LatencyHistogram is a lock-free log-linear histogram of latencies in
+// microseconds: values below kSubBuckets get one bucket each, and every
+// power of two above is split into kSubBuckets linear buckets, which bounds
+// the relative error of reported percentiles to 1/kSubBuckets. Recording costs
+// two relaxed atomic increments plus a compare-and-swap on a new maximum.
+class LatencyHistogram {
+  public:
+    static constexpr std::size_t kSubBucketBits = 3;
+    static constexpr std::size_t kSubBuckets = 1 << kSubBucketBits;
+    // Values at or above 2^(kMaxExponent + 1) us fall into the last bucket.
+    static constexpr std::size_t kMaxExponent = 35;
+    static constexpr std::size_t kNumBuckets =
+            kSubBuckets + (kMaxExponent - kSubBucketBits + 1) * kSubBuckets;
+
+    LatencyHistogram();
+
+    void Record(std::chrono::nanoseconds latency);
+    uint64_t GetCount() const;
+    std::chrono::microseconds GetMax() const;
+    // Return an upper bound of the percentile in [0, 100], 0 if empty.
+    std::chrono::microseconds GetPercentile(double percentile) const;
+
+    static std::size_t GetBucketIndex(uint64_t value_us);
+    // Return the largest value falling into bucket index.
+    static uint64_t GetBucketUpperBound(std::size_t index);
+
+  private:
+    LatencyHistogram(LatencyHistogram const &) = delete;
+    LatencyHistogram &operator=(LatencyHistogram const &) = delete;
+
+    std::array<std::atomic<uint32_t>, kNumBuckets> buckets_;
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> max_us_;
+};
+
+}  // namespace perfmgr
+}  // namespace android
+
+#endif  // ANDROID_LIBPERFMGR_LATENCYHISTOGRAM_H_
@@ -21,6 +21,7 @@
 
 #include <cstddef>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "perfmgr/RequestGroup.h"
@@ -49,11 +50,28 @@ class Node {
     virtual ~Node() {}
 
     // Return true if successfully add a request
-    bool AddRequest(std::size_t value_index, const std::string& hint_type,
-                    ReqTime end_time);
+    bool AddRequest(std::size_t value_index, HintId hint_id, ReqTime end_time);
+    bool AddRequest(std::size_t value_index, const std::string& hint_type, ReqTime end_time) {
+        return AddRequest(value_index, HintIdTable::Intern(hint_type), end_time);
+    }
 
     // Return true if successfully remove a request
-    bool RemoveRequest(const std::string& hint_type);
+    bool RemoveRequest(HintId hint_id);
+    bool RemoveRequest(const std::string& hint_type) {
+        return RemoveRequest(HintIdTable::Intern(hint_type));
+    }
+
+    // Append the requests of all values to requests and remove them from
+    // the node.
+    void TakeRequests(std::vector<std::pair<HintId, ReqTime>>* requests);
+
+    // Return true if other is configured the same way as this node, i.e. it
+    // could replace this node without any visible change.
+    virtual bool IsSameConfig(const Node& other) const;
+    // Take over the current value of the node this node replaces, so that the
+    // value is only rewritten when it changes; the node is rewritten on the
+    // next update if the value doesn't exist in this node.
+    void InheritCurrentValue(const Node& other);
 
     // Return the nearest expire time of active requests; return
     // std::chrono::milliseconds::max() if no active request on Node; update
@@ -61,12 +79,31 @@ class Node {
     // active request.
     virtual std::chrono::milliseconds Update(bool log_error) = 0;
 
+    // Return the value index selected by the highest priority active request,
+    // or the default index if no request is active; also update expire_time
+    // with the nearest expire time of the selected request.
+    std::size_t GetTargetIndex(std::chrono::milliseconds* expire_time);
+    // Return the value index the node is currently set to.
+    std::size_t GetCurrentIndex() const;
+
+    // Name of the node which bounds this node's value, e.g. a cpufreq min node
+    // depends on the max node of the same policy; empty if none.
+    const std::string& GetDependsOn() const;
+    void SetDependsOn(std::string depends_on);
+
+    // Name of the write lane the node is updated on, nodes of different lanes
+    // are written concurrently; empty for the looper thread's own lane.
+    const std::string& GetWriteLane() const;
+    void SetWriteLane(std::string write_lane);
+
     const std::string& GetName() const;
     const std::string& GetPath() const;
     std::vector<std::string> GetValues() const;
     std::size_t GetDefaultIndex() const;
     bool GetResetOnInit() const;
     bool GetValueIndex(const std::string& value, std::size_t* index) const;
+    // Return the node type as named by the "Type" field of the JSON config.
+    virtual const char* GetType() const = 0;
     virtual void DumpToFd(int fd) const = 0;
 
   protected:
@@ -84,6 +121,8 @@ class Node {
     // node will be explicitly initialized when first time called Update().
     bool reset_on_init_;
     std::size_t current_val_index_;
+    std::string depends_on_;
+    std::string write_lane_;
 };
 
 }  // namespace perfmgr
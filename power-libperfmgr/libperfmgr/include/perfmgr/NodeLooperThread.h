@@ -19,17 +19,34 @@
 
 #include <utils/Thread.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "perfmgr/LatencyHistogram.h"
 #include "perfmgr/Node.h"
+#include "perfmgr/PropertyCache.h"
 
 namespace android {
 namespace perfmgr {
 
+// ThrottlingSeverity names, indexed by value
+constexpr const char *kThermalSeverityNames[] = {
+        "NONE", "LIGHT", "MODERATE", "SEVERE", "CRITICAL", "EMERGENCY", "SHUTDOWN",
+};
+constexpr int32_t kThermalSeverityCount =
+        sizeof(kThermalSeverityNames) / sizeof(kThermalSeverityNames[0]);
+
 // The NodeAction specifies the sysfs node, the value to be assigned, and the
 // timeout for this action:
 struct NodeAction {
@@ -38,11 +55,16 @@ struct NodeAction {
         : node_index(node_index),
           value_index(value_index),
           timeout_ms(timeout_ms),
-          enable_property(enable_property) {}
+          enable_property(enable_property),
+          enable_cache(PropertyCache::GetBoolProperty(enable_property)) {}
     std::size_t node_index;
     std::size_t value_index;
     std::chrono::milliseconds timeout_ms;  // 0ms for forever
     std::string enable_property;           // boolean property to control action on/off.
+    std::shared_ptr<CachedBoolProperty> enable_cache;  // nullptr without enable_property
+    // Value index by thermal severity, e.g. a lower boost once it would be
+    // clipped anyway; empty to always use value_index.
+    std::vector<std::size_t> thermal_value_index;
 };
 
 // The NodeLooperThread is responsible for managing each of the sysfs nodes
@@ -53,10 +75,17 @@ struct NodeAction {
 // decides how to apply the requests. The NodeLooperThread contains a ThreadLoop
 // to maintain the sysfs nodes, and that thread is woken up both to handle
 // powerhint requests and when the timeout expires for an in-progress powerhint.
+// Nodes assigned to a named write lane are written by a worker thread of that
+// lane, concurrently with other lanes, while the looper still resolves the
+// requests and waits for all lanes before going back to sleep.
 class NodeLooperThread : public ::android::Thread {
   public:
-    explicit NodeLooperThread(std::vector<std::unique_ptr<Node>> nodes)
-        : Thread(false), nodes_(std::move(nodes)) {}
+    // A non-zero coalesce_window holds the sweep woken up by a request until
+    // the window has passed since that request, so requests arriving in a
+    // burst are resolved and written in one sweep.
+    explicit NodeLooperThread(std::vector<std::unique_ptr<Node>> nodes,
+                              std::chrono::microseconds coalesce_window =
+                                      std::chrono::microseconds::zero());
     virtual ~NodeLooperThread() { Stop(); }
 
     // Need call Stop() as the threadloop will hold a strong pointer
@@ -66,17 +95,54 @@ class NodeLooperThread : public ::android::Thread {
 
     // Return true when successfully adds request from actions for the hint_type
     // in each individual node. Return false if any of the actions has either
-    // invalid node index or value index.
-    bool Request(const std::vector<NodeAction>& actions,
-                 const std::string& hint_type);
+    // invalid node index or value index, or if the hint was never interned.
+    // timeout_ms_override replaces the timeout of every action when present.
+    bool Request(const std::vector<NodeAction>& actions, HintId hint_id,
+                 std::optional<std::chrono::milliseconds> timeout_ms_override = std::nullopt);
+    bool Request(const std::vector<NodeAction>& actions, const std::string& hint_type) {
+        return Request(actions, HintIdTable::Find(hint_type));
+    }
     // Return when successfully cancels request from actions for the hint_type
     // in each individual node. Return false if any of the actions has invalid
-    // node index.
-    bool Cancel(const std::vector<NodeAction>& actions,
-                const std::string& hint_type);
+    // node index, or if the hint was never interned.
+    bool Cancel(const std::vector<NodeAction>& actions, HintId hint_id);
+    bool Cancel(const std::vector<NodeAction>& actions, const std::string& hint_type) {
+        return Cancel(actions, HintIdTable::Find(hint_type));
+    }
+    // Requests and cancels made between BeginBatch and the matching EndBatch
+    // don't wake the looper; EndBatch wakes it once for all of them. Batches
+    // may nest, the outermost EndBatch does the wakeup.
+    void BeginBatch();
+    void EndBatch();
+
+    // Replace the nodes with the nodes of a new config without restarting the
+    // looper. A node whose config is unchanged keeps its object, current value
+    // and open fd; a changed node takes over the current value of the node it
+    // replaces. Active requests of hints in actions, keyed by hint and holding
+    // the new node actions of the hint, are carried over with their end time
+    // to the value of the hint's action on the node; other requests are
+    // dropped, and nodes which are gone are reset to their default value.
+    // Return false if nodes is empty.
+    bool Reload(std::vector<std::unique_ptr<Node>> nodes,
+                const std::unordered_map<HintId, std::vector<NodeAction>> &actions);
 
     // Dump all nodes to fd
     void DumpToFd(int fd);
+    // Dump latency histograms to fd, one interval per line, followed by the
+    // coalesced wakeup count
+    void DumpLatencyToFd(int fd) const;
+    // Number of requests which didn't wake the looper themselves because a
+    // wakeup was already pending or a batch was open.
+    uint64_t GetCoalescedWakeups() const;
+
+    // Set the thermal severity actions with thermal values pick their value
+    // by. It applies to the requests made after it.
+    void SetThermalSeverity(int32_t severity) {
+        thermal_severity_.store(severity, std::memory_order_relaxed);
+    }
+    int32_t GetThermalSeverity() const {
+        return thermal_severity_.load(std::memory_order_relaxed);
+    }
 
     // Return true when successfully started the looper thread
     bool Start();
@@ -85,10 +151,70 @@ class NodeLooperThread : public ::android::Thread {
     NodeLooperThread(NodeLooperThread const&) = delete;
     NodeLooperThread &operator=(NodeLooperThread const &) = delete;
     bool threadLoop() override;
+    // (Re)build the per node tables below from nodes_ and lanes_.
+    void InitNodeTables();
+    // Sort update_list_ so that each node is written exactly once and after
+    // the node it depends on when it moves past that node's current value.
+    void OrderUpdateList();
+    // Update node i and record write latencies if its value changed.
+    std::chrono::milliseconds UpdateNode(std::size_t i, bool log_error);
+    // Update the nodes of list in order and set their deadlines_.
+    void UpdateNodes(const std::vector<std::size_t> &list);
+    // The value index of action at the current thermal severity
+    std::size_t ValueIndex(const NodeAction &action) const;
+
+    struct WriteLane {
+        std::string name;
+        std::thread thread;
+        std::mutex lock;
+        std::condition_variable cond;
+        // nodes to update in this sweep, set by the looper before pending
+        std::vector<std::size_t> nodes;
+        bool pending = false;
+        bool exit = false;
+    };
+    void LaneLoop(WriteLane *lane);
+    // Return the lanes used by nodes, lane 0 being the looper itself.
+    static std::vector<std::unique_ptr<WriteLane>> MakeLanes(
+            const std::vector<std::unique_ptr<Node>> &nodes);
+    // Start or stop the worker threads of the named write lanes.
+    void StartLanes(std::vector<std::unique_ptr<WriteLane>> *lanes);
+    void StopLanes(std::vector<std::unique_ptr<WriteLane>> *lanes);
 
     static constexpr auto kMaxUpdatePeriod = std::chrono::milliseconds::max();
+    static constexpr auto kNoDependency = std::numeric_limits<std::size_t>::max();
 
     std::vector<std::unique_ptr<Node>> nodes_;  // parsed from Config
+    // nodes touched by Request/Cancel since last loop, all dirty at start so
+    // every node gets initialized by the first loop
+    std::vector<bool> dirty_;
+    // next time each node needs to be re-evaluated, e.g. request expiry or
+    // write retry; ReqTime::max() when nothing is pending on the node
+    std::vector<ReqTime> deadlines_;
+    // scratch list of node indexes evaluated in one loop
+    std::vector<std::size_t> update_list_;
+
+    // node index each node depends on, kNoDependency if none
+    std::vector<std::size_t> depends_on_;
+    // reverse of depends_on_
+    std::vector<std::vector<std::size_t>> dependents_;
+    // true if any node declares a dependency, nodes are then written once in
+    // dependency order instead of the two-pass update
+    bool ordered_;
+    // scratch state for OrderUpdateList
+    std::vector<bool> in_update_;
+    std::vector<bool> dependency_first_;
+    std::vector<std::size_t> in_degree_;
+    std::vector<std::size_t> ordered_list_;
+    // node values parsed as integers for dependency ordering
+    std::vector<std::vector<std::optional<int64_t>>> numeric_values_;
+    // lane index of each node into lanes_, lane 0 is the looper itself
+    std::vector<std::size_t> lane_of_;
+    std::vector<std::unique_ptr<WriteLane>> lanes_;
+    // wakeup time of the current sweep, shared with the lanes
+    ReqTime sweep_time_;
+    // set at wakeup when a request is pending, cleared by the first write
+    std::atomic<bool> first_write_pending_;
 
     // conditional variable from C++ standard library can be affected by wall
     // time change as it is using CLOCK_REAL (b/35756266). The component should
@@ -96,8 +222,23 @@ class NodeLooperThread : public ::android::Thread {
     // class for waking up threadloop.
     ::android::Condition wake_cond_;
 
-    // lock to protect nodes_
+    // lock to protect nodes_, dirty_, deadlines_ and the scratch lists
     ::android::Mutex lock_;
+
+    // depth of BeginBatch calls not yet ended, wakeups are held while non-zero
+    std::size_t batch_depth_;
+    const std::chrono::microseconds coalesce_window_;
+    std::atomic<uint64_t> coalesced_wakeups_;
+    std::atomic<int32_t> thermal_severity_{0};
+
+    // entry time of the oldest Request not yet seen by threadLoop
+    std::optional<ReqTime> pending_since_;
+    // Request entry (before taking lock_) to looper wakeup
+    LatencyHistogram wakeup_latency_;
+    // looper wakeup to the end of the first node write of the sweep
+    LatencyHistogram first_write_latency_;
+    // duration of each node update which changed the node value
+    LatencyHistogram write_latency_;
 };
 
 }  // namespace perfmgr
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specic language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ANDROID_LIBPERFMGR_PROPERTYCACHE_H_
+#define ANDROID_LIBPERFMGR_PROPERTYCACHE_H_
+
+#include <android-base/parsebool.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+struct prop_info;
+
+namespace android {
+namespace perfmgr {
+
+// CachedBoolProperty caches the parsed value of a boolean system property and
+// only re-reads it when the property serial changes, so checking it on the
+// hint path costs a few atomic loads instead of a property area lookup. The
+// lock is only taken to look the property up or re-read a changed value.
+class CachedBoolProperty {
+  public:
+    explicit CachedBoolProperty(const std::string &name) : name_(name) {}
+
+    // Return the property value, default_value if it is unset or not a bool.
+    bool Get(bool default_value);
+    const std::string &GetName() const { return name_; }
+
+  private:
+    // The property serial in the upper 32 bits and the ParseBoolResult plus
+    // one in the lower ones, so both are read at once; 0 until first read
+    static uint64_t Pack(uint32_t serial, android::base::ParseBoolResult value) {
+        return (uint64_t{serial} << 32) | (static_cast<uint32_t>(value) + 1);
+    }
+    static bool Unpack(uint64_t cached, bool default_value);
+    bool Refresh(bool default_value);
+
+    const std::string name_;
+    std::mutex lock_;
+    std::atomic<const prop_info *> pi_{nullptr};
+    // Area serial of the last failed lookup of a not yet existing property
+    // plus one, 0 before the first lookup
+    std::atomic<uint64_t> missing_area_serial_{0};
+    std::atomic<uint64_t> cached_{0};
+};
+
+// PropertyCache hands out one CachedBoolProperty per distinct property name
+// for the whole process, so actions sharing an enable property share its
+// cached value.
+class PropertyCache {
+  public:
+    // Return the shared cache of name, nullptr if name is empty.
+    static std::shared_ptr<CachedBoolProperty> GetBoolProperty(const std::string &name);
+
+  private:
+    PropertyCache() = delete;
+};
+
+}  // namespace perfmgr
+}  // namespace android
+
+#endif  // ANDROID_LIBPERFMGR_PROPERTYCACHE_H_
@@ -35,6 +35,8 @@ class PropertyNode : public Node {
 
     std::chrono::milliseconds Update(bool log_error) override;
 
+    const char* GetType() const override { return "Property"; }
+
     void DumpToFd(int fd) const override;
 
   private:
@@ -18,9 +18,13 @@
 #define ANDROID_LIBPERFMGR_REQUESTGROUP_H_
 
 #include <chrono>
-#include <map>
+#include <cstddef>
 #include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
+
+#include "perfmgr/HintId.h"
 
 namespace android {
 namespace perfmgr {
@@ -32,33 +36,71 @@ using ReqTime = std::chrono::time_point<std::chrono::steady_clock>;
 // add requests, a function to remove requests, and a function to check for the
 // next expiration time if there is an outstanding request, and a function to
 // check the requested value. There may only be one request per PowerHint, so
-// the representation is simple: a map from PowerHint to the expiration time for
-// that hint.
+// the representation is simple: a flat vector of (HintId, expiration time)
+// pairs with the nearest expiration time cached. Most groups only hold a
+// handful of requests and are scanned linearly; once a group grows past
+// kHeapThreshold requests the vector is kept as a min-heap on expiration time,
+// indexed by HintId, so that add/remove/expire stay logarithmic.
 class RequestGroup {
   public:
     RequestGroup(const std::string &request_value)  // NOLINT(runtime/explicit)
         : request_value_(request_value) {}
 
-    // Remove expired request in the map and return true when request_map_ is
-    // not empty, false when request_map_ is empty; also update expire_time with
-    // nearest timeout in request_map_ or std::chrono::milliseconds::max() when
-    // request_map_ is empty.
+    // Remove expired request and return true when requests_ is not empty,
+    // false when requests_ is empty; also update expire_time with nearest
+    // timeout in requests_ or std::chrono::milliseconds::max() when requests_
+    // is empty.
     bool GetExpireTime(std::chrono::milliseconds* expire_time);
     // Return the request value.
     const std::string& GetRequestValue() const;
     // Return true for adding request, false for extending expire time of
     // existing active request on given hint_type.
-    bool AddRequest(const std::string& hint_type, ReqTime end_time);
+    bool AddRequest(HintId hint_id, ReqTime end_time);
+    bool AddRequest(const std::string& hint_type, ReqTime end_time) {
+        return AddRequest(HintIdTable::Intern(hint_type), end_time);
+    }
     // Return true for removing request, false if request is not active on given
     // hint_type. If request exits and the new end_time is less than the active
     // time, expire time will not be updated; also returns false.
-    bool RemoveRequest(const std::string& hint_type);
+    bool RemoveRequest(HintId hint_id);
+    bool RemoveRequest(const std::string& hint_type) {
+        return RemoveRequest(HintIdTable::Intern(hint_type));
+    }
+    // Append the requests of the group, expired or not, to requests.
+    void GetRequests(std::vector<std::pair<HintId, ReqTime>>* requests) const;
+    // Remove all requests.
+    void ClearRequests();
     // Dump internal status to fd
     void DumpToFd(int fd, const std::string& prefix) const;
 
+    // Switch to the indexed heap when the group holds more requests than this,
+    // and back to the flat vector below half of it.
+    static constexpr size_t kHeapThreshold = 16;
+
   private:
+    struct Request {
+        HintId hint_id;
+        ReqTime end_time;
+    };
+
+    // Return the position of hint_id in requests_, requests_.size() if absent.
+    size_t Find(HintId hint_id) const;
+    // Remove the request at pos and keep the representation consistent.
+    void RemoveAt(size_t pos);
+    // Recompute min_end_time_ from requests_.
+    void UpdateMinEndTime();
+    // Indexed heap helpers, only used when heap_mode_ is set.
+    void BuildHeap();
+    void SiftUp(size_t pos);
+    void SiftDown(size_t pos);
+    void SwapRequests(size_t a, size_t b);
+
     const std::string request_value_;
-    std::map<std::string, ReqTime> request_map_;
+    std::vector<Request> requests_;
+    // Position of each request in requests_, maintained only in heap_mode_.
+    std::unordered_map<HintId, size_t> heap_index_;
+    bool heap_mode_ = false;
+    ReqTime min_end_time_ = ReqTime::max();
 };
 
 }  // namespace perfmgr
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specic language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include "perfmgr/BoostMonitor.h"
+#include "perfmgr/FileNode.h"
+#include "perfmgr/HintManager.h"
+
+namespace android {
+namespace perfmgr {
+
+using std::literals::chrono_literals::operator""h;
+using std::literals::chrono_literals::operator""ms;
+
+class BoostMonitorTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        policy_dir_ = std::string(dir_.path) + "/policy0";
+        ASSERT_EQ(0, mkdir(policy_dir_.c_str(), 0700));
+        nodes_.emplace_back(new FileNode("CPUCluster0MinFreq", policy_dir_ + "/scaling_min_freq",
+                                         {{"1500000"}, {"300000"}}, 1, false, false));
+        nodes_.emplace_back(new FileNode("Other", policy_dir_ + "/scaling_governor",
+                                         {{"1500000"}, {"schedutil"}}, 1, false, false));
+        Hint hint;
+        hint.node_actions.emplace_back(0, 0, 100ms);
+        hint.node_actions.emplace_back(1, 0, 100ms);
+        actions_.emplace("LAUNCH", hint);
+        actions_.emplace("NO_BOOST", Hint());
+    }
+
+    void SetFreqs(const std::string &cur_khz, const std::string &max_khz) {
+        ASSERT_TRUE(android::base::WriteStringToFile(cur_khz, policy_dir_ + "/scaling_cur_freq"));
+        ASSERT_TRUE(android::base::WriteStringToFile(max_khz, policy_dir_ + "/scaling_max_freq"));
+    }
+
+    static void Activate(HintStatus *status) {
+        const auto now = std::chrono::steady_clock::now();
+        status->start_time.store(now.time_since_epoch().count());
+        status->end_time.store((now + std::chrono::hours(1)).time_since_epoch().count());
+    }
+
+    TemporaryDir dir_;
+    std::string policy_dir_;
+    std::vector<std::unique_ptr<Node>> nodes_;
+    std::unordered_map<std::string, Hint> actions_;
+};
+
+TEST_F(BoostMonitorTest, FindTargetsTest) {
+    const auto targets = BoostMonitor::FindTargets(actions_, nodes_);
+    ASSERT_EQ(1u, targets.size());
+    ASSERT_EQ(1u, targets.at("LAUNCH").size());
+    EXPECT_EQ(policy_dir_, targets.at("LAUNCH")[0].policy_dir);
+    EXPECT_EQ(1500000u, targets.at("LAUNCH")[0].min_khz);
+}
+
+TEST_F(BoostMonitorTest, SampleTest) {
+    auto status = std::make_shared<HintStatus>(100ms);
+    const auto targets = BoostMonitor::FindTargets(actions_, nodes_);
+    BoostMonitor monitor(1h, {{status, targets.at("LAUNCH")}});
+
+    // Nothing counted while the hint isn't active
+    SetFreqs("1500000", "2000000");
+    EXPECT_FALSE(monitor.Sample());
+    EXPECT_EQ(0u, status->boost.samples);
+
+    Activate(status.get());
+    EXPECT_TRUE(monitor.Sample());
+    // Capped below the boost, e.g. by thermal
+    SetFreqs("1000000", "1200000");
+    EXPECT_TRUE(monitor.Sample());
+    SetFreqs("1000000", "2000000");
+    EXPECT_TRUE(monitor.Sample());
+    EXPECT_EQ(3u, status->boost.samples);
+    EXPECT_EQ(1u, status->boost.effective);
+    EXPECT_EQ(1u, status->boost.clipped);
+    EXPECT_EQ(1u, status->boost.below);
+
+    // Unreadable frequencies are skipped
+    ASSERT_EQ(0, unlink((policy_dir_ + "/scaling_cur_freq").c_str()));
+    EXPECT_TRUE(monitor.Sample());
+    EXPECT_EQ(3u, status->boost.samples);
+}
+
+TEST_F(BoostMonitorTest, WakeTest) {
+    auto status = std::make_shared<HintStatus>(100ms);
+    const auto targets = BoostMonitor::FindTargets(actions_, nodes_);
+    BoostMonitor monitor(1ms, {{status, targets.at("LAUNCH")}});
+    SetFreqs("1500000", "2000000");
+    Activate(status.get());
+    monitor.Wake();
+    for (int i = 0; i < 100 && status->boost.samples < 3; i++) {
+        std::this_thread::sleep_for(10ms);
+    }
+    EXPECT_GE(status->boost.samples, 3u);
+    monitor.Stop();
+    // No sampling after Stop
+    const uint64_t samples = status->boost.samples;
+    monitor.Wake();
+    std::this_thread::sleep_for(20ms);
+    EXPECT_EQ(samples, status->boost.samples);
+}
+
+}  // namespace perfmgr
+}  // namespace android
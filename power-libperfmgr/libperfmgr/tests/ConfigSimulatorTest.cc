@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specic language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <gtest/gtest.h>
+
+#include "perfmgr/ConfigSimulator.h"
+#include "perfmgr/FileNode.h"
+
+namespace android {
+namespace perfmgr {
+
+using std::literals::chrono_literals::operator""ms;
+using std::literals::chrono_literals::operator""us;
+
+class ConfigSimulatorTest : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+        nodes_.emplace_back(
+                new FileNode("n0", "/n0", {{"v0"}, {"v1"}, {"v2"}}, 2, false, false));
+        nodes_.emplace_back(new FileNode("n1", "/n1", {{"v0"}, {"v1"}}, 1, false, false));
+        // "LAUNCH": n0 v0 500ms, n1 v0 forever
+        // "INTERACTION": n0 v1 100ms
+        actions_["LAUNCH"].node_actions = std::vector<NodeAction>{{0, 0, 500ms}, {1, 0, 0ms}};
+        actions_["INTERACTION"].node_actions = std::vector<NodeAction>{{0, 1, 100ms}};
+        latencies_["/n1"] = 100us;
+        latencies_["*"] = 10us;
+    }
+
+    std::vector<std::unique_ptr<Node>> nodes_;
+    std::unordered_map<std::string, Hint> actions_;
+    std::unordered_map<std::string, std::chrono::microseconds> latencies_;
+};
+
+// Test parsing both trace formats
+TEST_F(ConfigSimulatorTest, ParseTraceTest) {
+    std::vector<ConfigSimulator::HintEvent> events;
+    EXPECT_TRUE(ConfigSimulator::ParseTrace(R"(
+# tracer: nop
+0 do INTERACTION
+10 do LAUNCH 300
+20 end LAUNCH
+  android.hardwar-1234  ( 1234) [002] ...1  12.500000: tracing_mark_write: C|1234|LAUNCH|5000
+  android.hardwar-1234  ( 1234) [002] ...1  12.750000: tracing_mark_write: C|1234|LAUNCH|0
+  android.hardwar-1234  ( 1234) [002] ...1  13.000000: tracing_mark_write: C|1234|HOLD|2147483647
+          <idle>-0     (-----) [000] d..2  13.100000: sched_switch: prev_comm=swapper/0
+)",
+                                            &events));
+    ASSERT_EQ(6u, events.size());
+    EXPECT_EQ(0ms, events[0].time);
+    EXPECT_EQ("INTERACTION", events[0].hint_type);
+    EXPECT_FALSE(events[0].end);
+    EXPECT_FALSE(events[0].duration.has_value());
+    EXPECT_EQ(300ms, events[1].duration.value_or(0ms));
+    EXPECT_TRUE(events[2].end);
+    EXPECT_EQ(12500ms, events[3].time);
+    EXPECT_EQ("LAUNCH", events[3].hint_type);
+    EXPECT_EQ(5000ms, events[3].duration.value_or(0ms));
+    EXPECT_TRUE(events[4].end);
+    EXPECT_EQ(0ms, events[5].duration.value_or(1ms));
+
+    EXPECT_FALSE(ConfigSimulator::ParseTrace("10 boost LAUNCH\n", &events));
+    EXPECT_FALSE(ConfigSimulator::ParseTrace("10 do\n", &events));
+    EXPECT_FALSE(ConfigSimulator::ParseTrace("10 do LAUNCH -5\n", &events));
+}
+
+// Test parsing the latency table
+TEST_F(ConfigSimulatorTest, ParseLatencyTableTest) {
+    std::unordered_map<std::string, std::chrono::microseconds> latencies;
+    EXPECT_TRUE(ConfigSimulator::ParseLatencyTable(
+            "# path latency\n/sys/a 120\n* 30  # others\n\n", &latencies));
+    EXPECT_EQ(2u, latencies.size());
+    EXPECT_EQ(120us, latencies["/sys/a"]);
+    EXPECT_EQ(30us, latencies["*"]);
+    EXPECT_FALSE(ConfigSimulator::ParseLatencyTable("/sys/a fast\n", &latencies));
+}
+
+// Test writes, redundant writes and latencies charged to each hint
+TEST_F(ConfigSimulatorTest, RunTest) {
+    std::vector<ConfigSimulator::HintEvent> events;
+    ASSERT_TRUE(ConfigSimulator::ParseTrace(
+            "0 do INTERACTION\n50 do LAUNCH\n600 end LAUNCH\n700 do INTERACTION\n"
+            "720 end INTERACTION\n730 do INTERACTION\n800 do NO_SUCH_HINT\n",
+            &events));
+    ConfigSimulator simulator(nodes_, actions_, latencies_);
+    simulator.Run(events);
+    const auto &costs = simulator.GetHintCosts();
+    ASSERT_EQ(2u, costs.size());
+    // n0 at 0, 700, 720, 730 and on expiry at 830; the writes at 720 and 730
+    // flip n0 back within the window
+    const auto &interaction = costs.at("INTERACTION");
+    EXPECT_EQ(3u, interaction.do_count);
+    EXPECT_EQ(5u, interaction.writes);
+    EXPECT_EQ(2u, interaction.redundant_writes);
+    EXPECT_EQ(50us, interaction.write_latency);
+    // n0 and n1 at 50, n0 on expiry at 550, n1 at 600
+    const auto &launch = costs.at("LAUNCH");
+    EXPECT_EQ(1u, launch.do_count);
+    EXPECT_EQ(4u, launch.writes);
+    EXPECT_EQ(0u, launch.redundant_writes);
+    EXPECT_EQ(220us, launch.write_latency);
+    EXPECT_EQ(1u, simulator.GetUnknownEvents());
+    EXPECT_NE(std::string::npos, simulator.GetReport().find("INTERACTION\t3\t5\t2\t50\t16\n"));
+}
+
+// Test peak requests per group and masked hints
+TEST_F(ConfigSimulatorTest, PeakAndMaskTest) {
+    actions_["BOOST"].node_actions = std::vector<NodeAction>{{0, 0, 0ms}};
+    actions_["MASK_LAUNCH"].hint_actions.emplace_back(HintActionType::MaskHint, "LAUNCH", "");
+    std::vector<ConfigSimulator::HintEvent> events;
+    ASSERT_TRUE(ConfigSimulator::ParseTrace(
+            "0 do BOOST\n10 do LAUNCH\n20 do MASK_LAUNCH\n30 end LAUNCH\n40 do LAUNCH\n"
+            "50 end MASK_LAUNCH\n60 do LAUNCH\n",
+            &events));
+    ConfigSimulator simulator(nodes_, actions_, latencies_);
+    simulator.Run(events);
+    const auto &launch = simulator.GetHintCosts().at("LAUNCH");
+    EXPECT_EQ(3u, launch.do_count);
+    // n1 at 10, 30 and 60; the masked DoHint at 40 does nothing
+    EXPECT_EQ(3u, launch.writes);
+    const auto peaks = simulator.GetGroupPeaks();
+    ASSERT_EQ(2u, peaks.size());
+    EXPECT_EQ("n0", peaks[0].node);
+    EXPECT_EQ("v0", peaks[0].value);
+    EXPECT_EQ(2u, peaks[0].peak);
+    EXPECT_EQ("n1", peaks[1].node);
+    EXPECT_EQ(1u, peaks[1].peak);
+}
+
+}  // namespace perfmgr
+}  // namespace android
@@ -73,10 +73,17 @@ TEST(FileNodeTest, DumpToFdTest) {
             "Current Index\t"
             "Current Value\t"
             "Hold FD\t"
-            "Truncate\n"
-            "%s\t%s\t%zu\t%s\t%d\t%d\n",
-            "test_dump", tf.path, static_cast<size_t>(1), "value1", 0, 1));
-    _VerifyPathValue(dumptf.path, buf);
+            "Truncate\t"
+            "Cache FD\t"
+            "Write Count\t"
+            "Avg Write (us)\t"
+            "Max Write (us)\n"
+            "%s\t%s\t%zu\t%s\t%d\t%d\t%d\t%d\t",
+            "test_dump", tf.path, static_cast<size_t>(1), "value1", 0, 1, 0, 1));
+    std::string s;
+    EXPECT_TRUE(android::base::ReadFileToString(dumptf.path, &s)) << strerror(errno);
+    // Write latency varies from run to run, only check the deterministic part
+    EXPECT_EQ(buf, s.substr(0, buf.size()));
 }
 
 // Test GetValueIndex
@@ -193,6 +200,27 @@ TEST(FileNodeTest, RemoveRequestTest) {
     EXPECT_EQ(std::chrono::milliseconds::max(), expire_time);
 }
 
+// Test add request with cached fd
+TEST(FileNodeTest, AddRequestTestCacheFd) {
+    TemporaryFile tf;
+    FileNode t("t", tf.path, {{"value0_long"}, {"value1"}, {"value2"}}, 2, true, true, false,
+               false, true);
+    EXPECT_TRUE(t.GetCacheFd());
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::milliseconds expire_time = t.Update(true);
+    _VerifyPathValue(tf.path, "value2");
+    EXPECT_TRUE(t.AddRequest(0, "LAUNCH", start + 200ms));
+    expire_time = t.Update(true);
+    _VerifyPathValue(tf.path, "value0_long");
+    EXPECT_NEAR(std::chrono::milliseconds(200).count(), expire_time.count(),
+                kTIMING_TOLERANCE_MS);
+    // Shorter value must not leave the tail of the previous one behind
+    t.RemoveRequest("LAUNCH");
+    expire_time = t.Update(true);
+    _VerifyPathValue(tf.path, "value2");
+    EXPECT_EQ(std::chrono::milliseconds::max(), expire_time);
+}
+
 // Test add request with holding fd
 TEST(FileNodeTest, AddRequestTestHoldFdOverride) {
     TemporaryFile tf;
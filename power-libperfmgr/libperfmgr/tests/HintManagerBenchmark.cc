@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "perfmgr/ConfigCache.h"
+#include "perfmgr/HintManager.h"
+
+namespace android {
+namespace perfmgr {
+
+namespace {
+
+constexpr std::size_t kNodeCount = 100;
+constexpr std::size_t kHintCount = 80;
+constexpr std::size_t kActionsPerHint = 20;
+
+// Expose the protected parser helpers to the benchmarks
+class BenchHintManager : public HintManager {
+  public:
+    using HintManager::InitHintStatus;
+    using HintManager::ParseConfig;
+};
+
+// Generate a config of production size with FileNodes backed by files in dir
+std::string MakeConfig(const std::string &dir) {
+    std::string json = "{\n  \"Nodes\": [\n";
+    for (std::size_t i = 0; i < kNodeCount; i++) {
+        const std::string path = android::base::StringPrintf("%s/node%zu", dir.c_str(), i);
+        android::base::WriteStringToFile("", path);
+        json += android::base::StringPrintf(
+                "    {\"Name\": \"Node%zu\", \"Path\": \"%s\", \"Values\": [\"3\", \"2\", \"1\", "
+                "\"0\"], \"DefaultIndex\": 3, \"ResetOnInit\": true, \"CacheFd\": %s}%s\n",
+                i, path.c_str(), (i % 2) ? "true" : "false", i + 1 < kNodeCount ? "," : "");
+    }
+    json += "  ],\n  \"Actions\": [\n";
+    for (std::size_t h = 0; h < kHintCount; h++) {
+        for (std::size_t k = 0; k < kActionsPerHint; k++) {
+            json += android::base::StringPrintf(
+                    "    {\"PowerHint\": \"HINT_%zu\", \"Node\": \"Node%zu\", \"Value\": \"%zu\", "
+                    "\"Duration\": %zu}%s\n",
+                    h, (h + k) % kNodeCount, k % 3, (k % 4) * 500,
+                    (h + 1 < kHintCount || k + 1 < kActionsPerHint) ? "," : "");
+        }
+    }
+    json += "  ],\n  \"AdpfConfig\": [\n";
+    for (std::size_t a = 0; a < 3; a++) {
+        json += android::base::StringPrintf(
+                "    {\"Name\": \"PROFILE_%zu\", \"PID_On\": true, \"PID_Po\": 5.0, \"PID_Pu\": "
+                "3.0, \"PID_I\": 0.001, \"PID_I_Init\": 200, \"PID_I_High\": 512, "
+                "\"PID_I_Low\": -120, \"PID_Do\": 500.0, \"PID_Du\": 0.0, \"UclampMin_On\": true, "
+                "\"UclampMin_Init\": 162, \"UclampMin_High\": 480, \"UclampMin_Low\": 2, "
+                "\"SamplingWindow_P\": 1, \"SamplingWindow_I\": 0, \"SamplingWindow_D\": 1, "
+                "\"ReportingRateLimitNs\": 166666660, \"TargetTimeFactor\": 1.0, "
+                "\"StaleTimeFactor\": 10.0}%s\n",
+                a, a + 1 < 3 ? "," : "");
+    }
+    json += "  ]\n}\n";
+    return json;
+}
+
+// Config files and a started HintManager shared by the benchmarks
+struct BenchEnv {
+    BenchEnv() {
+        json_doc = MakeConfig(dir.path);
+        json_path = std::string(dir.path) + "/powerhint.json";
+        android::base::WriteStringToFile(json_doc, json_path);
+        PowerConfig config;
+        BenchHintManager::ParseConfig(json_doc, json_path, &config);
+        sp<NodeLooperThread> nm = new NodeLooperThread(std::move(config.nodes));
+        hm = std::make_unique<HintManager>(nm, config.actions, config.adpfs,
+                                           config.gpu_sysfs_config_path);
+        BenchHintManager::InitHintStatus(hm);
+        hm->Start();
+    }
+
+    TemporaryDir dir;
+    std::string json_doc;
+    std::string json_path;
+    std::unique_ptr<HintManager> hm;
+};
+
+BenchEnv &GetEnv() {
+    static BenchEnv *env = new BenchEnv();
+    return *env;
+}
+
+}  // namespace
+
+// DoHint/EndHint pairs from concurrent callers, each on its own hint
+static void BM_DoHintEndHint(benchmark::State &state) {
+    HintManager *hm = GetEnv().hm.get();
+    const HintId hint = HintManager::LookupHint(
+            android::base::StringPrintf("HINT_%zu", state.thread_index() % kHintCount));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(hm->DoHint(hint));
+        benchmark::DoNotOptimize(hm->EndHint(hint));
+    }
+}
+BENCHMARK(BM_DoHintEndHint)->Threads(1)->Threads(4)->Threads(8)->UseRealTime();
+
+// Same with every caller on one hint, the contended case
+static void BM_DoHintEndHintSameHint(benchmark::State &state) {
+    HintManager *hm = GetEnv().hm.get();
+    const HintId hint = HintManager::LookupHint("HINT_0");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(hm->DoHint(hint));
+        benchmark::DoNotOptimize(hm->EndHint(hint));
+    }
+}
+BENCHMARK(BM_DoHintEndHintSameHint)->Threads(1)->Threads(4)->Threads(8)->UseRealTime();
+
+// One looper update sweep over every node, each switching its value. Uses
+// its own nodes so the running looper of the other benchmarks doesn't race.
+static void BM_UpdateSweep(benchmark::State &state) {
+    TemporaryDir dir;
+    PowerConfig config;
+    BenchHintManager::ParseConfig(MakeConfig(dir.path), "sweep", &config);
+    const HintId hint = HintManager::LookupHint("SWEEP");
+    std::size_t value_index = 0;
+    for (auto _ : state) {
+        value_index ^= 1;
+        for (auto &node : config.nodes) {
+            node->RemoveRequest(hint);
+            node->AddRequest(value_index, hint, ReqTime::max());
+            benchmark::DoNotOptimize(node->Update(true));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * config.nodes.size());
+}
+BENCHMARK(BM_UpdateSweep);
+
+// Full JSON parse of a production sized config
+static void BM_GetFromJSON(benchmark::State &state) {
+    BenchEnv &env = GetEnv();
+    for (auto _ : state) {
+        PowerConfig config;
+        benchmark::DoNotOptimize(BenchHintManager::ParseConfig(env.json_doc, env.json_path, &config));
+    }
+}
+BENCHMARK(BM_GetFromJSON)->Unit(benchmark::kMicrosecond);
+
+// Load of the same config from its compiled cache
+static void BM_GetFromConfigCache(benchmark::State &state) {
+    BenchEnv &env = GetEnv();
+    const std::string cache_path = HintManager::GetConfigCachePath(env.json_path);
+    {
+        PowerConfig config;
+        BenchHintManager::ParseConfig(env.json_doc, env.json_path, &config);
+        ConfigCache::Write(cache_path, config, HintManager::GetConfigKey(env.json_doc));
+    }
+    for (auto _ : state) {
+        PowerConfig config;
+        benchmark::DoNotOptimize(ConfigCache::Load(
+                cache_path, HintManager::GetConfigKey(env.json_doc), &config));
+    }
+}
+BENCHMARK(BM_GetFromConfigCache)->Unit(benchmark::kMicrosecond);
+
+}  // namespace perfmgr
+}  // namespace android
@@ -25,6 +25,7 @@
 #include <thread>
 
 #include "perfmgr/AdpfConfig.h"
+#include "perfmgr/ConfigCache.h"
 #include "perfmgr/FileNode.h"
 #include "perfmgr/HintManager.h"
 #include "perfmgr/PropertyNode.h"
@@ -51,7 +52,8 @@ constexpr char kJSON_RAW[] = R"(
                 "384000"
             ],
             "DefaultIndex": 2,
-            "ResetOnInit": true
+            "ResetOnInit": true,
+            "CacheFd": true
         },
         {
             "Name": "CPUCluster1MinFreq",
@@ -187,7 +189,21 @@ constexpr char kJSON_RAW[] = R"(
             "HBoostUclampMin": 800,
             "JankCheckTimeFactor": 1.2,
             "LowFrameRateThreshold": 25,
-            "MaxRecordsNum": 50
+            "MaxRecordsNum": 50,
+            "PredictiveBoost_On": true,
+            "PredictiveBoostUclampMin": 600,
+            "WorkerThreads": 2,
+            "GpuCapacityFilterUp": 0.5,
+            "GpuCapacityFilterDown": 0.25,
+            "EnergyAware_On": true,
+            "EnergyAwareUclampStep": 64,
+            "EnergyAwareWindowFrames": 30,
+            "SessionTaskProfile": "SessionPlacementBig",
+            "SessionTaskProfileRevert": "SessionPlacementDefault",
+            "SessionTaskProfileTags": "GAME,HWUI",
+            "GpuCoBoost_On": true,
+            "GpuCoBoostFactor": 0.5,
+            "GpuCoBoostFrames": 4
         },
         {
             "Name": "REFRESH_60FPS",
@@ -402,6 +418,41 @@ TEST_F(HintManagerTest, HintTest) {
     _VerifyPropertyValue(prop_, "n2_value2");
 }
 
+// Test hint/cancel with HintId handles
+TEST_F(HintManagerTest, HintIdTest) {
+    auto hm =
+            std::make_unique<HintManager>(nm_, actions_, std::vector<std::shared_ptr<AdpfConfig>>(),
+                                          std::optional<std::string>{});
+    EXPECT_TRUE(InitHintStatus(hm));
+    EXPECT_TRUE(hm->Start());
+    const std::size_t interned = HintIdTable::Size();
+    const HintId launch = HintManager::LookupHint("LAUNCH");
+    const HintId no_such_hint = HintManager::LookupHint("NO_SUCH_HINT");
+    EXPECT_EQ(launch, HintManager::LookupHint("LAUNCH"));
+    EXPECT_EQ(kInvalidHintId, no_such_hint);
+    // Looking up names, supported or not, doesn't grow the table
+    EXPECT_EQ(0u, hm->GetHintStats("NO_SUCH_HINT").count);
+    EXPECT_FALSE(hm->DoHint("NO_SUCH_HINT"));
+    EXPECT_EQ(interned, HintIdTable::Size());
+    EXPECT_EQ("LAUNCH", HintIdTable::GetName(launch));
+    EXPECT_TRUE(hm->IsHintSupported(launch));
+    EXPECT_FALSE(hm->IsHintSupported(no_such_hint));
+    EXPECT_FALSE(hm->IsHintSupported(kInvalidHintId));
+    EXPECT_FALSE(hm->DoHint(no_such_hint));
+    EXPECT_FALSE(hm->EndHint(no_such_hint));
+    EXPECT_TRUE(hm->DoHint(launch, 200ms));
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    _VerifyPathValue(files_[0]->path, "n0_value0");
+    _VerifyPathValue(files_[1]->path, "n1_value0");
+    _VerifyPropertyValue(prop_, "n2_value0");
+    EXPECT_TRUE(hm->EndHint(launch));
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    _VerifyPathValue(files_[0]->path, "n0_value2");
+    _VerifyPathValue(files_[1]->path, "n1_value2");
+    _VerifyPropertyValue(prop_, "n2_value2");
+    EXPECT_EQ(1u, hm->GetHintStats("LAUNCH").count);
+}
+
 // Test collecting stats with simple actions
 TEST_F(HintManagerTest, HintStatsTest) {
     auto hm =
@@ -446,6 +497,68 @@ TEST_F(HintManagerTest, HintStatsTest) {
     _VerifyStats(launch_stats, 2, 500, 600);
 }
 
+// Test stats stay consistent with DoHint/EndHint racing on the same hint
+TEST_F(HintManagerTest, HintStatsConcurrentTest) {
+    auto hm =
+            std::make_unique<HintManager>(nm_, actions_, std::vector<std::shared_ptr<AdpfConfig>>(),
+                                          std::optional<std::string>{});
+    EXPECT_TRUE(InitHintStatus(hm));
+    EXPECT_TRUE(hm->Start());
+    constexpr int kThreads = 4;
+    constexpr int kIterations = 500;
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([&hm, t]() {
+            for (int i = 0; i < kIterations; i++) {
+                EXPECT_TRUE(hm->DoHint("LAUNCH", 100ms));
+                if ((i + t) % 4 == 0) {
+                    EXPECT_TRUE(hm->EndHint("LAUNCH"));
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    EXPECT_TRUE(hm->EndHint("LAUNCH"));
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start);
+    HintStats launch_stats(hm->GetHintStats("LAUNCH"));
+    // Every hint interval lies within the run, so the recorded duration can't
+    // exceed it.
+    _VerifyStats(launch_stats, kThreads * kIterations, 0, elapsed.count() + 1);
+}
+
+// Test masking by more requesters than mask bits
+TEST_F(HintManagerTest, MaskHintManyRequestersTest) {
+    constexpr int kRequesters = Hint::kMaxMaskBits + 2;
+    std::unordered_map<std::string, Hint> actions = actions_;
+    for (int i = 0; i < kRequesters; i++) {
+        Hint hint;
+        hint.hint_actions.emplace_back(HintActionType::MaskHint, "LAUNCH", "");
+        actions.emplace("MASK_" + std::to_string(i), hint);
+    }
+    auto hm = std::make_unique<HintManager>(nm_, actions,
+                                            std::vector<std::shared_ptr<AdpfConfig>>(),
+                                            std::optional<std::string>{});
+    EXPECT_TRUE(InitHintStatus(hm));
+    EXPECT_TRUE(hm->Start());
+    for (int i = 0; i < kRequesters; i++) {
+        EXPECT_TRUE(hm->DoHint("MASK_" + std::to_string(i)));
+        EXPECT_FALSE(hm->IsHintEnabled("LAUNCH"));
+    }
+    EXPECT_FALSE(hm->DoHint("LAUNCH"));
+    // The hint is masked until the last requester, with or without a bit, ends
+    for (int i = 0; i < kRequesters; i++) {
+        EXPECT_FALSE(hm->IsHintEnabled("LAUNCH"));
+        EXPECT_TRUE(hm->EndHint("MASK_" + std::to_string(i)));
+    }
+    EXPECT_TRUE(hm->IsHintEnabled("LAUNCH"));
+    EXPECT_TRUE(hm->DoHint("LAUNCH"));
+    EXPECT_TRUE(hm->IsHintEnabled("INTERACTION"));
+}
+
 // Test parsing nodes
 TEST_F(HintManagerTest, ParseNodesTest) {
     std::vector<std::unique_ptr<Node>> nodes =
@@ -468,6 +581,8 @@ TEST_F(HintManagerTest, ParseNodesTest) {
     // no dynamic_cast intentionally in Android
     EXPECT_FALSE(reinterpret_cast<FileNode*>(nodes[0].get())->GetHoldFd());
     EXPECT_TRUE(reinterpret_cast<FileNode*>(nodes[1].get())->GetHoldFd());
+    EXPECT_TRUE(reinterpret_cast<FileNode*>(nodes[0].get())->GetCacheFd());
+    EXPECT_FALSE(reinterpret_cast<FileNode*>(nodes[1].get())->GetCacheFd());
     EXPECT_EQ("ModeProperty", nodes[2]->GetName());
     EXPECT_EQ(prop_, nodes[2]->GetPath());
     EXPECT_EQ("HIGH", nodes[2]->GetValues()[0]);
@@ -477,6 +592,52 @@ TEST_F(HintManagerTest, ParseNodesTest) {
     EXPECT_FALSE(nodes[2]->GetResetOnInit());
 }
 
+// Test parsing nodes with dependency
+TEST_F(HintManagerTest, ParseNodesDependsOnTest) {
+    std::string from = "\"CacheFd\": true";
+    size_t start_pos = json_doc_.find(from);
+    json_doc_.replace(start_pos, from.length(), from + ", \"DependsOn\": \"CPUCluster1MinFreq\"");
+    std::vector<std::unique_ptr<Node>> nodes = HintManager::ParseNodes(json_doc_);
+    EXPECT_EQ(4u, nodes.size());
+    EXPECT_EQ("CPUCluster1MinFreq", nodes[0]->GetDependsOn());
+    EXPECT_EQ("", nodes[1]->GetDependsOn());
+}
+
+// Test parsing nodes with unknown or cyclic dependency
+TEST_F(HintManagerTest, ParseNodesBadDependsOnTest) {
+    std::string from = "\"CacheFd\": true";
+    size_t start_pos = json_doc_.find(from);
+    std::string json_doc = json_doc_;
+    json_doc.replace(start_pos, from.length(), from + ", \"DependsOn\": \"NoSuchNode\"");
+    EXPECT_EQ(0u, HintManager::ParseNodes(json_doc).size());
+    json_doc = json_doc_;
+    json_doc.replace(start_pos, from.length(), from + ", \"DependsOn\": \"CPUCluster0MinFreq\"");
+    EXPECT_EQ(0u, HintManager::ParseNodes(json_doc).size());
+    json_doc = json_doc_;
+    json_doc.replace(start_pos, from.length(), from + ", \"DependsOn\": \"CPUCluster1MinFreq\"");
+    from = "\"HoldFd\": true";
+    start_pos = json_doc.find(from);
+    json_doc.replace(start_pos, from.length(), from + ", \"DependsOn\": \"CPUCluster0MinFreq\"");
+    EXPECT_EQ(0u, HintManager::ParseNodes(json_doc).size());
+}
+
+// Test parsing nodes with write lanes
+TEST_F(HintManagerTest, ParseNodesWriteLaneTest) {
+    std::string from = "\"CacheFd\": true";
+    size_t start_pos = json_doc_.find(from);
+    std::string json_doc = json_doc_;
+    json_doc.replace(start_pos, from.length(), from + ", \"WriteLane\": \"cpu0\"");
+    std::vector<std::unique_ptr<Node>> nodes = HintManager::ParseNodes(json_doc);
+    EXPECT_EQ(4u, nodes.size());
+    EXPECT_EQ("cpu0", nodes[0]->GetWriteLane());
+    EXPECT_EQ("", nodes[1]->GetWriteLane());
+    // Dependency across lanes is rejected
+    json_doc = json_doc_;
+    json_doc.replace(start_pos, from.length(),
+                     from + ", \"WriteLane\": \"cpu0\", \"DependsOn\": \"CPUCluster1MinFreq\"");
+    EXPECT_EQ(0u, HintManager::ParseNodes(json_doc).size());
+}
+
 // Test parsing nodes with duplicate name
 TEST_F(HintManagerTest, ParseNodesDuplicateNameTest) {
     std::string from = "CPUCluster0MinFreq";
@@ -661,6 +822,29 @@ TEST_F(HintManagerTest, ParseActionDuplicatePropertyNodeTest) {
     EXPECT_EQ(0u, actions.size());
 }
 
+// Test parsing actions with values by thermal severity
+TEST_F(HintManagerTest, ParseActionThermalValuesTest) {
+    std::string from = R"("Value": "1134000",)";
+    size_t start_pos = json_doc_.find(from);
+    json_doc_.replace(start_pos, from.length(),
+                      from + R"( "ThermalValues": {"LIGHT": "384000", "SEVERE": "1134000"},)");
+    auto nodes = HintManager::ParseNodes(json_doc_);
+    auto actions = HintManager::ParseActions(json_doc_, nodes);
+    ASSERT_EQ(7u, actions.size());
+    EXPECT_EQ(std::vector<std::size_t>({1, 2, 2, 1, 1, 1, 1}),
+              actions["INTERACTION"].node_actions[0].thermal_value_index);
+    EXPECT_TRUE(actions["LAUNCH"].node_actions[0].thermal_value_index.empty());
+
+    // Values not defined in the node and unknown severities fail
+    std::string bad_value = json_doc_;
+    from = R"("LIGHT": "384000")";
+    bad_value.replace(bad_value.find(from), from.length(), R"("LIGHT": "1")");
+    EXPECT_EQ(0u, HintManager::ParseActions(bad_value, nodes).size());
+    std::string bad_severity = json_doc_;
+    bad_severity.replace(bad_severity.find(from), from.length(), R"("NONE": "384000")");
+    EXPECT_EQ(0u, HintManager::ParseActions(bad_severity, nodes).size());
+}
+
 // Test parsing invalid json for actions
 TEST_F(HintManagerTest, ParseBadActionsTest) {
     std::vector<std::unique_ptr<Node>> nodes =
@@ -850,6 +1034,27 @@ TEST_F(HintManagerTest, ParseAdpfConfigsTest) {
     EXPECT_FALSE(adpfs[1]->mLowFrameRateThreshold.has_value());
     EXPECT_EQ(50U, adpfs[0]->mMaxRecordsNum.value());
     EXPECT_FALSE(adpfs[1]->mMaxRecordsNum.has_value());
+    EXPECT_TRUE(adpfs[0]->mPredictiveBoostOn.value());
+    EXPECT_FALSE(adpfs[1]->mPredictiveBoostOn.has_value());
+    EXPECT_EQ(600U, adpfs[0]->mPredictiveBoostUclampMin.value());
+    EXPECT_FALSE(adpfs[1]->mPredictiveBoostUclampMin.has_value());
+    EXPECT_EQ(2U, adpfs[0]->mWorkerThreads.value());
+    EXPECT_FALSE(adpfs[1]->mWorkerThreads.has_value());
+    EXPECT_EQ(0.5, adpfs[0]->mGpuCapacityFilterUp.value());
+    EXPECT_EQ(0.25, adpfs[0]->mGpuCapacityFilterDown.value());
+    EXPECT_FALSE(adpfs[1]->mGpuCapacityFilterUp.has_value());
+    EXPECT_TRUE(adpfs[0]->mEnergyAwareOn.value());
+    EXPECT_EQ(64U, adpfs[0]->mEnergyAwareUclampStep.value());
+    EXPECT_EQ(30U, adpfs[0]->mEnergyAwareWindowFrames.value());
+    EXPECT_FALSE(adpfs[1]->mEnergyAwareOn.has_value());
+    EXPECT_EQ("SessionPlacementBig", adpfs[0]->mSessionTaskProfile.value());
+    EXPECT_EQ("SessionPlacementDefault", adpfs[0]->mSessionTaskProfileRevert.value());
+    EXPECT_EQ("GAME,HWUI", adpfs[0]->mSessionTaskProfileTags.value());
+    EXPECT_FALSE(adpfs[1]->mSessionTaskProfile.has_value());
+    EXPECT_TRUE(adpfs[0]->mGpuCoBoostOn.value());
+    EXPECT_EQ(0.5, adpfs[0]->mGpuCoBoostFactor.value());
+    EXPECT_EQ(4U, adpfs[0]->mGpuCoBoostFrames.value());
+    EXPECT_FALSE(adpfs[1]->mGpuCoBoostOn.has_value());
 }
 
 // Test parsing adpf configs with duplicate name
@@ -879,6 +1084,39 @@ TEST_F(HintManagerTest, ParseAdpfConfigsWithBrokenHBoostConfig) {
     EXPECT_EQ(0u, adpfs.size());
 }
 
+// Test parsing adpf configs with partially missing predictive boost config
+TEST_F(HintManagerTest, ParseAdpfConfigsWithBrokenPredictiveBoostConfig) {
+    std::string from = "\"PredictiveBoostUclampMin\": 600";
+    size_t start_pos = json_doc_.find(from);
+    json_doc_.replace(start_pos, from.length(), "\"PredictiveBoostUclampMinTypo\": 600");
+    std::vector<std::shared_ptr<AdpfConfig>> adpfs = HintManager::ParseAdpfConfigs(json_doc_);
+    EXPECT_EQ(0u, adpfs.size());
+}
+
+TEST_F(HintManagerTest, ParseAdpfConfigsWithBrokenEnergyAwareConfig) {
+    std::string from = "\"EnergyAwareWindowFrames\": 30";
+    size_t start_pos = json_doc_.find(from);
+    json_doc_.replace(start_pos, from.length(), "\"EnergyAwareWindowFrames\": 0");
+    std::vector<std::shared_ptr<AdpfConfig>> adpfs = HintManager::ParseAdpfConfigs(json_doc_);
+    EXPECT_EQ(0u, adpfs.size());
+}
+
+TEST_F(HintManagerTest, ParseAdpfConfigsWithBrokenTaskProfileConfig) {
+    std::string from = "\"SessionTaskProfileRevert\"";
+    size_t start_pos = json_doc_.find(from);
+    json_doc_.replace(start_pos, from.length(), "\"SessionTaskProfileRevertTypo\"");
+    std::vector<std::shared_ptr<AdpfConfig>> adpfs = HintManager::ParseAdpfConfigs(json_doc_);
+    EXPECT_EQ(0u, adpfs.size());
+}
+
+TEST_F(HintManagerTest, ParseAdpfConfigsWithBrokenGpuCoBoostConfig) {
+    std::string from = "\"GpuCoBoostFrames\": 4";
+    size_t start_pos = json_doc_.find(from);
+    json_doc_.replace(start_pos, from.length(), "\"GpuCoBoostFrames\": 0");
+    std::vector<std::shared_ptr<AdpfConfig>> adpfs = HintManager::ParseAdpfConfigs(json_doc_);
+    EXPECT_EQ(0u, adpfs.size());
+}
+
 // Test hint/cancel/expire with json config
 TEST_F(HintManagerTest, GetFromJSONAdpfConfigTest) {
     TemporaryFile json_file;
@@ -931,5 +1169,159 @@ TEST_F(HintManagerTest, GpuConfigSupport) {
     EXPECT_EQ(profile->mGpuCapacityLoadUpHeadroom, 0);
 }
 
+// Test the compiled config cache round trip
+TEST_F(HintManagerTest, ConfigCacheTest) {
+    PowerConfig config;
+    ASSERT_TRUE(ParseConfig(json_doc_, "test", &config));
+    const uint64_t key = GetConfigKey(json_doc_);
+    const std::string cache = ConfigCache::Serialize(config, key);
+
+    PowerConfig loaded;
+    ASSERT_TRUE(ConfigCache::Deserialize(cache.data(), cache.size(), key, &loaded));
+    ASSERT_EQ(config.nodes.size(), loaded.nodes.size());
+    for (std::size_t i = 0; i < config.nodes.size(); ++i) {
+        EXPECT_EQ(config.nodes[i]->GetName(), loaded.nodes[i]->GetName());
+        EXPECT_EQ(config.nodes[i]->GetPath(), loaded.nodes[i]->GetPath());
+        EXPECT_STREQ(config.nodes[i]->GetType(), loaded.nodes[i]->GetType());
+        EXPECT_EQ(config.nodes[i]->GetValues(), loaded.nodes[i]->GetValues());
+        EXPECT_EQ(config.nodes[i]->GetDefaultIndex(), loaded.nodes[i]->GetDefaultIndex());
+        EXPECT_EQ(config.nodes[i]->GetResetOnInit(), loaded.nodes[i]->GetResetOnInit());
+        EXPECT_EQ(config.nodes[i]->GetDependsOn(), loaded.nodes[i]->GetDependsOn());
+        EXPECT_EQ(config.nodes[i]->GetWriteLane(), loaded.nodes[i]->GetWriteLane());
+    }
+    EXPECT_TRUE(static_cast<FileNode *>(loaded.nodes[0].get())->GetCacheFd());
+    EXPECT_TRUE(static_cast<FileNode *>(loaded.nodes[1].get())->GetHoldFd());
+
+    ASSERT_EQ(config.actions.size(), loaded.actions.size());
+    for (const auto &[hint_type, hint] : config.actions) {
+        const Hint &loaded_hint = loaded.actions[hint_type];
+        ASSERT_EQ(hint.node_actions.size(), loaded_hint.node_actions.size());
+        for (std::size_t i = 0; i < hint.node_actions.size(); ++i) {
+            EXPECT_EQ(hint.node_actions[i].node_index, loaded_hint.node_actions[i].node_index);
+            EXPECT_EQ(hint.node_actions[i].value_index, loaded_hint.node_actions[i].value_index);
+            EXPECT_EQ(hint.node_actions[i].timeout_ms, loaded_hint.node_actions[i].timeout_ms);
+            EXPECT_EQ(hint.node_actions[i].enable_property,
+                      loaded_hint.node_actions[i].enable_property);
+        }
+        ASSERT_EQ(hint.hint_actions.size(), loaded_hint.hint_actions.size());
+        for (std::size_t i = 0; i < hint.hint_actions.size(); ++i) {
+            EXPECT_EQ(hint.hint_actions[i].type, loaded_hint.hint_actions[i].type);
+            EXPECT_EQ(hint.hint_actions[i].value_id, loaded_hint.hint_actions[i].value_id);
+        }
+    }
+
+    ASSERT_EQ(config.adpfs.size(), loaded.adpfs.size());
+    for (std::size_t i = 0; i < config.adpfs.size(); ++i) {
+        EXPECT_EQ(config.adpfs[i]->mName, loaded.adpfs[i]->mName);
+        EXPECT_EQ(config.adpfs[i]->mPidPo, loaded.adpfs[i]->mPidPo);
+        EXPECT_EQ(config.adpfs[i]->mReportingRateLimitNs, loaded.adpfs[i]->mReportingRateLimitNs);
+        EXPECT_EQ(config.adpfs[i]->mGpuBoostOn, loaded.adpfs[i]->mGpuBoostOn);
+        EXPECT_EQ(config.adpfs[i]->mGpuBoostCapacityMax, loaded.adpfs[i]->mGpuBoostCapacityMax);
+        EXPECT_EQ(config.adpfs[i]->mUclampMinLoadUp, loaded.adpfs[i]->mUclampMinLoadUp);
+    }
+    EXPECT_EQ(config.gpu_sysfs_config_path, loaded.gpu_sysfs_config_path);
+
+    // Stale, corrupted or truncated caches are rejected
+    PowerConfig rejected;
+    EXPECT_FALSE(ConfigCache::Deserialize(cache.data(), cache.size(), key + 1, &rejected));
+    std::string corrupted = cache;
+    corrupted.back() ^= 0xff;
+    EXPECT_FALSE(ConfigCache::Deserialize(corrupted.data(), corrupted.size(), key, &rejected));
+    EXPECT_FALSE(ConfigCache::Deserialize(cache.data(), cache.size() - 1, key, &rejected));
+    EXPECT_TRUE(rejected.nodes.empty());
+}
+
+// Test GetFromJSON prefers a matching config cache and ignores a stale one
+TEST_F(HintManagerTest, GetFromJSONConfigCacheTest) {
+    TemporaryFile json_file;
+    ASSERT_TRUE(android::base::WriteStringToFile(json_doc_, json_file.path)) << strerror(errno);
+    const std::string cache_path = GetConfigCachePath(json_file.path);
+    PowerConfig config;
+    ASSERT_TRUE(ParseConfig(json_doc_, json_file.path, &config));
+    // Drop one hint from the cached config to tell which one got loaded
+    config.actions.erase("LAUNCH");
+
+    ASSERT_TRUE(ConfigCache::Write(cache_path, config, GetConfigKey(json_doc_)));
+    HintManager *hm = HintManager::GetFromJSON(json_file.path, false);
+    ASSERT_NE(nullptr, hm);
+    EXPECT_FALSE(hm->IsHintSupported("LAUNCH"));
+    EXPECT_TRUE(hm->IsHintSupported("INTERACTION"));
+
+    ASSERT_TRUE(ConfigCache::Write(cache_path, config, GetConfigKey(json_doc_ + " ")));
+    hm = HintManager::GetFromJSON(json_file.path, false);
+    ASSERT_NE(nullptr, hm);
+    EXPECT_TRUE(hm->IsHintSupported("LAUNCH"));
+    unlink(cache_path.c_str());
+}
+
+// Test switching config without dropping active hints
+TEST_F(HintManagerTest, ReloadFromJSONTest) {
+    TemporaryFile json_file;
+    ASSERT_TRUE(android::base::WriteStringToFile(json_doc_, json_file.path)) << strerror(errno);
+    HintManager *hm = HintManager::GetFromJSON(json_file.path, true);
+    ASSERT_NE(nullptr, hm);
+    EXPECT_TRUE(hm->DoHint("INTERACTION"));
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    _VerifyPathValue(files_[1 + 2]->path, "1134000");
+    _VerifyPropertyValue(prop_, "LOW");
+
+    // Boost CPUCluster1MinFreq higher on INTERACTION
+    std::string json_doc = json_doc_;
+    const std::string from = R"("Node": "CPUCluster1MinFreq",
+            "Value": "1134000")";
+    const size_t start_pos = json_doc.find(from);
+    ASSERT_NE(std::string::npos, start_pos);
+    json_doc.replace(start_pos, from.length(), R"("Node": "CPUCluster1MinFreq",
+            "Value": "1512000")");
+    ASSERT_TRUE(android::base::WriteStringToFile(json_doc, json_file.path)) << strerror(errno);
+    EXPECT_TRUE(HintManager::ReloadFromJSON(json_file.path));
+    hm = HintManager::GetInstance();
+    EXPECT_TRUE(hm->IsRunning());
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    // The active INTERACTION request now holds the new value
+    _VerifyPathValue(files_[1 + 2]->path, "1512000");
+    _VerifyPropertyValue(prop_, "LOW");
+    EXPECT_EQ(1u, hm->GetHintStats("INTERACTION").count);
+    EXPECT_TRUE(hm->EndHint("INTERACTION"));
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    _VerifyPathValue(files_[1 + 2]->path, "384000");
+    _VerifyPropertyValue(prop_, "NONE");
+
+    // A broken config is rejected and the current one stays
+    ASSERT_TRUE(android::base::WriteStringToFile("{", json_file.path)) << strerror(errno);
+    EXPECT_FALSE(HintManager::ReloadFromJSON(json_file.path));
+    EXPECT_EQ(hm, HintManager::GetInstance());
+    EXPECT_TRUE(hm->DoHint("LAUNCH"));
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    _VerifyPropertyValue(prop_, "HIGH");
+}
+
+// Test reloads keep masks and replaced instances usable
+TEST_F(HintManagerTest, ReloadFromJSONMaskTest) {
+    TemporaryFile json_file;
+    ASSERT_TRUE(android::base::WriteStringToFile(json_doc_, json_file.path)) << strerror(errno);
+    HintManager *first = HintManager::GetFromJSON(json_file.path, true);
+    ASSERT_NE(nullptr, first);
+    EXPECT_TRUE(first->DoHint("MASK_LAUNCH_INTERACTION_MODE"));
+    EXPECT_FALSE(first->IsHintEnabled("LAUNCH"));
+    EXPECT_FALSE(first->IsHintEnabled("INTERACTION"));
+
+    EXPECT_TRUE(HintManager::ReloadFromJSON(json_file.path));
+    EXPECT_TRUE(HintManager::ReloadFromJSON(json_file.path));
+    HintManager *hm = HintManager::GetInstance();
+    ASSERT_NE(first, hm);
+    EXPECT_FALSE(hm->IsHintEnabled("LAUNCH"));
+    EXPECT_FALSE(hm->IsHintEnabled("INTERACTION"));
+
+    // Requests through the replaced instance go to the current one
+    EXPECT_TRUE(first->EndHint("MASK_LAUNCH_INTERACTION_MODE"));
+    EXPECT_TRUE(hm->IsHintEnabled("LAUNCH"));
+    EXPECT_TRUE(hm->IsHintEnabled("INTERACTION"));
+    EXPECT_TRUE(first->DoHint("LAUNCH"));
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    _VerifyPropertyValue(prop_, "HIGH");
+    EXPECT_EQ(1u, hm->GetHintStats("LAUNCH").count);
+}
+
 }  // namespace perfmgr
 }  // namespace android
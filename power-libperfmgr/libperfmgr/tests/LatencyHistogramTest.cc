@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specic language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <gtest/gtest.h>
+
+#include "perfmgr/LatencyHistogram.h"
+
+namespace android {
+namespace perfmgr {
+
+using std::literals::chrono_literals::operator""us;
+
+// Test every value maps to a bucket whose upper bound covers it
+TEST(LatencyHistogramTest, BucketIndexTest) {
+    for (uint64_t v = 0; v < 100000; v++) {
+        const std::size_t index = LatencyHistogram::GetBucketIndex(v);
+        ASSERT_LT(index, LatencyHistogram::kNumBuckets);
+        EXPECT_LE(v, LatencyHistogram::GetBucketUpperBound(index));
+        if (index > 0) {
+            EXPECT_GT(v, LatencyHistogram::GetBucketUpperBound(index - 1));
+        }
+    }
+    EXPECT_EQ(LatencyHistogram::kNumBuckets - 1, LatencyHistogram::GetBucketIndex(UINT64_MAX));
+}
+
+// Test percentiles stay within the relative error of a sub bucket
+TEST(LatencyHistogramTest, PercentileTest) {
+    LatencyHistogram histogram;
+    EXPECT_EQ(0, histogram.GetCount());
+    EXPECT_EQ(0us, histogram.GetPercentile(50));
+    for (int i = 1; i <= 1000; i++) {
+        histogram.Record(std::chrono::microseconds(i));
+    }
+    EXPECT_EQ(1000, histogram.GetCount());
+    EXPECT_EQ(1000us, histogram.GetMax());
+    for (double p : {50.0, 90.0, 99.0}) {
+        const double expect = p * 10;
+        const double actual = histogram.GetPercentile(p).count();
+        EXPECT_GE(actual, expect);
+        EXPECT_LE(actual, expect * (1.0 + 1.0 / LatencyHistogram::kSubBuckets));
+    }
+    EXPECT_EQ(1000us, histogram.GetPercentile(100));
+}
+
+}  // namespace perfmgr
+}  // namespace android
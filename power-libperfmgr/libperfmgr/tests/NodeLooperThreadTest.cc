@@ -18,6 +18,7 @@
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <atomic>
 #include <thread>
 
 #include "perfmgr/FileNode.h"
@@ -33,6 +34,9 @@ constexpr auto kSLEEP_TOLERANCE_MS = 50ms;
 class NodeLooperThreadTest : public ::testing::Test {
   protected:
     virtual void SetUp() {
+        // As parsing a config with these hints would
+        HintIdTable::Intern("LAUNCH");
+        HintIdTable::Intern("INTERACTION");
         std::unique_ptr<TemporaryFile> tf = std::make_unique<TemporaryFile>();
         nodes_.emplace_back(new FileNode(
             "n0", tf->path, {{"n0_value0"}, {"n0_value1"}, {"n0_value2"}}, 2,
@@ -53,6 +57,40 @@ class NodeLooperThreadTest : public ::testing::Test {
     std::vector<std::unique_ptr<TemporaryFile>> files_;
 };
 
+// Node that counts how many times it gets evaluated and logs value changes
+class CountingNode : public Node {
+  public:
+    explicit CountingNode(std::string name,
+                          std::vector<RequestGroup> values = {{"value0"}, {"value1"}},
+                          std::vector<std::string>* write_log = nullptr,
+                          std::chrono::milliseconds write_delay = 0ms)
+        : Node(std::move(name), "", values, values.size() - 1, false),
+          write_log_(write_log),
+          write_delay_(write_delay) {}
+    std::chrono::milliseconds Update(bool) override {
+        update_count_++;
+        std::chrono::milliseconds expire_time;
+        std::size_t value_index = GetTargetIndex(&expire_time);
+        if (value_index != current_val_index_) {
+            std::this_thread::sleep_for(write_delay_);
+            if (write_log_) {
+                write_log_->push_back(GetName() + ":" + GetValues()[value_index]);
+            }
+            current_val_index_ = value_index;
+            write_count_++;
+        }
+        return expire_time;
+    }
+    const char* GetType() const override { return "Counting"; }
+    void DumpToFd(int) const override {}
+    std::atomic<int> update_count_{0};
+    std::atomic<int> write_count_{0};
+
+  private:
+    std::vector<std::string>* write_log_;
+    const std::chrono::milliseconds write_delay_;
+};
+
 static inline void _VerifyPathValue(const std::string& path,
                                     const std::string& value) {
     std::string s;
@@ -95,6 +133,46 @@ TEST_F(NodeLooperThreadTest, AddRequest) {
     EXPECT_FALSE(th->isRunning());
 }
 
+// Test request and cancel of a hint name no config has
+TEST_F(NodeLooperThreadTest, UnknownHintRequest) {
+    sp<NodeLooperThread> th = new NodeLooperThread(std::move(nodes_));
+    EXPECT_TRUE(th->Start());
+    std::vector<NodeAction> actions{{0, 0, 200ms}};
+    const std::size_t interned = HintIdTable::Size();
+    EXPECT_FALSE(th->Request(actions, "NO_SUCH_HINT"));
+    EXPECT_FALSE(th->Cancel(actions, "NO_SUCH_HINT"));
+    EXPECT_EQ(kInvalidHintId, HintIdTable::Find("NO_SUCH_HINT"));
+    EXPECT_EQ(interned, HintIdTable::Size());
+    th->Stop();
+}
+
+// Test value picked by thermal severity
+TEST_F(NodeLooperThreadTest, ThermalValueRequest) {
+    sp<NodeLooperThread> th = new NodeLooperThread(std::move(nodes_));
+    EXPECT_TRUE(th->Start());
+    // Node0, value0 up to LIGHT, value1 from MODERATE on
+    std::vector<NodeAction> actions{{0, 0, 200ms}};
+    actions[0].thermal_value_index = {0, 0, 1, 1, 1, 1, 1};
+    EXPECT_TRUE(th->Request(actions, "LAUNCH"));
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    _VerifyPathValue(files_[0]->path, "n0_value0");
+    EXPECT_TRUE(th->Cancel(actions, "LAUNCH"));
+
+    th->SetThermalSeverity(2);
+    EXPECT_EQ(2, th->GetThermalSeverity());
+    EXPECT_TRUE(th->Request(actions, "LAUNCH"));
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    _VerifyPathValue(files_[0]->path, "n0_value1");
+    EXPECT_TRUE(th->Cancel(actions, "LAUNCH"));
+
+    // Out of range severities use the closest one
+    th->SetThermalSeverity(100);
+    EXPECT_TRUE(th->Request(actions, "LAUNCH"));
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    _VerifyPathValue(files_[0]->path, "n0_value1");
+    th->Stop();
+}
+
 // Test request to override expire time
 TEST_F(NodeLooperThreadTest, AddRequestOverride) {
     sp<NodeLooperThread> th = new NodeLooperThread(std::move(nodes_));
@@ -191,5 +269,210 @@ TEST_F(NodeLooperThreadTest, MultipleRequest) {
     EXPECT_FALSE(th->isRunning());
 }
 
+// Test only nodes touched by a request get re-evaluated
+TEST_F(NodeLooperThreadTest, DirtyNodeUpdate) {
+    std::vector<std::unique_ptr<Node>> nodes;
+    nodes.emplace_back(new CountingNode("c0"));
+    nodes.emplace_back(new CountingNode("c1"));
+    auto c0 = static_cast<CountingNode*>(nodes[0].get());
+    auto c1 = static_cast<CountingNode*>(nodes[1].get());
+    sp<NodeLooperThread> th = new NodeLooperThread(std::move(nodes));
+    EXPECT_TRUE(th->Start());
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    // Initial loop evaluates every node in both passes
+    EXPECT_EQ(2, c0->update_count_);
+    EXPECT_EQ(2, c1->update_count_);
+    std::vector<NodeAction> actions{{0, 0, 100ms}};
+    EXPECT_TRUE(th->Request(actions, "LAUNCH"));
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    EXPECT_EQ(4, c0->update_count_);
+    EXPECT_EQ(2, c1->update_count_);
+    // Expiring request only wakes up its own node
+    std::this_thread::sleep_for(100ms);
+    EXPECT_EQ(6, c0->update_count_);
+    EXPECT_EQ(2, c1->update_count_);
+    th->Stop();
+    EXPECT_FALSE(th->isRunning());
+}
+
+// Test requests of a batch wake the looper once, at EndBatch
+TEST_F(NodeLooperThreadTest, BatchRequest) {
+    std::vector<std::unique_ptr<Node>> nodes;
+    nodes.emplace_back(new CountingNode("c0"));
+    nodes.emplace_back(new CountingNode("c1"));
+    auto c0 = static_cast<CountingNode*>(nodes[0].get());
+    auto c1 = static_cast<CountingNode*>(nodes[1].get());
+    sp<NodeLooperThread> th = new NodeLooperThread(std::move(nodes));
+    EXPECT_TRUE(th->Start());
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    EXPECT_EQ(2, c0->update_count_);
+    EXPECT_EQ(2, c1->update_count_);
+    th->BeginBatch();
+    th->BeginBatch();
+    EXPECT_TRUE(th->Request({{0, 0, 0ms}}, "LAUNCH"));
+    EXPECT_TRUE(th->Request({{1, 0, 0ms}}, "INTERACTION"));
+    th->EndBatch();
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    // Still inside the outer batch
+    EXPECT_EQ(2, c0->update_count_);
+    EXPECT_EQ(2, c1->update_count_);
+    th->EndBatch();
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    EXPECT_EQ(1, c0->write_count_);
+    EXPECT_EQ(1, c1->write_count_);
+    EXPECT_EQ(c0->update_count_, c1->update_count_);
+    th->Stop();
+    EXPECT_FALSE(th->isRunning());
+}
+
+// Test requests within the coalesce window are resolved in one sweep
+TEST_F(NodeLooperThreadTest, CoalesceWindow) {
+    std::vector<std::unique_ptr<Node>> nodes;
+    nodes.emplace_back(new CountingNode("c0"));
+    nodes.emplace_back(new CountingNode("c1"));
+    auto c0 = static_cast<CountingNode*>(nodes[0].get());
+    auto c1 = static_cast<CountingNode*>(nodes[1].get());
+    sp<NodeLooperThread> th = new NodeLooperThread(std::move(nodes), 20ms);
+    EXPECT_TRUE(th->Start());
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    EXPECT_EQ(2, c0->update_count_);
+    EXPECT_EQ(2, c1->update_count_);
+    EXPECT_TRUE(th->Request({{0, 0, 0ms}}, "LAUNCH"));
+    std::this_thread::sleep_for(5ms);
+    EXPECT_TRUE(th->Request({{1, 0, 0ms}}, "INTERACTION"));
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    // Both nodes are evaluated by the same two-pass sweep
+    EXPECT_EQ(4, c0->update_count_);
+    EXPECT_EQ(4, c1->update_count_);
+    EXPECT_EQ(1u, th->GetCoalescedWakeups());
+    th->Stop();
+    EXPECT_FALSE(th->isRunning());
+}
+
+// Test nodes with dependency are written once in direction-aware order
+TEST_F(NodeLooperThreadTest, DependencyOrderUpdate) {
+    std::vector<std::string> write_log;
+    std::vector<std::unique_ptr<Node>> nodes;
+    nodes.emplace_back(new CountingNode("min", {{"300"}, {"200"}, {"100"}}, &write_log));
+    nodes.emplace_back(new CountingNode("max", {{"400"}, {"250"}, {"150"}}, &write_log));
+    nodes[0]->SetDependsOn("max");
+    auto min_node = static_cast<CountingNode*>(nodes[0].get());
+    sp<NodeLooperThread> th = new NodeLooperThread(std::move(nodes));
+    EXPECT_TRUE(th->Start());
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    // Single pass
+    EXPECT_EQ(1, min_node->update_count_);
+    // Raising min above current max needs max written first
+    std::vector<NodeAction> actions{{0, 0, 0ms}, {1, 0, 0ms}};
+    EXPECT_TRUE(th->Request(actions, "LAUNCH"));
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    // Lowering both needs min written first
+    EXPECT_TRUE(th->Cancel(actions, "LAUNCH"));
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    th->Stop();
+    EXPECT_FALSE(th->isRunning());
+    EXPECT_EQ(3, min_node->update_count_);
+    EXPECT_EQ((std::vector<std::string>{"max:400", "min:300", "min:100", "max:150"}), write_log);
+}
+
+// Test slow nodes on separate write lanes get written concurrently
+TEST_F(NodeLooperThreadTest, WriteLaneUpdate) {
+    constexpr auto kWriteDelay = 60ms;
+    std::vector<std::unique_ptr<Node>> nodes;
+    for (const char* lane : {"", "lane1", "lane2"}) {
+        nodes.emplace_back(new CountingNode(std::string("c_") + lane, {{"value0"}, {"value1"}},
+                                            nullptr, kWriteDelay));
+        nodes.back()->SetWriteLane(lane);
+    }
+    std::vector<CountingNode*> counting;
+    for (auto& n : nodes) {
+        counting.push_back(static_cast<CountingNode*>(n.get()));
+    }
+    sp<NodeLooperThread> th = new NodeLooperThread(std::move(nodes));
+    EXPECT_TRUE(th->Start());
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    std::vector<NodeAction> actions{{0, 0, 0ms}, {1, 0, 0ms}, {2, 0, 0ms}};
+    EXPECT_TRUE(th->Request(actions, "LAUNCH"));
+    // Serial writes would take 3 * kWriteDelay
+    std::this_thread::sleep_for(kWriteDelay * 2);
+    for (auto c : counting) {
+        EXPECT_EQ(1, c->write_count_) << c->GetName();
+    }
+    th->Stop();
+    EXPECT_FALSE(th->isRunning());
+}
+
+// Test reloading nodes keeps unchanged nodes and carries over requests
+TEST_F(NodeLooperThreadTest, ReloadNodes) {
+    std::vector<std::string> write_log;
+    std::vector<std::unique_ptr<Node>> nodes;
+    nodes.emplace_back(new CountingNode("c0", {{"value0"}, {"value1"}}, &write_log));
+    nodes.emplace_back(new CountingNode("c1", {{"value0"}, {"value1"}}, &write_log));
+    nodes.emplace_back(new CountingNode("gone", {{"value0"}, {"value1"}}, &write_log));
+    auto c0 = static_cast<CountingNode*>(nodes[0].get());
+    sp<NodeLooperThread> th = new NodeLooperThread(std::move(nodes));
+    EXPECT_TRUE(th->Start());
+    std::vector<NodeAction> actions{{0, 0, 0ms}, {1, 0, 0ms}, {2, 0, 0ms}};
+    EXPECT_TRUE(th->Request(actions, "LAUNCH"));
+    EXPECT_TRUE(th->Request({{0, 0, 0ms}}, "INTERACTION"));
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    EXPECT_EQ(1, c0->write_count_);
+
+    // c0 is unchanged, c1 gets a new value in between, gone is removed, c2
+    // is added on a new write lane; INTERACTION no longer exists.
+    nodes.emplace_back(new CountingNode("c0", {{"value0"}, {"value1"}}, &write_log));
+    nodes.emplace_back(new CountingNode("c1", {{"value0"}, {"value01"}, {"value1"}}, &write_log));
+    nodes.emplace_back(new CountingNode("c2"));
+    nodes.back()->SetWriteLane("lane1");
+    auto c1 = static_cast<CountingNode*>(nodes[1].get());
+    auto c2 = static_cast<CountingNode*>(nodes[2].get());
+    // LAUNCH now asks c1 for value01 and touches c2
+    const std::vector<NodeAction> launch{{0, 0, 0ms}, {1, 1, 0ms}, {2, 0, 0ms}};
+    EXPECT_TRUE(th->Reload(std::move(nodes), {{HintIdTable::Intern("LAUNCH"), launch}}));
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    // c0 isn't rewritten and c2 only gets new requests
+    EXPECT_EQ(1, c0->write_count_);
+    EXPECT_EQ(1, c1->write_count_);
+    EXPECT_EQ(0, c2->write_count_);
+    EXPECT_TRUE(th->Cancel(launch, "LAUNCH"));
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    EXPECT_EQ(2, c0->write_count_);
+    EXPECT_EQ(2, c1->write_count_);
+    EXPECT_TRUE(th->Request(launch, "LAUNCH"));
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    EXPECT_EQ(3, c0->write_count_);
+    EXPECT_EQ(1, c2->write_count_);
+    th->Stop();
+    EXPECT_FALSE(th->isRunning());
+    // The removed node is reset and the carried over request moves c1 to its
+    // new value
+    EXPECT_EQ((std::vector<std::string>{"c0:value0", "c1:value0", "gone:value0", "gone:value1",
+                                        "c1:value01", "c0:value1", "c1:value1", "c0:value0",
+                                        "c1:value01"}),
+              write_log);
+}
+
+// Test request latencies get recorded and dumped
+TEST_F(NodeLooperThreadTest, LatencyDump) {
+    std::vector<std::unique_ptr<Node>> nodes;
+    nodes.emplace_back(new CountingNode("c0"));
+    sp<NodeLooperThread> th = new NodeLooperThread(std::move(nodes));
+    EXPECT_TRUE(th->Start());
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    std::vector<NodeAction> actions{{0, 0, 0ms}};
+    EXPECT_TRUE(th->Request(actions, "LAUNCH"));
+    std::this_thread::sleep_for(kSLEEP_TOLERANCE_MS);
+    TemporaryFile dumptf;
+    th->DumpLatencyToFd(dumptf.fd);
+    fsync(dumptf.fd);
+    std::string dump;
+    ASSERT_TRUE(android::base::ReadFileToString(dumptf.path, &dump));
+    EXPECT_NE(std::string::npos, dump.find("RequestToWakeup\t1\t"));
+    EXPECT_NE(std::string::npos, dump.find("WakeupToFirstWrite\t1\t"));
+    EXPECT_NE(std::string::npos, dump.find("NodeWrite\t1\t"));
+    EXPECT_NE(std::string::npos, dump.find("CoalescedWakeups\t0\n"));
+    th->Stop();
+}
+
 }  // namespace perfmgr
 }  // namespace android
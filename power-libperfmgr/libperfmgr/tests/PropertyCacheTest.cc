@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <android-base/properties.h>
+#include <gtest/gtest.h>
+
+#include "perfmgr/PropertyCache.h"
+
+namespace android {
+namespace perfmgr {
+
+// Test the value follows property changes
+TEST(PropertyCacheTest, GetBoolPropertyTest) {
+    const std::string key = "test.libperfmgr.cache.key";
+    EXPECT_TRUE(android::base::SetProperty(key, "1"));
+    auto prop = PropertyCache::GetBoolProperty(key);
+    ASSERT_NE(nullptr, prop);
+    EXPECT_EQ(key, prop->GetName());
+    EXPECT_TRUE(prop->Get(false));
+    EXPECT_TRUE(prop->Get(false));
+    EXPECT_TRUE(android::base::SetProperty(key, "false"));
+    EXPECT_FALSE(prop->Get(true));
+    // Unparseable value falls back to the default
+    EXPECT_TRUE(android::base::SetProperty(key, "maybe"));
+    EXPECT_TRUE(prop->Get(true));
+    EXPECT_FALSE(prop->Get(false));
+}
+
+// Test a property which is created after the first lookup
+TEST(PropertyCacheTest, GetBoolPropertyLateTest) {
+    const std::string key = "test.libperfmgr.cache.late";
+    auto prop = PropertyCache::GetBoolProperty(key);
+    ASSERT_NE(nullptr, prop);
+    EXPECT_TRUE(prop->Get(true));
+    EXPECT_FALSE(prop->Get(false));
+    EXPECT_TRUE(android::base::SetProperty(key, "0"));
+    EXPECT_FALSE(prop->Get(true));
+}
+
+// Test the same name shares one cache and empty name has none
+TEST(PropertyCacheTest, SharedPropertyTest) {
+    EXPECT_EQ(PropertyCache::GetBoolProperty("test.libperfmgr.cache.shared"),
+              PropertyCache::GetBoolProperty("test.libperfmgr.cache.shared"));
+    EXPECT_NE(PropertyCache::GetBoolProperty("test.libperfmgr.cache.shared"),
+              PropertyCache::GetBoolProperty("test.libperfmgr.cache.other"));
+    EXPECT_EQ(nullptr, PropertyCache::GetBoolProperty(""));
+}
+
+}  // namespace perfmgr
+}  // namespace android
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "perfmgr/RequestGroup.h"
+
+namespace android {
+namespace perfmgr {
+
+namespace {
+
+// The previous std::map based RequestGroup, kept as the baseline.
+class MapRequestGroup {
+  public:
+    bool AddRequest(const std::string &hint_type, ReqTime end_time) {
+        auto [it, inserted] = request_map_.emplace(hint_type, end_time);
+        if (!inserted && it->second < end_time) {
+            it->second = end_time;
+        }
+        return inserted;
+    }
+
+    bool RemoveRequest(const std::string &hint_type) { return request_map_.erase(hint_type); }
+
+    bool GetExpireTime(std::chrono::milliseconds *expire_time) {
+        ReqTime now = std::chrono::steady_clock::now();
+        *expire_time = std::chrono::milliseconds::max();
+        bool active = false;
+        for (auto it = request_map_.begin(); it != request_map_.end();) {
+            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(it->second - now);
+            if (duration <= std::chrono::milliseconds::zero()) {
+                it = request_map_.erase(it);
+            } else {
+                *expire_time = std::min(duration, *expire_time);
+                active = true;
+                ++it;
+            }
+        }
+        return active;
+    }
+
+  private:
+    std::map<std::string, ReqTime> request_map_;
+};
+
+std::vector<std::string> MakeHintNames(size_t count) {
+    std::vector<std::string> names;
+    for (size_t i = 0; i < count; i++) {
+        names.push_back("BENCH_HINT_" + std::to_string(i));
+    }
+    return names;
+}
+
+// Mimic NodeLooperThread: each iteration a random requester renews or cancels
+// its request, then the node re-evaluates the group's expire time.
+template <typename Group, typename Key, typename MakeKey>
+void RunChurn(benchmark::State &state, MakeKey make_key) {
+    const size_t size = state.range(0);
+    const auto names = MakeHintNames(size);
+    std::vector<Key> keys;
+    for (const auto &name : names) {
+        keys.push_back(make_key(name));
+    }
+    Group group;
+    auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < size; i++) {
+        group.AddRequest(keys[i], now + std::chrono::seconds(10 + i));
+    }
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<size_t> pick(0, size - 1);
+    std::uniform_int_distribution<int> timeout_s(1, 100);
+    std::chrono::milliseconds expire_time;
+    for (auto _ : state) {
+        const auto &key = keys[pick(rng)];
+        if (rng() % 4 == 0) {
+            group.RemoveRequest(key);
+        } else {
+            group.AddRequest(key, std::chrono::steady_clock::now() +
+                                          std::chrono::seconds(timeout_s(rng)));
+        }
+        benchmark::DoNotOptimize(group.GetExpireTime(&expire_time));
+    }
+}
+
+struct FlatRequestGroup : public RequestGroup {
+    FlatRequestGroup() : RequestGroup("") {}
+};
+
+}  // namespace
+
+static void BM_RequestGroupChurn(benchmark::State &state) {
+    RunChurn<FlatRequestGroup, HintId>(
+            state, [](const std::string &name) { return HintIdTable::Intern(name); });
+}
+BENCHMARK(BM_RequestGroupChurn)->Arg(2)->Arg(8)->Arg(32)->Arg(128);
+
+static void BM_MapRequestGroupChurn(benchmark::State &state) {
+    RunChurn<MapRequestGroup, std::string>(state, [](const std::string &name) { return name; });
+}
+BENCHMARK(BM_MapRequestGroupChurn)->Arg(2)->Arg(8)->Arg(32)->Arg(128);
+
+}  // namespace perfmgr
+}  // namespace android
+
+BENCHMARK_MAIN();
@@ -17,6 +17,7 @@
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <string>
 #include <thread>
 
 #include "perfmgr/RequestGroup.h"
@@ -25,6 +26,7 @@ namespace android {
 namespace perfmgr {
 
 using std::literals::chrono_literals::operator""ms;
+using std::literals::chrono_literals::operator""s;
 
 constexpr double kTIMING_TOLERANCE_MS = std::chrono::milliseconds(25).count();
 
@@ -160,5 +162,55 @@ TEST(RequestGroupTest, RemoveRequestTestMultiple) {
     EXPECT_EQ(true, active);
 }
 
+// Test a group large enough to use the indexed heap
+TEST(RequestGroupTest, ManyRequestsTest) {
+    RequestGroup req("");
+    const size_t count = RequestGroup::kHeapThreshold * 3;
+    auto start = std::chrono::steady_clock::now();
+    // Deadlines in reverse order of insertion, the last added is the nearest
+    for (size_t i = 0; i < count; i++) {
+        EXPECT_TRUE(req.AddRequest("HINT_" + std::to_string(i),
+                                   start + std::chrono::seconds(1000 - i)));
+    }
+    std::chrono::milliseconds expire_time;
+    EXPECT_TRUE(req.GetExpireTime(&expire_time));
+    EXPECT_NEAR(std::chrono::milliseconds(std::chrono::seconds(1000 - count + 1)).count(),
+                expire_time.count(), kTIMING_TOLERANCE_MS);
+    // Extending the nearest request moves the minimum to the next one
+    EXPECT_FALSE(req.AddRequest("HINT_" + std::to_string(count - 1), start + 2000s));
+    EXPECT_TRUE(req.GetExpireTime(&expire_time));
+    EXPECT_NEAR(std::chrono::milliseconds(std::chrono::seconds(1000 - count + 2)).count(),
+                expire_time.count(), kTIMING_TOLERANCE_MS);
+    // Remove all but the first request, crossing back to the flat vector
+    for (size_t i = 1; i < count; i++) {
+        EXPECT_TRUE(req.RemoveRequest("HINT_" + std::to_string(i)));
+    }
+    EXPECT_FALSE(req.RemoveRequest("HINT_1"));
+    EXPECT_TRUE(req.GetExpireTime(&expire_time));
+    EXPECT_NEAR(std::chrono::milliseconds(1000s).count(), expire_time.count(),
+                kTIMING_TOLERANCE_MS);
+    EXPECT_TRUE(req.RemoveRequest("HINT_0"));
+    EXPECT_FALSE(req.GetExpireTime(&expire_time));
+    EXPECT_EQ(std::chrono::milliseconds::max(), expire_time);
+}
+
+// Test expiring part of a group which uses the indexed heap
+TEST(RequestGroupTest, ManyRequestsTestExpire) {
+    RequestGroup req("");
+    const size_t count = RequestGroup::kHeapThreshold * 2;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i++) {
+        auto duration = (i % 2) ? 5ms : 50000ms;
+        req.AddRequest("HINT_" + std::to_string(i), start + duration);
+    }
+    std::this_thread::sleep_for(15ms);
+    std::chrono::milliseconds expire_time;
+    EXPECT_TRUE(req.GetExpireTime(&expire_time));
+    EXPECT_NEAR(50000, expire_time.count(), kTIMING_TOLERANCE_MS);
+    // Expired requests are gone, so adding them again counts as new
+    EXPECT_TRUE(req.AddRequest("HINT_1", start + 100000ms));
+    EXPECT_FALSE(req.AddRequest("HINT_0", start + 100000ms));
+}
+
 }  // namespace perfmgr
 }  // namespace android
@@ -22,6 +22,8 @@
 
 #include <thread>
 
+#include "perfmgr/ConfigCache.h"
+#include "perfmgr/ConfigSimulator.h"
 #include "perfmgr/HintManager.h"
 
 namespace android {
@@ -29,7 +31,9 @@ namespace perfmgr {
 
 class NodeVerifier : public HintManager {
   public:
-    static bool VerifyNodes(const std::string& config_path) {
+    // Run every check HintManager runs on the config at startup, the Nodes as
+    // well as the Actions and AdpfConfigs referring to them
+    static bool VerifyConfig(const std::string& config_path) {
         std::string json_doc;
 
         if (!android::base::ReadFileToString(config_path, &json_doc)) {
@@ -37,12 +41,65 @@ class NodeVerifier : public HintManager {
             return false;
         }
 
-        std::vector<std::unique_ptr<Node>> nodes = ParseNodes(json_doc);
-        if (nodes.empty()) {
-            LOG(ERROR) << "Failed to parse Nodes section from " << config_path;
+        PowerConfig config;
+        return ParseConfig(json_doc, config_path, &config);
+    }
+
+    static bool CompileConfig(const std::string& config_path, const std::string& output_path) {
+        std::string json_doc;
+
+        if (!android::base::ReadFileToString(config_path, &json_doc)) {
+            LOG(ERROR) << "Failed to read JSON config from " << config_path;
             return false;
         }
 
+        PowerConfig config;
+        if (!ParseConfig(json_doc, config_path, &config)) {
+            return false;
+        }
+
+        return ConfigCache::Write(output_path, config, GetConfigKey(json_doc));
+    }
+
+    static bool SimulateConfig(const std::string& config_path, const std::string& trace_path,
+                               const std::string& latency_path) {
+        std::string json_doc;
+        std::string trace;
+        std::string latency_table;
+
+        if (!android::base::ReadFileToString(config_path, &json_doc)) {
+            LOG(ERROR) << "Failed to read JSON config from " << config_path;
+            return false;
+        }
+        if (!android::base::ReadFileToString(trace_path, &trace)) {
+            LOG(ERROR) << "Failed to read hint trace from " << trace_path;
+            return false;
+        }
+        if (!latency_path.empty() &&
+            !android::base::ReadFileToString(latency_path, &latency_table)) {
+            LOG(ERROR) << "Failed to read latency table from " << latency_path;
+            return false;
+        }
+
+        PowerConfig config;
+        if (!ParseConfig(json_doc, config_path, &config)) {
+            return false;
+        }
+        std::vector<ConfigSimulator::HintEvent> events;
+        if (!ConfigSimulator::ParseTrace(trace, &events)) {
+            LOG(ERROR) << "Failed to parse hint trace " << trace_path;
+            return false;
+        }
+        std::unordered_map<std::string, std::chrono::microseconds> latencies;
+        if (!ConfigSimulator::ParseLatencyTable(latency_table, &latencies)) {
+            LOG(ERROR) << "Failed to parse latency table " << latency_path;
+            return false;
+        }
+
+        ConfigSimulator simulator(config.nodes, config.actions, latencies);
+        simulator.Run(events);
+        LOG(INFO) << "Simulated " << events.size() << " hint events from " << trace_path << "\n"
+                  << simulator.GetReport();
         return true;
     }
 
@@ -59,7 +116,8 @@ static void printUsage(const char* exec_name) {
     std::string usage = exec_name;
     usage =
         usage +
-        " is a command-line tool to verify Nodes in Json config are writable.\n"
+        " is a command-line tool to verify a Json config the way HintManager\n"
+        "parses it at startup, and to compile it into the cache loaded instead.\n"
         "Usages:\n"
         "    [su system] " +
         exec_name +
@@ -74,6 +132,19 @@ static void printUsage(const char* exec_name) {
         "       do only the specific hint\n\n"
         "   --hint_duration, -d  [duration]\n"
         "       duration in ms for each hint\n\n"
+        "   --simulate, -s  [PATH]\n"
+        "       replay the hint trace at PATH, either '<ms> do|end <hint>\n"
+        "       [duration ms]' lines or an atrace with the Power HAL hint\n"
+        "       counters, and report the node writes of each hint\n\n"
+        "   --latency_table, -l  [PATH]\n"
+        "       '<node path> <latency us>' lines used by --simulate to\n"
+        "       estimate write latency, path '*' matches any other node\n\n"
+        "   --compile, -o  [PATH]\n"
+        "       verify the config and write its compiled cache to PATH,\n"
+        "       which is loaded instead of the Json config, skipping its\n"
+        "       parsing and checks, when installed next to it with the\n"
+        "       .cache suffix. The cache is keyed by the hash of the Json\n"
+        "       config, so a stale one is ignored\n\n"
         "   --help, -h\n"
         "       print this message\n\n"
         "   --verbose, -v\n"
@@ -110,6 +181,9 @@ int main(int argc, char* argv[]) {
 
     std::string config_path;
     std::string hint_name;
+    std::string output_path;
+    std::string trace_path;
+    std::string latency_path;
     bool exec_hint = false;
     uint64_t hint_duration = 100;
 
@@ -119,13 +193,16 @@ int main(int argc, char* argv[]) {
             {"exec_hint", no_argument, nullptr, 'e'},
             {"hint_name", required_argument, nullptr, 'i'},
             {"hint_duration", required_argument, nullptr, 'd'},
+            {"compile", required_argument, nullptr, 'o'},
+            {"simulate", required_argument, nullptr, 's'},
+            {"latency_table", required_argument, nullptr, 'l'},
             {"help", no_argument, nullptr, 'h'},
             {"verbose", no_argument, nullptr, 'v'},
             {0, 0, 0, 0}  // termination of the option list
         };
 
         int option_index = 0;
-        int c = getopt_long(argc, argv, "c:ei:d:hv", opts, &option_index);
+        int c = getopt_long(argc, argv, "c:ei:d:o:s:l:hv", opts, &option_index);
         if (c == -1) {
             break;
         }
@@ -143,6 +220,15 @@ int main(int argc, char* argv[]) {
             case 'd':
                 hint_duration = strtoul(optarg, NULL, 10);
                 break;
+            case 'o':
+                output_path = optarg;
+                break;
+            case 's':
+                trace_path = optarg;
+                break;
+            case 'l':
+                latency_path = optarg;
+                break;
             case 'v':
                 android::base::SetMinimumLogSeverity(android::base::VERBOSE);
                 break;
@@ -161,16 +247,33 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    if (!output_path.empty()) {
+        if (android::perfmgr::NodeVerifier::CompileConfig(config_path, output_path)) {
+            LOG(INFO) << "Compiled JSON config to " << output_path;
+            return 0;
+        } else {
+            LOG(ERROR) << "Failed to compile JSON config";
+            return 1;
+        }
+    }
+
+    if (!trace_path.empty()) {
+        return android::perfmgr::NodeVerifier::SimulateConfig(config_path, trace_path,
+                                                               latency_path)
+                       ? 0
+                       : 1;
+    }
+
     if (exec_hint) {
         execConfig(config_path, hint_name, hint_duration);
         return 0;
     }
 
-    if (android::perfmgr::NodeVerifier::VerifyNodes(config_path)) {
-        LOG(INFO) << "Verified writing to JSON config";
+    if (android::perfmgr::NodeVerifier::VerifyConfig(config_path)) {
+        LOG(INFO) << "Verified JSON config";
         return 0;
     } else {
-        LOG(ERROR) << "Failed to verify nodes in JSON config";
+        LOG(ERROR) << "Failed to verify JSON config";
         return 1;
     }
 }
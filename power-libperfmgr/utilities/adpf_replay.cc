@@ -0,0 +1,181 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replays a hint session recorded with vendor.powerhal.adpf.record_dir
+// through the real PowerHintSession and PowerSessionManager against the ADPF
+// profile of a power config, and prints the resulting uclamp time series and
+// miss rate. The replay runs on a virtual clock, so it takes no longer than
+// the session calls themselves and gives the same result on every run. The
+// recorded session has no threads, so no uclamp is applied to any thread, but
+// GPU capacity votes still reach the GPU node of a profile with GPU boost on.
+//
+// Usage: adpf_replay <powerhint.json> <recording> [adpf profile]
+
+#include <aidl/android/hardware/power/SessionConfig.h>
+#include <aidl/android/hardware/power/SessionHint.h>
+#include <aidl/android/hardware/power/SessionTag.h>
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <perfmgr/HintManager.h>
+
+#include <cinttypes>
+#include <cstdio>
+
+#include "aidl/PowerHintSession.h"
+#include "aidl/PowerSessionManager.h"
+#include "aidl/SessionRecorder.h"
+#include "aidl/UClampVoter.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+using ::aidl::android::hardware::power::SessionConfig;
+using ::aidl::android::hardware::power::SessionHint;
+using ::aidl::android::hardware::power::SessionTag;
+using ::android::perfmgr::AdpfConfig;
+
+// Time of the replay, moved to each recorded event before it is replayed
+std::chrono::steady_clock::time_point sReplayTime;
+
+const char *eventName(RecordedEventType type) {
+    switch (type) {
+        case RecordedEventType::REPORT_DURATIONS:
+            return "report";
+        case RecordedEventType::SEND_HINT:
+            return "hint";
+        case RecordedEventType::UPDATE_TARGET:
+            return "target";
+        case RecordedEventType::PAUSE:
+            return "pause";
+        case RecordedEventType::RESUME:
+            return "resume";
+    }
+    return "unknown";
+}
+
+int replay(const std::shared_ptr<AdpfConfig> &config, const SessionRecording &recording) {
+    PowerSessionManager<> *psm = PowerSessionManager<>::getInstance();
+    const auto start = std::chrono::steady_clock::now();
+    sReplayTime = start;
+    psm->setClock([] { return sReplayTime; });
+
+    auto session = ndk::SharedRefBase::make<PowerHintSession<>>(
+            recording.tgid, recording.uid, std::vector<int32_t>{}, recording.targetNs,
+            static_cast<SessionTag>(recording.tag));
+    SessionConfig sessionConfig;
+    session->getSessionConfig(&sessionConfig);
+    auto uclampRange = [&] {
+        return psm->getSessionUclampRange(sessionConfig.id).value_or(UclampRange{});
+    };
+    int64_t targetNs = recording.targetNs;
+    uint64_t frames = 0;
+    uint64_t missed = 0;
+    uint64_t boostedFrames = 0;
+    uint64_t boostedMissed = 0;
+
+    printf("time_ms,event,uclamp_min,uclamp_max\n");
+    for (const auto &event : recording.events) {
+        sReplayTime = start + event.time;
+        // Time out the votes which expired since the previous event
+        psm->runDueWork();
+        switch (event.type) {
+            case RecordedEventType::REPORT_DURATIONS: {
+                const bool boosted =
+                        uclampRange().uclampMin > static_cast<int>(config->mUclampMinLow);
+                for (const auto &d : event.durations) {
+                    const bool miss = d.durationNanos > targetNs;
+                    frames++;
+                    missed += miss;
+                    boostedFrames += boosted;
+                    boostedMissed += boosted && miss;
+                }
+                session->reportActualWorkDuration(event.durations);
+                break;
+            }
+            case RecordedEventType::SEND_HINT:
+                session->sendHint(static_cast<SessionHint>(event.value));
+                break;
+            case RecordedEventType::UPDATE_TARGET:
+                targetNs = event.value;
+                session->updateTargetWorkDuration(event.value);
+                break;
+            case RecordedEventType::PAUSE:
+                session->pause();
+                break;
+            case RecordedEventType::RESUME:
+                session->resume();
+                break;
+        }
+        const auto range = uclampRange();
+        printf("%.3f,%s,%d,%d\n", std::chrono::duration<double, std::milli>(event.time).count(),
+               eventName(event.type), range.uclampMin, range.uclampMax);
+    }
+    session->close();
+
+    printf("# frames %" PRIu64 ", missed %" PRIu64 " (%.2f%%), boosted %" PRIu64
+           ", boosted missed %" PRIu64 "\n",
+           frames, missed, frames ? 100.0 * missed / frames : 0.0, boostedFrames, boostedMissed);
+    return 0;
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
+
+int main(int argc, char *argv[]) {
+    using ::aidl::google::hardware::power::impl::pixel::replay;
+    using ::aidl::google::hardware::power::impl::pixel::SessionRecording;
+    using ::android::perfmgr::HintManager;
+
+    if (argc < 3 || argc > 4) {
+        fprintf(stderr, "Usage: %s <powerhint.json> <recording> [adpf profile]\n", argv[0]);
+        return 1;
+    }
+    // Parse only, the nodes of the config are never written
+    HintManager *hm = HintManager::GetFromJSON(argv[1], false);
+    if (!hm) {
+        LOG(ERROR) << "Failed to parse " << argv[1];
+        return 1;
+    }
+    if (argc == 4 && !hm->SetAdpfProfile(argv[3])) {
+        LOG(ERROR) << "No ADPF profile " << argv[3] << " in " << argv[1];
+        return 1;
+    }
+    auto config = hm->GetAdpfProfile();
+    if (!config) {
+        LOG(ERROR) << "No ADPF profile in " << argv[1];
+        return 1;
+    }
+
+    std::string data;
+    if (!::android::base::ReadFileToString(argv[2], &data)) {
+        LOG(ERROR) << "Failed to read " << argv[2];
+        return 1;
+    }
+    auto recording = SessionRecording::parse(data);
+    if (!recording) {
+        LOG(ERROR) << argv[2] << " is not an ADPF recording";
+        return 1;
+    }
+    return replay(config, *recording);
+}
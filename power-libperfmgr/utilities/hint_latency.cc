@@ -0,0 +1,538 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the time from a call into the Power HAL to its effect on the
+// hardware, for each way a hint gets there:
+//   boost, mode       setBoost/setMode, until the cpufreq scaling_min_freq rises
+//   session_hint      IPowerHintSession::sendHint(CPU_LOAD_UP), until the uclamp
+//                     min of the session thread rises
+//   session_report    reportActualWorkDuration over target, same
+//   channel_hint      the two above, through the session FMQ channel
+//   channel_report
+//   gpu_hint          sendHint(GPU_LOAD_UP), until the --gpu-node value rises
+// and prints the distribution of the call and effect latencies of each.
+//
+// Talks to the HAL directly, so it needs root and a permissive policy.
+// Usage: hint_latency [options], see --help
+
+#include <aidl/android/hardware/power/Boost.h>
+#include <aidl/android/hardware/power/ChannelConfig.h>
+#include <aidl/android/hardware/power/ChannelMessage.h>
+#include <aidl/android/hardware/power/IPower.h>
+#include <aidl/android/hardware/power/IPowerHintSession.h>
+#include <aidl/android/hardware/power/Mode.h>
+#include <aidl/android/hardware/power/SessionConfig.h>
+#include <aidl/android/hardware/power/SessionHint.h>
+#include <aidl/android/hardware/power/SessionTag.h>
+#include <aidl/android/hardware/power/WorkDuration.h>
+#include <android-base/logging.h>
+#include <android-base/strings.h>
+#include <android-base/unique_fd.h>
+#include <android/binder_enums.h>
+#include <android/binder_manager.h>
+#include <fcntl.h>
+#include <fmq/AidlMessageQueue.h>
+#include <fmq/EventFlag.h>
+#include <getopt.h>
+#include <linux/types.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <functional>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using ::aidl::android::hardware::common::fmq::SynchronizedReadWrite;
+using ::aidl::android::hardware::power::Boost;
+using ::aidl::android::hardware::power::ChannelConfig;
+using ::aidl::android::hardware::power::ChannelMessage;
+using ::aidl::android::hardware::power::IPower;
+using ::aidl::android::hardware::power::IPowerHintSession;
+using ::aidl::android::hardware::power::Mode;
+using ::aidl::android::hardware::power::SessionConfig;
+using ::aidl::android::hardware::power::SessionHint;
+using ::aidl::android::hardware::power::SessionTag;
+using ::aidl::android::hardware::power::WorkDuration;
+using ::aidl::android::hardware::power::WorkDurationFixedV1;
+using ::android::AidlMessageQueue;
+using ::android::hardware::EventFlag;
+
+using Clock = std::chrono::steady_clock;
+using ChannelQueue = AidlMessageQueue<ChannelMessage, SynchronizedReadWrite>;
+using ChannelMessageContents = ChannelMessage::ChannelMessageContents;
+
+namespace {
+
+constexpr int64_t kTargetNs = 16666666;
+// Reported durations, far enough over the target for any PID to react
+constexpr int64_t kOverTargetNs = 3 * kTargetNs;
+constexpr size_t kReportBatch = 3;
+constexpr auto kPollInterval = std::chrono::microseconds(100);
+// Left between iterations for the HAL's own timers to settle
+constexpr auto kSettle = std::chrono::milliseconds(20);
+
+// A value the HAL should raise, nullopt if it can't be read
+using Probe = std::function<std::optional<int64_t>()>;
+
+// There is no glibc or bionic wrapper
+struct sched_attr {
+    __u32 size;
+    __u32 sched_policy;
+    __u64 sched_flags;
+    __s32 sched_nice;
+    __u32 sched_priority;
+    __u64 sched_runtime;
+    __u64 sched_deadline;
+    __u64 sched_period;
+    __u32 sched_util_min;
+    __u32 sched_util_max;
+};
+
+std::optional<int64_t> readUclampMin(pid_t tid) {
+    sched_attr attr = {};
+    if (syscall(__NR_sched_getattr, tid, &attr, sizeof(attr), 0)) {
+        PLOG(ERROR) << "sched_getattr failed for thread " << tid;
+        return std::nullopt;
+    }
+    return attr.sched_util_min;
+}
+
+// Keeps the node open, polling reopens nothing
+Probe nodeProbe(const std::string &path) {
+    auto fd = std::make_shared<::android::base::unique_fd>(
+            TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+    if (*fd < 0) {
+        PLOG(ERROR) << "Failed to open " << path;
+        return nullptr;
+    }
+    return [fd, path]() -> std::optional<int64_t> {
+        char buf[32];
+        const ssize_t n = TEMP_FAILURE_RETRY(pread(*fd, buf, sizeof(buf) - 1, 0));
+        if (n <= 0) {
+            PLOG(ERROR) << "Failed to read " << path;
+            return std::nullopt;
+        }
+        buf[n] = '\0';
+        return strtoll(buf, nullptr, 10);
+    };
+}
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch())
+            .count();
+}
+
+// A fresh session per iteration, so no PID state or vote carries over
+class Session {
+  public:
+    explicit Session(const std::shared_ptr<IPower> &hal) {
+        const auto status = hal->createHintSessionWithConfig(getpid(), getuid(), {gettid()},
+                                                             kTargetNs, SessionTag::OTHER,
+                                                             &mConfig, &mSession);
+        if (!status.isOk() || !mSession) {
+            LOG(ERROR) << "Failed to create a hint session: " << status.getDescription();
+            mSession = nullptr;
+        }
+    }
+    ~Session() {
+        if (mSession) {
+            mSession->close();
+        }
+    }
+
+    bool isValid() const { return mSession != nullptr; }
+    int32_t id() const { return mConfig.id; }
+    const std::shared_ptr<IPowerHintSession> &operator->() const { return mSession; }
+
+  private:
+    SessionConfig mConfig;
+    std::shared_ptr<IPowerHintSession> mSession;
+};
+
+std::vector<WorkDuration> overTargetDurations() {
+    std::vector<WorkDuration> durations(kReportBatch);
+    for (auto &d : durations) {
+        d.timeStampNanos = nowNs();
+        d.workPeriodStartTimestampNanos = d.timeStampNanos - kOverTargetNs;
+        d.durationNanos = kOverTargetNs;
+        d.cpuDurationNanos = kOverTargetNs;
+    }
+    return durations;
+}
+
+// The writing end of the session channel of this process
+class Channel {
+  public:
+    explicit Channel(const std::shared_ptr<IPower> &hal) : mHal(hal) {
+        ChannelConfig config;
+        const auto status = hal->getSessionChannel(getpid(), getuid(), &config);
+        if (!status.isOk()) {
+            LOG(ERROR) << "Failed to get the session channel: " << status.getDescription();
+            return;
+        }
+        mQueue = std::make_unique<ChannelQueue>(config.channelDescriptor, false);
+        if (!mQueue->isValid() ||
+            EventFlag::createEventFlag(mQueue->getEventFlagWord(), &mFlag) != ::android::OK) {
+            LOG(ERROR) << "Failed to map the session channel";
+            mQueue.reset();
+            mFlag = nullptr;
+            return;
+        }
+        mWriteBit = config.writeFlagBitmask;
+    }
+    ~Channel() {
+        if (mFlag != nullptr) {
+            EventFlag::deleteEventFlag(&mFlag);
+        }
+        mHal->closeSessionChannel(getpid(), getuid());
+    }
+
+    bool isValid() const { return mFlag != nullptr; }
+    bool send(const std::vector<ChannelMessage> &messages) {
+        if (!mQueue->write(messages.data(), messages.size())) {
+            return false;
+        }
+        mFlag->wake(mWriteBit);
+        return true;
+    }
+
+  private:
+    std::shared_ptr<IPower> mHal;
+    std::unique_ptr<ChannelQueue> mQueue;
+    EventFlag *mFlag = nullptr;
+    uint32_t mWriteBit = 0;
+};
+
+ChannelMessage hintMessage(int32_t sessionId, SessionHint hint) {
+    ChannelMessage message;
+    message.sessionID = sessionId;
+    message.timeStampNanos = nowNs();
+    message.data.set<ChannelMessageContents::Tag::hint>(hint);
+    return message;
+}
+
+std::vector<ChannelMessage> overTargetMessages(int32_t sessionId) {
+    std::vector<ChannelMessage> messages;
+    for (const auto &d : overTargetDurations()) {
+        WorkDurationFixedV1 fixed;
+        fixed.durationNanos = d.durationNanos;
+        fixed.workPeriodStartTimestampNanos = d.workPeriodStartTimestampNanos;
+        fixed.cpuDurationNanos = d.cpuDurationNanos;
+        ChannelMessage &message = messages.emplace_back();
+        message.sessionID = sessionId;
+        message.timeStampNanos = d.timeStampNanos;
+        message.data.set<ChannelMessageContents::Tag::workDuration>(fixed);
+    }
+    return messages;
+}
+
+// One way from a call to its effect
+struct Path {
+    std::string name;
+    Probe probe;
+    // Called before the baseline of the probe is read
+    std::function<bool()> setUp;
+    // The timed call
+    std::function<bool()> fire;
+    // Undo the call, the probe is then left to fall back to its baseline
+    std::function<void()> tearDown;
+};
+
+struct PathStats {
+    std::vector<int64_t> callUs;
+    std::vector<int64_t> effectUs;
+    int timeouts = 0;
+};
+
+// The first time probe reads above baseline, nullopt if it doesn't by deadline
+std::optional<Clock::time_point> waitForRise(const Probe &probe, int64_t baseline,
+                                             Clock::time_point deadline) {
+    while (true) {
+        const auto value = probe();
+        const auto now = Clock::now();
+        if (value && *value > baseline) {
+            return now;
+        }
+        if (now >= deadline) {
+            return std::nullopt;
+        }
+        std::this_thread::sleep_for(kPollInterval);
+    }
+}
+
+void waitForFall(const Probe &probe, int64_t baseline, Clock::time_point deadline) {
+    while (Clock::now() < deadline) {
+        const auto value = probe();
+        if (!value || *value <= baseline) {
+            return;
+        }
+        std::this_thread::sleep_for(kPollInterval);
+    }
+}
+
+int64_t toUs(Clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+bool runPath(const Path &path, int iterations, std::chrono::milliseconds timeout,
+             PathStats *stats) {
+    for (int i = 0; i < iterations; i++) {
+        if (path.setUp && !path.setUp()) {
+            return false;
+        }
+        std::this_thread::sleep_for(kSettle);
+        const auto baseline = path.probe();
+        if (!baseline) {
+            return false;
+        }
+        const auto start = Clock::now();
+        if (!path.fire()) {
+            LOG(ERROR) << path.name << " call failed";
+            return false;
+        }
+        stats->callUs.push_back(toUs(Clock::now() - start));
+        const auto effect = waitForRise(path.probe, *baseline, start + timeout);
+        if (effect) {
+            stats->effectUs.push_back(toUs(*effect - start));
+        } else {
+            stats->timeouts++;
+        }
+        if (path.tearDown) {
+            path.tearDown();
+        }
+        waitForFall(path.probe, *baseline, Clock::now() + timeout);
+    }
+    return true;
+}
+
+int64_t percentile(const std::vector<int64_t> &sorted, int p) {
+    if (sorted.empty()) {
+        return -1;
+    }
+    return sorted[std::min(sorted.size() - 1, sorted.size() * p / 100)];
+}
+
+void printStats(const std::string &name, PathStats *stats) {
+    std::sort(stats->callUs.begin(), stats->callUs.end());
+    std::sort(stats->effectUs.begin(), stats->effectUs.end());
+    printf("%-16s %5zu %8d %9" PRId64 " %9" PRId64 " %9" PRId64 " %9" PRId64 " %9" PRId64
+           " %9" PRId64 "\n",
+           name.c_str(), stats->callUs.size(), stats->timeouts, percentile(stats->callUs, 50),
+           percentile(stats->callUs, 99), percentile(stats->effectUs, 50),
+           percentile(stats->effectUs, 90), percentile(stats->effectUs, 99),
+           stats->effectUs.empty() ? -1 : stats->effectUs.back());
+}
+
+template <class EnumT>
+std::optional<EnumT> parseEnum(const std::string &name) {
+    for (const auto type : ndk::enum_range<EnumT>()) {
+        if (toString(type) == name) {
+            return type;
+        }
+    }
+    return std::nullopt;
+}
+
+void printUsage(const char *exec_name) {
+    fprintf(stderr,
+            "%s measures the latency from a Power HAL call to its effect on the hardware.\n"
+            "Usage: %s [options]\n"
+            "\n"
+            "Options:\n"
+            "   --paths, -p\n"
+            "       Comma separated paths to run, default all of: boost,mode,session_hint,\n"
+            "       session_report,channel_hint,channel_report,gpu_hint\n\n"
+            "   --iterations, -n\n"
+            "       Calls per path, default 50\n\n"
+            "   --cpu, -c\n"
+            "       CPU whose cpufreq scaling_min_freq the boost and mode raise, default 0\n\n"
+            "   --boost, -b\n"
+            "       Boost to send, default INTERACTION\n\n"
+            "   --boost-ms, -d\n"
+            "       Boost duration, default 100\n\n"
+            "   --mode, -m\n"
+            "       Mode to enable, default LAUNCH\n\n"
+            "   --gpu-node, -g\n"
+            "       Node a GPU_LOAD_UP hint raises, e.g. a devfreq min_freq, gpu_hint is\n"
+            "       skipped without it\n\n"
+            "   --timeout-ms, -t\n"
+            "       Time to wait for an effect, default 500\n\n"
+            "   --help, -h\n"
+            "       print this message\n",
+            exec_name, exec_name);
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    android::base::SetLogger(android::base::StderrLogger);
+    std::vector<std::string> paths = {"boost",          "mode",         "session_hint",
+                                      "session_report", "channel_hint", "channel_report",
+                                      "gpu_hint"};
+    int iterations = 50;
+    int cpu = 0;
+    std::string boostName = "INTERACTION";
+    int32_t boostMs = 100;
+    std::string modeName = "LAUNCH";
+    std::string gpuNode;
+    std::chrono::milliseconds timeout(500);
+
+    static struct option opts[] = {
+            {"paths", required_argument, nullptr, 'p'},
+            {"iterations", required_argument, nullptr, 'n'},
+            {"cpu", required_argument, nullptr, 'c'},
+            {"boost", required_argument, nullptr, 'b'},
+            {"boost-ms", required_argument, nullptr, 'd'},
+            {"mode", required_argument, nullptr, 'm'},
+            {"gpu-node", required_argument, nullptr, 'g'},
+            {"timeout-ms", required_argument, nullptr, 't'},
+            {"help", no_argument, nullptr, 'h'},
+            {0, 0, 0, 0}  // termination of the option list
+    };
+
+    int c = -1;
+    while ((c = getopt_long(argc, argv, "p:n:c:b:d:m:g:t:h", opts, nullptr)) != -1) {
+        switch (c) {
+            case 'p':
+                paths = ::android::base::Split(optarg, ",");
+                break;
+            case 'n':
+                iterations = std::stoi(optarg);
+                break;
+            case 'c':
+                cpu = std::stoi(optarg);
+                break;
+            case 'b':
+                boostName = optarg;
+                break;
+            case 'd':
+                boostMs = std::stoi(optarg);
+                break;
+            case 'm':
+                modeName = optarg;
+                break;
+            case 'g':
+                gpuNode = optarg;
+                break;
+            case 't':
+                timeout = std::chrono::milliseconds(std::stoi(optarg));
+                break;
+            case 'h':
+                printUsage(argv[0]);
+                return 0;
+            default:
+                printUsage(argv[0]);
+                return 1;
+        }
+    }
+    const auto boost = parseEnum<Boost>(boostName);
+    const auto mode = parseEnum<Mode>(modeName);
+    if (!boost || !mode) {
+        LOG(ERROR) << "Unknown boost " << boostName << " or mode " << modeName;
+        return 1;
+    }
+
+    const std::string kInstance = std::string(IPower::descriptor) + "/default";
+    auto hal = IPower::fromBinder(
+            ndk::SpAIBinder(AServiceManager_waitForService(kInstance.c_str())));
+    if (!hal) {
+        LOG(ERROR) << "Cannot get Power Hal Binder";
+        return 1;
+    }
+
+    const pid_t tid = gettid();
+    const Probe uclampProbe = [tid]() { return readUclampMin(tid); };
+    const Probe cpufreqProbe = nodeProbe("/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
+                                         "/cpufreq/scaling_min_freq");
+    const Probe gpuProbe = gpuNode.empty() ? nullptr : nodeProbe(gpuNode);
+    std::unique_ptr<Session> session;
+    std::unique_ptr<Channel> channel;
+    const auto newSession = [&hal, &session]() {
+        session.reset();
+        session = std::make_unique<Session>(hal);
+        return session->isValid();
+    };
+    const auto closeSession = [&session]() { session.reset(); };
+    const auto sessionHint = [&session](SessionHint hint) {
+        return (*session)->sendHint(hint).isOk();
+    };
+
+    printf("# latencies in us, -1 when there is no sample\n");
+    printf("%-16s %5s %8s %9s %9s %9s %9s %9s %9s\n", "path", "calls", "timeouts", "call_p50",
+           "call_p99", "eff_p50", "eff_p90", "eff_p99", "eff_max");
+    for (const auto &name : paths) {
+        Path path{.name = name};
+        if (name == "boost") {
+            path.probe = cpufreqProbe;
+            path.fire = [&]() { return hal->setBoost(*boost, boostMs).isOk(); };
+        } else if (name == "mode") {
+            path.probe = cpufreqProbe;
+            path.fire = [&]() { return hal->setMode(*mode, true).isOk(); };
+            path.tearDown = [&]() { hal->setMode(*mode, false); };
+        } else if (name == "session_hint" || name == "session_report" || name == "gpu_hint") {
+            path.probe = name == "gpu_hint" ? gpuProbe : uclampProbe;
+            path.setUp = newSession;
+            path.tearDown = closeSession;
+            if (name == "session_report") {
+                path.fire = [&]() {
+                    return (*session)->reportActualWorkDuration(overTargetDurations()).isOk();
+                };
+            } else {
+                const auto hint =
+                        name == "gpu_hint" ? SessionHint::GPU_LOAD_UP : SessionHint::CPU_LOAD_UP;
+                path.fire = [&sessionHint, hint]() { return sessionHint(hint); };
+            }
+        } else if (name == "channel_hint" || name == "channel_report") {
+            if (!channel) {
+                channel = std::make_unique<Channel>(hal);
+            }
+            if (!channel->isValid()) {
+                continue;
+            }
+            path.probe = uclampProbe;
+            path.setUp = newSession;
+            path.tearDown = closeSession;
+            if (name == "channel_report") {
+                path.fire = [&]() { return channel->send(overTargetMessages(session->id())); };
+            } else {
+                path.fire = [&]() {
+                    return channel->send({hintMessage(session->id(), SessionHint::CPU_LOAD_UP)});
+                };
+            }
+        } else {
+            LOG(ERROR) << "Unknown path " << name;
+            printUsage(argv[0]);
+            return 1;
+        }
+        if (!path.probe) {
+            LOG(WARNING) << "Skipping " << name << ", nothing to watch";
+            continue;
+        }
+        PathStats stats;
+        if (!runPath(path, iterations, timeout, &stats)) {
+            LOG(WARNING) << "Stopped " << name << " after " << stats.callUs.size() << " calls";
+        }
+        session.reset();
+        printStats(name, &stats);
+    }
+    return 0;
+}
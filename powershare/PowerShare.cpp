@@ -14,38 +14,156 @@
  * limitations under the License.
  */
 
+#define LOG_TAG "vendor.lineage.powershare@1.0-service.pixel"
+
 #include "PowerShare.h"
-#include <fstream>
+
+#include <android-base/logging.h>
+#include <cutils/uevent.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <string_view>
 
 #define WLC_DEV_DIR "/sys/class/power_supply/wireless/device"
 #define RTX_ENABLE_PATH WLC_DEV_DIR "/rtx"
 
+// The longest a caller of setEnabled waits for its write
+static constexpr int kWriteWaitMs = 100;
+static constexpr int kUeventMsgLen = 2048;
+
 /*
- * Write value to path and close file.
+ * Reads rtx through node, 0 when it can't be read.
  */
-template <typename T>
-static void set(const std::string& path, const T& value) {
-    std::ofstream file(path);
-    file << value;
+static int readRtx(android::hardware::google::pixel::SysfsNode& node) {
+    int64_t value;
+    return node.readInt(&value) && value == 1;
 }
 
-template <typename T>
-static T get(const std::string& path, const T& def) {
-    std::ifstream file(path);
-    T result;
+namespace vendor::lineage::powershare::pixel {
 
-    file >> result;
-    return file.fail() ? def : result;
+PowerShare::PowerShare() : mRtx(RTX_ENABLE_PATH), mWorkerRtx(RTX_ENABLE_PATH) {
+    mWakeFd.reset(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+    mUeventFd.reset(uevent_open_socket(64 * 1024, true));
+    if (!mUeventFd.ok()) {
+        LOG(ERROR) << "Can't open the uevent socket, reading " << RTX_ENABLE_PATH
+                   << " on every call";
+    }
+    mWorker = std::thread(&PowerShare::work, this);
 }
 
-namespace vendor::lineage::powershare::pixel {
+PowerShare::~PowerShare() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStopping = true;
+    }
+    eventfd_write(mWakeFd.get(), 1);
+    mWorker.join();
+}
+
+void PowerShare::work() {
+    pollfd fds[] = {{mWakeFd.get(), POLLIN, 0}, {mUeventFd.get(), POLLIN, 0}};
+    const nfds_t nfds = mUeventFd.ok() ? 2 : 1;
+
+    while (true) {
+        if (TEMP_FAILURE_RETRY(poll(fds, nfds, -1)) < 0) {
+            PLOG(ERROR) << "poll";
+            return;
+        }
+        if (nfds > 1 && (fds[1].revents & POLLIN)) {
+            readUevents();
+        }
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+        eventfd_t unused;
+        eventfd_read(mWakeFd.get(), &unused);
+
+        int value;
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            if (mStopping) {
+                return;
+            }
+            value = mPendingWrite;
+            mPendingWrite = -1;
+        }
+        if (value < 0) {
+            continue;
+        }
+
+        // May block while the TX hardware ramps
+        mWorkerRtx.writeInt(value);
+        const int enabled = readRtx(mWorkerRtx);
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mEnabled = mUeventFd.ok() ? enabled : -1;
+            mWrites++;
+        }
+        mWritten.notify_all();
+    }
+}
+
+/*
+ * Drops the cached state on a uevent of the wireless power supply, whose rtx
+ * follows it.
+ */
+void PowerShare::readUevents() {
+    char msg[kUeventMsgLen + 2];
+
+    while (true) {
+        const int n = uevent_kernel_multicast_recv(mUeventFd.get(), msg, kUeventMsgLen);
+        if (n <= 0 || n >= kUeventMsgLen) {
+            return;
+        }
+        msg[n] = '\0';
+        msg[n + 1] = '\0';
+
+        bool powerSupply = false, wireless = false;
+        for (const char* cp = msg; *cp; cp += strlen(cp) + 1) {
+            const std::string_view line(cp);
+            if (line == "SUBSYSTEM=power_supply") {
+                powerSupply = true;
+            } else if (line == "POWER_SUPPLY_NAME=wireless") {
+                wireless = true;
+            }
+        }
+        if (powerSupply && wireless) {
+            std::lock_guard<std::mutex> lock(mLock);
+            mEnabled = -1;
+        }
+    }
+}
 
 Return<bool> PowerShare::isEnabled() {
-    return get(RTX_ENABLE_PATH, 0) == 1;
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mEnabled < 0) {
+        const int enabled = readRtx(mRtx);
+        if (!mUeventFd.ok()) {
+            return enabled;
+        }
+        mEnabled = enabled;
+    }
+    return mEnabled == 1;
 }
 
 Return<bool> PowerShare::setEnabled(bool enable) {
-    set(RTX_ENABLE_PATH, enable ? 1 : 0);
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        const uint64_t writes = mWrites;
+        mPendingWrite = enable ? 1 : 0;
+        mEnabled = -1;
+        eventfd_write(mWakeFd.get(), 1);
+        // Beyond the wait, report what was asked for; the write and the uevent that
+        // follows it settle the cached state
+        if (!mWritten.wait_for(lock, std::chrono::milliseconds(kWriteWaitMs),
+                               [&] { return mWrites != writes && mPendingWrite < 0; })) {
+            return enable;
+        }
+    }
     return isEnabled();
 }
 
@@ -17,8 +17,14 @@
 #pragma once
 
 #include <vendor/lineage/powershare/1.0/IPowerShare.h>
+#include <android-base/unique_fd.h>
 #include <hidl/MQDescriptor.h>
 #include <hidl/Status.h>
+#include <pixelsysfs/SysfsNode.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 namespace vendor::lineage::powershare::pixel {
 
@@ -30,12 +36,45 @@ using ::android::hardware::Return;
 using ::android::hardware::Void;
 using ::android::sp;
 
+/*
+ * The enabled state is cached, and read from sysfs again only after a uevent of
+ * the wireless power supply. Writes to rtx are made on a worker thread, which
+ * also listens for the uevents, so that a binder thread waits at most
+ * kWriteWaitMs for the TX hardware to ramp.
+ */
 struct PowerShare : public V1_0::IPowerShare {
+    PowerShare();
+    ~PowerShare();
+
     // Methods from ::vendor::lineage::powershare::V1_0::IPowerShare follow.
     Return<bool> isEnabled() override;
     Return<bool> setEnabled(bool enable) override;
     Return<uint32_t> getMinBattery() override;
     Return<uint32_t> setMinBattery(uint32_t minBattery) override;
+
+  private:
+    void work();
+    void readUevents();
+
+    std::mutex mLock;
+    std::condition_variable mWritten;
+    // -1 when it must be read from sysfs
+    int mEnabled = -1;
+    // The write the worker has yet to make, -1 for none
+    int mPendingWrite = -1;
+    // Counts the writes made, for the callers waiting on one
+    uint64_t mWrites = 0;
+    bool mStopping = false;
+    // rtx as read by the binder threads, under mLock
+    android::hardware::google::pixel::SysfsNode mRtx;
+    // rtx as written and read back by the worker, without the lock
+    android::hardware::google::pixel::SysfsNode mWorkerRtx;
+
+    // Wakes the worker for a write
+    android::base::unique_fd mWakeFd;
+    // Invalid when uevents can't be received; nothing is cached then
+    android::base::unique_fd mUeventFd;
+    std::thread mWorker;
 };
 
 }  // namespace vendor::lineage::powershare::pixel
@@ -17,12 +17,8 @@
 #define LOG_TAG "libpixelpowerstats"
 
 #include <android-base/logging.h>
-#include <android-base/strings.h>
 #include <pixelpowerstats/GenericStateResidencyDataProvider.h>
-#include <pixelpowerstats/PowerStatsUtils.h>
 
-#include <cstdio>
-#include <cstring>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -65,84 +61,29 @@ PowerEntityConfig::PowerEntityConfig(const uint32_t start_id, const std::string
     }
 }
 
-static bool parseState(PowerEntityStateResidencyData *data, const StateResidencyConfig &config,
-                       FILE *fp, char **line, size_t *len) {
-    size_t numFieldsRead = 0;
-    const size_t numFields =
-            config.entryCountSupported + config.totalTimeSupported + config.lastEntrySupported;
-
-    while ((numFieldsRead < numFields) && (getline(line, len, fp) != -1)) {
-        uint64_t stat = 0;
-        // Attempt to extract data from the current line
-        if (config.entryCountSupported &&
-            utils::extractStat(*line, config.entryCountPrefix, stat)) {
-            data->totalStateEntryCount =
-                    config.entryCountTransform ? config.entryCountTransform(stat) : stat;
-            ++numFieldsRead;
-        } else if (config.totalTimeSupported &&
-                   utils::extractStat(*line, config.totalTimePrefix, stat)) {
-            data->totalTimeInStateMs =
-                    config.totalTimeTransform ? config.totalTimeTransform(stat) : stat;
-            ++numFieldsRead;
-        } else if (config.lastEntrySupported &&
-                   utils::extractStat(*line, config.lastEntryPrefix, stat)) {
-            data->lastEntryTimestampMs =
-                    config.lastEntryTransform ? config.lastEntryTransform(stat) : stat;
-            ++numFieldsRead;
-        }
-    }
-
-    // End of file was reached and not all state data was parsed. Something
-    // went wrong
-    if (numFieldsRead != numFields) {
-        LOG(ERROR) << __func__ << ": failed to parse stats for:" << config.name;
-        return false;
-    }
-
-    return true;
-}
-
-template <class T, class Func>
-static auto findNext(const std::vector<T> &collection, FILE *fp, char **line, size_t *len,
-                     Func pred) {
-    // handling the case when there is no header to look for
-    if (pred(collection.front(), "")) {
-        return collection.cbegin();
-    }
-
-    while (getline(line, len, fp) != -1) {
-        for (auto it = collection.cbegin(); it != collection.cend(); ++it) {
-            if (pred(*it, *line)) {
-                return it;
-            }
-        }
-    }
-
-    return collection.cend();
-}
-
 static bool getStateData(
         PowerEntityStateResidencyResult *result,
         const std::vector<std::pair<uint32_t, StateResidencyConfig>> &stateResidencyConfigs,
-        FILE *fp, char **line, size_t *len) {
+        GenericStateResidencyParser *parser) {
     size_t numStatesRead = 0;
     size_t numStates = stateResidencyConfigs.size();
-    auto nextState = stateResidencyConfigs.cbegin();
-    auto endState = stateResidencyConfigs.cend();
-    auto pred = [](auto a, char const *b) {
-        // return true if b matches the header contained in a, ignoring whitespace
-        return (a.second.header == android::base::Trim(b));
-    };
+    int32_t nextState = -1;
+    auto header = [](const auto &config) -> const std::string & { return config.second.header; };
 
     result->stateResidencyData.resize(numStates);
 
     // Search for state headers until we have found them all or can't find anymore
     while ((numStatesRead < numStates) &&
-           (nextState = findNext<std::pair<uint32_t, StateResidencyConfig>>(
-                    stateResidencyConfigs, fp, line, len, pred)) != endState) {
+           (nextState = parser->findNextHeader(stateResidencyConfigs, header)) >= 0) {
         // Found a matching state header. Parse the contents
-        PowerEntityStateResidencyData data = {.powerEntityStateId = nextState->first};
-        if (parseState(&data, nextState->second, fp, line, len)) {
+        GenericStateResidencyParser::StateStats stats;
+        if (parser->parseState(stateResidencyConfigs[nextState].second, &stats)) {
+            PowerEntityStateResidencyData data = {
+                    .powerEntityStateId = stateResidencyConfigs[nextState].first,
+                    .totalTimeInStateMs = stats.totalTimeInStateMs,
+                    .totalStateEntryCount = stats.totalStateEntryCount,
+                    .lastEntryTimestampMs = stats.lastEntryTimestampMs,
+            };
             result->stateResidencyData[numStatesRead] = data;
             ++numStatesRead;
         } else {
@@ -160,35 +101,25 @@ static bool getStateData(
 
 bool GenericStateResidencyDataProvider::getResults(
         std::unordered_map<uint32_t, PowerEntityStateResidencyResult> &results) {
-    // Using FILE* instead of std::ifstream for performance reasons (b/122253123)
-    std::unique_ptr<FILE, decltype(&fclose)> fp(fopen(mPath.c_str(), "r"), fclose);
-    if (!fp) {
-        PLOG(ERROR) << __func__ << ":Failed to open file " << mPath
-                    << " Error = " << strerror(errno);
+    std::lock_guard<std::mutex> lock(mLock);
+    if (!mParser.read()) {
         return false;
     }
 
-    size_t len = 0;
-    char *line = nullptr;
     size_t numEntitiesRead = 0;
     size_t numEntities = mPowerEntityConfigs.size();
-    auto nextConfig = mPowerEntityConfigs.cbegin();
-    auto endConfig = mPowerEntityConfigs.cend();
-    auto pred = [](auto a, char const *b) {
-        // return true if b matches the header contained in a, ignoring whitespace
-        return (a.second.mHeader == android::base::Trim(b));
-    };
+    int32_t next = -1;
+    auto header = [](const auto &config) -> const std::string & { return config.second.mHeader; };
     bool skipFindNext = false;
 
     // Search for entity headers until we have found them all or can't find anymore
     while ((numEntitiesRead < numEntities) &&
            (skipFindNext ||
-            (nextConfig = findNext<decltype(mPowerEntityConfigs)::value_type>(
-                     mPowerEntityConfigs, fp.get(), &line, &len, pred)) != endConfig)) {
+            (next = mParser.findNextHeader(mPowerEntityConfigs, header)) >= 0)) {
         // Found a matching header. Retrieve its state data
+        auto nextConfig = mPowerEntityConfigs.cbegin() + next;
         PowerEntityStateResidencyResult result = {.powerEntityId = nextConfig->first};
-        if (getStateData(&result, nextConfig->second.mStateResidencyConfigs, fp.get(), &line,
-                         &len)) {
+        if (getStateData(&result, nextConfig->second.mStateResidencyConfigs, &mParser)) {
             // If a power entity already exists, then merge in the
             // StateResidencyData.
             if (results.find(nextConfig->first) != results.end()) {
@@ -210,19 +141,18 @@ bool GenericStateResidencyDataProvider::getResults(
         // If the header of the next PowerEntityConfig is equal to the
         // current, don't search for it within the file since we'll be search
         // for more states.
-        auto currConfig = nextConfig++;
-        if (nextConfig != endConfig && nextConfig->second.mHeader == currConfig->second.mHeader) {
+        ++next;
+        if (next < numEntities && mPowerEntityConfigs[next].second.mHeader ==
+                                          nextConfig->second.mHeader) {
             skipFindNext = true;
         } else {
             skipFindNext = false;
         }
     }
 
-    free(line);
-
     // There was a problem gathering state residency data for one or more entities
     if (numEntitiesRead != numEntities) {
-        LOG(ERROR) << __func__ << ":Failed to get results for " << mPath;
+        LOG(ERROR) << __func__ << ":Failed to get results for " << mParser.path();
         return false;
     }
 
@@ -230,10 +160,12 @@ bool GenericStateResidencyDataProvider::getResults(
 }
 
 void GenericStateResidencyDataProvider::addEntity(uint32_t id, const PowerEntityConfig &config) {
+    std::lock_guard<std::mutex> lock(mLock);
     mPowerEntityConfigs.emplace_back(id, config);
 }
 
 std::vector<PowerEntityStateSpace> GenericStateResidencyDataProvider::getStateSpaces() {
+    std::lock_guard<std::mutex> lock(mLock);
     std::vector<PowerEntityStateSpace> stateSpaces;
     stateSpaces.reserve(mPowerEntityConfigs.size());
     for (auto config : mPowerEntityConfigs) {
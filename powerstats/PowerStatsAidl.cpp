@@ -24,6 +24,9 @@
 #include <android-base/strings.h>
 
 #include <inttypes.h>
+#include <pthread.h>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <numeric>
 #include <string>
@@ -34,6 +37,72 @@ namespace hardware {
 namespace power {
 namespace stats {
 
+namespace {
+
+std::atomic<uint64_t> nextEpoch{1};
+// The epoch of the top-level call running on this thread, 0 if none
+thread_local uint64_t threadEpoch = 0;
+thread_local int threadEpochDepth = 0;
+thread_local PowerStats::ReadCounters threadReadCounters;
+thread_local PowerStats::ReadCounters threadLastReadCounters;
+
+}  // namespace
+
+PowerStats::~PowerStats() {
+    {
+        std::lock_guard<std::mutex> lock(mSnapshotLock);
+        mReadThreadsExit = true;
+    }
+    mReadQueueCond.notify_all();
+    for (auto &thread : mReadThreads) {
+        thread.join();
+    }
+}
+
+PowerStats::SnapshotEpoch::SnapshotEpoch(PowerStats *powerStats) : mPowerStats(powerStats) {
+    if (threadEpochDepth++ == 0) {
+        threadEpoch = nextEpoch.fetch_add(1, std::memory_order_relaxed);
+        threadReadCounters = ReadCounters();
+    }
+}
+
+PowerStats::SnapshotEpoch::~SnapshotEpoch() {
+    if (--threadEpochDepth > 0) {
+        return;
+    }
+    threadEpoch = 0;
+    threadLastReadCounters = threadReadCounters;
+
+    std::lock_guard<std::mutex> lock(mPowerStats->mSnapshotLock);
+    ReadCounters &total = mPowerStats->mTotalReadCounters;
+    total.stateResidencyReads += threadReadCounters.stateResidencyReads;
+    total.energyMeterReads += threadReadCounters.energyMeterReads;
+    total.snapshotHits += threadReadCounters.snapshotHits;
+    total.stateResidencyTimeouts += threadReadCounters.stateResidencyTimeouts;
+}
+
+bool PowerStats::isFresh(const Snapshot &snapshot,
+                         ::android::base::boot_clock::time_point now) const {
+    if (snapshot.epoch == 0) {
+        return false;
+    }
+    return snapshot.epoch == threadEpoch || now - snapshot.time <= mMaxSnapshotStaleness;
+}
+
+void PowerStats::setMaxSnapshotStaleness(std::chrono::milliseconds staleness) {
+    std::lock_guard<std::mutex> lock(mSnapshotLock);
+    mMaxSnapshotStaleness = staleness;
+}
+
+void PowerStats::setStateResidencyReadTimeout(std::chrono::milliseconds timeout) {
+    std::lock_guard<std::mutex> lock(mSnapshotLock);
+    mStateResidencyReadTimeout = timeout;
+}
+
+PowerStats::ReadCounters PowerStats::getLastReadCounters() const {
+    return threadLastReadCounters;
+}
+
 void PowerStats::addStateResidencyDataProvider(std::unique_ptr<IStateResidencyDataProvider> p) {
     if (!p) {
         return;
@@ -44,6 +113,7 @@ void PowerStats::addStateResidencyDataProvider(std::unique_ptr<IStateResidencyDa
 
     size_t index = mStateResidencyDataProviders.size();
     mStateResidencyDataProviders.emplace_back(std::move(p));
+    mStateResidencySnapshots.emplace_back();
 
     for (const auto &[entityName, states] : info) {
         PowerEntity i = {
@@ -78,24 +148,66 @@ ndk::ScopedAStatus PowerStats::getStateResidency(const std::vector<int32_t> &in_
         return getStateResidency(v, _aidl_return);
     }
 
-    std::unordered_map<std::string, std::vector<StateResidency>> stateResidencies;
+    SnapshotEpoch epoch(this);
+    std::unique_lock<std::mutex> lock(mSnapshotLock);
+    const auto now = ::android::base::boot_clock::now();
 
+    // Hand the providers without a fresh snapshot to the read threads, unless a
+    // read of theirs is already running
+    std::vector<size_t> readIndexes;
     for (const int32_t id : in_powerEntityIds) {
         // check for invalid ids
         if (id < 0 || id >= mPowerEntityInfos.size()) {
             return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_ILLEGAL_ARGUMENT));
         }
 
-        // Check to see if we already have data for the given id
-        std::string powerEntityName = mPowerEntityInfos[id].name;
-        if (stateResidencies.find(powerEntityName) == stateResidencies.end()) {
-            mStateResidencyDataProviders.at(mStateResidencyDataProviderIndex.at(id))
-                    ->getStateResidencies(&stateResidencies);
+        const size_t index = mStateResidencyDataProviderIndex.at(id);
+        StateResidencySnapshot &snapshot = mStateResidencySnapshots.at(index);
+        if (isFresh(snapshot.snapshot, now)) {
+            threadReadCounters.snapshotHits++;
+            continue;
+        }
+        if (std::find(readIndexes.begin(), readIndexes.end(), index) != readIndexes.end()) {
+            continue;
+        }
+        readIndexes.emplace_back(index);
+        if (!snapshot.reading) {
+            snapshot.reading = true;
+            mReadQueue.push_back({.index = index, .epoch = threadEpoch, .time = now});
+            threadReadCounters.stateResidencyReads++;
+        }
+    }
+
+    if (!readIndexes.empty()) {
+        startReadThreadsLocked();
+        mReadQueueCond.notify_all();
+        const auto deadline = now + mStateResidencyReadTimeout;
+        mReadDoneCond.wait_until(lock, deadline, [this, &readIndexes] {
+            return std::none_of(readIndexes.begin(), readIndexes.end(), [this](size_t index) {
+                return mStateResidencySnapshots[index].reading;
+            });
+        });
+    }
+
+    // Assemble the results in the order of in_powerEntityIds. Entities whose provider
+    // timed out or failed are left out.
+    std::vector<bool> timedOut(mStateResidencySnapshots.size(), false);
+    for (const size_t index : readIndexes) {
+        if (mStateResidencySnapshots[index].reading) {
+            LOG(ERROR) << "State residency read timed out after "
+                       << mStateResidencyReadTimeout.count() << " ms";
+            threadReadCounters.stateResidencyTimeouts++;
+            timedOut[index] = true;
         }
+    }
+    for (const int32_t id : in_powerEntityIds) {
+        const std::string &powerEntityName = mPowerEntityInfos[id].name;
+        const size_t index = mStateResidencyDataProviderIndex.at(id);
+        const StateResidencySnapshot &snapshot = mStateResidencySnapshots.at(index);
 
         // Append results if we have them
-        auto stateResidency = stateResidencies.find(powerEntityName);
-        if (stateResidency != stateResidencies.end()) {
+        auto stateResidency = snapshot.residencies.find(powerEntityName);
+        if (!timedOut[index] && stateResidency != snapshot.residencies.end()) {
             StateResidencyResult res = {
                     .id = id,
                     .stateResidencyData = stateResidency->second,
@@ -110,6 +222,42 @@ ndk::ScopedAStatus PowerStats::getStateResidency(const std::vector<int32_t> &in_
     return ndk::ScopedAStatus::ok();
 }
 
+void PowerStats::startReadThreadsLocked() {
+    if (!mReadThreads.empty()) {
+        return;
+    }
+    const size_t numThreads = std::min(kMaxReadThreads, mStateResidencyDataProviders.size());
+    for (size_t i = 0; i < numThreads; i++) {
+        mReadThreads.emplace_back(&PowerStats::readThreadLoop, this);
+        pthread_setname_np(mReadThreads.back().native_handle(), "powerstats_read");
+    }
+}
+
+void PowerStats::readThreadLoop() {
+    std::unique_lock<std::mutex> lock(mSnapshotLock);
+    while (true) {
+        mReadQueueCond.wait(lock, [this] { return mReadThreadsExit || !mReadQueue.empty(); });
+        if (mReadThreadsExit) {
+            return;
+        }
+        const ReadRequest request = mReadQueue.front();
+        mReadQueue.pop_front();
+
+        // Read without the lock, so that callers can time out and other providers
+        // be read meanwhile. A late result still serves the calls after it.
+        std::unordered_map<std::string, std::vector<StateResidency>> residencies;
+        lock.unlock();
+        mStateResidencyDataProviders.at(request.index)->getStateResidencies(&residencies);
+        lock.lock();
+
+        StateResidencySnapshot &snapshot = mStateResidencySnapshots.at(request.index);
+        snapshot.residencies = std::move(residencies);
+        snapshot.snapshot = {.epoch = request.epoch, .time = request.time};
+        snapshot.reading = false;
+        mReadDoneCond.notify_all();
+    }
+}
+
 void PowerStats::addEnergyConsumer(std::unique_ptr<IEnergyConsumer> p) {
     if (!p) {
         return;
@@ -122,6 +270,8 @@ void PowerStats::addEnergyConsumer(std::unique_ptr<IEnergyConsumer> p) {
     int32_t id = mEnergyConsumers.size();
     mEnergyConsumerInfos.emplace_back(
             EnergyConsumer{.id = id, .ordinal = count, .type = info.first, .name = info.second});
+    mEnergyConsumerPowerEntityIds.emplace_back(p->getPowerEntityIds());
+    mEnergyConsumerChannelIds.emplace_back(p->getChannelIds());
     mEnergyConsumers.emplace_back(std::move(p));
 }
 
@@ -143,12 +293,35 @@ ndk::ScopedAStatus PowerStats::getEnergyConsumed(const std::vector<int32_t> &in_
         return getEnergyConsumed(v, _aidl_return);
     }
 
+    // check for invalid ids
     for (const auto id : in_energyConsumerIds) {
-        // check for invalid ids
         if (id < 0 || id >= mEnergyConsumers.size()) {
             return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_ILLEGAL_ARGUMENT));
         }
+    }
 
+    // The consumers read state residencies and energy meters through this
+    // class, so those they share are read once. Read all of them ahead, in one
+    // parallel read of the state residency providers and one of the energy meter.
+    SnapshotEpoch epoch(this);
+    std::vector<int32_t> powerEntityIds;
+    std::vector<int32_t> channelIds;
+    for (const auto id : in_energyConsumerIds) {
+        powerEntityIds.insert(powerEntityIds.end(), mEnergyConsumerPowerEntityIds[id].begin(),
+                              mEnergyConsumerPowerEntityIds[id].end());
+        channelIds.insert(channelIds.end(), mEnergyConsumerChannelIds[id].begin(),
+                          mEnergyConsumerChannelIds[id].end());
+    }
+    if (!powerEntityIds.empty()) {
+        std::vector<StateResidencyResult> results;
+        getStateResidency(powerEntityIds, &results);
+    }
+    if (!channelIds.empty()) {
+        std::vector<EnergyMeasurement> measurements;
+        readEnergyMeter(channelIds, &measurements);
+    }
+
+    for (const auto id : in_energyConsumerIds) {
         auto resopt = mEnergyConsumers[id]->getEnergyConsumed();
         if (resopt) {
             EnergyConsumerResult res = resopt.value();
@@ -165,6 +338,18 @@ ndk::ScopedAStatus PowerStats::getEnergyConsumed(const std::vector<int32_t> &in_
 
 void PowerStats::setEnergyMeterDataProvider(std::unique_ptr<IEnergyMeterDataProvider> p) {
     mEnergyMeterDataProvider = std::move(p);
+    mChannelIds.clear();
+    mEnergyMeterSnapshots.clear();
+    if (!mEnergyMeterDataProvider) {
+        return;
+    }
+
+    std::vector<Channel> channels;
+    mEnergyMeterDataProvider->getEnergyMeterInfo(&channels);
+    for (const auto &channel : channels) {
+        mChannelIds.emplace_back(channel.id);
+        mEnergyMeterSnapshots.emplace(channel.id, EnergyMeterSnapshot());
+    }
 }
 
 ndk::ScopedAStatus PowerStats::getEnergyMeterInfo(std::vector<Channel> *_aidl_return) {
@@ -179,7 +364,66 @@ ndk::ScopedAStatus PowerStats::readEnergyMeter(const std::vector<int32_t> &in_ch
     if (!mEnergyMeterDataProvider) {
         return ndk::ScopedAStatus::ok();
     }
-    return mEnergyMeterDataProvider->readEnergyMeter(in_channelIds, _aidl_return);
+
+    SnapshotEpoch epoch(this);
+    std::lock_guard<std::mutex> lock(mSnapshotLock);
+    const auto now = ::android::base::boot_clock::now();
+
+    // If in_channelIds is empty then return data for all channels
+    const std::vector<int32_t> &channelIds = in_channelIds.empty() ? mChannelIds : in_channelIds;
+
+    bool stale = false;
+    for (const int32_t id : channelIds) {
+        auto snapshot = mEnergyMeterSnapshots.find(id);
+        if (snapshot == mEnergyMeterSnapshots.end()) {
+            return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_ILLEGAL_ARGUMENT));
+        }
+        if (isFresh(snapshot->second.snapshot, now)) {
+            threadReadCounters.snapshotHits++;
+        } else {
+            stale = true;
+        }
+    }
+
+    // Read the channels without a fresh snapshot in one call to the provider. Within
+    // getEnergyConsumed() that is every stale channel, as the other consumers will ask
+    // for theirs.
+    std::vector<int32_t> staleIds;
+    if (stale) {
+        const bool nested = threadEpochDepth > 1;
+        for (const int32_t id : nested ? mChannelIds : channelIds) {
+            if (!isFresh(mEnergyMeterSnapshots.at(id).snapshot, now)) {
+                staleIds.emplace_back(id);
+            }
+        }
+    }
+
+    if (!staleIds.empty()) {
+        std::vector<EnergyMeasurement> measurements;
+        ndk::ScopedAStatus status =
+                mEnergyMeterDataProvider->readEnergyMeter(staleIds, &measurements);
+        threadReadCounters.energyMeterReads++;
+        if (!status.isOk()) {
+            return status;
+        }
+        for (const auto &measurement : measurements) {
+            auto snapshot = mEnergyMeterSnapshots.find(measurement.id);
+            if (snapshot != mEnergyMeterSnapshots.end()) {
+                snapshot->second.snapshot = {.epoch = threadEpoch, .time = now};
+                snapshot->second.measurement = measurement;
+            }
+        }
+    }
+
+    // Channels the provider failed to read are left out, as it would have
+    for (const int32_t id : channelIds) {
+        const EnergyMeterSnapshot &snapshot = mEnergyMeterSnapshots.at(id);
+        if (isFresh(snapshot.snapshot, now)) {
+            _aidl_return->emplace_back(snapshot.measurement);
+        }
+    }
+
+    return ndk::ScopedAStatus::ok();
 }
 
 void PowerStats::statesUpdate(const std::string &entityName, const std::vector<State> &states) {
@@ -394,6 +638,15 @@ void PowerStats::dumpEnergyConsumer(std::ostringstream &oss, bool delta) {
     oss << "========== End of PowerStats HAL 2.0 energy consumers ==========\n";
 }
 
+void PowerStats::dumpSnapshot(std::ostringstream &oss) {
+    std::lock_guard<std::mutex> lock(mSnapshotLock);
+    oss << "\nSnapshots: max staleness " << mMaxSnapshotStaleness.count() << " ms, "
+        << mTotalReadCounters.stateResidencyReads << " state residency reads, "
+        << mTotalReadCounters.energyMeterReads << " energy meter reads, "
+        << mTotalReadCounters.snapshotHits << " served from snapshots, "
+        << mTotalReadCounters.stateResidencyTimeouts << " state residency timeouts\n";
+}
+
 binder_status_t PowerStats::dump(int fd, const char **args, uint32_t numArgs) {
     std::ostringstream oss;
     bool delta = (numArgs == 1) && (std::string(args[0]) == "delta");
@@ -407,6 +660,12 @@ binder_status_t PowerStats::dump(int fd, const char **args, uint32_t numArgs) {
     // Generate debug output energy meter
     dumpEnergyMeter(oss, delta);
 
+    dumpSnapshot(oss);
+
+    for (const auto &provider : mStateResidencyDataProviders) {
+        provider->dump(oss);
+    }
+
     ::android::base::WriteStringToFd(oss.str(), fd);
     fsync(fd);
     return STATUS_OK;
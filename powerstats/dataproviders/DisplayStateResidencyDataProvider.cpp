@@ -30,7 +30,9 @@ namespace hardware {
 namespace power {
 namespace stats {
 
-static const int32_t POLL_TIMEOUT_MILLIS = 300;
+// The state is read when the driver notifies a change, and on this timeout
+// in case it does not notify at all
+static const int32_t RESYNC_INTERVAL_MILLIS = 2000;
 
 DisplayStateResidencyDataProvider::DisplayStateResidencyDataProvider(
         std::string name, std::string path, std::vector<std::string> states)
@@ -63,6 +65,11 @@ DisplayStateResidencyDataProvider::DisplayStateResidencyDataProvider(
 }
 
 DisplayStateResidencyDataProvider::~DisplayStateResidencyDataProvider() {
+    if (mThread.joinable()) {
+        mStop = true;
+        mLooper->wake();
+        mThread.join();
+    }
     if (mFd >= 0) {
         close(mFd);
     }
@@ -114,6 +121,7 @@ void DisplayStateResidencyDataProvider::updateStats() {
         PLOG(ERROR) << "Failed to read display state";
         return;
     }
+    data[ret] = '\0';
 
     trim = strchr(data, '\n');
     if (trim) {
@@ -150,10 +158,12 @@ void DisplayStateResidencyDataProvider::updateStats() {
 void DisplayStateResidencyDataProvider::pollLoop() {
     int32_t res;
     LOG(VERBOSE) << "DisplayStateResidencyDataProvider polling...";
-    while (true) {
+    // Read the initial state
+    updateStats();
+    while (!mStop) {
         // Poll for display state changes.
-        res = mLooper->pollOnce(POLL_TIMEOUT_MILLIS);
-        if (res >= 0 || res == ::android::Looper::POLL_TIMEOUT) {
+        res = mLooper->pollOnce(RESYNC_INTERVAL_MILLIS);
+        if (!mStop && (res >= 0 || res == ::android::Looper::POLL_TIMEOUT)) {
             updateStats();
         }
     }
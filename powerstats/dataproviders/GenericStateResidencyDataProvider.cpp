@@ -15,7 +15,6 @@
  */
 
 #include <android-base/logging.h>
-#include <android-base/strings.h>
 
 #include <dataproviders/GenericStateResidencyDataProvider.h>
 
@@ -40,92 +39,29 @@ generateGenericStateResidencyConfigs(
     return stateResidencyConfigs;
 }
 
-static bool extractStat(const char *line, const std::string &prefix, uint64_t *stat) {
-    char const *prefixStart = strstr(line, prefix.c_str());
-    if (prefixStart == nullptr) {
-        // Did not find the given prefix
-        return false;
-    }
-
-    *stat = strtoull(prefixStart + prefix.length(), nullptr, 0);
-    return true;
-}
-
-static bool parseState(StateResidency *data,
-                       const GenericStateResidencyDataProvider::StateResidencyConfig &config,
-                       FILE *fp, char **line, size_t *len) {
-    size_t numFieldsRead = 0;
-    const size_t numFields =
-            config.entryCountSupported + config.totalTimeSupported + config.lastEntrySupported;
-
-    while ((numFieldsRead < numFields) && (getline(line, len, fp) != -1)) {
-        uint64_t stat = 0;
-        // Attempt to extract data from the current line
-        if (config.entryCountSupported && extractStat(*line, config.entryCountPrefix, &stat)) {
-            data->totalStateEntryCount =
-                    config.entryCountTransform ? config.entryCountTransform(stat) : stat;
-            ++numFieldsRead;
-        } else if (config.totalTimeSupported && extractStat(*line, config.totalTimePrefix, &stat)) {
-            data->totalTimeInStateMs =
-                    config.totalTimeTransform ? config.totalTimeTransform(stat) : stat;
-            ++numFieldsRead;
-        } else if (config.lastEntrySupported && extractStat(*line, config.lastEntryPrefix, &stat)) {
-            data->lastEntryTimestampMs =
-                    config.lastEntryTransform ? config.lastEntryTransform(stat) : stat;
-            ++numFieldsRead;
-        }
-    }
-
-    // End of file was reached and not all state data was parsed. Something
-    // went wrong
-    if (numFieldsRead != numFields) {
-        LOG(ERROR) << "Failed to parse stats for " << config.name;
-        return false;
-    }
-
-    return true;
-}
-
-template <class T, class Func>
-static int32_t findNextIndex(const std::vector<T> &collection, FILE *fp, char **line, size_t *len,
-                             Func pred) {
-    // handling the case when there is no header to look for
-    if (pred(collection[0], "")) {
-        return 0;
-    }
-
-    while (getline(line, len, fp) != -1) {
-        for (int32_t i = 0; i < collection.size(); ++i) {
-            if (pred(collection[i], *line)) {
-                return i;
-            }
-        }
-    }
-
-    return -1;
-}
-
 static bool getStateData(std::vector<StateResidency> *result,
                          const std::vector<GenericStateResidencyDataProvider::StateResidencyConfig>
                                  &stateResidencyConfigs,
-                         FILE *fp, char **line, size_t *len) {
+                         GenericStateResidencyParser *parser) {
     size_t numStatesRead = 0;
     size_t numStates = stateResidencyConfigs.size();
     int32_t nextState = -1;
-    auto pred = [](auto a, char const *b) {
-        // return true if b matches the header contained in a, ignoring whitespace
-        return (a.header == ::android::base::Trim(b));
-    };
+    auto header = [](const auto &config) -> const std::string & { return config.header; };
 
     result->reserve(numStates);
 
     // Search for state headers until we have found them all or can't find anymore
     while ((numStatesRead < numStates) &&
-           (nextState = findNextIndex<GenericStateResidencyDataProvider::StateResidencyConfig>(
-                    stateResidencyConfigs, fp, line, len, pred)) >= 0) {
+           (nextState = parser->findNextHeader(stateResidencyConfigs, header)) >= 0) {
         // Found a matching state header. Parse the contents
-        StateResidency data = {.id = nextState};
-        if (parseState(&data, stateResidencyConfigs[nextState], fp, line, len)) {
+        GenericStateResidencyParser::StateStats stats;
+        if (parser->parseState(stateResidencyConfigs[nextState], &stats)) {
+            StateResidency data = {
+                    .id = nextState,
+                    .totalTimeInStateMs = static_cast<int64_t>(stats.totalTimeInStateMs),
+                    .totalStateEntryCount = static_cast<int64_t>(stats.totalStateEntryCount),
+                    .lastEntryTimestampMs = static_cast<int64_t>(stats.lastEntryTimestampMs),
+            };
             result->emplace_back(data);
             ++numStatesRead;
         } else {
@@ -143,31 +79,25 @@ static bool getStateData(std::vector<StateResidency> *result,
 
 bool GenericStateResidencyDataProvider::getStateResidencies(
         std::unordered_map<std::string, std::vector<StateResidency>> *residencies) {
-    // Using FILE* instead of std::ifstream for performance reasons
-    std::unique_ptr<FILE, decltype(&fclose)> fp(fopen(mPath.c_str(), "r"), fclose);
-    if (!fp) {
-        PLOG(ERROR) << "Failed to open file " << mPath;
+    std::lock_guard<std::mutex> lock(mLock);
+    if (!mParser.read()) {
         return false;
     }
 
-    size_t len = 0;
-    char *line = nullptr;
     size_t numEntitiesRead = 0;
     size_t numEntities = mPowerEntityConfigs.size();
     int32_t nextConfig = -1;
-    auto pred = [](auto a, char const *b) {
-        // return true if b matches the header contained in a, ignoring whitespace
-        return (a.mHeader == ::android::base::Trim(b));
+    auto header = [](const PowerEntityConfig &config) -> const std::string & {
+        return config.mHeader;
     };
 
     // Search for entity headers until we have found them all or can't find anymore
     while ((numEntitiesRead < numEntities) &&
-           (nextConfig = findNextIndex<decltype(mPowerEntityConfigs)::value_type>(
-                    mPowerEntityConfigs, fp.get(), &line, &len, pred)) >= 0) {
+           (nextConfig = mParser.findNextHeader(mPowerEntityConfigs, header)) >= 0) {
         // Found a matching header. Retrieve its state data
         std::vector<StateResidency> result;
-        if (getStateData(&result, mPowerEntityConfigs[nextConfig].mStateResidencyConfigs, fp.get(),
-                         &line, &len)) {
+        if (getStateData(&result, mPowerEntityConfigs[nextConfig].mStateResidencyConfigs,
+                         &mParser)) {
             residencies->emplace(mPowerEntityConfigs[nextConfig].mName, result);
             ++numEntitiesRead;
         } else {
@@ -175,11 +105,9 @@ bool GenericStateResidencyDataProvider::getStateResidencies(
         }
     }
 
-    free(line);
-
     // There was a problem gathering state residency data for one or more entities
     if (numEntitiesRead != numEntities) {
-        LOG(ERROR) << "Failed to get results for " << mPath;
+        LOG(ERROR) << "Failed to get results for " << mParser.path();
         return false;
     }
 
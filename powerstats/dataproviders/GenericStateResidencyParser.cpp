@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/logging.h>
+
+#include <dataproviders/GenericStateResidencyParser.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <limits>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace power {
+namespace stats {
+
+namespace {
+
+constexpr size_t kInitialBufferSize = 4096;
+constexpr const char *kWhitespace = " \t\n\v\f\r";
+
+// The number at the start of s as strtoull(s, nullptr, 0) reads it: after any
+// whitespace and sign, in hex after 0x, in octal after 0 and in decimal otherwise.
+uint64_t parseStat(std::string_view s) {
+    const size_t start = s.find_first_not_of(kWhitespace);
+    if (start == std::string_view::npos) {
+        return 0;
+    }
+    s.remove_prefix(start);
+    const bool negative = s.front() == '-';
+    if (negative || s.front() == '+') {
+        s.remove_prefix(1);
+    }
+
+    int base = 10;
+    if (s.size() > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        base = 16;
+        s.remove_prefix(2);
+    } else if (!s.empty() && s[0] == '0') {
+        base = 8;
+    }
+
+    uint64_t stat = 0;
+    if (std::from_chars(s.data(), s.data() + s.size(), stat, base).ec ==
+        std::errc::result_out_of_range) {
+        return std::numeric_limits<uint64_t>::max();
+    }
+    return negative ? -stat : stat;
+}
+
+// The number after prefix, if line has it anywhere
+bool extractStat(std::string_view line, const std::string &prefix, uint64_t *stat) {
+    const size_t start = line.find(prefix);
+    if (start == std::string_view::npos) {
+        // Did not find the given prefix
+        return false;
+    }
+
+    *stat = parseStat(line.substr(start + prefix.size()));
+    return true;
+}
+
+}  // namespace
+
+bool GenericStateResidencyParser::read() {
+    if (!mFd.ok()) {
+        mFd.reset(TEMP_FAILURE_RETRY(open(mPath.c_str(), O_RDONLY | O_CLOEXEC)));
+        if (!mFd.ok()) {
+            PLOG(ERROR) << "Failed to open file " << mPath;
+            return false;
+        }
+    }
+
+    size_t size = 0;
+    while (true) {
+        if (size == mBuffer.size()) {
+            mBuffer.resize(std::max(kInitialBufferSize, mBuffer.size() * 2));
+        }
+        const ssize_t n = TEMP_FAILURE_RETRY(
+                pread(mFd.get(), mBuffer.data() + size, mBuffer.size() - size, size));
+        if (n < 0) {
+            PLOG(ERROR) << "Failed to read file " << mPath;
+            // Open it again on the next read
+            mFd.reset();
+            mContents = {};
+            return false;
+        }
+        if (n == 0) {
+            break;
+        }
+        size += n;
+    }
+
+    mContents = std::string_view(mBuffer.data(), size);
+    return true;
+}
+
+bool GenericStateResidencyParser::parseState(const StateResidencyConfig &config,
+                                             StateStats *stats) {
+    size_t numFieldsRead = 0;
+    const size_t numFields =
+            config.entryCountSupported + config.totalTimeSupported + config.lastEntrySupported;
+
+    std::string_view line;
+    while ((numFieldsRead < numFields) && nextLine(&line)) {
+        uint64_t stat = 0;
+        // Attempt to extract data from the current line
+        if (config.entryCountSupported && extractStat(line, config.entryCountPrefix, &stat)) {
+            stats->totalStateEntryCount =
+                    config.entryCountTransform ? config.entryCountTransform(stat) : stat;
+            ++numFieldsRead;
+        } else if (config.totalTimeSupported && extractStat(line, config.totalTimePrefix, &stat)) {
+            stats->totalTimeInStateMs =
+                    config.totalTimeTransform ? config.totalTimeTransform(stat) : stat;
+            ++numFieldsRead;
+        } else if (config.lastEntrySupported && extractStat(line, config.lastEntryPrefix, &stat)) {
+            stats->lastEntryTimestampMs =
+                    config.lastEntryTransform ? config.lastEntryTransform(stat) : stat;
+            ++numFieldsRead;
+        }
+    }
+
+    // End of file was reached and not all state data was parsed. Something
+    // went wrong
+    if (numFieldsRead != numFields) {
+        LOG(ERROR) << "Failed to parse stats for " << config.name;
+        return false;
+    }
+
+    return true;
+}
+
+bool GenericStateResidencyParser::nextLine(std::string_view *line) {
+    if (mContents.empty()) {
+        return false;
+    }
+
+    const char *end =
+            static_cast<const char *>(memchr(mContents.data(), '\n', mContents.size()));
+    const size_t length = end ? end - mContents.data() : mContents.size();
+    *line = mContents.substr(0, length);
+    mContents.remove_prefix(end ? length + 1 : length);
+    return true;
+}
+
+std::string_view GenericStateResidencyParser::trim(std::string_view s) {
+    const size_t start = s.find_first_not_of(kWhitespace);
+    if (start == std::string_view::npos) {
+        return {};
+    }
+    return s.substr(start, s.find_last_not_of(kWhitespace) - start + 1);
+}
+
+}  // namespace stats
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
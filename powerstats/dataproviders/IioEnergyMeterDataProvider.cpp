@@ -22,7 +22,9 @@
 #include <android-base/strings.h>
 #include <dataproviders/IioEnergyMeterDataProvider.h>
 #include <dataproviders/IioEnergyMeterDataSelector.h>
+#include <fcntl.h>
 #include <inttypes.h>
+#include <unistd.h>
 #include <utils/Trace.h>
 
 namespace aidl {
@@ -32,10 +34,11 @@ namespace power {
 namespace stats {
 
 using aidl::android::hardware::power::stats::IioEnergyMeterDataSelector;
+using ::android::hardware::google::pixel::powerstats::RailEnergySampler;
 
 #define MAX_RAIL_NAME_LEN 50
-#define STR(s) #s
-#define XSTR(s) STR(s)
+// energy_value is a sysfs node, of a page at most
+#define ENERGY_VALUE_MAX_SIZE 4096
 
 void IioEnergyMeterDataProvider::findIioEnergyMeterNodes() {
     struct dirent *ent;
@@ -78,6 +81,8 @@ void IioEnergyMeterDataProvider::parseEnabledRails() {
             LOG(ERROR) << "Error reading enabled rails from " << path.first;
             continue;
         }
+        IioDevice device;
+        device.path = path.first;
 
         // Build RailInfos from list of enabled rails
         std::istringstream railNames(data);
@@ -92,8 +97,10 @@ void IioEnergyMeterDataProvider::parseEnabledRails() {
                     mChannelInfos.push_back(
                             {.id = id, .name = channelName, .subsystem = subsystemName});
                     mChannelIds.emplace(channelName, id);
+                    device.channels.emplace_back(channelName, id);
                     id++;
                 } else {
+                    device.channels.emplace_back(channelName, mChannelIds[channelName]);
                     LOG(WARNING) << "There exists rails with the same name (not supported): "
                                  << channelName << ". Only the last occurrence of rail energy will "
                                  << "be provided.";
@@ -102,12 +109,37 @@ void IioEnergyMeterDataProvider::parseEnabledRails() {
                 LOG(WARNING) << "Unexpected enabled rail format in " << path.first;
             }
         }
+
+        const std::string energyPath = path.first + kEnergyValueNode;
+        device.energyFd.reset(open(energyPath.c_str(), O_RDONLY | O_CLOEXEC));
+        if (device.energyFd < 0) {
+            PLOG(ERROR) << "Error opening " << energyPath;
+        }
+
+        if (kSamplerPeriod > std::chrono::milliseconds::zero()) {
+            device.sampler = RailEnergySampler::create(device.path, kSamplerPeriod);
+        }
+        if (device.sampler) {
+            // The samples must line up with the channels
+            const auto &railNames = device.sampler->railNames();
+            bool match = railNames.size() == device.channels.size();
+            for (size_t i = 0; match && i < railNames.size(); i++) {
+                match = railNames[i] == device.channels[i].first;
+            }
+            if (!match) {
+                LOG(WARNING) << "Rails of the buffer of " << device.path
+                             << " do not match enabled_rails";
+                device.sampler.reset();
+            }
+        }
+        mDevices.push_back(std::move(device));
     }
 }
 
 IioEnergyMeterDataProvider::IioEnergyMeterDataProvider(
-        const std::vector<const std::string> &deviceNames, const bool useSelector)
-    : kDeviceNames(std::move(deviceNames)) {
+        const std::vector<const std::string> &deviceNames, const bool useSelector,
+        std::chrono::milliseconds samplerPeriod)
+    : kDeviceNames(std::move(deviceNames)), kSamplerPeriod(samplerPeriod) {
     findIioEnergyMeterNodes();
     if (useSelector) {
         /* Run meter selection in constructor; object can be discarded afterwards */
@@ -115,89 +147,160 @@ IioEnergyMeterDataProvider::IioEnergyMeterDataProvider(
     }
     parseEnabledRails();
     mReading.resize(mChannelInfos.size());
+    mBuffer.resize(ENERGY_VALUE_MAX_SIZE);
+}
+
+// Parse the decimal number at the start of *text after any spaces, as sscanf()
+// would, and remove it from there
+static bool consumeNumber(std::string_view *text, uint64_t *value) {
+    while (!text->empty() && text->front() == ' ') {
+        text->remove_prefix(1);
+    }
+    size_t i = 0;
+    uint64_t v = 0;
+    for (; i < text->size() && isdigit((*text)[i]); i++) {
+        v = v * 10 + ((*text)[i] - '0');
+    }
+    if (i == 0) {
+        return false;
+    }
+    text->remove_prefix(i);
+    *value = v;
+    return true;
 }
 
-int IioEnergyMeterDataProvider::parseEnergyContents(const std::string &contents) {
-    std::istringstream energyData(contents);
-    std::string line;
+// Remove prefix from the start of *text, if it is there
+static bool consumePrefix(std::string_view *text, std::string_view prefix) {
+    if (text->substr(0, prefix.size()) != prefix) {
+        return false;
+    }
+    text->remove_prefix(prefix.size());
+    return true;
+}
 
-    int ret = 0;
+int IioEnergyMeterDataProvider::parseEnergyContents(std::string_view contents,
+                                                    const IioDevice &device) {
     uint64_t timestamp = 0;
     bool timestampRead = false;
 
-    while (std::getline(energyData, line)) {
-        bool parseLineSuccess = false;
+    while (!contents.empty()) {
+        const size_t eol = contents.find('\n');
+        std::string_view line = contents.substr(0, eol);
+        contents.remove_prefix(eol == std::string_view::npos ? contents.size() : eol + 1);
 
         if (timestampRead == false) {
             /* Read timestamp from boot (ms) */
-            if (sscanf(line.c_str(), "t=%" PRIu64, &timestamp) == 1) {
-                if (timestamp == 0 || timestamp == ULLONG_MAX) {
-                    LOG(ERROR) << "Potentially wrong timestamp: " << timestamp;
-                }
-                timestampRead = true;
-                parseLineSuccess = true;
+            if (!consumePrefix(&line, "t=") || !consumeNumber(&line, &timestamp)) {
+                return -1;
             }
-
-        } else {
-            /* Read rail energy */
-            uint64_t energy = 0;
-            uint64_t duration = 0;
-            char railNameRaw[MAX_RAIL_NAME_LEN + 1];
-
-            /* Format example: CH3(T=358356)[S2M_VDD_CPUCL2], 761330 */
-            if (sscanf(line.c_str(),
-                       "CH%*d(T=%" PRIu64 ")[%" XSTR(MAX_RAIL_NAME_LEN) "[^]]], %" PRIu64,
-                       &duration, railNameRaw, &energy) == 3) {
-                std::string railName(railNameRaw);
-
-                /* If the count == 0, the rail may not be enabled */
-                /* The count cannot be > 1; mChannelIds is a map */
-                if (mChannelIds.count(railName) == 1) {
-                    size_t index = mChannelIds[railName];
-                    mReading[index].id = index;
-                    mReading[index].timestampMs = timestamp;
-                    mReading[index].durationMs = duration;
-                    mReading[index].energyUWs = energy;
-                    if (mReading[index].energyUWs == ULLONG_MAX) {
-                        LOG(ERROR) << "Potentially wrong energy value on rail: " << railName;
-                    }
-                    ATRACE_INT(railNameRaw, energy);
-                }
-                parseLineSuccess = true;
+            if (timestamp == 0 || timestamp == ULLONG_MAX) {
+                LOG(ERROR) << "Potentially wrong timestamp: " << timestamp;
             }
+            timestampRead = true;
+            continue;
         }
 
-        if (parseLineSuccess == false) {
-            ret = -1;
+        /* Read rail energy */
+        /* Format example: CH3(T=358356)[S2M_VDD_CPUCL2], 761330 */
+        uint64_t channel = 0;
+        uint64_t duration = 0;
+        uint64_t energy = 0;
+        if (!consumePrefix(&line, "CH") || !consumeNumber(&line, &channel) ||
+            !consumePrefix(&line, "(T=") || !consumeNumber(&line, &duration) ||
+            !consumePrefix(&line, ")[")) {
+            return -1;
+        }
+        const size_t nameEnd = line.find(']');
+        if (nameEnd == 0 || nameEnd == std::string_view::npos || nameEnd > MAX_RAIL_NAME_LEN) {
+            return -1;
+        }
+        const std::string_view railName = line.substr(0, nameEnd);
+        line.remove_prefix(nameEnd + 1);
+        if (!consumePrefix(&line, ",") || !consumeNumber(&line, &energy)) {
+            return -1;
+        }
+
+        /* Rails which are not enabled are skipped */
+        for (const auto &[name, index] : device.channels) {
+            if (name != railName) {
+                continue;
+            }
+            mReading[index].id = index;
+            mReading[index].timestampMs = timestamp;
+            mReading[index].durationMs = duration;
+            mReading[index].energyUWs = energy;
+            if (mReading[index].energyUWs == ULLONG_MAX) {
+                LOG(ERROR) << "Potentially wrong energy value on rail: " << name;
+            }
+            ATRACE_INT(name.c_str(), energy);
             break;
         }
     }
 
-    return ret;
+    return 0;
 }
 
-int IioEnergyMeterDataProvider::parseEnergyValue(std::string path) {
-    int ret = 0;
-    std::string data;
-    if (!::android::base::ReadFileToString(path + kEnergyValueNode, &data)) {
-        LOG(ERROR) << "Error reading energy value in " << path;
+int IioEnergyMeterDataProvider::parseEnergyValue(const IioDevice &device) {
+    ssize_t size = -1;
+    if (device.energyFd >= 0) {
+        size = TEMP_FAILURE_RETRY(pread(device.energyFd, mBuffer.data(), mBuffer.size(), 0));
+    }
+    if (size < 0) {
+        PLOG(ERROR) << "Error reading energy value in " << device.path;
         return -1;
     }
 
-    ret = parseEnergyContents(data);
+    int ret = parseEnergyContents(std::string_view(mBuffer.data(), size), device);
     if (ret != 0) {
-        LOG(ERROR) << "Unexpected format in " << path;
+        LOG(ERROR) << "Unexpected format in " << device.path;
     }
     return ret;
 }
 
+bool IioEnergyMeterDataProvider::readSampledEnergy(IioDevice *device) {
+    if (!device->sampler || !device->sampler->readLatest(&device->samples)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < device->channels.size(); i++) {
+        const auto &[name, index] = device->channels[i];
+        const auto &sample = device->samples[i];
+        mReading[index].id = index;
+        mReading[index].timestampMs = sample.timestampMs;
+        mReading[index].durationMs = sample.durationMs;
+        mReading[index].energyUWs = sample.energyUWs;
+        ATRACE_INT(name.c_str(), sample.energyUWs);
+    }
+    return true;
+}
+
 ndk::ScopedAStatus IioEnergyMeterDataProvider::readEnergyMeter(
         const std::vector<int32_t> &in_channelIds, std::vector<EnergyMeasurement> *_aidl_return) {
     std::scoped_lock lock(mLock);
 
-    for (const auto &devicePath : mDevicePaths) {
-        if (parseEnergyValue(devicePath.first) < 0) {
-            LOG(ERROR) << "Error in parsing " << devicePath.first;
+    // Only read the devices which own a channel asked for
+    for (auto &device : mDevices) {
+        device.selected = in_channelIds.empty();
+    }
+    for (const auto &id : in_channelIds) {
+        // check for invalid ids
+        if (id < 0 || id >= mChannelInfos.size()) {
+            return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_ILLEGAL_ARGUMENT));
+        }
+        for (auto &device : mDevices) {
+            for (const auto &channel : device.channels) {
+                device.selected |= channel.second == id;
+            }
+        }
+    }
+
+    for (auto &device : mDevices) {
+        // Fall back to energy_value until the buffer has a sample
+        if (!device.selected || readSampledEnergy(&device)) {
+            continue;
+        }
+        if (parseEnergyValue(device) < 0) {
+            LOG(ERROR) << "Error in parsing " << device.path;
             return ndk::ScopedAStatus::ok();
         }
     }
@@ -207,11 +310,6 @@ ndk::ScopedAStatus IioEnergyMeterDataProvider::readEnergyMeter(
     } else {
         _aidl_return->reserve(in_channelIds.size());
         for (const auto &id : in_channelIds) {
-            // check for invalid ids
-            if (id < 0 || id >= mChannelInfos.size()) {
-                return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_ILLEGAL_ARGUMENT));
-            }
-
             _aidl_return->emplace_back(mReading[id]);
         }
     }
@@ -19,6 +19,11 @@
 #include <android-base/logging.h>
 #include <android-base/stringprintf.h>
 #include <android/binder_status.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+#include <algorithm>
+#include <sstream>
 
 namespace aidl {
 namespace android {
@@ -29,6 +34,17 @@ namespace stats {
 PixelStateResidencyDataProvider::PixelStateResidencyDataProvider()
     : mProviderService(ndk::SharedRefBase::make<ProviderService>(this)) {}
 
+PixelStateResidencyDataProvider::~PixelStateResidencyDataProvider() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mCallbackThreadsExit = true;
+    }
+    mCallbackQueueCond.notify_all();
+    for (auto &thread : mCallbackThreads) {
+        thread.join();
+    }
+}
+
 void PixelStateResidencyDataProvider::addEntity(std::string name, std::vector<State> states) {
     std::lock_guard<std::mutex> lock(mLock);
 
@@ -43,52 +59,115 @@ void PixelStateResidencyDataProvider::start() {
     }
 }
 
-::ndk::ScopedAStatus PixelStateResidencyDataProvider::getStateResidenciesTimed(
-        const Entry &entry, std::vector<StateResidency> *residency) {
-    const uint64_t MAX_LATENCY_US = 2000;
+void PixelStateResidencyDataProvider::setCallbackTimeout(std::chrono::milliseconds timeout) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mCallbackTimeout = timeout;
+}
 
-    if (!entry.mCallback) {
-        LOG(ERROR) << "callback for " << entry.mName << " is not registered";
-        return ndk::ScopedAStatus::fromStatus(STATUS_UNEXPECTED_NULL);
+void PixelStateResidencyDataProvider::startCallbackThreadsLocked() {
+    if (!mCallbackThreads.empty()) {
+        return;
     }
+    const size_t numThreads = std::min(kMaxCallbackThreads, mEntries.size());
+    for (size_t i = 0; i < numThreads; i++) {
+        mCallbackThreads.emplace_back(&PixelStateResidencyDataProvider::callbackThreadLoop, this);
+        pthread_setname_np(mCallbackThreads.back().native_handle(), "powerstats_cb");
+    }
+}
 
-    struct timespec then;
-    struct timespec now;
+void PixelStateResidencyDataProvider::callbackThreadLoop() {
+    const auto kMaxLatency = std::chrono::microseconds(2000);
 
-    clock_gettime(CLOCK_BOOTTIME, &then);
-    ::ndk::ScopedAStatus status = entry.mCallback->getStateResidency(residency);
-    clock_gettime(CLOCK_BOOTTIME, &now);
+    std::unique_lock<std::mutex> lock(mLock);
+    while (true) {
+        mCallbackQueueCond.wait(
+                lock, [this] { return mCallbackThreadsExit || !mCallbackQueue.empty(); });
+        if (mCallbackThreadsExit) {
+            return;
+        }
+        const size_t index = mCallbackQueue.front();
+        mCallbackQueue.pop_front();
+        const std::string name = mEntries[index].mName;
+        const std::shared_ptr<IPixelStateResidencyCallback> callback = mEntries[index].mCallback;
 
-    uint64_t timeElapsedUs =
-            ((now.tv_sec - then.tv_sec) * 1000000) + ((now.tv_nsec - then.tv_nsec) / 1000);
-    if (timeElapsedUs > MAX_LATENCY_US) {
-        LOG(WARNING) << "getStateResidency latency for " << entry.mName
-                     << " exceeded time allowed: " << timeElapsedUs << "us";
+        // Call without the lock, so that getStateResidencies() can time out and the
+        // other callbacks be called meanwhile. A late result serves the calls after it.
+        std::vector<StateResidency> residency;
+        lock.unlock();
+        const auto then = ::android::base::boot_clock::now();
+        ::ndk::ScopedAStatus status = callback->getStateResidency(&residency);
+        const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                ::android::base::boot_clock::now() - then);
+        lock.lock();
+
+        if (latency > kMaxLatency) {
+            LOG(WARNING) << "getStateResidency latency for " << name
+                         << " exceeded time allowed: " << latency.count() << "us";
+        }
+        Entry &entry = mEntries[index];
+        entry.mCalling = false;
+        entry.mCalls++;
+        entry.mLastLatency = latency;
+        entry.mMaxLatency = std::max(entry.mMaxLatency, latency);
+        if (entry.mCallback != callback) {
+            // Unregistered or replaced during the call, its result is of no use
+        } else if (status.isOk()) {
+            entry.mResidency = std::move(residency);
+        } else {
+            LOG(ERROR) << "getStateResidency for " << name << " failed";
+            entry.mFailures++;
+            entry.mResidency.clear();
+            if (status.getStatus() == STATUS_DEAD_OBJECT) {
+                LOG(ERROR) << "Unregistering dead callback for " << name;
+                entry.mCallback = nullptr;
+            }
+        }
+        mCallbackDoneCond.notify_all();
     }
-
-    return status;
 }
 
 bool PixelStateResidencyDataProvider::getStateResidencies(
         std::unordered_map<std::string, std::vector<StateResidency>> *residencies) {
-    std::lock_guard<std::mutex> lock(mLock);
+    std::unique_lock<std::mutex> lock(mLock);
+
+    // Hand every registered callback to the callback threads, unless one is still
+    // being called, in which case this waits on that same call
+    bool queued = false;
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        Entry &entry = mEntries[i];
+        if (!entry.mCallback) {
+            LOG(ERROR) << "callback for " << entry.mName << " is not registered";
+            continue;
+        }
+        if (!entry.mCalling) {
+            entry.mCalling = true;
+            mCallbackQueue.push_back(i);
+            queued = true;
+        }
+    }
+    if (queued) {
+        startCallbackThreadsLocked();
+        mCallbackQueueCond.notify_all();
+    }
+    const auto deadline = ::android::base::boot_clock::now() + mCallbackTimeout;
+    mCallbackDoneCond.wait_until(lock, deadline, [this] {
+        return std::none_of(mEntries.begin(), mEntries.end(),
+                            [](const Entry &entry) { return entry.mCalling; });
+    });
 
     size_t numResultsFound = 0;
     size_t numResults = mEntries.size();
     for (auto &entry : mEntries) {
-        std::vector<StateResidency> residency;
-        ::ndk::ScopedAStatus status = getStateResidenciesTimed(entry, &residency);
-
-        if (!status.isOk()) {
-            LOG(ERROR) << "getStateResidency for " << entry.mName << " failed";
-
-            if (status.getStatus() == STATUS_DEAD_OBJECT) {
-                LOG(ERROR) << "Unregistering dead callback for " << entry.mName;
-                entry.mCallback = nullptr;
-            }
+        if (!entry.mCallback) {
+            continue;
+        }
+        if (entry.mCalling) {
+            LOG(WARNING) << "getStateResidency for " << entry.mName << " missed the "
+                         << mCallbackTimeout.count() << " ms deadline, using its last result";
+            entry.mStaleResults++;
         }
-        if (!residency.empty()) {
-            residencies->emplace(entry.mName, residency);
+        if (!entry.mResidency.empty()) {
+            residencies->emplace(entry.mName, entry.mResidency);
             numResultsFound++;
         }
     }
@@ -107,6 +186,24 @@ std::unordered_map<std::string, std::vector<State>> PixelStateResidencyDataProvi
     return ret;
 }
 
+void PixelStateResidencyDataProvider::dump(std::ostringstream &oss) {
+    std::lock_guard<std::mutex> lock(mLock);
+
+    oss << "\n============= PowerStats HAL 2.0 state residency callbacks ==============\n";
+    oss << "Timeout: " << mCallbackTimeout.count() << " ms\n";
+    for (const auto &entry : mEntries) {
+        oss << ::android::base::StringPrintf(
+                "  %s: %s, %" PRId64 " calls, %" PRId64 " failed, %" PRId64
+                " stale, last %" PRId64 " us, max %" PRId64 " us\n",
+                entry.mName.c_str(),
+                !entry.mCallback ? "unregistered" : (entry.mCalling ? "calling" : "idle"),
+                entry.mCalls, entry.mFailures, entry.mStaleResults,
+                static_cast<int64_t>(entry.mLastLatency.count()),
+                static_cast<int64_t>(entry.mMaxLatency.count()));
+    }
+    oss << "========== End of PowerStats HAL 2.0 state residency callbacks ==========\n";
+}
+
 void PixelStateResidencyDataProvider::registerStatesUpdateCallback(
         std::function<void(const std::string &, const std::vector<State> &in_states)>
                 statesUpdateCallback) {
@@ -169,6 +266,7 @@ void PixelStateResidencyDataProvider::registerStatesUpdateCallback(
     }
 
     toRemove->mCallback = nullptr;
+    toRemove->mResidency.clear();
 
     return ::ndk::ScopedAStatus::ok();
 }
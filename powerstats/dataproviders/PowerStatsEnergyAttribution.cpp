@@ -17,9 +17,14 @@
 #include <dataproviders/PowerStatsEnergyAttribution.h>
 
 #include <android-base/logging.h>
-#include <android-base/parseint.h>
 #include <android-base/strings.h>
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
 #include <utility>
 
 using android::base::Split;
@@ -31,61 +36,160 @@ namespace hardware {
 namespace power {
 namespace stats {
 
-bool PowerStatsEnergyAttribution::readUidTimeInState(AttributionStats *attrStats,
-                                                     std::string path) {
-    std::unique_ptr<FILE, decltype(&fclose)> fp(fopen(path.c_str(), "r"), fclose);
-    if (!fp) {
-        PLOG(ERROR) <<  __func__ << ":Failed to open file " << path;
+namespace {
+
+constexpr size_t kInitialBufferSize = 16384;
+
+// Moves contents past its first line, which it returns without the newline
+std::string_view nextLine(std::string_view *contents) {
+    const char *end =
+            static_cast<const char *>(memchr(contents->data(), '\n', contents->size()));
+    const size_t length = end ? end - contents->data() : contents->size();
+    std::string_view line = contents->substr(0, length);
+    contents->remove_prefix(end ? length + 1 : length);
+    return line;
+}
+
+// Moves line past the number at its start, after any spaces
+template <class T>
+bool consumeNumber(std::string_view *line, T *value) {
+    const size_t start = line->find_first_not_of(" \t\r");
+    if (start == std::string_view::npos) {
+        return false;
+    }
+    line->remove_prefix(start);
+    auto [end, ec] = std::from_chars(line->data(), line->data() + line->size(), *value);
+    if (ec != std::errc()) {
         return false;
     }
+    line->remove_prefix(end - line->data());
+    return true;
+}
 
-    char *buf = nullptr;
-    size_t size = 0;
-    getline(&buf, &size, fp.get());
-    attrStats->uidTimeInStateNames = Split(Trim(buf), " ");
-    // first element will be "uid:" and it's useless
-    attrStats->uidTimeInStateNames.erase(attrStats->uidTimeInStateNames.begin());
+}  // namespace
 
-    while (getline(&buf, &size, fp.get()) != -1) {
-        std::vector<std::string> uidInfos = Split(Trim(buf), " ");
-        uidInfos[0].pop_back();
-        int32_t uid;
-        if (!::android::base::ParseInt(uidInfos[0], &uid)) {
-            PLOG(ERROR) << __func__ << "Failed to parse uid from " << path;
-            free(buf);
+bool PowerStatsEnergyAttribution::readFile() {
+    if (!mFd.ok()) {
+        mFd.reset(TEMP_FAILURE_RETRY(open(mPath.c_str(), O_RDONLY | O_CLOEXEC)));
+        if (!mFd.ok()) {
+            PLOG(ERROR) << __func__ << ":Failed to open file " << mPath;
             return false;
         }
+    }
 
-        std::vector<long> uidStats;
-        // first element will be uid number so skipping it
-        for (auto it = ++uidInfos.begin(); it != uidInfos.end(); ++it) {
-            long uidStat;
-            if (!::android::base::ParseInt(*it, &uidStat)) {
-                PLOG(ERROR) << __func__ << "Failed to parse uidStat from " << path;
-                free(buf);
-                return false;
-            }
-            uidStats.push_back(uidStat);
+    size_t size = 0;
+    while (true) {
+        if (size == mBuffer.size()) {
+            mBuffer.resize(std::max(kInitialBufferSize, mBuffer.size() * 2));
+        }
+        const ssize_t n = TEMP_FAILURE_RETRY(
+                pread(mFd.get(), mBuffer.data() + size, mBuffer.size() - size, size));
+        if (n < 0) {
+            PLOG(ERROR) << __func__ << ":Failed to read file " << mPath;
+            mFd.reset();
+            return false;
+        }
+        if (n == 0) {
+            break;
         }
-        attrStats->uidTimeInStats.emplace(uid, uidStats);
+        size += n;
     }
 
-    free(buf);
+    mContents = std::string_view(mBuffer.data(), size);
     return true;
 }
 
-AttributionStats PowerStatsEnergyAttribution::getAttributionStats(
-                                                                  std::unordered_map<int32_t,
-                                                                  std::string> paths) {
-    AttributionStats attrStats;
+bool PowerStatsEnergyAttribution::setPaths(const std::unordered_map<int32_t, std::string> &paths) {
+    if (!paths.count(UID_TIME_IN_STATE)) {
+        return true;
+    }
 
-    if (paths.count(UID_TIME_IN_STATE) &&
-        !readUidTimeInState(&attrStats, paths.at(UID_TIME_IN_STATE))) {
-            PLOG(ERROR) << ":Failed to read uid_time_in_state";
-            return {};
+    mPath = paths.at(UID_TIME_IN_STATE);
+    mFd.reset();
+    mStateNames.clear();
+    mUidRows.clear();
+    mTimes.clear();
+    if (!readFile()) {
+        PLOG(ERROR) << ":Failed to read uid_time_in_state";
+        return false;
     }
 
-    return attrStats;
+    mStateNames = Split(Trim(std::string(nextLine(&mContents))), " ");
+    // first element will be "uid:" and it's useless
+    mStateNames.erase(mStateNames.begin());
+    return !mStateNames.empty();
+}
+
+bool PowerStatsEnergyAttribution::readUidEnergies(
+        const std::vector<int64_t> &coefficients,
+        std::vector<std::pair<int32_t, int64_t>> *uidEnergies) {
+    if (mStateNames.empty() || !readFile()) {
+        return false;
+    }
+
+    const size_t numStates = mStateNames.size();
+    mChanged.clear();
+    mChangedTimes.clear();
+
+    // Skip the state names
+    nextLine(&mContents);
+    while (!mContents.empty()) {
+        std::string_view line = nextLine(&mContents);
+        if (line.find_first_not_of(" \t\r") == std::string_view::npos) {
+            continue;
+        }
+
+        int32_t uid;
+        if (!consumeNumber(&line, &uid) || line.empty() || line.front() != ':') {
+            LOG(ERROR) << __func__ << "Failed to parse uid from " << mPath;
+            return false;
+        }
+        line.remove_prefix(1);
+
+        // The times of the last read, if it had the uid
+        auto row = mUidRows.find(uid);
+        const int64_t *last = row != mUidRows.end() ? &mTimes[row->second * numStates] : nullptr;
+
+        const size_t offset = mChangedTimes.size();
+        mChangedTimes.resize(offset + numStates);
+        int64_t *times = &mChangedTimes[offset];
+        int64_t energy = 0;
+        bool changed = false;
+        for (size_t i = 0; i < numStates; i++) {
+            const int64_t lastTime = last ? last[i] : 0;
+            if (!consumeNumber(&line, &times[i])) {
+                if (line.find_first_not_of(" \t\r") != std::string_view::npos) {
+                    LOG(ERROR) << __func__ << "Failed to parse uidStat from " << mPath;
+                    return false;
+                }
+                // A short row keeps the times it leaves out
+                times[i] = lastTime;
+            }
+            if (times[i] != lastTime) {
+                changed = true;
+                energy += coefficients[i] * (times[i] - lastTime);
+            }
+        }
+
+        if (changed) {
+            mChanged.emplace_back(uid, energy);
+        } else {
+            mChangedTimes.resize(offset);
+        }
+    }
+
+    // The whole file parsed, keep its times for the next read
+    for (size_t i = 0; i < mChanged.size(); i++) {
+        const int32_t uid = mChanged[i].first;
+        auto [row, inserted] = mUidRows.emplace(uid, mUidRows.size());
+        if (inserted) {
+            mTimes.resize(mTimes.size() + numStates);
+        }
+        std::copy_n(&mChangedTimes[i * numStates], numStates, &mTimes[row->second * numStates]);
+        uidEnergies->emplace_back(mChanged[i]);
+    }
+
+    return true;
 }
 
 }  // namespace stats
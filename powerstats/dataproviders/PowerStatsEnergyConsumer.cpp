@@ -109,20 +109,24 @@ bool PowerStatsEnergyConsumer::addPowerEntity(std::string powerEntityName,
         }
     }
 
+    for (const auto &[stateId, coefficient] : mCoefficients) {
+        if (stateId >= mStateCoefficients.size()) {
+            mStateCoefficients.resize(stateId + 1, 0);
+        }
+        mStateCoefficients[stateId] = coefficient;
+    }
+
     return (mCoefficients.size() == stateCoeffs.size());
 }
 
 bool PowerStatsEnergyConsumer::addAttribution(std::unordered_map<int32_t, std::string> paths,
                                               std::map<std::string, int32_t> stateCoeffs) {
-    mAttrInfoPath = paths;
-
     if (paths.count(UID_TIME_IN_STATE)) {
-        mEnergyAttribution = PowerStatsEnergyAttribution();
-        AttributionStats attrStats = mEnergyAttribution.getAttributionStats(paths);
-        if (attrStats.uidTimeInStateNames.empty()) {
+        if (!mEnergyAttribution.setPaths(paths)) {
             LOG(ERROR) << "Failed to read uid_time_in_state";
             return false;
         }
+        const std::vector<std::string> &stateNames = mEnergyAttribution.getStateNames();
 
         // stateCoeffs should not blocking energy consumer to return power meter
         // so just handle this in getEnergyConsumed()
@@ -131,11 +135,13 @@ bool PowerStatsEnergyConsumer::addAttribution(std::unordered_map<int32_t, std::s
         }
 
         int32_t stateId = 0;
-        for (const auto &stateName : attrStats.uidTimeInStateNames) {
+        mAttrCoefficients.assign(stateNames.size(), 0);
+        for (const auto &stateName : stateNames) {
             if (stateCoeffs.count(stateName)) {
                 // When uid_time_in_state is not the only type of attribution,
                 // should condider to separate the coefficients just for attribution.
                 mCoefficients.emplace(stateId, stateCoeffs.at(stateName));
+                mAttrCoefficients[stateId] = stateCoeffs.at(stateName);
             }
             stateId++;
         }
@@ -164,29 +170,14 @@ std::optional<EnergyConsumerResult> PowerStatsEnergyConsumer::getEnergyConsumed(
     std::vector<EnergyConsumerAttribution> attribution;
     if (!mCoefficients.empty()) {
         if (mWithAttribution) {
-            AttributionStats attrStats = mEnergyAttribution.getAttributionStats(mAttrInfoPath);
-            if (attrStats.uidTimeInStats.empty() || attrStats.uidTimeInStateNames.empty()) {
+            // Only the uids whose time in state changed get more energy
+            mUidEnergies.clear();
+            if (!mEnergyAttribution.readUidEnergies(mAttrCoefficients, &mUidEnergies)) {
                 LOG(ERROR) << "Failed to read uid_time_in_state for attribution, return default EnergyConsumer";
             } else {
                 int64_t totalRelativeEnergyUWs = 0;
-                for (const auto &uidTimeInStat : attrStats.uidTimeInStats) {
-                    int64_t uidEnergyUWs = 0;
-                    for (int id = 0; id < uidTimeInStat.second.size(); id++) {
-                        if (mCoefficients.count(id)) {
-                            int64_t d_time_in_state = uidTimeInStat.second.at(id);
-                            if (mUidTimeInStateSS.count(uidTimeInStat.first)) {
-                                d_time_in_state -= mUidTimeInStateSS.at(uidTimeInStat.first).at(id);
-                            }
-                            uidEnergyUWs += mCoefficients.at(id) * d_time_in_state;
-                        }
-                    }
+                for (const auto &[uid, uidEnergyUWs] : mUidEnergies) {
                     totalRelativeEnergyUWs += uidEnergyUWs;
-
-                    EnergyConsumerAttribution attr = {
-                        .uid = uidTimeInStat.first,
-                        .energyUWs = uidEnergyUWs,
-                    };
-                    attribution.emplace_back(attr);
                 }
 
                 int64_t d_totalEnergyUWs = totalEnergyUWs - mTotalEnergySS;
@@ -194,21 +185,27 @@ std::optional<EnergyConsumerResult> PowerStatsEnergyConsumer::getEnergyConsumed(
                 if (totalRelativeEnergyUWs != 0) {
                     powerScale = static_cast<float>(d_totalEnergyUWs) / totalRelativeEnergyUWs;
                 }
-                for (auto &attr : attribution) {
-                    attr.energyUWs = (int64_t)(attr.energyUWs * powerScale) +
-                                     (mUidEnergySS.count(attr.uid) ? mUidEnergySS.at(attr.uid) : 0);
-                    mUidEnergySS[attr.uid] = attr.energyUWs;
+                for (const auto &[uid, uidEnergyUWs] : mUidEnergies) {
+                    mUidEnergySS[uid] += (int64_t)(uidEnergyUWs * powerScale);
                 }
-
-                mUidTimeInStateSS = attrStats.uidTimeInStats;
                 mTotalEnergySS = totalEnergyUWs;
+
+                attribution.reserve(mUidEnergySS.size());
+                for (const auto &[uid, uidEnergyUWs] : mUidEnergySS) {
+                    EnergyConsumerAttribution attr = {
+                        .uid = uid,
+                        .energyUWs = uidEnergyUWs,
+                    };
+                    attribution.emplace_back(attr);
+                }
             }
         } else {
             std::vector<StateResidencyResult> results;
-            if (mPowerStats->getStateResidency({mPowerEntityId}, &results).isOk()) {
+            if (mPowerStats->getStateResidency({mPowerEntityId}, &results).isOk() &&
+                !results.empty()) {
                 for (const auto &s : results[0].stateResidencyData) {
-                    if (mCoefficients.count(s.id)) {
-                        totalEnergyUWs += mCoefficients.at(s.id) * s.totalTimeInStateMs;
+                    if (s.id >= 0 && s.id < mStateCoefficients.size()) {
+                        totalEnergyUWs += mStateCoefficients[s.id] * s.totalTimeInStateMs;
                     }
                 }
             } else {
@@ -227,6 +224,13 @@ std::string PowerStatsEnergyConsumer::getConsumerName() {
     return kName;
 }
 
+std::vector<int32_t> PowerStatsEnergyConsumer::getPowerEntityIds() {
+    if (mCoefficients.empty() || mWithAttribution) {
+        return {};
+    }
+    return {mPowerEntityId};
+}
+
 }  // namespace stats
 }  // namespace power
 }  // namespace hardware
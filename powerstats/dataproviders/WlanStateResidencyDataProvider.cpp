@@ -19,6 +19,11 @@
 #include <android-base/strings.h>
 
 #include <dataproviders/WlanStateResidencyDataProvider.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
 
 namespace aidl {
 namespace android {
@@ -31,22 +36,62 @@ enum {
     DEEPSLEEP_ID = 1,
 };
 
-static bool extractStat(const char *line, const std::string &prefix, uint64_t *stat) {
-    char const *prefixStart = strstr(line, prefix.c_str());
+// Large enough for the stats file, a longer one grows the buffer
+static constexpr size_t kInitialBufferSize = 1024;
+
+static bool extractStat(const char *contents, const char *prefix, uint64_t *stat) {
+    char const *prefixStart = strstr(contents, prefix);
     if (prefixStart == nullptr) {
         // Did not find the given prefix
         return false;
     }
 
-    *stat = strtoull(prefixStart + prefix.length(), nullptr, 0);
+    *stat = strtoull(prefixStart + strlen(prefix), nullptr, 0);
+    return true;
+}
+
+bool WlanStateResidencyDataProvider::readStats() {
+    if (!mFd.ok()) {
+        mFd.reset(TEMP_FAILURE_RETRY(open(mPath.c_str(), O_RDONLY | O_CLOEXEC)));
+        if (!mFd.ok()) {
+            PLOG(ERROR) << ":Failed to open file " << mPath;
+            return false;
+        }
+    }
+
+    size_t size = 0;
+    while (true) {
+        if (size + 1 >= mBuffer.size()) {
+            mBuffer.resize(std::max(kInitialBufferSize, mBuffer.size() * 2));
+        }
+        const ssize_t n = TEMP_FAILURE_RETRY(
+                pread(mFd.get(), mBuffer.data() + size, mBuffer.size() - size - 1, size));
+        if (n < 0) {
+            PLOG(ERROR) << ":Failed to read file " << mPath;
+            // Open it again on the next query
+            mFd.reset();
+            return false;
+        }
+        if (n == 0) {
+            break;
+        }
+        size += n;
+    }
+    mBuffer[size] = '\0';
     return true;
 }
 
 bool WlanStateResidencyDataProvider::getStateResidencies(
         std::unordered_map<std::string, std::vector<StateResidency>> *residencies) {
     std::vector<StateResidency> result = {{.id = ACTIVE_ID}, {.id = DEEPSLEEP_ID}};
+    std::scoped_lock lock(mLock);
 
     std::string wlanDriverStatus = ::android::base::GetProperty("wlan.driver.status", "unloaded");
+    if (wlanDriverStatus != mDriverStatus) {
+        // A reloaded driver makes a new stats file
+        mFd.reset();
+        mDriverStatus = wlanDriverStatus;
+    }
     if (wlanDriverStatus != "ok") {
         LOG(ERROR) << ": wlan is " << wlanDriverStatus;
         // Return 0s for Wlan stats, because the driver is unloaded
@@ -54,43 +99,28 @@ bool WlanStateResidencyDataProvider::getStateResidencies(
         return true;
     }
 
-    // Using FILE* instead of std::ifstream for performance reasons (b/122253123)
-    std::unique_ptr<FILE, decltype(&fclose)> fp(fopen(mPath.c_str(), "r"), fclose);
-    if (!fp) {
-        PLOG(ERROR) << ":Failed to open file " << mPath;
+    if (!readStats()) {
         return false;
     }
-    size_t numFieldsRead = 0;
-    const size_t numFields = 4;
-    size_t len = 0;
-    char *line = nullptr;
-
-    while ((numFieldsRead < numFields) && (getline(&line, &len, fp.get()) != -1)) {
-        uint64_t stat = 0;
-        if (extractStat(line, "cumulative_sleep_time_ms:", &stat)) {
-            result[1].totalTimeInStateMs = stat;
-            ++numFieldsRead;
-        } else if (extractStat(line, "cumulative_total_on_time_ms:", &stat)) {
-            result[0].totalTimeInStateMs = stat;
-            ++numFieldsRead;
-        } else if (extractStat(line, "deep_sleep_enter_counter:", &stat)) {
-            result[0].totalStateEntryCount = stat;
-            result[1].totalStateEntryCount = stat;
-            ++numFieldsRead;
-        } else if (extractStat(line, "last_deep_sleep_enter_tstamp_ms:", &stat)) {
-            result[1].lastEntryTimestampMs = stat;
-            ++numFieldsRead;
-        }
-    }
-
-    free(line);
 
-    // End of file was reached and not all state data was parsed. Something
-    // went wrong
-    if (numFieldsRead != numFields) {
+    const char *contents = mBuffer.data();
+    uint64_t sleepTime = 0;
+    uint64_t onTime = 0;
+    uint64_t deepSleepEnterCount = 0;
+    uint64_t lastDeepSleepEnter = 0;
+    if (!extractStat(contents, "cumulative_sleep_time_ms:", &sleepTime) ||
+        !extractStat(contents, "cumulative_total_on_time_ms:", &onTime) ||
+        !extractStat(contents, "deep_sleep_enter_counter:", &deepSleepEnterCount) ||
+        !extractStat(contents, "last_deep_sleep_enter_tstamp_ms:", &lastDeepSleepEnter)) {
+        // Not all state data was parsed. Something went wrong
         LOG(ERROR) << __func__ << ": failed to parse stats for wlan";
         return false;
     }
+    result[0].totalTimeInStateMs = onTime;
+    result[0].totalStateEntryCount = deepSleepEnterCount;
+    result[1].totalTimeInStateMs = sleepTime;
+    result[1].totalStateEntryCount = deepSleepEnterCount;
+    result[1].lastEntryTimestampMs = lastDeepSleepEnter;
 
     residencies->emplace(mName, result);
 
@@ -18,7 +18,15 @@
 
 #include <aidl/android/hardware/power/stats/BnPowerStats.h>
 
+#include <android-base/chrono_utils.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <optional>
+#include <sstream>
+#include <thread>
 #include <unordered_map>
 
 namespace aidl {
@@ -37,6 +45,8 @@ class PowerStats : public BnPowerStats {
         virtual std::unordered_map<std::string, std::vector<State>> getInfo() = 0;
         virtual void registerStatesUpdateCallback(
                 __unused std::function<void(const std::string &, const std::vector<State> &)>) {}
+        // Add provider specific debug output to the HAL dump
+        virtual void dump(__unused std::ostringstream &oss) {}
     };
 
     class IEnergyConsumer {
@@ -45,6 +55,10 @@ class PowerStats : public BnPowerStats {
         virtual std::pair<EnergyConsumerType, std::string> getInfo() = 0;
         virtual std::optional<EnergyConsumerResult> getEnergyConsumed() = 0;
         virtual std::string getConsumerName() = 0;
+        // The power entities and energy meter channels getEnergyConsumed() reads through
+        // PowerStats, which reads them ahead for all the consumers of a call at once
+        virtual std::vector<int32_t> getPowerEntityIds() { return {}; }
+        virtual std::vector<int32_t> getChannelIds() { return {}; }
     };
 
     class IEnergyMeterDataProvider {
@@ -56,10 +70,29 @@ class PowerStats : public BnPowerStats {
         virtual ndk::ScopedAStatus getEnergyMeterInfo(std::vector<Channel> *_aidl_return) = 0;
     };
 
+    // The provider reads of one top-level call, and the entities and channels it
+    // served from a snapshot instead
+    struct ReadCounters {
+        int64_t stateResidencyReads = 0;
+        int64_t energyMeterReads = 0;
+        int64_t snapshotHits = 0;
+        // Providers whose read outlasted the state residency read timeout
+        int64_t stateResidencyTimeouts = 0;
+    };
+
     PowerStats() = default;
+    ~PowerStats();
     void addStateResidencyDataProvider(std::unique_ptr<IStateResidencyDataProvider> p);
     void addEnergyConsumer(std::unique_ptr<IEnergyConsumer> p);
     void setEnergyMeterDataProvider(std::unique_ptr<IEnergyMeterDataProvider> p);
+    // How old a provider reading may be and still serve a later call. At 0, the
+    // default, a reading is only shared within the top-level call that made it.
+    void setMaxSnapshotStaleness(std::chrono::milliseconds staleness);
+    // How long getStateResidency() waits for the providers it reads, which it
+    // reads in parallel. It leaves out the entities of those that take longer.
+    void setStateResidencyReadTimeout(std::chrono::milliseconds timeout);
+    // The counters of the last top-level call that returned on this thread
+    ReadCounters getLastReadCounters() const;
 
     // Methods from aidl::android::hardware::power::stats::IPowerStats
     ndk::ScopedAStatus getPowerEntityInfo(std::vector<PowerEntity> *_aidl_return) override;
@@ -74,6 +107,49 @@ class PowerStats : public BnPowerStats {
     binder_status_t dump(int fd, const char **args, uint32_t numArgs) override;
 
   private:
+    /*
+     * Each top-level call opens an epoch on its thread, which the calls it
+     * makes, such as those of the energy consumers back into this class, join.
+     * Within an epoch each provider is read at most once.
+     */
+    class SnapshotEpoch {
+      public:
+        explicit SnapshotEpoch(PowerStats *powerStats);
+        ~SnapshotEpoch();
+
+      private:
+        PowerStats *mPowerStats;
+    };
+
+    // When and in which epoch a reading was made, epoch 0 if never
+    struct Snapshot {
+        uint64_t epoch = 0;
+        ::android::base::boot_clock::time_point time;
+    };
+
+    struct StateResidencySnapshot {
+        Snapshot snapshot;
+        std::unordered_map<std::string, std::vector<StateResidency>> residencies;
+        // Whether a read thread is reading the provider
+        bool reading = false;
+    };
+
+    // A state residency provider read, stamped as the call that asked for it
+    struct ReadRequest {
+        size_t index;
+        uint64_t epoch;
+        ::android::base::boot_clock::time_point time;
+    };
+
+    struct EnergyMeterSnapshot {
+        Snapshot snapshot;
+        EnergyMeasurement measurement;
+    };
+
+    bool isFresh(const Snapshot &snapshot, ::android::base::boot_clock::time_point now) const;
+    void dumpSnapshot(std::ostringstream &oss);
+    void startReadThreadsLocked();
+    void readThreadLoop();
     void statesUpdate(const std::string &entityName, const std::vector<State> &states);
 
     void getEntityStateNames(
@@ -95,8 +171,31 @@ class PowerStats : public BnPowerStats {
 
     std::vector<std::unique_ptr<IEnergyConsumer>> mEnergyConsumers;
     std::vector<EnergyConsumer> mEnergyConsumerInfos;
+    // By index of mEnergyConsumers, what each reads, from its getPowerEntityIds() and
+    // getChannelIds() at registration
+    std::vector<std::vector<int32_t>> mEnergyConsumerPowerEntityIds;
+    std::vector<std::vector<int32_t>> mEnergyConsumerChannelIds;
 
     std::unique_ptr<IEnergyMeterDataProvider> mEnergyMeterDataProvider;
+    std::vector<int32_t> mChannelIds;
+
+    std::mutex mSnapshotLock;
+    // By index of mStateResidencyDataProviders, guarded by mSnapshotLock
+    std::vector<StateResidencySnapshot> mStateResidencySnapshots;
+    // By channel id, one for each channel. Guarded by mSnapshotLock.
+    std::unordered_map<int32_t, EnergyMeterSnapshot> mEnergyMeterSnapshots;
+    // The sum over all top-level calls, guarded by mSnapshotLock
+    ReadCounters mTotalReadCounters;
+    std::chrono::milliseconds mMaxSnapshotStaleness{0};
+
+    static constexpr size_t kMaxReadThreads = 4;
+    // Started on the first state residency read. The rest is guarded by mSnapshotLock.
+    std::vector<std::thread> mReadThreads;
+    std::deque<ReadRequest> mReadQueue;
+    std::condition_variable mReadQueueCond;
+    std::condition_variable mReadDoneCond;
+    bool mReadThreadsExit = false;
+    std::chrono::milliseconds mStateResidencyReadTimeout{200};
 };
 
 }  // namespace stats
@@ -21,6 +21,7 @@
 #include <utils/Looper.h>
 #include <utils/Thread.h>
 
+#include <atomic>
 #include <cstdio>
 #include <cstring>
 #include <mutex>
@@ -33,6 +34,12 @@ namespace hardware {
 namespace power {
 namespace stats {
 
+/*
+ * Tracks the residency of the display states from change notifications
+ * (sysfs_notify) of the state file: the file is only read when it changes,
+ * and at a slow resync for drivers that do not notify, and the residencies
+ * are kept as counters that queries just read.
+ */
 class DisplayStateResidencyDataProvider : public PowerStats::IStateResidencyDataProvider {
   public:
     // name = powerEntityName to be associated with this data provider
@@ -69,6 +76,8 @@ class DisplayStateResidencyDataProvider : public PowerStats::IStateResidencyData
     int mCurState;
     // Looper to facilitate polling of display state file desciptor
     ::android::sp<::android::Looper> mLooper;
+    // Set by the destructor to end pollLoop()
+    std::atomic<bool> mStop = false;
 
     std::thread mThread;
 };
@@ -17,6 +17,9 @@
 #pragma once
 
 #include <PowerStatsAidl.h>
+#include <dataproviders/GenericStateResidencyParser.h>
+
+#include <mutex>
 
 namespace aidl {
 namespace android {
@@ -26,23 +29,7 @@ namespace stats {
 
 class GenericStateResidencyDataProvider : public PowerStats::IStateResidencyDataProvider {
   public:
-    class StateResidencyConfig {
-      public:
-        std::string name;
-        std::string header;
-
-        bool entryCountSupported;
-        std::string entryCountPrefix;
-        std::function<uint64_t(uint64_t)> entryCountTransform;
-
-        bool totalTimeSupported;
-        std::string totalTimePrefix;
-        std::function<uint64_t(uint64_t)> totalTimeTransform;
-
-        bool lastEntrySupported;
-        std::string lastEntryPrefix;
-        std::function<uint64_t(uint64_t)> lastEntryTransform;
-    };
+    using StateResidencyConfig = stats::StateResidencyConfig;
 
     class PowerEntityConfig {
       public:
@@ -58,7 +45,7 @@ class GenericStateResidencyDataProvider : public PowerStats::IStateResidencyData
 
     GenericStateResidencyDataProvider(const std::string &path,
                                       const std::vector<PowerEntityConfig> &configs)
-        : mPath(std::move(path)), mPowerEntityConfigs(std::move(configs)) {}
+        : mParser(std::move(path)), mPowerEntityConfigs(std::move(configs)) {}
     ~GenericStateResidencyDataProvider() = default;
 
     // Methods from PowerStats::IStateResidencyDataProvider
@@ -67,7 +54,8 @@ class GenericStateResidencyDataProvider : public PowerStats::IStateResidencyData
     std::unordered_map<std::string, std::vector<State>> getInfo() override;
 
   private:
-    const std::string mPath;
+    std::mutex mLock;
+    GenericStateResidencyParser mParser;
     const std::vector<PowerEntityConfig> mPowerEntityConfigs;
 };
 
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <android-base/unique_fd.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace power {
+namespace stats {
+
+/*
+ * A state of a residency file: the line that starts it and the prefixes of
+ * the lines after it that hold its stats. Shared by the AIDL and the legacy
+ * HIDL GenericStateResidencyDataProvider.
+ */
+class StateResidencyConfig {
+  public:
+    std::string name;
+    std::string header;
+
+    bool entryCountSupported;
+    std::string entryCountPrefix;
+    std::function<uint64_t(uint64_t)> entryCountTransform;
+
+    bool totalTimeSupported;
+    std::string totalTimePrefix;
+    std::function<uint64_t(uint64_t)> totalTimeTransform;
+
+    bool lastEntrySupported;
+    std::string lastEntryPrefix;
+    std::function<uint64_t(uint64_t)> lastEntryTransform;
+};
+
+/*
+ * Parses the residency file of a GenericStateResidencyDataProvider. read()
+ * preads the whole file into a buffer that every read reuses, and the
+ * lookups then move a cursor over it line by line without copying.
+ */
+class GenericStateResidencyParser {
+  public:
+    // The stats of one state, after the transforms of its config
+    struct StateStats {
+        uint64_t totalStateEntryCount = 0;
+        uint64_t totalTimeInStateMs = 0;
+        uint64_t lastEntryTimestampMs = 0;
+    };
+
+    explicit GenericStateResidencyParser(std::string path) : mPath(std::move(path)) {}
+
+    const std::string &path() const { return mPath; }
+
+    // Reads the file again and moves the cursor to its start
+    bool read();
+
+    /*
+     * Moves the cursor past the next line that matches the header of one of
+     * collection, ignoring surrounding whitespace, and returns its index, or
+     * -1 if none is left. If the header of the first one is empty, that one
+     * matches without moving the cursor.
+     */
+    template <class T, class Func>
+    int32_t findNextHeader(const std::vector<T> &collection, Func header) {
+        if (collection.empty()) {
+            return -1;
+        }
+        // handling the case when there is no header to look for
+        if (std::string_view(header(collection.front())).empty()) {
+            return 0;
+        }
+
+        std::string_view line;
+        while (nextLine(&line)) {
+            line = trim(line);
+            for (int32_t i = 0; i < collection.size(); ++i) {
+                if (std::string_view(header(collection[i])) == line) {
+                    return i;
+                }
+            }
+        }
+        return -1;
+    }
+
+    // Parses the lines after the cursor until all the stats config supports are found
+    bool parseState(const StateResidencyConfig &config, StateStats *stats);
+
+  private:
+    bool nextLine(std::string_view *line);
+    static std::string_view trim(std::string_view s);
+
+    const std::string mPath;
+    ::android::base::unique_fd mFd;
+    std::vector<char> mBuffer;
+    // What is left of the file after the cursor
+    std::string_view mContents;
+};
+
+}  // namespace stats
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
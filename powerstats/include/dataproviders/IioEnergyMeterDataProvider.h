@@ -17,7 +17,11 @@
 #pragma once
 
 #include <PowerStatsAidl.h>
+#include <android-base/unique_fd.h>
+#include <railsampler/RailEnergySampler.h>
 
+#include <chrono>
+#include <string_view>
 #include <unordered_map>
 
 namespace aidl {
@@ -28,8 +32,13 @@ namespace stats {
 
 class IioEnergyMeterDataProvider : public PowerStats::IEnergyMeterDataProvider {
   public:
-    IioEnergyMeterDataProvider(const std::vector<const std::string> &deviceNames,
-                               const bool useSelector = false);
+    /*
+     * With a samplerPeriod, the devices whose driver supports it are captured
+     * through their IIO buffer at that rate instead of read on demand.
+     */
+    IioEnergyMeterDataProvider(
+            const std::vector<const std::string> &deviceNames, const bool useSelector = false,
+            std::chrono::milliseconds samplerPeriod = std::chrono::milliseconds::zero());
 
     // Methods from PowerStats::IRailEnergyDataProvider
     ndk::ScopedAStatus readEnergyMeter(const std::vector<int32_t> &in_channelIds,
@@ -37,18 +46,35 @@ class IioEnergyMeterDataProvider : public PowerStats::IEnergyMeterDataProvider {
     ndk::ScopedAStatus getEnergyMeterInfo(std::vector<Channel> *_aidl_return) override;
 
   private:
+    // An IIO device with its energy_value kept open, and the channels it reports
+    struct IioDevice {
+        std::string path;
+        ::android::base::unique_fd energyFd;
+        std::vector<std::pair<std::string, int32_t>> channels;  // name, id
+        // A channel of the device was asked for by the current readEnergyMeter()
+        bool selected = false;
+        // The buffered capture of the device, with a sample per entry of channels
+        std::unique_ptr<::android::hardware::google::pixel::powerstats::RailEnergySampler>
+                sampler;
+        std::vector<::android::hardware::google::pixel::powerstats::RailEnergySample> samples;
+    };
+
     void findIioEnergyMeterNodes();
     void parseEnabledRails();
-    int parseEnergyValue(std::string path);
-    int parseEnergyContents(const std::string &contents);
+    int parseEnergyValue(const IioDevice &device);
+    bool readSampledEnergy(IioDevice *device);
+    int parseEnergyContents(std::string_view contents, const IioDevice &device);
 
     std::mutex mLock;
     std::unordered_map<std::string, std::string> mDevicePaths;  // key: path, value: device name
     std::unordered_map<std::string, int32_t> mChannelIds;  // key: name, value: id
     std::vector<Channel> mChannelInfos;
     std::vector<EnergyMeasurement> mReading;
+    std::vector<IioDevice> mDevices;
+    std::vector<char> mBuffer;  // energy_value contents, preallocated
 
     const std::vector<const std::string> kDeviceNames;
+    const std::chrono::milliseconds kSamplerPeriod;
     const std::string kDeviceType = "iio:device";
     const std::string kIioRootDir = "/sys/bus/iio/devices/";
     const std::string kNameNode = "/name";
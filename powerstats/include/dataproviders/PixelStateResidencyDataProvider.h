@@ -20,8 +20,14 @@
 #include <aidl/android/vendor/powerstats/BnPixelStateResidencyCallback.h>
 #include <aidl/android/vendor/powerstats/BnPixelStateResidencyProvider.h>
 
+#include <android-base/chrono_utils.h>
 #include <android/binder_manager.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
 using ::aidl::android::vendor::powerstats::BnPixelStateResidencyProvider;
 using ::aidl::android::vendor::powerstats::IPixelStateResidencyCallback;
 
@@ -34,14 +40,18 @@ namespace stats {
 class PixelStateResidencyDataProvider : public PowerStats::IStateResidencyDataProvider {
   public:
     PixelStateResidencyDataProvider();
-    ~PixelStateResidencyDataProvider() = default;
+    ~PixelStateResidencyDataProvider();
     void addEntity(std::string name, std::vector<State> states);
     void start();
+    // How long getStateResidencies() waits for the callbacks, which it calls in
+    // parallel. A callback that takes longer is served from its last result.
+    void setCallbackTimeout(std::chrono::milliseconds timeout);
 
     // Methods from PowerStats::IStateResidencyDataProvider
     bool getStateResidencies(
             std::unordered_map<std::string, std::vector<StateResidency>> *residencies) override;
     std::unordered_map<std::string, std::vector<State>> getInfo() override;
+    void dump(std::ostringstream &oss) override;
 
   private:
     class ProviderService : public BnPixelStateResidencyProvider {
@@ -76,6 +86,16 @@ class PixelStateResidencyDataProvider : public PowerStats::IStateResidencyDataPr
         std::string mName;
         std::vector<State> mStates;
         std::shared_ptr<IPixelStateResidencyCallback> mCallback;
+        // The result of the last call that returned, empty if it failed
+        std::vector<StateResidency> mResidency;
+        // Whether a callback thread is calling the callback
+        bool mCalling = false;
+        int64_t mCalls = 0;
+        int64_t mFailures = 0;
+        // getStateResidencies() calls served from mResidency past the timeout
+        int64_t mStaleResults = 0;
+        std::chrono::microseconds mLastLatency{0};
+        std::chrono::microseconds mMaxLatency{0};
     };
 
     void registerStatesUpdateCallback(
@@ -94,13 +114,25 @@ class PixelStateResidencyDataProvider : public PowerStats::IStateResidencyDataPr
     ::ndk::ScopedAStatus unregisterCallback(
             const std::shared_ptr<IPixelStateResidencyCallback> &in_cb);
 
-    ::ndk::ScopedAStatus getStateResidenciesTimed(const Entry &entry,
-                                                  std::vector<StateResidency> *residency);
+    void startCallbackThreadsLocked();
+    void callbackThreadLoop();
 
     const std::string kInstance = "power.stats-vendor";
     std::mutex mLock;
     std::shared_ptr<ProviderService> mProviderService;
     std::vector<Entry> mEntries;
+
+    static constexpr size_t kMaxCallbackThreads = 8;
+    // Started on the first getStateResidencies(). The rest is guarded by mLock.
+    std::vector<std::thread> mCallbackThreads;
+    // Indexes in mEntries of the callbacks to call
+    std::deque<size_t> mCallbackQueue;
+    std::condition_variable mCallbackQueueCond;
+    std::condition_variable mCallbackDoneCond;
+    bool mCallbackThreadsExit = false;
+    // Below the state residency read timeout of PowerStats, so that late
+    // callbacks leave time to return the stale results
+    std::chrono::milliseconds mCallbackTimeout{100};
     std::function<void(const std::string &, const std::vector<State> &)> mStatesUpdateCallback;
 };
 
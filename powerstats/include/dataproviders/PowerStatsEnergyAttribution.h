@@ -16,8 +16,12 @@
 
 #pragma once
 
+#include <android-base/unique_fd.h>
+
 #include <map>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 #include <string>
 
@@ -31,29 +35,48 @@ enum AttributionType {
     UID_TIME_IN_STATE,
 };
 
-// Declaring different return values for each type of attributions
-struct AttributionStats {
-    /* Members for UID_TIME_IN_STATE
-     * uidTimeInStats: key = uid, val = {uid_time_in_state}
-     * uidTimeInStateNames: state_name_0, state_name_1, ..
-     */
-    std::unordered_map<int32_t, std::vector<long>> uidTimeInStats;
-    std::vector<std::string> uidTimeInStateNames;
-};
-
 namespace aidl {
 namespace android {
 namespace hardware {
 namespace power {
 namespace stats {
 
+/*
+ * Keeps the last uid_time_in_state it read, so that each read only does the
+ * energy math for the uids whose time in state changed since. The file is
+ * read into a buffer reused by every read and parsed in place.
+ */
 class PowerStatsEnergyAttribution {
   public:
     PowerStatsEnergyAttribution() = default;
     ~PowerStatsEnergyAttribution() = default;
-    AttributionStats getAttributionStats(std::unordered_map<int32_t, std::string> paths);
-private:
-    bool readUidTimeInState(AttributionStats *attrStats, std::string path);
+    // Reads the state names from the files of paths, by AttributionType
+    bool setPaths(const std::unordered_map<int32_t, std::string> &paths);
+    // uid_time_in_state state names, empty until setPaths() read them
+    const std::vector<std::string> &getStateNames() const { return mStateNames; }
+    /*
+     * Reads uid_time_in_state and appends, for each uid whose time in state
+     * changed since the last read, the sum over the states of the change times
+     * coefficients, which is by state index. Nothing changes if it fails.
+     */
+    bool readUidEnergies(const std::vector<int64_t> &coefficients,
+                         std::vector<std::pair<int32_t, int64_t>> *uidEnergies);
+
+  private:
+    bool readFile();
+
+    std::string mPath;
+    ::android::base::unique_fd mFd;
+    std::vector<char> mBuffer;
+    std::string_view mContents;
+    std::vector<std::string> mStateNames;
+
+    // The times of the last read, a row of mStateNames.size() for each uid
+    std::unordered_map<int32_t, size_t> mUidRows;
+    std::vector<int64_t> mTimes;
+    // The uids that changed in the read in progress, with their energy and times
+    std::vector<std::pair<int32_t, int64_t>> mChanged;
+    std::vector<int64_t> mChangedTimes;
 };
 
 }  // namespace stats
@@ -68,6 +68,9 @@ class PowerStatsEnergyConsumer : public PowerStats::IEnergyConsumer {
 
     std::string getConsumerName() override;
 
+    std::vector<int32_t> getPowerEntityIds() override;
+    std::vector<int32_t> getChannelIds() override { return mChannelIds; }
+
   private:
     PowerStatsEnergyConsumer(std::shared_ptr<PowerStats> p, EnergyConsumerType type,
                              std::string name, bool attr = false);
@@ -82,16 +85,20 @@ class PowerStatsEnergyConsumer : public PowerStats::IEnergyConsumer {
     std::vector<int32_t> mChannelIds;
     int32_t mPowerEntityId;
     bool mWithAttribution;
-    std::unordered_map<int32_t, std::string> mAttrInfoPath;
     PowerStatsEnergyAttribution mEnergyAttribution;
-    // Snapshot of each uid's energy, uid_time_in_state and total energy from power meter
-    // mUidTimeInStateSS: key = uid, val = {uid_time_in_state}
+    // Snapshot of each uid's energy and total energy from power meter, the one of
+    // uid_time_in_state is in mEnergyAttribution
     // mUidEnergySS:      key = uid, val = {uid's energy(UWs)}
     // mTotalEnergySS:    total energy from power meter
-    std::unordered_map<int32_t, std::vector<long>> mUidTimeInStateSS;
     std::unordered_map<int32_t, int64_t> mUidEnergySS;
     int64_t mTotalEnergySS = 0;
     std::map<int32_t, int32_t> mCoefficients;  // key = stateId, val = coefficients (mW)
+    // mCoefficients by state id of mPowerEntityId, 0 for those without
+    std::vector<int64_t> mStateCoefficients;
+    // mCoefficients by uid_time_in_state state index, 0 for those without
+    std::vector<int64_t> mAttrCoefficients;
+    // The relative energy of the uids that changed in the last read, reused by every read
+    std::vector<std::pair<int32_t, int64_t>> mUidEnergies;
 };
 
 }  // namespace stats
@@ -17,6 +17,9 @@
 #pragma once
 
 #include <PowerStatsAidl.h>
+#include <android-base/unique_fd.h>
+
+#include <mutex>
 
 namespace aidl {
 namespace android {
@@ -24,6 +27,11 @@ namespace hardware {
 namespace power {
 namespace stats {
 
+/*
+ * Reports the counters the wlan driver keeps in its debugfs stats file.
+ * debugfs sends no change notifications, so the file is read on every query,
+ * but through an fd kept open while the driver is up and into a reused buffer.
+ */
 class WlanStateResidencyDataProvider : public PowerStats::IStateResidencyDataProvider {
   public:
     WlanStateResidencyDataProvider(std::string name, std::string path)
@@ -36,8 +44,17 @@ class WlanStateResidencyDataProvider : public PowerStats::IStateResidencyDataPro
     std::unordered_map<std::string, std::vector<State>> getInfo() override;
 
   private:
+    bool readStats();
+
     const std::string mName;
     const std::string mPath;
+
+    std::mutex mLock;
+    // wlan.driver.status at the last query, the file is opened again when it changes
+    std::string mDriverStatus;
+    ::android::base::unique_fd mFd;
+    // The contents of the file, NUL terminated
+    std::vector<char> mBuffer;
 };
 
 }  // namespace stats
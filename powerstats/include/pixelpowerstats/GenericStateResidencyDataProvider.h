@@ -17,31 +17,19 @@
 #ifndef HARDWARE_GOOGLE_PIXEL_POWERSTATS_GENERICSTATERESIDENCYDATAPROVIDER_H
 #define HARDWARE_GOOGLE_PIXEL_POWERSTATS_GENERICSTATERESIDENCYDATAPROVIDER_H
 // TODO(b/167628903): Delete this file
+#include <dataproviders/GenericStateResidencyParser.h>
 #include <pixelpowerstats/PowerStats.h>
 
+#include <mutex>
+
 namespace android {
 namespace hardware {
 namespace google {
 namespace pixel {
 namespace powerstats {
 
-class StateResidencyConfig {
-  public:
-    std::string name;
-    std::string header;
-
-    bool entryCountSupported;
-    std::string entryCountPrefix;
-    std::function<uint64_t(uint64_t)> entryCountTransform;
-
-    bool totalTimeSupported;
-    std::string totalTimePrefix;
-    std::function<uint64_t(uint64_t)> totalTimeTransform;
-
-    bool lastEntrySupported;
-    std::string lastEntryPrefix;
-    std::function<uint64_t(uint64_t)> lastEntryTransform;
-};
+using ::aidl::android::hardware::power::stats::GenericStateResidencyParser;
+using StateResidencyConfig = ::aidl::android::hardware::power::stats::StateResidencyConfig;
 
 class PowerEntityConfig {
   public:
@@ -56,7 +44,7 @@ class PowerEntityConfig {
 
 class GenericStateResidencyDataProvider : public IStateResidencyDataProvider {
   public:
-    GenericStateResidencyDataProvider(std::string path) : mPath(std::move(path)) {}
+    GenericStateResidencyDataProvider(std::string path) : mParser(std::move(path)) {}
     ~GenericStateResidencyDataProvider() = default;
     void addEntity(uint32_t id, const PowerEntityConfig &config);
     bool getResults(
@@ -64,7 +52,8 @@ class GenericStateResidencyDataProvider : public IStateResidencyDataProvider {
     std::vector<PowerEntityStateSpace> getStateSpaces() override;
 
   private:
-    const std::string mPath;
+    std::mutex mLock;
+    GenericStateResidencyParser mParser;
     std::vector<std::pair<uint32_t, PowerEntityConfig>> mPowerEntityConfigs;
 };
 
@@ -0,0 +1,447 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <railsampler/RailEnergySampler.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+namespace powerstats {
+
+using ::android::base::ReadFileToString;
+using ::android::base::StartsWith;
+using ::android::base::StringPrintf;
+using ::android::base::Trim;
+using ::android::base::WriteStringToFile;
+
+namespace {
+
+constexpr const char *kHrtimerDir = "/config/iio/triggers/hrtimer/";
+constexpr const char *kDevDir = "/dev/";
+constexpr const char *kTimestampElement = "in_timestamp";
+// Records the driver may queue before the capture thread drains them
+constexpr size_t kBufferLength = 64;
+// Samples kept in the ring, a power of two
+constexpr uint64_t kRingSize = 64;
+// Times a reader retries when the capture thread lapped it mid-copy
+constexpr int kReadAttempts = 4;
+// How often the capture thread checks whether to stop when no record comes
+constexpr int kPollTimeoutMs = 500;
+
+bool readAttribute(const std::string &path, std::string *value) {
+    if (!ReadFileToString(path, value)) {
+        return false;
+    }
+    *value = Trim(*value);
+    return true;
+}
+
+std::string baseName(const std::string &path) {
+    const size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+std::string dirName(const std::string &path) {
+    const size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+}  // namespace
+
+std::unique_ptr<RailEnergySampler> RailEnergySampler::create(const std::string &devicePath,
+                                                             std::chrono::milliseconds period) {
+    std::unique_ptr<RailEnergySampler> sampler(new RailEnergySampler(devicePath));
+    if (!sampler->parseEnabledRails() || !sampler->layoutRecord() ||
+        !sampler->readStartDurations()) {
+        LOG(INFO) << "No buffered capture of the rails of " << devicePath;
+        return nullptr;
+    }
+    if (!sampler->setTrigger(period) || !sampler->enableBuffer()) {
+        LOG(WARNING) << "Failed to start the buffered capture of " << devicePath;
+        return nullptr;
+    }
+
+    const size_t slotSize = sampler->mRails.size() + 1;
+    sampler->mSlotSeqs.reset(new std::atomic<uint32_t>[kRingSize]());
+    sampler->mSlotValues.reset(new std::atomic<uint64_t>[kRingSize * slotSize]());
+    sampler->mRecords.resize(kBufferLength * sampler->mRecordSize);
+    sampler->mThread = std::thread(&RailEnergySampler::captureLoop, sampler.get());
+    LOG(INFO) << "Capturing " << sampler->mRails.size() << " rails of " << devicePath
+              << " every " << period.count() << "ms";
+    return sampler;
+}
+
+RailEnergySampler::~RailEnergySampler() {
+    mStop = true;
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+    disableBuffer();
+}
+
+bool RailEnergySampler::parseEnabledRails() {
+    std::string data;
+    if (!ReadFileToString(mDevicePath + "/enabled_rails", &data)) {
+        return false;
+    }
+
+    for (const auto &line : ::android::base::Split(data, "\n")) {
+        if (line.empty()) {
+            continue;
+        }
+        /* Format example: CH2[VSYS_PWR_RFFE]:Cellular */
+        unsigned int channel = 0;
+        const size_t nameStart = line.find('[');
+        const size_t nameEnd = line.find(']');
+        if (sscanf(line.c_str(), "CH%u[", &channel) != 1 || nameStart == std::string::npos ||
+            nameEnd == std::string::npos || nameEnd < nameStart) {
+            LOG(WARNING) << "Unexpected enabled rail format in " << mDevicePath;
+            return false;
+        }
+
+        Rail rail;
+        rail.name = line.substr(nameStart + 1, nameEnd - nameStart - 1);
+        const std::string element = StringPrintf("in_energy%u", channel);
+        if (!parseScanElement(element, &rail.element)) {
+            return false;
+        }
+
+        // IIO energy is in Joules once scaled; without a scale it is taken to be in uWs
+        std::string scale;
+        if (readAttribute(StringPrintf("%s/%s_scale", mDevicePath.c_str(), element.c_str()),
+                          &scale) ||
+            readAttribute(mDevicePath + "/in_energy_scale", &scale)) {
+            rail.scale = strtod(scale.c_str(), nullptr) * 1000000;
+        }
+
+        mRailNames.push_back(rail.name);
+        mRails.push_back(std::move(rail));
+    }
+    return !mRails.empty() && parseScanElement(kTimestampElement, &mTimestamp);
+}
+
+bool RailEnergySampler::parseScanElement(const std::string &name, ScanElement *element) const {
+    const std::string prefix =
+            StringPrintf("%s/scan_elements/%s", mDevicePath.c_str(), name.c_str());
+    std::string index;
+    std::string type;
+    if (!readAttribute(prefix + "_index", &index) || !readAttribute(prefix + "_type", &type)) {
+        return false;
+    }
+
+    /* Format example: le:u64/64>>0, repeated elements are not supported */
+    char endian = 0;
+    char sign = 0;
+    unsigned int bits = 0;
+    unsigned int storageBits = 0;
+    unsigned int shift = 0;
+    if (sscanf(type.c_str(), "%ce:%c%u/%u>>%u", &endian, &sign, &bits, &storageBits, &shift) !=
+                5 ||
+        (storageBits != 8 && storageBits != 16 && storageBits != 32 && storageBits != 64) ||
+        bits == 0 || bits + shift > storageBits) {
+        LOG(WARNING) << "Unsupported scan element type " << type << " of " << prefix;
+        return false;
+    }
+
+    element->name = name;
+    element->index = strtoul(index.c_str(), nullptr, 10);
+    element->bytes = storageBits / 8;
+    element->bits = bits;
+    element->shift = shift;
+    element->isSigned = sign == 's';
+    element->bigEndian = endian == 'b';
+    return true;
+}
+
+bool RailEnergySampler::layoutRecord() {
+    // Elements come in the order of their index, each aligned to its size
+    std::vector<ScanElement *> elements = {&mTimestamp};
+    for (auto &rail : mRails) {
+        elements.push_back(&rail.element);
+    }
+    std::sort(elements.begin(), elements.end(),
+              [](const auto *a, const auto *b) { return a->index < b->index; });
+
+    size_t offset = 0;
+    size_t alignment = 1;
+    for (auto *element : elements) {
+        offset = (offset + element->bytes - 1) / element->bytes * element->bytes;
+        element->offset = offset;
+        offset += element->bytes;
+        alignment = std::max(alignment, element->bytes);
+    }
+    mRecordSize = (offset + alignment - 1) / alignment * alignment;
+    return mRecordSize > 0;
+}
+
+bool RailEnergySampler::readStartDurations() {
+    // The buffer has no sampling duration, so carry on from the one energy_value has now
+    std::string data;
+    if (!ReadFileToString(mDevicePath + "/energy_value", &data)) {
+        return false;
+    }
+
+    const auto lines = ::android::base::Split(data, "\n");
+    unsigned long long timestamp = 0;
+    if (lines.empty() || sscanf(lines[0].c_str(), "t=%llu", &timestamp) != 1) {
+        return false;
+    }
+    mStartTimestampMs = timestamp;
+
+    size_t found = 0;
+    for (const auto &line : lines) {
+        /* Format example: CH3(T=358356)[S2M_VDD_CPUCL2], 761330 */
+        unsigned long long duration = 0;
+        const size_t nameStart = line.find(")[");
+        const size_t nameEnd = line.find("],");
+        if (sscanf(line.c_str(), "CH%*u(T=%llu)", &duration) != 1 ||
+            nameStart == std::string::npos || nameEnd == std::string::npos || nameEnd < nameStart) {
+            continue;
+        }
+        const std::string name = line.substr(nameStart + 2, nameEnd - nameStart - 2);
+        for (auto &rail : mRails) {
+            if (rail.name == name) {
+                rail.startDurationMs = duration;
+                ++found;
+            }
+        }
+    }
+    return found == mRails.size();
+}
+
+bool RailEnergySampler::setTrigger(std::chrono::milliseconds period) {
+    const std::string currentTrigger = mDevicePath + "/trigger/current_trigger";
+    std::string trigger;
+    if (!readAttribute(currentTrigger, &trigger)) {
+        return false;
+    }
+    if (!trigger.empty()) {
+        // The driver, or whoever set the device up, already picked the trigger
+        return true;
+    }
+    if (period.count() <= 0) {
+        return false;
+    }
+
+    std::string name = "railsampler-" + baseName(mDevicePath);
+    std::replace(name.begin(), name.end(), ':', '-');
+    const std::string hrtimerPath = kHrtimerDir + name;
+    if (mkdir(hrtimerPath.c_str(), 0755) != 0 && errno != EEXIST) {
+        PLOG(WARNING) << "Failed to create trigger " << hrtimerPath;
+        return false;
+    }
+    mHrtimerPath = hrtimerPath;
+
+    // The trigger shows up among the devices once created
+    const std::string iioDir = dirName(mDevicePath);
+    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(iioDir.c_str()), closedir);
+    if (!dir) {
+        PLOG(ERROR) << "Error opening directory " << iioDir;
+        return false;
+    }
+    std::string triggerDir;
+    while (struct dirent *ent = readdir(dir.get())) {
+        std::string triggerName;
+        if (StartsWith(ent->d_name, "trigger") &&
+            readAttribute(StringPrintf("%s/%s/name", iioDir.c_str(), ent->d_name), &triggerName) &&
+            triggerName == name) {
+            triggerDir = StringPrintf("%s/%s", iioDir.c_str(), ent->d_name);
+            break;
+        }
+    }
+    if (triggerDir.empty()) {
+        LOG(WARNING) << "Trigger " << name << " did not show up in " << iioDir;
+        return false;
+    }
+
+    const std::string frequency = StringPrintf("%.3f", 1000.0 / period.count());
+    if (!WriteStringToFile(frequency, triggerDir + "/sampling_frequency") ||
+        !WriteStringToFile(name, currentTrigger)) {
+        PLOG(WARNING) << "Failed to set trigger " << name << " on " << mDevicePath;
+        return false;
+    }
+    return true;
+}
+
+bool RailEnergySampler::enableBuffer() {
+    const std::string scanDir = mDevicePath + "/scan_elements";
+    WriteStringToFile("0", mDevicePath + "/buffer/enable");
+
+    // Only the rails and the timestamp may be in a record
+    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(scanDir.c_str()), closedir);
+    if (!dir) {
+        PLOG(ERROR) << "Error opening directory " << scanDir;
+        return false;
+    }
+    while (struct dirent *ent = readdir(dir.get())) {
+        const std::string_view entry = ent->d_name;
+        if (entry.size() > 3 && entry.substr(entry.size() - 3) == "_en") {
+            WriteStringToFile("0", StringPrintf("%s/%s", scanDir.c_str(), ent->d_name));
+        }
+    }
+
+    bool enabled = WriteStringToFile("boottime", mDevicePath + "/current_timestamp_clock") &&
+                   WriteStringToFile("1", StringPrintf("%s/%s_en", scanDir.c_str(),
+                                                       mTimestamp.name.c_str()));
+    for (size_t i = 0; enabled && i < mRails.size(); ++i) {
+        enabled = WriteStringToFile("1", StringPrintf("%s/%s_en", scanDir.c_str(),
+                                                      mRails[i].element.name.c_str()));
+    }
+    enabled = enabled &&
+              WriteStringToFile(std::to_string(kBufferLength), mDevicePath + "/buffer/length") &&
+              WriteStringToFile("1", mDevicePath + "/buffer/enable");
+    if (!enabled) {
+        PLOG(WARNING) << "Failed to enable the buffer of " << mDevicePath;
+        return false;
+    }
+
+    const std::string bufferPath = kDevDir + baseName(mDevicePath);
+    mBufferFd.reset(
+            TEMP_FAILURE_RETRY(open(bufferPath.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC)));
+    if (!mBufferFd.ok()) {
+        PLOG(WARNING) << "Failed to open " << bufferPath;
+        return false;
+    }
+    return true;
+}
+
+void RailEnergySampler::disableBuffer() {
+    if (mBufferFd.ok()) {
+        WriteStringToFile("0", mDevicePath + "/buffer/enable");
+        mBufferFd.reset();
+    }
+    if (!mHrtimerPath.empty()) {
+        WriteStringToFile("\n", mDevicePath + "/trigger/current_trigger");
+        rmdir(mHrtimerPath.c_str());
+        mHrtimerPath.clear();
+    }
+}
+
+uint64_t RailEnergySampler::readElement(const uint8_t *record, const ScanElement &element) const {
+    uint64_t value = 0;
+    for (size_t i = 0; i < element.bytes; ++i) {
+        value = (value << 8) |
+                record[element.offset + (element.bigEndian ? i : element.bytes - 1 - i)];
+    }
+    value >>= element.shift;
+    if (element.bits < 64) {
+        const uint64_t signBit = 1ULL << (element.bits - 1);
+        value &= (signBit << 1) - 1;
+        if (element.isSigned && (value & signBit)) {
+            value |= ~((signBit << 1) - 1);
+        }
+    }
+    return value;
+}
+
+void RailEnergySampler::publish(const uint8_t *record) {
+    const uint64_t published = mPublished.load(std::memory_order_relaxed);
+    const size_t slot = published % kRingSize;
+    std::atomic<uint64_t> *values = &mSlotValues[slot * (mRails.size() + 1)];
+    auto &seq = mSlotSeqs[slot];
+
+    const uint32_t start = seq.load(std::memory_order_relaxed) + 1;
+    seq.store(start, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    values[0].store(readElement(record, mTimestamp), std::memory_order_relaxed);
+    for (size_t i = 0; i < mRails.size(); ++i) {
+        const uint64_t raw = readElement(record, mRails[i].element);
+        const uint64_t energy =
+                mRails[i].scale > 0 ? static_cast<uint64_t>(raw * mRails[i].scale) : raw;
+        values[i + 1].store(energy, std::memory_order_relaxed);
+    }
+
+    seq.store(start + 1, std::memory_order_release);
+    mPublished.store(published + 1, std::memory_order_release);
+}
+
+bool RailEnergySampler::readLatest(std::vector<RailEnergySample> *samples) const {
+    samples->resize(mRails.size());
+    for (int attempt = 0; attempt < kReadAttempts; ++attempt) {
+        const uint64_t published = mPublished.load(std::memory_order_acquire);
+        if (published == 0) {
+            return false;
+        }
+        const size_t slot = (published - 1) % kRingSize;
+        const std::atomic<uint64_t> *values = &mSlotValues[slot * (mRails.size() + 1)];
+        const auto &seq = mSlotSeqs[slot];
+
+        const uint32_t start = seq.load(std::memory_order_acquire);
+        if (start & 1) {
+            continue;
+        }
+        const uint64_t timestampMs = values[0].load(std::memory_order_relaxed) / 1000000;
+        const uint64_t elapsedMs =
+                timestampMs > mStartTimestampMs ? timestampMs - mStartTimestampMs : 0;
+        for (size_t i = 0; i < mRails.size(); ++i) {
+            (*samples)[i].timestampMs = timestampMs;
+            (*samples)[i].durationMs = mRails[i].startDurationMs + elapsedMs;
+            (*samples)[i].energyUWs = values[i + 1].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq.load(std::memory_order_relaxed) == start) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void RailEnergySampler::captureLoop() {
+    while (!mStop) {
+        struct pollfd pfd = {.fd = mBufferFd.get(), .events = POLLIN, .revents = 0};
+        if (poll(&pfd, 1, kPollTimeoutMs) <= 0) {
+            continue;
+        }
+
+        const ssize_t size =
+                TEMP_FAILURE_RETRY(read(mBufferFd.get(), mRecords.data(), mRecords.size()));
+        if (size < 0) {
+            if (errno == EAGAIN) {
+                continue;
+            }
+            PLOG(ERROR) << "Failed to read the buffer of " << mDevicePath;
+            // Readers go back to energy_value rather than keep the last sample forever
+            mPublished.store(0, std::memory_order_release);
+            return;
+        }
+        for (size_t offset = 0; offset + mRecordSize <= static_cast<size_t>(size);
+             offset += mRecordSize) {
+            publish(mRecords.data() + offset);
+        }
+    }
+}
+
+}  // namespace powerstats
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
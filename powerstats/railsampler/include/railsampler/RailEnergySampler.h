@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <android-base/unique_fd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+namespace powerstats {
+
+// A rail at one sample, in the units of an energy_value line
+struct RailEnergySample {
+    uint64_t timestampMs = 0;  // since boot
+    uint64_t durationMs = 0;   // the T= of energy_value
+    uint64_t energyUWs = 0;
+};
+
+/*
+ * Samples the rails of an ODPM IIO device through the buffered capture of
+ * /dev/iio:deviceX, at the rate of a trigger, rather than by reading the text
+ * energy_value on demand. A thread drains the buffer into a ring of samples,
+ * and readers take the latest one without locking, so they never wait on the
+ * driver and every sample carries the timestamp the driver took it at.
+ *
+ * Used by the powerstats IIO energy meter and by the thermal HAL, each in its
+ * own process. create() returns nullptr when the driver cannot capture every
+ * enabled rail into its buffer; callers then keep reading energy_value.
+ */
+class RailEnergySampler {
+  public:
+    /*
+     * devicePath is the sysfs directory of the device, e.g.
+     * /sys/bus/iio/devices/iio:device0. The trigger the device already has is
+     * kept, otherwise an hrtimer trigger firing every period is created.
+     */
+    static std::unique_ptr<RailEnergySampler> create(const std::string &devicePath,
+                                                     std::chrono::milliseconds period);
+    ~RailEnergySampler();
+
+    RailEnergySampler(const RailEnergySampler &) = delete;
+    RailEnergySampler &operator=(const RailEnergySampler &) = delete;
+
+    // The enabled rails of the device, in the order of the samples
+    const std::vector<std::string> &railNames() const { return mRailNames; }
+
+    // Copies the latest sample of every rail into *samples, false if there is none yet
+    bool readLatest(std::vector<RailEnergySample> *samples) const;
+
+  private:
+    // How a scan element is laid out in a record of the buffer, from its _type
+    struct ScanElement {
+        std::string name;
+        uint32_t index = 0;
+        size_t offset = 0;
+        size_t bytes = 0;
+        uint32_t bits = 0;
+        uint32_t shift = 0;
+        bool isSigned = false;
+        bool bigEndian = false;
+    };
+    struct Rail {
+        std::string name;
+        ScanElement element;
+        double scale = 0;  // to uWs, 0 if the raw value is in uWs already
+        uint64_t startDurationMs = 0;
+    };
+
+    explicit RailEnergySampler(std::string devicePath) : mDevicePath(std::move(devicePath)) {}
+    bool parseEnabledRails();
+    bool parseScanElement(const std::string &name, ScanElement *element) const;
+    bool layoutRecord();
+    bool readStartDurations();
+    bool setTrigger(std::chrono::milliseconds period);
+    bool enableBuffer();
+    void disableBuffer();
+    uint64_t readElement(const uint8_t *record, const ScanElement &element) const;
+    void publish(const uint8_t *record);
+    void captureLoop();
+
+    const std::string mDevicePath;
+    std::vector<std::string> mRailNames;
+    std::vector<Rail> mRails;
+    ScanElement mTimestamp;
+    size_t mRecordSize = 0;
+    uint64_t mStartTimestampMs = 0;
+    // The hrtimer trigger this created, removed again on destruction
+    std::string mHrtimerPath;
+
+    ::android::base::unique_fd mBufferFd;
+    std::vector<uint8_t> mRecords;
+    /*
+     * The ring: each slot holds the timestamp of a record and the energy of
+     * every rail in it, and a sequence count that is odd while the slot is written, so a
+     * reader can tell when the capture thread lapped it mid-copy. The latest
+     * sample is in slot (mPublished - 1) % kRingSize.
+     */
+    std::unique_ptr<std::atomic<uint32_t>[]> mSlotSeqs;
+    std::unique_ptr<std::atomic<uint64_t>[]> mSlotValues;
+    std::atomic<uint64_t> mPublished = 0;
+    std::atomic<bool> mStop = false;
+    std::thread mThread;
+};
+
+}  // namespace powerstats
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
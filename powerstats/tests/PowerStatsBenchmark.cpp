@@ -0,0 +1,402 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Times the calls BatteryStats makes on every collection: getStateResidency({}),
+ * getEnergyConsumed({}) and readEnergyMeter({}).
+ *
+ * The BM_Fake benchmarks run PowerStats in this process, with state residency
+ * providers and an energy meter reading files laid out as the SoC stats and
+ * ODPM energy_value nodes are, and energy consumers over both. The BM_Live
+ * ones call the power stats HAL running on the device, and are skipped when
+ * there is none.
+ *
+ * Each reports the p50, p90 and p99 latency of a call in us, and the read
+ * syscalls per call, the syscr of /proc/<pid>/io of the process serving it.
+ * The fake ones also report the provider reads PowerStats made in the last call.
+ */
+
+#include <PowerStatsAidl.h>
+#include <aidl/android/hardware/power/stats/IPowerStats.h>
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <android-base/unique_fd.h>
+#include <android/binder_manager.h>
+#include <benchmark/benchmark.h>
+#include <dataproviders/GenericStateResidencyDataProvider.h>
+#include <dataproviders/PowerStatsEnergyConsumer.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace power {
+namespace stats {
+
+using ::android::base::ReadFileToString;
+using ::android::base::StringPrintf;
+using ::android::base::WriteStringToFile;
+
+namespace {
+
+// The shape of the fake provider set, about that of a Pixel SoC
+constexpr int kStatsFiles = 4;
+constexpr int kEntitiesPerFile = 4;
+constexpr int kStatesPerEntity = 6;
+constexpr int kRails = 16;
+
+// The read syscalls the process pid made so far, 0 if unknown
+uint64_t readSyscalls(pid_t pid) {
+    std::string io;
+    if (pid <= 0 || !ReadFileToString(StringPrintf("/proc/%d/io", pid), &io)) {
+        return 0;
+    }
+    for (const auto &line : ::android::base::Split(io, "\n")) {
+        uint64_t syscr = 0;
+        if (sscanf(line.c_str(), "syscr: %" SCNu64, &syscr) == 1) {
+            return syscr;
+        }
+    }
+    return 0;
+}
+
+std::string entityName(int file, int entity) {
+    return StringPrintf("ENTITY%d_%d", file, entity);
+}
+
+std::string railName(int rail) {
+    return StringPrintf("S%dM_VDD_RAIL", rail);
+}
+
+// A stats file as the SoC writes it, in the format of the Pixel configs
+std::string statsFileContents(int file, uint64_t tick) {
+    std::string contents;
+    for (int entity = 0; entity < kEntitiesPerFile; entity++) {
+        contents += entityName(file, entity) + ":\n";
+        for (int state = 0; state < kStatesPerEntity; state++) {
+            contents += StringPrintf(
+                    "  STATE%d\n"
+                    "    success_count: %" PRIu64 "\n"
+                    "    fail_count: 0\n"
+                    "    total_time_ns: 0x%" PRIx64 "\n"
+                    "    last_entry_time_ns: 0x%" PRIx64 "\n",
+                    state, tick * (state + 1), tick * 1000000 * (state + 1), tick * 1000000);
+        }
+    }
+    return contents;
+}
+
+std::string energyValueContents(uint64_t tick) {
+    std::string contents = StringPrintf("t=%" PRIu64 "\n", tick * 10);
+    for (int rail = 0; rail < kRails; rail++) {
+        contents += StringPrintf("CH%d(T=%" PRIu64 ")[%s], %" PRIu64 "\n", rail, tick * 10,
+                                 railName(rail).c_str(), tick * (rail + 1) * 1000);
+    }
+    return contents;
+}
+
+// Reads an energy_value file as IioEnergyMeterDataProvider does, with one pread
+class FakeEnergyMeter : public PowerStats::IEnergyMeterDataProvider {
+  public:
+    explicit FakeEnergyMeter(const std::string &path)
+        : mFd(open(path.c_str(), O_RDONLY | O_CLOEXEC)), mBuffer(4096) {
+        for (int rail = 0; rail < kRails; rail++) {
+            mChannels.push_back({.id = rail, .name = railName(rail), .subsystem = "SOC"});
+        }
+    }
+
+    ndk::ScopedAStatus readEnergyMeter(const std::vector<int32_t> &in_channelIds,
+                                       std::vector<EnergyMeasurement> *_aidl_return) override {
+        const ssize_t size = pread(mFd.get(), mBuffer.data(), mBuffer.size() - 1, 0);
+        if (size < 0) {
+            return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_ILLEGAL_STATE));
+        }
+        mBuffer[size] = '\0';
+
+        std::vector<EnergyMeasurement> reading(kRails);
+        uint64_t timestamp = 0;
+        char *line = mBuffer.data();
+        sscanf(line, "t=%" SCNu64, &timestamp);
+        while ((line = strchr(line, '\n')) && *++line) {
+            int channel = 0;
+            uint64_t duration = 0;
+            uint64_t energy = 0;
+            if (sscanf(line, "CH%d(T=%" SCNu64 ")[%*[^]]], %" SCNu64, &channel, &duration,
+                       &energy) == 3 &&
+                channel >= 0 && channel < kRails) {
+                reading[channel] = {.id = channel,
+                                    .timestampMs = static_cast<int64_t>(timestamp),
+                                    .durationMs = static_cast<int64_t>(duration),
+                                    .energyUWs = static_cast<int64_t>(energy)};
+            }
+        }
+
+        if (in_channelIds.empty()) {
+            *_aidl_return = std::move(reading);
+        } else {
+            for (const auto id : in_channelIds) {
+                if (id < 0 || id >= kRails) {
+                    return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_ILLEGAL_ARGUMENT));
+                }
+                _aidl_return->push_back(reading[id]);
+            }
+        }
+        return ndk::ScopedAStatus::ok();
+    }
+
+    ndk::ScopedAStatus getEnergyMeterInfo(std::vector<Channel> *_aidl_return) override {
+        *_aidl_return = mChannels;
+        return ndk::ScopedAStatus::ok();
+    }
+
+  private:
+    ::android::base::unique_fd mFd;
+    std::vector<char> mBuffer;
+    std::vector<Channel> mChannels;
+};
+
+// The fake provider set, built once for all the BM_Fake benchmarks
+class FakeHal {
+  public:
+    FakeHal() : mPowerStats(ndk::SharedRefBase::make<PowerStats>()) {
+        const GenericStateResidencyDataProvider::StateResidencyConfig stateConfig = {
+                .entryCountSupported = true,
+                .entryCountPrefix = "success_count:",
+                .totalTimeSupported = true,
+                .totalTimePrefix = "total_time_ns:",
+                .totalTimeTransform = [](uint64_t ns) { return ns / 1000000; },
+                .lastEntrySupported = true,
+                .lastEntryPrefix = "last_entry_time_ns:",
+                .lastEntryTransform = [](uint64_t ns) { return ns / 1000000; },
+        };
+        std::vector<std::pair<std::string, std::string>> stateHeaders;
+        for (int state = 0; state < kStatesPerEntity; state++) {
+            stateHeaders.emplace_back(StringPrintf("STATE%d", state),
+                                      StringPrintf("STATE%d", state));
+        }
+
+        for (int file = 0; file < kStatsFiles; file++) {
+            const std::string path = StringPrintf("%s/soc_stats%d", mDir.path, file);
+            WriteStringToFile(statsFileContents(file, 1), path);
+            std::vector<GenericStateResidencyDataProvider::PowerEntityConfig> configs;
+            for (int entity = 0; entity < kEntitiesPerFile; entity++) {
+                configs.emplace_back(generateGenericStateResidencyConfigs(stateConfig,
+                                                                          stateHeaders),
+                                     entityName(file, entity), entityName(file, entity) + ":");
+            }
+            mPowerStats->addStateResidencyDataProvider(
+                    std::make_unique<GenericStateResidencyDataProvider>(path, configs));
+        }
+
+        const std::string energyPath = StringPrintf("%s/energy_value", mDir.path);
+        WriteStringToFile(energyValueContents(1), energyPath);
+        mPowerStats->setEnergyMeterDataProvider(std::make_unique<FakeEnergyMeter>(energyPath));
+
+        // A consumer per pair of rails, and one per entity of the first file
+        for (int rail = 0; rail + 1 < kRails; rail += 2) {
+            mPowerStats->addEnergyConsumer(PowerStatsEnergyConsumer::createMeterConsumer(
+                    mPowerStats, EnergyConsumerType::OTHER, StringPrintf("RAILS%d", rail),
+                    {railName(rail), railName(rail + 1)}));
+        }
+        for (int entity = 0; entity < kEntitiesPerFile; entity++) {
+            std::map<std::string, int32_t> stateCoeffs;
+            for (int state = 0; state < kStatesPerEntity; state++) {
+                stateCoeffs.emplace(StringPrintf("STATE%d", state), state * 10);
+            }
+            mPowerStats->addEnergyConsumer(PowerStatsEnergyConsumer::createEntityConsumer(
+                    mPowerStats, EnergyConsumerType::OTHER, StringPrintf("ENTITY%d", entity),
+                    entityName(0, entity), stateCoeffs));
+        }
+    }
+
+    PowerStats *powerStats() { return mPowerStats.get(); }
+
+  private:
+    TemporaryDir mDir;
+    std::shared_ptr<PowerStats> mPowerStats;
+};
+
+FakeHal *fakeHal() {
+    static FakeHal *hal = new FakeHal();
+    return hal;
+}
+
+// The power stats HAL of the device and its pid, nullptr if there is none
+std::pair<std::shared_ptr<IPowerStats>, pid_t> liveHal() {
+    static const auto hal = []() -> std::pair<std::shared_ptr<IPowerStats>, pid_t> {
+        const std::string instance = std::string(IPowerStats::descriptor) + "/default";
+        if (!AServiceManager_isDeclared(instance.c_str())) {
+            return {nullptr, 0};
+        }
+        auto powerStats = IPowerStats::fromBinder(
+                ndk::SpAIBinder(AServiceManager_waitForService(instance.c_str())));
+
+        // The service process, for its read syscalls
+        pid_t pid = 0;
+        std::unique_ptr<DIR, decltype(&closedir)> dir(opendir("/proc"), closedir);
+        while (dir && pid == 0) {
+            struct dirent *ent = readdir(dir.get());
+            if (!ent) {
+                break;
+            }
+            std::string cmdline;
+            const pid_t candidate = atoi(ent->d_name);
+            if (candidate > 0 &&
+                ReadFileToString(StringPrintf("/proc/%d/cmdline", candidate), &cmdline) &&
+                cmdline.find("android.hardware.power.stats") != std::string::npos) {
+                pid = candidate;
+            }
+        }
+        return {powerStats, pid};
+    }();
+    return hal;
+}
+
+// Times call once per iteration, in the process pid
+void runCalls(benchmark::State &state, pid_t pid, const std::function<bool()> &call) {
+    std::vector<double> latenciesUs;
+    // What reading /proc/<pid>/io costs, when pid is this process
+    const uint64_t calibrationReads = readSyscalls(pid);
+    const uint64_t startReads = readSyscalls(pid);
+    const uint64_t readOverhead = startReads - calibrationReads;
+
+    for (auto _ : state) {
+        const auto start = std::chrono::steady_clock::now();
+        if (!call()) {
+            state.SkipWithError("call failed");
+            return;
+        }
+        latenciesUs.push_back(std::chrono::duration<double, std::micro>(
+                                      std::chrono::steady_clock::now() - start)
+                                      .count());
+    }
+    const uint64_t reads = readSyscalls(pid) - startReads - readOverhead;
+    if (latenciesUs.empty()) {
+        return;
+    }
+
+    std::sort(latenciesUs.begin(), latenciesUs.end());
+    auto percentile = [&](double p) {
+        return latenciesUs[std::min(latenciesUs.size() - 1,
+                                    static_cast<size_t>(p * latenciesUs.size()))];
+    };
+    state.counters["p50_us"] = percentile(0.50);
+    state.counters["p90_us"] = percentile(0.90);
+    state.counters["p99_us"] = percentile(0.99);
+    if (pid > 0) {
+        state.counters["read_syscalls"] =
+                benchmark::Counter(reads, benchmark::Counter::kAvgIterations);
+    }
+}
+
+void reportReadCounters(benchmark::State &state, PowerStats *powerStats) {
+    const auto counters = powerStats->getLastReadCounters();
+    state.counters["state_residency_reads"] = counters.stateResidencyReads;
+    state.counters["energy_meter_reads"] = counters.energyMeterReads;
+}
+
+void BM_FakeGetStateResidency(benchmark::State &state) {
+    PowerStats *powerStats = fakeHal()->powerStats();
+    runCalls(state, getpid(), [&] {
+        std::vector<StateResidencyResult> results;
+        return powerStats->getStateResidency({}, &results).isOk();
+    });
+    reportReadCounters(state, powerStats);
+}
+BENCHMARK(BM_FakeGetStateResidency);
+
+void BM_FakeGetEnergyConsumed(benchmark::State &state) {
+    PowerStats *powerStats = fakeHal()->powerStats();
+    runCalls(state, getpid(), [&] {
+        std::vector<EnergyConsumerResult> results;
+        return powerStats->getEnergyConsumed({}, &results).isOk();
+    });
+    reportReadCounters(state, powerStats);
+}
+BENCHMARK(BM_FakeGetEnergyConsumed);
+
+void BM_FakeReadEnergyMeter(benchmark::State &state) {
+    PowerStats *powerStats = fakeHal()->powerStats();
+    runCalls(state, getpid(), [&] {
+        std::vector<EnergyMeasurement> results;
+        return powerStats->readEnergyMeter({}, &results).isOk();
+    });
+    reportReadCounters(state, powerStats);
+}
+BENCHMARK(BM_FakeReadEnergyMeter);
+
+void BM_LiveGetStateResidency(benchmark::State &state) {
+    const auto [powerStats, pid] = liveHal();
+    if (!powerStats) {
+        state.SkipWithError("no power stats HAL");
+        return;
+    }
+    runCalls(state, pid, [&] {
+        std::vector<StateResidencyResult> results;
+        return powerStats->getStateResidency({}, &results).isOk();
+    });
+}
+BENCHMARK(BM_LiveGetStateResidency);
+
+void BM_LiveGetEnergyConsumed(benchmark::State &state) {
+    const auto [powerStats, pid] = liveHal();
+    if (!powerStats) {
+        state.SkipWithError("no power stats HAL");
+        return;
+    }
+    runCalls(state, pid, [&] {
+        std::vector<EnergyConsumerResult> results;
+        return powerStats->getEnergyConsumed({}, &results).isOk();
+    });
+}
+BENCHMARK(BM_LiveGetEnergyConsumed);
+
+void BM_LiveReadEnergyMeter(benchmark::State &state) {
+    const auto [powerStats, pid] = liveHal();
+    if (!powerStats) {
+        state.SkipWithError("no power stats HAL");
+        return;
+    }
+    runCalls(state, pid, [&] {
+        std::vector<EnergyMeasurement> results;
+        return powerStats->readEnergyMeter({}, &results).isOk();
+    });
+}
+BENCHMARK(BM_LiveReadEnergyMeter);
+
+}  // namespace
+
+}  // namespace stats
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
+
+BENCHMARK_MAIN();
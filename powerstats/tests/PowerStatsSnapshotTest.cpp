@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <PowerStatsAidl.h>
+#include <dataproviders/PowerStatsEnergyConsumer.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace power {
+namespace stats {
+
+namespace {
+
+constexpr int kChannels = 4;
+
+// A provider of the given entities, each in states ON and OFF, that counts its reads
+class FakeStateResidencyDataProvider : public PowerStats::IStateResidencyDataProvider {
+  public:
+    FakeStateResidencyDataProvider(std::vector<std::string> entities, std::atomic<int> *reads)
+        : mEntities(std::move(entities)), mReads(reads) {}
+
+    bool getStateResidencies(
+            std::unordered_map<std::string, std::vector<StateResidency>> *residencies) override {
+        const int read = ++*mReads;
+        for (const auto &entity : mEntities) {
+            residencies->emplace(entity, std::vector<StateResidency>{
+                                                 {.id = 0, .totalTimeInStateMs = 10 * read},
+                                                 {.id = 1, .totalTimeInStateMs = 20 * read},
+                                         });
+        }
+        return true;
+    }
+
+    std::unordered_map<std::string, std::vector<State>> getInfo() override {
+        std::unordered_map<std::string, std::vector<State>> info;
+        for (const auto &entity : mEntities) {
+            info.emplace(entity, std::vector<State>{{.id = 0, .name = "ON"},
+                                                    {.id = 1, .name = "OFF"}});
+        }
+        return info;
+    }
+
+  private:
+    const std::vector<std::string> mEntities;
+    std::atomic<int> *mReads;
+};
+
+// An energy meter of kChannels channels that counts its reads
+class FakeEnergyMeterDataProvider : public PowerStats::IEnergyMeterDataProvider {
+  public:
+    explicit FakeEnergyMeterDataProvider(std::atomic<int> *reads) : mReads(reads) {}
+
+    ndk::ScopedAStatus readEnergyMeter(const std::vector<int32_t> &in_channelIds,
+                                       std::vector<EnergyMeasurement> *_aidl_return) override {
+        const int read = ++*mReads;
+        for (const int32_t id : in_channelIds) {
+            _aidl_return->push_back({.id = id, .timestampMs = read, .energyUWs = 100 * read});
+        }
+        return ndk::ScopedAStatus::ok();
+    }
+
+    ndk::ScopedAStatus getEnergyMeterInfo(std::vector<Channel> *_aidl_return) override {
+        for (int32_t id = 0; id < kChannels; id++) {
+            _aidl_return->push_back(
+                    {.id = id, .name = "RAIL" + std::to_string(id), .subsystem = "SOC"});
+        }
+        return ndk::ScopedAStatus::ok();
+    }
+
+  private:
+    std::atomic<int> *mReads;
+};
+
+}  // namespace
+
+// Two state residency providers and an energy meter, with consumers that share them
+class PowerStatsSnapshotTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        mPowerStats = ndk::SharedRefBase::make<PowerStats>();
+        mPowerStats->addStateResidencyDataProvider(
+                std::make_unique<FakeStateResidencyDataProvider>(
+                        std::vector<std::string>{"CPU", "GPU"}, &mCpuGpuReads));
+        mPowerStats->addStateResidencyDataProvider(
+                std::make_unique<FakeStateResidencyDataProvider>(
+                        std::vector<std::string>{"MODEM"}, &mModemReads));
+        mPowerStats->setEnergyMeterDataProvider(
+                std::make_unique<FakeEnergyMeterDataProvider>(&mMeterReads));
+
+        // Meter consumers with a channel in common, and entity consumers, two of them over
+        // the same provider
+        mPowerStats->addEnergyConsumer(PowerStatsEnergyConsumer::createMeterConsumer(
+                mPowerStats, EnergyConsumerType::OTHER, "RAILS01", {"RAIL0", "RAIL1"}));
+        mPowerStats->addEnergyConsumer(PowerStatsEnergyConsumer::createMeterConsumer(
+                mPowerStats, EnergyConsumerType::OTHER, "RAILS12", {"RAIL1", "RAIL2"}));
+        for (const std::string entity : {"CPU", "GPU", "MODEM"}) {
+            mPowerStats->addEnergyConsumer(PowerStatsEnergyConsumer::createEntityConsumer(
+                    mPowerStats, EnergyConsumerType::OTHER, entity, entity, {{"ON", 100}}));
+        }
+    }
+
+    std::shared_ptr<PowerStats> mPowerStats;
+    std::atomic<int> mCpuGpuReads{0};
+    std::atomic<int> mModemReads{0};
+    std::atomic<int> mMeterReads{0};
+};
+
+TEST_F(PowerStatsSnapshotTest, GetEnergyConsumedReadsEachSourceOnce) {
+    std::vector<EnergyConsumerResult> results;
+
+    ASSERT_TRUE(mPowerStats->getEnergyConsumed({}, &results).isOk());
+    EXPECT_EQ(5u, results.size());
+    EXPECT_EQ(1, mCpuGpuReads);
+    EXPECT_EQ(1, mModemReads);
+    EXPECT_EQ(1, mMeterReads);
+
+    const PowerStats::ReadCounters counters = mPowerStats->getLastReadCounters();
+    EXPECT_EQ(2, counters.stateResidencyReads);
+    EXPECT_EQ(1, counters.energyMeterReads);
+    EXPECT_EQ(0, counters.stateResidencyTimeouts);
+}
+
+TEST_F(PowerStatsSnapshotTest, EachCallReadsAgain) {
+    std::vector<EnergyConsumerResult> results;
+
+    ASSERT_TRUE(mPowerStats->getEnergyConsumed({}, &results).isOk());
+    results.clear();
+    ASSERT_TRUE(mPowerStats->getEnergyConsumed({}, &results).isOk());
+    EXPECT_EQ(2, mCpuGpuReads);
+    EXPECT_EQ(2, mModemReads);
+    EXPECT_EQ(2, mMeterReads);
+
+    // The counters are of the last call only
+    const PowerStats::ReadCounters counters = mPowerStats->getLastReadCounters();
+    EXPECT_EQ(2, counters.stateResidencyReads);
+    EXPECT_EQ(1, counters.energyMeterReads);
+}
+
+TEST_F(PowerStatsSnapshotTest, GetStateResidencyReadsEachProviderOnce) {
+    std::vector<StateResidencyResult> results;
+
+    ASSERT_TRUE(mPowerStats->getStateResidency({}, &results).isOk());
+    EXPECT_EQ(3u, results.size());
+    EXPECT_EQ(1, mCpuGpuReads);
+    EXPECT_EQ(1, mModemReads);
+    EXPECT_EQ(0, mMeterReads);
+
+    const PowerStats::ReadCounters counters = mPowerStats->getLastReadCounters();
+    EXPECT_EQ(2, counters.stateResidencyReads);
+    EXPECT_EQ(0, counters.energyMeterReads);
+}
+
+TEST_F(PowerStatsSnapshotTest, ReadEnergyMeterReadsOnce) {
+    std::vector<EnergyMeasurement> measurements;
+
+    ASSERT_TRUE(mPowerStats->readEnergyMeter({}, &measurements).isOk());
+    EXPECT_EQ(static_cast<size_t>(kChannels), measurements.size());
+    EXPECT_EQ(1, mMeterReads);
+    EXPECT_EQ(1, mPowerStats->getLastReadCounters().energyMeterReads);
+}
+
+TEST_F(PowerStatsSnapshotTest, StalenessServesLaterCalls) {
+    std::vector<EnergyConsumerResult> first;
+    std::vector<EnergyConsumerResult> second;
+
+    mPowerStats->setMaxSnapshotStaleness(std::chrono::hours(1));
+    ASSERT_TRUE(mPowerStats->getEnergyConsumed({}, &first).isOk());
+    ASSERT_TRUE(mPowerStats->getEnergyConsumed({}, &second).isOk());
+    EXPECT_EQ(1, mCpuGpuReads);
+    EXPECT_EQ(1, mModemReads);
+    EXPECT_EQ(1, mMeterReads);
+
+    const PowerStats::ReadCounters counters = mPowerStats->getLastReadCounters();
+    EXPECT_EQ(0, counters.stateResidencyReads);
+    EXPECT_EQ(0, counters.energyMeterReads);
+    EXPECT_GT(counters.snapshotHits, 0);
+    ASSERT_EQ(first.size(), second.size());
+    for (size_t i = 0; i < first.size(); i++) {
+        EXPECT_EQ(first[i].energyUWs, second[i].energyUWs);
+    }
+}
+
+}  // namespace stats
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
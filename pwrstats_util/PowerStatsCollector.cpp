@@ -29,16 +29,18 @@ int PowerStatsCollector::get(std::vector<PowerStatistic>* stats) const {
         return 1;
     }
 
-    stats->clear();
+    // Reuse the entries stats already has, so that a caller sampling again and again
+    // with the same vector does not allocate them each time
+    stats->resize(mStatProviders.size());
+    auto stat = stats->begin();
     for (auto&& provider : mStatProviders) {
-        PowerStatistic stat;
-        if (provider.second->get(&stat) != 0) {
+        stat->Clear();
+        if (provider.second->get(&(*stat)) != 0) {
             LOG(ERROR) << __func__ << ": a data provider failed";
             stats->clear();
             return 1;
         }
-
-        stats->emplace_back(stat);
+        ++stat;
     }
     return 0;
 }
@@ -70,6 +72,38 @@ int PowerStatsCollector::get(const std::vector<PowerStatistic>& start,
     return 0;
 }
 
+int PowerStatsCollector::interval(const std::vector<PowerStatistic>& start,
+                                  const std::vector<PowerStatistic>& end,
+                                  std::vector<PowerStatistic>* interval) const {
+    if (!interval) {
+        LOG(ERROR) << __func__ << ": bad args; interval is null";
+        return 1;
+    }
+
+    if (start.size() != end.size()) {
+        LOG(ERROR) << __func__ << ": mismatched data";
+        interval->clear();
+        return 1;
+    }
+
+    interval->resize(end.size());
+    for (size_t i = 0; i < end.size(); ++i) {
+        auto provider = mStatProviders.find(end[i].power_stat_case());
+        if (provider == mStatProviders.end()) {
+            LOG(ERROR) << __func__ << ": a provider is missing";
+            interval->clear();
+            return 1;
+        }
+
+        if (provider->second->interval(start[i], end[i], &(*interval)[i]) != 0) {
+            LOG(ERROR) << __func__ << ": a data provider failed";
+            interval->clear();
+            return 1;
+        }
+    }
+    return 0;
+}
+
 void PowerStatsCollector::dump(const std::vector<PowerStatistic>& stats,
                                std::ostream* output) const {
     if (!output) {
@@ -116,6 +150,22 @@ int IPowerStatProvider::get(const PowerStatistic& start, PowerStatistic* interva
     return getImpl(start, interval);
 }
 
+int IPowerStatProvider::interval(const PowerStatistic& start, const PowerStatistic& end,
+                                 PowerStatistic* interval) const {
+    if (!interval) {
+        LOG(ERROR) << __func__ << ": bad args; interval is null";
+        return 1;
+    }
+
+    if (typeOf() != start.power_stat_case() || typeOf() != end.power_stat_case()) {
+        LOG(ERROR) << __func__ << ": bad args; start or end is incorrect type";
+        return 1;
+    }
+
+    interval->CopyFrom(end);
+    return getImpl(start, interval);
+}
+
 void IPowerStatProvider::dump(const PowerStatistic& stat, std::ostream* output) const {
     if (!output) {
         LOG(ERROR) << __func__ << ": bad args; output is null";
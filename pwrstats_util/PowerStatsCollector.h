@@ -34,6 +34,9 @@ class IPowerStatProvider {
     virtual ~IPowerStatProvider() = default;
     int get(PowerStatistic* stat) const;
     int get(const PowerStatistic& start, PowerStatistic* interval) const;
+    // The change from start to end, two stats this provider got before, without reading again
+    int interval(const PowerStatistic& start, const PowerStatistic& end,
+                 PowerStatistic* interval) const;
     void dump(const PowerStatistic& stat, std::ostream* output) const;
     virtual PowerStatCase typeOf() const = 0;
 
@@ -52,6 +55,10 @@ class PowerStatsCollector {
     PowerStatsCollector() = default;
     int get(std::vector<PowerStatistic>* stats) const;
     int get(const std::vector<PowerStatistic>& start, std::vector<PowerStatistic>* interval) const;
+    // As get(start, interval) with the stats of a get() at the end, so that no data provider
+    // is read again. The entries of interval are reused.
+    int interval(const std::vector<PowerStatistic>& start, const std::vector<PowerStatistic>& end,
+                 std::vector<PowerStatistic>* interval) const;
     void dump(const std::vector<PowerStatistic>& stats, std::ostream* output) const;
     void addDataProvider(std::unique_ptr<IPowerStatProvider> statProvider);
 
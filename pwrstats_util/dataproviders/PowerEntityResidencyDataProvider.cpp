@@ -105,7 +105,7 @@ int PowerEntityResidencyDataProvider::getImpl(PowerStatistic* stat) const {
 
 int PowerEntityResidencyDataProvider::getImpl(const PowerStatistic& start,
                                               PowerStatistic* interval) const {
-    auto startResidency = start.power_entity_state_residency().residency();
+    const auto& startResidency = start.power_entity_state_residency().residency();
     auto intervalResidency = interval->mutable_power_entity_state_residency()->mutable_residency();
 
     if (0 != StateResidencyInterval(startResidency, intervalResidency)) {
@@ -85,7 +85,7 @@ int RailEnergyDataProvider::getImpl(PowerStatistic* stat) const {
 }
 
 int RailEnergyDataProvider::getImpl(const PowerStatistic& start, PowerStatistic* interval) const {
-    auto startEnergy = start.rail_energy().entry();
+    const auto& startEnergy = start.rail_energy().entry();
     auto intervalEnergy = interval->mutable_rail_energy()->mutable_entry();
 
     // If start and interval are not the same size then they cannot have matching data
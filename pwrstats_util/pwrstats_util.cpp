@@ -21,6 +21,7 @@
 #include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 
 #include <algorithm>
 #include <chrono>
@@ -28,11 +29,18 @@
 #include <fstream>
 #include <iostream>
 
+#include <google/protobuf/util/delimited_message_util.h>
 #include <pwrstatsutil.pb.h>
 #include "PowerStatsCollector.h"
 
+using com::google::android::pwrstatsutil::Sample;
+
 namespace {
 volatile std::sig_atomic_t gSignalStatus;
+
+constexpr int64_t kDefaultStreamIntervalMs = 100;
+constexpr int64_t kNsPerMs = 1000000;
+constexpr int64_t kNsPerS = 1000000000;
 }
 
 static void signalHandler(int signal) {
@@ -44,40 +52,75 @@ class Options {
     bool humanReadable;
     bool daemonMode;
     std::string filePath;
+    bool streamMode;
+    std::string streamPath;  // "-" for stdout
+    int64_t streamIntervalMs;
+    int64_t streamCount;  // 0 until signaled
+    bool csv;
 };
 
 static Options parseArgs(int argc, char** argv) {
     Options opt = {
             .humanReadable = false,
             .daemonMode = false,
+            .streamMode = false,
+            .streamIntervalMs = kDefaultStreamIntervalMs,
+            .streamCount = 0,
+            .csv = false,
     };
 
     static struct option long_options[] = {/* These options set a flag. */
                                            {"human-readable", no_argument, 0, 0},
                                            {"daemon", required_argument, 0, 'd'},
+                                           {"stream", required_argument, 0, 's'},
+                                           {"interval-ms", required_argument, 0, 'i'},
+                                           {"count", required_argument, 0, 'n'},
+                                           {"csv", no_argument, 0, 0},
                                            {0, 0, 0, 0}};
 
     // getopt_long stores the option index here
     int option_index = 0;
 
     int c;
-    while ((c = getopt_long(argc, argv, "d:", long_options, &option_index)) != -1) {
+    while ((c = getopt_long(argc, argv, "d:s:i:n:", long_options, &option_index)) != -1) {
         switch (c) {
             case 0:
                 if ("human-readable" == std::string(long_options[option_index].name)) {
                     opt.humanReadable = true;
+                } else if ("csv" == std::string(long_options[option_index].name)) {
+                    opt.csv = true;
                 }
                 break;
             case 'd':
                 opt.daemonMode = true;
                 opt.filePath = std::string(optarg);
                 break;
+            case 's':
+                opt.streamMode = true;
+                opt.streamPath = std::string(optarg);
+                break;
+            case 'i':
+                opt.streamIntervalMs = std::max(1LL, std::atoll(optarg));
+                break;
+            case 'n':
+                opt.streamCount = std::max(0LL, std::atoll(optarg));
+                break;
             default: /* '?' */
                 std::cerr << "pwrstats_util: Prints out device power stats." << std::endl
                           << "--human-readable: human-readable format" << std::endl
                           << "--daemon <path/to/file>, -d <path/to/file>: daemon mode. Spawns a "
                              "daemon process and prints out its <pid>. kill -INT <pid> will "
                              "trigger a write to specified file."
+                          << std::endl
+                          << "--stream <path/to/file|->, -s <path/to/file|->: stream mode. Writes "
+                             "the change of the stats every interval, as length-delimited Sample "
+                             "protos, until kill -INT or the count is reached. - is stdout."
+                          << std::endl
+                          << "--interval-ms <ms>, -i <ms>: stream interval, "
+                          << kDefaultStreamIntervalMs << "ms by default" << std::endl
+                          << "--count <n>, -n <n>: stream n samples, then stop" << std::endl
+                          << "--csv: stream CSV rows of boottime_ns,interval_ns,kind,name,delta "
+                             "instead of protos"
                           << std::endl;
                 exit(EXIT_FAILURE);
         }
@@ -204,8 +247,147 @@ static void daemon(const Options& opt, const PowerStatsCollector& collector) {
     exit(EXIT_SUCCESS);
 }
 
+static int64_t nowNs(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * kNsPerS + ts.tv_nsec;
+}
+
+static void writeCsv(int64_t boottimeNs, int64_t intervalNs,
+                     const std::vector<PowerStatistic>& stats, std::ostream* output) {
+    auto writeResidencies = [&](const char* kind, const auto& residencies) {
+        for (auto const& residency : residencies) {
+            *output << boottimeNs << ',' << intervalNs << ',' << kind << ','
+                    << residency.entity_name() << '.' << residency.state_name() << ','
+                    << residency.time_ms() << '\n';
+        }
+    };
+
+    for (auto const& stat : stats) {
+        switch (stat.power_stat_case()) {
+            case PowerStatCase::kPowerEntityStateResidency:
+                writeResidencies("power_entity_residency_ms",
+                                 stat.power_entity_state_residency().residency());
+                break;
+            case PowerStatCase::kCStateResidency:
+                writeResidencies("c_state_residency_ms", stat.c_state_residency().residency());
+                break;
+            case PowerStatCase::kRailEnergy:
+                for (auto const& rail : stat.rail_energy().entry()) {
+                    *output << boottimeNs << ',' << intervalNs << ",rail_energy_uws,"
+                            << rail.rail_name() << ',' << rail.energy_uws() << '\n';
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void stream(const Options& opt, const PowerStatsCollector& collector) {
+    std::ofstream file;
+    std::ostream* output = &std::cout;
+    if (opt.streamPath != "-") {
+        file.open(opt.streamPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            LOG(ERROR) << "failed to open file";
+            exit(EXIT_FAILURE);
+        }
+        output = &file;
+    }
+
+    std::signal(SIGINT, signalHandler);
+    std::signal(SIGTERM, signalHandler);
+
+    // Every sample reuses these, so that the loop does not allocate once they have grown to
+    // the size of the stats
+    std::vector<PowerStatistic> prev;
+    std::vector<PowerStatistic> cur;
+    std::vector<PowerStatistic> interval;
+    Sample sample;
+
+    if (collector.get(&prev)) {
+        LOG(ERROR) << "failed to get start stats";
+        exit(EXIT_FAILURE);
+    }
+    int64_t prevNs = nowNs(CLOCK_BOOTTIME);
+
+    // Sample at a fixed rate from the start, so that the time the collection takes does not
+    // add up to a drift
+    const int64_t intervalNs = opt.streamIntervalMs * kNsPerMs;
+    int64_t deadlineNs = prevNs;
+    const int64_t startCpuNs = nowNs(CLOCK_THREAD_CPUTIME_ID);
+    const int64_t startNs = prevNs;
+    int64_t samples = 0;
+    int64_t missed = 0;
+    int64_t totalCollectNs = 0;
+    int64_t maxCollectNs = 0;
+
+    while (!gSignalStatus && (opt.streamCount == 0 || samples < opt.streamCount)) {
+        deadlineNs += intervalNs;
+        struct timespec deadline = {.tv_sec = static_cast<time_t>(deadlineNs / kNsPerS),
+                                    .tv_nsec = static_cast<long>(deadlineNs % kNsPerS)};
+        if (clock_nanosleep(CLOCK_BOOTTIME, TIMER_ABSTIME, &deadline, nullptr) != 0) {
+            // Interrupted by a signal; the loop condition sorts out which one
+            continue;
+        }
+
+        const int64_t curNs = nowNs(CLOCK_BOOTTIME);
+        if (collector.get(&cur) || collector.interval(prev, cur, &interval)) {
+            LOG(ERROR) << "failed to get interval stats";
+            exit(EXIT_FAILURE);
+        }
+
+        if (opt.csv) {
+            writeCsv(curNs, curNs - prevNs, interval, output);
+        } else {
+            sample.set_boottime_ns(curNs);
+            sample.set_interval_ns(curNs - prevNs);
+            // Swapped in and out rather than copied, so both keep their allocations
+            auto* sampleStats = sample.mutable_stat();
+            while (static_cast<size_t>(sampleStats->size()) < interval.size()) {
+                sampleStats->Add();
+            }
+            for (size_t i = 0; i < interval.size(); ++i) {
+                sampleStats->Mutable(i)->Swap(&interval[i]);
+            }
+            google::protobuf::util::SerializeDelimitedToOstream(sample, output);
+            for (size_t i = 0; i < interval.size(); ++i) {
+                sampleStats->Mutable(i)->Swap(&interval[i]);
+            }
+        }
+        output->flush();
+
+        std::swap(prev, cur);
+        prevNs = curNs;
+        ++samples;
+
+        const int64_t endNs = nowNs(CLOCK_BOOTTIME);
+        const int64_t collectNs = endNs - curNs;
+        totalCollectNs += collectNs;
+        maxCollectNs = std::max(maxCollectNs, collectNs);
+        // Skip the deadlines this sample overran rather than sampling back to back to catch up
+        if (endNs > deadlineNs + intervalNs) {
+            const int64_t overrun = (endNs - deadlineNs) / intervalNs;
+            missed += overrun;
+            deadlineNs += overrun * intervalNs;
+        }
+    }
+
+    const int64_t elapsedNs = nowNs(CLOCK_BOOTTIME) - startNs;
+    const int64_t cpuNs = nowNs(CLOCK_THREAD_CPUTIME_ID) - startCpuNs;
+    std::cerr << "samples: " << samples << ", missed deadlines: " << missed
+              << ", collect avg: " << (samples ? totalCollectNs / samples / 1000 : 0)
+              << "us, max: " << maxCollectNs / 1000 << "us, cpu: "
+              << (elapsedNs ? 100.0 * cpuNs / elapsedNs : 0.0) << "%" << std::endl;
+
+    exit(EXIT_SUCCESS);
+}
+
 static void runWithOptions(const Options& opt, const PowerStatsCollector& collector) {
-    if (opt.daemonMode) {
+    if (opt.streamMode) {
+        stream(opt, collector);
+    } else if (opt.daemonMode) {
         daemon(opt, collector);
     } else {
         snapshot(opt, collector);
@@ -33,14 +33,29 @@
  * override any settings assigned by this and assign the IRQ to the same
  * core as the code whose performance is impacted by the IRQ.
  *
+ * With --daemon, it keeps running after the one-shot distribution and every
+ * --interval=<seconds> (default 10) samples /proc/interrupts and
+ * /proc/softirqs. When the busiest Policy0 core takes clearly more interrupts
+ * and softirqs than the idlest one, it moves one of the actions it assigned
+ * from the busiest to the idlest core. An action whose affinity has been
+ * changed by anyone else since is left alone from then on.
+ *
  */
 
 #include <sys/types.h>
 #include <dirent.h>
-
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <list>
 #include <map>
+#include <string_view>
 #include <vector>
 
 #define LOG_TAG "rebalance_interrupts"
@@ -50,23 +65,47 @@
 #include <android-base/logging.h>
 #include <android-base/parseint.h>
 #include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 
 
 #define POLICY0_CORES_PATH "/sys/devices/system/cpu/cpufreq/policy0/affected_cpus"
 #define SYSFS_IRQDIR "/sys/kernel/irq"
 #define PROC_IRQDIR "/proc/irq"
-
+#define PROC_INTERRUPTS "/proc/interrupts"
+#define PROC_SOFTIRQS "/proc/softirqs"
+
+// Seconds between samples in daemon mode
+constexpr unsigned kDefaultIntervalSecs = 10;
+// Interrupts and softirqs per second the busiest core must take over the
+// idlest one, and the ratio of their loads, before anything is moved
+constexpr double kMinImbalancePerSec = 500.0;
+constexpr double kMinImbalanceRatio = 1.5;
+// Samples an action stays put after it is moved
+constexpr int kMoveCooldownSamples = 6;
+
+// Large enough for the CPUs of any device this runs on
+constexpr size_t kMaxCpus = 64;
+using CpuMask = std::bitset<kMaxCpus>;
+
+using android::base::Join;
 using android::base::ParseInt;
 using android::base::ParseUint;
 using android::base::ReadFileToString;
+using android::base::StartsWith;
 using android::base::Trim;
-using android::base::WriteStringToFile;
-using std::list;
+using android::base::unique_fd;
 using std::map;
 using std::pair;
 using std::string;
+using std::string_view;
 using std::vector;
 
+// The IRQs sharing one driver "action", which are all kept on one core.
+struct IrqAction {
+  string action;
+  vector<unsigned> irqs;
+};
+
 // Return a vector of strings describing the affected CPUs for cpufreq
 // Policy 0.
 vector<int> Policy0AffectedCpus() {
@@ -86,140 +125,180 @@ vector<int> Policy0AffectedCpus() {
   return cpus_as_int;
 }
 
-// Return a vector of strings describing the CPU masks for cpufreq Policy 0.
-vector<string> Policy0CpuMasks() {
-  vector<int> cpus = Policy0AffectedCpus();
-  vector<string> cpu_masks;
-  for (int i = 0; i < cpus.size(); ++i)
-    cpu_masks.push_back(fmt::format("{0:02x}", 1 << cpus[i]));
-  return cpu_masks;
-}
-
-// Read the actions for the given irq# from sysfs, and add it to action_to_irq
-bool AddEntryToIrqmap(const char* irq,
-                      map<string, list<string>>& action_to_irqs) {
-  const string irq_base(SYSFS_IRQDIR "/");
-  string irq_actions_path = irq_base + irq + "/actions";
-
-  string irq_actions;
-  if (!ReadFileToString(irq_actions_path, &irq_actions))
+// Read a small sysfs or procfs file relative to dir_fd into buf, with
+// trailing whitespace trimmed. Returns false if it can't be read.
+bool ReadAt(int dir_fd, const char* path, char* buf, size_t size, string_view* contents) {
+  unique_fd fd(TEMP_FAILURE_RETRY(openat(dir_fd, path, O_RDONLY | O_CLOEXEC)));
+  if (fd < 0)
     return false;
+  ssize_t len = TEMP_FAILURE_RETRY(read(fd, buf, size));
+  if (len < 0)
+    return false;
+  while (len > 0 && isspace(buf[len - 1]))
+    --len;
+  *contents = string_view(buf, len);
+  return true;
+}
 
-  irq_actions = Trim(irq_actions);
-
-  if (irq_actions == "(null)")
-    irq_actions = "";
-
-  action_to_irqs[irq_actions].push_back(irq);
+// Parse an smp_affinity mask: hex digits, in comma separated groups of
+// eight on devices with more than 32 CPUs.
+bool ParseCpuMask(string_view hex, CpuMask* mask) {
+  mask->reset();
+  size_t bit = 0;
+  for (auto it = hex.rbegin(); it != hex.rend(); ++it) {
+    if (*it == ',')
+      continue;
+    int digit;
+    if (*it >= '0' && *it <= '9')
+      digit = *it - '0';
+    else if (*it >= 'a' && *it <= 'f')
+      digit = *it - 'a' + 10;
+    else if (*it >= 'A' && *it <= 'F')
+      digit = *it - 'A' + 10;
+    else
+      return false;
+    for (int i = 0; i < 4; ++i, ++bit) {
+      if (digit & (1 << i)) {
+        if (bit >= kMaxCpus)
+          return false;
+        mask->set(bit);
+      }
+    }
+  }
+  return !hex.empty();
+}
 
+// Call fn with the number of each IRQ directory in dir. . and .. and anything
+// else that isn't a parsable number are skipped.
+template <typename Fn>
+bool ForEachIrq(DIR* dir, Fn fn) {
+  struct dirent* entry;
+  while ((entry = readdir(dir))) {
+    unsigned irq;
+    if (!ParseUint(entry->d_name, &irq))
+      continue;
+    fn(irq, entry->d_name);
+  }
   return true;
 }
 
-// Get a mapping of driver "action" to IRQ#s for each IRQ# in
-// SYSFS_IRQDIR.
-bool GetIrqmap(map<string, list<string>>& action_to_irqs) {
-  bool some_success = false;
+// Get the IRQ#s in SYSFS_IRQDIR grouped by their driver "action", in order of
+// action. IRQs with no action each get a group of their own.
+bool GetIrqmap(vector<IrqAction>& actions) {
   std::unique_ptr<DIR, decltype(&closedir)> irq_dir(opendir(SYSFS_IRQDIR), closedir);
   if (!irq_dir) {
     PLOG(ERROR) << "opening dir " SYSFS_IRQDIR;
     return false;
   }
 
-  struct dirent* entry;
-  while ((entry = readdir(irq_dir.get()))) {
-
-    // If the directory entry isn't a parsable number, skip it.
-    // . and .. get skipped here.
-    unsigned throwaway;
-    if (!ParseUint(entry->d_name, &throwaway))
-      continue;
+  vector<pair<string, unsigned>> entries;
+  char buf[256];
+  ForEachIrq(irq_dir.get(), [&](unsigned irq, const char* name) {
+    char path[32];
+    snprintf(path, sizeof(path), "%s/actions", name);
+    string_view irq_actions;
+    if (!ReadAt(dirfd(irq_dir.get()), path, buf, sizeof(buf), &irq_actions))
+      return;
+    if (irq_actions == "(null)")
+      irq_actions = "";
+    entries.emplace_back(string(irq_actions), irq);
+  });
+  if (entries.empty())
+    return false;
 
-    some_success |= AddEntryToIrqmap(entry->d_name, action_to_irqs);
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const auto& a, const auto& b) { return a.first < b.first; });
+  for (const auto& entry : entries) {
+    if (entry.first.empty() || actions.empty() || actions.back().action != entry.first)
+      actions.push_back({entry.first, {}});
+    actions.back().irqs.push_back(entry.second);
   }
-  return some_success;
+  return true;
 }
 
-// Given a map of irq actions -> IRQs,
-// find out which ones haven't been assigned and add those to
-// rebalance_actions.
-void FindUnassignedIrqs(const map<string, list<string>>& action_to_irqs,
-                        list<pair<string, list<string>>>& rebalance_actions) {
-  for (const auto &action_to_irqs_entry: action_to_irqs) {
+// Given the IRQs grouped by action, find out which ones haven't been
+// assigned and add those to rebalance_actions.
+void FindUnassignedIrqs(const vector<IrqAction>& actions,
+                        vector<IrqAction>& rebalance_actions) {
+  unique_fd proc_irq_fd(open(PROC_IRQDIR, O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+  if (proc_irq_fd < 0) {
+    PLOG(ERROR) << "opening dir " PROC_IRQDIR;
+    return;
+  }
+
+  // On ARM interrupt controllers under Linux, if an IRQ is assigned to
+  // more than one core it will only be assigned to the lowest core.
+  // Assume any IRQ which is set to more than one core in the lowest four
+  // CPUs hasn't been assigned and needs to be rebalanced.
+  const CpuMask low_cpus(0xf);
+  for (const auto& action : actions) {
     bool rebalance = true;
-    for (const auto& irq: action_to_irqs_entry.second) {
-      string smp_affinity;
-      string proc_path(PROC_IRQDIR "/");
-      proc_path += irq + "/smp_affinity";
-      ReadFileToString(proc_path, &smp_affinity);
-      smp_affinity = Trim(smp_affinity);
-
-      // Try to respect previoulsy set IRQ affinities.
-      // On ARM interrupt controllers under Linux, if an IRQ is assigned
-      // to more than one core it will only be assigned to the lowest core.
-      // Assume any IRQ which is set to more than one core in the lowest four
-      // CPUs hasn't been assigned and needs to be rebalanced.
-      if (smp_affinity.back() == '0' ||
-          smp_affinity.back() == '1' ||
-          smp_affinity.back() == '2' ||
-          smp_affinity.back() == '4' ||
-          smp_affinity.back() == '8') {
+    for (unsigned irq : action.irqs) {
+      char path[32];
+      char buf[64];
+      string_view smp_affinity;
+      CpuMask mask;
+      snprintf(path, sizeof(path), "%u/smp_affinity", irq);
+      // Try to respect previoulsy set IRQ affinities, and leave alone any
+      // whose affinity can't be read.
+      if (!ReadAt(proc_irq_fd, path, buf, sizeof(buf), &smp_affinity) ||
+          !ParseCpuMask(smp_affinity, &mask) || (mask & low_cpus).count() <= 1) {
         rebalance = false;
       }
 
       // Treat each unnamed action IRQ as independent.
-      if (action_to_irqs_entry.first.empty()) {
-        if (rebalance) {
-          pair<string, list<string>> empty_action_irq;
-          empty_action_irq.first = "";
-          empty_action_irq.second.push_back(irq);
-          rebalance_actions.push_back(empty_action_irq);
-        }
+      if (action.action.empty()) {
+        if (rebalance)
+          rebalance_actions.push_back({"", {irq}});
         rebalance = true;
       }
     }
-    if (rebalance && !action_to_irqs_entry.first.empty()) {
-      rebalance_actions.push_back(std::make_pair(action_to_irqs_entry.first,
-                                                 action_to_irqs_entry.second));
-    }
+    if (rebalance && !action.action.empty())
+      rebalance_actions.push_back(action);
   }
 }
 
-// Read the file at `path`, Trim whitespace, see if it matches `expected_value`.
-// Print the results to stdout.
-void ReportIfAffinityUpdated(const std::string expected_value,
-                             const std::string path) {
-  std::string readback, report;
-  ReadFileToString(path, &readback);
-  readback = Trim(readback);
-  if (readback != expected_value) {
-    report += "Unable to set ";
-  } else {
-    report += "Success setting ";
+// Write mask to the smp_affinity of irq. The kernel rejects a mask it can't
+// apply, so only a failed write is read back to report what was left there.
+bool SetIrqAffinity(int proc_irq_fd, unsigned irq, const string& mask) {
+  char path[32];
+  snprintf(path, sizeof(path), "%u/smp_affinity", irq);
+  unique_fd fd(TEMP_FAILURE_RETRY(openat(proc_irq_fd, path, O_WRONLY | O_CLOEXEC)));
+  if (fd >= 0 && TEMP_FAILURE_RETRY(write(fd, mask.data(), mask.size())) ==
+                         static_cast<ssize_t>(mask.size())) {
+    LOG(DEBUG) << "Success setting " PROC_IRQDIR "/" << path << " to " << mask;
+    return true;
   }
-  report += path;
-  report += ": found " + readback + " vs " + expected_value + "\n";
-  LOG(DEBUG) << report;
+
+  int saved_errno = errno;
+  char buf[64];
+  string_view readback;
+  ReadAt(proc_irq_fd, path, buf, sizeof(buf), &readback);
+  LOG(DEBUG) << "Unable to set " PROC_IRQDIR "/" << path << ": found " << readback << " vs "
+             << mask << ": " << strerror(saved_errno);
+  return false;
 }
 
 // Evenly distribute the IRQ actions across all the Policy0 CPUs.
 // Assign all the IRQs of an action to a single CPU core.
-bool RebalanceIrqs(const list<pair<string, list<string>>>& action_to_irqs) {
-  int mask_index = 0;
-  std::vector<std::string> affinity_masks = Policy0CpuMasks();
-
-  if (affinity_masks.empty()) {
+bool RebalanceIrqs(const vector<IrqAction>& actions) {
+  vector<int> cpus = Policy0AffectedCpus();
+  if (cpus.empty()) {
     LOG(ERROR) << "Unable to find Policy0 CPUs for IRQ assignment.";
     return false;
   }
+  unique_fd proc_irq_fd(open(PROC_IRQDIR, O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+  if (proc_irq_fd < 0) {
+    PLOG(ERROR) << "opening dir " PROC_IRQDIR;
+    return false;
+  }
 
-  for (const auto &action_to_irq: action_to_irqs) {
-    for (const auto& irq: action_to_irq.second) {
-      std::string affinity_path(PROC_IRQDIR "/");
-      affinity_path += irq + "/smp_affinity";
-      WriteStringToFile(affinity_masks[mask_index], affinity_path);
-      ReportIfAffinityUpdated(affinity_masks[mask_index], affinity_path);
-    }
-    mask_index = (mask_index + 1) % affinity_masks.size();
+  int mask_index = 0;
+  for (const auto& action : actions) {
+    const string mask = fmt::format("{0:02x}", 1 << cpus[mask_index]);
+    for (unsigned irq : action.irqs)
+      SetIrqAffinity(proc_irq_fd, irq, mask);
+    mask_index = (mask_index + 1) % cpus.size();
   }
   return true;
 }
@@ -231,29 +310,251 @@ void ChownIrqAffinity() {
         return;
     }
 
-    struct dirent *entry;
-    while ((entry = readdir(irq_dir.get()))) {
-        // If the directory entry isn't a parsable number, skip it.
-        // . and .. get skipped here.
-        unsigned throwaway;
-        if (!ParseUint(entry->d_name, &throwaway))
-            continue;
-
-        string affinity_path(PROC_IRQDIR "/");
-        affinity_path += entry->d_name;
-        affinity_path += "/smp_affinity";
-        chown(affinity_path.c_str(), 1000, 1000);
-
-        string affinity_list_path(PROC_IRQDIR "/");
-        affinity_list_path += entry->d_name;
-        affinity_list_path += "/smp_affinity_list";
-        chown(affinity_list_path.c_str(), 1000, 1000);
+    ForEachIrq(irq_dir.get(), [&](unsigned /* irq */, const char* name) {
+        char path[64];
+        snprintf(path, sizeof(path), "%s/smp_affinity", name);
+        fchownat(dirfd(irq_dir.get()), path, 1000, 1000, 0);
+        snprintf(path, sizeof(path), "%s/smp_affinity_list", name);
+        fchownat(dirfd(irq_dir.get()), path, 1000, 1000, 0);
+    });
+}
+
+// Counts from /proc/interrupts or /proc/softirqs: the total of each numbered
+// IRQ over all CPUs, in the ascending order of the file, and the total of
+// each CPU over all the lines counted.
+struct InterruptCounts {
+  vector<pair<unsigned, uint64_t>> irq_totals;
+  vector<uint64_t> cpu_totals;
+
+  // The total of irq, or 0 if it wasn't listed.
+  uint64_t IrqTotal(unsigned irq) const {
+    auto it = std::lower_bound(
+            irq_totals.begin(), irq_totals.end(), irq,
+            [](const auto& entry, unsigned value) { return entry.first < value; });
+    return it != irq_totals.end() && it->first == irq ? it->second : 0;
+  }
+};
+
+// Parse the per-CPU table of /proc/interrupts or /proc/softirqs in a single
+// pass. The first line names the CPU columns. With numbered_only, lines not
+// labelled with an IRQ number (IPIs, Err) are skipped, as they can't be moved.
+bool ReadInterruptCounts(const char* path, bool numbered_only,
+                         InterruptCounts* counts) {
+  string contents;
+  if (!ReadFileToString(path, &contents)) {
+    PLOG(ERROR) << "reading " << path;
+    return false;
+  }
+
+  const char* p = contents.c_str();
+  const char* end = p + contents.size();
+  const char* eol = std::find(p, end, '\n');
+  size_t ncpus = 0;
+  for (const char* q = p; q + 3 <= eol; ++q) {
+    if (q[0] == 'C' && q[1] == 'P' && q[2] == 'U')
+      ++ncpus;
+  }
+  counts->irq_totals.clear();
+  counts->cpu_totals.assign(ncpus, 0);
+
+  for (p = eol; p < end; p = eol) {
+    ++p;
+    eol = std::find(p, end, '\n');
+    while (p < eol && *p == ' ')
+      ++p;
+    const char* colon = std::find(p, eol, ':');
+    if (colon == eol)
+      continue;
+    unsigned irq;
+    bool numbered = ParseUint(string(p, colon), &irq);
+    if (numbered_only && !numbered)
+      continue;
+
+    uint64_t total = 0;
+    char* next = const_cast<char*>(colon + 1);
+    for (size_t cpu = 0; cpu < ncpus; ++cpu) {
+      char* parsed;
+      uint64_t count = strtoull(next, &parsed, 10);
+      if (parsed == next || parsed > eol)
+        break;
+      counts->cpu_totals[cpu] += count;
+      total += count;
+      next = parsed;
+    }
+    if (numbered)
+      counts->irq_totals.emplace_back(irq, total);
+  }
+  return ncpus > 0;
+}
+
+// An action assigned by RebalanceIrqs, which the daemon may move again.
+struct ManagedAction {
+  string name;
+  vector<unsigned> irqs;
+  int cpu;
+  bool managed = true;
+  int cooldown = 0;
+  double rate = 0;
+};
+
+// Whether every IRQ of the action is still set to the core it was last given.
+bool StillManaged(int proc_irq_fd, const ManagedAction& action) {
+  for (unsigned irq : action.irqs) {
+    char path[32];
+    char buf[64];
+    string_view smp_affinity;
+    CpuMask mask;
+    snprintf(path, sizeof(path), "%u/smp_affinity", irq);
+    if (!ReadAt(proc_irq_fd, path, buf, sizeof(buf), &smp_affinity) ||
+        !ParseCpuMask(smp_affinity, &mask) || mask != CpuMask().set(action.cpu))
+      return false;
+  }
+  return true;
+}
+
+// Move the action that best evens out the load between the busiest and the
+// idlest of the cpus, if they are far enough apart. Returns true on a move.
+bool MoveOneAction(int proc_irq_fd, const vector<int>& cpus, const map<int, double>& cpu_load,
+                   vector<ManagedAction>& actions) {
+  int busiest = cpus.front();
+  int idlest = cpus.front();
+  for (int cpu : cpus) {
+    if (cpu_load.at(cpu) > cpu_load.at(busiest))
+      busiest = cpu;
+    if (cpu_load.at(cpu) < cpu_load.at(idlest))
+      idlest = cpu;
+  }
+  double gap = cpu_load.at(busiest) - cpu_load.at(idlest);
+  if (gap < kMinImbalancePerSec ||
+      cpu_load.at(busiest) < cpu_load.at(idlest) * kMinImbalanceRatio)
+    return false;
+
+  // Moving rate r leaves the two cores r - gap / 2 from even, and only
+  // lowers the busiest load while r < gap.
+  ManagedAction* best = nullptr;
+  for (auto& action : actions) {
+    if (!action.managed || action.cpu != busiest || action.cooldown > 0 ||
+        action.rate <= 0 || action.rate >= gap)
+      continue;
+    if (!best || std::abs(action.rate - gap / 2) < std::abs(best->rate - gap / 2))
+      best = &action;
+  }
+  if (!best)
+    return false;
+
+  if (!StillManaged(proc_irq_fd, *best)) {
+    LOG(INFO) << "'" << best->name << "' was reassigned elsewhere, leaving it there";
+    best->managed = false;
+    return false;
+  }
+
+  const string mask = fmt::format("{0:02x}", 1 << idlest);
+  for (unsigned irq : best->irqs)
+    SetIrqAffinity(proc_irq_fd, irq, mask);
+  LOG(INFO) << fmt::format("Moved '{}' (IRQ {}, {:.0f}/s) from CPU{} ({:.0f}/s) "
+                           "to CPU{} ({:.0f}/s)",
+                           best->name, Join(best->irqs, ","), best->rate, busiest,
+                           cpu_load.at(busiest), idlest, cpu_load.at(idlest));
+  best->cpu = idlest;
+  best->cooldown = kMoveCooldownSamples;
+  return true;
+}
+
+// Sample the interrupt and softirq counts every interval_secs and move one
+// action at a time off the busiest Policy0 core. Only returns on error.
+int RunDaemon(const vector<IrqAction>& rebalanced_actions, unsigned interval_secs) {
+  vector<int> cpus = Policy0AffectedCpus();
+  if (cpus.empty()) {
+    LOG(ERROR) << "Unable to find Policy0 CPUs for IRQ assignment.";
+    return 1;
+  }
+  unique_fd proc_irq_fd(open(PROC_IRQDIR, O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+  if (proc_irq_fd < 0) {
+    PLOG(ERROR) << "opening dir " PROC_IRQDIR;
+    return 1;
+  }
+
+  // RebalanceIrqs handed the actions out round-robin in this order.
+  vector<ManagedAction> actions;
+  for (const auto& rebalanced : rebalanced_actions) {
+    ManagedAction action;
+    action.name = rebalanced.action.empty() ? "IRQ " + std::to_string(rebalanced.irqs.front())
+                                            : rebalanced.action;
+    action.irqs = rebalanced.irqs;
+    action.cpu = cpus[actions.size() % cpus.size()];
+    actions.push_back(action);
+  }
+
+  InterruptCounts prev_irqs, prev_softirqs;
+  ReadInterruptCounts(PROC_INTERRUPTS, true, &prev_irqs);
+  ReadInterruptCounts(PROC_SOFTIRQS, false, &prev_softirqs);
+  auto prev_time = std::chrono::steady_clock::now();
+
+  while (true) {
+    sleep(interval_secs);
+
+    InterruptCounts irqs, softirqs;
+    if (!ReadInterruptCounts(PROC_INTERRUPTS, true, &irqs) ||
+        !ReadInterruptCounts(PROC_SOFTIRQS, false, &softirqs)) {
+      return 1;
+    }
+    auto now = std::chrono::steady_clock::now();
+    double secs = std::chrono::duration<double>(now - prev_time).count();
+
+    map<int, double> cpu_load;
+    for (int cpu : cpus) {
+      size_t column = cpu;
+      double load = 0;
+      if (column < irqs.cpu_totals.size() && column < prev_irqs.cpu_totals.size())
+        load += irqs.cpu_totals[column] - prev_irqs.cpu_totals[column];
+      if (column < softirqs.cpu_totals.size() && column < prev_softirqs.cpu_totals.size())
+        load += softirqs.cpu_totals[column] - prev_softirqs.cpu_totals[column];
+      cpu_load[cpu] = load / secs;
     }
+    for (auto& action : actions) {
+      uint64_t delta = 0;
+      for (unsigned irq : action.irqs) {
+        uint64_t total = irqs.IrqTotal(irq);
+        uint64_t prev_total = prev_irqs.IrqTotal(irq);
+        if (total > prev_total)
+          delta += total - prev_total;
+      }
+      action.rate = delta / secs;
+      if (action.cooldown > 0)
+        --action.cooldown;
+    }
+
+    MoveOneAction(proc_irq_fd, cpus, cpu_load, actions);
+
+    prev_irqs = std::move(irqs);
+    prev_softirqs = std::move(softirqs);
+    prev_time = now;
+  }
 }
 
-int main(int /* argc */, char* /* argv */[]) {
-  map<string, list<string>> irq_mapping;
-  list<pair<string, list<string>>> action_to_irqs;
+int main(int argc, char* argv[]) {
+  bool daemon = false;
+  unsigned interval_secs = kDefaultIntervalSecs;
+  for (int i = 1; i < argc; ++i) {
+    string arg(argv[i]);
+    bool valid = true;
+    if (arg == "--daemon") {
+      daemon = true;
+    } else if (StartsWith(arg, "--interval=")) {
+      valid = ParseUint(arg.substr(strlen("--interval=")), &interval_secs, 3600u) &&
+              interval_secs > 0;
+    } else {
+      valid = false;
+    }
+    if (!valid) {
+      LOG(ERROR) << "Usage: " << argv[0] << " [--daemon [--interval=<seconds>]]";
+      return 1;
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  vector<IrqAction> irq_mapping;
+  vector<IrqAction> rebalance_actions;
 
   // Find the mapping of "irq actions" to IRQs.
   // Each IRQ has an assocatied irq_actions field, showing the actions
@@ -273,9 +574,19 @@ int main(int /* argc */, char* /* argv */[]) {
   // good reason (like some drivers have an IRQ per core, for per-core
   // queues.)  Find the set of IRQs that haven't been mapped to specific
   // cores.
-  FindUnassignedIrqs(irq_mapping, action_to_irqs);
+  FindUnassignedIrqs(irq_mapping, rebalance_actions);
 
   // Distribute the rebalancable IRQs across all cores.
-  return RebalanceIrqs(action_to_irqs) ? 0 : 1;
+  if (!RebalanceIrqs(rebalance_actions))
+    return 1;
+
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  LOG(INFO) << fmt::format(
+          "Rebalanced {} of {} IRQ actions in {} us", rebalance_actions.size(),
+          irq_mapping.size(),
+          std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+
+  // Keep moving them off any core their load piles up on.
+  return daemon ? RunDaemon(rebalance_actions, interval_secs) : 0;
 }
 
@@ -18,6 +18,9 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <chrono>
+#include <functional>
+#include <future>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -113,6 +116,18 @@ bool ProvisionSilentOtaFlag(const std::string& reason) {
     return true;
 }
 
+/** Run a step of the wipe, reporting its outcome and duration on the UI. */
+bool RunWipeStep(::RecoveryUI *const ui, const char *name, const std::function<bool()> &step) {
+    const auto start = std::chrono::steady_clock::now();
+    const bool success = step();
+    const long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+    ui->Print("%s %s (%lld ms)\n", name, success ? "done" : "failed", ms);
+    LOG(INFO) << name << (success ? " done" : " failed") << " in " << ms << " ms";
+    return success;
+}
+
 }  // namespace
 
 class PixelDevice : public ::Device {
@@ -122,40 +137,52 @@ class PixelDevice : public ::Device {
     /** Hook to wipe user data not stored in /data */
     bool PostWipeData() override {
         // Try to do everything but report a failure if anything wasn't successful
-        bool totalSuccess = false;
         ::RecoveryUI* const ui = GetUI();
+        auto reason = GetReason();
+        CHECK(reason.has_value());
 
         ui->Print("Wiping Titan M...\n");
 
-        uint32_t retries = 5;
-        while (retries--) {
-            if (WipeTitanM()) {
-                totalSuccess = true;
-                break;
+        // Titan M and the misc partition are independent, so wipe them at the same time.
+        // The device WipeKeys may use Titan M as well, so it runs after the Titan M wipe.
+        std::future<bool> titanWiped = std::async(std::launch::async, [ui]() {
+            bool success = RunWipeStep(ui, "Titan M wipe", []() {
+                uint32_t retries = 5;
+                while (retries--) {
+                    if (WipeTitanM()) {
+                        return true;
+                    }
+                }
+                return false;
+            });
+            if (!RunWipeStep(ui, "Keys wipe", [ui]() { return WipeKeysHook(ui); })) {
+                success = false;
             }
-        }
+            return success;
+        });
 
-        if (!WipeKeysHook(ui)) {
+        // The misc steps write small flags next to other data, so they are written in place
+        // one after another rather than discarded.
+        bool totalSuccess = true;
+        if (!RunWipeStep(ui, "Provisioned flag wipe", WipeProvisionedFlag)) {
             totalSuccess = false;
         }
 
-        if (!WipeProvisionedFlag()) {
-            totalSuccess = false;
-        }
-
-        if (!WipeUserPreferredResolution()) {
+        if (!RunWipeStep(ui, "Preferred resolution wipe", WipeUserPreferredResolution)) {
             totalSuccess = false;
         }
 
         // Extendable to wipe other components
 
         // Additional behavior along with wiping data
-        auto reason = GetReason();
-        CHECK(reason.has_value());
         if (!ProvisionSilentOtaFlag(reason.value())) {
             totalSuccess = false;
         }
 
+        if (!titanWiped.get()) {
+            totalSuccess = false;
+        }
+
         return totalSuccess;
     }
 };
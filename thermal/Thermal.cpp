@@ -40,6 +40,9 @@ ndk::ScopedAStatus readErrorStatus() {
             EX_ILLEGAL_STATE, "ThermalHal cannot read any sensor data");
 }
 
+// Distinct sensors a callback can be behind on before the oldest one is dropped
+constexpr size_t kMaxPendingNotifications = 64;
+
 bool interfacesEqual(const std::shared_ptr<::ndk::ICInterface> left,
                      const std::shared_ptr<::ndk::ICInterface> right) {
     if (left == nullptr || right == nullptr || !left->isRemote() || !right->isRemote()) {
@@ -59,6 +62,13 @@ Thermal::Thermal(const std::shared_ptr<ThermalHelper> &helper) {
     thermal_helper_ = helper;
 }
 
+Thermal::~Thermal() {
+    std::lock_guard<std::mutex> _lock(thermal_callback_mutex_);
+    for (const auto &queue : callbacks_) {
+        queue->stop();
+    }
+}
+
 ndk::ScopedAStatus Thermal::getTemperatures(std::vector<Temperature> *_aidl_return) {
     return getFilteredTemperatures(false, TemperatureType::UNKNOWN, _aidl_return);
 }
@@ -147,11 +157,13 @@ ndk::ScopedAStatus Thermal::unregisterThermalChangedCallback(
     callbacks_.erase(
             std::remove_if(
                     callbacks_.begin(), callbacks_.end(),
-                    [&](const CallbackSetting &c) {
+                    [&](const std::shared_ptr<CallbackQueue> &q) {
+                        const auto &c = q->setting();
                         if (interfacesEqual(c.callback, callback)) {
                             LOG(INFO)
                                     << "a callback has been unregistered to ThermalHAL, isFilter: "
                                     << c.is_filter_type << " Type: " << toString(c.type);
+                            q->stop();
                             removed = true;
                             return true;
                         }
@@ -177,36 +189,37 @@ ndk::ScopedAStatus Thermal::registerThermalChangedCallback(
         return initErrorStatus();
     }
     std::lock_guard<std::mutex> _lock(thermal_callback_mutex_);
-    if (std::any_of(callbacks_.begin(), callbacks_.end(), [&](const CallbackSetting &c) {
-            return interfacesEqual(c.callback, callback);
-        })) {
+    if (std::any_of(callbacks_.begin(), callbacks_.end(),
+                    [&](const std::shared_ptr<CallbackQueue> &q) {
+                        return interfacesEqual(q->setting().callback, callback);
+                    })) {
         return ndk::ScopedAStatus::fromExceptionCodeWithMessage(EX_ILLEGAL_ARGUMENT,
                                                                 "Callback already registered");
     }
-    auto c = callbacks_.emplace_back(callback, filterType, type);
-    LOG(INFO) << "a callback has been registered to ThermalHAL, isFilter: " << c.is_filter_type
-              << " Type: " << toString(c.type);
+    auto queue = std::make_shared<CallbackQueue>(CallbackSetting(callback, filterType, type));
+    queue->start();
+    callbacks_.push_back(queue);
+    LOG(INFO) << "a callback has been registered to ThermalHAL, isFilter: " << filterType
+              << " Type: " << toString(type);
     // Send notification right away after successful thermal callback registration
-    std::function<void()> handler = [this, c, filterType, type]() {
+    std::function<void()> handler = [this, queue, filterType, type]() {
         std::vector<Temperature> temperatures;
         if (thermal_helper_->fillCurrentTemperatures(filterType, true, type, &temperatures)) {
             std::lock_guard<std::mutex> _lock(thermal_callback_mutex_);
-            auto it = std::find_if(callbacks_.begin(), callbacks_.end(),
-                                   [&](const CallbackSetting &cc) {
-                                       return interfacesEqual(c.callback, cc.callback);
-                                   });
+            auto it = std::find(callbacks_.begin(), callbacks_.end(), queue);
             if (it != callbacks_.end()) {
-                if (AIBinder_isAlive(c.callback->asBinder().get())) {
+                if (AIBinder_isAlive(queue->setting().callback->asBinder().get())) {
                     for (const auto &t : temperatures) {
                         if (!filterType || t.type == type) {
                             LOG(INFO) << "Sending notification: "
                                       << " Type: " << toString(t.type) << " Name: " << t.name
                                       << " CurrentValue: " << t.value
                                       << " ThrottlingStatus: " << toString(t.throttlingStatus);
-                            c.callback->notifyThrottling(t);
+                            queue->enqueue(t);
                         }
                     }
                 } else {
+                    queue->stop();
                     callbacks_.erase(it);
                 }
             }
@@ -224,17 +237,21 @@ void Thermal::sendThermalChangedCallback(const Temperature &t) {
                  << " CurrentValue: " << t.value
                  << " ThrottlingStatus: " << toString(t.throttlingStatus);
 
+    // Clients only register once the helper is set
+    const auto emul_script_report =
+            callbacks_.empty() ? nullptr : thermal_helper_->getEmulScriptReport();
+    // Only queue the notification here, each client gets it from its own thread
     callbacks_.erase(std::remove_if(callbacks_.begin(), callbacks_.end(),
-                                    [&](const CallbackSetting &c) {
+                                    [&](const std::shared_ptr<CallbackQueue> &q) {
+                                        if (q->isDead()) {
+                                            LOG(ERROR) << "a Thermal callback is dead, removed "
+                                                          "from callback list.";
+                                            q->stop();
+                                            return true;
+                                        }
+                                        const auto &c = q->setting();
                                         if (!c.is_filter_type || t.type == c.type) {
-                                            ::ndk::ScopedAStatus ret =
-                                                    c.callback->notifyThrottling(t);
-                                            if (!ret.isOk()) {
-                                                LOG(ERROR) << "a Thermal callback is dead, removed "
-                                                              "from callback list.";
-                                                return true;
-                                            }
-                                            return false;
+                                            q->enqueue(t, emul_script_report);
                                         }
                                         return false;
                                     }),
@@ -373,7 +390,8 @@ void Thermal::dumpVtEstimatorInfo(std::ostringstream *dump_buf) {
 void Thermal::dumpThrottlingInfo(std::ostringstream *dump_buf) {
     *dump_buf << "getThrottlingInfo:" << std::endl;
     const auto &map = thermal_helper_->GetSensorInfoMap();
-    const auto &thermal_throttling_status_map = thermal_helper_->GetThermalThrottlingStatusMap();
+    const auto thermal_throttling_status_map =
+            thermal_helper_->GetThermalThrottlingStatusSnapshot();
     for (const auto &name_info_pair : map) {
         if (name_info_pair.second.throttling_info == nullptr) {
             continue;
@@ -506,7 +524,8 @@ void Thermal::dumpThrottlingInfo(std::ostringstream *dump_buf) {
 }
 
 void Thermal::dumpThrottlingRequestStatus(std::ostringstream *dump_buf) {
-    const auto &thermal_throttling_status_map = thermal_helper_->GetThermalThrottlingStatusMap();
+    const auto thermal_throttling_status_map =
+            thermal_helper_->GetThermalThrottlingStatusSnapshot();
     if (!thermal_throttling_status_map.size()) {
         return;
     }
@@ -557,7 +576,7 @@ void Thermal::dumpThrottlingRequestStatus(std::ostringstream *dump_buf) {
 
 void Thermal::dumpPowerRailInfo(std::ostringstream *dump_buf) {
     const auto &power_rail_info_map = thermal_helper_->GetPowerRailInfoMap();
-    const auto &power_status_map = thermal_helper_->GetPowerStatusMap();
+    const auto power_status_map = thermal_helper_->GetPowerStatusSnapshot();
 
     *dump_buf << "getPowerRailInfo:" << std::endl;
     for (const auto &power_rail_pair : power_rail_info_map) {
@@ -695,161 +714,251 @@ void Thermal::dumpThermalStats(std::ostringstream *dump_buf) {
     }
 }
 
-void Thermal::dumpThermalData(int fd, const char **args, uint32_t numArgs) {
-    std::ostringstream dump_buf;
+void Thermal::dumpCachedTemperatures(std::ostringstream *dump_buf) {
+    *dump_buf << "getCachedTemperatures:" << std::endl;
+    const auto sensor_status_map = thermal_helper_->GetSensorStatusSnapshot();
+    boot_clock::time_point now = boot_clock::now();
+    for (const auto &sensor_status_pair : sensor_status_map) {
+        if ((sensor_status_pair.second.thermal_cached.timestamp) == boot_clock::time_point::min()) {
+            continue;
+        }
+        *dump_buf << " Name: " << sensor_status_pair.first
+                  << " CachedValue: " << sensor_status_pair.second.thermal_cached.temp
+                  << " TimeToCache: "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(
+                             now - sensor_status_pair.second.thermal_cached.timestamp)
+                             .count()
+                  << "ms" << std::endl;
+    }
+}
 
-    if (!thermal_helper_->isInitializedOk()) {
-        dump_buf << "ThermalHAL not initialized properly." << std::endl;
-    } else if (numArgs == 0 || std::string(args[0]) == "-a") {
-        const auto &sensor_status_map = thermal_helper_->GetSensorStatusMap();
-        {
-            dump_buf << "getCachedTemperatures:" << std::endl;
-            boot_clock::time_point now = boot_clock::now();
-            for (const auto &sensor_status_pair : sensor_status_map) {
-                if ((sensor_status_pair.second.thermal_cached.timestamp) ==
-                    boot_clock::time_point::min()) {
-                    continue;
-                }
-                dump_buf << " Name: " << sensor_status_pair.first
-                         << " CachedValue: " << sensor_status_pair.second.thermal_cached.temp
-                         << " TimeToCache: "
-                         << std::chrono::duration_cast<std::chrono::milliseconds>(
-                                    now - sensor_status_pair.second.thermal_cached.timestamp)
-                                    .count()
-                         << "ms" << std::endl;
-            }
+void Thermal::dumpPollingPeriods(std::ostringstream *dump_buf) {
+    *dump_buf << "getPollingPeriods:" << std::endl;
+    const auto sensor_status_map = thermal_helper_->GetSensorStatusSnapshot();
+    for (const auto &sensor_status_pair : sensor_status_map) {
+        if (sensor_status_pair.second.requested_period == std::chrono::milliseconds::zero()) {
+            continue;
         }
-        {
-            dump_buf << "getEmulSettings:" << std::endl;
-            for (const auto &sensor_status_pair : sensor_status_map) {
-                if (sensor_status_pair.second.override_status.emul_temp == nullptr) {
-                    continue;
-                }
-                dump_buf << " Name: " << sensor_status_pair.first << " EmulTemp: "
-                         << sensor_status_pair.second.override_status.emul_temp->temp
-                         << " EmulSeverity: "
-                         << sensor_status_pair.second.override_status.emul_temp->severity
-                         << " maxThrottling: " << std::boolalpha
-                         << sensor_status_pair.second.override_status.max_throttling << std::endl;
-            }
+        const auto &sensor_status = sensor_status_pair.second;
+        *dump_buf << " Name: " << sensor_status_pair.first
+                  << " RequestedPeriod: " << sensor_status.requested_period.count()
+                  << "ms ActualPeriod: " << sensor_status.actual_period.count() << "ms"
+                  << std::endl;
+    }
+}
+
+void Thermal::dumpEmulSettings(std::ostringstream *dump_buf) {
+    *dump_buf << "getEmulSettings:" << std::endl;
+    const auto sensor_status_map = thermal_helper_->GetSensorStatusSnapshot();
+    for (const auto &sensor_status_pair : sensor_status_map) {
+        if (!sensor_status_pair.second.emul_temp.has_value()) {
+            continue;
         }
-        {
-            const auto &map = thermal_helper_->GetSensorInfoMap();
-            dump_buf << "getCurrentTemperatures:" << std::endl;
-            Temperature temp_2_0;
-            for (const auto &name_info_pair : map) {
-                thermal_helper_->readTemperature(name_info_pair.first, &temp_2_0, nullptr, true);
-                dump_buf << " Type: " << toString(temp_2_0.type)
-                         << " Name: " << name_info_pair.first << " CurrentValue: " << temp_2_0.value
-                         << " ThrottlingStatus: " << toString(temp_2_0.throttlingStatus)
-                         << std::endl;
-            }
-            dump_buf << "getTemperatureThresholds:" << std::endl;
-            for (const auto &name_info_pair : map) {
-                if (!name_info_pair.second.is_watch) {
-                    continue;
-                }
-                dump_buf << " Type: " << toString(name_info_pair.second.type)
-                         << " Name: " << name_info_pair.first;
-                dump_buf << " hotThrottlingThreshold: [";
-                for (size_t i = 0; i < kThrottlingSeverityCount; ++i) {
-                    dump_buf << name_info_pair.second.hot_thresholds[i] << " ";
-                }
-                dump_buf << "] coldThrottlingThreshold: [";
-                for (size_t i = 0; i < kThrottlingSeverityCount; ++i) {
-                    dump_buf << name_info_pair.second.cold_thresholds[i] << " ";
-                }
-                dump_buf << "] vrThrottlingThreshold: " << name_info_pair.second.vr_threshold;
-                dump_buf << std::endl;
-            }
-            dump_buf << "getHysteresis:" << std::endl;
-            for (const auto &name_info_pair : map) {
-                if (!name_info_pair.second.is_watch) {
-                    continue;
-                }
-                dump_buf << " Name: " << name_info_pair.first;
-                dump_buf << " hotHysteresis: [";
-                for (size_t i = 0; i < kThrottlingSeverityCount; ++i) {
-                    dump_buf << name_info_pair.second.hot_hysteresis[i] << " ";
-                }
-                dump_buf << "] coldHysteresis: [";
-                for (size_t i = 0; i < kThrottlingSeverityCount; ++i) {
-                    dump_buf << name_info_pair.second.cold_hysteresis[i] << " ";
-                }
-                dump_buf << "]" << std::endl;
-            }
+        *dump_buf << " Name: " << sensor_status_pair.first
+                  << " EmulTemp: " << sensor_status_pair.second.emul_temp->temp
+                  << " EmulSeverity: " << sensor_status_pair.second.emul_temp->severity
+                  << " maxThrottling: " << std::boolalpha
+                  << sensor_status_pair.second.max_throttling << std::endl;
+    }
+}
+
+void Thermal::dumpCurrentTemperatures(std::ostringstream *dump_buf) {
+    const auto &map = thermal_helper_->GetSensorInfoMap();
+    *dump_buf << "getCurrentTemperatures:" << std::endl;
+    // The temperatures the watcher last published, reading the sensors again here would
+    // compete with the watcher for them
+    std::vector<Temperature> temperatures;
+    thermal_helper_->fillCurrentTemperatures(false, false, TemperatureType::UNKNOWN,
+                                             &temperatures);
+    for (const auto &temp : temperatures) {
+        *dump_buf << " Type: " << toString(temp.type) << " Name: " << temp.name
+                  << " CurrentValue: " << temp.value
+                  << " ThrottlingStatus: " << toString(temp.throttlingStatus) << std::endl;
+    }
+    *dump_buf << "getTemperatureThresholds:" << std::endl;
+    for (const auto &name_info_pair : map) {
+        if (!name_info_pair.second.is_watch) {
+            continue;
         }
-        {
-            dump_buf << "getCurrentCoolingDevices:" << std::endl;
-            std::vector<CoolingDevice> cooling_devices;
-            if (!thermal_helper_->fillCurrentCoolingDevices(false, CoolingType::CPU,
-                                                            &cooling_devices)) {
-                dump_buf << " Failed to getCurrentCoolingDevices." << std::endl;
-            }
+        *dump_buf << " Type: " << toString(name_info_pair.second.type)
+                  << " Name: " << name_info_pair.first;
+        *dump_buf << " hotThrottlingThreshold: [";
+        for (size_t i = 0; i < kThrottlingSeverityCount; ++i) {
+            *dump_buf << name_info_pair.second.hot_thresholds[i] << " ";
+        }
+        *dump_buf << "] coldThrottlingThreshold: [";
+        for (size_t i = 0; i < kThrottlingSeverityCount; ++i) {
+            *dump_buf << name_info_pair.second.cold_thresholds[i] << " ";
+        }
+        *dump_buf << "] vrThrottlingThreshold: " << name_info_pair.second.vr_threshold;
+        *dump_buf << std::endl;
+    }
+    *dump_buf << "getHysteresis:" << std::endl;
+    for (const auto &name_info_pair : map) {
+        if (!name_info_pair.second.is_watch) {
+            continue;
+        }
+        *dump_buf << " Name: " << name_info_pair.first;
+        *dump_buf << " hotHysteresis: [";
+        for (size_t i = 0; i < kThrottlingSeverityCount; ++i) {
+            *dump_buf << name_info_pair.second.hot_hysteresis[i] << " ";
+        }
+        *dump_buf << "] coldHysteresis: [";
+        for (size_t i = 0; i < kThrottlingSeverityCount; ++i) {
+            *dump_buf << name_info_pair.second.cold_hysteresis[i] << " ";
+        }
+        *dump_buf << "]" << std::endl;
+    }
+}
 
-            for (const auto &c : cooling_devices) {
-                dump_buf << " Type: " << toString(c.type) << " Name: " << c.name
-                         << " CurrentValue: " << c.value << std::endl;
-            }
+void Thermal::dumpCoolingDevices(std::ostringstream *dump_buf) {
+    *dump_buf << "getCurrentCoolingDevices:" << std::endl;
+    std::vector<CoolingDevice> cooling_devices;
+    if (!thermal_helper_->fillCurrentCoolingDevices(false, CoolingType::CPU, &cooling_devices)) {
+        *dump_buf << " Failed to getCurrentCoolingDevices." << std::endl;
+    }
+
+    for (const auto &c : cooling_devices) {
+        *dump_buf << " Type: " << toString(c.type) << " Name: " << c.name
+                  << " CurrentValue: " << c.value << std::endl;
+    }
+}
+
+void Thermal::dumpCallbacks(std::ostringstream *dump_buf) {
+    std::vector<std::shared_ptr<CallbackQueue>> callbacks;
+    {
+        std::lock_guard<std::mutex> _lock(thermal_callback_mutex_);
+        callbacks = callbacks_;
+    }
+    *dump_buf << "getCallbacks:" << std::endl;
+    *dump_buf << " Total: " << callbacks.size() << std::endl;
+    for (const auto &queue : callbacks) {
+        queue->dump(dump_buf);
+    }
+}
+
+void Thermal::dumpNotificationSettings(std::ostringstream *dump_buf) {
+    const auto &map = thermal_helper_->GetSensorInfoMap();
+    *dump_buf << "sendCallback:" << std::endl;
+    *dump_buf << "  Enabled List: ";
+    for (const auto &name_info_pair : map) {
+        if (name_info_pair.second.send_cb) {
+            *dump_buf << name_info_pair.first << " ";
         }
-        {
-            dump_buf << "getCallbacks:" << std::endl;
-            dump_buf << " Total: " << callbacks_.size() << std::endl;
-            for (const auto &c : callbacks_) {
-                dump_buf << " IsFilter: " << c.is_filter_type << " Type: " << toString(c.type)
-                         << std::endl;
+    }
+    *dump_buf << std::endl;
+    *dump_buf << "sendPowerHint:" << std::endl;
+    *dump_buf << "  Enabled List: ";
+    for (const auto &name_info_pair : map) {
+        if (name_info_pair.second.send_powerhint) {
+            *dump_buf << name_info_pair.first << " ";
+        }
+    }
+    *dump_buf << std::endl;
+}
+
+void Thermal::dumpTickStats(std::ostringstream *dump_buf) {
+    thermal_helper_->dumpTickStats(dump_buf);
+}
+
+void Thermal::dumpEmulScript(std::ostringstream *dump_buf) {
+    thermal_helper_->dumpEmulScript(dump_buf);
+}
+
+void Thermal::dumpPowerHalInfo(std::ostringstream *dump_buf) {
+    *dump_buf << "getAIDLPowerHalInfo:" << std::endl;
+    *dump_buf << " Exist: " << std::boolalpha << thermal_helper_->isAidlPowerHalExist()
+              << std::endl;
+    *dump_buf << " Connected: " << std::boolalpha << thermal_helper_->isPowerHalConnected()
+              << std::endl;
+    *dump_buf << " Ext connected: " << std::boolalpha << thermal_helper_->isPowerHalExtConnected()
+              << std::endl;
+    thermal_helper_->dumpPowerHalStatus(dump_buf);
+}
+
+void Thermal::dumpThermalData(int fd, const char **args, uint32_t numArgs) {
+    struct DumpSection {
+        std::string_view name;
+        void (Thermal::*dump)(std::ostringstream *dump_buf);
+    };
+    // In the order of a full dump
+    static const DumpSection kDumpSections[] = {
+            {"cached_temperatures", &Thermal::dumpCachedTemperatures},
+            {"polling_periods", &Thermal::dumpPollingPeriods},
+            {"emul_settings", &Thermal::dumpEmulSettings},
+            {"temperatures", &Thermal::dumpCurrentTemperatures},
+            {"cooling_devices", &Thermal::dumpCoolingDevices},
+            {"callbacks", &Thermal::dumpCallbacks},
+            {"notifications", &Thermal::dumpNotificationSettings},
+            {"virtual_sensors", &Thermal::dumpVirtualSensorInfo},
+            {"vt_estimator", &Thermal::dumpVtEstimatorInfo},
+            {"throttling", &Thermal::dumpThrottlingInfo},
+            {"throttling_requests", &Thermal::dumpThrottlingRequestStatus},
+            {"power_rails", &Thermal::dumpPowerRailInfo},
+            {"stats", &Thermal::dumpThermalStats},
+            {"tick_stats", &Thermal::dumpTickStats},
+            {"emul_script", &Thermal::dumpEmulScript},
+            {"power_hal", &Thermal::dumpPowerHalInfo},
+    };
+
+    const auto find_section = [](std::string_view name) -> const DumpSection * {
+        for (const auto &section : kDumpSections) {
+            if (section.name == name) {
+                return &section;
             }
         }
-        {
-            dump_buf << "sendCallback:" << std::endl;
-            dump_buf << "  Enabled List: ";
-            const auto &map = thermal_helper_->GetSensorInfoMap();
-            for (const auto &name_info_pair : map) {
-                if (name_info_pair.second.send_cb) {
-                    dump_buf << name_info_pair.first << " ";
-                }
+        return nullptr;
+    };
+
+    std::ostringstream dump_buf;
+    std::vector<const DumpSection *> sections;
+    if (!thermal_helper_->isInitializedOk()) {
+        dump_buf << "ThermalHAL not initialized properly." << std::endl;
+    } else if (numArgs == 0 || std::string(args[0]) == "-a") {
+        for (const auto &section : kDumpSections) {
+            sections.push_back(&section);
+        }
+    } else if (std::string(args[0]) == "-vt-estimator") {
+        sections.push_back(find_section("vt_estimator"));
+    } else {
+        // --section <name> [--section <name>...]
+        for (uint32_t i = 0; i + 1 < numArgs; i += 2) {
+            const DumpSection *section =
+                    std::string(args[i]) == "--section" ? find_section(args[i + 1]) : nullptr;
+            if (section == nullptr) {
+                dump_buf << "Unknown section: " << args[i] << " " << args[i + 1] << std::endl;
+                continue;
             }
-            dump_buf << std::endl;
+            sections.push_back(section);
         }
-        {
-            dump_buf << "sendPowerHint:" << std::endl;
-            dump_buf << "  Enabled List: ";
-            const auto &map = thermal_helper_->GetSensorInfoMap();
-            for (const auto &name_info_pair : map) {
-                if (name_info_pair.second.send_powerhint) {
-                    dump_buf << name_info_pair.first << " ";
-                }
+        if (sections.empty()) {
+            dump_buf << "Sections:";
+            for (const auto &section : kDumpSections) {
+                dump_buf << " " << section.name;
             }
             dump_buf << std::endl;
         }
-        dumpVirtualSensorInfo(&dump_buf);
-        dumpVtEstimatorInfo(&dump_buf);
-        dumpThrottlingInfo(&dump_buf);
-        dumpThrottlingRequestStatus(&dump_buf);
-        dumpPowerRailInfo(&dump_buf);
-        dumpThermalStats(&dump_buf);
-        {
-            dump_buf << "getAIDLPowerHalInfo:" << std::endl;
-            dump_buf << " Exist: " << std::boolalpha << thermal_helper_->isAidlPowerHalExist()
-                     << std::endl;
-            dump_buf << " Connected: " << std::boolalpha << thermal_helper_->isPowerHalConnected()
-                     << std::endl;
-            dump_buf << " Ext connected: " << std::boolalpha
-                     << thermal_helper_->isPowerHalExtConnected() << std::endl;
-        }
-    } else if (std::string(args[0]) == "-vt-estimator") {
-        dumpVtEstimatorInfo(&dump_buf);
     }
 
-    std::string buf = dump_buf.str();
-    if (!::android::base::WriteStringToFd(buf, fd)) {
+    // Each section is formatted from its own snapshot and written before the next one is
+    // taken, so a slow reader never holds up the locks or a whole dump in memory
+    for (const auto *section : sections) {
+        (this->*section->dump)(&dump_buf);
+        if (!::android::base::WriteStringToFd(dump_buf.str(), fd)) {
+            PLOG(ERROR) << "Failed to dump " << section->name << " to fd";
+            return;
+        }
+        dump_buf.str("");
+    }
+    if (sections.empty() && !::android::base::WriteStringToFd(dump_buf.str(), fd)) {
         PLOG(ERROR) << "Failed to dump state to fd";
     }
     fsync(fd);
 }
 
 binder_status_t Thermal::dump(int fd, const char **args, uint32_t numArgs) {
-    if (numArgs == 0 || std::string(args[0]) == "-a" || std::string(args[0]) == "-vt-estimator") {
+    if (numArgs == 0 || std::string(args[0]) == "-a" || std::string(args[0]) == "-vt-estimator" ||
+        std::string(args[0]) == "--section") {
         dumpThermalData(fd, args, numArgs);
         return STATUS_OK;
     }
@@ -870,6 +979,18 @@ binder_status_t Thermal::dump(int fd, const char **args, uint32_t numArgs) {
         return (numArgs != 2 || !thermal_helper_->emulClear(std::string(args[1])))
                        ? STATUS_BAD_VALUE
                        : STATUS_OK;
+    } else if (std::string(args[0]) == "emul_script" && numArgs >= 2) {
+        return thermal_helper_->emulScript(std::string(args[1]),
+                                           numArgs == 2 ? 1.0f : std::atof(args[2]))
+                       ? STATUS_OK
+                       : STATUS_BAD_VALUE;
+    } else if (std::string(args[0]) == "emul_script_stop") {
+        thermal_helper_->emulScriptStop();
+        return STATUS_OK;
+    } else if (std::string(args[0]) == "cdev_power_refresh") {
+        return thermal_helper_->refreshCdevPowerTable(numArgs == 2 ? std::string(args[1]) : "all")
+                       ? STATUS_OK
+                       : STATUS_BAD_VALUE;
     }
     return STATUS_BAD_VALUE;
 }
@@ -902,6 +1023,92 @@ void Thermal::Looper::loop() {
     }
 }
 
+void Thermal::CallbackQueue::start() {
+    std::thread([self = shared_from_this()] { self->loop(); }).detach();
+}
+
+void Thermal::CallbackQueue::stop() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        aborted_ = true;
+        pending_order_.clear();
+        pending_.clear();
+    }
+    cv_.notify_one();
+}
+
+void Thermal::CallbackQueue::enqueue(const Temperature &t,
+                                     std::shared_ptr<EmulScriptReport> report) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (aborted_) {
+            return;
+        }
+        NotificationKey key(t.name, t.type);
+        auto it = pending_.find(key);
+        if (it != pending_.end()) {
+            // Still waiting for delivery, only the latest severity matters
+            it->second.temperature = t;
+            it->second.report = std::move(report);
+            coalesced_count_++;
+            return;
+        }
+        if (pending_order_.size() >= kMaxPendingNotifications) {
+            pending_.erase(pending_order_.front());
+            pending_order_.pop_front();
+            dropped_count_++;
+        }
+        pending_.emplace(key, PendingNotification{t, boot_clock::now(), std::move(report)});
+        pending_order_.push_back(std::move(key));
+    }
+    cv_.notify_one();
+}
+
+void Thermal::CallbackQueue::dump(std::ostringstream *dump_buf) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    *dump_buf << " IsFilter: " << setting_.is_filter_type << " Type: " << toString(setting_.type)
+              << " Pending: " << pending_order_.size() << " Delivered: " << delivered_count_
+              << " Coalesced: " << coalesced_count_ << " Dropped: " << dropped_count_
+              << " LastLatencyMs: " << last_latency_.count()
+              << " AvgLatencyMs: "
+              << (delivered_count_ ? total_latency_.count() / delivered_count_ : 0)
+              << " MaxLatencyMs: " << max_latency_.count() << std::endl;
+}
+
+void Thermal::CallbackQueue::loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [&] { return aborted_ || !pending_order_.empty(); });
+        if (aborted_) {
+            return;
+        }
+        auto notification = pending_.extract(pending_order_.front());
+        pending_order_.pop_front();
+        lock.unlock();
+
+        const Temperature &t = notification.mapped().temperature;
+        ::ndk::ScopedAStatus ret = setting_.callback->notifyThrottling(t);
+        const auto latency_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                boot_clock::now() - notification.mapped().enqueue_time);
+        const auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(latency_us);
+        if (notification.mapped().report != nullptr) {
+            notification.mapped().report->recordCallbackLatency(latency_us);
+        }
+
+        lock.lock();
+        if (!ret.isOk()) {
+            LOG(ERROR) << "Failed to notify a Thermal callback of " << t.name
+                       << ", stop delivering to it";
+            dead_ = true;
+            return;
+        }
+        delivered_count_++;
+        last_latency_ = latency;
+        max_latency_ = std::max(max_latency_, latency);
+        total_latency_ += latency;
+    }
+}
+
 }  // namespace implementation
 }  // namespace thermal
 }  // namespace hardware
@@ -18,6 +18,10 @@
 
 #include <aidl/android/hardware/thermal/BnThermal.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
 #include <mutex>
 #include <thread>
 
@@ -51,7 +55,7 @@ class Thermal : public BnThermal {
   public:
     Thermal();
     explicit Thermal(const std::shared_ptr<ThermalHelper> &helper);
-    ~Thermal() = default;
+    ~Thermal();
     ndk::ScopedAStatus getTemperatures(std::vector<Temperature> *_aidl_return) override;
     ndk::ScopedAStatus getTemperaturesWithType(TemperatureType type,
                                                std::vector<Temperature> *_aidl_return) override;
@@ -108,9 +112,53 @@ class Thermal : public BnThermal {
         void loop();
     };
 
+    // Delivers the notifications of one registered callback from its own thread, so a slow
+    // client only delays itself. While the client is behind, only the latest notification of
+    // each sensor is kept.
+    class CallbackQueue : public std::enable_shared_from_this<CallbackQueue> {
+      public:
+        explicit CallbackQueue(const CallbackSetting &setting) : setting_(setting) {}
+
+        // Start the delivery thread, which keeps the queue alive until it is stopped
+        void start();
+        // Drop the pending notifications and let the delivery thread exit, without waiting
+        // for a notification in flight
+        void stop();
+        // report, when a script plays, gets the delivery latency
+        void enqueue(const Temperature &t, std::shared_ptr<EmulScriptReport> report = nullptr);
+        // True once a notification failed, the client is gone
+        bool isDead() const { return dead_; }
+        const CallbackSetting &setting() const { return setting_; }
+        void dump(std::ostringstream *dump_buf);
+
+      private:
+        struct PendingNotification {
+            Temperature temperature;
+            boot_clock::time_point enqueue_time;
+            std::shared_ptr<EmulScriptReport> report;
+        };
+        using NotificationKey = std::pair<std::string, TemperatureType>;
+
+        const CallbackSetting setting_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::deque<NotificationKey> pending_order_;
+        std::map<NotificationKey, PendingNotification> pending_;
+        bool aborted_ = false;
+        std::atomic<bool> dead_ = false;
+        uint64_t delivered_count_ = 0;
+        uint64_t coalesced_count_ = 0;
+        uint64_t dropped_count_ = 0;
+        std::chrono::milliseconds last_latency_ = std::chrono::milliseconds::zero();
+        std::chrono::milliseconds max_latency_ = std::chrono::milliseconds::zero();
+        std::chrono::milliseconds total_latency_ = std::chrono::milliseconds::zero();
+
+        void loop();
+    };
+
     std::shared_ptr<ThermalHelper> thermal_helper_;
     std::mutex thermal_callback_mutex_;
-    std::vector<CallbackSetting> callbacks_;
+    std::vector<std::shared_ptr<CallbackQueue>> callbacks_;
     std::mutex cdev_callback_mutex_;
     std::vector<CoolingDeviceCallbackSetting> cdev_callbacks_;
 
@@ -126,6 +174,14 @@ class Thermal : public BnThermal {
             const std::shared_ptr<IThermalChangedCallback> &callback, bool filterType,
             TemperatureType type);
 
+    // Dump sections, each takes its own snapshot of what it shows
+    void dumpCachedTemperatures(std::ostringstream *dump_buf);
+    void dumpPollingPeriods(std::ostringstream *dump_buf);
+    void dumpEmulSettings(std::ostringstream *dump_buf);
+    void dumpCurrentTemperatures(std::ostringstream *dump_buf);
+    void dumpCoolingDevices(std::ostringstream *dump_buf);
+    void dumpCallbacks(std::ostringstream *dump_buf);
+    void dumpNotificationSettings(std::ostringstream *dump_buf);
     void dumpVirtualSensorInfo(std::ostringstream *dump_buf);
     void dumpVtEstimatorInfo(std::ostringstream *dump_buf);
     void dumpThrottlingInfo(std::ostringstream *dump_buf);
@@ -134,6 +190,10 @@ class Thermal : public BnThermal {
     void dumpStatsRecord(std::ostringstream *dump_buf, const StatsRecord &stats_record,
                          std::string_view line_prefix);
     void dumpThermalStats(std::ostringstream *dump_buf);
+    void dumpTickStats(std::ostringstream *dump_buf);
+    void dumpEmulScript(std::ostringstream *dump_buf);
+    void dumpPowerHalInfo(std::ostringstream *dump_buf);
+    // Stream every section, or those picked with --section <name>, to fd
     void dumpThermalData(int fd, const char **args, uint32_t numArgs);
 };
 
@@ -0,0 +1,378 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replays a trace recorded by the thermal HAL (vendor.thermal.trace_record_path) through the
+// sensor evaluation and throttling code of the HAL, and prints the cooling device requests
+// as CSV, one row per tick in which a request changed.
+//
+// usage: thermal_replay <thermal_info_config.json> <trace> [output.csv]
+//
+// Emulated temperatures, max throttling overrides and PID compensation from predictions are
+// not part of the trace and are not replayed.
+
+#include <android-base/logging.h>
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "utils/thermal_config_cache.h"
+#include "utils/thermal_sensor_eval.h"
+#include "utils/thermal_throttling.h"
+#include "utils/thermal_trace.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace thermal {
+namespace implementation {
+
+namespace {
+
+// Feeds the energy samples of the replayed tick to PowerFiles in place of the ODPM nodes
+class ReplayPowerFiles : public PowerFiles {
+  public:
+    void setEnergySamples(const std::vector<std::pair<std::string, PowerSample>> *samples) {
+        samples_ = samples;
+    }
+
+  protected:
+    bool findEnergySourceToWatch(void) override { return true; }
+    bool updateEnergyValues(void) override {
+        if (samples_ == nullptr) {
+            return false;
+        }
+        for (const auto &[power_rail, sample] : *samples_) {
+            setEnergySample(power_rail, sample);
+        }
+        return true;
+    }
+
+  private:
+    const std::vector<std::pair<std::string, PowerSample>> *samples_ = nullptr;
+};
+
+struct ReplaySensorStatus {
+    ThrottlingSeverity severity = ThrottlingSeverity::NONE;
+    ThrottlingSeverity prev_hot_severity = ThrottlingSeverity::NONE;
+    ThrottlingSeverity prev_cold_severity = ThrottlingSeverity::NONE;
+    float cached_temp = NAN;
+    std::chrono::milliseconds cached_time = std::chrono::milliseconds::min();
+    std::chrono::milliseconds last_update_time = std::chrono::milliseconds::min();
+};
+
+// Evaluates the sensors of the trace the way the HAL does, with the sysfs readings and ODPM
+// samples taken from the trace
+class ThermalReplay : public SensorInputReader {
+  public:
+    bool init(std::string_view config_path, const std::vector<ThermalTraceTick> &ticks);
+    void run(const std::vector<ThermalTraceTick> &ticks, std::ostream *out);
+
+    bool readSensor(std::string_view sensor_name, size_t sensor_node, float *temp,
+                    std::map<std::string, float> *sensor_log_map) override;
+    bool readPower(std::string_view power_rail, float *power) override;
+
+  private:
+    bool evaluateSensor(std::string_view sensor_name, float *temp,
+                        std::map<std::string, float> *sensor_log_map);
+    void updateSensor(std::string_view sensor_name, const ThermalTraceTick &tick,
+                      std::vector<std::string> *cooling_devices_to_update);
+
+    ParsedThermalConfig config_;
+    ReplayPowerFiles power_files_;
+    ThermalThrottling thermal_throttling_;
+    ThermalStatsHelper thermal_stats_helper_;
+    std::unordered_map<std::string, ReplaySensorStatus> sensor_status_map_;
+    // Sensors read in the replayed tick, each sensor is evaluated once per tick
+    std::unordered_map<std::string, float> tick_temps_;
+    std::unordered_map<std::string, float> tick_raw_temps_;
+    std::chrono::milliseconds now_;
+    bool power_data_is_updated_ = false;
+};
+
+bool ThermalReplay::init(std::string_view config_path,
+                         const std::vector<ThermalTraceTick> &ticks) {
+    if (!LoadThermalConfig(config_path, "", &config_)) {
+        LOG(ERROR) << "Failed to load thermal config " << config_path;
+        return false;
+    }
+
+    // Register the power rails against the first energy samples in the trace
+    if (!config_.power_rail_info_map.empty()) {
+        for (const auto &tick : ticks) {
+            if (!tick.energy_samples.empty()) {
+                power_files_.setEnergySamples(&tick.energy_samples);
+                break;
+            }
+        }
+        if (!power_files_.registerPowerRailsToWatch(std::move(config_.power_rail_info_map))) {
+            LOG(ERROR) << "Failed to register power rails";
+            return false;
+        }
+    }
+
+    for (const auto &[sensor_name, sensor_info] : config_.sensor_info_map) {
+        sensor_status_map_[sensor_name] = ReplaySensorStatus();
+        if (sensor_info.throttling_info != nullptr &&
+            !thermal_throttling_.registerThermalThrottling(sensor_name, sensor_info,
+                                                           config_.cooling_device_info_map)) {
+            LOG(ERROR) << sensor_name << " failed to register thermal throttling";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ThermalReplay::readSensor(std::string_view sensor_name, size_t /*sensor_node*/,
+                               float *temp, std::map<std::string, float> *sensor_log_map) {
+    const auto tick_temp = tick_temps_.find(sensor_name.data());
+    if (tick_temp != tick_temps_.end()) {
+        *temp = tick_temp->second;
+        if (!std::isnan(*temp)) {
+            (*sensor_log_map)[sensor_name.data()] = *temp;
+        }
+        return true;
+    }
+    if (!evaluateSensor(sensor_name, temp, sensor_log_map)) {
+        return false;
+    }
+    tick_temps_[sensor_name.data()] = *temp;
+    return true;
+}
+
+bool ThermalReplay::evaluateSensor(std::string_view sensor_name, float *temp,
+                                   std::map<std::string, float> *sensor_log_map) {
+    const auto sensor_info_it = config_.sensor_info_map.find(sensor_name.data());
+    if (sensor_info_it == config_.sensor_info_map.end()) {
+        LOG(ERROR) << "Unknown thermal sensor " << sensor_name;
+        return false;
+    }
+    const auto &sensor_info = sensor_info_it->second;
+    auto &sensor_status = sensor_status_map_.at(sensor_name.data());
+    const auto since_last_update = sensor_status.cached_time == std::chrono::milliseconds::min()
+                                           ? std::chrono::milliseconds::max()
+                                           : now_ - sensor_status.cached_time;
+
+    if (sensor_info.virtual_sensor_info == nullptr) {
+        // A physical sensor was read from sysfs in this tick only if the trace has its value,
+        // otherwise the HAL used the cached one
+        const auto raw_temp = tick_raw_temps_.find(sensor_name.data());
+        if (raw_temp == tick_raw_temps_.end()) {
+            if (std::isnan(sensor_status.cached_temp)) {
+                LOG(ERROR) << "No recorded reading of " << sensor_name;
+                return false;
+            }
+            *temp = sensor_status.cached_temp;
+            (*sensor_log_map)[sensor_name.data()] = *temp;
+            return true;
+        }
+        *temp = raw_temp->second;
+    } else {
+        if (since_last_update < sensor_info.time_resolution &&
+            !std::isnan(sensor_status.cached_temp)) {
+            *temp = sensor_status.cached_temp;
+            (*sensor_log_map)[sensor_name.data()] = *temp;
+            return true;
+        }
+
+        if (!EvaluateVirtualSensor(sensor_name, kNoSensorNode, *sensor_info.virtual_sensor_info,
+                                   {}, {}, kNoSensorNode, this, sensor_log_map, temp)) {
+            return false;
+        }
+        if (std::isnan(*temp)) {
+            return true;
+        }
+    }
+
+    *temp = SmoothSensorTemp(sensor_info, *temp, sensor_status.cached_temp, since_last_update);
+    (*sensor_log_map)[sensor_name.data()] = *temp;
+    sensor_status.cached_temp = *temp;
+    sensor_status.cached_time = now_;
+    return true;
+}
+
+bool ThermalReplay::readPower(std::string_view power_rail, float *power) {
+    const auto &power_status_map = power_files_.GetPowerStatusMap();
+    const auto power_status = power_status_map.find(power_rail.data());
+    if (power_status == power_status_map.end()) {
+        return false;
+    }
+    *power = power_status->second.last_updated_avg_power;
+    return true;
+}
+
+void ThermalReplay::updateSensor(std::string_view sensor_name, const ThermalTraceTick &tick,
+                                 std::vector<std::string> *cooling_devices_to_update) {
+    const auto sensor_info_it = config_.sensor_info_map.find(sensor_name.data());
+    if (sensor_info_it == config_.sensor_info_map.end()) {
+        LOG(ERROR) << "Unknown thermal sensor " << sensor_name << " in trace";
+        return;
+    }
+    const auto &sensor_info = sensor_info_it->second;
+    auto &sensor_status = sensor_status_map_.at(sensor_name.data());
+    std::map<std::string, float> sensor_log_map;
+    float value = NAN;
+    if (!readSensor(sensor_name, kNoSensorNode, &value, &sensor_log_map)) {
+        LOG(ERROR) << "Failed to replay sensor " << sensor_name << " at " << now_.count() << "ms";
+        return;
+    }
+    // Same as the HAL, a sensor reading nan is not updated
+    if (std::isnan(value)) {
+        LOG(INFO) << "Sensor " << sensor_name << " temperature is nan at " << now_.count() << "ms";
+        return;
+    }
+
+    Temperature temp;
+    temp.type = sensor_info.type;
+    temp.name = sensor_name.data();
+    temp.value = value * sensor_info.multiplier;
+    std::pair<ThrottlingSeverity, ThrottlingSeverity> status =
+            std::make_pair(ThrottlingSeverity::NONE, ThrottlingSeverity::NONE);
+    if (sensor_info.is_watch) {
+        status = getSeverityFromThresholds(sensor_info.hot_thresholds, sensor_info.cold_thresholds,
+                                           sensor_info.hot_hysteresis, sensor_info.cold_hysteresis,
+                                           sensor_status.prev_hot_severity,
+                                           sensor_status.prev_cold_severity, temp.value);
+    }
+    temp.throttlingStatus = static_cast<size_t>(status.first) > static_cast<size_t>(status.second)
+                                    ? status.first
+                                    : status.second;
+    sensor_status.prev_hot_severity = status.first;
+    sensor_status.prev_cold_severity = status.second;
+    sensor_status.severity = temp.throttlingStatus;
+
+    // The HAL refreshes the power data once per tick, after the first sensor is read
+    if (!power_data_is_updated_ && !tick.energy_samples.empty()) {
+        power_files_.setEnergySamples(&tick.energy_samples);
+        power_files_.refreshPowerStatus(boot_clock::time_point(tick.time));
+        power_data_is_updated_ = true;
+    }
+
+    std::chrono::milliseconds time_elapsed_ms = std::chrono::milliseconds::zero();
+    if (sensor_status.last_update_time != std::chrono::milliseconds::min()) {
+        time_elapsed_ms = now_ - sensor_status.last_update_time;
+    }
+    if (sensor_status.severity == ThrottlingSeverity::NONE) {
+        thermal_throttling_.clearThrottlingData(sensor_info);
+    } else {
+        thermal_throttling_.thermalThrottlingUpdate(temp, sensor_info, sensor_status.severity,
+                                                    time_elapsed_ms,
+                                                    power_files_.GetPowerStatusMap(),
+                                                    config_.cooling_device_info_map);
+    }
+    thermal_throttling_.computeCoolingDevicesRequest(sensor_name, sensor_info,
+                                                     sensor_status.severity,
+                                                     cooling_devices_to_update,
+                                                     &thermal_stats_helper_);
+    sensor_status.last_update_time = now_;
+}
+
+void ThermalReplay::run(const std::vector<ThermalTraceTick> &ticks, std::ostream *out) {
+    std::vector<std::string> cdev_names(config_.cooling_device_info_map.size());
+    for (const auto &[cdev_name, cdev_info] : config_.cooling_device_info_map) {
+        cdev_names[cdev_info.id] = cdev_name;
+    }
+    std::vector<int> cdev_requests(cdev_names.size(), 0);
+
+    *out << "time_ms";
+    for (const auto &cdev_name : cdev_names) {
+        *out << "," << cdev_name;
+    }
+    *out << "\n";
+
+    for (const auto &tick : ticks) {
+        now_ = tick.time;
+        power_data_is_updated_ = false;
+        tick_temps_.clear();
+        tick_raw_temps_.clear();
+        for (const auto &[sensor_name, value] : tick.sensor_readings) {
+            tick_raw_temps_[sensor_name] = value;
+        }
+
+        std::vector<std::string> cooling_devices_to_update;
+        for (const auto &sensor_name : tick.updated_sensors) {
+            updateSensor(sensor_name, tick, &cooling_devices_to_update);
+        }
+        if (cooling_devices_to_update.empty()) {
+            continue;
+        }
+
+        bool request_changed = false;
+        for (const auto &cdev_name : cooling_devices_to_update) {
+            const size_t cdev_id = config_.cooling_device_info_map.at(cdev_name).id;
+            int max_state;
+            if (thermal_throttling_.getCdevMaxRequest(cdev_id, &max_state) &&
+                max_state != cdev_requests[cdev_id]) {
+                cdev_requests[cdev_id] = max_state;
+                request_changed = true;
+            }
+        }
+        if (!request_changed) {
+            continue;
+        }
+        *out << tick.time.count();
+        for (const int request : cdev_requests) {
+            *out << "," << request;
+        }
+        *out << "\n";
+    }
+}
+
+}  // namespace
+
+}  // namespace implementation
+}  // namespace thermal
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
+
+int main(int argc, char *argv[]) {
+    using ::aidl::android::hardware::thermal::implementation::ParseThermalTrace;
+    using ::aidl::android::hardware::thermal::implementation::ThermalReplay;
+    using ::aidl::android::hardware::thermal::implementation::ThermalTraceTick;
+
+    if (argc < 3 || argc > 4) {
+        std::cerr << "usage: " << argv[0] << " <thermal_info_config.json> <trace> [output.csv]"
+                  << std::endl;
+        return 1;
+    }
+    ::android::base::InitLogging(argv, ::android::base::StderrLogger);
+
+    std::vector<ThermalTraceTick> ticks;
+    if (!ParseThermalTrace(argv[2], &ticks)) {
+        return 1;
+    }
+    ThermalReplay replay;
+    if (!replay.init(argv[1], ticks)) {
+        return 1;
+    }
+
+    if (argc == 4) {
+        std::ofstream out(argv[3]);
+        if (!out) {
+            std::cerr << "Failed to open " << argv[3] << std::endl;
+            return 1;
+        }
+        replay.run(ticks, &out);
+    } else {
+        replay.run(ticks, &std::cout);
+    }
+    return 0;
+}
@@ -37,6 +37,10 @@ class MockThermalHelper : public ThermalHelper {
     MOCK_METHOD(bool, emulTemp, (std::string_view, const float, const bool), (override));
     MOCK_METHOD(bool, emulSeverity, (std::string_view, const int, const bool), (override));
     MOCK_METHOD(bool, emulClear, (std::string_view), (override));
+    MOCK_METHOD(bool, emulScript, (std::string_view, const float), (override));
+    MOCK_METHOD(void, emulScriptStop, (), (override));
+    MOCK_METHOD(std::shared_ptr<EmulScriptReport>, getEmulScriptReport, (), (const, override));
+    MOCK_METHOD(bool, refreshCdevPowerTable, (std::string_view), (override));
     MOCK_METHOD(bool, isInitializedOk, (), (const, override));
     MOCK_METHOD(bool, readTemperature,
                 (std::string_view, Temperature *out,
@@ -59,6 +63,12 @@ class MockThermalHelper : public ThermalHelper {
                 (const, override));
     MOCK_METHOD((const std::unordered_map<std::string, PowerStatus> &), GetPowerStatusMap, (),
                 (const, override));
+    MOCK_METHOD((std::unordered_map<std::string, SensorStatusSnapshot>), GetSensorStatusSnapshot,
+                (), (const, override));
+    MOCK_METHOD((std::unordered_map<std::string, ThermalThrottlingStatus>),
+                GetThermalThrottlingStatusSnapshot, (), (const, override));
+    MOCK_METHOD((std::unordered_map<std::string, PowerStatus>), GetPowerStatusSnapshot, (),
+                (const, override));
     MOCK_METHOD((const std::unordered_map<std::string, SensorTempStats>),
                 GetSensorTempStatsSnapshot, (), (override));
     MOCK_METHOD((const std::unordered_map<std::string,
@@ -67,6 +77,9 @@ class MockThermalHelper : public ThermalHelper {
     MOCK_METHOD(bool, isAidlPowerHalExist, (), (override));
     MOCK_METHOD(bool, isPowerHalConnected, (), (override));
     MOCK_METHOD(bool, isPowerHalExtConnected, (), (override));
+    MOCK_METHOD(void, dumpPowerHalStatus, (std::ostringstream *), (override));
+    MOCK_METHOD(void, dumpTickStats, (std::ostringstream *), (const, override));
+    MOCK_METHOD(void, dumpEmulScript, (std::ostringstream *), (const, override));
     MOCK_METHOD(void, dumpTraces, (std::string_view), (override));
 };
 
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "utils/thermal_adaptive_polling.h"
+
+namespace aidl::android::hardware::thermal::implementation {
+
+namespace {
+
+using std::chrono::milliseconds;
+
+constexpr milliseconds kPollingDelay(10000);
+constexpr milliseconds kPassiveDelay(1000);
+
+// Throttles LIGHT at 40 and MODERATE at 45
+SensorInfo adaptiveSensor(milliseconds time_resolution = milliseconds(100)) {
+    SensorInfo info{};
+    info.hot_thresholds.fill(NAN);
+    info.hot_thresholds[static_cast<size_t>(ThrottlingSeverity::LIGHT)] = 40;
+    info.hot_thresholds[static_cast<size_t>(ThrottlingSeverity::MODERATE)] = 45;
+    info.polling_delay = kPollingDelay;
+    info.passive_delay = kPassiveDelay;
+    info.time_resolution = time_resolution;
+    info.adaptive_polling = true;
+    return info;
+}
+
+}  // namespace
+
+TEST(ThermalAdaptivePollingTest, speedsUpNearTrigger) {
+    const auto info = adaptiveSensor();
+
+    // 1 degree every 10s from 39: LIGHT in 10s, read again in 5s
+    EXPECT_EQ(AdaptPollingDelay(info, ThrottlingSeverity::NONE, 39, 38, kPollingDelay,
+                                kPollingDelay),
+              milliseconds(5000));
+    // Twice as fast: read again in 2.5s
+    EXPECT_EQ(AdaptPollingDelay(info, ThrottlingSeverity::NONE, 39, 37, kPollingDelay,
+                                kPollingDelay),
+              milliseconds(2500));
+    // LIGHT in 3 polling delays: not close enough to speed up, too close to slow down
+    EXPECT_EQ(AdaptPollingDelay(info, ThrottlingSeverity::NONE, 37, 36, kPollingDelay,
+                                kPollingDelay),
+              kPollingDelay);
+}
+
+TEST(ThermalAdaptivePollingTest, clampsSpeedUp) {
+    // About to cross LIGHT: no faster than passive_delay / kAdaptivePollingMaxSpeedup
+    EXPECT_EQ(AdaptPollingDelay(adaptiveSensor(), ThrottlingSeverity::NONE, 39.9, 35,
+                                kPassiveDelay, kPollingDelay),
+              kPassiveDelay / kAdaptivePollingMaxSpeedup);
+    // ... nor faster than time_resolution
+    EXPECT_EQ(AdaptPollingDelay(adaptiveSensor(milliseconds(500)), ThrottlingSeverity::NONE,
+                                39.9, 35, kPassiveDelay, kPollingDelay),
+              milliseconds(500));
+}
+
+TEST(ThermalAdaptivePollingTest, slowsDownWhenCool) {
+    const auto info = adaptiveSensor();
+
+    // Steady, cooling, or heating too slowly to reach LIGHT within 4 polling delays
+    EXPECT_EQ(AdaptPollingDelay(info, ThrottlingSeverity::NONE, 30, 30, kPollingDelay,
+                                kPollingDelay),
+              kPollingDelay * kAdaptivePollingMaxSlowdown);
+    EXPECT_EQ(AdaptPollingDelay(info, ThrottlingSeverity::NONE, 30, 32, kPollingDelay,
+                                kPollingDelay),
+              kPollingDelay * kAdaptivePollingMaxSlowdown);
+    EXPECT_EQ(AdaptPollingDelay(info, ThrottlingSeverity::NONE, 30, 29.9, kPollingDelay,
+                                kPollingDelay),
+              kPollingDelay * kAdaptivePollingMaxSlowdown);
+}
+
+TEST(ThermalAdaptivePollingTest, clampsSlowDown) {
+    const auto info = adaptiveSensor();
+
+    // However long the sensor stays cool, no slower than kAdaptivePollingMaxSlowdown times
+    // polling_delay
+    const auto slow = AdaptPollingDelay(info, ThrottlingSeverity::NONE, 20, 30, kPollingDelay,
+                                        kPollingDelay);
+    EXPECT_EQ(slow, kPollingDelay * kAdaptivePollingMaxSlowdown);
+    EXPECT_EQ(AdaptPollingDelay(info, ThrottlingSeverity::NONE, 20, 20, slow, slow), slow);
+}
+
+TEST(ThermalAdaptivePollingTest, resetsToBaseDelayOnceThrottling) {
+    const auto info = adaptiveSensor();
+
+    // Throttling at LIGHT polls at passive_delay, steady or cooling, and doesn't slow down
+    EXPECT_EQ(AdaptPollingDelay(info, ThrottlingSeverity::LIGHT, 41, 41, kPollingDelay,
+                                kPassiveDelay),
+              kPassiveDelay);
+    EXPECT_EQ(AdaptPollingDelay(info, ThrottlingSeverity::LIGHT, 41, 43, kPassiveDelay,
+                                kPassiveDelay),
+              kPassiveDelay);
+    // Not throttling the sensor itself but a trigger of its is: passive_delay, no slow-down
+    EXPECT_EQ(AdaptPollingDelay(info, ThrottlingSeverity::NONE, 30, 30, kPollingDelay,
+                                kPassiveDelay),
+              kPassiveDelay);
+    // Past the last threshold there is nothing to adapt to
+    EXPECT_EQ(AdaptPollingDelay(info, ThrottlingSeverity::MODERATE, 50, 46, kPassiveDelay,
+                                kPassiveDelay),
+              kPassiveDelay);
+    // Heading for MODERATE speeds up from passive_delay
+    EXPECT_EQ(AdaptPollingDelay(info, ThrottlingSeverity::LIGHT, 42, 41, kPassiveDelay,
+                                kPassiveDelay),
+              milliseconds(1000));
+    EXPECT_EQ(AdaptPollingDelay(info, ThrottlingSeverity::LIGHT, 44, 43, milliseconds(1024),
+                                kPassiveDelay),
+              milliseconds(512));
+}
+
+TEST(ThermalAdaptivePollingTest, keepsDelayWithoutRate) {
+    const auto info = adaptiveSensor();
+
+    EXPECT_EQ(AdaptPollingDelay(info, ThrottlingSeverity::NONE, NAN, 30, kPollingDelay,
+                                kPollingDelay),
+              kPollingDelay);
+    EXPECT_EQ(AdaptPollingDelay(info, ThrottlingSeverity::NONE, 39, NAN, kPollingDelay,
+                                kPollingDelay),
+              kPollingDelay);
+    EXPECT_EQ(AdaptPollingDelay(info, ThrottlingSeverity::NONE, 39, 38, milliseconds(0),
+                                kPollingDelay),
+              kPollingDelay);
+    EXPECT_EQ(AdaptPollingDelay(info, ThrottlingSeverity::NONE, 39, 38, kPollingDelay,
+                                milliseconds::max()),
+              milliseconds::max());
+}
+
+}  // namespace aidl::android::hardware::thermal::implementation
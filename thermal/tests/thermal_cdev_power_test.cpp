@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "utils/thermal_cdev_power.h"
+
+namespace aidl::android::hardware::thermal::implementation {
+
+namespace {
+
+// The shallowest state whose power fits, scanning all but the deepest state
+int scanState(const std::vector<float> &state2power, float power_budget) {
+    size_t i = 0;
+    while (i + 1 < state2power.size() && power_budget < state2power[i]) {
+        ++i;
+    }
+    return i;
+}
+
+}  // namespace
+
+TEST(CdevPowerTablesTest, powerToStateMatchesScan) {
+    CdevPowerTables tables;
+    const std::vector<size_t> num_states = {1, 2, 8, 24, 40};
+    for (size_t id = 0; id < num_states.size(); ++id) {
+        std::vector<float> state2power;
+        for (size_t i = 0; i < num_states[id]; ++i) {
+            // Flat steps, like states sharing a frequency
+            state2power.push_back(100.0f * ((num_states[id] - i) / 2));
+        }
+        tables.set(id, state2power);
+    }
+    for (size_t id = 0; id < num_states.size(); ++id) {
+        const auto state2power = tables.get(id);
+        ASSERT_EQ(num_states[id], state2power.size());
+        for (float budget = -50.0f; budget < 100.0f * num_states[id]; budget += 25.0f) {
+            EXPECT_EQ(scanState(state2power, budget), tables.powerToState(id, budget))
+                    << num_states[id] << " states, budget " << budget;
+        }
+    }
+}
+
+TEST(CdevPowerTablesTest, powerToStateScansUnsortedTables) {
+    CdevPowerTables tables;
+    std::vector<float> state2power(30, 100.0f);
+    state2power[3] = 500.0f;
+    tables.set(0, state2power);
+    EXPECT_EQ(0, tables.powerToState(0, 200.0f));
+    EXPECT_EQ(29, tables.powerToState(0, 50.0f));
+
+    state2power.assign(30, 100.0f);
+    state2power[0] = NAN;
+    tables.set(0, state2power);
+    EXPECT_EQ(1, tables.powerToState(0, 200.0f));
+}
+
+TEST(CdevPowerTablesTest, stateToPower) {
+    CdevPowerTables tables;
+    tables.set(1, {300.0f, 200.0f, 100.0f});
+    EXPECT_FALSE(tables.has(0));
+    EXPECT_TRUE(tables.has(1));
+    EXPECT_EQ(200.0f, tables.stateToPower(1, 1));
+    EXPECT_TRUE(std::isnan(tables.stateToPower(1, 3)));
+    EXPECT_TRUE(std::isnan(tables.stateToPower(1, -1)));
+    EXPECT_TRUE(std::isnan(tables.stateToPower(0, 0)));
+    EXPECT_TRUE(std::isnan(tables.stateToPower(2, 0)));
+    EXPECT_EQ(0, tables.powerToState(0, 0.0f));
+}
+
+TEST(CdevPowerTablesTest, replaceKeepsOtherTables) {
+    CdevPowerTables tables;
+    tables.set(0, {30.0f, 20.0f, 10.0f});
+    tables.set(1, {60.0f, 50.0f});
+    tables.set(2, {90.0f, 80.0f, 70.0f});
+
+    // Same size is rewritten in place, a new size repacks the tables
+    tables.set(1, {65.0f, 55.0f});
+    EXPECT_EQ(std::vector<float>({65.0f, 55.0f}), tables.get(1));
+    tables.set(0, {35.0f, 25.0f, 15.0f, 5.0f});
+    EXPECT_EQ(std::vector<float>({35.0f, 25.0f, 15.0f, 5.0f}), tables.get(0));
+    EXPECT_EQ(std::vector<float>({65.0f, 55.0f}), tables.get(1));
+    EXPECT_EQ(std::vector<float>({90.0f, 80.0f, 70.0f}), tables.get(2));
+    EXPECT_EQ(3, tables.powerToState(0, 0.0f));
+    EXPECT_EQ(1, tables.powerToState(2, 85.0f));
+}
+
+TEST(CdevPowerTablesTest, parseState2PowerTable) {
+    std::vector<float> state2power;
+    EXPECT_TRUE(parseState2PowerTable("3000 2000\n1000 0\n", &state2power));
+    EXPECT_EQ(std::vector<float>({3000.0f, 2000.0f, 1000.0f, 0.0f}), state2power);
+    EXPECT_FALSE(parseState2PowerTable("\n", &state2power));
+    EXPECT_TRUE(state2power.empty());
+}
+
+}  // namespace aidl::android::hardware::thermal::implementation
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cmath>
+
+#include "utils/thermal_config_cache.h"
+
+namespace aidl::android::hardware::thermal::implementation {
+
+constexpr std::string_view kConfig(R"({
+    "Sensors": [
+        {
+            "Name": "skin",
+            "Type": "SKIN",
+            "HotThreshold": ["NAN", "NAN", "NAN", 45.0, "NAN", "NAN", "NAN"],
+            "Multiplier": 0.001,
+            "PollingDelay": 1000,
+            "PassiveDelay": 500,
+            "AdaptivePolling": true
+        },
+        {
+            "Name": "virtual-skin",
+            "Type": "SKIN",
+            "VirtualSensor": true,
+            "Formula": "WEIGHTED_AVG",
+            "Combination": ["skin"],
+            "Coefficient": ["1.0"],
+            "PollingDelay": 2000
+        }
+    ],
+    "CoolingDevices": [
+        {
+            "Name": "fan",
+            "Type": "FAN"
+        }
+    ]
+})");
+
+class ThermalConfigCacheTest : public testing::Test {
+  protected:
+    void SetUp() override {
+        config_path_ = std::string(config_dir_.path) + "/thermal_info_config.json";
+        compiled_path_ = std::string(cache_dir_.path) + "/thermal_info_config.json.bin";
+        ASSERT_TRUE(::android::base::WriteStringToFile(std::string(kConfig), config_path_));
+    }
+
+    void expectConfig(const ParsedThermalConfig &config) {
+        ASSERT_EQ(2u, config.sensor_info_map.size());
+        const SensorInfo &skin = config.sensor_info_map.at("skin");
+        EXPECT_EQ(TemperatureType::SKIN, skin.type);
+        EXPECT_FLOAT_EQ(45.0, skin.hot_thresholds[3]);
+        EXPECT_TRUE(std::isnan(skin.hot_thresholds[4]));
+        EXPECT_FLOAT_EQ(0.001, skin.multiplier);
+        EXPECT_EQ(std::chrono::milliseconds(1000), skin.polling_delay);
+        EXPECT_EQ(std::chrono::milliseconds(500), skin.passive_delay);
+        EXPECT_TRUE(skin.adaptive_polling);
+
+        const SensorInfo &virtual_skin = config.sensor_info_map.at("virtual-skin");
+        ASSERT_NE(nullptr, virtual_skin.virtual_sensor_info);
+        EXPECT_EQ(FormulaOption::WEIGHTED_AVG, virtual_skin.virtual_sensor_info->formula);
+        EXPECT_EQ(std::vector<std::string>{"skin"},
+                  virtual_skin.virtual_sensor_info->linked_sensors);
+        EXPECT_FALSE(virtual_skin.adaptive_polling);
+        EXPECT_NE(skin.id, virtual_skin.id);
+
+        ASSERT_EQ(1u, config.cooling_device_info_map.size());
+        EXPECT_EQ(CoolingType::FAN, config.cooling_device_info_map.at("fan").type);
+    }
+
+    TemporaryDir config_dir_;
+    TemporaryDir cache_dir_;
+    std::string config_path_;
+    std::string compiled_path_;
+};
+
+TEST_F(ThermalConfigCacheTest, compilesAndReloadsConfig) {
+    ParsedThermalConfig parsed;
+    ASSERT_TRUE(LoadThermalConfig(config_path_, cache_dir_.path, &parsed));
+    expectConfig(parsed);
+    ASSERT_EQ(0, access(compiled_path_.c_str(), R_OK));
+
+    // The second load reads the compiled copy
+    ParsedThermalConfig loaded;
+    ASSERT_TRUE(LoadThermalConfig(config_path_, cache_dir_.path, &loaded));
+    expectConfig(loaded);
+    EXPECT_EQ(parsed.sensor_info_map.at("skin").id, loaded.sensor_info_map.at("skin").id);
+}
+
+TEST_F(ThermalConfigCacheTest, recompilesWhenConfigChanges) {
+    ParsedThermalConfig parsed;
+    ASSERT_TRUE(LoadThermalConfig(config_path_, cache_dir_.path, &parsed));
+    std::string compiled;
+    ASSERT_TRUE(::android::base::ReadFileToString(compiled_path_, &compiled));
+
+    std::string config(kConfig);
+    config.replace(config.find("45.0"), 4, "50.0");
+    ASSERT_TRUE(::android::base::WriteStringToFile(config, config_path_));
+    ParsedThermalConfig reparsed;
+    ASSERT_TRUE(LoadThermalConfig(config_path_, cache_dir_.path, &reparsed));
+    EXPECT_FLOAT_EQ(50.0, reparsed.sensor_info_map.at("skin").hot_thresholds[3]);
+
+    std::string recompiled;
+    ASSERT_TRUE(::android::base::ReadFileToString(compiled_path_, &recompiled));
+    EXPECT_NE(compiled, recompiled);
+}
+
+TEST_F(ThermalConfigCacheTest, fallsBackOnCorruptedCache) {
+    ParsedThermalConfig parsed;
+    ASSERT_TRUE(LoadThermalConfig(config_path_, cache_dir_.path, &parsed));
+
+    std::string compiled;
+    ASSERT_TRUE(::android::base::ReadFileToString(compiled_path_, &compiled));
+    compiled[compiled.size() - 1] ^= 0xff;
+    ASSERT_TRUE(::android::base::WriteStringToFile(compiled, compiled_path_));
+    ParsedThermalConfig reparsed;
+    ASSERT_TRUE(LoadThermalConfig(config_path_, cache_dir_.path, &reparsed));
+    expectConfig(reparsed);
+
+    // Truncated down to part of the header
+    ASSERT_TRUE(::android::base::WriteStringToFile(compiled.substr(0, 8), compiled_path_));
+    ParsedThermalConfig truncated;
+    ASSERT_TRUE(LoadThermalConfig(config_path_, cache_dir_.path, &truncated));
+    expectConfig(truncated);
+}
+
+TEST_F(ThermalConfigCacheTest, parsesWithoutCacheDir) {
+    ParsedThermalConfig parsed;
+    ASSERT_TRUE(LoadThermalConfig(config_path_, "", &parsed));
+    expectConfig(parsed);
+    EXPECT_NE(0, access(compiled_path_.c_str(), F_OK));
+}
+
+TEST_F(ThermalConfigCacheTest, loadsPrebuiltCompiledConfig) {
+    const std::string prebuilt_path = config_path_ + ".bin";
+    ASSERT_TRUE(CompileThermalConfig(config_path_, prebuilt_path));
+
+    // Loaded from next to the config, so nothing is compiled into the cache dir
+    ParsedThermalConfig loaded;
+    ASSERT_TRUE(LoadThermalConfig(config_path_, cache_dir_.path, &loaded));
+    expectConfig(loaded);
+    EXPECT_NE(0, access(compiled_path_.c_str(), F_OK));
+
+    // A prebuilt left behind by a config change is ignored
+    std::string config(kConfig);
+    config.replace(config.find("45.0"), 4, "50.0");
+    ASSERT_TRUE(::android::base::WriteStringToFile(config, config_path_));
+    ParsedThermalConfig reparsed;
+    ASSERT_TRUE(LoadThermalConfig(config_path_, cache_dir_.path, &reparsed));
+    EXPECT_FLOAT_EQ(50.0, reparsed.sensor_info_map.at("skin").hot_thresholds[3]);
+    EXPECT_EQ(0, access(compiled_path_.c_str(), R_OK));
+}
+
+TEST_F(ThermalConfigCacheTest, compileRejectsInvalidConfig) {
+    ASSERT_TRUE(::android::base::WriteStringToFile(R"({"Sensors": [{"Name": "skin"}]})",
+                                                   config_path_));
+    const std::string prebuilt_path = config_path_ + ".bin";
+    EXPECT_FALSE(CompileThermalConfig(config_path_, prebuilt_path));
+    EXPECT_FALSE(CompileThermalConfig(config_path_, ""));
+    EXPECT_NE(0, access(prebuilt_path.c_str(), F_OK));
+}
+
+}  // namespace aidl::android::hardware::thermal::implementation
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "utils/thermal_emul_script.h"
+
+namespace aidl::android::hardware::thermal::implementation {
+
+TEST(ThermalEmulScriptTest, parsesSteps) {
+    std::vector<EmulScriptStep> steps;
+    std::string error;
+    ASSERT_TRUE(ParseEmulScript("# warm up\n"
+                                "time_ms, VIRTUAL-SKIN, battery\n"
+                                "0,30,32\r\n"
+                                "\n"
+                                "1000,35.5,\n"
+                                "2000,-\n",
+                                &steps, &error))
+            << error;
+    ASSERT_EQ(3u, steps.size());
+    EXPECT_EQ(std::chrono::milliseconds(0), steps[0].time);
+    ASSERT_EQ(2u, steps[0].temps.size());
+    EXPECT_EQ("VIRTUAL-SKIN", steps[0].temps[0].first);
+    EXPECT_EQ(30, steps[0].temps[0].second);
+    EXPECT_EQ("battery", steps[0].temps[1].first);
+    // An empty cell leaves the sensor out
+    ASSERT_EQ(1u, steps[1].temps.size());
+    EXPECT_EQ(35.5, steps[1].temps[0].second);
+    ASSERT_EQ(1u, steps[2].temps.size());
+    EXPECT_TRUE(std::isnan(steps[2].temps[0].second));
+}
+
+TEST(ThermalEmulScriptTest, rejectsBadScripts) {
+    std::vector<EmulScriptStep> steps;
+    std::string error;
+    EXPECT_FALSE(ParseEmulScript("", &steps, &error));
+    EXPECT_FALSE(ParseEmulScript("time,skin\n0,30\n", &steps, &error));
+    EXPECT_FALSE(ParseEmulScript("time_ms,skin\n", &steps, &error));
+    EXPECT_FALSE(ParseEmulScript("time_ms,skin\n0,30,31\n", &steps, &error));
+    EXPECT_FALSE(ParseEmulScript("time_ms,skin\n0,hot\n", &steps, &error));
+    EXPECT_FALSE(ParseEmulScript("time_ms,skin\n1000,30\n0,31\n", &steps, &error));
+    EXPECT_NE(std::string::npos, error.find("line 3"));
+}
+
+TEST(ThermalEmulScriptTest, playsStepsThenClears) {
+    std::mutex mutex;
+    std::vector<float> applied;
+    int clears = 0;
+    ThermalEmulScriptPlayer player(
+            [&](const std::vector<std::pair<std::string, float>> &temps) {
+                std::lock_guard<std::mutex> lock(mutex);
+                applied.push_back(temps[0].second);
+            },
+            [&] {
+                std::lock_guard<std::mutex> lock(mutex);
+                clears++;
+            });
+    std::vector<EmulScriptStep> steps;
+    std::string error;
+    ASSERT_TRUE(ParseEmulScript("time_ms,skin\n0,30\n1000,40\n2000,50\n", &steps, &error));
+
+    // 2 seconds of script at 100x
+    player.start(std::move(steps), "test", 100);
+    const auto report = player.activeReport();
+    ASSERT_NE(nullptr, report);
+    report->recordTick(std::chrono::microseconds(300));
+    report->recordSeverityChange();
+    report->recordCdevRequests(2);
+    for (int i = 0; i < 100 && !report->isFinished(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(report->isFinished());
+    EXPECT_EQ(nullptr, player.activeReport());
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        EXPECT_EQ((std::vector<float>{30, 40, 50}), applied);
+        EXPECT_EQ(1, clears);
+    }
+
+    std::ostringstream dump_buf;
+    player.dump(&dump_buf);
+    const std::string dump = dump_buf.str();
+    EXPECT_NE(std::string::npos, dump.find("Steps: 3 State: done"));
+    EXPECT_NE(std::string::npos, dump.find("StepLateness: Count: 3"));
+    EXPECT_NE(std::string::npos, dump.find("SeverityChanges: 1 CdevRequests: 2"));
+}
+
+TEST(ThermalEmulScriptTest, stopClearsEarly) {
+    std::atomic<int> applied = 0;
+    std::atomic<int> clears = 0;
+    ThermalEmulScriptPlayer player([&](const auto &) { applied++; }, [&] { clears++; });
+    std::vector<EmulScriptStep> steps;
+    std::string error;
+    ASSERT_TRUE(ParseEmulScript("time_ms,skin\n0,30\n3600000,40\n", &steps, &error));
+
+    player.start(std::move(steps), "test", 1);
+    const auto report = player.activeReport();
+    ASSERT_NE(nullptr, report);
+    player.stop();
+    EXPECT_TRUE(report->isFinished());
+    EXPECT_LE(applied, 1);
+    EXPECT_EQ(1, clears);
+
+    std::ostringstream dump_buf;
+    player.dump(&dump_buf);
+    EXPECT_NE(std::string::npos, dump_buf.str().find("State: stopped"));
+}
+
+}  // namespace aidl::android::hardware::thermal::implementation
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include "utils/thermal_files.h"
+
+namespace aidl::android::hardware::thermal::implementation {
+
+class ThermalFilesTest : public testing::TestWithParam<bool> {};
+
+TEST_P(ThermalFilesTest, readsNumbers) {
+    TemporaryFile file;
+    ThermalFiles files(GetParam());
+    ASSERT_TRUE(files.addThermalFile("skin", file.path));
+    EXPECT_FALSE(files.addThermalFile("skin", file.path));
+
+    float temp = 0;
+    ASSERT_TRUE(::android::base::WriteStringToFile("41234\n", file.path));
+    ASSERT_TRUE(files.readThermalFile("skin", &temp));
+    EXPECT_FLOAT_EQ(41234, temp);
+
+    // Every read sees the current content of the file
+    ASSERT_TRUE(::android::base::WriteStringToFile("-5000\n", file.path));
+    ASSERT_TRUE(files.readThermalFile("skin", &temp));
+    EXPECT_FLOAT_EQ(-5000, temp);
+
+    ASSERT_TRUE(::android::base::WriteStringToFile("36.5\n", file.path));
+    ASSERT_TRUE(files.readThermalFile("skin", &temp));
+    EXPECT_FLOAT_EQ(36.5, temp);
+
+    std::string data;
+    ASSERT_TRUE(files.readThermalFile("skin", &data));
+    EXPECT_EQ("36.5", data);
+
+    ASSERT_TRUE(::android::base::WriteStringToFile("\n", file.path));
+    EXPECT_FALSE(files.readThermalFile("skin", &temp));
+    EXPECT_FLOAT_EQ(36.5, temp);
+    EXPECT_FALSE(files.readThermalFile("unknown", &temp));
+}
+
+TEST_P(ThermalFilesTest, opensLateFile) {
+    TemporaryDir dir;
+    const std::string path = std::string(dir.path) + "/temp";
+    ThermalFiles files(GetParam());
+    // Not there yet when added
+    ASSERT_TRUE(files.addThermalFile("skin", path));
+
+    float temp = 0;
+    EXPECT_FALSE(files.readThermalFile("skin", &temp));
+    ASSERT_TRUE(::android::base::WriteStringToFile("30000\n", path));
+    ASSERT_TRUE(files.readThermalFile("skin", &temp));
+    EXPECT_FLOAT_EQ(30000, temp);
+}
+
+TEST(ThermalFilesCdevTest, writesChangedStates) {
+    TemporaryFile fan;
+    TemporaryFile cpu;
+    ThermalFiles files;
+    ASSERT_TRUE(files.addCdevFile(1, "fan", fan.path));
+    ASSERT_TRUE(files.addCdevFile(0, "cpu", cpu.path));
+    EXPECT_FALSE(files.addCdevFile(1, "fan", fan.path));
+
+    std::string data;
+    ASSERT_TRUE(files.writeCdevStates({{.cdev_id = 1, .state = 3}, {.cdev_id = 0, .state = 5}}));
+    ASSERT_TRUE(::android::base::ReadFileToString(fan.path, &data));
+    EXPECT_EQ("3", data);
+    ASSERT_TRUE(::android::base::ReadFileToString(cpu.path, &data));
+    EXPECT_EQ("5", data);
+
+    // A cdev which already holds the state is not written again
+    ASSERT_TRUE(::android::base::WriteStringToFile("7", fan.path));
+    ASSERT_TRUE(files.writeCdevStates({{.cdev_id = 1, .state = 3}}));
+    ASSERT_TRUE(::android::base::ReadFileToString(fan.path, &data));
+    EXPECT_EQ("7", data);
+    ASSERT_TRUE(files.writeCdevStates({{.cdev_id = 1, .state = 4}}));
+    ASSERT_TRUE(::android::base::ReadFileToString(fan.path, &data));
+    EXPECT_EQ("4", data);
+
+    EXPECT_FALSE(files.writeCdevStates({{.cdev_id = 2, .state = 1}}));
+}
+
+INSTANTIATE_TEST_SUITE_P(KeepFdOpen, ThermalFilesTest, testing::Bool());
+
+}  // namespace aidl::android::hardware::thermal::implementation
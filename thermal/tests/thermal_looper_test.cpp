@@ -93,4 +93,74 @@ TEST_F(ThermalLooperTest, AsyncCallbackTest) {
     ASSERT_THAT(callbackWithType->getTemperatures(), testing::UnorderedElementsAreArray({t1}));
 }
 
+// Blocks in the first notification until released
+class BlockingCallback : public TestCallback {
+  public:
+    ndk::ScopedAStatus notifyThrottling(const Temperature &t) override {
+        {
+            std::unique_lock<std::mutex> lock(mBlockMutex);
+            mBlocked = true;
+            mBlockCv.notify_all();
+            mBlockCv.wait(lock, [this] { return mReleased; });
+        }
+        return TestCallback::notifyThrottling(t);
+    }
+
+    void waitBlocked() {
+        std::unique_lock<std::mutex> lock(mBlockMutex);
+        mBlockCv.wait(lock, [this] { return mBlocked; });
+    }
+
+    void release() {
+        std::lock_guard<std::mutex> lock(mBlockMutex);
+        mReleased = true;
+        mBlockCv.notify_all();
+    }
+
+  private:
+    std::mutex mBlockMutex;
+    std::condition_variable mBlockCv;
+    bool mBlocked = false;
+    bool mReleased = false;
+};
+
+TEST_F(ThermalLooperTest, SlowCallbackTest) {
+    ON_CALL(*helper, fillCurrentTemperatures).WillByDefault(testing::Return(false));
+    std::shared_ptr<BlockingCallback> slowCallback = ndk::SharedRefBase::make<BlockingCallback>();
+    std::shared_ptr<TestCallback> callback = ndk::SharedRefBase::make<TestCallback>();
+    ASSERT_TRUE(thermal->registerThermalChangedCallback(slowCallback).isOk());
+    ASSERT_TRUE(thermal->registerThermalChangedCallback(callback).isOk());
+
+    Temperature skin;
+    skin.name = "skin";
+    skin.type = TemperatureType::SKIN;
+    skin.throttlingStatus = ThrottlingSeverity::LIGHT;
+    Temperature cpu;
+    cpu.name = "cpu";
+    cpu.type = TemperatureType::CPU;
+    cpu.throttlingStatus = ThrottlingSeverity::MODERATE;
+
+    thermal->sendThermalChangedCallback(skin);
+    slowCallback->waitBlocked();
+    skin.throttlingStatus = ThrottlingSeverity::MODERATE;
+    thermal->sendThermalChangedCallback(skin);
+    thermal->sendThermalChangedCallback(cpu);
+    skin.throttlingStatus = ThrottlingSeverity::SEVERE;
+    thermal->sendThermalChangedCallback(skin);
+
+    // The slow client doesn't hold up the others
+    sleep(1);
+    ASSERT_EQ(4u, callback->getTemperatures().size());
+    ASSERT_TRUE(slowCallback->getTemperatures().empty());
+
+    // Only the latest notification of skin is left for the slow client
+    slowCallback->release();
+    sleep(1);
+    const auto temperatures = slowCallback->getTemperatures();
+    ASSERT_EQ(3u, temperatures.size());
+    EXPECT_EQ(ThrottlingSeverity::LIGHT, temperatures[0].throttlingStatus);
+    EXPECT_EQ(ThrottlingSeverity::SEVERE, temperatures[1].throttlingStatus);
+    EXPECT_EQ("cpu", temperatures[2].name);
+}
+
 }  // namespace aidl::android::hardware::thermal::implementation
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <unordered_map>
+
+#include "utils/thermal_sensor_eval.h"
+
+namespace aidl::android::hardware::thermal::implementation {
+
+namespace {
+
+class FakeSensorInputs : public SensorInputReader {
+  public:
+    bool readSensor(std::string_view sensor_name, size_t sensor_node, float *temp,
+                    std::map<std::string, float> *sensor_log_map) override {
+        nodes_read.push_back(sensor_node);
+        const auto it = temps.find(std::string(sensor_name));
+        if (it == temps.end()) {
+            return false;
+        }
+        *temp = it->second;
+        (*sensor_log_map)[it->first] = *temp;
+        return true;
+    }
+    bool readPower(std::string_view power_rail, float *power) override {
+        const auto it = powers.find(std::string(power_rail));
+        if (it == powers.end()) {
+            return false;
+        }
+        *power = it->second;
+        return true;
+    }
+
+    std::unordered_map<std::string, float> temps;
+    std::unordered_map<std::string, float> powers;
+    std::vector<size_t> nodes_read;
+};
+
+VirtualSensorInfo weightedAvg(std::vector<std::string> linked_sensors,
+                              std::vector<SensorFusionType> linked_sensors_type,
+                              std::vector<std::string> coefficients) {
+    VirtualSensorInfo info;
+    info.linked_sensors = std::move(linked_sensors);
+    info.linked_sensors_type = std::move(linked_sensors_type);
+    info.coefficients = std::move(coefficients);
+    info.coefficients_type.assign(info.coefficients.size(), SensorFusionType::CONSTANT);
+    info.offset = 1000;
+    info.formula = FormulaOption::WEIGHTED_AVG;
+    return info;
+}
+
+}  // namespace
+
+TEST(ThermalSensorEvalTest, computesFormulaFromInputs) {
+    FakeSensorInputs inputs;
+    inputs.temps = {{"skin", 30000}};
+    inputs.powers = {{"rail", 2000}};
+    const auto info = weightedAvg({"skin", "rail"},
+                                  {SensorFusionType::SENSOR, SensorFusionType::ODPM}, {"0.5", "2"});
+    std::map<std::string, float> sensor_log_map;
+    float temp = NAN;
+
+    ASSERT_TRUE(EvaluateVirtualSensor("virtual-skin", 0, info, {4, kNoSensorNode}, {},
+                                      kNoSensorNode, &inputs, &sensor_log_map, &temp));
+    EXPECT_FLOAT_EQ(30000 * 0.5 + 2000 * 2 + 1000, temp);
+    EXPECT_EQ(std::vector<size_t>{4}, inputs.nodes_read);
+    EXPECT_FLOAT_EQ(30000, sensor_log_map["skin"]);
+    EXPECT_FLOAT_EQ(2000, sensor_log_map["rail"]);
+}
+
+TEST(ThermalSensorEvalTest, isNanWhileInputIsCollected) {
+    FakeSensorInputs inputs;
+    inputs.temps = {{"skin", 30000}};
+    inputs.powers = {{"rail", NAN}};
+    const auto info = weightedAvg({"skin", "rail"},
+                                  {SensorFusionType::SENSOR, SensorFusionType::ODPM}, {"1", "1"});
+    std::map<std::string, float> sensor_log_map;
+    float temp = 0;
+
+    ASSERT_TRUE(EvaluateVirtualSensor("virtual-skin", 0, info, {}, {}, kNoSensorNode, &inputs,
+                                      &sensor_log_map, &temp));
+    EXPECT_TRUE(std::isnan(temp));
+    EXPECT_EQ(0u, sensor_log_map.count("rail"));
+}
+
+TEST(ThermalSensorEvalTest, failsOnUnreadableInput) {
+    FakeSensorInputs inputs;
+    inputs.temps = {{"skin", 30000}};
+    std::map<std::string, float> sensor_log_map;
+    float temp = NAN;
+
+    EXPECT_FALSE(EvaluateVirtualSensor("virtual-skin", 0,
+                                       weightedAvg({"skin", "modem"},
+                                                   {SensorFusionType::SENSOR,
+                                                    SensorFusionType::SENSOR},
+                                                   {"1", "1"}),
+                                       {}, {}, kNoSensorNode, &inputs, &sensor_log_map, &temp));
+    EXPECT_FALSE(EvaluateVirtualSensor("virtual-skin", 0,
+                                       weightedAvg({"rail"}, {SensorFusionType::ODPM}, {"1"}), {},
+                                       {}, kNoSensorNode, &inputs, &sensor_log_map, &temp));
+}
+
+TEST(ThermalSensorEvalTest, smoothsRecentReadingsByStepRatio) {
+    SensorInfo sensor_info = {};
+    sensor_info.passive_delay = std::chrono::milliseconds(500);
+    sensor_info.step_ratio = 0.25;
+
+    EXPECT_FLOAT_EQ(0.25 * 40000 + 0.75 * 36000,
+                    SmoothSensorTemp(sensor_info, 40000, 36000, std::chrono::milliseconds(999)));
+    // The cached reading is too old, or there is none
+    EXPECT_FLOAT_EQ(40000,
+                    SmoothSensorTemp(sensor_info, 40000, 36000, std::chrono::milliseconds(1000)));
+    EXPECT_FLOAT_EQ(40000,
+                    SmoothSensorTemp(sensor_info, 40000, NAN, std::chrono::milliseconds(100)));
+
+    sensor_info.step_ratio = NAN;
+    EXPECT_FLOAT_EQ(40000,
+                    SmoothSensorTemp(sensor_info, 40000, 36000, std::chrono::milliseconds(100)));
+}
+
+}  // namespace aidl::android::hardware::thermal::implementation
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "utils/thermal_throttling.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace thermal {
+namespace implementation {
+
+namespace {
+
+using ::android::base::StringPrintf;
+
+// About what a phone config binds: skin and SoC sensors throttling the CPU
+// clusters, GPU, TPU, modem and display, with tables of ~20 states
+constexpr size_t kNumSensors = 8;
+constexpr size_t kNumCdevs = 8;
+constexpr size_t kCdevsPerSensor = 6;
+constexpr int kNumStates = 20;
+
+std::vector<float> makeState2Power(int num_states, float max_power) {
+    std::vector<float> state2power(num_states);
+    for (int i = 0; i < num_states; ++i) {
+        state2power[i] = max_power * (num_states - i) / num_states;
+    }
+    return state2power;
+}
+
+ThrottlingArray filledArray(float value) {
+    ThrottlingArray array;
+    array.fill(value);
+    return array;
+}
+
+CdevArray filledCdevArray(int value) {
+    CdevArray array;
+    array.fill(value);
+    return array;
+}
+
+class ThrottlingFixture {
+  public:
+    ThrottlingFixture() {
+        for (size_t i = 0; i < kNumCdevs; ++i) {
+            const std::string name = StringPrintf("cdev%zu", i);
+            cdevs_[name] = CdevInfo{
+                    .state2power = makeState2Power(kNumStates, 4000.0f - 300.0f * i),
+                    .max_state = kNumStates - 1,
+                    .id = i,
+            };
+            power_status_[name + "_rail"].last_updated_avg_power = 1500.0f + 100.0f * i;
+        }
+        for (size_t i = 0; i < kNumSensors; ++i) {
+            auto throttling_info = std::make_shared<ThrottlingInfo>();
+            throttling_info->k_po = filledArray(50.0f);
+            throttling_info->k_pu = filledArray(30.0f);
+            throttling_info->k_i = filledArray(5.0f);
+            throttling_info->k_d = filledArray(0.0f);
+            throttling_info->i_max = filledArray(2000.0f);
+            throttling_info->max_alloc_power = filledArray(20000.0f);
+            throttling_info->min_alloc_power = filledArray(1000.0f);
+            throttling_info->s_power = filledArray(8000.0f);
+            throttling_info->i_cutoff = filledArray(20.0f);
+            throttling_info->i_default = 0.0f;
+            throttling_info->i_default_pct = NAN;
+            for (size_t j = 0; j < kCdevsPerSensor; ++j) {
+                const std::string cdev = StringPrintf("cdev%zu", (i + j) % kNumCdevs);
+                throttling_info->binded_cdev_info_map[cdev] = BindedCdevInfo{
+                        .limit_info = filledCdevArray(0),
+                        .power_thresholds = filledArray(NAN),
+                        .release_logic = ReleaseLogic::NONE,
+                        .cdev_weight_for_pid = filledArray(1.0f + j),
+                        .cdev_ceiling = filledCdevArray(kNumStates - 1),
+                        .max_release_step = std::numeric_limits<int>::max(),
+                        .max_throttle_step = std::numeric_limits<int>::max(),
+                        .cdev_floor_with_power_link = filledCdevArray(0),
+                        .power_rail = cdev + "_rail",
+                        .high_power_check = false,
+                        .throttling_with_power_link = false,
+                        .enabled = true,
+                };
+            }
+            auto &sensor = sensors_[StringPrintf("sensor%zu", i)];
+            sensor.hot_thresholds = filledArray(NAN);
+            sensor.hot_thresholds[static_cast<size_t>(ThrottlingSeverity::SEVERE)] = 45.0f;
+            sensor.multiplier = 1.0f;
+            sensor.throttling_info = std::move(throttling_info);
+            sensor.id = i;
+        }
+        for (const auto &[name, sensor] : sensors_) {
+            throttling_.registerThermalThrottling(name, sensor, cdevs_);
+        }
+    }
+
+    // One watcher tick: every sensor hot enough for its PID to allocate power
+    void tick(float temp_value) {
+        for (const auto &[name, sensor] : sensors_) {
+            const Temperature temp = {.name = name, .value = temp_value};
+            throttling_.thermalThrottlingUpdate(temp, sensor, ThrottlingSeverity::SEVERE,
+                                                std::chrono::milliseconds(1000), power_status_,
+                                                cdevs_);
+        }
+    }
+
+  private:
+    std::unordered_map<std::string, CdevInfo> cdevs_;
+    std::unordered_map<std::string, PowerStatus> power_status_;
+    std::unordered_map<std::string, SensorInfo> sensors_;
+    ThermalThrottling throttling_;
+};
+
+void BM_ThrottlingTick(benchmark::State &state) {
+    ::android::base::SetMinimumLogSeverity(::android::base::WARNING);
+    ThrottlingFixture fixture;
+    float temp = 46.0f;
+    for (auto _ : state) {
+        fixture.tick(temp);
+        temp = temp > 50.0f ? 46.0f : temp + 0.5f;
+    }
+    state.counters["sensors/s"] = benchmark::Counter(static_cast<double>(kNumSensors),
+                                                     benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_ThrottlingTick);
+
+// Power to state conversion of a table of state.range(0) states, bisected or scanned
+void BM_CdevStateOfPower(benchmark::State &state) {
+    auto state2power = makeState2Power(state.range(0), 4000.0f);
+    if (!state.range(1)) {
+        // A rising deepest but one state keeps the table from being bisected
+        state2power[state2power.size() - 2] = state2power.front() + 1.0f;
+    }
+    CdevPowerTables tables;
+    tables.set(0, state2power);
+    float budget = 0.0f;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tables.powerToState(0, budget));
+        budget = budget > 4000.0f ? 0.0f : budget + 37.0f;
+    }
+}
+BENCHMARK(BM_CdevStateOfPower)->ArgsProduct({{8, 20, 64}, {0, 1}});
+
+}  // namespace
+
+}  // namespace implementation
+}  // namespace thermal
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
+
+BENCHMARK_MAIN();
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "utils/thermal_tick_stats.h"
+
+namespace aidl::android::hardware::thermal::implementation {
+
+TEST(LatencyHistogramTest, bucketsByUpperLimit) {
+    LatencyHistogram histogram;
+    histogram.record(std::chrono::microseconds(99));
+    histogram.record(std::chrono::microseconds(100));
+    histogram.record(std::chrono::microseconds(60000));
+    EXPECT_EQ(3u, histogram.count());
+    EXPECT_EQ(1u, histogram.bucketCount(0));
+    EXPECT_EQ(1u, histogram.bucketCount(1));
+    EXPECT_EQ(1u, histogram.bucketCount(LatencyHistogram::kBucketLimitsUs.size()));
+}
+
+TEST(ThermalTickStatsTest, countsTicksOverPreviousBudget) {
+    ThermalTickStats stats;
+    stats.init({"skin", "virtual-skin"});
+    stats.recordSensorRead(1, std::chrono::microseconds(300));
+    // Out of range sensors are ignored
+    stats.recordSensorRead(2, std::chrono::microseconds(300));
+
+    const ThermalTickStats::TickTiming slow_tick = {
+            .total = std::chrono::milliseconds(20),
+            .throttling_update = std::chrono::milliseconds(5),
+            .cdev_update = std::chrono::milliseconds(1),
+    };
+    // No budget before the first tick
+    stats.recordTick(slow_tick, std::chrono::milliseconds(10));
+    stats.recordTick(slow_tick, std::chrono::milliseconds(100));
+    stats.recordTick(slow_tick, std::chrono::milliseconds(100));
+
+    std::ostringstream dump_buf;
+    stats.dump(&dump_buf);
+    const std::string dump = dump_buf.str();
+    EXPECT_NE(std::string::npos, dump.find("Overruns: 1"));
+    EXPECT_NE(std::string::npos, dump.find("virtual-skin: Count: 1"));
+    EXPECT_EQ(std::string::npos, dump.find(" skin: "));
+}
+
+}  // namespace aidl::android::hardware::thermal::implementation
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "utils/thermal_trace.h"
+
+namespace aidl::android::hardware::thermal::implementation {
+
+class ThermalTraceTest : public testing::Test {
+  protected:
+    void SetUp() override { trace_path_ = std::string(trace_dir_.path) + "/thermal_trace"; }
+
+    TemporaryDir trace_dir_;
+    std::string trace_path_;
+};
+
+TEST_F(ThermalTraceTest, parsesRecordedTrace) {
+    {
+        ThermalTraceRecorder recorder;
+        ASSERT_TRUE(recorder.open(trace_path_));
+        recorder.beginTick(boot_clock::time_point(std::chrono::milliseconds(1000)));
+        recorder.recordSensorReading("skin", 35123);
+        recorder.recordSensorUpdate("skin");
+        recorder.recordEnergySample("rail", {.energy_counter = 123456, .duration = 1000});
+        recorder.recordSensorUpdate("virtual-skin");
+        recorder.endTick();
+        recorder.beginTick(boot_clock::time_point(std::chrono::milliseconds(1500)));
+        recorder.recordSensorUpdate("virtual-skin");
+        recorder.endTick();
+    }
+
+    std::vector<ThermalTraceTick> ticks;
+    ASSERT_TRUE(ParseThermalTrace(trace_path_, &ticks));
+    ASSERT_EQ(2u, ticks.size());
+    EXPECT_EQ(std::chrono::milliseconds(1000), ticks[0].time);
+    ASSERT_EQ(1u, ticks[0].sensor_readings.size());
+    EXPECT_EQ("skin", ticks[0].sensor_readings[0].first);
+    EXPECT_FLOAT_EQ(35123, ticks[0].sensor_readings[0].second);
+    ASSERT_EQ(1u, ticks[0].energy_samples.size());
+    EXPECT_EQ("rail", ticks[0].energy_samples[0].first);
+    EXPECT_EQ(123456u, ticks[0].energy_samples[0].second.energy_counter);
+    EXPECT_EQ(1000u, ticks[0].energy_samples[0].second.duration);
+    EXPECT_EQ((std::vector<std::string>{"skin", "virtual-skin"}), ticks[0].updated_sensors);
+
+    EXPECT_EQ(std::chrono::milliseconds(1500), ticks[1].time);
+    EXPECT_TRUE(ticks[1].sensor_readings.empty());
+    EXPECT_EQ(std::vector<std::string>{"virtual-skin"}, ticks[1].updated_sensors);
+}
+
+TEST_F(ThermalTraceTest, parsesNanReading) {
+    {
+        ThermalTraceRecorder recorder;
+        ASSERT_TRUE(recorder.open(trace_path_));
+        recorder.beginTick(boot_clock::time_point(std::chrono::milliseconds(1000)));
+        recorder.recordSensorReading("skin", NAN);
+        recorder.endTick();
+    }
+
+    std::vector<ThermalTraceTick> ticks;
+    ASSERT_TRUE(ParseThermalTrace(trace_path_, &ticks));
+    ASSERT_EQ(1u, ticks.size());
+    ASSERT_EQ(1u, ticks[0].sensor_readings.size());
+    EXPECT_EQ("skin", ticks[0].sensor_readings[0].first);
+    EXPECT_TRUE(std::isnan(ticks[0].sensor_readings[0].second));
+}
+
+TEST_F(ThermalTraceTest, rejectsMalformedTrace) {
+    std::vector<ThermalTraceTick> ticks;
+    // A reading before any tick
+    ASSERT_TRUE(::android::base::WriteStringToFile("S skin 35000\n", trace_path_));
+    EXPECT_FALSE(ParseThermalTrace(trace_path_, &ticks));
+
+    ticks.clear();
+    ASSERT_TRUE(::android::base::WriteStringToFile("T 1000\nE rail 12\n", trace_path_));
+    EXPECT_FALSE(ParseThermalTrace(trace_path_, &ticks));
+}
+
+}  // namespace aidl::android::hardware::thermal::implementation
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "virtualtemp_estimator/virtualtemp_estimator.h"
+
+namespace thermal {
+namespace vtestimator {
+
+namespace {
+
+// Weighted sum of the last samples, as the estimator computed it before the
+// history became a flat ring
+class ScalarLinearModel {
+  public:
+    ScalarLinearModel(size_t num_linked_sensors, size_t order, std::vector<float> coefficients)
+        : num_linked_sensors_(num_linked_sensors),
+          order_(order),
+          coefficients_(std::move(coefficients)),
+          samples_(order) {}
+
+    float estimate(const std::vector<float> &thermistors) {
+        if (count_ == 0) {
+            samples_.assign(order_, thermistors);
+        }
+        const size_t cur = count_ % order_;
+        samples_[cur] = thermistors;
+        int level = cur;
+        float value = 0;
+        for (size_t i = 0; i < order_; ++i) {
+            for (size_t j = 0; j < num_linked_sensors_; ++j) {
+                value += coefficients_[i * num_linked_sensors_ + j] * samples_[level][j];
+            }
+            level = (level > 0) ? level - 1 : order_ - 1;
+        }
+        count_++;
+        return value;
+    }
+
+  private:
+    const size_t num_linked_sensors_;
+    const size_t order_;
+    const std::vector<float> coefficients_;
+    std::vector<std::vector<float>> samples_;
+    size_t count_ = 0;
+};
+
+}  // namespace
+
+class VirtualTempLinearModelTest
+    : public testing::TestWithParam<std::tuple<size_t /* sensors */, size_t /* order */>> {};
+
+TEST_P(VirtualTempLinearModelTest, matchesScalarModel) {
+    const auto [num_linked_sensors, order] = GetParam();
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> coefficient(-0.5, 0.5);
+    std::uniform_real_distribution<float> temp(20000, 50000);
+
+    VtEstimationInitData init_data(kUseLinearModel);
+    init_data.linear_model_init_data.use_prev_samples = order > 1;
+    init_data.linear_model_init_data.prev_samples_order = order;
+    for (size_t i = 0; i < num_linked_sensors * order; ++i) {
+        init_data.linear_model_init_data.coefficients.push_back(coefficient(rng));
+    }
+    ScalarLinearModel reference(num_linked_sensors, order,
+                                init_data.linear_model_init_data.coefficients);
+    VirtualTempEstimator estimator("test", kUseLinearModel, num_linked_sensors);
+    ASSERT_EQ(kVtEstimatorOk, estimator.Initialize(init_data));
+
+    std::vector<float> thermistors(num_linked_sensors);
+    for (size_t tick = 0; tick < 3 * order + 5; ++tick) {
+        for (auto &t : thermistors) {
+            t = temp(rng);
+        }
+        std::vector<float> output;
+        ASSERT_EQ(kVtEstimatorOk, estimator.Estimate(thermistors, &output));
+        ASSERT_EQ(1, output.size());
+        const float expected = reference.estimate(thermistors);
+        // Only the order of the float additions differs
+        EXPECT_NEAR(expected, output[0], 1e-5 * 50000 * num_linked_sensors * order)
+                << "tick " << tick;
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Shapes, VirtualTempLinearModelTest,
+                         testing::Combine(testing::Values(1, 3, 8), testing::Values(1, 2, 7, 30)));
+
+}  // namespace vtestimator
+}  // namespace thermal
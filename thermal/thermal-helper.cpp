@@ -19,13 +19,17 @@
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/parseint.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <pixelboottiming/BootPhaseAtom.h>
+#include <pixeltrace/PixelTrace.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
+#include <functional>
 #include <iterator>
-#include <set>
 #include <sstream>
 #include <thread>
 #include <vector>
@@ -36,6 +40,9 @@ namespace hardware {
 namespace thermal {
 namespace implementation {
 
+using ::android::hardware::google::pixel::BootPhaseTimer;
+using ::android::hardware::google::pixel::reportBootPhasesToStats;
+
 constexpr std::string_view kThermalSensorsRoot("/sys/devices/virtual/thermal");
 constexpr std::string_view kSensorPrefix("thermal_zone");
 constexpr std::string_view kCoolingDevicePrefix("cooling_device");
@@ -50,11 +57,16 @@ constexpr std::string_view kCoolingDeviceMaxStateSuffix("max_state");
 constexpr std::string_view kCoolingDeviceState2powerSuffix("state2power_table");
 constexpr std::string_view kConfigProperty("vendor.thermal.config");
 constexpr std::string_view kConfigDefaultFileName("thermal_info_config.json");
+// Where the parsed config is compiled to, to skip the JSON parse on the next start
+constexpr std::string_view kCompiledConfigDir("/data/vendor/thermal");
 constexpr std::string_view kThermalGenlProperty("persist.vendor.enable.thermal.genl");
 constexpr std::string_view kThermalDisabledProperty("vendor.disable.thermalhal.control");
+// Path to record the inputs of the throttling path to, for thermal_replay
+constexpr std::string_view kTraceRecordPathProperty("vendor.thermal.trace_record_path");
+// Sensors due this close to a wakeup are updated with it instead of waking again
+constexpr std::chrono::milliseconds kSensorDeadlineSlack(50);
 
 namespace {
-using ::android::base::StringPrintf;
 
 std::unordered_map<std::string, std::string> parseThermalPathMap(std::string_view prefix) {
     std::unordered_map<std::string, std::string> path_map;
@@ -90,6 +102,12 @@ std::unordered_map<std::string, std::string> parseThermalPathMap(std::string_vie
     return path_map;
 }
 
+// Models may leave out the coefficients, or their types
+size_t numCoefficients(const VirtualSensorInfo &virtual_sensor_info) {
+    return std::min(virtual_sensor_info.coefficients.size(),
+                    virtual_sensor_info.coefficients_type.size());
+}
+
 }  // namespace
 
 // dump additional traces for a given sensor
@@ -102,8 +120,8 @@ void ThermalHelperImpl::dumpTraces(std::string_view sensor_name) {
 
     // add trace for current sensor
     const auto &sensor_status = sensor_status_map_.at(sensor_name.data());
-    ATRACE_INT((sensor_name.data() + std::string("-cached")).c_str(),
-               static_cast<int>(sensor_status.thermal_cached.temp));
+    PIXEL_TRACE_INT_F(static_cast<int>(sensor_status.thermal_cached.temp), "%s-cached",
+                      sensor_name.data());
 
     const auto &sensor_info = sensor_info_map_.at(sensor_name.data());
     if (!sensor_info.virtual_sensor_info) {
@@ -145,49 +163,55 @@ void ThermalHelperImpl::maxCoolingRequestCheck(
 ThermalHelperImpl::ThermalHelperImpl(const NotificationCallback &cb)
     : thermal_watcher_(new ThermalWatcher(std::bind(&ThermalHelperImpl::thermalWatcherCallbackFunc,
                                                     this, std::placeholders::_1))),
-      cb_(cb) {
+      thermal_sensors_(true),
+      cb_(cb),
+      emul_script_player_(
+              [this](const std::vector<std::pair<std::string, float>> &temps) {
+                  emulTemps(temps);
+              },
+              [this] { emulClear("all"); }) {
+    BootPhaseTimer boot_timer("thermal");
+    boot_timer.begin("parse_config");
     const std::string config_path =
             "/vendor/etc/" +
             ::android::base::GetProperty(kConfigProperty.data(), kConfigDefaultFileName.data());
     bool thermal_throttling_disabled =
             ::android::base::GetBoolProperty(kThermalDisabledProperty.data(), false);
     bool ret = true;
-    Json::Value config;
-    if (!ParseThermalConfig(config_path, &config)) {
-        LOG(ERROR) << "Failed to read JSON config";
-        ret = false;
-    }
-
-    if (!ParseCoolingDevice(config, &cooling_device_info_map_)) {
-        LOG(ERROR) << "Failed to parse cooling device info config";
-        ret = false;
-    }
-
-    if (!ParseSensorInfo(config, &sensor_info_map_)) {
-        LOG(ERROR) << "Failed to parse sensor info config";
+    ParsedThermalConfig parsed_config;
+    if (!LoadThermalConfig(config_path, kCompiledConfigDir, &parsed_config)) {
+        LOG(ERROR) << "Failed to load thermal config";
         ret = false;
     }
+    cooling_device_info_map_ = std::move(parsed_config.cooling_device_info_map);
+    sensor_info_map_ = std::move(parsed_config.sensor_info_map);
 
+    boot_timer.begin("sensor_map");
     auto tz_map = parseThermalPathMap(kSensorPrefix.data());
     if (!initializeSensorMap(tz_map)) {
         LOG(ERROR) << "Failed to initialize sensor map";
         ret = false;
     }
 
+    boot_timer.begin("cooling_devices");
     auto cdev_map = parseThermalPathMap(kCoolingDevicePrefix.data());
     if (!initializeCoolingDevices(cdev_map)) {
         LOG(ERROR) << "Failed to initialize cooling device map";
         ret = false;
     }
 
-    if (!power_files_.registerPowerRailsToWatch(config)) {
+    boot_timer.begin("power_rails");
+    if (!power_files_.registerPowerRailsToWatch(std::move(parsed_config.power_rail_info_map))) {
         LOG(ERROR) << "Failed to register power rails";
         ret = false;
     }
 
+    boot_timer.begin("sensor_status");
     if (ret) {
-        if (!thermal_stats_helper_.initializeStats(config, sensor_info_map_,
-                                                   cooling_device_info_map_, this)) {
+        if (!thermal_stats_helper_.initializeStats(
+                    parsed_config.sensor_stats_info, parsed_config.abnormal_stats_info,
+                    parsed_config.cooling_device_request_info, sensor_info_map_,
+                    cooling_device_info_map_, this)) {
             LOG(FATAL) << "Failed to initialize thermal stats";
         }
     }
@@ -200,11 +224,13 @@ ThermalHelperImpl::ThermalHelperImpl(const NotificationCallback &cb)
                 .last_update_time = boot_clock::time_point::min(),
                 .thermal_cached = {NAN, boot_clock::time_point::min()},
                 .override_status = {nullptr, false, false},
+                .requested_period = std::chrono::milliseconds::zero(),
+                .actual_period = std::chrono::milliseconds::zero(),
         };
 
         if (name_status_pair.second.throttling_info != nullptr) {
             if (!thermal_throttling_.registerThermalThrottling(
-                        name_status_pair.first, name_status_pair.second.throttling_info,
+                        name_status_pair.first, name_status_pair.second,
                         cooling_device_info_map_)) {
                 LOG(ERROR) << name_status_pair.first << " failed to register thermal throttling";
                 ret = false;
@@ -317,6 +343,12 @@ ThermalHelperImpl::ThermalHelperImpl(const NotificationCallback &cb)
         }
     }
 
+    if (ret && !initializeSensorGraph()) {
+        LOG(ERROR) << "Failed to initialize sensor graph";
+        ret = false;
+    }
+
+    boot_timer.begin("power_hal");
     if (!power_hal_service_.connect()) {
         LOG(ERROR) << "Fail to connect to Power Hal";
     } else {
@@ -327,10 +359,14 @@ ThermalHelperImpl::ThermalHelperImpl(const NotificationCallback &cb)
         if (ret) {
             clearAllThrottling();
             is_initialized_ = ret;
+            boot_timer.finish(reportBootPhasesToStats);
             return;
         } else {
+            sensor_nodes_.clear();
+            sensor_node_map_.clear();
             sensor_info_map_.clear();
             cooling_device_info_map_.clear();
+            boot_timer.finish(reportBootPhasesToStats);
             return;
         }
     } else if (!ret) {
@@ -341,7 +377,14 @@ ThermalHelperImpl::ThermalHelperImpl(const NotificationCallback &cb)
     const bool thermal_genl_enabled =
             ::android::base::GetBoolProperty(kThermalGenlProperty.data(), false);
 
-    std::set<std::string> monitored_sensors;
+    const std::string trace_record_path =
+            ::android::base::GetProperty(kTraceRecordPathProperty.data(), "");
+    if (!trace_record_path.empty()) {
+        trace_recorder_.open(trace_record_path);
+    }
+
+    boot_timer.begin("watcher");
+    std::vector<WatchedSensor> monitored_sensors;
     initializeTrip(tz_map, &monitored_sensors, thermal_genl_enabled);
 
     if (thermal_genl_enabled) {
@@ -355,6 +398,7 @@ ThermalHelperImpl::ThermalHelperImpl(const NotificationCallback &cb)
     if (!is_initialized_) {
         LOG(FATAL) << "ThermalHAL could not start watching thread properly.";
     }
+    boot_timer.finish(reportBootPhasesToStats);
 }
 
 bool getThermalZoneTypeById(int tz_id, std::string *type) {
@@ -417,6 +461,7 @@ bool ThermalHelperImpl::emulTemp(std::string_view target_sensor, const float tem
 
     checkUpdateSensorForEmul(target_sensor.data(), max_throttling);
 
+    override_pending_ = true;
     thermal_watcher_->wake();
     return true;
 }
@@ -451,10 +496,65 @@ bool ThermalHelperImpl::emulSeverity(std::string_view target_sensor, const int s
 
     checkUpdateSensorForEmul(target_sensor.data(), max_throttling);
 
+    override_pending_ = true;
     thermal_watcher_->wake();
     return true;
 }
 
+void ThermalHelperImpl::emulTemps(const std::vector<std::pair<std::string, float>> &temps) {
+    std::lock_guard<std::shared_mutex> _lock(sensor_status_map_mutex_);
+    for (const auto &[sensor_name, temp] : temps) {
+        auto it = sensor_status_map_.find(sensor_name);
+        if (it == sensor_status_map_.end()) {
+            continue;
+        }
+        if (std::isnan(temp)) {
+            it->second.override_status.emul_temp = nullptr;
+        } else {
+            it->second.override_status.emul_temp.reset(new EmulTemp{temp, -1});
+        }
+        it->second.override_status.pending_update = true;
+        checkUpdateSensorForEmul(sensor_name, it->second.override_status.max_throttling);
+    }
+
+    override_pending_ = true;
+    thermal_watcher_->wake();
+}
+
+bool ThermalHelperImpl::emulScript(std::string_view script_path, const float speed) {
+    std::string content;
+    std::string error;
+    std::vector<EmulScriptStep> steps;
+
+    if (!(speed > 0)) {
+        LOG(ERROR) << "Invalid emul script speed " << speed;
+        return false;
+    }
+    if (!::android::base::ReadFileToString(std::string(script_path), &content)) {
+        PLOG(ERROR) << "Failed to read emul script " << script_path;
+        return false;
+    }
+    if (!ParseEmulScript(content, &steps, &error)) {
+        LOG(ERROR) << "Failed to parse emul script " << script_path << ": " << error;
+        return false;
+    }
+    {
+        std::shared_lock<std::shared_mutex> _lock(sensor_status_map_mutex_);
+        for (const auto &step : steps) {
+            for (const auto &[sensor_name, temp] : step.temps) {
+                if (!sensor_status_map_.count(sensor_name)) {
+                    LOG(ERROR) << "Cannot find emul script sensor: " << sensor_name;
+                    return false;
+                }
+            }
+        }
+    }
+
+    LOG(INFO) << "Play emul script " << script_path << " at " << speed << "x";
+    emul_script_player_.start(std::move(steps), std::string(script_path), speed);
+    return true;
+}
+
 bool ThermalHelperImpl::emulClear(std::string_view target_sensor) {
     LOG(INFO) << "Clear " << target_sensor.data() << " emulation settings";
 
@@ -475,6 +575,7 @@ bool ThermalHelperImpl::emulClear(std::string_view target_sensor) {
         return false;
     }
 
+    override_pending_ = true;
     thermal_watcher_->wake();
     return true;
 }
@@ -503,12 +604,24 @@ bool ThermalHelperImpl::readTemperature(
         std::string_view sensor_name, Temperature *out,
         std::pair<ThrottlingSeverity, ThrottlingSeverity> *throttling_status,
         const bool force_no_cache) {
+    return readTemperature(sensor_name, out, throttling_status, force_no_cache, nullptr);
+}
+
+bool ThermalHelperImpl::readTemperature(
+        std::string_view sensor_name, Temperature *out,
+        std::pair<ThrottlingSeverity, ThrottlingSeverity> *throttling_status,
+        const bool force_no_cache, SensorTickReadings *tick) {
     // Return fail if the thermal sensor cannot be read.
     float temp = NAN;
     std::map<std::string, float> sensor_log_map;
-    auto &sensor_status = sensor_status_map_.at(sensor_name.data());
+    const auto node_itr = sensor_node_map_.find(sensor_name.data());
+    if (node_itr == sensor_node_map_.end()) {
+        LOG(ERROR) << "Unknown thermal sensor " << sensor_name.data();
+        return false;
+    }
+    auto &sensor_status = *sensor_nodes_[node_itr->second].status;
 
-    if (!readThermalSensor(sensor_name, &temp, force_no_cache, &sensor_log_map)) {
+    if (!readThermalSensor(node_itr->second, &temp, force_no_cache, &sensor_log_map, tick)) {
         LOG(ERROR) << "Failed to read thermal sensor " << sensor_name.data();
         thermal_stats_helper_.reportThermalAbnormality(
                 ThermalSensorAbnormalityDetected::TEMP_READ_FAIL, sensor_name, std::nullopt);
@@ -520,7 +633,7 @@ bool ThermalHelperImpl::readTemperature(
         return false;
     }
 
-    const auto &sensor_info = sensor_info_map_.at(sensor_name.data());
+    const auto &sensor_info = *sensor_nodes_[node_itr->second].info;
     out->type = sensor_info.type;
     out->name = sensor_name.data();
     out->value = temp * sensor_info.multiplier;
@@ -562,7 +675,8 @@ bool ThermalHelperImpl::readTemperature(
             sensor_log << sensor_log_pair.first << ":" << sensor_log_pair.second << " ";
         }
         // Update sensor temperature time in state
-        thermal_stats_helper_.updateSensorTempStatsBySeverity(sensor_name, out->throttlingStatus);
+        thermal_stats_helper_.updateSensorTempStatsBySeverity(sensor_info.id,
+                                                              out->throttlingStatus);
         LOG(INFO) << sensor_name.data() << ":" << out->value << " raw data: " << sensor_log.str();
     }
 
@@ -593,59 +707,19 @@ bool ThermalHelperImpl::readTemperatureThreshold(std::string_view sensor_name,
 
 void ThermalHelperImpl::updateCoolingDevices(const std::vector<std::string> &updated_cdev) {
     int max_state;
+    std::vector<ThermalFiles::CdevState> cdev_states;
 
+    cdev_states.reserve(updated_cdev.size());
     for (const auto &target_cdev : updated_cdev) {
-        if (thermal_throttling_.getCdevMaxRequest(target_cdev, &max_state)) {
-            if (cooling_devices_.writeCdevFile(target_cdev, std::to_string(max_state))) {
-                ATRACE_INT(target_cdev.c_str(), max_state);
-                LOG(INFO) << "Successfully update cdev " << target_cdev << " sysfs to "
-                          << max_state;
-            } else {
-                LOG(ERROR) << "Failed to update cdev " << target_cdev << " sysfs to " << max_state;
-            }
+        const size_t cdev_id = cooling_device_info_map_.at(target_cdev).id;
+        if (thermal_throttling_.getCdevMaxRequest(cdev_id, &max_state)) {
+            cdev_states.push_back({.cdev_id = cdev_id, .state = max_state});
+            power_hal_service_.publishCdevState(target_cdev, max_state);
         }
     }
-}
-
-std::pair<ThrottlingSeverity, ThrottlingSeverity> ThermalHelperImpl::getSeverityFromThresholds(
-        const ThrottlingArray &hot_thresholds, const ThrottlingArray &cold_thresholds,
-        const ThrottlingArray &hot_hysteresis, const ThrottlingArray &cold_hysteresis,
-        ThrottlingSeverity prev_hot_severity, ThrottlingSeverity prev_cold_severity,
-        float value) const {
-    ThrottlingSeverity ret_hot = ThrottlingSeverity::NONE;
-    ThrottlingSeverity ret_hot_hysteresis = ThrottlingSeverity::NONE;
-    ThrottlingSeverity ret_cold = ThrottlingSeverity::NONE;
-    ThrottlingSeverity ret_cold_hysteresis = ThrottlingSeverity::NONE;
-
-    // Here we want to control the iteration from high to low, and ::ndk::enum_range doesn't support
-    // a reverse iterator yet.
-    for (size_t i = static_cast<size_t>(ThrottlingSeverity::SHUTDOWN);
-         i > static_cast<size_t>(ThrottlingSeverity::NONE); --i) {
-        if (!std::isnan(hot_thresholds[i]) && hot_thresholds[i] <= value &&
-            ret_hot == ThrottlingSeverity::NONE) {
-            ret_hot = static_cast<ThrottlingSeverity>(i);
-        }
-        if (!std::isnan(hot_thresholds[i]) && (hot_thresholds[i] - hot_hysteresis[i]) < value &&
-            ret_hot_hysteresis == ThrottlingSeverity::NONE) {
-            ret_hot_hysteresis = static_cast<ThrottlingSeverity>(i);
-        }
-        if (!std::isnan(cold_thresholds[i]) && cold_thresholds[i] >= value &&
-            ret_cold == ThrottlingSeverity::NONE) {
-            ret_cold = static_cast<ThrottlingSeverity>(i);
-        }
-        if (!std::isnan(cold_thresholds[i]) && (cold_thresholds[i] + cold_hysteresis[i]) > value &&
-            ret_cold_hysteresis == ThrottlingSeverity::NONE) {
-            ret_cold_hysteresis = static_cast<ThrottlingSeverity>(i);
-        }
-    }
-    if (static_cast<size_t>(ret_hot) < static_cast<size_t>(prev_hot_severity)) {
-        ret_hot = ret_hot_hysteresis;
-    }
-    if (static_cast<size_t>(ret_cold) < static_cast<size_t>(prev_cold_severity)) {
-        ret_cold = ret_cold_hysteresis;
+    if (!cooling_devices_.writeCdevStates(cdev_states)) {
+        LOG(ERROR) << "Failed to update some of the cdev sysfs";
     }
-
-    return std::make_pair(ret_hot, ret_cold);
 }
 
 bool ThermalHelperImpl::isSubSensorValid(std::string_view sensor_data,
@@ -671,9 +745,12 @@ bool ThermalHelperImpl::isSubSensorValid(std::string_view sensor_data,
 
 void ThermalHelperImpl::clearAllThrottling(void) {
     // Clear the CDEV request
+    std::vector<ThermalFiles::CdevState> cdev_states;
     for (const auto &cdev_info_pair : cooling_device_info_map_) {
-        cooling_devices_.writeCdevFile(cdev_info_pair.first, "0");
+        cdev_states.push_back({.cdev_id = cdev_info_pair.second.id, .state = 0});
+        power_hal_service_.publishCdevState(cdev_info_pair.first, 0);
     }
+    cooling_devices_.writeCdevStates(cdev_states);
 
     for (auto &sensor_info_pair : sensor_info_map_) {
         sensor_info_pair.second.is_watch = false;
@@ -692,11 +769,185 @@ void ThermalHelperImpl::clearAllThrottling(void) {
         }
         // Disable thermal power hints
         if (sensor_info_pair.second.send_powerhint) {
-            for (const auto &severity : ::ndk::enum_range<ThrottlingSeverity>()) {
-                power_hal_service_.setMode(sensor_info_pair.first, severity, false);
+            power_hal_service_.clearPowerHints(sensor_info_pair.first);
+        }
+    }
+}
+
+bool ThermalHelperImpl::initializeSensorGraph() {
+    enum class VisitState { VISITING, DONE };
+    std::unordered_map<std::string_view, VisitState> visit_states;
+    // Depth first, a sensor gets its node once every sensor it reads has one
+    std::function<bool(const std::string &)> visit = [&](const std::string &sensor_name) {
+        const auto info_itr = sensor_info_map_.find(sensor_name);
+        if (info_itr == sensor_info_map_.end()) {
+            LOG(ERROR) << "Could not find linked sensor " << sensor_name;
+            return false;
+        }
+        const auto [state_itr, first_visit] =
+                visit_states.emplace(info_itr->first, VisitState::VISITING);
+        // Unlike the iterator, the reference survives a rehash in the recursion
+        VisitState &visit_state = state_itr->second;
+        if (!first_visit) {
+            if (visit_state == VisitState::VISITING) {
+                LOG(ERROR) << "Sensor " << sensor_name << " links back to itself";
+                return false;
+            }
+            return true;
+        }
+
+        const auto *virtual_sensor_info = info_itr->second.virtual_sensor_info.get();
+        if (virtual_sensor_info != nullptr) {
+            for (size_t i = 0; i < virtual_sensor_info->linked_sensors.size(); i++) {
+                if (virtual_sensor_info->linked_sensors_type[i] == SensorFusionType::SENSOR &&
+                    !visit(virtual_sensor_info->linked_sensors[i])) {
+                    return false;
+                }
+            }
+            for (size_t i = 0; i < numCoefficients(*virtual_sensor_info); i++) {
+                if (virtual_sensor_info->coefficients_type[i] == SensorFusionType::SENSOR &&
+                    !visit(virtual_sensor_info->coefficients[i])) {
+                    return false;
+                }
+            }
+            if (!virtual_sensor_info->backup_sensor.empty() &&
+                !visit(virtual_sensor_info->backup_sensor)) {
+                return false;
+            }
+        }
+        visit_state = VisitState::DONE;
+        sensor_node_map_[info_itr->first] = sensor_nodes_.size();
+        sensor_nodes_.push_back({.name = info_itr->first,
+                                 .info = &info_itr->second,
+                                 .status = &sensor_status_map_.at(info_itr->first),
+                                 .linked_nodes = {},
+                                 .coefficient_nodes = {},
+                                 .backup_node = kNoSensorNode,
+                                 .predictor_node = kNoSensorNode,
+                                 .trigger_nodes = {}});
+        return true;
+    };
+
+    sensor_nodes_.reserve(sensor_info_map_.size());
+    for (const auto &name_info_pair : sensor_info_map_) {
+        if (!visit(name_info_pair.first)) {
+            sensor_nodes_.clear();
+            sensor_node_map_.clear();
+            return false;
+        }
+    }
+
+    const auto node_of = [&](const std::string &sensor_data, SensorFusionType type) {
+        return type == SensorFusionType::SENSOR ? sensor_node_map_.at(sensor_data) : kNoSensorNode;
+    };
+    for (auto &node : sensor_nodes_) {
+        if (node.info->predictor_info != nullptr) {
+            node.predictor_node = sensor_node_map_.at(node.info->predictor_info->sensor);
+        }
+        const auto *virtual_sensor_info = node.info->virtual_sensor_info.get();
+        if (virtual_sensor_info == nullptr) {
+            continue;
+        }
+        for (size_t i = 0; i < virtual_sensor_info->linked_sensors.size(); i++) {
+            node.linked_nodes.push_back(node_of(virtual_sensor_info->linked_sensors[i],
+                                                virtual_sensor_info->linked_sensors_type[i]));
+        }
+        for (size_t i = 0; i < numCoefficients(*virtual_sensor_info); i++) {
+            node.coefficient_nodes.push_back(node_of(virtual_sensor_info->coefficients[i],
+                                                     virtual_sensor_info->coefficients_type[i]));
+        }
+        if (!virtual_sensor_info->backup_sensor.empty()) {
+            node.backup_node = sensor_node_map_.at(virtual_sensor_info->backup_sensor);
+        }
+    }
+
+    sensor_schedules_.assign(sensor_nodes_.size(), {.next_due = boot_clock::time_point::max(),
+                                                    .period = std::chrono::milliseconds::zero()});
+    trigger_dependents_.assign(sensor_nodes_.size(), {});
+    for (size_t i = 0; i < sensor_nodes_.size(); i++) {
+        auto &node = sensor_nodes_[i];
+        if (!node.info->is_watch) {
+            continue;
+        }
+        // Every watched sensor is due on the first tick
+        scheduleSensor(i, boot_clock::time_point::min());
+        if (node.info->virtual_sensor_info == nullptr) {
+            continue;
+        }
+        for (const auto &trigger_sensor : node.info->virtual_sensor_info->trigger_sensors) {
+            const auto trigger_itr = sensor_node_map_.find(trigger_sensor);
+            if (trigger_itr == sensor_node_map_.end()) {
+                LOG(ERROR) << "Could not find trigger sensor " << trigger_sensor;
+                return false;
+            }
+            trigger_dependents_[trigger_itr->second].push_back(i);
+            node.trigger_nodes.push_back(trigger_itr->second);
+        }
+    }
+
+    // The predict window of an estimator is fixed once it is initialized
+    prediction_caches_ = std::vector<PredictionCache>(sensor_nodes_.size());
+    for (const auto &node : sensor_nodes_) {
+        if (node.predictor_node == kNoSensorNode) {
+            continue;
+        }
+        const auto &predictor_node = sensor_nodes_[node.predictor_node];
+        size_t predict_window = 0;
+        ::thermal::vtestimator::VtEstimatorStatus ret =
+                predictor_node.info->virtual_sensor_info->vt_estimator->GetMaxPredictWindowMs(
+                        &predict_window);
+        if (ret != ::thermal::vtestimator::kVtEstimatorOk) {
+            LOG(ERROR) << "Failed to read prediction window (ret: " << ret << ") from "
+                       << predictor_node.name << " for sensor " << node.name;
+            continue;
+        }
+        prediction_caches_[node.predictor_node].max_window_ms = predict_window;
+    }
+
+    std::vector<std::string> sensor_names;
+    sensor_names.reserve(sensor_nodes_.size());
+    for (const auto &node : sensor_nodes_) {
+        sensor_names.push_back(node.name);
+    }
+    tick_stats_.init(std::move(sensor_names));
+    return true;
+}
+
+void ThermalHelperImpl::scheduleSensor(size_t sensor_node, boot_clock::time_point next_due) {
+    auto &schedule = sensor_schedules_[sensor_node];
+    if (schedule.next_due == next_due) {
+        return;
+    }
+    schedule.next_due = next_due;
+    sensor_deadlines_.emplace(next_due, sensor_node);
+}
+
+bool ThermalHelperImpl::collectDueSensors(const TriggeredSensors &triggered_sensors,
+                                          boot_clock::time_point now,
+                                          std::vector<size_t> *due_nodes) {
+    if (triggered_sensors.any() || override_pending_.exchange(false)) {
+        // Whether a uevent or an override concerns a sensor is decided per sensor
+        for (size_t i = 0; i < sensor_nodes_.size(); i++) {
+            if (sensor_nodes_[i].info->is_watch) {
+                due_nodes->push_back(i);
             }
         }
+        return true;
+    }
+
+    // Deadlines within the slack are batched into this wakeup
+    while (!sensor_deadlines_.empty() &&
+           sensor_deadlines_.top().first <= now + kSensorDeadlineSlack) {
+        const auto [next_due, sensor_node] = sensor_deadlines_.top();
+        sensor_deadlines_.pop();
+        auto &schedule = sensor_schedules_[sensor_node];
+        if (schedule.next_due != next_due) {
+            continue;
+        }
+        schedule.next_due = boot_clock::time_point::max();
+        due_nodes->push_back(sensor_node);
     }
+    return false;
 }
 
 bool ThermalHelperImpl::initializeSensorMap(
@@ -756,18 +1007,13 @@ bool ThermalHelperImpl::initializeCoolingDevices(
         if (::android::base::ReadFileToString(state2power_path, &state2power_str)) {
             LOG(INFO) << "Cooling device " << cooling_device_info_pair.first
                       << " use state2power read from sysfs";
-            cooling_device_info_pair.second.state2power.clear();
-
-            std::stringstream power(state2power_str);
-            unsigned int power_number;
-            int i = 0;
-            while (power >> power_number) {
-                cooling_device_info_pair.second.state2power.push_back(
-                        static_cast<float>(power_number));
+            auto &state2power = cooling_device_info_pair.second.state2power;
+            parseState2PowerTable(state2power_str, &state2power);
+            for (size_t i = 0; i < state2power.size(); ++i) {
                 LOG(INFO) << "Cooling device " << cooling_device_info_pair.first << " state:" << i
-                          << " power: " << power_number;
-                i++;
+                          << " power: " << state2power[i];
             }
+            cdev_state2power_paths_[cooling_device_name] = state2power_path;
         }
 
         // Get max cooling device request state
@@ -796,8 +1042,6 @@ bool ThermalHelperImpl::initializeCoolingDevices(
         }
 
         // Add cooling device path for thermalHAL to request state
-        cooling_device_name =
-                ::android::base::StringPrintf("%s_%s", cooling_device_name.c_str(), "w");
         std::string write_path;
         if (!cooling_device_info_pair.second.write_path.empty()) {
             write_path = cooling_device_info_pair.second.write_path.data();
@@ -806,7 +1050,8 @@ bool ThermalHelperImpl::initializeCoolingDevices(
                                                        kCoolingDeviceCurStateSuffix.data());
         }
 
-        if (!cooling_devices_.addThermalFile(cooling_device_name, write_path)) {
+        if (!cooling_devices_.addCdevFile(cooling_device_info_pair.second.id, cooling_device_name,
+                                          write_path)) {
             LOG(ERROR) << "Could not add " << cooling_device_name
                        << " write path to cooling device map";
             return false;
@@ -815,13 +1060,50 @@ bool ThermalHelperImpl::initializeCoolingDevices(
     return true;
 }
 
+bool ThermalHelperImpl::refreshCdevPowerTable(std::string_view target_cdev) {
+    bool found = false;
+    bool ok = true;
+    for (const auto &[cdev_name, state2power_path] : cdev_state2power_paths_) {
+        if (target_cdev != "all" && target_cdev != cdev_name) {
+            continue;
+        }
+        found = true;
+        const auto &cdev_info = cooling_device_info_map_.at(cdev_name);
+        std::string state2power_str;
+        std::vector<float> state2power;
+        if (!::android::base::ReadFileToString(state2power_path, &state2power_str) ||
+            !parseState2PowerTable(state2power_str, &state2power)) {
+            LOG(ERROR) << "Could not read cooling device " << cdev_name
+                       << " state2power from: " << state2power_path;
+            ok = false;
+            continue;
+        }
+        if (cdev_info.max_state != std::numeric_limits<int>::max() &&
+            static_cast<int>(state2power.size()) != cdev_info.max_state + 1) {
+            LOG(ERROR) << "Invalid state2power number of cooling device " << cdev_name << ": "
+                       << state2power.size() << ", number should be " << cdev_info.max_state + 1
+                       << " (max_state + 1)";
+            ok = false;
+            continue;
+        }
+        LOG(INFO) << "Cooling device " << cdev_name << " state2power refreshed from sysfs";
+        thermal_throttling_.updateCdevPowerTable(cdev_info.id, state2power);
+    }
+    if (!found) {
+        LOG(ERROR) << "Cannot find cooling device with state2power in sysfs: "
+                   << target_cdev.data();
+        return false;
+    }
+    return ok;
+}
+
 void ThermalHelperImpl::setMinTimeout(SensorInfo *sensor_info) {
     sensor_info->polling_delay = kMinPollIntervalMs;
     sensor_info->passive_delay = kMinPollIntervalMs;
 }
 
 void ThermalHelperImpl::initializeTrip(const std::unordered_map<std::string, std::string> &path_map,
-                                       std::set<std::string> *monitored_sensors,
+                                       std::vector<WatchedSensor> *monitored_sensors,
                                        bool thermal_genl_enabled) {
     for (auto &sensor_info : sensor_info_map_) {
         if (!sensor_info.second.is_watch || (sensor_info.second.virtual_sensor_info != nullptr)) {
@@ -884,7 +1166,16 @@ void ThermalHelperImpl::initializeTrip(const std::unordered_map<std::string, std
                     break;
                 }
             }
-            monitored_sensors->insert(sensor_info.first);
+            // The thermal zone id lets genl events skip the sensor name lookup
+            int tz_id = -1;
+            const std::string tz_dir = ::android::base::Basename(std::string(tz_path));
+            if (!::android::base::StartsWith(tz_dir, kSensorPrefix.data()) ||
+                !::android::base::ParseInt(tz_dir.substr(kSensorPrefix.size()), &tz_id)) {
+                tz_id = -1;
+            }
+            monitored_sensors->push_back({.name = sensor_info.first,
+                                          .index = sensor_node_map_.at(sensor_info.first),
+                                          .tz_id = tz_id});
         }
 
         if (!trip_update) {
@@ -899,6 +1190,7 @@ bool ThermalHelperImpl::fillCurrentTemperatures(bool filterType, bool filterCall
                                                 TemperatureType type,
                                                 std::vector<Temperature> *temperatures) {
     std::vector<Temperature> ret;
+    const auto snapshot = getThermalSnapshot();
     for (const auto &name_info_pair : sensor_info_map_) {
         Temperature temp;
         if (name_info_pair.second.is_hidden) {
@@ -910,7 +1202,13 @@ bool ThermalHelperImpl::fillCurrentTemperatures(bool filterType, bool filterCall
         if (filterCallback && !name_info_pair.second.send_cb) {
             continue;
         }
-        if (readTemperature(name_info_pair.first, &temp, nullptr, false)) {
+        // The watcher doesn't read unwatched sensors, and nothing is
+        // published before its first tick
+        const size_t id = name_info_pair.second.id;
+        if (snapshot != nullptr && id < snapshot->temperatures.size() &&
+            snapshot->temperatures[id].has_value()) {
+            ret.emplace_back(*snapshot->temperatures[id]);
+        } else if (readTemperature(name_info_pair.first, &temp, nullptr, false)) {
             ret.emplace_back(std::move(temp));
         } else {
             LOG(ERROR) << __func__
@@ -921,6 +1219,30 @@ bool ThermalHelperImpl::fillCurrentTemperatures(bool filterType, bool filterCall
     return ret.size() > 0;
 }
 
+std::unordered_map<std::string, SensorStatusSnapshot> ThermalHelperImpl::GetSensorStatusSnapshot()
+        const {
+    std::unordered_map<std::string, SensorStatusSnapshot> snapshot;
+    std::shared_lock<std::shared_mutex> _lock(sensor_status_map_mutex_);
+    snapshot.reserve(sensor_status_map_.size());
+    for (const auto &[name, sensor_status] : sensor_status_map_) {
+        auto &sensor_snapshot = snapshot[name];
+        sensor_snapshot.thermal_cached = sensor_status.thermal_cached;
+        sensor_snapshot.requested_period = sensor_status.requested_period;
+        sensor_snapshot.actual_period = sensor_status.actual_period;
+        if (sensor_status.override_status.emul_temp != nullptr) {
+            sensor_snapshot.emul_temp = *sensor_status.override_status.emul_temp;
+        }
+        sensor_snapshot.max_throttling = sensor_status.override_status.max_throttling;
+    }
+    return snapshot;
+}
+
+std::shared_ptr<const ThermalHelperImpl::ThermalSnapshot> ThermalHelperImpl::getThermalSnapshot()
+        const {
+    std::lock_guard<std::mutex> _lock(thermal_snapshot_mutex_);
+    return thermal_snapshot_;
+}
+
 bool ThermalHelperImpl::fillTemperatureThresholds(
         bool filterType, TemperatureType type,
         std::vector<TemperatureThreshold> *thresholds) const {
@@ -964,107 +1286,40 @@ bool ThermalHelperImpl::fillCurrentCoolingDevices(
     return ret.size() > 0;
 }
 
-bool ThermalHelperImpl::readDataByType(std::string_view sensor_data, float *reading_value,
-                                       const SensorFusionType type, const bool force_no_cache,
-                                       std::map<std::string, float> *sensor_log_map) {
-    switch (type) {
-        case SensorFusionType::SENSOR:
-            if (!readThermalSensor(sensor_data.data(), reading_value, force_no_cache,
-                                   sensor_log_map)) {
-                LOG(ERROR) << "Failed to get " << sensor_data.data() << " data";
-                return false;
-            }
-            break;
-        case SensorFusionType::ODPM:
-            *reading_value = GetPowerStatusMap().at(sensor_data.data()).last_updated_avg_power;
-            if (std::isnan(*reading_value)) {
-                LOG(INFO) << "Power data " << sensor_data.data() << " is under collecting";
-                return true;
-            }
-            (*sensor_log_map)[sensor_data.data()] = *reading_value;
-            break;
-        case SensorFusionType::CONSTANT:
-            *reading_value = std::atof(sensor_data.data());
-            break;
-        default:
-            break;
-    }
-    return true;
-}
-
-bool ThermalHelperImpl::runVirtualTempEstimator(std::string_view sensor_name,
-                                                std::map<std::string, float> *sensor_log_map,
-                                                const bool force_no_cache,
-                                                std::vector<float> *outputs) {
-    std::vector<float> model_inputs;
-    std::vector<float> model_outputs;
-
-    ATRACE_NAME(StringPrintf("ThermalHelper::runVirtualTempEstimator - %s", sensor_name.data())
-                        .c_str());
-    if (!(sensor_info_map_.count(sensor_name.data()) &&
-          sensor_status_map_.count(sensor_name.data()))) {
-        LOG(ERROR) << sensor_name << " not part of sensor_info_map_ or sensor_status_map_";
-        return false;
-    }
-
-    const auto &sensor_info = sensor_info_map_.at(sensor_name.data());
-    if (sensor_info.virtual_sensor_info == nullptr ||
-        sensor_info.virtual_sensor_info->vt_estimator == nullptr) {
-        LOG(ERROR) << "vt_estimator not valid for " << sensor_name;
-        return false;
-    }
+class ThermalHelperImpl::SensorInputs : public SensorInputReader {
+  public:
+    SensorInputs(ThermalHelperImpl *helper, bool force_no_cache, SensorTickReadings *tick)
+        : helper_(helper), force_no_cache_(force_no_cache), tick_(tick) {}
 
-    if (outputs == nullptr) {
-        LOG(ERROR) << "vt_estimator output is nullptr";
-        return false;
+    bool readSensor(std::string_view /*sensor_name*/, size_t sensor_node, float *temp,
+                    std::map<std::string, float> *sensor_log_map) override {
+        return helper_->readThermalSensor(sensor_node, temp, force_no_cache_, sensor_log_map,
+                                          tick_);
     }
 
-    model_inputs.reserve(sensor_info.virtual_sensor_info->linked_sensors.size());
-
-    for (size_t i = 0; i < sensor_info.virtual_sensor_info->linked_sensors.size(); i++) {
-        std::string linked_sensor = sensor_info.virtual_sensor_info->linked_sensors[i];
-
-        if ((*sensor_log_map).count(linked_sensor.data())) {
-            float value = (*sensor_log_map)[linked_sensor.data()];
-            model_inputs.push_back(value);
-        } else {
-            LOG(ERROR) << "failed to read sensor: " << linked_sensor;
+    bool readPower(std::string_view power_rail, float *power) override {
+        const auto &power_status_map = helper_->GetPowerStatusMap();
+        const auto power_status = power_status_map.find(power_rail.data());
+        if (power_status == power_status_map.end()) {
             return false;
         }
+        *power = power_status->second.last_updated_avg_power;
+        return true;
     }
 
-    ::thermal::vtestimator::VtEstimatorStatus ret =
-            sensor_info.virtual_sensor_info->vt_estimator->Estimate(model_inputs, &model_outputs);
-
-    if (ret == ::thermal::vtestimator::kVtEstimatorOk) {
-        *outputs = model_outputs;
-        return true;
-    } else if (ret == ::thermal::vtestimator::kVtEstimatorLowConfidence ||
-               ret == ::thermal::vtestimator::kVtEstimatorUnderSampling) {
-        std::string_view backup_sensor = sensor_info.virtual_sensor_info->backup_sensor;
-        float backup_sensor_vt;
-        if (backup_sensor.empty()) {
-            LOG(ERROR) << "Failed to run estimator (ret: " << ret << ") for " << sensor_name
-                       << " with no backup.";
-            return false;
-        }
-        LOG(INFO) << "VT Estimator returned (ret: " << ret << ") for " << sensor_name
-                  << ". Reading backup sensor [" << backup_sensor << "] data to use";
-        if (!readDataByType(backup_sensor, &backup_sensor_vt, SensorFusionType::SENSOR,
-                            force_no_cache, sensor_log_map)) {
-            LOG(ERROR) << "Failed to read " << sensor_name.data() << "'s backup sensor "
-                       << backup_sensor;
-            return false;
+    void onEstimate(size_t sensor_node) override {
+        if (sensor_node < helper_->prediction_caches_.size()) {
+            // Cached predictions are from the previous run now
+            std::lock_guard<std::mutex> _lock(helper_->prediction_cache_mutex_);
+            helper_->prediction_caches_[sensor_node].estimate_time = boot_clock::now();
         }
-        model_outputs.clear();
-        model_outputs.push_back(backup_sensor_vt);
-        *outputs = model_outputs;
-        return true;
     }
 
-    LOG(ERROR) << "Failed to run estimator (ret: " << ret << ") for " << sensor_name;
-    return false;
-}
+  private:
+    ThermalHelperImpl *helper_;
+    const bool force_no_cache_;
+    SensorTickReadings *tick_;
+};
 
 void ThermalHelperImpl::dumpVtEstimatorStatus(std::string_view sensor_name,
                                               std::ostringstream *dump_buf) const {
@@ -1084,38 +1339,21 @@ void ThermalHelperImpl::dumpVtEstimatorStatus(std::string_view sensor_name,
 }
 
 size_t ThermalHelperImpl::getPredictionMaxWindowMs(std::string_view sensor_name) {
-    size_t predict_window = 0;
-
-    ATRACE_NAME(StringPrintf("ThermalHelper::getPredictionMaxWindowMs - %s", sensor_name.data())
-                        .c_str());
-
-    const auto &sensor_info = sensor_info_map_.at(sensor_name.data());
-    if (sensor_info.predictor_info == nullptr) {
+    const auto node_itr = sensor_node_map_.find(sensor_name.data());
+    if (node_itr == sensor_node_map_.end() ||
+        sensor_nodes_[node_itr->second].predictor_node == kNoSensorNode) {
         LOG(ERROR) << "No predictor info found for sensor: " << sensor_name;
         return 0;
     }
 
-    std::string_view predict_sensor_name = sensor_info.predictor_info->sensor;
-    const auto &predictor_sensor_info = sensor_info_map_.at(predict_sensor_name.data());
-    ::thermal::vtestimator::VtEstimatorStatus ret =
-            predictor_sensor_info.virtual_sensor_info->vt_estimator->GetMaxPredictWindowMs(
-                    &predict_window);
-
-    if (ret != ::thermal::vtestimator::kVtEstimatorOk) {
-        LOG(ERROR) << "Failed to read prediction (ret: " << ret << ") from " << predict_sensor_name
-                   << " for sensor " << sensor_name;
-        return 0;
-    }
-
-    return predict_window;
+    return prediction_caches_[sensor_nodes_[node_itr->second].predictor_node].max_window_ms;
 }
 
 float ThermalHelperImpl::readPredictionAfterTimeMs(std::string_view sensor_name,
                                                    const size_t time_ms) {
     float predicted_vt = NAN;
 
-    ATRACE_NAME(
-            StringPrintf("ThermalHelper::readPredictAfterTimeMs - %s", sensor_name.data()).c_str());
+    PIXEL_TRACE_NAME_F("ThermalHelper::readPredictAfterTimeMs - %s", sensor_name.data());
 
     const auto &sensor_info = sensor_info_map_.at(sensor_name.data());
     if (sensor_info.predictor_info == nullptr) {
@@ -1145,57 +1383,89 @@ float ThermalHelperImpl::readPredictionAfterTimeMs(std::string_view sensor_name,
     return NAN;
 }
 
-bool ThermalHelperImpl::readTemperaturePredictions(std::string_view sensor_name,
+bool ThermalHelperImpl::readTemperaturePredictions(size_t sensor_node,
                                                    std::vector<float> *predictions) {
-    ATRACE_NAME(StringPrintf("ThermalHelper::readTemperaturePredictions - %s", sensor_name.data())
-                        .c_str());
+    const SensorNode &node = sensor_nodes_[sensor_node];
+    PIXEL_TRACE_NAME_F("ThermalHelper::readTemperaturePredictions - %s", node.name.data());
 
     if (predictions == nullptr) {
         LOG(ERROR) << " predictions is nullptr";
         return false;
     }
 
-    if (!sensor_info_map_.count(sensor_name.data())) {
-        LOG(ERROR) << sensor_name << " not part of sensor_info_map_";
+    if (node.predictor_node == kNoSensorNode) {
+        LOG(ERROR) << "No predictor info found for sensor: " << node.name;
         return false;
     }
 
-    const auto &sensor_info = sensor_info_map_.at(sensor_name.data());
-    if (sensor_info.predictor_info == nullptr) {
-        LOG(ERROR) << "No predictor info found for sensor: " << sensor_name;
-        return false;
+    const SensorNode &predictor_node = sensor_nodes_[node.predictor_node];
+    std::lock_guard<std::mutex> _lock(prediction_cache_mutex_);
+    auto &cache = prediction_caches_[node.predictor_node];
+    // Until the estimator runs there is no run to cache the predictions of
+    if (cache.estimate_time == boot_clock::time_point::min() ||
+        cache.predictions_time != cache.estimate_time) {
+        ::thermal::vtestimator::VtEstimatorStatus ret =
+                predictor_node.info->virtual_sensor_info->vt_estimator->GetAllPredictions(
+                        &cache.predictions);
+        if (ret != ::thermal::vtestimator::kVtEstimatorOk) {
+            LOG(ERROR) << "Failed to read predictions (ret: " << ret << ") from "
+                       << predictor_node.name << " for sensor " << node.name;
+            cache.predictions_time = boot_clock::time_point::min();
+            return false;
+        }
+        cache.predictions_time = cache.estimate_time;
     }
 
-    std::string predict_sensor_name = sensor_info.predictor_info->sensor;
-    const auto &predictor_sensor_info = sensor_info_map_.at(predict_sensor_name);
-    ::thermal::vtestimator::VtEstimatorStatus ret =
-            predictor_sensor_info.virtual_sensor_info->vt_estimator->GetAllPredictions(predictions);
+    *predictions = cache.predictions;
+    return true;
+}
 
-    if (ret != ::thermal::vtestimator::kVtEstimatorOk) {
-        LOG(ERROR) << "Failed to read predictions (ret: " << ret << ") from " << predict_sensor_name
-                   << " for sensor " << sensor_name;
+bool ThermalHelperImpl::readThermalSensor(size_t sensor_node, float *temp,
+                                          const bool force_no_cache,
+                                          std::map<std::string, float> *sensor_log_map,
+                                          SensorTickReadings *tick) {
+    bool from_cache = false;
+    if (tick == nullptr) {
+        return evaluateThermalSensor(sensor_node, temp, force_no_cache, sensor_log_map, nullptr,
+                                     &from_cache);
+    }
+
+    const auto state = tick->states[sensor_node];
+    if (state == SensorTickReadings::FAILED) {
         return false;
     }
+    // A cached reading doesn't do for a read bypassing the cache
+    if (state == SensorTickReadings::READ ||
+        (state == SensorTickReadings::READ_FROM_CACHE && !force_no_cache)) {
+        *temp = tick->temps[sensor_node];
+        if (!std::isnan(*temp)) {
+            (*sensor_log_map)[sensor_nodes_[sensor_node].name] = *temp;
+        }
+        return true;
+    }
 
+    if (!evaluateThermalSensor(sensor_node, temp, force_no_cache, sensor_log_map, tick,
+                               &from_cache)) {
+        tick->states[sensor_node] = SensorTickReadings::FAILED;
+        return false;
+    }
+    tick->temps[sensor_node] = *temp;
+    tick->states[sensor_node] =
+            from_cache ? SensorTickReadings::READ_FROM_CACHE : SensorTickReadings::READ;
     return true;
 }
 
-constexpr int kTranTimeoutParam = 2;
-
-bool ThermalHelperImpl::readThermalSensor(std::string_view sensor_name, float *temp,
-                                          const bool force_no_cache,
-                                          std::map<std::string, float> *sensor_log_map) {
-    std::string file_reading;
+bool ThermalHelperImpl::evaluateThermalSensor(size_t sensor_node, float *temp,
+                                              const bool force_no_cache,
+                                              std::map<std::string, float> *sensor_log_map,
+                                              SensorTickReadings *tick, bool *from_cache) {
     boot_clock::time_point now = boot_clock::now();
+    const SensorNode &node = sensor_nodes_[sensor_node];
+    std::string_view sensor_name = node.name;
 
-    ATRACE_NAME(StringPrintf("ThermalHelper::readThermalSensor - %s", sensor_name.data()).c_str());
-    if (!(sensor_info_map_.count(sensor_name.data()) &&
-          sensor_status_map_.count(sensor_name.data()))) {
-        return false;
-    }
-
-    const auto &sensor_info = sensor_info_map_.at(sensor_name.data());
-    auto &sensor_status = sensor_status_map_.at(sensor_name.data());
+    PIXEL_TRACE_NAME_F("ThermalHelper::readThermalSensor - %s", sensor_name.data());
+    const auto &sensor_info = *node.info;
+    auto &sensor_status = *node.status;
 
     {
         std::shared_lock<std::shared_mutex> _lock(sensor_status_map_mutex_);
@@ -1215,98 +1485,45 @@ bool ThermalHelperImpl::readThermalSensor(std::string_view sensor_name, float *t
         (since_last_update < sensor_info.time_resolution) &&
         !isnan(sensor_status.thermal_cached.temp)) {
         *temp = sensor_status.thermal_cached.temp;
+        *from_cache = true;
         (*sensor_log_map)[sensor_name.data()] = *temp;
-        ATRACE_INT((sensor_name.data() + std::string("-cached")).c_str(), static_cast<int>(*temp));
+        PIXEL_TRACE_INT_F(static_cast<int>(*temp), "%s-cached", sensor_name.data());
         return true;
     }
 
     // Reading thermal sensor according to it's composition
+    const boot_clock::time_point read_start = boot_clock::now();
     if (sensor_info.virtual_sensor_info == nullptr) {
-        if (!thermal_sensors_.readThermalFile(sensor_name.data(), &file_reading) ||
-            file_reading.empty()) {
+        const bool read_ok = thermal_sensors_.readThermalFile(sensor_name, temp);
+        // A driver stalling on its bus shows up here, failed reads included
+        tick_stats_.recordSensorRead(sensor_node,
+                                     std::chrono::duration_cast<std::chrono::microseconds>(
+                                             boot_clock::now() - read_start));
+        if (!read_ok) {
             LOG(ERROR) << "failed to read sensor: " << sensor_name;
             return false;
         }
-        *temp = std::stof(::android::base::Trim(file_reading));
+        if (tick != nullptr && trace_recorder_.isRecording()) {
+            trace_recorder_.recordSensorReading(sensor_name, *temp);
+        }
     } else {
-        const auto &linked_sensors_size = sensor_info.virtual_sensor_info->linked_sensors.size();
-        std::vector<float> sensor_readings(linked_sensors_size, NAN);
-
-        // Calculate temperature of each of the linked sensor
-        for (size_t i = 0; i < linked_sensors_size; i++) {
-            if (!readDataByType(sensor_info.virtual_sensor_info->linked_sensors[i],
-                                &sensor_readings[i],
-                                sensor_info.virtual_sensor_info->linked_sensors_type[i],
-                                force_no_cache, sensor_log_map)) {
-                LOG(ERROR) << "Failed to read " << sensor_name.data() << "'s linked sensor "
-                           << sensor_info.virtual_sensor_info->linked_sensors[i];
-                return false;
-            }
-            if (std::isnan(sensor_readings[i])) {
-                LOG(INFO) << sensor_name << " data is under collecting";
-                return true;
-            }
+        SensorInputs inputs(this, force_no_cache, tick);
+        if (!EvaluateVirtualSensor(sensor_name, sensor_node, *sensor_info.virtual_sensor_info,
+                                   node.linked_nodes, node.coefficient_nodes, node.backup_node,
+                                   &inputs, sensor_log_map, temp)) {
+            return false;
         }
-
-        if ((sensor_info.virtual_sensor_info->formula == FormulaOption::USE_ML_MODEL) ||
-            (sensor_info.virtual_sensor_info->formula == FormulaOption::USE_LINEAR_MODEL)) {
-            std::vector<float> vt_estimator_out;
-            if (!runVirtualTempEstimator(sensor_name, sensor_log_map, force_no_cache,
-                                         &vt_estimator_out)) {
-                LOG(ERROR) << "Failed running VirtualEstimator for " << sensor_name;
-                return false;
-            }
-            *temp = vt_estimator_out[0];
-        } else {
-            float temp_val = 0.0;
-            for (size_t i = 0; i < linked_sensors_size; i++) {
-                float coefficient = NAN;
-                if (!readDataByType(sensor_info.virtual_sensor_info->coefficients[i], &coefficient,
-                                    sensor_info.virtual_sensor_info->coefficients_type[i],
-                                    force_no_cache, sensor_log_map)) {
-                    LOG(ERROR) << "Failed to read " << sensor_name.data() << "'s coefficient "
-                               << sensor_info.virtual_sensor_info->coefficients[i];
-                    return false;
-                }
-                if (std::isnan(coefficient)) {
-                    LOG(INFO) << sensor_name << " data is under collecting";
-                    return true;
-                }
-                switch (sensor_info.virtual_sensor_info->formula) {
-                    case FormulaOption::COUNT_THRESHOLD:
-                        if ((coefficient < 0 && sensor_readings[i] < -coefficient) ||
-                            (coefficient >= 0 && sensor_readings[i] >= coefficient))
-                            temp_val += 1;
-                        break;
-                    case FormulaOption::WEIGHTED_AVG:
-                        temp_val += sensor_readings[i] * coefficient;
-                        break;
-                    case FormulaOption::MAXIMUM:
-                        if (i == 0)
-                            temp_val = std::numeric_limits<float>::lowest();
-                        if (sensor_readings[i] * coefficient > temp_val)
-                            temp_val = sensor_readings[i] * coefficient;
-                        break;
-                    case FormulaOption::MINIMUM:
-                        if (i == 0)
-                            temp_val = std::numeric_limits<float>::max();
-                        if (sensor_readings[i] * coefficient < temp_val)
-                            temp_val = sensor_readings[i] * coefficient;
-                        break;
-                    default:
-                        LOG(ERROR) << "Unknown formula type for sensor " << sensor_name.data();
-                        return false;
-                }
-            }
-            *temp = (temp_val + sensor_info.virtual_sensor_info->offset);
+        if (std::isnan(*temp)) {
+            return true;
         }
+        // Includes the reads of linked sensors missing from the cache and the estimator run
+        tick_stats_.recordSensorRead(sensor_node,
+                                     std::chrono::duration_cast<std::chrono::microseconds>(
+                                             boot_clock::now() - read_start));
     }
 
-    if (!isnan(sensor_info.step_ratio) && !isnan(sensor_status.thermal_cached.temp) &&
-        since_last_update < sensor_info.passive_delay * kTranTimeoutParam) {
-        *temp = (sensor_info.step_ratio * *temp +
-                 (1 - sensor_info.step_ratio) * sensor_status.thermal_cached.temp);
-    }
+    *temp = SmoothSensorTemp(sensor_info, *temp, sensor_status.thermal_cached.temp,
+                             since_last_update);
 
     (*sensor_log_map)[sensor_name.data()] = *temp;
     ATRACE_INT(sensor_name.data(), static_cast<int>(*temp));
@@ -1317,43 +1534,50 @@ bool ThermalHelperImpl::readThermalSensor(std::string_view sensor_name, float *t
         sensor_status.thermal_cached.timestamp = now;
     }
     auto real_temp = (*temp) * sensor_info.multiplier;
-    thermal_stats_helper_.updateSensorTempStatsByThreshold(sensor_name, real_temp);
+    thermal_stats_helper_.updateSensorTempStatsByThreshold(sensor_info.id, real_temp);
     return true;
 }
 
 // This is called in the different thread context and will update sensor_status
-// uevent_sensors is the set of sensors which trigger uevent from thermal core driver.
+// triggered_sensors are the sensor nodes which trigger uevent from thermal core driver.
 std::chrono::milliseconds ThermalHelperImpl::thermalWatcherCallbackFunc(
-        const std::set<std::string> &uevent_sensors) {
+        const TriggeredSensors &triggered_sensors) {
     std::vector<Temperature> temps;
     std::vector<std::string> cooling_devices_to_update;
     boot_clock::time_point now = boot_clock::now();
-    auto min_sleep_ms = std::chrono::milliseconds::max();
+    const boot_clock::time_point tick_start = now;
     bool power_data_is_updated = false;
+    bool snapshot_is_updated = false;
+    ThermalTickStats::TickTiming tick_timing = {};
 
     ATRACE_CALL();
-    for (auto &name_status_pair : sensor_status_map_) {
-        bool force_update = false;
+    if (trace_recorder_.isRecording()) {
+        trace_recorder_.beginTick(now);
+    }
+    sensor_tick_readings_.reset(sensor_nodes_.size());
+    if (tick_temperatures_.size() != sensor_info_map_.size()) {
+        tick_temperatures_.resize(sensor_info_map_.size());
+    }
+    std::vector<size_t> due_nodes;
+    // Sensors taken from the deadline heap are due, the others are checked here
+    const bool check_due = collectDueSensors(triggered_sensors, now, &due_nodes);
+    for (const size_t sensor_node : due_nodes) {
+        const SensorNode &node = sensor_nodes_[sensor_node];
+        bool force_update = !check_due;
         bool force_no_cache = false;
         Temperature temp;
         TemperatureThreshold threshold;
-        SensorStatus &sensor_status = name_status_pair.second;
-        const SensorInfo &sensor_info = sensor_info_map_.at(name_status_pair.first);
+        SensorStatus &sensor_status = *node.status;
+        const SensorInfo &sensor_info = *node.info;
         bool max_throttling = false;
 
-        // Only handle the sensors in allow list
-        if (!sensor_info.is_watch) {
-            continue;
-        }
-
-        ATRACE_NAME(StringPrintf("ThermalHelper::thermalWatcherCallbackFunc - %s",
-                                 name_status_pair.first.data())
-                            .c_str());
+        PIXEL_TRACE_NAME_F("ThermalHelper::thermalWatcherCallbackFunc - %s", node.name.data());
 
         std::chrono::milliseconds time_elapsed_ms = std::chrono::milliseconds::zero();
         auto sleep_ms = (sensor_status.severity != ThrottlingSeverity::NONE)
                                 ? sensor_info.passive_delay
                                 : sensor_info.polling_delay;
+        bool trigger_is_throttling = false;
 
         if (sensor_info.virtual_sensor_info != nullptr &&
             !sensor_info.virtual_sensor_info->trigger_sensors.empty()) {
@@ -1362,32 +1586,39 @@ std::chrono::milliseconds ThermalHelperImpl::thermalWatcherCallbackFunc(
                         sensor_status_map_.at(sensor_info.virtual_sensor_info->trigger_sensors[i]);
                 if (trigger_sensor_status.severity != ThrottlingSeverity::NONE) {
                     sleep_ms = sensor_info.passive_delay;
+                    trigger_is_throttling = true;
                     break;
                 }
             }
         }
+        if (sensor_info.adaptive_polling) {
+            // The period picked at the last update stands, unless it was stretched and a
+            // trigger sensor has started throttling since
+            const auto adapted_ms = sensor_schedules_[sensor_node].period;
+            if (adapted_ms > std::chrono::milliseconds::zero() &&
+                (adapted_ms < sleep_ms || !trigger_is_throttling)) {
+                sleep_ms = adapted_ms;
+            }
+        }
         // Check if the sensor need to be updated
         if (sensor_status.last_update_time == boot_clock::time_point::min()) {
             force_update = true;
         } else {
             time_elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
                     now - sensor_status.last_update_time);
-            if (uevent_sensors.size()) {
+            if (triggered_sensors.any()) {
                 if (sensor_info.virtual_sensor_info != nullptr) {
-                    for (size_t i = 0; i < sensor_info.virtual_sensor_info->trigger_sensors.size();
-                         i++) {
-                        if (uevent_sensors.find(
-                                    sensor_info.virtual_sensor_info->trigger_sensors[i]) !=
-                            uevent_sensors.end()) {
+                    for (const size_t trigger_node : node.trigger_nodes) {
+                        if (triggered_sensors.test(trigger_node)) {
                             force_update = true;
                             break;
                         }
                     }
-                } else if (uevent_sensors.find(name_status_pair.first) != uevent_sensors.end()) {
+                } else if (triggered_sensors.test(sensor_node)) {
                     force_update = true;
                     force_no_cache = true;
                 }
-            } else if (time_elapsed_ms > sleep_ms) {
+            } else if (time_elapsed_ms + kSensorDeadlineSlack > sleep_ms) {
                 force_update = true;
             }
         }
@@ -1399,32 +1630,37 @@ std::chrono::milliseconds ThermalHelperImpl::thermalWatcherCallbackFunc(
                 sensor_status.override_status.pending_update = false;
             }
         }
-        LOG(VERBOSE) << "sensor " << name_status_pair.first
-                     << ": time_elapsed=" << time_elapsed_ms.count()
+        LOG(VERBOSE) << "sensor " << node.name << ": time_elapsed=" << time_elapsed_ms.count()
                      << ", sleep_ms=" << sleep_ms.count() << ", force_update = " << force_update
                      << ", force_no_cache = " << force_no_cache;
 
         if (!force_update) {
-            auto timeout_remaining = sleep_ms - time_elapsed_ms;
-            if (min_sleep_ms > timeout_remaining) {
-                min_sleep_ms = timeout_remaining;
-            }
-            LOG(VERBOSE) << "sensor " << name_status_pair.first
-                         << ": timeout_remaining=" << timeout_remaining.count();
+            scheduleSensor(sensor_node, sensor_status.last_update_time + sleep_ms);
+            LOG(VERBOSE) << "sensor " << node.name
+                         << ": timeout_remaining=" << (sleep_ms - time_elapsed_ms).count();
             continue;
         }
+        // A sensor which fails to read is retried one period later
+        scheduleSensor(sensor_node, now + sleep_ms);
 
         std::pair<ThrottlingSeverity, ThrottlingSeverity> throttling_status;
-        if (!readTemperature(name_status_pair.first, &temp, &throttling_status, force_no_cache)) {
-            LOG(ERROR) << __func__
-                       << ": error reading temperature for sensor: " << name_status_pair.first;
+        if (!readTemperature(node.name, &temp, &throttling_status, force_no_cache,
+                             &sensor_tick_readings_)) {
+            LOG(ERROR) << __func__ << ": error reading temperature for sensor: " << node.name;
             continue;
         }
-        if (!readTemperatureThreshold(name_status_pair.first, &threshold)) {
+        if (!readTemperatureThreshold(node.name, &threshold)) {
             LOG(ERROR) << __func__ << ": error reading temperature threshold for sensor: "
-                       << name_status_pair.first;
+                       << node.name;
             continue;
         }
+        const auto &prev_temp = tick_temperatures_[sensor_info.id];
+        const float prev_value = prev_temp.has_value() ? prev_temp->value : NAN;
+        tick_temperatures_[sensor_info.id] = temp;
+        snapshot_is_updated = true;
+        if (trace_recorder_.isRecording()) {
+            trace_recorder_.recordSensorUpdate(node.name);
+        }
 
         {
             // writer lock
@@ -1441,23 +1677,58 @@ std::chrono::milliseconds ThermalHelperImpl::thermalWatcherCallbackFunc(
                 sleep_ms = (sensor_status.severity != ThrottlingSeverity::NONE)
                                    ? sensor_info.passive_delay
                                    : sensor_info.polling_delay;
+                if (sensor_status.severity != ThrottlingSeverity::NONE) {
+                    // Virtual sensors triggered by this one switch to passive_delay now
+                    // rather than at their next polling_delay update
+                    for (const size_t dependent : trigger_dependents_[sensor_node]) {
+                        const auto next_due = sensor_schedules_[dependent].next_due;
+                        const auto last_update_time =
+                                sensor_nodes_[dependent].status->last_update_time;
+                        if (next_due == boot_clock::time_point::max() ||
+                            last_update_time == boot_clock::time_point::min()) {
+                            continue;
+                        }
+                        const auto passive_due =
+                                last_update_time + sensor_nodes_[dependent].info->passive_delay;
+                        if (passive_due < next_due) {
+                            scheduleSensor(dependent, passive_due);
+                        }
+                    }
+                }
             }
         }
 
+        if (sensor_info.adaptive_polling) {
+            const auto base_sleep_ms =
+                    (sensor_status.severity != ThrottlingSeverity::NONE || trigger_is_throttling)
+                            ? sensor_info.passive_delay
+                            : sensor_info.polling_delay;
+            sleep_ms = AdaptPollingDelay(sensor_info, sensor_status.severity, temp.value,
+                                         prev_value, time_elapsed_ms, base_sleep_ms);
+        }
+
         if (!power_data_is_updated) {
-            power_files_.refreshPowerStatus();
+            power_files_.refreshPowerStatus(now);
             power_data_is_updated = true;
+            if (trace_recorder_.isRecording()) {
+                const auto &rail_names = power_files_.GetEnergyRailNames();
+                const auto &energy_samples = power_files_.GetEnergySamples();
+                for (size_t slot = 0; slot < energy_samples.size(); ++slot) {
+                    trace_recorder_.recordEnergySample(rail_names[slot], energy_samples[slot]);
+                }
+            }
         }
 
+        const boot_clock::time_point throttling_start = boot_clock::now();
         if (sensor_status.severity == ThrottlingSeverity::NONE) {
-            thermal_throttling_.clearThrottlingData(name_status_pair.first);
+            thermal_throttling_.clearThrottlingData(sensor_info);
         } else {
             // prepare for predictions for throttling compensation
             std::vector<float> sensor_predictions;
             if (sensor_info.predictor_info != nullptr &&
                 sensor_info.predictor_info->support_pid_compensation) {
-                if (!readTemperaturePredictions(name_status_pair.first, &sensor_predictions)) {
-                    LOG(ERROR) << "Failed to read predictions of " << name_status_pair.first
+                if (!readTemperaturePredictions(sensor_node, &sensor_predictions)) {
+                    LOG(ERROR) << "Failed to read predictions of " << node.name
                                << " for throttling compensation";
                 }
             }
@@ -1469,26 +1740,49 @@ std::chrono::milliseconds ThermalHelperImpl::thermalWatcherCallbackFunc(
                     sensor_predictions);
         }
 
-        thermal_throttling_.computeCoolingDevicesRequest(
-                name_status_pair.first, sensor_info, sensor_status.severity,
-                &cooling_devices_to_update, &thermal_stats_helper_);
-        if (min_sleep_ms > sleep_ms) {
-            min_sleep_ms = sleep_ms;
-        }
+        thermal_throttling_.computeCoolingDevicesRequest(node.name, sensor_info,
+                                                         sensor_status.severity,
+                                                         &cooling_devices_to_update,
+                                                         &thermal_stats_helper_);
+        tick_timing.throttling_update += std::chrono::duration_cast<std::chrono::microseconds>(
+                boot_clock::now() - throttling_start);
+        scheduleSensor(sensor_node, now + sleep_ms);
 
-        LOG(VERBOSE) << "Sensor " << name_status_pair.first << ": sleep_ms=" << sleep_ms.count()
-                     << ", min_sleep_ms voting result=" << min_sleep_ms.count();
+        LOG(VERBOSE) << "Sensor " << node.name << ": sleep_ms=" << sleep_ms.count();
+        if (sensor_status.last_update_time != boot_clock::time_point::min()) {
+            sensor_status.requested_period = sensor_schedules_[sensor_node].period;
+            sensor_status.actual_period = time_elapsed_ms;
+        }
+        sensor_schedules_[sensor_node].period = sleep_ms;
         sensor_status.last_update_time = now;
     }
 
     if (!cooling_devices_to_update.empty()) {
+        const boot_clock::time_point cdev_update_start = boot_clock::now();
         updateCoolingDevices(cooling_devices_to_update);
+        tick_timing.cdev_update = std::chrono::duration_cast<std::chrono::microseconds>(
+                boot_clock::now() - cdev_update_start);
     }
 
+    if (trace_recorder_.isRecording()) {
+        trace_recorder_.endTick();
+    }
+
+    if (snapshot_is_updated) {
+        auto snapshot = std::make_shared<const ThermalSnapshot>(
+                ThermalSnapshot{.temperatures = tick_temperatures_});
+        std::lock_guard<std::mutex> _lock(thermal_snapshot_mutex_);
+        thermal_snapshot_.swap(snapshot);
+    }
+
+    const auto emul_script_report = emul_script_player_.activeReport();
     if (!temps.empty()) {
         for (const auto &t : temps) {
             if (sensor_info_map_.at(t.name).send_cb && cb_) {
                 cb_(t);
+                if (emul_script_report != nullptr) {
+                    emul_script_report->recordSeverityChange();
+                }
             }
 
             if (sensor_info_map_.at(t.name).send_powerhint) {
@@ -1508,7 +1802,27 @@ std::chrono::milliseconds ThermalHelperImpl::thermalWatcherCallbackFunc(
         power_files_.logPowerStatus(now);
     }
 
-    return min_sleep_ms;
+    // Drop the entries of rescheduled sensors to find the next deadline
+    while (!sensor_deadlines_.empty() &&
+           sensor_schedules_[sensor_deadlines_.top().second].next_due !=
+                   sensor_deadlines_.top().first) {
+        sensor_deadlines_.pop();
+    }
+    auto next_sleep = std::chrono::milliseconds::max();
+    now = boot_clock::now();
+    if (!sensor_deadlines_.empty()) {
+        const auto next_due = sensor_deadlines_.top().first;
+        next_sleep = (next_due <= now)
+                             ? std::chrono::milliseconds::zero()
+                             : std::chrono::ceil<std::chrono::milliseconds>(next_due - now);
+    }
+    tick_timing.total = std::chrono::duration_cast<std::chrono::microseconds>(now - tick_start);
+    tick_stats_.recordTick(tick_timing, next_sleep);
+    if (emul_script_report != nullptr) {
+        emul_script_report->recordTick(tick_timing.total);
+        emul_script_report->recordCdevRequests(cooling_devices_to_update.size());
+    }
+    return next_sleep;
 }
 
 }  // namespace implementation
@@ -19,9 +19,13 @@
 #include <aidl/android/hardware/thermal/IThermal.h>
 
 #include <array>
+#include <atomic>
 #include <chrono>
+#include <cmath>
 #include <map>
 #include <mutex>
+#include <optional>
+#include <queue>
 #include <shared_mutex>
 #include <string>
 #include <string_view>
@@ -31,10 +35,16 @@
 
 #include "utils/power_files.h"
 #include "utils/powerhal_helper.h"
+#include "utils/thermal_adaptive_polling.h"
+#include "utils/thermal_config_cache.h"
+#include "utils/thermal_emul_script.h"
 #include "utils/thermal_files.h"
 #include "utils/thermal_info.h"
+#include "utils/thermal_sensor_eval.h"
 #include "utils/thermal_stats_helper.h"
 #include "utils/thermal_throttling.h"
+#include "utils/thermal_tick_stats.h"
+#include "utils/thermal_trace.h"
 #include "utils/thermal_watcher.h"
 
 namespace aidl {
@@ -73,6 +83,19 @@ struct SensorStatus {
     boot_clock::time_point last_update_time;
     ThermalSample thermal_cached;
     OverrideStatus override_status;
+    // Polling period the watcher asked for before the last update, and the
+    // time that actually passed since the update before it
+    std::chrono::milliseconds requested_period;
+    std::chrono::milliseconds actual_period;
+};
+
+// The part of a SensorStatus the dump shows, copied out under the lock
+struct SensorStatusSnapshot {
+    ThermalSample thermal_cached;
+    std::chrono::milliseconds requested_period;
+    std::chrono::milliseconds actual_period;
+    std::optional<EmulTemp> emul_temp;
+    bool max_throttling;
 };
 
 class ThermalHelper {
@@ -89,6 +112,14 @@ class ThermalHelper {
     virtual bool emulSeverity(std::string_view target_sensor, const int severity,
                               const bool max_throttling) = 0;
     virtual bool emulClear(std::string_view target_sensor) = 0;
+    // Play an emulation script at speed times its own pace, see thermal_emul_script.h
+    virtual bool emulScript(std::string_view script_path, const float speed) = 0;
+    virtual void emulScriptStop() = 0;
+    // The report of the script playing, nullptr if none is
+    virtual std::shared_ptr<EmulScriptReport> getEmulScriptReport() const = 0;
+    // Reread the state2power table of a cooling device from sysfs, or of all of them with
+    // "all", once its driver changed it
+    virtual bool refreshCdevPowerTable(std::string_view target_cdev) = 0;
     virtual bool isInitializedOk() const = 0;
     virtual bool readTemperature(
             std::string_view sensor_name, Temperature *out,
@@ -106,6 +137,12 @@ class ThermalHelper {
     GetThermalThrottlingStatusMap() const = 0;
     virtual const std::unordered_map<std::string, PowerRailInfo> &GetPowerRailInfoMap() const = 0;
     virtual const std::unordered_map<std::string, PowerStatus> &GetPowerStatusMap() const = 0;
+    // Copies for the dump, which formats them without holding the locks
+    virtual std::unordered_map<std::string, SensorStatusSnapshot> GetSensorStatusSnapshot()
+            const = 0;
+    virtual std::unordered_map<std::string, ThermalThrottlingStatus>
+    GetThermalThrottlingStatusSnapshot() const = 0;
+    virtual std::unordered_map<std::string, PowerStatus> GetPowerStatusSnapshot() const = 0;
     virtual const std::unordered_map<std::string, SensorTempStats> GetSensorTempStatsSnapshot() = 0;
     virtual const std::unordered_map<std::string,
                                      std::unordered_map<std::string, ThermalStats<int>>>
@@ -113,6 +150,9 @@ class ThermalHelper {
     virtual bool isAidlPowerHalExist() = 0;
     virtual bool isPowerHalConnected() = 0;
     virtual bool isPowerHalExtConnected() = 0;
+    virtual void dumpPowerHalStatus(std::ostringstream *dump_buf) = 0;
+    virtual void dumpTickStats(std::ostringstream *dump_buf) const = 0;
+    virtual void dumpEmulScript(std::ostringstream *dump_buf) const = 0;
     virtual void dumpTraces(std::string_view target_sensor) = 0;
 };
 
@@ -132,6 +172,12 @@ class ThermalHelperImpl : public ThermalHelper {
     bool emulSeverity(std::string_view target_sensor, const int severity,
                       const bool max_throttling) override;
     bool emulClear(std::string_view target_sensor) override;
+    bool emulScript(std::string_view script_path, const float speed) override;
+    void emulScriptStop() override { emul_script_player_.stop(); }
+    std::shared_ptr<EmulScriptReport> getEmulScriptReport() const override {
+        return emul_script_player_.activeReport();
+    }
+    bool refreshCdevPowerTable(std::string_view target_cdev) override;
     void dumpTraces(std::string_view target_sensor) override;
 
     // Disallow copy and assign.
@@ -180,6 +226,15 @@ class ThermalHelperImpl : public ThermalHelper {
     const std::unordered_map<std::string, PowerStatus> &GetPowerStatusMap() const override {
         return power_files_.GetPowerStatusMap();
     }
+    std::unordered_map<std::string, SensorStatusSnapshot> GetSensorStatusSnapshot()
+            const override;
+    std::unordered_map<std::string, ThermalThrottlingStatus> GetThermalThrottlingStatusSnapshot()
+            const override {
+        return thermal_throttling_.GetThermalThrottlingStatusSnapshot();
+    }
+    std::unordered_map<std::string, PowerStatus> GetPowerStatusSnapshot() const override {
+        return power_files_.GetPowerStatusSnapshot();
+    }
 
     // Get Thermal Stats Sensor Map
     const std::unordered_map<std::string, SensorTempStats> GetSensorTempStatsSnapshot() override {
@@ -194,6 +249,15 @@ class ThermalHelperImpl : public ThermalHelper {
     bool isAidlPowerHalExist() override { return power_hal_service_.isAidlPowerHalExist(); }
     bool isPowerHalConnected() override { return power_hal_service_.isPowerHalConnected(); }
     bool isPowerHalExtConnected() override { return power_hal_service_.isPowerHalExtConnected(); }
+    void dumpPowerHalStatus(std::ostringstream *dump_buf) override {
+        power_hal_service_.dump(dump_buf);
+    }
+    void dumpTickStats(std::ostringstream *dump_buf) const override {
+        tick_stats_.dump(dump_buf);
+    }
+    void dumpEmulScript(std::ostringstream *dump_buf) const override {
+        emul_script_player_.dump(dump_buf);
+    }
 
   private:
     bool initializeSensorMap(const std::unordered_map<std::string, std::string> &path_map);
@@ -201,49 +265,134 @@ class ThermalHelperImpl : public ThermalHelper {
     bool isSubSensorValid(std::string_view sensor_data, const SensorFusionType sensor_fusion_type);
     void setMinTimeout(SensorInfo *sensor_info);
     void initializeTrip(const std::unordered_map<std::string, std::string> &path_map,
-                        std::set<std::string> *monitored_sensors, bool thermal_genl_enabled);
+                        std::vector<WatchedSensor> *monitored_sensors, bool thermal_genl_enabled);
     void clearAllThrottling();
     // For thermal_watcher_'s polling thread, return the sleep interval
     std::chrono::milliseconds thermalWatcherCallbackFunc(
-            const std::set<std::string> &uevent_sensors);
-    // Return hot and cold severity status as std::pair
-    std::pair<ThrottlingSeverity, ThrottlingSeverity> getSeverityFromThresholds(
-            const ThrottlingArray &hot_thresholds, const ThrottlingArray &cold_thresholds,
-            const ThrottlingArray &hot_hysteresis, const ThrottlingArray &cold_hysteresis,
-            ThrottlingSeverity prev_hot_severity, ThrottlingSeverity prev_cold_severity,
-            float value) const;
-    // Read sensor data according to the type
-    bool readDataByType(std::string_view sensor_data, float *reading_value,
-                        const SensorFusionType type, const bool force_no_cache,
-                        std::map<std::string, float> *sensor_log_map);
-    bool readThermalSensor(std::string_view sensor_name, float *temp, const bool force_sysfs,
-                           std::map<std::string, float> *sensor_log_map);
-    bool runVirtualTempEstimator(std::string_view sensor_name,
-                                 std::map<std::string, float> *sensor_log_map,
-                                 const bool force_no_cache, std::vector<float> *outputs);
+            const TriggeredSensors &triggered_sensors);
+    // Sensors in dependency order, a virtual sensor comes after every sensor
+    // it reads. Built once sensor_info_map_ and sensor_status_map_ are final.
+    struct SensorNode {
+        std::string name;
+        const SensorInfo *info;
+        SensorStatus *status;
+        // Node of each linked sensor and coefficient, kNoSensorNode unless
+        // its type is SENSOR
+        std::vector<size_t> linked_nodes;
+        std::vector<size_t> coefficient_nodes;
+        size_t backup_node;
+        // Node of the PredictorSensor, kNoSensorNode without predictor info
+        size_t predictor_node;
+        // Node of each trigger sensor of a watched virtual sensor
+        std::vector<size_t> trigger_nodes;
+    };
+    // Readings taken during one watcher tick, so a sensor linked by several
+    // virtual sensors is evaluated once per tick
+    struct SensorTickReadings {
+        enum State : uint8_t { NOT_READ, READ_FROM_CACHE, READ, FAILED };
+        std::vector<float> temps;
+        std::vector<State> states;
+        void reset(size_t size) {
+            temps.assign(size, NAN);
+            states.assign(size, NOT_READ);
+        }
+    };
+    bool initializeSensorGraph();
+    // When each watched sensor is next due, indexed by sensor node.
+    // next_due is time_point::max() while the sensor is taken by a tick.
+    struct SensorSchedule {
+        boot_clock::time_point next_due;
+        std::chrono::milliseconds period;
+    };
+    using SensorDeadline = std::pair<boot_clock::time_point, size_t>;
+    // Pushes a heap entry when next_due moves, the entries it replaces stay
+    // in the heap and are dropped once they reach the top
+    void scheduleSensor(size_t sensor_node, boot_clock::time_point next_due);
+    // Sensor nodes the watcher evaluates this tick, returns true if they are
+    // all the watched sensors and each still needs to be checked
+    bool collectDueSensors(const TriggeredSensors &triggered_sensors, boot_clock::time_point now,
+                           std::vector<size_t> *due_nodes);
+    // What the AIDL getters report, the watcher publishes a new one at the
+    // end of a tick and never modifies a published one
+    struct ThermalSnapshot {
+        // Last reading of each watched sensor, indexed by SensorInfo::id
+        std::vector<std::optional<Temperature>> temperatures;
+    };
+    std::shared_ptr<const ThermalSnapshot> getThermalSnapshot() const;
+    bool readTemperature(std::string_view sensor_name, Temperature *out,
+                         std::pair<ThrottlingSeverity, ThrottlingSeverity> *throtting_status,
+                         const bool force_no_cache, SensorTickReadings *tick);
+    // Reads the linked sensors, power rails and backup sensor of a virtual
+    // sensor for EvaluateVirtualSensor()
+    class SensorInputs;
+    // Return the reading of this tick if there is one, tick may be nullptr
+    bool readThermalSensor(size_t sensor_node, float *temp, const bool force_no_cache,
+                           std::map<std::string, float> *sensor_log_map, SensorTickReadings *tick);
+    // Set from_cache if temp is the cached reading
+    bool evaluateThermalSensor(size_t sensor_node, float *temp, const bool force_no_cache,
+                               std::map<std::string, float> *sensor_log_map,
+                               SensorTickReadings *tick, bool *from_cache);
     size_t getPredictionMaxWindowMs(std::string_view sensor_name);
     float readPredictionAfterTimeMs(std::string_view sensor_name, const size_t time_ms);
-    bool readTemperaturePredictions(std::string_view sensor_name, std::vector<float> *predictions);
+    // Predictions of the sensor's predictor from its latest estimator run
+    bool readTemperaturePredictions(size_t sensor_node, std::vector<float> *predictions);
     void updateCoolingDevices(const std::vector<std::string> &cooling_devices_to_update);
     // Check the max CDEV state for cdev_ceiling
     void maxCoolingRequestCheck(
             std::unordered_map<std::string, BindedCdevInfo> *binded_cdev_info_map);
     void checkUpdateSensorForEmul(std::string_view target_sensor, const bool max_throttling);
+    // Set or, for NAN, clear the emulated temperature of several sensors with one wake
+    void emulTemps(const std::vector<std::pair<std::string, float>> &temps);
     sp<ThermalWatcher> thermal_watcher_;
     PowerFiles power_files_;
     ThermalFiles thermal_sensors_;
     ThermalFiles cooling_devices_;
     ThermalThrottling thermal_throttling_;
+    // Only touched from the watcher thread
+    ThermalTraceRecorder trace_recorder_;
     bool is_initialized_;
     const NotificationCallback cb_;
     std::unordered_map<std::string, CdevInfo> cooling_device_info_map_;
+    // The state2power_table sysfs node of the cooling devices which have one
+    std::unordered_map<std::string, std::string> cdev_state2power_paths_;
     std::unordered_map<std::string, SensorInfo> sensor_info_map_;
     std::unordered_map<std::string, std::unordered_map<ThrottlingSeverity, ThrottlingSeverity>>
             supported_powerhint_map_;
     PowerHalService power_hal_service_;
     ThermalStatsHelper thermal_stats_helper_;
+    ThermalTickStats tick_stats_;
     mutable std::shared_mutex sensor_status_map_mutex_;
     std::unordered_map<std::string, SensorStatus> sensor_status_map_;
+    // Set with an override pending_update, so the next tick checks every sensor
+    std::atomic<bool> override_pending_{false};
+    std::vector<SensorNode> sensor_nodes_;
+    std::unordered_map<std::string, size_t> sensor_node_map_;
+    // Only used by the watcher thread
+    std::vector<SensorSchedule> sensor_schedules_;
+    std::priority_queue<SensorDeadline, std::vector<SensorDeadline>, std::greater<SensorDeadline>>
+            sensor_deadlines_;
+    // Watched virtual sensors which poll at passive_delay while a sensor is
+    // throttling, indexed by the node of the TriggerSensor
+    std::vector<std::vector<size_t>> trigger_dependents_;
+    SensorTickReadings sensor_tick_readings_;
+    std::vector<std::optional<Temperature>> tick_temperatures_;
+    // Output of a predictor sensor's estimator, fetched at most once per estimator run
+    struct PredictionCache {
+        std::vector<float> predictions;
+        // Time of the latest estimator run, and of the run predictions are from
+        boot_clock::time_point estimate_time = boot_clock::time_point::min();
+        boot_clock::time_point predictions_time = boot_clock::time_point::min();
+        size_t max_window_ms = 0;
+    };
+    // Indexed by sensor node
+    std::mutex prediction_cache_mutex_;
+    std::vector<PredictionCache> prediction_caches_;
+    // Only held to copy or swap the pointer, so Binder readers never wait for
+    // a watcher tick and the watcher never waits for them
+    mutable std::mutex thermal_snapshot_mutex_;
+    std::shared_ptr<const ThermalSnapshot> thermal_snapshot_;
+    // Last so its thread stops before anything it touches goes away
+    ThermalEmulScriptPlayer emul_script_player_;
 };
 
 }  // namespace implementation
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Parses a thermal config the way the HAL does and fails on anything the HAL would reject. With
+// an output path it also writes the compiled config, which the HAL loads instead of parsing the
+// JSON when it is installed next to the config with the .bin suffix, e.g.
+// /vendor/etc/thermal_info_config.json.bin. The compiled config is keyed by the hash of the
+// JSON, so one left behind by a config change is ignored.
+//
+// usage: thermal_config_verifier <thermal_info_config.json> [compiled.bin]
+
+#include <android-base/logging.h>
+
+#include <iostream>
+#include <string>
+
+#include "utils/thermal_config_cache.h"
+
+int main(int argc, char *argv[]) {
+    using ::aidl::android::hardware::thermal::implementation::CompileThermalConfig;
+
+    if (argc < 2 || argc > 3) {
+        std::cerr << "usage: " << argv[0] << " <thermal_info_config.json> [compiled.bin]"
+                  << std::endl;
+        return 1;
+    }
+    ::android::base::InitLogging(argv, ::android::base::StderrLogger);
+    ::android::base::SetMinimumLogSeverity(::android::base::WARNING);
+
+    const std::string compiled_path = argc == 3 ? argv[2] : "";
+    if (!CompileThermalConfig(argv[1], compiled_path)) {
+        std::cerr << "Failed to verify " << argv[1] << std::endl;
+        return 1;
+    }
+    if (compiled_path.empty()) {
+        std::cout << "Verified " << argv[1] << std::endl;
+    } else {
+        std::cout << "Verified and compiled " << argv[1] << " to " << compiled_path << std::endl;
+    }
+    return 0;
+}
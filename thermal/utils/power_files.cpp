@@ -24,8 +24,12 @@
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <utils/Trace.h>
 
+#include <charconv>
+
 namespace aidl {
 namespace android {
 namespace hardware {
@@ -35,9 +39,12 @@ namespace implementation {
 constexpr std::string_view kDeviceType("iio:device");
 constexpr std::string_view kIioRootDir("/sys/bus/iio/devices");
 constexpr std::string_view kEnergyValueNode("energy_value");
+// Large enough for the energy_value of a device, a longer one grows the buffer
+constexpr size_t kEnergyBufferSize = 2048;
 
 using ::android::base::ReadFileToString;
 using ::android::base::StringPrintf;
+using ::android::hardware::google::pixel::powerstats::RailEnergySampler;
 
 namespace {
 bool calculateAvgPower(std::string_view power_rail, const PowerSample &last_sample,
@@ -63,13 +70,39 @@ bool calculateAvgPower(std::string_view power_rail, const PowerSample &last_samp
                  << ", duration = " << duration << ", deltaEnergy = " << deltaEnergy;
     return true;
 }
-}  // namespace
 
-bool PowerFiles::registerPowerRailsToWatch(const Json::Value &config) {
-    if (!ParsePowerRailInfo(config, &power_rail_info_map_)) {
-        LOG(ERROR) << "Failed to parse power rail info config";
+bool parseUint64(std::string_view str, uint64_t *value) {
+    while (!str.empty() && str.front() == ' ') {
+        str.remove_prefix(1);
+    }
+    return std::from_chars(str.data(), str.data() + str.size(), *value).ec == std::errc();
+}
+
+// Parse one energy_value line without allocating, lines of other formats are
+// skipped. Format example: CH3(T=358356)[S2M_VDD_CPUCL2], 761330
+bool parseEnergyLine(std::string_view line, std::string_view *rail_name, PowerSample *sample) {
+    auto start_pos = line.find("T=");
+    if (start_pos == std::string_view::npos ||
+        !parseUint64(line.substr(start_pos + 2), &sample->duration)) {
+        return false;
+    }
+
+    start_pos = line.find(")[", start_pos);
+    if (start_pos == std::string_view::npos) {
         return false;
     }
+    const auto end_pos = line.find("],", start_pos);
+    if (end_pos == std::string_view::npos) {
+        return false;
+    }
+    *rail_name = line.substr(start_pos + 2, end_pos - start_pos - 2);
+    return parseUint64(line.substr(end_pos + 2), &sample->energy_counter);
+}
+}  // namespace
+
+bool PowerFiles::registerPowerRailsToWatch(
+        std::unordered_map<std::string, PowerRailInfo> &&power_rail_info_map) {
+    power_rail_info_map_ = std::move(power_rail_info_map);
 
     if (!power_rail_info_map_.size()) {
         LOG(INFO) << " No power rail info config found";
@@ -81,17 +114,20 @@ bool PowerFiles::registerPowerRailsToWatch(const Json::Value &config) {
         return false;
     }
 
-    if (!energy_info_map_.size() && !updateEnergyValues()) {
+    if (!energy_samples_.size() && !updateEnergyValues()) {
         LOG(ERROR) << "Faield to update energy info";
         return false;
     }
 
+    auto sample_period = std::chrono::milliseconds::max();
     for (const auto &power_rail_info_pair : power_rail_info_map_) {
         std::vector<std::queue<PowerSample>> power_history;
+        std::vector<size_t> energy_slots;
         if (!power_rail_info_pair.second.power_sample_count ||
             power_rail_info_pair.second.power_sample_delay == std::chrono::milliseconds::max()) {
             continue;
         }
+        sample_period = std::min(sample_period, power_rail_info_pair.second.power_sample_delay);
 
         if (power_rail_info_pair.second.virtual_power_rail_info != nullptr &&
             power_rail_info_pair.second.virtual_power_rail_info->linked_power_rails.size()) {
@@ -100,20 +136,24 @@ bool PowerFiles::registerPowerRailsToWatch(const Json::Value &config) {
                  ++i) {
                 std::string power_rail =
                         power_rail_info_pair.second.virtual_power_rail_info->linked_power_rails[i];
-                if (!energy_info_map_.count(power_rail)) {
+                const size_t energy_slot = findEnergySlot(power_rail);
+                if (energy_slot == kNoEnergySlot) {
                     LOG(ERROR) << " Could not find energy source " << power_rail;
                     return false;
                 }
 
-                const auto curr_sample = energy_info_map_.at(power_rail);
+                const auto curr_sample = energy_samples_[energy_slot];
+                energy_slots.push_back(energy_slot);
                 power_history.emplace_back(std::queue<PowerSample>());
                 for (int j = 0; j < power_rail_info_pair.second.power_sample_count; j++) {
                     power_history[i].emplace(curr_sample);
                 }
             }
         } else {
-            if (energy_info_map_.count(power_rail_info_pair.first)) {
-                const auto curr_sample = energy_info_map_.at(power_rail_info_pair.first);
+            const size_t energy_slot = findEnergySlot(power_rail_info_pair.first);
+            if (energy_slot != kNoEnergySlot) {
+                const auto curr_sample = energy_samples_[energy_slot];
+                energy_slots.push_back(energy_slot);
                 power_history.emplace_back(std::queue<PowerSample>());
                 for (int j = 0; j < power_rail_info_pair.second.power_sample_count; j++) {
                     power_history[0].emplace(curr_sample);
@@ -125,11 +165,16 @@ bool PowerFiles::registerPowerRailsToWatch(const Json::Value &config) {
         }
 
         if (power_history.size()) {
-            power_status_map_[power_rail_info_pair.first] = {
+            auto &power_status = power_status_map_[power_rail_info_pair.first];
+            power_status = {
                     .last_update_time = boot_clock::time_point::min(),
                     .power_history = power_history,
                     .last_updated_avg_power = NAN,
             };
+            tracked_power_rails_.push_back({.name = power_rail_info_pair.first,
+                                            .info = &power_rail_info_pair.second,
+                                            .status = &power_status,
+                                            .energy_slots = std::move(energy_slots)});
         } else {
             LOG(ERROR) << "power history size is zero";
             return false;
@@ -137,15 +182,19 @@ bool PowerFiles::registerPowerRailsToWatch(const Json::Value &config) {
         LOG(INFO) << "Successfully to register power rail " << power_rail_info_pair.first;
     }
 
+    if (sample_period != std::chrono::milliseconds::max()) {
+        startEnergySamplers(sample_period);
+    }
+
     power_status_log_ = {.prev_log_time = boot_clock::now(),
-                         .prev_energy_info_map = energy_info_map_};
+                         .prev_energy_samples = energy_samples_};
     return true;
 }
 
 bool PowerFiles::findEnergySourceToWatch(void) {
     std::string devicePath;
 
-    if (energy_path_set_.size()) {
+    if (energy_sources_.size()) {
         return true;
     }
 
@@ -165,85 +214,137 @@ bool PowerFiles::findEnergySourceToWatch(void) {
             if (!ReadFileToString(StringPrintf("%s/%s", devicePath.data(), kEnergyValueNode.data()),
                                   &deviceEnergyContent)) {
             } else if (deviceEnergyContent.size()) {
-                energy_path_set_.emplace(
+                energy_sources_.emplace_back(
                         StringPrintf("%s/%s", devicePath.data(), kEnergyValueNode.data()));
             }
         }
     }
 
-    if (!energy_path_set_.size()) {
+    if (!energy_sources_.size()) {
         return false;
     }
 
     return true;
 }
 
-bool PowerFiles::updateEnergyValues(void) {
-    std::string deviceEnergyContent;
-    std::string deviceEnergyContents;
-    std::string line;
+bool PowerFiles::readEnergySource(EnergySource *source) {
+    source->buffer.resize(std::max(source->buffer.capacity(), kEnergyBufferSize));
+    bool reopened = false;
+    while (true) {
+        if (!source->fd.ok()) {
+            source->fd.reset(TEMP_FAILURE_RETRY(open(source->path.c_str(), O_RDONLY | O_CLOEXEC)));
+        }
+        const ssize_t len = source->fd.ok() ? TEMP_FAILURE_RETRY(pread(
+                                                      source->fd, source->buffer.data(),
+                                                      source->buffer.size(), 0))
+                                            : -1;
+        if (len < 0) {
+            if (reopened) {
+                PLOG(ERROR) << "Failed to read energy content from " << source->path;
+                return false;
+            }
+            // The driver may have been reloaded, retry once on a fresh fd
+            source->fd.reset();
+            reopened = true;
+            continue;
+        }
+        if (static_cast<size_t>(len) == source->buffer.size()) {
+            // Possibly cut, read again into a larger buffer
+            source->buffer.resize(source->buffer.size() * 2);
+            continue;
+        }
+        source->buffer.resize(len);
+        return true;
+    }
+}
 
-    ATRACE_CALL();
-    for (const auto &path : energy_path_set_) {
-        if (!::android::base::ReadFileToString(path, &deviceEnergyContent)) {
-            LOG(ERROR) << "Failed to read energy content from " << path;
-            return false;
-        } else {
-            deviceEnergyContents.append(deviceEnergyContent);
+void PowerFiles::startEnergySamplers(std::chrono::milliseconds period) {
+    for (auto &source : energy_sources_) {
+        if (source.sampler) {
+            continue;
         }
+        // The sysfs directory of the device is the one of its energy_value node
+        const auto device_path = source.path.substr(0, source.path.find_last_of('/'));
+        source.sampler = RailEnergySampler::create(device_path, period);
+    }
+}
+
+void PowerFiles::storeEnergySample(EnergySource *source, size_t line_index,
+                                   std::string_view power_rail, const PowerSample &sample) {
+    if (line_index == source->line_slots.size()) {
+        source->line_slots.push_back(kNoEnergySlot);
     }
+    size_t &slot = source->line_slots[line_index];
+    if (slot == kNoEnergySlot || energy_rail_names_[slot] != power_rail) {
+        // First read, or the device listed its rails differently
+        slot = findOrAddEnergySlot(power_rail);
+    }
+    energy_samples_[slot] = sample;
+}
 
-    std::istringstream energyData(deviceEnergyContents);
+size_t PowerFiles::findEnergySlot(std::string_view power_rail) const {
+    const auto slot_itr = energy_slot_map_.find(std::string(power_rail));
+    return slot_itr == energy_slot_map_.end() ? kNoEnergySlot : slot_itr->second;
+}
 
-    while (std::getline(energyData, line)) {
-        /* Read rail energy */
-        uint64_t energy_counter = 0;
-        uint64_t duration = 0;
+size_t PowerFiles::findOrAddEnergySlot(std::string_view power_rail) {
+    auto [slot_itr, inserted] =
+            energy_slot_map_.try_emplace(std::string(power_rail), energy_samples_.size());
+    if (inserted) {
+        energy_samples_.emplace_back();
+        energy_rail_names_.emplace_back(power_rail);
+    }
+    return slot_itr->second;
+}
 
-        /* Format example: CH3(T=358356)[S2M_VDD_CPUCL2], 761330 */
-        auto start_pos = line.find("T=");
-        auto end_pos = line.find(')');
-        if (start_pos != std::string::npos) {
-            duration =
-                    strtoul(line.substr(start_pos + 2, end_pos - start_pos - 2).c_str(), NULL, 10);
-        } else {
-            continue;
-        }
+void PowerFiles::setEnergySample(std::string_view power_rail, const PowerSample &sample) {
+    energy_samples_[findOrAddEnergySlot(power_rail)] = sample;
+}
 
-        start_pos = line.find(")[");
-        end_pos = line.find(']');
-        std::string railName;
-        if (start_pos != std::string::npos) {
-            railName = line.substr(start_pos + 2, end_pos - start_pos - 2);
-        } else {
+bool PowerFiles::updateEnergyValues(void) {
+    ATRACE_CALL();
+    for (auto &source : energy_sources_) {
+        if (source.sampler && source.sampler->readLatest(&source.sampled_energy)) {
+            const auto &rail_names = source.sampler->railNames();
+            for (size_t i = 0; i < rail_names.size(); ++i) {
+                storeEnergySample(&source, i, rail_names[i],
+                                  {.energy_counter = source.sampled_energy[i].energyUWs,
+                                   .duration = source.sampled_energy[i].durationMs});
+            }
             continue;
         }
 
-        start_pos = line.find("],");
-        if (start_pos != std::string::npos) {
-            energy_counter = strtoul(line.substr(start_pos + 2).c_str(), NULL, 10);
-        } else {
-            continue;
+        // No buffered capture, or no sample in it yet
+        if (!readEnergySource(&source)) {
+            return false;
         }
 
-        energy_info_map_[railName] = {
-                .energy_counter = energy_counter,
-                .duration = duration,
-        };
+        std::string_view contents(source.buffer);
+        size_t line_index = 0;
+        while (!contents.empty()) {
+            const auto line_end = contents.find('\n');
+            const std::string_view line = contents.substr(0, line_end);
+            contents.remove_prefix(line_end == std::string_view::npos ? contents.size()
+                                                                      : line_end + 1);
+
+            std::string_view rail_name;
+            PowerSample sample;
+            if (!parseEnergyLine(line, &rail_name, &sample)) {
+                continue;
+            }
+
+            storeEnergySample(&source, line_index++, rail_name, sample);
+        }
     }
 
     return true;
 }
 
-float PowerFiles::updateAveragePower(std::string_view power_rail,
+float PowerFiles::updateAveragePower(std::string_view power_rail, size_t energy_slot,
                                      std::queue<PowerSample> *power_history) {
     float avg_power = NAN;
-    if (!energy_info_map_.count(power_rail.data())) {
-        LOG(ERROR) << " Could not find power rail " << power_rail.data();
-        return avg_power;
-    }
     const auto last_sample = power_history->front();
-    const auto curr_sample = energy_info_map_.at(power_rail.data());
+    const auto curr_sample = energy_samples_[energy_slot];
     if (calculateAvgPower(power_rail, last_sample, curr_sample, &avg_power)) {
         power_history->pop();
         power_history->push(curr_sample);
@@ -251,21 +352,13 @@ float PowerFiles::updateAveragePower(std::string_view power_rail,
     return avg_power;
 }
 
-float PowerFiles::updatePowerRail(std::string_view power_rail) {
+float PowerFiles::updatePowerRail(const TrackedPowerRail &power_rail,
+                                  const boot_clock::time_point &now) {
     float avg_power = NAN;
 
-    if (!power_rail_info_map_.count(power_rail.data())) {
-        return avg_power;
-    }
-
-    if (!power_status_map_.count(power_rail.data())) {
-        return avg_power;
-    }
+    const auto &power_rail_info = *power_rail.info;
+    auto &power_status = *power_rail.status;
 
-    const auto &power_rail_info = power_rail_info_map_.at(power_rail.data());
-    auto &power_status = power_status_map_.at(power_rail.data());
-
-    boot_clock::time_point now = boot_clock::now();
     auto time_elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
             now - power_status.last_update_time);
 
@@ -274,13 +367,14 @@ float PowerFiles::updatePowerRail(std::string_view power_rail) {
         return power_status.last_updated_avg_power;
     }
 
-    if (!energy_info_map_.size() && !updateEnergyValues()) {
+    if (!energy_samples_.size() && !updateEnergyValues()) {
         LOG(ERROR) << "Failed to update energy values";
         return avg_power;
     }
 
     if (power_rail_info.virtual_power_rail_info == nullptr) {
-        avg_power = updateAveragePower(power_rail, &power_status.power_history[0]);
+        avg_power = updateAveragePower(power_rail.name, power_rail.energy_slots[0],
+                                       &power_status.power_history[0]);
     } else {
         const auto offset = power_rail_info.virtual_power_rail_info->offset;
         float avg_power_val = 0.0;
@@ -289,7 +383,7 @@ float PowerFiles::updatePowerRail(std::string_view power_rail) {
             float coefficient = power_rail_info.virtual_power_rail_info->coefficients[i];
             float avg_power_number = updateAveragePower(
                     power_rail_info.virtual_power_rail_info->linked_power_rails[i],
-                    &power_status.power_history[i]);
+                    power_rail.energy_slots[i], &power_status.power_history[i]);
 
             switch (power_rail_info.virtual_power_rail_info->formula) {
                 case FormulaOption::COUNT_THRESHOLD:
@@ -332,14 +426,14 @@ float PowerFiles::updatePowerRail(std::string_view power_rail) {
     return avg_power;
 }
 
-bool PowerFiles::refreshPowerStatus(void) {
+bool PowerFiles::refreshPowerStatus(const boot_clock::time_point &now) {
     if (!updateEnergyValues()) {
         LOG(ERROR) << "Failed to update energy values";
         return false;
     }
 
-    for (const auto &power_status_pair : power_status_map_) {
-        updatePowerRail(power_status_pair.first);
+    for (const auto &power_rail : tracked_power_rails_) {
+        updatePowerRail(power_rail, now);
     }
     return true;
 }
@@ -350,13 +444,11 @@ void PowerFiles::logPowerStatus(const boot_clock::time_point &now) {
     uint64_t max_duration = 0;
     float tot_power = 0.0;
     std::string out;
-    for (const auto &energy_info_pair : energy_info_map_) {
-        const auto &rail = energy_info_pair.first;
-        if (!power_status_log_.prev_energy_info_map.count(rail)) {
-            continue;
-        }
-        const auto &last_sample = power_status_log_.prev_energy_info_map.at(rail);
-        const auto &curr_sample = energy_info_pair.second;
+    const auto &prev_energy_samples = power_status_log_.prev_energy_samples;
+    for (size_t slot = 0; slot < prev_energy_samples.size(); ++slot) {
+        const auto &rail = energy_rail_names_[slot];
+        const auto &last_sample = prev_energy_samples[slot];
+        const auto &curr_sample = energy_samples_[slot];
         float avg_power = NAN;
         if (calculateAvgPower(rail, last_sample, curr_sample, &avg_power) &&
             !std::isnan(avg_power)) {
@@ -379,7 +471,7 @@ void PowerFiles::logPowerStatus(const boot_clock::time_point &now) {
                                   max_duration);
         LOG(INFO) << out;
     }
-    power_status_log_ = {.prev_log_time = now, .prev_energy_info_map = energy_info_map_};
+    power_status_log_ = {.prev_log_time = now, .prev_energy_samples = energy_samples_};
 }
 
 }  // namespace implementation
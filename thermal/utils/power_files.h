@@ -17,13 +17,16 @@
 #pragma once
 
 #include <android-base/chrono_utils.h>
+#include <android-base/unique_fd.h>
+#include <railsampler/RailEnergySampler.h>
 
 #include <chrono>
+#include <limits>
 #include <queue>
 #include <shared_mutex>
 #include <string>
 #include <unordered_map>
-#include <unordered_set>
+#include <vector>
 
 #include "thermal_info.h"
 
@@ -49,21 +52,22 @@ struct PowerStatus {
 
 struct PowerStatusLog {
     boot_clock::time_point prev_log_time;
-    // energy sample at last logging
-    std::unordered_map<std::string, PowerSample> prev_energy_info_map;
+    // energy sample at last logging, indexed by energy slot
+    std::vector<PowerSample> prev_energy_samples;
 };
 
 // A helper class for monitoring power rails.
 class PowerFiles {
   public:
     PowerFiles() = default;
-    ~PowerFiles() = default;
+    virtual ~PowerFiles() = default;
     // Disallow copy and assign.
     PowerFiles(const PowerFiles &) = delete;
     void operator=(const PowerFiles &) = delete;
-    bool registerPowerRailsToWatch(const Json::Value &config);
+    bool registerPowerRailsToWatch(
+            std::unordered_map<std::string, PowerRailInfo> &&power_rail_info_map);
     // Update the power data from ODPM sysfs
-    bool refreshPowerStatus(void);
+    bool refreshPowerStatus(const boot_clock::time_point &now);
     // Log the power data for the duration
     void logPowerStatus(const boot_clock::time_point &now);
     // Get previous power log time_point
@@ -75,29 +79,80 @@ class PowerFiles {
         std::shared_lock<std::shared_mutex> _lock(power_status_map_mutex_);
         return power_status_map_;
     }
+    // Copy of the power status map, for readers outside the watcher thread
+    std::unordered_map<std::string, PowerStatus> GetPowerStatusSnapshot() const {
+        std::shared_lock<std::shared_mutex> _lock(power_status_map_mutex_);
+        return power_status_map_;
+    }
     // Get power rail info map
     const std::unordered_map<std::string, PowerRailInfo> &GetPowerRailInfoMap() const {
         return power_rail_info_map_;
     }
+    // Get the names of the rails read so far, indexed by energy slot
+    const std::vector<std::string> &GetEnergyRailNames() const { return energy_rail_names_; }
+    // Get the last energy sample of each rail, indexed by energy slot
+    const std::vector<PowerSample> &GetEnergySamples() const { return energy_samples_; }
+
+  protected:
+    // Update energy value to energy_samples_, return false if the value is failed to update.
+    virtual bool updateEnergyValues(void);
+    // Find the energy source path, return false if no energy source found.
+    virtual bool findEnergySourceToWatch(void);
+    // Store the last energy sample of a rail, giving it a slot on first sight
+    void setEnergySample(std::string_view power_rail, const PowerSample &sample);
 
   private:
-    // Update energy value to energy_info_map_, return false if the value is failed to update.
-    bool updateEnergyValues(void);
+    // An energy_value node, read whole with one pread() on an fd kept open
+    struct EnergySource {
+        explicit EnergySource(std::string_view file_path) : path(file_path) {}
+        std::string path;
+        ::android::base::unique_fd fd;
+        std::string buffer;
+        // Energy slot of each line seen in the node, the rails of a device
+        // come in the same order on every read
+        std::vector<size_t> line_slots;
+        // The buffered capture of the device, read instead of the node when it has a sample
+        std::unique_ptr<::android::hardware::google::pixel::powerstats::RailEnergySampler>
+                sampler;
+        std::vector<::android::hardware::google::pixel::powerstats::RailEnergySample>
+                sampled_energy;
+    };
+    // A registered power rail with the energy slots of its linked rails,
+    // one slot for a physical power rail
+    struct TrackedPowerRail {
+        std::string_view name;
+        const PowerRailInfo *info;
+        PowerStatus *status;
+        std::vector<size_t> energy_slots;
+    };
+    static constexpr size_t kNoEnergySlot = std::numeric_limits<size_t>::max();
+    // Read the whole node into source->buffer, return false on failure
+    bool readEnergySource(EnergySource *source);
+    // Start the buffered capture of the energy sources whose driver supports it
+    void startEnergySamplers(std::chrono::milliseconds period);
+    // Store the sample of the line_index-th rail of the source
+    void storeEnergySample(EnergySource *source, size_t line_index, std::string_view power_rail,
+                           const PowerSample &sample);
+    // Energy slot of the rail, kNoEnergySlot if it has never been read
+    size_t findEnergySlot(std::string_view power_rail) const;
+    size_t findOrAddEnergySlot(std::string_view power_rail);
     // Compute the average power for physical power rail.
-    float updateAveragePower(std::string_view power_rail, std::queue<PowerSample> *power_history);
+    float updateAveragePower(std::string_view power_rail, size_t energy_slot,
+                             std::queue<PowerSample> *power_history);
     // Update the power data for the target power rail.
-    float updatePowerRail(std::string_view power_rail);
-    // Find the energy source path, return false if no energy source found.
-    bool findEnergySourceToWatch(void);
-    // The map to record the energy counter for each power rail.
-    std::unordered_map<std::string, PowerSample> energy_info_map_;
+    float updatePowerRail(const TrackedPowerRail &power_rail, const boot_clock::time_point &now);
+    // The last energy counter of each power rail, indexed by energy slot.
+    std::vector<PowerSample> energy_samples_;
+    std::vector<std::string> energy_rail_names_;
+    std::unordered_map<std::string, size_t> energy_slot_map_;
     // The map to record the power data for each thermal sensor.
     std::unordered_map<std::string, PowerStatus> power_status_map_;
     mutable std::shared_mutex power_status_map_mutex_;
     // The map to record the power rail information from thermal config
     std::unordered_map<std::string, PowerRailInfo> power_rail_info_map_;
-    // The set to store the energy source paths
-    std::unordered_set<std::string> energy_path_set_;
+    std::vector<TrackedPowerRail> tracked_power_rails_;
+    // The energy sources to read, one per iio device
+    std::vector<EnergySource> energy_sources_;
     PowerStatusLog power_status_log_;
 };
 
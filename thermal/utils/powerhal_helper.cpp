@@ -18,6 +18,7 @@
 
 #include "powerhal_helper.h"
 
+#include <android-base/chrono_utils.h>
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
@@ -25,6 +26,7 @@
 #include <android-base/strings.h>
 #include <android/binder_manager.h>
 
+#include <algorithm>
 #include <iterator>
 #include <set>
 #include <sstream>
@@ -39,11 +41,36 @@ namespace hardware {
 namespace thermal {
 namespace implementation {
 
+using ::android::base::boot_clock;
 using ::android::base::StringPrintf;
 
+namespace {
+
+constexpr char kThermalChannelPathProperty[] = "vendor.thermal.power_channel_path";
+
+std::string getPowerHint(const std::string &type, const ThrottlingSeverity &t) {
+    return StringPrintf("THERMAL_%s_%s", type.c_str(), toString(t).c_str());
+}
+
+}  // namespace
+
 PowerHalService::PowerHalService()
     : power_hal_aidl_exist_(true), power_hal_aidl_(nullptr), power_hal_ext_aidl_(nullptr) {
+    thermal_channel_path_ = ::android::base::GetProperty(kThermalChannelPathProperty, "");
+    if (!thermal_channel_path_.empty() && !thermal_channel_.open(thermal_channel_path_)) {
+        PLOG(ERROR) << "Failed to open thermal channel " << thermal_channel_path_;
+    }
     connect();
+    sender_thread_ = std::thread(&PowerHalService::senderLoop, this);
+}
+
+PowerHalService::~PowerHalService() {
+    {
+        std::lock_guard<std::mutex> lock(mailbox_mutex_);
+        stop_sender_ = true;
+    }
+    mailbox_cv_.notify_one();
+    sender_thread_.join();
 }
 
 bool PowerHalService::connect() {
@@ -105,6 +132,14 @@ bool PowerHalService::connect() {
 }
 
 void PowerHalService::reconnect() {
+    {
+        std::lock_guard<std::mutex> lock(mailbox_mutex_);
+        reconnect_pending_ = true;
+    }
+    mailbox_cv_.notify_one();
+}
+
+void PowerHalService::resendPowerHints() {
     ATRACE_CALL();
     if (!connect()) {
         LOG(ERROR) << " Failed to reconnect power_hal_ext";
@@ -112,12 +147,12 @@ void PowerHalService::reconnect() {
     }
 
     LOG(INFO) << "Resend the power hints when power_hal_ext is reconnected";
-    std::lock_guard<std::shared_mutex> _lock(powerhint_status_mutex_);
+    std::shared_lock<std::shared_mutex> _lock(powerhint_status_mutex_);
     for (const auto &[sensor_name, supported_powerhint] : supported_powerhint_map_) {
         std::stringstream log_buf;
         for (const auto &severity : ::ndk::enum_range<ThrottlingSeverity>()) {
             bool mode = severity <= supported_powerhint.prev_hint_severity;
-            setMode(sensor_name, severity, mode);
+            queueMode(getPowerHint(sensor_name, severity), mode, true);
             log_buf << toString(severity).c_str() << ":" << mode << " ";
         }
 
@@ -172,6 +207,17 @@ void PowerHalService::sendPowerExtHint(const Temperature &t) {
         return;
     }
 
+    if (thermal_channel_.isOpen()) {
+        thermal_channel_.setSensorSeverity(t.name, static_cast<int32_t>(current_hint_severity));
+        if (thermal_channel_.consumerAttached()) {
+            LOG(INFO) << t.name << " publish powerhint severity: "
+                      << toString(current_hint_severity);
+            supported_powerhint_map_[t.name].prev_hint_severity = current_hint_severity;
+            channel_hint_count_++;
+            return;
+        }
+    }
+
     for (const auto &severity : ::ndk::enum_range<ThrottlingSeverity>()) {
         if (severity != supported_powerhint_map_[t.name].hint_severity_map[severity]) {
             continue;
@@ -186,12 +232,26 @@ void PowerHalService::sendPowerExtHint(const Temperature &t) {
     supported_powerhint_map_[t.name].prev_hint_severity = current_hint_severity;
 }
 
+void PowerHalService::clearPowerHints(const std::string &sensor_name) {
+    for (const auto &severity : ::ndk::enum_range<ThrottlingSeverity>()) {
+        setMode(sensor_name, severity, false);
+    }
+    std::lock_guard<std::shared_mutex> _lock(powerhint_status_mutex_);
+    thermal_channel_.setSensorSeverity(sensor_name,
+                                       static_cast<int32_t>(ThrottlingSeverity::NONE));
+}
+
+void PowerHalService::publishCdevState(const std::string &cdev_name, int state) {
+    std::lock_guard<std::shared_mutex> _lock(powerhint_status_mutex_);
+    thermal_channel_.setCdevState(cdev_name, state);
+}
+
 bool PowerHalService::isModeSupported(const std::string &type, const ThrottlingSeverity &t) {
     bool isSupported = false;
     if (!connect()) {
         return false;
     }
-    std::string power_hint = StringPrintf("THERMAL_%s_%s", type.c_str(), toString(t).c_str());
+    std::string power_hint = getPowerHint(type, t);
     lock_.lock();
     if (!power_hal_ext_aidl_->isModeSupported(power_hint, &isSupported).isOk()) {
         LOG(ERROR) << "Fail to check supported mode, Hint: " << power_hint;
@@ -205,24 +265,123 @@ bool PowerHalService::isModeSupported(const std::string &type, const ThrottlingS
 }
 
 void PowerHalService::setMode(const std::string &type, const ThrottlingSeverity &t,
-                              const bool &enable, const bool error_on_exit) {
-    if (!connect()) {
-        return;
+                              const bool &enable) {
+    queueMode(getPowerHint(type, t), enable, false);
+}
+
+void PowerHalService::queueMode(std::string power_hint, const bool enable, const bool force) {
+    {
+        std::lock_guard<std::mutex> lock(mailbox_mutex_);
+        if (force) {
+            sent_modes_.erase(power_hint);
+        }
+        auto pending = pending_modes_.find(power_hint);
+        if (pending != pending_modes_.end()) {
+            pending->second = enable;
+            coalesced_count_++;
+            return;
+        }
+        auto sent = sent_modes_.find(power_hint);
+        if (sent != sent_modes_.end() && sent->second == enable) {
+            dropped_duplicate_count_++;
+            return;
+        }
+        pending_modes_.emplace(power_hint, enable);
+        pending_order_.push_back(std::move(power_hint));
     }
+    mailbox_cv_.notify_one();
+}
 
-    std::string power_hint = StringPrintf("THERMAL_%s_%s", type.c_str(), toString(t).c_str());
-    lock_.lock();
-    if (!power_hal_ext_aidl_->setMode(power_hint, enable).isOk()) {
+bool PowerHalService::sendMode(const std::string &power_hint, const bool enable) {
+    ATRACE_CALL();
+    // Retry once with a fresh connection
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (!connect()) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(lock_);
+        if (power_hal_ext_aidl_ == nullptr) {
+            continue;
+        }
+        if (power_hal_ext_aidl_->setMode(power_hint, enable).isOk()) {
+            return true;
+        }
         LOG(ERROR) << "Fail to set mode, Hint: " << power_hint;
         power_hal_ext_aidl_ = nullptr;
         power_hal_aidl_ = nullptr;
-        lock_.unlock();
-        if (!error_on_exit) {
-            setMode(type, t, enable, true);
+    }
+    return false;
+}
+
+void PowerHalService::senderLoop() {
+    std::unique_lock<std::mutex> lock(mailbox_mutex_);
+    while (true) {
+        mailbox_cv_.wait(lock, [this] {
+            return stop_sender_ || reconnect_pending_ || !pending_order_.empty();
+        });
+        if (stop_sender_) {
+            return;
         }
-        return;
+        if (reconnect_pending_) {
+            reconnect_pending_ = false;
+            lock.unlock();
+            resendPowerHints();
+            lock.lock();
+            continue;
+        }
+
+        std::string power_hint = std::move(pending_order_.front());
+        pending_order_.pop_front();
+        const bool enable = pending_modes_.extract(power_hint).mapped();
+        auto sent = sent_modes_.find(power_hint);
+        if (sent != sent_modes_.end() && sent->second == enable) {
+            dropped_duplicate_count_++;
+            continue;
+        }
+        // Record the state before sending so a request racing with this one is compared
+        // against what the power HAL is about to have
+        sent_modes_[power_hint] = enable;
+
+        lock.unlock();
+        const auto start = boot_clock::now();
+        const bool ok = sendMode(power_hint, enable);
+        const auto latency =
+                std::chrono::duration_cast<std::chrono::microseconds>(boot_clock::now() - start);
+        lock.lock();
+
+        if (ok) {
+            sent_count_++;
+        } else {
+            sent = sent_modes_.find(power_hint);
+            if (sent != sent_modes_.end() && sent->second == enable) {
+                sent_modes_.erase(sent);
+            }
+            failed_count_++;
+        }
+        last_send_latency_ = latency;
+        max_send_latency_ = std::max(max_send_latency_, latency);
+    }
+}
+
+void PowerHalService::dump(std::ostringstream *dump_buf) {
+    {
+        std::lock_guard<std::mutex> lock(mailbox_mutex_);
+        *dump_buf << " Hints sent: " << sent_count_ << std::endl;
+        *dump_buf << " Hints failed: " << failed_count_ << std::endl;
+        *dump_buf << " Hints pending: " << pending_order_.size() << std::endl;
+        *dump_buf << " Duplicate hints dropped: " << dropped_duplicate_count_ << std::endl;
+        *dump_buf << " Hints coalesced: " << coalesced_count_ << std::endl;
+        *dump_buf << " Last send latency: " << last_send_latency_.count() << "us" << std::endl;
+        *dump_buf << " Max send latency: " << max_send_latency_.count() << "us" << std::endl;
+    }
+    // Taken after the mailbox lock is released, hints are queued under this one
+    std::shared_lock<std::shared_mutex> _lock(powerhint_status_mutex_);
+    if (thermal_channel_.isOpen()) {
+        *dump_buf << " Thermal channel: " << thermal_channel_path_
+                  << " generation: " << thermal_channel_.generation()
+                  << " consumer attached: " << thermal_channel_.consumerAttached() << std::endl;
+        *dump_buf << " Hints published on channel: " << channel_hint_count_ << std::endl;
     }
-    lock_.unlock();
 }
 
 }  // namespace implementation
@@ -20,11 +20,17 @@
 #include <aidl/android/hardware/thermal/IThermal.h>
 #include <aidl/android/hardware/thermal/ThrottlingSeverity.h>
 #include <aidl/google/hardware/power/extension/pixel/IPowerExt.h>
+#include <pixelthermalchannel/ThermalChannel.h>
 #include <utils/Trace.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <queue>
 #include <shared_mutex>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -38,6 +44,7 @@ namespace implementation {
 
 using ::aidl::android::hardware::power::IPower;
 using ::aidl::google::hardware::power::extension::pixel::IPowerExt;
+using ::android::hardware::google::pixel::ThermalChannelWriter;
 
 using CdevRequestStatus = std::unordered_map<std::string, int>;
 
@@ -49,20 +56,33 @@ struct PowerHintstatus {
 class PowerHalService {
   public:
     PowerHalService();
-    ~PowerHalService() = default;
+    ~PowerHalService();
     bool connect();
+    // Ask the sender thread to reconnect and resend the current power hints
     void reconnect();
     bool isAidlPowerHalExist() { return power_hal_aidl_exist_; }
     bool isModeSupported(const std::string &type, const ThrottlingSeverity &t);
     bool isPowerHalConnected() { return power_hal_aidl_ != nullptr; }
     bool isPowerHalExtConnected() { return power_hal_ext_aidl_ != nullptr; }
-    void setMode(const std::string &type, const ThrottlingSeverity &t, const bool &enable,
-                 const bool error_on_exit = false);
+    // Queue a mode change for the sender thread, never blocks on the power HAL
+    void setMode(const std::string &type, const ThrottlingSeverity &t, const bool &enable);
     void updateSupportedPowerHints(
             const std::unordered_map<std::string, SensorInfo> &sensor_info_map_);
     void sendPowerExtHint(const Temperature &t);
+    // Turn off every power hint of the sensor
+    void clearPowerHints(const std::string &sensor_name);
+    // Share the requested state of a cooling device with the power HAL
+    void publishCdevState(const std::string &cdev_name, int state);
+    void dump(std::ostringstream *dump_buf);
 
   private:
+    // Only the latest requested state of a hint is kept, a request matching what the power HAL
+    // already has is dropped unless it is forced by a reconnect
+    void queueMode(std::string power_hint, const bool enable, const bool force);
+    bool sendMode(const std::string &power_hint, const bool enable);
+    void resendPowerHints();
+    void senderLoop();
+
     ndk::ScopedAIBinder_DeathRecipient power_hal_ext_aidl_death_recipient_;
     static void onPowerHalExtAidlBinderDied(void *cookie) {
         if (cookie) {
@@ -72,6 +92,8 @@ class PowerHalService {
                 e->power_hal_aidl_ = nullptr;
                 e->power_hal_ext_aidl_ = nullptr;
             }
+            // Back to binder until the restarted power HAL attaches again
+            e->thermal_channel_.detachConsumer();
             e->reconnect();
         }
     }
@@ -82,6 +104,28 @@ class PowerHalService {
     std::mutex lock_;
     std::unordered_map<std::string, PowerHintstatus> supported_powerhint_map_;
     mutable std::shared_mutex powerhint_status_mutex_;
+    // Optional shared memory path to the power HAL, written under powerhint_status_mutex_.
+    // Once the power HAL attaches to it the sensor hints skip binder.
+    ThermalChannelWriter thermal_channel_;
+    std::string thermal_channel_path_;
+    uint64_t channel_hint_count_ = 0;
+
+    std::mutex mailbox_mutex_;
+    std::condition_variable mailbox_cv_;
+    // Pending hint to its latest requested state, sent in the order the hints were queued
+    std::unordered_map<std::string, bool> pending_modes_;
+    std::deque<std::string> pending_order_;
+    // Hint to the state the power HAL last accepted
+    std::unordered_map<std::string, bool> sent_modes_;
+    bool reconnect_pending_ = false;
+    bool stop_sender_ = false;
+    uint64_t sent_count_ = 0;
+    uint64_t failed_count_ = 0;
+    uint64_t dropped_duplicate_count_ = 0;
+    uint64_t coalesced_count_ = 0;
+    std::chrono::microseconds last_send_latency_{0};
+    std::chrono::microseconds max_send_latency_{0};
+    std::thread sender_thread_;
 };
 
 }  // namespace implementation
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "thermal_adaptive_polling.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace thermal {
+namespace implementation {
+
+std::chrono::milliseconds AdaptPollingDelay(const SensorInfo &sensor_info,
+                                            const ThrottlingSeverity severity, const float value,
+                                            const float prev_value,
+                                            const std::chrono::milliseconds time_elapsed_ms,
+                                            const std::chrono::milliseconds sleep_ms) {
+    if (std::isnan(value) || std::isnan(prev_value) || time_elapsed_ms.count() <= 0 ||
+        sleep_ms == std::chrono::milliseconds::max()) {
+        return sleep_ms;
+    }
+    float next_threshold = NAN;
+    for (size_t i = static_cast<size_t>(severity) + 1; i < kThrottlingSeverityCount; i++) {
+        if (!std::isnan(sensor_info.hot_thresholds[i])) {
+            next_threshold = sensor_info.hot_thresholds[i];
+            break;
+        }
+    }
+    if (std::isnan(next_threshold)) {
+        return sleep_ms;
+    }
+
+    const float rate_per_ms = (value - prev_value) / time_elapsed_ms.count();
+    const float time_to_threshold_ms =
+            (rate_per_ms > 0) ? (next_threshold - value) / rate_per_ms : INFINITY;
+    // Read at least twice before the threshold is reached
+    if (time_to_threshold_ms < 2 * sleep_ms.count()) {
+        const auto min_sleep_ms = std::max(sensor_info.passive_delay / kAdaptivePollingMaxSpeedup,
+                                           sensor_info.time_resolution);
+        return std::clamp(std::chrono::milliseconds(static_cast<int64_t>(time_to_threshold_ms / 2)),
+                          std::min(min_sleep_ms, sleep_ms), sleep_ms);
+    }
+    if (severity == ThrottlingSeverity::NONE && sleep_ms == sensor_info.polling_delay &&
+        time_to_threshold_ms >= 2 * kAdaptivePollingMaxSlowdown * sleep_ms.count()) {
+        return sleep_ms * kAdaptivePollingMaxSlowdown;
+    }
+    return sleep_ms;
+}
+
+}  // namespace implementation
+}  // namespace thermal
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+
+#include "thermal_info.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace thermal {
+namespace implementation {
+
+// Bounds of an AdaptivePolling sensor's period, relative to passive_delay and polling_delay
+constexpr int kAdaptivePollingMaxSpeedup = 4;
+constexpr int kAdaptivePollingMaxSlowdown = 2;
+
+// Period of an AdaptivePolling sensor, from how soon its reading crosses the next hot
+// threshold at the rate it changed since the previous update. sleep_ms is the delay for the
+// severity of the sensor, passive_delay while throttling and polling_delay otherwise.
+std::chrono::milliseconds AdaptPollingDelay(const SensorInfo &sensor_info,
+                                            const ThrottlingSeverity severity, const float value,
+                                            const float prev_value,
+                                            const std::chrono::milliseconds time_elapsed_ms,
+                                            const std::chrono::milliseconds sleep_ms);
+
+}  // namespace implementation
+}  // namespace thermal
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
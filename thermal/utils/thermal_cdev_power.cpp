@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "thermal_cdev_power.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace thermal {
+namespace implementation {
+
+namespace {
+
+// Scanning is as fast up to a few dozen states
+constexpr size_t kMinStatesToBisect = 24;
+
+bool isSorted(const float *powers, size_t size) {
+    for (size_t i = 0; i + 1 < size; ++i) {
+        if (std::isnan(powers[i]) || (i > 0 && powers[i] > powers[i - 1])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+bool parseState2PowerTable(std::string_view content, std::vector<float> *state2power) {
+    state2power->clear();
+    std::stringstream power{std::string(content)};
+    unsigned int power_number;
+    while (power >> power_number) {
+        state2power->push_back(static_cast<float>(power_number));
+    }
+    return !state2power->empty();
+}
+
+void CdevPowerTables::set(size_t cdev_id, const std::vector<float> &state2power) {
+    if (cdev_id >= tables_.size()) {
+        tables_.resize(cdev_id + 1, {.offset = powers_.size(), .size = 0, .sorted = true,
+                                     .set = false});
+    }
+    auto &table = tables_[cdev_id];
+    if (table.size != state2power.size()) {
+        // Repack the other tables and put this one at the end, tables are seldom replaced
+        std::vector<float> powers;
+        powers.reserve(powers_.size() - table.size + state2power.size());
+        for (auto &other : tables_) {
+            if (&other == &table) {
+                continue;
+            }
+            const auto begin = powers_.begin() + other.offset;
+            other.offset = powers.size();
+            powers.insert(powers.end(), begin, begin + other.size);
+        }
+        table.offset = powers.size();
+        table.size = state2power.size();
+        powers.resize(powers.size() + table.size);
+        powers_ = std::move(powers);
+    }
+    std::copy(state2power.begin(), state2power.end(), powers_.begin() + table.offset);
+    table.sorted = isSorted(state2power.data(), state2power.size());
+    table.set = true;
+}
+
+std::vector<float> CdevPowerTables::get(size_t cdev_id) const {
+    if (cdev_id >= tables_.size()) {
+        return {};
+    }
+    const auto begin = powers_.begin() + tables_[cdev_id].offset;
+    return std::vector<float>(begin, begin + tables_[cdev_id].size);
+}
+
+float CdevPowerTables::stateToPower(size_t cdev_id, int state) const {
+    if (state < 0 || static_cast<size_t>(state) >= numStates(cdev_id)) {
+        return NAN;
+    }
+    return powers_[tables_[cdev_id].offset + state];
+}
+
+int CdevPowerTables::powerToState(size_t cdev_id, float power_budget) const {
+    const size_t size = numStates(cdev_id);
+    if (size < 2) {
+        return 0;
+    }
+    const auto &table = tables_[cdev_id];
+    const float *begin = powers_.data() + table.offset;
+    // The deepest state is taken when no shallower one fits, it's never compared
+    const float *deepest = begin + size - 1;
+    if (table.sorted && size >= kMinStatesToBisect) {
+        return std::partition_point(begin, deepest,
+                                    [power_budget](float power) { return power_budget < power; }) -
+               begin;
+    }
+    return std::find_if(begin, deepest,
+                        [power_budget](float power) { return power_budget >= power; }) -
+           begin;
+}
+
+}  // namespace implementation
+}  // namespace thermal
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
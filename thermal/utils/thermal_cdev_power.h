@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace thermal {
+namespace implementation {
+
+// Parse the content of a cooling device's state2power_table node, one power per state,
+// false if it holds no number
+bool parseState2PowerTable(std::string_view content, std::vector<float> *state2power);
+
+// The state2power tables of the cooling devices, indexed by CdevInfo::id and packed in one
+// array. Each table is checked for being sorted when set, so that powerToState can bisect
+// the long ones.
+class CdevPowerTables {
+  public:
+    // Set or replace the table of a cooling device
+    void set(size_t cdev_id, const std::vector<float> &state2power);
+    bool has(size_t cdev_id) const { return cdev_id < tables_.size() && tables_[cdev_id].set; }
+    size_t numStates(size_t cdev_id) const {
+        return cdev_id < tables_.size() ? tables_[cdev_id].size : 0;
+    }
+    std::vector<float> get(size_t cdev_id) const;
+    // The power of a state, NAN if the table has no such state
+    float stateToPower(size_t cdev_id, int state) const;
+    // The shallowest state whose power fits in power_budget, the deepest state if none
+    // does, 0 if the table has less than 2 states
+    int powerToState(size_t cdev_id, float power_budget) const;
+
+  private:
+    struct Table {
+        size_t offset;
+        size_t size;
+        // The powers of all but the deepest state are numbers not growing with the state
+        bool sorted;
+        bool set;
+    };
+    std::vector<float> powers_;
+    std::vector<Table> tables_;
+};
+
+}  // namespace implementation
+}  // namespace thermal
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,826 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG (ATRACE_TAG_THERMAL | ATRACE_TAG_HAL)
+
+#include "thermal_config_cache.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/properties.h>
+#include <android-base/unique_fd.h>
+#include <fcntl.h>
+#include <json/value.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utils/Trace.h>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace thermal {
+namespace implementation {
+
+namespace {
+
+using ::thermal::vtestimator::LinearModelInitData;
+using ::thermal::vtestimator::MLModelInitData;
+using ::thermal::vtestimator::VtEstimationInitData;
+
+constexpr uint32_t kCompiledConfigMagic = 0x434d4854;  // "THMC"
+// Bump whenever a parsed struct or the layout below changes
+constexpr uint32_t kCompiledConfigVersion = 2;
+constexpr std::string_view kCompiledConfigSuffix(".bin");
+constexpr uint64_t kFnvOffsetBasis = 0xcbf29ce484222325ULL;
+constexpr uint64_t kFnvPrime = 0x100000001b3ULL;
+
+struct CompiledConfigHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t config_hash;
+    uint64_t payload_size;
+    uint64_t payload_hash;
+};
+
+// A file read by the JSON parse, whose content the parsed config depends on
+struct ConfigDependency {
+    std::string path;
+    uint64_t hash;
+};
+
+uint64_t hashBytes(std::string_view bytes, uint64_t hash = kFnvOffsetBasis) {
+    for (const char c : bytes) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= kFnvPrime;
+    }
+    return hash;
+}
+
+template <typename T>
+uint64_t hashValue(const T &value, uint64_t hash) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    return hashBytes(std::string_view(reinterpret_cast<const char *>(&value), sizeof(value)), hash);
+}
+
+// Covers everything besides the dependency files that changes what the parse produces
+uint64_t computeConfigHash(std::string_view json_doc) {
+    uint64_t hash = hashBytes(json_doc);
+    hash = hashValue(kCompiledConfigVersion, hash);
+    hash = hashValue(::android::base::GetBoolProperty(kPowerLinkDisabledProperty.data(), false),
+                     hash);
+    return hashValue(sizeof(size_t), hash);
+}
+
+uint64_t hashDependency(const std::string &path) {
+    std::string content;
+    if (!::android::base::ReadFileToString(path, &content)) {
+        return 0;
+    }
+    return hashBytes(content);
+}
+
+// The field lists below are shared by ConfigWriter and ConfigReader so that both sides walk the
+// structs in the same order. Runtime objects such as vt_estimator are rebuilt after loading.
+template <typename Archive, typename Info>
+void transferConfigDependency(Archive *ar, Info *info) {
+    ar->field(&info->path);
+    ar->field(&info->hash);
+}
+
+template <typename Archive, typename Info>
+void transferCdevInfo(Archive *ar, Info *info) {
+    ar->field(&info->type);
+    ar->field(&info->read_path);
+    ar->field(&info->write_path);
+    ar->field(&info->state2power);
+    ar->field(&info->max_state);
+    ar->field(&info->id);
+}
+
+template <typename Archive, typename Info>
+void transferBindedCdevInfo(Archive *ar, Info *info) {
+    ar->field(&info->limit_info);
+    ar->field(&info->power_thresholds);
+    ar->field(&info->release_logic);
+    ar->field(&info->cdev_weight_for_pid);
+    ar->field(&info->cdev_ceiling);
+    ar->field(&info->max_release_step);
+    ar->field(&info->max_throttle_step);
+    ar->field(&info->cdev_floor_with_power_link);
+    ar->field(&info->power_rail);
+    ar->field(&info->high_power_check);
+    ar->field(&info->throttling_with_power_link);
+    ar->field(&info->enabled);
+}
+
+template <typename Archive, typename Info>
+void transferThrottlingInfo(Archive *ar, Info *info) {
+    ar->field(&info->k_po);
+    ar->field(&info->k_pu);
+    ar->field(&info->k_i);
+    ar->field(&info->k_d);
+    ar->field(&info->i_max);
+    ar->field(&info->max_alloc_power);
+    ar->field(&info->min_alloc_power);
+    ar->field(&info->s_power);
+    ar->field(&info->i_cutoff);
+    ar->field(&info->i_default);
+    ar->field(&info->i_default_pct);
+    ar->field(&info->tran_cycle);
+    ar->field(&info->excluded_power_info_map);
+    ar->field(&info->binded_cdev_info_map);
+    ar->field(&info->profile_map);
+}
+
+template <typename Archive, typename Info>
+void transferMLModelInitData(Archive *ar, Info *info) {
+    ar->field(&info->model_path);
+    ar->field(&info->use_prev_samples);
+    ar->field(&info->prev_samples_order);
+    ar->field(&info->output_label_count);
+    ar->field(&info->num_hot_spots);
+    ar->field(&info->enable_input_validation);
+    ar->field(&info->offset_thresholds);
+    ar->field(&info->offset_values);
+    ar->field(&info->support_under_sampling);
+    ar->field(&info->num_threads);
+    ar->field(&info->delegate);
+}
+
+template <typename Archive, typename Info>
+void transferLinearModelInitData(Archive *ar, Info *info) {
+    ar->field(&info->use_prev_samples);
+    ar->field(&info->prev_samples_order);
+    ar->field(&info->coefficients);
+    ar->field(&info->offset_thresholds);
+    ar->field(&info->offset_values);
+}
+
+template <typename Archive, typename Info>
+void transferVtEstimationInitData(Archive *ar, Info *info) {
+    ar->field(&info->ml_model_init_data);
+    ar->field(&info->linear_model_init_data);
+}
+
+template <typename Archive, typename Info>
+void transferVirtualSensorInfo(Archive *ar, Info *info) {
+    ar->field(&info->linked_sensors);
+    ar->field(&info->linked_sensors_type);
+    ar->field(&info->coefficients);
+    ar->field(&info->coefficients_type);
+    ar->field(&info->offset);
+    ar->field(&info->trigger_sensors);
+    ar->field(&info->formula);
+    ar->field(&info->vt_estimator_model_file);
+    ar->field(&info->backup_sensor);
+    ar->field(&info->vt_estimator_init_data);
+}
+
+template <typename Archive, typename Info>
+void transferPredictorInfo(Archive *ar, Info *info) {
+    ar->field(&info->sensor);
+    ar->field(&info->support_pid_compensation);
+    ar->field(&info->prediction_weights);
+    ar->field(&info->k_p_compensate);
+}
+
+template <typename Archive, typename Info>
+void transferSensorInfo(Archive *ar, Info *info) {
+    ar->field(&info->type);
+    ar->field(&info->hot_thresholds);
+    ar->field(&info->cold_thresholds);
+    ar->field(&info->hot_hysteresis);
+    ar->field(&info->cold_hysteresis);
+    ar->field(&info->temp_path);
+    ar->field(&info->vr_threshold);
+    ar->field(&info->multiplier);
+    ar->field(&info->polling_delay);
+    ar->field(&info->passive_delay);
+    ar->field(&info->time_resolution);
+    ar->field(&info->adaptive_polling);
+    ar->field(&info->step_ratio);
+    ar->field(&info->send_cb);
+    ar->field(&info->send_powerhint);
+    ar->field(&info->is_watch);
+    ar->field(&info->is_hidden);
+    ar->field(&info->virtual_sensor_info);
+    ar->field(&info->throttling_info);
+    ar->field(&info->predictor_info);
+    ar->field(&info->id);
+}
+
+template <typename Archive, typename Info>
+void transferVirtualPowerRailInfo(Archive *ar, Info *info) {
+    ar->field(&info->linked_power_rails);
+    ar->field(&info->coefficients);
+    ar->field(&info->offset);
+    ar->field(&info->formula);
+}
+
+template <typename Archive, typename Info>
+void transferPowerRailInfo(Archive *ar, Info *info) {
+    ar->field(&info->power_sample_count);
+    ar->field(&info->power_sample_delay);
+    ar->field(&info->virtual_power_rail_info);
+}
+
+template <typename Archive, typename Info>
+void transferThresholdList(Archive *ar, Info *info) {
+    ar->field(&info->logging_name);
+    ar->field(&info->thresholds);
+}
+
+template <typename Archive, typename Info>
+void transferStatsInfo(Archive *ar, Info *info) {
+    ar->field(&info->record_by_default_threshold_all_or_name_set_);
+    ar->field(&info->record_by_threshold);
+}
+
+template <typename Archive, typename Info>
+void transferSensorsTempRangeInfo(Archive *ar, Info *info) {
+    ar->field(&info->sensors);
+    ar->field(&info->temp_range_info);
+}
+
+template <typename Archive, typename Info>
+void transferSensorsTempStuckInfo(Archive *ar, Info *info) {
+    ar->field(&info->sensors);
+    ar->field(&info->temp_stuck_info);
+}
+
+template <typename Archive, typename Info>
+void transferAbnormalStatsInfo(Archive *ar, Info *info) {
+    ar->field(&info->default_temp_range_info);
+    ar->field(&info->sensors_temp_range_infos);
+    ar->field(&info->default_temp_stuck_info);
+    ar->field(&info->sensors_temp_stuck_infos);
+}
+
+template <typename Archive, typename Info>
+void transferParsedThermalConfig(Archive *ar, Info *info) {
+    ar->field(&info->cooling_device_info_map);
+    ar->field(&info->sensor_info_map);
+    ar->field(&info->power_rail_info_map);
+    ar->field(&info->sensor_stats_info);
+    ar->field(&info->abnormal_stats_info);
+    ar->field(&info->cooling_device_request_info);
+}
+
+class ConfigWriter {
+  public:
+    template <typename T>
+    void field(const T *value) {
+        put(*value);
+    }
+
+    template <typename T>
+    std::enable_if_t<std::is_trivially_copyable_v<T>> put(const T &value) {
+        buffer_.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+    void put(const std::string &value) {
+        putSize(value.size());
+        buffer_.append(value);
+    }
+    template <typename T>
+    void put(const std::vector<T> &values) {
+        putSize(values.size());
+        for (const auto &value : values) {
+            put(value);
+        }
+    }
+    void put(const std::unordered_set<std::string> &values) {
+        putSize(values.size());
+        for (const auto &value : values) {
+            put(value);
+        }
+    }
+    template <typename V>
+    void put(const std::unordered_map<std::string, V> &values) {
+        putSize(values.size());
+        for (const auto &[key, value] : values) {
+            put(key);
+            put(value);
+        }
+    }
+    template <typename T>
+    void put(const std::optional<T> &value) {
+        put(value.has_value());
+        if (value.has_value()) {
+            put(*value);
+        }
+    }
+    template <typename T>
+    void put(const std::unique_ptr<T> &value) {
+        put(value != nullptr);
+        if (value != nullptr) {
+            put(*value);
+        }
+    }
+    template <typename T>
+    void put(const std::shared_ptr<T> &value) {
+        put(value != nullptr);
+        if (value != nullptr) {
+            put(*value);
+        }
+    }
+    void put(const std::variant<bool, std::unordered_set<std::string>> &value) {
+        put(static_cast<uint32_t>(value.index()));
+        std::visit([this](const auto &alternative) { put(alternative); }, value);
+    }
+    template <typename T>
+    void put(const ThresholdList<T> &info) {
+        transferThresholdList(this, &info);
+    }
+    template <typename T>
+    void put(const StatsInfo<T> &info) {
+        transferStatsInfo(this, &info);
+    }
+    void put(const ConfigDependency &info) { transferConfigDependency(this, &info); }
+    void put(const CdevInfo &info) { transferCdevInfo(this, &info); }
+    void put(const BindedCdevInfo &info) { transferBindedCdevInfo(this, &info); }
+    void put(const ThrottlingInfo &info) { transferThrottlingInfo(this, &info); }
+    void put(const MLModelInitData &info) { transferMLModelInitData(this, &info); }
+    void put(const LinearModelInitData &info) { transferLinearModelInitData(this, &info); }
+    void put(const VtEstimationInitData &info) { transferVtEstimationInitData(this, &info); }
+    void put(const VirtualSensorInfo &info) { transferVirtualSensorInfo(this, &info); }
+    void put(const PredictorInfo &info) { transferPredictorInfo(this, &info); }
+    void put(const SensorInfo &info) { transferSensorInfo(this, &info); }
+    void put(const VirtualPowerRailInfo &info) { transferVirtualPowerRailInfo(this, &info); }
+    void put(const PowerRailInfo &info) { transferPowerRailInfo(this, &info); }
+    void put(const AbnormalStatsInfo::SensorsTempRangeInfo &info) {
+        transferSensorsTempRangeInfo(this, &info);
+    }
+    void put(const AbnormalStatsInfo::SensorsTempStuckInfo &info) {
+        transferSensorsTempStuckInfo(this, &info);
+    }
+    void put(const AbnormalStatsInfo &info) { transferAbnormalStatsInfo(this, &info); }
+    void put(const ParsedThermalConfig &info) { transferParsedThermalConfig(this, &info); }
+
+    std::string release() { return std::move(buffer_); }
+
+  private:
+    void putSize(size_t size) { put(static_cast<uint64_t>(size)); }
+
+    std::string buffer_;
+};
+
+// Reads back what ConfigWriter wrote. Every read is bounds checked, and the first failure
+// sticks so callers only need to check ok() at the end.
+class ConfigReader {
+  public:
+    ConfigReader(const char *data, size_t size) : data_(data), size_(size), pos_(0), ok_(true) {}
+
+    bool ok() const { return ok_; }
+    bool done() const { return ok_ && pos_ == size_; }
+
+    template <typename T>
+    void field(T *value) {
+        get(value);
+    }
+
+    template <typename T>
+    std::enable_if_t<std::is_trivially_copyable_v<T>> get(T *value) {
+        if (!ok_ || size_ - pos_ < sizeof(T)) {
+            ok_ = false;
+            return;
+        }
+        std::memcpy(value, data_ + pos_, sizeof(T));
+        pos_ += sizeof(T);
+    }
+    void get(std::string *value) {
+        size_t size;
+        if (!getSize(&size)) {
+            return;
+        }
+        value->assign(data_ + pos_, size);
+        pos_ += size;
+    }
+    template <typename T>
+    void get(std::vector<T> *values) {
+        size_t size;
+        if (!getSize(&size)) {
+            return;
+        }
+        values->clear();
+        values->resize(size);
+        for (size_t i = 0; i < size && ok_; ++i) {
+            get(&(*values)[i]);
+        }
+    }
+    void get(std::unordered_set<std::string> *values) {
+        size_t size;
+        if (!getSize(&size)) {
+            return;
+        }
+        values->clear();
+        for (size_t i = 0; i < size && ok_; ++i) {
+            std::string value;
+            get(&value);
+            values->emplace(std::move(value));
+        }
+    }
+    template <typename V>
+    void get(std::unordered_map<std::string, V> *values) {
+        size_t size;
+        if (!getSize(&size)) {
+            return;
+        }
+        values->clear();
+        for (size_t i = 0; i < size && ok_; ++i) {
+            std::string key;
+            V value{};
+            get(&key);
+            get(&value);
+            values->emplace(std::move(key), std::move(value));
+        }
+    }
+    template <typename T>
+    void get(std::optional<T> *value) {
+        bool has_value = false;
+        get(&has_value);
+        value->reset();
+        if (ok_ && has_value) {
+            T parsed{};
+            get(&parsed);
+            *value = std::move(parsed);
+        }
+    }
+    template <typename T>
+    void get(std::unique_ptr<T> *value) {
+        bool has_value = false;
+        get(&has_value);
+        value->reset();
+        if (ok_ && has_value) {
+            *value = std::make_unique<T>();
+            get(value->get());
+        }
+    }
+    void get(std::unique_ptr<VtEstimationInitData> *value) {
+        bool has_value = false;
+        get(&has_value);
+        value->reset();
+        if (ok_ && has_value) {
+            *value = std::make_unique<VtEstimationInitData>(::thermal::vtestimator::kUseMLModel);
+            get(value->get());
+        }
+    }
+    template <typename T>
+    void get(std::shared_ptr<T> *value) {
+        bool has_value = false;
+        get(&has_value);
+        value->reset();
+        if (ok_ && has_value) {
+            *value = std::make_shared<T>();
+            get(value->get());
+        }
+    }
+    void get(std::variant<bool, std::unordered_set<std::string>> *value) {
+        uint32_t index = 0;
+        get(&index);
+        if (!ok_) {
+            return;
+        }
+        if (index == 0) {
+            bool all = false;
+            get(&all);
+            *value = all;
+        } else if (index == 1) {
+            std::unordered_set<std::string> names;
+            get(&names);
+            *value = std::move(names);
+        } else {
+            ok_ = false;
+        }
+    }
+    template <typename T>
+    void get(ThresholdList<T> *info) {
+        transferThresholdList(this, info);
+    }
+    template <typename T>
+    void get(StatsInfo<T> *info) {
+        transferStatsInfo(this, info);
+    }
+    void get(ConfigDependency *info) { transferConfigDependency(this, info); }
+    void get(CdevInfo *info) { transferCdevInfo(this, info); }
+    void get(BindedCdevInfo *info) { transferBindedCdevInfo(this, info); }
+    void get(ThrottlingInfo *info) { transferThrottlingInfo(this, info); }
+    void get(MLModelInitData *info) { transferMLModelInitData(this, info); }
+    void get(LinearModelInitData *info) { transferLinearModelInitData(this, info); }
+    void get(VtEstimationInitData *info) { transferVtEstimationInitData(this, info); }
+    void get(VirtualSensorInfo *info) { transferVirtualSensorInfo(this, info); }
+    void get(PredictorInfo *info) { transferPredictorInfo(this, info); }
+    void get(SensorInfo *info) { transferSensorInfo(this, info); }
+    void get(VirtualPowerRailInfo *info) { transferVirtualPowerRailInfo(this, info); }
+    void get(PowerRailInfo *info) { transferPowerRailInfo(this, info); }
+    void get(AbnormalStatsInfo::SensorsTempRangeInfo *info) {
+        transferSensorsTempRangeInfo(this, info);
+    }
+    void get(AbnormalStatsInfo::SensorsTempStuckInfo *info) {
+        transferSensorsTempStuckInfo(this, info);
+    }
+    void get(AbnormalStatsInfo *info) { transferAbnormalStatsInfo(this, info); }
+    void get(ParsedThermalConfig *info) { transferParsedThermalConfig(this, info); }
+
+  private:
+    // Every element takes at least one byte, so a count beyond the remaining bytes is corrupt
+    bool getSize(size_t *size) {
+        uint64_t value = 0;
+        get(&value);
+        if (!ok_ || value > size_ - pos_) {
+            ok_ = false;
+            return false;
+        }
+        *size = static_cast<size_t>(value);
+        return true;
+    }
+
+    const char *data_;
+    size_t size_;
+    size_t pos_;
+    bool ok_;
+};
+
+class MappedFile {
+  public:
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    explicit MappedFile(const std::string &path) : addr_(MAP_FAILED), size_(0) {
+        ::android::base::unique_fd fd(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+        if (fd == -1) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) || st.st_size <= 0) {
+            return;
+        }
+        addr_ = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr_ != MAP_FAILED) {
+            size_ = st.st_size;
+        }
+    }
+    ~MappedFile() {
+        if (addr_ != MAP_FAILED) {
+            munmap(addr_, size_);
+        }
+    }
+
+    const char *data() const {
+        return addr_ == MAP_FAILED ? nullptr : static_cast<const char *>(addr_);
+    }
+    size_t size() const { return size_; }
+
+  private:
+    void *addr_;
+    size_t size_;
+};
+
+// The estimators are not stored, so recreate them from the kept init data
+bool rebuildVtEstimators(std::unordered_map<std::string, SensorInfo> *sensor_info_map) {
+    for (auto &[name, sensor_info] : *sensor_info_map) {
+        auto &virtual_sensor_info = sensor_info.virtual_sensor_info;
+        if (virtual_sensor_info == nullptr ||
+            virtual_sensor_info->vt_estimator_init_data == nullptr) {
+            continue;
+        }
+        const auto type = (virtual_sensor_info->formula == FormulaOption::USE_ML_MODEL)
+                                  ? ::thermal::vtestimator::kUseMLModel
+                                  : ::thermal::vtestimator::kUseLinearModel;
+        virtual_sensor_info->vt_estimator =
+                std::make_unique<::thermal::vtestimator::VirtualTempEstimator>(
+                        name, type, virtual_sensor_info->linked_sensors.size());
+        ::thermal::vtestimator::VtEstimatorStatus ret =
+                virtual_sensor_info->vt_estimator->Initialize(
+                        *virtual_sensor_info->vt_estimator_init_data);
+        if (ret != ::thermal::vtestimator::kVtEstimatorOk) {
+            LOG(ERROR) << "Failed to initialize vt estimator for Sensor[" << name
+                       << "] with ret code : " << ret;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool readCompiledConfig(const std::string &compiled_path, uint64_t config_hash,
+                        ParsedThermalConfig *parsed_config) {
+    ATRACE_CALL();
+    MappedFile file(compiled_path);
+    if (file.data() == nullptr) {
+        LOG(INFO) << "No compiled thermal config at " << compiled_path;
+        return false;
+    }
+
+    CompiledConfigHeader header;
+    if (file.size() < sizeof(header)) {
+        LOG(ERROR) << "Compiled thermal config " << compiled_path << " is truncated";
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    const std::string_view payload(file.data() + sizeof(header), file.size() - sizeof(header));
+    if (header.magic != kCompiledConfigMagic || header.version != kCompiledConfigVersion ||
+        header.config_hash != config_hash) {
+        LOG(INFO) << "Compiled thermal config " << compiled_path << " is stale";
+        return false;
+    }
+    if (header.payload_size != payload.size() || header.payload_hash != hashBytes(payload)) {
+        LOG(ERROR) << "Compiled thermal config " << compiled_path << " is corrupted";
+        return false;
+    }
+
+    ConfigReader reader(payload.data(), payload.size());
+    std::vector<ConfigDependency> dependencies;
+    reader.get(&dependencies);
+    if (!reader.ok()) {
+        LOG(ERROR) << "Failed to read dependencies of compiled thermal config";
+        return false;
+    }
+    for (const auto &dependency : dependencies) {
+        if (hashDependency(dependency.path) != dependency.hash) {
+            LOG(INFO) << "Compiled thermal config is stale since " << dependency.path
+                      << " changed";
+            return false;
+        }
+    }
+
+    reader.get(parsed_config);
+    if (!reader.done()) {
+        LOG(ERROR) << "Failed to read compiled thermal config " << compiled_path;
+        return false;
+    }
+    return rebuildVtEstimators(&parsed_config->sensor_info_map);
+}
+
+bool parseThermalConfig(std::string_view json_doc, ParsedThermalConfig *parsed_config,
+                        std::vector<ConfigDependency> *dependencies) {
+    ATRACE_CALL();
+    Json::Value config;
+    if (!ParseThermalConfigDoc(json_doc, &config)) {
+        LOG(ERROR) << "Failed to read JSON config";
+        return false;
+    }
+
+    if (!ParseCoolingDevice(config, &parsed_config->cooling_device_info_map)) {
+        LOG(ERROR) << "Failed to parse cooling device info config";
+        return false;
+    }
+
+    if (!ParseSensorInfo(config, &parsed_config->sensor_info_map)) {
+        LOG(ERROR) << "Failed to parse sensor info config";
+        return false;
+    }
+
+    if (!ParsePowerRailInfo(config, &parsed_config->power_rail_info_map)) {
+        LOG(ERROR) << "Failed to parse power rail info config";
+        return false;
+    }
+
+    if (!ParseSensorStatsConfig(config, parsed_config->sensor_info_map,
+                                &parsed_config->sensor_stats_info,
+                                &parsed_config->abnormal_stats_info)) {
+        LOG(ERROR) << "Failed to parse sensor stats config";
+        return false;
+    }
+
+    if (!ParseCoolingDeviceStatsConfig(config, parsed_config->cooling_device_info_map,
+                                       &parsed_config->cooling_device_request_info)) {
+        LOG(ERROR) << "Failed to parse cooling device stats config";
+        return false;
+    }
+
+    // ParseSensorInfo reads the scaling frequencies of these cooling devices
+    const Json::Value &cdevs = config["CoolingDevices"];
+    for (Json::Value::ArrayIndex i = 0; i < cdevs.size(); ++i) {
+        if (cdevs[i]["ScalingAvailableFrequenciesPath"].empty()) {
+            continue;
+        }
+        std::string path = cdevs[i]["ScalingAvailableFrequenciesPath"].asString();
+        const uint64_t hash = hashDependency(path);
+        dependencies->push_back({std::move(path), hash});
+    }
+    return true;
+}
+
+bool writeCompiledConfig(const std::string &compiled_path, uint64_t config_hash,
+                         const std::vector<ConfigDependency> &dependencies,
+                         const ParsedThermalConfig &parsed_config) {
+    ATRACE_CALL();
+    ConfigWriter writer;
+    writer.put(dependencies);
+    writer.put(parsed_config);
+    const std::string payload = writer.release();
+
+    const CompiledConfigHeader header = {
+            .magic = kCompiledConfigMagic,
+            .version = kCompiledConfigVersion,
+            .config_hash = config_hash,
+            .payload_size = payload.size(),
+            .payload_hash = hashBytes(payload),
+    };
+    std::string content(reinterpret_cast<const char *>(&header), sizeof(header));
+    content.append(payload);
+
+    // Write aside and rename so a reader never maps a partial file
+    const std::string temp_path = compiled_path + ".tmp";
+    if (!::android::base::WriteStringToFile(content, temp_path)) {
+        PLOG(WARNING) << "Failed to write compiled thermal config to " << temp_path;
+        return false;
+    }
+    if (rename(temp_path.c_str(), compiled_path.c_str())) {
+        PLOG(WARNING) << "Failed to rename compiled thermal config to " << compiled_path;
+        unlink(temp_path.c_str());
+        return false;
+    }
+    LOG(INFO) << "Compiled thermal config to " << compiled_path << " (" << content.size()
+              << " bytes)";
+    return true;
+}
+
+}  // namespace
+
+bool LoadThermalConfig(std::string_view config_path, std::string_view cache_dir,
+                       ParsedThermalConfig *parsed_config) {
+    ATRACE_CALL();
+    std::string json_doc;
+    if (!::android::base::ReadFileToString(config_path.data(), &json_doc)) {
+        LOG(ERROR) << "Failed to read JSON config from " << config_path;
+        return false;
+    }
+
+    const uint64_t config_hash = computeConfigHash(json_doc);
+    // Shipped next to the config by thermal_config_verifier, which already validated it
+    const std::string prebuilt_path = std::string(config_path) + std::string(kCompiledConfigSuffix);
+    if (readCompiledConfig(prebuilt_path, config_hash, parsed_config)) {
+        LOG(INFO) << "Loaded prebuilt thermal config from " << prebuilt_path;
+        return true;
+    }
+    *parsed_config = ParsedThermalConfig();
+
+    std::string compiled_path;
+    if (!cache_dir.empty()) {
+        compiled_path = std::string(cache_dir) + "/" +
+                        ::android::base::Basename(config_path.data()) +
+                        std::string(kCompiledConfigSuffix);
+        if (readCompiledConfig(compiled_path, config_hash, parsed_config)) {
+            LOG(INFO) << "Loaded compiled thermal config from " << compiled_path;
+            return true;
+        }
+        *parsed_config = ParsedThermalConfig();
+    }
+
+    std::vector<ConfigDependency> dependencies;
+    if (!parseThermalConfig(json_doc, parsed_config, &dependencies)) {
+        return false;
+    }
+    if (!compiled_path.empty()) {
+        writeCompiledConfig(compiled_path, config_hash, dependencies, *parsed_config);
+    }
+    return true;
+}
+
+bool CompileThermalConfig(std::string_view config_path, std::string_view compiled_path) {
+    std::string json_doc;
+    if (!::android::base::ReadFileToString(config_path.data(), &json_doc)) {
+        LOG(ERROR) << "Failed to read JSON config from " << config_path;
+        return false;
+    }
+    ParsedThermalConfig parsed_config;
+    std::vector<ConfigDependency> dependencies;
+    if (!parseThermalConfig(json_doc, &parsed_config, &dependencies)) {
+        return false;
+    }
+    if (compiled_path.empty()) {
+        return true;
+    }
+    return writeCompiledConfig(std::string(compiled_path), computeConfigHash(json_doc),
+                               dependencies, parsed_config);
+}
+
+}  // namespace implementation
+}  // namespace thermal
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "thermal_info.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace thermal {
+namespace implementation {
+
+// Everything the HAL parses out of the thermal config JSON
+struct ParsedThermalConfig {
+    std::unordered_map<std::string, CdevInfo> cooling_device_info_map;
+    std::unordered_map<std::string, SensorInfo> sensor_info_map;
+    std::unordered_map<std::string, PowerRailInfo> power_rail_info_map;
+    StatsInfo<float> sensor_stats_info;
+    AbnormalStatsInfo abnormal_stats_info;
+    StatsInfo<int> cooling_device_request_info;
+};
+
+// Loads the parsed thermal config, preferring a compiled copy: the one next to config_path with
+// the .bin suffix, see CompileThermalConfig, then the one in cache_dir.
+// The compiled copy is keyed by the hash of the config file, the files the parse reads and the
+// properties it depends on. When it is missing or stale the JSON is parsed and, on success,
+// compiled into cache_dir for the next start. An empty cache_dir skips that copy.
+bool LoadThermalConfig(std::string_view config_path, std::string_view cache_dir,
+                       ParsedThermalConfig *parsed_config);
+
+// Parses and validates the config at config_path and writes its compiled copy to compiled_path.
+// An empty compiled_path only validates. Returns false if the config is invalid or the copy
+// couldn't be written.
+bool CompileThermalConfig(std::string_view config_path, std::string_view compiled_path);
+
+}  // namespace implementation
+}  // namespace thermal
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "thermal_emul_script.h"
+
+#include <android-base/logging.h>
+#include <android-base/parsedouble.h>
+#include <android-base/parseint.h>
+#include <android-base/strings.h>
+#include <pthread.h>
+
+#include <cmath>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace thermal {
+namespace implementation {
+
+bool ParseEmulScript(std::string_view content, std::vector<EmulScriptStep> *steps,
+                     std::string *error) {
+    std::vector<std::string> sensors;
+    size_t line_number = 0;
+
+    steps->clear();
+    for (const auto &raw_line : ::android::base::Split(std::string(content), "\n")) {
+        line_number++;
+        const std::string line = ::android::base::Trim(raw_line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        const std::vector<std::string> cells = ::android::base::Split(line, ",");
+        const std::string where = "line " + std::to_string(line_number) + ": ";
+
+        if (sensors.empty()) {
+            if (cells.size() < 2 || ::android::base::Trim(cells[0]) != "time_ms") {
+                *error = where + "header must be time_ms followed by the sensor names";
+                return false;
+            }
+            for (size_t i = 1; i < cells.size(); i++) {
+                const std::string sensor = ::android::base::Trim(cells[i]);
+                if (sensor.empty()) {
+                    *error = where + "empty sensor name";
+                    return false;
+                }
+                sensors.push_back(sensor);
+            }
+            continue;
+        }
+
+        if (cells.size() > sensors.size() + 1) {
+            *error = where + "more cells than sensors";
+            return false;
+        }
+        EmulScriptStep step;
+        int64_t time_ms;
+        if (!::android::base::ParseInt(::android::base::Trim(cells[0]), &time_ms, int64_t(0))) {
+            *error = where + "invalid time " + cells[0];
+            return false;
+        }
+        step.time = std::chrono::milliseconds(time_ms);
+        if (!steps->empty() && step.time < steps->back().time) {
+            *error = where + "time goes backwards";
+            return false;
+        }
+        for (size_t i = 1; i < cells.size(); i++) {
+            const std::string cell = ::android::base::Trim(cells[i]);
+            float temp;
+            if (cell.empty()) {
+                continue;
+            } else if (cell == "-") {
+                temp = NAN;
+            } else if (!::android::base::ParseFloat(cell, &temp) || std::isnan(temp)) {
+                *error = where + "invalid temperature " + cell + " for " + sensors[i - 1];
+                return false;
+            }
+            step.temps.emplace_back(sensors[i - 1], temp);
+        }
+        steps->push_back(std::move(step));
+    }
+
+    if (steps->empty()) {
+        *error = "no steps";
+        return false;
+    }
+    return true;
+}
+
+void EmulScriptReport::finish(bool stopped) {
+    stopped_.store(stopped, std::memory_order_relaxed);
+    finished_.store(true, std::memory_order_release);
+}
+
+void EmulScriptReport::dump(std::ostringstream *dump_buf) const {
+    const char *state = "playing";
+    if (isFinished()) {
+        state = stopped_.load(std::memory_order_relaxed) ? "stopped" : "done";
+    }
+    *dump_buf << " Script: " << name_ << " Speed: " << speed_ << " Steps: " << step_count_
+              << " State: " << state << std::endl;
+    *dump_buf << "  StepLateness: ";
+    step_lateness_.dump(dump_buf);
+    *dump_buf << std::endl << "  Tick: ";
+    tick_latency_.dump(dump_buf);
+    *dump_buf << std::endl << "  CallbackLatency: ";
+    callback_latency_.dump(dump_buf);
+    *dump_buf << std::endl
+              << "  SeverityChanges: " << severity_changes_.load(std::memory_order_relaxed)
+              << " CdevRequests: " << cdev_requests_.load(std::memory_order_relaxed)
+              << std::endl;
+}
+
+ThermalEmulScriptPlayer::~ThermalEmulScriptPlayer() {
+    stop();
+}
+
+void ThermalEmulScriptPlayer::start(std::vector<EmulScriptStep> steps, std::string name,
+                                    float speed) {
+    stop();
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = false;
+    report_ = std::make_shared<EmulScriptReport>(std::move(name), speed, steps.size());
+    thread_ = std::thread(&ThermalEmulScriptPlayer::play, this, std::move(steps), speed, report_);
+    pthread_setname_np(thread_.native_handle(), "ThermalEmulScript");
+}
+
+void ThermalEmulScriptPlayer::stop() {
+    std::thread thread;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        thread = std::move(thread_);
+    }
+    cv_.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+std::shared_ptr<EmulScriptReport> ThermalEmulScriptPlayer::activeReport() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (report_ == nullptr || report_->isFinished()) {
+        return nullptr;
+    }
+    return report_;
+}
+
+void ThermalEmulScriptPlayer::dump(std::ostringstream *dump_buf) const {
+    std::shared_ptr<EmulScriptReport> report;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        report = report_;
+    }
+    if (report == nullptr) {
+        return;
+    }
+    *dump_buf << "getEmulScript:" << std::endl;
+    report->dump(dump_buf);
+}
+
+void ThermalEmulScriptPlayer::play(std::vector<EmulScriptStep> steps, float speed,
+                                   std::shared_ptr<EmulScriptReport> report) {
+    const auto start = std::chrono::steady_clock::now();
+    bool stopped = false;
+
+    LOG(INFO) << "Emulation script started, " << steps.size() << " steps at " << speed << "x";
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (const auto &step : steps) {
+        const auto due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                         step.time / speed);
+        if (cv_.wait_until(lock, due, [this] { return stopping_; })) {
+            stopped = true;
+            break;
+        }
+        lock.unlock();
+        report->recordStep(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - due));
+        apply_(step.temps);
+        lock.lock();
+    }
+    lock.unlock();
+
+    clear_();
+    report->finish(stopped);
+    LOG(INFO) << "Emulation script " << (stopped ? "stopped" : "done");
+}
+
+}  // namespace implementation
+}  // namespace thermal
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
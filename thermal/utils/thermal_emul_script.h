@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "thermal_tick_stats.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace thermal {
+namespace implementation {
+
+// One row of an emulation script: the emulated temperature of some sensors from time on.
+// A NAN temperature ends the emulation of that sensor.
+struct EmulScriptStep {
+    std::chrono::milliseconds time;
+    std::vector<std::pair<std::string, float>> temps;
+};
+
+// Parse an emulation script, a CSV file with a header naming the sensors:
+//
+//   time_ms,VIRTUAL-SKIN,battery
+//   0,30,32
+//   1000,35,        <- an empty cell leaves the sensor as it is
+//   2000,-,33       <- "-" ends the emulation of the sensor
+//
+// Lines starting with '#' are comments, times must not go backwards.
+bool ParseEmulScript(std::string_view content, std::vector<EmulScriptStep> *steps,
+                     std::string *error);
+
+// What the HAL did while a script played
+class EmulScriptReport {
+  public:
+    EmulScriptReport(std::string name, float speed, size_t step_count)
+        : name_(std::move(name)), speed_(speed), step_count_(step_count) {}
+
+    // How late a step was applied against the accelerated schedule
+    void recordStep(std::chrono::microseconds lateness) { step_lateness_.record(lateness); }
+    void recordTick(std::chrono::microseconds total) { tick_latency_.record(total); }
+    // A severity change sent to the callback clients, and how long delivering one took
+    void recordSeverityChange() { severity_changes_.fetch_add(1, std::memory_order_relaxed); }
+    void recordCallbackLatency(std::chrono::microseconds latency) {
+        callback_latency_.record(latency);
+    }
+    // Cooling device requests the throttling wrote
+    void recordCdevRequests(size_t count) {
+        cdev_requests_.fetch_add(count, std::memory_order_relaxed);
+    }
+    void finish(bool stopped);
+    bool isFinished() const { return finished_.load(std::memory_order_acquire); }
+    void dump(std::ostringstream *dump_buf) const;
+
+  private:
+    const std::string name_;
+    const float speed_;
+    const size_t step_count_;
+    LatencyHistogram step_lateness_;
+    LatencyHistogram tick_latency_;
+    LatencyHistogram callback_latency_;
+    std::atomic<uint64_t> severity_changes_{0};
+    std::atomic<uint64_t> cdev_requests_{0};
+    std::atomic<bool> finished_{false};
+    std::atomic<bool> stopped_{false};
+};
+
+// Plays an emulation script back from its own thread, speed times faster than written. The
+// steps go through apply, which sets the emulated temperatures the sensor reads return, so
+// the watcher, the throttling and the callbacks run as they would on real readings. At the
+// end clear drops every emulated temperature.
+class ThermalEmulScriptPlayer {
+  public:
+    using ApplyFunc = std::function<void(const std::vector<std::pair<std::string, float>> &)>;
+    using ClearFunc = std::function<void()>;
+
+    ThermalEmulScriptPlayer(ApplyFunc apply, ClearFunc clear)
+        : apply_(std::move(apply)), clear_(std::move(clear)) {}
+    ~ThermalEmulScriptPlayer();
+    // Disallow copy and assign.
+    ThermalEmulScriptPlayer(const ThermalEmulScriptPlayer &) = delete;
+    void operator=(const ThermalEmulScriptPlayer &) = delete;
+
+    // Stop any script playing and start this one
+    void start(std::vector<EmulScriptStep> steps, std::string name, float speed);
+    void stop();
+    // The report of the script playing, nullptr if none is
+    std::shared_ptr<EmulScriptReport> activeReport() const;
+    // The report of the script playing or last played
+    void dump(std::ostringstream *dump_buf) const;
+
+  private:
+    void play(std::vector<EmulScriptStep> steps, float speed,
+              std::shared_ptr<EmulScriptReport> report);
+
+    const ApplyFunc apply_;
+    const ClearFunc clear_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+    std::shared_ptr<EmulScriptReport> report_;
+    std::thread thread_;
+};
+
+}  // namespace implementation
+}  // namespace thermal
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
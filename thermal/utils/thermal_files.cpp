@@ -18,13 +18,20 @@
 
 #include "thermal_files.h"
 
+#include <android-base/chrono_utils.h>
 #include <android-base/file.h>
 #include <android-base/logging.h>
-#include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <fcntl.h>
+#include <pixeltrace/PixelTrace.h>
+#include <unistd.h>
 #include <utils/Trace.h>
 
 #include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <string_view>
 
 namespace aidl {
@@ -33,34 +40,146 @@ namespace hardware {
 namespace thermal {
 namespace implementation {
 
-using ::android::base::StringPrintf;
+namespace {
+
+// Sysfs readings are a handful of digits, longer content is cut
+constexpr size_t kMaxReadingSize = 64;
+
+int openThermalFile(const std::string &path) {
+    return TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+}
+
+int openCdevFile(const std::string &path) {
+    return TEMP_FAILURE_RETRY(open(path.c_str(), O_WRONLY | O_CLOEXEC));
+}
+
+// Parse the integer readings of sysfs by hand, anything else such as a
+// decimal reading goes through strtof.
+bool parseReading(const char *reading, float *value) {
+    const char *p = reading;
+    while (isspace(static_cast<unsigned char>(*p))) {
+        p++;
+    }
+    const bool negative = (*p == '-');
+    if (negative) {
+        p++;
+    }
+    const char *digits = p;
+    int64_t parsed = 0;
+    // 18 digits can't overflow int64_t
+    while (isdigit(static_cast<unsigned char>(*p)) && p - digits < 18) {
+        parsed = parsed * 10 + (*p - '0');
+        p++;
+    }
+    if (p != digits && (*p == '\0' || isspace(static_cast<unsigned char>(*p)))) {
+        *value = static_cast<float>(negative ? -parsed : parsed);
+        return true;
+    }
+
+    char *end = nullptr;
+    const float fallback = strtof(reading, &end);
+    if (end == reading) {
+        return false;
+    }
+    *value = fallback;
+    return true;
+}
+
+}  // namespace
 
 std::string ThermalFiles::getThermalFilePath(std::string_view thermal_name) const {
     auto sensor_itr = thermal_name_to_path_map_.find(thermal_name.data());
     if (sensor_itr == thermal_name_to_path_map_.end()) {
         return "";
     }
-    return sensor_itr->second;
+    return sensor_itr->second.path;
 }
 
 bool ThermalFiles::addThermalFile(std::string_view thermal_name, std::string_view path) {
-    return thermal_name_to_path_map_.emplace(thermal_name, path).second;
+    auto [itr, inserted] = thermal_name_to_path_map_.try_emplace(std::string(thermal_name), path);
+    if (inserted && keep_fd_open_) {
+        // A file missing for now is opened again on the first read
+        itr->second.fd.reset(openThermalFile(itr->second.path));
+        if (!itr->second.fd.ok()) {
+            PLOG(WARNING) << "Failed to open " << thermal_name << " at " << path;
+        }
+    }
+    return inserted;
+}
+
+ssize_t ThermalFiles::readToBuffer(std::string_view thermal_name, char *buf, size_t size) const {
+    auto sensor_itr = thermal_name_to_path_map_.find(thermal_name.data());
+    if (sensor_itr == thermal_name_to_path_map_.end()) {
+        LOG(WARNING) << "Failed to find " << thermal_name << "'s path";
+        return -1;
+    }
+    const ThermalFile &file = sensor_itr->second;
+
+    ssize_t len = -1;
+    if (!keep_fd_open_) {
+        ::android::base::unique_fd fd(openThermalFile(file.path));
+        if (fd.ok()) {
+            len = TEMP_FAILURE_RETRY(read(fd, buf, size - 1));
+        }
+    } else {
+        std::lock_guard<std::mutex> _lock(file.fd_mutex);
+        if (file.fd.ok()) {
+            len = TEMP_FAILURE_RETRY(pread(file.fd, buf, size - 1, 0));
+        }
+        if (len < 0) {
+            // The driver behind the file may have been reloaded, retry once
+            // on a fresh fd
+            file.fd.reset(openThermalFile(file.path));
+            if (file.fd.ok()) {
+                len = TEMP_FAILURE_RETRY(pread(file.fd, buf, size - 1, 0));
+            }
+        }
+    }
+    if (len < 0) {
+        PLOG(WARNING) << "Failed to read sensor: " << thermal_name;
+        return -1;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+bool ThermalFiles::readThermalFile(std::string_view thermal_name, float *value) const {
+    char reading[kMaxReadingSize];
+
+    PIXEL_TRACE_NAME_F("ThermalFiles::readThermalFile - %s", thermal_name.data());
+    const ssize_t len = readToBuffer(thermal_name, reading, sizeof(reading));
+    if (len < 0) {
+        return false;
+    }
+    if (len <= 1 || !parseReading(reading, value)) {
+        LOG(ERROR) << thermal_name << "'s reading:" << reading << " is invalid";
+        return false;
+    }
+    return true;
 }
 
 bool ThermalFiles::readThermalFile(std::string_view thermal_name, std::string *data) const {
     std::string sensor_reading;
-    std::string file_path = getThermalFilePath(std::string_view(thermal_name));
     *data = "";
 
-    ATRACE_NAME(StringPrintf("ThermalFiles::readThermalFile - %s", thermal_name.data()).c_str());
-    if (file_path.empty()) {
-        PLOG(WARNING) << "Failed to find " << thermal_name << "'s path";
-        return false;
-    }
+    PIXEL_TRACE_NAME_F("ThermalFiles::readThermalFile - %s", thermal_name.data());
+    if (keep_fd_open_) {
+        char reading[kMaxReadingSize];
+        if (readToBuffer(thermal_name, reading, sizeof(reading)) < 0) {
+            return false;
+        }
+        sensor_reading = reading;
+    } else {
+        std::string file_path = getThermalFilePath(std::string_view(thermal_name));
+        if (file_path.empty()) {
+            PLOG(WARNING) << "Failed to find " << thermal_name << "'s path";
+            return false;
+        }
 
-    if (!::android::base::ReadFileToString(file_path, &sensor_reading)) {
-        PLOG(WARNING) << "Failed to read sensor: " << thermal_name;
-        return false;
+        if (!::android::base::ReadFileToString(file_path, &sensor_reading)) {
+            PLOG(WARNING) << "Failed to read sensor: " << thermal_name;
+            return false;
+        }
     }
 
     if (sensor_reading.size() <= 1) {
@@ -73,19 +192,85 @@ bool ThermalFiles::readThermalFile(std::string_view thermal_name, std::string *d
     return true;
 }
 
-bool ThermalFiles::writeCdevFile(std::string_view cdev_name, std::string_view data) {
-    std::string file_path =
-            getThermalFilePath(::android::base::StringPrintf("%s_%s", cdev_name.data(), "w"));
+bool ThermalFiles::addCdevFile(size_t cdev_id, std::string_view cdev_name,
+                               std::string_view path) {
+    std::lock_guard<std::mutex> _lock(cdev_files_mutex_);
+    if (cdev_files_.size() <= cdev_id) {
+        cdev_files_.resize(cdev_id + 1);
+    }
+    CdevFile &cdev_file = cdev_files_[cdev_id];
+    if (!cdev_file.name.empty()) {
+        return false;
+    }
+    cdev_file.name = cdev_name;
+    cdev_file.path = path;
+    cdev_file.last_state = kUnknownCdevState;
+    // A file missing for now is opened again on the first write
+    cdev_file.fd.reset(openCdevFile(cdev_file.path));
+    if (!cdev_file.fd.ok()) {
+        PLOG(WARNING) << "Failed to open " << cdev_name << " at " << path;
+    }
+    return true;
+}
+
+bool ThermalFiles::writeCdevState(CdevFile *cdev_file, int state) {
+    if (state == cdev_file->last_state) {
+        LOG(VERBOSE) << "Skip writing cdev " << cdev_file->name << " which holds " << state;
+        return true;
+    }
 
-    ATRACE_NAME(StringPrintf("ThermalFiles::writeCdevFile - %s", cdev_name.data()).c_str());
-    if (!::android::base::WriteStringToFile(data.data(), file_path)) {
-        PLOG(WARNING) << "Failed to write cdev: " << cdev_name << " to " << data.data();
+    char data[16];
+    const int len = snprintf(data, sizeof(data), "%d", state);
+    ssize_t written = -1;
+    if (cdev_file->fd.ok()) {
+        written = TEMP_FAILURE_RETRY(pwrite(cdev_file->fd, data, len, 0));
+    }
+    if (written != len) {
+        // The driver behind the file may have been reloaded, retry once on a fresh fd
+        cdev_file->fd.reset(openCdevFile(cdev_file->path));
+        if (cdev_file->fd.ok()) {
+            written = TEMP_FAILURE_RETRY(pwrite(cdev_file->fd, data, len, 0));
+        }
+    }
+    if (written != len) {
+        PLOG(WARNING) << "Failed to write cdev: " << cdev_file->name << " to " << data;
+        cdev_file->last_state = kUnknownCdevState;
         return false;
     }
 
+    cdev_file->last_state = state;
+    ATRACE_INT(cdev_file->name.c_str(), state);
+    LOG(INFO) << "Successfully update cdev " << cdev_file->name << " sysfs to " << state;
     return true;
 }
 
+bool ThermalFiles::writeCdevStates(const std::vector<CdevState> &cdev_states) {
+    bool ret = true;
+
+    ATRACE_NAME("ThermalFiles::writeCdevStates");
+    const auto start = ::android::base::boot_clock::now();
+    {
+        std::lock_guard<std::mutex> _lock(cdev_files_mutex_);
+        for (const auto &cdev_state : cdev_states) {
+            if (cdev_state.cdev_id >= cdev_files_.size() ||
+                cdev_files_[cdev_state.cdev_id].name.empty()) {
+                LOG(ERROR) << "Failed to find cdev " << cdev_state.cdev_id << "'s path";
+                ret = false;
+                continue;
+            }
+            if (!writeCdevState(&cdev_files_[cdev_state.cdev_id], cdev_state.state)) {
+                ret = false;
+            }
+        }
+    }
+    const int64_t latency_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                       ::android::base::boot_clock::now() - start)
+                                       .count();
+    ATRACE_INT64("ThermalFiles::writeCdevStates latency_us", latency_us);
+    LOG(VERBOSE) << "Wrote " << cdev_states.size() << " cdev states in " << latency_us << "us";
+    return ret;
+}
+
 }  // namespace implementation
 }  // namespace thermal
 }  // namespace hardware
@@ -16,8 +16,12 @@
 
 #pragma once
 
+#include <android-base/unique_fd.h>
+
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace aidl {
 namespace android {
@@ -27,7 +31,9 @@ namespace implementation {
 
 class ThermalFiles {
   public:
-    ThermalFiles() = default;
+    // With keep_fd_open, files are opened once by addThermalFile and read
+    // with pread(), a failed read reopens the file.
+    explicit ThermalFiles(bool keep_fd_open = false) : keep_fd_open_(keep_fd_open) {}
     ~ThermalFiles() = default;
     ThermalFiles(const ThermalFiles &) = delete;
     void operator=(const ThermalFiles &) = delete;
@@ -39,11 +45,48 @@ class ThermalFiles {
     // data to empty and return false. If the thermal_name is found and its content
     // is read, this function will fill in data accordingly then return true.
     bool readThermalFile(std::string_view thermal_name, std::string *data) const;
-    bool writeCdevFile(std::string_view thermal_name, std::string_view data);
+    // Same as above for a file holding a number, parsed without allocating.
+    bool readThermalFile(std::string_view thermal_name, float *value) const;
     size_t getNumThermalFiles() const { return thermal_name_to_path_map_.size(); }
 
+    // Cooling device state files are indexed by CdevInfo::id and kept open.
+    // Returns true if add was successful, false otherwise.
+    bool addCdevFile(size_t cdev_id, std::string_view cdev_name, std::string_view path);
+    struct CdevState {
+        size_t cdev_id;
+        int state;
+    };
+    // Write the states in order under one trace span, a cdev which already holds
+    // its state is skipped. Returns false if any write failed.
+    bool writeCdevStates(const std::vector<CdevState> &cdev_states);
+
   private:
-    std::unordered_map<std::string, std::string> thermal_name_to_path_map_;
+    struct ThermalFile {
+        explicit ThermalFile(std::string_view file_path) : path(file_path) {}
+        const std::string path;
+        // Guards fd, which a failed read replaces
+        mutable std::mutex fd_mutex;
+        mutable ::android::base::unique_fd fd;
+    };
+    // Read up to size - 1 bytes of the file into the NUL terminated buf,
+    // return the bytes read or -1 on failure.
+    ssize_t readToBuffer(std::string_view thermal_name, char *buf, size_t size) const;
+
+    struct CdevFile {
+        std::string name;
+        std::string path;
+        ::android::base::unique_fd fd;
+        // State of the last successful write, kUnknownCdevState before it
+        int last_state;
+    };
+    static constexpr int kUnknownCdevState = -1;
+    bool writeCdevState(CdevFile *cdev_file, int state);
+
+    const bool keep_fd_open_;
+    std::unordered_map<std::string, ThermalFile> thermal_name_to_path_map_;
+    std::mutex cdev_files_mutex_;
+    // Indexed by CdevInfo::id, a cdev which is not added has an empty name
+    std::vector<CdevFile> cdev_files_;
 };
 
 }  // namespace implementation
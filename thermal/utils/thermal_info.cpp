@@ -30,8 +30,6 @@ namespace hardware {
 namespace thermal {
 namespace implementation {
 
-constexpr std::string_view kPowerLinkDisabledProperty("vendor.disable.thermal.powerlink");
-
 namespace {
 
 template <typename T>
@@ -198,16 +196,55 @@ std::ostream &operator<<(std::ostream &stream, const SensorFusionType &sensor_fu
     }
 }
 
+bool ComputeVirtualSensorTemp(const VirtualSensorInfo &virtual_sensor_info,
+                              const std::vector<float> &sensor_readings,
+                              const std::vector<float> &coefficients, float *temp) {
+    float temp_val = 0.0;
+    for (size_t i = 0; i < sensor_readings.size(); i++) {
+        switch (virtual_sensor_info.formula) {
+            case FormulaOption::COUNT_THRESHOLD:
+                if ((coefficients[i] < 0 && sensor_readings[i] < -coefficients[i]) ||
+                    (coefficients[i] >= 0 && sensor_readings[i] >= coefficients[i]))
+                    temp_val += 1;
+                break;
+            case FormulaOption::WEIGHTED_AVG:
+                temp_val += sensor_readings[i] * coefficients[i];
+                break;
+            case FormulaOption::MAXIMUM:
+                if (i == 0)
+                    temp_val = std::numeric_limits<float>::lowest();
+                if (sensor_readings[i] * coefficients[i] > temp_val)
+                    temp_val = sensor_readings[i] * coefficients[i];
+                break;
+            case FormulaOption::MINIMUM:
+                if (i == 0)
+                    temp_val = std::numeric_limits<float>::max();
+                if (sensor_readings[i] * coefficients[i] < temp_val)
+                    temp_val = sensor_readings[i] * coefficients[i];
+                break;
+            default:
+                return false;
+        }
+    }
+    *temp = temp_val + virtual_sensor_info.offset;
+    return true;
+}
+
 bool ParseThermalConfig(std::string_view config_path, Json::Value *config) {
     std::string json_doc;
     if (!::android::base::ReadFileToString(config_path.data(), &json_doc)) {
         LOG(ERROR) << "Failed to read JSON config from " << config_path;
         return false;
     }
+    return ParseThermalConfigDoc(json_doc, config);
+}
+
+bool ParseThermalConfigDoc(std::string_view json_doc, Json::Value *config) {
     Json::CharReaderBuilder builder;
     std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
     std::string errorMessage;
-    if (!reader->parse(&*json_doc.begin(), &*json_doc.end(), config, &errorMessage)) {
+    if (!reader->parse(json_doc.data(), json_doc.data() + json_doc.size(), config,
+                       &errorMessage)) {
         LOG(ERROR) << "Failed to parse JSON config: " << errorMessage;
         return false;
     }
@@ -273,6 +310,7 @@ bool ParseVirtualSensorInfo(const std::string_view name, const Json::Value &sens
     std::vector<SensorFusionType> coefficients_type;
     FormulaOption formula = FormulaOption::COUNT_THRESHOLD;
     std::string vt_estimator_model_file;
+    std::unique_ptr<::thermal::vtestimator::VtEstimationInitData> vt_estimator_init_data;
     std::unique_ptr<::thermal::vtestimator::VirtualTempEstimator> vt_estimator;
     std::string backup_sensor;
 
@@ -470,6 +508,30 @@ bool ParseVirtualSensorInfo(const std::string_view name, const Json::Value &sens
             LOG(INFO) << "Sensor[" << name << "] supports under sampling estimation.";
         }
 
+        if (!sensor["NumThreads"].empty()) {
+            init_data.ml_model_init_data.num_threads = sensor["NumThreads"].asInt();
+            if (init_data.ml_model_init_data.num_threads <= 0) {
+                LOG(ERROR) << "Sensor[" << name << "] has invalid NumThreads "
+                           << init_data.ml_model_init_data.num_threads;
+                return false;
+            }
+            LOG(INFO) << "Sensor[" << name << "] runs its model on "
+                      << init_data.ml_model_init_data.num_threads << " threads";
+        }
+
+        if (!sensor["Delegate"].empty()) {
+            if (sensor["Delegate"].asString().compare("XNNPACK") == 0) {
+                init_data.ml_model_init_data.delegate = ::thermal::vtestimator::kDelegateXnnpack;
+            } else if (sensor["Delegate"].asString().compare("NNAPI") == 0) {
+                init_data.ml_model_init_data.delegate = ::thermal::vtestimator::kDelegateNnapi;
+            } else if (sensor["Delegate"].asString().compare("DEFAULT") != 0) {
+                LOG(ERROR) << "Sensor[" << name << "]'s Delegate is invalid";
+                return false;
+            }
+            LOG(INFO) << "Sensor[" << name << "] uses " << sensor["Delegate"].asString()
+                      << " delegate";
+        }
+
         ::thermal::vtestimator::VtEstimatorStatus ret = vt_estimator->Initialize(init_data);
         if (ret != ::thermal::vtestimator::kVtEstimatorOk) {
             LOG(ERROR) << "Failed to initialize vt estimator for Sensor[" << name
@@ -477,6 +539,8 @@ bool ParseVirtualSensorInfo(const std::string_view name, const Json::Value &sens
                        << " with ret code : " << ret;
             return false;
         }
+        vt_estimator_init_data =
+                std::make_unique<::thermal::vtestimator::VtEstimationInitData>(init_data);
 
         LOG(INFO) << "Successfully created vt_estimator for Sensor[" << name
                   << "] with input samples: " << linked_sensors.size();
@@ -529,6 +593,8 @@ bool ParseVirtualSensorInfo(const std::string_view name, const Json::Value &sens
                        << "] with ret code : " << ret;
             return false;
         }
+        vt_estimator_init_data =
+                std::make_unique<::thermal::vtestimator::VtEstimationInitData>(init_data);
 
         LOG(INFO) << "Successfully created vt_estimator for Sensor[" << name
                   << "] with input samples: " << linked_sensors.size();
@@ -537,7 +603,8 @@ bool ParseVirtualSensorInfo(const std::string_view name, const Json::Value &sens
     virtual_sensor_info->reset(
             new VirtualSensorInfo{linked_sensors, linked_sensors_type, coefficients,
                                   coefficients_type, offset, trigger_sensors, formula,
-                                  vt_estimator_model_file, std::move(vt_estimator), backup_sensor});
+                                  vt_estimator_model_file, std::move(vt_estimator), backup_sensor,
+                                  std::move(vt_estimator_init_data)});
     return true;
 }
 
@@ -1316,6 +1383,13 @@ bool ParseSensorInfo(const Json::Value &config,
         }
         LOG(INFO) << "Sensor[" << name << "]'s Time resolution: " << time_resolution.count();
 
+        bool adaptive_polling = false;
+        if (!sensors[i]["AdaptivePolling"].empty()) {
+            adaptive_polling = sensors[i]["AdaptivePolling"].asBool();
+        }
+        LOG(INFO) << "Sensor[" << name << "]'s AdaptivePolling: " << std::boolalpha
+                  << adaptive_polling;
+
         float step_ratio = NAN;
         if (!sensors[i]["StepRatio"].empty()) {
             step_ratio = sensors[i]["StepRatio"].asFloat();
@@ -1376,6 +1450,7 @@ bool ParseSensorInfo(const Json::Value &config,
                 .polling_delay = polling_delay,
                 .passive_delay = passive_delay,
                 .time_resolution = time_resolution,
+                .adaptive_polling = adaptive_polling,
                 .step_ratio = step_ratio,
                 .send_cb = send_cb,
                 .send_powerhint = send_powerhint,
@@ -1384,6 +1459,7 @@ bool ParseSensorInfo(const Json::Value &config,
                 .virtual_sensor_info = std::move(virtual_sensor_info),
                 .throttling_info = std::move(throttling_info),
                 .predictor_info = std::move(predictor_info),
+                .id = total_parsed,
         };
 
         ++total_parsed;
@@ -1457,6 +1533,7 @@ bool ParseCoolingDevice(const Json::Value &config,
                 .read_path = read_path,
                 .write_path = write_path,
                 .state2power = state2power,
+                .id = total_parsed,
         };
         ++total_parsed;
     }
@@ -49,6 +49,7 @@ constexpr int kMaxPowerLogPerLine = 6;
 // VendorSensorCoolingDeviceStats, VendorTempResidencyStats
 constexpr int kMaxStatsResidencyCount = 20;
 constexpr int kMaxStatsThresholdCount = kMaxStatsResidencyCount - 1;
+constexpr std::string_view kPowerLinkDisabledProperty("vendor.disable.thermal.powerlink");
 
 enum class FormulaOption : uint32_t {
     COUNT_THRESHOLD = 0,
@@ -143,6 +144,8 @@ struct VirtualSensorInfo {
     std::string vt_estimator_model_file;
     std::unique_ptr<::thermal::vtestimator::VirtualTempEstimator> vt_estimator;
     std::string backup_sensor;
+    // Kept so that vt_estimator can be rebuilt from a compiled config
+    std::unique_ptr<::thermal::vtestimator::VtEstimationInitData> vt_estimator_init_data;
 };
 
 struct PredictorInfo {
@@ -218,6 +221,9 @@ struct SensorInfo {
     std::chrono::milliseconds polling_delay;
     std::chrono::milliseconds passive_delay;
     std::chrono::milliseconds time_resolution;
+    // Poll faster than passive_delay while a hot threshold is about to be crossed, and slower
+    // than polling_delay while not throttling and not heading for one
+    bool adaptive_polling;
     // The StepRatio value which is used for smoothing transient w/ the equation:
     // Temp = CurrentTemp * StepRatio + LastTemp * (1 - StepRatio)
     float step_ratio;
@@ -228,6 +234,8 @@ struct SensorInfo {
     std::unique_ptr<VirtualSensorInfo> virtual_sensor_info;
     std::shared_ptr<ThrottlingInfo> throttling_info;
     std::unique_ptr<PredictorInfo> predictor_info;
+    // Dense index assigned in parse order, to key per sensor state by vector
+    size_t id;
 };
 
 struct CdevInfo {
@@ -236,6 +244,8 @@ struct CdevInfo {
     std::string write_path;
     std::vector<float> state2power;
     int max_state;
+    // Dense index assigned in parse order, to key per cooling device state by vector
+    size_t id;
 };
 
 struct PowerRailInfo {
@@ -245,6 +255,7 @@ struct PowerRailInfo {
 };
 
 bool ParseThermalConfig(std::string_view config_path, Json::Value *config);
+bool ParseThermalConfigDoc(std::string_view json_doc, Json::Value *config);
 bool ParseSensorInfo(const Json::Value &config,
                      std::unordered_map<std::string, SensorInfo> *sensors_parsed);
 bool ParseCoolingDevice(const Json::Value &config,
@@ -255,6 +266,10 @@ bool ParseSensorStatsConfig(const Json::Value &config,
                             const std::unordered_map<std::string, SensorInfo> &sensor_info_map_,
                             StatsInfo<float> *sensor_stats_info_parsed,
                             AbnormalStatsInfo *abnormal_stats_info_parsed);
+// Combine the linked sensor readings of a non-estimator virtual sensor by its formula
+bool ComputeVirtualSensorTemp(const VirtualSensorInfo &virtual_sensor_info,
+                              const std::vector<float> &sensor_readings,
+                              const std::vector<float> &coefficients, float *temp);
 bool ParseCoolingDeviceStatsConfig(
         const Json::Value &config,
         const std::unordered_map<std::string, CdevInfo> &cooling_device_info_map_,
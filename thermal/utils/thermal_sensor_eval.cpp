@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "thermal_sensor_eval.h"
+
+#include <android-base/logging.h>
+#include <pixeltrace/PixelTrace.h>
+
+#include <cmath>
+#include <cstdlib>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace thermal {
+namespace implementation {
+
+namespace {
+
+// A smoothed reading needs a cached one within two passive delays
+constexpr int kTranTimeoutParam = 2;
+
+size_t nodeAt(const std::vector<size_t> &nodes, size_t i) {
+    return i < nodes.size() ? nodes[i] : kNoSensorNode;
+}
+
+bool runVirtualTempEstimator(std::string_view sensor_name, size_t sensor_node,
+                             const VirtualSensorInfo &virtual_sensor_info, size_t backup_node,
+                             SensorInputReader *reader,
+                             std::map<std::string, float> *sensor_log_map, float *temp) {
+    PIXEL_TRACE_NAME_F("ThermalHelper::runVirtualTempEstimator - %s", sensor_name.data());
+    if (virtual_sensor_info.vt_estimator == nullptr) {
+        LOG(ERROR) << "vt_estimator not valid for " << sensor_name;
+        return false;
+    }
+
+    std::vector<float> model_inputs;
+    model_inputs.reserve(virtual_sensor_info.linked_sensors.size());
+    for (const auto &linked_sensor : virtual_sensor_info.linked_sensors) {
+        const auto value = sensor_log_map->find(linked_sensor);
+        if (value == sensor_log_map->end()) {
+            LOG(ERROR) << "failed to read sensor: " << linked_sensor;
+            return false;
+        }
+        model_inputs.push_back(value->second);
+    }
+
+    std::vector<float> model_outputs;
+    const ::thermal::vtestimator::VtEstimatorStatus ret =
+            virtual_sensor_info.vt_estimator->Estimate(model_inputs, &model_outputs);
+    if (ret == ::thermal::vtestimator::kVtEstimatorOk && !model_outputs.empty()) {
+        *temp = model_outputs[0];
+        reader->onEstimate(sensor_node);
+        return true;
+    }
+    if (ret == ::thermal::vtestimator::kVtEstimatorLowConfidence ||
+        ret == ::thermal::vtestimator::kVtEstimatorUnderSampling) {
+        std::string_view backup_sensor = virtual_sensor_info.backup_sensor;
+        if (backup_sensor.empty()) {
+            LOG(ERROR) << "Failed to run estimator (ret: " << ret << ") for " << sensor_name
+                       << " with no backup.";
+            return false;
+        }
+        LOG(INFO) << "VT Estimator returned (ret: " << ret << ") for " << sensor_name
+                  << ". Reading backup sensor [" << backup_sensor << "] data to use";
+        if (!ReadSensorInput(backup_sensor, backup_node, SensorFusionType::SENSOR, reader,
+                             sensor_log_map, temp)) {
+            LOG(ERROR) << "Failed to read " << sensor_name << "'s backup sensor "
+                       << backup_sensor;
+            return false;
+        }
+        return true;
+    }
+
+    LOG(ERROR) << "Failed to run estimator (ret: " << ret << ") for " << sensor_name;
+    return false;
+}
+
+}  // namespace
+
+bool ReadSensorInput(std::string_view sensor_data, size_t sensor_node, SensorFusionType type,
+                     SensorInputReader *reader, std::map<std::string, float> *sensor_log_map,
+                     float *value) {
+    switch (type) {
+        case SensorFusionType::SENSOR:
+            if (!reader->readSensor(sensor_data, sensor_node, value, sensor_log_map)) {
+                LOG(ERROR) << "Failed to get " << sensor_data << " data";
+                return false;
+            }
+            break;
+        case SensorFusionType::ODPM:
+            if (!reader->readPower(sensor_data, value)) {
+                LOG(ERROR) << "Unknown power rail " << sensor_data;
+                return false;
+            }
+            if (std::isnan(*value)) {
+                LOG(INFO) << "Power data " << sensor_data << " is under collecting";
+                return true;
+            }
+            (*sensor_log_map)[sensor_data.data()] = *value;
+            break;
+        case SensorFusionType::CONSTANT:
+            *value = std::atof(sensor_data.data());
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+bool EvaluateVirtualSensor(std::string_view sensor_name, size_t sensor_node,
+                           const VirtualSensorInfo &virtual_sensor_info,
+                           const std::vector<size_t> &linked_nodes,
+                           const std::vector<size_t> &coefficient_nodes, size_t backup_node,
+                           SensorInputReader *reader, std::map<std::string, float> *sensor_log_map,
+                           float *temp) {
+    const size_t linked_sensors_size = virtual_sensor_info.linked_sensors.size();
+    std::vector<float> sensor_readings(linked_sensors_size, NAN);
+
+    // Calculate temperature of each of the linked sensor
+    for (size_t i = 0; i < linked_sensors_size; i++) {
+        if (!ReadSensorInput(virtual_sensor_info.linked_sensors[i], nodeAt(linked_nodes, i),
+                             virtual_sensor_info.linked_sensors_type[i], reader, sensor_log_map,
+                             &sensor_readings[i])) {
+            LOG(ERROR) << "Failed to read " << sensor_name << "'s linked sensor "
+                       << virtual_sensor_info.linked_sensors[i];
+            return false;
+        }
+        if (std::isnan(sensor_readings[i])) {
+            LOG(INFO) << sensor_name << " data is under collecting";
+            *temp = NAN;
+            return true;
+        }
+    }
+
+    if ((virtual_sensor_info.formula == FormulaOption::USE_ML_MODEL) ||
+        (virtual_sensor_info.formula == FormulaOption::USE_LINEAR_MODEL)) {
+        if (!runVirtualTempEstimator(sensor_name, sensor_node, virtual_sensor_info, backup_node,
+                                     reader, sensor_log_map, temp)) {
+            LOG(ERROR) << "Failed running VirtualEstimator for " << sensor_name;
+            return false;
+        }
+        return true;
+    }
+
+    std::vector<float> coefficients(linked_sensors_size, NAN);
+    for (size_t i = 0; i < linked_sensors_size; i++) {
+        if (!ReadSensorInput(virtual_sensor_info.coefficients[i], nodeAt(coefficient_nodes, i),
+                             virtual_sensor_info.coefficients_type[i], reader, sensor_log_map,
+                             &coefficients[i])) {
+            LOG(ERROR) << "Failed to read " << sensor_name << "'s coefficient "
+                       << virtual_sensor_info.coefficients[i];
+            return false;
+        }
+        if (std::isnan(coefficients[i])) {
+            LOG(INFO) << sensor_name << " data is under collecting";
+            *temp = NAN;
+            return true;
+        }
+    }
+    if (!ComputeVirtualSensorTemp(virtual_sensor_info, sensor_readings, coefficients, temp)) {
+        LOG(ERROR) << "Unknown formula type for sensor " << sensor_name;
+        return false;
+    }
+    return true;
+}
+
+float SmoothSensorTemp(const SensorInfo &sensor_info, float temp, float cached_temp,
+                       std::chrono::milliseconds since_last_update) {
+    if (std::isnan(sensor_info.step_ratio) || std::isnan(cached_temp) ||
+        since_last_update >= sensor_info.passive_delay * kTranTimeoutParam) {
+        return temp;
+    }
+    return sensor_info.step_ratio * temp + (1 - sensor_info.step_ratio) * cached_temp;
+}
+
+}  // namespace implementation
+}  // namespace thermal
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "thermal_info.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace thermal {
+namespace implementation {
+
+// Node of a sensor its reader has no node for
+constexpr size_t kNoSensorNode = std::numeric_limits<size_t>::max();
+
+// Source of the readings a virtual sensor is computed from: the thermal HAL reads sysfs and
+// ODPM, the replay tool reads a recorded trace. A sensor is given by name and by the node the
+// reader resolved it to, kNoSensorNode if the reader doesn't resolve sensors to nodes.
+class SensorInputReader {
+  public:
+    virtual ~SensorInputReader() = default;
+    // Read the temperature of a linked or backup sensor, NAN while it is being collected
+    virtual bool readSensor(std::string_view sensor_name, size_t sensor_node, float *temp,
+                            std::map<std::string, float> *sensor_log_map) = 0;
+    // Read the average power of a power rail, NAN while it is being collected. Return false
+    // if there is no such rail.
+    virtual bool readPower(std::string_view power_rail, float *power) = 0;
+    // The estimator of the virtual sensor at sensor_node produced new outputs
+    virtual void onEstimate(size_t /*sensor_node*/) {}
+};
+
+// Read one linked sensor, coefficient or backup sensor of a virtual sensor
+bool ReadSensorInput(std::string_view sensor_data, size_t sensor_node, SensorFusionType type,
+                     SensorInputReader *reader, std::map<std::string, float> *sensor_log_map,
+                     float *value);
+
+// Compute the temperature of a virtual sensor from its linked sensors, by its formula or its
+// estimator. linked_nodes and coefficient_nodes are empty or give the node of each linked
+// sensor and coefficient. *temp is NAN while one of the inputs is being collected.
+bool EvaluateVirtualSensor(std::string_view sensor_name, size_t sensor_node,
+                           const VirtualSensorInfo &virtual_sensor_info,
+                           const std::vector<size_t> &linked_nodes,
+                           const std::vector<size_t> &coefficient_nodes, size_t backup_node,
+                           SensorInputReader *reader, std::map<std::string, float> *sensor_log_map,
+                           float *temp);
+
+// Blend a new reading into the cached one by the step ratio of the sensor, if the cached one
+// is recent enough
+float SmoothSensorTemp(const SensorInfo &sensor_info, float temp, float cached_temp,
+                       std::chrono::milliseconds since_last_update);
+
+}  // namespace implementation
+}  // namespace thermal
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
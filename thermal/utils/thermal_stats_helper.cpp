@@ -82,26 +82,105 @@ void resetCurrentTempStatus(CurrTempStatus *curr_temp_status, float new_temp) {
     curr_temp_status->repeat_count = 1;
 }
 
+void loadSensorTempExtremes(const SensorStatsSlot &slot, SensorTempStats *sensor_temp_stats) {
+    sensor_temp_stats->max_temp = slot.max_temp.load(std::memory_order_relaxed);
+    sensor_temp_stats->max_temp_timestamp = SystemTimePoint(
+            SystemTimePoint::duration(slot.max_temp_timestamp.load(std::memory_order_relaxed)));
+    sensor_temp_stats->min_temp = slot.min_temp.load(std::memory_order_relaxed);
+    sensor_temp_stats->min_temp_timestamp = SystemTimePoint(
+            SystemTimePoint::duration(slot.min_temp_timestamp.load(std::memory_order_relaxed)));
+}
+
 }  // namespace
 
+AtomicStatsRecord::AtomicStatsRecord(size_t time_in_state_size)
+    : last_stats_report_time(boot_clock::now()),
+      state_and_start_ms_(static_cast<uint64_t>(nowMs()) << kStateBits),
+      time_in_state_ms_(time_in_state_size) {}
+
+int64_t AtomicStatsRecord::nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   boot_clock::now().time_since_epoch())
+            .count();
+}
+
+void AtomicStatsRecord::update(int new_state) {
+    new_state = std::clamp(new_state, 0, static_cast<int>(time_in_state_ms_.size()) - 1);
+    uint64_t cur = state_and_start_ms_.load(std::memory_order_relaxed);
+    if (static_cast<int>(cur & kStateMask) == new_state) {
+        return;
+    }
+    const int64_t now_ms = nowMs();
+    const uint64_t next = (static_cast<uint64_t>(now_ms) << kStateBits) | new_state;
+    do {
+        if (static_cast<int>(cur & kStateMask) == new_state) {
+            return;
+        }
+    } while (!state_and_start_ms_.compare_exchange_weak(cur, next, std::memory_order_relaxed));
+    const int cur_state = cur & kStateMask;
+    const int64_t cur_state_start_ms = cur >> kStateBits;
+    time_in_state_ms_[cur_state].fetch_add(now_ms - cur_state_start_ms,
+                                           std::memory_order_relaxed);
+}
+
+StatsRecord AtomicStatsRecord::snapshot(bool reset) {
+    const int64_t now_ms = nowMs();
+    uint64_t cur = state_and_start_ms_.load(std::memory_order_relaxed);
+    if (reset) {
+        // Close the current entry and start a new one in the same state
+        while (!state_and_start_ms_.compare_exchange_weak(
+                cur, (static_cast<uint64_t>(now_ms) << kStateBits) | (cur & kStateMask),
+                std::memory_order_relaxed)) {
+        }
+    }
+    const int cur_state = cur & kStateMask;
+    const int64_t cur_state_start_ms = cur >> kStateBits;
+    const int64_t cur_state_duration_ms = std::max<int64_t>(now_ms - cur_state_start_ms, 0);
+
+    StatsRecord stats_record(time_in_state_ms_.size(), cur_state);
+    stats_record.last_stats_report_time = last_stats_report_time;
+    stats_record.report_fail_count = report_fail_count;
+    for (size_t i = 0; i < time_in_state_ms_.size(); i++) {
+        const int64_t time_in_state_ms =
+                reset ? time_in_state_ms_[i].exchange(0, std::memory_order_relaxed)
+                      : time_in_state_ms_[i].load(std::memory_order_relaxed);
+        stats_record.time_in_state_ms[i] = std::chrono::milliseconds(time_in_state_ms);
+    }
+    stats_record.time_in_state_ms[cur_state] += std::chrono::milliseconds(cur_state_duration_ms);
+    return stats_record;
+}
+
+void AtomicStatsRecord::restore(const StatsRecord &stats_record) {
+    for (size_t i = 0; i < time_in_state_ms_.size(); i++) {
+        time_in_state_ms_[i].fetch_add(stats_record.time_in_state_ms[i].count(),
+                                       std::memory_order_relaxed);
+    }
+}
+
+template <typename ValueType>
+ThermalStats<ValueType> AtomicThermalStats<ValueType>::snapshot(bool reset) {
+    ThermalStats<ValueType> thermal_stats;
+    for (const auto &stats_by_threshold : stats_by_custom_threshold) {
+        StatsByThreshold<ValueType> &stats_by_threshold_snapshot =
+                thermal_stats.stats_by_custom_threshold.emplace_back();
+        stats_by_threshold_snapshot.thresholds = stats_by_threshold->thresholds;
+        stats_by_threshold_snapshot.logging_name = stats_by_threshold->logging_name;
+        stats_by_threshold_snapshot.stats_record = stats_by_threshold->stats_record.snapshot(reset);
+    }
+    if (stats_by_default_threshold) {
+        thermal_stats.stats_by_default_threshold = stats_by_default_threshold->snapshot(reset);
+    }
+    return thermal_stats;
+}
+
 bool ThermalStatsHelper::initializeStats(
-        const Json::Value &config,
+        const StatsInfo<float> &sensor_stats_info, const AbnormalStatsInfo &abnormal_stats_info,
+        const StatsInfo<int> &cooling_device_request_info,
         const std::unordered_map<std::string, SensorInfo> &sensor_info_map_,
         const std::unordered_map<std::string, CdevInfo> &cooling_device_info_map_,
         ThermalHelper *const thermal_helper_handle) {
-    StatsInfo<float> sensor_stats_info;
-    AbnormalStatsInfo abnormal_stats_info;
-    if (!ParseSensorStatsConfig(config, sensor_info_map_, &sensor_stats_info,
-                                &abnormal_stats_info)) {
-        LOG(ERROR) << "Failed to parse sensor stats config";
-        return false;
-    }
-    StatsInfo<int> cooling_device_request_info;
-    if (!ParseCoolingDeviceStatsConfig(config, cooling_device_info_map_,
-                                       &cooling_device_request_info)) {
-        LOG(ERROR) << "Failed to parse cooling device stats config";
-        return false;
-    }
+    sensor_stats_slots_.clear();
+    sensor_stats_slots_.resize(sensor_info_map_.size());
     if (!initializeSensorTempStats(sensor_stats_info, sensor_info_map_)) {
         LOG(ERROR) << "Failed to initialize sensor temp stats";
         return false;
@@ -123,17 +202,38 @@ bool ThermalStatsHelper::initializeStats(
     return true;
 }
 
+SensorStatsSlot *ThermalStatsHelper::getSensorStatsSlot(size_t sensor_id) const {
+    return sensor_id < sensor_stats_slots_.size() ? sensor_stats_slots_[sensor_id].get()
+                                                  : nullptr;
+}
+
+SensorStatsSlot *ThermalStatsHelper::getOrCreateSensorStatsSlot(const std::string &sensor,
+                                                                size_t sensor_id) {
+    auto &slot = sensor_stats_slots_.at(sensor_id);
+    if (slot == nullptr) {
+        slot = std::make_unique<SensorStatsSlot>();
+        slot->name = sensor;
+    }
+    return slot.get();
+}
+
 bool ThermalStatsHelper::initializeSensorCdevRequestStats(
         const StatsInfo<int> &request_stats_info,
         const std::unordered_map<std::string, SensorInfo> &sensor_info_map_,
         const std::unordered_map<std::string, CdevInfo> &cooling_device_info_map_) {
-    std::unique_lock<std::shared_mutex> _lock(sensor_cdev_request_stats_map_mutex_);
     for (const auto &[sensor, sensor_info] : sensor_info_map_) {
+        if (sensor_info.throttling_info == nullptr) {
+            continue;
+        }
         for (const auto &binded_cdev_info_pair :
              sensor_info.throttling_info->binded_cdev_info_map) {
             const auto &cdev = binded_cdev_info_pair.first;
-            const auto &max_state =
-                    cooling_device_info_map_.at(binded_cdev_info_pair.first).max_state;
+            const auto &cdev_info = cooling_device_info_map_.at(binded_cdev_info_pair.first);
+            const auto &max_state = cdev_info.max_state;
+            auto request_stats_slot = std::make_unique<CdevRequestStatsSlot>();
+            request_stats_slot->cdev_id = cdev_info.id;
+            request_stats_slot->cdev_name = cdev;
+            auto &request_stats = request_stats_slot->request_stats;
             // Record by all state
             if (isRecordByDefaultThreshold(
                         request_stats_info.record_by_default_threshold_all_or_name_set_, cdev)) {
@@ -148,13 +248,14 @@ bool ThermalStatsHelper::initializeSensorCdevRequestStats(
                     std::iota(thresholds.begin(), thresholds.end(), starting_state);
                     const auto logging_name = cdev + kCompressedThresholdSuffix.data();
                     ThresholdList<int> threshold_list(logging_name, thresholds);
-                    sensor_cdev_request_stats_map_[sensor][cdev]
-                            .stats_by_custom_threshold.emplace_back(threshold_list);
+                    request_stats.stats_by_custom_threshold.push_back(
+                            std::make_unique<AtomicStatsByThreshold<int>>(threshold_list));
                 } else {
                     // buckets = [0, 1, 2, 3, ...max_state]
                     const auto default_threshold_time_in_state_size = max_state + 1;
-                    sensor_cdev_request_stats_map_[sensor][cdev].stats_by_default_threshold =
-                            StatsRecord(default_threshold_time_in_state_size);
+                    request_stats.stats_by_default_threshold =
+                            std::make_unique<AtomicStatsRecord>(
+                                    default_threshold_time_in_state_size);
                 }
                 LOG(INFO) << "Sensor Cdev user vote stats on basis of all state initialized for ["
                           << sensor << "-" << cdev << "]";
@@ -169,16 +270,22 @@ bool ThermalStatsHelper::initializeSensorCdevRequestStats(
                         LOG(ERROR) << "For sensor " << sensor << " bindedCdev: " << cdev
                                    << "Invalid bindedCdev stats threshold: "
                                    << threshold_list.thresholds.back() << " >= " << max_state;
-                        sensor_cdev_request_stats_map_.clear();
+                        sensor_stats_slots_.clear();
                         return false;
                     }
-                    sensor_cdev_request_stats_map_[sensor][cdev]
-                            .stats_by_custom_threshold.emplace_back(threshold_list);
+                    request_stats.stats_by_custom_threshold.push_back(
+                            std::make_unique<AtomicStatsByThreshold<int>>(threshold_list));
                     LOG(INFO)
                             << "Sensor Cdev user vote stats on basis of threshold initialized for ["
                             << sensor << "-" << cdev << "]";
                 }
             }
+
+            if (request_stats.stats_by_default_threshold != nullptr ||
+                !request_stats.stats_by_custom_threshold.empty()) {
+                getOrCreateSensorStatsSlot(sensor, sensor_info.id)
+                        ->cdev_request_stats.push_back(std::move(request_stats_slot));
+            }
         }
     }
     return true;
@@ -187,17 +294,16 @@ bool ThermalStatsHelper::initializeSensorCdevRequestStats(
 bool ThermalStatsHelper::initializeSensorTempStats(
         const StatsInfo<float> &sensor_stats_info,
         const std::unordered_map<std::string, SensorInfo> &sensor_info_map_) {
-    std::unique_lock<std::shared_mutex> _lock(sensor_stats_mutex_);
-    auto &temp_stats_map_ = sensor_stats.temp_stats_map_;
     const int severity_time_in_state_size = kThrottlingSeverityCount;
     for (const auto &[sensor, sensor_info] : sensor_info_map_) {
+        auto temp_stats = std::make_unique<AtomicThermalStats<float>>();
         // Record by severity
         if (sensor_info.is_watch &&
             isRecordByDefaultThreshold(
                     sensor_stats_info.record_by_default_threshold_all_or_name_set_, sensor)) {
             // number of buckets = number of severity
-            temp_stats_map_[sensor].stats_by_default_threshold =
-                    StatsRecord(severity_time_in_state_size);
+            temp_stats->stats_by_default_threshold =
+                    std::make_unique<AtomicStatsRecord>(severity_time_in_state_size);
             LOG(INFO) << "Sensor temp stats on basis of severity initialized for [" << sensor
                       << "]";
         }
@@ -205,11 +311,17 @@ bool ThermalStatsHelper::initializeSensorTempStats(
         // Record by custom threshold
         if (sensor_stats_info.record_by_threshold.count(sensor)) {
             for (const auto &threshold_list : sensor_stats_info.record_by_threshold.at(sensor)) {
-                temp_stats_map_[sensor].stats_by_custom_threshold.emplace_back(threshold_list);
+                temp_stats->stats_by_custom_threshold.push_back(
+                        std::make_unique<AtomicStatsByThreshold<float>>(threshold_list));
                 LOG(INFO) << "Sensor temp stats on basis of threshold initialized for [" << sensor
                           << "]";
             }
         }
+
+        if (temp_stats->stats_by_default_threshold != nullptr ||
+            !temp_stats->stats_by_custom_threshold.empty()) {
+            getOrCreateSensorStatsSlot(sensor, sensor_info.id)->temp_stats = std::move(temp_stats);
+        }
     }
     return true;
 }
@@ -217,8 +329,7 @@ bool ThermalStatsHelper::initializeSensorTempStats(
 bool ThermalStatsHelper::initializeSensorAbnormalityStats(
         const AbnormalStatsInfo &abnormal_stats_info,
         const std::unordered_map<std::string, SensorInfo> &sensor_info_map_) {
-    std::unique_lock<std::shared_mutex> _lock(sensor_stats_mutex_);
-    auto &temp_range_info_map_ = sensor_stats.temp_range_info_map_;
+    std::unordered_map<std::string, std::shared_ptr<TempRangeInfo>> temp_range_info_map_;
     for (const auto &sensors_temp_range_info : abnormal_stats_info.sensors_temp_range_infos) {
         const auto &temp_range_info_ptr =
                 std::make_shared<TempRangeInfo>(sensors_temp_range_info.temp_range_info);
@@ -226,7 +337,7 @@ bool ThermalStatsHelper::initializeSensorAbnormalityStats(
             temp_range_info_map_[sensor] = temp_range_info_ptr;
         }
     }
-    auto &temp_stuck_info_map_ = sensor_stats.temp_stuck_info_map_;
+    std::unordered_map<std::string, std::shared_ptr<TempStuckInfo>> temp_stuck_info_map_;
     for (const auto &sensors_temp_stuck_info : abnormal_stats_info.sensors_temp_stuck_infos) {
         const auto &temp_stuck_info_ptr =
                 std::make_shared<TempStuckInfo>(sensors_temp_stuck_info.temp_stuck_info);
@@ -244,16 +355,22 @@ bool ThermalStatsHelper::initializeSensorAbnormalityStats(
                     ? std::make_shared<TempStuckInfo>(
                               abnormal_stats_info.default_temp_stuck_info.value())
                     : nullptr;
-    for (const auto &sensor_info : sensor_info_map_) {
-        const auto &sensor = sensor_info.first;
-        if (default_temp_range_info_ptr && !temp_range_info_map_.count(sensor))
-            temp_range_info_map_[sensor] = default_temp_range_info_ptr;
-        if (default_temp_stuck_info_ptr && !temp_stuck_info_map_.count(sensor))
-            temp_stuck_info_map_[sensor] = default_temp_stuck_info_ptr;
-    }
-
-    for (const auto &sensor_temp_stuck_info : temp_stuck_info_map_) {
-        sensor_stats.curr_temp_status_map_[sensor_temp_stuck_info.first] = {
+    for (const auto &[sensor, sensor_info] : sensor_info_map_) {
+        const auto temp_range_info_it = temp_range_info_map_.find(sensor);
+        const auto &temp_range_info = temp_range_info_it != temp_range_info_map_.end()
+                                              ? temp_range_info_it->second
+                                              : default_temp_range_info_ptr;
+        const auto temp_stuck_info_it = temp_stuck_info_map_.find(sensor);
+        const auto &temp_stuck_info = temp_stuck_info_it != temp_stuck_info_map_.end()
+                                              ? temp_stuck_info_it->second
+                                              : default_temp_stuck_info_ptr;
+        if (temp_range_info == nullptr && temp_stuck_info == nullptr) {
+            continue;
+        }
+        auto *slot = getOrCreateSensorStatsSlot(sensor, sensor_info.id);
+        slot->temp_range_info = temp_range_info;
+        slot->temp_stuck_info = temp_stuck_info;
+        slot->curr_temp_status = {
                 .temp = std::numeric_limits<float>::min(),
                 .start_time = boot_clock::time_point::min(),
                 .repeat_count = 0,
@@ -262,94 +379,75 @@ bool ThermalStatsHelper::initializeSensorAbnormalityStats(
     return true;
 }
 
-void ThermalStatsHelper::updateStatsRecord(StatsRecord *stats_record, int new_state) {
-    const auto now = boot_clock::now();
-    const auto cur_state_duration = std::chrono::duration_cast<std::chrono::milliseconds>(
-            now - stats_record->cur_state_start_time);
-    LOG(VERBOSE) << "Adding duration " << cur_state_duration.count()
-                 << " for cur_state: " << stats_record->cur_state << " with value: "
-                 << stats_record->time_in_state_ms[stats_record->cur_state].count();
-    // Update last record end time
-    stats_record->time_in_state_ms[stats_record->cur_state] += cur_state_duration;
-    stats_record->cur_state_start_time = now;
-    stats_record->cur_state = new_state;
-}
-
-void ThermalStatsHelper::updateSensorCdevRequestStats(std::string_view sensor,
-                                                      std::string_view cdev, int new_value) {
-    std::unique_lock<std::shared_mutex> _lock(sensor_cdev_request_stats_map_mutex_);
-    if (!sensor_cdev_request_stats_map_.count(sensor.data()) ||
-        !sensor_cdev_request_stats_map_[sensor.data()].count(cdev.data())) {
+void ThermalStatsHelper::updateSensorCdevRequestStats(size_t sensor_id, size_t cdev_id,
+                                                      int new_value) {
+    const auto *slot = getSensorStatsSlot(sensor_id);
+    if (slot == nullptr) {
         return;
     }
-    auto &request_stats = sensor_cdev_request_stats_map_[sensor.data()][cdev.data()];
-    for (auto &stats_by_threshold : request_stats.stats_by_custom_threshold) {
-        int value = calculateThresholdBucket(stats_by_threshold.thresholds, new_value);
-        if (value != stats_by_threshold.stats_record.cur_state) {
-            LOG(VERBOSE) << "Updating bindedCdev stats for sensor: " << sensor.data()
-                         << " , cooling_device: " << cdev.data() << " with new value: " << value;
-            updateStatsRecord(&stats_by_threshold.stats_record, value);
+    for (const auto &request_stats_slot : slot->cdev_request_stats) {
+        if (request_stats_slot->cdev_id != cdev_id) {
+            continue;
         }
-    }
-
-    if (request_stats.stats_by_default_threshold.has_value()) {
-        auto &stats_record = request_stats.stats_by_default_threshold.value();
-        if (new_value != stats_record.cur_state) {
-            LOG(VERBOSE) << "Updating bindedCdev stats for sensor: " << sensor.data()
-                         << " , cooling_device: " << cdev.data()
-                         << " with new value: " << new_value;
-            updateStatsRecord(&stats_record, new_value);
+        auto &request_stats = request_stats_slot->request_stats;
+        for (auto &stats_by_threshold : request_stats.stats_by_custom_threshold) {
+            stats_by_threshold->stats_record.update(
+                    calculateThresholdBucket(stats_by_threshold->thresholds, new_value));
+        }
+        if (request_stats.stats_by_default_threshold != nullptr) {
+            request_stats.stats_by_default_threshold->update(new_value);
         }
+        return;
     }
 }
 
-void ThermalStatsHelper::updateSensorTempStatsByThreshold(std::string_view sensor,
-                                                          float temperature) {
-    std::unique_lock<std::shared_mutex> _lock(sensor_stats_mutex_);
-    verifySensorAbnormality(sensor, temperature);
-    auto &temp_stats_map_ = sensor_stats.temp_stats_map_;
-    if (!temp_stats_map_.count(sensor.data())) {
+void ThermalStatsHelper::updateSensorTempStatsByThreshold(size_t sensor_id, float temperature) {
+    auto *slot = getSensorStatsSlot(sensor_id);
+    if (slot == nullptr) {
         return;
     }
-    auto &sensor_temp_stats = temp_stats_map_[sensor.data()];
-    for (auto &stats_by_threshold : sensor_temp_stats.stats_by_custom_threshold) {
-        int value = calculateThresholdBucket(stats_by_threshold.thresholds, temperature);
-        if (value != stats_by_threshold.stats_record.cur_state) {
-            LOG(VERBOSE) << "Updating sensor stats for sensor: " << sensor.data()
-                         << " with value: " << value;
-            updateStatsRecord(&stats_by_threshold.stats_record, value);
-        }
+    verifySensorAbnormality(slot, temperature);
+    if (slot->temp_stats == nullptr) {
+        return;
     }
-    if (temperature > sensor_temp_stats.max_temp) {
-        sensor_temp_stats.max_temp = temperature;
-        sensor_temp_stats.max_temp_timestamp = system_clock::now();
+    for (auto &stats_by_threshold : slot->temp_stats->stats_by_custom_threshold) {
+        stats_by_threshold->stats_record.update(
+                calculateThresholdBucket(stats_by_threshold->thresholds, temperature));
+    }
+    float max_temp = slot->max_temp.load(std::memory_order_relaxed);
+    while (temperature > max_temp) {
+        if (slot->max_temp.compare_exchange_weak(max_temp, temperature,
+                                                 std::memory_order_relaxed)) {
+            slot->max_temp_timestamp.store(system_clock::now().time_since_epoch().count(),
+                                           std::memory_order_relaxed);
+            break;
+        }
     }
-    if (temperature < sensor_temp_stats.min_temp) {
-        sensor_temp_stats.min_temp = temperature;
-        sensor_temp_stats.min_temp_timestamp = system_clock::now();
+    float min_temp = slot->min_temp.load(std::memory_order_relaxed);
+    while (temperature < min_temp) {
+        if (slot->min_temp.compare_exchange_weak(min_temp, temperature,
+                                                 std::memory_order_relaxed)) {
+            slot->min_temp_timestamp.store(system_clock::now().time_since_epoch().count(),
+                                           std::memory_order_relaxed);
+            break;
+        }
     }
 }
 
-void ThermalStatsHelper::updateSensorTempStatsBySeverity(std::string_view sensor,
+void ThermalStatsHelper::updateSensorTempStatsBySeverity(size_t sensor_id,
                                                          const ThrottlingSeverity &severity) {
-    std::unique_lock<std::shared_mutex> _lock(sensor_stats_mutex_);
-    auto &temp_stats_map_ = sensor_stats.temp_stats_map_;
-    if (temp_stats_map_.count(sensor.data()) &&
-        temp_stats_map_[sensor.data()].stats_by_default_threshold.has_value()) {
-        auto &stats_record = temp_stats_map_[sensor.data()].stats_by_default_threshold.value();
-        int value = static_cast<int>(severity);
-        if (value != stats_record.cur_state) {
-            LOG(VERBOSE) << "Updating sensor stats for sensor: " << sensor.data()
-                         << " with value: " << value;
-            updateStatsRecord(&stats_record, value);
-        }
+    const auto *slot = getSensorStatsSlot(sensor_id);
+    if (slot != nullptr && slot->temp_stats != nullptr &&
+        slot->temp_stats->stats_by_default_threshold != nullptr) {
+        slot->temp_stats->stats_by_default_threshold->update(static_cast<int>(severity));
     }
 }
 
-void ThermalStatsHelper::verifySensorAbnormality(std::string_view sensor, float temp) {
+void ThermalStatsHelper::verifySensorAbnormality(SensorStatsSlot *slot, float temp) {
+    std::string_view sensor = slot->name;
     LOG(VERBOSE) << "Verify sensor abnormality for " << sensor << " with temp " << temp;
-    if (sensor_stats.temp_range_info_map_.count(sensor.data())) {
-        const auto &temp_range_info = sensor_stats.temp_range_info_map_[sensor.data()];
+    if (slot->temp_range_info != nullptr) {
+        const auto &temp_range_info = slot->temp_range_info;
         if (temp < temp_range_info->min_temp_threshold) {
             LOG(ERROR) << "Outlier Temperature Detected, sensor: " << sensor.data()
                        << " temp: " << temp << " < " << temp_range_info->min_temp_threshold;
@@ -362,9 +460,11 @@ void ThermalStatsHelper::verifySensorAbnormality(std::string_view sensor, float
                                      std::round(temp));
         }
     }
-    if (sensor_stats.temp_stuck_info_map_.count(sensor.data())) {
-        const auto &temp_stuck_info = sensor_stats.temp_stuck_info_map_[sensor.data()];
-        auto &curr_temp_status = sensor_stats.curr_temp_status_map_[sensor.data()];
+    if (slot->temp_stuck_info != nullptr) {
+        const auto &temp_stuck_info = slot->temp_stuck_info;
+        // Only contended when the sensor is read from a binder thread and the watcher at once
+        std::lock_guard<std::mutex> _lock(slot->curr_temp_status_mutex);
+        auto &curr_temp_status = slot->curr_temp_status;
         LOG(VERBOSE) << "Current Temp Status: temp=" << curr_temp_status.temp
                      << " repeat_count=" << curr_temp_status.repeat_count
                      << " start_time=" << curr_temp_status.start_time.time_since_epoch().count();
@@ -418,27 +518,34 @@ int ThermalStatsHelper::reportStats() {
 
 int ThermalStatsHelper::reportAllSensorTempStats(const std::shared_ptr<IStats> &stats_client) {
     int count_failed_reporting = 0;
-    std::unique_lock<std::shared_mutex> _lock(sensor_stats_mutex_);
-    for (auto &[sensor, temp_stats] : sensor_stats.temp_stats_map_) {
+    std::lock_guard<std::mutex> _lock(report_mutex_);
+    for (const auto &slot : sensor_stats_slots_) {
+        if (slot == nullptr || slot->temp_stats == nullptr) {
+            continue;
+        }
+        const auto &sensor = slot->name;
+        auto &temp_stats = *slot->temp_stats;
+        SensorTempStats sensor_temp_stats;
+        loadSensorTempExtremes(*slot, &sensor_temp_stats);
         for (size_t threshold_set_idx = 0;
              threshold_set_idx < temp_stats.stats_by_custom_threshold.size(); threshold_set_idx++) {
-            auto &stats_by_threshold = temp_stats.stats_by_custom_threshold[threshold_set_idx];
+            auto &stats_by_threshold = *temp_stats.stats_by_custom_threshold[threshold_set_idx];
             std::string sensor_name = stats_by_threshold.logging_name.value_or(
                     sensor + kCustomThresholdSetSuffix.data() + std::to_string(threshold_set_idx));
-            if (!reportSensorTempStats(stats_client, sensor_name, temp_stats,
+            if (!reportSensorTempStats(stats_client, sensor_name, sensor_temp_stats,
                                        &stats_by_threshold.stats_record)) {
                 count_failed_reporting++;
             }
         }
-        if (temp_stats.stats_by_default_threshold.has_value()) {
-            if (!reportSensorTempStats(stats_client, sensor, temp_stats,
-                                       &temp_stats.stats_by_default_threshold.value())) {
+        if (temp_stats.stats_by_default_threshold != nullptr) {
+            if (!reportSensorTempStats(stats_client, sensor, sensor_temp_stats,
+                                       temp_stats.stats_by_default_threshold.get())) {
                 count_failed_reporting++;
             }
         }
         // Reset temp stats after reporting
-        temp_stats.max_temp = std::numeric_limits<float>::min();
-        temp_stats.min_temp = std::numeric_limits<float>::max();
+        slot->max_temp.store(std::numeric_limits<float>::min(), std::memory_order_relaxed);
+        slot->min_temp.store(std::numeric_limits<float>::max(), std::memory_order_relaxed);
     }
     return count_failed_reporting;
 }
@@ -446,15 +553,14 @@ int ThermalStatsHelper::reportAllSensorTempStats(const std::shared_ptr<IStats> &
 bool ThermalStatsHelper::reportSensorTempStats(const std::shared_ptr<IStats> &stats_client,
                                                std::string_view sensor,
                                                const SensorTempStats &sensor_temp_stats,
-                                               StatsRecord *stats_record) {
+                                               AtomicStatsRecord *stats_record) {
     LOG(VERBOSE) << "Reporting sensor stats for " << sensor;
-    // maintain a copy in case reporting fails
-    StatsRecord thermal_stats_before_reporting = *stats_record;
+    StatsRecord taken_stats_record;
+    std::chrono::milliseconds since_last_update_ms;
     std::vector<VendorAtomValue> values(2);
     values[0].set<VendorAtomValue::stringValue>(sensor);
-    std::vector<int64_t> time_in_state_ms = processStatsRecordForReporting(stats_record);
-    const auto since_last_update_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-            stats_record->cur_state_start_time - stats_record->last_stats_report_time);
+    std::vector<int64_t> time_in_state_ms = processStatsRecordForReporting(
+            stats_record, &taken_stats_record, &since_last_update_ms);
     values[1].set<VendorAtomValue::longValue>(since_last_update_ms.count());
     VendorAtomValue tmp;
     for (auto &time_in_state : time_in_state_ms) {
@@ -481,7 +587,7 @@ bool ThermalStatsHelper::reportSensorTempStats(const std::shared_ptr<IStats> &st
         LOG(ERROR) << "Unable to report VendorTempResidencyStats to Stats service for "
                       "sensor: "
                    << sensor;
-        *stats_record = restoreStatsRecordOnFailure(std::move(thermal_stats_before_reporting));
+        restoreStatsRecordOnFailure(stats_record, taken_stats_record);
         return false;
     }
     // Update last time of stats reporting
@@ -492,14 +598,20 @@ bool ThermalStatsHelper::reportSensorTempStats(const std::shared_ptr<IStats> &st
 int ThermalStatsHelper::reportAllSensorCdevRequestStats(
         const std::shared_ptr<IStats> &stats_client) {
     int count_failed_reporting = 0;
-    std::unique_lock<std::shared_mutex> _lock(sensor_cdev_request_stats_map_mutex_);
-    for (auto &[sensor, cdev_request_stats_map] : sensor_cdev_request_stats_map_) {
-        for (auto &[cdev, request_stats] : cdev_request_stats_map) {
+    std::lock_guard<std::mutex> _lock(report_mutex_);
+    for (const auto &slot : sensor_stats_slots_) {
+        if (slot == nullptr) {
+            continue;
+        }
+        const auto &sensor = slot->name;
+        for (const auto &request_stats_slot : slot->cdev_request_stats) {
+            const auto &cdev = request_stats_slot->cdev_name;
+            auto &request_stats = request_stats_slot->request_stats;
             for (size_t threshold_set_idx = 0;
                  threshold_set_idx < request_stats.stats_by_custom_threshold.size();
                  threshold_set_idx++) {
                 auto &stats_by_threshold =
-                        request_stats.stats_by_custom_threshold[threshold_set_idx];
+                        *request_stats.stats_by_custom_threshold[threshold_set_idx];
                 std::string cdev_name = stats_by_threshold.logging_name.value_or(
                         cdev + kCustomThresholdSetSuffix.data() +
                         std::to_string(threshold_set_idx));
@@ -509,10 +621,10 @@ int ThermalStatsHelper::reportAllSensorCdevRequestStats(
                 }
             }
 
-            if (request_stats.stats_by_default_threshold.has_value()) {
+            if (request_stats.stats_by_default_threshold != nullptr) {
                 if (!reportSensorCdevRequestStats(
                             stats_client, sensor, cdev,
-                            &request_stats.stats_by_default_threshold.value())) {
+                            request_stats.stats_by_default_threshold.get())) {
                     count_failed_reporting++;
                 }
             }
@@ -524,17 +636,16 @@ int ThermalStatsHelper::reportAllSensorCdevRequestStats(
 bool ThermalStatsHelper::reportSensorCdevRequestStats(const std::shared_ptr<IStats> &stats_client,
                                                       std::string_view sensor,
                                                       std::string_view cdev,
-                                                      StatsRecord *stats_record) {
+                                                      AtomicStatsRecord *stats_record) {
     LOG(VERBOSE) << "Reporting bindedCdev stats for sensor: " << sensor
                  << " cooling_device: " << cdev;
-    // maintain a copy in case reporting fails
-    StatsRecord thermal_stats_before_reporting = *stats_record;
+    StatsRecord taken_stats_record;
+    std::chrono::milliseconds since_last_update_ms;
     std::vector<VendorAtomValue> values(3);
     values[0].set<VendorAtomValue::stringValue>(sensor);
     values[1].set<VendorAtomValue::stringValue>(cdev);
-    std::vector<int64_t> time_in_state_ms = processStatsRecordForReporting(stats_record);
-    const auto since_last_update_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-            stats_record->cur_state_start_time - stats_record->last_stats_report_time);
+    std::vector<int64_t> time_in_state_ms = processStatsRecordForReporting(
+            stats_record, &taken_stats_record, &since_last_update_ms);
     values[2].set<VendorAtomValue::longValue>(since_last_update_ms.count());
     VendorAtomValue tmp;
     for (auto &time_in_state : time_in_state_ms) {
@@ -547,7 +658,7 @@ bool ThermalStatsHelper::reportSensorCdevRequestStats(const std::shared_ptr<ISta
         LOG(ERROR) << "Unable to report VendorSensorCoolingDeviceStats to Stats "
                       "service for sensor: "
                    << sensor << " cooling_device: " << cdev;
-        *stats_record = restoreStatsRecordOnFailure(std::move(thermal_stats_before_reporting));
+        restoreStatsRecordOnFailure(stats_record, taken_stats_record);
         return false;
     }
     // Update last time of stats reporting
@@ -555,16 +666,18 @@ bool ThermalStatsHelper::reportSensorCdevRequestStats(const std::shared_ptr<ISta
     return true;
 }
 
-std::vector<int64_t> ThermalStatsHelper::processStatsRecordForReporting(StatsRecord *stats_record) {
-    // update the last unclosed entry and start new record with same state
-    updateStatsRecord(stats_record, stats_record->cur_state);
-    std::vector<std::chrono::milliseconds> &time_in_state_ms = stats_record->time_in_state_ms;
+std::vector<int64_t> ThermalStatsHelper::processStatsRecordForReporting(
+        AtomicStatsRecord *stats_record, StatsRecord *taken_stats_record,
+        std::chrono::milliseconds *since_last_update_ms) {
+    // take the residency up to now, the record carries on in the same state
+    *taken_stats_record = stats_record->snapshot(true);
+    *since_last_update_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            boot_clock::now() - stats_record->last_stats_report_time);
     // convert std::chrono::milliseconds time_in_state to int64_t vector for reporting
+    const auto &time_in_state_ms = taken_stats_record->time_in_state_ms;
     std::vector<int64_t> stats_residency(time_in_state_ms.size());
     std::transform(time_in_state_ms.begin(), time_in_state_ms.end(), stats_residency.begin(),
                    [](std::chrono::milliseconds time_ms) { return time_ms.count(); });
-    // clear previous stats
-    std::fill(time_in_state_ms.begin(), time_in_state_ms.end(), std::chrono::milliseconds::zero());
     return stats_residency;
 }
 
@@ -617,52 +730,44 @@ bool ThermalStatsHelper::reportAtom(const std::shared_ptr<IStats> &stats_client,
     return ret.isOk();
 }
 
-StatsRecord ThermalStatsHelper::restoreStatsRecordOnFailure(
-        StatsRecord &&stats_record_before_failure) {
-    stats_record_before_failure.report_fail_count += 1;
-    // If consecutive count of failure is high, reset stat to avoid overflow
-    if (stats_record_before_failure.report_fail_count >= kMaxStatsReportingFailCount) {
-        return StatsRecord(stats_record_before_failure.time_in_state_ms.size(),
-                           stats_record_before_failure.cur_state);
+void ThermalStatsHelper::restoreStatsRecordOnFailure(AtomicStatsRecord *stats_record,
+                                                     const StatsRecord &taken_stats_record) {
+    stats_record->report_fail_count += 1;
+    // If consecutive count of failure is high, drop the stats to avoid overflow
+    if (stats_record->report_fail_count >= kMaxStatsReportingFailCount) {
+        stats_record->report_fail_count = 0;
+        stats_record->last_stats_report_time = boot_clock::now();
     } else {
-        return stats_record_before_failure;
+        stats_record->restore(taken_stats_record);
     }
 }
 
 std::unordered_map<std::string, SensorTempStats> ThermalStatsHelper::GetSensorTempStatsSnapshot() {
-    auto sensor_temp_stats_snapshot = sensor_stats.temp_stats_map_;
-    for (auto &sensor_temp_stats_pair : sensor_temp_stats_snapshot) {
-        for (auto &temp_stats : sensor_temp_stats_pair.second.stats_by_custom_threshold) {
-            // update the last unclosed entry and start new record with same state
-            updateStatsRecord(&temp_stats.stats_record, temp_stats.stats_record.cur_state);
-        }
-        if (sensor_temp_stats_pair.second.stats_by_default_threshold.has_value()) {
-            auto &stats_by_default_threshold =
-                    sensor_temp_stats_pair.second.stats_by_default_threshold.value();
-            // update the last unclosed entry and start new record with same state
-            updateStatsRecord(&stats_by_default_threshold, stats_by_default_threshold.cur_state);
+    std::unordered_map<std::string, SensorTempStats> sensor_temp_stats_snapshot;
+    std::lock_guard<std::mutex> _lock(report_mutex_);
+    for (const auto &slot : sensor_stats_slots_) {
+        if (slot == nullptr || slot->temp_stats == nullptr) {
+            continue;
         }
+        auto &sensor_temp_stats = sensor_temp_stats_snapshot[slot->name];
+        static_cast<ThermalStats<float> &>(sensor_temp_stats) = slot->temp_stats->snapshot(false);
+        loadSensorTempExtremes(*slot, &sensor_temp_stats);
     }
     return sensor_temp_stats_snapshot;
 }
 
 std::unordered_map<std::string, std::unordered_map<std::string, ThermalStats<int>>>
 ThermalStatsHelper::GetSensorCoolingDeviceRequestStatsSnapshot() {
-    auto sensor_cdev_request_stats_snapshot = sensor_cdev_request_stats_map_;
-    for (auto &sensor_cdev_request_stats_pair : sensor_cdev_request_stats_snapshot) {
-        for (auto &cdev_request_stats_pair : sensor_cdev_request_stats_pair.second) {
-            for (auto &request_stats : cdev_request_stats_pair.second.stats_by_custom_threshold) {
-                // update the last unclosed entry and start new record with same state
-                updateStatsRecord(&request_stats.stats_record,
-                                  request_stats.stats_record.cur_state);
-            }
-            if (cdev_request_stats_pair.second.stats_by_default_threshold.has_value()) {
-                auto &stats_by_default_threshold =
-                        cdev_request_stats_pair.second.stats_by_default_threshold.value();
-                // update the last unclosed entry and start new record with same state
-                updateStatsRecord(&stats_by_default_threshold,
-                                  stats_by_default_threshold.cur_state);
-            }
+    std::unordered_map<std::string, std::unordered_map<std::string, ThermalStats<int>>>
+            sensor_cdev_request_stats_snapshot;
+    std::lock_guard<std::mutex> _lock(report_mutex_);
+    for (const auto &slot : sensor_stats_slots_) {
+        if (slot == nullptr) {
+            continue;
+        }
+        for (const auto &request_stats_slot : slot->cdev_request_stats) {
+            sensor_cdev_request_stats_snapshot[slot->name][request_stats_slot->cdev_name] =
+                    request_stats_slot->request_stats.snapshot(false);
         }
     }
     return sensor_cdev_request_stats_snapshot;
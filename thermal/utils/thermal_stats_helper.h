@@ -21,7 +21,10 @@
 #include <android-base/chrono_utils.h>
 #include <hardware/google/pixel/pixelstats/pixelatoms.pb.h>
 
+#include <atomic>
 #include <chrono>
+#include <memory>
+#include <mutex>
 #include <shared_mutex>
 #include <string_view>
 #include <unordered_map>
@@ -115,15 +118,81 @@ struct CurrTempStatus {
     int repeat_count;
 };
 
-struct SensorStats {
-    // Temperature residency stats for each sensor being watched
-    std::unordered_map<std::string, SensorTempStats> temp_stats_map_;
-    // Min, Max Temp threshold info for each sensor being monitored
-    std::unordered_map<std::string, std::shared_ptr<TempRangeInfo>> temp_range_info_map_;
-    // Temperature Stuck info for each sensor being monitored
-    std::unordered_map<std::string, std::shared_ptr<TempStuckInfo>> temp_stuck_info_map_;
-    // Current temperature status for each sensor being monitored for stuck
-    std::unordered_map<std::string, CurrTempStatus> curr_temp_status_map_;
+// StatsRecord updated from the control loop without a lock. The current state and the time
+// it was entered share one word, so a state change is a single compare-and-swap followed by
+// adding the time spent in the previous state to its bucket.
+class AtomicStatsRecord {
+  public:
+    explicit AtomicStatsRecord(size_t time_in_state_size);
+    // Disallow copy and assign
+    AtomicStatsRecord(const AtomicStatsRecord &) = delete;
+    void operator=(const AtomicStatsRecord &) = delete;
+
+    // Move to new_state, clamped to the buckets of the record
+    void update(int new_state);
+    // Copy the record out with the current entry closed. With reset, the residency is cleared
+    // for the next report.
+    StatsRecord snapshot(bool reset);
+    // Put back the residency taken by snapshot(true) after the report of it failed
+    void restore(const StatsRecord &stats_record);
+    size_t size() const { return time_in_state_ms_.size(); }
+
+    // Only touched by the reporting thread
+    boot_clock::time_point last_stats_report_time;
+    int report_fail_count = 0;
+
+  private:
+    static constexpr int kStateBits = 8;
+    static constexpr uint64_t kStateMask = (1 << kStateBits) - 1;
+    static int64_t nowMs();
+    std::atomic<uint64_t> state_and_start_ms_;
+    std::vector<std::atomic<int64_t>> time_in_state_ms_;
+};
+
+template <typename ValueType>
+struct AtomicStatsByThreshold {
+    std::vector<ValueType> thresholds;
+    std::optional<std::string> logging_name;
+    AtomicStatsRecord stats_record;
+    explicit AtomicStatsByThreshold(const ThresholdList<ValueType> &threshold_list)
+        : thresholds(threshold_list.thresholds),
+          logging_name(threshold_list.logging_name),
+          // number of states = number of thresholds + 1
+          stats_record(threshold_list.thresholds.size() + 1) {}
+};
+
+template <typename ValueType>
+struct AtomicThermalStats {
+    std::vector<std::unique_ptr<AtomicStatsByThreshold<ValueType>>> stats_by_custom_threshold;
+    std::unique_ptr<AtomicStatsRecord> stats_by_default_threshold;
+    ThermalStats<ValueType> snapshot(bool reset);
+};
+
+struct CdevRequestStatsSlot {
+    size_t cdev_id;
+    std::string cdev_name;
+    AtomicThermalStats<int> request_stats;
+};
+
+// Stats of a sensor, indexed by SensorInfo::id
+struct SensorStatsSlot {
+    static constexpr SystemTimePoint::rep kNoTimestamp =
+            SystemTimePoint::min().time_since_epoch().count();
+    std::string name;
+    // Temperature residency stats, nullptr if the sensor isn't recorded
+    std::unique_ptr<AtomicThermalStats<float>> temp_stats;
+    std::atomic<float> max_temp = std::numeric_limits<float>::min();
+    std::atomic<SystemTimePoint::rep> max_temp_timestamp = kNoTimestamp;
+    std::atomic<float> min_temp = std::numeric_limits<float>::max();
+    std::atomic<SystemTimePoint::rep> min_temp_timestamp = kNoTimestamp;
+    // Min, Max Temp threshold info if the sensor is being monitored
+    std::shared_ptr<TempRangeInfo> temp_range_info;
+    // Temperature Stuck info and current status if the sensor is being monitored for stuck
+    std::shared_ptr<TempStuckInfo> temp_stuck_info;
+    std::mutex curr_temp_status_mutex;
+    CurrTempStatus curr_temp_status;
+    // userVote request stats to the binded cooling devices
+    std::vector<std::unique_ptr<CdevRequestStatsSlot>> cdev_request_stats;
 };
 
 class ThermalStatsHelper {
@@ -134,15 +203,17 @@ class ThermalStatsHelper {
     ThermalStatsHelper(const ThermalStatsHelper &) = delete;
     void operator=(const ThermalStatsHelper &) = delete;
 
-    bool initializeStats(const Json::Value &config,
+    bool initializeStats(const StatsInfo<float> &sensor_stats_info,
+                         const AbnormalStatsInfo &abnormal_stats_info,
+                         const StatsInfo<int> &cooling_device_request_info,
                          const std::unordered_map<std::string, SensorInfo> &sensor_info_map_,
                          const std::unordered_map<std::string, CdevInfo> &cooling_device_info_map_,
                          ThermalHelper *const thermal_helper_handle);
-    void updateSensorCdevRequestStats(std::string_view trigger_sensor, std::string_view cdev,
-                                      int new_state);
-    void updateSensorTempStatsBySeverity(std::string_view sensor,
-                                         const ThrottlingSeverity &severity);
-    void updateSensorTempStatsByThreshold(std::string_view sensor, float temperature);
+    // The update functions are called from the control loop and don't take a lock,
+    // sensor_id and cdev_id are SensorInfo::id and CdevInfo::id
+    void updateSensorCdevRequestStats(size_t sensor_id, size_t cdev_id, int new_state);
+    void updateSensorTempStatsBySeverity(size_t sensor_id, const ThrottlingSeverity &severity);
+    void updateSensorTempStatsByThreshold(size_t sensor_id, float temperature);
     /*
      * Function to report all the stats by calling all specific stats reporting function.
      * Returns:
@@ -163,15 +234,12 @@ class ThermalStatsHelper {
     static constexpr std::chrono::milliseconds kUpdateIntervalMs =
             std::chrono::duration_cast<std::chrono::milliseconds>(24h);
     boot_clock::time_point last_total_stats_report_time = boot_clock::time_point::min();
-    int abnormal_stats_reported_per_update_interval = 0;
-    mutable std::shared_mutex sensor_stats_mutex_;
-    SensorStats sensor_stats;
-    mutable std::shared_mutex sensor_cdev_request_stats_map_mutex_;
+    std::atomic<int> abnormal_stats_reported_per_update_interval = 0;
+    // Sized at initializeStats and not resized after, nullptr for sensors without stats
+    std::vector<std::unique_ptr<SensorStatsSlot>> sensor_stats_slots_;
+    // Serializes reporting against the dump snapshots
+    std::mutex report_mutex_;
     ThermalHelper *thermal_helper_handle_;
-    // userVote request stat for the sensor to the corresponding cdev (sensor -> cdev ->
-    // StatsRecord)
-    std::unordered_map<std::string, std::unordered_map<std::string, ThermalStats<int>>>
-            sensor_cdev_request_stats_map_;
 
     bool initializeSensorTempStats(
             const StatsInfo<float> &sensor_stats_info,
@@ -183,19 +251,26 @@ class ThermalStatsHelper {
     bool initializeSensorAbnormalityStats(
             const AbnormalStatsInfo &abnormal_stats_info,
             const std::unordered_map<std::string, SensorInfo> &sensor_info_map_);
-    void updateStatsRecord(StatsRecord *stats_record, int new_state);
-    void verifySensorAbnormality(std::string_view sensor, float temperature);
+    SensorStatsSlot *getSensorStatsSlot(size_t sensor_id) const;
+    SensorStatsSlot *getOrCreateSensorStatsSlot(const std::string &sensor, size_t sensor_id);
+    void verifySensorAbnormality(SensorStatsSlot *slot, float temperature);
     int reportAllSensorTempStats(const std::shared_ptr<IStats> &stats_client);
     bool reportSensorTempStats(const std::shared_ptr<IStats> &stats_client, std::string_view sensor,
-                               const SensorTempStats &sensor_temp_stats, StatsRecord *stats_record);
+                               const SensorTempStats &sensor_temp_stats,
+                               AtomicStatsRecord *stats_record);
     int reportAllSensorCdevRequestStats(const std::shared_ptr<IStats> &stats_client);
     bool reportSensorCdevRequestStats(const std::shared_ptr<IStats> &stats_client,
                                       std::string_view sensor, std::string_view cdev,
-                                      StatsRecord *stats_record);
+                                      AtomicStatsRecord *stats_record);
     bool reportAtom(const std::shared_ptr<IStats> &stats_client, const int32_t &atom_id,
                     std::vector<VendorAtomValue> &&values);
-    std::vector<int64_t> processStatsRecordForReporting(StatsRecord *stats_record);
-    StatsRecord restoreStatsRecordOnFailure(StatsRecord &&stats_record_before_failure);
+    // Take the residency of the record for reporting, return the report period through
+    // since_last_update_ms
+    std::vector<int64_t> processStatsRecordForReporting(
+            AtomicStatsRecord *stats_record, StatsRecord *taken_stats_record,
+            std::chrono::milliseconds *since_last_update_ms);
+    void restoreStatsRecordOnFailure(AtomicStatsRecord *stats_record,
+                                     const StatsRecord &taken_stats_record);
 };
 
 }  // namespace implementation
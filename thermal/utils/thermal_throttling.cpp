@@ -22,10 +22,11 @@
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <pixeltrace/PixelTrace.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <iterator>
-#include <set>
 #include <sstream>
 #include <thread>
 #include <vector>
@@ -58,9 +59,50 @@ size_t getTargetStateOfPID(const SensorInfo &sensor_info, const ThrottlingSeveri
     return target_state;
 }
 
+std::pair<ThrottlingSeverity, ThrottlingSeverity> getSeverityFromThresholds(
+        const ThrottlingArray &hot_thresholds, const ThrottlingArray &cold_thresholds,
+        const ThrottlingArray &hot_hysteresis, const ThrottlingArray &cold_hysteresis,
+        ThrottlingSeverity prev_hot_severity, ThrottlingSeverity prev_cold_severity, float value) {
+    ThrottlingSeverity ret_hot = ThrottlingSeverity::NONE;
+    ThrottlingSeverity ret_hot_hysteresis = ThrottlingSeverity::NONE;
+    ThrottlingSeverity ret_cold = ThrottlingSeverity::NONE;
+    ThrottlingSeverity ret_cold_hysteresis = ThrottlingSeverity::NONE;
+
+    // Here we want to control the iteration from high to low, and ::ndk::enum_range doesn't support
+    // a reverse iterator yet.
+    for (size_t i = static_cast<size_t>(ThrottlingSeverity::SHUTDOWN);
+         i > static_cast<size_t>(ThrottlingSeverity::NONE); --i) {
+        if (!std::isnan(hot_thresholds[i]) && hot_thresholds[i] <= value &&
+            ret_hot == ThrottlingSeverity::NONE) {
+            ret_hot = static_cast<ThrottlingSeverity>(i);
+        }
+        if (!std::isnan(hot_thresholds[i]) && (hot_thresholds[i] - hot_hysteresis[i]) < value &&
+            ret_hot_hysteresis == ThrottlingSeverity::NONE) {
+            ret_hot_hysteresis = static_cast<ThrottlingSeverity>(i);
+        }
+        if (!std::isnan(cold_thresholds[i]) && cold_thresholds[i] >= value &&
+            ret_cold == ThrottlingSeverity::NONE) {
+            ret_cold = static_cast<ThrottlingSeverity>(i);
+        }
+        if (!std::isnan(cold_thresholds[i]) && (cold_thresholds[i] + cold_hysteresis[i]) > value &&
+            ret_cold_hysteresis == ThrottlingSeverity::NONE) {
+            ret_cold_hysteresis = static_cast<ThrottlingSeverity>(i);
+        }
+    }
+    if (static_cast<size_t>(ret_hot) < static_cast<size_t>(prev_hot_severity)) {
+        ret_hot = ret_hot_hysteresis;
+    }
+    if (static_cast<size_t>(ret_cold) < static_cast<size_t>(prev_cold_severity)) {
+        ret_cold = ret_cold_hysteresis;
+    }
+
+    return std::make_pair(ret_hot, ret_cold);
+}
+
 void ThermalThrottling::parseProfileProperty(std::string_view sensor_name,
                                              const SensorInfo &sensor_info) {
-    if (sensor_info.throttling_info == nullptr) {
+    auto *throttling_status = getThrottlingStatus(sensor_info);
+    if (sensor_info.throttling_info == nullptr || throttling_status == nullptr) {
         return;
     }
 
@@ -68,57 +110,61 @@ void ThermalThrottling::parseProfileProperty(std::string_view sensor_name,
             StringPrintf("vendor.thermal.%s.profile", sensor_name.data()), "");
 
     if (profile.empty() || sensor_info.throttling_info->profile_map.count(profile)) {
-        if (profile != thermal_throttling_status_map_[sensor_name.data()].profile) {
+        if (profile != throttling_status->profile) {
             LOG(INFO) << sensor_name.data() << ": throttling profile change to "
                       << ((profile.empty()) ? "default" : profile);
-            thermal_throttling_status_map_[sensor_name.data()].profile = profile;
+            throttling_status->profile = profile;
         }
     } else {
         LOG(ERROR) << sensor_name.data() << ": set profile to default because " << profile
                    << " is invalid";
-        thermal_throttling_status_map_[sensor_name.data()].profile = "";
+        throttling_status->profile = "";
+    }
+}
+
+ThermalThrottlingStatus *ThermalThrottling::getThrottlingStatus(const SensorInfo &sensor_info) {
+    if (sensor_info.id >= thermal_throttling_status_by_id_.size()) {
+        return nullptr;
     }
+    return thermal_throttling_status_by_id_[sensor_info.id];
 }
 
-void ThermalThrottling::clearThrottlingData(std::string_view sensor_name) {
-    if (!thermal_throttling_status_map_.count(sensor_name.data())) {
+void ThermalThrottling::clearThrottlingData(const SensorInfo &sensor_info) {
+    auto *throttling_status = getThrottlingStatus(sensor_info);
+    if (throttling_status == nullptr) {
         return;
     }
     std::unique_lock<std::shared_mutex> _lock(thermal_throttling_status_map_mutex_);
 
-    for (auto &pid_power_budget_pair :
-         thermal_throttling_status_map_.at(sensor_name.data()).pid_power_budget_map) {
+    for (auto &pid_power_budget_pair : throttling_status->pid_power_budget_map) {
         pid_power_budget_pair.second = std::numeric_limits<int>::max();
     }
 
-    for (auto &pid_cdev_request_pair :
-         thermal_throttling_status_map_.at(sensor_name.data()).pid_cdev_request_map) {
+    for (auto &pid_cdev_request_pair : throttling_status->pid_cdev_request_map) {
         pid_cdev_request_pair.second = 0;
     }
 
-    for (auto &hardlimit_cdev_request_pair :
-         thermal_throttling_status_map_.at(sensor_name.data()).hardlimit_cdev_request_map) {
+    for (auto &hardlimit_cdev_request_pair : throttling_status->hardlimit_cdev_request_map) {
         hardlimit_cdev_request_pair.second = 0;
     }
 
-    for (auto &throttling_release_pair :
-         thermal_throttling_status_map_.at(sensor_name.data()).throttling_release_map) {
+    for (auto &throttling_release_pair : throttling_status->throttling_release_map) {
         throttling_release_pair.second = 0;
     }
 
-    thermal_throttling_status_map_[sensor_name.data()].prev_err = NAN;
-    thermal_throttling_status_map_[sensor_name.data()].i_budget = NAN;
-    thermal_throttling_status_map_[sensor_name.data()].prev_target =
-            static_cast<size_t>(ThrottlingSeverity::NONE);
-    thermal_throttling_status_map_[sensor_name.data()].prev_power_budget = NAN;
-    thermal_throttling_status_map_[sensor_name.data()].tran_cycle = 0;
+    throttling_status->prev_err = NAN;
+    throttling_status->i_budget = NAN;
+    throttling_status->prev_target = static_cast<size_t>(ThrottlingSeverity::NONE);
+    throttling_status->prev_power_budget = NAN;
+    throttling_status->tran_cycle = 0;
 
     return;
 }
 
 bool ThermalThrottling::registerThermalThrottling(
-        std::string_view sensor_name, const std::shared_ptr<ThrottlingInfo> &throttling_info,
+        std::string_view sensor_name, const SensorInfo &sensor_info,
         const std::unordered_map<std::string, CdevInfo> &cooling_device_info_map) {
+    const auto &throttling_info = sensor_info.throttling_info;
     if (thermal_throttling_status_map_.count(sensor_name.data())) {
         LOG(ERROR) << "Sensor " << sensor_name.data() << " throttling map has been registered";
         return false;
@@ -137,12 +183,19 @@ bool ThermalThrottling::registerThermalThrottling(
     thermal_throttling_status_map_[sensor_name.data()].tran_cycle = 0;
     thermal_throttling_status_map_[sensor_name.data()].profile = "";
 
+    if (cdev_all_requests_.size() < cooling_device_info_map.size()) {
+        cdev_all_requests_.resize(cooling_device_info_map.size());
+    }
     for (auto &binded_cdev_pair : throttling_info->binded_cdev_info_map) {
         if (!cooling_device_info_map.count(binded_cdev_pair.first)) {
             LOG(ERROR) << "Could not find " << sensor_name.data() << "'s binded CDEV "
                        << binded_cdev_pair.first;
             return false;
         }
+        const auto &cdev_info = cooling_device_info_map.at(binded_cdev_pair.first);
+        if (!cdev_power_tables_.has(cdev_info.id)) {
+            cdev_power_tables_.set(cdev_info.id, cdev_info.state2power);
+        }
         // Register PID throttling map
         for (const auto &cdev_weight : binded_cdev_pair.second.cdev_weight_for_pid) {
             if (!std::isnan(cdev_weight)) {
@@ -153,7 +206,6 @@ bool ThermalThrottling::registerThermalThrottling(
                         .pid_cdev_request_map[binded_cdev_pair.first] = 0;
                 thermal_throttling_status_map_[sensor_name.data()]
                         .cdev_status_map[binded_cdev_pair.first] = 0;
-                cdev_all_request_map_[binded_cdev_pair.first].insert(0);
                 break;
             }
         }
@@ -164,7 +216,6 @@ bool ThermalThrottling::registerThermalThrottling(
                         .hardlimit_cdev_request_map[binded_cdev_pair.first] = 0;
                 thermal_throttling_status_map_[sensor_name.data()]
                         .cdev_status_map[binded_cdev_pair.first] = 0;
-                cdev_all_request_map_[binded_cdev_pair.first].insert(0);
                 break;
             }
         }
@@ -179,6 +230,86 @@ bool ThermalThrottling::registerThermalThrottling(
             }
         }
     }
+
+    // The maps are complete, map entries don't move once inserted
+    auto &throttling_status = thermal_throttling_status_map_.at(sensor_name.data());
+    if (thermal_throttling_status_by_id_.size() <= sensor_info.id) {
+        thermal_throttling_status_by_id_.resize(sensor_info.id + 1, nullptr);
+        cdev_request_slots_by_id_.resize(sensor_info.id + 1);
+        pid_cdev_slots_by_id_.resize(sensor_info.id + 1);
+    }
+    thermal_throttling_status_by_id_[sensor_info.id] = &throttling_status;
+    const auto find_request = [](const std::unordered_map<std::string, int> &request_map,
+                                 const std::string &cdev_name) -> const int * {
+        const auto itr = request_map.find(cdev_name);
+        return itr == request_map.end() ? nullptr : &itr->second;
+    };
+    for (auto &cdev_status_pair : throttling_status.cdev_status_map) {
+        const auto &cdev_name = cdev_status_pair.first;
+        const size_t cdev_id = cooling_device_info_map.at(cdev_name).id;
+        auto &cdev_requests = cdev_all_requests_[cdev_id].requests;
+        cdev_requests.push_back(0);
+        cdev_request_slots_by_id_[sensor_info.id].push_back({
+                .cdev_name = cdev_name,
+                .cdev_id = cdev_id,
+                .request_index = cdev_requests.size() - 1,
+                .cdev_status = &cdev_status_pair.second,
+                .pid_cdev_request = find_request(throttling_status.pid_cdev_request_map, cdev_name),
+                .hardlimit_cdev_request =
+                        find_request(throttling_status.hardlimit_cdev_request_map, cdev_name),
+                .release_step = find_request(throttling_status.throttling_release_map, cdev_name),
+                .binded_cdev_info = &throttling_info->binded_cdev_info_map.at(cdev_name),
+        });
+    }
+
+    auto &pid_cdev_slots = pid_cdev_slots_by_id_[sensor_info.id];
+    if (!makePidCdevSlots(sensor_name, throttling_info->binded_cdev_info_map, &throttling_status,
+                          cooling_device_info_map, &pid_cdev_slots.binded)) {
+        return false;
+    }
+    for (const auto &[profile, binded_cdevs] : throttling_info->profile_map) {
+        if (!makePidCdevSlots(sensor_name, binded_cdevs, &throttling_status,
+                              cooling_device_info_map, &pid_cdev_slots.profiles[profile])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ThermalThrottling::makePidCdevSlots(
+        std::string_view sensor_name,
+        const std::unordered_map<std::string, BindedCdevInfo> &binded_cdevs,
+        ThermalThrottlingStatus *throttling_status,
+        const std::unordered_map<std::string, CdevInfo> &cooling_device_info_map,
+        std::vector<PidCdevSlot> *slots) {
+    slots->clear();
+    for (const auto &[cdev_name, binded_cdev_info] : binded_cdevs) {
+        const auto budget_itr = throttling_status->pid_power_budget_map.find(cdev_name);
+        if (budget_itr == throttling_status->pid_power_budget_map.end()) {
+            // The PID only registers the cooling devices weighted in the default profile
+            const auto &weights = binded_cdev_info.cdev_weight_for_pid;
+            if (std::any_of(weights.begin(), weights.end(),
+                            [](float weight) { return !std::isnan(weight) && weight != 0; })) {
+                LOG(ERROR) << "Sensor " << sensor_name << "'s binded CDEV " << cdev_name
+                           << " has PID weights in a profile only";
+                return false;
+            }
+            continue;
+        }
+        const auto cdev_itr = cooling_device_info_map.find(cdev_name);
+        if (cdev_itr == cooling_device_info_map.end()) {
+            LOG(ERROR) << "Could not find " << sensor_name << "'s binded CDEV " << cdev_name;
+            return false;
+        }
+        slots->push_back({
+                .cdev_name = cdev_name,
+                .binded_cdev_info = &binded_cdev_info,
+                .cdev_info = &cdev_itr->second,
+                .pid_power_budget = &budget_itr->second,
+                .pid_cdev_request = &throttling_status->pid_cdev_request_map.at(cdev_name),
+                .allocated = false,
+        });
+    }
     return true;
 }
 
@@ -192,7 +323,7 @@ float ThermalThrottling::updatePowerBudget(
     float power_budget = std::numeric_limits<float>::max();
     bool target_changed = false;
     float budget_transient = 0.0;
-    auto &throttling_status = thermal_throttling_status_map_.at(temp.name);
+    auto &throttling_status = *getThrottlingStatus(sensor_info);
     std::string sensor_name = temp.name;
 
     if (curr_severity == ThrottlingSeverity::NONE) {
@@ -228,8 +359,8 @@ float ThermalThrottling::updatePowerBudget(
                  sensor_info.throttling_info->binded_cdev_info_map) {
                 int max_cdev_vote;
                 const CdevInfo &cdev_info = cooling_device_info_map.at(binded_cdev_info_pair.first);
-                max_cdev_vote = getCdevMaxRequest(binded_cdev_info_pair.first, &max_cdev_vote);
-                default_i_budget += cdev_info.state2power[max_cdev_vote];
+                max_cdev_vote = getCdevMaxRequest(cdev_info.id, &max_cdev_vote);
+                default_i_budget += cdev_power_tables_.stateToPower(cdev_info.id, max_cdev_vote);
             }
             throttling_status.i_budget =
                     default_i_budget * sensor_info.throttling_info->i_default_pct / 100;
@@ -295,27 +426,20 @@ float ThermalThrottling::updatePowerBudget(
               << " compensation=" << compensation << " budget transient=" << budget_transient
               << " control target=" << target_state;
 
-    ATRACE_INT((sensor_name + std::string("-power_budget")).c_str(),
-               static_cast<int>(power_budget));
-    ATRACE_INT((sensor_name + std::string("-s_power")).c_str(),
-               static_cast<int>(sensor_info.throttling_info->s_power[target_state]));
-    ATRACE_INT((sensor_name + std::string("-time_elapsed_ms")).c_str(),
-               static_cast<int>(time_elapsed_ms.count()));
-    ATRACE_INT((sensor_name + std::string("-budget_transient")).c_str(),
-               static_cast<int>(budget_transient));
-    ATRACE_INT((sensor_name + std::string("-i")).c_str(),
-               static_cast<int>(throttling_status.i_budget));
-    ATRACE_INT((sensor_name + std::string("-target_state")).c_str(),
-               static_cast<int>(target_state));
-
-    ATRACE_INT((sensor_name + std::string("-err")).c_str(),
-               static_cast<int>(err / sensor_info.multiplier));
-    ATRACE_INT((sensor_name + std::string("-p")).c_str(), static_cast<int>(p));
-    ATRACE_INT((sensor_name + std::string("-d")).c_str(), static_cast<int>(d));
-    ATRACE_INT((sensor_name + std::string("-predict_compensation")).c_str(),
-               static_cast<int>(compensation));
-    ATRACE_INT((sensor_name + std::string("-temp")).c_str(),
-               static_cast<int>(temp.value / sensor_info.multiplier));
+    const char *name = sensor_name.c_str();
+    PIXEL_TRACE_INT_F(static_cast<int>(power_budget), "%s-power_budget", name);
+    PIXEL_TRACE_INT_F(static_cast<int>(sensor_info.throttling_info->s_power[target_state]),
+                      "%s-s_power", name);
+    PIXEL_TRACE_INT_F(static_cast<int>(time_elapsed_ms.count()), "%s-time_elapsed_ms", name);
+    PIXEL_TRACE_INT_F(static_cast<int>(budget_transient), "%s-budget_transient", name);
+    PIXEL_TRACE_INT_F(static_cast<int>(throttling_status.i_budget), "%s-i", name);
+    PIXEL_TRACE_INT_F(static_cast<int>(target_state), "%s-target_state", name);
+
+    PIXEL_TRACE_INT_F(static_cast<int>(err / sensor_info.multiplier), "%s-err", name);
+    PIXEL_TRACE_INT_F(static_cast<int>(p), "%s-p", name);
+    PIXEL_TRACE_INT_F(static_cast<int>(d), "%s-d", name);
+    PIXEL_TRACE_INT_F(static_cast<int>(compensation), "%s-predict_compensation", name);
+    PIXEL_TRACE_INT_F(static_cast<int>(temp.value / sensor_info.multiplier), "%s-temp", name);
 
     throttling_status.prev_power_budget = power_budget;
 
@@ -340,15 +464,13 @@ float ThermalThrottling::computeExcludedPower(
                     last_updated_avg_power,
                     excluded_power_info_pair.second[static_cast<size_t>(curr_severity)]));
 
-            ATRACE_INT((std::string(sensor_name) + std::string("-") +
-                        excluded_power_info_pair.first + std::string("-avg_power"))
-                               .c_str(),
-                       static_cast<int>(last_updated_avg_power));
+            PIXEL_TRACE_INT_F(static_cast<int>(last_updated_avg_power), "%s-%s-avg_power",
+                              sensor_name.data(), excluded_power_info_pair.first.c_str());
         }
     }
 
-    ATRACE_INT((std::string(sensor_name) + std::string("-excluded_power")).c_str(),
-               static_cast<int>(excluded_power));
+    PIXEL_TRACE_INT_F(static_cast<int>(excluded_power), "%s-excluded_power",
+                      sensor_name.data());
     return excluded_power;
 }
 
@@ -366,14 +488,20 @@ bool ThermalThrottling::allocatePowerToCdev(
     bool low_power_device_check = true;
     bool is_budget_allocated = false;
     bool power_data_invalid = false;
-    std::set<std::string> allocated_cdev;
     std::string log_buf;
+    const size_t severity = static_cast<size_t>(curr_severity);
 
     std::unique_lock<std::shared_mutex> _lock(thermal_throttling_status_map_mutex_);
+    auto &throttling_status = *getThrottlingStatus(sensor_info);
     auto total_power_budget =
             updatePowerBudget(temp, sensor_info, cooling_device_info_map, time_elapsed_ms,
                               curr_severity, max_throttling, sensor_predictions);
-    const auto &profile = thermal_throttling_status_map_[temp.name].profile;
+    auto &pid_cdev_slots = pid_cdev_slots_by_id_[sensor_info.id];
+    const auto profile_itr = throttling_status.profile.empty()
+                                     ? pid_cdev_slots.profiles.end()
+                                     : pid_cdev_slots.profiles.find(throttling_status.profile);
+    auto &slots = profile_itr != pid_cdev_slots.profiles.end() ? profile_itr->second
+                                                               : pid_cdev_slots.binded;
 
     if (sensor_info.throttling_info->excluded_power_info_map.size()) {
         total_power_budget -= computeExcludedPower(sensor_info, curr_severity, power_status_map,
@@ -386,56 +514,47 @@ bool ThermalThrottling::allocatePowerToCdev(
     }
 
     // Compute total cdev weight
-    for (const auto &binded_cdev_info_pair :
-         (sensor_info.throttling_info->profile_map.count(profile)
-                  ? sensor_info.throttling_info->profile_map.at(profile)
-                  : sensor_info.throttling_info->binded_cdev_info_map)) {
-        const auto cdev_weight = binded_cdev_info_pair.second
-                                         .cdev_weight_for_pid[static_cast<size_t>(curr_severity)];
-        if (!binded_cdev_info_pair.second.enabled) {
+    for (auto &slot : slots) {
+        const auto cdev_weight = slot.binded_cdev_info->cdev_weight_for_pid[severity];
+        slot.allocated = false;
+        if (!slot.binded_cdev_info->enabled) {
             continue;
         } else if (std::isnan(cdev_weight) || cdev_weight == 0) {
-            allocated_cdev.insert(binded_cdev_info_pair.first);
+            slot.allocated = true;
             continue;
         }
         total_weight += cdev_weight;
     }
 
     while (!is_budget_allocated) {
-        for (const auto &binded_cdev_info_pair :
-             (sensor_info.throttling_info->profile_map.count(profile)
-                      ? sensor_info.throttling_info->profile_map.at(profile)
-                      : sensor_info.throttling_info->binded_cdev_info_map)) {
+        for (auto &slot : slots) {
+            const auto &binded_cdev_info = *slot.binded_cdev_info;
             float cdev_power_adjustment = 0;
-            const auto cdev_weight =
-                    binded_cdev_info_pair.second
-                            .cdev_weight_for_pid[static_cast<size_t>(curr_severity)];
+            const auto cdev_weight = binded_cdev_info.cdev_weight_for_pid[severity];
 
-            if (allocated_cdev.count(binded_cdev_info_pair.first)) {
+            if (slot.allocated) {
                 continue;
             }
 
             // Get the power data
             if (!power_data_invalid) {
-                if (!binded_cdev_info_pair.second.power_rail.empty()) {
-                    last_updated_avg_power =
-                            power_status_map.at(binded_cdev_info_pair.second.power_rail)
-                                    .last_updated_avg_power;
+                if (!binded_cdev_info.power_rail.empty()) {
+                    last_updated_avg_power = power_status_map.at(binded_cdev_info.power_rail)
+                                                     .last_updated_avg_power;
                     if (std::isnan(last_updated_avg_power)) {
                         LOG(VERBOSE) << "power data is under collecting";
                         power_data_invalid = true;
                         break;
                     }
 
-                    ATRACE_INT((temp.name + std::string("-") +
-                                binded_cdev_info_pair.second.power_rail + std::string("-avg_power"))
-                                       .c_str(),
-                               static_cast<int>(last_updated_avg_power));
+                    PIXEL_TRACE_INT_F(static_cast<int>(last_updated_avg_power),
+                                      "%s-%s-avg_power", temp.name.c_str(),
+                                      binded_cdev_info.power_rail.c_str());
                 } else {
                     power_data_invalid = true;
                     break;
                 }
-                if (binded_cdev_info_pair.second.throttling_with_power_link) {
+                if (binded_cdev_info.throttling_with_power_link) {
                     return false;
                 }
             }
@@ -445,42 +564,40 @@ bool ThermalThrottling::allocatePowerToCdev(
 
             if (low_power_device_check) {
                 // Share the budget for the CDEV which power is lower than target
-                if (cdev_power_adjustment > 0 &&
-                    thermal_throttling_status_map_[temp.name].pid_cdev_request_map.at(
-                            binded_cdev_info_pair.first) == 0) {
+                if (cdev_power_adjustment > 0 && *slot.pid_cdev_request == 0) {
                     allocated_power += last_updated_avg_power;
                     allocated_weight += cdev_weight;
-                    allocated_cdev.insert(binded_cdev_info_pair.first);
-                    if (!binded_cdev_info_pair.second.power_rail.empty()) {
+                    slot.allocated = true;
+                    if (!binded_cdev_info.power_rail.empty()) {
                         log_buf.append(StringPrintf("(%s: %0.2f mW)",
-                                                    binded_cdev_info_pair.second.power_rail.c_str(),
+                                                    binded_cdev_info.power_rail.c_str(),
                                                     last_updated_avg_power));
                     }
-                    LOG(VERBOSE) << temp.name << " binded " << binded_cdev_info_pair.first
+                    LOG(VERBOSE) << temp.name << " binded " << slot.cdev_name
                                  << " has been already at min state 0";
                 }
             } else {
-                const CdevInfo &cdev_info = cooling_device_info_map.at(binded_cdev_info_pair.first);
-                if (!binded_cdev_info_pair.second.power_rail.empty()) {
+                const CdevInfo &cdev_info = *slot.cdev_info;
+                const auto state_power = [this, &cdev_info](int state) {
+                    return cdev_power_tables_.stateToPower(cdev_info.id, state);
+                };
+                if (!binded_cdev_info.power_rail.empty()) {
                     log_buf.append(StringPrintf("(%s: %0.2f mW)",
-                                                binded_cdev_info_pair.second.power_rail.c_str(),
+                                                binded_cdev_info.power_rail.c_str(),
                                                 last_updated_avg_power));
                 }
                 // Ignore the power distribution if the CDEV has no space to reduce power
                 if ((cdev_power_adjustment < 0 &&
-                     thermal_throttling_status_map_[temp.name].pid_cdev_request_map.at(
-                             binded_cdev_info_pair.first) == cdev_info.max_state)) {
-                    LOG(VERBOSE) << temp.name << " binded " << binded_cdev_info_pair.first
+                     *slot.pid_cdev_request == cdev_info.max_state)) {
+                    LOG(VERBOSE) << temp.name << " binded " << slot.cdev_name
                                  << " has been already at max state " << cdev_info.max_state;
                     continue;
                 }
 
-                if (!binded_cdev_info_pair.second.enabled) {
-                    cdev_power_budget = cdev_info.state2power[0];
-                } else if (!power_data_invalid && binded_cdev_info_pair.second.power_rail != "") {
-                    auto cdev_curr_power_budget =
-                            thermal_throttling_status_map_[temp.name].pid_power_budget_map.at(
-                                    binded_cdev_info_pair.first);
+                if (!binded_cdev_info.enabled) {
+                    cdev_power_budget = state_power(0);
+                } else if (!power_data_invalid && binded_cdev_info.power_rail != "") {
+                    int cdev_curr_power_budget = *slot.pid_power_budget;
 
                     if (last_updated_avg_power > cdev_curr_power_budget) {
                         cdev_power_budget = cdev_curr_power_budget +=
@@ -493,76 +610,61 @@ bool ThermalThrottling::allocatePowerToCdev(
                     cdev_power_budget = total_power_budget * (cdev_weight / total_weight);
                 }
 
-                if (!std::isnan(cdev_info.state2power[0]) &&
-                    cdev_power_budget > cdev_info.state2power[0]) {
-                    cdev_power_budget = cdev_info.state2power[0];
+                if (!std::isnan(state_power(0)) && cdev_power_budget > state_power(0)) {
+                    cdev_power_budget = state_power(0);
                 } else if (cdev_power_budget < 0) {
                     cdev_power_budget = 0;
                 }
 
                 int max_cdev_vote;
-                if (!getCdevMaxRequest(binded_cdev_info_pair.first, &max_cdev_vote)) {
+                if (!getCdevMaxRequest(cdev_info.id, &max_cdev_vote)) {
                     return false;
                 }
 
-                const auto curr_cdev_vote =
-                        thermal_throttling_status_map_[temp.name].pid_cdev_request_map.at(
-                                binded_cdev_info_pair.first);
+                const auto curr_cdev_vote = *slot.pid_cdev_request;
 
                 if (!max_throttling) {
-                    if (binded_cdev_info_pair.second.max_release_step !=
-                                std::numeric_limits<int>::max() &&
+                    if (binded_cdev_info.max_release_step != std::numeric_limits<int>::max() &&
                         (power_data_invalid || cdev_power_adjustment > 0)) {
                         if (!power_data_invalid && curr_cdev_vote < max_cdev_vote) {
-                            cdev_power_budget = cdev_info.state2power[curr_cdev_vote];
-                            LOG(VERBOSE) << temp.name << "'s " << binded_cdev_info_pair.first
+                            cdev_power_budget = state_power(curr_cdev_vote);
+                            LOG(VERBOSE) << temp.name << "'s " << slot.cdev_name
                                          << " vote: " << curr_cdev_vote
                                          << " is lower than max cdev vote: " << max_cdev_vote;
                         } else {
-                            int target_release_step = binded_cdev_info_pair.second.max_release_step;
+                            int target_release_step = binded_cdev_info.max_release_step;
                             while ((curr_cdev_vote - target_release_step) >
-                                           binded_cdev_info_pair.second
-                                                   .limit_info[static_cast<size_t>(
-                                                           curr_severity)] &&
-                                   cdev_info.state2power[curr_cdev_vote - target_release_step] ==
-                                           cdev_info.state2power[curr_cdev_vote]) {
+                                           binded_cdev_info.limit_info[severity] &&
+                                   state_power(curr_cdev_vote - target_release_step) ==
+                                           state_power(curr_cdev_vote)) {
                                 target_release_step += 1;
                             }
                             const auto target_state =
                                     std::max(curr_cdev_vote - target_release_step, 0);
 
                             cdev_power_budget = std::min(cdev_power_budget,
-                                                         cdev_info.state2power[target_state]);
+                                                         state_power(target_state));
                         }
                     }
 
-                    if (binded_cdev_info_pair.second.max_throttle_step !=
-                                std::numeric_limits<int>::max() &&
+                    if (binded_cdev_info.max_throttle_step != std::numeric_limits<int>::max() &&
                         (power_data_invalid || cdev_power_adjustment < 0)) {
-                        int target_throttle_step = binded_cdev_info_pair.second.max_throttle_step;
+                        int target_throttle_step = binded_cdev_info.max_throttle_step;
                         while ((curr_cdev_vote + target_throttle_step) <
-                                       binded_cdev_info_pair.second
-                                               .cdev_ceiling[static_cast<size_t>(curr_severity)] &&
-                               cdev_info.state2power[curr_cdev_vote + target_throttle_step] ==
-                                       cdev_info.state2power[curr_cdev_vote]) {
+                                       binded_cdev_info.cdev_ceiling[severity] &&
+                               state_power(curr_cdev_vote + target_throttle_step) ==
+                                       state_power(curr_cdev_vote)) {
                             target_throttle_step += 1;
                         }
-                        const auto target_state =
-                                std::min(curr_cdev_vote + target_throttle_step,
-                                         binded_cdev_info_pair.second
-                                                 .cdev_ceiling[static_cast<size_t>(curr_severity)]);
-                        cdev_power_budget =
-                                std::max(cdev_power_budget, cdev_info.state2power[target_state]);
+                        const auto target_state = std::min(curr_cdev_vote + target_throttle_step,
+                                                           binded_cdev_info.cdev_ceiling[severity]);
+                        cdev_power_budget = std::max(cdev_power_budget, state_power(target_state));
                     }
                 }
 
-                thermal_throttling_status_map_[temp.name].pid_power_budget_map.at(
-                        binded_cdev_info_pair.first) = cdev_power_budget;
-                LOG(VERBOSE) << temp.name << " allocate "
-                             << thermal_throttling_status_map_[temp.name].pid_power_budget_map.at(
-                                        binded_cdev_info_pair.first)
-                             << "mW to " << binded_cdev_info_pair.first
-                             << "(cdev_weight=" << cdev_weight << ")";
+                *slot.pid_power_budget = cdev_power_budget;
+                LOG(VERBOSE) << temp.name << " allocate " << *slot.pid_power_budget << "mW to "
+                             << slot.cdev_name << "(cdev_weight=" << cdev_weight << ")";
             }
         }
 
@@ -585,52 +687,48 @@ bool ThermalThrottling::allocatePowerToCdev(
     return true;
 }
 
-void ThermalThrottling::updateCdevRequestByPower(
-        std::string sensor_name,
-        const std::unordered_map<std::string, CdevInfo> &cooling_device_info_map) {
-    size_t i;
-
+void ThermalThrottling::updateCdevRequestByPower(const SensorInfo &sensor_info) {
     std::unique_lock<std::shared_mutex> _lock(thermal_throttling_status_map_mutex_);
-    for (auto &pid_power_budget_pair :
-         thermal_throttling_status_map_[sensor_name.data()].pid_power_budget_map) {
-        const CdevInfo &cdev_info = cooling_device_info_map.at(pid_power_budget_pair.first);
-
-        for (i = 0; i < cdev_info.state2power.size() - 1; ++i) {
-            if (pid_power_budget_pair.second >= cdev_info.state2power[i]) {
-                break;
-            }
-        }
-        thermal_throttling_status_map_[sensor_name.data()].pid_cdev_request_map.at(
-                pid_power_budget_pair.first) = static_cast<int>(i);
+    // The default profile has every cooling device the PID registered
+    for (const auto &slot : pid_cdev_slots_by_id_[sensor_info.id].binded) {
+        *slot.pid_cdev_request = cdev_power_tables_.powerToState(
+                slot.cdev_info->id, static_cast<float>(*slot.pid_power_budget));
     }
+}
 
-    return;
+void ThermalThrottling::updateCdevPowerTable(size_t cdev_id,
+                                             const std::vector<float> &state2power) {
+    std::unique_lock<std::shared_mutex> _lock(thermal_throttling_status_map_mutex_);
+    cdev_power_tables_.set(cdev_id, state2power);
+}
+
+std::vector<float> ThermalThrottling::getCdevPowerTable(size_t cdev_id) const {
+    std::shared_lock<std::shared_mutex> _lock(thermal_throttling_status_map_mutex_);
+    return cdev_power_tables_.get(cdev_id);
 }
 
 void ThermalThrottling::updateCdevRequestBySeverity(std::string_view sensor_name,
                                                     const SensorInfo &sensor_info,
                                                     ThrottlingSeverity curr_severity) {
     std::unique_lock<std::shared_mutex> _lock(thermal_throttling_status_map_mutex_);
-    const auto &profile = thermal_throttling_status_map_[sensor_name.data()].profile;
+    auto &throttling_status = *getThrottlingStatus(sensor_info);
+    const auto &profile = throttling_status.profile;
 
     for (const auto &binded_cdev_info_pair :
          (sensor_info.throttling_info->profile_map.count(profile)
                   ? sensor_info.throttling_info->profile_map.at(profile)
                   : sensor_info.throttling_info->binded_cdev_info_map)) {
-        if (!thermal_throttling_status_map_[sensor_name.data()].hardlimit_cdev_request_map.count(
-                    binded_cdev_info_pair.first)) {
+        auto request_itr =
+                throttling_status.hardlimit_cdev_request_map.find(binded_cdev_info_pair.first);
+        if (request_itr == throttling_status.hardlimit_cdev_request_map.end()) {
             continue;
         }
-        thermal_throttling_status_map_[sensor_name.data()].hardlimit_cdev_request_map.at(
-                binded_cdev_info_pair.first) =
-                (binded_cdev_info_pair.second.enabled)
-                        ? binded_cdev_info_pair.second
-                                  .limit_info[static_cast<size_t>(curr_severity)]
-                        : 0;
+        request_itr->second = (binded_cdev_info_pair.second.enabled)
+                                      ? binded_cdev_info_pair.second
+                                                .limit_info[static_cast<size_t>(curr_severity)]
+                                      : 0;
         LOG(VERBOSE) << "Hard Limit: Sensor " << sensor_name.data() << " update cdev "
-                     << binded_cdev_info_pair.first << " to "
-                     << thermal_throttling_status_map_[sensor_name.data()]
-                                .hardlimit_cdev_request_map.at(binded_cdev_info_pair.first);
+                     << binded_cdev_info_pair.first << " to " << request_itr->second;
     }
 }
 
@@ -641,10 +739,11 @@ bool ThermalThrottling::throttlingReleaseUpdate(
         const ThrottlingSeverity severity, const SensorInfo &sensor_info) {
     ATRACE_CALL();
     std::unique_lock<std::shared_mutex> _lock(thermal_throttling_status_map_mutex_);
-    if (!thermal_throttling_status_map_.count(sensor_name.data())) {
+    auto *throttling_status = getThrottlingStatus(sensor_info);
+    if (throttling_status == nullptr) {
         return false;
     }
-    auto &thermal_throttling_status = thermal_throttling_status_map_.at(sensor_name.data());
+    auto &thermal_throttling_status = *throttling_status;
     for (const auto &binded_cdev_info_pair : sensor_info.throttling_info->binded_cdev_info_map) {
         float avg_power = -1;
 
@@ -682,13 +781,12 @@ bool ThermalThrottling::throttlingReleaseUpdate(
                   << ": power threshold = "
                   << binded_cdev_info_pair.second.power_thresholds[static_cast<int>(severity)]
                   << ", avg power = " << avg_power;
-        std::string atrace_prefix = ::android::base::StringPrintf(
-                "%s-%s", sensor_name.data(), binded_cdev_info_pair.second.power_rail.data());
-        ATRACE_INT(
-                (atrace_prefix + std::string("-power_threshold")).c_str(),
+        const char *power_rail = binded_cdev_info_pair.second.power_rail.c_str();
+        PIXEL_TRACE_INT_F(
                 static_cast<int>(
-                        binded_cdev_info_pair.second.power_thresholds[static_cast<int>(severity)]));
-        ATRACE_INT((atrace_prefix + std::string("-avg_power")).c_str(), avg_power);
+                        binded_cdev_info_pair.second.power_thresholds[static_cast<int>(severity)]),
+                "%s-%s-power_threshold", sensor_name.data(), power_rail);
+        PIXEL_TRACE_INT_F(avg_power, "%s-%s-avg_power", sensor_name.data(), power_rail);
 
         switch (binded_cdev_info_pair.second.release_logic) {
             case ReleaseLogic::INCREASE:
@@ -737,7 +835,8 @@ void ThermalThrottling::thermalThrottlingUpdate(
         const std::unordered_map<std::string, PowerStatus> &power_status_map,
         const std::unordered_map<std::string, CdevInfo> &cooling_device_info_map,
         const bool max_throttling, const std::vector<float> &sensor_predictions) {
-    if (!thermal_throttling_status_map_.count(temp.name)) {
+    auto *throttling_status = getThrottlingStatus(sensor_info);
+    if (throttling_status == nullptr) {
         return;
     }
 
@@ -745,25 +844,24 @@ void ThermalThrottling::thermalThrottlingUpdate(
         parseProfileProperty(temp.name.c_str(), sensor_info);
     }
 
-    if (thermal_throttling_status_map_[temp.name].pid_power_budget_map.size()) {
+    if (throttling_status->pid_power_budget_map.size()) {
         if (!allocatePowerToCdev(temp, sensor_info, curr_severity, time_elapsed_ms,
                                  power_status_map, cooling_device_info_map, max_throttling,
                                  sensor_predictions)) {
             LOG(ERROR) << "Sensor " << temp.name << " PID request cdev failed";
             // Clear the CDEV request if the power budget is failed to be allocated
-            for (auto &pid_cdev_request_pair :
-                 thermal_throttling_status_map_[temp.name].pid_cdev_request_map) {
+            for (auto &pid_cdev_request_pair : throttling_status->pid_cdev_request_map) {
                 pid_cdev_request_pair.second = 0;
             }
         }
-        updateCdevRequestByPower(temp.name, cooling_device_info_map);
+        updateCdevRequestByPower(sensor_info);
     }
 
-    if (thermal_throttling_status_map_[temp.name].hardlimit_cdev_request_map.size()) {
+    if (throttling_status->hardlimit_cdev_request_map.size()) {
         updateCdevRequestBySeverity(temp.name.c_str(), sensor_info, curr_severity);
     }
 
-    if (thermal_throttling_status_map_[temp.name].throttling_release_map.size()) {
+    if (throttling_status->throttling_release_map.size()) {
         throttlingReleaseUpdate(temp.name.c_str(), cooling_device_info_map, power_status_map,
                                 curr_severity, sensor_info);
     }
@@ -776,41 +874,29 @@ void ThermalThrottling::computeCoolingDevicesRequest(
     int release_step = 0;
     std::unique_lock<std::shared_mutex> _lock(thermal_throttling_status_map_mutex_);
 
-    if (!thermal_throttling_status_map_.count(sensor_name.data())) {
+    auto *throttling_status = getThrottlingStatus(sensor_info);
+    if (throttling_status == nullptr) {
         return;
     }
 
-    auto &thermal_throttling_status = thermal_throttling_status_map_.at(sensor_name.data());
-    const auto &cdev_release_map = thermal_throttling_status.throttling_release_map;
-
-    const auto &profile = thermal_throttling_status_map_[sensor_name.data()].profile;
-    const auto &binded_cdev_info_map =
-            sensor_info.throttling_info->profile_map.count(profile)
-                    ? sensor_info.throttling_info->profile_map.at(profile)
-                    : sensor_info.throttling_info->binded_cdev_info_map;
-
-    for (auto &cdev_request_pair : thermal_throttling_status.cdev_status_map) {
-        int pid_cdev_request = 0;
-        int hardlimit_cdev_request = 0;
-        const auto &cdev_name = cdev_request_pair.first;
-        const auto &binded_cdev_info = binded_cdev_info_map.at(cdev_name);
+    const auto &profile = throttling_status->profile;
+    const auto profile_itr = profile.empty()
+                                     ? sensor_info.throttling_info->profile_map.end()
+                                     : sensor_info.throttling_info->profile_map.find(profile);
+
+    for (auto &slot : cdev_request_slots_by_id_[sensor_info.id]) {
+        const int pid_cdev_request = slot.pid_cdev_request ? *slot.pid_cdev_request : 0;
+        const int hardlimit_cdev_request =
+                slot.hardlimit_cdev_request ? *slot.hardlimit_cdev_request : 0;
+        const auto &cdev_name = slot.cdev_name;
+        const auto &binded_cdev_info =
+                profile_itr != sensor_info.throttling_info->profile_map.end()
+                        ? profile_itr->second.at(cdev_name.data())
+                        : *slot.binded_cdev_info;
         const auto cdev_ceiling = binded_cdev_info.cdev_ceiling[static_cast<size_t>(curr_severity)];
         const auto cdev_floor =
                 binded_cdev_info.cdev_floor_with_power_link[static_cast<size_t>(curr_severity)];
-        release_step = 0;
-
-        if (thermal_throttling_status.pid_cdev_request_map.count(cdev_name)) {
-            pid_cdev_request = thermal_throttling_status.pid_cdev_request_map.at(cdev_name);
-        }
-
-        if (thermal_throttling_status.hardlimit_cdev_request_map.count(cdev_name)) {
-            hardlimit_cdev_request =
-                    thermal_throttling_status.hardlimit_cdev_request_map.at(cdev_name);
-        }
-
-        if (cdev_release_map.count(cdev_name)) {
-            release_step = cdev_release_map.at(cdev_name);
-        }
+        release_step = slot.release_step ? *slot.release_step : 0;
 
         LOG(VERBOSE) << sensor_name.data() << " binded cooling device " << cdev_name
                      << "'s pid_request=" << pid_cdev_request
@@ -818,14 +904,15 @@ void ThermalThrottling::computeCoolingDevicesRequest(
                      << " release_step=" << release_step
                      << " cdev_floor_with_power_link=" << cdev_floor
                      << " cdev_ceiling=" << cdev_ceiling;
-        std::string atrace_prefix =
-                ::android::base::StringPrintf("%s-%s", sensor_name.data(), cdev_name.data());
-        ATRACE_INT((atrace_prefix + std::string("-pid_request")).c_str(), pid_cdev_request);
-        ATRACE_INT((atrace_prefix + std::string("-hardlimit_request")).c_str(),
-                   hardlimit_cdev_request);
-        ATRACE_INT((atrace_prefix + std::string("-release_step")).c_str(), release_step);
-        ATRACE_INT((atrace_prefix + std::string("-cdev_floor")).c_str(), cdev_floor);
-        ATRACE_INT((atrace_prefix + std::string("-cdev_ceiling")).c_str(), cdev_ceiling);
+        PIXEL_TRACE_INT_F(pid_cdev_request, "%s-%s-pid_request", sensor_name.data(),
+                          cdev_name.data());
+        PIXEL_TRACE_INT_F(hardlimit_cdev_request, "%s-%s-hardlimit_request", sensor_name.data(),
+                          cdev_name.data());
+        PIXEL_TRACE_INT_F(release_step, "%s-%s-release_step", sensor_name.data(),
+                          cdev_name.data());
+        PIXEL_TRACE_INT_F(cdev_floor, "%s-%s-cdev_floor", sensor_name.data(), cdev_name.data());
+        PIXEL_TRACE_INT_F(cdev_ceiling, "%s-%s-cdev_ceiling", sensor_name.data(),
+                          cdev_name.data());
 
         auto request_state = std::max(pid_cdev_request, hardlimit_cdev_request);
         if (release_step) {
@@ -838,44 +925,51 @@ void ThermalThrottling::computeCoolingDevicesRequest(
             request_state = std::max(request_state, cdev_floor);
         }
         request_state = std::min(request_state, cdev_ceiling);
-        if (cdev_request_pair.second != request_state) {
-            ATRACE_INT((atrace_prefix + std::string("-final_request")).c_str(), request_state);
-            if (updateCdevMaxRequestAndNotifyIfChange(cdev_name, cdev_request_pair.second,
+        if (*slot.cdev_status != request_state) {
+            PIXEL_TRACE_INT_F(request_state, "%s-%s-final_request", sensor_name.data(),
+                              cdev_name.data());
+            if (updateCdevMaxRequestAndNotifyIfChange(slot.cdev_id, slot.request_index,
                                                       request_state)) {
                 cooling_devices_to_update->emplace_back(cdev_name);
             }
-            cdev_request_pair.second = request_state;
+            *slot.cdev_status = request_state;
             // Update sensor cdev request time in state
-            thermal_stats_helper->updateSensorCdevRequestStats(sensor_name, cdev_name,
-                                                               cdev_request_pair.second);
+            thermal_stats_helper->updateSensorCdevRequestStats(sensor_info.id, slot.cdev_id,
+                                                               *slot.cdev_status);
         }
     }
 }
 
-bool ThermalThrottling::updateCdevMaxRequestAndNotifyIfChange(std::string_view cdev_name,
-                                                              int cur_request, int new_request) {
+bool ThermalThrottling::updateCdevMaxRequestAndNotifyIfChange(size_t cdev_id,
+                                                              size_t request_index,
+                                                              int new_request) {
     std::unique_lock<std::shared_mutex> _lock(cdev_all_request_map_mutex_);
-    auto &request_set = cdev_all_request_map_.at(cdev_name.data());
-    int cur_max_request = (*request_set.begin());
-    // Remove old cdev request and add the new one.
-    request_set.erase(request_set.find(cur_request));
-    request_set.insert(new_request);
+    auto &cdev_requests = cdev_all_requests_.at(cdev_id);
+    int cur_max_request = cdev_requests.max_request;
+    int &request = cdev_requests.requests.at(request_index);
+    const int cur_request = request;
+    request = new_request;
     // Check if there is any change in aggregated max cdev request.
-    int new_max_request = (*request_set.begin());
-    LOG(VERBOSE) << "For cooling device [" << cdev_name.data()
-                 << "] cur_max_request is: " << cur_max_request
+    if (new_request >= cur_max_request) {
+        cdev_requests.max_request = new_request;
+    } else if (cur_request == cur_max_request) {
+        cdev_requests.max_request =
+                *std::max_element(cdev_requests.requests.begin(), cdev_requests.requests.end());
+    }
+    int new_max_request = cdev_requests.max_request;
+    LOG(VERBOSE) << "For cooling device [" << cdev_id << "] cur_max_request is: " << cur_max_request
                  << " new_max_request is: " << new_max_request;
     return new_max_request != cur_max_request;
 }
 
-bool ThermalThrottling::getCdevMaxRequest(std::string_view cdev_name, int *max_state) {
+bool ThermalThrottling::getCdevMaxRequest(size_t cdev_id, int *max_state) {
     std::shared_lock<std::shared_mutex> _lock(cdev_all_request_map_mutex_);
-    if (!cdev_all_request_map_.count(cdev_name.data())) {
-        LOG(ERROR) << "Cooling device [" << cdev_name.data()
+    if (cdev_id >= cdev_all_requests_.size() || cdev_all_requests_[cdev_id].requests.empty()) {
+        LOG(ERROR) << "Cooling device [" << cdev_id
                    << "] not present in cooling device request map";
         return false;
     }
-    *max_state = *cdev_all_request_map_.at(cdev_name.data()).begin();
+    *max_state = cdev_all_requests_[cdev_id].max_request;
     return true;
 }
 
@@ -20,13 +20,14 @@
 
 #include <functional>
 #include <queue>
-#include <set>
 #include <shared_mutex>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "power_files.h"
+#include "thermal_cdev_power.h"
 #include "thermal_info.h"
 #include "thermal_stats_helper.h"
 
@@ -54,6 +55,12 @@ struct ThermalThrottlingStatus {
 // Return the control temp target of PID algorithm
 size_t getTargetStateOfPID(const SensorInfo &sensor_info, const ThrottlingSeverity curr_severity);
 
+// Return hot and cold severity status as std::pair
+std::pair<ThrottlingSeverity, ThrottlingSeverity> getSeverityFromThresholds(
+        const ThrottlingArray &hot_thresholds, const ThrottlingArray &cold_thresholds,
+        const ThrottlingArray &hot_hysteresis, const ThrottlingArray &cold_hysteresis,
+        ThrottlingSeverity prev_hot_severity, ThrottlingSeverity prev_cold_severity, float value);
+
 // A helper class for conducting thermal throttling
 class ThermalThrottling {
   public:
@@ -64,10 +71,10 @@ class ThermalThrottling {
     void operator=(const ThermalThrottling &) = delete;
 
     // Clear throttling data
-    void clearThrottlingData(std::string_view sensor_name);
+    void clearThrottlingData(const SensorInfo &sensor_info);
     // Register map for throttling algo
     bool registerThermalThrottling(
-            std::string_view sensor_name, const std::shared_ptr<ThrottlingInfo> &throttling_info,
+            std::string_view sensor_name, const SensorInfo &sensor_info,
             const std::unordered_map<std::string, CdevInfo> &cooling_device_info_map);
     // Get throttling status map
     const std::unordered_map<std::string, ThermalThrottlingStatus> &GetThermalThrottlingStatusMap()
@@ -75,6 +82,12 @@ class ThermalThrottling {
         std::shared_lock<std::shared_mutex> _lock(thermal_throttling_status_map_mutex_);
         return thermal_throttling_status_map_;
     }
+    // Copy of the throttling status map, for readers outside the watcher thread
+    std::unordered_map<std::string, ThermalThrottlingStatus> GetThermalThrottlingStatusSnapshot()
+            const {
+        std::shared_lock<std::shared_mutex> _lock(thermal_throttling_status_map_mutex_);
+        return thermal_throttling_status_map_;
+    }
     // Update thermal throttling request for the specific sensor
     void thermalThrottlingUpdate(
             const Temperature &temp, const SensorInfo &sensor_info,
@@ -90,9 +103,52 @@ class ThermalThrottling {
                                       std::vector<std::string> *cooling_devices_to_update,
                                       ThermalStatsHelper *thermal_stats_helper);
     // Get the aggregated (from all sensor) max request for a cooling device
-    bool getCdevMaxRequest(std::string_view cdev_name, int *max_state);
+    bool getCdevMaxRequest(size_t cdev_id, int *max_state);
+    // Replace the state2power table the PID uses for a cooling device, e.g. after its driver
+    // changed its frequency table
+    void updateCdevPowerTable(size_t cdev_id, const std::vector<float> &state2power);
+    std::vector<float> getCdevPowerTable(size_t cdev_id) const;
 
   private:
+    // A cooling device bound to a sensor, pointing at the entries of the
+    // sensor's ThermalThrottlingStatus maps
+    struct CdevRequestSlot {
+        std::string_view cdev_name;
+        size_t cdev_id;
+        // Index of the sensor's request in cdev_all_requests_[cdev_id]
+        size_t request_index;
+        int *cdev_status;
+        // nullptr if the cooling device isn't throttled that way
+        const int *pid_cdev_request;
+        const int *hardlimit_cdev_request;
+        const int *release_step;
+        const BindedCdevInfo *binded_cdev_info;
+    };
+    // A cooling device a sensor allocates its PID power budget to, in one of its
+    // throttling profiles, pointing at the entries of the sensor's
+    // ThermalThrottlingStatus maps
+    struct PidCdevSlot {
+        std::string_view cdev_name;
+        const BindedCdevInfo *binded_cdev_info;
+        const CdevInfo *cdev_info;
+        int *pid_power_budget;
+        int *pid_cdev_request;
+        // Set by allocatePowerToCdev once the cooling device got its budget
+        bool allocated;
+    };
+    // The PID cooling devices of a sensor, for the default profile and by profile name
+    struct PidCdevSlots {
+        std::vector<PidCdevSlot> binded;
+        std::unordered_map<std::string, std::vector<PidCdevSlot>> profiles;
+    };
+    // Build the PID slots of one profile, false if a cooling device isn't registered
+    bool makePidCdevSlots(std::string_view sensor_name,
+                          const std::unordered_map<std::string, BindedCdevInfo> &binded_cdevs,
+                          ThermalThrottlingStatus *throttling_status,
+                          const std::unordered_map<std::string, CdevInfo> &cooling_device_info_map,
+                          std::vector<PidCdevSlot> *slots);
+    // Return nullptr if the sensor has no throttling registered
+    ThermalThrottlingStatus *getThrottlingStatus(const SensorInfo &sensor_info);
     // Check if the thermal throttling profile need to be switched
     void parseProfileProperty(std::string_view sensor_name, const SensorInfo &sensor_info);
     // PID algo - get the total power budget
@@ -117,9 +173,7 @@ class ThermalThrottling {
             const std::unordered_map<std::string, CdevInfo> &cooling_device_info_map,
             const bool max_throttling, const std::vector<float> &sensor_predictions);
     // PID algo - map the target throttling state according to the power budget
-    void updateCdevRequestByPower(
-            std::string sensor_name,
-            const std::unordered_map<std::string, CdevInfo> &cooling_device_info_map);
+    void updateCdevRequestByPower(const SensorInfo &sensor_info);
     // Hard limit algo - assign the throttling state according to the severity
     void updateCdevRequestBySeverity(std::string_view sensor_name, const SensorInfo &sensor_info,
                                      ThrottlingSeverity curr_severity);
@@ -130,16 +184,29 @@ class ThermalThrottling {
             const std::unordered_map<std::string, CdevInfo> &cooling_device_info_map,
             const std::unordered_map<std::string, PowerStatus> &power_status_map,
             const ThrottlingSeverity severity, const SensorInfo &sensor_info);
-    // Update the cooling device request set for new request and notify the caller if there is
+    // Update the cooling device request of a sensor and notify the caller if there is
     // change in max_request for the cooling device.
-    bool updateCdevMaxRequestAndNotifyIfChange(std::string_view cdev_name, int cur_request,
+    bool updateCdevMaxRequestAndNotifyIfChange(size_t cdev_id, size_t request_index,
                                                int new_request);
     mutable std::shared_mutex thermal_throttling_status_map_mutex_;
-    // Thermal throttling status from each sensor
+    // Thermal throttling status from each sensor, keyed by name for dumps
     std::unordered_map<std::string, ThermalThrottlingStatus> thermal_throttling_status_map_;
+    // The same statuses and their cooling devices indexed by SensorInfo::id
+    std::vector<ThermalThrottlingStatus *> thermal_throttling_status_by_id_;
+    std::vector<std::vector<CdevRequestSlot>> cdev_request_slots_by_id_;
+    std::vector<PidCdevSlots> pid_cdev_slots_by_id_;
+    // The state2power tables of the PID cooling devices, loaded from their CdevInfo at
+    // registration
+    CdevPowerTables cdev_power_tables_;
     std::shared_mutex cdev_all_request_map_mutex_;
-    // Set of all request for a cooling device from each sensor
-    std::unordered_map<std::string, std::multiset<int, std::greater<int>>> cdev_all_request_map_;
+    // The request of each sensor bound to a cooling device, sized at registration
+    struct CdevRequests {
+        std::vector<int> requests;
+        // Max of requests, only rescanned when its holder lowers its request
+        int max_request = 0;
+    };
+    // All requests for a cooling device, indexed by CdevInfo::id
+    std::vector<CdevRequests> cdev_all_requests_;
 };
 
 }  // namespace implementation
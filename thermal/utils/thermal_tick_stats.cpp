@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG (ATRACE_TAG_THERMAL | ATRACE_TAG_HAL)
+
+#include "thermal_tick_stats.h"
+
+#include <pixeltrace/PixelTrace.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace thermal {
+namespace implementation {
+
+namespace {
+
+void updateMax(std::atomic<int64_t> *max, int64_t value) {
+    int64_t prev = max->load(std::memory_order_relaxed);
+    while (prev < value && !max->compare_exchange_weak(prev, value, std::memory_order_relaxed)) {
+    }
+}
+
+}  // namespace
+
+void LatencyHistogram::record(std::chrono::microseconds latency) {
+    const int64_t latency_us = std::max<int64_t>(latency.count(), 0);
+    const size_t bucket =
+            std::upper_bound(kBucketLimitsUs.begin(), kBucketLimitsUs.end(), latency_us) -
+            kBucketLimitsUs.begin();
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    total_us_.fetch_add(latency_us, std::memory_order_relaxed);
+    updateMax(&max_us_, latency_us);
+}
+
+void LatencyHistogram::dump(std::ostringstream *dump_buf) const {
+    const uint64_t count = count_.load(std::memory_order_relaxed);
+    *dump_buf << "Count: " << count
+              << " AvgUs: " << (count ? total_us_.load(std::memory_order_relaxed) / count : 0)
+              << " MaxUs: " << max_us_.load(std::memory_order_relaxed) << " [";
+    for (size_t i = 0; i < buckets_.size(); i++) {
+        const uint64_t bucket_count = buckets_[i].load(std::memory_order_relaxed);
+        if (bucket_count == 0) {
+            continue;
+        }
+        if (i < kBucketLimitsUs.size()) {
+            *dump_buf << " <" << kBucketLimitsUs[i] << "us:" << bucket_count;
+        } else {
+            *dump_buf << " >=" << kBucketLimitsUs.back() << "us:" << bucket_count;
+        }
+    }
+    *dump_buf << " ]";
+}
+
+void ThermalTickStats::init(std::vector<std::string> sensor_names) {
+    sensor_read_latency_ = std::make_unique<LatencyHistogram[]>(sensor_names.size());
+    sensor_names_ = std::move(sensor_names);
+}
+
+void ThermalTickStats::recordSensorRead(size_t sensor_node, std::chrono::microseconds latency) {
+    if (sensor_node >= sensor_names_.size()) {
+        return;
+    }
+    sensor_read_latency_[sensor_node].record(latency);
+    PIXEL_TRACE_INT_F(latency.count(), "%s-read_us", sensor_names_[sensor_node].c_str());
+}
+
+void ThermalTickStats::recordTick(const TickTiming &timing, std::chrono::milliseconds next_sleep) {
+    tick_latency_.record(timing.total);
+    throttling_update_latency_.record(timing.throttling_update);
+    cdev_update_latency_.record(timing.cdev_update);
+    last_tick_us_.store(timing.total.count(), std::memory_order_relaxed);
+    // A tick overruns when it takes longer than the sleep the previous tick asked for
+    if (tick_budget_ != std::chrono::milliseconds::max() && tick_budget_.count() > 0 &&
+        timing.total > tick_budget_) {
+        tick_overrun_count_.fetch_add(1, std::memory_order_relaxed);
+    }
+    last_tick_budget_ms_.store(
+            tick_budget_ == std::chrono::milliseconds::max() ? -1 : tick_budget_.count(),
+            std::memory_order_relaxed);
+    tick_budget_ = next_sleep;
+    ATRACE_INT64("ThermalHelper::tick_us", timing.total.count());
+}
+
+void ThermalTickStats::dump(std::ostringstream *dump_buf) const {
+    *dump_buf << "getThermalTickStats:" << std::endl;
+    *dump_buf << " LastTickUs: " << last_tick_us_.load(std::memory_order_relaxed)
+              << " LastBudgetMs: " << last_tick_budget_ms_.load(std::memory_order_relaxed)
+              << " Overruns: " << tick_overrun_count_.load(std::memory_order_relaxed)
+              << std::endl;
+    *dump_buf << " Tick: ";
+    tick_latency_.dump(dump_buf);
+    *dump_buf << std::endl << " ThrottlingUpdate: ";
+    throttling_update_latency_.dump(dump_buf);
+    *dump_buf << std::endl << " CdevUpdate: ";
+    cdev_update_latency_.dump(dump_buf);
+    *dump_buf << std::endl << " SensorReadLatency:" << std::endl;
+    for (size_t i = 0; i < sensor_names_.size(); i++) {
+        if (sensor_read_latency_[i].count() == 0) {
+            continue;
+        }
+        *dump_buf << "  " << sensor_names_[i] << ": ";
+        sensor_read_latency_[i].dump(dump_buf);
+        *dump_buf << std::endl;
+    }
+}
+
+}  // namespace implementation
+}  // namespace thermal
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace thermal {
+namespace implementation {
+
+// Latency histogram with fixed log scale buckets, safe to record from several threads
+class LatencyHistogram {
+  public:
+    // Upper bound of each bucket, the last bucket takes everything above
+    static constexpr std::array<int64_t, 9> kBucketLimitsUs = {100,   250,   500,   1000, 2500,
+                                                               5000, 10000, 25000, 50000};
+
+    void record(std::chrono::microseconds latency);
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t bucketCount(size_t bucket) const {
+        return buckets_[bucket].load(std::memory_order_relaxed);
+    }
+    void dump(std::ostringstream *dump_buf) const;
+
+  private:
+    std::array<std::atomic<uint64_t>, kBucketLimitsUs.size() + 1> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> total_us_{0};
+    std::atomic<int64_t> max_us_{0};
+};
+
+// Where the time of the watcher thread goes: per sensor read latency and the duration of each
+// tick against the interval the previous tick asked to sleep
+class ThermalTickStats {
+  public:
+    // How one watcher tick spent its time
+    struct TickTiming {
+        std::chrono::microseconds total;
+        std::chrono::microseconds throttling_update;
+        std::chrono::microseconds cdev_update;
+    };
+
+    // Size the per sensor histograms, before any read is recorded
+    void init(std::vector<std::string> sensor_names);
+    // A sensor read which missed the cache, sensor_node indexes the names given to init
+    void recordSensorRead(size_t sensor_node, std::chrono::microseconds latency);
+    // Record a tick, next_sleep is what the tick returned to the watcher
+    void recordTick(const TickTiming &timing, std::chrono::milliseconds next_sleep);
+    void dump(std::ostringstream *dump_buf) const;
+
+  private:
+    std::vector<std::string> sensor_names_;
+    std::unique_ptr<LatencyHistogram[]> sensor_read_latency_;
+    LatencyHistogram tick_latency_;
+    LatencyHistogram throttling_update_latency_;
+    LatencyHistogram cdev_update_latency_;
+    // Only written by the watcher thread
+    std::chrono::milliseconds tick_budget_ = std::chrono::milliseconds::max();
+    std::atomic<uint64_t> tick_overrun_count_{0};
+    std::atomic<int64_t> last_tick_us_{0};
+    std::atomic<int64_t> last_tick_budget_ms_{-1};
+};
+
+}  // namespace implementation
+}  // namespace thermal
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "thermal_trace.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/parsedouble.h>
+#include <android-base/stringprintf.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sstream>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace thermal {
+namespace implementation {
+
+namespace {
+
+constexpr size_t kTraceFlushSize = 64 * 1024;
+
+}  // namespace
+
+ThermalTraceRecorder::~ThermalTraceRecorder() {
+    flush();
+}
+
+bool ThermalTraceRecorder::open(std::string_view path) {
+    fd_.reset(TEMP_FAILURE_RETRY(
+            ::open(path.data(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600)));
+    if (!fd_.ok()) {
+        PLOG(ERROR) << "Failed to open thermal trace " << path;
+        return false;
+    }
+    buffer_.reserve(kTraceFlushSize * 2);
+    LOG(INFO) << "Recording thermal trace to " << path;
+    return true;
+}
+
+void ThermalTraceRecorder::beginTick(const boot_clock::time_point &now) {
+    ::android::base::StringAppendF(
+            &buffer_, "T %lld\n",
+            static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                           now.time_since_epoch())
+                                           .count()));
+}
+
+void ThermalTraceRecorder::recordSensorReading(std::string_view sensor_name, float value) {
+    ::android::base::StringAppendF(&buffer_, "S %s %.9g\n", sensor_name.data(), value);
+}
+
+void ThermalTraceRecorder::recordEnergySample(std::string_view power_rail,
+                                              const PowerSample &sample) {
+    ::android::base::StringAppendF(&buffer_, "E %s %llu %llu\n", power_rail.data(),
+                                   static_cast<unsigned long long>(sample.energy_counter),
+                                   static_cast<unsigned long long>(sample.duration));
+}
+
+void ThermalTraceRecorder::recordSensorUpdate(std::string_view sensor_name) {
+    buffer_.append("U ").append(sensor_name).append("\n");
+}
+
+void ThermalTraceRecorder::endTick() {
+    if (buffer_.size() >= kTraceFlushSize) {
+        flush();
+    }
+}
+
+void ThermalTraceRecorder::flush() {
+    if (!fd_.ok() || buffer_.empty()) {
+        buffer_.clear();
+        return;
+    }
+    if (!::android::base::WriteFully(fd_, buffer_.data(), buffer_.size())) {
+        PLOG(ERROR) << "Failed to write thermal trace, stop recording";
+        fd_.reset();
+    }
+    buffer_.clear();
+}
+
+bool ParseThermalTrace(std::string_view path, std::vector<ThermalTraceTick> *ticks) {
+    std::string content;
+    if (!::android::base::ReadFileToString(path.data(), &content)) {
+        LOG(ERROR) << "Failed to read thermal trace " << path;
+        return false;
+    }
+
+    std::istringstream lines(content);
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(lines, line)) {
+        ++line_number;
+        if (line.empty()) {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string tag;
+        fields >> tag;
+        bool parsed = false;
+        if (tag == "T") {
+            long long time_ms;
+            if (fields >> time_ms) {
+                ticks->emplace_back();
+                ticks->back().time = std::chrono::milliseconds(time_ms);
+                parsed = true;
+            }
+        } else if (!ticks->empty() && tag == "S") {
+            std::string sensor_name;
+            std::string value_str;
+            float value;
+            // A sensor reads nan while its data is collected, which operator>> rejects
+            if (fields >> sensor_name >> value_str &&
+                ::android::base::ParseFloat(value_str, &value)) {
+                ticks->back().sensor_readings.emplace_back(std::move(sensor_name), value);
+                parsed = true;
+            }
+        } else if (!ticks->empty() && tag == "E") {
+            std::string power_rail;
+            PowerSample sample;
+            if (fields >> power_rail >> sample.energy_counter >> sample.duration) {
+                ticks->back().energy_samples.emplace_back(std::move(power_rail), sample);
+                parsed = true;
+            }
+        } else if (!ticks->empty() && tag == "U") {
+            std::string sensor_name;
+            if (fields >> sensor_name) {
+                ticks->back().updated_sensors.push_back(std::move(sensor_name));
+                parsed = true;
+            }
+        }
+        if (!parsed) {
+            LOG(ERROR) << "Malformed thermal trace line " << line_number << ": " << line;
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace implementation
+}  // namespace thermal
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
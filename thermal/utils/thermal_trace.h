@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/chrono_utils.h>
+#include <android-base/unique_fd.h>
+
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "power_files.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace thermal {
+namespace implementation {
+
+using ::android::base::boot_clock;
+
+// One pass of the thermal watcher callback, as recorded by ThermalTraceRecorder.
+// The trace is line based text, each tick starts with "T <boot time ms>" followed by
+//   "S <sensor> <value>" for a raw sensor read from sysfs,
+//   "E <rail> <energy counter> <duration>" for an ODPM sample after a power refresh,
+//   "U <sensor>" for a sensor which went through the throttling update, in update order.
+struct ThermalTraceTick {
+    std::chrono::milliseconds time;
+    std::vector<std::pair<std::string, float>> sensor_readings;
+    std::vector<std::pair<std::string, PowerSample>> energy_samples;
+    std::vector<std::string> updated_sensors;
+};
+
+// Records the inputs of the throttling path into a trace file. Lines are kept in memory and
+// written in large chunks, so a recording HAL costs a few string appends per sensor read.
+class ThermalTraceRecorder {
+  public:
+    ThermalTraceRecorder() = default;
+    ~ThermalTraceRecorder();
+    // Disallow copy and assign.
+    ThermalTraceRecorder(const ThermalTraceRecorder &) = delete;
+    void operator=(const ThermalTraceRecorder &) = delete;
+
+    // Start appending to the trace at path, return false if it cannot be opened
+    bool open(std::string_view path);
+    bool isRecording() const { return fd_.ok(); }
+
+    void beginTick(const boot_clock::time_point &now);
+    void recordSensorReading(std::string_view sensor_name, float value);
+    void recordEnergySample(std::string_view power_rail, const PowerSample &sample);
+    void recordSensorUpdate(std::string_view sensor_name);
+    // Write the buffered lines out once enough of them are pending
+    void endTick();
+
+  private:
+    void flush();
+
+    ::android::base::unique_fd fd_;
+    std::string buffer_;
+};
+
+// Parse a trace written by ThermalTraceRecorder, return false on malformed lines
+bool ParseThermalTrace(std::string_view path, std::vector<ThermalTraceTick> *ticks);
+
+}  // namespace implementation
+}  // namespace thermal
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -28,9 +28,13 @@
 #include <linux/thermal.h>
 #include <sys/inotify.h>
 #include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
+#include <unistd.h>
 #include <utils/Trace.h>
 
+#include <array>
 #include <chrono>
 #include <fstream>
 
@@ -44,6 +48,10 @@ namespace implementation {
 
 namespace {
 
+// Thermal genl messages received by one recvmmsg call, and the size of each buffer
+constexpr size_t kGenlBatchSize = 16;
+constexpr size_t kGenlMsgLen = 8192;
+
 static int nlErrorHandle(struct sockaddr_nl *nla, struct nlmsgerr *err, void *arg) {
     int *ret = reinterpret_cast<int *>(arg);
     *ret = err->error;
@@ -72,16 +80,6 @@ static int nlAckHandle(struct nl_msg *msg, void *arg) {
     return NL_OK;
 }
 
-static int nlSeqCheckHandle(struct nl_msg *msg, void *arg) {
-    int *ret = reinterpret_cast<int *>(arg);
-    *ret = 1;
-    struct nlmsghdr *nlh = nlmsg_hdr(msg);
-
-    LOG(VERBOSE) << __func__ << ": nlmsg type: " << nlh->nlmsg_type;
-
-    return NL_OK;
-}
-
 struct HandlerArgs {
     const char *group;
     int id;
@@ -186,19 +184,22 @@ static bool socketAddMembership(struct nl_sock *sock, const char *group) {
     return true;
 }
 
-static int handleEvent(struct nl_msg *n, void *arg) {
-    struct nlmsghdr *nlh = nlmsg_hdr(n);
+// Parse one thermal genl event in place, return the thermal zone id it concerns or -1
+static int handleEvent(struct nlmsghdr *nlh) {
     struct genlmsghdr *glh = genlmsg_hdr(nlh);
     struct nlattr *attrs[THERMAL_GENL_ATTR_MAX + 1];
-    int *tz_id = reinterpret_cast<int *>(arg);
+    int tz_id = -1;
 
-    genlmsg_parse(nlh, 0, attrs, THERMAL_GENL_ATTR_MAX, NULL);
+    if (genlmsg_parse(nlh, 0, attrs, THERMAL_GENL_ATTR_MAX, NULL) < 0) {
+        LOG(ERROR) << "Failed to parse thermal genl event";
+        return tz_id;
+    }
 
     if (glh->cmd == THERMAL_GENL_EVENT_TZ_TRIP_UP) {
         LOG(INFO) << "THERMAL_GENL_EVENT_TZ_TRIP_UP";
         if (attrs[THERMAL_GENL_ATTR_TZ_ID]) {
             LOG(INFO) << "Thermal zone id: " << nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
-            *tz_id = nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
+            tz_id = nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
         }
         if (attrs[THERMAL_GENL_ATTR_TZ_TRIP_ID])
             LOG(INFO) << "Thermal zone trip id: "
@@ -209,7 +210,7 @@ static int handleEvent(struct nl_msg *n, void *arg) {
         LOG(INFO) << "THERMAL_GENL_EVENT_TZ_TRIP_DOWN";
         if (attrs[THERMAL_GENL_ATTR_TZ_ID]) {
             LOG(INFO) << "Thermal zone id: " << nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
-            *tz_id = nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
+            tz_id = nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
         }
         if (attrs[THERMAL_GENL_ATTR_TZ_TRIP_ID])
             LOG(INFO) << "Thermal zone trip id: "
@@ -220,7 +221,7 @@ static int handleEvent(struct nl_msg *n, void *arg) {
         LOG(INFO) << "THERMAL_GENL_EVENT_TZ_GOV_CHANGE";
         if (attrs[THERMAL_GENL_ATTR_TZ_ID]) {
             LOG(INFO) << "Thermal zone id: " << nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
-            *tz_id = nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
+            tz_id = nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
         }
         if (attrs[THERMAL_GENL_ATTR_GOV_NAME])
             LOG(INFO) << "Governor name: " << nla_get_string(attrs[THERMAL_GENL_ATTR_GOV_NAME]);
@@ -230,7 +231,7 @@ static int handleEvent(struct nl_msg *n, void *arg) {
         LOG(INFO) << "THERMAL_GENL_EVENT_TZ_CREATE";
         if (attrs[THERMAL_GENL_ATTR_TZ_ID]) {
             LOG(INFO) << "Thermal zone id: " << nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
-            *tz_id = nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
+            tz_id = nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
         }
         if (attrs[THERMAL_GENL_ATTR_TZ_NAME])
             LOG(INFO) << "Thermal zone name: " << nla_get_string(attrs[THERMAL_GENL_ATTR_TZ_NAME]);
@@ -240,7 +241,7 @@ static int handleEvent(struct nl_msg *n, void *arg) {
         LOG(INFO) << "THERMAL_GENL_EVENT_TZ_DELETE";
         if (attrs[THERMAL_GENL_ATTR_TZ_ID]) {
             LOG(INFO) << "Thermal zone id: " << nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
-            *tz_id = nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
+            tz_id = nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
         }
     }
 
@@ -248,7 +249,7 @@ static int handleEvent(struct nl_msg *n, void *arg) {
         LOG(INFO) << "THERMAL_GENL_EVENT_TZ_DISABLE";
         if (attrs[THERMAL_GENL_ATTR_TZ_ID]) {
             LOG(INFO) << "Thermal zone id: " << nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
-            *tz_id = nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
+            tz_id = nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
         }
     }
 
@@ -256,7 +257,7 @@ static int handleEvent(struct nl_msg *n, void *arg) {
         LOG(INFO) << "THERMAL_GENL_EVENT_TZ_ENABLE";
         if (attrs[THERMAL_GENL_ATTR_TZ_ID]) {
             LOG(INFO) << "Thermal zone id: " << nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
-            *tz_id = nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
+            tz_id = nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
         }
     }
 
@@ -264,7 +265,7 @@ static int handleEvent(struct nl_msg *n, void *arg) {
         LOG(INFO) << "THERMAL_GENL_EVENT_TZ_TRIP_CHANGE";
         if (attrs[THERMAL_GENL_ATTR_TZ_ID]) {
             LOG(INFO) << "Thermal zone id: " << nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
-            *tz_id = nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
+            tz_id = nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
         }
         if (attrs[THERMAL_GENL_ATTR_TZ_TRIP_ID])
             LOG(INFO) << "Trip id:: " << nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_TRIP_ID]);
@@ -294,7 +295,7 @@ static int handleEvent(struct nl_msg *n, void *arg) {
         LOG(INFO) << "THERMAL_GENL_EVENT_TZ_TRIP_DELETE";
         if (attrs[THERMAL_GENL_ATTR_TZ_ID]) {
             LOG(INFO) << "Thermal zone id: " << nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
-            *tz_id = nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
+            tz_id = nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
         }
         if (attrs[THERMAL_GENL_ATTR_TZ_TRIP_ID])
             LOG(INFO) << "Trip id:: " << nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_TRIP_ID]);
@@ -330,20 +331,36 @@ static int handleEvent(struct nl_msg *n, void *arg) {
         LOG(INFO) << "THERMAL_GENL_SAMPLING_TEMP";
         if (attrs[THERMAL_GENL_ATTR_TZ_ID]) {
             LOG(INFO) << "Thermal zone id: " << nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
-            *tz_id = nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
+            tz_id = nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_ID]);
         }
         if (attrs[THERMAL_GENL_ATTR_TZ_TEMP])
             LOG(INFO) << "Thermal zone temp: " << nla_get_u32(attrs[THERMAL_GENL_ATTR_TZ_TEMP]);
     }
 
-    return 0;
+    return tz_id;
 }
 
 }  // namespace
 
-void ThermalWatcher::registerFilesToWatch(const std::set<std::string> &sensors_to_watch) {
+void ThermalWatcher::addWatchedSensors(const std::vector<WatchedSensor> &sensors_to_watch) {
+    size_t sensor_count = 0;
+    for (const auto &sensor : sensors_to_watch) {
+        monitored_sensors_[sensor.name] = sensor.index;
+        sensor_count = std::max(sensor_count, sensor.index + 1);
+        if (sensor.tz_id < 0) {
+            continue;
+        }
+        if (tz_id_to_sensor_.size() <= static_cast<size_t>(sensor.tz_id)) {
+            tz_id_to_sensor_.resize(sensor.tz_id + 1, kNoSensor);
+        }
+        tz_id_to_sensor_[sensor.tz_id] = sensor.index;
+    }
+    triggered_sensors_.resize(sensor_count);
+}
+
+void ThermalWatcher::registerFilesToWatch(const std::vector<WatchedSensor> &sensors_to_watch) {
     LOG(INFO) << "Uevent register file to watch...";
-    monitored_sensors_.insert(sensors_to_watch.begin(), sensors_to_watch.end());
+    addWatchedSensors(sensors_to_watch);
 
     uevent_fd_.reset((TEMP_FAILURE_RETRY(uevent_open_socket(64 * 1024, true))));
     if (uevent_fd_.get() < 0) {
@@ -358,9 +375,9 @@ void ThermalWatcher::registerFilesToWatch(const std::set<std::string> &sensors_t
     last_update_time_ = boot_clock::now();
 }
 
-void ThermalWatcher::registerFilesToWatchNl(const std::set<std::string> &sensors_to_watch) {
+void ThermalWatcher::registerFilesToWatchNl(const std::vector<WatchedSensor> &sensors_to_watch) {
     LOG(INFO) << "Thermal genl register file to watch...";
-    monitored_sensors_.insert(sensors_to_watch.begin(), sensors_to_watch.end());
+    addWatchedSensors(sensors_to_watch);
 
     sk_thermal = nl_socket_alloc();
     if (!sk_thermal) {
@@ -394,6 +411,7 @@ void ThermalWatcher::registerFilesToWatchNl(const std::set<std::string> &sensors
     */
 
     fcntl(thermal_genl_fd_, F_SETFL, O_NONBLOCK);
+    genl_buffer_.resize(kGenlBatchSize * kGenlMsgLen);
     looper_->addFd(thermal_genl_fd_.get(), 0, ::android::Looper::EVENT_INPUT, nullptr, nullptr);
     sleep_ms_ = std::chrono::milliseconds(0);
     last_update_time_ = boot_clock::now();
@@ -401,6 +419,13 @@ void ThermalWatcher::registerFilesToWatchNl(const std::set<std::string> &sensors
 
 bool ThermalWatcher::startWatchingDeviceFiles() {
     if (cb_) {
+        // Without the timer the looper timeout wakes the thread instead
+        timer_fd_.reset(timerfd_create(CLOCK_BOOTTIME, TFD_NONBLOCK | TFD_CLOEXEC));
+        if (timer_fd_.get() < 0) {
+            PLOG(ERROR) << "failed to create watcher timerfd";
+        } else {
+            looper_->addFd(timer_fd_.get(), 0, ::android::Looper::EVENT_INPUT, nullptr, nullptr);
+        }
         auto ret = this->run("FileWatcherThread", -10);
         if (ret != ::android::NO_ERROR) {
             LOG(ERROR) << "ThermalWatcherThread start fail";
@@ -412,7 +437,7 @@ bool ThermalWatcher::startWatchingDeviceFiles() {
     }
     return false;
 }
-void ThermalWatcher::parseUevent(std::set<std::string> *sensors_set) {
+void ThermalWatcher::parseUevent(TriggeredSensors *triggered_sensors) {
     bool thermal_event = false;
     constexpr int kUeventMsgLen = 2048;
     char msg[kUeventMsgLen + 2];
@@ -451,9 +476,9 @@ void ThermalWatcher::parseUevent(std::set<std::string> *sensors_set) {
                 auto start_pos = uevent.find("NAME=");
                 if (start_pos != std::string::npos) {
                     start_pos += 5;
-                    std::string name = uevent.substr(start_pos);
-                    if (monitored_sensors_.find(name) != monitored_sensors_.end()) {
-                        sensors_set->insert(name);
+                    const auto sensor_itr = monitored_sensors_.find(uevent.substr(start_pos));
+                    if (sensor_itr != monitored_sensors_.end()) {
+                        triggered_sensors->set(sensor_itr->second);
                     }
                     break;
                 }
@@ -466,28 +491,62 @@ void ThermalWatcher::parseUevent(std::set<std::string> *sensors_set) {
 
 // TODO(b/175367921): Consider for potentially adding more type of event in the function
 // instead of just add the sensors to the list.
-void ThermalWatcher::parseGenlink(std::set<std::string> *sensors_set) {
-    int err = 0, done = 0, tz_id = -1;
-
-    std::unique_ptr<nl_cb, decltype(&nl_cb_put)> cb(nl_cb_alloc(NL_CB_DEFAULT), nl_cb_put);
+void ThermalWatcher::parseGenlink(TriggeredSensors *triggered_sensors) {
+    std::array<struct mmsghdr, kGenlBatchSize> msgs;
+    std::array<struct iovec, kGenlBatchSize> iovs;
 
-    nl_cb_err(cb.get(), NL_CB_CUSTOM, nlErrorHandle, &err);
-    nl_cb_set(cb.get(), NL_CB_FINISH, NL_CB_CUSTOM, nlFinishHandle, &done);
-    nl_cb_set(cb.get(), NL_CB_ACK, NL_CB_CUSTOM, nlAckHandle, &done);
-    nl_cb_set(cb.get(), NL_CB_SEQ_CHECK, NL_CB_CUSTOM, nlSeqCheckHandle, &done);
-    nl_cb_set(cb.get(), NL_CB_VALID, NL_CB_CUSTOM, handleEvent, &tz_id);
-
-    while (!done && !err) {
-        nl_recvmsgs(sk_thermal, cb.get());
-
-        if (tz_id < 0) {
+    while (true) {
+        for (size_t i = 0; i < kGenlBatchSize; i++) {
+            iovs[i] = {.iov_base = &genl_buffer_[i * kGenlMsgLen], .iov_len = kGenlMsgLen};
+            msgs[i] = {};
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        const int n = TEMP_FAILURE_RETRY(recvmmsg(thermal_genl_fd_.get(), msgs.data(),
+                                                  kGenlBatchSize, MSG_DONTWAIT, nullptr));
+        if (n <= 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                PLOG(ERROR) << "Error reading from thermal genl Fd";
+            }
             break;
         }
 
-        std::string name;
-        if (getThermalZoneTypeById(tz_id, &name) &&
-            monitored_sensors_.find(name) != monitored_sensors_.end()) {
-            sensors_set->insert(name);
+        for (int i = 0; i < n; i++) {
+            if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                LOG(ERROR) << "Thermal genl message overflowed buffer, discarding";
+                continue;
+            }
+            int len = msgs[i].msg_len;
+            for (auto *nlh = reinterpret_cast<struct nlmsghdr *>(iovs[i].iov_base);
+                 NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+                // Only multicast events are expected on this socket
+                if (nlh->nlmsg_type < NLMSG_MIN_TYPE ||
+                    nlh->nlmsg_len < NLMSG_LENGTH(GENL_HDRLEN)) {
+                    continue;
+                }
+                const int tz_id = handleEvent(nlh);
+                if (tz_id < 0) {
+                    continue;
+                }
+                if (static_cast<size_t>(tz_id) < tz_id_to_sensor_.size() &&
+                    tz_id_to_sensor_[tz_id] != kNoSensor) {
+                    triggered_sensors->set(tz_id_to_sensor_[tz_id]);
+                    continue;
+                }
+                // Zones not known at registration are resolved by name
+                std::string name;
+                if (getThermalZoneTypeById(tz_id, &name)) {
+                    const auto sensor_itr = monitored_sensors_.find(name);
+                    if (sensor_itr != monitored_sensors_.end()) {
+                        triggered_sensors->set(sensor_itr->second);
+                    }
+                }
+            }
+        }
+
+        // A short batch means the socket is drained
+        if (static_cast<size_t>(n) < kGenlBatchSize) {
+            break;
         }
     }
 }
@@ -496,32 +555,69 @@ void ThermalWatcher::wake() {
     looper_->wake();
 }
 
+bool ThermalWatcher::armTimer() {
+    if (timer_fd_.get() < 0) {
+        return false;
+    }
+
+    // A zero it_value disarms the timer when no sensor is due
+    boot_clock::time_point deadline = boot_clock::time_point::min();
+    if (sleep_ms_ != std::chrono::milliseconds::max()) {
+        deadline = last_update_time_ + sleep_ms_;
+    }
+    if (deadline == armed_deadline_) {
+        return true;
+    }
+
+    struct itimerspec spec = {};
+    if (deadline != boot_clock::time_point::min()) {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                deadline.time_since_epoch())
+                                .count();
+        spec.it_value.tv_sec = ns / 1000000000;
+        spec.it_value.tv_nsec = ns % 1000000000;
+    }
+    if (timerfd_settime(timer_fd_.get(), TFD_TIMER_ABSTIME, &spec, nullptr)) {
+        PLOG(ERROR) << "failed to arm watcher timerfd";
+        return false;
+    }
+    armed_deadline_ = deadline;
+    return true;
+}
+
 bool ThermalWatcher::threadLoop() {
     LOG(VERBOSE) << "ThermalWatcher polling...";
 
     int fd;
-    std::set<std::string> sensors;
+    triggered_sensors_.clear();
 
     auto time_elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(boot_clock::now() -
                                                                                  last_update_time_);
 
     if (time_elapsed_ms < sleep_ms_ &&
-        looper_->pollOnce(sleep_ms_.count(), &fd, nullptr, nullptr) >= 0) {
+        looper_->pollOnce(armTimer() ? -1 : sleep_ms_.count(), &fd, nullptr, nullptr) >= 0) {
         ATRACE_NAME("ThermalWatcher::threadLoop - receive event");
-        if (fd != uevent_fd_.get() && fd != thermal_genl_fd_.get()) {
+        if (fd == timer_fd_.get()) {
+            uint64_t expirations;
+            if (TEMP_FAILURE_RETRY(read(timer_fd_.get(), &expirations, sizeof(expirations))) < 0) {
+                // Spurious wakeup, the deadline is not reached yet
+                return true;
+            }
+            armed_deadline_ = boot_clock::time_point::min();
+        } else if (fd != uevent_fd_.get() && fd != thermal_genl_fd_.get()) {
             return true;
         } else if (fd == thermal_genl_fd_.get()) {
-            parseGenlink(&sensors);
+            parseGenlink(&triggered_sensors_);
         } else if (fd == uevent_fd_.get()) {
-            parseUevent(&sensors);
+            parseUevent(&triggered_sensors_);
         }
         // Ignore cb_ if uevent is not from monitored sensors
-        if (sensors.size() == 0) {
+        if (fd != timer_fd_.get() && !triggered_sensors_.any()) {
             return true;
         }
     }
 
-    sleep_ms_ = cb_(sensors);
+    sleep_ms_ = cb_(triggered_sensors_);
     last_update_time_ = boot_clock::now();
     return true;
 }
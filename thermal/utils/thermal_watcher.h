@@ -24,12 +24,13 @@
 #include <utils/Looper.h>
 #include <utils/Thread.h>
 
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
 #include <future>
+#include <limits>
 #include <list>
 #include <mutex>
-#include <set>
 #include <string>
 #include <thread>
 #include <unordered_map>
@@ -43,7 +44,39 @@ namespace implementation {
 
 using ::android::base::boot_clock;
 using ::android::base::unique_fd;
-using WatcherCallback = std::function<std::chrono::milliseconds(const std::set<std::string> &name)>;
+
+// A sensor watched for thermal events. index is the bit it sets in TriggeredSensors,
+// tz_id is the id of its thermal zone or -1 if unknown.
+struct WatchedSensor {
+    std::string name;
+    size_t index;
+    int tz_id;
+};
+
+// Sensors which triggered a thermal event during one watcher wakeup, by index
+class TriggeredSensors {
+  public:
+    void resize(size_t size) { triggered_.assign(size, false); }
+    void clear() {
+        if (any_) {
+            std::fill(triggered_.begin(), triggered_.end(), false);
+            any_ = false;
+        }
+    }
+    void set(size_t index) {
+        triggered_[index] = true;
+        any_ = true;
+    }
+    bool test(size_t index) const { return index < triggered_.size() && triggered_[index]; }
+    bool any() const { return any_; }
+
+  private:
+    std::vector<bool> triggered_;
+    bool any_ = false;
+};
+
+using WatcherCallback =
+        std::function<std::chrono::milliseconds(const TriggeredSensors &triggered_sensors)>;
 
 // A helper class for monitoring thermal files changes.
 class ThermalWatcher : public ::android::Thread {
@@ -62,9 +95,9 @@ class ThermalWatcher : public ::android::Thread {
     // class will by default wait for modifications to the file with a looper.
     // This should be called before starting watcher thread.
     // For monitoring uevents.
-    void registerFilesToWatch(const std::set<std::string> &sensors_to_watch);
+    void registerFilesToWatch(const std::vector<WatchedSensor> &sensors_to_watch);
     // For monitoring thermal genl events.
-    void registerFilesToWatchNl(const std::set<std::string> &sensors_to_watch);
+    void registerFilesToWatchNl(const std::vector<WatchedSensor> &sensors_to_watch);
     // Wake up the looper thus the worker thread, immediately. This can be called
     // in any thread.
     void wake();
@@ -76,11 +109,17 @@ class ThermalWatcher : public ::android::Thread {
     // modified file.
     bool threadLoop() override;
 
+    // Arm timer_fd_ for the next deadline, false if there is no timer
+    bool armTimer();
+
+    // Index the watched sensors by name and by thermal zone id
+    void addWatchedSensors(const std::vector<WatchedSensor> &sensors_to_watch);
+
     // Parse uevent message
-    void parseUevent(std::set<std::string> *sensor_name);
+    void parseUevent(TriggeredSensors *triggered_sensors);
 
-    // Parse thermal netlink message
-    void parseGenlink(std::set<std::string> *sensor_name);
+    // Parse thermal netlink messages in place, a batch per recvmmsg
+    void parseGenlink(TriggeredSensors *triggered_sensors);
 
     // Maps watcher filer descriptor to watched file path.
     std::unordered_map<int, std::string> watch_to_file_path_map_;
@@ -97,8 +136,19 @@ class ThermalWatcher : public ::android::Thread {
     ::android::base::unique_fd uevent_fd_;
     // For thermal genl socket registration.
     ::android::base::unique_fd thermal_genl_fd_;
-    // Sensor list which monitor flag is enabled.
-    std::set<std::string> monitored_sensors_;
+    // Index of each sensor which monitor flag is enabled.
+    std::unordered_map<std::string, size_t> monitored_sensors_;
+    // Sensor index of each thermal zone id, kNoSensor if the zone is not monitored
+    static constexpr size_t kNoSensor = std::numeric_limits<size_t>::max();
+    std::vector<size_t> tz_id_to_sensor_;
+    // Reused by each wakeup
+    TriggeredSensors triggered_sensors_;
+    // Receive buffers of the genl batch
+    std::vector<char> genl_buffer_;
+    // Wakes the thread at the next sensor deadline on CLOCK_BOOTTIME
+    ::android::base::unique_fd timer_fd_;
+    // Deadline timer_fd_ is armed for, time_point::min() when disarmed
+    boot_clock::time_point armed_deadline_ = boot_clock::time_point::min();
     // Sleep interval voting result
     std::chrono::milliseconds sleep_ms_;
     // Timestamp for last thermal update
@@ -21,8 +21,10 @@
 #include <android-base/stringprintf.h>
 #include <dlfcn.h>
 #include <json/reader.h>
+#include <pixeltrace/PixelTrace.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <cmath>
 #include <sstream>
 #include <vector>
@@ -75,6 +77,24 @@ float CalculateOffset(const std::vector<float> &offset_thresholds,
 
     return 0;
 }
+
+// Four independent partial sums, which the compiler keeps in one vector
+// register instead of a serial chain of float adds
+float DotProduct(const float *a, const float *b, size_t size) {
+    float sums[4] = {0, 0, 0, 0};
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        sums[0] += a[i] * b[i];
+        sums[1] += a[i + 1] * b[i + 1];
+        sums[2] += a[i + 2] * b[i + 2];
+        sums[3] += a[i + 3] * b[i + 3];
+    }
+    float sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    for (; i < size; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
 }  // namespace
 
 VtEstimatorStatus VirtualTempEstimator::DumpTraces() {
@@ -108,13 +128,12 @@ VtEstimatorStatus VirtualTempEstimator::DumpTraces() {
     // Add traces for model input/output buffers
     std::string sensor_name = common_instance_->sensor_name;
     for (size_t i = 0; i < input_buffer_size; ++i) {
-        ATRACE_INT((sensor_name + "_input_" + std::to_string(i)).c_str(),
-                   static_cast<int>(model_input[i]));
+        PIXEL_TRACE_INT_F(static_cast<int>(model_input[i]), "%s_input_%zu", sensor_name.c_str(), i);
     }
 
     for (size_t i = 0; i < output_buffer_size; ++i) {
-        ATRACE_INT((sensor_name + "_output_" + std::to_string(i)).c_str(),
-                   static_cast<int>(model_output[i]));
+        PIXEL_TRACE_INT_F(static_cast<int>(model_output[i]), "%s_output_%zu", sensor_name.c_str(),
+                          i);
     }
 
     // log input data and output data buffers
@@ -188,6 +207,13 @@ void VirtualTempEstimator::LoadTFLiteWrapper() {
         LOG(ERROR) << "Could not link and cast tflitewrapper_get_input_config with error: "
                    << dlerror();
     }
+
+    // Older wrappers do not take execution options
+    tflite_instance_->tflite_methods.set_options = reinterpret_cast<tflitewrapper_set_options>(
+            dlsym(mLibHandle, "ThermalTfliteSetOptions"));
+    if (!tflite_instance_->tflite_methods.set_options) {
+        LOG(INFO) << "tflitewrapper_set_options not available: " << dlerror();
+    }
 }
 
 VirtualTempEstimator::VirtualTempEstimator(std::string_view sensor_name,
@@ -237,17 +263,11 @@ VtEstimatorStatus VirtualTempEstimator::LinearModelInitialize(LinearModelInitDat
     common_instance_->use_prev_samples = data.use_prev_samples;
     common_instance_->prev_samples_order = data.prev_samples_order;
 
-    linear_model_instance_->input_samples.reserve(common_instance_->prev_samples_order);
-    linear_model_instance_->coefficients.reserve(common_instance_->prev_samples_order);
-
-    // Store coefficients
-    for (size_t i = 0; i < data.prev_samples_order; ++i) {
-        std::vector<float> single_order_coefficients;
-        for (size_t j = 0; j < num_linked_sensors; ++j) {
-            single_order_coefficients.emplace_back(data.coefficients[i * num_linked_sensors + j]);
-        }
-        linear_model_instance_->coefficients.emplace_back(single_order_coefficients);
-    }
+    linear_model_instance_->input_samples.assign(
+            2 * common_instance_->prev_samples_order * num_linked_sensors, 0);
+    linear_model_instance_->window_start = 0;
+    // Coefficients come order by order, already in the layout of the window
+    linear_model_instance_->coefficients = data.coefficients;
 
     common_instance_->offset_thresholds = data.offset_thresholds;
     common_instance_->offset_values = data.offset_values;
@@ -322,6 +342,20 @@ VtEstimatorStatus VirtualTempEstimator::TFliteInitialize(MLModelInitData data) {
         return kVtEstimatorInitFailed;
     }
 
+    if (data.num_threads > 0 || data.delegate != kDelegateDefault) {
+        if (!tflite_instance_->tflite_methods.set_options) {
+            LOG(WARNING) << "tflite wrapper ignores num_threads " << data.num_threads
+                         << " and delegate " << data.delegate << " for " << model_path;
+        } else if (tflite_instance_->tflite_methods.set_options(
+                           tflite_instance_->tflite_wrapper, data.num_threads, data.delegate)) {
+            LOG(ERROR) << "Failed to set tflite options for " << model_path;
+            return kVtEstimatorInitFailed;
+        } else {
+            tflite_instance_->num_threads = data.num_threads;
+            tflite_instance_->delegate = data.delegate;
+        }
+    }
+
     int ret = tflite_instance_->tflite_methods.init(tflite_instance_->tflite_wrapper,
                                                     model_path.c_str());
     if (ret) {
@@ -379,29 +413,30 @@ VtEstimatorStatus VirtualTempEstimator::LinearModelEstimate(const std::vector<fl
         return kVtEstimatorInitFailed;
     }
 
+    auto &input_samples = linear_model_instance_->input_samples;
+    auto &window_start = linear_model_instance_->window_start;
     // For the first iteration copy current inputs to all previous inputs
     // This would allow the estimator to have previous samples from the first iteration itself
     // and provide a valid predicted value
     if (common_instance_->cur_sample_count == 0) {
-        for (size_t i = 0; i < prev_samples_order; ++i) {
-            linear_model_instance_->input_samples[i] = thermistors;
+        window_start = 0;
+        for (size_t i = 0; i < 2 * prev_samples_order; ++i) {
+            std::copy(thermistors.begin(), thermistors.end(),
+                      input_samples.begin() + i * num_linked_sensors);
         }
+    } else {
+        // The window moves back by one sample, the oldest falls out of it
+        window_start = (window_start == 0 ? prev_samples_order : window_start) - 1;
+        std::copy(thermistors.begin(), thermistors.end(),
+                  input_samples.begin() + window_start * num_linked_sensors);
+        std::copy(thermistors.begin(), thermistors.end(),
+                  input_samples.begin() + (window_start + prev_samples_order) * num_linked_sensors);
     }
 
-    size_t cur_sample_index = common_instance_->cur_sample_count % prev_samples_order;
-    linear_model_instance_->input_samples[cur_sample_index] = thermistors;
-
     // Calculate Weighted Average Value
-    int input_level = cur_sample_index;
-    float estimated_value = 0;
-    for (size_t i = 0; i < prev_samples_order; ++i) {
-        for (size_t j = 0; j < num_linked_sensors; ++j) {
-            estimated_value += linear_model_instance_->coefficients[i][j] *
-                               linear_model_instance_->input_samples[input_level][j];
-        }
-        input_level--;  // go to previous samples
-        input_level = (input_level >= 0) ? input_level : (prev_samples_order - 1);
-    }
+    float estimated_value = DotProduct(linear_model_instance_->coefficients.data(),
+                                       input_samples.data() + window_start * num_linked_sensors,
+                                       prev_samples_order * num_linked_sensors);
 
     // Update sample count
     common_instance_->cur_sample_count++;
@@ -410,8 +445,8 @@ VtEstimatorStatus VirtualTempEstimator::LinearModelEstimate(const std::vector<fl
     estimated_value += CalculateOffset(common_instance_->offset_thresholds,
                                        common_instance_->offset_values, estimated_value);
 
-    std::vector<float> data = {estimated_value};
-    *output = data;
+    // Reuses the caller's buffer
+    output->assign(1, estimated_value);
     return kVtEstimatorOk;
 }
 
@@ -501,6 +536,7 @@ VtEstimatorStatus VirtualTempEstimator::TFliteEstimate(const std::vector<float>
         model_input = tflite_instance_->scratch_buffer;
     }
 
+    const auto invoke_start = boot_clock::now();
     int ret = tflite_instance_->tflite_methods.invoke(
             tflite_instance_->tflite_wrapper, model_input, input_buffer_size,
             tflite_instance_->output_buffer, output_buffer_size);
@@ -510,6 +546,11 @@ VtEstimatorStatus VirtualTempEstimator::TFliteEstimate(const std::vector<float>
         return kVtEstimatorInvokeFailed;
     }
     tflite_instance_->last_update_time = boot_clock::now();
+    auto &invoke_latency_us = tflite_instance_->invoke_latency_us;
+    invoke_latency_us[tflite_instance_->invoke_count++ % invoke_latency_us.size()] =
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                    tflite_instance_->last_update_time - invoke_start)
+                    .count();
 
     // prepare output
     std::vector<float> data;
@@ -704,6 +745,22 @@ VtEstimatorStatus VirtualTempEstimator::TFLiteDumpStatus(std::string_view sensor
     *dump_buf << std::endl;
 
     *dump_buf << "  Model Path: \"" << tflite_instance_->model_path << "\"" << std::endl;
+    *dump_buf << "  Num Threads: " << tflite_instance_->num_threads
+              << " Delegate: " << tflite_instance_->delegate << std::endl;
+
+    const auto &invoke_latency_us = tflite_instance_->invoke_latency_us;
+    const size_t num_latencies = std::min(tflite_instance_->invoke_count, invoke_latency_us.size());
+    if (num_latencies) {
+        std::vector<int64_t> latencies(invoke_latency_us.begin(),
+                                       invoke_latency_us.begin() + num_latencies);
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&latencies](size_t p) {
+            return latencies[(latencies.size() - 1) * p / 100];
+        };
+        *dump_buf << "  Invoke Latency (us) over last " << num_latencies
+                  << " invokes: p50: " << percentile(50) << " p90: " << percentile(90)
+                  << " p99: " << percentile(99) << " max: " << latencies.back() << std::endl;
+    }
 
     return kVtEstimatorOk;
 }
@@ -47,6 +47,9 @@ struct MLModelInitData {
     std::vector<float> offset_thresholds;
     std::vector<float> offset_values;
     bool support_under_sampling;
+    // 0 keeps the wrapper's default thread count
+    int num_threads;
+    VtEstimatorDelegate delegate;
 };
 
 struct LinearModelInitData {
@@ -57,7 +60,8 @@ struct LinearModelInitData {
     std::vector<float> offset_values;
 };
 
-union VtEstimationInitData {
+// Only the member of the estimation type is used
+struct VtEstimationInitData {
     VtEstimationInitData(VtEstimationType type) {
         if (type == kUseMLModel) {
             ml_model_init_data.model_path = "";
@@ -67,6 +71,8 @@ union VtEstimationInitData {
             ml_model_init_data.num_hot_spots = 1;
             ml_model_init_data.enable_input_validation = false;
             ml_model_init_data.support_under_sampling = false;
+            ml_model_init_data.num_threads = 0;
+            ml_model_init_data.delegate = kDelegateDefault;
         } else if (type == kUseLinearModel) {
             linear_model_init_data.use_prev_samples = false;
             linear_model_init_data.prev_samples_order = 1;
@@ -0,0 +1,324 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <android-base/parseint.h>
+#include <android-base/strings.h>
+#include <benchmark/benchmark.h>
+#include <sched.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "virtualtemp_estimator.h"
+
+namespace {
+
+std::atomic<uint64_t> allocation_count{0};
+
+}  // namespace
+
+// Count the heap allocations of the benchmarked calls
+void *operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace thermal {
+namespace vtestimator {
+
+namespace {
+
+// TFLite model under test, set from the command line as the model is only on device
+struct TFliteModelConfig {
+    std::string model_path;
+    size_t num_linked_sensors = 0;
+    size_t prev_samples_order = 1;
+    size_t output_label_count = 1;
+    size_t num_hot_spots = 1;
+};
+TFliteModelConfig tflite_model_config;
+
+// Reports latency through the benchmark time, and the calls per second and heap
+// allocations per call as counters
+class CallCounter {
+  public:
+    explicit CallCounter(benchmark::State &state)
+        : state_(state), start_count_(allocation_count.load(std::memory_order_relaxed)) {}
+    ~CallCounter() {
+        const uint64_t allocations =
+                allocation_count.load(std::memory_order_relaxed) - start_count_;
+        state_.counters["allocs_per_call"] =
+                benchmark::Counter(allocations, benchmark::Counter::kAvgIterations);
+        state_.SetItemsProcessed(state_.iterations());
+    }
+
+  private:
+    benchmark::State &state_;
+    const uint64_t start_count_;
+};
+
+// The previous history of one vector per sample, kept as the baseline.
+class NestedLinearModel {
+  public:
+    NestedLinearModel(size_t num_linked_sensors, size_t order,
+                      const std::vector<float> &coefficients)
+        : samples_(order) {
+        for (size_t i = 0; i < order; ++i) {
+            coefficients_.emplace_back(coefficients.begin() + i * num_linked_sensors,
+                                       coefficients.begin() + (i + 1) * num_linked_sensors);
+        }
+    }
+
+    float estimate(const std::vector<float> &thermistors) {
+        const size_t order = samples_.size();
+        if (count_ == 0) {
+            samples_.assign(order, thermistors);
+        }
+        const size_t cur = count_ % order;
+        samples_[cur] = thermistors;
+        int level = cur;
+        float value = 0;
+        for (size_t i = 0; i < order; ++i) {
+            for (size_t j = 0; j < thermistors.size(); ++j) {
+                value += coefficients_[i][j] * samples_[level][j];
+            }
+            level = (level > 0) ? level - 1 : order - 1;
+        }
+        count_++;
+        return value;
+    }
+
+  private:
+    std::vector<std::vector<float>> coefficients_;
+    std::vector<std::vector<float>> samples_;
+    size_t count_ = 0;
+};
+
+std::vector<float> randomValues(size_t size, float min, float max) {
+    std::mt19937 rng(size);
+    std::uniform_real_distribution<float> dist(min, max);
+    std::vector<float> values(size);
+    for (auto &v : values) {
+        v = dist(rng);
+    }
+    return values;
+}
+
+}  // namespace
+
+static void BM_NestedLinearModel(benchmark::State &state) {
+    const size_t num_linked_sensors = state.range(0);
+    const size_t order = state.range(1);
+    NestedLinearModel model(num_linked_sensors, order,
+                            randomValues(num_linked_sensors * order, -0.5, 0.5));
+    const auto thermistors = randomValues(num_linked_sensors, 20000, 50000);
+    CallCounter counter(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(model.estimate(thermistors));
+    }
+}
+BENCHMARK(BM_NestedLinearModel)->ArgsProduct({{4, 12}, {1, 10, 60}});
+
+static void BM_LinearModelEstimate(benchmark::State &state) {
+    const size_t num_linked_sensors = state.range(0);
+    const size_t order = state.range(1);
+    VtEstimationInitData init_data(kUseLinearModel);
+    init_data.linear_model_init_data.use_prev_samples = order > 1;
+    init_data.linear_model_init_data.prev_samples_order = order;
+    init_data.linear_model_init_data.coefficients =
+            randomValues(num_linked_sensors * order, -0.5, 0.5);
+    VirtualTempEstimator estimator("benchmark", kUseLinearModel, num_linked_sensors);
+    if (estimator.Initialize(init_data) != kVtEstimatorOk) {
+        state.SkipWithError("Failed to initialize the linear model");
+        return;
+    }
+    const auto thermistors = randomValues(num_linked_sensors, 20000, 50000);
+    std::vector<float> output;
+    CallCounter counter(state);
+    for (auto _ : state) {
+        estimator.Estimate(thermistors, &output);
+        benchmark::DoNotOptimize(output.data());
+    }
+}
+BENCHMARK(BM_LinearModelEstimate)->ArgsProduct({{4, 12}, {1, 10, 60}});
+
+bool initializeTFliteEstimator(benchmark::State &state, VirtualTempEstimator *estimator) {
+    if (tflite_model_config.model_path.empty()) {
+        state.SkipWithError("No model, pass --vt_model and --vt_linked_sensors");
+        return false;
+    }
+    VtEstimationInitData init_data(kUseMLModel);
+    auto &ml_data = init_data.ml_model_init_data;
+    ml_data.model_path = tflite_model_config.model_path;
+    ml_data.use_prev_samples = tflite_model_config.prev_samples_order > 1;
+    ml_data.prev_samples_order = tflite_model_config.prev_samples_order;
+    ml_data.output_label_count = tflite_model_config.output_label_count;
+    ml_data.num_hot_spots = tflite_model_config.num_hot_spots;
+    ml_data.support_under_sampling = true;
+    if (estimator->Initialize(init_data) != kVtEstimatorOk) {
+        state.SkipWithError("Failed to initialize the tflite model");
+        return false;
+    }
+    return true;
+}
+
+static void BM_TFliteEstimate(benchmark::State &state) {
+    const size_t num_linked_sensors = tflite_model_config.num_linked_sensors;
+    VirtualTempEstimator estimator("benchmark", kUseMLModel, num_linked_sensors);
+    if (!initializeTFliteEstimator(state, &estimator)) {
+        return;
+    }
+    const auto thermistors = randomValues(num_linked_sensors, 20, 50);
+    std::vector<float> output;
+    CallCounter counter(state);
+    for (auto _ : state) {
+        if (estimator.Estimate(thermistors, &output) != kVtEstimatorOk) {
+            state.SkipWithError("Failed to run the tflite model");
+            break;
+        }
+        benchmark::DoNotOptimize(output.data());
+    }
+}
+
+static void BM_TFliteGetAllPredictions(benchmark::State &state) {
+    const size_t num_linked_sensors = tflite_model_config.num_linked_sensors;
+    VirtualTempEstimator estimator("benchmark", kUseMLModel, num_linked_sensors);
+    if (!initializeTFliteEstimator(state, &estimator)) {
+        return;
+    }
+    std::vector<float> output;
+    if (estimator.Estimate(randomValues(num_linked_sensors, 20, 50), &output) != kVtEstimatorOk) {
+        state.SkipWithError("Failed to run the tflite model");
+        return;
+    }
+    CallCounter counter(state);
+    for (auto _ : state) {
+        estimator.GetAllPredictions(&output);
+        benchmark::DoNotOptimize(output.data());
+    }
+}
+
+// CPUs of a little, mid or big cluster, telling clusters apart by their max frequency
+bool getClusterCpus(std::string_view cluster, cpu_set_t *cpus) {
+    std::map<int, std::vector<int>> cpus_by_max_freq;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        std::string max_freq;
+        int freq;
+        if (!::android::base::ReadFileToString(
+                    "/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
+                            "/cpufreq/cpuinfo_max_freq",
+                    &max_freq) ||
+            !::android::base::ParseInt(::android::base::Trim(max_freq), &freq)) {
+            break;
+        }
+        cpus_by_max_freq[freq].push_back(cpu);
+    }
+    if (cpus_by_max_freq.empty()) {
+        return false;
+    }
+
+    const std::vector<int> *cluster_cpus = nullptr;
+    if (cluster == "little") {
+        cluster_cpus = &cpus_by_max_freq.begin()->second;
+    } else if (cluster == "big") {
+        cluster_cpus = &cpus_by_max_freq.rbegin()->second;
+    } else if (cluster == "mid" && cpus_by_max_freq.size() > 2) {
+        cluster_cpus = &std::next(cpus_by_max_freq.begin())->second;
+    } else {
+        return false;
+    }
+    CPU_ZERO(cpus);
+    for (const int cpu : *cluster_cpus) {
+        CPU_SET(cpu, cpus);
+    }
+    return true;
+}
+
+bool parseSizeFlag(std::string_view arg, std::string_view flag, size_t *value) {
+    return ::android::base::ConsumePrefix(&arg, flag) &&
+           ::android::base::ParseUint(std::string(arg), value);
+}
+
+}  // namespace vtestimator
+}  // namespace thermal
+
+// On top of the benchmark flags:
+//   --vt_model=<path> --vt_linked_sensors=<n> [--vt_prev_samples_order=<n>]
+//   [--vt_output_labels=<n>] [--vt_hot_spots=<n>] run the tflite benchmarks on a model
+//   --vt_cluster=little|mid|big pins the benchmarks to the cores of a cluster
+int main(int argc, char **argv) {
+    using thermal::vtestimator::tflite_model_config;
+    std::string cluster;
+    int kept_argc = 1;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (::android::base::ConsumePrefix(&arg, "--vt_model=")) {
+            tflite_model_config.model_path = arg;
+        } else if (::android::base::ConsumePrefix(&arg, "--vt_cluster=")) {
+            cluster = arg;
+        } else if (!thermal::vtestimator::parseSizeFlag(argv[i], "--vt_linked_sensors=",
+                                                        &tflite_model_config.num_linked_sensors) &&
+                   !thermal::vtestimator::parseSizeFlag(argv[i], "--vt_prev_samples_order=",
+                                                        &tflite_model_config.prev_samples_order) &&
+                   !thermal::vtestimator::parseSizeFlag(argv[i], "--vt_output_labels=",
+                                                        &tflite_model_config.output_label_count) &&
+                   !thermal::vtestimator::parseSizeFlag(argv[i], "--vt_hot_spots=",
+                                                        &tflite_model_config.num_hot_spots)) {
+            argv[kept_argc++] = argv[i];
+        }
+    }
+    argc = kept_argc;
+
+    if (!cluster.empty()) {
+        cpu_set_t cpus;
+        if (!thermal::vtestimator::getClusterCpus(cluster, &cpus) ||
+            sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+            std::cerr << "Failed to pin to the " << cluster << " cluster" << std::endl;
+            return 1;
+        }
+    }
+    if (!tflite_model_config.model_path.empty()) {
+        benchmark::RegisterBenchmark("BM_TFliteEstimate", thermal::vtestimator::BM_TFliteEstimate);
+        benchmark::RegisterBenchmark("BM_TFliteGetAllPredictions",
+                                     thermal::vtestimator::BM_TFliteGetAllPredictions);
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -15,6 +15,7 @@
  */
 #include <android-base/chrono_utils.h>
 
+#include <array>
 #include <cstddef>
 #include <mutex>
 #include <string>
@@ -30,6 +31,9 @@ using android::base::boot_clock;
 constexpr int kNumInputTensors = 1;
 constexpr int kNumOutputTensors = 1;
 
+// TFLite delegate the wrapper runs the model with
+enum VtEstimatorDelegate { kDelegateDefault = 0, kDelegateXnnpack = 1, kDelegateNnapi = 2 };
+
 typedef void *(*tflitewrapper_create)(int num_input_tensors, int num_output_tensors);
 typedef bool (*tflitewrapper_init)(void *handle, const char *model_path);
 typedef bool (*tflitewrapper_invoke)(void *handle, float *input_samples, int num_input_samples,
@@ -38,6 +42,8 @@ typedef void (*tflitewrapper_destroy)(void *handle);
 typedef bool (*tflitewrapper_get_input_config_size)(void *handle, int *config_size);
 typedef bool (*tflitewrapper_get_input_config)(void *handle, char *config_buffer,
                                                int config_buffer_size);
+// Optional, must be called before init
+typedef bool (*tflitewrapper_set_options)(void *handle, int num_threads, int delegate);
 
 struct TFLiteWrapperMethods {
     tflitewrapper_create create;
@@ -46,6 +52,7 @@ struct TFLiteWrapperMethods {
     tflitewrapper_destroy destroy;
     tflitewrapper_get_input_config_size get_input_config_size;
     tflitewrapper_get_input_config get_input_config;
+    tflitewrapper_set_options set_options;
     mutable std::mutex mutex;
 };
 
@@ -99,6 +106,7 @@ struct VtEstimatorTFLiteData {
         tflite_methods.get_input_config = nullptr;
         tflite_methods.invoke = nullptr;
         tflite_methods.destroy = nullptr;
+        tflite_methods.set_options = nullptr;
     }
 
     void *tflite_wrapper;
@@ -119,6 +127,11 @@ struct VtEstimatorTFLiteData {
     boot_clock::time_point last_update_time;
     boot_clock::time_point prev_sample_time;
     bool enable_input_validation;
+    int num_threads = 0;
+    VtEstimatorDelegate delegate = kDelegateDefault;
+    // Ring of the latest invoke latencies in microseconds
+    std::array<int64_t, 128> invoke_latency_us{};
+    size_t invoke_count = 0;
 
     ~VtEstimatorTFLiteData() {
         if (tflite_wrapper && tflite_methods.destroy) {
@@ -144,8 +157,13 @@ struct VtEstimatorLinearModelData {
 
     ~VtEstimatorLinearModelData() {}
 
-    std::vector<std::vector<float>> input_samples;
-    std::vector<std::vector<float>> coefficients;
+    // Ring of the last prev_samples_order samples of all linked sensors. Each
+    // sample is stored twice, prev_samples_order rows apart, so the samples
+    // from the newest at window_start to the oldest are always contiguous.
+    std::vector<float> input_samples;
+    size_t window_start = 0;
+    // Coefficients laid out like the window, order by order
+    std::vector<float> coefficients;
     mutable std::mutex mutex;
 };
 
@@ -14,21 +14,21 @@
  * limitations under the License.
  */
 
-#include <android-base/properties.h>
-
 #include "GloveMode.h"
 
 #define TOUCH_SENSITIVITY_PROP "persist.vendor.touch_sensitivity_mode"
 
 namespace vendor::lineage::touch::pixel {
 
+GloveMode::GloveMode() : mSensitivity(TOUCH_SENSITIVITY_PROP) {}
+
 // Methods from ::vendor::lineage::touch::V1_0::IGloveMode follow.
 Return<bool> GloveMode::isEnabled() {
-    return android::base::GetBoolProperty(TOUCH_SENSITIVITY_PROP, false);
+    return mSensitivity.isEnabled();
 }
 
 Return<bool> GloveMode::setEnabled(bool enabled) {
-    return android::base::SetProperty(TOUCH_SENSITIVITY_PROP, enabled ? "1" : "0");
+    return mSensitivity.setEnabled(enabled);
 }
 
 }  // namespace vendor::lineage::touch::pixel
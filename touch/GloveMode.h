@@ -20,6 +20,8 @@
 #include <hidl/MQDescriptor.h>
 #include <hidl/Status.h>
 
+#include "TouchFeature.h"
+
 namespace vendor::lineage::touch::pixel {
 
 using ::android::hardware::hidl_array;
@@ -31,9 +33,14 @@ using ::android::hardware::Void;
 using ::android::sp;
 
 struct GloveMode : public V1_0::IGloveMode {
+    GloveMode();
+
     // Methods from ::vendor::lineage::touch::V1_0::IGloveMode follow.
     Return<bool> isEnabled() override;
     Return<bool> setEnabled(bool enabled) override;
+
+  private:
+    TouchFeature mSensitivity;
 };
 
 }  // namespace vendor::lineage::touch::pixel
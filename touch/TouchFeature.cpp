@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/properties.h>
+
+#include "TouchFeature.h"
+
+namespace vendor::lineage::touch::pixel {
+
+TouchFeature::TouchFeature(const std::string& prop) : mProp(prop) {}
+
+void TouchFeature::refresh() {
+    if (!mInfo) {
+        mInfo = __system_property_find(mProp.c_str());
+        if (!mInfo) {
+            mEnabled = false;
+            return;
+        }
+    } else if (__system_property_serial(mInfo) == mSerial) {
+        return;
+    }
+    // Take the serial first, so that a change while reading is seen next time
+    mSerial = __system_property_serial(mInfo);
+    mEnabled = android::base::GetBoolProperty(mProp, false);
+}
+
+bool TouchFeature::isEnabled() {
+    std::lock_guard<std::mutex> lock(mLock);
+    refresh();
+    return mEnabled;
+}
+
+bool TouchFeature::setEnabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(mLock);
+    refresh();
+    if (mInfo && mEnabled == enabled) {
+        return true;
+    }
+    return android::base::SetProperty(mProp, enabled ? "1" : "0");
+}
+
+}  // namespace vendor::lineage::touch::pixel
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <sys/system_properties.h>
+
+#include <mutex>
+#include <string>
+
+namespace vendor::lineage::touch::pixel {
+
+/*
+ * A touch feature switched by a vendor property, which the touch driver's init
+ * triggers apply to sysfs. The state is cached against the serial of the
+ * property, so reading it takes no property lookup while it is unchanged, and
+ * setting the state it already has sends nothing to the property service.
+ */
+class TouchFeature {
+  public:
+    explicit TouchFeature(const std::string& prop);
+
+    bool isEnabled();
+    // False if the property could not be set
+    bool setEnabled(bool enabled);
+
+  private:
+    // Refreshes mEnabled if the property changed; call with mLock held
+    void refresh();
+
+    const std::string mProp;
+    std::mutex mLock;
+    // Found once the property exists
+    const prop_info* mInfo = nullptr;
+    uint32_t mSerial = 0;
+    bool mEnabled = false;
+};
+
+}  // namespace vendor::lineage::touch::pixel
@@ -19,7 +19,9 @@
 #include "include/pixelusb/CommonUtils.h"
 
 #include <android-base/file.h>
+#include <android-base/parseint.h>
 #include <android-base/properties.h>
+#include <android-base/strings.h>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
 #include <sys/inotify.h>
@@ -35,11 +37,11 @@ namespace google {
 namespace pixel {
 namespace usb {
 
-// Android metrics requires number of elements in any repeated field cannot exceed 127 elements
-constexpr int kWestworldRepeatedFieldSizeLimit = 127;
-
 using ::android::base::GetProperty;
+using ::android::base::ParseUint;
+using ::android::base::ReadFileToString;
 using ::android::base::SetProperty;
+using ::android::base::Trim;
 using ::android::base::WriteStringToFile;
 using ::std::chrono::microseconds;
 using ::std::chrono::steady_clock;
@@ -132,12 +134,53 @@ int unlinkFunctions(const char *path) {
     return ret;
 }
 
+int unlinkFunctionsFrom(const char *path, int index) {
+    DIR *config = opendir(path);
+    struct dirent *function;
+    char filepath[kMaxFilePathLength];
+    int ret = 0;
+
+    if (config == NULL)
+        return -1;
+
+    while (((function = readdir(config)) != NULL)) {
+        unsigned int number;
+
+        if (strncmp(function->d_name, FUNCTION_NAME, strlen(FUNCTION_NAME)) ||
+            !ParseUint(function->d_name + strlen(FUNCTION_NAME), &number) ||
+            number < static_cast<unsigned int>(index))
+            continue;
+        snprintf(filepath, kMaxFilePathLength, "%s/%s", path, function->d_name);
+        ret = remove(filepath);
+        if (ret) {
+            ALOGE("Unable  remove file %s errno:%d", filepath, errno);
+            break;
+        }
+    }
+
+    closedir(config);
+    return ret;
+}
+
 int linkFunction(const char *function, int index) {
     char functionPath[kMaxFilePathLength];
     char link[kMaxFilePathLength];
+    char target[kMaxFilePathLength];
+    ssize_t len;
 
     snprintf(functionPath, kMaxFilePathLength, "%s%s", FUNCTIONS_PATH, function);
     snprintf(link, kMaxFilePathLength, "%s%d", FUNCTION_PATH, index);
+
+    len = readlink(link, target, sizeof(target) - 1);
+    if (len >= 0) {
+        target[len] = '\0';
+        if (!strcmp(target, functionPath))
+            return 0;
+        // The kernel orders functions by link time, so later links go too.
+        if (unlinkFunctionsFrom(CONFIG_PATH, index))
+            return -1;
+    }
+
     if (symlink(functionPath, link)) {
         ALOGE("Cannot create symlink %s -> %s errno:%d", link, functionPath, errno);
         return -1;
@@ -145,32 +188,62 @@ int linkFunction(const char *function, int index) {
     return 0;
 }
 
+static bool sameAttributeValue(const std::string &current, const std::string &value) {
+    unsigned long currentNumber, number;
+
+    if (current == value)
+        return true;
+    return ParseUint(current, &currentNumber) && ParseUint(value, &number) &&
+           currentNumber == number;
+}
+
+bool writeIfChanged(const std::string &value, const char *path) {
+    std::string current;
+
+    if (ReadFileToString(path, &current) && sameAttributeValue(Trim(current), value))
+        return true;
+
+    return WriteStringToFile(value, path);
+}
+
 bool setVidPidCommon(const char *vid, const char *pid) {
-    if (!WriteStringToFile(vid, VENDOR_ID_PATH))
+    if (!writeIfChanged(vid, VENDOR_ID_PATH))
         return false;
 
-    if (!WriteStringToFile(pid, PRODUCT_ID_PATH))
+    if (!writeIfChanged(pid, PRODUCT_ID_PATH))
         return false;
 
     return true;
 }
 
-bool resetGadgetCommon() {
-    ALOGI("setCurrentUsbFunctions None");
+bool pullDownGadgetCommon() {
+    std::string udc;
+
+    // An unbound gadget reads back an empty UDC
+    if (!ReadFileToString(PULLUP_PATH, &udc) || !Trim(udc).empty()) {
+        if (!WriteStringToFile("none", PULLUP_PATH))
+            ALOGI("Gadget cannot be pulled down");
+    }
 
-    if (!WriteStringToFile("none", PULLUP_PATH))
-        ALOGI("Gadget cannot be pulled down");
+    if (!writeIfChanged("0", DEVICE_CLASS_PATH))
+        return false;
 
-    if (!WriteStringToFile("0", DEVICE_CLASS_PATH))
+    if (!writeIfChanged("0", DEVICE_SUB_CLASS_PATH))
         return false;
 
-    if (!WriteStringToFile("0", DEVICE_SUB_CLASS_PATH))
+    if (!writeIfChanged("0", DEVICE_PROTOCOL_PATH))
         return false;
 
-    if (!WriteStringToFile("0", DEVICE_PROTOCOL_PATH))
+    if (!writeIfChanged("0", DESC_USE_PATH))
         return false;
 
-    if (!WriteStringToFile("0", DESC_USE_PATH))
+    return true;
+}
+
+bool resetGadgetCommon() {
+    ALOGI("setCurrentUsbFunctions None");
+
+    if (!pullDownGadgetCommon())
         return false;
 
     if (unlinkFunctions(CONFIG_PATH))
@@ -179,7 +252,7 @@ bool resetGadgetCommon() {
     return true;
 }
 
-static VendorUsbDataSessionEvent_UsbDeviceState stringToUsbDeviceStateProto(
+VendorUsbDataSessionEvent_UsbDeviceState stringToUsbDeviceStateProto(
         const std::string &state) {
     if (state == "not attached\n") {
         return VendorUsbDataSessionEvent_UsbDeviceState_USB_STATE_NOT_ATTACHED;
@@ -14,12 +14,9 @@
  * limitations under the License.
  */
 
-#define LOG_TAG "libpixelusb-i2chelper"
-
 #include "include/pixelusb/I2cHelper.h"
 
-#include <dirent.h>
-#include <utils/Log.h>
+#include "include/pixelusb/UsbBusHelper.h"
 
 namespace android {
 namespace hardware {
@@ -27,37 +24,6 @@ namespace google {
 namespace pixel {
 namespace usb {
 
-// getI2cBusNumberString: Return the I2C bus number as the string type
-//
-// The bus number can be extracted from the sub-directory under the hsi2c sysfs
-// device directory (e.g. /sys/devices/platform/10d60000.hsi2c/) and the pattern
-// of the sub-directory is /^i2c-\d+$/ where \d+ is the bus number.
-static string getI2cBusNumberString(const string hsi2cPath) {
-    DIR *dp = opendir(hsi2cPath.c_str());
-
-    if (dp != NULL) {
-        struct dirent *ep;
-
-        while ((ep = readdir(dp))) {
-            if (ep->d_type == DT_DIR) {
-                // Supposed that there is only one sub dir in the pattern "i2c-"
-                if (string::npos != string(ep->d_name).find("i2c-")) {
-                    std::strtok(ep->d_name, "-");
-                    string busNumber = std::strtok(NULL, "-");
-                    closedir(dp);
-                    return busNumber;
-                }
-            }
-        }
-        closedir(dp);
-        ALOGE("Failed to find the i2c sub dir under %s", hsi2cPath.c_str());
-        return string("");
-    }
-
-    ALOGE("Failed to open %s", hsi2cPath.c_str());
-    return string("");
-}
-
 // getI2cClientPath: Return the full path of the I2C client directory
 //
 // There are two forms of the directory path: in client ID and in I2C device name
@@ -72,38 +38,11 @@ static string getI2cBusNumberString(const string hsi2cPath) {
 // Append the I2c device name to the full path if found, otherwise, append "bus
 // number" + "-" + client ID. Note that the client ID must be a 4-digit number
 // with 0 stuffed in the type of string.
-string getI2cClientPath(const string hsi2cPath, const string devName, const string clientId) {
-    DIR *dp;
-    string strBusNumber, i2cPathPartial, i2cClientPath;
-
-    strBusNumber = getI2cBusNumberString(hsi2cPath);
-    if (strBusNumber.empty()) {
-        return string("");
-    }
-
-    i2cPathPartial = hsi2cPath + "/i2c-" + strBusNumber;
-    dp = opendir(i2cPathPartial.c_str());
-    if (dp != NULL) {
-        struct dirent *ep;
-        string i2cClientDevice = strBusNumber + "-" + clientId;
-
-        while ((ep = readdir(dp))) {
-            if (ep->d_type == DT_DIR) {
-                if (string::npos != string(ep->d_name).find(devName)) {
-                    closedir(dp);
-                    return string(i2cPathPartial + "/" + devName + "/");
-                }
-                if (string::npos != string(ep->d_name).find(i2cClientDevice)) {
-                    closedir(dp);
-                    return string(i2cPathPartial + "/" + i2cClientDevice + "/");
-                }
-            }
-        }
-        closedir(dp);
-    }
-
-    ALOGE("Failed to open %s", i2cPathPartial.c_str());
-    return string("");
+//
+// This is the i2c case of getBusClientPath(), which caches the result.
+string getI2cClientPath(std::string_view hsi2cPath, std::string_view devName,
+                        std::string_view clientId) {
+    return getBusClientPath("i2c", hsi2cPath, devName, clientId);
 }
 
 }  // namespace usb
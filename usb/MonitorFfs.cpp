@@ -19,15 +19,16 @@
 #include "include/pixelusb/MonitorFfs.h"
 
 #include <android-base/file.h>
-#include <sys/epoll.h>
-#include <sys/eventfd.h>
 #include <sys/inotify.h>
+#include <sys/timerfd.h>
 #include <utils/Log.h>
 
 #include <chrono>
 #include <memory>
 #include <mutex>
 
+#include "include/pixelusb/UsbEventLoop.h"
+
 namespace android {
 namespace hardware {
 namespace google {
@@ -48,38 +49,27 @@ MonitorFfs::MonitorFfs(const char *const gadget)
       mCv(),
       mLockFd(),
       mCurrentUsbFunctionsApplied(false),
-      mMonitor(),
+      mWriteUdc(true),
+      mPullUpPending(false),
+      mDisconnect(),
       mCallback(NULL),
       mPayload(NULL),
       mGadgetName(gadget),
       mMonitorRunning(false) {
-    unique_fd eventFd(eventfd(0, 0));
-    if (eventFd == -1) {
-        ALOGE("mEventFd failed to create %d", errno);
-        abort();
-    }
-
-    unique_fd epollFd(epoll_create(2));
-    if (epollFd == -1) {
-        ALOGE("mEpollFd failed to create %d", errno);
-        abort();
-    }
-
-    unique_fd inotifyFd(inotify_init());
+    unique_fd inotifyFd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
     if (inotifyFd < 0) {
         ALOGE("inotify init failed");
         abort();
     }
 
-    if (addEpollFd(epollFd, inotifyFd) == -1)
-        abort();
-
-    if (addEpollFd(epollFd, eventFd) == -1)
+    unique_fd pullUpTimer(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC));
+    if (pullUpTimer == -1) {
+        ALOGE("mPullUpTimer failed to create %d", errno);
         abort();
+    }
 
-    mEpollFd = std::move(epollFd);
     mInotifyFd = std::move(inotifyFd);
-    mEventFd = std::move(eventFd);
+    mPullUpTimer = std::move(pullUpTimer);
     gadgetPullup = false;
 }
 
@@ -127,121 +117,88 @@ static void displayInotifyEvent(struct inotify_event *i) {
         ALOGE("        name = %s\n", i->name);
 }
 
-void *MonitorFfs::startMonitorFd(void *param) {
-    MonitorFfs *monitorFfs = (MonitorFfs *)param;
-    char buf[kBufferSize];
-    bool writeUdc = true, stopMonitor = false;
-    struct epoll_event events[kEpollEvents];
-    steady_clock::time_point disconnect;
-
-    bool descriptorWritten = true;
-    for (int i = 0; i < static_cast<int>(monitorFfs->mEndpointList.size()); i++) {
-        if (access(monitorFfs->mEndpointList.at(i).c_str(), R_OK)) {
-            descriptorWritten = false;
-            break;
+bool MonitorFfs::descriptorsPresent() {
+    for (int i = 0; i < static_cast<int>(mEndpointList.size()); i++) {
+        if (access(mEndpointList.at(i).c_str(), R_OK)) {
+            if (kDebug) {
+                ALOGI("%s absent", mEndpointList.at(i).c_str());
+            }
+            return false;
         }
     }
+    return true;
+}
 
-    // notify here if the endpoints are already present.
-    if (descriptorWritten) {
-        usleep(kPullUpDelay);
-        if (WriteStringToFile(monitorFfs->mGadgetName, PULLUP_PATH)) {
-            std::lock_guard<std::mutex> lock(monitorFfs->mLock);
-            monitorFfs->mCurrentUsbFunctionsApplied = true;
-            monitorFfs->mCallback(monitorFfs->mCurrentUsbFunctionsApplied, monitorFfs->mPayload);
-            gadgetPullup = true;
-            writeUdc = false;
-            ALOGI("GADGET pulled up");
-            monitorFfs->mCv.notify_all();
-        }
+void MonitorFfs::pullUp() {
+    if (WriteStringToFile(mGadgetName, PULLUP_PATH)) {
+        std::lock_guard<std::mutex> lock(mLock);
+        mCurrentUsbFunctionsApplied = true;
+        mCallback(mCurrentUsbFunctionsApplied, mPayload);
+        ALOGI("GADGET pulled up");
+        mWriteUdc = false;
+        gadgetPullup = true;
+        // notify the main thread to signal userspace.
+        mCv.notify_all();
     }
+}
+
+void MonitorFfs::onInotifyEvent() {
+    char buf[kBufferSize];
 
-    while (!stopMonitor) {
-        int nrEvents = epoll_wait(monitorFfs->mEpollFd, events, kEpollEvents, -1);
+    // Process all of the events in buffer returned by read().
+    int numRead = read(mInotifyFd, buf, kBufferSize);
+    if (numRead <= 0)
+        return;
 
-        if (nrEvents <= 0) {
-            ALOGE("epoll wait did not return descriptor number");
-            continue;
+    if (kDebug) {
+        for (char *p = buf; p < buf + numRead;) {
+            struct inotify_event *event = (struct inotify_event *)p;
+            displayInotifyEvent(event);
+            p += sizeof(struct inotify_event) + event->len;
         }
+    }
 
-        for (int i = 0; i < nrEvents; i++) {
-            ALOGV("event=%u on fd=%d\n", events[i].events, events[i].data.fd);
-
-            if (events[i].data.fd == monitorFfs->mInotifyFd) {
-                // Process all of the events in buffer returned by read().
-                int numRead = read(monitorFfs->mInotifyFd, buf, kBufferSize);
-                for (char *p = buf; p < buf + numRead;) {
-                    struct inotify_event *event = (struct inotify_event *)p;
-                    if (kDebug) {
-                        displayInotifyEvent(event);
-                    }
-
-                    p += sizeof(struct inotify_event) + event->len;
-
-                    bool descriptorPresent = true;
-                    for (int j = 0; j < static_cast<int>(monitorFfs->mEndpointList.size()); j++) {
-                        if (access(monitorFfs->mEndpointList.at(j).c_str(), R_OK)) {
-                            if (kDebug) {
-                                ALOGI("%s absent", monitorFfs->mEndpointList.at(j).c_str());
-                            }
-                            descriptorPresent = false;
-                            break;
-                        }
-                    }
-
-                    if (!descriptorPresent && !writeUdc) {
-                        if (kDebug) {
-                            ALOGI("endpoints not up");
-                        }
-                        writeUdc = true;
-                        disconnect = std::chrono::steady_clock::now();
-                    } else if (descriptorPresent && writeUdc) {
-                        steady_clock::time_point temp = steady_clock::now();
-
-                        if (std::chrono::duration_cast<microseconds>(temp - disconnect).count() <
-                            kPullUpDelay)
-                            usleep(kPullUpDelay);
-
-                        if (WriteStringToFile(monitorFfs->mGadgetName, PULLUP_PATH)) {
-                            std::lock_guard<std::mutex> lock(monitorFfs->mLock);
-                            monitorFfs->mCurrentUsbFunctionsApplied = true;
-                            monitorFfs->mCallback(monitorFfs->mCurrentUsbFunctionsApplied,
-                                                  monitorFfs->mPayload);
-                            ALOGI("GADGET pulled up");
-                            writeUdc = false;
-                            gadgetPullup = true;
-                            // notify the main thread to signal userspace.
-                            monitorFfs->mCv.notify_all();
-                        }
-                    }
-                }
-            } else {
-                uint64_t flag;
-                read(monitorFfs->mEventFd, &flag, sizeof(flag));
-                if (flag == 100) {
-                    stopMonitor = true;
-                    break;
-                }
-            }
+    // The endpoints are checked on disk, so one check covers the whole batch.
+    bool descriptorPresent = descriptorsPresent();
+
+    if (!descriptorPresent && !mWriteUdc) {
+        if (kDebug) {
+            ALOGI("endpoints not up");
+        }
+        mWriteUdc = true;
+        mDisconnect = steady_clock::now();
+    } else if (descriptorPresent && mWriteUdc && !mPullUpPending) {
+        steady_clock::time_point temp = steady_clock::now();
+
+        if (std::chrono::duration_cast<microseconds>(temp - mDisconnect).count() < kPullUpDelay) {
+            UsbEventLoop::armTimer(mPullUpTimer, kPullUpDelay / 1000);
+            mPullUpPending = true;
+        } else {
+            pullUp();
         }
     }
-    return NULL;
+}
+
+void MonitorFfs::onPullUpTimer() {
+    mPullUpPending = false;
+    if (mWriteUdc && descriptorsPresent())
+        pullUp();
 }
 
 void MonitorFfs::reset() {
     std::lock_guard<std::mutex> lock(mLockFd);
-    uint64_t flag = 100;
-    unsigned long ret;
 
     if (mMonitorRunning) {
-        // Stop the monitor thread by writing into signal fd.
-        ret = TEMP_FAILURE_RETRY(write(mEventFd, &flag, sizeof(flag)));
-        if (ret < 0)
-            ALOGE("Error writing eventfd errno=%d", errno);
-
-        ALOGI("mMonitor signalled to exit");
-        mMonitor->join();
-        ALOGI("mMonitor destroyed");
+        UsbEventLoop &loop = UsbEventLoop::get();
+
+        // Once this returns no handler is running or will run again.
+        loop.runSync([this, &loop] {
+            loop.removeFd(mInotifyFd);
+            loop.removeFd(mPullUpTimer);
+            UsbEventLoop::armTimer(mPullUpTimer, 0);
+            mPullUpPending = false;
+        });
+        ALOGI("monitor stopped");
         mMonitorRunning = false;
     }
 
@@ -255,9 +212,27 @@ void MonitorFfs::reset() {
 }
 
 bool MonitorFfs::startMonitor() {
-    mMonitor = std::make_unique<std::thread>(this->startMonitorFd, this);
-    mMonitorRunning = true;
-    return true;
+    UsbEventLoop &loop = UsbEventLoop::get();
+    bool registered = false;
+
+    loop.runSync([this, &loop, &registered] {
+        mWriteUdc = true;
+        mDisconnect = steady_clock::time_point();
+
+        registered = loop.addFd(mInotifyFd, EPOLLIN, [this](uint32_t) { onInotifyEvent(); });
+        if (registered && !loop.addTimer(mPullUpTimer, [this] { onPullUpTimer(); })) {
+            loop.removeFd(mInotifyFd);
+            registered = false;
+        }
+
+        // pull up after kPullUpDelay if the endpoints are already present.
+        if (registered && descriptorsPresent()) {
+            UsbEventLoop::armTimer(mPullUpTimer, kPullUpDelay / 1000);
+            mPullUpPending = true;
+        }
+    });
+    mMonitorRunning = registered;
+    return registered;
 }
 
 bool MonitorFfs::isMonitorRunning() {
@@ -19,15 +19,27 @@
 #include "include/pixelusb/UsbBusHelper.h"
 
 #include <dirent.h>
+#include <unistd.h>
 #include <utils/Log.h>
 
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <tuple>
+
 namespace android {
 namespace hardware {
 namespace google {
 namespace pixel {
 namespace usb {
 
-static string getBusNumberString(const string busType, const string busPath) {
+// Resolved client paths keyed by (busType, busPath, devName, clientId).
+// Failed lookups are not cached so that a late-probing client is found on retry.
+using BusClientKey = std::tuple<string, string, string, string>;
+static std::mutex sBusClientPathLock;
+static std::map<BusClientKey, string> sBusClientPaths;
+
+static string getBusNumberString(const string &busType, const string &busPath) {
     DIR *dp = opendir(busPath.c_str());
 
     if (dp != NULL) {
@@ -36,7 +48,7 @@ static string getBusNumberString(const string busType, const string busPath) {
         while ((ep = readdir(dp))) {
             if (ep->d_type == DT_DIR) {
                 // Supposed that there is only one sub dir in the busType pattern
-                if (string::npos != string(ep->d_name).find(string(busType + "-"))) {
+                if (string::npos != string(ep->d_name).find(busType + "-")) {
                     std::strtok(ep->d_name, "-");
                     string busNumber = std::strtok(NULL, "-");
                     closedir(dp);
@@ -74,8 +86,8 @@ static string getBusNumberString(const string busType, const string busPath) {
  * 0 stuffed in the type of string for I2c, or a 2-digit number for SPMI.
  *
  */
-string getBusClientPath(const string busType, const string busPath, const string devName,
-                        const string clientId) {
+static string resolveBusClientPath(const string &busType, const string &busPath,
+                                  const string &devName, const string &clientId) {
     DIR *dp;
     string strBusNumber, busPathPartial, busClientPath;
 
@@ -109,6 +121,41 @@ string getBusClientPath(const string busType, const string busPath, const string
     return string("");
 }
 
+/*
+ * The directory scans above run on every plug event otherwise. A cached path
+ * is only trusted while its directory still exists, so a client that was
+ * unbound is resolved again even if no uevent reached us.
+ */
+string getBusClientPath(std::string_view busType, std::string_view busPath,
+                        std::string_view devName, std::string_view clientId) {
+    BusClientKey key(busType, busPath, devName, clientId);
+    string busClientPath;
+
+    {
+        std::lock_guard<std::mutex> lock(sBusClientPathLock);
+        auto it = sBusClientPaths.find(key);
+        if (it != sBusClientPaths.end()) {
+            if (!access(it->second.c_str(), F_OK))
+                return it->second;
+            sBusClientPaths.erase(it);
+        }
+    }
+
+    busClientPath = resolveBusClientPath(std::get<0>(key), std::get<1>(key), std::get<2>(key),
+                                         std::get<3>(key));
+    if (!busClientPath.empty()) {
+        std::lock_guard<std::mutex> lock(sBusClientPathLock);
+        sBusClientPaths[std::move(key)] = busClientPath;
+    }
+
+    return busClientPath;
+}
+
+void invalidateBusClientPaths() {
+    std::lock_guard<std::mutex> lock(sBusClientPathLock);
+    sBusClientPaths.clear();
+}
+
 }  // namespace usb
 }  // namespace pixel
 }  // namespace google
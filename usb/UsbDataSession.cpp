@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "libpixelusb-UsbDataSession"
+
+#include "include/pixelusb/UsbDataSession.h"
+
+#include <utils/Log.h>
+
+#include "include/pixelusb/UsbEventLoop.h"
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+namespace usb {
+
+using ::std::chrono::duration_cast;
+using ::std::chrono::milliseconds;
+using android::hardware::google::pixel::PixelAtoms::
+        VendorUsbDataSessionEvent_UsbDataRole_USB_ROLE_DEVICE;
+using android::hardware::google::pixel::PixelAtoms::
+        VendorUsbDataSessionEvent_UsbDataRole_USB_ROLE_HOST;
+
+UsbDataSession::UsbDataSession(Reporter reporter)
+    : mReporter(std::move(reporter)), mActive(false), mIsHost(false), mHead(0), mCount(0) {}
+
+void UsbDataSession::start(bool isHost) {
+    std::lock_guard<std::mutex> lock(mLock);
+    boot_clock::time_point now = boot_clock::now();
+
+    if (mActive)
+        endLocked(now);
+
+    mActive = true;
+    mIsHost = isHost;
+    mStartTime = now;
+    mHead = 0;
+    mCount = 0;
+}
+
+void UsbDataSession::recordState(const std::string &state) {
+    std::lock_guard<std::mutex> lock(mLock);
+    VendorUsbDataSessionEvent_UsbDeviceState proto = stringToUsbDeviceStateProto(state);
+
+    if (!mActive)
+        return;
+
+    if (mCount) {
+        size_t last = (mHead + mCount - 1) % mTransitions.size();
+        if (mTransitions[last].state == proto)
+            return;
+    }
+
+    if (mCount == mTransitions.size()) {
+        mHead = (mHead + 1) % mTransitions.size();
+        mCount--;
+    }
+    mTransitions[(mHead + mCount) % mTransitions.size()] = {boot_clock::now(), proto};
+    mCount++;
+}
+
+void UsbDataSession::end() {
+    std::lock_guard<std::mutex> lock(mLock);
+
+    if (mActive)
+        endLocked(boot_clock::now());
+}
+
+bool UsbDataSession::active() {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mActive;
+}
+
+void UsbDataSession::endLocked(boot_clock::time_point now) {
+    VendorUsbDataSessionEvent event;
+
+    if (mIsHost)
+        event.set_usb_role(VendorUsbDataSessionEvent_UsbDataRole_USB_ROLE_HOST);
+    else
+        event.set_usb_role(VendorUsbDataSessionEvent_UsbDataRole_USB_ROLE_DEVICE);
+
+    for (size_t i = 0; i < mCount; i++) {
+        const Transition &transition = mTransitions[(mHead + i) % mTransitions.size()];
+
+        event.add_usb_states(transition.state);
+        event.add_elapsed_time_ms(
+                duration_cast<milliseconds>(transition.time - mStartTime).count());
+    }
+    event.set_duration_ms(duration_cast<milliseconds>(now - mStartTime).count());
+
+    mActive = false;
+    mCount = 0;
+
+    if (!mReporter)
+        return;
+
+    UsbEventLoop::get().post(
+            [reporter = mReporter, event = std::move(event)] { reporter(event); });
+}
+
+}  // namespace usb
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
@@ -22,20 +22,27 @@
 #include <android-base/parseint.h>
 #include <android-base/strings.h>
 #include <dirent.h>
-#include <pthread.h>
+#include <fcntl.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
 #include <sys/timerfd.h>
+#include <unistd.h>
 #include <utils/Log.h>
 
 #include <cstring>
 
+#include "include/pixelusb/UsbEventLoop.h"
+
 using aidl::android::hardware::usb::DisplayPortAltModeStatus;
 using android::base::ParseUint;
 using android::base::ReadFileToString;
 using android::base::Trim;
 using android::base::WriteStringToFile;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
 
 #define LINK_TRAINING_STATUS_UNKNOWN "0"
 #define LINK_TRAINING_STATUS_SUCCESS "1"
@@ -58,10 +65,20 @@ namespace hardware {
 namespace google {
 namespace pixel {
 namespace usb {
-// Set by signal handler to destroy thread
-volatile bool destroyDisplayPortThread;
 
 constexpr char kPortPartnerPath[] = "/sys/class/typec/port0-partner/";
+constexpr char kOrientationPath[] = "/sys/class/typec/port0/orientation";
+constexpr char kPortActivePath[] = "/sys/class/typec/port0/port0.0/mode1/active";
+
+// Opens drm attribute (attribute) for reading and writing
+static int openDrmAttributeHelper(const string &drmPath, const char *attribute) {
+    string path = drmPath + attribute;
+    int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd == -1) {
+        ALOGW("usbdp: open at %s failed, writing by path; errno=%d", path.c_str(), errno);
+    }
+    return fd;
+}
 
 UsbDp::UsbDp(const char *const drmPath)
     : mDrmPath(drmPath),
@@ -72,24 +89,14 @@ UsbDp::UsbDp(const char *const drmPath)
       mCallback(NULL),
       mPayload(NULL),
       mPartnerSupportsDisplayPort(false),
+      mFdLock(PTHREAD_MUTEX_INITIALIZER),
+      mPinSet(false),
+      mOrientationSet(false),
+      mActivateRetryCount(0),
+      mHpdHighPending(false),
+      mHpdToDrmLatency(),
+      mHpdToLinkTrainedLatency(),
       mLock(PTHREAD_MUTEX_INITIALIZER) {
-    pthread_condattr_t attr;
-    if (pthread_condattr_init(&attr)) {
-        ALOGE("pthread_condattr_init failed: %s", strerror(errno));
-        abort();
-    }
-    if (pthread_condattr_setclock(&attr, CLOCK_MONOTONIC)) {
-        ALOGE("pthread_condattr_setclock failed: %s", strerror(errno));
-        abort();
-    }
-    if (pthread_cond_init(&mCV, &attr)) {
-        ALOGE("usbdp: pthread_cond_init failed: %s", strerror(errno));
-        abort();
-    }
-    if (pthread_condattr_destroy(&attr)) {
-        ALOGE("pthread_condattr_destroy failed: %s", strerror(errno));
-        abort();
-    }
     mDisplayPortEventPipe = eventfd(0, EFD_NONBLOCK);
     if (mDisplayPortEventPipe == -1) {
         ALOGE("mDisplayPortEventPipe eventfd failed: %s", strerror(errno));
@@ -100,11 +107,15 @@ UsbDp::UsbDp(const char *const drmPath)
         ALOGE("mDisplayPortDebounceTimer timerfd failed: %s", strerror(errno));
         abort();
     }
-    mActivateTimer = timerfd_create(CLOCK_MONOTONIC, 0);
+    mActivateTimer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
     if (mActivateTimer == -1) {
         ALOGE("mActivateTimer timerfd failed: %s", strerror(errno));
         abort();
     }
+    mDrmHpdFd.reset(openDrmAttributeHelper(mDrmPath, "hpd"));
+    mDrmPinAssignmentFd.reset(openDrmAttributeHelper(mDrmPath, "pin_assignment"));
+    mDrmOrientationFd.reset(openDrmAttributeHelper(mDrmPath, "orientation"));
+    mDrmIrqHpdFd.reset(openDrmAttributeHelper(mDrmPath, "irq_hpd"));
 }
 
 /* Class Get/Set Helper Functions */
@@ -134,7 +145,7 @@ void UsbDp::setClientPath(string path) {
  * getPollRunning()
  *
  * Return:
- * boolean indicating if mPoll is currently running
+ * boolean indicating if DisplayPort polling is currently running
  */
 bool UsbDp::getPollRunning() {
     return mPollRunning;
@@ -186,7 +197,45 @@ void UsbDp::registerCallback(void (*callback)(void *(payload)), void *payload) {
     mPayload = payload;
 }
 
-/* Internal fd, epoll, timer Helper Functions */
+/**
+ * dumpDisplayPortLatency()
+ *
+ * Writes the time from the port partner raising hpd to the drm taking hpd,
+ * and to the drm reporting successful link training, for the HAL's dump().
+ *
+ * Input:
+ * @fd: fd to write to
+ */
+void UsbDp::dumpDisplayPortLatency(int fd) {
+    pthread_mutex_lock(&mFdLock);
+    dprintf(fd, "DisplayPort hot-plug latency:\n");
+    mHpdToDrmLatency.dump(fd, "hpd to drm");
+    mHpdToLinkTrainedLatency.dump(fd, "hpd to link trained");
+    pthread_mutex_unlock(&mFdLock);
+}
+
+void UsbDp::LatencyStats::record(int64_t us) {
+    if (count == 0 || us < minUs)
+        minUs = us;
+    if (count == 0 || us > maxUs)
+        maxUs = us;
+    lastUs = us;
+    totalUs += us;
+    count++;
+}
+
+void UsbDp::LatencyStats::dump(int fd, const char *name) const {
+    if (count == 0) {
+        dprintf(fd, "  %s: no samples\n", name);
+        return;
+    }
+    dprintf(fd,
+            "  %s: count:%u last:%" PRId64 "us min:%" PRId64 "us avg:%" PRId64 "us max:%" PRId64
+            "us\n",
+            name, count, lastUs, minUs, totalUs / count, maxUs);
+}
+
+/* Internal fd Helper Functions */
 // Opens file with given flags
 static int displayPortPollOpenFileHelper(const char *file, int flags) {
     int fd = open(file, flags);
@@ -196,164 +245,86 @@ static int displayPortPollOpenFileHelper(const char *file, int flags) {
     return fd;
 }
 
-// Sets timerfd (fd) to trigger after (ms) milliseconds.
-// Setting ms to 0 disarms the timer.
-static int armTimerFdHelper(int fd, int ms) {
-    struct itimerspec ts;
-    int ret;
-
-    ts.it_interval.tv_sec = 0;
-    ts.it_interval.tv_nsec = 0;
-    ts.it_value.tv_sec = ms / 1000;
-    ts.it_value.tv_nsec = (ms % 1000) * 1000000;
-
-    ret = timerfd_settime(fd, 0, &ts, NULL);
-    if (ret < 0) {
-        ALOGE("usbdp: %s failed to arm timer", __func__);
-    }
-
-    return ret;
+// Reads a sysfs attribute through an fd kept open across events. sysfs
+// regenerates the value on every read from offset 0.
+static bool readAttributeFdHelper(int fd, string *value) {
+    char buf[128];
+    ssize_t len;
+
+    if (fd == -1)
+        return false;
+    len = TEMP_FAILURE_RETRY(pread(fd, buf, sizeof(buf), 0));
+    if (len < 0)
+        return false;
+    value->assign(buf, len);
+    return true;
 }
 
-// Returns timespec that expires in debounceMs ms
-static struct timespec setTimespecTimer(int debounceMs) {
-    struct timespec to;
-    struct timespec now;
-
-    clock_gettime(CLOCK_MONOTONIC, &now);
-    to.tv_nsec = now.tv_nsec + ((debounceMs % 1000) * 1000000);
-    to.tv_sec = now.tv_sec + (debounceMs / 1000);
-    // Overflow handling
-    to.tv_sec += to.tv_sec / 1000000000L;
-    to.tv_nsec = to.tv_nsec % 1000000000L;
-
-    return to;
+// Writes a sysfs attribute through fd, or by path when fd could not be opened
+static bool writeAttributeFdHelper(int fd, const string &value, const string &path) {
+    if (fd == -1)
+        return WriteStringToFile(value, path);
+    return TEMP_FAILURE_RETRY(pwrite(fd, value.data(), value.size(), 0)) ==
+           static_cast<ssize_t>(value.size());
 }
 
 /* Setup/Shutdown Helper Functions */
-void *displayPortPollWork(void *param) {
-    UsbDp *usbDp = reinterpret_cast<UsbDp *>(param);
-
-    usbDp->displayPortPollWorkHelper();
-
-    return NULL;
-}
-
 /**
  * setupDisplayPortPoll()
  *
- * Used by USB HAL to setup DisplayPort work thread. Consecutive calls to
- * setupDisplayPortPoll will exit if the currently starting thread has not
- * established sysfs links, otherwise assume that the file descriptors have
- * become stale and setup needs to be performed again.
+ * Used by USB HAL to setup DisplayPort polling on the USB event loop.
+ * Consecutive calls to setupDisplayPortPoll will exit if a queued setup has
+ * not established sysfs links yet, otherwise assume that the file
+ * descriptors have become stale and setup needs to be performed again.
  *
  */
 void UsbDp::setupDisplayPortPoll() {
-    uint64_t flag = DISPLAYPORT_SHUTDOWN_CLEAR;
     mFirstSetupDone = true;
-    int ret;
 
-    ALOGI("usbdp: setup: beginning setup for displayport poll thread");
+    ALOGI("usbdp: setup: beginning setup for displayport poll");
     mPartnerSupportsDisplayPort = true;
 
     /*
-     * If thread is currently starting, then it hasn't setup DisplayPort fd's, and we can abandon
+     * If a setup is queued, then it hasn't setup DisplayPort fd's, and we can abandon
      * this process.
      */
     if (mPollStarting) {
-        ALOGI("usbdp: setup: abandoning poll thread because another startup is in progress");
+        ALOGI("usbdp: setup: abandoning poll setup because another startup is in progress");
         return;
     }
-
-    /*
-     * Check to see if thread is currently running. If it is, then we assume that it must have
-     * invalid DisplayPort fd's and the new thread takes over.
-     */
-    if (mPollRunning) {
-        shutdownDisplayPortPoll(true);
-        pthread_mutex_lock(&mCVLock);
-        struct timespec to = setTimespecTimer(DISPLAYPORT_POLL_WAIT_MS);
-        ret = pthread_cond_timedwait(&mCV, &mCVLock, &to);
-        if (ret == ETIMEDOUT) {
-            ALOGI("usbdp: setup: Wait for poll to shutdown timed out, starting new poll anyways.");
-        }
-        pthread_mutex_unlock(&mCVLock);
-    }
-
-    // Indicate that startup procedure is initiated (mutex protects two threads running setup at
-    // once)
     mPollStarting = true;
 
-    // Reset shutdown signals because shutdown() does not perform self clean-up
-    write(mDisplayPortEventPipe, &flag, sizeof(flag));
-    destroyDisplayPortThread = false;
-
     /*
-     * Create a background thread to poll DisplayPort system files
+     * If the poll is currently running, then we assume that it must have invalid DisplayPort
+     * fd's and the new setup takes over. Both run in order on the event loop.
      */
-    if (pthread_create(&mPoll, NULL, displayPortPollWork, this)) {
-        ALOGE("usbdp: setup: failed to create displayport poll thread %d", errno);
-        goto error;
-    }
-    ALOGI("usbdp: setup: successfully started displayport poll thread");
-    return;
-
-error:
-    mPollStarting = false;
-    return;
-}
-
-/**
- * shutdownDisplayPortPollHelper()
- *
- * Discover the DisplayPort driver sysfs attribute directory. Iterates through
- * all port partner alt mode directories and queries for displayport sysfs group
- * to do so.
- *
- */
-void UsbDp::shutdownDisplayPortPollHelper() {
-    uint64_t flag = DISPLAYPORT_SHUTDOWN_SET;
-    int ret;
-
-    // Write shutdown signal to child thread.
-    ret = write(mDisplayPortEventPipe, &flag, sizeof(flag));
-    if (ret < 0) {
-        ALOGE("usbdp: shutdownDisplayPortPollHelper write failure, %d", ret);
-    }
-    pthread_join(mPoll, NULL);
-    writeHpdOverride(string(mDrmPath), "0");
-    pthread_mutex_lock(&mCVLock);
-    pthread_cond_signal(&mCV);
-    pthread_mutex_unlock(&mCVLock);
-}
-
-void *shutdownDisplayPortPollWork(void *param) {
-    UsbDp *usbDp = reinterpret_cast<UsbDp *>(param);
-
-    usbDp->shutdownDisplayPortPollHelper();
-    ALOGI("usbdp: shutdown: displayport thread shutdown complete.");
-    return NULL;
+    UsbEventLoop::get().post([this] {
+        if (mPollRunning) {
+            stopDisplayPortPoll();
+            writeHpdOverride(mDrmPath, "0");
+        }
+        startDisplayPortPoll();
+    });
+    ALOGI("usbdp: setup: displayport poll setup queued");
 }
 
 /**
  * shutdownDisplayPortPoll()
  *
- * Discover the DisplayPort driver sysfs attribute directory. Iterates through
- * all port partner alt mode directories and queries for displayport sysfs group
- * to do so.
+ * Stops DisplayPort polling on the USB event loop and clears hpd in the drm.
  *
  * Input
- * @force: boolean to indicate if thread should be shutdown irrespective of
- *         whether or not the thread is running.
+ * @force: boolean to indicate if polling should be shutdown irrespective of
+ *         whether or not the DisplayPort directory is still present.
  *
  */
 void UsbDp::shutdownDisplayPortPoll(bool force) {
     string displayPortUsbPath;
 
-    ALOGI("usbdp: shutdown: beginning shutdown for displayport poll thread");
+    ALOGI("usbdp: shutdown: beginning shutdown for displayport poll");
 
     /*
-     * Determine if should shutdown thread
+     * Determine if should shutdown polling
      *
      * getDisplayPortUsbPathHelper locates a DisplayPort directory, no need to double check
      * directory.
@@ -361,15 +332,19 @@ void UsbDp::shutdownDisplayPortPoll(bool force) {
      * Force is put in place to shutdown even when displayPortUsbPath is still present.
      * Happens when back to back BIND events are sent and fds are no longer current.
      */
-    if (!mPollRunning ||
+    if ((!mPollRunning && !mPollStarting) ||
         (!force && getDisplayPortUsbPathHelper(&displayPortUsbPath) == Status::SUCCESS)) {
         return;
     }
     // Shutdown is nonblocking to let other usb operations continue
-    if (pthread_create(&mDisplayPortShutdownHelper, NULL, shutdownDisplayPortPollWork, this)) {
-        ALOGE("usbdp: shutdown: shutdown worker pthread creation failed %d", errno);
-    }
-    ALOGI("usbdp: shutdown: shutdown thread initialized, force:%d", force);
+    UsbEventLoop::get().post([this] {
+        if (mPollRunning) {
+            stopDisplayPortPoll();
+        }
+        writeHpdOverride(mDrmPath, "0");
+        ALOGI("usbdp: shutdown: displayport poll shutdown complete.");
+    });
+    ALOGI("usbdp: shutdown: shutdown queued, force:%d", force);
 }
 
 /* Sysfs Helper Functions */
@@ -431,12 +406,22 @@ Status getDisplayPortUsbPathHelper(string *path) {
  */
 Status UsbDp::readDisplayPortAttribute(string attribute, string usb_path, string *value) {
     string attrPath;
+    // Held open by the running poll; only valid for the poll's usb_path
+    const unique_fd *attrFd = NULL;
+    bool needsPollPath = false;
+    bool readOk;
 
-    if (!strncmp(attribute.c_str(), "hpd", strlen("hpd")) ||
-        !strncmp(attribute.c_str(), "pin_assignment", strlen("pin_assignment"))) {
+    if (!strncmp(attribute.c_str(), "hpd", strlen("hpd"))) {
         attrPath = usb_path + attribute;
+        attrFd = &mHpdFd;
+        needsPollPath = true;
+    } else if (!strncmp(attribute.c_str(), "pin_assignment", strlen("pin_assignment"))) {
+        attrPath = usb_path + attribute;
+        attrFd = &mPinAssignmentFd;
+        needsPollPath = true;
     } else if (!strncmp(attribute.c_str(), "link_status", strlen("link_status"))) {
         attrPath = mDrmPath + "link_status";
+        attrFd = &mLinkStatusFd;
     } else if (!strncmp(attribute.c_str(), "vdo", strlen("vdo"))) {
         attrPath = usb_path + "/../vdo";
     } else {
@@ -444,7 +429,14 @@ Status UsbDp::readDisplayPortAttribute(string attribute, string usb_path, string
     }
 
     // Read Attribute
-    if (ReadFileToString(attrPath.c_str(), value)) {
+    pthread_mutex_lock(&mFdLock);
+    if (attrFd && *attrFd != -1 && (!needsPollPath || usb_path == mDisplayPortUsbPath)) {
+        readOk = readAttributeFdHelper(*attrFd, value);
+    } else {
+        readOk = ReadFileToString(attrPath.c_str(), value);
+    }
+    pthread_mutex_unlock(&mFdLock);
+    if (readOk) {
         return Status::SUCCESS;
     }
 
@@ -460,21 +452,21 @@ error:
  *
  * Input
  * @attribute: sysfs attribute to read. Function supports
- *     "hpd", "irq_hpd_count", "link_status", and "orientation"
- * @usb_path: path to the port partner's displayport sysfs group
- * @drm_path: path to the drm for link_status monitoring
+ *     "hpd", "irq_hpd_count", "pin_assignment", and "orientation"
+ * @usbFd: open fd of the usb sysfs attribute
  *
  * Return:
  * SUCCESS on successful write, ERROR otherwise
  */
-Status UsbDp::writeDisplayPortAttribute(string attribute, string usb_path) {
+Status UsbDp::writeDisplayPortAttribute(string attribute, int usbFd) {
     string attrUsb, attrDrm, attrDrmPath;
+    int drmFd = -1;
 
     // Get Drm Path
     attrDrmPath = mDrmPath + attribute;
 
     // Read Attribute
-    if (!ReadFileToString(usb_path, &attrUsb)) {
+    if (!readAttributeFdHelper(usbFd, &attrUsb)) {
         ALOGE("usbdp: Failed to open or read Type-C attribute %s", attribute.c_str());
         return Status::ERROR;
     }
@@ -482,9 +474,11 @@ Status UsbDp::writeDisplayPortAttribute(string attribute, string usb_path) {
 
     // Separate Logic for hpd and pin_assignment
     if (!strncmp(attribute.c_str(), "hpd", strlen("hpd"))) {
+        drmFd = mDrmHpdFd;
         if (!strncmp(attrUsb.c_str(), "0", strlen("0"))) {
             // Read DRM attribute to compare
-            if (!ReadFileToString(attrDrmPath, &attrDrm)) {
+            if (!(drmFd != -1 ? readAttributeFdHelper(drmFd, &attrDrm)
+                              : ReadFileToString(attrDrmPath, &attrDrm))) {
                 ALOGE("usbdp: Failed to open or read hpd from drm");
                 return Status::ERROR;
             }
@@ -508,6 +502,7 @@ Status UsbDp::writeDisplayPortAttribute(string attribute, string usb_path) {
             mIrqCountCache = temp;
         }
         attrDrmPath = mDrmPath + "irq_hpd";
+        drmFd = mDrmIrqHpdFd;
     } else if (!strncmp(attribute.c_str(), "pin_assignment", strlen("pin_assignment"))) {
         size_t pos = attrUsb.find("[");
         if (pos != string::npos) {
@@ -518,10 +513,13 @@ Status UsbDp::writeDisplayPortAttribute(string attribute, string usb_path) {
             ALOGI("usbdp: Pin config not yet chosen, nothing written.");
             return Status::ERROR;
         }
+        drmFd = mDrmPinAssignmentFd;
+    } else if (!strncmp(attribute.c_str(), "orientation", strlen("orientation"))) {
+        drmFd = mDrmOrientationFd;
     }
 
     // Write to drm
-    if (!WriteStringToFile(attrUsb, attrDrmPath)) {
+    if (!writeAttributeFdHelper(drmFd, attrUsb, attrDrmPath)) {
         ALOGE("usbdp: Failed to write attribute %s to drm: %s", attribute.c_str(), attrUsb.c_str());
         return Status::ERROR;
     }
@@ -548,7 +546,8 @@ Status UsbDp::writeHpdOverride(string drm_path, string value) {
     attrDrmPath = drm_path + "hpd";
 
     // Write to drm
-    if (!WriteStringToFile(value, attrDrmPath)) {
+    if (!writeAttributeFdHelper(drm_path == mDrmPath ? mDrmHpdFd.get() : -1, value,
+                                attrDrmPath)) {
         ALOGE("usbdp: hpd override failed: %s", value.c_str());
         return Status::ERROR;
     }
@@ -693,239 +692,229 @@ AltModeData::DisplayPortAltModeData constructAltModeData(string hpd, string pin_
 }
 
 /* Primary Poll Work */
-void UsbDp::displayPortPollWorkHelper() {
-    /* epoll fields */
-    int epoll_fd;
-    struct epoll_event ev_hpd, ev_pin, ev_orientation, ev_eventfd, ev_link;
-    struct epoll_event ev_debounce, ev_activate;
-    int epoll_flags = EPOLLIN | EPOLLET;
-    int epoll_nevents = 0;
-    /* fd fields */
-    int hpd_fd, pin_fd, orientation_fd, link_training_status_fd;
-    int fd_flags = O_RDONLY;
-    /* DisplayPort Link Setup statuses */
-    bool orientationSet = false, pinSet = false;
-    int activateRetryCount = 0;
+/**
+ * startDisplayPortPoll()
+ *
+ * Opens the DisplayPort sysfs attributes of the current connection and
+ * registers their handlers with the USB event loop. Runs on the loop thread.
+ */
+void UsbDp::startDisplayPortPoll() {
+    UsbEventLoop &loop = UsbEventLoop::get();
+    int fd_flags = O_RDONLY | O_CLOEXEC;
     /* File paths */
-    string displayPortUsbPath, irqHpdCountPath, hpdPath, pinAssignmentPath, orientationPath;
-    string tcpcBus, linkPath, partnerActivePath, portActivePath;
-    /* Other */
-    unsigned long res;
-    int ret = 0;
+    string displayPortUsbPath, irqHpdCountPath, hpdPath, pinAssignmentPath, linkPath;
+    uint64_t flag;
 
-    mPollRunning = true;
     mPollStarting = false;
 
     /*---------- Setup ----------*/
 
     if (getDisplayPortUsbPathHelper(&displayPortUsbPath) == Status::ERROR) {
         ALOGE("usbdp: worker: could not locate usb displayport directory");
-        goto usb_path_error;
+        return;
     }
 
     ALOGI("usbdp: worker: displayport usb path located at %s", displayPortUsbPath.c_str());
     hpdPath = displayPortUsbPath + "hpd";
     pinAssignmentPath = displayPortUsbPath + "pin_assignment";
-    orientationPath = "/sys/class/typec/port0/orientation";
     linkPath = string(mDrmPath) + "link_status";
 
-    partnerActivePath = displayPortUsbPath + "../mode1/active";
-    portActivePath = "/sys/class/typec/port0/port0.0/mode1/active";
-
     if (mClientPath.empty()) {
         ALOGE("usbdp: worker: mClientPath not defined");
-        goto bus_client_error;
+        return;
     }
 
     irqHpdCountPath = mClientPath + "irq_hpd_count";
     ALOGI("usbdp: worker: irqHpdCountPath:%s", irqHpdCountPath.c_str());
 
-    epoll_fd = epoll_create(64);
-    if (epoll_fd == -1) {
-        ALOGE("usbdp: worker: epoll_create failed; errno=%d", errno);
-        goto epoll_fd_error;
+    unique_fd hpdFd(displayPortPollOpenFileHelper(hpdPath.c_str(), fd_flags));
+    unique_fd pinFd(displayPortPollOpenFileHelper(pinAssignmentPath.c_str(), fd_flags));
+    unique_fd orientationFd(displayPortPollOpenFileHelper(kOrientationPath, fd_flags));
+    unique_fd linkFd(displayPortPollOpenFileHelper(linkPath.c_str(), fd_flags));
+    if (hpdFd == -1 || pinFd == -1 || orientationFd == -1 || linkFd == -1) {
+        return;
     }
 
-    if ((hpd_fd = displayPortPollOpenFileHelper(hpdPath.c_str(), fd_flags)) == -1) {
-        goto hpd_fd_error;
-    }
-    if ((pin_fd = displayPortPollOpenFileHelper(pinAssignmentPath.c_str(), fd_flags)) == -1) {
-        goto pin_fd_error;
-    }
-    if ((orientation_fd = displayPortPollOpenFileHelper(orientationPath.c_str(), fd_flags)) == -1) {
-        goto orientation_fd_error;
-    }
-    if ((link_training_status_fd = displayPortPollOpenFileHelper(linkPath.c_str(), fd_flags)) ==
-        -1) {
-        goto link_training_status_fd_error;
+    pthread_mutex_lock(&mFdLock);
+    mDisplayPortUsbPath = displayPortUsbPath;
+    mHpdFd = std::move(hpdFd);
+    mPinAssignmentFd = std::move(pinFd);
+    mOrientationFd = std::move(orientationFd);
+    mLinkStatusFd = std::move(linkFd);
+    // Not fatal here; reported when an IRQ_HPD check fails to read it
+    mIrqHpdCountFd.reset(displayPortPollOpenFileHelper(irqHpdCountPath.c_str(), fd_flags));
+    pthread_mutex_unlock(&mFdLock);
+
+    mPartnerActivePath = displayPortUsbPath + "../mode1/active";
+    mPinSet = false;
+    mOrientationSet = false;
+    mActivateRetryCount = 0;
+    mHpdHighPending = false;
+
+    // Drop signals left over from before this poll
+    read(mDisplayPortEventPipe, &flag, sizeof(flag));
+
+    if (!loop.addFd(mHpdFd, EPOLLIN | EPOLLET, [this](uint32_t) { onHpdEvent(); }) ||
+        !loop.addFd(mPinAssignmentFd, EPOLLIN | EPOLLET,
+                    [this](uint32_t) { onPinAssignmentEvent(); }) ||
+        !loop.addFd(mOrientationFd, EPOLLIN | EPOLLET, [this](uint32_t) { onOrientationEvent(); }) ||
+        !loop.addFd(mLinkStatusFd, EPOLLIN | EPOLLET, [this](uint32_t) { onLinkStatusEvent(); }) ||
+        !loop.addTimer(mDisplayPortDebounceTimer, [this] { onDebounceTimer(); }) ||
+        !loop.addTimer(mActivateTimer, [this] { onActivateTimer(); }) ||
+        !loop.addEventFd(mDisplayPortEventPipe, [this](uint64_t value) { onEventPipe(value); })) {
+        ALOGE("usbdp: worker: failed to register displayport fds with the event loop");
+        stopDisplayPortPoll();
+        return;
     }
+    mPollRunning = true;
 
-    // Set epoll_event events and flags
-    epoll_flags = EPOLLIN | EPOLLET;
-    ev_hpd.events = epoll_flags;
-    ev_pin.events = epoll_flags;
-    ev_orientation.events = epoll_flags;
-    ev_eventfd.events = epoll_flags;
-    ev_link.events = epoll_flags;
-    ev_debounce.events = epoll_flags;
-    ev_activate.events = epoll_flags;
+    /* Arm timer to see if DisplayPort Alt Mode Activates */
+    UsbEventLoop::armTimer(mActivateTimer, DISPLAYPORT_ACTIVATE_DEBOUNCE_MS);
+    ALOGI("usbdp: worker: displayport poll started");
+}
 
-    ev_hpd.data.fd = hpd_fd;
-    ev_pin.data.fd = pin_fd;
-    ev_orientation.data.fd = orientation_fd;
-    ev_eventfd.data.fd = mDisplayPortEventPipe;
-    ev_link.data.fd = link_training_status_fd;
-    ev_debounce.data.fd = mDisplayPortDebounceTimer;
-    ev_activate.data.fd = mActivateTimer;
+/**
+ * stopDisplayPortPoll()
+ *
+ * Unregisters and closes the DisplayPort sysfs attributes. Runs on the loop
+ * thread.
+ */
+void UsbDp::stopDisplayPortPoll() {
+    UsbEventLoop &loop = UsbEventLoop::get();
+
+    loop.removeFd(mHpdFd);
+    loop.removeFd(mPinAssignmentFd);
+    loop.removeFd(mOrientationFd);
+    loop.removeFd(mLinkStatusFd);
+    loop.removeFd(mDisplayPortDebounceTimer);
+    loop.removeFd(mActivateTimer);
+    loop.removeFd(mDisplayPortEventPipe);
+
+    /* Need to disarm so the next poll doesn't get old event */
+    UsbEventLoop::armTimer(mDisplayPortDebounceTimer, 0);
+    UsbEventLoop::armTimer(mActivateTimer, 0);
+
+    pthread_mutex_lock(&mFdLock);
+    mDisplayPortUsbPath.clear();
+    mHpdFd.reset();
+    mPinAssignmentFd.reset();
+    mOrientationFd.reset();
+    mLinkStatusFd.reset();
+    mIrqHpdCountFd.reset();
+    pthread_mutex_unlock(&mFdLock);
+
+    mHpdHighPending = false;
+    mPollRunning = false;
+    ALOGI("usbdp: worker: displayport poll stopped");
+}
 
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, hpd_fd, &ev_hpd) == -1) {
-        ALOGE("usbdp: worker: epoll_ctl failed to add hpd; errno=%d", errno);
-        goto error;
-    }
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, pin_fd, &ev_pin) == -1) {
-        ALOGE("usbdp: worker: epoll_ctl failed to add pin; errno=%d", errno);
-        goto error;
-    }
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, orientation_fd, &ev_orientation) == -1) {
-        ALOGE("usbdp: worker: epoll_ctl failed to add orientation; errno=%d", errno);
-        goto error;
+void UsbDp::onHpdEvent() {
+    steady_clock::time_point now = steady_clock::now();
+    string hpd;
+
+    if (!mPinSet || !mOrientationSet) {
+        ALOGW("usbdp: worker: HPD may be set before pin_assignment and orientation");
+        if (!mPinSet &&
+            writeDisplayPortAttribute("pin_assignment", mPinAssignmentFd) == Status::SUCCESS) {
+            mPinSet = true;
+        }
+        if (!mOrientationSet &&
+            writeDisplayPortAttribute("orientation", mOrientationFd) == Status::SUCCESS) {
+            mOrientationSet = true;
+        }
     }
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, link_training_status_fd, &ev_link) == -1) {
-        ALOGE("usbdp: worker: epoll_ctl failed to add link status; errno=%d", errno);
-        goto error;
+
+    mHpdHighPending =
+            readAttributeFdHelper(mHpdFd, &hpd) && !strncmp(hpd.c_str(), "1", strlen("1"));
+    if (mHpdHighPending) {
+        mHpdHighTime = now;
     }
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, mDisplayPortDebounceTimer, &ev_debounce) == -1) {
-        ALOGE("usbdp: worker: epoll_ctl failed to add framework update debounce; errno=%d", errno);
-        goto error;
+    if (writeDisplayPortAttribute("hpd", mHpdFd) == Status::SUCCESS && mHpdHighPending) {
+        pthread_mutex_lock(&mFdLock);
+        mHpdToDrmLatency.record(
+                duration_cast<microseconds>(steady_clock::now() - mHpdHighTime).count());
+        pthread_mutex_unlock(&mFdLock);
     }
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, mActivateTimer, &ev_activate) == -1) {
-        ALOGE("usbdp: worker: epoll_ctl failed to add activate debounce; errno=%d", errno);
-        goto error;
+    UsbEventLoop::armTimer(mDisplayPortDebounceTimer, DISPLAYPORT_STATUS_DEBOUNCE_MS);
+}
+
+void UsbDp::onPinAssignmentEvent() {
+    if (writeDisplayPortAttribute("pin_assignment", mPinAssignmentFd) == Status::SUCCESS) {
+        mPinSet = true;
+        UsbEventLoop::armTimer(mDisplayPortDebounceTimer, DISPLAYPORT_STATUS_DEBOUNCE_MS);
     }
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, mDisplayPortEventPipe, &ev_eventfd) == -1) {
-        ALOGE("usbdp: worker: epoll_ctl failed to add event pipe; errno=%d", errno);
-        goto error;
+}
+
+void UsbDp::onOrientationEvent() {
+    if (writeDisplayPortAttribute("orientation", mOrientationFd) == Status::SUCCESS) {
+        mOrientationSet = true;
+        UsbEventLoop::armTimer(mDisplayPortDebounceTimer, DISPLAYPORT_STATUS_DEBOUNCE_MS);
     }
+}
 
-    /* Arm timer to see if DisplayPort Alt Mode Activates */
-    armTimerFdHelper(mActivateTimer, DISPLAYPORT_ACTIVATE_DEBOUNCE_MS);
+void UsbDp::onLinkStatusEvent() {
+    string linkStatus;
+
+    if (mHpdHighPending && readAttributeFdHelper(mLinkStatusFd, &linkStatus)) {
+        LinkTrainingStatus status = parseLinkTrainingStatusHelper(linkStatus);
 
-    while (!destroyDisplayPortThread) {
-        struct epoll_event events[64];
+        if (status == LinkTrainingStatus::SUCCESS) {
+            int64_t us = duration_cast<microseconds>(steady_clock::now() - mHpdHighTime).count();
 
-        epoll_nevents = epoll_wait(epoll_fd, events, 64, -1);
-        if (epoll_nevents == -1) {
-            if (errno == EINTR)
-                continue;
-            ALOGE("usbdp: worker: epoll_wait failed; errno=%d", errno);
-            break;
+            pthread_mutex_lock(&mFdLock);
+            mHpdToLinkTrainedLatency.record(us);
+            pthread_mutex_unlock(&mFdLock);
+            ALOGI("usbdp: link trained %" PRId64 "us after hpd", us);
         }
+        if (status != LinkTrainingStatus::UNKNOWN) {
+            mHpdHighPending = false;
+        }
+    }
+    UsbEventLoop::armTimer(mDisplayPortDebounceTimer, DISPLAYPORT_STATUS_DEBOUNCE_MS);
+}
 
-        for (int n = 0; n < epoll_nevents; n++) {
-            if (events[n].data.fd == hpd_fd) {
-                if (!pinSet || !orientationSet) {
-                    ALOGW("usbdp: worker: HPD may be set before pin_assignment and orientation");
-                    if (!pinSet && writeDisplayPortAttribute("pin_assignment", pinAssignmentPath) ==
-                                           Status::SUCCESS) {
-                        pinSet = true;
-                    }
-                    if (!orientationSet &&
-                        writeDisplayPortAttribute("orientation", orientationPath) ==
-                                Status::SUCCESS) {
-                        orientationSet = true;
-                    }
-                }
-                writeDisplayPortAttribute("hpd", hpdPath);
-                armTimerFdHelper(mDisplayPortDebounceTimer, DISPLAYPORT_STATUS_DEBOUNCE_MS);
-            } else if (events[n].data.fd == pin_fd) {
-                if (writeDisplayPortAttribute("pin_assignment", pinAssignmentPath) ==
-                    Status::SUCCESS) {
-                    pinSet = true;
-                    armTimerFdHelper(mDisplayPortDebounceTimer, DISPLAYPORT_STATUS_DEBOUNCE_MS);
-                }
-            } else if (events[n].data.fd == orientation_fd) {
-                if (writeDisplayPortAttribute("orientation", orientationPath) == Status::SUCCESS) {
-                    orientationSet = true;
-                    armTimerFdHelper(mDisplayPortDebounceTimer, DISPLAYPORT_STATUS_DEBOUNCE_MS);
-                }
-            } else if (events[n].data.fd == link_training_status_fd) {
-                armTimerFdHelper(mDisplayPortDebounceTimer, DISPLAYPORT_STATUS_DEBOUNCE_MS);
-            } else if (events[n].data.fd == mDisplayPortDebounceTimer) {
-                ret = read(mDisplayPortDebounceTimer, &res, sizeof(res));
-                ALOGI("usbdp: dp debounce triggered, val:%lu ret:%d", res, ret);
-                if (ret < 0) {
-                    ALOGW("usbdp: debounce read errno:%d", errno);
-                    continue;
-                }
-                if (mCallback) {
-                    mCallback(mPayload);
-                }
-            } else if (events[n].data.fd == mActivateTimer) {
-                string activePartner, activePort;
-
-                if (ReadFileToString(partnerActivePath.c_str(), &activePartner) &&
-                    ReadFileToString(portActivePath.c_str(), &activePort)) {
-                    // Retry activate signal when DisplayPort Alt Mode is active on port but not
-                    // partner.
-                    if (!strncmp(activePartner.c_str(), "no", strlen("no")) &&
-                        !strncmp(activePort.c_str(), "yes", strlen("yes")) &&
-                        activateRetryCount < DISPLAYPORT_ACTIVATE_MAX_RETRIES) {
-                        if (!WriteStringToFile("1", partnerActivePath)) {
-                            ALOGE("usbdp: Failed to activate port partner Alt Mode");
-                        } else {
-                            ALOGI("usbdp: Attempting to activate port partner Alt Mode");
-                        }
-                        activateRetryCount++;
-                        armTimerFdHelper(mActivateTimer, DISPLAYPORT_ACTIVATE_DEBOUNCE_MS);
-                    } else {
-                        ALOGI("usbdp: DisplayPort Alt Mode is active, or disabled on port");
-                    }
-                } else {
-                    activateRetryCount++;
-                    armTimerFdHelper(mActivateTimer, DISPLAYPORT_ACTIVATE_DEBOUNCE_MS);
-                    ALOGE("usbdp: Failed to read active state from port or partner");
-                }
-            } else if (events[n].data.fd == mDisplayPortEventPipe) {
-                uint64_t flag = 0;
-                if (!read(mDisplayPortEventPipe, &flag, sizeof(flag))) {
-                    if (errno == EAGAIN)
-                        continue;
-                    ALOGI("usbdp: worker: Shutdown eventfd read error");
-                    goto error;
-                }
-                if (flag == DISPLAYPORT_SHUTDOWN_SET) {
-                    ALOGI("usbdp: worker: Shutdown eventfd triggered");
-                    destroyDisplayPortThread = true;
-                    break;
-                } else if (flag == DISPLAYPORT_IRQ_HPD_COUNT_CHECK) {
-                    ALOGI("usbdp: worker: IRQ_HPD event through DISPLAYPORT_IRQ_HPD_COUNT_CHECK");
-                    writeDisplayPortAttribute("irq_hpd_count", irqHpdCountPath);
-                }
+void UsbDp::onDebounceTimer() {
+    ALOGI("usbdp: dp debounce triggered");
+    if (mCallback) {
+        mCallback(mPayload);
+    }
+}
+
+void UsbDp::onActivateTimer() {
+    string activePartner, activePort;
+
+    if (ReadFileToString(mPartnerActivePath.c_str(), &activePartner) &&
+        ReadFileToString(kPortActivePath, &activePort)) {
+        // Retry activate signal when DisplayPort Alt Mode is active on port but not
+        // partner.
+        if (!strncmp(activePartner.c_str(), "no", strlen("no")) &&
+            !strncmp(activePort.c_str(), "yes", strlen("yes")) &&
+            mActivateRetryCount < DISPLAYPORT_ACTIVATE_MAX_RETRIES) {
+            if (!WriteStringToFile("1", mPartnerActivePath)) {
+                ALOGE("usbdp: Failed to activate port partner Alt Mode");
+            } else {
+                ALOGI("usbdp: Attempting to activate port partner Alt Mode");
             }
+            mActivateRetryCount++;
+            UsbEventLoop::armTimer(mActivateTimer, DISPLAYPORT_ACTIVATE_DEBOUNCE_MS);
+        } else {
+            ALOGI("usbdp: DisplayPort Alt Mode is active, or disabled on port");
         }
+    } else {
+        mActivateRetryCount++;
+        UsbEventLoop::armTimer(mActivateTimer, DISPLAYPORT_ACTIVATE_DEBOUNCE_MS);
+        ALOGE("usbdp: Failed to read active state from port or partner");
     }
+}
 
-error:
-    /* Need to disarm so new threads don't get old event */
-    armTimerFdHelper(mDisplayPortDebounceTimer, 0);
-    armTimerFdHelper(mActivateTimer, 0);
-    close(link_training_status_fd);
-link_training_status_fd_error:
-    close(orientation_fd);
-orientation_fd_error:
-    close(pin_fd);
-pin_fd_error:
-    close(hpd_fd);
-hpd_fd_error:
-    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, mDisplayPortDebounceTimer, &ev_debounce);
-    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, mActivateTimer, &ev_activate);
-    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, mDisplayPortEventPipe, &ev_eventfd);
-    close(epoll_fd);
-epoll_fd_error:
-bus_client_error:
-usb_path_error:
-    mPollRunning = false;
-    ALOGI("usbdp: worker: exiting worker thread");
+void UsbDp::onEventPipe(uint64_t flag) {
+    if (flag == DISPLAYPORT_SHUTDOWN_SET) {
+        ALOGI("usbdp: worker: Shutdown eventfd triggered");
+        stopDisplayPortPoll();
+    } else if (flag == DISPLAYPORT_IRQ_HPD_COUNT_CHECK) {
+        ALOGI("usbdp: worker: IRQ_HPD event through DISPLAYPORT_IRQ_HPD_COUNT_CHECK");
+        writeDisplayPortAttribute("irq_hpd_count", mIrqHpdCountFd);
+    }
 }
 
 }  // namespace usb
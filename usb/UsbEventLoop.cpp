@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "libpixelusb-UsbEventLoop"
+
+#include "include/pixelusb/UsbEventLoop.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <utils/Log.h>
+
+#include <future>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+namespace usb {
+
+using ::android::base::unique_fd;
+
+constexpr int kMaxEvents = 16;
+// epoll key of mWakeFd; handler keys start above it.
+constexpr uint64_t kWakeKey = 0;
+
+static thread_local bool tIsLoopThread = false;
+
+UsbEventLoop &UsbEventLoop::get() {
+    // Never destroyed: the loop thread runs until the process exits.
+    static UsbEventLoop *loop = new UsbEventLoop();
+    return *loop;
+}
+
+UsbEventLoop::UsbEventLoop() : mNextKey(kWakeKey + 1) {
+    unique_fd epollFd(epoll_create1(EPOLL_CLOEXEC));
+    if (epollFd == -1) {
+        ALOGE("epoll_create1 failed: %d", errno);
+        abort();
+    }
+
+    unique_fd wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+    if (wakeFd == -1) {
+        ALOGE("eventfd failed: %d", errno);
+        abort();
+    }
+
+    struct epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.u64 = kWakeKey;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event)) {
+        ALOGE("epoll_ctl failed to add wake fd: %d", errno);
+        abort();
+    }
+
+    mEpollFd = std::move(epollFd);
+    mWakeFd = std::move(wakeFd);
+    mThread = std::thread(&UsbEventLoop::run, this);
+}
+
+bool UsbEventLoop::addFd(int fd, uint32_t events, FdHandler handler) {
+    std::lock_guard<std::mutex> lock(mLock);
+    struct epoll_event event {};
+    uint64_t key = mNextKey;
+
+    if (mKeys.count(fd)) {
+        ALOGE("fd %d is already registered", fd);
+        return false;
+    }
+
+    event.events = events;
+    event.data.u64 = key;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &event)) {
+        ALOGE("epoll_ctl failed to add fd %d: %d", fd, errno);
+        return false;
+    }
+
+    mNextKey++;
+    mKeys[fd] = key;
+    mHandlers[key] = std::make_shared<FdHandler>(std::move(handler));
+    return true;
+}
+
+static bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        ALOGE("failed to make fd %d non-blocking: %d", fd, errno);
+        return false;
+    }
+    return true;
+}
+
+bool UsbEventLoop::addTimer(int timerFd, TimerHandler handler, uint32_t events) {
+    if (!setNonBlocking(timerFd))
+        return false;
+
+    return addFd(timerFd, events, [timerFd, handler = std::move(handler)](uint32_t) {
+        uint64_t expirations;
+
+        if (read(timerFd, &expirations, sizeof(expirations)) != sizeof(expirations))
+            return;
+        handler();
+    });
+}
+
+bool UsbEventLoop::addEventFd(int eventFd, EventHandler handler) {
+    if (!setNonBlocking(eventFd))
+        return false;
+
+    return addFd(eventFd, EPOLLIN, [eventFd, handler = std::move(handler)](uint32_t) {
+        uint64_t value;
+
+        if (read(eventFd, &value, sizeof(value)) != sizeof(value))
+            return;
+        handler(value);
+    });
+}
+
+void UsbEventLoop::removeFd(int fd) {
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mKeys.find(fd);
+
+    if (it == mKeys.end())
+        return;
+
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, NULL))
+        ALOGE("epoll_ctl failed to remove fd %d: %d", fd, errno);
+    mHandlers.erase(it->second);
+    mKeys.erase(it);
+}
+
+void UsbEventLoop::post(Task task) {
+    uint64_t one = 1;
+
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mTasks.push_back(std::move(task));
+    }
+    if (TEMP_FAILURE_RETRY(write(mWakeFd, &one, sizeof(one))) < 0)
+        ALOGE("failed to wake event loop: %d", errno);
+}
+
+void UsbEventLoop::runSync(Task task) {
+    if (isLoopThread()) {
+        task();
+        return;
+    }
+
+    std::promise<void> done;
+    post([&task, &done] {
+        task();
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+bool UsbEventLoop::isLoopThread() const {
+    return tIsLoopThread;
+}
+
+int UsbEventLoop::armTimer(int timerFd, int ms) {
+    struct itimerspec ts {};
+    int ret;
+
+    ts.it_value.tv_sec = ms / 1000;
+    ts.it_value.tv_nsec = (ms % 1000) * 1000000;
+
+    ret = timerfd_settime(timerFd, 0, &ts, NULL);
+    if (ret < 0)
+        ALOGE("failed to arm timer fd %d: %d", timerFd, errno);
+
+    return ret;
+}
+
+void UsbEventLoop::runTasks() {
+    std::vector<Task> tasks;
+    uint64_t count;
+
+    read(mWakeFd, &count, sizeof(count));
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        tasks.swap(mTasks);
+    }
+    for (auto &task : tasks)
+        task();
+}
+
+void UsbEventLoop::run() {
+    struct epoll_event events[kMaxEvents];
+
+    tIsLoopThread = true;
+    pthread_setname_np(pthread_self(), "UsbEventLoop");
+
+    while (true) {
+        int nrEvents = epoll_wait(mEpollFd, events, kMaxEvents, -1);
+
+        if (nrEvents == -1) {
+            if (errno != EINTR)
+                ALOGE("epoll_wait failed: %d", errno);
+            continue;
+        }
+
+        for (int i = 0; i < nrEvents; i++) {
+            std::shared_ptr<FdHandler> handler;
+
+            if (events[i].data.u64 == kWakeKey) {
+                runTasks();
+                continue;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mLock);
+                auto it = mHandlers.find(events[i].data.u64);
+                if (it == mHandlers.end())
+                    continue;
+                handler = it->second;
+            }
+            (*handler)(events[i].events);
+        }
+    }
+}
+
+}  // namespace usb
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
@@ -23,6 +23,8 @@
 #include <thermalutils/ThermalHidlWrapper.h>
 #include <time.h>
 
+#include "include/pixelusb/UsbEventLoop.h"
+
 namespace android {
 namespace hardware {
 namespace google {
@@ -32,75 +34,45 @@ namespace usb {
 // Start monitoring the temperature
 static volatile bool monitorTemperature;
 
-constexpr int kEpollEvents = 10;
 constexpr char kOverheatLock[] = "overheat";
 constexpr char kWakeLockPath[] = "/sys/power/wake_lock";
 constexpr char kWakeUnlockPath[] = "/sys/power/wake_unlock";
 
-int addEpollFdWakeUp(const unique_fd &epfd, const unique_fd &fd) {
-    struct epoll_event event {};
-    int ret;
-
-    event.data.fd = fd;
-    event.events = EPOLLIN | EPOLLWAKEUP;
-
-    ret = epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &event);
-    if (ret)
-        ALOGE("epoll_ctl error %d", errno);
-
-    return ret;
-}
-
 UsbOverheatEvent::UsbOverheatEvent(const ZoneInfo &monitored_zone,
                                    const std::vector<ZoneInfo> &queried_zones,
                                    const int &monitor_interval_sec)
     : monitored_zone_(monitored_zone),
       queried_zones_(queried_zones),
       monitor_interval_sec_(monitor_interval_sec),
-      monitor_() {
-    int fd = timerfd_create(CLOCK_BOOTTIME_ALARM, 0);
-    if (fd < 0) {
-        ALOGE("timerfd_create failed: %d", errno);
-    }
-
-    unique_fd timerFd(timerfd_create(CLOCK_BOOTTIME_ALARM, 0));
+      max_overheat_temp_(0) {
+    unique_fd timerFd(timerfd_create(CLOCK_BOOTTIME_ALARM, TFD_NONBLOCK));
     if (timerFd == -1) {
         ALOGE("timerFd failed to create %d", errno);
         abort();
     }
+    timer_fd_ = std::move(timerFd);
 
-    unique_fd epollFd(epoll_create(2));
-    if (epollFd == -1) {
-        ALOGE("epoll_fd_ failed to create %d", errno);
-        abort();
-    }
-
-    unique_fd eventFd(eventfd(0, 0));
-    if (eventFd == -1) {
-        ALOGE("event_fd_ failed to create %d", errno);
-        abort();
-    }
-
-    if (addEpollFdWakeUp(epollFd, timerFd) == -1) {
+    // EPOLLWAKEUP keeps the system awake from the alarm until the sample is taken
+    if (!UsbEventLoop::get().addTimer(
+                timer_fd_,
+                [this] {
+                    ALOGI("Wake up caused by timer fd");
+                    sampleTemperatures();
+                },
+                EPOLLIN | EPOLLWAKEUP)) {
         ALOGE("Adding timerFd failed");
         abort();
     }
 
-    if (addEpollFdWakeUp(epollFd, eventFd) == -1) {
-        ALOGE("Adding eventFd failed");
-        abort();
-    }
-
-    epoll_fd_ = std::move(epollFd);
-    timer_fd_ = std::move(timerFd);
-    event_fd_ = std::move(eventFd);
-
-    monitor_ = unique_ptr<thread>(new thread(this->monitorThread, this));
     registerListener();
 }
 
 UsbOverheatEvent::~UsbOverheatEvent() {
+    UsbEventLoop &loop = UsbEventLoop::get();
+
     unregisterThermalCallback();
+    // Also waits out samples already posted by wakeupMonitor()
+    loop.runSync([this, &loop] { loop.removeFd(timer_fd_); });
 }
 
 static int wakelock_cnt = 0;
@@ -130,63 +102,35 @@ static void wakeLockRelease() {
     }
 }
 
-void *UsbOverheatEvent::monitorThread(void *param) {
-    auto *overheatEvent = reinterpret_cast<UsbOverheatEvent *>(param);
-    struct epoll_event events[kEpollEvents];
+void UsbOverheatEvent::sampleTemperatures() {
     struct itimerspec delay = itimerspec();
+    hidl_vec<Temperature> temperatures;
+    string status;
 
-    while (true) {
-        uint64_t fired;
-        float temperature = 0;
-        string status;
-
-        for (vector<ZoneInfo>::size_type i = 0; i < overheatEvent->queried_zones_.size(); i++) {
-            if (overheatEvent->getCurrentTemperature(overheatEvent->queried_zones_[i].name_,
-                                                     &temperature)) {
+    wakeLockAcquire();
+    // One query returns every USB port sensor
+    if (getUsbPortTemperatures(&temperatures)) {
+        for (vector<ZoneInfo>::size_type i = 0; i < queried_zones_.size(); i++) {
+            for (const auto &temperature : temperatures) {
+                if (temperature.name != queried_zones_[i].name_)
+                    continue;
                 if (i == 0)
-                    overheatEvent->max_overheat_temp_ =
-                            max(temperature, overheatEvent->max_overheat_temp_);
-                status.append(overheatEvent->queried_zones_[i].name_);
+                    max_overheat_temp_ = max(temperature.value, max_overheat_temp_);
+                status.append(queried_zones_[i].name_);
                 status.append(":");
-                status.append(std::to_string(temperature));
+                status.append(std::to_string(temperature.value));
                 status.append(" ");
             }
         }
-        ALOGW("%s", status.c_str());
-
-        delay.it_value.tv_sec = monitorTemperature ? overheatEvent->monitor_interval_sec_ : 0;
-        int ret = timerfd_settime(overheatEvent->timer_fd_, 0, &delay, NULL);
-        if (ret < 0) {
-            ALOGE("timerfd_settime failed. err:%d tv_sec:%ld", errno, delay.it_value.tv_sec);
-            continue;
-        }
-
-        wakeLockRelease();
-        int nrEvents = epoll_wait(overheatEvent->epoll_fd_, events, kEpollEvents, -1);
-        wakeLockAcquire();
-        if (nrEvents <= 0) {
-            ALOGE("nrEvents negative skipping");
-            continue;
-        }
+    }
+    ALOGW("%s", status.c_str());
 
-        for (int i = 0; i < nrEvents; i++) {
-            ALOGV("event=%u on fd=%d\n", events[i].events, events[i].data.fd);
-
-            if (events[i].data.fd == overheatEvent->timer_fd_) {
-                ALOGI("Wake up caused by timer fd");
-                int numRead = read(overheatEvent->timer_fd_, &fired, sizeof(fired));
-                if (numRead != sizeof(fired)) {
-                    ALOGV("numRead incorrect");
-                }
-                if (fired != 1) {
-                    ALOGV("Fired not set to 1");
-                }
-            } else {
-                ALOGI("Wake up caused by event fd");
-                read(overheatEvent->event_fd_, &fired, sizeof(fired));
-            }
-        }
+    delay.it_value.tv_sec = monitorTemperature ? monitor_interval_sec_ : 0;
+    int ret = timerfd_settime(timer_fd_, 0, &delay, NULL);
+    if (ret < 0) {
+        ALOGE("timerfd_settime failed. err:%d tv_sec:%ld", errno, delay.it_value.tv_sec);
     }
+    wakeLockRelease();
 }
 
 bool UsbOverheatEvent::registerListener() {
@@ -253,13 +197,13 @@ void UsbOverheatEvent::unregisterThermalCallback() {
 }
 
 void UsbOverheatEvent::wakeupMonitor() {
-    // <flag> value does not have any significance here
-    uint64_t flag = 100;
-
-    unsigned long ret = TEMP_FAILURE_RETRY(write(event_fd_, &flag, sizeof(flag)));
-    if (ret < 0) {
-        ALOGE("Error writing eventfd errno=%d", errno);
-    }
+    // Held until the loop has taken the sample
+    wakeLockAcquire();
+    UsbEventLoop::get().post([this] {
+        ALOGI("Wake up caused by event");
+        sampleTemperatures();
+        wakeLockRelease();
+    });
 }
 
 bool UsbOverheatEvent::startRecording() {
@@ -268,7 +212,6 @@ bool UsbOverheatEvent::startRecording() {
     if (monitorTemperature)
         return true;
 
-    wakeLockAcquire();
     monitorTemperature = true;
     wakeupMonitor();
     return true;
@@ -280,28 +223,36 @@ bool UsbOverheatEvent::stopRecording() {
     if (!monitorTemperature)
         return true;
 
-    wakeLockRelease();
     monitorTemperature = false;
-    wakeupMonitor();
+    // No sample needed to cool down; just stop the alarm
+    UsbEventLoop::get().post([this] {
+        if (!monitorTemperature)
+            UsbEventLoop::armTimer(timer_fd_, 0);
+    });
 
     return true;
 }
 
-bool UsbOverheatEvent::getCurrentTemperature(const string &name, float *temp) {
+bool UsbOverheatEvent::getUsbPortTemperatures(hidl_vec<Temperature> *temperatures) {
     ThermalStatus thermal_status;
-    hidl_vec<Temperature> thermal_temperatures;
     const std::lock_guard<std::mutex> lock(thermal_hal_mutex_);
     if (thermal_service_ == NULL)
         return false;
 
     auto ret = thermal_service_->getCurrentTemperatures(
             false, TemperatureType::USB_PORT,
-            [&](ThermalStatus status, hidl_vec<Temperature> temperatures) {
+            [&](ThermalStatus status, hidl_vec<Temperature> result) {
                 thermal_status = status;
-                thermal_temperatures = temperatures;
+                *temperatures = result;
             });
 
-    if (ret.isOk() && thermal_status.code == ThermalStatusCode::SUCCESS) {
+    return ret.isOk() && thermal_status.code == ThermalStatusCode::SUCCESS;
+}
+
+bool UsbOverheatEvent::getCurrentTemperature(const string &name, float *temp) {
+    hidl_vec<Temperature> thermal_temperatures;
+
+    if (getUsbPortTemperatures(&thermal_temperatures)) {
         for (auto temperature : thermal_temperatures) {
             if (temperature.name == name) {
                 *temp = temperature.value;
@@ -347,6 +298,12 @@ Return<void> UsbOverheatEvent::notifyThrottling(const Temperature &temperature)
     ALOGV("notifyThrottling '%s' T=%2.2f throttlingStatus=%d", temperature.name.c_str(),
           temperature.value, temperature.throttlingStatus);
     if (temperature.type == monitored_zone_.type_) {
+        // The callback carries a reading; count it without waiting for a sample
+        if (!queried_zones_.empty() && temperature.name == queried_zones_[0].name_) {
+            float value = temperature.value;
+            UsbEventLoop::get().post(
+                    [this, value] { max_overheat_temp_ = max(value, max_overheat_temp_); });
+        }
         if (temperature.throttlingStatus >= monitored_zone_.severity_) {
             startRecording();
         } else {
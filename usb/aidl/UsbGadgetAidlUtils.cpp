@@ -33,7 +33,6 @@ using ::aidl::android::hardware::usb::gadget::GadgetFunction;
 using ::android::base::GetBoolProperty;
 using ::android::base::GetProperty;
 using ::android::base::SetProperty;
-using ::android::base::WriteStringToFile;
 
 Status setVidPid(const char *vid, const char *pid) {
     return setVidPidCommon(vid, pid) ? Status::SUCCESS : Status::ERROR;
@@ -43,12 +42,20 @@ Status resetGadget() {
     return resetGadgetCommon() ? Status::SUCCESS : Status::ERROR;
 }
 
+Status pullDownGadget() {
+    return pullDownGadgetCommon() ? Status::SUCCESS : Status::ERROR;
+}
+
+Status removeStaleFunctions(int functionCount) {
+    return unlinkFunctionsFrom(CONFIG_PATH, functionCount) ? Status::ERROR : Status::SUCCESS;
+}
+
 Status addGenericAndroidFunctions(MonitorFfs *monitorFfs, uint64_t functions, bool *ffsEnabled,
                                   int *functionCount) {
     if (((functions & GadgetFunction::MTP) != 0)) {
         *ffsEnabled = true;
         ALOGI("setCurrentUsbFunctions mtp");
-        if (!WriteStringToFile("1", DESC_USE_PATH))
+        if (!writeIfChanged("1", DESC_USE_PATH))
             return Status::ERROR;
 
         if (!monitorFfs->addInotifyFd("/dev/usb-ffs/mtp/"))
@@ -64,7 +71,7 @@ Status addGenericAndroidFunctions(MonitorFfs *monitorFfs, uint64_t functions, bo
     } else if (((functions & GadgetFunction::PTP) != 0)) {
         *ffsEnabled = true;
         ALOGI("setCurrentUsbFunctions ptp");
-        if (!WriteStringToFile("1", DESC_USE_PATH))
+        if (!writeIfChanged("1", DESC_USE_PATH))
             return Status::ERROR;
 
         if (!monitorFfs->addInotifyFd("/dev/usb-ffs/ptp/"))
@@ -127,7 +134,7 @@ Status addGenericAndroidFunctions(MonitorFfs *monitorFfs, uint64_t functions, bo
 
 Status addAdb(MonitorFfs *monitorFfs, int *functionCount) {
     ALOGI("setCurrentUsbFunctions Adb");
-    if (!WriteStringToFile("1", DESC_USE_PATH))
+    if (!writeIfChanged("1", DESC_USE_PATH))
         return Status::ERROR;
 
     if (!monitorFfs->addInotifyFd("/dev/usb-ffs/adb/"))
@@ -30,7 +30,6 @@ namespace usb {
 
 using ::android::base::GetProperty;
 using ::android::base::SetProperty;
-using ::android::base::WriteStringToFile;
 using ::android::hardware::usb::gadget::V1_0::GadgetFunction;
 
 Status setVidPid(const char *vid, const char *pid) {
@@ -41,12 +40,20 @@ Status resetGadget() {
     return resetGadgetCommon() ? Status::SUCCESS : Status::ERROR;
 }
 
+Status pullDownGadget() {
+    return pullDownGadgetCommon() ? Status::SUCCESS : Status::ERROR;
+}
+
+Status removeStaleFunctions(int functionCount) {
+    return unlinkFunctionsFrom(CONFIG_PATH, functionCount) ? Status::ERROR : Status::SUCCESS;
+}
+
 Status addGenericAndroidFunctions(MonitorFfs *monitorFfs, uint64_t functions, bool *ffsEnabled,
                                   int *functionCount) {
     if (((functions & GadgetFunction::MTP) != 0)) {
         *ffsEnabled = true;
         ALOGI("setCurrentUsbFunctions mtp");
-        if (!WriteStringToFile("1", DESC_USE_PATH))
+        if (!writeIfChanged("1", DESC_USE_PATH))
             return Status::ERROR;
 
         if (!monitorFfs->addInotifyFd("/dev/usb-ffs/mtp/"))
@@ -62,7 +69,7 @@ Status addGenericAndroidFunctions(MonitorFfs *monitorFfs, uint64_t functions, bo
     } else if (((functions & GadgetFunction::PTP) != 0)) {
         *ffsEnabled = true;
         ALOGI("setCurrentUsbFunctions ptp");
-        if (!WriteStringToFile("1", DESC_USE_PATH))
+        if (!writeIfChanged("1", DESC_USE_PATH))
             return Status::ERROR;
 
         if (!monitorFfs->addInotifyFd("/dev/usb-ffs/ptp/"))
@@ -113,7 +120,7 @@ Status addGenericAndroidFunctions(MonitorFfs *monitorFfs, uint64_t functions, bo
 
 Status addAdb(MonitorFfs *monitorFfs, int *functionCount) {
     ALOGI("setCurrentUsbFunctions Adb");
-    if (!WriteStringToFile("1", DESC_USE_PATH))
+    if (!writeIfChanged("1", DESC_USE_PATH))
         return Status::ERROR;
 
     if (!monitorFfs->addInotifyFd("/dev/usb-ffs/adb/"))
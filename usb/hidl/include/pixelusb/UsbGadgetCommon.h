@@ -39,6 +39,12 @@ Status addGenericAndroidFunctions(MonitorFfs *monitorFfs, uint64_t functions, bo
                                   int *functionCount);
 // Pulls down USB gadget.
 Status resetGadget();
+// Pulls down USB gadget but keeps the function links, so that a
+// reconfiguration only relinks the functions that change. Call
+// removeStaleFunctions() once all functions are added.
+Status pullDownGadget();
+// Removes the function links left from the previous configuration.
+Status removeStaleFunctions(int functionCount);
 
 }  // namespace usb
 }  // namespace pixel
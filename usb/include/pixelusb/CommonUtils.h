@@ -36,6 +36,8 @@ constexpr bool kDebug = false;
 constexpr int kDisconnectWaitUs = 100000;
 constexpr int kPullUpDelay = 500000;
 constexpr int kShutdownMonitor = 100;
+// Android metrics requires number of elements in any repeated field cannot exceed 127 elements
+constexpr int kWestworldRepeatedFieldSizeLimit = 127;
 
 constexpr char kBuildType[] = "ro.build.type";
 constexpr char kPersistentVendorConfig[] = "persist.vendor.usb.usbradio.config";
@@ -61,6 +63,7 @@ constexpr char kUvcEnabled[] = "ro.usb.uvc.enabled";
 
 using ::android::base::boot_clock;
 using android::hardware::google::pixel::PixelAtoms::VendorUsbDataSessionEvent;
+using android::hardware::google::pixel::PixelAtoms::VendorUsbDataSessionEvent_UsbDeviceState;
 
 // Adds the given fd to the epollfd(epfd).
 int addEpollFd(const ::android::base::unique_fd &epfd, const ::android::base::unique_fd &fd);
@@ -68,12 +71,26 @@ int addEpollFd(const ::android::base::unique_fd &epfd, const ::android::base::un
 std::string getVendorFunctions();
 // Removes all the usb functions link in the specified path.
 int unlinkFunctions(const char *path);
-// Creates a configfs link for the function.
+// Removes the usb function links numbered index and above in the specified path.
+int unlinkFunctionsFrom(const char *path, int index);
+// Creates a configfs link for the function. A link already at index that
+// points to the function is kept; any other is replaced together with the
+// links after it, so the kernel still sees the functions in index order.
 int linkFunction(const char *function, int index);
+// Writes value to path unless the attribute already holds it. Numbers
+// compare by value, so "0" matches an attribute that reads "0x00".
+bool writeIfChanged(const std::string &value, const char *path);
 // Sets the USB VID and PID. Returns true on success, false on failure
 bool setVidPidCommon(const char *vid, const char *pid);
+// Pulls down USB gadget and clears the device descriptors, keeping the
+// function links so that relinking the same functions costs nothing.
+// Finish with unlinkFunctionsFrom(CONFIG_PATH, functionCount).
+// Returns true on success, false on failure
+bool pullDownGadgetCommon();
 // Pulls down USB gadget. Returns true on success, false on failure
 bool resetGadgetCommon();
+// Maps the content of the udc "state" attribute, newline included, to the proto enum.
+VendorUsbDataSessionEvent_UsbDeviceState stringToUsbDeviceStateProto(const std::string &state);
 void BuildVendorUsbDataSessionEvent(bool is_host, boot_clock::time_point currentTime,
                                     boot_clock::time_point startTime,
                                     std::vector<std::string> *states,
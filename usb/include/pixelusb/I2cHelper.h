@@ -18,6 +18,7 @@
 #define HARDWARE_GOOGLE_PIXEL_USB_I2CHELPER_H_
 
 #include <string>
+#include <string_view>
 
 using ::std::string;
 
@@ -27,8 +28,9 @@ namespace google {
 namespace pixel {
 namespace usb {
 
-// Search the path of the i2c client
-string getI2cClientPath(const string hsi2cPath, const string devName, const string clientId);
+// Search the path of the i2c client; see getBusClientPath() for caching
+string getI2cClientPath(std::string_view hsi2cPath, std::string_view devName,
+                        std::string_view clientId);
 
 }  // namespace usb
 }  // namespace pixel
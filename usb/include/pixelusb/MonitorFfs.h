@@ -20,9 +20,10 @@
 #include <android-base/unique_fd.h>
 #include <pixelusb/CommonUtils.h>
 
+#include <chrono>
+#include <condition_variable>
 #include <mutex>
 #include <string>
-#include <thread>
 #include <vector>
 
 namespace android {
@@ -35,17 +36,13 @@ using ::android::base::unique_fd;
 
 // MonitorFfs automously manages gadget pullup by monitoring
 // the ep file status. Restarts the usb gadget when the ep
-// owner restarts.
+// owner restarts. Monitoring runs on the UsbEventLoop thread.
 class MonitorFfs {
   private:
     // Monitors the endpoints Inotify events.
     unique_fd mInotifyFd;
-    // Control pipe for shutting down the mMonitor thread.
-    // mMonitor exits when SHUTDOWN_MONITOR is written into
-    // mEventFd/
-    unique_fd mEventFd;
-    // Pools on mInotifyFd and mEventFd.
-    unique_fd mEpollFd;
+    // Delays the pullup by kPullUpDelay after the endpoints appear.
+    unique_fd mPullUpTimer;
     std::vector<int> mWatchFd;
 
     // Maintains the list of Endpoints.
@@ -53,14 +50,17 @@ class MonitorFfs {
     // protects the CV.
     std::mutex mLock;
     std::condition_variable mCv;
-    // protects mInotifyFd, mEpollFd.
+    // protects mInotifyFd, mWatchFd, mEndpointList.
     std::mutex mLockFd;
 
     // Flag to maintain the current status of gadget pullup.
     bool mCurrentUsbFunctionsApplied;
 
-    // Thread object that executes the ep monitoring logic.
-    std::unique_ptr<std::thread> mMonitor;
+    // Loop thread state: the gadget needs pulling up once the endpoints
+    // are present, and when they last went away.
+    bool mWriteUdc;
+    bool mPullUpPending;
+    std::chrono::steady_clock::time_point mDisconnect;
     // Callback to be invoked when gadget is pulled up.
     void (*mCallback)(bool functionsApplied, void *payload);
     void *mPayload;
@@ -69,6 +69,12 @@ class MonitorFfs {
     // Monitor State
     bool mMonitorRunning;
 
+    // Ep monitoring and the gadget pull up logic.
+    bool descriptorsPresent();
+    void pullUp();
+    void onInotifyEvent();
+    void onPullUpTimer();
+
   public:
     MonitorFfs(const char *const gadget);
     // Inits all the UniqueFds.
@@ -88,8 +94,6 @@ class MonitorFfs {
     void registerFunctionsAppliedCallback(void (*callback)(bool functionsApplied, void *(payload)),
                                           void *payload);
     bool isMonitorRunning();
-    // Ep monitoring and the gadget pull up logic.
-    static void *startMonitorFd(void *param);
 };
 
 }  // namespace usb
@@ -18,6 +18,7 @@
 #define HARDWARE_GOOGLE_PIXEL_USB_USBBUSHELPER_H_
 
 #include <string>
+#include <string_view>
 
 using ::std::string;
 
@@ -27,9 +28,14 @@ namespace google {
 namespace pixel {
 namespace usb {
 
-// Search the path of the client
-string getBusClientPath(const string busType, const string busPath, const string devName,
-                        const string clientId);
+// Search the path of the client. Resolved paths are cached until the client
+// directory disappears or invalidateBusClientPaths() is called.
+string getBusClientPath(std::string_view busType, std::string_view busPath,
+                        std::string_view devName, std::string_view clientId);
+
+// Drop every cached client path. Call on i2c/spmi/platform bus uevents, when
+// bus numbers may have been reassigned.
+void invalidateBusClientPaths();
 
 }  // namespace usb
 }  // namespace pixel
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_USB_USBDATASESSION_H_
+#define HARDWARE_GOOGLE_PIXEL_USB_USBDATASESSION_H_
+
+#include <pixelusb/CommonUtils.h>
+
+#include <array>
+#include <functional>
+#include <mutex>
+#include <string>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+namespace usb {
+
+// UsbDataSession keeps the udc state transitions of the current data session
+// in memory, so the session event is built from what the uevent path already
+// read instead of from sysfs at report time. Finished sessions are handed to
+// the reporter on the UsbEventLoop thread, so callers never wait on statsd.
+class UsbDataSession {
+  public:
+    using Reporter = std::function<void(const VendorUsbDataSessionEvent &event)>;
+
+    explicit UsbDataSession(Reporter reporter);
+
+    // Starts a session in the given data role. A session still open is
+    // ended and reported first.
+    void start(bool isHost);
+    // Records a udc "state" attribute value read by the uevent handler.
+    // Ignored outside a session and when the state did not change.
+    void recordState(const std::string &state);
+    // Ends the current session, if any, and queues its report.
+    void end();
+    bool active();
+
+  private:
+    struct Transition {
+        boot_clock::time_point time;
+        VendorUsbDataSessionEvent_UsbDeviceState state;
+    };
+
+    // Caller holds mLock.
+    void endLocked(boot_clock::time_point now);
+
+    const Reporter mReporter;
+
+    // Protects everything below.
+    std::mutex mLock;
+    bool mActive;
+    bool mIsHost;
+    boot_clock::time_point mStartTime;
+    // Ring of the latest transitions; once full the oldest is overwritten.
+    std::array<Transition, kWestworldRepeatedFieldSizeLimit> mTransitions;
+    size_t mHead;
+    size_t mCount;
+};
+
+}  // namespace usb
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
+
+#endif  // HARDWARE_GOOGLE_PIXEL_USB_USBDATASESSION_H_
@@ -22,13 +22,17 @@
 #include <aidl/android/hardware/usb/DisplayPortAltModeStatus.h>
 #include <aidl/android/hardware/usb/LinkTrainingStatus.h>
 #include <aidl/android/hardware/usb/Status.h>
+#include <android-base/unique_fd.h>
+#include <pthread.h>
 
+#include <chrono>
 #include <string>
 
 using aidl::android::hardware::usb::AltModeData;
 using aidl::android::hardware::usb::DisplayPortAltModePinAssignment;
 using aidl::android::hardware::usb::LinkTrainingStatus;
 using aidl::android::hardware::usb::Status;
+using android::base::unique_fd;
 
 using std::string;
 
@@ -52,27 +56,22 @@ class UsbDp {
     string mDrmPath;
     string mClientPath;
 
-    // True when mPoll thread is running
+    // True while the DisplayPort attributes are registered with the event loop
     volatile bool mPollRunning;
+    // True while a setup is queued on the event loop
     volatile bool mPollStarting;
 
-    pthread_cond_t mCV;
-    pthread_mutex_t mCVLock;
-
     volatile bool mFirstSetupDone;
 
     // Used to cache the values read from tcpci's irq_hpd_count.
     // Update drm driver when cached value is not the same as the read value.
     uint32_t mIrqCountCache;
 
-    pthread_t mPoll;
-    pthread_t mDisplayPortShutdownHelper;
-
     // Callback called when mDisplayPortDebounceTimer is triggered
     void (*mCallback)(void *payload);
     void *mPayload;
 
-    // eventfd to signal DisplayPort thread from typec kernel driver
+    // eventfd to signal DisplayPort handlers from typec kernel driver
     int mDisplayPortEventPipe;
 
     /*
@@ -96,22 +95,74 @@ class UsbDp {
      */
     bool mPartnerSupportsDisplayPort;
 
-    Status writeDisplayPortAttribute(string attribute, string usb_path);
+    /*
+     * Attributes of the current DisplayPort connection. They are opened when
+     * the poll starts and read with pread() on every event instead of being
+     * reopened by path. Only the event loop opens and closes them, under
+     * mFdLock, which readDisplayPortAttribute() takes since HAL threads may
+     * call it. mFdLock also protects the latency stats.
+     */
+    pthread_mutex_t mFdLock;
+    string mDisplayPortUsbPath;
+    unique_fd mHpdFd;
+    unique_fd mPinAssignmentFd;
+    unique_fd mOrientationFd;
+    unique_fd mLinkStatusFd;
+    unique_fd mIrqHpdCountFd;
+
+    // drm attributes written on every event, opened once
+    unique_fd mDrmHpdFd;
+    unique_fd mDrmPinAssignmentFd;
+    unique_fd mDrmOrientationFd;
+    unique_fd mDrmIrqHpdFd;
+
+    // DisplayPort Link Setup statuses of the current connection
+    bool mPinSet;
+    bool mOrientationSet;
+    int mActivateRetryCount;
+    string mPartnerActivePath;
+
+    // Time from the partner raising hpd to a drm stage, in microseconds
+    struct LatencyStats {
+        uint32_t count;
+        int64_t lastUs;
+        int64_t minUs;
+        int64_t maxUs;
+        int64_t totalUs;
+
+        void record(int64_t us);
+        void dump(int fd, const char *name) const;
+    };
+    // Set when hpd goes high, cleared once link training reports a result
+    std::chrono::steady_clock::time_point mHpdHighTime;
+    bool mHpdHighPending;
+    // hpd written to the drm
+    LatencyStats mHpdToDrmLatency;
+    // drm reports link training success, i.e. the display can come up
+    LatencyStats mHpdToLinkTrainedLatency;
+
+    Status writeDisplayPortAttribute(string attribute, int usbFd);
+
+    // Event loop handlers; run on the UsbEventLoop thread
+    void startDisplayPortPoll();
+    void stopDisplayPortPoll();
+    void onHpdEvent();
+    void onPinAssignmentEvent();
+    void onOrientationEvent();
+    void onLinkStatusEvent();
+    void onDebounceTimer();
+    void onActivateTimer();
+    void onEventPipe(uint64_t flag);
 
   public:
     UsbDp(const char *const drmPath);
 
-    /* Internal to Library */
-    // For thread setup
-    void displayPortPollWorkHelper();
-    void shutdownDisplayPortPollHelper();
-
     /* For HAL Use */
     // Protects writeDisplayPortAttribute(), setupDisplayPortPoll(),
     // and shutdownDisplayPortPoll()
     pthread_mutex_t mLock;
 
-    // Setup and Shutdown Thread
+    // Setup and Shutdown DisplayPort polling on the USB event loop
     void setupDisplayPortPoll();
     void shutdownDisplayPortPoll(bool force);
 
@@ -130,6 +181,9 @@ class UsbDp {
     Status writeHpdOverride(string attribute, string value);
 
     void registerCallback(void (*callback)(void *(payload)), void *payload);
+
+    // Writes hot-plug to display latency statistics to fd, for the HAL's dump()
+    void dumpDisplayPortLatency(int fd);
 };
 
 /* Sysfs Helper Functions */
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_PIXEL_USB_USBEVENTLOOP_H_
+#define HARDWARE_GOOGLE_PIXEL_USB_USBEVENTLOOP_H_
+
+#include <android-base/unique_fd.h>
+#include <sys/epoll.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace google {
+namespace pixel {
+namespace usb {
+
+// UsbEventLoop is the one thread per process that waits on the fds of every
+// libpixelusb feature (DisplayPort, FunctionFs monitoring, overheat sampling)
+// and dispatches each ready fd to the handler registered for it. Handlers
+// run on the loop thread and must not block.
+class UsbEventLoop {
+  public:
+    // Called with the epoll events reported for the fd.
+    using FdHandler = std::function<void(uint32_t events)>;
+    // Called after a timerfd expiry has been read.
+    using TimerHandler = std::function<void()>;
+    // Called with the counter read from an eventfd.
+    using EventHandler = std::function<void(uint64_t value)>;
+    using Task = std::function<void()>;
+
+    // Returns the process-wide loop, starting its thread on first use.
+    static UsbEventLoop &get();
+
+    // Registers a handler for fd. The caller keeps ownership of fd and must
+    // removeFd() it before closing it.
+    bool addFd(int fd, uint32_t events, FdHandler handler);
+    // Registers a timerfd; it is switched to non-blocking so a timer disarmed
+    // after it was reported cannot stall the loop.
+    bool addTimer(int timerFd, TimerHandler handler, uint32_t events = EPOLLIN);
+    // Registers an eventfd, switched to non-blocking as for addTimer().
+    bool addEventFd(int eventFd, EventHandler handler);
+    void removeFd(int fd);
+
+    // Queues task to run on the loop thread.
+    void post(Task task);
+    // Runs task on the loop thread and waits for it to finish. Runs task
+    // inline when called from the loop thread.
+    void runSync(Task task);
+    bool isLoopThread() const;
+
+    // Sets timerFd to expire once after ms milliseconds; 0 disarms it.
+    static int armTimer(int timerFd, int ms);
+
+  private:
+    UsbEventLoop();
+    void run();
+    void runTasks();
+
+    ::android::base::unique_fd mEpollFd;
+    // Wakes the loop when a task is posted.
+    ::android::base::unique_fd mWakeFd;
+
+    // Protects mHandlers, mKeys, mNextKey and mTasks.
+    std::mutex mLock;
+    // Handlers are looked up by a key that is never reused, so an event
+    // reported for an fd that was removed, closed and reopened in the same
+    // epoll_wait() batch does not reach the new handler.
+    std::unordered_map<uint64_t, std::shared_ptr<FdHandler>> mHandlers;
+    std::unordered_map<int, uint64_t> mKeys;
+    uint64_t mNextKey;
+    std::vector<Task> mTasks;
+
+    std::thread mThread;
+};
+
+}  // namespace usb
+}  // namespace pixel
+}  // namespace google
+}  // namespace hardware
+}  // namespace android
+
+#endif  // HARDWARE_GOOGLE_PIXEL_USB_USBEVENTLOOP_H_
@@ -88,13 +88,10 @@ class ZoneInfo {
  */
 class UsbOverheatEvent : public IServiceNotification, public IThermalChangedCallback {
   private:
-    // To wake up thread to record max temperature
+    // Wakes the UsbEventLoop to record max temperature; disarmed when port is cold.
     unique_fd timer_fd_;
-    // Polls on timer_fd_ & event_fd. Thread waits here when port is cold.
-    unique_fd epoll_fd_;
-    // To wake up the thread when waiting on TimerFd
-    unique_fd event_fd_;
-    // Thermal zone for monitoring Throttling event
+    // Thermal zone for monitoring Throttling event. Its callbacks drive
+    // startRecording()/stopRecording(), so nothing is polled while it is cool.
     ZoneInfo monitored_zone_;
     // Info of thermal zones that are queried during polling.
     // ATM Suez UsbPortOverheatEvent can only report one of the values though.
@@ -103,9 +100,7 @@ class UsbOverheatEvent : public IServiceNotification, public IThermalChangedCall
     vector<ZoneInfo> queried_zones_;
     //  Sampling interval for monitoring the temperature
     int monitor_interval_sec_;
-    // Thread object that executes the ep monitoring logic
-    unique_ptr<thread> monitor_;
-    // Maximum overheat temperature recorded
+    // Maximum overheat temperature recorded. Only written on the UsbEventLoop.
     float max_overheat_temp_;
     // Reference to Thermal service
     ::android::sp<IThermal> thermal_service_;
@@ -115,11 +110,13 @@ class UsbOverheatEvent : public IServiceNotification, public IThermalChangedCall
     ndk::ScopedAIBinder_DeathRecipient thermal_aidl_death_recipient_;
     // Whether the Thermal callback is successfully registered
     bool is_thermal_callback_registered_;
-    // Thread that polls temperature to record max temp
-    static void *monitorThread(void *param);
+    // Polls temperature to record max temp and re-arms timer_fd_; runs on the UsbEventLoop
+    void sampleTemperatures();
+    // Reads all USB_PORT sensors from the Thermal service in one call
+    bool getUsbPortTemperatures(hidl_vec<Temperature> *temperatures);
     // Register service notification listener
     bool registerListener();
-    // Helper function to wakeup monitor thread
+    // Helper function to sample right away on the UsbEventLoop
     void wakeupMonitor();
     // Thermal HIDL Service Notification listener
     Return<void> onRegistration(const hidl_string & /*fully_qualified_name*/,
@@ -29,6 +29,16 @@
 namespace android {
 namespace chre {
 
+CapoDetector::~CapoDetector() {
+    {
+        std::lock_guard<std::mutex> lock(mCallbackMutex);
+        mStopCallback = true;
+    }
+    mCallbackCv.notify_one();
+    if (mCallbackThread.joinable())
+        mCallbackThread.join();
+}
+
 /**
  * Called when initializing connection with CHRE socket.
  */
@@ -51,7 +61,7 @@ void CapoDetector::onConnected() {
     flatbuffers::FlatBufferBuilder builder;
 
     // Reset the last position type.
-    last_position_type_ = capo::PositionType::UNKNOWN;
+    resetPosition();
 
     HostProtocolHost::encodeNanoappListRequest(builder);
     if (!sendMessage(builder.GetBufferPointer(), builder.GetSize())) {
@@ -75,17 +85,44 @@ void CapoDetector::onConnectionAborted() {
  */
 
 void CapoDetector::onDisconnected() {
-    last_position_type_ = capo::PositionType::UNKNOWN;
+    resetPosition();
+}
+
+void CapoDetector::resetPosition() {
+    const uint64_t info = mPositionInfo.load(std::memory_order_relaxed);
+    mPositionInfo.store(packPositionInfo(capo::PositionType::UNKNOWN, faceUpTimeOf(info)),
+                        std::memory_order_relaxed);
 }
 
 /**
  * Decode unix socket msgs to CHRE messages, and call the appropriate
  * callback depending on the CHRE message.
+ * Nanoapp messages, the only frequent ones, are read in place from the
+ * verified buffer instead of being unpacked to a NanoappMessageT.
  */
 void CapoDetector::onMessageReceived(const void *data, size_t length) {
-    if (!HostProtocolHost::decodeMessageFromChre(data, length, *this)) {
+    flatbuffers::Verifier verifier(static_cast<const uint8_t *>(data), length);
+    if (!fbs::VerifyMessageContainerBuffer(verifier)) {
         ALOGE("Failed to decode message");
+        return;
     }
+
+    const fbs::MessageContainer *container = fbs::GetMessageContainer(data);
+    if (container->message_type() != fbs::ChreMessage::NanoappMessage) {
+        if (!HostProtocolHost::decodeMessageFromChre(data, length, *this)) {
+            ALOGE("Failed to decode message");
+        }
+        return;
+    }
+
+    const fbs::NanoappMessage *message = container->message_as_NanoappMessage();
+    const size_t size = message->message() ? message->message()->size() : 0;
+    ALOGI("%s, Id %" PRIu64 ", type %d, size %d", __func__, message->app_id(),
+          message->message_type(), static_cast<int>(size));
+    // Exclude the message with unmatched nanoapp id.
+    if (message->app_id() != kCapoNanoappId)
+        return;
+    handleCapoMessage(message->message_type(), size ? message->message()->data() : nullptr, size);
 }
 
 /**
@@ -97,46 +134,54 @@ void CapoDetector::handleNanoappMessage(const fbs::NanoappMessageT &message) {
     // Exclude the message with unmatched nanoapp id.
     if (message.app_id != kCapoNanoappId)
         return;
+    handleCapoMessage(message.message_type, message.message.data(), message.message.size());
+}
 
+void CapoDetector::handleCapoMessage(uint32_t message_type, const uint8_t *payload, size_t size) {
     // Handle the message with message_type.
-    switch (message.message_type) {
+    switch (message_type) {
         case capo::MessageType::ACK_NOTIFICATION: {
+            if (size < 2)
+                break;
             capo::AckNotification gd;
-            gd.set_notification_type(static_cast<capo::NotificationType>(message.message[1]));
+            gd.set_notification_type(static_cast<capo::NotificationType>(payload[1]));
             ALOGD("%s, get notification event from capo nanoapp, type %d", __func__,
                   gd.notification_type());
             break;
         }
         case capo::MessageType::POSITION_DETECTED: {
-            uint8_t position;
-            uint32_t time;
+            if (size < 2)
+                break;
+            const uint64_t last_info = mPositionInfo.load(std::memory_order_relaxed);
+            const uint8_t last_position = positionOf(last_info);
+            uint32_t face_up_time = faceUpTimeOf(last_info);
+            const uint32_t time = getCurrentTimeInMs();
+            capo::PositionDetected gd;
+            gd.set_position_type(static_cast<capo::PositionType>(payload[1]));
+            ALOGD("CapoDetector: [%u] get position event from capo nanoapp, from %d to %d", time,
+                  last_position, gd.position_type());
+
+            // Record the last moment we were in FACE_UP state
+            if (last_position == capo::PositionType::ON_TABLE_FACE_UP ||
+                gd.position_type() == capo::PositionType::ON_TABLE_FACE_UP) {
+                face_up_time = time;
+            }
+            const uint8_t position = gd.position_type();
+            mPositionInfo.store(packPositionInfo(position, face_up_time),
+                                std::memory_order_relaxed);
+            // Hand the carried position event to the callback thread.
             {
-                std::lock_guard<std::mutex> lock(mCapoMutex);
-                capo::PositionDetected gd;
-                time = getCurrentTimeInMs();
-                gd.set_position_type(static_cast<capo::PositionType>(message.message[1]));
-                ALOGD("CapoDetector: [%u] get position event from capo nanoapp, from %d to %d",
-                      time, last_position_type_, gd.position_type());
-
-                // Record the last moment we were in FACE_UP state
-                if (last_position_type_ == capo::PositionType::ON_TABLE_FACE_UP ||
-                    gd.position_type() == capo::PositionType::ON_TABLE_FACE_UP) {
-                    mLastFaceUpEvent = time;
+                std::lock_guard<std::mutex> lock(mCallbackMutex);
+                if (mCallbackThread.joinable()) {
+                    mPendingPosition = position;
+                    mCallbackCv.notify_one();
                 }
-                last_position_type_ = gd.position_type();
-                position = last_position_type_;
-            }
-            // Callback to function while getting carried position event.
-            if (callback_func_ != nullptr) {
-                ALOGD("%s, sent position type %d to callback function", __func__,
-                      last_position_type_);
-                callback_func_(last_position_type_);
             }
             break;
         }
         default:
             ALOGE("%s, get invalid message, type: %" PRIu32 ", from capo nanoapp.", __func__,
-                  message.message_type);
+                  message_type);
             break;
     }
 }
@@ -217,16 +262,41 @@ void CapoDetector::enable() {
     }
 }
 
+void CapoDetector::setCallback(cb_fn_t cb) {
+    std::lock_guard<std::mutex> lock(mCallbackMutex);
+    callback_func_ = std::move(cb);
+    if (callback_func_ != nullptr && !mCallbackThread.joinable())
+        mCallbackThread = std::thread(&CapoDetector::callbackLoop, this);
+}
+
+void CapoDetector::callbackLoop() {
+    std::unique_lock<std::mutex> lock(mCallbackMutex);
+    while (true) {
+        mCallbackCv.wait(lock, [this] { return mStopCallback || mPendingPosition.has_value(); });
+        if (mStopCallback)
+            return;
+        const uint8_t position = *mPendingPosition;
+        mPendingPosition.reset();
+        const cb_fn_t callback = callback_func_;
+        lock.unlock();
+        if (callback != nullptr) {
+            ALOGD("%s, sent position type %d to callback function", __func__, position);
+            callback(position);
+        }
+        lock.lock();
+    }
+}
+
 /**
  * Method for gathering the position and time tuple simultaneously to avoid any
  * concurrency issues.
  */
 void CapoDetector::getCarriedPositionInfo(uint8_t *position, uint32_t *time) {
-    std::lock_guard<std::mutex> lock(mCapoMutex);
+    const uint64_t info = mPositionInfo.load(std::memory_order_relaxed);
     if (position)
-        *position = last_position_type_;
+        *position = positionOf(info);
     if (time)
-        *time = mLastFaceUpEvent;
+        *time = faceUpTimeOf(info);
 }
 
 }  // namespace chre
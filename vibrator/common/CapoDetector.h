@@ -17,7 +17,12 @@
 #include <chre_host/host_protocol_host.h>
 #include <chre_host/socket_client.h>
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
 
 #include "proto/capo.pb.h"
 
@@ -50,6 +55,7 @@ class CapoDetector : public android::chre::SocketClient::ICallbacks,
     // Typedef declaration for callback function.
     typedef std::function<void(uint8_t)> cb_fn_t;
 
+    ~CapoDetector();
     // Called when initializing connection with CHRE socket.
     static android::sp<CapoDetector> start();
     // Common getTime function to share
@@ -78,18 +84,33 @@ class CapoDetector : public android::chre::SocketClient::ICallbacks,
     void handleNanoappListResponse(const ::chre::fbs::NanoappListResponseT &response) override;
     // Send enabling message to the nanoapp.
     void enable();
-    // Get last carried position type and time simultaneously.
+    // Get last carried position type and time simultaneously, without locking.
     void getCarriedPositionInfo(uint8_t *position, uint32_t *time);
     // Get last carried position type.
-    uint8_t getCarriedPosition() { return last_position_type_; }
+    uint8_t getCarriedPosition() { return positionOf(mPositionInfo.load()); }
     // Get the host endpoint.
     uint16_t getHostEndPoint() { return kHostEndpoint; }
     // Get the capo nanoapp ID.
     uint64_t getNanoppAppId() { return kCapoNanoappId; }
-    // Set up callback_func_ if needed.
-    void setCallback(cb_fn_t cb) { callback_func_ = cb; }
+    // Set up callback_func_ if needed. It runs on a thread of its own, never on the
+    // CHRE socket thread.
+    void setCallback(cb_fn_t cb);
 
   private:
+    // The carried position is published as one word so readers get the position and the
+    // face up time of the same update: position in the high half, time in the low half.
+    static uint64_t packPositionInfo(uint8_t position, uint32_t time) {
+        return (static_cast<uint64_t>(position) << 32) | time;
+    }
+    static uint8_t positionOf(uint64_t info) { return static_cast<uint8_t>(info >> 32); }
+    static uint32_t faceUpTimeOf(uint64_t info) { return static_cast<uint32_t>(info); }
+    // Reset the position, keeping the last face up time
+    void resetPosition();
+    // Handle a message of the capo nanoapp
+    void handleCapoMessage(uint32_t message_type, const uint8_t *payload, size_t size);
+    // Run callback_func_ with the latest position until stopped
+    void callbackLoop();
+
     // Nanoapp ID of capo, ref: go/nanoapp-id-tracker.
     static constexpr uint64_t kCapoNanoappId = 0x476f6f676c001020ULL;
     // String of socket name for connecting chre.
@@ -100,12 +121,15 @@ class CapoDetector : public android::chre::SocketClient::ICallbacks,
     static constexpr uint16_t kHostEndpoint = 0x9020;
     // Using for hal layer callback function.
     cb_fn_t callback_func_ = nullptr;
-    // Last carried position received from the nano app
-    capo::PositionType last_position_type_ = capo::PositionType::UNKNOWN;
-    // Last face up event
-    uint32_t mLastFaceUpEvent = 0;
-    // Mutex for time + position tuple
-    std::mutex mCapoMutex;
+    // Last carried position received from the nano app and the last face up event, only
+    // written from the CHRE socket thread
+    std::atomic<uint64_t> mPositionInfo{packPositionInfo(capo::PositionType::UNKNOWN, 0)};
+    // Position waiting for the callback thread, a newer one replaces it
+    std::optional<uint8_t> mPendingPosition;
+    bool mStopCallback = false;
+    std::mutex mCallbackMutex;
+    std::condition_variable mCallbackCv;
+    std::thread mCallbackThread;
     // Motion detector parameters for host-driven capo config
     const struct CapoMDParams mCapoDetectorMDParameters {
         .still_time_threshold_ns = NS_FROM_MS(500), .window_width_ns = NS_FROM_MS(100),
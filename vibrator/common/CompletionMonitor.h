@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <aidl/android/hardware/vibrator/BnVibrator.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+/*
+ * Waits for the effects a chip plays to complete, on a thread that lives as
+ * long as the HAL, rather than on one started for each effect.
+ *
+ * An effect is handed over once the chip plays it, with the callback to
+ * notify. The chip's waiter blocks until the effect is complete, cleans up
+ * after it and notifies the callback. Effects are waited for one at a time,
+ * in the order they were played, and a new request waits for idle() before it
+ * plays, so it never races the clean-up of the one before it.
+ */
+class CompletionMonitor {
+  public:
+    using Waiter = std::function<void(std::shared_ptr<IVibratorCallback> &&callback)>;
+
+    explicit CompletionMonitor(Waiter waiter) : mWaiter(std::move(waiter)) {
+        mThread = std::thread(&CompletionMonitor::run, this);
+    }
+    // Waits for the effects already played, then stops the thread
+    ~CompletionMonitor() {
+        {
+            const std::scoped_lock<std::mutex> lock(mMutex);
+            mTerminate = true;
+        }
+        mCv.notify_all();
+        mThread.join();
+    }
+
+    // Returns false if an effect is still pending after timeout
+    bool idle(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        return mCv.wait_for(lock, timeout, [this] { return mPending.empty(); });
+    }
+
+    // Hands over an effect the chip just played
+    void push(std::shared_ptr<IVibratorCallback> callback) {
+        {
+            const std::scoped_lock<std::mutex> lock(mMutex);
+            mPending.push_back(std::move(callback));
+        }
+        mCv.notify_all();
+    }
+
+  private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (true) {
+            mCv.wait(lock, [this] { return mTerminate || !mPending.empty(); });
+            if (mPending.empty()) {
+                return;
+            }
+            std::shared_ptr<IVibratorCallback> callback = mPending.front();
+            lock.unlock();
+            mWaiter(std::move(callback));
+            lock.lock();
+            mPending.pop_front();
+            mCv.notify_all();
+        }
+    }
+
+    const Waiter mWaiter;
+    // Effects played and not yet complete; the front one is being waited for
+    std::deque<std::shared_ptr<IVibratorCallback>> mPending;
+    std::mutex mMutex;
+    std::condition_variable mCv;
+    bool mTerminate{false};
+    std::thread mThread;
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <aidl/android/hardware/vibrator/BnVibrator.h>
+#include <log/log.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "VibratorStats.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+/*
+ * Checks a composition against the limits all the chips share, then hands its
+ * delays and primitives, in order, to a chip's Backend, which builds whatever
+ * the chip plays from them:
+ *
+ *   // Called when the composition is out of the limits, before it is refused
+ *   void rejected();
+ *   // A pause before the next primitive, or at the end
+ *   ndk::ScopedAStatus addDelay(int32_t delayMs);
+ *   // A primitive other than NOOP, with its scale checked to be in [0, 1]
+ *   ndk::ScopedAStatus addPrimitive(CompositePrimitive primitive, float scale);
+ *
+ * Nothing reaches the backend unless the whole composition is within the
+ * limits, and the first error the backend returns ends the composition.
+ */
+template <typename Backend>
+ndk::ScopedAStatus compileComposition(const std::vector<CompositeEffect> &composite,
+                                      size_t sizeMax, int32_t delayMaxMs, Backend *backend) {
+    if (composite.empty() || composite.size() > sizeMax) {
+        ALOGE("%s: Invalid size %zu", __func__, composite.size());
+        backend->rejected();
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+    for (size_t i = 0; i < composite.size(); i++) {
+        const CompositeEffect &e = composite[i];
+        if (e.scale < 0.0f || e.scale > 1.0f) {
+            ALOGE("%s: #%zu: Invalid scale %f", __func__, i, e.scale);
+            backend->rejected();
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+        }
+        if (e.delayMs < 0 || e.delayMs > delayMaxMs) {
+            ALOGE("%s: #%zu: Invalid delay %d", __func__, i, e.delayMs);
+            backend->rejected();
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+        }
+    }
+
+    for (const CompositeEffect &e : composite) {
+        if (e.delayMs) {
+            ndk::ScopedAStatus status = backend->addDelay(e.delayMs);
+            if (!status.isOk()) {
+                return status;
+            }
+        }
+        if (e.primitive != CompositePrimitive::NOOP) {
+            ndk::ScopedAStatus status = backend->addPrimitive(e.primitive, e.scale);
+            if (!status.isOk()) {
+                return status;
+            }
+        }
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+// Limits of a PWLE composition that differ between the chips
+struct PwleLimits {
+    size_t sizeMax;
+    int32_t durationMaxMs;
+    float frequencyMinHz;
+    float frequencyMaxHz;
+    // Amplitudes above this, up to 1, are trimmed to it
+    float levelMax;
+    bool clabSupported;
+};
+
+/*
+ * Checks a PWLE composition against the limits, then hands its primitives, in
+ * order, to a chip's Backend, which builds the segments the chip plays:
+ *
+ *   // Called with the error to count when the composition is out of the
+ *   // limits, before it is refused
+ *   void rejected(VibratorError error);
+ *   // An active primitive, with its amplitudes trimmed to levelMax
+ *   ndk::ScopedAStatus addActive(const ActivePwle &active);
+ *   // A braking primitive, of a supported type
+ *   ndk::ScopedAStatus addBraking(const BrakingPwle &braking);
+ *
+ * As with compileComposition(), nothing reaches the backend unless the whole
+ * composition is within the limits.
+ */
+template <typename Backend>
+ndk::ScopedAStatus compilePwle(const std::vector<PrimitivePwle> &composite,
+                               const PwleLimits &limits, Backend *backend) {
+    if (composite.empty() || composite.size() > limits.sizeMax) {
+        ALOGE("%s: Invalid size %zu", __func__, composite.size());
+        backend->rejected(kBadCompositeError);
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+    for (size_t i = 0; i < composite.size(); i++) {
+        const PrimitivePwle &e = composite[i];
+        bool valid = true;
+        switch (e.getTag()) {
+            case PrimitivePwle::active: {
+                const ActivePwle &active = e.get<PrimitivePwle::active>();
+                if (active.duration < 0 || active.duration > limits.durationMaxMs) {
+                    ALOGE("%s: #%zu: active: Invalid duration %d", __func__, i, active.duration);
+                    valid = false;
+                } else if (active.startAmplitude < 0.0f || active.startAmplitude > 1.0f ||
+                           active.endAmplitude < 0.0f || active.endAmplitude > 1.0f) {
+                    ALOGE("%s: #%zu: active: Invalid scale %f, %f", __func__, i,
+                          active.startAmplitude, active.endAmplitude);
+                    valid = false;
+                } else if (active.startFrequency < limits.frequencyMinHz ||
+                           active.startFrequency > limits.frequencyMaxHz ||
+                           active.endFrequency < limits.frequencyMinHz ||
+                           active.endFrequency > limits.frequencyMaxHz) {
+                    ALOGE("%s: #%zu: active: Invalid frequency %f, %f", __func__, i,
+                          active.startFrequency, active.endFrequency);
+                    valid = false;
+                }
+                break;
+            }
+            case PrimitivePwle::braking: {
+                const BrakingPwle &braking = e.get<PrimitivePwle::braking>();
+                if (braking.braking > Braking::CLAB ||
+                    (braking.braking == Braking::CLAB && !limits.clabSupported)) {
+                    ALOGE("%s: #%zu: braking: Unsupported type %s", __func__, i,
+                          toString(braking.braking).c_str());
+                    valid = false;
+                } else if (braking.duration < 0 || braking.duration > limits.durationMaxMs) {
+                    ALOGE("%s: #%zu: braking: Invalid duration %d", __func__, i,
+                          braking.duration);
+                    valid = false;
+                }
+                break;
+            }
+        }
+        if (!valid) {
+            backend->rejected(kBadPrimitiveError);
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+        }
+    }
+
+    for (const PrimitivePwle &e : composite) {
+        ndk::ScopedAStatus status = ndk::ScopedAStatus::ok();
+        switch (e.getTag()) {
+            case PrimitivePwle::active: {
+                ActivePwle active = e.get<PrimitivePwle::active>();
+                active.startAmplitude = std::min(active.startAmplitude, limits.levelMax);
+                active.endAmplitude = std::min(active.endAmplitude, limits.levelMax);
+                status = backend->addActive(active);
+                break;
+            }
+            case PrimitivePwle::braking:
+                status = backend->addBraking(e.get<PrimitivePwle::braking>());
+                break;
+        }
+        if (!status.isOk()) {
+            return status;
+        }
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
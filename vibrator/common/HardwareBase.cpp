@@ -19,6 +19,7 @@
 #include <cutils/properties.h>
 #include <log/log.h>
 
+#include <cstring>
 #include <fstream>
 #include <sstream>
 
@@ -34,9 +35,11 @@ HwApiBase::HwApiBase() {
     if (mPathPrefix.empty() && (std::getenv("INPUT_EVENT_NAME") == NULL)) {
         ALOGE("Failed to get HWAPI path prefix!");
     }
+    const char *records = std::getenv("HWAPI_RECORDS");
+    mRecording = records == nullptr || strcmp(records, "0") != 0;
 }
 
-void HwApiBase::saveName(const std::string &name, const std::ios *stream) {
+void HwApiBase::saveName(const std::string &name, const void *stream) {
     mNames[stream] = name;
 }
 
@@ -44,6 +47,19 @@ bool HwApiBase::has(const std::ios &stream) {
     return !!stream;
 }
 
+void HwApiBase::open(const std::string &name, unique_fd *fd, int flags) {
+    saveName(name, fd);
+    const std::string path = mPathPrefix + name;
+    fd->reset(TEMP_FAILURE_RETRY(::open(path.c_str(), flags | O_CLOEXEC)));
+    if (!fd->ok()) {
+        ALOGE("Failed to open %s (%d): %s", path.c_str(), errno, strerror(errno));
+    }
+}
+
+bool HwApiBase::has(const unique_fd &fd) {
+    return fd.ok();
+}
+
 void HwApiBase::debug(int fd) {
     dprintf(fd, "Kernel:\n");
 
@@ -17,10 +17,16 @@
 
 #include <android-base/stringprintf.h>
 #include <android-base/unique_fd.h>
+#include <fcntl.h>
 #include <log/log.h>
+#include <poll.h>
 #include <sys/epoll.h>
+#include <sys/uio.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
+#include <cctype>
+#include <charconv>
 #include <chrono>
 #include <list>
 #include <map>
@@ -39,7 +45,8 @@ using ::android::base::unique_fd;
 
 class HwApiBase {
   private:
-    using NamesMap = std::map<const std::ios *, std::string>;
+    // Keyed by the stream or fd of each node
+    using NamesMap = std::map<const void *, std::string>;
 
     class RecordInterface {
       public:
@@ -49,7 +56,7 @@ class HwApiBase {
     template <typename T>
     class Record : public RecordInterface {
       public:
-        Record(const char *func, const T &value, const std::ios *stream)
+        Record(const char *func, const T &value, const void *stream)
             : mFunc(func),
               mValue(value),
               mStream(stream),
@@ -59,7 +66,7 @@ class HwApiBase {
       private:
         const char *mFunc;
         const T mValue;
-        const std::ios *mStream;
+        const void *mStream;
         const std::chrono::system_clock::time_point mTp;
     };
     using Records = std::list<std::unique_ptr<RecordInterface>>;
@@ -75,7 +82,7 @@ class HwApiBase {
         ALOGI("Update HWAPI path prefix to %s", prefix.c_str());
         mPathPrefix = prefix;
     }
-    void saveName(const std::string &name, const std::ios *stream);
+    void saveName(const std::string &name, const void *stream);
     template <typename T>
     void open(const std::string &name, T *stream);
     bool has(const std::ios &stream);
@@ -85,18 +92,40 @@ class HwApiBase {
     bool set(const T &value, std::ostream *stream);
     template <typename T>
     bool poll(const T &value, std::istream *stream, const int32_t timeout = -1);
+    /*
+     * The same over a raw fd: values are read with pread and written with
+     * pwrite from a stack buffer, and poll() waits on the fd it reads, so
+     * none of them does any stream or locale work. flags is O_RDONLY for
+     * read-only nodes and O_RDWR for the rest.
+     */
+    void open(const std::string &name, unique_fd *fd, int flags);
+    bool has(const unique_fd &fd);
     template <typename T>
-    void record(const char *func, const T &value, const std::ios *stream);
+    bool get(T *value, unique_fd *fd);
+    template <typename T>
+    bool set(const T &value, unique_fd *fd);
+    template <typename T>
+    bool poll(const T &value, unique_fd *fd, const int32_t timeout = -1);
+    bool recording() const { return mRecording; }
+    template <typename T>
+    void record(const char *func, const T &value, const void *stream);
 
   private:
     std::string mPathPrefix;
+    // Unless HWAPI_RECORDS is 0, each access is kept for debug()
+    bool mRecording;
     NamesMap mNames;
     Records mRecords{RECORDS_SIZE};
     std::mutex mRecordsMutex;
     std::mutex mIoMutex;
 };
 
-#define HWAPI_RECORD(args...) HwApiBase::record(__FUNCTION__, ##args)
+#define HWAPI_RECORD(args...)                            \
+    do {                                                 \
+        if (HwApiBase::recording()) {                    \
+            HwApiBase::record(__FUNCTION__, ##args);     \
+        }                                                \
+    } while (0)
 
 template <typename T>
 void HwApiBase::open(const std::string &name, T *stream) {
@@ -172,7 +201,94 @@ bool HwApiBase::poll(const T &value, std::istream *stream, const int32_t timeout
 }
 
 template <typename T>
-void HwApiBase::record(const char *func, const T &value, const std::ios *stream) {
+bool HwApiBase::get(T *value, unique_fd *fd) {
+    ATRACE_NAME("HwApi::get");
+    std::scoped_lock ioLock{mIoMutex};
+    char buf[32];
+    ssize_t len = -1;
+    if (fd->ok()) {
+        len = TEMP_FAILURE_RETRY(pread(fd->get(), buf, sizeof(buf), 0));
+    }
+    const char *first = buf;
+    const char *last = buf + std::max<ssize_t>(len, 0);
+    while (first < last && isspace(*first)) {
+        first++;
+    }
+    auto [end, ec] = std::from_chars(first, last, *value);
+    if (len < 0 || ec != std::errc()) {
+        ALOGE("Failed to read %s (%d): %s", mNames[fd].c_str(), errno, strerror(errno));
+        return false;
+    }
+    HWAPI_RECORD(*value, fd);
+    return true;
+}
+
+template <typename T>
+bool HwApiBase::set(const T &value, unique_fd *fd) {
+    ATRACE_NAME("HwApi::set");
+    std::scoped_lock ioLock{mIoMutex};
+    char buf[32];
+    iovec iov[2];
+    if constexpr (std::is_same_v<T, std::string>) {
+        iov[0] = {const_cast<char *>(value.data()), value.size()};
+    } else if constexpr (std::is_same_v<T, bool>) {
+        buf[0] = value ? '1' : '0';
+        iov[0] = {buf, 1};
+    } else {
+        auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+        iov[0] = {buf, static_cast<size_t>(end - buf)};
+    }
+    iov[1] = {const_cast<char *>("\n"), 1};
+
+    const ssize_t size = iov[0].iov_len + iov[1].iov_len;
+    if (!fd->ok() || TEMP_FAILURE_RETRY(pwritev(fd->get(), iov, 2, 0)) != size) {
+        ALOGE("Failed to write %s (%d): %s", mNames[fd].c_str(), errno, strerror(errno));
+        return false;
+    }
+    HWAPI_RECORD(value, fd);
+    return true;
+}
+
+template <typename T>
+bool HwApiBase::poll(const T &value, unique_fd *fd, const int32_t timeoutMs) {
+    ATRACE_NAME(ATRACE_ENABLED() ? StringPrintf("HwApi::poll %s==%s", mNames[fd].c_str(),
+                                                std::to_string(value).c_str())
+                                           .c_str()
+                                 : "HwApi::poll");
+    pollfd event = {
+            .fd = fd->get(),
+            .events = POLLPRI,
+            .revents = 0,
+    };
+    T actual;
+    bool ret;
+    int pollRet;
+
+    if (timeoutMs < -1) {
+        ALOGE("Invalid polling timeout!");
+        return false;
+    }
+
+    if (!fd->ok()) {
+        ALOGE("Failed to poll %s", mNames[fd].c_str());
+        return false;
+    }
+
+    // Reading the node through fd is what arms it for the next change
+    while ((ret = get(&actual, fd)) && (actual != value)) {
+        pollRet = TEMP_FAILURE_RETRY(::poll(&event, 1, timeoutMs));
+        if (pollRet <= 0) {
+            ALOGE("Polling error or timeout! (%d)", pollRet);
+            return false;
+        }
+    }
+
+    HWAPI_RECORD(value, fd);
+    return ret;
+}
+
+template <typename T>
+void HwApiBase::record(const char *func, const T &value, const void *stream) {
     std::lock_guard<std::mutex> lock(mRecordsMutex);
     mRecords.emplace_back(std::make_unique<Record<T>>(func, value, stream));
     mRecords.pop_front();
@@ -23,6 +23,7 @@
 #include <utils/Trace.h>
 
 #include <chrono>
+#include <iterator>
 #include <sstream>
 
 using ::aidl::android::frameworks::stats::IStats;
@@ -75,13 +76,15 @@ static constexpr auto UPLOAD_INTERVAL = std::chrono::minutes(1);
 static constexpr auto UPLOAD_INTERVAL = std::chrono::hours(24);
 #endif
 
-static void reportVendorAtom(const std::shared_ptr<IStats> &statsClient, const VendorAtom &atom) {
+static bool reportVendorAtom(const std::shared_ptr<IStats> &statsClient, const VendorAtom &atom) {
     STATS_TRACE("   reportVendorAtom(statsClient, atom: %s)", atomToString(atom.atomId));
     const ndk::ScopedAStatus status = statsClient->reportVendorAtom(atom);
     if (status.isOk()) {
         ALOGI("Vendor atom [id = %d] reported.", atom.atomId);
+        return true;
     } else {
         ALOGE("Failed to report atom [id = %d].", atom.atomId);
+        return false;
     }
 }
 
@@ -93,26 +96,79 @@ static std::string dumpData(const std::vector<int32_t> &data) {
     return stream.str();
 }
 
+void StatsCounters::resize(size_t size) {
+    mData.reset(new std::atomic<int32_t>[size]());
+    mSize = size;
+}
+
+void StatsCounters::updateMin(size_t index, int32_t value) {
+    int32_t current = mData[index].load(std::memory_order_relaxed);
+    while ((current == 0 || value < current) &&
+           !mData[index].compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+void StatsCounters::updateMax(size_t index, int32_t value) {
+    int32_t current = mData[index].load(std::memory_order_relaxed);
+    while (value > current &&
+           !mData[index].compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+std::vector<int32_t> StatsCounters::values(bool clear) {
+    std::vector<int32_t> values(mSize);
+    for (size_t i = 0; i < mSize; i++) {
+        values[i] = clear ? mData[i].exchange(0, std::memory_order_relaxed)
+                          : mData[i].load(std::memory_order_relaxed);
+    }
+    return values;
+}
+
 StatsBase::StatsBase(const std::string &instance)
     : mReporterThread([this]() { runReporterThread(); }),
       kStatsInstanceName(std::string() + IStats::descriptor + "/" + instance) {}
 
 StatsBase::~StatsBase() {}
 
+void StatsBase::initLatencies(size_t latencyCount) {
+    mMinLatencies.resize(latencyCount);
+    mMaxLatencies.resize(latencyCount);
+    mLatencyTotals.resize(latencyCount);
+    mLatencyCounts.resize(latencyCount);
+    mLatencyHistogram.resize(latencyCount * LATENCY_BUCKET_COUNT);
+}
+
+void StatsBase::logLatency(size_t latencyIndex, int32_t latency) {
+    size_t bucket = 0;
+    while (bucket < LATENCY_BUCKET_COUNT - 1 && latency >= (1 << bucket)) {
+        bucket++;
+    }
+
+    mMinLatencies.updateMin(latencyIndex, latency);
+    mMaxLatencies.updateMax(latencyIndex, latency);
+    mLatencyTotals.add(latencyIndex, latency);
+    mLatencyCounts.add(latencyIndex);
+    mLatencyHistogram.add(latencyIndex * LATENCY_BUCKET_COUNT + bucket);
+}
+
 void StatsBase::debug(int fd) {
     STATS_TRACE("debug(fd: %d)", fd);
 
     dprintf(fd, "Stats:\n");
-    {
-        std::scoped_lock<std::mutex> lock(mDataAccess);
-        dprintf(fd, "  Waveform Counts:%s\n", dumpData(mWaveformCounts).c_str());
-        dprintf(fd, "  Duration Counts:%s\n", dumpData(mDurationCounts).c_str());
-        dprintf(fd, "  Min Latencies:%s\n", dumpData(mMinLatencies).c_str());
-        dprintf(fd, "  Max Latencies:%s\n", dumpData(mMaxLatencies).c_str());
-        dprintf(fd, "  Latency Totals:%s\n", dumpData(mLatencyTotals).c_str());
-        dprintf(fd, "  Latency Counts:%s\n", dumpData(mLatencyCounts).c_str());
-        dprintf(fd, "  Error Counts: %s\n", dumpData(mErrorCounts).c_str());
+    dprintf(fd, "  Waveform Counts:%s\n", dumpData(mWaveformCounts.values()).c_str());
+    dprintf(fd, "  Duration Counts:%s\n", dumpData(mDurationCounts.values()).c_str());
+    dprintf(fd, "  Min Latencies:%s\n", dumpData(mMinLatencies.values()).c_str());
+    dprintf(fd, "  Max Latencies:%s\n", dumpData(mMaxLatencies.values()).c_str());
+    dprintf(fd, "  Latency Totals:%s\n", dumpData(mLatencyTotals.values()).c_str());
+    dprintf(fd, "  Latency Counts:%s\n", dumpData(mLatencyCounts.values()).c_str());
+    const std::vector<int32_t> histogram = mLatencyHistogram.values();
+    for (size_t i = 0; i < mLatencyCounts.size(); i++) {
+        dprintf(fd, "  Latency Histogram %zu (<1 <2 <4 ... <128 >=128 ms):%s\n", i,
+                dumpData(std::vector<int32_t>(histogram.begin() + i * LATENCY_BUCKET_COUNT,
+                                              histogram.begin() + (i + 1) * LATENCY_BUCKET_COUNT))
+                        .c_str());
     }
+    dprintf(fd, "  Error Counts: %s\n", dumpData(mErrorCounts.values()).c_str());
 }
 
 void StatsBase::reportVendorAtomAsync(const VendorAtom &atom) {
@@ -124,9 +180,15 @@ void StatsBase::reportVendorAtomAsync(const VendorAtom &atom) {
 
 void StatsBase::uploadDiagnostics() {
     STATS_TRACE("uploadDiagnostics()");
-    uploadPlaycountAtoms();
-    uploadLatencyAtoms();
-    uploadErrorAtoms();
+    // Queued together, so the next drain reports them all in one pass
+    std::vector<VendorAtom> atoms;
+    atoms.push_back(vibratorPlaycountAtom());
+    atoms.push_back(vibratorLatencyAtom());
+    atoms.push_back(vibratorErrorAtom());
+
+    std::scoped_lock<std::mutex> lock(mAtomQueueAccess);
+    std::move(atoms.begin(), atoms.end(), std::back_inserter(mAtomQueue));
+    mAtomQueueUpdated.notify_all();
 }
 
 std::shared_ptr<IStats> StatsBase::waitForStatsService() const {
@@ -176,48 +238,24 @@ void StatsBase::drainAtomQueue() {
         std::unique_lock<std::mutex> lock(mAtomQueueAccess);
         std::swap(mAtomQueue, tempQueue);
     }
+    if (tempQueue.empty()) {
+        return;
+    }
 
-    std::shared_ptr<IStats> client = waitForStatsService();
-    if (!client) {
+    if (!mStatsClient) {
+        mStatsClient = waitForStatsService();
+    }
+    if (!mStatsClient) {
         ALOGE("Failed to get IStats service. Atoms are dropped.");
         return;
     }
 
     for (const VendorAtom &atom : tempQueue) {
-        reportVendorAtom(client, atom);
-    }
-}
-
-void StatsBase::uploadPlaycountAtoms() {
-    STATS_TRACE("uploadPlaycountAtoms()");
-    VendorAtom playcountAtom = vibratorPlaycountAtom();
-    reportVendorAtomAsync(playcountAtom);
-    clearData(&mWaveformCounts);
-    clearData(&mDurationCounts);
-}
-
-void StatsBase::uploadLatencyAtoms() {
-    STATS_TRACE("uploadLatencyAtoms()");
-    VendorAtom latencyAtom = vibratorLatencyAtom();
-    reportVendorAtomAsync(latencyAtom);
-    clearData(&mMinLatencies);
-    clearData(&mMaxLatencies);
-    clearData(&mLatencyTotals);
-    clearData(&mLatencyCounts);
-}
-
-void StatsBase::uploadErrorAtoms() {
-    STATS_TRACE("uploadErrorAtoms()");
-    VendorAtom errorAtom = vibratorErrorAtom();
-    reportVendorAtomAsync(errorAtom);
-    clearData(&mErrorCounts);
-}
-
-void StatsBase::clearData(std::vector<int32_t> *data) {
-    STATS_TRACE("clearData(data)");
-    if (data) {
-        std::scoped_lock<std::mutex> lock(mDataAccess);
-        std::fill((*data).begin(), (*data).end(), 0);
+        if (!reportVendorAtom(mStatsClient, atom)) {
+            // The service may have restarted; look it up again for the next atoms
+            mStatsClient = nullptr;
+            return;
+        }
     }
 }
 
@@ -225,11 +263,8 @@ VendorAtom StatsBase::vibratorPlaycountAtom() {
     STATS_TRACE("vibratorPlaycountAtom()");
     std::vector<VendorAtomValue> values(2);
 
-    {
-        std::scoped_lock<std::mutex> lock(mDataAccess);
-        values[0].set<VendorAtomValue::repeatedIntValue>(mWaveformCounts);
-        values[1].set<VendorAtomValue::repeatedIntValue>(mDurationCounts);
-    }
+    values[0].set<VendorAtomValue::repeatedIntValue>(mWaveformCounts.values(true));
+    values[1].set<VendorAtomValue::repeatedIntValue>(mDurationCounts.values(true));
 
     return VendorAtom{
             .reverseDomainName = "",
@@ -241,22 +276,22 @@ VendorAtom StatsBase::vibratorPlaycountAtom() {
 VendorAtom StatsBase::vibratorLatencyAtom() {
     STATS_TRACE("vibratorLatencyAtom()");
     std::vector<VendorAtomValue> values(3);
+    const std::vector<int32_t> totals = mLatencyTotals.values(true);
+    const std::vector<int32_t> counts = mLatencyCounts.values(true);
     std::vector<int32_t> avgLatencies;
 
-    {
-        std::scoped_lock<std::mutex> lock(mDataAccess);
-        for (uint32_t i = 0; i < mLatencyCounts.size(); i++) {
-            int32_t avg = 0;
-            if (mLatencyCounts[0] > 0) {
-                avg = mLatencyTotals[i] / mLatencyCounts[i];
-            }
-            avgLatencies.push_back(avg);
+    for (uint32_t i = 0; i < counts.size(); i++) {
+        int32_t avg = 0;
+        if (counts[i] > 0) {
+            avg = totals[i] / counts[i];
         }
-
-        values[0].set<VendorAtomValue::repeatedIntValue>(mMinLatencies);
-        values[1].set<VendorAtomValue::repeatedIntValue>(mMaxLatencies);
+        avgLatencies.push_back(avg);
     }
+
+    values[0].set<VendorAtomValue::repeatedIntValue>(mMinLatencies.values(true));
+    values[1].set<VendorAtomValue::repeatedIntValue>(mMaxLatencies.values(true));
     values[2].set<VendorAtomValue::repeatedIntValue>(avgLatencies);
+    mLatencyHistogram.values(true);
 
     return VendorAtom{
             .reverseDomainName = "",
@@ -269,10 +304,7 @@ VendorAtom StatsBase::vibratorErrorAtom() {
     STATS_TRACE("vibratorErrorAtom()");
     std::vector<VendorAtomValue> values(1);
 
-    {
-        std::scoped_lock<std::mutex> lock(mDataAccess);
-        values[0].set<VendorAtomValue::repeatedIntValue>(mErrorCounts);
-    }
+    values[0].set<VendorAtomValue::repeatedIntValue>(mErrorCounts.values(true));
 
     return VendorAtom{
             .reverseDomainName = "",
@@ -17,7 +17,9 @@
 
 #include <utils/SystemClock.h>
 
+#include <atomic>
 #include <cinttypes>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <vector>
@@ -43,6 +45,25 @@ namespace android {
 namespace hardware {
 namespace vibrator {
 
+// A fixed number of counters that are updated without a lock
+class StatsCounters {
+  public:
+    void resize(size_t size);
+    size_t size() const { return mSize; }
+    void add(size_t index, int32_t value = 1) {
+        mData[index].fetch_add(value, std::memory_order_relaxed);
+    }
+    // Lowers the counter to value, where 0 is no value yet
+    void updateMin(size_t index, int32_t value);
+    void updateMax(size_t index, int32_t value);
+    // Takes the counters, leaving them 0 if clear
+    std::vector<int32_t> values(bool clear = false);
+
+  private:
+    std::unique_ptr<std::atomic<int32_t>[]> mData;
+    size_t mSize = 0;
+};
+
 class StatsBase {
   public:
     using VendorAtom = ::aidl::android::frameworks::stats::VendorAtom;
@@ -54,14 +75,22 @@ class StatsBase {
     void debug(int fd);
 
   protected:
-    std::vector<int32_t> mWaveformCounts;
-    std::vector<int32_t> mDurationCounts;
-    std::vector<int32_t> mMinLatencies;
-    std::vector<int32_t> mMaxLatencies;
-    std::vector<int32_t> mLatencyTotals;
-    std::vector<int32_t> mLatencyCounts;
-    std::vector<int32_t> mErrorCounts;
-    std::mutex mDataAccess;
+    // Powers of two of milliseconds: under 1, 2, 4 ... 128, and the rest
+    static const size_t LATENCY_BUCKET_COUNT = 9;
+
+    // Sizes the latency counters, after which logLatency() may be called
+    void initLatencies(size_t latencyCount);
+    // Adds a latency of the given kind, in milliseconds
+    void logLatency(size_t latencyIndex, int32_t latency);
+
+    StatsCounters mWaveformCounts;
+    StatsCounters mDurationCounts;
+    StatsCounters mMinLatencies;
+    StatsCounters mMaxLatencies;
+    StatsCounters mLatencyTotals;
+    StatsCounters mLatencyCounts;
+    StatsCounters mLatencyHistogram;
+    StatsCounters mErrorCounts;
 
   private:
     void runReporterThread();
@@ -70,17 +99,13 @@ class StatsBase {
     std::shared_ptr<IStats> waitForStatsService() const;
     void drainAtomQueue();
 
-    void uploadPlaycountAtoms();
-    void uploadLatencyAtoms();
-    void uploadErrorAtoms();
-
-    void clearData(std::vector<int32_t> *data);
-
     VendorAtom vibratorPlaycountAtom();
     VendorAtom vibratorLatencyAtom();
     VendorAtom vibratorErrorAtom();
 
     std::thread mReporterThread;
+    // Only used on the reporter thread, and dropped when a report fails
+    std::shared_ptr<IStats> mStatsClient;
     std::vector<VendorAtom> mAtomQueue;
     std::mutex mAtomQueueAccess;
     std::condition_variable mAtomQueueUpdated;
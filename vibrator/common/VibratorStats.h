@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+enum EffectLatency : uint16_t {
+    kWaveformEffectLatency = 0,
+    kPrebakedEffectLatency,
+    kCompositionEffectLatency,
+    kPwleEffectLatency,
+
+    kEffectLatencyCount
+};
+
+enum VibratorError : uint16_t {
+    kInitError = 0,
+    kHwApiError,
+    kHwCalError,
+    kComposeFailError,
+    kAlsaFailError,
+    kAsyncFailError,
+    kBadTimeoutError,
+    kBadAmplitudeError,
+    kBadEffectError,
+    kBadEffectStrengthError,
+    kBadPrimitiveError,
+    kBadCompositeError,
+    kPwleConstructionFailError,
+    kUnsupportedOpError,
+
+    kVibratorErrorCount
+};
+
+// APIs for logging data to statistics backend, the same for all the chips so
+// the code that plays effects reports them the same way
+class VibratorStatsApi {
+  public:
+    virtual ~VibratorStatsApi() = default;
+    // Increment count for effect
+    virtual bool logPrimitive(uint16_t effectIndex) = 0;
+    // Increment count for long/short waveform and duration bucket
+    virtual bool logWaveform(uint16_t effectIndex, int32_t duration) = 0;
+    // Increment count for error
+    virtual bool logError(uint16_t errorIndex) = 0;
+    // Start new latency measurement
+    virtual bool logLatencyStart(uint16_t latencyIndex) = 0;
+    // Finish latency measurement and update latency statistics with result
+    virtual bool logLatencyEnd() = 0;
+    // Emit diagnostic information to the given file.
+    virtual void debug(int fd) = 0;
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
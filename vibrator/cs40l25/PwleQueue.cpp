@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PwleQueue.h"
+
+#include <stdio.h>
+
+#include <charconv>
+#include <cmath>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+static constexpr char PWLE_QUEUE_HEADER[] = "S:0,WF:4,RP:0,WT:0";
+
+PwleQueue::PwleQueue(size_t capacity) {
+    mQueue.reserve(capacity);
+    reset();
+}
+
+void PwleQueue::reset() {
+    mQueue.assign(PWLE_QUEUE_HEADER);
+    mSegments = 0;
+}
+
+void PwleQueue::addActiveSegment(int duration, float level, float frequency) {
+    appendField(",T", duration);
+    appendLevel(level);
+    appendField(",F", std::lroundf(frequency));
+    appendField(",C", 1);
+    appendField(",B", 0);
+    appendField(",AR", 0);
+    appendField(",V", 0);
+    mSegments++;
+}
+
+void PwleQueue::addBrakingSegment(int duration, Braking braking, float frequency) {
+    appendField(",T", duration);
+    appendField(",L", 0);
+    appendField(",F", std::lroundf(frequency));
+    appendField(",C", 0);
+    appendField(",B", static_cast<std::underlying_type<Braking>::type>(braking));
+    appendField(",AR", 0);
+    appendField(",V", 0);
+    mSegments++;
+}
+
+void PwleQueue::appendField(const char *key, long value) {
+    mQueue.append(key);
+    appendInt(mSegments);
+    mQueue.push_back(':');
+    appendInt(value);
+}
+
+void PwleQueue::appendLevel(float level) {
+    // One significant digit, as the driver has always been sent
+    char buf[16];
+    int len = snprintf(buf, sizeof(buf), "%.1g", level);
+
+    mQueue.append(",L");
+    appendInt(mSegments);
+    mQueue.push_back(':');
+    mQueue.append(buf, len);
+}
+
+void PwleQueue::appendInt(long value) {
+    char buf[24];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+
+    mQueue.append(buf, result.ptr);
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
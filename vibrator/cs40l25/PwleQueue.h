@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <aidl/android/hardware/vibrator/BnVibrator.h>
+
+#include <string>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+/*
+ * Builds the text written to the cs40l2x pwle node: a header, then for each
+ * segment its time, level, frequency, chirp, braking, amplitude regulation
+ * and vbemf fields, e.g. "S:0,WF:4,RP:0,WT:0,T0:0,L0:0.5,F0:150,C0:1,...".
+ * The buffer is kept from one queue to the next, so once it has grown to the
+ * longest queue the driver takes, building one does not allocate.
+ */
+class PwleQueue {
+  public:
+    explicit PwleQueue(size_t capacity);
+
+    // Starts a new queue with no segments
+    void reset();
+    void addActiveSegment(int duration, float level, float frequency);
+    void addBrakingSegment(int duration, Braking braking, float frequency);
+
+    const std::string &str() const { return mQueue; }
+    int segments() const { return mSegments; }
+
+  private:
+    void appendField(const char *key, long value);
+    void appendLevel(float level);
+    void appendInt(long value);
+
+    std::string mQueue;
+    int mSegments{0};
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -100,34 +100,6 @@ namespace android {
 namespace hardware {
 namespace vibrator {
 
-enum EffectLatency : uint16_t {
-    kWaveformEffectLatency = 0,
-    kPrebakedEffectLatency,
-    kCompositionEffectLatency,
-    kPwleEffectLatency,
-
-    kEffectLatencyCount
-};
-
-enum VibratorError : uint16_t {
-    kInitError = 0,
-    kHwApiError,
-    kHwCalError,
-    kComposeFailError,
-    kAlsaFailError,
-    kAsyncFailError,
-    kBadTimeoutError,
-    kBadAmplitudeError,
-    kBadEffectError,
-    kBadEffectStrengthError,
-    kBadPrimitiveError,
-    kBadCompositeError,
-    kPwleConstructionFailError,
-    kUnsupportedOpError,
-
-    kVibratorErrorCount
-};
-
 class StatsApi : public Vibrator::StatsApi, private StatsBase {
   private:
     static constexpr uint32_t BASE_CONTINUOUS_EFFECT_OFFSET = 32768;
@@ -163,13 +135,10 @@ class StatsApi : public Vibrator::StatsApi, private StatsBase {
     StatsApi()
         : StatsBase(std::string(std::getenv("STATS_INSTANCE"))),
           mCurrentLatencyIndex(kEffectLatencyCount) {
-        mWaveformCounts = std::vector<int32_t>(WAVEFORM_MAX_INDEX, 0);
-        mDurationCounts = std::vector<int32_t>(DURATION_BUCKET_COUNT, 0);
-        mMinLatencies = std::vector<int32_t>(kEffectLatencyCount, 0);
-        mMaxLatencies = std::vector<int32_t>(kEffectLatencyCount, 0);
-        mLatencyTotals = std::vector<int32_t>(kEffectLatencyCount, 0);
-        mLatencyCounts = std::vector<int32_t>(kEffectLatencyCount, 0);
-        mErrorCounts = std::vector<int32_t>(kVibratorErrorCount, 0);
+        mWaveformCounts.resize(WAVEFORM_MAX_INDEX);
+        mDurationCounts.resize(DURATION_BUCKET_COUNT);
+        initLatencies(kEffectLatencyCount);
+        mErrorCounts.resize(kVibratorErrorCount);
     }
 
     bool logPrimitive(uint16_t effectIndex) override {
@@ -182,10 +151,7 @@ class StatsApi : public Vibrator::StatsApi, private StatsBase {
             return false;
         }
 
-        {
-            std::scoped_lock<std::mutex> lock(mDataAccess);
-            mWaveformCounts[effectIndex]++;
-        }
+        mWaveformCounts.add(effectIndex);
 
         return true;
     }
@@ -208,14 +174,11 @@ class StatsApi : public Vibrator::StatsApi, private StatsBase {
             return false;
         }
 
-        {
-            std::scoped_lock<std::mutex> lock(mDataAccess);
-            mWaveformCounts[effectIndex]++;
-            if (duration < DURATION_BUCKET_WIDTH * DURATION_50MS_BUCKET_COUNT) {
-                mDurationCounts[duration / DURATION_BUCKET_WIDTH]++;
-            } else {
-                mDurationCounts[DURATION_50MS_BUCKET_COUNT]++;
-            }
+        mWaveformCounts.add(effectIndex);
+        if (duration < DURATION_BUCKET_WIDTH * DURATION_50MS_BUCKET_COUNT) {
+            mDurationCounts.add(duration / DURATION_BUCKET_WIDTH);
+        } else {
+            mDurationCounts.add(DURATION_50MS_BUCKET_COUNT);
         }
 
         return true;
@@ -229,10 +192,7 @@ class StatsApi : public Vibrator::StatsApi, private StatsBase {
             return false;
         }
 
-        {
-            std::scoped_lock<std::mutex> lock(mDataAccess);
-            mErrorCounts[errorIndex]++;
-        }
+        mErrorCounts.add(errorIndex);
 
         return true;
     }
@@ -262,18 +222,7 @@ class StatsApi : public Vibrator::StatsApi, private StatsBase {
                                    std::chrono::steady_clock::now() - mCurrentLatencyStart))
                                   .count();
 
-        {
-            std::scoped_lock<std::mutex> lock(mDataAccess);
-            if (latency < mMinLatencies[mCurrentLatencyIndex] ||
-                mMinLatencies[mCurrentLatencyIndex] == 0) {
-                mMinLatencies[mCurrentLatencyIndex] = latency;
-            }
-            if (latency > mMaxLatencies[mCurrentLatencyIndex]) {
-                mMaxLatencies[mCurrentLatencyIndex] = latency;
-            }
-            mLatencyTotals[mCurrentLatencyIndex] += latency;
-            mLatencyCounts[mCurrentLatencyIndex]++;
-        }
+        logLatency(mCurrentLatencyIndex, latency);
 
         mCurrentLatencyIndex = kEffectLatencyCount;
         return true;
@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <cinttypes>
 #include <cmath>
 #include <fstream>
@@ -30,6 +31,7 @@
 #include <map>
 #include <sstream>
 
+#include "Composition.h"
 #include "Stats.h"
 
 #ifndef ARRAY_SIZE
@@ -110,8 +112,6 @@ static constexpr int32_t Q16_BIT_SHIFT = 16;
 static constexpr int32_t Q17_BIT_SHIFT = 17;
 
 static constexpr int32_t COMPOSE_PWLE_PRIMITIVE_DURATION_MAX_MS = 999;
-static constexpr float PWLE_LEVEL_MIN = 0.0f;
-static constexpr float PWLE_LEVEL_MAX = 1.0f;
 static constexpr float CS40L2X_PWLE_LEVEL_MAX = 0.99f;
 static constexpr float PWLE_FREQUENCY_RESOLUTION_HZ = 1.0f;
 static constexpr float PWLE_FREQUENCY_MIN_HZ = 30.0f;
@@ -214,7 +214,7 @@ Vibrator::Vibrator(std::unique_ptr<HwApi> hwapi, std::unique_ptr<HwCal> hwcal,
     : mHwApi(std::move(hwapi)),
       mHwCal(std::move(hwcal)),
       mStatsApi(std::move(statsapi)),
-      mAsyncHandle(std::async([] {})) {
+      mPwleQueue(CS40L2X_PWLE_LENGTH_MAX) {
     int32_t longFreqencyShift;
     uint32_t calVer;
     uint32_t caldata;
@@ -492,42 +492,43 @@ ndk::ScopedAStatus Vibrator::compose(const std::vector<CompositeEffect> &composi
 
     mStatsApi->logLatencyStart(kCompositionEffectLatency);
 
-    if (composite.size() > COMPOSE_SIZE_MAX) {
-        mStatsApi->logError(kBadCompositeError);
-        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-    }
     const std::scoped_lock<std::mutex> lock(mTotalDurationMutex);
 
-    // Reset the mTotalDuration
-    mTotalDuration = 0;
-    for (auto &e : composite) {
-        if (e.scale < 0.0f || e.scale > 1.0f) {
-            mStatsApi->logError(kBadCompositeError);
-            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-        }
+    // The queue lists delays and effect.level pairs, separated by commas
+    struct ComposeBackend {
+        Vibrator *vibrator;
+        std::ostringstream *effectBuilder;
 
-        if (e.delayMs) {
-            if (e.delayMs > COMPOSE_DELAY_MAX_MS) {
-                mStatsApi->logError(kBadCompositeError);
-                return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-            }
-            effectBuilder << e.delayMs << ",";
-            mTotalDuration += e.delayMs;
+        void rejected() { vibrator->mStatsApi->logError(kBadCompositeError); }
+
+        ndk::ScopedAStatus addDelay(int32_t delayMs) {
+            *effectBuilder << delayMs << ",";
+            vibrator->mTotalDuration += delayMs;
+            return ndk::ScopedAStatus::ok();
         }
-        if (e.primitive != CompositePrimitive::NOOP) {
-            ndk::ScopedAStatus status;
-            uint32_t effectIndex;
 
-            status = getPrimitiveDetails(e.primitive, &effectIndex);
-            mStatsApi->logPrimitive(effectIndex);
+        ndk::ScopedAStatus addPrimitive(CompositePrimitive primitive, float scale) {
+            uint32_t effectIndex;
+            ndk::ScopedAStatus status = vibrator->getPrimitiveDetails(primitive, &effectIndex);
             if (!status.isOk()) {
-                mStatsApi->logError(kBadCompositeError);
+                vibrator->mStatsApi->logError(kBadCompositeError);
                 return status;
             }
+            vibrator->mStatsApi->logPrimitive(effectIndex);
 
-            effectBuilder << effectIndex << "." << intensityToVolLevel(e.scale, effectIndex) << ",";
-            mTotalDuration += mEffectDurations[effectIndex];
+            *effectBuilder << effectIndex << "."
+                           << vibrator->intensityToVolLevel(scale, effectIndex) << ",";
+            vibrator->mTotalDuration += vibrator->mEffectDurations[effectIndex];
+            return ndk::ScopedAStatus::ok();
         }
+    } backend{this, &effectBuilder};
+
+    // Reset the mTotalDuration
+    mTotalDuration = 0;
+    ndk::ScopedAStatus status =
+            compileComposition(composite, COMPOSE_SIZE_MAX, COMPOSE_DELAY_MAX_MS, &backend);
+    if (!status.isOk()) {
+        return status;
     }
 
     if (effectBuilder.tellp() == 0) {
@@ -550,7 +551,7 @@ ndk::ScopedAStatus Vibrator::on(uint32_t timeoutMs, uint32_t effectIndex,
         ALOGE("Device is under external control mode. Force to disable it to prevent chip hang "
               "problem.");
     }
-    if (mAsyncHandle.wait_for(ASYNC_COMPLETION_TIMEOUT) != std::future_status::ready) {
+    if (!mCompletionMonitor.idle(ASYNC_COMPLETION_TIMEOUT)) {
         mStatsApi->logError(kAsyncFailError);
         ALOGE("Previous vibration pending: prev: %d, curr: %d", mActiveId, effectIndex);
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
@@ -571,7 +572,7 @@ ndk::ScopedAStatus Vibrator::on(uint32_t timeoutMs, uint32_t effectIndex,
 
     mActiveId = effectIndex;
 
-    mAsyncHandle = std::async(&Vibrator::waitForComplete, this, callback);
+    mCompletionMonitor.push(callback);
 
     return ndk::ScopedAStatus::ok();
 }
@@ -851,53 +852,17 @@ ndk::ScopedAStatus Vibrator::setPwle(const std::string &pwleQueue) {
     return ndk::ScopedAStatus::ok();
 }
 
-static void incrementIndex(int *index) {
-    *index += 1;
-}
-
-static void constructActiveDefaults(std::ostringstream &pwleBuilder, const int &segmentIdx) {
-    HAPTICS_TRACE("constructActiveDefaults(pwleBuilder, segmentIdx:%d)", segmentIdx);
-    pwleBuilder << ",C" << segmentIdx << ":1";
-    pwleBuilder << ",B" << segmentIdx << ":0";
-    pwleBuilder << ",AR" << segmentIdx << ":0";
-    pwleBuilder << ",V" << segmentIdx << ":0";
-}
-
-static void constructActiveSegment(std::ostringstream &pwleBuilder, const int &segmentIdx,
-                                   int duration, float amplitude, float frequency) {
-    HAPTICS_TRACE(
-            "constructActiveSegment(pwleBuilder, segmentIdx:%d, duration:%d, amplitude:%f, "
-            "frequency:%f)",
-            segmentIdx, duration, amplitude, frequency);
-    pwleBuilder << ",T" << segmentIdx << ":" << duration;
-    pwleBuilder << ",L" << segmentIdx << ":" << std::setprecision(1) << amplitude;
-    pwleBuilder << ",F" << segmentIdx << ":" << std::lroundf(frequency);
-    constructActiveDefaults(pwleBuilder, segmentIdx);
-}
-
-static void constructBrakingSegment(std::ostringstream &pwleBuilder, const int &segmentIdx,
-                                    int duration, Braking brakingType, float frequency) {
-    HAPTICS_TRACE(
-            "constructActiveSegment(pwleBuilder, segmentIdx:%d, duration:%d, brakingType:%s, "
-            "frequency:%f)",
-            segmentIdx, duration, toString(brakingType).c_str(), frequency);
-    pwleBuilder << ",T" << segmentIdx << ":" << duration;
-    pwleBuilder << ",L" << segmentIdx << ":" << 0;
-    pwleBuilder << ",F" << segmentIdx << ":" << std::lroundf(frequency);
-    pwleBuilder << ",C" << segmentIdx << ":0";
-    pwleBuilder << ",B" << segmentIdx << ":"
-                << static_cast<std::underlying_type<Braking>::type>(brakingType);
-    pwleBuilder << ",AR" << segmentIdx << ":0";
-    pwleBuilder << ",V" << segmentIdx << ":0";
+// The limit on input level at a frequency, from the nearest point of pwleMaxLevelLimitMap
+static float pwleMaxLevelLimit(float frequency) {
+    long idx = std::lroundf((frequency - PWLE_FREQUENCY_MIN_HZ) / PWLE_FREQUENCY_RESOLUTION_HZ);
+    idx = std::clamp(idx, 0L, static_cast<long>(pwleMaxLevelLimitMap.size()) - 1);
+    return pwleMaxLevelLimitMap[idx];
 }
 
 ndk::ScopedAStatus Vibrator::composePwle(const std::vector<PrimitivePwle> &composite,
                                          const std::shared_ptr<IVibratorCallback> &callback) {
     HAPTICS_TRACE("composePwle(composite, callback)");
     ATRACE_NAME("Vibrator::composePwle");
-    std::ostringstream pwleBuilder;
-    std::string pwleQueue;
-
     mStatsApi->logLatencyStart(kPwleEffectLatency);
 
     if (!mIsChirpEnabled) {
@@ -905,100 +870,64 @@ ndk::ScopedAStatus Vibrator::composePwle(const std::vector<PrimitivePwle> &compo
         return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
     }
 
-    if (composite.size() <= 0 || composite.size() > mCompositionSizeMax) {
-        mStatsApi->logError(kBadCompositeError);
-        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-    }
+    // Each ramp starts where the last one ended unless it says otherwise, and
+    // braking leaves the actuator still at the frequency it was braked from
+    struct PwleBackend {
+        Vibrator *vibrator;
+        float prevEndAmplitude;
+        float prevEndFrequency;
+        uint32_t totalDuration;
 
-    float prevEndAmplitude = 0;
-    float prevEndFrequency = mResonantFrequency;
+        void rejected(VibratorError error) { vibrator->mStatsApi->logError(error); }
 
-    int segmentIdx = 0;
-    uint32_t totalDuration = 0;
+        ndk::ScopedAStatus addActive(ActivePwle active) {
+            // clip to the hard limit on input level from pwleMaxLevelLimitMap
+            active.startAmplitude =
+                    std::min(active.startAmplitude, pwleMaxLevelLimit(active.startFrequency));
+            active.endAmplitude =
+                    std::min(active.endAmplitude, pwleMaxLevelLimit(active.endFrequency));
 
-    pwleBuilder << "S:0,WF:4,RP:0,WT:0";
-
-    for (auto &e : composite) {
-        switch (e.getTag()) {
-            case PrimitivePwle::active: {
-                auto active = e.get<PrimitivePwle::active>();
-                if (active.duration < 0 ||
-                    active.duration > COMPOSE_PWLE_PRIMITIVE_DURATION_MAX_MS) {
-                    mStatsApi->logError(kBadCompositeError);
-                    return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-                }
-                if (active.startAmplitude < PWLE_LEVEL_MIN ||
-                    active.startAmplitude > PWLE_LEVEL_MAX ||
-                    active.endAmplitude < PWLE_LEVEL_MIN || active.endAmplitude > PWLE_LEVEL_MAX) {
-                    mStatsApi->logError(kBadCompositeError);
-                    return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-                }
-                if (active.startAmplitude > CS40L2X_PWLE_LEVEL_MAX) {
-                    active.startAmplitude = CS40L2X_PWLE_LEVEL_MAX;
-                }
-                if (active.endAmplitude > CS40L2X_PWLE_LEVEL_MAX) {
-                    active.endAmplitude = CS40L2X_PWLE_LEVEL_MAX;
-                }
-
-                if (active.startFrequency < PWLE_FREQUENCY_MIN_HZ ||
-                    active.startFrequency > PWLE_FREQUENCY_MAX_HZ ||
-                    active.endFrequency < PWLE_FREQUENCY_MIN_HZ ||
-                    active.endFrequency > PWLE_FREQUENCY_MAX_HZ) {
-                    mStatsApi->logError(kBadCompositeError);
-                    return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-                }
-
-                // clip to the hard limit on input level from pwleMaxLevelLimitMap
-                float maxLevelLimit =
-                    pwleMaxLevelLimitMap[active.startFrequency / PWLE_FREQUENCY_RESOLUTION_HZ - 1];
-                if (active.startAmplitude > maxLevelLimit) {
-                    active.startAmplitude = maxLevelLimit;
-                }
-                maxLevelLimit =
-                    pwleMaxLevelLimitMap[active.endFrequency / PWLE_FREQUENCY_RESOLUTION_HZ - 1];
-                if (active.endAmplitude > maxLevelLimit) {
-                    active.endAmplitude = maxLevelLimit;
-                }
+            if (!((active.startAmplitude == prevEndAmplitude) &&
+                  (active.startFrequency == prevEndFrequency))) {
+                vibrator->mPwleQueue.addActiveSegment(0, active.startAmplitude,
+                                                      active.startFrequency);
+            }
+            vibrator->mPwleQueue.addActiveSegment(active.duration, active.endAmplitude,
+                                                  active.endFrequency);
 
-                if (!((active.startAmplitude == prevEndAmplitude) &&
-                      (active.startFrequency == prevEndFrequency))) {
-                    constructActiveSegment(pwleBuilder, segmentIdx, 0, active.startAmplitude,
-                                           active.startFrequency);
-                    incrementIndex(&segmentIdx);
-                }
+            prevEndAmplitude = active.endAmplitude;
+            prevEndFrequency = active.endFrequency;
+            totalDuration += active.duration;
+            return ndk::ScopedAStatus::ok();
+        }
 
-                constructActiveSegment(pwleBuilder, segmentIdx, active.duration,
-                                       active.endAmplitude, active.endFrequency);
-                incrementIndex(&segmentIdx);
+        ndk::ScopedAStatus addBraking(const BrakingPwle &braking) {
+            vibrator->mPwleQueue.addBrakingSegment(braking.duration, braking.braking,
+                                                   prevEndFrequency);
 
-                prevEndAmplitude = active.endAmplitude;
-                prevEndFrequency = active.endFrequency;
-                totalDuration += active.duration;
-                break;
-            }
-            case PrimitivePwle::braking: {
-                auto braking = e.get<PrimitivePwle::braking>();
-                if (braking.braking > Braking::CLAB) {
-                    mStatsApi->logError(kBadPrimitiveError);
-                    return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-                }
-                if (braking.duration > COMPOSE_PWLE_PRIMITIVE_DURATION_MAX_MS) {
-                    mStatsApi->logError(kBadPrimitiveError);
-                    return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-                }
+            prevEndAmplitude = 0;
+            totalDuration += braking.duration;
+            return ndk::ScopedAStatus::ok();
+        }
+    } backend{this, 0, mResonantFrequency, 0};
 
-                constructBrakingSegment(pwleBuilder, segmentIdx, braking.duration, braking.braking,
-                                        prevEndFrequency);
-                incrementIndex(&segmentIdx);
+    mPwleQueue.reset();
 
-                prevEndAmplitude = 0;
-                totalDuration += braking.duration;
-                break;
-            }
-        }
+    const PwleLimits limits{
+            .sizeMax = static_cast<size_t>(mCompositionSizeMax),
+            .durationMaxMs = COMPOSE_PWLE_PRIMITIVE_DURATION_MAX_MS,
+            .frequencyMinHz = PWLE_FREQUENCY_MIN_HZ,
+            .frequencyMaxHz = PWLE_FREQUENCY_MAX_HZ,
+            .levelMax = CS40L2X_PWLE_LEVEL_MAX,
+            .clabSupported = true,
+    };
+    ndk::ScopedAStatus status = compilePwle(composite, limits, &backend);
+    if (!status.isOk()) {
+        return status;
     }
+    uint32_t totalDuration = backend.totalDuration;
 
-    pwleQueue = pwleBuilder.str();
+    const std::string &pwleQueue = mPwleQueue.str();
     ALOGD("composePwle queue: (%s)", pwleQueue.c_str());
 
     if (pwleQueue.size() > CS40L2X_PWLE_LENGTH_MAX) {
@@ -1007,7 +936,7 @@ ndk::ScopedAStatus Vibrator::composePwle(const std::vector<PrimitivePwle> &compo
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     } else {
         ALOGD("PWLE string : %u", static_cast<uint32_t>(pwleQueue.size()));
-        ndk::ScopedAStatus status = setPwle(pwleQueue);
+        status = setPwle(pwleQueue);
         if (!status.isOk()) {
             mStatsApi->logError(kPwleConstructionFailError);
             ALOGE("Failed to write pwle queue");
@@ -1027,7 +956,7 @@ ndk::ScopedAStatus Vibrator::composePwle(const std::vector<PrimitivePwle> &compo
     mStatsApi->logLatencyEnd();
     mHwApi->setActivate(1);
 
-    mAsyncHandle = std::async(&Vibrator::waitForComplete, this, callback);
+    mCompletionMonitor.push(callback);
 
     return ndk::ScopedAStatus::ok();
 }
@@ -20,7 +20,11 @@
 
 #include <array>
 #include <fstream>
-#include <future>
+#include <mutex>
+
+#include "CompletionMonitor.h"
+#include "PwleQueue.h"
+#include "VibratorStats.h"
 
 namespace aidl {
 namespace android {
@@ -144,22 +148,7 @@ class Vibrator : public BnVibrator {
     };
 
     // APIs for logging data to statistics backend
-    class StatsApi {
-      public:
-        virtual ~StatsApi() = default;
-        // Increment count for effect
-        virtual bool logPrimitive(uint16_t effectIndex) = 0;
-        // Increment count for long/short waveform and duration bucket
-        virtual bool logWaveform(uint16_t effectIndex, int32_t duration) = 0;
-        // Increment count for error
-        virtual bool logError(uint16_t errorIndex) = 0;
-        // Start new latency measurement
-        virtual bool logLatencyStart(uint16_t latencyIndex) = 0;
-        // Finish latency measurement and update latency statistics with result
-        virtual bool logLatencyEnd() = 0;
-        // Emit diagnostic information to the given file.
-        virtual void debug(int fd) = 0;
-    };
+    using StatsApi = VibratorStatsApi;
 
   public:
     Vibrator(std::unique_ptr<HwApi> hwapi, std::unique_ptr<HwCal> hwcal,
@@ -239,12 +228,12 @@ class Vibrator : public BnVibrator {
     std::array<uint32_t, 2> mClickEffectVol;
     std::array<uint32_t, 2> mLongEffectVol;
     std::vector<uint32_t> mEffectDurations;
-    std::future<void> mAsyncHandle;
+    PwleQueue mPwleQueue;
     int32_t mCompositionSizeMax;
-    struct pcm *mHapticPcm;
+    struct pcm *mHapticPcm{nullptr};
     int mCard;
     int mDevice;
-    bool mHasHapticAlsaDevice;
+    bool mHasHapticAlsaDevice{false};
     bool mIsUnderExternalControl;
     float mResonantFrequency;
     uint32_t mRedc{0};
@@ -254,6 +243,11 @@ class Vibrator : public BnVibrator {
     bool mGenerateBandwidthAmplitudeMapDone;
     uint32_t mTotalDuration{0};
     std::mutex mTotalDurationMutex;
+    // Last, so it stops before the state waitForComplete() uses is destroyed
+    CompletionMonitor mCompletionMonitor{
+            [this](std::shared_ptr<IVibratorCallback> &&callback) {
+                waitForComplete(std::move(callback));
+            }};
 };
 
 }  // namespace vibrator
@@ -34,33 +34,6 @@ namespace android {
 namespace hardware {
 namespace vibrator {
 
-enum EffectLatency : uint16_t {
-    kPrebakedEffectLatency = 0,
-    kCompositionEffectLatency,
-    kPwleEffectLatency,
-
-    kEffectLatencyCount
-};
-
-enum VibratorError : uint16_t {
-    kInitError = 0,
-    kHwApiError,
-    kHwCalError,
-    kComposeFailError,
-    kAlsaFailError,
-    kAsyncFailError,
-    kBadTimeoutError,
-    kBadAmplitudeError,
-    kBadEffectError,
-    kBadEffectStrengthError,
-    kBadPrimitiveError,
-    kBadCompositeError,
-    kPwleConstructionFailError,
-    kUnsupportedOpError,
-
-    kVibratorErrorCount
-};
-
 class StatsApi : public Vibrator::StatsApi {
   private:
     static constexpr uint32_t BASE_CONTINUOUS_EFFECT_OFFSET = 32768;
@@ -18,6 +18,7 @@
 #include <cutils/fs.h>
 
 #include "Hardware.h"
+#include "PwleQueue.h"
 #include "Stats.h"
 #include "Vibrator.h"
 
@@ -159,6 +160,24 @@ BENCHMARK_WRAPPER(VibratorBench, perform, {
     }
 })->Apply(VibratorBench::SupportedEffectArgs);
 
+static void PwleQueue_build(benchmark::State &state) {
+    const int segments = state.range(0);
+    PwleQueue queue(4096);
+
+    for (auto _ : state) {
+        queue.reset();
+        for (int i = 0; i < segments; i++) {
+            if (i % 10 == 9) {
+                queue.addBrakingSegment(i, Braking::CLAB, 150.0f);
+            } else {
+                queue.addActiveSegment(i * 7 % 1000, 0.1f * (i % 10), 30.0f + i * 2.7f);
+            }
+        }
+        benchmark::DoNotOptimize(queue.str().data());
+    }
+}
+BENCHMARK(PwleQueue_build)->Unit(benchmark::kMicrosecond)->Arg(100);
+
 }  // namespace vibrator
 }  // namespace hardware
 }  // namespace android
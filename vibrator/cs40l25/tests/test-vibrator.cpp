@@ -20,6 +20,8 @@
 #include <gtest/gtest.h>
 
 #include <future>
+#include <iomanip>
+#include <sstream>
 
 #include "Stats.h"
 #include "Vibrator.h"
@@ -681,6 +683,121 @@ INSTANTIATE_TEST_CASE_P(VibratorTests, ComposeTest,
                         ValuesIn(kComposeParams.begin(), kComposeParams.end()),
                         ComposeTest::PrintParam);
 
+// One segment of the pwle queue, formatted the way the driver has always been sent it
+static void PwleSegment(std::ostringstream *queue, int index, int duration, float level,
+                        float frequency, int chirp, int braking) {
+    *queue << ",T" << index << ":" << duration;
+    if (chirp) {
+        *queue << ",L" << index << ":" << std::setprecision(1) << level;
+    } else {
+        *queue << ",L" << index << ":" << 0;
+    }
+    *queue << ",F" << index << ":" << std::lroundf(frequency);
+    *queue << ",C" << index << ":" << chirp;
+    *queue << ",B" << index << ":" << braking;
+    *queue << ",AR" << index << ":0";
+    *queue << ",V" << index << ":0";
+}
+
+TEST_F(VibratorTest, composePwle_queue) {
+    std::unique_ptr<MockApi> mockapi;
+    std::unique_ptr<MockCal> mockcal;
+    std::unique_ptr<MockStats> mockstats;
+    std::vector<PrimitivePwle> composite;
+    std::ostringstream expected;
+    int index = 0;
+    auto callback = ndk::SharedRefBase::make<MockVibratorCallback>();
+    std::promise<void> promise;
+    std::future<void> future{promise.get_future()};
+    auto complete = [&promise] {
+        promise.set_value();
+        return ndk::ScopedAStatus::ok();
+    };
+
+    deleteVibrator();
+    createMock(&mockapi, &mockcal, &mockstats);
+    ON_CALL(*mMockCal, isChirpEnabled()).WillByDefault(Return(true));
+    createVibrator(std::move(mockapi), std::move(mockcal), std::move(mockstats));
+
+    // Levels with one, two and no significant digits, ramps that start where the last one
+    // ended and ones that do not, and braking in between
+    expected << "S:0,WF:4,RP:0,WT:0";
+    float prevEndLevel = 0;
+    float prevEndFrequency = 0;
+    for (int i = 0; i < 20; i++) {
+        ActivePwle active;
+        active.startAmplitude = (i % 3) ? prevEndLevel : 0.05f * (i % 7);
+        active.startFrequency = (i % 3) ? prevEndFrequency : 60.0f + 10 * i;
+        active.endAmplitude = 0.125f * (i % 8);
+        active.endFrequency = 80.0f + 11.3f * i;
+        active.duration = 17 * i;
+        composite.emplace_back(active);
+
+        if (!(active.startAmplitude == prevEndLevel &&
+              active.startFrequency == prevEndFrequency)) {
+            PwleSegment(&expected, index++, 0, active.startAmplitude, active.startFrequency, 1,
+                        0);
+        }
+        PwleSegment(&expected, index++, active.duration, active.endAmplitude,
+                    active.endFrequency, 1, 0);
+        prevEndLevel = active.endAmplitude;
+        prevEndFrequency = active.endFrequency;
+
+        if (i % 5 == 4) {
+            BrakingPwle braking;
+            braking.braking = (i % 2) ? Braking::CLAB : Braking::NONE;
+            braking.duration = 3 * i;
+            composite.emplace_back(braking);
+
+            PwleSegment(&expected, index++, braking.duration, 0, prevEndFrequency, 0,
+                        static_cast<int>(braking.braking));
+            prevEndLevel = 0;
+        }
+    }
+
+    EXPECT_CALL(*mMockApi, setPwle(expected.str())).WillOnce(Return(true));
+    EXPECT_CALL(*mMockApi, setEffectScale(_)).WillRepeatedly(Return(true));
+    EXPECT_CALL(*mMockApi, setEffectIndex(_)).WillOnce(Return(true));
+    EXPECT_CALL(*mMockApi, setDuration(_)).WillOnce(Return(true));
+    EXPECT_CALL(*mMockApi, setActivate(true)).WillOnce(Return(true));
+    EXPECT_CALL(*mMockApi, pollVibeState(false, _)).WillOnce(Return(true));
+    EXPECT_CALL(*mMockApi, setActivate(false)).WillOnce(Return(true));
+    EXPECT_CALL(*callback, onComplete()).WillOnce(complete);
+
+    EXPECT_EQ(EX_NONE, mVibrator->composePwle(composite, callback).getExceptionCode());
+
+    EXPECT_EQ(future.wait_for(std::chrono::milliseconds(100)), std::future_status::ready);
+}
+
+TEST_F(VibratorTest, composePwle_rejectedBeforeQueued) {
+    std::unique_ptr<MockApi> mockapi;
+    std::unique_ptr<MockCal> mockcal;
+    std::unique_ptr<MockStats> mockstats;
+    std::vector<PrimitivePwle> composite;
+
+    deleteVibrator();
+    createMock(&mockapi, &mockcal, &mockstats);
+    ON_CALL(*mMockCal, isChirpEnabled()).WillByDefault(Return(true));
+    createVibrator(std::move(mockapi), std::move(mockcal), std::move(mockstats));
+
+    // The first primitive is fine, the one after it is out of the frequency range
+    ActivePwle active;
+    active.startAmplitude = 0.5f;
+    active.startFrequency = 150.0f;
+    active.endAmplitude = 0.5f;
+    active.endFrequency = 150.0f;
+    active.duration = 10;
+    composite.emplace_back(active);
+    active.endFrequency = 1000.0f;
+    composite.emplace_back(active);
+
+    EXPECT_CALL(*mMockStats, logError(kBadPrimitiveError)).WillOnce(Return(true));
+    EXPECT_CALL(*mMockApi, setPwle(_)).Times(0);
+    EXPECT_CALL(*mMockApi, setActivate(_)).Times(0);
+
+    EXPECT_EQ(EX_ILLEGAL_ARGUMENT, mVibrator->composePwle(composite, nullptr).getExceptionCode());
+}
+
 class AlwaysOnTest : public VibratorTest, public WithParamInterface<int32_t> {
   public:
     static auto PrintParam(const TestParamInfo<ParamType> &info) {
@@ -18,6 +18,7 @@
 
 #include <linux/version.h>
 #include <log/log.h>
+#include <pixeltrace/PixelTrace.h>
 #include <utils/Trace.h>
 
 #include <cmath>
@@ -32,7 +33,7 @@ namespace vibrator {
 #ifdef VIBRATOR_TRACE
 /* Function Trace */
 #define VFTRACE(...)                                                             \
-    ATRACE_NAME(StringPrintf("Vibrator::%s", __func__).c_str());                 \
+    PIXEL_TRACE_NAME_F("Vibrator::%s", __func__);                                \
     auto f_trace_ = std::make_unique<FunctionTrace>("Vibrator", __func__);       \
     __VA_OPT__(f_trace_->addParameter(PREPEND_EACH_ARG_WITH_NAME(__VA_ARGS__))); \
     f_trace_->save()
@@ -41,7 +42,7 @@ namespace vibrator {
     auto e_trace_ = std::make_unique<EffectTrace>(i, s, d, ch); \
     e_trace_->save()
 #else
-#define VFTRACE(...) ATRACE_NAME(StringPrintf("Vibrator::%s", __func__).c_str())
+#define VFTRACE(...) PIXEL_TRACE_NAME_F("Vibrator::%s", __func__)
 #define VETRACE(...)
 #endif
 
@@ -128,6 +129,22 @@ int DspMemChunk::write(int nbits, uint32_t val) {
     return 0;
 }
 
+int DspMemChunk::writeWord(uint32_t word) {
+    if (_cachebits)
+        return write(24, word);
+
+    if (isEnd())
+        return -ENOSPC;
+
+    /* Same layout write() flushes a full cache in: a zero byte, then 24 bits big-endian */
+    *_current++ = 0;
+    *_current++ = (word >> 16) & 0xFF;
+    *_current++ = (word >> 8) & 0xFF;
+    *_current++ = word & 0xFF;
+    bytes += sizeof(_cache);
+    return 0;
+}
+
 int DspMemChunk::fToU16(float input, uint16_t *output, float scale, float min, float max) {
     VFTRACE(input, output, scale, min, max);
     if (input < min || input > max)
@@ -169,12 +186,14 @@ int DspMemChunk::constructComposeSegment(uint32_t effectVolLevel, uint32_t effec
         ALOGE("%s: Invalid argument: %u, %u", __func__, effectVolLevel, effectIndex);
         return -EINVAL;
     }
-    write(8, effectVolLevel);   /* amplitude */
-    write(8, effectIndex);      /* index */
-    write(8, repeat);           /* repeat */
-    write(8, flags);            /* flags */
-    write(16, nextEffectDelay); /* delay */
-    return 0;
+    /*
+     * A section is two whole words, so each goes in at once rather than a
+     * field at a time: amplitude, index and repeat, then flags and delay.
+     */
+    int ret = writeWord(effectVolLevel << 16 | effectIndex << 8 | repeat);
+    if (ret < 0)
+        return ret;
+    return writeWord(flags << 16 | nextEffectDelay);
 }
 
 int DspMemChunk::constructActiveSegment(int duration, float amplitude, float frequency,
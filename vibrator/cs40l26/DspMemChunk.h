@@ -95,6 +95,8 @@ class DspMemChunk {
     int min(int x, int y) { return x < y ? x : y; }
 
     int write(int nbits, uint32_t val);
+    // write(24, word), without the bit packing when the cache is empty
+    int writeWord(uint32_t word);
 
     int fToU16(float input, uint16_t *output, float scale, float min, float max);
 
@@ -70,16 +70,16 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
   public:
     HwApi() {
         HwApi::initFF();
-        open("calibration/f0_stored", &mF0);
-        open("default/f0_offset", &mF0Offset);
-        open("calibration/redc_stored", &mRedc);
-        open("calibration/q_stored", &mQ);
-        open("default/vibe_state", &mVibeState);
-        open("default/num_waves", &mEffectCount);
-        open("default/owt_free_space", &mOwtFreeSpace);
-        open("default/f0_comp_enable", &mF0CompEnable);
-        open("default/redc_comp_enable", &mRedcCompEnable);
-        open("default/delay_before_stop_playback_us", &mMinOnOffInterval);
+        open("calibration/f0_stored", &mF0, O_RDWR);
+        open("default/f0_offset", &mF0Offset, O_RDWR);
+        open("calibration/redc_stored", &mRedc, O_RDWR);
+        open("calibration/q_stored", &mQ, O_RDWR);
+        open("default/vibe_state", &mVibeState, O_RDONLY);
+        open("default/num_waves", &mEffectCount, O_RDONLY);
+        open("default/owt_free_space", &mOwtFreeSpace, O_RDONLY);
+        open("default/f0_comp_enable", &mF0CompEnable, O_RDWR);
+        open("default/redc_comp_enable", &mRedcCompEnable, O_RDWR);
+        open("default/delay_before_stop_playback_us", &mMinOnOffInterval, O_RDWR);
     }
 
     bool setF0(std::string value) override { return set(value, &mF0); }
@@ -149,14 +149,7 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
                         ALOGI("Control %s through %s", INPUT_EVENT_NAME.c_str(), g.gl_pathv[i]);
 
                         std::string path = g.gl_pathv[i];
-                        // Get fstream ready for input event write().
-                        saveName(path, &mInputIoStream);
-                        mInputIoStream.open(
-                                path, std::fstream::out | std::fstream::in | std::fstream::binary);
-                        if (!mInputIoStream) {
-                            ALOGE("Failed to open %s (%d): %s", path.c_str(), errno,
-                                  strerror(errno));
-                        }
+                        saveName(path, &mInputFd);
 
                         // Construct the sysfs device path.
                         path = "/sys/class/input/" +
@@ -195,13 +188,12 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
             ALOGE("Invalid gain");
             return false;
         }
-        mInputIoStream.write((const char *)&gain, sizeof(gain));
-        mInputIoStream.flush();
-        if (mInputIoStream.fail()) {
+        if (TEMP_FAILURE_RETRY(write(mInputFd, &gain, sizeof(gain))) !=
+            static_cast<ssize_t>(sizeof(gain))) {
             ALOGE("setFFGain fail");
             return false;
         }
-        HWAPI_RECORD(StringPrintf("%d%%", value), &mInputIoStream);
+        HWAPI_RECORD(StringPrintf("%d%%", value), &mInputFd);
         return true;
     }
     bool setFFEffect(struct ff_effect *effect, uint16_t timeoutMs) override {
@@ -214,7 +206,7 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
             ALOGE("setFFEffect fail");
             return false;
         }
-        HWAPI_RECORD(StringPrintf("#%d: %dms", (*effect).id, timeoutMs), &mInputIoStream);
+        HWAPI_RECORD(StringPrintf("#%d: %dms", (*effect).id, timeoutMs), &mInputFd);
         return true;
     }
     bool setFFPlay(int8_t index, bool value) override {
@@ -224,13 +216,12 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
                 .code = static_cast<uint16_t>(index),
                 .value = value,
         };
-        mInputIoStream.write((const char *)&play, sizeof(play));
-        mInputIoStream.flush();
-        if (mInputIoStream.fail()) {
+        if (TEMP_FAILURE_RETRY(write(mInputFd, &play, sizeof(play))) !=
+            static_cast<ssize_t>(sizeof(play))) {
             ALOGE("setFFPlay fail");
             return false;
         }
-        HWAPI_RECORD(StringPrintf("#%d: %b", index, value), &mInputIoStream);
+        HWAPI_RECORD(StringPrintf("#%d: %b", index, value), &mInputFd);
         return true;
     }
     bool getHapticAlsaDevice(int *card, int *device) override {
@@ -259,12 +250,15 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
         int ret = 0;
 
         if (enable) {
-            *haptic_pcm = pcm_open(card, device, PCM_OUT, &haptic_nohost_config);
-            if (!pcm_is_ready(*haptic_pcm)) {
-                ALOGE("cannot open pcm_out driver: %s", pcm_get_error(*haptic_pcm));
-                goto fail;
+            // A pcm left open by the last disable only needs preparing and starting
+            if (*haptic_pcm == nullptr) {
+                *haptic_pcm = pcm_open(card, device, PCM_OUT, &haptic_nohost_config);
+                if (!pcm_is_ready(*haptic_pcm)) {
+                    ALOGE("cannot open pcm_out driver: %s", pcm_get_error(*haptic_pcm));
+                    goto fail;
+                }
+                HWAPI_RECORD(std::string("pcm_open"), &mPcmStream);
             }
-            HWAPI_RECORD(std::string("pcm_open"), &mPcmStream);
 
             ret = pcm_prepare(*haptic_pcm);
             if (ret < 0) {
@@ -282,10 +276,16 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
 
             return true;
         } else {
+            // Stopped rather than closed, so that enabling it again is cheap
             if (*haptic_pcm) {
-                pcm_close(*haptic_pcm);
-                HWAPI_RECORD(std::string("pcm_close"), &mPcmStream);
-                *haptic_pcm = NULL;
+                if (pcm_stop(*haptic_pcm) < 0) {
+                    ALOGW("cannot stop haptic_pcm, closing it: %s", pcm_get_error(*haptic_pcm));
+                    pcm_close(*haptic_pcm);
+                    HWAPI_RECORD(std::string("pcm_close"), &mPcmStream);
+                    *haptic_pcm = NULL;
+                } else {
+                    HWAPI_RECORD(std::string("pcm_stop"), &mPcmStream);
+                }
             }
             return true;
         }
@@ -334,7 +334,7 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
         }
         *outEffectIndex = (*effect).id;
         *status = 0;
-        HWAPI_RECORD(StringPrintf("#%d: %dB", *outEffectIndex, numBytes), &mInputIoStream);
+        HWAPI_RECORD(StringPrintf("#%d: %dB", *outEffectIndex, numBytes), &mInputFd);
         return true;
     }
     bool eraseOwtEffect(int8_t effectIndex, std::vector<ff_effect> *effect) override {
@@ -361,14 +361,14 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
                     break;
                 }
             }
-            HWAPI_RECORD(StringPrintf("#%d", effectIndex), &mInputIoStream);
+            HWAPI_RECORD(StringPrintf("#%d", effectIndex), &mInputFd);
         } else {
             /* Flush all non-prestored effects of ff-core and driver. */
             getEffectCount(&effectCountBefore);
             for (i = WAVEFORM_MAX_PHYSICAL_INDEX; i < FF_MAX_EFFECTS; i++) {
                 if (ioctl(mInputFd, EVIOCRMFF, i) >= 0) {
                     successFlush++;
-                    HWAPI_RECORD(StringPrintf("#%d", i), &mInputIoStream);
+                    HWAPI_RECORD(StringPrintf("#%d", i), &mInputFd);
                 }
             }
             getEffectCount(&effectCountAfter);
@@ -389,13 +389,13 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
     bool enableDbc() override {
         ATRACE_NAME(__func__);
         if (isDbcSupported()) {
-            open("dbc/dbc_env_rel_coef", &mDbcEnvRelCoef);
-            open("dbc/dbc_rise_headroom", &mDbcRiseHeadroom);
-            open("dbc/dbc_fall_headroom", &mDbcFallHeadroom);
-            open("dbc/dbc_tx_lvl_thresh_fs", &mDbcTxLvlThreshFs);
-            open("dbc/dbc_tx_lvl_hold_off_ms", &mDbcTxLvlHoldOffMs);
-            open("default/pm_active_timeout_ms", &mPmActiveTimeoutMs);
-            open("dbc/dbc_enable", &mDbcEnable);
+            open("dbc/dbc_env_rel_coef", &mDbcEnvRelCoef, O_RDWR);
+            open("dbc/dbc_rise_headroom", &mDbcRiseHeadroom, O_RDWR);
+            open("dbc/dbc_fall_headroom", &mDbcFallHeadroom, O_RDWR);
+            open("dbc/dbc_tx_lvl_thresh_fs", &mDbcTxLvlThreshFs, O_RDWR);
+            open("dbc/dbc_tx_lvl_hold_off_ms", &mDbcTxLvlHoldOffMs, O_RDWR);
+            open("default/pm_active_timeout_ms", &mPmActiveTimeoutMs, O_RDWR);
+            open("dbc/dbc_enable", &mDbcEnable, O_RDWR);
 
             // Set values from config. Default if not found.
             set(utils::getProperty("ro.vendor.vibrator.hal.dbc.envrelcoef", kDbcDefaultEnvRelCoef),
@@ -432,28 +432,27 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
     static constexpr uint32_t kDefaultPmActiveTimeoutMs = 5;
     static constexpr uint32_t kDbcEnable = 1;
 
-    std::ofstream mF0;
-    std::ofstream mF0Offset;
-    std::ofstream mRedc;
-    std::ofstream mQ;
-    std::ifstream mEffectCount;
-    std::ifstream mVibeState;
-    std::ifstream mOwtFreeSpace;
-    std::ofstream mF0CompEnable;
-    std::ofstream mRedcCompEnable;
-    std::ofstream mMinOnOffInterval;
-    std::ofstream mInputIoStream;
+    unique_fd mF0;
+    unique_fd mF0Offset;
+    unique_fd mRedc;
+    unique_fd mQ;
+    unique_fd mEffectCount;
+    unique_fd mVibeState;
+    unique_fd mOwtFreeSpace;
+    unique_fd mF0CompEnable;
+    unique_fd mRedcCompEnable;
+    unique_fd mMinOnOffInterval;
     std::ofstream mPcmStream;
-    ::android::base::unique_fd mInputFd;
+    unique_fd mInputFd;
 
     // DBC Parameters
-    std::ofstream mDbcEnvRelCoef;
-    std::ofstream mDbcRiseHeadroom;
-    std::ofstream mDbcFallHeadroom;
-    std::ofstream mDbcTxLvlThreshFs;
-    std::ofstream mDbcTxLvlHoldOffMs;
-    std::ofstream mDbcEnable;
-    std::ofstream mPmActiveTimeoutMs;
+    unique_fd mDbcEnvRelCoef;
+    unique_fd mDbcRiseHeadroom;
+    unique_fd mDbcFallHeadroom;
+    unique_fd mDbcTxLvlThreshFs;
+    unique_fd mDbcTxLvlHoldOffMs;
+    unique_fd mDbcEnable;
+    unique_fd mPmActiveTimeoutMs;
 };
 
 class HwCal : public Vibrator::HwCal, private HwCalBase {
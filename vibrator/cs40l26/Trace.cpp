@@ -18,6 +18,11 @@
 
 #include <aidl/android/hardware/vibrator/BnVibrator.h>
 #include <log/log.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
 
 namespace aidl {
 namespace android {
@@ -199,55 +204,84 @@ void FunctionTrace::save() {
     Trace::push(fmtOut);
 }
 
-/* Effect Trace Implementation */
-
-EffectTrace::EffectTrace(uint16_t index, float scale, int32_t duration, const DspMemChunk *ch) {
-    std::stringstream fmt;
-    fmt << "Effect(";
-    switch (index) {
-        case WAVEFORM_LONG_VIBRATION_EFFECT_INDEX:
-            fmt << "LONG_VIBRATION, " << scale << ", " << duration << ")";
-            break;
-        case WAVEFORM_CLICK_INDEX:
-            fmt << "CLICK, " << scale << ")";
-            break;
-        case WAVEFORM_SHORT_VIBRATION_EFFECT_INDEX:
-            fmt << "SHORT_VIBRATION, " << scale << ", " << duration << ")";
-            break;
-        case WAVEFORM_THUD_INDEX:
-        case WAVEFORM_SPIN_INDEX:
-        case WAVEFORM_QUICK_RISE_INDEX:
-        case WAVEFORM_SLOW_RISE_INDEX:
-        case WAVEFORM_QUICK_FALL_INDEX:
-            break;
-        case WAVEFORM_LIGHT_TICK_INDEX:
-            fmt << "LIGHT_TICK, " << scale << ")";
-            break;
-        case WAVEFORM_LOW_TICK_INDEX:
-            break;
-        case WAVEFORM_COMPOSE:
-            fmt << "COMPOSITE, " << ch->size() << " bytes)";
-            break;
-        case WAVEFORM_PWLE:
-            fmt << "PWLE, " << ch->size() << " bytes)";
-            break;
-        default:
-            break;
-    }
-    mDescription = fmt.str();
+/* Effect History Implementation */
+
+void EffectHistory::record(uint16_t index, float scale, uint32_t durationMs,
+                           const DspMemChunk *ch, uint32_t latencyUs, int32_t result) {
+    Record &record = mRecords[mNext.fetch_add(1, std::memory_order_relaxed) % kRecordCount];
+    const uint32_t sequence = record.sequence.load(std::memory_order_relaxed);
+
+    record.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    record.timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch())
+                            .count();
+    record.durationMs = durationMs;
+    record.latencyUs = latencyUs;
+    record.scale = scale;
+    record.result = result;
+    record.index = index;
+    record.size = ch ? static_cast<uint16_t>(ch->size()) : 0;
+    record.sequence.store(sequence + 2, std::memory_order_release);
+
+    ATRACE_INT("VibratorEffect", index);
 }
 
-void EffectTrace::save() {
-    std::stringstream fmt;
-    for (int i = 0; i < depth(); i++) {
-        fmt << "   ";
-    }
-    fmt << mDescription;
+void EffectHistory::debug(int fd) const {
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    const uint32_t next = mNext.load(std::memory_order_acquire);
+    const uint32_t count = std::min<uint32_t>(next, kRecordCount);
+
+    dprintf(fd, "\nEffect History:\n");
+    for (uint32_t i = next - count; i != next; i++) {
+        const Record &slot = mRecords[i % kRecordCount];
+        const uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence & 1) {
+            continue;
+        }
+        const int64_t timeNs = slot.timeNs;
+        const uint32_t durationMs = slot.durationMs;
+        const uint32_t latencyUs = slot.latencyUs;
+        const float scale = slot.scale;
+        const int32_t result = slot.result;
+        const uint16_t index = slot.index;
+        const uint16_t size = slot.size;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+            continue;
+        }
 
-    std::string fmtOut = fmt.str();
-    ALOGI("%s", fmtOut.c_str());
-    Trace::push(fmtOut);
-    Trace::save();
+        std::string description;
+        switch (index) {
+            case WAVEFORM_LONG_VIBRATION_EFFECT_INDEX:
+                description = StringPrintf("LONG_VIBRATION, %.2f, %ums", scale, durationMs);
+                break;
+            case WAVEFORM_SHORT_VIBRATION_EFFECT_INDEX:
+                description = StringPrintf("SHORT_VIBRATION, %.2f, %ums", scale, durationMs);
+                break;
+            case WAVEFORM_CLICK_INDEX:
+                description = StringPrintf("CLICK, %.2f", scale);
+                break;
+            case WAVEFORM_LIGHT_TICK_INDEX:
+                description = StringPrintf("LIGHT_TICK, %.2f", scale);
+                break;
+            case WAVEFORM_COMPOSE:
+                description = StringPrintf("COMPOSITE, %u bytes", size);
+                break;
+            case WAVEFORM_PWLE:
+                description = StringPrintf("PWLE, %u bytes", size);
+                break;
+            default:
+                description = StringPrintf("%u, %.2f, %ums", index, scale, durationMs);
+                break;
+        }
+        const int64_t ageMs =
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                        now - std::chrono::nanoseconds(timeNs))
+                        .count();
+        dprintf(fd, "  -%" PRId64 "ms Effect(%s) latency %uus result %d\n", ageMs,
+                description.c_str(), latencyUs, result);
+    }
 }
 
 }  // namespace vibrator
@@ -22,6 +22,8 @@
 #include <hardware/vibrator.h>
 #include <linux/input.h>
 
+#include <array>
+#include <atomic>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
@@ -216,13 +218,33 @@ class FunctionTrace : public Trace {
     std::vector<std::string> mParameters;
 };
 
-class EffectTrace : public Trace {
+/*
+ * The last effects played, kept as fixed-size records so that recording one
+ * neither allocates nor formats. They are only turned into text by debug().
+ */
+class EffectHistory {
   public:
-    EffectTrace(uint16_t index, float scale, int32_t duration, const DspMemChunk *ch);
-    void save();
+    void record(uint16_t index, float scale, uint32_t durationMs, const DspMemChunk *ch,
+                uint32_t latencyUs, int32_t result);
+    void debug(int fd) const;
 
   private:
-    std::string mDescription;
+    static constexpr size_t kRecordCount = 64;
+
+    struct Record {
+        // Odd while the record is being written
+        std::atomic<uint32_t> sequence{0};
+        int64_t timeNs;
+        uint32_t durationMs;
+        uint32_t latencyUs;
+        float scale;
+        int32_t result;
+        uint16_t index;
+        uint16_t size;
+    };
+
+    std::array<Record, kRecordCount> mRecords;
+    std::atomic<uint32_t> mNext{0};
 };
 
 }  // namespace vibrator
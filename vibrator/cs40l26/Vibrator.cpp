@@ -21,9 +21,12 @@
 #include <hardware/vibrator.h>
 #include <linux/version.h>
 #include <log/log.h>
+#include <pixeltrace/PixelTrace.h>
+#include <sys/system_properties.h>
 #include <utils/Trace.h>
 #include <vendor_vibrator_hal_flags.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cinttypes>
 #include <cmath>
@@ -33,7 +36,9 @@
 #include <memory>
 #include <optional>
 #include <sstream>
+#include <string_view>
 
+#include "Composition.h"
 #include "DspMemChunk.h"
 #include "Stats.h"
 #include "Trace.h"
@@ -52,17 +57,15 @@ namespace vibrator {
 #ifdef VIBRATOR_TRACE
 /* Function Trace */
 #define VFTRACE(...)                                                             \
-    ATRACE_NAME(StringPrintf("Vibrator::%s", __func__).c_str());                 \
+    PIXEL_TRACE_NAME_F("Vibrator::%s", __func__);                                \
     auto f_trace_ = std::make_unique<FunctionTrace>("Vibrator", __func__);       \
     __VA_OPT__(f_trace_->addParameter(PREPEND_EACH_ARG_WITH_NAME(__VA_ARGS__))); \
     f_trace_->save()
-/* Effect Trace */
-#define VETRACE(i, s, d, ch)                                    \
-    auto e_trace_ = std::make_unique<EffectTrace>(i, s, d, ch); \
-    e_trace_->save()
+/* Closes the function trace of an effect */
+#define VETRACE() Trace::save()
 #else
-#define VFTRACE(...) ATRACE_NAME(StringPrintf("Vibrator::%s", __func__).c_str())
-#define VETRACE(...)
+#define VFTRACE(...) PIXEL_TRACE_NAME_F("Vibrator::%s", __func__)
+#define VETRACE()
 #endif
 
 static constexpr uint16_t FF_CUSTOM_DATA_LEN_MAX_COMP = 2044;  // (COMPOSE_SIZE_MAX + 1) * 8 + 4
@@ -82,6 +85,7 @@ static constexpr uint32_t MAX_TIME_MS = UINT16_MAX;
 static constexpr auto ASYNC_COMPLETION_TIMEOUT = std::chrono::milliseconds(100);
 static constexpr auto POLLING_TIMEOUT = 50;  // POLLING_TIMEOUT < ASYNC_COMPLETION_TIMEOUT
 static constexpr int32_t COMPOSE_DELAY_MAX_MS = 10000;
+static constexpr size_t OWT_CACHE_SIZE_MAX = 8;  // OWT effects kept loaded for replay
 
 // Measured resonant frequency, f0_measured, is represented by Q10.14 fixed
 // point format on cs40l26 devices. The expression to calculate f0 is:
@@ -103,8 +107,6 @@ static constexpr int32_t Q15_BIT_SHIFT = 15;
 // See the LRA Calibration Support documentation for more details.
 static constexpr int32_t Q16_BIT_SHIFT = 16;
 
-static constexpr float PWLE_LEVEL_MIN = 0.0;
-static constexpr float PWLE_LEVEL_MAX = 1.0;
 static constexpr float PWLE_FREQUENCY_RESOLUTION_HZ = 1.00;
 static constexpr float RESONANT_FREQUENCY_DEFAULT = 145.0f;
 static constexpr float PWLE_BW_MAP_SIZE =
@@ -175,8 +177,7 @@ Vibrator::Vibrator(std::unique_ptr<HwApi> hwapi, std::unique_ptr<HwCal> hwcal,
                    std::unique_ptr<StatsApi> statsapi)
     : mHwApi(std::move(hwapi)),
       mHwCal(std::move(hwcal)),
-      mStatsApi(std::move(statsapi)),
-      mAsyncHandle(std::async([] {})) {
+      mStatsApi(std::move(statsapi)) {
     int32_t longFrequencyShift;
     std::string caldata{8, '0'};
     uint32_t calVer;
@@ -361,7 +362,7 @@ ndk::ScopedAStatus Vibrator::off() {
         }
         halState = STOPPED;
 
-        if ((mActiveId >= WAVEFORM_MAX_PHYSICAL_INDEX) &&
+        if ((mActiveId >= WAVEFORM_MAX_PHYSICAL_INDEX) && !isOwtEffectCached(mActiveId) &&
             (!mHwApi->eraseOwtEffect(mActiveId, &mFfEffects))) {
             mStatsApi->logError(kHwApiError);
             ALOGE("Failed to clean up the composed effect %d", mActiveId);
@@ -388,7 +389,7 @@ ndk::ScopedAStatus Vibrator::on(int32_t timeoutMs,
                                 const std::shared_ptr<IVibratorCallback> &callback) {
     VFTRACE(timeoutMs, callback);
 
-    mStatsApi->logLatencyStart(kWaveformEffectLatency);
+    logLatencyStart(kWaveformEffectLatency);
     if (timeoutMs > MAX_TIME_MS) {
         mStatsApi->logError(kBadTimeoutError);
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
@@ -412,7 +413,7 @@ ndk::ScopedAStatus Vibrator::perform(Effect effect, EffectStrength strength,
                                      int32_t *_aidl_return) {
     VFTRACE(effect, strength, callback, _aidl_return);
 
-    mStatsApi->logLatencyStart(kPrebakedEffectLatency);
+    logLatencyStart(kPrebakedEffectLatency);
 
     return performEffect(effect, strength, callback, _aidl_return);
 }
@@ -450,13 +451,29 @@ ndk::ScopedAStatus Vibrator::setExternalControl(bool enabled) {
     if (!mHasPassthroughHapticDevice) {
         if (mHasHapticAlsaDevice || mConfigHapticAlsaDeviceDone ||
             hasHapticAlsaDevice()) {
-            if (!mHwApi->setHapticPcmAmp(&mHapticPcm, enabled, mCard,
-                                         mDevice)) {
+            const auto start = std::chrono::steady_clock::now();
+            bool ok = mHwApi->setHapticPcmAmp(&mHapticPcm, enabled, mCard, mDevice);
+            if (!ok && enabled) {
+                // The sound card may have been removed and added again; find it anew
+                ALOGW("Failed to enable haptic pcm device %d-%d, looking it up again", mCard,
+                      mDevice);
+                mConfigHapticAlsaDeviceDone = false;
+                mHasHapticAlsaDevice = false;
+                ok = hasHapticAlsaDevice() &&
+                     mHwApi->setHapticPcmAmp(&mHapticPcm, enabled, mCard, mDevice);
+            }
+            if (!ok) {
                 mStatsApi->logError(kHwApiError);
                 ALOGE("Failed to %s haptic pcm device: %d",
                       (enabled ? "enable" : "disable"), mDevice);
                 return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
             }
+            const uint32_t latencyUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                                               std::chrono::steady_clock::now() - start)
+                                               .count();
+            mExternalControlLatencyUs[enabled][0] = latencyUs;
+            mExternalControlLatencyUs[enabled][1] =
+                    std::max(mExternalControlLatencyUs[enabled][1], latencyUs);
         } else {
             mStatsApi->logError(kAlsaFailError);
             ALOGE("No haptics ALSA device");
@@ -507,87 +524,63 @@ ndk::ScopedAStatus Vibrator::getPrimitiveDuration(CompositePrimitive primitive,
 ndk::ScopedAStatus Vibrator::compose(const std::vector<CompositeEffect> &composite,
                                      const std::shared_ptr<IVibratorCallback> &callback) {
     VFTRACE(composite, callback);
-    uint16_t size;
-    uint16_t nextEffectDelay;
-    uint16_t totalDuration = 0;
-
-    mStatsApi->logLatencyStart(kCompositionEffectLatency);
 
-    if (composite.size() > COMPOSE_SIZE_MAX || composite.empty()) {
-        ALOGE("%s: Invalid size", __func__);
-        mStatsApi->logError(kBadCompositeError);
-        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-    }
-
-    /* Check if there is a wait before the first effect. */
-    nextEffectDelay = composite.front().delayMs;
-    totalDuration += nextEffectDelay;
-    if (nextEffectDelay > COMPOSE_DELAY_MAX_MS || nextEffectDelay < 0) {
-        ALOGE("%s: Invalid delay %u", __func__, nextEffectDelay);
-        mStatsApi->logError(kBadCompositeError);
-        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-    } else if (nextEffectDelay > 0) {
-        size = composite.size() + 1;
-    } else {
-        size = composite.size();
-    }
+    logLatencyStart(kCompositionEffectLatency);
 
     DspMemChunk ch(WAVEFORM_COMPOSE, FF_CUSTOM_DATA_LEN_MAX_COMP);
     const uint8_t header_count = ch.size();
 
-    /* Insert 1 section for a wait before the first effect. */
-    if (nextEffectDelay) {
-        ch.constructComposeSegment(0 /*amplitude*/, 0 /*index*/, 0 /*repeat*/, 0 /*flags*/,
-                                   nextEffectDelay /*delay*/);
-    }
+    // Each section plays an effect, or none, and then waits for its delay
+    struct ComposeBackend {
+        Vibrator *vibrator;
+        DspMemChunk *ch;
+        uint16_t sections = 0;
+        bool pending = false;
+        uint32_t pendingIndex = 0;
+        uint32_t pendingVolLevel = 0;
 
-    for (uint32_t i_curr = 0, i_next = 1; i_curr < composite.size(); i_curr++, i_next++) {
-        auto &e_curr = composite[i_curr];
-        uint32_t effectIndex = 0;
-        uint32_t effectVolLevel = 0;
-        if (e_curr.scale < 0.0f || e_curr.scale > 1.0f) {
-            ALOGE("%s: #%u: Invalid scale %f", __func__, i_curr, e_curr.scale);
-            mStatsApi->logError(kBadCompositeError);
-            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+        void rejected() { vibrator->mStatsApi->logError(kBadCompositeError); }
+
+        ndk::ScopedAStatus addDelay(int32_t delayMs) {
+            addSection(delayMs);
+            return ndk::ScopedAStatus::ok();
         }
 
-        if (e_curr.primitive != CompositePrimitive::NOOP) {
-            ndk::ScopedAStatus status;
-            status = getPrimitiveDetails(e_curr.primitive, &effectIndex);
+        ndk::ScopedAStatus addPrimitive(CompositePrimitive primitive, float scale) {
+            if (pending) {
+                addSection(0);
+            }
+            uint32_t effectIndex;
+            ndk::ScopedAStatus status = vibrator->getPrimitiveDetails(primitive, &effectIndex);
             if (!status.isOk()) {
                 return status;
             }
-            effectVolLevel = intensityToVolLevel(e_curr.scale, effectIndex);
-            totalDuration += mEffectDurations[effectIndex];
+            vibrator->mStatsApi->logPrimitive(effectIndex);
+            pending = true;
+            pendingIndex = effectIndex;
+            pendingVolLevel = vibrator->intensityToVolLevel(scale, effectIndex);
+            return ndk::ScopedAStatus::ok();
         }
 
-        /* Fetch the next composite effect delay and fill into the current section */
-        nextEffectDelay = 0;
-        if (i_next < composite.size()) {
-            auto &e_next = composite[i_next];
-            int32_t delay = e_next.delayMs;
-
-            if (delay > COMPOSE_DELAY_MAX_MS || delay < 0) {
-                ALOGE("%s: #%u: Invalid delay %d", __func__, i_next, delay);
-                mStatsApi->logError(kBadCompositeError);
-                return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-            }
-            nextEffectDelay = delay;
-            totalDuration += delay;
+        void addSection(uint16_t delayMs) {
+            ch->constructComposeSegment(pending ? pendingVolLevel : 0, pending ? pendingIndex : 0,
+                                        0 /*repeat*/, 0 /*flags*/, delayMs /*delay*/);
+            pending = false;
+            sections++;
         }
+    } backend{this, &ch};
 
-        if (effectIndex == 0 && nextEffectDelay == 0) {
-            ALOGE("%s: #%u: Invalid results", __func__, i_curr);
-            mStatsApi->logError(kBadCompositeError);
-            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-        }
-        mStatsApi->logPrimitive(effectIndex);
-        ch.constructComposeSegment(effectVolLevel, effectIndex, 0 /*repeat*/, 0 /*flags*/,
-                                   nextEffectDelay /*delay*/);
+    ndk::ScopedAStatus status =
+            compileComposition(composite, COMPOSE_SIZE_MAX, COMPOSE_DELAY_MAX_MS, &backend);
+    if (!status.isOk()) {
+        return status;
+    }
+    if (backend.pending) {
+        backend.addSection(0);
     }
 
     ch.flush();
-    if (ch.updateNSection(size) < 0) {
+    if (ch.updateNSection(backend.sections) < 0) {
         mStatsApi->logError(kComposeFailError);
         ALOGE("%s: Failed to update the section count", __func__);
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
@@ -614,7 +607,7 @@ ndk::ScopedAStatus Vibrator::on(uint32_t timeoutMs, uint32_t effectIndex, const
         ALOGE("Invalid waveform index %d", effectIndex);
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
     }
-    if (mAsyncHandle.wait_for(ASYNC_COMPLETION_TIMEOUT) != std::future_status::ready) {
+    if (!mCompletionMonitor.idle(ASYNC_COMPLETION_TIMEOUT)) {
         mStatsApi->logError(kAsyncFailError);
         ALOGE("Previous vibration pending: prev: %d, curr: %d", mActiveId, effectIndex);
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
@@ -633,51 +626,110 @@ ndk::ScopedAStatus Vibrator::on(uint32_t timeoutMs, uint32_t effectIndex, const
             ALOGE("Invalid OWT type");
             return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
         }
-        effectIndex = ch->type();
-
-        uint32_t freeBytes;
-        mHwApi->getOwtFreeSpace(&freeBytes);
-        if (ch->size() > freeBytes) {
-            mStatsApi->logError(kBadCompositeError);
-            ALOGE("Invalid OWT length: Effect %d: %zu > %d!", effectIndex, ch->size(), freeBytes);
-            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-        }
-        int errorStatus;
-        if (!mHwApi->uploadOwtEffect(ch->front(), ch->size(), &mFfEffects[effectIndex],
-                                     &effectIndex, &errorStatus)) {
-            mStatsApi->logError(kHwApiError);
-            ALOGE("Invalid uploadOwtEffect");
-            return ndk::ScopedAStatus::fromExceptionCode(errorStatus);
+        status = loadOwtEffect(ch, &effectIndex);
+        if (!status.isOk()) {
+            return status;
         }
 
     } else if (effectIndex == WAVEFORM_SHORT_VIBRATION_EFFECT_INDEX ||
                effectIndex == WAVEFORM_LONG_VIBRATION_EFFECT_INDEX) {
         /* Update duration for long/short vibration. */
-        // We can pass in the timeout for long/short vibration effects
-        mFfEffects[effectIndex].replay.length = static_cast<uint16_t>(timeoutMs);
-        if (!mHwApi->setFFEffect(&mFfEffects[effectIndex], static_cast<uint16_t>(timeoutMs))) {
-            mStatsApi->logError(kHwApiError);
-            ALOGE("Failed to edit effect %d (%d): %s", effectIndex, errno, strerror(errno));
-            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+        // We can pass in the timeout for long/short vibration effects. The driver keeps the
+        // last one, so a repeat of the same duration plays without editing the effect.
+        if (mFfEffects[effectIndex].replay.length != static_cast<uint16_t>(timeoutMs)) {
+            mFfEffects[effectIndex].replay.length = static_cast<uint16_t>(timeoutMs);
+            if (!mHwApi->setFFEffect(&mFfEffects[effectIndex], static_cast<uint16_t>(timeoutMs))) {
+                mStatsApi->logError(kHwApiError);
+                ALOGE("Failed to edit effect %d (%d): %s", effectIndex, errno, strerror(errno));
+                mFfEffects[effectIndex].replay.length = 0;
+                return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+            }
         }
     }
 
     const std::scoped_lock<std::mutex> lock(mActiveId_mutex);
     mActiveId = effectIndex;
     /* Play the event now. */
-    VETRACE(effectIndex, mGlobalAmplitude, timeoutMs, ch);
-    mStatsApi->logLatencyEnd();
+    VETRACE();
+    const uint32_t latencyUs = logLatencyEnd();
+    const uint16_t historyIndex = ch ? ch->type() : effectIndex;
     if (!mHwApi->setFFPlay(effectIndex, true)) {
         mStatsApi->logError(kHwApiError);
         ALOGE("Failed to play effect %d (%d): %s", effectIndex, errno, strerror(errno));
+        mEffectHistory.record(historyIndex, mGlobalAmplitude, timeoutMs, ch, latencyUs,
+                              EX_ILLEGAL_STATE);
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     }
+    mEffectHistory.record(historyIndex, mGlobalAmplitude, timeoutMs, ch, latencyUs, EX_NONE);
     halState = ISSUED;
 
-    mAsyncHandle = std::async(&Vibrator::waitForComplete, this, callback);
+    mCompletionMonitor.push(callback);
     return ndk::ScopedAStatus::ok();
 }
 
+ndk::ScopedAStatus Vibrator::loadOwtEffect(const DspMemChunk *ch, uint32_t *outEffectIndex) {
+    const uint8_t type = ch->type();
+    const uint16_t length = mFfEffects[type].replay.length;
+    const std::string_view data(reinterpret_cast<const char *>(ch->front()), ch->size());
+    const size_t hash = std::hash<std::string_view>{}(data) ^ (type << 16 | length);
+
+    for (auto entry = mOwtCache.begin(); entry != mOwtCache.end(); entry++) {
+        if (entry->hash != hash || entry->type != type || entry->length != length ||
+            entry->data.size() != data.size() ||
+            !std::equal(entry->data.begin(), entry->data.end(), ch->front())) {
+            continue;
+        }
+        *outEffectIndex = entry->effectIndex;
+        std::rotate(mOwtCache.begin(), entry, entry + 1);
+        return ndk::ScopedAStatus::ok();
+    }
+
+    if (mOwtCache.size() >= OWT_CACHE_SIZE_MAX) {
+        evictOwtEffect();
+    }
+    uint32_t freeBytes;
+    mHwApi->getOwtFreeSpace(&freeBytes);
+    while (ch->size() > freeBytes && !mOwtCache.empty()) {
+        evictOwtEffect();
+        mHwApi->getOwtFreeSpace(&freeBytes);
+    }
+    if (ch->size() > freeBytes) {
+        mStatsApi->logError(kBadCompositeError);
+        ALOGE("Invalid OWT length: Effect %d: %zu > %d!", type, ch->size(), freeBytes);
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+    uint32_t effectIndex = type;
+    int errorStatus;
+    if (!mHwApi->uploadOwtEffect(ch->front(), ch->size(), &mFfEffects[type], &effectIndex,
+                                 &errorStatus)) {
+        mStatsApi->logError(kHwApiError);
+        ALOGE("Invalid uploadOwtEffect");
+        return ndk::ScopedAStatus::fromExceptionCode(errorStatus);
+    }
+    // The cache owns the uploaded effect; the next upload of this type creates a new one
+    mFfEffects[type].id = -1;
+    mOwtCache.insert(mOwtCache.begin(), {hash, type, length,
+                                         std::vector<uint8_t>(ch->front(), ch->front() + ch->size()),
+                                         static_cast<int8_t>(effectIndex)});
+    *outEffectIndex = effectIndex;
+    return ndk::ScopedAStatus::ok();
+}
+
+void Vibrator::evictOwtEffect() {
+    const int8_t effectIndex = mOwtCache.back().effectIndex;
+    mOwtCache.pop_back();
+    if (!mHwApi->eraseOwtEffect(effectIndex, &mFfEffects)) {
+        mStatsApi->logError(kHwApiError);
+        ALOGE("Failed to evict the cached effect %d", effectIndex);
+    }
+}
+
+bool Vibrator::isOwtEffectCached(int8_t effectIndex) const {
+    return std::any_of(mOwtCache.begin(), mOwtCache.end(), [effectIndex](const auto &entry) {
+        return entry.effectIndex == effectIndex;
+    });
+}
+
 uint16_t Vibrator::amplitudeToScale(float amplitude, float maximum, bool scalable) {
     VFTRACE(amplitude, maximum, scalable);
     float ratio = 100; /* Unit: % */
@@ -707,7 +759,7 @@ uint16_t Vibrator::amplitudeToScale(float amplitude, float maximum, bool scalabl
         /* If the device is face-up or within the fade scaling range, find new scaling factor */
         if (device_face_up || now < lastFaceUpTime + mScaleTime) {
             /* Device is face-up, so we will scale it down. Start with highest scaling factor */
-            context_scale = mScalingFactor <= 100 ? static_cast<float>(mScalingFactor) / 100 : 1.0;
+            context_scale = mContextScaleByPosition[capo::PositionType::ON_TABLE_FACE_UP];
             if (mFadeEnable && mScaleTime > 0 && (context_scale < 1.0) &&
                 (now < lastFaceUpTime + mScaleTime) && !device_face_up) {
                 float fade_scale =
@@ -741,6 +793,13 @@ uint16_t Vibrator::amplitudeToScale(float amplitude, float maximum, bool scalabl
 }
 
 void Vibrator::updateContext() {
+    /* The properties are only read again after some property was set */
+    const uint32_t propertySerial = __system_property_area_serial();
+    if (propertySerial == mContextPropertySerial) {
+        return;
+    }
+    mContextPropertySerial = propertySerial;
+
     /* Don't enable capo from HAL if flag is set to remove it */
     if (vibrator_aconfig_flags::remove_capo()) {
         mContextEnable = false;
@@ -758,6 +817,9 @@ void Vibrator::updateContext() {
             mScalingFactor = mHwApi->getContextScale();
             mScaleTime = mHwApi->getContextSettlingTime();
             mScaleCooldown = mHwApi->getContextCooldownTime();
+            mContextScaleByPosition.fill(1.0);
+            mContextScaleByPosition[capo::PositionType::ON_TABLE_FACE_UP] =
+                    mScalingFactor <= 100 ? static_cast<float>(mScalingFactor) / 100 : 1.0;
             ALOGD("%s, CapoDetector started successfully! NanoAppID: 0x%x, Scaling Factor: %d, "
                   "Scaling Time: %d, Cooldown Time: %d",
                   __func__, (uint32_t)mContextListener->getNanoppAppId(), mScalingFactor,
@@ -779,14 +841,33 @@ ndk::ScopedAStatus Vibrator::setEffectAmplitude(float amplitude, float maximum,
 
     scale = amplitudeToScale(amplitude, maximum, scalable);
 
+    // The gain stays staged in the driver; only a change needs the write
+    if (scale == mFfGain) {
+        return ndk::ScopedAStatus::ok();
+    }
     if (!mHwApi->setFFGain(scale)) {
         mStatsApi->logError(kHwApiError);
         ALOGE("Failed to set the gain to %u (%d): %s", scale, errno, strerror(errno));
+        mFfGain = -1;
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     }
+    mFfGain = scale;
     return ndk::ScopedAStatus::ok();
 }
 
+void Vibrator::logLatencyStart(uint16_t latencyIndex) {
+    mStatsApi->logLatencyStart(latencyIndex);
+    mLatencyStart = std::chrono::steady_clock::now();
+}
+
+uint32_t Vibrator::logLatencyEnd() {
+    mStatsApi->logLatencyEnd();
+    const auto latencyUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - mLatencyStart);
+    mPlayLatenciesUs[mPlayLatencyCount++ % mPlayLatenciesUs.size()] = latencyUs.count();
+    return latencyUs.count();
+}
+
 ndk::ScopedAStatus Vibrator::getSupportedAlwaysOnEffects(std::vector<Effect> * /*_aidl_return*/) {
     VFTRACE();
     mStatsApi->logError(kUnsupportedOpError);
@@ -1055,7 +1136,7 @@ ndk::ScopedAStatus Vibrator::composePwle(const std::vector<PrimitivePwle> &compo
     VFTRACE(composite, callback);
     int32_t capabilities;
 
-    mStatsApi->logLatencyStart(kPwleEffectLatency);
+    logLatencyStart(kPwleEffectLatency);
 
     Vibrator::getCapabilities(&capabilities);
     if ((capabilities & IVibrator::CAP_COMPOSE_PWLE_EFFECTS) == 0) {
@@ -1064,147 +1145,107 @@ ndk::ScopedAStatus Vibrator::composePwle(const std::vector<PrimitivePwle> &compo
         return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
     }
 
-    if (composite.empty() || composite.size() > COMPOSE_PWLE_SIZE_MAX_DEFAULT) {
-        ALOGE("%s: Invalid size", __func__);
-        mStatsApi->logError(kBadCompositeError);
-        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-    }
-
     std::vector<Braking> supported;
     Vibrator::getSupportedBraking(&supported);
     bool isClabSupported =
             std::find(supported.begin(), supported.end(), Braking::CLAB) != supported.end();
 
-    int segmentIdx = 0;
-    uint32_t totalDuration = 0;
-    float prevEndAmplitude;
-    float prevEndFrequency;
-    resetPreviousEndAmplitudeEndFrequency(&prevEndAmplitude, &prevEndFrequency);
     DspMemChunk ch(WAVEFORM_PWLE, FF_CUSTOM_DATA_LEN_MAX_PWLE);
-    bool chirp = false;
-    uint16_t c = 0;
-
-    for (auto &e : composite) {
-        switch (e.getTag()) {
-            case PrimitivePwle::active: {
-                auto active = e.get<PrimitivePwle::active>();
-                if (active.duration < 0 ||
-                    active.duration > COMPOSE_PWLE_PRIMITIVE_DURATION_MAX_MS) {
-                    mStatsApi->logError(kBadPrimitiveError);
-                    ALOGE("%s: #%u: active: Invalid duration %d", __func__, c, active.duration);
-                    return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-                }
-                if (active.startAmplitude < PWLE_LEVEL_MIN ||
-                    active.startAmplitude > PWLE_LEVEL_MAX ||
-                    active.endAmplitude < PWLE_LEVEL_MIN || active.endAmplitude > PWLE_LEVEL_MAX) {
-                    mStatsApi->logError(kBadPrimitiveError);
-                    ALOGE("%s: #%u: active: Invalid scale %f, %f", __func__, c,
-                          active.startAmplitude, active.endAmplitude);
-                    return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-                }
-                if (active.startAmplitude > CS40L26_PWLE_LEVEL_MAX) {
-                    active.startAmplitude = CS40L26_PWLE_LEVEL_MAX;
-                    ALOGD("%s: #%u: active: trim the start scale", __func__, c);
-                }
-                if (active.endAmplitude > CS40L26_PWLE_LEVEL_MAX) {
-                    active.endAmplitude = CS40L26_PWLE_LEVEL_MAX;
-                    ALOGD("%s: #%u: active: trim the end scale", __func__, c);
-                }
-
-                if (active.startFrequency < PWLE_FREQUENCY_MIN_HZ ||
-                    active.startFrequency > PWLE_FREQUENCY_MAX_HZ ||
-                    active.endFrequency < PWLE_FREQUENCY_MIN_HZ ||
-                    active.endFrequency > PWLE_FREQUENCY_MAX_HZ) {
-                    mStatsApi->logError(kBadPrimitiveError);
-                    ALOGE("%s: #%u: active: Invalid frequency %f, %f", __func__, c,
-                          active.startFrequency, active.endFrequency);
-                    return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-                }
 
-                /* Append a new segment if current and previous amplitude and
-                 * frequency are not all the same.
-                 */
-                if (!((active.startAmplitude == prevEndAmplitude) &&
-                      (active.startFrequency == prevEndFrequency))) {
-                    if (ch.constructActiveSegment(0, active.startAmplitude, active.startFrequency,
-                                                  false) < 0) {
-                        mStatsApi->logError(kPwleConstructionFailError);
-                        ALOGE("%s: #%u: active: Failed to construct for the start scale and "
-                              "frequency %f, %f",
-                              __func__, c, active.startAmplitude, active.startFrequency);
-                        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-                    }
-                    incrementIndex(&segmentIdx);
-                }
-
-                if (active.startFrequency != active.endFrequency) {
-                    chirp = true;
-                }
-                if (ch.constructActiveSegment(active.duration, active.endAmplitude,
-                                              active.endFrequency, chirp) < 0) {
-                    mStatsApi->logError(kPwleConstructionFailError);
-                    ALOGE("%s: #%u: active: Failed to construct for the end scale and frequency "
-                          "%f, %f",
+    // Writes each primitive as one or two sections, counting them
+    struct PwleBackend {
+        Vibrator *vibrator;
+        DspMemChunk *ch;
+        int segmentIdx = 0;
+        uint32_t totalDuration = 0;
+        float prevEndAmplitude;
+        float prevEndFrequency;
+        uint16_t c = 0;
+
+        void rejected(VibratorError error) { vibrator->mStatsApi->logError(error); }
+
+        ndk::ScopedAStatus addActive(const ActivePwle &active) {
+            /* Append a new segment if current and previous amplitude and
+             * frequency are not all the same.
+             */
+            if (!((active.startAmplitude == prevEndAmplitude) &&
+                  (active.startFrequency == prevEndFrequency))) {
+                if (ch->constructActiveSegment(0, active.startAmplitude, active.startFrequency,
+                                               false) < 0) {
+                    vibrator->mStatsApi->logError(kPwleConstructionFailError);
+                    ALOGE("%s: #%u: active: Failed to construct for the start scale and "
+                          "frequency %f, %f",
                           __func__, c, active.startAmplitude, active.startFrequency);
                     return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
                 }
                 incrementIndex(&segmentIdx);
-
-                prevEndAmplitude = active.endAmplitude;
-                prevEndFrequency = active.endFrequency;
-                totalDuration += active.duration;
-                chirp = false;
-                break;
             }
-            case PrimitivePwle::braking: {
-                auto braking = e.get<PrimitivePwle::braking>();
-                if (braking.braking > Braking::CLAB) {
-                    mStatsApi->logError(kBadPrimitiveError);
-                    ALOGE("%s: #%u: braking: Invalid braking type %s", __func__, c,
-                          toString(braking.braking).c_str());
-                    return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-                } else if (!isClabSupported && (braking.braking == Braking::CLAB)) {
-                    mStatsApi->logError(kBadPrimitiveError);
-                    ALOGE("%s: #%u: braking: Unsupported CLAB braking", __func__, c);
-                    return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-                }
 
-                if (braking.duration > COMPOSE_PWLE_PRIMITIVE_DURATION_MAX_MS) {
-                    mStatsApi->logError(kBadPrimitiveError);
-                    ALOGE("%s: #%u: braking: Invalid duration %d", __func__, c, braking.duration);
-                    return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-                }
+            const bool chirp = active.startFrequency != active.endFrequency;
+            if (ch->constructActiveSegment(active.duration, active.endAmplitude,
+                                           active.endFrequency, chirp) < 0) {
+                vibrator->mStatsApi->logError(kPwleConstructionFailError);
+                ALOGE("%s: #%u: active: Failed to construct for the end scale and frequency "
+                      "%f, %f",
+                      __func__, c, active.endAmplitude, active.endFrequency);
+                return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+            }
+            incrementIndex(&segmentIdx);
 
-                if (ch.constructBrakingSegment(0, braking.braking) < 0) {
-                    mStatsApi->logError(kPwleConstructionFailError);
-                    ALOGE("%s: #%u: braking: Failed to construct for type %s", __func__, c,
-                          toString(braking.braking).c_str());
-                    return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-                }
-                incrementIndex(&segmentIdx);
+            prevEndAmplitude = active.endAmplitude;
+            prevEndFrequency = active.endFrequency;
+            totalDuration += active.duration;
+            return next();
+        }
 
-                if (ch.constructBrakingSegment(braking.duration, braking.braking) < 0) {
-                    mStatsApi->logError(kPwleConstructionFailError);
-                    ALOGE("%s: #%u: braking: Failed to construct for type %s with duration %d",
-                          __func__, c, toString(braking.braking).c_str(), braking.duration);
-                    return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
-                }
-                incrementIndex(&segmentIdx);
+        ndk::ScopedAStatus addBraking(const BrakingPwle &braking) {
+            if (ch->constructBrakingSegment(0, braking.braking) < 0) {
+                vibrator->mStatsApi->logError(kPwleConstructionFailError);
+                ALOGE("%s: #%u: braking: Failed to construct for type %s", __func__, c,
+                      toString(braking.braking).c_str());
+                return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+            }
+            incrementIndex(&segmentIdx);
 
-                resetPreviousEndAmplitudeEndFrequency(&prevEndAmplitude, &prevEndFrequency);
-                totalDuration += braking.duration;
-                break;
+            if (ch->constructBrakingSegment(braking.duration, braking.braking) < 0) {
+                vibrator->mStatsApi->logError(kPwleConstructionFailError);
+                ALOGE("%s: #%u: braking: Failed to construct for type %s with duration %d",
+                      __func__, c, toString(braking.braking).c_str(), braking.duration);
+                return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
             }
-        }
+            incrementIndex(&segmentIdx);
 
-        if (segmentIdx > COMPOSE_PWLE_SIZE_MAX_DEFAULT) {
-            mStatsApi->logError(kPwleConstructionFailError);
-            ALOGE("Too many PrimitivePwle section!");
-            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+            resetPreviousEndAmplitudeEndFrequency(&prevEndAmplitude, &prevEndFrequency);
+            totalDuration += braking.duration;
+            return next();
         }
 
-        c++;
+        ndk::ScopedAStatus next() {
+            if (segmentIdx > COMPOSE_PWLE_SIZE_MAX_DEFAULT) {
+                vibrator->mStatsApi->logError(kPwleConstructionFailError);
+                ALOGE("Too many PrimitivePwle section!");
+                return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+            }
+            c++;
+            return ndk::ScopedAStatus::ok();
+        }
+    } backend{this, &ch};
+    resetPreviousEndAmplitudeEndFrequency(&backend.prevEndAmplitude, &backend.prevEndFrequency);
+
+    const PwleLimits limits{
+            .sizeMax = COMPOSE_PWLE_SIZE_MAX_DEFAULT,
+            .durationMaxMs = COMPOSE_PWLE_PRIMITIVE_DURATION_MAX_MS,
+            .frequencyMinHz = PWLE_FREQUENCY_MIN_HZ,
+            .frequencyMaxHz = PWLE_FREQUENCY_MAX_HZ,
+            .levelMax = CS40L26_PWLE_LEVEL_MAX,
+            .clabSupported = isClabSupported,
+    };
+    ndk::ScopedAStatus status = compilePwle(composite, limits, &backend);
+    if (!status.isOk()) {
+        return status;
     }
+    const int segmentIdx = backend.segmentIdx;
+    uint32_t totalDuration = backend.totalDuration;
     ch.flush();
 
     /* Update wlength */
@@ -1266,6 +1307,24 @@ binder_status_t Vibrator::dump(int fd, const char **args, uint32_t numArgs) {
     dprintf(fd, "  Redc: %.02f\n", mRedc);
     dprintf(fd, "  HAL State: %" PRIu32 "\n", halState);
 
+    dprintf(fd, "  External Control Toggle Latency (us): enable: last %" PRIu32 " max %" PRIu32
+                ", disable: last %" PRIu32 " max %" PRIu32 "\n",
+            mExternalControlLatencyUs[true][0], mExternalControlLatencyUs[true][1],
+            mExternalControlLatencyUs[false][0], mExternalControlLatencyUs[false][1]);
+
+    std::vector<uint32_t> latencies(
+            mPlayLatenciesUs.begin(),
+            mPlayLatenciesUs.begin() + std::min<size_t>(mPlayLatencyCount, mPlayLatenciesUs.size()));
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](size_t p) {
+        return latencies.empty() ? 0 : latencies[(latencies.size() - 1) * p / 100];
+    };
+    dprintf(fd,
+            "  Request To Play Latency (us): p50: %" PRIu32 " p90: %" PRIu32 " p99: %" PRIu32
+            " max: %" PRIu32 " (last %zu of %zu)\n",
+            percentile(50), percentile(90), percentile(99), percentile(100), latencies.size(),
+            mPlayLatencyCount);
+
     dprintf(fd, "  Voltage Levels:\n");
     dprintf(fd, "    Tick Effect Min: %" PRIu32 " Max: %" PRIu32 "\n", mTickEffectVol[0],
             mTickEffectVol[1]);
@@ -1298,6 +1357,12 @@ binder_status_t Vibrator::dump(int fd, const char **args, uint32_t numArgs) {
         }
         dprintf(fd, "\t%d\t%d\t{%s}\n", mFfEffects[effectId].id, numBytes, ss.str().c_str());
     }
+    dprintf(fd, "    Cached OWT Waveform:\n");
+    dprintf(fd, "\tId\tType\tt\tBytes\n");
+    for (const auto &entry : mOwtCache) {
+        dprintf(fd, "\t%d\t%d\t%d\t%zu\n", entry.effectIndex, entry.type, entry.length,
+                entry.data.size());
+    }
 
     dprintf(fd, "\n");
 
@@ -1389,6 +1454,8 @@ binder_status_t Vibrator::dump(int fd, const char **args, uint32_t numArgs) {
 
     mStatsApi->debug(fd);
 
+    mEffectHistory.debug(fd);
+
     if (mHwApi->isDbcSupported()) {
         dprintf(fd, "\nDBC Enabled\n");
     }
@@ -1634,7 +1701,7 @@ void Vibrator::waitForComplete(std::shared_ptr<IVibratorCallback> &&callback) {
 
     const std::scoped_lock<std::mutex> lock(mActiveId_mutex);
     uint32_t effectCount = WAVEFORM_MAX_PHYSICAL_INDEX;
-    if ((mActiveId >= WAVEFORM_MAX_PHYSICAL_INDEX) &&
+    if ((mActiveId >= WAVEFORM_MAX_PHYSICAL_INDEX) && !isOwtEffectCached(mActiveId) &&
         (!mHwApi->eraseOwtEffect(mActiveId, &mFfEffects))) {
         mStatsApi->logError(kHwApiError);
         ALOGE("Failed to clean up the composed effect %d", mActiveId);
@@ -1642,11 +1709,13 @@ void Vibrator::waitForComplete(std::shared_ptr<IVibratorCallback> &&callback) {
         ALOGD("waitForComplete: Vibrator is already off");
     }
     mHwApi->getEffectCount(&effectCount);
-    // Do waveform number checking
-    if ((effectCount > WAVEFORM_MAX_PHYSICAL_INDEX) &&
-        (!mHwApi->eraseOwtEffect(WAVEFORM_MAX_INDEX, &mFfEffects))) {
-        mStatsApi->logError(kHwApiError);
-        ALOGE("Failed to forcibly clean up all composed effect");
+    // Do waveform number checking; only the cached OWT effects may remain
+    if (effectCount > WAVEFORM_MAX_PHYSICAL_INDEX + mOwtCache.size()) {
+        if (!mHwApi->eraseOwtEffect(WAVEFORM_MAX_INDEX, &mFfEffects)) {
+            mStatsApi->logError(kHwApiError);
+            ALOGE("Failed to forcibly clean up all composed effect");
+        }
+        mOwtCache.clear();
     }
 
     mActiveId = -1;
@@ -25,9 +25,13 @@
 #include <chrono>
 #include <ctime>
 #include <fstream>
-#include <future>
+#include <mutex>
+#include <vector>
 
 #include "CapoDetector.h"
+#include "CompletionMonitor.h"
+#include "Trace.h"
+#include "VibratorStats.h"
 
 using CapoDetector = android::chre::CapoDetector;
 
@@ -157,22 +161,7 @@ class Vibrator : public BnVibrator {
     };
 
     // APIs for logging data to statistics backend
-    class StatsApi {
-      public:
-        virtual ~StatsApi() = default;
-        // Increment count for effect
-        virtual bool logPrimitive(uint16_t effectIndex) = 0;
-        // Increment count for long/short waveform and duration bucket
-        virtual bool logWaveform(uint16_t effectIndex, int32_t duration) = 0;
-        // Increment count for error
-        virtual bool logError(uint16_t errorIndex) = 0;
-        // Start new latency measurement
-        virtual bool logLatencyStart(uint16_t latencyIndex) = 0;
-        // Finish latency measurement and update latency statistics with result
-        virtual bool logLatencyEnd() = 0;
-        // Emit diagnostic information to the given file.
-        virtual void debug(int fd) = 0;
-    };
+    using StatsApi = VibratorStatsApi;
 
   public:
     Vibrator(std::unique_ptr<HwApi> hwapi, std::unique_ptr<HwCal> hwcal,
@@ -214,6 +203,10 @@ class Vibrator : public BnVibrator {
   private:
     ndk::ScopedAStatus on(uint32_t timeoutMs, uint32_t effectIndex, const class DspMemChunk *ch,
                           const std::shared_ptr<IVibratorCallback> &callback);
+    // uploads 'ch', unless an identical OWT effect is still loaded, and reports its index
+    ndk::ScopedAStatus loadOwtEffect(const class DspMemChunk *ch, uint32_t *outEffectIndex);
+    void evictOwtEffect();
+    bool isOwtEffectCached(int8_t effectIndex) const;
     // set 'amplitude' based on an arbitrary scale determined by 'maximum'
     ndk::ScopedAStatus setEffectAmplitude(float amplitude, float maximum, bool scalable);
     // 'simple' effects are those precompiled and loaded into the controller
@@ -240,6 +233,10 @@ class Vibrator : public BnVibrator {
     void createPwleMaxLevelLimitMap();
     void createBandwidthAmplitudeMap();
     uint16_t amplitudeToScale(float amplitude, float maximum, bool scalable);
+    // mStatsApi latency logging, also timing each request to its play event for dump()
+    void logLatencyStart(uint16_t latencyIndex);
+    // Returns the latency from the request, in microseconds
+    uint32_t logLatencyEnd();
     void updateContext();
 
     std::unique_ptr<HwApi> mHwApi;
@@ -250,11 +247,26 @@ class Vibrator : public BnVibrator {
     std::array<uint32_t, 2> mClickEffectVol;
     std::array<uint32_t, 2> mLongEffectVol;
     std::vector<ff_effect> mFfEffects;
+    // An OWT effect left loaded after it played, so the same composition replays without an upload
+    struct OwtCacheEntry {
+        size_t hash;
+        uint8_t type;
+        uint16_t length;
+        std::vector<uint8_t> data;
+        int8_t effectIndex;
+    };
+    std::vector<OwtCacheEntry> mOwtCache;  // most recently played first
     std::vector<uint32_t> mEffectDurations;
     std::vector<std::vector<int16_t>> mEffectCustomData;
-    std::future<void> mAsyncHandle;
     int8_t mActiveId{-1};
-    struct pcm *mHapticPcm;
+    int32_t mFfGain{-1};  // the gain last written, or -1 if unknown
+    std::chrono::steady_clock::time_point mLatencyStart;
+    std::array<uint32_t, 256> mPlayLatenciesUs{};
+    size_t mPlayLatencyCount{0};
+    EffectHistory mEffectHistory;
+    // Indexed by enabled: the last and the longest time to toggle external control
+    std::array<std::array<uint32_t, 2>, 2> mExternalControlLatencyUs{};
+    struct pcm *mHapticPcm{nullptr};  // kept open, and stopped, while not under external control
     int mCard;
     int mDevice;
     bool mHasHapticAlsaDevice{false};
@@ -278,6 +290,10 @@ class Vibrator : public BnVibrator {
     uint32_t mLastEffectPlayedTime = 0;
     float mLastPlayedScale = 0;
     sp<CapoDetector> mContextListener;
+    // Context scale of each carried position, filled when the listener starts
+    std::array<float, capo::PositionType_ARRAYSIZE> mContextScaleByPosition{};
+    // Property area serial the context properties were last read at
+    uint32_t mContextPropertySerial{0};
     enum hal_state {
         IDLE,
         PREPARING,
@@ -287,6 +303,11 @@ class Vibrator : public BnVibrator {
         RESTORED,
     };
     hal_state halState = IDLE;
+    // Last, so it stops before the state waitForComplete() uses is destroyed
+    CompletionMonitor mCompletionMonitor{
+            [this](std::shared_ptr<IVibratorCallback> &&callback) {
+                waitForComplete(std::move(callback));
+            }};
 };
 
 }  // namespace vibrator
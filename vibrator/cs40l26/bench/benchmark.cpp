@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "benchmark/benchmark.h"
+
+#include "DspMemChunk.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// As in Vibrator.cpp
+static constexpr uint8_t WAVEFORM_CLICK_INDEX = 2;
+static constexpr uint8_t WAVEFORM_COMPOSE = 14;
+static constexpr uint16_t FF_CUSTOM_DATA_LEN_MAX_COMP = 2044;
+
+// Builds the OWT bytes of a composition of state.range(0) primitives, as compose() does
+static void BM_ComposeBuild(benchmark::State &state) {
+    const int count = state.range(0);
+
+    for (auto _ : state) {
+        DspMemChunk ch(WAVEFORM_COMPOSE, FF_CUSTOM_DATA_LEN_MAX_COMP);
+        for (int i = 0; i < count; i++) {
+            ch.constructComposeSegment(50 /*amplitude*/, WAVEFORM_CLICK_INDEX /*index*/,
+                                       0 /*repeat*/, 0 /*flags*/, 20 /*delay*/);
+        }
+        ch.flush();
+        ch.updateNSection(count);
+        benchmark::DoNotOptimize(ch.front());
+    }
+}
+
+BENCHMARK(BM_ComposeBuild)->Arg(1)->Arg(4)->Arg(32)->Arg(COMPOSE_SIZE_MAX);
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
+
+BENCHMARK_MAIN();
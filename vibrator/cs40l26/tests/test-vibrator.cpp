@@ -16,6 +16,7 @@
 
 #include <aidl/android/hardware/vibrator/BnVibratorCallback.h>
 #include <android-base/logging.h>
+#include <dirent.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <linux/input.h>
@@ -198,6 +199,17 @@ static EffectScale Scale(float intensity, float levelLow, float levelHigh) {
     return levelToScale(Level(intensity, levelLow, levelHigh));
 }
 
+static size_t ThreadCount() {
+    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir("/proc/self/task"), closedir);
+    size_t count = 0;
+    while (dirent *entry = readdir(dir.get())) {
+        if (entry->d_name[0] != '.') {
+            count++;
+        }
+    }
+    return count;
+}
+
 class VibratorTest : public Test {
   public:
     void SetUp() override {
@@ -430,6 +442,39 @@ TEST_F(VibratorTest, off) {
     EXPECT_TRUE(mVibrator->off().isOk());
 }
 
+TEST_F(VibratorTest, onRepeated) {
+    constexpr int kCount = 1000;
+    auto callback = ndk::SharedRefBase::make<MockVibratorCallback>();
+    const size_t threads = ThreadCount();
+    size_t maxThreads = threads;
+
+    EXPECT_CALL(*mMockStats, logLatencyStart(kWaveformEffectLatency)).Times(kCount);
+    EXPECT_CALL(*mMockStats, logWaveform(_, _)).Times(kCount);
+    EXPECT_CALL(*mMockStats, logLatencyEnd()).Times(kCount);
+    // Every play has the same gain and duration, so both are only written once
+    EXPECT_CALL(*mMockApi, setFFGain(ON_GLOBAL_SCALE)).Times(1);
+    EXPECT_CALL(*mMockApi, setFFEffect(_, _)).Times(1);
+    EXPECT_CALL(*mMockApi, setFFPlay(WAVEFORM_SHORT_VIBRATION_EFFECT_INDEX, true)).Times(kCount);
+    EXPECT_CALL(*mMockApi, pollVibeState(_, _)).Times(2 * kCount);
+
+    for (int i = 0; i < kCount; i++) {
+        std::promise<void> promise;
+        std::future<void> future{promise.get_future()};
+        EXPECT_CALL(*callback, onComplete()).WillOnce([&promise] {
+            promise.set_value();
+            return ndk::ScopedAStatus::ok();
+        });
+
+        EXPECT_TRUE(mVibrator->on(1, callback).isOk());
+        maxThreads = std::max(maxThreads, ThreadCount());
+
+        EXPECT_EQ(future.wait_for(std::chrono::milliseconds(100)), std::future_status::ready);
+    }
+
+    // Completions all go through the one monitor thread the vibrator started with
+    EXPECT_EQ(threads, maxThreads);
+}
+
 TEST_F(VibratorTest, supportsAmplitudeControl_supported) {
     int32_t capabilities;
     EXPECT_CALL(*mMockApi, hasOwtFreeSpace()).WillOnce(Return(true));
@@ -485,6 +530,22 @@ TEST_F(VibratorTest, setExternalControl_enable) {
     EXPECT_TRUE(mVibrator->setExternalControl(true).isOk());
 }
 
+TEST_F(VibratorTest, setExternalControl_enableAfterHotplug) {
+    Sequence s1;
+    EXPECT_CALL(*mMockApi, setFFGain(ON_GLOBAL_SCALE)).WillOnce(DoDefault());
+    EXPECT_CALL(*mMockApi, getHapticAlsaDevice(_, _)).InSequence(s1).WillOnce(Return(true));
+    // The cached device is gone, so it is looked up again and opened once more
+    EXPECT_CALL(*mMockApi, setHapticPcmAmp(_, true, _, _))
+            .InSequence(s1)
+            .WillOnce(Return(false));
+    EXPECT_CALL(*mMockApi, getHapticAlsaDevice(_, _)).InSequence(s1).WillOnce(Return(true));
+    EXPECT_CALL(*mMockApi, setHapticPcmAmp(_, true, _, _))
+            .InSequence(s1)
+            .WillOnce(Return(true));
+
+    EXPECT_TRUE(mVibrator->setExternalControl(true).isOk());
+}
+
 TEST_F(VibratorTest, setExternalControl_disable) {
     Sequence s1, s2, s3, s4;
 
@@ -536,7 +597,7 @@ TEST_P(EffectsTest, perform) {
     bool composeEffect;
 
     ExpectationSet eSetup;
-    Expectation eActivate, ePollHaptics, ePollStop, eEraseDone;
+    Expectation eActivate, ePollHaptics, ePollStop;
 
     eSetup +=
             EXPECT_CALL(*mMockStats, logLatencyStart(kPrebakedEffectLatency)).WillOnce(DoDefault());
@@ -575,14 +636,8 @@ TEST_P(EffectsTest, perform) {
         ePollStop = EXPECT_CALL(*mMockApi, pollVibeState(0, -1))
                             .After(ePollHaptics)
                             .WillOnce(DoDefault());
-        if (composeEffect) {
-            eEraseDone = EXPECT_CALL(*mMockApi, eraseOwtEffect(_, _))
-                                 .After(ePollStop)
-                                 .WillOnce(DoDefault());
-            EXPECT_CALL(*callback, onComplete()).After(eEraseDone).WillOnce(complete);
-        } else {
-            EXPECT_CALL(*callback, onComplete()).After(ePollStop).WillOnce(complete);
-        }
+        // A composed effect stays loaded for replay rather than being erased
+        EXPECT_CALL(*callback, onComplete()).After(ePollStop).WillOnce(complete);
     }
 
     int32_t lengthMs;
@@ -658,7 +713,7 @@ TEST_P(ComposeTest, compose) {
     auto composite = param.composite;
     auto queue = std::get<0>(param.queue);
     ExpectationSet eSetup;
-    Expectation eActivate, ePollHaptics, ePollStop, eEraseDone;
+    Expectation eActivate, ePollHaptics, ePollStop;
     auto callback = ndk::SharedRefBase::make<MockVibratorCallback>();
     std::promise<void> promise;
     std::future<void> future{promise.get_future()};
@@ -688,15 +743,44 @@ TEST_P(ComposeTest, compose) {
                            .WillOnce(DoDefault());
     ePollStop =
             EXPECT_CALL(*mMockApi, pollVibeState(0, -1)).After(ePollHaptics).WillOnce(DoDefault());
-    eEraseDone =
-            EXPECT_CALL(*mMockApi, eraseOwtEffect(_, _)).After(ePollStop).WillOnce(DoDefault());
-    EXPECT_CALL(*callback, onComplete()).After(eEraseDone).WillOnce(complete);
+    EXPECT_CALL(*callback, onComplete()).After(ePollStop).WillOnce(complete);
 
     EXPECT_EQ(EX_NONE, mVibrator->compose(composite, callback).getExceptionCode());
 
     EXPECT_EQ(future.wait_for(std::chrono::milliseconds(100)), std::future_status::ready);
 }
 
+TEST_P(ComposeTest, composeReplay) {
+    auto param = GetParam();
+    auto composite = param.composite;
+    auto callback = ndk::SharedRefBase::make<MockVibratorCallback>();
+
+    EXPECT_CALL(*mMockStats, logLatencyStart(kCompositionEffectLatency)).Times(2);
+    EXPECT_CALL(*mMockStats, logPrimitive(_)).Times(2 * composite.size());
+    EXPECT_CALL(*mMockStats, logLatencyEnd()).Times(2);
+    // The gain is staged by the first play and left as it is for the replay
+    EXPECT_CALL(*mMockApi, setFFGain(ON_GLOBAL_SCALE)).Times(1);
+    EXPECT_CALL(*mMockApi, pollVibeState(_, _)).Times(4);
+    EXPECT_CALL(*mMockApi, setFFPlay(WAVEFORM_COMPOSE, true)).Times(2);
+    // Only the first play uploads; the replay finds the effect still loaded
+    EXPECT_CALL(*mMockApi, getOwtFreeSpace(_)).Times(1);
+    EXPECT_CALL(*mMockApi, uploadOwtEffect(_, _, _, _, _)).Times(1);
+    EXPECT_CALL(*mMockApi, eraseOwtEffect(_, _)).Times(0);
+
+    for (int i = 0; i < 2; i++) {
+        std::promise<void> promise;
+        std::future<void> future{promise.get_future()};
+        EXPECT_CALL(*callback, onComplete()).WillOnce([&promise] {
+            promise.set_value();
+            return ndk::ScopedAStatus::ok();
+        });
+
+        EXPECT_EQ(EX_NONE, mVibrator->compose(composite, callback).getExceptionCode());
+
+        EXPECT_EQ(future.wait_for(std::chrono::milliseconds(100)), std::future_status::ready);
+    }
+}
+
 const std::vector<ComposeParam> kComposeParams = {
         {"click",
          {{0, CompositePrimitive::CLICK, 1.0f}},